@@ -70,6 +70,7 @@ check_include_file(sys/resource.h HAVE_SYS_RESOURCE_H)
 check_include_file(sys/stat.h HAVE_SYS_STAT_H)
 check_include_file(sys/time.h HAVE_SYS_TIME_H)
 check_include_file(sys/types.h HAVE_SYS_TYPES_H)
+check_include_file(sys/un.h HAVE_SYS_UN_H)
 check_include_file(sys/wait.h HAVE_SYS_WAIT_H)
 check_include_file(termios.h HAVE_TERMIOS_H)
 check_include_file(time.h HAVE_TIME_H)
@@ -89,6 +90,25 @@ ELSE (HAVE_LIBDL)
     SET(LIBDL "")
 ENDIF (HAVE_LIBDL)
 
+# compression libraries for --compress-debug-sections
+check_include_file(zlib.h HAVE_ZLIB_H)
+check_library_exists(z compress2 "" HAVE_LIBZ)
+IF (HAVE_ZLIB_H AND HAVE_LIBZ)
+    SET(HAVE_ZLIB 1)
+    SET(LIBZ "z")
+ELSE (HAVE_ZLIB_H AND HAVE_LIBZ)
+    SET(LIBZ "")
+ENDIF (HAVE_ZLIB_H AND HAVE_LIBZ)
+
+check_include_file(zstd.h HAVE_ZSTD_H)
+check_library_exists(zstd ZSTD_compress "" HAVE_LIBZSTD)
+IF (HAVE_ZSTD_H AND HAVE_LIBZSTD)
+    SET(HAVE_ZSTD 1)
+    SET(LIBZSTD "zstd")
+ELSE (HAVE_ZSTD_H AND HAVE_LIBZSTD)
+    SET(LIBZSTD "")
+ENDIF (HAVE_ZSTD_H AND HAVE_LIBZSTD)
+
 # function checks
 INCLUDE(CheckSymbolExists)
 INCLUDE(CheckFunctionExists)
@@ -120,6 +140,7 @@ check_symbol_exists(mkstemp "stdlib.h;unistd.h" HAVE_MKSTEMP)
 check_symbol_exists(mktemp "stdlib.h;unistd.h" HAVE_MKTEMP)
 if( NOT LLVM_ON_WIN32 )
   check_symbol_exists(pthread_mutex_lock pthread.h HAVE_PTHREAD_MUTEX_LOCK)
+  check_symbol_exists(pthread_getspecific pthread.h HAVE_PTHREAD_GETSPECIFIC)
 endif()
 check_symbol_exists(sbrk unistd.h HAVE_SBRK)
 check_symbol_exists(strdup string.h HAVE_STRDUP)
@@ -156,6 +177,14 @@ endif()
 check_type_exists(uint64_t "${headers}" HAVE_UINT64_T)
 check_type_exists(u_int64_t "${headers}" HAVE_U_INT64_T)
 
+# 128-bit integers with checked arithmetic (used by IntNum)
+CHECK_CXX_SOURCE_COMPILES("
+int main() {
+  __int128 a = 1, b = 2, r;
+  return __builtin_add_overflow(a, b, &r) || __builtin_sub_overflow(a, b, &r)
+      || __builtin_mul_overflow(a, b, &r);
+}" HAVE_INT128_OVERFLOW_BUILTINS)
+
 include(CheckCXXCompilerFlag)
 check_cxx_compiler_flag("-fPIC" SUPPORTS_FPIC_FLAG)
 
@@ -215,18 +244,42 @@ endif( MSVC )
 # FIXME: Signal handler return type, currently hardcoded to 'void'
 set(RETSIGTYPE void)
 
-#if( LLVM_ENABLE_THREADS )
-#  if( HAVE_PTHREAD_H OR WIN32 )
-#    set(ENABLE_THREADS 1)
-#  endif( HAVE_PTHREAD_H OR WIN32 )
-#endif( LLVM_ENABLE_THREADS )
-#
-#if( ENABLE_THREADS )
-#  message(STATUS "Threads enabled.")
-#else( ENABLE_THREADS )
-#  message(STATUS "Threads disabled.")
-#endif( ENABLE_THREADS )
+set(LLVM_ENABLE_THREADS 0)
+if( ENABLE_THREADS )
+  if( HAVE_PTHREAD_H OR WIN32 )
+    set(LLVM_ENABLE_THREADS 1)
+  endif( HAVE_PTHREAD_H OR WIN32 )
+endif( ENABLE_THREADS )
+
+if( LLVM_ENABLE_THREADS )
+  message(STATUS "Threads enabled.")
+else( LLVM_ENABLE_THREADS )
+  message(STATUS "Threads disabled.")
+endif( LLVM_ENABLE_THREADS )
+
+IF (LLVM_ENABLE_THREADS AND HAVE_LIBPTHREAD)
+    SET(LIBPTHREAD "pthread")
+ELSE (LLVM_ENABLE_THREADS AND HAVE_LIBPTHREAD)
+    SET(LIBPTHREAD "")
+ENDIF (LLVM_ENABLE_THREADS AND HAVE_LIBPTHREAD)
+
 set(LLVM_HAS_ATOMICS 0)
+if( LLVM_ENABLE_THREADS )
+  if( MSVC )
+    set(LLVM_HAS_ATOMICS 1)
+  else( MSVC )
+    CHECK_CXX_SOURCE_COMPILES("
+int main() {
+  volatile unsigned int val = 0;
+  __sync_synchronize();
+  __sync_add_and_fetch(&val, 1);
+  return __sync_val_compare_and_swap(&val, 1, 0);
+}" HAVE_GCC_ATOMICS)
+    if( HAVE_GCC_ATOMICS )
+      set(LLVM_HAS_ATOMICS 1)
+    endif( HAVE_GCC_ATOMICS )
+  endif( MSVC )
+endif( LLVM_ENABLE_THREADS )
 
 if(WIN32)
   if(CYGWIN)
@@ -620,6 +673,11 @@ CONFIGURE_FILE(
     include/yasmx/Config/longlong.h.cmake
     ${CMAKE_CURRENT_BINARY_DIR}/include/yasmx/Config/longlong.h
     )
+SET(YASM_64BIT_SOURCE_LOCATIONS ${ENABLE_64BIT_SOURCE_LOCATIONS})
+CONFIGURE_FILE(
+    include/yasmx/Config/sourceloc.h.cmake
+    ${CMAKE_CURRENT_BINARY_DIR}/include/yasmx/Config/sourceloc.h
+    )
 IF(BUILD_TESTS)
     CONFIGURE_FILE(
         unittests/unittest_config.h.cmake
@@ -0,0 +1,279 @@
+#! /usr/bin/env python
+# Assembler benchmark harness
+#
+#  Copyright (C) 2026  Peter Johnson
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+#
+#
+# Generates the synthetic inputs in genbench.py, assembles each one
+# several times with "yasm --trace", and reports the time spent in each
+# assembler phase (taken from the trace) along with the total run time.
+# Results can also be written in Google Benchmark JSON format for
+# comparison with its tools (e.g. compare.py).
+#
+# With --scaling, the scaling generators are instead run at element counts
+# from 10^3 up to 10^6, and the empirical complexity exponent (the slope of
+# log time against log size) is reported for each, so superlinear
+# behavior shows up long before it would on real inputs.
+#
+import json
+import math
+import optparse
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+import genbench
+
+PHASES = ["Parse", "Finalize", "Optimize", "Debug Generate", "Output"]
+
+def lprint(*args, **kwargs):
+    sep = kwargs.pop("sep", ' ')
+    end = kwargs.pop("end", '\n')
+    file = kwargs.pop("file", sys.stdout)
+    file.write(sep.join(args))
+    file.write(end)
+
+def run_once(yasmexe, gen, inpath, workdir):
+    """Assemble an input once; returns a dict of phase name to seconds."""
+    tracepath = os.path.join(workdir, gen.name + ".trace.json")
+    outpath = os.path.join(workdir, gen.name + ".o")
+    cmd = [yasmexe] + gen.args + ["--trace=" + tracepath, "-o", outpath,
+                                  inpath]
+    start = time.time()
+    proc = subprocess.Popen(cmd, stdout=subprocess.PIPE,
+                            stderr=subprocess.STDOUT)
+    output = proc.communicate()[0]
+    elapsed = time.time() - start
+    if proc.returncode != 0:
+        raise RuntimeError("%s failed:\n%s" % (" ".join(cmd),
+                                                output.decode("utf-8")))
+
+    times = dict((phase, 0.0) for phase in PHASES)
+    times["Total"] = elapsed
+    f = open(tracepath)
+    try:
+        events = json.load(f)["traceEvents"]
+    finally:
+        f.close()
+    for event in events:
+        if event["ph"] == 'X' and event["name"] in times:
+            times[event["name"]] += event["dur"] / 1e6
+    return times
+
+def fit_exponent(sizes, times):
+    """Least-squares slope of log(time) against log(size)."""
+    xs = [math.log(n) for n in sizes]
+    ys = [math.log(t) for t in times]
+    xmean = sum(xs) / len(xs)
+    ymean = sum(ys) / len(ys)
+    sxx = sum((x - xmean) ** 2 for x in xs)
+    sxy = sum((x - xmean) * (y - ymean) for x, y in zip(xs, ys))
+    return sxy / sxx
+
+def run_scaling(yasmexe, gen, options, workdir, results):
+    """Time a scaling generator at increasing sizes, stopping at the first
+    size that fails to assemble.  Returns the fitted exponent (None if there
+    were too few usable sizes) and whether all sizes assembled."""
+    # Time an empty input to subtract process startup and output overhead,
+    # which would otherwise flatten the fit at small sizes.
+    inpath = gen.write(workdir, 0)
+    base = min(run_once(yasmexe, gen, inpath, workdir)["Total"]
+               for i in range(options.repetitions))
+
+    max_size = min(options.max_size, gen.max_size or options.max_size)
+    sizes, times = [], []
+    ok = True
+    step = 0
+    while True:
+        n = int(round(1000 * 10 ** (step / 2.0)))
+        step += 1
+        if n > max_size:
+            break
+        inpath = gen.write(workdir, n)
+        try:
+            elapsed = min(run_once(yasmexe, gen, inpath, workdir)["Total"]
+                          for i in range(options.repetitions))
+        except RuntimeError:
+            lprint("%-32s %12s %12d" % ("%s/%d" % (gen.name, n), "FAILED", n))
+            ok = False
+            break
+        name = "%s/%d" % (gen.name, n)
+        lprint("%-32s %9.3f ms %12d" % (name, elapsed * 1e3, n))
+        results.append({
+            "name": name,
+            "run_name": gen.name,
+            "run_type": "iteration",
+            "iterations": options.repetitions,
+            "real_time": elapsed * 1e3,
+            "cpu_time": elapsed * 1e3,
+            "time_unit": "ms",
+            "complexity_n": n,
+        })
+        # Sizes too fast to measure above the startup time say nothing
+        # about the growth rate.
+        if elapsed - base >= options.min_time:
+            sizes.append(n)
+            times.append(elapsed - base)
+        if elapsed >= options.time_limit:
+            break
+
+    if len(sizes) < 2:
+        lprint("%-32s %12s" % (gen.name + "_BigO", "too fast"))
+        return None, ok
+    exponent = fit_exponent(sizes, times)
+    lprint("%-32s %12s" % (gen.name + "_BigO", "N^%.2f" % exponent))
+    results.append({
+        "name": gen.name + "_BigO",
+        "run_name": gen.name,
+        "run_type": "aggregate",
+        "aggregate_name": "BigO",
+        "big_o": "N^%.2f" % exponent,
+        "exponent": exponent,
+        "time_unit": "ms",
+    })
+    return exponent, ok
+
+def run_benchmarks(yasmexe, options, filt, workdir, results):
+    lprint("%-32s %12s %12s %10s" % ("Benchmark", "Time", "Min",
+                                     "Iterations"))
+    lprint("-" * 69)
+    for gen in genbench.generators:
+        if not filt.search(gen.name):
+            continue
+        inpath = gen.write(workdir, options.scale)
+        runs = [run_once(yasmexe, gen, inpath, workdir)
+                for i in range(options.repetitions)]
+        for phase in PHASES + ["Total"]:
+            samples = [run[phase] for run in runs]
+            if phase != "Total" and max(samples) == 0.0:
+                continue    # phase not run (e.g. no debug format)
+            name = "%s/%s" % (gen.name, phase.replace(' ', ''))
+            mean = sum(samples) / len(samples)
+            lprint("%-32s %9.3f ms %9.3f ms %10d" %
+                   (name, mean * 1e3, min(samples) * 1e3, len(samples)))
+            results.append({
+                "name": name,
+                "run_name": name,
+                "run_type": "iteration",
+                "iterations": len(samples),
+                "real_time": mean * 1e3,
+                "cpu_time": mean * 1e3,
+                "time_unit": "ms",
+                "min_time": min(samples) * 1e3,
+            })
+
+def run_scaling_benchmarks(yasmexe, options, filt, workdir, results):
+    """Returns the names of the benchmarks that failed to assemble or
+    exceeded the maximum exponent."""
+    failed = []
+    lprint("%-32s %12s %12s" % ("Benchmark", "Time", "Size"))
+    lprint("-" * 58)
+    for gen in genbench.scaling_generators:
+        if not filt.search(gen.name):
+            continue
+        exponent, ok = run_scaling(yasmexe, gen, options, workdir, results)
+        if not ok or (options.max_exponent is not None and
+                      exponent is not None and
+                      exponent > options.max_exponent):
+            failed.append(gen.name)
+    return failed
+
+def main(argv):
+    parser = optparse.OptionParser(usage="%prog [options] <yasm executable>")
+    parser.add_option("-s", "--scale", type="int", default=1,
+                      help="input size multiplier [default: %default]")
+    parser.add_option("-r", "--repetitions", type="int", default=5,
+                      help="runs per benchmark [default: %default]")
+    parser.add_option("-f", "--filter", default="",
+                      help="only run benchmarks matching regex")
+    parser.add_option("--json", metavar="FILE",
+                      help="write results in Google Benchmark JSON format")
+    parser.add_option("--keep", metavar="DIR",
+                      help="keep generated inputs and outputs in DIR")
+    parser.add_option("--scaling", action="store_true", default=False,
+                      help="run the scaling benchmarks and report their "
+                           "complexity exponents")
+    parser.add_option("--max-size", type="int", default=1000000,
+                      help="largest scaling input size [default: %default]")
+    parser.add_option("--time-limit", type="float", default=10.0,
+                      help="stop growing a scaling input once a run takes "
+                           "this many seconds [default: %default]")
+    parser.add_option("--min-time", type="float", default=0.01,
+                      help="ignore scaling runs within this many seconds "
+                           "of an empty input [default: %default]")
+    parser.add_option("--max-exponent", type="float",
+                      help="fail if a scaling benchmark's exponent "
+                           "exceeds this")
+    (options, args) = parser.parse_args(argv[1:])
+    if len(args) != 1:
+        parser.error("no yasm executable given")
+    yasmexe = args[0]
+
+    if options.keep:
+        workdir = options.keep
+        if not os.path.isdir(workdir):
+            os.makedirs(workdir)
+    else:
+        workdir = tempfile.mkdtemp(prefix="yasmbench")
+
+    filt = re.compile(options.filter)
+    results = []
+    failed = []
+    try:
+        if options.scaling:
+            failed = run_scaling_benchmarks(yasmexe, options, filt, workdir,
+                                            results)
+        else:
+            run_benchmarks(yasmexe, options, filt, workdir, results)
+    finally:
+        if not options.keep:
+            shutil.rmtree(workdir)
+
+    if options.json:
+        f = open(options.json, "w")
+        try:
+            json.dump({
+                "context": {
+                    "date": time.strftime("%Y-%m-%d %H:%M:%S"),
+                    "executable": yasmexe,
+                    "scale": options.scale,
+                    "scaling": options.scaling,
+                },
+                "benchmarks": results,
+            }, f, indent=2)
+            f.write("\n")
+        finally:
+            f.close()
+
+    if failed:
+        lprint("FAILED: " + ", ".join(failed), file=sys.stderr)
+        return 1
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,276 @@
+#! /usr/bin/env python
+# Benchmark input generators
+#
+#  Copyright (C) 2026  Peter Johnson
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+#
+#
+# Each generator writes a synthetic source file exercising one part of the
+# assembler.  The size of the input scales linearly with the scale factor;
+# scale 1 assembles in well under a second.
+#
+# The scaling generators instead take an element count and build
+# pathological inputs (one huge expression, one long dependency chain,
+# etc.) for measuring how assembly time grows with input size.
+#
+import os
+import sys
+
+class Generator(object):
+    def __init__(self, name, filename, args, func, desc, max_size=None):
+        self.name = name
+        self.filename = filename
+        self.args = args
+        self.func = func
+        self.desc = desc
+        self.max_size = max_size
+
+    def write(self, outdir, scale):
+        path = os.path.join(outdir, self.filename)
+        f = open(path, "w")
+        try:
+            self.func(f, scale)
+        finally:
+            f.close()
+        return path
+
+generators = []
+
+def generator(filename, args, desc):
+    """Register a generator function; args are the yasm arguments."""
+    def register(func):
+        generators.append(Generator(func.__name__, filename, args, func,
+                                    desc))
+        return func
+    return register
+
+scaling_generators = []
+
+def scaling(filename, args, desc, max_size=1000000):
+    """Register a scaling generator function, called with an element
+    count rather than a scale factor; max_size caps the element count."""
+    def register(func):
+        scaling_generators.append(Generator(func.__name__, filename, args,
+                                            func, desc, max_size))
+        return func
+    return register
+
+@generator("jumps.asm", ["-f", "elf64"],
+           "jump-dense code (optimizer span resolution)")
+def jumps(f, scale):
+    # Every block jumps both forward and backward across a varying amount
+    # of code, so many jumps sit close to the short/near boundary.
+    n = 5000 * scale
+    f.write("bits 64\nsection .text\n")
+    for i in range(n):
+        f.write("L%d:\n" % i)
+        f.write("\tcmp eax, %d\n" % (i % 128))
+        f.write("\tje L%d\n" % min(n - 1, i + 1 + (i * 7) % 40))
+        f.write("\tjne L%d\n" % max(0, i - (i * 13) % 40))
+        f.write("\tadd eax, ebx\n" * (i % 5))
+        f.write("\tjmp L%d\n" % ((i * 31) % n))
+
+@generator("macros.asm", ["-f", "elf64"],
+           "macro-heavy NASM (preprocessor)")
+def macros(f, scale):
+    n = 2000 * scale
+    f.write("bits 64\n")
+    f.write("%macro SAVE 1-*\n%rep %0\n\tpush %1\n%rotate 1\n%endrep\n"
+            "%endmacro\n")
+    f.write("%macro RESTORE 1-*\n%rep %0\n%rotate -1\n\tpop %1\n%endrep\n"
+            "%endmacro\n")
+    f.write("%macro FUNC 2\n%1:\n\tSAVE rbx, rbp, r12, r13\n"
+            "%assign %%i 0\n%rep %2\n\tmov rax, %%i\n\tadd rbx, rax\n"
+            "%assign %%i %%i+1\n%endrep\n"
+            "\tRESTORE rbx, rbp, r12, r13\n\tret\n%endmacro\n")
+    f.write("%define SCALE(x) ((x)*4+1)\n")
+    f.write("section .text\n")
+    for i in range(n):
+        f.write("FUNC func%d, %d\n" % (i, i % 8))
+        f.write("\tmov ecx, SCALE(%d)\n" % i)
+
+@generator("compiler.s", ["-p", "gas", "-f", "elf64", "-g", "dwarf2"],
+           "compiler-style GAS with .loc and .cfi")
+def compiler(f, scale):
+    n = 2000 * scale
+    f.write("\t.file\t\"bench.c\"\n")
+    f.write("\t.file 1 \"bench.c\"\n")
+    f.write("\t.file 2 \"bench.h\"\n")
+    f.write("\t.text\n")
+    for i in range(n):
+        line = i * 10
+        f.write("\t.globl\tfunc%d\n" % i)
+        f.write("\t.type\tfunc%d, @function\n" % i)
+        f.write("func%d:\n" % i)
+        f.write("\t.loc 1 %d 0\n" % line)
+        f.write("\t.cfi_startproc\n")
+        f.write("\tpushq\t%rbp\n")
+        f.write("\t.cfi_def_cfa_offset 16\n")
+        f.write("\t.cfi_offset 6, -16\n")
+        f.write("\tmovq\t%rsp, %rbp\n")
+        f.write("\t.cfi_def_cfa_register 6\n")
+        f.write("\t.loc 1 %d 5\n" % (line + 1))
+        f.write("\tmovl\t%%edi, -%d(%%rbp)\n" % (4 + (i % 4) * 4))
+        f.write("\t.loc 2 %d 3\n" % (i % 100 + 1))
+        f.write("\tleaq\t.LC%d(%%rip), %%rax\n" % i)
+        f.write("\ttestl\t%edi, %edi\n")
+        f.write("\tje\t.L%d\n" % i)
+        f.write("\tcall\tfunc%d\n" % ((i * 17) % n))
+        f.write(".L%d:\n" % i)
+        f.write("\t.loc 1 %d 1\n" % (line + 2))
+        f.write("\tpopq\t%rbp\n")
+        f.write("\t.cfi_def_cfa 7, 8\n")
+        f.write("\tret\n")
+        f.write("\t.cfi_endproc\n")
+        f.write("\t.size\tfunc%d, .-func%d\n" % (i, i))
+        f.write("\t.section\t.rodata\n")
+        f.write(".LC%d:\n\t.string\t\"string %d\"\n" % (i, i))
+        f.write("\t.text\n")
+
+@generator("data.asm", ["-f", "elf64"],
+           "large times/.rept data")
+def data(f, scale):
+    n = 200 * scale
+    f.write("section .data\n")
+    for i in range(n):
+        f.write("d%d:\n" % i)
+        f.write("\ttimes %d db %d\n" % (256 + i % 256, i % 256))
+        f.write("\ttimes 64 dd d%d + %d\n" % (i, i))
+        f.write("\ttimes 32 dw %d, %d\n" % (i, -i))
+    f.write("section .bss\n")
+    f.write("\tresb %d\n" % (65536 * scale))
+
+@generator("rept.s", ["-p", "gas", "-f", "elf64"],
+           "large .rept data (GAS)")
+def rept(f, scale):
+    n = 200 * scale
+    f.write("\t.data\n")
+    for i in range(n):
+        f.write("d%d:\n" % i)
+        f.write("\t.rept %d\n\t.byte %d\n\t.endr\n" % (256 + i % 256,
+                                                        i % 256))
+        f.write("\t.rept 64\n\t.long d%d + %d\n\t.endr\n" % (i, i))
+        f.write("\t.fill 32, 2, %d\n" % i)
+
+@generator("sections.asm", ["-f", "elf64"],
+           "many sections")
+def sections(f, scale):
+    n = 2000 * scale
+    f.write("bits 64\n")
+    for i in range(n):
+        f.write("section .text.f%d progbits alloc exec align=16\n" % i)
+        f.write("global f%d\nf%d:\n" % (i, i))
+        f.write("\tmov eax, [rel v%d]\n\tret\n" % i)
+        f.write("section .data.v%d progbits alloc write align=4\n" % i)
+        f.write("v%d: dd %d\n" % (i, i))
+
+@generator("symbols.asm", ["-f", "elf64"],
+           "many symbols")
+def symbols(f, scale):
+    n = 20000 * scale
+    f.write("bits 64\nsection .data\n")
+    for i in range(n):
+        if i % 3 == 0:
+            f.write("global sym%d\n" % i)
+        elif i % 3 == 1:
+            f.write("extern ext%d\n" % i)
+        f.write("sym%d: dq sym%d\n" % (i, (i * 7) % n))
+        f.write("equ%d equ %d\n" % (i, i))
+        if i % 3 == 1:
+            f.write("\tdq ext%d\n" % i)
+
+@scaling("exprchain.asm", ["-f", "bin"],
+         "one long + chain (Expr::LevelOp)")
+def exprchain(f, n):
+    f.write("x equ 1\n\tdd x")
+    for i in range(n):
+        f.write("+x")
+    f.write("\n")
+
+@scaling("timeschain.asm", ["-f", "bin"],
+         "chain of times depending on the next block (CheckCycles)")
+def timeschain(f, n):
+    # Each block's size depends on the size of the block after it, giving
+    # a dependency chain as deep as the input is long.
+    for i in range(n):
+        f.write("s%d:\ttimes (e%d-s%d)&3 db 0\n" % (i, i+1, i+1))
+        f.write("\tnop\ne%d:\n" % i)
+    f.write("s%d:\tnop\ne%d:\n" % (n, n))
+
+@scaling("aligns.asm", ["-f", "bin"],
+         "align between span-dependent jumps (offset setters)")
+def aligns(f, n):
+    f.write("bits 32\n")
+    for i in range(n):
+        f.write("\tjmp L%d\n" % min(n, i + 8))
+        f.write("\ttimes %d nop\n" % (i % 13))
+        f.write("\talign 16\nL%d:\n" % i)
+    f.write("L%d:\n" % n)
+
+@scaling("binsects.asm", ["-f", "bin"],
+         "many bin sections (BinLink::CheckLMAOverlap)", max_size=100000)
+def binsects(f, n):
+    for i in range(n):
+        f.write("section s%d progbits align=4\n" % i)
+        f.write("\tdd %d\n" % i)
+
+@scaling("dwarffiles.s", ["-p", "gas", "-f", "elf64", "-g", "dwarf2"],
+         "many .file entries (DwarfDebug::AddFile)")
+def dwarffiles(f, n):
+    f.write("\t.text\n")
+    for i in range(1, n+1):
+        f.write("\t.file %d \"dir%d/file%d.c\"\n" % (i, i % 100, i))
+        f.write("\t.loc %d 1 0\n\tnop\n" % i)
+
+@scaling("reptcount.s", ["-p", "gas", "-f", "elf64"],
+         "one huge .rept count (ParseDirRept)")
+def reptcount(f, n):
+    f.write("\t.data\n\t.rept %d\n\t.byte 1\n\t.endr\n" % n)
+
+def main(argv):
+    import optparse
+    parser = optparse.OptionParser(
+        usage="%prog [options] <output directory> [<name>...]")
+    parser.add_option("-s", "--scale", type="int", default=1,
+                      help="input size multiplier [default: %default]")
+    parser.add_option("-n", "--size", type="int",
+                      help="write the scaling inputs with SIZE elements "
+                           "instead")
+    (options, args) = parser.parse_args(argv[1:])
+    if not args:
+        parser.error("no output directory given")
+    outdir = args[0]
+    if not os.path.isdir(outdir):
+        os.makedirs(outdir)
+    if options.size is not None:
+        gens, scale = scaling_generators, options.size
+    else:
+        gens, scale = generators, options.scale
+    for gen in gens:
+        if len(args) > 1 and gen.name not in args[1:]:
+            continue
+        print(gen.write(outdir, scale))
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -200,7 +200,7 @@ macro (YASM_ADD_EXECUTABLE _target_NAME)
    if (NOT BUILD_STATIC)
        yasm_handle_rpath_for_executable(${_target_NAME} ${_type})
    endif (NOT BUILD_STATIC)
-   TARGET_LINK_LIBRARIES(${_target_NAME} yasmstdx libyasmx ${LIBPSAPI} ${LIBIMAGEHLP})
+   TARGET_LINK_LIBRARIES(${_target_NAME} yasmstdx libyasmx ${LIBPTHREAD} ${LIBPSAPI} ${LIBIMAGEHLP})
    set_target_properties(${_target_NAME} PROPERTIES
        LINK_FLAGS "${YASM_EXE_LINKER_FLAGS}"
        )
@@ -253,9 +253,13 @@ macro (YASM_ADD_LIBRARY _target_NAME _lib_TYPE)
    yasm_set_compile_flags(${_SRCS})
 endmacro (YASM_ADD_LIBRARY _target_NAME _lib_TYPE)
 
+# Modules not listed in YASM_STANDARD_MODULES (if set) are left out.
 macro (YASM_ADD_MODULE _module_NAME)
-    list(APPEND YASM_MODULES_SRC ${ARGN})
-    list(APPEND YASM_MODULES ${_module_NAME})
+    list(FIND YASM_STANDARD_MODULES ${_module_NAME} _module_index)
+    if (NOT YASM_STANDARD_MODULES OR _module_index GREATER -1)
+        list(APPEND YASM_MODULES_SRC ${ARGN})
+        list(APPEND YASM_MODULES ${_module_NAME})
+    endif (NOT YASM_STANDARD_MODULES OR _module_index GREATER -1)
 endmacro (YASM_ADD_MODULE)
 
 macro (YASM_GENPERF _in_NAME _out_NAME)
@@ -36,9 +36,22 @@
 /* Define to 1 if you have the <sys/types.h> header file. */
 #cmakedefine HAVE_SYS_TYPES_H 1
 
+/* Define to 1 if you have the <sys/un.h> header file. */
+#cmakedefine HAVE_SYS_UN_H 1
+
 /* Define to 1 if you have the `getcwd' function. */
 #cmakedefine HAVE_GETCWD 1
 
+/* Define to 1 if the compiler supports __int128 and the
+   __builtin_*_overflow checked arithmetic functions. */
+#cmakedefine HAVE_INT128_OVERFLOW_BUILTINS 1
+
+/* Define to 1 if zlib is available for section compression. */
+#cmakedefine HAVE_ZLIB 1
+
+/* Define to 1 if zstd is available for section compression. */
+#cmakedefine HAVE_ZSTD 1
+
 /* Name of package */
 #define PACKAGE "yasm"
 
@@ -0,0 +1,293 @@
+//
+// Static library archive writer
+//
+//  Copyright (C) 2026  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include "archive.h"
+
+#include <algorithm>
+
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "yasmx/Object.h"
+#include "yasmx/Symbol.h"
+
+
+using namespace yasm;
+using llvm::StringRef;
+
+static const char ARMAG[] = "!<arch>\n";
+static const unsigned long HEADER_SIZE = 60;
+
+// Write a space-padded header field.
+static void
+WriteField(llvm::raw_ostream& os, StringRef str, unsigned int width)
+{
+    os << str.substr(0, width);
+    os.indent(width - std::min<std::size_t>(str.size(), width));
+}
+
+// Write a member header.  Timestamps and owners are zeroed so the
+// archive only depends on its contents.
+static void
+WriteHeader(llvm::raw_ostream& os,
+            StringRef name,
+            unsigned long size,
+            bool index)
+{
+    std::string size_str;
+    llvm::raw_string_ostream(size_str) << size;
+    WriteField(os, name, 16);
+    WriteField(os, "0", 12);            // date
+    WriteField(os, "0", 6);             // uid
+    WriteField(os, "0", 6);             // gid
+    WriteField(os, index ? "0" : "644", 8);
+    WriteField(os, size_str, 10);
+    os << "`\n";
+}
+
+static void
+WriteBE32(llvm::raw_ostream& os, unsigned long val)
+{
+    os << static_cast<char>((val >> 24) & 0xff)
+       << static_cast<char>((val >> 16) & 0xff)
+       << static_cast<char>((val >> 8) & 0xff)
+       << static_cast<char>(val & 0xff);
+}
+
+static void
+WriteLE32(llvm::raw_ostream& os, unsigned long val)
+{
+    os << static_cast<char>(val & 0xff)
+       << static_cast<char>((val >> 8) & 0xff)
+       << static_cast<char>((val >> 16) & 0xff)
+       << static_cast<char>((val >> 24) & 0xff);
+}
+
+static void
+WriteZeros(llvm::raw_ostream& os, unsigned long n)
+{
+    for (; n > 0; --n)
+        os << '\0';
+}
+
+// Get the length of a BSD member name as stored, NUL-padded so the
+// member contents start 8-byte aligned.
+static unsigned long
+BSDNameLength(unsigned long offset, std::size_t len)
+{
+    unsigned long end = offset + HEADER_SIZE + len;
+    return len + ((8 - (end & 7)) & 7);
+}
+
+void
+ArchiveWriter::Add(StringRef name, const Object& object,
+                   std::vector<char>& image)
+{
+    m_members.push_back(Member());
+    Member& member = m_members.back();
+    member.name = llvm::sys::path::filename(name);
+    member.image.swap(image);
+
+    // Index the symbols a linker could resolve against this member.
+    for (Object::const_symbol_iterator i=object.symbols_begin(),
+         end=object.symbols_end(); i != end; ++i)
+    {
+        int vis = i->getVisibility();
+        if ((vis & Symbol::COMMON) || ((vis & Symbol::GLOBAL) &&
+                                       i->isDefined()))
+            member.symbols.push_back(i->getName());
+    }
+}
+
+void
+ArchiveWriter::Write(llvm::raw_ostream& os) const
+{
+    if (m_format == BSD)
+        WriteBSD(os);
+    else
+        WriteGNU(os);
+}
+
+// System V / GNU layout: the "/" symbol index (big-endian count and member
+// header offsets, then the names), the "//" table of names too long for a
+// header, then the members, each padded to an even size.
+void
+ArchiveWriter::WriteGNU(llvm::raw_ostream& os) const
+{
+    unsigned long nsyms = 0, strsize = 0;
+    std::string long_names;
+    std::vector<std::string> header_names;
+    for (std::deque<Member>::const_iterator i=m_members.begin(),
+         end=m_members.end(); i != end; ++i)
+    {
+        nsyms += i->symbols.size();
+        for (std::vector<std::string>::const_iterator j=i->symbols.begin(),
+             jend=i->symbols.end(); j != jend; ++j)
+            strsize += j->size() + 1;
+
+        // Names are terminated with '/' so they may contain spaces.
+        if (i->name.size() < 16)
+            header_names.push_back(i->name + '/');
+        else
+        {
+            std::string ref;
+            llvm::raw_string_ostream(ref) << '/' << long_names.size();
+            header_names.push_back(ref);
+            long_names += i->name;
+            long_names += "/\n";
+        }
+    }
+
+    unsigned long offset = sizeof(ARMAG)-1;
+    unsigned long index_size = 4 + 4*nsyms + strsize;
+    if (nsyms > 0)
+        offset += HEADER_SIZE + index_size + (index_size & 1);
+    if (!long_names.empty())
+        offset += HEADER_SIZE + long_names.size() + (long_names.size() & 1);
+
+    os << ARMAG;
+    if (nsyms > 0)
+    {
+        WriteHeader(os, "/", index_size, true);
+        WriteBE32(os, nsyms);
+        unsigned long member_offset = offset;
+        for (std::deque<Member>::const_iterator i=m_members.begin(),
+             end=m_members.end(); i != end; ++i)
+        {
+            for (std::size_t j=0; j<i->symbols.size(); ++j)
+                WriteBE32(os, member_offset);
+            unsigned long size = i->image.size();
+            member_offset += HEADER_SIZE + size + (size & 1);
+        }
+        for (std::deque<Member>::const_iterator i=m_members.begin(),
+             end=m_members.end(); i != end; ++i)
+        {
+            for (std::vector<std::string>::const_iterator j=
+                 i->symbols.begin(), jend=i->symbols.end(); j != jend; ++j)
+                os << *j << '\0';
+        }
+        if (index_size & 1)
+            os << '\n';
+    }
+
+    if (!long_names.empty())
+    {
+        WriteHeader(os, "//", long_names.size(), true);
+        os << long_names;
+        if (long_names.size() & 1)
+            os << '\n';
+    }
+
+    std::vector<std::string>::const_iterator name = header_names.begin();
+    for (std::deque<Member>::const_iterator i=m_members.begin(),
+         end=m_members.end(); i != end; ++i, ++name)
+    {
+        unsigned long size = i->image.size();
+        WriteHeader(os, *name, size, false);
+        if (size > 0)
+            os.write(&i->image[0], size);
+        if (size & 1)
+            os << '\n';
+    }
+}
+
+// BSD / Darwin layout: every name is stored after its header ("#1/len"),
+// NUL-padded so member contents are 8-byte aligned as ld64 expects.  The
+// "__.SYMDEF" index holds little-endian (name offset, member header offset)
+// pairs followed by the names.
+void
+ArchiveWriter::WriteBSD(llvm::raw_ostream& os) const
+{
+    static const char SYMDEF[] = "__.SYMDEF";
+
+    unsigned long nsyms = 0, strsize = 0;
+    for (std::deque<Member>::const_iterator i=m_members.begin(),
+         end=m_members.end(); i != end; ++i)
+    {
+        nsyms += i->symbols.size();
+        for (std::vector<std::string>::const_iterator j=i->symbols.begin(),
+             jend=i->symbols.end(); j != jend; ++j)
+            strsize += j->size() + 1;
+    }
+    strsize = (strsize + 3) & ~3UL;
+
+    unsigned long offset = sizeof(ARMAG)-1;
+    unsigned long index_name = BSDNameLength(offset, sizeof(SYMDEF)-1);
+    unsigned long index_size = 4 + 8*nsyms + 4 + strsize;
+    index_size = (index_size + 7) & ~7UL;
+    offset += HEADER_SIZE + index_name + index_size;
+
+    os << ARMAG;
+
+    std::string field;
+    llvm::raw_string_ostream(field) << "#1/" << index_name;
+    WriteHeader(os, field, index_name + index_size, true);
+    os << SYMDEF;
+    WriteZeros(os, index_name - (sizeof(SYMDEF)-1));
+
+    WriteLE32(os, 8*nsyms);
+    unsigned long member_offset = offset, strx = 0;
+    for (std::deque<Member>::const_iterator i=m_members.begin(),
+         end=m_members.end(); i != end; ++i)
+    {
+        for (std::vector<std::string>::const_iterator j=i->symbols.begin(),
+             jend=i->symbols.end(); j != jend; ++j)
+        {
+            WriteLE32(os, strx);
+            WriteLE32(os, member_offset);
+            strx += j->size() + 1;
+        }
+        unsigned long name_len = BSDNameLength(member_offset, i->name.size());
+        unsigned long size = (i->image.size() + 7) & ~7UL;
+        member_offset += HEADER_SIZE + name_len + size;
+    }
+    WriteLE32(os, strsize);
+    for (std::deque<Member>::const_iterator i=m_members.begin(),
+         end=m_members.end(); i != end; ++i)
+    {
+        for (std::vector<std::string>::const_iterator j=i->symbols.begin(),
+             jend=i->symbols.end(); j != jend; ++j)
+            os << *j << '\0';
+    }
+    WriteZeros(os, strsize - strx);
+    WriteZeros(os, index_size - (4 + 8*nsyms + 4 + strsize));
+
+    for (std::deque<Member>::const_iterator i=m_members.begin(),
+         end=m_members.end(); i != end; ++i)
+    {
+        unsigned long name_len = BSDNameLength(offset, i->name.size());
+        unsigned long size = i->image.size();
+        unsigned long padded = (size + 7) & ~7UL;
+        field.clear();
+        llvm::raw_string_ostream(field) << "#1/" << name_len;
+        WriteHeader(os, field, name_len + padded, false);
+        os << i->name;
+        WriteZeros(os, name_len - i->name.size());
+        if (size > 0)
+            os.write(&i->image[0], size);
+        WriteZeros(os, padded - size);
+        offset += HEADER_SIZE + name_len + padded;
+    }
+}
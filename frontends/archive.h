@@ -0,0 +1,90 @@
+#ifndef YASM_ARCHIVE_H
+#define YASM_ARCHIVE_H
+//
+// Static library archive writer header file
+//
+//  Copyright (C) 2026  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/StringRef.h"
+
+
+namespace llvm { class raw_ostream; }
+
+namespace yasm
+{
+
+class Object;
+
+/// Static library ("ar") archive of assembled objects, written in one go
+/// so no intermediate object files are needed.  The archive starts with a
+/// symbol index of the global symbols each member defines, as ranlib would
+/// add, so it can be passed straight to a linker.
+class ArchiveWriter
+{
+public:
+    enum Format
+    {
+        GNU,            ///< System V / GNU (ELF, COFF, etc.)
+        BSD             ///< BSD / Darwin (Mach-O)
+    };
+
+    /// Constructor.
+    /// @param format       archive flavor
+    explicit ArchiveWriter(Format format) : m_format(format) {}
+
+    /// Add a member.  Members are written in the order added.
+    /// @param name         member name (only the last path component is
+    ///                     used)
+    /// @param object       assembled object, for the symbol index
+    /// @param image        object file contents; swapped out, so empty
+    ///                     after the call
+    void Add(llvm::StringRef name, const Object& object,
+             std::vector<char>& image);
+
+    /// Write the archive.
+    /// @param os           output stream
+    void Write(llvm::raw_ostream& os) const;
+
+private:
+    struct Member
+    {
+        std::string name;
+        std::vector<std::string> symbols;
+        std::vector<char> image;
+    };
+
+    void WriteGNU(llvm::raw_ostream& os) const;
+    void WriteBSD(llvm::raw_ostream& os) const;
+
+    Format m_format;
+    std::deque<Member> m_members;   // deque so images are never copied
+};
+
+} // namespace yasm
+
+#endif
@@ -0,0 +1,266 @@
+//
+// Object file cache
+//
+//  Copyright (C) 2026  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//
+// A cache entry consists of two files named by the MD5 digest of the entry
+// key: the object file (.obj) and a manifest (.manifest) listing the MD5
+// digest and path of each source file read while assembling it, and
+// ("-" in place of the digest) each path looked up that didn't exist.  The
+// latter catch a header being added to an include directory searched
+// before the one the header was originally found in.  A piece record
+// (.piece) is named by the digest of the piece key instead; the key holds
+// the piece text, so it needs no manifest.  Entries are written to
+// temporary files and renamed into place, so concurrent runs never see a
+// partial entry.
+//
+#include "cache.h"
+
+#include "config.h"
+
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/system_error.h"
+#include "yasmx/Basic/FileManager.h"
+#include "yasmx/Basic/SourceManager.h"
+#include "yasmx/Support/MD5.h"
+#include "yasmx/Object.h"
+
+
+using namespace yasm;
+
+static const char* MANIFEST_HEADER = "yasm object cache 2";
+
+// Get the MD5 digest of data as a hex string.
+static std::string
+getDigest(StringRef data)
+{
+    static const char hexdigits[] = "0123456789abcdef";
+    unsigned char digest[16];
+    MD5 md5;
+    md5.Update(reinterpret_cast<const unsigned char*>(data.data()),
+               data.size());
+    md5.Final(digest);
+
+    std::string str;
+    for (int i=0; i<16; ++i)
+    {
+        str += hexdigits[digest[i] >> 4];
+        str += hexdigits[digest[i] & 0xf];
+    }
+    return str;
+}
+
+// Write data to path, by way of a temporary file in the cache directory.
+static bool
+WriteEntryFile(StringRef dir, StringRef path, StringRef data)
+{
+    int fd;
+    SmallString<128> tmp_path;
+    if (llvm::sys::fs::unique_file(dir + "/tmp-%%%%%%%%", fd, tmp_path,
+                                   false, 0644))
+        return false;
+    {
+        llvm::raw_fd_ostream os(fd, true);
+        os << data;
+        os.close();
+        if (os.has_error())
+        {
+            os.clear_error();
+            bool existed;
+            llvm::sys::fs::remove(tmp_path.str(), existed);
+            return false;
+        }
+    }
+    if (llvm::sys::fs::rename(tmp_path.str(), path))
+    {
+        bool existed;
+        llvm::sys::fs::remove(tmp_path.str(), existed);
+        return false;
+    }
+    return true;
+}
+
+ObjectCache::ObjectCache(StringRef dir, const std::vector<std::string>& args)
+    : m_dir(dir)
+{
+    bool existed;
+    if (llvm::sys::fs::create_directories(m_dir, existed))
+        m_dir.clear();
+
+    // The output can depend on the working directory (e.g. through
+    // relative include paths or in debugging information) as well as the
+    // options given.
+    SmallString<128> cwd;
+    llvm::sys::fs::current_path(cwd);
+
+    m_key = PACKAGE_VERSION;
+    m_key += '\0';
+    m_key += cwd.str();
+    m_key += '\0';
+    for (std::vector<std::string>::const_iterator i=args.begin(),
+         end=args.end(); i != end; ++i)
+    {
+        m_key += *i;
+        m_key += '\0';
+    }
+}
+
+std::string
+ObjectCache::getEntryPath(StringRef in_filename) const
+{
+    std::string key = m_key;
+    key += in_filename;
+    return m_dir + "/" + getDigest(key);
+}
+
+bool
+ObjectCache::Fetch(StringRef in_filename,
+                   OwningPtr<MemoryBuffer>& obj,
+                   std::vector<std::string>* sources)
+{
+    if (m_dir.empty())
+        return false;
+    std::string entry = getEntryPath(in_filename);
+
+    OwningPtr<MemoryBuffer> manifest;
+    if (MemoryBuffer::getFile(entry + ".manifest", manifest))
+        return false;
+
+    // Check that every source still has the contents it was assembled from,
+    // and that every include search that missed still misses.
+    StringRef rest = manifest->getBuffer();
+    std::pair<StringRef, StringRef> line = rest.split('\n');
+    if (line.first != MANIFEST_HEADER)
+        return false;
+    std::vector<std::string> names;
+    for (rest = line.second; !rest.empty(); rest = line.second)
+    {
+        line = rest.split('\n');
+        std::pair<StringRef, StringRef> fields = line.first.split(' ');
+        if (fields.first == "-")
+        {
+            if (fields.second.empty() || llvm::sys::fs::exists(fields.second))
+                return false;
+            continue;
+        }
+        OwningPtr<MemoryBuffer> source;
+        if (fields.second.empty()
+            || MemoryBuffer::getFile(fields.second, source)
+            || getDigest(source->getBuffer()) != fields.first)
+            return false;
+        names.push_back(fields.second);
+    }
+
+    if (MemoryBuffer::getFile(entry + ".obj", obj, -1, false))
+        return false;
+    if (sources)
+        sources->swap(names);
+    return true;
+}
+
+void
+ObjectCache::Store(StringRef in_filename,
+                   StringRef obj_filename,
+                   SourceManager& source_mgr,
+                   const Object& object)
+{
+    if (m_dir.empty())
+        return;
+
+    // Incbin reads files outside the source manager, so changes to them
+    // can't be detected.
+    if (!object.getInputFiles().empty())
+        return;
+
+    std::string manifest = MANIFEST_HEADER;
+    manifest += '\n';
+    for (SourceManager::fileinfo_iterator i=source_mgr.fileinfo_begin(),
+         end=source_mgr.fileinfo_end(); i != end; ++i)
+    {
+        bool invalid = false;
+        const MemoryBuffer* buf =
+            source_mgr.getMemoryBufferForFile(i->first, &invalid);
+        if (invalid || !buf)
+            return;
+        manifest += getDigest(buf->getBuffer());
+        manifest += ' ';
+        manifest += i->first->getName();
+        manifest += '\n';
+    }
+
+    SmallVector<StringRef, 16> missing;
+    source_mgr.getFileManager().GetNonExistentFiles(missing);
+    for (SmallVectorImpl<StringRef>::const_iterator i=missing.begin(),
+         end=missing.end(); i != end; ++i)
+    {
+        manifest += "- ";
+        manifest += *i;
+        manifest += '\n';
+    }
+
+    OwningPtr<MemoryBuffer> obj;
+    if (MemoryBuffer::getFile(obj_filename, obj, -1, false))
+        return;
+
+    // Write the object first, so a manifest always has an object to go
+    // with it.
+    std::string entry = getEntryPath(in_filename);
+    if (WriteEntryFile(m_dir, entry + ".obj", obj->getBuffer()))
+        WriteEntryFile(m_dir, entry + ".manifest", manifest);
+}
+
+std::string
+ObjectCache::getPieceEntryPath(StringRef key) const
+{
+    std::string entry_key = m_key;
+    entry_key += "piece";
+    entry_key += '\0';
+    entry_key += key;
+    return m_dir + "/" + getDigest(entry_key) + ".piece";
+}
+
+bool
+ObjectCache::FetchPiece(StringRef key, std::string& data)
+{
+    if (m_dir.empty())
+        return false;
+    OwningPtr<MemoryBuffer> piece;
+    if (MemoryBuffer::getFile(getPieceEntryPath(key), piece, -1, false))
+        return false;
+    data = piece->getBuffer();
+    return true;
+}
+
+void
+ObjectCache::StorePiece(StringRef key, StringRef data)
+{
+    if (m_dir.empty())
+        return;
+    WriteEntryFile(m_dir, getPieceEntryPath(key), data);
+}
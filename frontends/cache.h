@@ -0,0 +1,101 @@
+#ifndef YASM_CACHE_H
+#define YASM_CACHE_H
+//
+// Object file cache header file
+//
+//  Copyright (C) 2026  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/StringRef.h"
+#include "yasmx/Assembler.h"
+
+
+namespace llvm { class MemoryBuffer; }
+
+namespace yasm
+{
+
+class Object;
+class SourceManager;
+
+/// Cache of assembled object files, like ccache but built into the
+/// frontend.  An entry is keyed by the yasm version, working directory,
+/// command line, and input filename, and is only used if every source file
+/// read to produce it (the input file and anything it included) still has
+/// the same contents and every file it looked for but didn't find (e.g.
+/// while searching the include path) still doesn't exist.  Cache failures
+/// are never fatal; they just mean the input gets assembled.
+///
+/// Records of the pieces of split parses are kept too, keyed by the same
+/// yasm version, working directory, and command line as well as the piece
+/// key, so a changed source only has its changed pieces parsed in full.
+class ObjectCache : public PieceCache
+{
+public:
+    /// Constructor.
+    /// @param dir          cache directory; created if needed
+    /// @param args         command line
+    ObjectCache(llvm::StringRef dir, const std::vector<std::string>& args);
+
+    /// Look up an object file in the cache.
+    /// @param in_filename  input filename
+    /// @param obj          object file contents (output)
+    /// @param sources      source files the entry was assembled from
+    ///                     (output); may be NULL
+    /// @return True if a valid entry was found.
+    bool Fetch(llvm::StringRef in_filename,
+               llvm::OwningPtr<llvm::MemoryBuffer>& obj,
+               /*@null@*/ std::vector<std::string>* sources = 0);
+
+    /// Add an object file to the cache.  Nothing is stored if the object
+    /// depends on files other than its sources (e.g. through incbin).
+    /// @param in_filename  input filename
+    /// @param obj_filename object filename just written
+    /// @param source_mgr   source manager holding the sources read
+    /// @param object       assembled object
+    void Store(llvm::StringRef in_filename,
+               llvm::StringRef obj_filename,
+               SourceManager& source_mgr,
+               const Object& object);
+
+    virtual bool FetchPiece(llvm::StringRef key, std::string& data);
+    virtual void StorePiece(llvm::StringRef key, llvm::StringRef data);
+
+private:
+    /// Get the cache entry path (without extension) for an input file.
+    std::string getEntryPath(llvm::StringRef in_filename) const;
+
+    /// Get the path of the piece record file for a piece key.
+    std::string getPieceEntryPath(llvm::StringRef key) const;
+
+    std::string m_dir;
+    std::string m_key;      ///< key text common to all entries
+};
+
+} // namespace yasm
+
+#endif
@@ -0,0 +1,385 @@
+//
+// Assembler server (daemon) mode
+//
+//  Copyright (C) 2026  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// A job is sent as a request header (with the client's standard
+// input/output/error file descriptors attached), followed by the
+// NUL-terminated working directory, arguments, and environment strings.
+// The server answers with the job's exit status.  Each job runs in its own
+// process, forked (by way of a monitor process) from the server.
+//
+#include "daemon.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "llvm/Support/raw_ostream.h"
+
+
+extern char** environ;
+
+using namespace yasm;
+
+namespace {
+struct DaemonRequest
+{
+    unsigned int len;       // length of strings following
+    unsigned int argc;      // number of arguments
+    unsigned int envc;      // number of environment strings
+};
+} // anonymous namespace
+
+// Largest request accepted by the server.
+static const unsigned int MAX_REQUEST_LEN = 1<<24;
+
+static bool
+WriteAll(int fd, const char* buf, std::size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool
+ReadAll(int fd, char* buf, std::size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = read(fd, buf, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool
+SetAddr(sockaddr_un* addr, const char* path)
+{
+    std::memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (std::strlen(path) >= sizeof(addr->sun_path))
+        return false;
+    std::strcpy(addr->sun_path, path);
+    return true;
+}
+
+static void
+AppendString(std::vector<char>& buf, const char* str)
+{
+    buf.insert(buf.end(), str, str+std::strlen(str)+1);
+}
+
+bool
+yasm::RunDaemonClient(const char* path, int argc, char* argv[], int* status)
+{
+    sockaddr_un addr;
+    if (!path || *path == '\0' || !SetAddr(&addr, path))
+        return false;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return false;
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    std::vector<char> strings;
+    std::vector<char> cwd(256);
+    while (!getcwd(&cwd[0], cwd.size()))
+    {
+        if (errno != ERANGE)
+        {
+            close(fd);
+            return false;
+        }
+        cwd.resize(cwd.size()*2);
+    }
+    AppendString(strings, &cwd[0]);
+    for (int i=0; i<argc; ++i)
+        AppendString(strings, argv[i]);
+    unsigned int envc = 0;
+    for (char** env = environ; *env; ++env, ++envc)
+        AppendString(strings, *env);
+
+    DaemonRequest req;
+    req.len = strings.size();
+    req.argc = argc;
+    req.envc = envc;
+
+    // Send the request header along with stdin, stdout, and stderr.
+    int fds[3] = {0, 1, 2};
+    char control[CMSG_SPACE(sizeof(fds))];
+    std::memset(control, 0, sizeof(control));
+    iovec iov;
+    iov.iov_base = &req;
+    iov.iov_len = sizeof(req);
+    msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    std::memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    ssize_t n;
+    do {
+        n = sendmsg(fd, &msg, 0);
+    } while (n < 0 && errno == EINTR);
+    if (n != static_cast<ssize_t>(sizeof(req)))
+    {
+        close(fd);
+        return false;
+    }
+
+    // Once the request is sent, the job may already be producing output,
+    // so don't fall back to running locally.
+    int result;
+    if (!WriteAll(fd, &strings[0], strings.size())
+        || !ReadAll(fd, reinterpret_cast<char*>(&result), sizeof(result)))
+    {
+        llvm::errs() << argv[0] << ": lost connection to server '" << path
+                     << "'\n";
+        result = EXIT_FAILURE;
+    }
+    close(fd);
+    *status = result;
+    return true;
+}
+
+// Receive a job request and run it.
+static int
+ServeJob(int conn, DaemonJob job)
+{
+    DaemonRequest req;
+    int fds[3];
+    char control[CMSG_SPACE(sizeof(fds))];
+    iovec iov;
+    iov.iov_base = &req;
+    iov.iov_len = sizeof(req);
+    msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t n;
+    do {
+        n = recvmsg(conn, &msg, 0);
+    } while (n < 0 && errno == EINTR);
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if (n != static_cast<ssize_t>(sizeof(req)) || !cmsg
+        || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS
+        || cmsg->cmsg_len != CMSG_LEN(sizeof(fds))
+        || req.len > MAX_REQUEST_LEN)
+        return EXIT_FAILURE;
+    std::memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+
+    std::vector<char> strings(req.len+1);
+    if (req.len == 0 || !ReadAll(conn, &strings[0], req.len))
+        return EXIT_FAILURE;
+    strings[req.len] = '\0';
+
+    // Split into working directory, arguments, and environment.
+    std::vector<char*> ptrs;
+    for (unsigned int i=0; i<req.len; i += std::strlen(&strings[i])+1)
+        ptrs.push_back(&strings[i]);
+    if (ptrs.size() != 1+static_cast<std::size_t>(req.argc)+req.envc
+        || req.argc == 0)
+        return EXIT_FAILURE;
+    std::vector<char*> args(ptrs.begin()+1, ptrs.begin()+1+req.argc);
+    args.push_back(0);
+    std::vector<char*> envs(ptrs.begin()+1+req.argc, ptrs.end());
+    envs.push_back(0);
+
+    for (int i=0; i<3; ++i)
+    {
+        dup2(fds[i], i);
+        if (fds[i] != i)
+            close(fds[i]);
+    }
+    environ = &envs[0];
+    if (chdir(ptrs[0]) < 0)
+    {
+        llvm::errs() << args[0] << ": could not change to directory '"
+                     << ptrs[0] << "': " << std::strerror(errno) << '\n';
+        return EXIT_FAILURE;
+    }
+
+    int status = job(req.argc, &args[0]);
+    llvm::outs().flush();
+    llvm::errs().flush();
+    return status;
+}
+
+// Run a job in a child process and send its exit status to the client.
+// The status comes from the child's exit, as the job may exit directly
+// (e.g. for --version) or crash.
+static void
+MonitorJob(int conn, DaemonJob job)
+{
+    pid_t pid = fork();
+    if (pid == 0)
+        std::exit(ServeJob(conn, job));
+
+    int status = EXIT_FAILURE;
+    int wstatus;
+    if (pid > 0 && waitpid(pid, &wstatus, 0) == pid && WIFEXITED(wstatus))
+        status = WEXITSTATUS(wstatus);
+    WriteAll(conn, reinterpret_cast<const char*>(&status), sizeof(status));
+}
+
+// Returns true if the process on the other end of conn runs as our user.
+// Jobs run with the client's working directory, arguments and environment,
+// so nobody else may submit them.
+static bool
+IsOwnPeer(int conn)
+{
+#ifdef SO_PEERCRED
+    ucred cred;
+    socklen_t len = sizeof(cred);
+    if (getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0)
+        return false;
+    return cred.uid == getuid();
+#else
+    uid_t uid;
+    gid_t gid;
+    if (getpeereid(conn, &uid, &gid) < 0)
+        return false;
+    return uid == getuid();
+#endif
+}
+
+int
+yasm::RunDaemon(const char* progname, const std::string& path, DaemonJob job)
+{
+    sockaddr_un addr;
+    if (!SetAddr(&addr, path.c_str()))
+    {
+        llvm::errs() << progname << ": socket path '" << path
+                     << "' is too long\n";
+        return EXIT_FAILURE;
+    }
+
+    // Only replace a stale socket; never remove anything else at the path.
+    struct stat st;
+    if (lstat(path.c_str(), &st) == 0)
+    {
+        if (!S_ISSOCK(st.st_mode))
+        {
+            llvm::errs() << progname << ": '" << path
+                         << "' exists and is not a socket\n";
+            return EXIT_FAILURE;
+        }
+        unlink(path.c_str());
+    }
+
+    // Create the socket accessible to our user only (mode 0600).
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    int err = 0;
+    if (fd >= 0)
+    {
+        mode_t old_mask = umask(077);
+        if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+            err = errno;
+        umask(old_mask);
+    }
+    else
+        err = errno;
+    if (err == 0 && listen(fd, SOMAXCONN) < 0)
+        err = errno;
+    if (err != 0)
+    {
+        errno = err;
+        llvm::errs() << progname << ": could not listen on '" << path
+                     << "': " << std::strerror(errno) << '\n';
+        return EXIT_FAILURE;
+    }
+
+    // Job processes are reaped automatically.
+    std::signal(SIGCHLD, SIG_IGN);
+
+    for (;;)
+    {
+        int conn = accept(fd, 0, 0);
+        if (conn < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            llvm::errs() << progname << ": could not accept connection: "
+                         << std::strerror(errno) << '\n';
+            return EXIT_FAILURE;
+        }
+
+        if (!IsOwnPeer(conn))
+        {
+            llvm::errs() << progname
+                         << ": rejected connection from another user\n";
+            close(conn);
+            continue;
+        }
+
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            close(fd);
+            std::signal(SIGCHLD, SIG_DFL);
+            MonitorJob(conn, job);
+            std::exit(EXIT_SUCCESS);
+        }
+        if (pid < 0)
+            llvm::errs() << progname << ": could not start job: "
+                         << std::strerror(errno) << '\n';
+        close(conn);
+    }
+}
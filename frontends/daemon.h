@@ -0,0 +1,59 @@
+#ifndef YASM_DAEMON_H
+#define YASM_DAEMON_H
+//
+// Assembler server (daemon) mode header file
+//
+//  Copyright (C) 2026  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include <string>
+
+
+namespace yasm
+{
+
+/// Assembler job function; same interface as main().
+typedef int (*DaemonJob) (int argc, char* argv[]);
+
+/// Run as a server, accepting jobs on a Unix domain socket until killed.
+/// Each job runs in a process forked from the server, so it starts from the
+/// state initialized before calling this function, and jobs run
+/// concurrently.  The job gets the client's command line, environment,
+/// working directory, and standard input/output/error.
+/// @param progname     program name for error messages
+/// @param path         socket path
+/// @param job          job function
+/// @return Exit status (only returns on error).
+int RunDaemon(const char* progname, const std::string& path, DaemonJob job);
+
+/// Hand a command line to a server started by RunDaemon().
+/// @param path         socket path; may be null
+/// @param argc         argument count
+/// @param argv         arguments
+/// @param status       job exit status (output)
+/// @return False if no server is available at path.
+bool RunDaemonClient(const char* path, int argc, char* argv[], int* status);
+
+} // namespace yasm
+
+#endif
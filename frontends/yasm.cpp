@@ -26,18 +26,27 @@
 //
 #include "config.h"
 
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <deque>
 #include <memory>
 
+#include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Format.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/system_error.h"
+#include "llvm/Support/Timer.h"
 #include "yasmx/Basic/Diagnostic.h"
 #include "yasmx/Basic/FileManager.h"
+#include "yasmx/Basic/FileSystemStatCache.h"
 #include "yasmx/Basic/SourceManager.h"
 #include "yasmx/Frontend/DiagnosticOptions.h"
 #include "yasmx/Frontend/TextDiagnosticPrinter.h"
@@ -46,19 +55,33 @@
 #include "yasmx/Parse/Parser.h"
 #include "yasmx/Parse/Preprocessor.h"
 #include "yasmx/Support/registry.h"
+#include "yasmx/Support/scoped_ptr.h"
+#include "yasmx/Support/Trace.h"
 #include "yasmx/System/plugin.h"
 #include "yasmx/Arch.h"
 #include "yasmx/Assembler.h"
+#include "yasmx/Bytecode.h"
 #include "yasmx/DebugFormat.h"
 #include "yasmx/ListFormat.h"
 #include "yasmx/Module.h"
 #include "yasmx/Object.h"
 #include "yasmx/ObjectFormat.h"
+#include "yasmx/Section.h"
+#include "yasmx/Symbol.h"
 
 #ifdef HAVE_LIBGEN_H
 #include <libgen.h>
 #endif
 
+#include "archive.h"
+#include "cache.h"
+#ifdef HAVE_SYS_UN_H
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "daemon.h"
+#endif
+
 #include "frontends/license.cpp"
 
 
@@ -70,6 +93,15 @@ namespace cl = llvm::cl;
 
 static std::auto_ptr<raw_ostream> errfile;
 
+// command line, for the object cache key
+static std::vector<std::string> command_line;
+
+// object formats to assemble for (from a comma-separated -f list)
+static std::vector<std::string> objfmt_keywords;
+
+// STDIN contents, once read
+static OwningPtr<MemoryBuffer> stdin_buffer;
+
 // version message
 static const char* full_version =
     PACKAGE_NAME " " PACKAGE_INTVER "." PACKAGE_BUILD;
@@ -93,8 +125,8 @@ static cl::extrahelp help_tail(
     "\n"
     "Report bugs to bug-yasm@tortall.net\n");
 
-static cl::opt<std::string> in_filename(cl::Positional,
-    cl::desc("file"));
+static cl::list<std::string> in_filenames(cl::Positional,
+    cl::desc("file..."));
 
 // -a, --arch
 static cl::opt<std::string> arch_keyword("a",
@@ -107,6 +139,32 @@ static cl::alias arch_keyword_long("arch",
     cl::value_desc("arch"),
     cl::aliasopt(arch_keyword));
 
+// --branch-align
+static cl::opt<unsigned int> branch_align("branch-align",
+    cl::desc("pad jumps to not cross or end at <boundary>-byte boundaries"),
+    cl::value_desc("boundary"),
+    cl::init(0));
+
+// --cache-dir
+static cl::opt<std::string> cache_dir("cache-dir",
+    cl::desc("Cache object files in <dir> (default $YASM_CACHE_DIR)"),
+    cl::value_desc("dir"));
+
+// --compress-debug-sections
+static cl::opt<Object::Compression> compress_debug_sections(
+    "compress-debug-sections",
+    cl::desc("Compress DWARF debug sections (ELF only):"),
+    cl::init(Object::COMPRESS_NONE),
+    cl::values(
+        clEnumValN(Object::COMPRESS_ZLIB, "", "zlib (default)"),
+        clEnumValN(Object::COMPRESS_NONE, "none", "no compression"),
+        clEnumValN(Object::COMPRESS_ZLIB, "zlib", "zlib"),
+        clEnumValN(Object::COMPRESS_ZLIB, "zlib-gabi", "zlib"),
+        clEnumValN(Object::COMPRESS_ZSTD, "zstd", "zstd"),
+        clEnumValEnd),
+    cl::ValueOptional,
+    cl::ZeroOrMore);
+
 // -D, -d
 static cl::list<std::string> predefine_macros("D",
     cl::desc("Pre-define a macro, optionally to value"),
@@ -117,10 +175,16 @@ static cl::alias predefine_macros_alias("d",
     cl::value_desc("macro[=value]"),
     cl::aliasopt(predefine_macros));
 
-#ifdef WITH_XML
+#ifdef HAVE_SYS_UN_H
+// --daemon
+static cl::opt<std::string> daemon_socket("daemon",
+    cl::desc("Run as a server accepting jobs on <socket> (see YASM_SERVER)"),
+    cl::value_desc("socket"));
+#endif
+
 // -dump-object
 static cl::opt<Assembler::ObjectDumpTime> dump_object("dump-object",
-    cl::desc("Dump object in XML after this phase:"),
+    cl::desc("Dump object after this phase:"),
     cl::values(
         clEnumValN(Assembler::DUMP_NEVER, "never", "never dump"),
         clEnumValN(Assembler::DUMP_AFTER_PARSE, "parsed",
@@ -132,8 +196,20 @@ static cl::opt<Assembler::ObjectDumpTime> dump_object("dump-object",
         clEnumValN(Assembler::DUMP_AFTER_OUTPUT, "output",
                    "after output"),
         clEnumValEnd));
+
+// -dump-format
+static cl::opt<Assembler::ObjectDumpFormat> dump_format("dump-format",
+    cl::desc("Format of object dump:"),
+    cl::values(
+#ifdef WITH_XML
+        clEnumValN(Assembler::DUMP_XML, "xml", "XML document"),
+#endif // WITH_XML
+        clEnumValN(Assembler::DUMP_JSON, "json", "JSON lines"),
+        clEnumValEnd),
+#ifdef WITH_XML
+    cl::init(Assembler::DUMP_XML));
 #else
-Assembler::ObjectDumpTime dump_object = Assembler::DUMP_NEVER;
+    cl::init(Assembler::DUMP_JSON));
 #endif // WITH_XML
 
 // -E
@@ -151,6 +227,10 @@ static cl::alias preproc_only_long("preproc-only",
     cl::desc("Alias for -e"),
     cl::aliasopt(preproc_only));
 
+// --explain-relax
+static cl::opt<bool> explain_relax("explain-relax",
+    cl::desc("Report why each jump took its long form"));
+
 // --execstack, --noexecstack
 static cl::list<bool> execstack("execstack",
     cl::desc("require executable stack for this object"));
@@ -159,7 +239,8 @@ static cl::list<bool> noexecstack("noexecstack",
 
 // -f, --oformat
 static cl::opt<std::string> objfmt_keyword("f",
-    cl::desc("Select object format (list with -f help)"),
+    cl::desc("Select object format, or a comma-separated list of formats "
+             "(list with -f help)"),
     cl::value_desc("format"),
     cl::Prefix,
     cl::ZeroOrMore);
@@ -179,6 +260,17 @@ static cl::alias dbgfmt_keyword_long("dformat",
     cl::value_desc("debug"),
     cl::aliasopt(dbgfmt_keyword));
 
+// --diag-repeat-limit
+static cl::opt<unsigned int> diag_repeat_limit("diag-repeat-limit",
+    cl::desc("Show at most <n> of each kind of error/warning message, "
+             "then summarize (0 = no limit)"),
+    cl::value_desc("n"),
+    cl::init(0));
+
+// --fast-exit
+static cl::opt<bool> fast_exit("fast-exit",
+    cl::desc("Exit without freeing memory once output is written"));
+
 // --force-strict
 static cl::opt<bool> force_strict("force-strict",
     cl::desc("treat all sized operands as if `strict' was used"));
@@ -198,6 +290,21 @@ static cl::alias include_paths_alias("i",
     cl::aliasopt(include_paths),
     cl::Prefix);
 
+// --isa-note
+static cl::opt<bool> isa_note("isa-note",
+    cl::desc("Record CPU features used in a .note.yasm.isa section"));
+
+// -j, --jobs
+static cl::opt<unsigned int> num_jobs("j",
+    cl::desc("Use up to N threads (0 for one per processor)"),
+    cl::value_desc("N"),
+    cl::Prefix,
+    cl::init(1));
+static cl::alias num_jobs_long("jobs",
+    cl::desc("Alias for -j"),
+    cl::value_desc("N"),
+    cl::aliasopt(num_jobs));
+
 // -L, --lformat
 static cl::opt<std::string> listfmt_keyword("L",
     cl::desc("Select list format (list with -L help)"),
@@ -223,10 +330,52 @@ static cl::alias list_filename_long("list",
     cl::value_desc("listfile"),
     cl::aliasopt(list_filename));
 
+// --list-costs
+static cl::opt<std::string> list_costs("list-costs",
+    cl::desc("List instruction cost estimates for a processor model"),
+    cl::value_desc("model"));
+
+// --load-relax
+static cl::opt<std::string> load_relax_file("load-relax",
+    cl::desc("Start optimizing from the jump sizes recorded in <file>"),
+    cl::value_desc("file"));
+
+// --keep-unchanged
+static cl::opt<bool> keep_unchanged("keep-unchanged",
+    cl::desc("don't rewrite the object file if its contents are unchanged"));
+
+// --merge
+static cl::opt<bool> merge_objects("merge",
+    cl::desc("Merge the objects of multiple input files into one object"));
+
+// --merge-sections
+static cl::opt<bool> merge_sections("merge-sections",
+    cl::desc("remove duplicate entries from mergeable sections"));
+
+// --no-relax-relocations
+static cl::opt<bool> no_relax_relocations("no-relax-relocations",
+    cl::desc("don't use relocations the linker may relax (e.g. GOTPCRELX)"));
+
+// --pack-relative-relocs
+static cl::opt<bool> pack_relative_relocs("pack-relative-relocs",
+    cl::desc("pack section-relative address relocations into RELR sections"));
+
 // -M
 static cl::opt<bool> generate_make_dependencies("M",
     cl::desc("generate Makefile dependencies on stdout"));
 
+// -MD, -MF, -MT
+static cl::opt<bool> dependency_file_output("MD",
+    cl::desc("write Makefile dependencies to a file while assembling"));
+static cl::opt<std::string> dependency_filename("MF",
+    cl::desc("Name of -MD dependency file (default object file with .d)"),
+    cl::value_desc("file"),
+    cl::Prefix);
+static cl::opt<std::string> dependency_target("MT",
+    cl::desc("Target of -MD dependency rule (default object file)"),
+    cl::value_desc("target"),
+    cl::Prefix);
+
 // -m, --machine
 static cl::opt<std::string> machine_name("m",
     cl::desc("Select machine (list with -m help)"),
@@ -239,8 +388,9 @@ static cl::alias machine_name_long("machine",
     cl::aliasopt(machine_name));
 
 // -O, -Onnn
-static cl::opt<int> optimize_level("O",
-    cl::desc("Set optimization level (ignored)"),
+static cl::opt<std::string> optimize_level("O",
+    cl::desc("Set optimization level (0: long jumps, 1: limited jump "
+             "optimization, x: use shortest instruction forms)"),
     cl::value_desc("level"),
     cl::ValueOptional,
     cl::ZeroOrMore,
@@ -286,11 +436,57 @@ static cl::alias parser_keyword_long("parser",
     cl::value_desc("parser"),
     cl::aliasopt(parser_keyword));
 
+// --report-isa
+static cl::opt<bool> report_isa("report-isa",
+    cl::desc("Report CPU features used by the instructions in each section"));
+
+// --save-relax
+static cl::opt<std::string> save_relax_file("save-relax",
+    cl::desc("Record the jump sizes chosen by the optimizer in <file>"),
+    cl::value_desc("file"));
+
 // -s
 static cl::opt<bool> error_stdout("s",
     cl::desc("redirect error messages to stdout"),
     cl::ZeroOrMore);
 
+// --size-report
+static cl::opt<bool> size_report("size-report",
+    cl::desc("Report the code size and layout of each label"));
+
+// --split-dwarf-file
+static cl::opt<std::string> split_dwarf_file("split-dwarf-file",
+    cl::desc("Write split DWARF debug information to file (-g dwarf5)"),
+    cl::value_desc("filename"));
+
+// --split-parse
+static cl::opt<bool> split_parse("split-parse",
+    cl::desc("Parse independent pieces of GAS source on -j threads"));
+
+// --stat-cache
+static cl::opt<std::string> stat_cache_filename("stat-cache",
+    cl::desc("Remember missing include files in <file> across runs "
+             "(default $YASM_STAT_CACHE)"),
+    cl::value_desc("file"));
+
+// --symbol-ordering-file
+static cl::opt<std::string> symbol_ordering_file("symbol-ordering-file",
+    cl::desc("Place functions listed in <file> in hot/cold sections (ELF)"),
+    cl::value_desc("file"));
+
+// --thread-jumps
+static cl::opt<bool> thread_jumps("thread-jumps",
+    cl::desc("retarget jumps to jumps to their final destination"));
+
+// --time-report
+static cl::opt<bool> time_report("time-report",
+    cl::desc("Report time spent in each assembly phase, and statistics"));
+
+// --trace
+static cl::opt<std::string> trace_filename("trace",
+    cl::desc("Write a Chrome trace of assembly phases to <file>"),
+    cl::value_desc("file"));
+
 // -U, -u
 static cl::list<std::string> undefine_macros("U",
     cl::desc("Undefine a macro"),
@@ -519,6 +715,26 @@ ConfigureObject(Object& object)
         else
             break; // we're done with the list
     }
+
+    // -O0 and -O1 reduce the effort spent on jump sizes; anything else
+    // (including no -O) optimizes them fully.
+    if (optimize_level == "0")
+        config.OptimizeLevel = Object::OPTIMIZE_NONE;
+    else if (optimize_level == "1")
+        config.OptimizeLevel = Object::OPTIMIZE_BASIC;
+    else
+        config.OptimizeLevel = Object::OPTIMIZE_FULL;
+
+    config.SplitDwarfFile = split_dwarf_file;
+    config.CompressDebugSections = compress_debug_sections;
+    config.MergeSections = merge_sections;
+    config.RelaxRelocations = !no_relax_relocations;
+    config.PackRelativeRelocs = pack_relative_relocs;
+    config.SymbolOrderingFile = symbol_ordering_file;
+    config.SaveRelaxFile = save_relax_file;
+    config.LoadRelaxFile = load_relax_file;
+    config.ExplainRelax = explain_relax;
+    object.setMarkLayout(size_report);
 }
 
 static void
@@ -581,136 +797,710 @@ ApplyPreprocessorSavedOptions(Preprocessor& preproc)
     }
 }
 
-#if 0
+// Append a filename to a dependency rule, escaped for make.
+static void
+AppendDependency(std::string& rule, std::string::size_type* linelen,
+                 StringRef filename)
+{
+    std::string escaped;
+    for (StringRef::iterator i=filename.begin(), end=filename.end();
+         i != end; ++i)
+    {
+        if (*i == ' ' || *i == '#')
+            escaped += '\\';
+        else if (*i == '$')
+            escaped += '$';
+        escaped += *i;
+    }
+
+    if (*linelen + 1 + escaped.size() > 72)
+    {
+        rule += " \\\n ";
+        *linelen = 1;
+    }
+    rule += ' ';
+    rule += escaped;
+    *linelen += 1 + escaped.size();
+}
+
+// Write the -MD dependency file for an assembled object.  The main file
+// comes first, then included files and other inputs in the order read.
+static bool
+WriteDependencyFile(StringRef obj_filename,
+                    const std::vector<std::string>& deps,
+                    DiagnosticsEngine& diags)
+{
+    SmallString<128> dep_filename(dependency_filename);
+    if (dep_filename.empty())
+    {
+        dep_filename = obj_filename;
+        llvm::sys::path::replace_extension(dep_filename, "d");
+    }
+
+    std::string rule =
+        dependency_target.empty() ? obj_filename.str() : dependency_target;
+    rule += ':';
+    std::string::size_type linelen = rule.size();
+    for (std::vector<std::string>::const_iterator i=deps.begin(),
+         end=deps.end(); i != end; ++i)
+        AppendDependency(rule, &linelen, *i);
+    rule += '\n';
+
+    std::string err;
+    raw_fd_ostream out(dep_filename.c_str(), err);
+    if (!err.empty())
+    {
+        diags.Report(SourceLocation(), diag::err_cannot_open_file)
+            << dep_filename.str() << err;
+        return false;
+    }
+    out << rule;
+    return true;
+}
+
+namespace {
+struct FileEntryUIDLess
+{
+    bool operator() (const FileEntry* a, const FileEntry* b) const
+    { return a->getUID() < b->getUID(); }
+};
+} // anonymous namespace
+
+// Get the files an assembled object depends on, for -MD.
+static void
+GetDependencies(SourceManager& source_mgr,
+                const Object& object,
+                std::vector<std::string>* deps)
+{
+    // The parser may have already discarded its file IDs, so use the
+    // files the source manager has read, in the order they were opened.
+    std::vector<const FileEntry*> files;
+    for (SourceManager::fileinfo_iterator i=source_mgr.fileinfo_begin(),
+         end=source_mgr.fileinfo_end(); i != end; ++i)
+        files.push_back(i->first);
+    std::sort(files.begin(), files.end(), FileEntryUIDLess());
+    for (std::vector<const FileEntry*>::const_iterator i=files.begin(),
+         end=files.end(); i != end; ++i)
+        deps->push_back((*i)->getName());
+    deps->insert(deps->end(), object.getInputFiles().begin(),
+                 object.getInputFiles().end());
+}
+
+// Read STDIN.  It's only read once, as it's assembled once for each
+// object format.
+static bool
+ReadStdin(DiagnosticsEngine& diags)
+{
+    if (stdin_buffer)
+        return true;
+    if (llvm::error_code err = MemoryBuffer::getSTDIN(stdin_buffer))
+    {
+        diags.Report(SourceLocation(), diag::fatal_file_open)
+            << "-" << err.message();
+        return false;
+    }
+    return true;
+}
+
+// Open the input file, or STDIN (for filename of "-"), as the main file.
+static bool
+OpenMainFile(SourceManager& source_mgr,
+             DiagnosticsEngine& diags,
+             const std::string& in_filename)
+{
+    if (in_filename == "-")
+    {
+        if (!ReadStdin(diags))
+            return false;
+        source_mgr.createMainFileIDForMemBuffer(
+            MemoryBuffer::getMemBuffer(stdin_buffer->getBuffer(),
+                                       stdin_buffer->getBufferIdentifier()));
+    }
+    else
+    {
+        const FileEntry* in =
+            source_mgr.getFileManager().getFile(in_filename);
+        if (!in)
+        {
+            diags.Report(SourceLocation(), diag::fatal_file_open)
+                << in_filename;
+            return false;
+        }
+        source_mgr.createMainFileID(in);
+    }
+    return true;
+}
+
+// Set up header search paths from the command line.
+static void
+SetIncludePaths(HeaderSearch& headers, FileManager& file_mgr)
+{
+    std::vector<DirectoryLookup> dirs;
+    for (std::vector<std::string>::iterator i = include_paths.begin(),
+         end = include_paths.end(); i != end; ++i)
+    {
+        dirs.push_back(DirectoryLookup(file_mgr.getDirectory(*i), true));
+    }
+    headers.SetSearchPaths(dirs, 0, false);
+}
+
+// preprocess a single input file, without assembling it
 static int
-do_preproc_only(void)
+do_preproc_only(SourceManager& source_mgr, DiagnosticsEngine& diags)
 {
-    yasm_linemap *linemap;
-    char *preproc_buf = yasm_xmalloc(PREPROC_BUF_SIZE);
-    size_t got;
-    const char *base_filename;
-    FILE *out = NULL;
-    yasm_errwarns *errwarns = yasm_errwarns_create();
+    // Apply warning settings
+    ApplyWarningSettings(diags);
 
-    /* Initialize line map */
-    linemap = yasm_linemap_create();
-    yasm_linemap_set(linemap, in_filename, 1, 1);
+    if (in_filenames.size() > 1)
+    {
+        diags.Report(diag::fatal_multiple_inputs) << "-e";
+        return EXIT_FAILURE;
+    }
 
-    /* Default output to stdout if not specified or generating dependency
-       makefiles */
-    if (!obj_filename || generate_make_dependencies)
+    // Only the parser is needed; there's no object or architecture.
+    std::auto_ptr<ParserModule> parser_module =
+        LoadModule<ParserModule>(parser_keyword);
+    if (parser_module.get() == 0)
     {
-        out = stdout;
+        diags.Report(SourceLocation(), diag::fatal_module_load)
+            << "parser" << parser_keyword;
+        return EXIT_FAILURE;
+    }
 
-        /* determine the object filename if not specified, but we need a
-            file name for the makefile rule */
-        if (generate_make_dependencies && !obj_filename)
+    FileManager& file_mgr = source_mgr.getFileManager();
+    HeaderSearch headers(file_mgr);
+    SetIncludePaths(headers, file_mgr);
+    if (!OpenMainFile(source_mgr, diags, in_filenames.front()))
+        return EXIT_FAILURE;
+
+    std::auto_ptr<Parser> parser =
+        parser_module->Create(diags, source_mgr, headers);
+    ApplyPreprocessorBuiltins(parser->getPreprocessor());
+    ApplyPreprocessorSavedOptions(parser->getPreprocessor());
+    if (diags.hasErrorOccurred())
+        return EXIT_FAILURE;
+
+    // Output to stdout if no output file was specified.
+    OwningPtr<raw_fd_ostream> out_file;
+    raw_ostream* out = &llvm::outs();
+    if (!obj_filename.empty())
+    {
+        std::string err;
+        out_file.reset(new raw_fd_ostream(obj_filename.c_str(), err));
+        if (!err.empty())
+        {
+            diags.Report(SourceLocation(), diag::err_cannot_open_file)
+                << obj_filename << err;
+            return EXIT_FAILURE;
+        }
+        out = out_file.get();
+    }
+    // The output is written a line at a time; buffer plenty of it.
+    out->SetBufferSize(256*1024);
+
+    diags.getClient()->BeginSourceFile();
+    bool ok = parser->Preprocess(*out, diags);
+    diags.getClient()->EndSourceFile();
+    out->flush();
+
+    if (!ok || diags.hasErrorOccurred())
+    {
+        if (out_file)
+        {
+            out_file->close();
+            remove(obj_filename.c_str());
+        }
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+// print the CPU features used by the instructions in each section
+static void
+ReportFeatureUsage(Assembler& assembler, StringRef in_filename)
+{
+    Arch::FeatureUsage usage;
+    Object& object = *assembler.getObject();
+    for (Object::section_iterator sect=object.sections_begin(),
+         end=object.sections_end(); sect != end; ++sect)
+    {
+        unsigned long insns =
+            assembler.getArch()->getFeatureUsage(*sect, &usage);
+        if (insns == 0)
+            continue;
+        llvm::errs() << in_filename << ": " << sect->getName() << ": "
+                     << insns << " instructions";
+        for (Arch::FeatureUsage::const_iterator i=usage.begin(),
+             endi=usage.end(); i != endi; ++i)
+            llvm::errs() << ' ' << i->first << '=' << i->second;
+        llvm::errs() << '\n';
+    }
+}
+
+// Code between one label and the next, for the size report.
+struct SymbolLayout
+{
+    const Section* sect;
+    unsigned int sect_num;
+    StringRef name;
+    uint64_t begin, end;
+    unsigned long insns;        // instructions starting in the range
+    unsigned long long_forms;   // jumps etc. given their longest form
+    uint64_t padding;           // alignment padding just before begin
+
+    uint64_t getSize() const { return end - begin; }
+};
+
+static bool
+SymbolLayoutBegin(const SymbolLayout& a, const SymbolLayout& b)
+{
+    return a.begin < b.begin;
+}
+
+// largest first; ties in section and offset order
+static bool
+SymbolLayoutLarger(const SymbolLayout& a, const SymbolLayout& b)
+{
+    if (a.getSize() != b.getSize())
+        return a.getSize() > b.getSize();
+    if (a.sect_num != b.sect_num)
+        return a.sect_num < b.sect_num;
+    return a.begin < b.begin;
+}
+
+// find the range an offset in the section falls in; null if it's before
+// the first label
+static SymbolLayout*
+FindSymbolLayout(std::vector<SymbolLayout>& layouts, uint64_t offset)
+{
+    SymbolLayout key;
+    key.begin = offset;
+    std::vector<SymbolLayout>::iterator i =
+        std::upper_bound(layouts.begin(), layouts.end(), key,
+                         SymbolLayoutBegin);
+    if (i == layouts.begin())
+        return 0;
+    return &*--i;
+}
+
+// print the size, instruction count, long jumps, and leading alignment
+// padding of the code from each label to the next, largest first
+static void
+ReportSymbolSizes(Object& object, StringRef in_filename)
+{
+    std::vector<SymbolLayout> all;
+    const std::vector<SymbolRef>& labels = object.getLayoutLabels();
+    unsigned int sect_num = 0;
+    for (Object::section_iterator sect=object.sections_begin(),
+         end=object.sections_end(); sect != end; ++sect, ++sect_num)
+    {
+        if (sect->bytecodes_begin() == sect->bytecodes_end())
+            continue;
+
+        std::vector<SymbolLayout> layouts;
+        for (std::vector<SymbolRef>::const_iterator i=labels.begin(),
+             endi=labels.end(); i != endi; ++i)
         {
-            if (in_filename == NULL)
-                /* Default to yasm.out if no obj filename specified */
-                obj_filename = yasm__xstrdup("yasm.out");
-            else
+            Location loc;
+            // .L labels are local to the assembler by convention.
+            if (!(*i)->getLabel(&loc) ||
+                loc.bc->getContainer() != &*sect ||
+                StringRef((*i)->getName()).startswith(".L"))
+                continue;
+            SymbolLayout layout;
+            layout.sect = &*sect;
+            layout.sect_num = sect_num;
+            layout.name = (*i)->getName();
+            layout.begin = loc.getOffset();
+            layout.insns = 0;
+            layout.long_forms = 0;
+            layout.padding = 0;
+            layouts.push_back(layout);
+        }
+        if (layouts.empty())
+            continue;
+
+        // Each range ends at the next label or the end of the section.
+        std::stable_sort(layouts.begin(), layouts.end(), SymbolLayoutBegin);
+        for (std::size_t i=0; i+1<layouts.size(); ++i)
+            layouts[i].end = layouts[i+1].begin;
+        layouts.back().end = sect->bytecodes_back().getNextOffset();
+
+        for (BytecodeContainer::const_insn_iterator i=sect->insns_begin(),
+             endi=sect->insns_end(); i != endi; ++i)
+        {
+            SymbolLayout* layout = FindSymbolLayout(layouts, i->getOffset());
+            if (layout)
+                ++layout->insns;
+        }
+
+        // Padding before a label is the tail of the alignment bytecodes
+        // (and nothing else) immediately preceding it.
+        std::vector<SymbolLayout>::iterator next = layouts.begin();
+        uint64_t padding = 0;
+        for (Section::const_bc_iterator bc=sect->bytecodes_begin(),
+             endbc=sect->bytecodes_end(); bc != endbc; ++bc)
+        {
+            for (; next != layouts.end() && next->begin <= bc->getOffset();
+                 ++next)
+                next->padding = padding;
+            if (bc->getFixedLen() > 0)
             {
-                /* replace (or add) extension to base filename */
-                yasm__splitpath(in_filename, &base_filename);
-                if (base_filename[0] == '\0')
-                    obj_filename = yasm__xstrdup("yasm.out");
-                else
-                    obj_filename = replace_extension(base_filename,
-                        cur_objfmt_module->extension, "yasm.out");
+                padding = 0;
+                for (; next != layouts.end() &&
+                     next->begin <= bc->getTailOffset(); ++next)
+                    next->padding = 0;
+            }
+            if (bc->getSpecial() == Bytecode::Contents::SPECIAL_OFFSET)
+                padding += bc->getTailLen();
+            else if (bc->getTailLen() > 0)
+                padding = 0;
+
+            if (object.isLongForm(*bc))
+            {
+                if (SymbolLayout* layout =
+                    FindSymbolLayout(layouts, bc->getTailOffset()))
+                    ++layout->long_forms;
             }
         }
+        for (; next != layouts.end(); ++next)
+            next->padding = padding;
+
+        all.insert(all.end(), layouts.begin(), layouts.end());
     }
-    else
+
+    std::stable_sort(all.begin(), all.end(), SymbolLayoutLarger);
+    for (std::vector<SymbolLayout>::const_iterator i=all.begin(),
+         end=all.end(); i != end; ++i)
+    {
+        llvm::errs() << in_filename << ": " << i->sect->getName() << ": "
+                     << i->name << ": " << i->getSize() << " bytes at "
+                     << llvm::format("0x%llx", (unsigned long long)i->begin)
+                     << ", " << i->insns << " instructions, "
+                     << i->long_forms << " long jumps, "
+                     << i->padding << " bytes padding before\n";
+    }
+}
+
+// Objects being combined into one output file.
+struct CombinedOutput
+{
+    explicit CombinedOutput(ArchiveWriter* archive_) : archive(archive_) {}
+
+    ArchiveWriter* archive;                 // static library; if null,
+    std::deque<std::vector<char> > images;  // objects to merge
+    std::vector<std::string> deps;          // dependencies of all inputs
+};
+
+// assemble a single input file
+static int
+assemble_file(Assembler& assembler,
+              SourceManager& source_mgr,
+              DiagnosticsEngine& diags,
+              HeaderSearch& headers,
+              ObjectCache* cache,
+              const std::string& in_filename,
+              StringRef out_dir,
+              CombinedOutput* combined = 0)
+{
+    if (!OpenMainFile(source_mgr, diags, in_filename))
+        return EXIT_FAILURE;
+
+    // initialize the object.
+    if (!assembler.InitObject(source_mgr, diags))
+        return EXIT_FAILURE;
+
+    // Place the default-named object file in the output directory.
+    if (!out_dir.empty())
     {
-        /* Open output (object) file */
-        out = open_file(obj_filename, "wt");
-        if (!out)
+        SmallString<128> path(out_dir);
+        llvm::sys::path::append(path, assembler.getObjectFilename());
+        assembler.setObjectFilename(path);
+        assembler.getObject()->setObjectFilename(path);
+    }
+
+    // The input can't be cached if it's read from STDIN, and the cache
+    // doesn't keep listings, feature usage, relax or size reports, or
+    // combined objects.
+    if (in_filename == "-" || !list_filename.empty() || report_isa ||
+        isa_note || explain_relax || size_report || combined)
+        cache = 0;
+    std::vector<std::string> deps;
+    OwningPtr<MemoryBuffer> cached;
+    if (cache && cache->Fetch(in_filename, cached,
+                              dependency_file_output ? &deps : 0))
+    {
+        if (keep_unchanged)
         {
-            PrintError(String::Compose(_("could not open file `%1'"), filename));
-            yasm_xfree(preproc_buf);
-            return EXIT_FAILURE;
+            if (!assembler.WriteObjectIfChanged(cached->getBuffer(), diags))
+                return EXIT_FAILURE;
+        }
+        else
+        {
+            std::string err;
+            raw_fd_ostream out(assembler.getObjectFilename().str().c_str(),
+                               err, raw_fd_ostream::F_Binary);
+            if (!err.empty())
+            {
+                diags.Report(SourceLocation(), diag::err_cannot_open_file)
+                    << assembler.getObjectFilename() << err;
+                return EXIT_FAILURE;
+            }
+            out << cached->getBuffer();
+            out.close();
+            if (out.has_error())
+            {
+                diags.Report(SourceLocation(), diag::err_file_output_write);
+                out.clear_error();
+                return EXIT_FAILURE;
+            }
         }
+        if (dependency_file_output &&
+            !WriteDependencyFile(assembler.getObjectFilename(), deps, diags))
+            return EXIT_FAILURE;
+        return EXIT_SUCCESS;
     }
 
-    /* Pre-process until done */
-    cur_preproc = yasm_preproc_create(cur_preproc_module, in_filename,
-                                      linemap, errwarns);
+    // Configure object per command line parameters.
+    ConfigureObject(*assembler.getObject());
+
+    // Objects to be merged are compressed (if at all) once merged.
+    if (combined && !combined->archive)
+        assembler.getObject()->getConfig().CompressDebugSections =
+            Object::COMPRESS_NONE;
 
-    apply_preproc_builtins();
-    apply_preproc_saved_options();
+    // initialize the parser.
+    Parser& parser = assembler.InitParser(source_mgr, diags, headers);
+    ApplyPreprocessorBuiltins(parser.getPreprocessor());
+    ApplyPreprocessorSavedOptions(parser.getPreprocessor());
+    if (diags.hasErrorOccurred())
+        return EXIT_FAILURE;
 
-    if (generate_make_dependencies)
+    // assemble the input.
+    if (!assembler.Assemble(source_mgr, diags))
     {
-        size_t totlen;
+        // An error occurred during assembly.
+        return EXIT_FAILURE;
+    }
 
-        fprintf(stdout, "%s: %s", obj_filename, in_filename);
-        totlen = strlen(obj_filename)+2+strlen(in_filename);
+    // The reports below go straight to stderr; get the diagnostics out first.
+    errfile->flush();
+    if (report_isa)
+        ReportFeatureUsage(assembler, in_filename);
+    if (explain_relax)
+        llvm::errs() << assembler.getObject()->getRelaxReport();
+    if (size_report)
+        ReportSymbolSizes(*assembler.getObject(), in_filename);
+    if (isa_note)
+        assembler.AddFeatureNote(diags);
+
+    // open the list file; the listing is written along with the object
+    std::string err;
+    raw_ostream* list_os = 0;
+    OwningPtr<raw_fd_ostream> list_file;
+    if (!list_filename.empty())
+    {
+        list_file.reset(new raw_fd_ostream(list_filename.c_str(), err));
+        if (!err.empty())
+        {
+            diags.Report(SourceLocation(), diag::err_cannot_open_file)
+                << list_filename << err;
+            return EXIT_FAILURE;
+        }
+        list_os = list_file.get();
+    }
 
-        while ((got = yasm_preproc_get_included_file(cur_preproc, preproc_buf,
-                                                     PREPROC_BUF_SIZE)) != 0)
+    if (combined)
+    {
+        // Keep the object in memory for the archive or merge.
+        std::vector<char> image;
+        if (!assembler.Output(image, diags, list_os))
+            return EXIT_FAILURE;
+        if (combined->archive)
+            combined->archive->Add(assembler.getObjectFilename(),
+                                   *assembler.getObject(), image);
+        else
         {
-            totlen += got;
-            if (totlen > 72)
+            combined->images.push_back(std::vector<char>());
+            combined->images.back().swap(image);
+        }
+        if (dependency_file_output)
+        {
+            GetDependencies(source_mgr, *assembler.getObject(), &deps);
+            for (std::vector<std::string>::const_iterator i=deps.begin(),
+                 end=deps.end(); i != end; ++i)
             {
-                fputs(" \\\n  ", stdout);
-                totlen = 2;
+                if (std::find(combined->deps.begin(), combined->deps.end(),
+                              *i) == combined->deps.end())
+                    combined->deps.push_back(*i);
             }
-            fputc(' ', stdout);
-            fwrite(preproc_buf, got, 1, stdout);
         }
-        fputc('\n', stdout);
+        return EXIT_SUCCESS;
+    }
+    else if (keep_unchanged)
+    {
+        if (!assembler.OutputIfChanged(diags, list_os))
+        {
+            remove(assembler.getObjectFilename().str().c_str());
+            return EXIT_FAILURE;
+        }
     }
     else
     {
-        while ((got = yasm_preproc_input(cur_preproc, preproc_buf,
-                                         PREPROC_BUF_SIZE)) != 0)
-            fwrite(preproc_buf, got, 1, out);
+        // open the object file for output
+        raw_fd_ostream out(assembler.getObjectFilename().str().c_str(),
+                           err, raw_fd_ostream::F_Binary);
+        if (!err.empty())
+        {
+            diags.Report(SourceLocation(), diag::err_cannot_open_file)
+                << assembler.getObjectFilename() << err;
+            return EXIT_FAILURE;
+        }
+
+        if (!assembler.Output(out, diags, list_os))
+        {
+            // An error occurred during output.
+            // If we had an error at this point, we also need to delete the
+            // output object file (to make sure it's not left newer than the
+            // source).
+            out.close();
+            remove(assembler.getObjectFilename().str().c_str());
+            return EXIT_FAILURE;
+        }
+
+        // close object file
+        out.close();
     }
 
-    if (out != stdout)
-        fclose(out);
+    // Warnings aren't kept in the cache, so only cache warning-free output.
+    if (cache && diags.getNumWarnings() == 0)
+        cache->Store(in_filename, assembler.getObjectFilename(), source_mgr,
+                     *assembler.getObject());
+
+    if (dependency_file_output)
+    {
+        GetDependencies(source_mgr, *assembler.getObject(), &deps);
+        if (!WriteDependencyFile(assembler.getObjectFilename(), deps, diags))
+            return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+// assemble all the input files into a single output file (obj_filename):
+// a static library, or with --merge, a merged object
+static int
+assemble_combined(Assembler& assembler,
+                  SourceManager& source_mgr,
+                  DiagnosticsEngine& diags,
+                  HeaderSearch& headers)
+{
+    util::scoped_ptr<ArchiveWriter> archive;
+    if (!merge_objects)
+        archive.reset(new ArchiveWriter(
+            StringRef(objfmt_keyword).startswith("macho") ?
+            ArchiveWriter::BSD : ArchiveWriter::GNU));
+    CombinedOutput combined(archive.get());
+    int status = EXIT_SUCCESS;
+    for (std::vector<std::string>::const_iterator i=in_filenames.begin(),
+         end=in_filenames.end(); i != end; ++i)
+    {
+        if (i != in_filenames.begin())
+        {
+            assembler.Reset();
+            source_mgr.clearIDTables();
+            diags.Reset();
+            ApplyWarningSettings(diags);
+        }
+        if (assemble_file(assembler, source_mgr, diags, headers, 0, *i, "",
+                          &combined) != EXIT_SUCCESS)
+            status = EXIT_FAILURE;
+    }
+    if (status != EXIT_SUCCESS)
+        return status;
+
+    if (!archive)
+    {
+        // Read the objects back into a fresh object.
+        assembler.Reset();
+        source_mgr.clearIDTables();
+        diags.Reset();
+        ApplyWarningSettings(diags);
+        assembler.setObjectFilename(obj_filename);
+
+        std::vector<StringRef> images;
+        for (std::deque<std::vector<char> >::const_iterator
+             i=combined.images.begin(), end=combined.images.end();
+             i != end; ++i)
+            images.push_back(StringRef(i->empty() ? 0 : &(*i)[0],
+                                       i->size()));
+        if (!assembler.Merge(images, diags))
+            return EXIT_FAILURE;
+        ConfigureObject(*assembler.getObject());
+    }
 
-    if (yasm_errwarns_num_errors(errwarns, warning_error) > 0)
+    std::string err;
+    raw_fd_ostream out(obj_filename.c_str(), err, raw_fd_ostream::F_Binary);
+    if (!err.empty())
     {
-        yasm_errwarns_output_all(errwarns, linemap, warning_error,
-                                 print_yasm_error, print_yasm_warning);
-        if (out != stdout)
-            remove(obj_filename);
-        yasm_xfree(preproc_buf);
-        yasm_linemap_destroy(linemap);
-        yasm_errwarns_destroy(errwarns);
+        diags.Report(SourceLocation(), diag::err_cannot_open_file)
+            << obj_filename << err;
         return EXIT_FAILURE;
     }
+    if (archive)
+        archive->Write(out);
+    else if (!assembler.Output(out, diags))
+    {
+        out.close();
+        remove(obj_filename.c_str());
+        return EXIT_FAILURE;
+    }
+    out.close();
 
-    yasm_errwarns_output_all(errwarns, linemap, warning_error,
-                             print_yasm_error, print_yasm_warning);
-    yasm_xfree(preproc_buf);
-    yasm_linemap_destroy(linemap);
-    yasm_errwarns_destroy(errwarns);
+    if (dependency_file_output &&
+        !WriteDependencyFile(obj_filename, combined.deps, diags))
+        return EXIT_FAILURE;
     return EXIT_SUCCESS;
 }
-#endif
+
+// assemble the input files for one object format; a non-empty out_dir
+// names the directory for the (default-named) object files
 static int
-do_assemble(SourceManager& source_mgr, DiagnosticsEngine& diags)
+do_assemble(SourceManager& source_mgr,
+            DiagnosticsEngine& diags,
+            StringRef out_dir = StringRef())
 {
     // Apply warning settings
     ApplyWarningSettings(diags);
 
-    Assembler assembler(arch_keyword, objfmt_keyword, diags, dump_object);
+    // With --fast-exit the assembler is never freed; see FastExit().
+    Assembler* assembler_ptr =
+        new Assembler(arch_keyword, objfmt_keyword, diags, dump_object);
+    util::scoped_ptr<Assembler> assembler_owner(fast_exit ? 0 : assembler_ptr);
+    Assembler& assembler = *assembler_ptr;
     FileManager& file_mgr = source_mgr.getFileManager();
     HeaderSearch headers(file_mgr);
 
-    if (diags.hasFatalErrorOccurred())
+    if (diags.hasErrorOccurred())
         return EXIT_FAILURE;
 
-    // Set object filename if specified.
-    if (!obj_filename.empty())
+    // Set object filename if specified.  With multiple input files, it
+    // names the directory for the (default-named) object files instead.
+    if (!obj_filename.empty() && in_filenames.size() == 1 && out_dir.empty())
         assembler.setObjectFilename(obj_filename);
 
     // Set parser.
     assembler.setParser(parser_keyword, diags);
 
+    // Set number of threads.
+    assembler.setNumJobs(num_jobs);
+    assembler.setSplitParse(split_parse);
+
+    assembler.setTimeReport(time_report);
+    // The statistics include the span, interval tree, and byte counts.
+    if (time_report)
+        llvm::EnableStatistics();
+    assembler.setDumpFormat(dump_format);
+
     // Set machine if specified.
     if (!machine_name.empty())
         assembler.setMachine(machine_name, diags);
@@ -725,114 +1515,349 @@ do_assemble(SourceManager& source_mgr, DiagnosticsEngine& diags)
     if (diags.hasFatalErrorOccurred())
         return EXIT_FAILURE;
 
+    // Set list format if a listing was requested.
+    if (!list_filename.empty())
+        assembler.setListFormat(listfmt_keyword, diags);
+
+    if (diags.hasFatalErrorOccurred())
+        return EXIT_FAILURE;
+
     // Set up header search paths
-    std::vector<DirectoryLookup> dirs;
-    for (std::vector<std::string>::iterator i = include_paths.begin(),
-         end = include_paths.end(); i != end; ++i)
+    SetIncludePaths(headers, file_mgr);
+
+    assembler.getArch()->setVar("force_strict", force_strict);
+    assembler.getArch()->setVar("optimize", optimize_level == "x");
+    if ((branch_align & (branch_align-1)) != 0)
     {
-        dirs.push_back(DirectoryLookup(file_mgr.getDirectory(*i), true));
+        diags.Report(diag::fatal_bad_branch_align) << branch_align;
+        return EXIT_FAILURE;
+    }
+    assembler.getArch()->setVar("branch_align", branch_align);
+    assembler.getArch()->setVar("thread_jumps", thread_jumps);
+    assembler.getArch()->setVar("feature_usage", report_isa || isa_note);
+    if (!assembler.getArch()->setCostModel(list_costs))
+    {
+        diags.Report(diag::fatal_unrecognized_module) << "cost model"
+                                                      << list_costs;
+        return EXIT_FAILURE;
     }
-    headers.SetSearchPaths(dirs, 0, false);
 
-    assembler.getArch()->setVar("force_strict", force_strict);
+    // Set up the object cache if enabled.
+    util::scoped_ptr<ObjectCache> cache;
+    std::string cache_path = cache_dir;
+    if (cache_path.empty())
+    {
+        if (const char* env = std::getenv("YASM_CACHE_DIR"))
+            cache_path = env;
+    }
+    if (!cache_path.empty() && dump_object == Assembler::DUMP_NEVER)
+    {
+        // Entries for each of multiple formats must be kept apart.
+        std::vector<std::string> key(command_line);
+        if (objfmt_keywords.size() > 1)
+            key.push_back("-f" + objfmt_keyword);
+        cache.reset(new ObjectCache(cache_path, key));
+        if (split_parse)
+            assembler.setPieceCache(cache.get());
+    }
 
-    // open the input file or STDIN (for filename of "-")
-    if (in_filename == "-")
+    if (in_filenames.size() == 1)
+        return assemble_file(assembler, source_mgr, diags, headers,
+                             cache.get(), in_filenames.front(), out_dir);
+
+    // An output file named *.a (rather than a directory) gets a static
+    // library of all the objects, and --merge a single merged object; only
+    // one dependency file is then needed.
+    bool is_dir = false;
+    bool to_file = !obj_filename.empty() &&
+        (llvm::sys::fs::is_directory(obj_filename, is_dir) || !is_dir);
+    bool combine = merge_objects ||
+        (to_file && StringRef(obj_filename).endswith(".a"));
+    if (merge_objects && !to_file)
+    {
+        diags.Report(diag::fatal_merge_needs_objfile);
+        return EXIT_FAILURE;
+    }
+
+    if (!list_filename.empty())
+    {
+        diags.Report(diag::fatal_multiple_inputs) << "-l";
+        return EXIT_FAILURE;
+    }
+    if (!dependency_filename.empty() && !combine)
+    {
+        diags.Report(diag::fatal_multiple_inputs) << "-MF";
+        return EXIT_FAILURE;
+    }
+    if (!save_relax_file.empty())
+    {
+        diags.Report(diag::fatal_multiple_inputs) << "--save-relax";
+        return EXIT_FAILURE;
+    }
+    if (!dependency_target.empty() && !combine)
+    {
+        diags.Report(diag::fatal_multiple_inputs) << "-MT";
+        return EXIT_FAILURE;
+    }
+
+    if (combine)
+        return assemble_combined(assembler, source_mgr, diags, headers);
+
+    if (out_dir.empty() && !obj_filename.empty())
     {
-        OwningPtr<MemoryBuffer> my_stdin;
-        if (llvm::error_code err = MemoryBuffer::getSTDIN(my_stdin))
+        // Must be an existing directory, or end in a separator (in which
+        // case it's created if needed).
+        if (!llvm::sys::path::is_separator(obj_filename[obj_filename.size()-1])
+            && (llvm::sys::fs::is_directory(obj_filename, is_dir) || !is_dir))
+        {
+            diags.Report(diag::fatal_objfile_not_directory) << obj_filename;
+            return EXIT_FAILURE;
+        }
+        bool existed;
+        if (llvm::error_code err =
+            llvm::sys::fs::create_directories(obj_filename, existed))
         {
             diags.Report(SourceLocation(), diag::fatal_file_open)
-                << in_filename << err.message();
+                << obj_filename << err.message();
             return EXIT_FAILURE;
         }
-        source_mgr.createMainFileIDForMemBuffer(my_stdin.take());
     }
-    else
+
+    // Assemble each file in turn, reusing the assembler (and the lookup
+    // caches it has built up) rather than starting over for each one.
+    int status = EXIT_SUCCESS;
+    for (std::vector<std::string>::const_iterator i=in_filenames.begin(),
+         end=in_filenames.end(); i != end; ++i)
     {
-        const FileEntry* in = file_mgr.getFile(in_filename);
-        if (!in)
+        if (i != in_filenames.begin())
         {
-            diags.Report(SourceLocation(), diag::fatal_file_open)
-                << in_filename;
-            return EXIT_FAILURE;
+            assembler.Reset();
+            source_mgr.clearIDTables();
+            diags.Reset();
+            ApplyWarningSettings(diags);
         }
-        source_mgr.createMainFileID(in);
+        if (assemble_file(assembler, source_mgr, diags, headers, cache.get(),
+                          *i, out_dir.empty() ? StringRef(obj_filename)
+                                              : out_dir) != EXIT_SUCCESS)
+            status = EXIT_FAILURE;
     }
+    return status;
+}
 
-    // initialize the object.
-    if (!assembler.InitObject(source_mgr, diags))
+#ifdef HAVE_SYS_UN_H
+// Assemble for each object format in a forked child, concurrently.  The
+// children buffer their diagnostics and pass them back through a pipe, so
+// they're printed one format after another, just as when assembling the
+// formats in turn.  A format that can't be forked off is assembled in
+// this process instead.
+static int
+assemble_formats_forked(SourceManager& source_mgr,
+                        DiagnosticsEngine& diags,
+                        const DiagnosticOptions& diag_opts,
+                        const std::vector<std::string>& out_dirs)
+{
+    // STDIN has to be read before forking for every child to see it.
+    if (std::find(in_filenames.begin(), in_filenames.end(), "-") !=
+        in_filenames.end() && !ReadStdin(diags))
         return EXIT_FAILURE;
 
-    // Configure object per command line parameters.
-    ConfigureObject(*assembler.getObject());
+    errfile->flush();
+    llvm::outs().flush();
 
-    // initialize the parser.
-    Parser& parser = assembler.InitParser(source_mgr, diags, headers);
-    ApplyPreprocessorBuiltins(parser.getPreprocessor());
-    ApplyPreprocessorSavedOptions(parser.getPreprocessor());
-    if (diags.hasErrorOccurred())
-        return EXIT_FAILURE;
+    std::vector<pid_t> pids(objfmt_keywords.size(), -1);
+    std::vector<int> fds(objfmt_keywords.size(), -1);
+    for (std::size_t i=0; i<objfmt_keywords.size(); ++i)
+    {
+        int fd[2];
+        if (pipe(fd) != 0)
+            continue;
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            close(fd[0]);
+            close(fd[1]);
+            continue;
+        }
+        if (pid > 0)
+        {
+            close(fd[1]);
+            pids[i] = pid;
+            fds[i] = fd[0];
+            continue;
+        }
 
-    // assemble the input.
-    if (!assembler.Assemble(source_mgr, diags))
+        // child
+        close(fd[0]);
+        std::string diag_text;
+        int status;
+        {
+            llvm::raw_string_ostream os(diag_text);
+            TextDiagnosticPrinter diag_printer(os, diag_opts);
+            diag_printer.setPrefix("yasm");
+            diags.setClient(&diag_printer, false);
+            objfmt_keyword = objfmt_keywords[i];
+            status = do_assemble(source_mgr, diags, out_dirs[i]);
+            diag_printer.finish();
+            if (time_report)
+                llvm::TimerGroup::printAll(os);
+        }
+        llvm::outs().flush();
+        for (std::size_t done=0; done < diag_text.size(); )
+        {
+            ssize_t n = write(fd[1], diag_text.data()+done,
+                              diag_text.size()-done);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                break;
+            done += n;
+        }
+        _exit(status);
+    }
+
+    int status = EXIT_SUCCESS;
+    for (std::size_t i=0; i<objfmt_keywords.size(); ++i)
     {
-        // An error occurred during assembly.
-        return EXIT_FAILURE;
+        if (pids[i] < 0)
+        {
+            source_mgr.clearIDTables();
+            diags.Reset();
+            objfmt_keyword = objfmt_keywords[i];
+            if (do_assemble(source_mgr, diags, out_dirs[i]) != EXIT_SUCCESS)
+                status = EXIT_FAILURE;
+            continue;
+        }
+
+        char buf[4096];
+        for (;;)
+        {
+            ssize_t n = read(fds[i], buf, sizeof(buf));
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                break;
+            errfile->write(buf, n);
+        }
+        close(fds[i]);
+
+        int child_status;
+        while (waitpid(pids[i], &child_status, 0) < 0)
+        {
+            if (errno != EINTR)
+            {
+                child_status = -1;
+                break;
+            }
+        }
+        if (child_status == -1 || !WIFEXITED(child_status) ||
+            WEXITSTATUS(child_status) != EXIT_SUCCESS)
+            status = EXIT_FAILURE;
     }
+    errfile->flush();
+    return status;
+}
+#endif
 
-    // open the object file for output
-    std::string err;
-    raw_fd_ostream out(assembler.getObjectFilename().str().c_str(),
-                             err, raw_fd_ostream::F_Binary);
-    if (!err.empty())
+// assemble the input files for each of several object formats, placing
+// the objects in a subdirectory named for the format (under the -o
+// directory, if given).  Each format is parsed on its own, as directives,
+// special symbols, and __YASM_OBJFMT__ all depend on the format, but the
+// source files are only read once.
+static int
+assemble_formats(SourceManager& source_mgr,
+                 DiagnosticsEngine& diags,
+                 const DiagnosticOptions& diag_opts)
+{
+    // Options naming a single output file can't be used.
+    const char* single_output = 0;
+    if (!list_filename.empty())
+        single_output = "-l";
+    else if (!dependency_filename.empty())
+        single_output = "-MF";
+    else if (!dependency_target.empty())
+        single_output = "-MT";
+    else if (!save_relax_file.empty())
+        single_output = "--save-relax";
+    else if (merge_objects)
+        single_output = "--merge";
+    if (single_output)
     {
-        diags.Report(SourceLocation(), diag::err_cannot_open_file)
-            << obj_filename << err;
+        diags.Report(diag::fatal_multiple_formats) << single_output;
         return EXIT_FAILURE;
     }
 
-    if (!assembler.Output(out, diags))
+    // The object file output must be an existing directory, or end in a
+    // separator (in which case it's created if needed).
+    bool is_dir = false;
+    if (!obj_filename.empty() &&
+        !llvm::sys::path::is_separator(obj_filename[obj_filename.size()-1])
+        && (llvm::sys::fs::is_directory(obj_filename, is_dir) || !is_dir))
     {
-        // An error occurred during output.
-        // If we had an error at this point, we also need to delete the output
-        // object file (to make sure it's not left newer than the source).
-        out.close();
-        remove(assembler.getObjectFilename().str().c_str());
+        diags.Report(diag::fatal_formats_objfile_not_directory)
+            << obj_filename;
         return EXIT_FAILURE;
     }
 
-    // close object file
-    out.close();
-#if 0
-    // Open and write the list file
-    if (list_filename)
+    std::vector<std::string> out_dirs;
+    for (std::vector<std::string>::const_iterator i=objfmt_keywords.begin(),
+         end=objfmt_keywords.end(); i != end; ++i)
     {
-        FILE *list = open_file(list_filename, "wt");
-        if (!list)
+        SmallString<128> path(obj_filename);
+        llvm::sys::path::append(path, *i);
+        bool existed;
+        if (llvm::error_code err =
+            llvm::sys::fs::create_directories(path.str(), existed))
         {
-            PrintError(String::Compose(_("could not open file `%1'"), filename));
+            diags.Report(SourceLocation(), diag::fatal_file_open)
+                << path.str() << err.message();
             return EXIT_FAILURE;
         }
-        /* Initialize the list format */
-        cur_listfmt = yasm_listfmt_create(cur_listfmt_module, in_filename,
-                                          obj_filename);
-        yasm_listfmt_output(cur_listfmt, list, linemap, cur_arch);
-        fclose(list);
+        out_dirs.push_back(path.str());
     }
+
+#ifdef HAVE_SYS_UN_H
+    if (num_jobs != 1)
+        return assemble_formats_forked(source_mgr, diags, diag_opts,
+                                       out_dirs);
 #endif
-    return EXIT_SUCCESS;
+
+    int status = EXIT_SUCCESS;
+    for (std::size_t i=0; i<objfmt_keywords.size(); ++i)
+    {
+        if (i > 0)
+        {
+            source_mgr.clearIDTables();
+            diags.Reset();
+        }
+        objfmt_keyword = objfmt_keywords[i];
+        if (do_assemble(source_mgr, diags, out_dirs[i]) != EXIT_SUCCESS)
+            status = EXIT_FAILURE;
+    }
+    return status;
 }
 
-// main function
-int
-main(int argc, char* argv[])
+// Exit once all output is written, without tearing down the assembler,
+// object, and source buffers one allocation at a time; the OS releases
+// the memory in one go.
+static void
+FastExit(int status)
 {
-    llvm::llvm_shutdown_obj llvm_manager(false);
-
-    cl::SetVersionPrinter(&PrintVersion);
-    cl::ParseCommandLineOptions(argc, argv);
+    // The time report and statistics are normally printed on shutdown.
+    if (errfile.get())
+        errfile->flush();
+    if (time_report)
+        llvm::TimerGroup::printAll(llvm::errs());
+    if (llvm::AreStatisticsEnabled())
+        llvm::PrintStatistics(llvm::errs());
+    llvm::outs().flush();
+    llvm::errs().flush();
+    std::exit(status);
+}
 
+// everything after command line parsing
+static int
+do_main()
+{
     // Handle special exiting options
     if (show_help)
         cl::PrintHelpMessage();
@@ -866,11 +1891,15 @@ main(int argc, char* argv[])
     }
     else
         errfile.reset(new llvm::raw_stderr_ostream);
+    // Floods of warnings are written a buffer at a time; this is still
+    // unbuffered if stderr is a terminal.
+    errfile->SetBuffered();
 
     DiagnosticOptions diag_opts;
     diag_opts.Format = ewmsg_style;
     diag_opts.ShowOptionNames = 1;
     diag_opts.ShowSourceRanges = 1;
+    diag_opts.RepeatLimit = diag_repeat_limit;
     TextDiagnosticPrinter diag_printer(*errfile, diag_opts);
     IntrusiveRefCntPtr<DiagnosticIDs> diagids(new DiagnosticIDs);
     DiagnosticsEngine diags(diagids, &diag_printer, false);
@@ -909,8 +1938,17 @@ main(int argc, char* argv[])
         (arch_keyword, "architecture", "architectures", &listed, diags);
     parser_keyword = ModuleCommonHandler<ParserModule>
         (parser_keyword, "parser", "parsers", &listed, diags);
-    objfmt_keyword = ModuleCommonHandler<ObjectFormatModule>
-        (objfmt_keyword, "object format", "object formats", &listed, diags);
+    SmallVector<StringRef, 4> formats;
+    StringRef(objfmt_keyword).split(formats, ",", -1, false);
+    for (SmallVectorImpl<StringRef>::const_iterator i=formats.begin(),
+         end=formats.end(); i != end; ++i)
+    {
+        std::string keyword = ModuleCommonHandler<ObjectFormatModule>
+            (*i, "object format", "object formats", &listed, diags);
+        if (std::find(objfmt_keywords.begin(), objfmt_keywords.end(),
+                      keyword) == objfmt_keywords.end())
+            objfmt_keywords.push_back(keyword);
+    }
     dbgfmt_keyword = ModuleCommonHandler<DebugFormatModule>
         (dbgfmt_keyword, "debug format", "debug formats", &listed, diags);
     listfmt_keyword = ModuleCommonHandler<ListFormatModule>
@@ -918,11 +1956,6 @@ main(int argc, char* argv[])
     if (listed)
         return EXIT_SUCCESS;
 
-    // If generating make dependencies, also set preproc_only to true,
-    // as we don't want to generate code.
-    if (generate_make_dependencies)
-        preproc_only = true;
-
     // Default to x86 as the architecture
     if (arch_keyword.empty())
         arch_keyword = "x86";
@@ -944,25 +1977,26 @@ main(int argc, char* argv[])
 
     // Require an input filename.  We don't use llvm::cl facilities for this
     // as we want to allow e.g. "yasm --license".
-    if (in_filename.empty())
+    if (in_filenames.empty())
     {
         diags.Report(diag::fatal_no_input_files);
         return EXIT_FAILURE;
     }
 
     // If not already specified, default to bin as the object format.
-    if (objfmt_keyword.empty())
-        objfmt_keyword = "bin";
+    if (objfmt_keywords.empty())
+        objfmt_keywords.push_back("bin");
+    objfmt_keyword = objfmt_keywords.front();
+    if (objfmt_keywords.size() > 1 && preproc_only)
+    {
+        diags.Report(diag::fatal_multiple_formats) << "-e";
+        return EXIT_FAILURE;
+    }
 
     // Default to NASM as the parser
     if (parser_keyword.empty())
         parser_keyword = "nasm";
 
-#if 0
-    // handle preproc-only case here
-    if (preproc_only)
-        return do_preproc_only();
-#endif
     // If list file enabled, make sure we have a list format loaded.
     if (!list_filename.empty())
     {
@@ -971,6 +2005,129 @@ main(int argc, char* argv[])
             listfmt_keyword = "nasm";
     }
 
-    return do_assemble(source_mgr, diags);
+    if (!trace_filename.empty())
+        EnableTrace();
+
+    // Set up the stat cache if enabled; the file manager owns it.
+    PersistentStatCache* stat_cache = 0;
+    std::string stat_cache_path = stat_cache_filename;
+    if (stat_cache_path.empty())
+    {
+        if (const char* env = std::getenv("YASM_STAT_CACHE"))
+            stat_cache_path = env;
+    }
+    if (!stat_cache_path.empty())
+    {
+        stat_cache = new PersistentStatCache;
+        stat_cache->load(stat_cache_path);
+        file_mgr.addStatCache(stat_cache);
+    }
+
+    int status;
+    if (preproc_only)
+        status = do_preproc_only(source_mgr, diags);
+    else if (objfmt_keywords.size() > 1)
+        status = assemble_formats(source_mgr, diags, diag_opts);
+    else
+        status = do_assemble(source_mgr, diags);
+    diag_printer.finish();
+
+    // Failing to save the stat cache only costs the next run some time.
+    if (stat_cache)
+        stat_cache->save(stat_cache_path);
+
+    if (!trace_filename.empty())
+    {
+        std::string err;
+        raw_fd_ostream os(trace_filename.c_str(), err);
+        if (!err.empty())
+        {
+            diags.Report(SourceLocation(), diag::err_cannot_open_file)
+                << trace_filename << err;
+            return EXIT_FAILURE;
+        }
+        WriteTrace(os);
+    }
+
+    if (fast_exit)
+        FastExit(status);
+    return status;
+}
+
+#ifdef HAVE_SYS_UN_H
+// server job
+static int
+do_daemon_job(int argc, char* argv[])
+{
+    cl::ParseCommandLineOptions(argc, argv);
+    command_line.assign(argv, argv+argc);
+    int status = do_main();
+    errfile.reset();
+    llvm::llvm_shutdown();
+    return status;
+}
+
+// server main loop
+static int
+do_daemon(int argc, char* argv[])
+{
+    // Jobs parse their own options on top of the server's, so the server
+    // can't take any others.
+    if (argc != 2)
+    {
+        llvm::errs() << "yasm: --daemon=<socket> must be the only option\n";
+        return EXIT_FAILURE;
+    }
+
+    // Initialize the modules once, so jobs start with them already set up.
+    if (!LoadStandardPlugins())
+    {
+        llvm::errs() << "yasm: could not load standard modules\n";
+        return EXIT_FAILURE;
+    }
+    std::auto_ptr<ArchModule> arch_module = LoadModule<ArchModule>("x86");
+    if (arch_module.get())
+        arch_module->Create();
+
+    return RunDaemon("yasm", daemon_socket, &do_daemon_job);
 }
 
+// Determine if the command line starts a server.
+static bool
+is_daemon_command(int argc, char* argv[])
+{
+    for (int i=1; i<argc; ++i)
+    {
+        llvm::StringRef arg(argv[i]);
+        if (arg.startswith("--daemon") || arg.startswith("-daemon"))
+            return true;
+    }
+    return false;
+}
+#endif
+
+// main function
+int
+main(int argc, char* argv[])
+{
+    llvm::llvm_shutdown_obj llvm_manager(false);
+
+#ifdef HAVE_SYS_UN_H
+    // Hand the job to a server, if one is running.
+    int status;
+    if (!is_daemon_command(argc, argv)
+        && RunDaemonClient(std::getenv("YASM_SERVER"), argc, argv, &status))
+        return status;
+#endif
+
+    cl::SetVersionPrinter(&PrintVersion);
+    cl::ParseCommandLineOptions(argc, argv);
+    command_line.assign(argv, argv+argc);
+
+#ifdef HAVE_SYS_UN_H
+    if (!daemon_socket.empty())
+        return do_daemon(argc, argv);
+#endif
+
+    return do_main();
+}
@@ -26,8 +26,10 @@
 //
 #include "config.h"
 
+#include <cstdlib>
 #include <memory>
 
+#include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/Support/CommandLine.h"
@@ -36,6 +38,7 @@
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/system_error.h"
+#include "llvm/Support/Timer.h"
 #include "yasmx/Basic/Diagnostic.h"
 #include "yasmx/Basic/FileManager.h"
 #include "yasmx/Basic/SourceManager.h"
@@ -105,6 +108,24 @@ static cl::list<bool> bits_32("32",
 static cl::list<bool> bits_64("64",
     cl::desc("set 64-bit output"));
 
+// --compress-debug-sections, --nocompress-debug-sections
+static cl::opt<Object::Compression> compress_debug_sections(
+    "compress-debug-sections",
+    cl::desc("compress DWARF debug sections:"),
+    cl::init(Object::COMPRESS_NONE),
+    cl::values(
+        clEnumValN(Object::COMPRESS_ZLIB, "", "zlib (default)"),
+        clEnumValN(Object::COMPRESS_NONE, "none", "no compression"),
+        clEnumValN(Object::COMPRESS_ZLIB, "zlib", "zlib"),
+        clEnumValN(Object::COMPRESS_ZLIB, "zlib-gabi", "zlib"),
+        clEnumValN(Object::COMPRESS_ZSTD, "zstd", "zstd"),
+        clEnumValEnd),
+    cl::ValueOptional,
+    cl::ZeroOrMore);
+static cl::opt<bool> nocompress_debug_sections("nocompress-debug-sections",
+    cl::desc("don't compress DWARF debug sections"),
+    cl::ZeroOrMore);
+
 // -defsym
 static cl::list<std::string> defsym("defsym",
     cl::desc("define symbol"));
@@ -117,7 +138,7 @@ static cl::list<std::string> ignored_D("D",
 
 // -dump-object
 static cl::opt<Assembler::ObjectDumpTime> dump_object("dump-object",
-    cl::desc("Dump object in XML after this phase:"),
+    cl::desc("Dump object after this phase:"),
     cl::values(
         clEnumValN(Assembler::DUMP_NEVER, "never", "never dump"),
         clEnumValN(Assembler::DUMP_AFTER_PARSE, "parsed",
@@ -130,12 +151,38 @@ static cl::opt<Assembler::ObjectDumpTime> dump_object("dump-object",
                    "after output"),
         clEnumValEnd));
 
+// -dump-format
+static cl::opt<Assembler::ObjectDumpFormat> dump_format("dump-format",
+    cl::desc("Format of object dump:"),
+    cl::values(
+#ifdef WITH_XML
+        clEnumValN(Assembler::DUMP_XML, "xml", "XML document"),
+#endif // WITH_XML
+        clEnumValN(Assembler::DUMP_JSON, "json", "JSON lines"),
+        clEnumValEnd),
+#ifdef WITH_XML
+    cl::init(Assembler::DUMP_XML));
+#else
+    cl::init(Assembler::DUMP_JSON));
+#endif // WITH_XML
+
+// --diag-repeat-limit
+static cl::opt<unsigned int> diag_repeat_limit("diag-repeat-limit",
+    cl::desc("Show at most <n> of each kind of error/warning message, "
+             "then summarize (0 = no limit)"),
+    cl::value_desc("n"),
+    cl::init(0));
+
 // --execstack, --noexecstack
 static cl::list<bool> execstack("execstack",
     cl::desc("require executable stack for this object"));
 static cl::list<bool> noexecstack("noexecstack",
     cl::desc("don't require executable stack for this object"));
 
+// --fast-exit
+static cl::opt<bool> fast_exit("fast-exit",
+    cl::desc("Exit without freeing memory once output is written"));
+
 // -J
 static cl::list<bool> no_signed_overflow("J",
     cl::desc("don't warn about signed overflow"));
@@ -150,6 +197,32 @@ static cl::list<std::string> include_paths("I",
 static cl::opt<bool> show_license("license",
     cl::desc("Show license text"));
 
+// -mbranches-within-32B-boundaries, -malign-branch-boundary
+static cl::opt<bool> branches_within_32b("mbranches-within-32B-boundaries",
+    cl::desc("pad jumps to not cross or end at 32-byte boundaries"));
+static cl::opt<unsigned int> align_branch_boundary("malign-branch-boundary",
+    cl::desc("pad jumps to not cross or end at NUM-byte boundaries"),
+    cl::value_desc("NUM"),
+    cl::init(0));
+
+// -mrelax-relocations
+static cl::opt<std::string> relax_relocations("mrelax-relocations",
+    cl::desc("use relocations the linker may relax (e.g. GOTPCRELX)"),
+    cl::value_desc("yes|no"),
+    cl::init("yes"));
+
+// --keep-unchanged
+static cl::opt<bool> keep_unchanged("keep-unchanged",
+    cl::desc("don't rewrite the object file if its contents are unchanged"));
+
+// --merge-sections
+static cl::opt<bool> merge_sections("merge-sections",
+    cl::desc("remove duplicate entries from mergeable sections"));
+
+// --pack-relative-relocs
+static cl::opt<bool> pack_relative_relocs("pack-relative-relocs",
+    cl::desc("pack section-relative address relocations into RELR sections"));
+
 // --plugin
 #ifndef BUILD_STATIC
 static cl::list<std::string> plugin_names("plugin",
@@ -163,6 +236,23 @@ static cl::opt<std::string> obj_filename("o",
     cl::value_desc("filename"),
     cl::Prefix);
 
+// -O, -Onnn
+static cl::opt<std::string> optimize_level("O",
+    cl::desc("Use shortest instruction forms (except -O0)"),
+    cl::value_desc("level"),
+    cl::ValueOptional,
+    cl::ZeroOrMore,
+    cl::Prefix);
+
+// --symbol-ordering-file
+static cl::opt<std::string> symbol_ordering_file("symbol-ordering-file",
+    cl::desc("Place functions listed in <file> in hot/cold sections (ELF)"),
+    cl::value_desc("file"));
+
+// --time-report
+static cl::opt<bool> time_report("time-report",
+    cl::desc("Report time spent in each assembly phase, and statistics"));
+
 // -w
 static cl::opt<bool> ignored_w("w",
     cl::desc("Ignored"),
@@ -359,6 +449,15 @@ ConfigureObject(Object& object)
         else
             break; // we're done with the list
     }
+
+    // The later of compress and nocompress wins.
+    if (nocompress_debug_sections.getPosition() <=
+        compress_debug_sections.getPosition())
+        config.CompressDebugSections = compress_debug_sections;
+    config.MergeSections = merge_sections;
+    config.RelaxRelocations = (relax_relocations != "no");
+    config.PackRelativeRelocs = pack_relative_relocs;
+    config.SymbolOrderingFile = symbol_ordering_file;
 }
 
 static int
@@ -371,11 +470,15 @@ do_assemble(SourceManager& source_mgr, DiagnosticsEngine& diags)
     std::string objfmt_bits = GetBitsSetting();
 
     FileManager& file_mgr = source_mgr.getFileManager();
-    Assembler assembler("x86", YGAS_OBJFMT_BASE + objfmt_bits, diags,
-                        dump_object);
+    // With --fast-exit the assembler is never freed; see FastExit().
+    Assembler* assembler_ptr = new Assembler("x86",
+                                             YGAS_OBJFMT_BASE + objfmt_bits,
+                                             diags, dump_object);
+    std::auto_ptr<Assembler> assembler_owner(fast_exit ? 0 : assembler_ptr);
+    Assembler& assembler = *assembler_ptr;
     HeaderSearch headers(file_mgr);
 
-    if (diags.hasFatalErrorOccurred())
+    if (diags.hasErrorOccurred())
         return EXIT_FAILURE;
 
     // Set object filename if specified.
@@ -385,9 +488,29 @@ do_assemble(SourceManager& source_mgr, DiagnosticsEngine& diags)
     // Set parser.
     assembler.setParser("gas", diags);
 
+    assembler.setTimeReport(time_report);
+    // The statistics include the span, interval tree, and byte counts.
+    if (time_report)
+        llvm::EnableStatistics();
+    assembler.setDumpFormat(dump_format);
+
     if (diags.hasFatalErrorOccurred())
         return EXIT_FAILURE;
 
+    // Set branch alignment.  The later option wins.
+    unsigned int branch_align = align_branch_boundary;
+    if (branches_within_32b &&
+        branches_within_32b.getPosition() > align_branch_boundary.getPosition())
+        branch_align = 32;
+    if ((branch_align & (branch_align-1)) != 0)
+    {
+        diags.Report(diag::fatal_bad_branch_align) << branch_align;
+        return EXIT_FAILURE;
+    }
+    assembler.getArch()->setVar("branch_align", branch_align);
+    assembler.getArch()->setVar("optimize",
+        optimize_level.getNumOccurrences() > 0 && optimize_level != "0");
+
     // Set debug format to dwarf2pass if it's legal for this object format.
     if (assembler.isOkDebugFormat("dwarf2pass"))
     {
@@ -503,6 +626,16 @@ do_assemble(SourceManager& source_mgr, DiagnosticsEngine& diags)
         return EXIT_FAILURE;
     }
 
+    if (keep_unchanged)
+    {
+        if (!assembler.OutputIfChanged(diags))
+        {
+            remove(assembler.getObjectFilename().str().c_str());
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
     // open the object file for output
     std::string err;
     raw_fd_ostream out(assembler.getObjectFilename().str().c_str(),
@@ -529,6 +662,21 @@ do_assemble(SourceManager& source_mgr, DiagnosticsEngine& diags)
     return EXIT_SUCCESS;
 }
 
+// Exit once all output is written, without tearing down the assembler,
+// object, and source buffers one allocation at a time.
+static void
+FastExit(int status)
+{
+    // The time report and statistics are normally printed on shutdown.
+    if (time_report)
+        llvm::TimerGroup::printAll(llvm::errs());
+    if (llvm::AreStatisticsEnabled())
+        llvm::PrintStatistics(llvm::errs());
+    llvm::outs().flush();
+    llvm::errs().flush();
+    std::exit(status);
+}
+
 // main function
 int
 main(int argc, char* argv[])
@@ -549,6 +697,10 @@ main(int argc, char* argv[])
     DiagnosticOptions diag_opts;
     diag_opts.ShowOptionNames = 1;
     diag_opts.ShowSourceRanges = 1;
+    diag_opts.RepeatLimit = diag_repeat_limit;
+    // Floods of warnings are written a buffer at a time; this is still
+    // unbuffered if stderr is a terminal.
+    llvm::errs().SetBuffered();
     TextDiagnosticPrinter diag_printer(llvm::errs(), diag_opts);
     IntrusiveRefCntPtr<DiagnosticIDs> diagids(new DiagnosticIDs);
     DiagnosticsEngine diags(diagids, &diag_printer, false);
@@ -585,6 +737,10 @@ main(int argc, char* argv[])
     if (in_filename.empty())
         in_filename = "-";
 
-    return do_assemble(source_mgr, diags);
+    int status = do_assemble(source_mgr, diags);
+    diag_printer.finish();
+    if (fast_exit)
+        FastExit(status);
+    return status;
 }
 
@@ -26,6 +26,7 @@
 //
 #include "config.h"
 
+#include <algorithm>
 #include <cctype>
 #include <cstring>
 #include <stdexcept>
@@ -42,7 +43,11 @@
 #include "yasmx/Basic/Diagnostic.h"
 #include "yasmx/Basic/FileManager.h"
 #include "yasmx/Basic/SourceManager.h"
+#include "yasmx/Config/functional.h"
 #include "yasmx/Frontend/OffsetDiagnosticPrinter.h"
+#include "yasmx/Support/HexFormat.h"
+#include "yasmx/Support/ThreadPool.h"
+#include "yasmx/Support/ptr_vector.h"
 #include "yasmx/Support/registry.h"
 #include "yasmx/System/plugin.h"
 #include "yasmx/Arch.h"
@@ -95,6 +100,17 @@ static cl::alias objfmt_keyword_long("target",
     cl::value_desc("target"),
     cl::aliasopt(objfmt_keyword));
 
+// -j, --jobs
+static cl::opt<unsigned int> num_jobs("j",
+    cl::desc("Dump up to N files at once (0 for one per processor)"),
+    cl::value_desc("N"),
+    cl::Prefix,
+    cl::init(1));
+static cl::alias num_jobs_long("jobs",
+    cl::desc("Alias for -j"),
+    cl::value_desc("N"),
+    cl::aliasopt(num_jobs));
+
 // -H
 static cl::opt<bool> show_help("H",
     cl::desc("Alias for --help"),
@@ -162,6 +178,14 @@ static cl::alias show_contents_long("full-contents",
     cl::desc("Alias for -s"),
     cl::aliasopt(show_contents));
 
+// -d, --disassemble
+static cl::opt<bool> show_disassembly("d",
+    cl::desc("Display assembler contents of code sections"),
+    cl::Grouping);
+static cl::alias show_disassembly_long("disassemble",
+    cl::desc("Alias for -d"),
+    cl::aliasopt(show_disassembly));
+
 // -x, --all-headers
 static cl::opt<bool> show_all_headers("x",
     cl::desc("Display all available header information (-f -h -p -r -t)"),
@@ -190,9 +214,8 @@ list_module()
 }
 
 static void
-DumpSectionHeaders(const Object& object)
+DumpSectionHeaders(raw_ostream& os, const Object& object)
 {
-    raw_ostream& os = llvm::outs();
     os << "Sections:\n"
        << "Idx Name          Size      ";
     unsigned int bits = 64; // FIXME
@@ -221,9 +244,8 @@ DumpSectionHeaders(const Object& object)
 }
 
 static void
-DumpSymbols(const Object& object)
+DumpSymbols(raw_ostream& os, const Object& object)
 {
-    raw_ostream& os = llvm::outs();
     os << "SYMBOL TABLE:\n";
     unsigned int bits = 64; // FIXME
     for (Object::const_symbol_iterator sym=object.symbols_begin(),
@@ -257,9 +279,8 @@ DumpSymbols(const Object& object)
 }
 
 static void
-DumpRelocs(const Object& object)
+DumpRelocs(raw_ostream& os, const Object& object)
 {
-    raw_ostream& os = llvm::outs();
     unsigned int bits = 64; // FIXME
 
     for (Object::const_section_iterator sect=object.sections_begin(),
@@ -287,47 +308,45 @@ DumpRelocs(const Object& object)
 }
 
 static void
-DumpContentsLine(const IntNum& addr,
+DumpContentsLine(raw_ostream& os,
+                 const IntNum& addr,
                  const unsigned char* data,
                  int len,
                  int addr_bits)
 {
-    raw_ostream& os = llvm::outs();
-
     // address
     os << ' ';
     addr.Print(os, 16, true, false, addr_bits);
 
-    // hex dump
-    for (int i=0; i<16; ++i)
+    // hex dump and ascii dump, built up as a whole row
+    char row[16*2+4+2+16+1];
+    char* p = row;
+    for (int i=0; i<16; i += 4)
     {
-        if ((i & 3) == 0)
-            os << ' ';
-        if (i<len)
-            os << format("%02x", static_cast<unsigned int>(data[i]));
-        else
-            os << "  ";
+        *p++ = ' ';
+        int n = std::min(std::max(len-i, 0), 4);
+        p = FormatHexBytes(p, &data[i], n);
+        std::memset(p, ' ', (4-n)*2);
+        p += (4-n)*2;
     }
-
-    // ascii dump
-    os << "  ";
+    *p++ = ' ';
+    *p++ = ' ';
     for (int i=0; i<16; ++i)
     {
         if (i>=len)
-            os << ' ';
+            *p++ = ' ';
         else if (!std::isprint(data[i]))
-            os << '.';
+            *p++ = '.';
         else
-            os << data[i];
+            *p++ = data[i];
     }
-
-    os << '\n';
+    *p++ = '\n';
+    os.write(row, p-row);
 }
 
 static void
-DumpContents(const Object& object)
+DumpContents(raw_ostream& os, const Object& object)
 {
-    raw_ostream& os = llvm::outs();
 
     for (Object::const_section_iterator sect=object.sections_begin(),
          end=object.sections_end(); sect != end; ++sect)
@@ -375,7 +394,7 @@ DumpContents(const Object& object)
                 // when we've filled up a line, output it.
                 if (line_pos == 16)
                 {
-                    DumpContentsLine(addr, line, 16, addr_bits);
+                    DumpContentsLine(os, addr, line, 16, addr_bits);
                     addr += 16;
                     line_pos = 0;
                 }
@@ -384,12 +403,87 @@ DumpContents(const Object& object)
 
         // output any remaining
         if (line_pos != 0)
-            DumpContentsLine(addr, line, line_pos, addr_bits);
+            DumpContentsLine(os, addr, line, line_pos, addr_bits);
+    }
+}
+
+static void
+DumpDisassembly(raw_ostream& os, const Object& object, const Arch& arch)
+{
+    for (Object::const_section_iterator sect=object.sections_begin(),
+         end=object.sections_end(); sect != end; ++sect)
+    {
+        if (!sect->isCode() || sect->isBSS())
+            continue;
+
+        // XXX: only disassembles fixed portions
+        std::vector<unsigned char> data;
+        for (Section::const_bc_iterator bc=sect->bytecodes_begin(),
+             endbc=sect->bytecodes_end(); bc != endbc; ++bc)
+        {
+            const Bytes& fixed = bc->getFixed();
+            data.insert(data.end(), fixed.begin(), fixed.end());
+        }
+        if (data.empty())
+            continue;
+
+        // labels in this section, by offset
+        std::vector<std::pair<unsigned long, std::string> > labels;
+        for (Object::const_symbol_iterator sym=object.symbols_begin(),
+             endsym=object.symbols_end(); sym != endsym; ++sym)
+        {
+            Location loc;
+            if (sym->getLabel(&loc) && !sym->getName().empty()
+                && loc.bc->getContainer()->getSection() == &*sect)
+                labels.push_back(std::make_pair(loc.getOffset(),
+                                                sym->getName()));
+        }
+        std::sort(labels.begin(), labels.end());
+        std::vector<std::pair<unsigned long, std::string> >::iterator
+            label = labels.begin();
+
+        os << "Disassembly of section " << sect->getName() << ":\n";
+
+        uint64_t vma = sect->getVMA().getUInt64();
+        unsigned long pos = 0, size = data.size();
+        while (pos < size)
+        {
+            for (; label != labels.end() && label->first <= pos; ++label)
+            {
+                if (label->first == pos)
+                    os << '\n' << label->second << ":\n";
+            }
+
+            std::string text;
+            llvm::raw_string_ostream text_os(text);
+            Arch::DisasmInsn insn;
+            if (arch.Disassemble(&data[pos], size-pos, vma+pos, &insn,
+                                 &text_os))
+                text_os.flush();
+            else
+            {
+                insn.length = 1;
+                insn.features = "";
+                text = "(bad)";
+            }
+
+            os << format("%8lx", static_cast<unsigned long>(vma+pos))
+               << ":\t";
+            for (unsigned int i=0; i<insn.length; ++i)
+                os << format("%02x ", static_cast<unsigned int>(data[pos+i]));
+            os << '\t' << text;
+            if (insn.features[0] != '\0')
+                os << "\t; " << insn.features;
+            os << '\n';
+            pos += insn.length;
+        }
+        os << '\n';
     }
 }
 
 static int
-DoDump(const std::string& in_filename,
+DoDump(raw_ostream& os,
+       const std::string& in_filename,
        SourceManager& source_mgr,
        DiagnosticsEngine& diags)
 {
@@ -414,6 +508,7 @@ DoDump(const std::string& in_filename,
         {
             diags.Report(SourceLocation(), diag::err_file_open)
                 << in_filename;
+            return EXIT_FAILURE;
         }
         source_mgr.createMainFileID(in);
     }
@@ -428,7 +523,6 @@ DoDump(const std::string& in_filename,
 
     if (!objfmt_keyword.empty())
     {
-        objfmt_keyword = StringRef(objfmt_keyword).lower();
         if (!isModule<ObjectFormatModule>(objfmt_keyword))
         {
             diags.Report(sloc, diag::err_unrecognized_object_format)
@@ -500,24 +594,124 @@ DoDump(const std::string& in_filename,
         return EXIT_FAILURE;
     }
 
+    // Only load what will be dumped.
+    unsigned int parts = 0;
+    if (show_symbols)
+        parts |= Object::READ_SYMBOLS;
+    if (show_relocs)
+        parts |= Object::READ_RELOCS;
+    if (show_contents)
+        parts |= Object::READ_CONTENTS;
+    if (show_disassembly)
+        parts |= Object::READ_CONTENTS | Object::READ_SYMBOLS;
+    object.getConfig().ReadParts = parts;
+
     std::auto_ptr<ObjectFormat> objfmt = objfmt_module->Create(object);
     if (!objfmt->Read(source_mgr, diags))
         return EXIT_FAILURE;
 
-    llvm::outs() << in_filename << ":     file format "
-                 << objfmt_module->getKeyword() << "\n\n";
+    os << in_filename << ":     file format "
+       << objfmt_module->getKeyword() << "\n\n";
 
     if (show_section_headers)
-        DumpSectionHeaders(object);
+        DumpSectionHeaders(os, object);
     if (show_symbols)
-        DumpSymbols(object);
+        DumpSymbols(os, object);
     if (show_relocs)
-        DumpRelocs(object);
+        DumpRelocs(os, object);
     if (show_contents)
-        DumpContents(object);
+        DumpContents(os, object);
+    if (show_disassembly)
+        DumpDisassembly(os, object, *arch);
     return EXIT_SUCCESS;
 }
 
+static int
+DumpFile(raw_ostream& os,
+         raw_ostream& err_os,
+         const std::string& in_filename,
+         SourceManager& source_mgr,
+         DiagnosticsEngine& diags)
+{
+    try
+    {
+        return DoDump(os, in_filename, source_mgr, diags);
+    }
+    catch (std::out_of_range& err)
+    {
+        err_os << in_filename << ": "
+            << "out of range error while reading (corrupt file?)\n";
+        return EXIT_FAILURE;
+    }
+}
+
+namespace {
+/// A single file dumped by a worker thread.  Standard output and
+/// diagnostics are buffered so they can be emitted in input order.
+class DumpJob
+{
+public:
+    DumpJob(const std::string& in_filename,
+            const FileSystemOptions& opts,
+            const IntrusiveRefCntPtr<DiagnosticIDs>& diagids);
+    ~DumpJob() {}
+
+    void Run();
+
+    /// Write the buffered output and diagnostics.
+    /// @return Exit status of the dump.
+    int Flush(raw_ostream& os, raw_ostream& err_os);
+
+private:
+    const std::string& m_in_filename;
+    std::string m_out, m_err;
+    llvm::raw_string_ostream m_out_os, m_err_os;
+    OffsetDiagnosticPrinter m_diag_printer;
+    DiagnosticsEngine m_diags;
+    FileManager m_file_mgr;
+    SourceManager m_source_mgr;
+    int m_retval;
+};
+} // anonymous namespace
+
+DumpJob::DumpJob(const std::string& in_filename,
+                 const FileSystemOptions& opts,
+                 const IntrusiveRefCntPtr<DiagnosticIDs>& diagids)
+    : m_in_filename(in_filename)
+    , m_out_os(m_out)
+    , m_err_os(m_err)
+    , m_diag_printer(m_err_os)
+    , m_diags(diagids, &m_diag_printer, false)
+    , m_file_mgr(opts)
+    , m_source_mgr(m_diags, m_file_mgr)
+    , m_retval(EXIT_SUCCESS)
+{
+    m_diags.setSourceManager(&m_source_mgr);
+    m_diag_printer.setPrefix("yobjdump");
+}
+
+void
+DumpJob::Run()
+{
+    m_retval = DumpFile(m_out_os, m_err_os, m_in_filename, m_source_mgr,
+                        m_diags);
+}
+
+int
+DumpJob::Flush(raw_ostream& os, raw_ostream& err_os)
+{
+    os << m_out_os.str();
+    os.flush();
+    err_os << m_err_os.str();
+    return m_retval;
+}
+
+static void
+RunDumpJob(stdx::ptr_vector<DumpJob>& jobs, std::size_t i)
+{
+    jobs[i].Run();
+}
+
 int
 main(int argc, char* argv[])
 {
@@ -575,21 +769,51 @@ main(int argc, char* argv[])
         return EXIT_FAILURE;
     }
 
+    if (!objfmt_keyword.empty())
+        objfmt_keyword = StringRef(objfmt_keyword).lower();
+
     int retval = EXIT_SUCCESS;
 
-    for (std::vector<std::string>::const_iterator i=in_filenames.begin(),
-         end=in_filenames.end(); i != end; ++i)
+    ThreadPool pool(num_jobs);
+    if (pool.getNumThreads() == 1 || in_filenames.size() == 1)
     {
-        try
+        for (std::vector<std::string>::const_iterator i=in_filenames.begin(),
+             end=in_filenames.end(); i != end; ++i)
         {
-            if (DoDump(*i, source_mgr, diags) != EXIT_SUCCESS)
+            // Each file is the main file of its own source manager, and
+            // errors in one file must not stop the next from being read.
+            FileManager file_mgr(opts);
+            SourceManager file_source_mgr(diags, file_mgr);
+            diags.setSourceManager(&file_source_mgr);
+            diags.Reset();
+            if (DumpFile(llvm::outs(), llvm::errs(), *i, file_source_mgr,
+                         diags) != EXIT_SUCCESS)
                 retval = EXIT_FAILURE;
+            diags.setSourceManager(&source_mgr);
         }
-        catch (std::out_of_range& err)
+        return retval;
+    }
+
+    // Dump files in batches across the pool, writing each batch in input
+    // order.  Batching bounds the amount of buffered output.
+    std::size_t batch_size = pool.getNumThreads() * 8;
+    for (std::size_t first=0; first < in_filenames.size(); first += batch_size)
+    {
+        std::size_t last = std::min(first + batch_size, in_filenames.size());
+
+        stdx::ptr_vector<DumpJob> jobs;
+        stdx::ptr_vector_owner<DumpJob> jobs_owner(jobs);
+        jobs.reserve(last - first);
+        for (std::size_t i=first; i<last; ++i)
+            jobs.push_back(new DumpJob(in_filenames[i], opts, diagids));
+
+        pool.Run(jobs.size(), TR1::bind(&RunDumpJob, TR1::ref(jobs), _1));
+
+        for (stdx::ptr_vector<DumpJob>::iterator i=jobs.begin(),
+             end=jobs.end(); i != end; ++i)
         {
-            llvm::errs() << *i << ": "
-                << "out of range error while reading (corrupt file?)\n";
-            retval = EXIT_FAILURE;
+            if (i->Flush(llvm::outs(), llvm::errs()) != EXIT_SUCCESS)
+                retval = EXIT_FAILURE;
         }
     }
     return retval;
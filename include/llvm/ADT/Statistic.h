@@ -124,16 +124,23 @@ protected:
   static llvm::Statistic VARNAME = { DEBUG_TYPE, DESC, 0, 0 }
 
 /// \brief Enable the collection and printing of statistics.
-void EnableStatistics();
+YASM_LIB_EXPORT void EnableStatistics();
 
 /// \brief Check if statistics are enabled.
-bool AreStatisticsEnabled();
+YASM_LIB_EXPORT bool AreStatisticsEnabled();
+
+/// \brief Check if statistics (and timers) are to be printed as JSON.
+YASM_LIB_EXPORT bool AreStatisticsJSONEnabled();
 
 /// \brief Print statistics to the file returned by CreateInfoOutputFile().
-void PrintStatistics();
+YASM_LIB_EXPORT void PrintStatistics();
 
 /// \brief Print statistics to the given output stream.
-void PrintStatistics(raw_ostream &OS);
+YASM_LIB_EXPORT void PrintStatistics(raw_ostream &OS);
+
+/// \brief Print statistics and any started timers in JSON format to the
+/// given output stream.
+YASM_LIB_EXPORT void PrintStatisticsJSON(raw_ostream &OS);
 
 } // End llvm namespace
 
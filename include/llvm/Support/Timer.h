@@ -182,6 +182,15 @@ public:
   
   /// printAll - This static method prints all timers and clears them all out.
   static void printAll(raw_ostream &OS);
+
+  /// printJSONValues - Print any started timers in this group as JSON
+  /// key/value pairs and zero them.  Each pair is preceded by delim; returns
+  /// the delimiter to use for any following pair.
+  const char *printJSONValues(raw_ostream &OS, const char *delim);
+
+  /// printAllJSONValues - Print all started timers as JSON key/value pairs
+  /// and clear them all out.
+  static const char *printAllJSONValues(raw_ostream &OS, const char *delim);
   
 private:
   friend class Timer;
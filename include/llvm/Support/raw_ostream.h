@@ -338,6 +338,11 @@ class YASM_LIB_EXPORT raw_fd_ostream : public raw_ostream {
   /// possible.
   bool UseAtomicWrites;
 
+  /// SupportsSeeking - True if the stream is a regular file opened by name
+  /// for writing (not appending), so seek() can skip forward past regions
+  /// that do not need to be written.
+  bool SupportsSeeking;
+
   uint64_t pos;
 
   /// write_impl - See raw_ostream::write_impl.
@@ -394,6 +399,11 @@ public:
   /// position to the offset specified from the beginning of the file.
   uint64_t seek(uint64_t off);
 
+  /// supportsSeeking - Return true if seek() may be used to reposition
+  /// the output, including leaving unwritten holes past the current end
+  /// of the file.
+  bool supportsSeeking() const { return SupportsSeeking; }
+
   /// SetUseAtomicWrite - Set the stream to attempt to use atomic writes for
   /// individual output routines where possible.
   ///
@@ -61,6 +61,11 @@ namespace std
 #	include <exception>
 #endif
 
+// Detect support for long long type
+#if !defined(PUGIXML_HAS_LONG_LONG) && (defined(__GNUC__) || (defined(_MSC_VER) && _MSC_VER >= 1400))
+#	define PUGIXML_HAS_LONG_LONG
+#endif
+
 // If no API is defined, assume default
 #ifndef PUGIXML_API
 #   define PUGIXML_API
@@ -309,6 +314,10 @@ namespace pugi
 		bool set_value(unsigned int rhs);
 		bool set_value(long rhs);
 		bool set_value(unsigned long rhs);
+	#ifdef PUGIXML_HAS_LONG_LONG
+		bool set_value(long long rhs);
+		bool set_value(unsigned long long rhs);
+	#endif
 		bool set_value(double rhs);
 		bool set_value(bool rhs);
 
@@ -318,6 +327,10 @@ namespace pugi
 		xml_attribute& operator=(unsigned int rhs);
 		xml_attribute& operator=(long rhs);
 		xml_attribute& operator=(unsigned long rhs);
+	#ifdef PUGIXML_HAS_LONG_LONG
+		xml_attribute& operator=(long long rhs);
+		xml_attribute& operator=(unsigned long long rhs);
+	#endif
 		xml_attribute& operator=(double rhs);
 		xml_attribute& operator=(bool rhs);
 
@@ -29,12 +29,14 @@
 /// POSSIBILITY OF SUCH DAMAGE.
 /// @endlicense
 ///
+#include <cstddef>
 #include <memory>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Support/DataTypes.h"
 #include "yasmx/Basic/LLVM.h"
 #include "yasmx/Config/export.h"
 #include "yasmx/DebugDumper.h"
@@ -48,6 +50,7 @@ namespace yasm
 {
 
 class ArchModule;
+class Bytecode;
 class BytecodeContainer;
 class Bytes;
 class DiagnosticsEngine;
@@ -56,9 +59,13 @@ class EffAddr;
 class Expr;
 class IntNum;
 class Insn;
+class Object;
 class ParserImpl;
 class Prefix;
 class Preprocessor;
+class RecordReader;
+class RecordWriter;
+class Section;
 class SourceLocation;
 class TargetModifier;
 class Token;
@@ -271,8 +278,28 @@ public:
         };
     };
 
+    /// Instruction decoded by Disassemble().
+    struct DisasmInsn
+    {
+        unsigned int length;    ///< length in bytes
+        const char* mnemonic;   ///< instruction mnemonic
+        /// CPU features required beyond the base architecture, separated
+        /// by spaces (empty if none).
+        const char* features;
+    };
+
+    /// Estimated cost of executing instructions, from a cost model.
+    struct InsnCost
+    {
+        unsigned int insns;         ///< number of instructions
+        unsigned int unknown;       ///< instructions without an estimate
+        unsigned int uops;          ///< micro-operations issued
+        unsigned int latency;       ///< latency, in cycles
+        unsigned int rthroughput;   ///< reciprocal throughput, 1/100 cycles
+    };
+
     /// Constructor.
-    Arch(const ArchModule& module) : m_module(module) {}
+    Arch(const ArchModule& module) : m_module(module), m_lookup_gen(0) {}
 
     /// Destructor.
     virtual ~Arch();
@@ -308,6 +335,50 @@ public:
     /// @return True on success, false on failure (variable does not exist).
     virtual bool setVar(StringRef var, unsigned long val) = 0;
 
+    /// Return state that source directives can change (e.g. the active CPU
+    /// features) to its initial settings, so the architecture can be reused
+    /// to assemble another source file.  The parser, machine, and variables
+    /// set with setVar() are kept; callers must reapply any of these that
+    /// directives also change.  The default implementation does nothing.
+    virtual void Reset();
+
+    /// Create another architecture of the same module with the same
+    /// settings, including state that directives have changed, to parse
+    /// part of the source independently.  The default implementation
+    /// returns NULL.
+    /// @return New architecture, or NULL if not supported.
+    virtual std::auto_ptr<Arch> Clone() const;
+
+    /// Write a register to a parse record.  The default implementation
+    /// returns false.
+    /// @param reg          register
+    /// @param out          parse record writer
+    /// @return False if the register can't be recorded.
+    virtual bool SaveRegister(const Register& reg, RecordWriter& out) const;
+
+    /// Read a register written by SaveRegister() from a parse record.
+    /// The default implementation throws std::out_of_range.
+    /// @param in           parse record reader
+    /// @return Register.
+    virtual const Register* LoadRegister(RecordReader& in) const;
+
+    /// Read bytecode contents written by Bytecode::Contents::Save() from a
+    /// parse record.  The default implementation returns false.
+    /// @param type         contents type (see Bytecode::Contents::getType())
+    /// @param in           parse record reader
+    /// @param bc           bytecode to give the contents
+    /// @return False if the architecture can't read contents of the type.
+    virtual bool LoadContents(StringRef type,
+                              RecordReader& in,
+                              Bytecode& bc) const;
+
+    /// Make architecture-specific changes to an object after it has been
+    /// finalized and before it is optimized.  The default implementation
+    /// does nothing.
+    /// @param object       object
+    /// @param diags        diagnostic reporting
+    virtual void FinalizeObject(Object& object, DiagnosticsEngine& diags);
+
     /// Determine if a custom parser (ParseInsn) should be used.  The default
     /// implementation returns false.
     /// @note This can be parser-dependent, so call setParser() first.
@@ -375,11 +446,98 @@ public:
     /// ParseCheckInsnPrefix().
     virtual std::auto_ptr<Insn> CreateInsn(const InsnInfo* info) const = 0;
 
+    /// Reuse an instruction as though it had just been created by
+    /// CreateInsn(), or by CreateEmptyInsn() if info is NULL.  Parsers
+    /// keep a single instruction this way so that parsing an instruction
+    /// normally doesn't allocate.  The default implementation creates a
+    /// new instruction.
+    /// @param insn         instruction previously created by this arch,
+    ///                     or empty to create a new one
+    /// @param info         InsnInfo from ParseCheckInsnPrefix(), or NULL
+    virtual void ReuseInsn(std::auto_ptr<Insn>& insn,
+                           const InsnInfo* info) const;
+
+    /// Decode a single instruction in the active mode (the address size
+    /// as returned by getAddressSize()).  Decoding doesn't allocate, so
+    /// it's fast enough to scan large amounts of code; the instruction is
+    /// only formatted if an output stream is given.  The default
+    /// implementation recognizes no instructions.
+    /// @param bytes        instruction bytes
+    /// @param len          number of bytes available
+    /// @param addr         address of the instruction (for branch targets)
+    /// @param insn         decoded instruction (output)
+    /// @param os           if not NULL, the instruction and its operands
+    ///                     are written here in the syntax of the NASM parser
+    /// @return False if the bytes don't start a recognized instruction.
+    virtual bool Disassemble(const unsigned char* bytes,
+                             std::size_t len,
+                             uint64_t addr,
+                             DisasmInsn* insn,
+                             raw_ostream* os = 0) const;
+
+    /// Instruction counts by CPU feature name.
+    typedef std::vector<std::pair<std::string, unsigned long> > FeatureUsage;
+
+    /// Get the CPU features required by the instructions in a section.
+    /// Only recorded while parsing with the "feature_usage" variable set
+    /// (see setVar()).  The default implementation records nothing.
+    /// @param sect         section
+    /// @param usage        number of instructions requiring each feature,
+    ///                     in architecture order (output)
+    /// @return Number of instructions recorded in the section.
+    virtual unsigned long getFeatureUsage(const Section& sect,
+                                          FeatureUsage* usage) const;
+
+    /// Select the cost model used to estimate the cost of instructions.
+    /// Estimates are recorded for the listed lines of instructions parsed
+    /// afterwards (see getLineCost()).  The default implementation has no
+    /// cost models.
+    /// @param model        microarchitecture keyword; empty to disable
+    /// @return False if unrecognized model.
+    virtual bool setCostModel(StringRef model);
+
+    /// Get the issue width of the selected cost model.
+    /// @return Micro-operations issued per cycle; 0 if no cost model is
+    ///         selected.
+    virtual unsigned int getIssueWidth() const;
+
+    /// Get the estimated cost of the instructions of a listed source line.
+    /// Instruction costs add up: multiple instructions on the same line
+    /// report their total latency and reciprocal throughput.
+    /// @param sect         section
+    /// @param line         source line (see Object::getListLine())
+    /// @param cost         estimated cost (output)
+    /// @return False if the line has no instructions.
+    virtual bool getLineCost(const Section& sect,
+                             SourceLocation line,
+                             InsnCost* cost) const;
+
+    /// Get the DWARF register number of a register, as used in call frame
+    /// information.  The numbering may depend on the current mode.  The
+    /// default implementation has no DWARF register numbers.
+    /// @param reg          register
+    /// @return DWARF register number, or -1 if the register has none.
+    virtual int getDwarfRegNum(const Register& reg) const;
+
+    /// Get the lookup generation.  This changes whenever the results of
+    /// ParseCheckInsnPrefix() or ParseCheckRegTmod() may have changed (e.g.
+    /// due to a mode or CPU change), so callers that cache lookup results
+    /// should redo the lookup when it differs from the cached value.
+    /// @return Lookup generation.
+    unsigned int getLookupGeneration() const { return m_lookup_gen; }
+
+protected:
+    /// Invalidate cached lookup results.  Implementations should call this
+    /// whenever state used by ParseCheckInsnPrefix() or ParseCheckRegTmod()
+    /// changes.
+    void InvalidateLookups() { ++m_lookup_gen; }
+
 private:
     Arch(const Arch&);                  // not implemented
     const Arch& operator=(const Arch&); // not implemented
 
     const ArchModule& m_module;
+    unsigned int m_lookup_gen;  ///< Lookup generation
 };
 
 /// Arch module interface.
@@ -29,9 +29,14 @@
 /// POSSIBILITY OF SUCH DAMAGE.
 /// @endlicense
 ///
+#include <string>
+#include <vector>
+
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Support/DataTypes.h"
 #include "yasmx/Basic/LLVM.h"
 #include "yasmx/Config/export.h"
+#include "yasmx/Support/ptr_vector.h"
 #include "yasmx/Support/scoped_ptr.h"
 
 
@@ -42,9 +47,11 @@ namespace yasm
 
 class Arch;
 class ArchModule;
+struct CodeFixup;
 class DebugFormat;
 class DebugFormatModule;
 class DiagnosticsEngine;
+class FileEntry;
 class FileManager;
 class HeaderSearch;
 class ListFormat;
@@ -52,10 +59,30 @@ class ListFormatModule;
 class Object;
 class ObjectFormat;
 class ObjectFormatModule;
+class OutputFileStream;
 class Parser;
 class ParserModule;
 class SourceManager;
 
+/// Cache of what parsing pieces of a source produced, for
+/// Assembler::setPieceCache().
+class YASM_LIB_EXPORT PieceCache
+{
+public:
+    virtual ~PieceCache();
+
+    /// Look up a piece record.
+    /// @param key          piece key
+    /// @param data         record (output)
+    /// @return True if the key was found.
+    virtual bool FetchPiece(StringRef key, std::string& data) = 0;
+
+    /// Add a piece record, replacing any with the same key.
+    /// @param key          piece key
+    /// @param data         record
+    virtual void StorePiece(StringRef key, StringRef data) = 0;
+};
+
 /// An assembler.
 class YASM_LIB_EXPORT Assembler
 {
@@ -69,13 +96,19 @@ public:
         DUMP_AFTER_OUTPUT
     };
 
+    enum ObjectDumpFormat
+    {
+        DUMP_XML = 0,           ///< XML document (requires WITH_XML)
+        DUMP_JSON               ///< JSON lines, streamed as written
+    };
+
     /// Constructor.  A default section is created as the first
     /// section, and an empty symbol table is created.
     /// The object filename is initially unset (empty string).
     /// @param arch_keyword     architecture keyword
     /// @param objfmt_keyword   object format keyword
     /// @param diags            diagnostic reporting
-    /// @param dump_time        when (if ever) to dump object XML to stderr
+    /// @param dump_time        when (if ever) to dump the object to stderr
     Assembler(StringRef arch_keyword,
               StringRef objfmt_keyword,
               DiagnosticsEngine& diags,
@@ -96,6 +129,40 @@ public:
     /// @return False on error.
     bool setMachine(StringRef machine, DiagnosticsEngine& diags);
 
+    /// Set the maximum number of threads to use for assembly.
+    /// @param num_jobs         number of threads; 0 selects the number of
+    ///                         processors
+    void setNumJobs(unsigned int num_jobs) { m_num_jobs = num_jobs; }
+
+    /// Parse pieces of the source on several threads (see setNumJobs())
+    /// when the parser can split the source into pieces that don't depend
+    /// on each other, and the object format can combine them.  Otherwise,
+    /// or if any piece gives a diagnostic, the source is parsed as usual.
+    /// Not done when listing or using a debug format other than "null"
+    /// or "cfi".
+    /// @param enable       true to parse pieces in parallel
+    void setSplitParse(bool enable) { m_split_parse = enable; }
+
+    /// Set a cache for the pieces of a split parse (see setSplitParse()).
+    /// The parser records each piece in it, and a later parse of a piece
+    /// with the same text (and setup lines) replays the record instead of
+    /// parsing all of the piece again.  The source is then split where
+    /// its contents say, so editing part of it leaves the other pieces
+    /// the same.  The cache key doesn't include the options; the cache
+    /// must keep records for different options apart.
+    /// @param cache        piece cache, or NULL for none; not owned
+    void setPieceCache(/*@null@*/ PieceCache* cache) { m_piece_cache = cache; }
+
+    /// Enable timing of each assembly phase.  The report is printed
+    /// (along with any -stats output) when LLVM is shut down.
+    /// @param enable       true to time phases
+    void setTimeReport(bool enable) { m_time_report = enable; }
+
+    /// Set the format of object dumps.  Defaults to XML if built with XML
+    /// support, otherwise JSON lines.
+    /// @param format       dump format
+    void setDumpFormat(ObjectDumpFormat format) { m_dump_format = format; }
+
     /// Set the parser.
     /// @param parser_keyword   parser keyword
     /// @param diags            diagnostic reporting
@@ -121,12 +188,47 @@ public:
     /// @return False on error.
     bool setListFormat(StringRef list_keyword, DiagnosticsEngine& diags);
 
+    /// Register an in-memory source file.  Include directives that resolve
+    /// to this path find the in-memory contents, even if a file by the
+    /// same name exists on disk.  Registering a path again replaces its
+    /// contents.
+    /// @param source_mgr       source manager
+    /// @param filename         path of the file, relative to the current
+    ///                         directory or absolute
+    /// @param contents         file contents (copied)
+    /// @return File entry.
+    const FileEntry* AddVirtualFile(SourceManager& source_mgr,
+                                    StringRef filename,
+                                    StringRef contents);
+
+    /// Load the main file from memory rather than from disk.  The main file
+    /// is registered as with AddVirtualFile(), so the filename is used in
+    /// diagnostics and to determine the default object filename, and
+    /// relative includes are looked up from its directory.
+    /// @param source_mgr       source manager; must not have a main file
+    /// @param filename         path of the main file
+    /// @param source           source text (copied)
+    void setMainSource(SourceManager& source_mgr,
+                       StringRef filename,
+                       StringRef source);
+
     /// Initialize the object for assembly.  Does not read from input file.
     /// @param source_mgr       source manager
     /// @param diags            diagnostic reporting
     /// @return True on success, false on failure.
     bool InitObject(SourceManager& source_mgr, DiagnosticsEngine& diags);
 
+    /// Initialize the object by merging object files of the current object
+    /// format, rather than by assembly; see ObjectFormat::Merge().  Same
+    /// named sections are concatenated in the order given.  Output() may
+    /// then be used to write the merged object.  The object filename
+    /// should be set first.
+    /// @param objects          object file images
+    /// @param diags            diagnostic reporting
+    /// @return True on success, false on failure.
+    bool Merge(const std::vector<StringRef>& objects,
+               DiagnosticsEngine& diags);
+
     /// Initialize parser.  Does not read from input file.
     /// @param source_mgr       source manager
     /// @param diags            diagnostic reporting
@@ -144,11 +246,88 @@ public:
     /// @return True on success, false on failure.
     bool Assemble(SourceManager& source_mgr, DiagnosticsEngine& diags);
 
+    /// Record the CPU features used by the instructions of each section
+    /// (see Arch::getFeatureUsage()) in a ".note.yasm.isa" section, so
+    /// they can be checked in the object file.  The section holds one
+    /// ELF-style note (name "yasm", type 1) whose description is a line
+    /// per section: the section name, the number of instructions, and
+    /// feature=count pairs, separated by spaces.  Call after Assemble().
+    /// @param diags            diagnostic reporting
+    void AddFeatureNote(DiagnosticsEngine& diags);
+
     /// Write assembly results to output file.  Fails if assembly not
     /// performed first.
     /// @param os               output stream
+    /// @param diags            diagnostic reporting
+    /// @param list_os          list file output stream; if non-NULL and a
+    ///                         list format is set, the listing is written
+    ///                         as the object file is output
+    /// @return True on success, false on failure.
+    bool Output(raw_fd_ostream& os,
+                DiagnosticsEngine& diags,
+                raw_ostream* list_os = 0);
+
+    /// Write assembly results to memory rather than a file.  Object
+    /// formats seek and patch within the image as they would a file.
+    /// Fails if assembly not performed first.
+    /// @param image            buffer to receive the object file image
+    ///                         (its previous contents are discarded)
+    /// @param diags            diagnostic reporting
+    /// @param list_os          list file output stream (see above)
+    /// @return True on success, false on failure.
+    bool Output(std::vector<char>& image,
+                DiagnosticsEngine& diags,
+                raw_ostream* list_os = 0);
+
+    /// Write assembly results as machine code ready to run at a given
+    /// address, with no object file container; see
+    /// ObjectFormat::OutputCode().  Only some object formats (e.g. "bin")
+    /// support this.  Fails if assembly not performed first.
+    /// @param base             address the code will be loaded at
+    /// @param image            buffer to receive the code image
+    ///                         (its previous contents are discarded)
+    /// @param fixups           (output) references to external symbols,
+    ///                         to be applied by the caller after copying
+    ///                         the image to base
+    /// @param diags            diagnostic reporting
     /// @return True on success, false on failure.
-    bool Output(raw_fd_ostream& os, DiagnosticsEngine& diags);
+    bool OutputCode(uint64_t base,
+                    std::vector<char>& image,
+                    /*@out@*/ std::vector<CodeFixup>& fixups,
+                    DiagnosticsEngine& diags);
+
+    /// Write assembly results to the object file (see getObjectFilename()),
+    /// unless the file already has exactly the same contents.  In that
+    /// case the file is left untouched, keeping its modification time so
+    /// dependent build steps aren't rerun.  Fails if assembly not
+    /// performed first.
+    /// @param diags            diagnostic reporting
+    /// @param list_os          list file output stream (see Output())
+    /// @param unchanged        set to true if the file was left untouched
+    /// @return True on success, false on failure.
+    bool OutputIfChanged(DiagnosticsEngine& diags,
+                         raw_ostream* list_os = 0,
+                         /*@out@*/ bool* unchanged = 0);
+
+    /// Write a complete object file image to the object file (see
+    /// getObjectFilename()), unless the file already has exactly the same
+    /// contents, as OutputIfChanged() does.  Used for object files that
+    /// were not assembled here, e.g. ones restored from a cache.
+    /// @param image            object file contents
+    /// @param diags            diagnostic reporting
+    /// @param unchanged        set to true if the file was left untouched
+    /// @return True on success, false on failure.
+    bool WriteObjectIfChanged(StringRef image,
+                              DiagnosticsEngine& diags,
+                              /*@out@*/ bool* unchanged = 0);
+
+    /// Prepare to assemble another source file.  The object, parser,
+    /// and object, debug, and list formats from the previous assembly are
+    /// released and the object filename is cleared; the loaded modules, the
+    /// architecture (with its instruction lookup caches), and all other
+    /// settings are kept.  The source manager's file IDs must be cleared
+    /// separately before loading the next main file.
+    void Reset();
 
     /// Get the object.  Returns 0 until after InitObject() is called.
     /// @return Object.
@@ -166,6 +345,19 @@ private:
     Assembler(const Assembler&);                    // not implemented
     const Assembler& operator=(const Assembler&);   // not implemented
 
+    void DumpObject(ObjectDumpTime dump_time) const;
+    bool CreateObject(StringRef src_filename,
+                      bool default_section,
+                      DiagnosticsEngine& diags);
+    const FileEntry* AddVirtualFileAs(SourceManager& source_mgr,
+                                      StringRef path,
+                                      StringRef contents);
+    bool Output(OutputFileStream& file_os,
+                DiagnosticsEngine& diags,
+                raw_ostream* list_os);
+    bool ParsePieces(SourceManager& source_mgr, DiagnosticsEngine& diags);
+    void ClearPieces();
+
     util::scoped_ptr<ArchModule> m_arch_module;
     util::scoped_ptr<ParserModule> m_parser_module;
     util::scoped_ptr<ObjectFormatModule> m_objfmt_module;
@@ -178,11 +370,23 @@ private:
     util::scoped_ptr<DebugFormat> m_dbgfmt;
     util::scoped_ptr<ListFormat> m_listfmt;
 
+    /// Pieces of the source parsed by ParsePieces().  Their contents are
+    /// moved into the object, but they keep the memory, so they're
+    /// destroyed after it.
+    struct Piece;
+    stdx::ptr_vector<Piece> m_pieces;
+    stdx::ptr_vector_owner<Piece> m_pieces_owner;
+
     util::scoped_ptr<Object> m_object;
 
     std::string m_obj_filename;
     std::string m_machine;
     Assembler::ObjectDumpTime m_dump_time;
+    Assembler::ObjectDumpFormat m_dump_format;
+    unsigned int m_num_jobs;
+    bool m_split_parse;
+    PieceCache* m_piece_cache;
+    bool m_time_report;
 };
 
 } // namespace yasm
@@ -30,8 +30,8 @@
 /// @endlicense
 ///
 #include <memory>
+#include <vector>
 
-#include "llvm/ADT/SmallVector.h"
 #include "yasmx/Config/export.h"
 #include "yasmx/DebugDumper.h"
 
@@ -48,6 +48,11 @@ public:
     /// Destructor.
     virtual ~AssocData();
 
+    /// Whether the data is stored in the container's inline slot.  Derived
+    /// classes that are looked up often (e.g. the object format's per-symbol
+    /// and per-section data) redefine this to true.
+    static const bool inline_slot = false;
+
 #ifdef WITH_XML
     /// Write an XML representation.  For debugging purposes.
     /// @param out          XML node
@@ -60,7 +65,9 @@ private:
     const AssocData& operator=(const AssocData&);   // not implemented
 };
 
-/// Associated data container.
+/// Associated data container.  One piece of data (the first added with
+/// inline_slot set) is kept in an inline slot, so finding it is a single
+/// comparison; other data is kept in a map searched linearly.
 class YASM_LIB_EXPORT AssocDataContainer
 {
     struct AssocMapEntry
@@ -68,23 +75,53 @@ class YASM_LIB_EXPORT AssocDataContainer
         const void* key;
         AssocData* value;
     };
-    typedef llvm::SmallVector<AssocMapEntry, 1> AssocMap;
+    typedef std::vector<AssocMapEntry> AssocMap;
+
+    const void* m_slot_key;
+    AssocData* m_slot;
     AssocMap m_assoc_map;
 
 public:
     AssocDataContainer();
     virtual ~AssocDataContainer();
 
+    /// Add data, replacing any data with the same key.
+    /// @param key          key
+    /// @param data         data
+    /// @param inline_slot  if true, store in the inline slot if available
+    /// @return Previous data for key, if any.
     std::auto_ptr<AssocData> AddAssocData(const void* key,
-                                          std::auto_ptr<AssocData> data);
+                                          std::auto_ptr<AssocData> data,
+                                          bool inline_slot = false);
+
+    /// Determine if all data of another container can be moved into this
+    /// one, i.e. if no key has data in both.
+    /// @param from         container to move data from
+    bool canMoveAssocData(const AssocDataContainer& from) const;
 
-    AssocData* getAssocData(const void* key);
-    const AssocData* getAssocData(const void* key) const;
+    /// Move all data from another container, leaving it empty.
+    /// canMoveAssocData() must be true.
+    /// @param from         container to move data from
+    void MoveAssocData(AssocDataContainer& from);
+
+    AssocData* getAssocData(const void* key)
+    {
+        if (key == m_slot_key)
+            return m_slot;
+        return FindAssocData(key);
+    }
+    const AssocData* getAssocData(const void* key) const
+    {
+        if (key == m_slot_key)
+            return m_slot;
+        return FindAssocData(key);
+    }
 
     template <typename T>
     std::auto_ptr<AssocData> AddAssocData(std::auto_ptr<T> data)
     {
-        return AddAssocData(T::key, std::auto_ptr<AssocData>(data.release()));
+        return AddAssocData(T::key, std::auto_ptr<AssocData>(data.release()),
+                            T::inline_slot);
     }
 
     template <typename T>
@@ -104,6 +141,9 @@ public:
     /// @return Root node.
     virtual pugi::xml_node Write(pugi::xml_node out) const = 0;
 #endif // WITH_XML
+
+private:
+    AssocData* FindAssocData(const void* key) const;
 };
 
 } // namespace yasm
@@ -192,6 +192,21 @@ YASM_LIB_EXPORT
 bool ConvertUTF8toWide(unsigned WideCharWidth, llvm::StringRef Source,
                        char *&ResultPtr);
 
+/**
+ * Convert an UTF8 StringRef to UTF16 or UTF32 code units (depending on
+ * WideCharWidth) in the given byte order.  Runs of ASCII are widened
+ * directly; other characters go through ConvertUTF8toUTF32().  The result is
+ * written to ResultPtr, which needs no alignment and must point to at least
+ * WideCharWidth * Source.size() bytes.  Source may itself lie within that
+ * buffer, provided it starts at least (WideCharWidth - 1) * Source.size()
+ * bytes past ResultPtr.  On success, ResultPtr will point one after the end
+ * of the converted string.
+ * \return true on success, false on illegal or truncated UTF8.
+ */
+YASM_LIB_EXPORT
+bool ConvertUTF8toWideUnits(unsigned WideCharWidth, bool BigEndian,
+                            llvm::StringRef Source, char *&ResultPtr);
+
 /**
  * Convert an Unicode code point to UTF8 sequence.
  *
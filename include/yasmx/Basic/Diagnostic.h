@@ -623,6 +623,13 @@ public:
 
   void Report(const StoredDiagnostic &storedDiag);
 
+  /// \brief Issue a stored diagnostic as though it had been reported here.
+  ///
+  /// Unlike Report(const StoredDiagnostic&), the level is decided by this
+  /// engine (e.g. for -Werror), and the diagnostic is subject to its error
+  /// limit and fatal error suppression.
+  void Replay(const StoredDiagnostic &storedDiag);
+
   /// \brief Determine whethere there is already a diagnostic in flight.
   bool isDiagnosticInFlight() const { return CurDiagID != ~0U; }
 
@@ -651,12 +658,18 @@ public:
                             StringRef Arg2 = "");
   
   /// \brief Clear out the current diagnostic.
-  void Clear() { CurDiagID = ~0U; }
+  void Clear() {
+    CurDiagID = ~0U;
+    CurDiagMessage = StringRef();
+  }
 
 private:
   /// \brief Report the delayed diagnostic.
   void ReportDelayed();
 
+  /// \brief Make a stored diagnostic the one in flight.
+  void SetCurrentDiagnostic(const StoredDiagnostic &storedDiag);
+
   // This is private state used by DiagnosticBuilder.  We put it here instead of
   // in DiagnosticBuilder in order to keep DiagnosticBuilder a small lightweight
   // object.  This implementation choice means that we can only have one
@@ -677,6 +690,10 @@ private:
   /// This is set to ~0U when there is no diagnostic in flight.
   unsigned CurDiagID;
 
+  /// \brief The already formatted message of the current diagnostic, if it
+  /// is being replayed.
+  StringRef CurDiagMessage;
+
   enum {
     /// \brief The maximum number of arguments we can hold.
     ///
@@ -1052,7 +1069,8 @@ class YASM_LIB_EXPORT Diagnostic {
   const DiagnosticsEngine *DiagObj;
   StringRef StoredDiagMessage;
 public:
-  explicit Diagnostic(const DiagnosticsEngine *DO) : DiagObj(DO) {}
+  explicit Diagnostic(const DiagnosticsEngine *DO)
+    : DiagObj(DO), StoredDiagMessage(DO->CurDiagMessage) {}
   Diagnostic(const DiagnosticsEngine *DO, StringRef storedDiagMessage)
     : DiagObj(DO), StoredDiagMessage(storedDiagMessage) {}
 
@@ -1285,6 +1303,56 @@ class IgnoringDiagConsumer : public DiagnosticConsumer {
   }
 };
 
+/// \brief A diagnostic client that saves all diagnostics so they can be
+/// replayed later (e.g. in a deterministic order after parallel work).
+class YASM_LIB_EXPORT StoredDiagnosticConsumer : public DiagnosticConsumer {
+  std::vector<StoredDiagnostic> &StoredDiags;
+
+public:
+  explicit StoredDiagnosticConsumer(std::vector<StoredDiagnostic> &StoredDiags)
+    : StoredDiags(StoredDiags) { }
+  ~StoredDiagnosticConsumer();
+
+  void HandleDiagnostic(DiagnosticsEngine::Level DiagLevel,
+                        const Diagnostic &Info);
+  DiagnosticConsumer *clone(DiagnosticsEngine &Diags) const {
+    return new StoredDiagnosticConsumer(StoredDiags);
+  }
+
+  /// \brief Report saved diagnostics to \p Diags in order, letting it decide
+  /// their final severity.
+  static void Replay(DiagnosticsEngine &Diags,
+                     const std::vector<StoredDiagnostic> &StoredDiags);
+};
+
+/// \brief A diagnostics engine for work done on another thread, which saves
+/// its diagnostics to be replayed to the main engine afterwards, in a
+/// deterministic order.
+///
+/// Create it on the main engine's thread, as DiagnosticIDs is not reference
+/// counted in a thread-safe manner; the engine may then be used by any one
+/// thread at a time.
+class YASM_LIB_EXPORT DiagnosticBuffer {
+  std::vector<StoredDiagnostic> StoredDiags;
+  DiagnosticsEngine Diags;
+
+  DiagnosticBuffer(const DiagnosticBuffer &); // DO NOT IMPLEMENT
+  void operator=(const DiagnosticBuffer &);   // DO NOT IMPLEMENT
+
+public:
+  /// \param Parent engine to share diagnostic IDs and source manager with
+  explicit DiagnosticBuffer(const DiagnosticsEngine &Parent);
+  ~DiagnosticBuffer();
+
+  DiagnosticsEngine &getDiagnostics() { return Diags; }
+
+  /// \brief Determine if there are no saved diagnostics.
+  bool empty() const { return StoredDiags.empty(); }
+
+  /// \brief Replay the saved diagnostics to \p Parent and clear them.
+  void Replay(DiagnosticsEngine &Parent);
+};
+
 /// Special character that the diagnostic printer will use to toggle the bold
 /// attribute.  The character itself will be not be printed.
 const char ToggleHighlight = 127;
@@ -27,6 +27,8 @@
 #include "yasmx/Config/export.h"
 // FIXME: Enhance libsystem to support inode and other fields in stat.
 #include <sys/types.h>
+#include <string>
+#include <vector>
 
 #ifdef _MSC_VER
 typedef unsigned short mode_t;
@@ -41,6 +43,7 @@ namespace sys { class Path; }
 
 namespace yasm {
 class FileManager;
+class FilePrefetcher;
 class FileSystemStatCache;
 
 /// \brief Cached information about one directory (either on disk or in
@@ -161,6 +164,10 @@ class YASM_LIB_EXPORT FileManager : public RefCountedBase<FileManager> {
   // Caching.
   OwningPtr<FileSystemStatCache> StatCache;
 
+  /// \brief Background reader for prefetchFile(); null if threads are not
+  /// available.
+  OwningPtr<FilePrefetcher> Prefetcher;
+
   bool getStatValue(const char *Path, struct stat &StatBuf,
                     int *FileDescriptor);
 
@@ -231,6 +238,16 @@ public:
   llvm::MemoryBuffer *getBufferForFile(StringRef Filename,
                                        std::string *ErrorStr = 0);
 
+  /// \brief Start reading the first of several candidate files that exists
+  /// on a background thread, so a later getBufferForFile() for it doesn't
+  /// wait on the file system.  May be called from any thread.
+  ///
+  /// \param Paths candidate paths, in search order.
+  ///
+  /// \param Keep if false, the file is only read through into the operating
+  /// system's cache, for files that are opened without the FileManager.
+  void prefetchFile(const std::vector<std::string> &Paths, bool Keep = true);
+
   /// \brief Get the 'stat' information for the given \p Path.
   ///
   /// If the path is relative, it will be resolved against the WorkingDir of the
@@ -250,6 +267,10 @@ public:
   void GetUniqueIDMapping(
                     SmallVectorImpl<const FileEntry *> &UIDToFiles) const;
 
+  /// \brief Get the paths of all files that were looked up and found not
+  /// to exist.
+  void GetNonExistentFiles(SmallVectorImpl<StringRef> &Paths) const;
+
   /// \brief Modifies the size and modification time of a previously created
   /// FileEntry. Use with caution.
   static void modifyFileEntry(FileEntry *File, off_t Size,
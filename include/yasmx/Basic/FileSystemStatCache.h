@@ -19,6 +19,8 @@
 #include "llvm/ADT/StringMap.h"
 #include "yasmx/Basic/LLVM.h"
 #include "yasmx/Config/export.h"
+#include <ctime>
+#include <string>
 #include <sys/types.h>
 #include <sys/stat.h>
 
@@ -101,6 +103,51 @@ public:
                                int *FileDescriptor);
 };
 
+/// \brief A stat cache that remembers which files don't exist, and can be
+/// saved and loaded so later runs skip the failed lookups (e.g. of an include
+/// file in each of a long list of search directories).
+///
+/// Each missing file is recorded along with the modification time of its
+/// directory, and is only trusted while the directory is unchanged; creating
+/// a file in a directory updates the directory's modification time.
+/// Existing files are always looked up on the file system.
+class YASM_LIB_EXPORT PersistentStatCache : public FileSystemStatCache {
+  struct DirInfo {
+    time_t MTime;       ///< Modification time of the directory.
+    bool Checked;       ///< Whether the directory has been checked this run.
+    bool Trusted;       ///< Whether Missing is known to be current.
+    llvm::StringMap<char> Missing;  ///< Names known not to exist.
+
+    DirInfo() : MTime(0), Checked(false), Trusted(false) {}
+  };
+
+  /// Directories, by absolute path.
+  llvm::StringMap<DirInfo> Dirs;
+  /// Current directory, for making paths absolute.
+  std::string CurDir;
+  /// Time the cache was created; directories modified since can't be
+  /// trusted, as a later change might not update the modification time.
+  time_t StartTime;
+  /// Whether there are changes to save.
+  bool Dirty;
+
+  DirInfo &getDirInfo(StringRef Dir);
+
+public:
+  PersistentStatCache();
+
+  /// \brief Load a cache file saved by an earlier run.
+  /// \returns \c true if the file could not be read or is not a cache file.
+  bool load(StringRef Filename);
+
+  /// \brief Save the cache, if it has changed, to a file.
+  /// \returns \c true on error.
+  bool save(StringRef Filename) const;
+
+  virtual LookupResult getStat(const char *Path, struct stat &StatBuf,
+                               int *FileDescriptor);
+};
+
 } // end namespace yasm
 
 #endif
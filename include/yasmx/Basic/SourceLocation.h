@@ -17,8 +17,10 @@
 
 #include "llvm/Support/PointerLikeTypeTraits.h"
 #include "llvm/Support/Compiler.h"
+#include "llvm/Support/DataTypes.h"
 #include "yasmx/Basic/LLVM.h"
 #include "yasmx/Config/export.h"
+#include "yasmx/Config/sourceloc.h"
 #include <utility>
 #include <functional>
 #include <cassert>
@@ -83,15 +85,26 @@ private:
 /// In addition, one bit of SourceLocation is used for quick access to the
 /// information whether the location is in a file or a macro expansion.
 ///
-/// It is important that this type remains small. It is currently 32 bits wide.
+/// It is important that this type remains small. It is 32 bits wide unless
+/// yasm is configured with ENABLE_64BIT_SOURCE_LOCATIONS, which lifts the 2GB
+/// limit on all input buffers and expansions together at the cost of 64-bit
+/// locations.
 class YASM_LIB_EXPORT SourceLocation {
-  unsigned ID;
+public:
+#ifdef YASM_64BIT_SOURCE_LOCATIONS
+  typedef uint64_t UIntTy;
+  typedef int64_t IntTy;
+#else
+  typedef uint32_t UIntTy;
+  typedef int32_t IntTy;
+#endif
+
+private:
+  UIntTy ID;
   friend class SourceManager;
   friend class ASTReader;
   friend class ASTWriter;
-  enum {
-    MacroIDBit = 1U << 31
-  };
+  static const UIntTy MacroIDBit = UIntTy(1) << (8*sizeof(UIntTy) - 1);
 public:
 
   SourceLocation() : ID(0) {}
@@ -109,18 +122,18 @@ public:
 
 private:
   /// \brief Return the offset into the manager's global input view.
-  unsigned getOffset() const {
+  UIntTy getOffset() const {
     return ID & ~MacroIDBit;
   }
 
-  static SourceLocation getFileLoc(unsigned ID) {
+  static SourceLocation getFileLoc(UIntTy ID) {
     assert((ID & MacroIDBit) == 0 && "Ran out of source locations!");
     SourceLocation L;
     L.ID = ID;
     return L;
   }
 
-  static SourceLocation getMacroLoc(unsigned ID) {
+  static SourceLocation getMacroLoc(UIntTy ID) {
     assert((ID & MacroIDBit) == 0 && "Ran out of source locations!");
     SourceLocation L;
     L.ID = MacroIDBit | ID;
@@ -130,7 +143,7 @@ public:
 
   /// \brief Return a source location with the specified offset from this
   /// SourceLocation.
-  SourceLocation getLocWithOffset(int Offset) const {
+  SourceLocation getLocWithOffset(IntTy Offset) const {
     assert(((getOffset()+Offset) & MacroIDBit) == 0 && "offset overflow");
     SourceLocation L;
     L.ID = ID+Offset;
@@ -138,17 +151,17 @@ public:
   }
 
   /// \brief When a SourceLocation itself cannot be used, this returns
-  /// an (opaque) 32-bit integer encoding for it.
+  /// an (opaque) integer encoding for it.
   ///
   /// This should only be passed to SourceLocation::getFromRawEncoding, it
   /// should not be inspected directly.
-  unsigned getRawEncoding() const { return ID; }
+  UIntTy getRawEncoding() const { return ID; }
 
   /// \brief Turn a raw encoding of a SourceLocation object into
   /// a real SourceLocation.
   ///
   /// \see getRawEncoding.
-  static SourceLocation getFromRawEncoding(unsigned Encoding) {
+  static SourceLocation getFromRawEncoding(UIntTy Encoding) {
     SourceLocation X;
     X.ID = Encoding;
     return X;
@@ -168,7 +181,7 @@ public:
   /// getFromPtrEncoding - Turn a pointer encoding of a SourceLocation object
   /// into a real SourceLocation.
   static SourceLocation getFromPtrEncoding(const void *Encoding) {
-    return getFromRawEncoding((unsigned)(uintptr_t)Encoding);
+    return getFromRawEncoding((UIntTy)(uintptr_t)Encoding);
   }
 
   void print(raw_ostream &OS, const SourceManager &SM) const;
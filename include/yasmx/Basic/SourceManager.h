@@ -59,6 +59,7 @@ class SourceManager;
 class FileManager;
 class FileEntry;
 class LineTableInfo;
+struct LineEntry;
 class LangOptions;
 class ASTWriter;
 class ASTReader;
@@ -238,7 +239,7 @@ namespace SrcMgr {
     /// \brief The location of the \#include that brought in this file.
     ///
     /// This is an invalid SLOC for the main file (top of the \#include chain).
-    unsigned IncludeLoc;  // Really a SourceLocation
+    SourceLocation::UIntTy IncludeLoc;  // Really a SourceLocation
 
     /// \brief Number of FileIDs (files and macros) that were created during
     /// preprocessing of this \#include, including this SLocEntry.
@@ -295,7 +296,7 @@ namespace SrcMgr {
     // Really these are all SourceLocations.
 
     /// \brief Where the spelling for the token can be found.
-    unsigned SpellingLoc;
+    SourceLocation::UIntTy SpellingLoc;
 
     /// In a macro expansion, ExpansionLocStart and ExpansionLocEnd
     /// indicate the start and end of the expansion. In object-like macros,
@@ -303,7 +304,7 @@ namespace SrcMgr {
     /// will be the identifier and the end will be the ')'. Finally, in
     /// macro-argument instantiations, the end will be 'SourceLocation()', an
     /// invalid location.
-    unsigned ExpansionLocStart, ExpansionLocEnd;
+    SourceLocation::UIntTy ExpansionLocStart, ExpansionLocEnd;
 
   public:
     SourceLocation getSpellingLoc() const {
@@ -381,13 +382,13 @@ namespace SrcMgr {
   /// SourceManager keeps an array of these objects, and they are uniquely
   /// identified by the FileID datatype.
   class SLocEntry {
-    unsigned Offset;   // low bit is set for expansion info.
+    SourceLocation::UIntTy Offset;   // low bit is set for expansion info.
     union {
       FileInfo File;
       ExpansionInfo Expansion;
     };
   public:
-    unsigned getOffset() const { return Offset >> 1; }
+    SourceLocation::UIntTy getOffset() const { return Offset >> 1; }
 
     bool isExpansion() const { return Offset & 1; }
     bool isFile() const { return !isExpansion(); }
@@ -402,14 +403,15 @@ namespace SrcMgr {
       return Expansion;
     }
 
-    static SLocEntry get(unsigned Offset, const FileInfo &FI) {
+    static SLocEntry get(SourceLocation::UIntTy Offset, const FileInfo &FI) {
       SLocEntry E;
       E.Offset = Offset << 1;
       E.File = FI;
       return E;
     }
 
-    static SLocEntry get(unsigned Offset, const ExpansionInfo &Expansion) {
+    static SLocEntry get(SourceLocation::UIntTy Offset,
+                         const ExpansionInfo &Expansion) {
       SLocEntry E;
       E.Offset = (Offset << 1) | 1;
       E.Expansion = Expansion;
@@ -583,17 +585,18 @@ class YASM_LIB_EXPORT SourceManager : public RefCountedBase<SourceManager> {
   /// \brief The starting offset of the next local SLocEntry.
   ///
   /// This is LocalSLocEntryTable.back().Offset + the size of that entry.
-  unsigned NextLocalOffset;
+  SourceLocation::UIntTy NextLocalOffset;
 
   /// \brief The starting offset of the latest batch of loaded SLocEntries.
   ///
   /// This is LoadedSLocEntryTable.back().Offset, except that that entry might
   /// not have been loaded, so that value would be unknown.
-  unsigned CurrentLoadedOffset;
+  SourceLocation::UIntTy CurrentLoadedOffset;
 
-  /// \brief The highest possible offset is 2^31-1, so CurrentLoadedOffset
-  /// starts at 2^31.
-  static const unsigned MaxLoadedOffset = 1U << 31U;
+  /// \brief The highest possible offset is 2^31-1 (2^63-1 with 64-bit source
+  /// locations), so CurrentLoadedOffset starts at 2^31 (2^63).
+  static const SourceLocation::UIntTy MaxLoadedOffset =
+    SourceLocation::UIntTy(1) << (8*sizeof(SourceLocation::UIntTy) - 1);
 
   /// \brief A bitmap that indicates whether the entries of LoadedSLocEntryTable
   /// have already been loaded from the external source.
@@ -720,7 +723,8 @@ public:
   /// This translates NULL into standard input.
   FileID createFileID(const FileEntry *SourceFile, SourceLocation IncludePos,
                       SrcMgr::CharacteristicKind FileCharacter,
-                      int LoadedID = 0, unsigned LoadedOffset = 0) {
+                      int LoadedID = 0,
+                      SourceLocation::UIntTy LoadedOffset = 0) {
     const SrcMgr::ContentCache *
       IR = getOrCreateContentCache(SourceFile,
                               /*isSystemFile=*/FileCharacter != SrcMgr::C_User);
@@ -733,7 +737,8 @@ public:
   /// This does no caching of the buffer and takes ownership of the
   /// MemoryBuffer, so only pass a MemoryBuffer to this once.
   FileID createFileIDForMemBuffer(const llvm::MemoryBuffer *Buffer,
-                                  int LoadedID = 0, unsigned LoadedOffset = 0,
+                                  int LoadedID = 0,
+                                  SourceLocation::UIntTy LoadedOffset = 0,
                                  SourceLocation IncludeLoc = SourceLocation()) {
     return createFileID(createMemBufferContentCache(Buffer), IncludeLoc,
                         SrcMgr::C_User, LoadedID, LoadedOffset);
@@ -755,7 +760,7 @@ public:
                                     SourceLocation ExpansionLocEnd,
                                     unsigned TokLength,
                                     int LoadedID = 0,
-                                    unsigned LoadedOffset = 0);
+                                    SourceLocation::UIntTy LoadedOffset = 0);
 
   /// \brief Retrieve the memory buffer associated with the given file.
   ///
@@ -906,7 +911,7 @@ public:
   /// the entry in SLocEntryTable which contains the specified location.
   ///
   FileID getFileID(SourceLocation SpellingLoc) const {
-    unsigned SLocOffset = SpellingLoc.getOffset();
+    SourceLocation::UIntTy SLocOffset = SpellingLoc.getOffset();
 
     // If our one-entry cache covers this offset, just return it.
     if (isOffsetInFileID(LastFileIDLookup, SLocOffset))
@@ -930,7 +935,7 @@ public:
     if (Invalid || !Entry.isFile())
       return SourceLocation();
 
-    unsigned FileOffset = Entry.getOffset();
+    SourceLocation::UIntTy FileOffset = Entry.getOffset();
     return SourceLocation::getFileLoc(FileOffset);
   }
   
@@ -942,7 +947,7 @@ public:
     if (Invalid || !Entry.isFile())
       return SourceLocation();
     
-    unsigned FileOffset = Entry.getOffset();
+    SourceLocation::UIntTy FileOffset = Entry.getOffset();
     return SourceLocation::getFileLoc(FileOffset + getFileIDSize(FID) - 1);
   }
 
@@ -1086,9 +1091,9 @@ public:
             (Start.getOffset() >= CurrentLoadedOffset &&
                 Start.getOffset()+Length < MaxLoadedOffset)) &&
            "Chunk is not valid SLoc address space");
-    unsigned LocOffs = Loc.getOffset();
-    unsigned BeginOffs = Start.getOffset();
-    unsigned EndOffs = BeginOffs + Length;
+    SourceLocation::UIntTy LocOffs = Loc.getOffset();
+    SourceLocation::UIntTy BeginOffs = Start.getOffset();
+    SourceLocation::UIntTy EndOffs = BeginOffs + Length;
     if (LocOffs >= BeginOffs && LocOffs < EndOffs) {
       if (RelativeOffset)
         *RelativeOffset = LocOffs - BeginOffs;
@@ -1104,8 +1109,8 @@ public:
   /// If it's true and \p RelativeOffset is non-null, it will be set to the
   /// offset of \p RHS relative to \p LHS.
   bool isInSameSLocAddrSpace(SourceLocation LHS, SourceLocation RHS,
-                             int *RelativeOffset) const {
-    unsigned LHSOffs = LHS.getOffset(), RHSOffs = RHS.getOffset();
+                             SourceLocation::IntTy *RelativeOffset) const {
+    SourceLocation::UIntTy LHSOffs = LHS.getOffset(), RHSOffs = RHS.getOffset();
     bool LHSLoaded = LHSOffs >= CurrentLoadedOffset;
     bool RHSLoaded = RHSOffs >= CurrentLoadedOffset;
 
@@ -1221,7 +1226,7 @@ public:
   /// of FileID) to \p relativeOffset.
   bool isInFileID(SourceLocation Loc, FileID FID,
                   unsigned *RelativeOffset = 0) const {
-    unsigned Offs = Loc.getOffset();
+    SourceLocation::UIntTy Offs = Loc.getOffset();
     if (isOffsetInFileID(FID, Offs)) {
       if (RelativeOffset)
         *RelativeOffset = Offs - getSLocEntry(FID).getOffset();
@@ -1243,7 +1248,8 @@ public:
   /// specified by Loc.
   ///
   /// If FilenameID is -1, it is considered to be unspecified.
-  void AddLineNote(SourceLocation Loc, unsigned LineNo, int FilenameID);
+  void AddLineNote(SourceLocation Loc, unsigned LineNo, int FilenameID,
+                   unsigned LineInc = 1);
   void AddLineNote(SourceLocation Loc, unsigned LineNo, int FilenameID,
                    bool IsFileEntry, bool IsFileExit,
                    bool IsSystemHeader, bool IsExternCHeader);
@@ -1328,8 +1334,9 @@ public:
   /// offset in the "source location address space".
   ///
   /// Note that we always consider source locations loaded from
-  bool isBeforeInSLocAddrSpace(SourceLocation LHS, unsigned RHS) const {
-    unsigned LHSOffset = LHS.getOffset();
+  bool isBeforeInSLocAddrSpace(SourceLocation LHS,
+                               SourceLocation::UIntTy RHS) const {
+    SourceLocation::UIntTy LHSOffset = LHS.getOffset();
     bool LHSLoaded = LHSOffset >= CurrentLoadedOffset;
     bool RHSLoaded = RHS >= CurrentLoadedOffset;
     if (LHSLoaded == RHSLoaded)
@@ -1381,7 +1388,9 @@ public:
     return getSLocEntryByID(FID.ID);
   }
 
-  unsigned getNextLocalOffset() const { return NextLocalOffset; }
+  SourceLocation::UIntTy getNextLocalOffset() const {
+    return NextLocalOffset;
+  }
 
   void setExternalSLocEntrySource(ExternalSLocEntrySource *Source) {
     assert(LoadedSLocEntryTable.empty() &&
@@ -1395,8 +1404,9 @@ public:
   /// NumSLocEntries will be allocated, which occupy a total of TotalSize space
   /// in the global source view. The lowest ID and the base offset of the
   /// entries will be returned.
-  std::pair<int, unsigned>
-  AllocateLoadedSLocEntries(unsigned NumSLocEntries, unsigned TotalSize);
+  std::pair<int, SourceLocation::UIntTy>
+  AllocateLoadedSLocEntries(unsigned NumSLocEntries,
+                            SourceLocation::UIntTy TotalSize);
 
   /// \brief Returns true if \p Loc came from a PCH/Module.
   bool isLoadedSourceLocation(SourceLocation Loc) const {
@@ -1499,14 +1509,16 @@ private:
 
   /// Implements the common elements of storing an expansion info struct into
   /// the SLocEntry table and producing a source location that refers to it.
-  SourceLocation createExpansionLocImpl(const SrcMgr::ExpansionInfo &Expansion,
-                                        unsigned TokLength,
-                                        int LoadedID = 0,
-                                        unsigned LoadedOffset = 0);
+  SourceLocation
+  createExpansionLocImpl(const SrcMgr::ExpansionInfo &Expansion,
+                         unsigned TokLength,
+                         int LoadedID = 0,
+                         SourceLocation::UIntTy LoadedOffset = 0);
 
   /// \brief Return true if the specified FileID contains the
   /// specified SourceLocation offset.  This is a very hot method.
-  inline bool isOffsetInFileID(FileID FID, unsigned SLocOffset) const {
+  inline bool isOffsetInFileID(FileID FID,
+                               SourceLocation::UIntTy SLocOffset) const {
     const SrcMgr::SLocEntry &Entry = getSLocEntry(FID);
     // If the entry is after the offset, it can't contain it.
     if (SLocOffset < Entry.getOffset()) return false;
@@ -1532,7 +1544,7 @@ private:
   FileID createFileID(const SrcMgr::ContentCache* File,
                       SourceLocation IncludePos,
                       SrcMgr::CharacteristicKind DirCharacter,
-                      int LoadedID, unsigned LoadedOffset);
+                      int LoadedID, SourceLocation::UIntTy LoadedOffset);
 
   const SrcMgr::ContentCache *
     getOrCreateContentCache(const FileEntry *SourceFile,
@@ -1542,9 +1554,9 @@ private:
   const SrcMgr::ContentCache*
   createMemBufferContentCache(const llvm::MemoryBuffer *Buf);
 
-  FileID getFileIDSlow(unsigned SLocOffset) const;
-  FileID getFileIDLocal(unsigned SLocOffset) const;
-  FileID getFileIDLoaded(unsigned SLocOffset) const;
+  FileID getFileIDSlow(SourceLocation::UIntTy SLocOffset) const;
+  FileID getFileIDLocal(SourceLocation::UIntTy SLocOffset) const;
+  FileID getFileIDLoaded(SourceLocation::UIntTy SLocOffset) const;
 
   SourceLocation getExpansionLocSlowCase(SourceLocation Loc) const;
   SourceLocation getSpellingLocSlowCase(SourceLocation Loc) const;
@@ -1559,6 +1571,64 @@ private:
 
   friend class ASTReader;
   friend class ASTWriter;
+  friend class SourceLineCursor;
+};
+
+/// \brief Maps source locations to presumed locations for a caller that
+/// visits them mostly in increasing order, such as a walk over the
+/// bytecodes of a section.
+///
+/// SourceManager::getPresumedLoc() searches for the line and any line
+/// directive on every call.  The cursor keeps its position in the current
+/// file's line table and line directives instead, so moving forward a line
+/// at a time is amortized constant time; only going backwards, skipping
+/// far ahead, or changing files searches.
+///
+/// The source manager must not gain files or line directives while the
+/// cursor is in use.
+class YASM_LIB_EXPORT SourceLineCursor {
+  const SourceManager &SM;
+
+  /// \brief The current file, and its name and include location before
+  /// any line directive.
+  FileID FID;
+  const char *FileName;
+  SourceLocation FileIncludeLoc;
+
+  /// \brief The current file's text, and offsets of the start of each line.
+  const char *Buf;
+  const char *BufEnd;
+  const unsigned *LineStarts;
+  unsigned NumLines;
+
+  /// \brief Index of the current line in LineStarts.
+  unsigned Line;
+
+  /// \brief The current file's line directives (null if none), and the
+  /// current position in them (Entry == Entries if before the first).
+  const LineEntry *Entries;
+  const LineEntry *EntriesEnd;
+  const LineEntry *Entry;
+
+  /// \brief Physical line number of the last line directive before the
+  /// current line.
+  unsigned EntryLine;
+
+  bool setFile(FileID NewFID);
+  void seekLine(unsigned Offset);
+  void seekEntry(unsigned Offset);
+
+public:
+  explicit SourceLineCursor(const SourceManager &SM);
+
+  /// \brief Get the presumed location of \p Loc, as
+  /// SourceManager::getPresumedLoc() would.
+  PresumedLoc getPresumedLoc(SourceLocation Loc);
+
+  /// \brief Get the text (without terminator) of the line of the location
+  /// last passed to getPresumedLoc().  The text points into the source
+  /// buffer, so its data pointer identifies the line.
+  StringRef getLineText() const;
 };
 
 /// \brief Comparison function object.
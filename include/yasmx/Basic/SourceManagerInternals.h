@@ -47,15 +47,21 @@ struct LineEntry {
   /// If this is 0 then there is no virtual \#includer.
   unsigned IncludeOffset;
 
+  /// \brief The presumed line increment for each physical line following
+  /// the entry: 0 for NASM's %line 4+0, which places all following lines
+  /// (e.g. a macro expansion) on the same line.
+  unsigned LineInc;
+
   static LineEntry get(unsigned Offs, unsigned Line, int Filename,
                        SrcMgr::CharacteristicKind FileKind,
-                       unsigned IncludeOffset) {
+                       unsigned IncludeOffset, unsigned LineInc = 1) {
     LineEntry E;
     E.FileOffset = Offs;
     E.LineNo = Line;
     E.FilenameID = Filename;
     E.FileKind = FileKind;
     E.IncludeOffset = IncludeOffset;
+    E.LineInc = LineInc;
     return E;
   }
 };
@@ -108,7 +114,7 @@ public:
   unsigned getNumFilenames() const { return FilenamesByID.size(); }
 
   void AddLineNote(FileID FID, unsigned Offset,
-                   unsigned LineNo, int FilenameID);
+                   unsigned LineNo, int FilenameID, unsigned LineInc = 1);
   void AddLineNote(FileID FID, unsigned Offset,
                    unsigned LineNo, int FilenameID,
                    unsigned EntryExit, SrcMgr::CharacteristicKind FileKind);
@@ -119,6 +125,17 @@ public:
   /// If there is no line entry before \p Offset in \p FID, returns null.
   const LineEntry *FindNearestLineEntry(FileID FID, unsigned Offset);
 
+  /// \brief Get the line entries for \p FID, sorted by offset.
+  ///
+  /// Returns null if there are none.
+  const std::vector<LineEntry> *getLineEntries(FileID FID) const {
+    std::map<FileID, std::vector<LineEntry> >::const_iterator I =
+      LineEntries.find(FID);
+    if (I == LineEntries.end() || I->second.empty())
+      return 0;
+    return &I->second;
+  }
+
   // Low-level access
   typedef std::map<FileID, std::vector<LineEntry> >::iterator iterator;
   iterator begin() { return LineEntries.begin(); }
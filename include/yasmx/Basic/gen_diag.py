@@ -220,11 +220,27 @@ add_fatal("fatal_file_open", "could not open file '%0'")
 add_fatal("fatal_standard_modules", "could not load standard modules")
 add_warning("warn_plugin_load", "could not load plugin '%0'")
 add_fatal("fatal_no_input_files", "no input files specified")
+add_fatal("fatal_preproc_only_unsupported",
+          "parser '%0' does not support preprocessing only")
+add_fatal("fatal_multiple_inputs",
+          "option '%0' cannot be used with multiple input files")
+add_fatal("fatal_objfile_not_directory",
+          "object file output '%0' must be a directory when assembling "
+          "multiple input files")
+add_fatal("fatal_multiple_formats",
+          "option '%0' cannot be used with multiple object formats")
+add_fatal("fatal_formats_objfile_not_directory",
+          "object file output '%0' must be a directory when assembling "
+          "for multiple object formats")
+add_fatal("fatal_merge_needs_objfile",
+          "merging objects requires an object file name (-o)")
 add_fatal("fatal_unrecognized_module", "unrecognized %0 '%1'")
 add_warning("warn_unknown_command_line_option",
             "unknown command line argument '%0'; try '-help'")
 add_fatal("fatal_bad_defsym",
           "bad defsym '%0'; format is --defsym name=value")
+add_fatal("fatal_bad_branch_align",
+          "branch alignment boundary '%0' is not a power of 2")
 
 # Source manager
 add_fatal("err_cannot_open_file", "cannot open file '%0': %1")
@@ -232,6 +248,9 @@ add_fatal("err_file_modified",
           "file '%0' modified since it was first processed")
 add_fatal("err_unsupported_bom", "%0 byte order mark detected in '%1', but "
           "encoding is not supported")
+add_fatal("err_sloc_space_too_large",
+          "input too large for source locations; configure yasm with "
+          "ENABLE_64BIT_SOURCE_LOCATIONS")
 
 # yobjdump
 add_error("err_file_open", "could not open file '%0'")
@@ -285,6 +304,7 @@ add_warning("warn_unrecognized_ident", "unrecognized identifier")
 # NASM errors
 add_error("err_non_reserve_in_absolute_section",
           "only RES* allowed within absolute section")
+add_error("err_no_struc", "%0 without matching STRUC or ISTRUC")
 
 # GAS warnings
 add_warning("warn_scale_without_index",
@@ -298,6 +318,18 @@ add_error("err_missing_or_invalid_immediate",
           "missing or invalid immediate expression")
 add_error("err_rept_without_endr", ".rept without matching .endr")
 add_error("err_endr_without_rept", ".endr without matching .rept")
+add_error("err_macro_without_endm", ".macro without matching .endm")
+add_error("err_endm_without_macro", ".endm without matching .macro")
+add_error("err_macro_redefined", "macro '%0' is already defined")
+add_error("err_macro_undefined", "macro '%0' is not defined")
+add_error("err_macro_duplicate_param",
+          "duplicate parameter '%0' in definition of macro '%1'")
+add_error("err_macro_bad_qualifier", "'%0' is not a valid parameter qualifier")
+add_error("err_macro_missing_arg",
+          "missing value for required parameter '%0' of macro '%1'")
+add_error("err_macro_unknown_param", "macro '%0' has no parameter '%1'")
+add_error("err_macro_too_many_args", "too many arguments to macro '%0'")
+add_error("err_macro_too_deep", "macros nested too deeply")
 add_error("err_bad_argument_to_syntax_dir", "bad argument to syntax directive")
 add_warning("warn_popsection_without_pushsection",
             ".popsection without corresponding .pushsection; ignored")
@@ -370,6 +402,10 @@ add_error("err_file_output_seek", "unable to seek on output file",
 add_error("err_file_output_position",
           "could not get file position on output file",
           mapping="FATAL")
+add_error("err_file_output_write", "unable to write output file",
+          mapping="FATAL")
+add_error("err_compression_unsupported",
+          "%0 compression is not supported by this build")
 
 # Align
 add_error("err_align_not_integer", "alignment constraint is not an integer")
@@ -488,6 +524,7 @@ add_error("err_ea_length_unknown",
 
 # Optimizer
 add_error("err_optimizer_circular_reference", "circular reference detected")
+add_note("note_optimizer_circular_member", "also part of circular reference")
 add_error("err_optimizer_secondary_expansion",
           "secondary expansion of an external/complex value")
 
@@ -607,6 +644,7 @@ add_error("err_exponent_has_no_digits", "exponent has no digits")
 add_warning("warn_expected_hex_digit", "expected hex digit after \\x")
 add_error("err_unicode_escape_requires_hex",
           "expected hex digit for Unicode character code (%0 digits required)")
+add_error("err_invalid_utf8_string", "invalid UTF-8 in string passed to %0")
 
 # Preprocessor
 add_error("err_pp_file_not_found", "'%0' file not found", mapping="FATAL")
@@ -624,6 +662,7 @@ add_error("err_pp_cond_not_constant", "non-constant conditional expression")
 
 add_error("err_pp_expected_line", "expected %%line")
 add_fatal("fatal_pp_errors", "preprocessor errors")
+add_fatal("fatal_pp_fatal", "%0")
 
 # Output
 add_warning("warn_nobits_data",
@@ -665,12 +704,16 @@ add_warning("warn_unrecognized_numeric_qualifier",
 add_error("err_loc_option_requires_value", "option %0 requires value")
 
 add_error("err_loc_missing_filename", "file number given but no filename")
+add_warning("warn_split_dwarf_version",
+            "split DWARF requires DWARF version 5; not splitting")
 
 add_error("err_file_number_unassigned", "file number %0 unassigned")
 
 # Object reading
 add_error("err_object_read_not_supported",
           "object format does not support reading")
+add_error("err_object_code_not_supported",
+          "object format does not support code image output")
 add_error("err_object_header_unreadable", "could not read object header")
 add_error("err_not_file_type", "not an %0 file")
 add_error("err_no_section_table", "no section table")
@@ -683,6 +726,14 @@ add_error("err_section_relocs_unreadable", "could not read section '%0' relocs")
 add_error("err_symbol_unreadable", "could not read symbol table entry")
 add_error("err_symbol_entity_size_zero", "symbol table entity size is zero")
 add_error("err_invalid_string_offset", "invalid string table offset")
+add_error("err_object_merge_not_supported",
+          "object format does not support merging objects")
+add_error("err_merge_object_mismatch",
+          "object file does not match the class and machine being merged")
+add_error("err_merge_section_group", "cannot merge section group '%0'")
+add_error("err_merge_compressed", "cannot merge compressed section '%0'")
+add_error("err_merge_section_type",
+          "section '%0' has different types in merged objects")
 
 # Binary object format
 add_error("err_org_too_complex", "ORG expression is too complex")
@@ -744,6 +795,7 @@ add_warning("warn_coff_section_name_length",
             "COFF section names limited to 8 characters: truncating")
 add_warning("warn_coff_no_readonly_sections",
             "standard COFF does not support read-only data sections")
+add_error("err_coff_too_many_sections", "%0 sections, maximum of %1")
 add_warning("warn_nested_def",
             ".def pseudo-op used inside of .def/.endef; ignored")
 add_warning("warn_outside_def",
@@ -780,6 +832,8 @@ add_error("err_offset_out_of_range",
 add_error("err_prologue_too_large", "prologue %0 bytes, must be <256")
 add_error("err_too_many_unwind_codes", "%0 unwind codes, maximum of 255")
 add_note("note_prologue_end", "prologue ended here")
+add_warning("warn_cfi_not_unwindable",
+            "CFI directive has no win64 unwind equivalent; ignored")
 
 # RDF object format
 add_error("err_segment_requires_type",
@@ -30,6 +30,7 @@
 /// @endlicense
 ///
 #include <algorithm>
+#include <cstddef>
 #include <memory>
 #include <vector>
 
@@ -51,6 +52,7 @@ class BytecodeContainer;
 class BytecodeOutput;
 class DiagnosticsEngine;
 class Expr;
+class RecordWriter;
 
 /// A bytecode.
 class YASM_LIB_EXPORT Bytecode
@@ -75,8 +77,8 @@ public:
     typedef TR1::function<void (Bytecode& bc,
                                 int id,
                                 const Value& value,
-                                long neg_thres,
-                                long pos_thres)>
+                                int64_t neg_thres,
+                                int64_t pos_thres)>
         AddSpanFunc;
 
     typedef std::auto_ptr<Bytecode> Ptr;
@@ -92,6 +94,10 @@ public:
         Contents();
         virtual ~Contents();
 
+        /// Allocation is counted for memory statistics.
+        static void* operator new(std::size_t size);
+        static void operator delete(void* ptr, std::size_t size);
+
         /// Finalizes the bytecode after parsing.
         /// Called from Bytecode::Finalize().
         /// @param bc           bytecode
@@ -109,7 +115,7 @@ public:
         /// @return False if an error occurred.
         /// @note May store to bytecode updated expressions.
         virtual bool CalcLen(Bytecode& bc,
-                             /*@out@*/ unsigned long* len,
+                             /*@out@*/ uint64_t* len,
                              const Bytecode::AddSpanFunc& add_span,
                              DiagnosticsEngine& diags)
             = 0;
@@ -137,15 +143,36 @@ public:
         /// @return False if an error occurred.
         /// @note May store to bytecode updated expressions.
         virtual bool Expand(Bytecode& bc,
-                            unsigned long* len,
+                            uint64_t* len,
                             int span,
-                            long old_val,
-                            long new_val,
+                            int64_t old_val,
+                            int64_t new_val,
                             bool* keep,
-                            /*@out@*/ long* neg_thres,
-                            /*@out@*/ long* pos_thres,
+                            /*@out@*/ int64_t* neg_thres,
+                            /*@out@*/ int64_t* pos_thres,
                             DiagnosticsEngine& diags);
 
+        /// Get an upper bound on how much the bytecode length may still
+        /// increase through calls to Expand().  Used by the optimizer to
+        /// retire spans that can't exceed their thresholds.
+        /// The base version returns false (growth not bounded).
+        /// @param bc           bytecode
+        /// @param growth       maximum increase in bytes (output)
+        /// @return False if the growth can't be bounded.
+        virtual bool getMaxGrowth(const Bytecode& bc,
+                                  /*@out@*/ uint64_t* growth) const;
+
+        /// For offset setters, get a period such that moving the bytecode
+        /// by a multiple of it leaves its length unchanged.  Used by the
+        /// optimizer to skip over offset setters that pass a change in
+        /// offset on to the following bytecodes.
+        /// The base version returns false (no period).
+        /// @param bc           bytecode
+        /// @param period       period in bytes, a power of two (output)
+        /// @return False if there is no such period.
+        virtual bool getOffsetPeriod(const Bytecode& bc,
+                                     /*@out@*/ uint64_t* period) const;
+
         /// Output a bytecode.
         /// Called from Bytecode::Output().
         /// @param bc           bytecode
@@ -177,6 +204,13 @@ public:
 
         virtual Contents* clone() const = 0;
 
+        /// Write the contents to a parse record, to be read back by
+        /// Arch::LoadContents().  Only contents that instructions create
+        /// need to support this.  The base version returns false.
+        /// @param out          parse record writer
+        /// @return False if the contents can't be recorded.
+        virtual bool Save(RecordWriter& out) const;
+
 #ifdef WITH_XML
         /// Write an XML representation.  For debugging purposes.
         /// Called by Bytecode::Write(pugi::xml_node).
@@ -234,6 +268,16 @@ public:
     /// Destructor.
     ~Bytecode();
 
+    /// Allocation is counted for memory statistics.
+    static void* operator new(std::size_t size);
+    static void operator delete(void* ptr, std::size_t size);
+
+    /// Placement allocation, for bytecodes constructed in a container's
+    /// arena.  The container counts these itself.
+    static void* operator new(std::size_t size, void* place)
+    { return place; }
+    static void operator delete(void* ptr, void* place) {}
+
     /// Finalize a bytecode after parsing.
     /// @param diags        diagnostic reporting
     /// @return False if an error occurred.
@@ -242,39 +286,39 @@ public:
     /// Get the offset of the bytecode.
     /// @return Offset of the bytecode in bytes.
     /// @warning Only valid /after/ optimization.
-    unsigned long getOffset() const { return m_offset; }
+    uint64_t getOffset() const { return m_offset; }
 
     /// Set the offset of the bytecode.
     /// @internal Should be used by Object::optimize() only.
     /// @param offset       new offset of the bytecode
-    void setOffset(unsigned long offset) { m_offset = offset; }
+    void setOffset(uint64_t offset) { m_offset = offset; }
 
     /// Get the offset of the start of the tail of the bytecode.
     /// @return Offset of the tail in bytes.
-    unsigned long getTailOffset() const { return m_offset + getFixedLen(); }
+    uint64_t getTailOffset() const { return m_offset + getFixedLen(); }
 
     /// Get the offset of the next bytecode (the next bytecode doesn't have to
     /// actually exist).
     /// @return Offset of the next bytecode in bytes.
     /// @warning Only valid /after/ optimization.
-    unsigned long getNextOffset() const
+    uint64_t getNextOffset() const
     { return m_offset + getTotalLen(); }
 
     /// Get the total length of the bytecode.
     /// @return Total length of the bytecode in bytes.
     /// @warning Only valid /after/ optimization.
-    unsigned long getTotalLen() const
-    { return static_cast<unsigned long>(m_fixed.size()) + m_len; }
+    uint64_t getTotalLen() const
+    { return static_cast<uint64_t>(m_fixed.size()) + m_len; }
 
     /// Get the fixed length of the bytecode.
     /// @return Length in bytes.
-    unsigned long getFixedLen() const
-    { return static_cast<unsigned long>(m_fixed.size()); }
+    uint64_t getFixedLen() const
+    { return static_cast<uint64_t>(m_fixed.size()); }
 
     /// Get the tail (dynamic) length of the bytecode.
     /// @return Length of the bytecode in bytes.
     /// @warning Only valid /after/ optimization.
-    unsigned long getTailLen() const { return m_len; }
+    uint64_t getTailLen() const { return m_len; }
 
     /// Resolve EQUs in a bytecode and calculate its minimum size.
     /// Generates dependent bytecode spans for cases where, if the length
@@ -300,13 +344,25 @@ public:
     /// @note May store to bytecode updated expressions and the updated
     ///       length.
     bool Expand(int span,
-                long old_val,
-                long new_val,
+                int64_t old_val,
+                int64_t new_val,
                 bool* keep,
-                /*@out@*/ long* neg_thres,
-                /*@out@*/ long* pos_thres,
+                /*@out@*/ int64_t* neg_thres,
+                /*@out@*/ int64_t* pos_thres,
                 DiagnosticsEngine& diags);
 
+    /// Get an upper bound on how much the bytecode length may still
+    /// increase through calls to Expand().
+    /// @param growth       maximum increase in bytes (output)
+    /// @return False if the growth can't be bounded.
+    bool getMaxGrowth(/*@out@*/ uint64_t* growth) const;
+
+    /// For offset setters, get a period such that moving the bytecode by
+    /// a multiple of it leaves its length unchanged.
+    /// @param period       period in bytes, a power of two (output)
+    /// @return False if there is no such period.
+    bool getOffsetPeriod(/*@out@*/ uint64_t* period) const;
+
     /// Output a bytecode.
     /// @param bc_out       bytecode output interface
     /// @return False if an error occurred.
@@ -321,8 +377,7 @@ public:
     /// @param offset       offset to set this bytecode to
     /// @param diags        diagnostic reporting
     /// @return Offset of next bytecode.
-    unsigned long UpdateOffset(unsigned long offset,
-                               DiagnosticsEngine& diags);
+    uint64_t UpdateOffset(uint64_t offset, DiagnosticsEngine& diags);
 
     SourceLocation getSource() const { return m_source; }
 
@@ -366,6 +421,7 @@ public:
     };
 
     void AppendFixup(const Fixup& fixup) { m_fixed_fixups.push_back(fixup); }
+    const std::vector<Fixup>& getFixups() const { return m_fixed_fixups; }
 
 #ifdef WITH_XML
     /// Write an XML representation.  For debugging purposes.
@@ -375,6 +431,10 @@ public:
 #endif // WITH_XML
 
 private:
+    /// Recalculate the length of an offset-based bytecode for a new offset.
+    /// Out of line so UpdateOffset() stays cheap for everything else.
+    void ExpandOffsetSetter(uint64_t offset, DiagnosticsEngine& diags);
+
     /// Fixed data that comes before the possibly dynamic length data generated
     /// by the implementation-specific tail in m_contents.
     Bytes m_fixed;
@@ -389,14 +449,18 @@ private:
     /*@dependent@*/ BytecodeContainer* m_container;
 
     /// Total length of tail contents (not including multiple copies).
-    unsigned long m_len;
+    uint64_t m_len;
+
+    /// Special classification of m_contents as of the last Transform() or
+    /// CalcLen(), cached so offset updates don't need to visit the contents.
+    Contents::SpecialType m_special;
 
     /// Source location where bytecode tail was defined.
     SourceLocation m_source;
 
     /// Offset of bytecode from beginning of its section.
-    /// 0-based, ~0UL (e.g. all 1 bits) if unknown.
-    unsigned long m_offset;
+    /// 0-based, ~0 (e.g. all 1 bits) if unknown.
+    uint64_t m_offset;
 
     /// Unique integer index of bytecode.  Used during optimization.
     unsigned long m_index;
@@ -410,6 +474,17 @@ Bytecode::operator= (const Bytecode& rhs)
     return *this;
 }
 
+inline uint64_t
+Bytecode::UpdateOffset(uint64_t offset, DiagnosticsEngine& diags)
+{
+    // Only offset setters (align, org) depend on their offset; for all
+    // other bytecodes this is just a running sum of lengths.
+    if (m_special == Contents::SPECIAL_OFFSET)
+        ExpandOffsetSetter(offset, diags);
+    m_offset = offset;
+    return getNextOffset();
+}
+
 inline Bytecode::Contents::SpecialType
 Bytecode::getSpecial() const
 {
@@ -431,6 +506,12 @@ swap(Bytecode::Fixup& left, Bytecode::Fixup& right)
     left.swap(right);
 }
 
+inline uint64_t
+Location::getOffset() const
+{
+    return bc->getOffset() + off;
+}
+
 } // namespace yasm
 
 namespace std
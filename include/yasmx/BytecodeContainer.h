@@ -30,8 +30,11 @@
 /// @endlicense
 ///
 #include <memory>
+#include <vector>
 
+#include "llvm/Support/Allocator.h"
 #include "yasmx/Basic/LLVM.h"
+#include "yasmx/Basic/SourceLocation.h"
 #include "yasmx/Config/export.h"
 #include "yasmx/Support/EndianState.h"
 #include "yasmx/Support/ptr_vector.h"
@@ -48,7 +51,6 @@ class DiagnosticsEngine;
 class Expr;
 class IntNum;
 class Section;
-class SourceLocation;
 
 /// A bytecode container.
 class YASM_LIB_EXPORT BytecodeContainer
@@ -65,15 +67,11 @@ public:
     Section* getSection() { return m_sect; }
     const Section* getSection() const { return m_sect; }
 
-    /// Add bytecode to the end of the container.
-    /// @param bc       bytecode (may be NULL)
-    void AppendBytecode(/*@null@*/ std::auto_ptr<Bytecode> bc);
-
     /// Add gap space to the end of the container.
     /// @param size     number of bytes of gap
     /// @param source   source location
     /// @return Reference to gap bytecode.
-    Bytecode& AppendGap(unsigned long size, SourceLocation source);
+    Bytecode& AppendGap(uint64_t size, SourceLocation source);
 
     /// Start a new bytecode at the end of the container.  Factory function.
     /// @return Reference to new bytecode.
@@ -85,6 +83,12 @@ public:
     /// @return Reference to last bytecode.
     Bytecode& FreshBytecode();
 
+    /// Move all bytecodes of another container to the end of this one,
+    /// leaving the other container empty.  The bytecodes stay in the other
+    /// container's arena, so it must outlive this container.
+    /// @param other        container to take bytecodes from
+    void TakeBytecodes(BytecodeContainer& other);
+
     typedef stdx::ptr_vector<Bytecode>::iterator bc_iterator;
     typedef stdx::ptr_vector<Bytecode>::const_iterator const_bc_iterator;
 
@@ -100,6 +104,32 @@ public:
 
     stdx::ptr_vector<Bytecode>::size_type size() { return m_bcs.size(); }
 
+    /// Start of the output of a source line.  Only recorded while the
+    /// object has a list format or marks lines (see Object::setListLine()).
+    struct LineMark
+    {
+        const Bytecode* bc;     ///< Bytecode the line's output starts in
+        unsigned long offset;   ///< Offset within the bytecode
+        SourceLocation source;  ///< Source line
+    };
+
+    typedef std::vector<LineMark>::const_iterator const_line_iterator;
+
+    const_line_iterator lines_begin() const { return m_lines.begin(); }
+    const_line_iterator lines_end() const { return m_lines.end(); }
+
+    /// Starts of the instructions' output, in container order.  Only
+    /// recorded while the object marks layout (see
+    /// Object::setMarkLayout()).
+    typedef std::vector<Location>::const_iterator const_insn_iterator;
+
+    const_insn_iterator insns_begin() const { return m_insns.begin(); }
+    const_insn_iterator insns_end() const { return m_insns.end(); }
+
+    /// Record the start of an instruction's output, if the object marks
+    /// layout.  Called by Insn::Append() before appending.
+    void MarkInsn();
+
     /// Get location for start of a bytecode container.
     Location getBeginLoc()
     {
@@ -140,11 +170,25 @@ private:
 
     Section* m_sect;        ///< Pointer to parent section
 
+    /// Arena the bytecodes are constructed in.
+    llvm::BumpPtrAllocator m_bc_alloc;
+
     /// The bytecodes for the section's contents.
     stdx::ptr_vector<Bytecode> m_bcs;
-    stdx::ptr_vector_owner<Bytecode> m_bcs_owner;
+
+    /// Record the start of the current listed source line's output, if
+    /// it's not already recorded.
+    /// @param bc           bytecode
+    /// @param offset       offset within bc
+    void MarkLine(const Bytecode& bc, unsigned long offset);
 
     bool m_last_gap;        ///< Last bytecode is a gap bytecode
+
+    /// Source line starts, in container order.
+    std::vector<LineMark> m_lines;
+
+    /// Instruction starts, in container order.
+    std::vector<Location> m_insns;
 };
 
 /// The factory functions append to the end of a section.
@@ -187,6 +231,18 @@ void AppendData(BytecodeContainer& container,
                 unsigned int size,
                 EndianState endian);
 
+/// Append raw integer data values to the end of a section.  This is
+/// much faster than appending each value individually.
+/// @param sect         section
+/// @param vals         data values; each is truncated to size bytes
+/// @param size         storage size (in bytes) for each value; at most 8
+/// @param arch         architecture
+YASM_LIB_EXPORT
+void AppendDataArray(BytecodeContainer& container,
+                     ArrayRef<uint64_t> vals,
+                     unsigned int size,
+                     const Arch& arch);
+
 /// Append a data value to the end of a section.
 /// @param sect         section
 /// @param expr         data value
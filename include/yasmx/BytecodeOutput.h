@@ -29,11 +29,13 @@
 /// POSSIBILITY OF SUCH DAMAGE.
 /// @endlicense
 ///
+#include "llvm/ADT/StringRef.h"
 #include "yasmx/Basic/Diagnostic.h"
 #include "yasmx/Basic/LLVM.h"
 #include "yasmx/Basic/SourceLocation.h"
 #include "yasmx/Config/export.h"
 #include "yasmx/Bytes.h"
+#include "yasmx/ListFormat.h"
 #include "yasmx/Location.h"
 #include "yasmx/NumericOutput.h"
 #include "yasmx/SymbolRef.h"
@@ -44,6 +46,7 @@ namespace yasm
 {
 
 class Bytecode;
+class OutputFileStream;
 
 /// Bytecode output interface.
 ///
@@ -52,7 +55,12 @@ class Bytecode;
 /// called to convert values and relocations into byte format first, then
 /// DoOutputBytes() is called.  It is assumed that DoOutputBytes()
 /// actually outputs the bytes to the object file.  The implementation
-/// function DoOutputGap() will be called for gaps in the output.
+/// function DoOutputGap() will be called for gaps in the output,
+/// DoOutputRaw() for large regions of raw data such as incbin contents,
+/// and DoOutputFill() for bytes repeated many times.
+/// ConvertValueToBytes() is passed the bytecode's own value, which may be
+/// output more than once (e.g. "TIMES x JMP label"), so it must not modify
+/// the value in ways that change its result; copy it first if needed.
 class YASM_LIB_EXPORT BytecodeOutput
 {
 public:
@@ -84,7 +92,11 @@ public:
 
     /// Get the total number of bytes (and gap) output.
     /// @return Number of bytes output.
-    unsigned long getNumOutput() const { return m_num_output; }
+    uint64_t getNumOutput() const { return m_num_output; }
+
+    /// Set the list format to report output bytecodes to.
+    /// @param listfmt      list format; may be null (the default) for none
+    void setListFormat(ListFormat* listfmt) { m_listfmt = listfmt; }
 
     /// Output a value.
     ///
@@ -109,13 +121,25 @@ public:
     /// program is run.
     /// @param size         gap size, in bytes
     /// @param source       source location
-    inline void OutputGap(unsigned long size, SourceLocation source);
+    inline void OutputGap(uint64_t size, SourceLocation source);
 
     /// Output a sequence of bytes.
     /// @param bytes        bytes to output
     /// @param source       source location
     inline void OutputBytes(const Bytes& bytes, SourceLocation source);
 
+    /// Output a region of raw data directly, without copying it into a
+    /// Bytes object first.
+    /// @param data         data to output
+    /// @param source       source location
+    inline void OutputRaw(StringRef data, SourceLocation source);
+
+    /// Output a sequence of bytes repeated a number of times.
+    /// @param bytes        bytes to output
+    /// @param count        number of times to output bytes
+    /// @param source       source location
+    void OutputFill(const Bytes& bytes, uint64_t count, SourceLocation source);
+
     /// Convert a value to bytes.  Called by OutputValue() so that
     /// implementations can keep track of relocations and verify legal
     /// expressions.
@@ -152,7 +176,7 @@ protected:
     /// Overrideable implementation of OutputGap().
     /// @param size         gap size, in bytes
     /// @param source       source location
-    virtual void DoOutputGap(unsigned long size,
+    virtual void DoOutputGap(uint64_t size,
                              SourceLocation source) = 0;
 
     /// Overrideable implementation of OutputBytes().
@@ -161,6 +185,23 @@ protected:
     virtual void DoOutputBytes(const Bytes& bytes,
                                SourceLocation source) = 0;
 
+    /// Overrideable implementation of OutputRaw().
+    /// The default implementation passes the data to DoOutputBytes() in
+    /// fixed-size chunks.
+    /// @param data         data to output
+    /// @param source       source location
+    virtual void DoOutputRaw(StringRef data, SourceLocation source);
+
+    /// Overrideable implementation of OutputFill().
+    /// The default implementation passes blocks of copies of the bytes to
+    /// DoOutputBytes().
+    /// @param bytes        bytes to output
+    /// @param count        number of times to output bytes
+    /// @param source       source location
+    virtual void DoOutputFill(const Bytes& bytes,
+                              uint64_t count,
+                              SourceLocation source);
+
 private:
     friend class Bytecode;
 
@@ -170,7 +211,8 @@ private:
     DiagnosticsEngine& m_diags; ///< Diagnostic reporting
     Bytes m_scratch;            ///< Reusable scratch area
     Bytes m_bc_scratch;         ///< Reusable scratch area for Bytecode class
-    unsigned long m_num_output; ///< Total number of bytes+gap output
+    uint64_t m_num_output;      ///< Total number of bytes+gap output
+    ListFormat* m_listfmt;      ///< List format to report output to
 };
 
 inline Bytes&
@@ -205,17 +247,32 @@ BytecodeOutput::OutputSymbol(SymbolRef sym,
 }
 
 inline void
-BytecodeOutput::OutputGap(unsigned long size, SourceLocation source)
+BytecodeOutput::OutputGap(uint64_t size, SourceLocation source)
 {
     DoOutputGap(size, source);
     m_num_output += size;
+    if (m_listfmt)
+        m_listfmt->OutputGap(size);
 }
 
 inline void
 BytecodeOutput::OutputBytes(const Bytes& bytes, SourceLocation source)
 {
     DoOutputBytes(bytes, source);
-    m_num_output += static_cast<unsigned long>(bytes.size());
+    m_num_output += static_cast<uint64_t>(bytes.size());
+    if (m_listfmt && !bytes.empty())
+        m_listfmt->OutputBytes(ArrayRef<unsigned char>(&bytes[0],
+                                                       bytes.size()));
+}
+
+inline void
+BytecodeOutput::OutputRaw(StringRef data, SourceLocation source)
+{
+    DoOutputRaw(data, source);
+    m_num_output += static_cast<uint64_t>(data.size());
+    if (m_listfmt)
+        m_listfmt->OutputBytes(ArrayRef<unsigned char>(
+            reinterpret_cast<const unsigned char*>(data.data()), data.size()));
 }
 
 /// No-output specialization of BytecodeOutput.
@@ -233,8 +290,12 @@ protected:
     bool ConvertValueToBytes(Value& value,
                              Location loc,
                              NumericOutput& num_out);
-    void DoOutputGap(unsigned long size, SourceLocation source);
+    void DoOutputGap(uint64_t size, SourceLocation source);
     void DoOutputBytes(const Bytes& bytes, SourceLocation source);
+    void DoOutputRaw(StringRef data, SourceLocation source);
+    void DoOutputFill(const Bytes& bytes,
+                      uint64_t count,
+                      SourceLocation source);
 };
 
 /// Stream output specialization of BytecodeOutput.
@@ -245,15 +306,25 @@ class YASM_LIB_EXPORT BytecodeStreamOutput : public BytecodeOutput
 {
 public:
     BytecodeStreamOutput(raw_ostream& os, DiagnosticsEngine& diags)
-        : BytecodeOutput(diags), m_os(os)
+        : BytecodeOutput(diags), m_os(os), m_file_os(0)
     {}
+
+    /// Constructor for output to a file image.  Gaps and fills are passed
+    /// on to the file stream run-length rather than expanded.
+    BytecodeStreamOutput(OutputFileStream& os, DiagnosticsEngine& diags);
+
     ~BytecodeStreamOutput();
 
 protected:
-    void DoOutputGap(unsigned long size, SourceLocation source);
+    void DoOutputGap(uint64_t size, SourceLocation source);
     void DoOutputBytes(const Bytes& bytes, SourceLocation source);
+    void DoOutputRaw(StringRef data, SourceLocation source);
+    void DoOutputFill(const Bytes& bytes,
+                      uint64_t count,
+                      SourceLocation source);
 
     raw_ostream& m_os;
+    OutputFileStream* m_file_os;    ///< m_os, if a file image
 };
 
 } // namespace yasm
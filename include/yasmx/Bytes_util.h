@@ -89,16 +89,18 @@ Write8(Bytes& bytes, unsigned char val)
 inline void
 Write16(Bytes& bytes, unsigned short val)
 {
+    unsigned char buf[2];
     if (bytes.isBigEndian())
     {
-        bytes.push_back(static_cast<unsigned char>((val >> 8) & 0xFF));
-        bytes.push_back(static_cast<unsigned char>(val & 0xFF));
+        buf[0] = static_cast<unsigned char>((val >> 8) & 0xFF);
+        buf[1] = static_cast<unsigned char>(val & 0xFF);
     }
     else
     {
-        bytes.push_back(static_cast<unsigned char>(val & 0xFF));
-        bytes.push_back(static_cast<unsigned char>((val >> 8) & 0xFF));
+        buf[0] = static_cast<unsigned char>(val & 0xFF);
+        buf[1] = static_cast<unsigned char>((val >> 8) & 0xFF);
     }
+    bytes.insert(bytes.end(), buf, buf+2);
 }
 
 /// Write a 32-bit value to a bytes buffer.
@@ -107,20 +109,42 @@ Write16(Bytes& bytes, unsigned short val)
 inline void
 Write32(Bytes& bytes, unsigned long val)
 {
+    unsigned char buf[4];
     if (bytes.isBigEndian())
     {
-        bytes.push_back(static_cast<unsigned char>((val >> 24) & 0xFF));
-        bytes.push_back(static_cast<unsigned char>((val >> 16) & 0xFF));
-        bytes.push_back(static_cast<unsigned char>((val >> 8) & 0xFF));
-        bytes.push_back(static_cast<unsigned char>(val & 0xFF));
+        buf[0] = static_cast<unsigned char>((val >> 24) & 0xFF);
+        buf[1] = static_cast<unsigned char>((val >> 16) & 0xFF);
+        buf[2] = static_cast<unsigned char>((val >> 8) & 0xFF);
+        buf[3] = static_cast<unsigned char>(val & 0xFF);
     }
     else
     {
-        bytes.push_back(static_cast<unsigned char>(val & 0xFF));
-        bytes.push_back(static_cast<unsigned char>((val >> 8) & 0xFF));
-        bytes.push_back(static_cast<unsigned char>((val >> 16) & 0xFF));
-        bytes.push_back(static_cast<unsigned char>((val >> 24) & 0xFF));
+        buf[0] = static_cast<unsigned char>(val & 0xFF);
+        buf[1] = static_cast<unsigned char>((val >> 8) & 0xFF);
+        buf[2] = static_cast<unsigned char>((val >> 16) & 0xFF);
+        buf[3] = static_cast<unsigned char>((val >> 24) & 0xFF);
     }
+    bytes.insert(bytes.end(), buf, buf+4);
+}
+
+/// Write a 64-bit value to a bytes buffer.
+/// @param bytes    output bytes buffer
+/// @param val      64-bit value
+inline void
+Write64(Bytes& bytes, uint64_t val)
+{
+    unsigned char buf[8];
+    if (bytes.isBigEndian())
+    {
+        for (int i=0; i<8; ++i)
+            buf[i] = static_cast<unsigned char>((val >> (56-8*i)) & 0xFF);
+    }
+    else
+    {
+        for (int i=0; i<8; ++i)
+            buf[i] = static_cast<unsigned char>((val >> (8*i)) & 0xFF);
+    }
+    bytes.insert(bytes.end(), buf, buf+8);
 }
 
 /// Write a N-bit value to a bytes buffer.
@@ -42,6 +42,14 @@
 # endif
 #endif
 
+#ifndef YASM_C_EXPORT
+# ifdef MAKE_YASMC_LIB
+#  define YASM_C_EXPORT YASM_EXPORT
+# else
+#  define YASM_C_EXPORT YASM_IMPORT
+# endif
+#endif
+
 #ifndef YASM_UNIT_EXPORT
 # ifdef MAKE_YASMUNIT_LIB
 #  define YASM_UNIT_EXPORT YASM_EXPORT
@@ -0,0 +1,6 @@
+#ifndef YASM_SOURCELOC_H
+#define YASM_SOURCELOC_H
+
+#cmakedefine YASM_64BIT_SOURCE_LOCATIONS 1
+
+#endif
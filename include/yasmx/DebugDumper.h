@@ -36,6 +36,7 @@
 #include "yasmx/Basic/LLVM.h"
 #endif // WITH_XML
 #include "yasmx/Config/export.h"
+#include "yasmx/Config/longlong.h"
 
 
 namespace yasm
@@ -90,6 +91,12 @@ YASM_LIB_EXPORT
 pugi::xml_node append_data(pugi::xml_node node, long val);
 YASM_LIB_EXPORT
 pugi::xml_node append_data(pugi::xml_node node, unsigned long val);
+#ifdef YASM_HAVE_LONG_LONG
+YASM_LIB_EXPORT
+pugi::xml_node append_data(pugi::xml_node node, long long val);
+YASM_LIB_EXPORT
+pugi::xml_node append_data(pugi::xml_node node, unsigned long long val);
+#endif
 YASM_LIB_EXPORT
 pugi::xml_node append_data(pugi::xml_node node, bool val);
 YASM_LIB_EXPORT
@@ -122,6 +129,13 @@ YASM_LIB_EXPORT
 pugi::xml_node append_child(pugi::xml_node node, const char* name, long val);
 YASM_LIB_EXPORT
 pugi::xml_node append_child(pugi::xml_node node, const char* name, unsigned long val);
+#ifdef YASM_HAVE_LONG_LONG
+YASM_LIB_EXPORT
+pugi::xml_node append_child(pugi::xml_node node, const char* name, long long val);
+YASM_LIB_EXPORT
+pugi::xml_node append_child(pugi::xml_node node, const char* name,
+                            unsigned long long val);
+#endif
 YASM_LIB_EXPORT
 pugi::xml_node append_child(pugi::xml_node node, const char* name, bool val);
 YASM_LIB_EXPORT
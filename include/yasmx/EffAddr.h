@@ -33,12 +33,14 @@
 
 #include "yasmx/Config/export.h"
 #include "yasmx/DebugDumper.h"
+#include "yasmx/IntNum.h"
 #include "yasmx/Value.h"
 
 
 namespace yasm
 {
 
+class Register;
 class SegmentRegister;
 
 /// Base class for an effective address.
@@ -86,6 +88,36 @@ public:
     /// 1 if effective address is forced non-PC-relative.
     bool m_not_pc_rel:1;
 
+    /// 1 if the parser recognized m_disp as [base + index*scale + disp]
+    /// with a constant disp; see m_base, m_index, m_scale, m_const_disp.
+    /// m_disp still holds the complete expression.
+    bool m_decomposed:1;
+
+    const Register* m_base;     ///< base register (0 if none)
+    const Register* m_index;    ///< index register (0 if none)
+    unsigned int m_scale;       ///< index multiplier
+    IntNum m_const_disp;        ///< constant displacement
+
+    /// Record a decomposition the parser built m_disp from.  Nothing is
+    /// recorded if disp is not a constant or base and index are the same
+    /// register.
+    /// @param base         base register (0 if none)
+    /// @param index        index register (0 if none)
+    /// @param scale        index multiplier
+    /// @param disp         displacement expression (may be empty)
+    void setDecomposed(const Register* base,
+                       const Register* index,
+                       unsigned int scale,
+                       const Expr& disp);
+
+    /// Try to recognize m_disp as [base + index*scale + disp] with a
+    /// constant disp.  Only sums of registers, registers multiplied by
+    /// constants, and constants are recognized; two unscaled registers
+    /// are left undecided, as which is the index is up to the
+    /// architecture.
+    /// @return True if m_disp was decomposed.
+    bool Decompose();
+
     /// Clone an effective address.
     virtual EffAddr* clone() const = 0;
 
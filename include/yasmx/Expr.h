@@ -30,6 +30,7 @@
 /// @endlicense
 ///
 #include <assert.h>
+#include <cstddef>
 #include <memory>
 
 #include "llvm/ADT/APFloat.h"
@@ -427,6 +428,10 @@ public:
     /// Destructor.
     ~Expr();
 
+    /// Allocation is counted for memory statistics.
+    static void* operator new(std::size_t size);
+    static void operator delete(void* ptr, std::size_t size);
+
     /// Determine if an expression is a specified operation (at the top
     /// level).
     /// @param op   operator
@@ -39,10 +39,16 @@ class Expr;
 
 /// Expand any and all EQU values in an expression.
 /// Detects circular references, and will return false if one found.
+/// Expanded EQU values are memoized on their symbols, so repeated uses of
+/// the same EQU are only expanded once.
 /// @param e        Expression
+/// @param fold_constants   if true, EQU values that reduce to an integer
+///                         constant are replaced by that constant rather
+///                         than by their full expression; use when the
+///                         caller simplifies the result anyway
 /// @return True if equ expansion successful with no circular references.
 YASM_LIB_EXPORT
-bool ExpandEqu(Expr& e);
+bool ExpandEqu(Expr& e, bool fold_constants = false);
 
 } // namespace yasm
 
@@ -51,6 +51,8 @@ public:
   unsigned ShowTemplateTree: 1;  /// Print a template tree when diffing
 
   unsigned ErrorLimit;           /// Limit # errors emitted.
+  unsigned RepeatLimit;          /// Limit # diagnostics emitted per ID; the
+                                 /// rest are counted and summarized.
   unsigned MacroBacktraceLimit;  /// Limit depth of macro expansion backtrace.
   unsigned TemplateBacktraceLimit; /// Limit depth of instantiation backtrace.
   unsigned ConstexprBacktraceLimit; /// Limit depth of constexpr backtrace.
@@ -100,6 +102,7 @@ public:
     ShowParseableFixits = 0;
     VerifyDiagnostics = 0;
     ErrorLimit = 0;
+    RepeatLimit = 0;
     TemplateBacktraceLimit = DefaultTemplateBacktraceLimit;
     MacroBacktraceLimit = DefaultMacroBacktraceLimit;
     ConstexprBacktraceLimit = DefaultConstexprBacktraceLimit;
@@ -16,6 +16,7 @@
 #ifndef YASM_FRONTEND_TEXT_DIAGNOSTIC_H_
 #define YASM_FRONTEND_TEXT_DIAGNOSTIC_H_
 
+#include "llvm/ADT/OwningPtr.h"
 #include "yasmx/Config/export.h"
 #include "yasmx/Frontend/DiagnosticRenderer.h"
 
@@ -38,6 +39,13 @@ namespace yasm {
 class YASM_LIB_EXPORT TextDiagnostic : public DiagnosticRenderer {
   raw_ostream &OS;
 
+  /// \brief The source line of the last snippet emitted, with its column
+  /// map, so further diagnostics on the same line don't have to find and
+  /// measure it again.
+  FileID LastLineFID;
+  const char *LastLineStart;
+  OwningPtr<SourceColumnMap> LastLineMap;
+
 public:
   TextDiagnostic(raw_ostream &OS,
                  const DiagnosticOptions &DiagOpts);
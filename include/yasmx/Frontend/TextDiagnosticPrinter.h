@@ -15,6 +15,11 @@
 #ifndef YASM_TEXT_DIAGNOSTIC_PRINTER_H
 #define YASM_TEXT_DIAGNOSTIC_PRINTER_H
 
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/OwningPtr.h"
 #include "yasmx/Basic/Diagnostic.h"
 #include "yasmx/Basic/LLVM.h"
@@ -36,6 +41,17 @@ class YASM_LIB_EXPORT TextDiagnosticPrinter : public DiagnosticConsumer {
 
   unsigned OwnsOutputStream : 1;
 
+  /// Set while the notes of a diagnostic dropped by the repeat limit are
+  /// being dropped along with it.
+  unsigned SuppressingNotes : 1;
+
+  /// Number of times each diagnostic ID has been seen (with a repeat limit).
+  llvm::DenseMap<unsigned, unsigned> RepeatCounts;
+
+  /// Diagnostic IDs over the repeat limit, in the order they went over, with
+  /// the first dropped message for the summary.
+  std::vector<std::pair<unsigned, std::string> > Suppressed;
+
 public:
   TextDiagnosticPrinter(raw_ostream &os, const DiagnosticOptions &diags,
                         bool OwnsOutputStream = false);
@@ -48,6 +64,11 @@ public:
 
   void BeginSourceFile();
   void EndSourceFile();
+
+  /// Print a note for each diagnostic ID that went over the repeat limit
+  /// with the number of diagnostics dropped, and flush the output.
+  void finish();
+
   void HandleDiagnostic(DiagnosticsEngine::Level Level, const Diagnostic &Info);
   DiagnosticConsumer *clone(DiagnosticsEngine &Diags) const;
 };
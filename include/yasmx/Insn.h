@@ -104,6 +104,13 @@ public:
     /// @return Newly allocated operand.
     Operand(std::auto_ptr<Expr> val);
 
+    /// Create an instruction operand from an immediate expression,
+    /// taking its terms.  Unlike the auto_ptr form, a single register
+    /// doesn't need a heap-allocated expression, so parsers can build
+    /// operands in a reused scratch expression.
+    /// @param val  immediate expression; empty on return
+    explicit Operand(Expr& val);
+
     /// Explicit copy creator.
     /// There's no copy constructor or assignment operator as we want
     /// to use the default bit-copy ones.  Even though this class
@@ -335,6 +342,10 @@ protected:
     /// Copy constructor.
     Insn(const Insn& rhs);
 
+    /// Remove all operands and prefixes, keeping allocated storage so
+    /// the instruction can be reused.
+    void Clear();
+
     /// Append instruction to a section.
     virtual bool DoAppend(BytecodeContainer& container,
                           SourceLocation source,
@@ -76,9 +76,15 @@ struct YASM_LIB_EXPORT IntNumData
     union
     {
         SmallValue sv;          ///< integer value (for integers <=long bits)
-        llvm::APInt* bv;        ///< big value (for integers >long bits)
+        /// Double-width value (for integers <=128 bits), two's complement.
+        struct
+        {
+            uint64_t lo;        ///< low 64 bits
+            int64_t hi;         ///< high 64 bits (signed)
+        } dv;
+        llvm::APInt* bv;        ///< big value (for integers >128 bits)
     } m_val;
-    enum { INTNUM_SV, INTNUM_BV } m_type;
+    enum { INTNUM_SV, INTNUM_DV, INTNUM_BV } m_type;
 };
 
 /// Big integer number.
@@ -214,7 +220,7 @@ public:
     ~IntNum()
     {
         if (m_type == INTNUM_BV)
-            delete m_val.bv;
+            DeleteBV(m_val.bv);
     }
 
     /// Integer calculation function: acc = acc op operand.
@@ -286,6 +292,11 @@ public:
     /// @return Unsigned 32-bit value of intn.
     unsigned long getUInt() const;
 
+    /// Convert an intnum to an unsigned 64-bit value.
+    /// @note Parameter intnum is saturated to fit into 64 bits.
+    /// @return Unsigned 64-bit value of intn.
+    uint64_t getUInt64() const;
+
     /// Convert an intnum to a signed "long" value.
     /// The value is in "standard" C format (eg, of unknown endian).
     /// @note Parameter intnum is saturated to fit into a long.  Use
@@ -293,6 +304,11 @@ public:
     /// @return Signed long value of intn.
     long getInt() const;
 
+    /// Convert an intnum to a signed 64-bit value.
+    /// @note Parameter intnum is saturated to fit into 64 bits.
+    /// @return Signed 64-bit value of intn.
+    int64_t getInt64() const;
+
     /// Determine if intnum will fit in a signed "long" without saturating.
     bool isInt() const;
 
@@ -319,6 +335,10 @@ public:
     /// @return False if overflow occurred.
     bool setStr(StringRef str, unsigned int radix=10);
 
+    /// Set intnum value from an unsigned 64-bit integer.
+    /// @param val      integer value
+    void setUInt64(uint64_t val) { setDV(val, 0); }
+
     /// Get intnum value into a SmallString.  The returned string will
     /// contain a leading '-' if the intnum is negative.
     /// @param str          output SmallString
@@ -404,6 +424,15 @@ public:
                int bits = -1) const;
 
 private:
+    /// Allocate a bitvector value; counted for memory statistics.
+    /// @param bv       value to copy
+    /// @return Newly allocated bitvector.
+    static llvm::APInt* NewBV(const llvm::APInt& bv);
+
+    /// Free a bitvector value allocated by NewBV().
+    /// @param bv       bitvector
+    static void DeleteBV(llvm::APInt* bv);
+
     /// Integer calculation function: acc = acc op operand.
     /// @note Not all operations in Op::Op may be supported; unsupported
     ///       operations will result in an error.
@@ -417,6 +446,12 @@ private:
                   SourceLocation source,
                   DiagnosticsEngine* diags);
 
+    /// Set an intnum to a 128-bit two's complement integer.  Stored as a
+    /// small value if it fits.
+    /// @param lo       low 64 bits
+    /// @param hi       high 64 bits
+    void setDV(uint64_t lo, int64_t hi);
+
     /// Set an intnum to an unsigned integer.
     /// @param val      integer value
     void set(USmallValue val);
@@ -426,7 +461,7 @@ private:
     void set(SmallValue val)
     {
         if (m_type == INTNUM_BV)
-            delete m_val.bv;
+            DeleteBV(m_val.bv);
         m_type = INTNUM_SV;
         m_val.sv = val;
     }
@@ -31,6 +31,7 @@
 ///
 #include <memory>
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/StringRef.h"
 #include "yasmx/Basic/LLVM.h"
 #include "yasmx/Config/export.h"
@@ -41,12 +42,15 @@
 namespace yasm
 {
 
-class Arch;
+class Bytecode;
 class Directives;
-class Linemap;
 class ListFormatModule;
+class SourceManager;
 
 /// List format interface.
+/// The listing is written while the object file is output, a bytecode at a
+/// time, so producing it doesn't require keeping anything beyond the
+/// object itself.  Bytecodes are reported in object file order.
 class YASM_LIB_EXPORT ListFormat
 {
 public:
@@ -62,14 +66,26 @@ public:
     /// Add directive handlers.
     virtual void AddDirectives(Directives& dirs, StringRef parser);
 
-    /// Write out list to the list file.
-    /// This function may call all read-only yasm:: functions as necessary.
+    /// Start writing the listing.  Called before the object file is output.
     /// @param os           output stream
-    /// @param linemap      line mapping repository
-    /// @param arch         architecture
-    virtual void Output(raw_ostream& os,
-                        Linemap& linemap,
-                        Arch& arch) = 0;
+    /// @param smgr         source manager
+    virtual void Begin(raw_ostream& os, SourceManager& smgr) = 0;
+
+    /// Start the output of a bytecode.  The bytecode's output follows in
+    /// calls to OutputBytes() and OutputGap().
+    /// @param bc           bytecode
+    virtual void BeginBytecode(const Bytecode& bc) = 0;
+
+    /// Add output bytes of the current bytecode.
+    /// @param bytes        bytes
+    virtual void OutputBytes(ArrayRef<unsigned char> bytes) = 0;
+
+    /// Add an uninitialized gap to the output of the current bytecode.
+    /// @param size         gap size, in bytes
+    virtual void OutputGap(uint64_t size) = 0;
+
+    /// Finish writing the listing.  Called after the object file is output.
+    virtual void End() = 0;
 
 private:
     ListFormat(const ListFormat&);                  // not implemented
@@ -31,10 +31,13 @@
 ///
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "llvm/ADT/StringRef.h"
 #include "yasmx/Basic/LLVM.h"
+#include "yasmx/Basic/SourceLocation.h"
 #include "yasmx/Config/export.h"
+#include "yasmx/Config/functional.h"
 #include "yasmx/Support/ptr_vector.h"
 #include "yasmx/Support/scoped_ptr.h"
 #include "yasmx/DebugDumper.h"
@@ -47,6 +50,7 @@ namespace yasm
 
 class Arch;
 class DiagnosticsEngine;
+class ListFormat;
 class Section;
 class Symbol;
 
@@ -64,6 +68,11 @@ public:
         /// the value.  Defaults to false.
         bool DisableGlobalSubRelative;
 
+        /// As DisableGlobalSubRelative, but for all symbols other than
+        /// assembler-temporary ones (unnamed, or named starting with "L"
+        /// or "l"), whatever their visibility.  Defaults to false.
+        bool DisableNonTempSubRelative;
+
         /// Alignment directives specify power-of-2.  Defaults to false.
         bool PowerOfTwoAlignment;
     };
@@ -78,6 +87,99 @@ public:
         /// Advise linker that stack should be non-executable.
         /// Defaults to false.
         bool NoExecStack;
+
+        /// Maximum number of threads to use for writing the object file;
+        /// 0 selects the number of processors.  Defaults to 1.
+        unsigned int NumJobs;
+
+        /// Effort Optimize() spends minimizing span-dependent bytecodes
+        /// (e.g. jumps), as an #OptimizeLevel value.
+        /// Defaults to OPTIMIZE_FULL.
+        unsigned int OptimizeLevel;
+
+        /// File to record the form (e.g. short or near jump) Optimize()
+        /// chooses for each span-dependent bytecode in, for use as
+        /// LoadRelaxFile when assembling the same source again.
+        /// Defaults to empty (not recorded).
+        std::string SaveRelaxFile;
+
+        /// File with the forms recorded by SaveRelaxFile in an earlier
+        /// assembly.  Optimize() starts from the recorded long forms and
+        /// only checks that they are needed, optimizing fully if not.
+        /// Ignored if the file cannot be read.
+        /// Defaults to empty (none).
+        std::string LoadRelaxFile;
+
+        /// Record why span-dependent bytecodes (e.g. jumps) take their
+        /// longest form in Optimize(), for getRelaxReport().
+        /// Defaults to false.
+        bool ExplainRelax;
+
+        /// File to write split DWARF (.dwo) debug information to.  If
+        /// set, only a skeleton unit is left in the object file.
+        /// Defaults to empty (no splitting).
+        std::string SplitDwarfFile;
+
+        /// Compression to apply to debug sections, as a #Compression
+        /// value.  Object formats that cannot compress ignore this.
+        /// Defaults to COMPRESS_NONE.
+        unsigned int CompressDebugSections;
+
+        /// Remove duplicate entries from mergeable (e.g. string literal)
+        /// sections.  Object formats without such sections ignore this.
+        /// Defaults to false.
+        bool MergeSections;
+
+        /// Use relocation types the linker may relax (e.g. x86-64
+        /// GOTPCRELX) where the instruction allows.  Object formats
+        /// without such relocations ignore this.
+        /// Defaults to true.
+        bool RelaxRelocations;
+
+        /// Pack relocations that only add a section's address to an
+        /// address-sized field (e.g. x86-64 R_X86_64_64 against a local
+        /// label) into compact bitmap-encoded relative relocation
+        /// sections, for a link step that understands them.  Object
+        /// formats without such sections ignore this.
+        /// Defaults to false.
+        bool PackRelativeRelocs;
+
+        /// File listing functions that are hot or cold, for object formats
+        /// that can place them in separate sections for the linker to lay
+        /// out.  Object formats without such sections ignore this.
+        /// Defaults to empty (no list).
+        std::string SymbolOrderingFile;
+
+        /// Parts of an object file to load in ObjectFormat::Read(), as a
+        /// mask of #ReadPart values.  Sections (headers) are always loaded;
+        /// object formats may load more than requested.
+        /// Defaults to READ_ALL.
+        unsigned int ReadParts;
+    };
+
+    /// Parts of an object file that can be selectively loaded.
+    enum ReadPart
+    {
+        READ_SYMBOLS = 1<<0,    ///< symbol table
+        READ_RELOCS = 1<<1,     ///< relocations (implies symbols)
+        READ_CONTENTS = 1<<2,   ///< section contents
+        READ_ALL = READ_SYMBOLS | READ_RELOCS | READ_CONTENTS
+    };
+
+    /// Optimization levels for Optimize().
+    enum OptimizeLevel
+    {
+        OPTIMIZE_NONE = 0,      ///< use the long form of all jumps etc.
+        OPTIMIZE_BASIC,         ///< limited number of relaxation passes
+        OPTIMIZE_FULL           ///< relax until all forms are minimal
+    };
+
+    /// Section compression algorithms.
+    enum Compression
+    {
+        COMPRESS_NONE = 0,      ///< no compression
+        COMPRESS_ZLIB,          ///< zlib (deflate)
+        COMPRESS_ZSTD           ///< Zstandard
     };
 
     /// Constructor.  A default section is created as the first
@@ -93,7 +195,9 @@ public:
 
     /// Finalize an object after parsing.
     /// @param diags    diagnostic reporting
-    void Finalize(DiagnosticsEngine& diags);
+    /// @param num_jobs maximum number of threads to use for finalizing
+    ///                 bytecodes; 0 selects the number of processors
+    void Finalize(DiagnosticsEngine& diags, unsigned int num_jobs = 1);
 
     /// Change the source filename for an object.
     /// @param src_filename new source filename (e.g. "file.asm")
@@ -117,7 +221,24 @@ public:
     /// Optimize an object.  Takes the unoptimized object and optimizes it.
     /// If successful, the object is ready for output to an object file.
     /// @param diags    diagnostic reporting
-    void Optimize(DiagnosticsEngine& diags);
+    /// @param num_jobs maximum number of threads to use for optimizing
+    ///                 independent sections; 0 selects the number of
+    ///                 processors
+    void Optimize(DiagnosticsEngine& diags, unsigned int num_jobs = 1);
+
+    /// Optimize an object again after some of its sections have changed
+    /// (e.g. bytecodes were appended or replaced) since the last call to
+    /// Optimize() or Reoptimize().  Only the changed sections and those
+    /// with values depending on them are optimized; bytecode lengths and
+    /// offsets in the others are kept.  New bytecodes must be finalized.
+    /// @param changed  sections that have changed
+    /// @param diags    diagnostic reporting
+    /// @param num_jobs maximum number of threads to use for optimizing
+    ///                 independent sections; 0 selects the number of
+    ///                 processors
+    void Reoptimize(const std::vector<Section*>& changed,
+                    DiagnosticsEngine& diags,
+                    unsigned int num_jobs = 1);
 
     /// Updates all bytecode offsets in object.
     /// @param diags    diagnostic reporting
@@ -137,6 +258,19 @@ public:
     /// @return Section matching name, or NULL if no match found.
     /*@null@*/ Section* FindSection(StringRef name);
 
+    /// Append the contents of another object, as if its source had
+    /// followed this object's source.  Sections are appended to the ones
+    /// of the same name, and symbols are combined with the ones of the
+    /// same name, the other object's becoming aliases of them.  Symbols
+    /// not in the other object's symbol table aren't moved.  Nothing is
+    /// changed if a symbol is defined or declared EXTERN or COMMON in
+    /// both objects, or has the same kind of associated data in both.
+    /// @param other        object to append; left with the aliases and
+    ///                     the memory of the appended contents, so it
+    ///                     must outlive this object
+    /// @return False if the objects couldn't be combined.
+    bool AppendObject(Object& other);
+
     typedef stdx::ptr_vector<Section> Sections;
     typedef Sections::iterator section_iterator;
     typedef Sections::const_iterator const_section_iterator;
@@ -178,7 +312,8 @@ public:
     SymbolRef getSymbol(StringRef name);
 
     /// Get a symbol for an arbitrary location.  The symbol may already exist,
-    /// or a new unnamed one may be created.
+    /// or a new unnamed one may be created.  Each location gets a single
+    /// symbol, so the symbol's label must not be moved.
     /// @param loc          location
     SymbolRef getSymbol(Location loc);
 
@@ -244,6 +379,97 @@ public:
     Arch* getArch() { return m_arch; }
     const Arch* getArch() const { return m_arch; }
 
+    /// Get the list format that object formats should report output to.
+    /// @return List format, or NULL if no listing is being written.
+    /*@null@*/ ListFormat* getListFormat() const { return m_listfmt; }
+    void setListFormat(/*@null@*/ ListFormat* listfmt)
+    { m_listfmt = listfmt; }
+
+    /// Record where each source line's output starts even without a
+    /// listing (e.g. for debug formats describing the assembly source).
+    /// Must be set before parsing.
+    /// @param mark         true to record line starts
+    void setMarkLines(bool mark) { m_mark_lines = mark; }
+    bool isMarkLines() const { return m_mark_lines; }
+
+    /// Record layout details for reports on the code (e.g. the size of
+    /// each function): where each instruction's output starts (see
+    /// BytecodeContainer::insns_begin()), the labels that aren't local to
+    /// another label (getLayoutLabels()), and which bytecodes Optimize()
+    /// gives their longest form (isLongForm()).  Must be set before
+    /// parsing.
+    /// @param mark         true to record layout details
+    void setMarkLayout(bool mark) { m_mark_layout = mark; }
+    bool isMarkLayout() const { return m_mark_layout; }
+
+    /// Get the labels passed to StartLabel() while marking layout, in the
+    /// order defined.
+    const std::vector<SymbolRef>& getLayoutLabels() const
+    { return m_layout_labels; }
+
+    /// Determine if a span-dependent bytecode (e.g. a jump) took its
+    /// longest form in the last Optimize() or Reoptimize() of its section.
+    /// Only recorded while marking layout.
+    /// @param bc           bytecode
+    /// @return True if the bytecode took its longest form.
+    bool isLongForm(const Bytecode& bc) const;
+
+    /// Set the source line that following output comes from, so the
+    /// listing can find where each line's output starts.  Called by
+    /// parsers at the start of each line; ignored if there's no list format
+    /// and setMarkLines() hasn't been called.
+    /// @param line         source line location; invalid after parsing
+    void setListLine(SourceLocation line)
+    {
+        if (m_listfmt || m_mark_lines)
+            m_list_line = line;
+    }
+    SourceLocation getListLine() const { return m_list_line; }
+
+    /// Function called when the parser is about to define a label that
+    /// isn't local to another label.  It may change the current section
+    /// to place the label and the code following it elsewhere.
+    typedef TR1::function<void (SymbolRef sym,
+                                SourceLocation source,
+                                DiagnosticsEngine& diags)> LabelHandler;
+
+    /// Set the function to call from StartLabel().
+    /// @param handler      label handler
+    void setLabelHandler(const LabelHandler& handler)
+    { m_label_handler = handler; }
+
+    /// Inform the object that a label is about to be defined in the current
+    /// section.  Called by parsers before defining a non-local label;
+    /// parsers must use the (possibly changed) current section afterwards.
+    /// @param sym          label symbol
+    /// @param source       label source location
+    /// @param diags        diagnostic reporting
+    void StartLabel(SymbolRef sym,
+                    SourceLocation source,
+                    DiagnosticsEngine& diags)
+    {
+        if (m_mark_layout)
+            m_layout_labels.push_back(sym);
+        if (m_label_handler)
+            m_label_handler(sym, source, diags);
+    }
+
+    /// Record a file other than a source file (e.g. an incbin file) that
+    /// the object contents are read from.
+    /// @param filename     file name
+    void AddInputFile(StringRef filename);
+
+    /// Get the files recorded by AddInputFile(), in the order first added.
+    const std::vector<std::string>& getInputFiles() const
+    { return m_input_files; }
+
+    /// Get a report of why span-dependent bytecodes in the sections
+    /// optimized by the last Optimize() or Reoptimize() took their longest
+    /// form: the value and range of each, and the bytecodes that grew
+    /// within it.  Only recorded if Config::ExplainRelax is set.
+    /// @return Report text, one or more lines per bytecode.
+    const std::string& getRelaxReport() const;
+
 #ifdef WITH_XML
     /// Write an XML representation.  For debugging purposes.
     /// @param out          XML node
@@ -255,6 +481,13 @@ private:
     Object(const Object&);                  // not implemented
     const Object& operator=(const Object&); // not implemented
 
+    bool OptimizeSections(const std::vector<Section*>& sections,
+                          DiagnosticsEngine& diags,
+                          unsigned int num_jobs,
+                          /*@null@*/ const std::vector<std::string>*
+                              long_keys = 0,
+                          /*@null@*/ std::string* forms = 0);
+
     std::string m_src_filename;         ///< Source filename
     std::string m_obj_filename;         ///< Object filename
 
@@ -262,6 +495,12 @@ private:
     Config m_config;                    ///< Object configuration
 
     Arch* m_arch;                       ///< Target architecture
+    /*@null@*/ ListFormat* m_listfmt;   ///< List format being written
+    bool m_mark_lines;                  ///< Record line starts regardless
+    bool m_mark_layout;                 ///< Record layout details
+    std::vector<SymbolRef> m_layout_labels; ///< Labels while marking layout
+    SourceLocation m_list_line;         ///< Source line being parsed
+    LabelHandler m_label_handler;       ///< Called by StartLabel()
 
     /// Currently active section.  Used by some directives.  NULL if no
     /// section active.
@@ -275,6 +514,9 @@ private:
     Symbols m_symbols;
     stdx::ptr_vector_owner<Symbol> m_symbols_owner;
 
+    /// Non-source input files
+    std::vector<std::string> m_input_files;
+
     /// Pimpl for symbol table hash trie.
     class Impl;
     util::scoped_ptr<Impl> m_impl;
@@ -0,0 +1,52 @@
+#ifndef YASM_OBJECTDUMPER_H
+#define YASM_OBJECTDUMPER_H
+///
+/// @file
+/// @brief Streaming object dump.
+///
+/// @license
+///  Copyright (C) 2026  Peter Johnson
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions
+/// are met:
+///  - Redistributions of source code must retain the above copyright
+///    notice, this list of conditions and the following disclaimer.
+///  - Redistributions in binary form must reproduce the above copyright
+///    notice, this list of conditions and the following disclaimer in the
+///    documentation and/or other materials provided with the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+/// @endlicense
+///
+#include "yasmx/Basic/LLVM.h"
+#include "yasmx/Config/export.h"
+
+
+namespace yasm
+{
+
+class Object;
+
+/// Dump an object as JSON lines: one JSON record per line for the object,
+/// then each section followed by its bytecodes and relocations, then each
+/// symbol.  Records are written as the object is walked, so unlike
+/// DumpXml() no document is built in memory.  For debugging purposes.
+/// @param object       object
+/// @param os           output stream
+YASM_LIB_EXPORT
+void DumpJsonLines(const Object& object, raw_ostream& os);
+
+} // namespace yasm
+
+#endif
@@ -34,6 +34,7 @@
 #include <vector>
 
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Support/DataTypes.h"
 #include "yasmx/Basic/LLVM.h"
 #include "yasmx/Config/export.h"
 
@@ -48,10 +49,24 @@ class DiagnosticsEngine;
 class Directives;
 class Object;
 class ObjectFormatModule;
+class OutputFileStream;
 class Section;
 class SourceLocation;
 class SourceManager;
 
+/// Reference from a code image (see ObjectFormat::OutputCode()) to a
+/// symbol not defined in the object.  The field is output as zero; the
+/// loader stores the symbol's address plus the addend into it.  PC-relative
+/// references are already folded into the addend.
+struct YASM_LIB_EXPORT CodeFixup
+{
+    uint64_t offset;            ///< offset of the field in the image
+    unsigned int size;          ///< size of the field, in bits
+    bool is_signed;             ///< true if the field is signed
+    int64_t addend;             ///< value to add to the symbol address
+    std::string symbol;         ///< symbol name
+};
+
 /// Object format interface.
 class YASM_LIB_EXPORT ObjectFormat
 {
@@ -70,6 +85,11 @@ public:
     /// Add directive handlers.
     virtual void AddDirectives(Directives& dirs, StringRef parser);
 
+    /// Add directive handlers the debug format may take over.  Called
+    /// after the debug format's directive handlers are added, so these
+    /// are only used if the debug format has no handler of its own.
+    virtual void AddFallbackDirectives(Directives& dirs, StringRef parser);
+
     /// Initialize symbols (default and special symbols).
     /// Called prior to assembly process.
     /// Default implementation does nothing.
@@ -86,6 +106,24 @@ public:
     /// @return False if an error occurred.
     virtual bool Read(SourceManager& sm, DiagnosticsEngine& diags);
 
+    /// Append the contents of an object file of this format to the
+    /// associated object, as a relocatable link ("ld -r") would: sections
+    /// of the same name are concatenated, and symbols and relocations are
+    /// rebased to match.  Global symbols are shared between merged files.
+    /// The default implementation reports an error.
+    /// @param in           object file to merge
+    /// @param diags        diagnostic reporting
+    /// @return False if an error occurred.
+    virtual bool Merge(const MemoryBuffer& in, DiagnosticsEngine& diags);
+
+    /// Append a piece of the source parsed separately, into its own object
+    /// with an object format of this module, to the associated object (see
+    /// Object::AppendObject()).  Nothing is changed on failure.  The
+    /// default implementation doesn't support pieces.
+    /// @param piece        object format of the piece; must outlive this
+    /// @return False if the piece couldn't be appended.
+    virtual bool AppendPiece(ObjectFormat& piece);
+
     /// Write out (post-optimized) sections to the object file.
     /// This function may call #Symbol and #Object functions as necessary
     /// to retrieve symbolic information.
@@ -95,11 +133,25 @@ public:
     /// @param dbgfmt       debugging format
     /// @param diags        diagnostic reporting
     /// @note Errors and warnings are reported via diags.
-    virtual void Output(raw_fd_ostream& os,
+    virtual void Output(OutputFileStream& os,
                         bool all_syms,
                         DebugFormat& dbgfmt,
                         DiagnosticsEngine& diags) = 0;
 
+    /// Write out (post-optimized) sections as an image of machine code ready
+    /// to run at a given address, with no object file container.  All
+    /// references within the object are resolved; references to symbols
+    /// not defined in the object are returned as fixups for the caller to
+    /// apply.  The default implementation reports an error.
+    /// @param os           output image
+    /// @param base         address the image will be loaded at
+    /// @param fixups       (output) references to external symbols
+    /// @param diags        diagnostic reporting
+    virtual void OutputCode(OutputFileStream& os,
+                            uint64_t base,
+                            /*@out@*/ std::vector<CodeFixup>& fixups,
+                            DiagnosticsEngine& diags);
+
     /// Add a default section to an object.
     /// @return Default section.
     virtual Section* AddDefaultSection() = 0;
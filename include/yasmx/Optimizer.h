@@ -29,15 +29,20 @@
 /// POSSIBILITY OF SUCH DAMAGE.
 /// @endlicense
 ///
+#include <utility>
+#include <vector>
+
 #include "yasmx/Config/export.h"
 #include "yasmx/Support/scoped_ptr.h"
 #include "yasmx/DebugDumper.h"
+#include "yasmx/Location.h"
 
 
 namespace yasm
 {
 
 class Bytecode;
+class BytecodeContainer;
 class DiagnosticsEngine;
 class Value;
 
@@ -45,27 +50,134 @@ class Value;
 class YASM_LIB_EXPORT Optimizer
 {
 public:
+    /// Pairs of containers coupled by span terms: the first contains a
+    /// span whose value depends on bytecode lengths in the second.
+    typedef std::vector<std::pair<const BytecodeContainer*,
+                                  const BytecodeContainer*> > Couplings;
+
+    /// Spans, each as its bytecode and span id.
+    typedef std::vector<std::pair<Bytecode*, int> > SpanIds;
+
+    /// Why a span took its longest form (see getLongSpanReasons()).
+    struct LongSpanReason
+    {
+        enum Reason
+        {
+            OUT_OF_RANGE,   ///< value exceeded the thresholds
+            RELATIVE,       ///< value is relative (e.g. external)
+            COMPLEX,        ///< value is too complex to calculate
+            PASS_LIMIT,     ///< out of relaxation passes
+            SEEDED          ///< given by setLongSpans()
+        };
+
+        Bytecode* bc;
+        int id;
+        Reason reason;
+
+        /// Value when the span was expanded, or INT64_MAX if not
+        /// calculated, and the thresholds of the form it was expanded
+        /// from.
+        int64_t value;
+        int64_t neg_thres;
+        int64_t pos_thres;
+
+        /// If the value is a single distance plus a constant (e.g. a
+        /// jump), it's CalcDist(loc, loc2) + add.
+        bool dist;
+        Location loc;
+        Location loc2;
+        int64_t add;
+
+        /// Bytecodes spanned by the value that grew before the span was
+        /// expanded, with their total growth, in bytecode order.
+        std::vector<std::pair<Bytecode*, int64_t> > growth;
+    };
+    typedef std::vector<LongSpanReason> LongSpanReasons;
+
     Optimizer(DiagnosticsEngine& diags);
     ~Optimizer();
     void AddSpan(Bytecode& bc,
                  int id,
                  const Value& value,
-                 long neg_thres,
-                 long pos_thres);
+                 int64_t neg_thres,
+                 int64_t pos_thres);
     void AddOffsetSetter(Bytecode& bc);
 
+    /// Note the start of a new bytecode container in Step 1a.  Until the
+    /// first span is added, offsets in the container are final, so an
+    /// offset setter (e.g. an already-aligned align or a same-offset org)
+    /// has a final length and is not tracked by the optimizer.
+    void StartContainer();
+
+    /// Limit the effort spent relaxing spans.  After max_passes passes
+    /// over the spans of a group of sections, all spans that could still
+    /// grow take their longest form (if they have one), so no further
+    /// passes are needed for them.  With 0, they take their longest form
+    /// in Step 1b.  Defaults to no limit.
+    /// @param max_passes   maximum number of relaxation passes
+    void setMaxPasses(unsigned int max_passes);
+
+    /// Get the spans added so far that have a longest form (see
+    /// Bytecode::getMaxGrowth()), in the order they were added.
+    /// @param spans        spans (output)
+    /// @return True if all spans added so far have a longest form.
+    bool getSpanIds(/*@out@*/ SpanIds* spans) const;
+
+    /// Have spans take their longest form in Step 1b, e.g. as decided by
+    /// an earlier optimization of the same source.  Must be called before
+    /// Step 1b.
+    /// @param spans        spans, sorted
+    void setLongSpans(const SpanIds& spans);
+
+    /// Check that the spans given to setLongSpans() need their longest
+    /// form at the final offsets.  Call after optimization is complete.
+    /// @return False if any of them is in range of a shorter form.
+    bool VerifyLongSpans();
+
+    /// Get the spans that took their longest form.  Call after
+    /// optimization is complete.
+    /// @param spans        spans (output), sorted
+    void getLongSpans(/*@out@*/ SpanIds* spans) const;
+
+    /// Record why spans take their longest form, for
+    /// getLongSpanReasons().  Must be called before Step 1b.
+    /// @param explain      true to record reasons
+    void setExplain(bool explain);
+
+    /// Get the reasons recorded for spans that took their longest form.
+    /// Call after optimization is complete.
+    /// @param reasons      reasons (output), in no particular order
+    void getLongSpanReasons(/*@out@*/ LongSpanReasons* reasons) const;
+
     // Step1a: Set bytecode indexes, initial offsets, add spans and
     // offset setters using the above functions.
 
-    void Step1b();
+    /// Step 1b: create span terms and expand spans that are known to be
+    /// long before any offsets are calculated.
+    /// @param num_jobs     maximum number of threads to use for creating
+    ///                     span terms; 0 selects the number of processors
+    void Step1b(unsigned int num_jobs = 1);
+
+    /// Get the containers coupled by span terms.  Valid after Step 1b;
+    /// includes spans that have been resolved since.
+    /// @return Coupled containers, sorted and without duplicates.
+    const Couplings& getCouplings() const;
 
     // Step1c: update offsets
 
-    // @return True if an error occurred.
-    bool Step1d();
+    /// Step 1d: calculate initial span values from the updated offsets.
+    /// @param num_jobs     maximum number of threads to use for calculating
+    ///                     span values; 0 selects the number of processors
+    /// @return True if no further optimization is needed.
+    bool Step1d(unsigned int num_jobs = 1);
 
     void Step1e();
-    void Step2();
+
+    /// Step 2: relax spans until no further expansion is needed.
+    /// @param num_jobs     maximum number of threads to use for relaxing
+    ///                     independent groups of sections; 0 selects the
+    ///                     number of processors
+    void Step2(unsigned int num_jobs = 1);
 
     // Step 3: update offsets
 
@@ -43,6 +43,7 @@ namespace yasm
 
 class DiagnosticsEngine;
 class Object;
+class ParserImpl;
 
 /// Directive information.  Helper class for passing all information about
 /// a directive to a handler.
@@ -78,6 +79,19 @@ private:
 typedef TR1::function<void (DirectiveInfo& info,
                             DiagnosticsEngine& diags)> Directive;
 
+/// Directive handler that reads its arguments directly from the parser's
+/// tokens rather than from name/values, for directives frequent enough
+/// that building the name/values dominates.  The handler may decline by
+/// returning false without consuming any tokens, in which case the
+/// arguments are parsed and passed to the normal handler.
+/// @param info     directive information (no name/values)
+/// @param parser   parser, positioned at the first argument token
+/// @param diags    diagnostic reporting
+/// @return False if declined.
+typedef TR1::function<bool (DirectiveInfo& info,
+                            ParserImpl& parser,
+                            DiagnosticsEngine& diags)> ParsedDirective;
+
 /// Container to manage and call directive handlers.
 class YASM_LIB_EXPORT Directives
 {
@@ -124,12 +138,28 @@ public:
     }
 
     /// Get a directive functor.  Returns false if no match.
+    /// The returned handler refers to storage owned by this object, so it
+    /// may be kept (e.g. cached by a parser) for the lifetime of this
+    /// object.
     /// @param handler      directive handler (returned)
     /// @param name         directive name
     /// @return True if directive exists, and handler is set to the
     ///         matching handler.
     bool get(Directive* handler, StringRef name) const;
 
+    /// Add a handler that parses the arguments of a directive itself.
+    /// The directive must also have been added with Add(), as the
+    /// parsed handler may decline.  Parsers are not required to use it.
+    /// @param name         Directive name.
+    /// @param handler      Parsed directive function
+    void AddParsed(StringRef name, ParsedDirective handler);
+
+    /// Get a parsed directive functor.  Returns false if there is none.
+    /// @param handler      parsed directive handler (returned)
+    /// @param name         directive name
+    /// @return True if a parsed handler exists, and handler is set to it.
+    bool getParsed(ParsedDirective* handler, StringRef name) const;
+
 private:
     /// Pimpl for class internals.
     class Impl;
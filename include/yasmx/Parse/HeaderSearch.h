@@ -102,6 +102,17 @@ class YASM_LIB_EXPORT HeaderSearch
   /// query.
   llvm::StringMap<std::pair<unsigned, unsigned> > LookupFileCache;
 
+  /// IncluderLookupCache - This keeps the result of each complete lookup
+  /// performed by LookupFile (other than #include_next), found or not, keyed
+  /// by the directory of the including file and the name looked up.
+  struct IncluderLookup {
+    bool Valid;
+    const FileEntry *File;
+    const DirectoryLookup *Dir;
+    IncluderLookup() : Valid(false), File(0), Dir(0) {}
+  };
+  llvm::StringMap<IncluderLookup> IncluderLookupCache;
+
 #if 0
   /// \brief Entity used to resolve the identifier IDs of controlling
   /// macros into IdentifierInfo pointers, as needed.
@@ -130,6 +141,7 @@ public:
     SystemDirIdx = systemDirIdx;
     NoCurDirSearch = noCurDirSearch;
     //LookupFileCache.clear();
+    IncluderLookupCache.clear();
   }
 
   /// ClearFileInfo - Forget everything we know about headers so far.
@@ -156,6 +168,11 @@ public:
                               const DirectoryLookup *&CurDir,
                               const FileEntry *CurFileEnt);
 
+  /// PrefetchFile - Start reading the file a later "foo" LookupFile() from a
+  /// file in IncluderDir would find, in the background.  Only the search
+  /// paths are used, so this may be called from any thread.
+  void PrefetchFile(StringRef Filename, StringRef IncluderDir) const;
+
   /// ShouldEnterIncludeFile - Mark the specified file as a target of of a
   /// #include, #include_next, or #import directive.  Return false if #including
   /// the file will have no effect or true if we should include it.
@@ -189,6 +206,13 @@ public:
   void PrintStats();
 private:
 
+  /// SearchFile - Perform the lookup for LookupFile without the
+  /// IncluderLookupCache.
+  const FileEntry *SearchFile(StringRef Filename, bool isAngled,
+                              const DirectoryLookup *FromDir,
+                              const DirectoryLookup *&CurDir,
+                              const FileEntry *CurFileEnt);
+
   /// getFileInfo - Return the HeaderFileInfo structure for the specified
   /// FileEntry.
   HeaderFileInfo &getFileInfo(const FileEntry *FE);
@@ -78,14 +78,36 @@ class YASM_LIB_EXPORT IdentifierInfo
 
     unsigned int m_token_id : 16;   // Front-end token ID.
     unsigned int m_flags    : 16;   // Flags
+    unsigned int m_lookup_gen;      // Arch lookup generation of lookups.
 
     IdentifierInfo(const IdentifierInfo&);  // NONCOPYABLE.
     void operator=(const IdentifierInfo&);  // NONASSIGNABLE.
 
+    // Discard cached instruction/register lookups made under a different
+    // arch state (e.g. a different BITS or CPU setting).
+    void CheckLookupGeneration(const Arch& arch)
+    {
+        unsigned int gen = arch.getLookupGeneration();
+        if (gen != m_lookup_gen && !(m_flags & IS_CUSTOM))
+        {
+            m_flags = 0;
+            m_lookup_gen = gen;
+        }
+    }
+
+    void DoInsnLookupSlow(const Arch& arch,
+                          SourceLocation source,
+                          DiagnosticsEngine& diags);
+    void DoRegLookupSlow(const Arch& arch,
+                         SourceLocation source,
+                         DiagnosticsEngine& diags);
+
     friend class IdentifierTable;
 
 public:
-    IdentifierInfo() : m_info(0), m_token_id(Token::unknown), m_flags(0) {}
+    IdentifierInfo()
+        : m_info(0), m_token_id(Token::unknown), m_flags(0), m_lookup_gen(0)
+    {}
 
     /// Return true if this is the identifier for the specified string.
     /// This is intended to be used for string literals only: ii->is_str("foo").
@@ -120,13 +142,25 @@ public:
     unsigned int getTokenKind() const { return m_token_id; }
     void setTokenKind(unsigned int id) { m_token_id = id; }
 
-    // Perform lookup of instruction/register data.
+    // Perform lookup of instruction/register data.  The results are cached
+    // on the identifier until the arch lookup generation changes, so
+    // repeated lookups are inexpensive.
     void DoInsnLookup(const Arch& arch,
                       SourceLocation source,
-                      DiagnosticsEngine& diags);
+                      DiagnosticsEngine& diags)
+    {
+        CheckLookupGeneration(arch);
+        if (!(m_flags & DID_INSN_LOOKUP))
+            DoInsnLookupSlow(arch, source, diags);
+    }
     void DoRegLookup(const Arch& arch,
                      SourceLocation source,
-                     DiagnosticsEngine& diags);
+                     DiagnosticsEngine& diags)
+    {
+        CheckLookupGeneration(arch);
+        if (!(m_flags & DID_REG_LOOKUP))
+            DoRegLookupSlow(arch, source, diags);
+    }
 
     bool isUnknown()
     {
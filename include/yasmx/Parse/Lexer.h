@@ -138,6 +138,16 @@ public:
     SourceLocation getSourceLocation() const
     { return getSourceLocation(m_buf_ptr); }
 
+    /// Continue lexing from the start of the line at @p offset into the
+    /// buffer, so that only part of a file is lexed.
+    void SeekToLine(unsigned int offset)
+    {
+        assert(offset <= static_cast<unsigned int>(m_buf_end-m_buf_start) &&
+               "seek past end of buffer");
+        m_buf_ptr = m_buf_start + offset;
+        m_is_at_start_of_line = true;
+    }
+
 #if 0
     /// Relex the token at the specified location and return its length in
     /// bytes in the input file.  If the token needs cleaning (e.g. includes an
@@ -32,6 +32,7 @@
 //
 #include <cctype>
 
+#include "llvm/Support/DataTypes.h"
 #include "yasmx/Basic/LLVM.h"
 #include "yasmx/Config/export.h"
 
@@ -76,6 +77,27 @@ public:
     virtual llvm::APFloat getFloatValue(const llvm::fltSemantics& format,
                                         bool* is_exact = 0);
 
+    /// Convert this numeric literal, if it is a decimal float, to the
+    /// bits of an IEEE single or double precision value.
+    /// See getDecimalFloatBits().
+    /// @param size     size in bits (32 or 64)
+    /// @param bits     result bits
+    /// @return False if not handled; use getFloatValue() instead.
+    bool getIEEEBits(unsigned int size, uint64_t* bits) const;
+
+    /// Convert a plain decimal floating point string
+    /// ([+-]? [0-9]* ([.] [0-9]*)? ([eE] [-+]? [0-9]+)?) to the bits of the
+    /// correctly rounded IEEE single or double precision value.  This is
+    /// much faster than APFloat, but only handles strings with at most 19
+    /// significant digits and a zero or normal result.
+    /// @param str      string
+    /// @param size     size in bits (32 or 64)
+    /// @param bits     result bits
+    /// @return False if not handled.
+    static bool getDecimalFloatBits(StringRef str,
+                                    unsigned int size,
+                                    uint64_t* bits);
+
 protected:
     const char* m_digits_begin;
     const char* m_digits_end;
@@ -44,6 +44,7 @@
 namespace yasm
 {
 
+class Bytes;
 class DiagnosticsEngine;
 class Directives;
 class HeaderSearch;
@@ -81,6 +82,57 @@ public:
                        Directives& dirs,
                        DiagnosticsEngine& diags) = 0;
 
+    /// Preprocess the input without parsing it, streaming the preprocessed
+    /// source to os.  No object is needed.  The default implementation
+    /// reports that preprocessing only is not supported.
+    /// @param os           output stream
+    /// @param diags        diagnostic reporter
+    /// @return False if an error occurred.
+    virtual bool Preprocess(raw_ostream& os, DiagnosticsEngine& diags);
+
+    /// Find where the main source file may be split into pieces that can
+    /// be parsed independently of each other, each into its own object.
+    /// The default implementation finds none.
+    /// @param splits       offsets of the lines pieces may start at
+    ///                     (output, ascending)
+    /// @param setup        offsets of lines each piece starting after them
+    ///                     parses first, e.g. to give sections the same
+    ///                     attributes (output, ascending)
+    /// @return False if the source can't be split.
+    virtual bool SplitSource(std::vector<unsigned int>* splits,
+                             std::vector<unsigned int>* setup);
+
+    /// Parse one piece of the main source file into an object, as split
+    /// by SplitSource().  Only called if SplitSource() returned true.
+    /// @param object       object to parse into
+    /// @param dirs         available directives
+    /// @param diags        diagnostic reporter
+    /// @param setup        setup lines from SplitSource()
+    /// @param begin        offset of the start of the piece
+    /// @param end          offset of the end of the piece
+    /// @param record       if not NULL, a record of the parse is written
+    ///                     to it, for a later parse of the same piece
+    ///                     (with the same setup lines and options) to
+    ///                     replay
+    /// @param replay       record of an earlier parse of the piece to
+    ///                     replay parts of, rather than parsing them
+    ///                     again; may be empty
+    /// @return False if the replay record can't be used.  The object is
+    ///         then left partly parsed.
+    virtual bool ParsePiece(Object& object,
+                            Directives& dirs,
+                            DiagnosticsEngine& diags,
+                            const std::vector<unsigned int>& setup,
+                            unsigned int begin,
+                            unsigned int end,
+                            /*@null@*/ Bytes* record,
+                            ArrayRef<unsigned char> replay);
+
+    /// Finish an object the pieces of the main source file have been
+    /// parsed and combined into, as Parse() would have done at the end.
+    /// @param object       object
+    virtual void FinishPieces(Object& object);
+
 private:
     Parser(const Parser&);                  // not implemented
     const Parser& operator=(const Parser&); // not implemented
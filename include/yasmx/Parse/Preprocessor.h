@@ -134,10 +134,21 @@ public:
     /// tokens has a permanent owner somewhere, so they do not need to be copied.
     /// If it is true, it assumes the array of tokens is allocated with new[] and
     /// must be freed.
+    ///
+    /// The token stream is returned RepeatCount times in succession without
+    /// copying it.
     void EnterTokenStream(const Token* toks,
                           unsigned int num_toks,
                           bool disable_macro_expansion,
-                          bool owns_tokens);
+                          bool owns_tokens,
+                          unsigned long repeat_count = 1);
+
+    /// Add a "macro" context to the top of the include stack that returns
+    /// the tokens of a shared buffer, as above.  The buffer is kept alive
+    /// until the stream ends, so it can be entered any number of times.
+    void EnterTokenStream(TokenBuffer* toks,
+                          bool disable_macro_expansion,
+                          unsigned long repeat_count = 1);
 
     /// Pop the current lexer/macro exp off the top of the
     /// lexer stack.  This should only be used in situations where the current
@@ -231,6 +242,12 @@ public:
         return m_diags.Report(tok.getLocation(), id);
     }
   
+    /// Return the characters of a token as they appear in the source
+    /// buffer (or the identifier table, for identifiers), without copying.
+    /// This is the spelling unless tok.needsCleaning(), in which case
+    /// any escaped newlines are still in it.
+    StringRef getRawSpelling(const Token& tok) const;
+
     /// Return the 'spelling' of the Tok token.  The spelling of a
     /// token is the characters used to represent the token in the source file
     /// after escaped-newline folding.  In particular, this wants to get the
@@ -207,6 +207,14 @@ public:
         m_ptr_data = (void*)ptr;
     }
 
+    /// Determine if this token is an exact copy of another.
+    bool isIdenticalTo(const Token& oth) const
+    {
+        return m_loc == oth.m_loc && m_ptr_data == oth.m_ptr_data &&
+               m_len == oth.m_len && m_kind == oth.m_kind &&
+               m_flags == oth.m_flags;
+    }
+
     /// Set the specified flag.
     void setFlag(TokenFlags flag) { m_flags |= flag; }
 
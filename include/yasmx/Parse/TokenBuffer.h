@@ -0,0 +1,86 @@
+#ifndef YASM_PARSE_TOKENBUFFER_H
+#define YASM_PARSE_TOKENBUFFER_H
+///
+/// @file
+/// @brief Shared token buffer interface.
+///
+/// @license
+///  Copyright (C) 2026  Peter Johnson
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions
+/// are met:
+///  - Redistributions of source code must retain the above copyright
+///    notice, this list of conditions and the following disclaimer.
+///  - Redistributions in binary form must reproduce the above copyright
+///    notice, this list of conditions and the following disclaimer in the
+///    documentation and/or other materials provided with the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+/// @endlicense
+///
+#include <vector>
+
+#include "llvm/ADT/IntrusiveRefCntPtr.h"
+#include "yasmx/Basic/LLVM.h"
+#include "yasmx/Config/export.h"
+#include "yasmx/Parse/Token.h"
+
+
+namespace yasm
+{
+
+/// A reference-counted array of tokens.  A token stream entered from one
+/// of these (see Preprocessor::EnterTokenStream()) keeps it alive, so the
+/// same body (e.g. that of a nested repeat) can be entered again and again,
+/// even while earlier entries are still being lexed, without copying it.
+class YASM_LIB_EXPORT TokenBuffer : public RefCountedBase<TokenBuffer>
+{
+public:
+    /// Constructor; copies the tokens.
+    /// @param toks         tokens
+    /// @param num_toks     number of tokens
+    TokenBuffer(const Token* toks, unsigned int num_toks)
+        : m_tokens(toks, toks+num_toks)
+    {}
+
+    /// Get the tokens.
+    const Token* getTokens() const
+    { return m_tokens.empty() ? 0 : &m_tokens[0]; }
+
+    /// Get the number of tokens.
+    unsigned int size() const { return m_tokens.size(); }
+
+    /// Determine if the buffer holds exactly the given tokens.
+    /// @param toks         tokens
+    /// @param num_toks     number of tokens
+    /// @return True if the tokens are identical.
+    bool equals(const Token* toks, unsigned int num_toks) const
+    {
+        if (num_toks != m_tokens.size())
+            return false;
+        for (unsigned int i=0; i<num_toks; ++i)
+        {
+            if (!m_tokens[i].isIdenticalTo(toks[i]))
+                return false;
+        }
+        return true;
+    }
+
+private:
+    std::vector<Token> m_tokens;
+};
+
+} // namespace yasm
+
+#endif
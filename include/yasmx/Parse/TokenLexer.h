@@ -30,8 +30,10 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 //
+#include "llvm/ADT/IntrusiveRefCntPtr.h"
 #include "yasmx/Basic/SourceLocation.h"
 #include "yasmx/Config/export.h"
+#include "yasmx/Parse/TokenBuffer.h"
 
 namespace yasm
 {
@@ -71,12 +73,20 @@ class YASM_LIB_EXPORT TokenLexer
     /// may or may not own (depending on OwnsTokens).
     const Token* m_tokens;
 
+    /// If the tokens are from a shared buffer, this keeps it alive.
+    IntrusiveRefCntPtr<TokenBuffer> m_buffer;
+
     /// This is the length of the Tokens array.
     unsigned m_num_tokens;
 
     /// This is the next token that Lex will return.
     unsigned m_cur_token;
 
+    /// Number of passes over the Tokens array remaining, including the
+    /// current one.  Token streams that repeat (e.g. GAS .rept) replay the
+    /// same array rather than copying it once per repetition.
+    unsigned long m_repeat_count;
+
     /// The source location range where this macro was expanded.
     SourceLocation m_expand_loc_start, m_expand_loc_end;
 
@@ -120,19 +130,27 @@ public:
     /// specified, this takes ownership of the tokens and delete[]'s them when
     /// the token lexer is empty.
     TokenLexer(const Token* tok_array, unsigned num_toks,
-               bool disable_expansion, bool owns_tokens, Preprocessor& pp)
+               bool disable_expansion, bool owns_tokens, Preprocessor& pp,
+               unsigned long repeat_count = 1)
         : /*m_macro(0), m_actual_args(0),*/ m_pp(pp), m_owns_tokens(false)
     {
-        Init(tok_array, num_toks, disable_expansion, owns_tokens);
+        Init(tok_array, num_toks, disable_expansion, owns_tokens, repeat_count);
     }
 
     /// Initialize this TokenLexer with the specified token stream.
     /// This does not take ownership of the specified token vector.
     ///
     /// DisableExpansion is true when macro expansion of tokens lexed from this
-    /// stream should be disabled.
+    /// stream should be disabled.  The stream is returned repeat_count times
+    /// in succession; a repeat count of 0 returns no tokens.
     void Init(const Token* tok_array, unsigned num_toks,
-              bool disable_macro_expansion, bool owns_tokens);
+              bool disable_macro_expansion, bool owns_tokens,
+              unsigned long repeat_count = 1);
+
+    /// Initialize this TokenLexer with the tokens of a shared buffer,
+    /// holding a reference to it until the TokenLexer is done with it.
+    void Init(TokenBuffer* buffer, bool disable_macro_expansion,
+              unsigned long repeat_count = 1);
 
     ~TokenLexer() { destroy(); }
 
@@ -151,7 +169,7 @@ private:
     /// include stack.
     bool isAtEnd() const
     {
-        return m_cur_token == m_num_tokens;
+        return m_cur_token == m_num_tokens && m_repeat_count <= 1;
     }
 
 #if 0
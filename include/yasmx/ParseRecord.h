@@ -0,0 +1,211 @@
+#ifndef YASM_PARSERECORD_H
+#define YASM_PARSERECORD_H
+///
+/// @file
+/// @brief Parse record interface.
+///
+/// @license
+///  Copyright (C) 2026  Peter Johnson
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions
+/// are met:
+///  - Redistributions of source code must retain the above copyright
+///    notice, this list of conditions and the following disclaimer.
+///  - Redistributions in binary form must reproduce the above copyright
+///    notice, this list of conditions and the following disclaimer in the
+///    documentation and/or other materials provided with the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+/// @endlicense
+///
+#include <cstddef>
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/DataTypes.h"
+#include "yasmx/Basic/LLVM.h"
+#include "yasmx/Basic/SourceLocation.h"
+#include "yasmx/Config/export.h"
+#include "yasmx/Bytecode.h"
+#include "yasmx/SymbolRef.h"
+
+
+namespace yasm
+{
+
+class Arch;
+class BytecodeContainer;
+class Bytes;
+class Expr;
+class InputBuffer;
+class IntNum;
+class Object;
+class Register;
+class Value;
+
+/// Writer of parse records.  A parse record holds what parsing part of a
+/// source produced (e.g. the bytecodes appended for an instruction), so
+/// parsing the same source again can replay it with RecordReader instead.
+/// Source locations are kept relative to the start of the part, and
+/// symbols by name.  Anything that can't be recorded makes the Write and
+/// Save functions return false; the record is then unusable.
+class YASM_LIB_EXPORT RecordWriter
+{
+public:
+    /// End of a bytecode container, for WriteAppended().
+    struct Mark
+    {
+        std::size_t bcs;        ///< Number of bytecodes
+        std::size_t fixed;      ///< Fixed length of the last bytecode
+        std::size_t fixups;     ///< Number of fixups of the last bytecode
+        bool contents;          ///< If the last bytecode has contents
+    };
+
+    /// Constructor.
+    /// @param out          bytes to append the record to
+    /// @param arch         architecture
+    /// @param object       object the recorded symbols are in
+    /// @param begin        start of the recorded source
+    /// @param end          end of the recorded source; recorded source
+    ///                     locations must be before it
+    RecordWriter(Bytes& out,
+                 const Arch& arch,
+                 Object& object,
+                 SourceLocation begin,
+                 SourceLocation end);
+
+    /// Get the output bytes.
+    Bytes& getBytes() { return m_out; }
+
+    /// Write an unsigned integer.
+    void WriteUnsigned(uint64_t val);
+
+    /// Write a string.
+    void WriteString(StringRef str);
+
+    /// Write an integer of any size.
+    void WriteIntNum(const IntNum& intn);
+
+    /// Write a source location.
+    /// @return False if the location is outside the recorded source.
+    bool WriteSource(SourceLocation source);
+
+    /// Write a symbol reference (may be NULL).
+    /// @return False if the symbol can't be found by name.
+    bool WriteSymbol(SymbolRef sym);
+
+    /// Write a register (may be NULL).
+    /// @return False if the architecture can't record the register.
+    bool WriteRegister(const Register* reg);
+
+    /// Write an expression.  Only integers, symbols, registers, and
+    /// operators can be recorded.
+    /// @return False if the expression can't be recorded.
+    bool WriteExpr(const Expr& e);
+
+    /// Write a value as the parser leaves it.  Values with a relative
+    /// portion (set when values are finalized) can't be recorded.
+    /// @return False if the value can't be recorded.
+    bool WriteValue(const Value& value);
+
+    /// Write bytecode contents.
+    /// @return False if the contents can't be recorded.
+    bool WriteContents(const Bytecode::Contents& contents);
+
+    /// Get the end of a bytecode container.
+    static Mark getMark(BytecodeContainer& container);
+
+    /// Write what has been appended to a bytecode container since a mark.
+    /// Bytecodes before the mark must not have changed.
+    /// @param container    bytecode container
+    /// @param mark         earlier end of container
+    /// @return False if something appended can't be recorded.
+    bool WriteAppended(BytecodeContainer& container, const Mark& mark);
+
+private:
+    Bytes& m_out;
+    const Arch& m_arch;
+    Object& m_object;
+    SourceLocation m_begin;
+    SourceLocation m_end;
+};
+
+/// Reader of parse records written by RecordWriter.  Malformed records
+/// throw std::out_of_range, as InputBuffer does.
+class YASM_LIB_EXPORT RecordReader
+{
+public:
+    /// Constructor.
+    /// @param in           record input
+    /// @param arch         architecture
+    /// @param object       object to look up symbols in
+    /// @param begin        start of the recorded source
+    /// @param end          end of the recorded source
+    RecordReader(InputBuffer& in,
+                 const Arch& arch,
+                 Object& object,
+                 SourceLocation begin,
+                 SourceLocation end);
+
+    /// Get the input.
+    InputBuffer& getInput() { return m_in; }
+
+    /// Read an unsigned integer.
+    uint64_t ReadUnsigned();
+
+    /// Read an unsigned integer that must be no larger than a maximum.
+    /// @param max          maximum value
+    uint64_t ReadUnsigned(uint64_t max);
+
+    /// Read a string.
+    StringRef ReadString();
+
+    /// Read an integer of any size.
+    IntNum ReadIntNum();
+
+    /// Read a source location.
+    SourceLocation ReadSource();
+
+    /// Read a symbol reference.  The symbol must already exist.
+    SymbolRef ReadSymbol();
+
+    /// Read a register.
+    const Register* ReadRegister();
+
+    /// Read an expression.
+    /// @param e            expression (output)
+    void ReadExpr(Expr& e);
+
+    /// Read a value.
+    /// @param value        value (output)
+    void ReadValue(Value& value);
+
+    /// Read bytecode contents.
+    /// @param bc           bytecode to give the contents
+    void ReadContents(Bytecode& bc);
+
+    /// Append to a bytecode container what RecordWriter::WriteAppended()
+    /// recorded.
+    void ReadAppended(BytecodeContainer& container);
+
+private:
+    InputBuffer& m_in;
+    const Arch& m_arch;
+    Object& m_object;
+    SourceLocation m_begin;
+    SourceLocation m_end;
+};
+
+} // namespace yasm
+
+#endif
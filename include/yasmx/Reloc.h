@@ -29,6 +29,7 @@
 /// POSSIBILITY OF SUCH DAMAGE.
 /// @endlicense
 ///
+#include <cstddef>
 #include <memory>
 #include <string>
 
@@ -42,6 +43,8 @@
 namespace yasm
 {
 
+class Section;
+
 /// Basic YASM relocation.  Object formats will need to extend this
 /// structure with additional fields for relocation type, etc.
 class YASM_LIB_EXPORT Reloc
@@ -50,6 +53,20 @@ public:
     Reloc(const IntNum& addr, SymbolRef sym);
     virtual ~Reloc();
 
+    /// Allocate a relocation from the arena of the section it will be
+    /// added to, e.g. "new (sect) ElfReloc(...)".  Relocations are always
+    /// allocated this way; the memory is released when the section is.
+    /// @param size         size of relocation object
+    /// @param sect         section
+    static void* operator new(std::size_t size, Section& sect);
+
+    /// Matching placement delete; does nothing.
+    static void operator delete(void* ptr, Section& sect);
+
+    /// Deleting a relocation only destroys it; the memory belongs to the
+    /// section arena.
+    static void operator delete(void* ptr);
+
     SymbolRef getSymbol() { return m_sym; }
     const SymbolRef getSymbol() const { return m_sym; }
 
@@ -33,6 +33,7 @@
 #include <string>
 
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Allocator.h"
 #include "yasmx/Basic/LLVM.h"
 #include "yasmx/Config/export.h"
 #include "yasmx/Support/ptr_vector.h"
@@ -104,9 +105,20 @@ public:
     void setDefault(bool def = true) { m_def = def; }
 
     /// Add a relocation to a section.
-    /// @param reloc        relocation
+    /// @param reloc        relocation; must have been allocated from this
+    ///                     section (see Reloc::operator new)
     void AddReloc(std::auto_ptr<Reloc> reloc);
 
+    /// Allocate memory for a relocation.  Use Reloc::operator new instead
+    /// of calling this directly.  The memory is freed when the section is
+    /// destroyed.
+    /// @param size         size in bytes
+    /// @return Allocated memory.
+    void* AllocateReloc(std::size_t size)
+    {
+        return m_reloc_alloc.Allocate(size, llvm::AlignOf<double>::Alignment);
+    }
+
     typedef stdx::ptr_vector<Reloc> Relocs;
     typedef Relocs::iterator reloc_iterator;
     typedef Relocs::const_iterator const_reloc_iterator;
@@ -197,6 +209,9 @@ private:
     /// "Default" section, e.g. not specified by using section directive.
     bool m_def;
 
+    /// Arena for the relocations; must be destroyed after them.
+    llvm::BumpPtrAllocator m_reloc_alloc;
+
     /// The relocations for the section.
     Relocs m_relocs;
     stdx::ptr_vector_owner<Reloc> m_relocs_owner;
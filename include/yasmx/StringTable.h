@@ -31,6 +31,7 @@
 ///
 #include <vector>
 
+#include "llvm/ADT/StringMap.h"
 #include "yasmx/Basic/LLVM.h"
 #include "yasmx/Config/export.h"
 
@@ -61,8 +62,9 @@ public:
     /// Destructor.
     ~StringTable();
 
-    /// Get an index for a string.  If the asked-for string is a tail substring
-    /// of an existing string in the table, it may be reused.
+    /// Get an index for a string.  If the asked-for string is already in
+    /// the table, its existing index is returned rather than adding a second
+    /// copy.
     /// @param str      String
     /// @return String index.
     unsigned long getIndex(StringRef str);
@@ -91,6 +93,9 @@ public:
 private:
     std::vector<char> m_storage;
     unsigned long m_first_index;
+
+    /// Indexes of strings added by getIndex(), for reuse.
+    llvm::StringMap<unsigned long> m_indexes;
 };
 
 } // namespace yasm
@@ -0,0 +1,54 @@
+#ifndef YASM_DECIMALFLOAT_H
+#define YASM_DECIMALFLOAT_H
+///
+/// @file
+/// @brief Decimal to IEEE floating point conversion interface.
+///
+/// @license
+///  Copyright (C) 2026  Peter Johnson
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions
+/// are met:
+///  - Redistributions of source code must retain the above copyright
+///    notice, this list of conditions and the following disclaimer.
+///  - Redistributions in binary form must reproduce the above copyright
+///    notice, this list of conditions and the following disclaimer in the
+///    documentation and/or other materials provided with the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+/// @endlicense
+///
+#include "llvm/Support/DataTypes.h"
+#include "yasmx/Config/export.h"
+
+
+namespace yasm
+{
+
+/// Convert w * 10^q to the bits of the nearest IEEE single or double
+/// precision value (round to nearest, ties to even), using the
+/// Eisel-Lemire algorithm.  Only normal results are produced; zero,
+/// subnormal, and infinite results (which may need an underflow or
+/// overflow warning) are left to the caller.
+/// @param w        decimal significand (not zero)
+/// @param q        decimal exponent
+/// @param size     result size in bits (32 or 64)
+/// @param bits     result bits (sign bit clear)
+/// @return False if the result is not a normal number.
+YASM_LIB_EXPORT
+bool DecimalToIEEE(uint64_t w, int q, unsigned int size, uint64_t* bits);
+
+} // namespace yasm
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef YASM_FILEPREFETCHER_H
+#define YASM_FILEPREFETCHER_H
+///
+/// @file
+/// @brief Background file reader interface.
+///
+/// @license
+///  Copyright (C) 2026  Peter Johnson
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions
+/// are met:
+///  - Redistributions of source code must retain the above copyright
+///    notice, this list of conditions and the following disclaimer.
+///  - Redistributions in binary form must reproduce the above copyright
+///    notice, this list of conditions and the following disclaimer in the
+///    documentation and/or other materials provided with the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+/// @endlicense
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/StringRef.h"
+#include "yasmx/Config/export.h"
+#include "yasmx/Support/scoped_ptr.h"
+
+
+namespace llvm { class MemoryBuffer; }
+
+namespace yasm
+{
+
+/// Reads files on a background thread ahead of their use, so a slow file
+/// system (e.g. a network mount) doesn't stall the caller when it gets to
+/// them.  The thread is only started by the first Prefetch().  If threads
+/// are not available, requests are ignored and Take() always returns 0.
+class YASM_LIB_EXPORT FilePrefetcher
+{
+public:
+    /// Constructor.
+    FilePrefetcher();
+
+    /// Destructor.  Abandons outstanding requests and stops the thread.
+    /// Contents that were never taken are freed.
+    ~FilePrefetcher();
+
+    /// Determine if files can be prefetched (i.e. threads are available).
+    /// @return False if requests would be ignored.
+    static bool isAvailable();
+
+    /// Start reading the first of several candidate files that exists,
+    /// e.g. an include file in each directory of a search path.  Paths
+    /// already requested are not read again, and the search stops at one
+    /// that has been (or is being) read.  May be called from any thread.
+    /// @param paths        candidate paths, in search order
+    /// @param keep         if true, keep the contents for Take(); if false,
+    ///                     only read the file through so it's in the
+    ///                     operating system's cache when next opened
+    void Prefetch(const std::vector<std::string>& paths, bool keep = true);
+
+    /// Take the prefetched contents of a file, waiting for them if the
+    /// file is queued or being read.  May be called from any thread.
+    /// @param path         path, as given to Prefetch()
+    /// @return Contents (ownership transferred to caller), or 0 if the
+    ///         file was not prefetched or could not be read.
+    llvm::MemoryBuffer* Take(llvm::StringRef path);
+
+    class Impl;
+
+private:
+    FilePrefetcher(const FilePrefetcher&);                  // not implemented
+    const FilePrefetcher& operator=(const FilePrefetcher&); // not implemented
+
+    /// Pimpl.
+    util::scoped_ptr<Impl> m_impl;
+};
+
+} // namespace yasm
+
+#endif
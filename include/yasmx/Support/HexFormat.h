@@ -0,0 +1,64 @@
+#ifndef YASM_HEXFORMAT_H
+#define YASM_HEXFORMAT_H
+///
+/// @file
+/// @brief Hexadecimal formatting interface.
+///
+/// @license
+///  Copyright (C) 2026  Peter Johnson
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions
+/// are met:
+///  - Redistributions of source code must retain the above copyright
+///    notice, this list of conditions and the following disclaimer.
+///  - Redistributions in binary form must reproduce the above copyright
+///    notice, this list of conditions and the following disclaimer in the
+///    documentation and/or other materials provided with the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+/// @endlicense
+#include <cstddef>
+
+#include "llvm/Support/DataTypes.h"
+#include "yasmx/Config/export.h"
+
+
+namespace yasm
+{
+
+/// Write a value in hexadecimal, zero padded to a minimum number of
+/// digits, without a base prefix.
+/// @param buf          output buffer; must have room for the larger of
+///                     digits and 16 characters
+/// @param val          value
+/// @param digits       minimum number of digits
+/// @param lowercase    whether hex digits should be lowercase
+/// @return Pointer just past the last digit written.
+YASM_LIB_EXPORT
+char* FormatHex(char* buf, uint64_t val, unsigned int digits = 1,
+                bool lowercase = true);
+
+/// Write bytes as pairs of hexadecimal digits, with no separators.
+/// @param buf          output buffer; must have room for 2*len characters
+/// @param data         bytes
+/// @param len          number of bytes
+/// @param lowercase    whether hex digits should be lowercase
+/// @return Pointer just past the last digit written.
+YASM_LIB_EXPORT
+char* FormatHexBytes(char* buf, const unsigned char* data, std::size_t len,
+                     bool lowercase = true);
+
+} // namespace yasm
+
+#endif
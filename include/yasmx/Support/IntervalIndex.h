@@ -0,0 +1,212 @@
+#ifndef YASM_INTERVALINDEX_H
+#define YASM_INTERVALINDEX_H
+///
+/// @file
+/// @brief Static interval index interface.
+///
+/// @license
+///  Copyright (C) 2026  Peter Johnson
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions
+/// are met:
+///  - Redistributions of source code must retain the above copyright
+///    notice, this list of conditions and the following disclaimer.
+///  - Redistributions in binary form must reproduce the above copyright
+///    notice, this list of conditions and the following disclaimer in the
+///    documentation and/or other materials provided with the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+/// @endlicense
+///
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+
+namespace yasm
+{
+
+/// Set of closed intervals, each with associated data, that is built once
+/// and then queried for the intervals overlapping a range.  Unlike
+/// IntervalTree, all intervals must be inserted before any query, which
+/// lets the index live in a single sorted array: an implicit binary tree
+/// over the array (in-order by low bound), with each node augmented with
+/// the highest bound in its subtree.  Queries don't allocate and call a
+/// visitor that can be inlined.  Once built, concurrent queries are safe.
+template <typename T>
+class IntervalIndex
+{
+public:
+    IntervalIndex() : m_max_level(-1), m_built(true) {}
+
+    /// Add an interval.  Build() must be called afterwards before querying.
+    /// @param low      low bound (inclusive)
+    /// @param high     high bound (inclusive)
+    /// @param data     associated data
+    void Insert(long low, long high, const T& data)
+    {
+        Entry entry = { low, high, high, data };
+        m_entries.push_back(entry);
+        m_built = false;
+    }
+
+    /// Index the inserted intervals.
+    void Build();
+
+    /// Get the number of intervals.
+    std::size_t size() const { return m_entries.size(); }
+
+    /// Call a visitor with the data of each interval overlapping the
+    /// closed interval [low,high], in order of increasing low bound
+    /// (intervals with the same low bound are visited in insertion order).
+    /// @param low      low bound (inclusive)
+    /// @param high     high bound (inclusive)
+    /// @param visit    visitor; called as visit(const T&)
+    template <typename Visitor>
+    void Enumerate(long low, long high, Visitor& visit) const;
+
+private:
+    struct Entry
+    {
+        long low;
+        long high;
+        long max_high;      ///< highest bound in subtree rooted here
+        T data;
+    };
+
+    static bool LowLess(const Entry& a, const Entry& b)
+    { return a.low < b.low; }
+
+    std::vector<Entry> m_entries;   ///< sorted by low after Build()
+    int m_max_level;                ///< level of the root, -1 if empty
+    bool m_built;
+};
+
+// In the implicit tree, leaves are the even indexes, and a node at level k
+// has index i with the lowest k bits set and bit k clear; its children are
+// at i -/+ 2^(k-1).  The root is at 2^max_level - 1.  The array length need
+// not be a power of two, so parts of the tree may be past the end; those
+// nodes take the highest bound of the last real node in their place.
+template <typename T>
+void
+IntervalIndex<T>::Build()
+{
+    m_built = true;
+    std::stable_sort(m_entries.begin(), m_entries.end(), LowLess);
+
+    std::size_t n = m_entries.size();
+    if (n == 0)
+    {
+        m_max_level = -1;
+        return;
+    }
+
+    std::size_t last_i = 0;
+    long last = 0;
+    for (std::size_t i=0; i<n; i+=2)
+    {
+        last_i = i;
+        last = m_entries[i].max_high = m_entries[i].high;
+    }
+
+    int k;
+    for (k=1; (static_cast<std::size_t>(1)<<k) <= n; ++k)
+    {
+        std::size_t x = static_cast<std::size_t>(1)<<(k-1);
+        std::size_t i0 = (x<<1)-1;
+        std::size_t step = x<<2;
+        for (std::size_t i=i0; i<n; i+=step)
+        {
+            long el = m_entries[i-x].max_high;
+            long er = (i+x < n) ? m_entries[i+x].max_high : last;
+            long e = m_entries[i].high;
+            if (el > e)
+                e = el;
+            if (er > e)
+                e = er;
+            m_entries[i].max_high = e;
+        }
+        last_i = ((last_i>>k) & 1) ? last_i-x : last_i+x;
+        if (last_i < n && m_entries[last_i].max_high > last)
+            last = m_entries[last_i].max_high;
+    }
+    m_max_level = k-1;
+}
+
+template <typename T>
+template <typename Visitor>
+void
+IntervalIndex<T>::Enumerate(long low, long high, Visitor& visit) const
+{
+    assert(m_built && "interval index queried before Build()");
+    if (m_max_level < 0)
+        return;
+
+    struct StackItem
+    {
+        std::size_t x;      // node index
+        int k;              // node level
+        bool left_done;     // left subtree already visited
+    };
+    StackItem stack[2*(sizeof(std::size_t)*8+1)];
+    int top = 0;
+    std::size_t n = m_entries.size();
+
+    StackItem root = {(static_cast<std::size_t>(1)<<m_max_level)-1,
+                      m_max_level, false};
+    stack[top++] = root;
+    while (top > 0)
+    {
+        StackItem z = stack[--top];
+        if (z.k <= 3)
+        {
+            // Small subtree: scan it linearly.
+            std::size_t i = (z.x >> z.k) << z.k;
+            std::size_t end = i + (static_cast<std::size_t>(1)<<(z.k+1)) - 1;
+            if (end > n)
+                end = n;
+            for (; i<end && m_entries[i].low <= high; ++i)
+            {
+                if (m_entries[i].high >= low)
+                    visit(m_entries[i].data);
+            }
+        }
+        else if (!z.left_done)
+        {
+            // Revisit this node after its left subtree, which is only
+            // worth visiting if something in it reaches low.
+            std::size_t y = z.x - (static_cast<std::size_t>(1)<<(z.k-1));
+            z.left_done = true;
+            stack[top++] = z;
+            if (y >= n || m_entries[y].max_high >= low)
+            {
+                StackItem left = {y, z.k-1, false};
+                stack[top++] = left;
+            }
+        }
+        else if (z.x < n && m_entries[z.x].low <= high)
+        {
+            if (m_entries[z.x].high >= low)
+                visit(m_entries[z.x].data);
+            StackItem right = {z.x + (static_cast<std::size_t>(1)<<(z.k-1)),
+                               z.k-1, false};
+            stack[top++] = right;
+        }
+    }
+}
+
+} // namespace yasm
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef YASM_MEMORYSTATS_H
+#define YASM_MEMORYSTATS_H
+///
+/// @file
+/// @brief Memory use accounting interface.
+///
+/// @license
+///  Copyright (C) 2026  Peter Johnson
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions
+/// are met:
+///  - Redistributions of source code must retain the above copyright
+///    notice, this list of conditions and the following disclaimer.
+///  - Redistributions in binary form must reproduce the above copyright
+///    notice, this list of conditions and the following disclaimer in the
+///    documentation and/or other materials provided with the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+/// @endlicense
+#include <cstddef>
+
+#include "yasmx/Config/export.h"
+
+
+namespace yasm
+{
+
+/// Categories of heap memory counted by memory accounting.
+enum MemoryCategory
+{
+    MEM_BYTECODE = 0,       ///< Bytecodes and their contents
+    MEM_EXPR,               ///< Heap-allocated expressions
+    MEM_SYMBOL,             ///< Symbols
+    MEM_INTNUM,             ///< Big (>128 bit) integer values
+    NUM_MEMORY_CATEGORIES
+};
+
+/// Start counting memory use.  Until this is called, CountAlloc() and
+/// CountFree() do nothing.  Memory allocated before this is called must
+/// not be counted as freed, so call this before any objects are created.
+YASM_LIB_EXPORT
+void EnableMemoryStats();
+
+/// Determine if memory use is being counted.
+/// @return True if EnableMemoryStats() has been called.
+YASM_LIB_EXPORT
+bool isMemoryStatsEnabled();
+
+/// Count an allocation.  Thread-safe.
+/// @param cat          memory category
+/// @param size         size of allocation, in bytes
+YASM_LIB_EXPORT
+void CountAlloc(MemoryCategory cat, std::size_t size);
+
+/// Count a deallocation.  Thread-safe.
+/// @param cat          memory category
+/// @param size         size of allocation, in bytes
+YASM_LIB_EXPORT
+void CountFree(MemoryCategory cat, std::size_t size);
+
+/// Get the memory use counted in a category.
+/// @param cat          memory category
+/// @param current      bytes currently allocated (output)
+/// @param peak         most bytes allocated at one time (output)
+YASM_LIB_EXPORT
+void getMemoryStats(MemoryCategory cat, std::size_t* current,
+                    std::size_t* peak);
+
+/// Get the name of a memory category, for reports.
+/// @param cat          memory category
+/// @return Name.
+YASM_LIB_EXPORT
+const char* getMemoryCategoryName(MemoryCategory cat);
+
+} // namespace yasm
+
+#endif
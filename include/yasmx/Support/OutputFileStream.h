@@ -0,0 +1,143 @@
+#ifndef YASM_OUTPUTFILESTREAM_H
+#define YASM_OUTPUTFILESTREAM_H
+///
+/// @file
+/// @brief Seekable in-memory output file stream interface.
+///
+/// @license
+///  Copyright (C) 2026  Peter Johnson
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions
+/// are met:
+///  - Redistributions of source code must retain the above copyright
+///    notice, this list of conditions and the following disclaimer.
+///  - Redistributions in binary form must reproduce the above copyright
+///    notice, this list of conditions and the following disclaimer in the
+///    documentation and/or other materials provided with the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+/// @endlicense
+///
+#include <cstddef>
+#include <map>
+#include <vector>
+
+#include "llvm/Support/DataTypes.h"
+#include "llvm/Support/raw_ostream.h"
+#include "yasmx/Basic/LLVM.h"
+#include "yasmx/Config/export.h"
+
+
+namespace yasm
+{
+
+/// An output stream that assembles a complete file image in memory and
+/// writes it to an underlying stream in one piece when closed.  Seeking
+/// only moves the in-memory position, so object formats can reserve space
+/// for headers, write the file body, and then seek back to patch the
+/// headers without flushing partial writes to disk.  Seeking past the end
+/// of the data written so far zero-fills the gap.
+///
+/// Zeros and other repeated patterns written with write_zeros() and
+/// write_fill() are kept run-length (one copy of the pattern and a count)
+/// until the file is written, so large fills cost almost no memory.
+///
+/// When the underlying stream is a seekable file, long runs of zeros in
+/// the image are skipped over rather than written on close, leaving holes
+/// that the filesystem can store sparsely.
+class YASM_LIB_EXPORT OutputFileStream : public raw_ostream
+{
+public:
+    /// Constructor.
+    /// @param os       stream to write the file image to on close
+    explicit OutputFileStream(raw_ostream& os);
+
+    /// Constructor for file output.  If the file supports seeking, runs of
+    /// at least SPARSE_THRESHOLD zero bytes are left as holes on close.
+    /// @param os       file stream to write the file image to on close
+    explicit OutputFileStream(raw_fd_ostream& os);
+
+    /// Constructor for in-memory output.  On close, the file image is
+    /// stored into the given buffer (replacing its contents).
+    /// @param image    buffer to receive the file image on close
+    explicit OutputFileStream(std::vector<char>& image);
+
+    /// Destructor.  If the stream was not closed, the file image is
+    /// discarded without being written.
+    ~OutputFileStream();
+
+    /// Move the output position.
+    /// @param off      new position from start of file
+    /// @return The new position.
+    uint64_t seek(uint64_t off);
+
+    /// Write zero bytes at the current position.  Faster than writing a
+    /// buffer of zeros, as the zeros are only recorded as a run.
+    /// @param size     number of zero bytes
+    void write_zeros(uint64_t size);
+
+    /// Write a pattern repeated a number of times at the current position.
+    /// Long fills are only recorded as a run and expanded when the file is
+    /// written.
+    /// @param pattern  pattern to repeat
+    /// @param size     pattern size, in bytes
+    /// @param count    number of copies
+    void write_fill(const char* pattern, size_t size, uint64_t count);
+
+    /// Write the file image to the underlying stream (or hand it over to
+    /// the image buffer) and release it.  Write errors are reported
+    /// through the underlying stream's has_error().  No further output is
+    /// allowed after closing.
+    void close();
+
+    /// Get the size of the file image.  Remains valid after close().
+    /// @return Size in bytes.
+    uint64_t size() const { return m_size; }
+
+    /// Minimum length of a run of zeros left as a hole in a sparse file.
+    /// This is a multiple of the block size of common filesystems.
+    static const size_t SPARSE_THRESHOLD = 64*1024;
+
+private:
+    OutputFileStream(const OutputFileStream&);                  // not implemented
+    const OutputFileStream& operator=(const OutputFileStream&); // not implemented
+
+    /// A piece of the file image: literal data (count of 1), or a pattern
+    /// repeated count times.
+    struct Extent
+    {
+        std::vector<char> data;
+        uint64_t count;
+
+        uint64_t size() const { return data.size() * count; }
+    };
+    typedef std::map<uint64_t, Extent> Extents;     // keyed by file offset
+
+    void write_impl(const char* ptr, size_t size);
+    uint64_t current_pos() const;
+    Extents::iterator split(uint64_t off);
+    void replace(Extent& extent);
+
+    raw_ostream* m_os;          ///< stream written on close, if any
+    std::vector<char>* m_image; ///< buffer receiving image if no m_os
+    raw_fd_ostream* m_fd_os;    ///< m_os if it can be written sparsely
+    Extents m_extents;          ///< file image
+    uint64_t m_size;            ///< size of file image
+    uint64_t m_pos;             ///< position in image not counting buffer
+    bool m_closed;
+};
+
+} // namespace yasm
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef YASM_PIPELINE_H
+#define YASM_PIPELINE_H
+///
+/// @file
+/// @brief Two-stage producer/consumer pipeline interface.
+///
+/// @license
+///  Copyright (C) 2026  Peter Johnson
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions
+/// are met:
+///  - Redistributions of source code must retain the above copyright
+///    notice, this list of conditions and the following disclaimer.
+///  - Redistributions in binary form must reproduce the above copyright
+///    notice, this list of conditions and the following disclaimer in the
+///    documentation and/or other materials provided with the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+/// @endlicense
+///
+#include <cstddef>
+#include <string>
+
+#include "yasmx/Config/export.h"
+#include "yasmx/Config/functional.h"
+#include "yasmx/Support/scoped_ptr.h"
+
+
+namespace yasm
+{
+
+/// Passes chunks of text from a producer running on its own thread to a
+/// consumer running on the calling thread, through a bounded queue.
+/// Chunks are moved (swapped) in and out of the queue rather than copied.
+class YASM_LIB_EXPORT Pipeline
+{
+public:
+    /// A pipeline stage.
+    typedef TR1::function<void ()> Stage;
+
+    /// Constructor.
+    /// @param max_chunks   maximum number of chunks queued at once
+    explicit Pipeline(std::size_t max_chunks);
+
+    /// Destructor.
+    ~Pipeline();
+
+    /// Determine if pipelines can be run (i.e. threads are available).
+    /// @return False if Run() would fail.
+    static bool isAvailable();
+
+    /// Run producer on a new thread and consumer on the calling thread.
+    /// Returns after both have returned.  The producer must call Close()
+    /// when done, and the consumer must Pop() until it returns false or
+    /// call Abandon().
+    /// @param producer     producer stage
+    /// @param consumer     consumer stage
+    /// @return False if the producer thread could not be started (neither
+    ///         stage is run).
+    bool Run(const Stage& producer, const Stage& consumer);
+
+    /// Queue a chunk, waiting for room if the queue is full.  Called by
+    /// the producer.  Discarded if the consumer has abandoned the pipeline.
+    /// @param chunk        chunk; left empty
+    void Push(std::string& chunk);
+
+    /// Indicate that no more chunks will be pushed.  Called by the
+    /// producer.
+    void Close();
+
+    /// Wait until the consumer has taken every queued chunk and is
+    /// waiting for more (or has abandoned the pipeline).  The consumer then
+    /// stays idle until the next Push() or Close(), so in the meantime the
+    /// producer may use state the consumer otherwise owns.  Called by the
+    /// producer.
+    void WaitIdle();
+
+    /// Get the next chunk, waiting for one if the queue is empty.  Called
+    /// by the consumer.
+    /// @param chunk        chunk (output)
+    /// @return False if the pipeline is closed and the queue is empty.
+    bool Pop(std::string& chunk);
+
+    /// Stop taking chunks; the producer's further chunks are discarded.
+    /// Called by the consumer.
+    void Abandon();
+
+    class Impl;
+
+private:
+    Pipeline(const Pipeline&);                  // not implemented
+    const Pipeline& operator=(const Pipeline&); // not implemented
+
+    /// Pimpl.
+    util::scoped_ptr<Impl> m_impl;
+};
+
+} // namespace yasm
+
+#endif
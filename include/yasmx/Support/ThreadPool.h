@@ -0,0 +1,89 @@
+#ifndef YASM_THREADPOOL_H
+#define YASM_THREADPOOL_H
+///
+/// @file
+/// @brief Worker thread pool interface.
+///
+/// @license
+///  Copyright (C) 2026  Peter Johnson
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions
+/// are met:
+///  - Redistributions of source code must retain the above copyright
+///    notice, this list of conditions and the following disclaimer.
+///  - Redistributions in binary form must reproduce the above copyright
+///    notice, this list of conditions and the following disclaimer in the
+///    documentation and/or other materials provided with the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+/// @endlicense
+///
+#include <cstddef>
+
+#include "yasmx/Config/export.h"
+#include "yasmx/Config/functional.h"
+#include "yasmx/Support/scoped_ptr.h"
+
+
+namespace yasm
+{
+
+/// A fixed-size pool of worker threads for running independent jobs.
+/// If threading is not available, or only one thread is requested, jobs
+/// are simply run in order on the calling thread.
+class YASM_LIB_EXPORT ThreadPool
+{
+public:
+    /// A job; called with the index of the job being run.
+    typedef TR1::function<void (std::size_t)> Job;
+
+    /// Constructor.
+    /// @param num_threads  number of threads to run jobs on (including the
+    ///                     calling thread); 0 selects the number of
+    ///                     processors
+    explicit ThreadPool(unsigned int num_threads);
+
+    /// Destructor.  Stops all worker threads.
+    ~ThreadPool();
+
+    /// Get the number of threads jobs are run on.
+    /// @return Number of threads (at least 1).
+    unsigned int getNumThreads() const { return m_num_threads; }
+
+    /// Run job(0) through job(count-1).  Jobs may be run in any order and
+    /// concurrently on different threads.  The calling thread also runs
+    /// jobs.  Returns after all jobs have completed.
+    /// @param count        number of jobs
+    /// @param job          job function
+    void Run(std::size_t count, const Job& job);
+
+    /// Get the number of processors available.
+    /// @return Number of processors (at least 1).
+    static unsigned int getNumProcessors();
+
+    class Impl;
+
+private:
+    ThreadPool(const ThreadPool&);                  // not implemented
+    const ThreadPool& operator=(const ThreadPool&); // not implemented
+
+    unsigned int m_num_threads;
+
+    /// Pimpl.
+    util::scoped_ptr<Impl> m_impl;
+};
+
+} // namespace yasm
+
+#endif
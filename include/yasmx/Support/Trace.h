@@ -0,0 +1,106 @@
+#ifndef YASM_TRACE_H
+#define YASM_TRACE_H
+///
+/// @file
+/// @brief Phase tracing interface.
+///
+/// @license
+///  Copyright (C) 2026  Peter Johnson
+///
+/// Redistribution and use in source and binary forms, with or without
+/// modification, are permitted provided that the following conditions
+/// are met:
+///  - Redistributions of source code must retain the above copyright
+///    notice, this list of conditions and the following disclaimer.
+///  - Redistributions in binary form must reproduce the above copyright
+///    notice, this list of conditions and the following disclaimer in the
+///    documentation and/or other materials provided with the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+/// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+/// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+/// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+/// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+/// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+/// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+/// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+/// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+/// POSSIBILITY OF SUCH DAMAGE.
+/// @endlicense
+#include <string>
+
+#include "llvm/ADT/StringRef.h"
+#include "yasmx/Config/export.h"
+
+
+namespace llvm { class raw_ostream; }
+
+namespace yasm
+{
+
+/// Start recording trace events.  Until this is called, TraceRegion,
+/// TraceBegin(), and TraceEnd() do nothing.
+YASM_LIB_EXPORT
+void EnableTrace();
+
+/// Determine if trace events are being recorded.
+/// @return True if EnableTrace() has been called.
+YASM_LIB_EXPORT
+bool isTraceEnabled();
+
+/// Write the recorded trace events in Chrome trace event (JSON) format,
+/// as read by chrome://tracing and Perfetto.
+/// @param os           output stream
+YASM_LIB_EXPORT
+void WriteTrace(llvm::raw_ostream& os);
+
+/// Begin a trace span that doesn't follow C++ scope (e.g. an include
+/// file).  Must be matched by TraceEnd() on the same thread.
+/// @param name         span name
+/// @param detail       detail (e.g. file or section name)
+YASM_LIB_EXPORT
+void TraceBegin(llvm::StringRef name, llvm::StringRef detail = "");
+
+/// End the innermost span started by TraceBegin() on this thread.
+YASM_LIB_EXPORT
+void TraceEnd();
+
+/// A trace span covering the lifetime of the object.  May be used from
+/// any thread.
+class YASM_LIB_EXPORT TraceRegion
+{
+public:
+    /// Constructor.
+    /// @param name         span name
+    /// @param detail       detail (e.g. file or section name)
+    TraceRegion(llvm::StringRef name, llvm::StringRef detail = "")
+        : m_enabled(isTraceEnabled())
+    {
+        if (m_enabled)
+            Start(name, detail);
+    }
+
+    /// Destructor.  Records the span.
+    ~TraceRegion()
+    {
+        if (m_enabled)
+            Stop();
+    }
+
+private:
+    TraceRegion(const TraceRegion&);                    // not implemented
+    const TraceRegion& operator=(const TraceRegion&);   // not implemented
+
+    void Start(llvm::StringRef name, llvm::StringRef detail);
+    void Stop();
+
+    bool m_enabled;
+    std::string m_name;
+    std::string m_detail;
+    double m_start;
+};
+
+} // namespace yasm
+
+#endif
@@ -53,6 +53,16 @@ typedef std::vector<StringRef> ModuleNames;
 namespace impl
 {
 
+/// An entry in a constant table of built-in modules.  Tables are built
+/// with YASM_MODULE_ENTRY() and terminated with YASM_MODULE_TABLE_END,
+/// so they need no code to run at startup.
+struct ModuleEntry
+{
+    unsigned int type;          ///< module type (e.g. ArchModule::module_type)
+    const char* keyword;        ///< module keyword; null ends the table
+    void* (*create)();          ///< creation function
+};
+
 // Implemented using the Singleton pattern
 class YASM_LIB_EXPORT ModuleFactory
 {
@@ -73,6 +83,12 @@ public:
     /// the function that creates the class.
     void AddCreateFn(unsigned int type, StringRef keyword, BASE_CREATE_FN func);
 
+    /// Set the built-in (standard) module tables.  The tables are used in
+    /// place, not copied.  Modules added with AddCreateFn() take
+    /// precedence over built-in modules with the same keyword.
+    /// @param tables       null-terminated list of module tables
+    void setStandardModules(const ModuleEntry* const* tables);
+
     /// Get the creation function for a given type and class name.
     /// @return NULL if not found.
     BASE_CREATE_FN getCreateFn(unsigned int type, StringRef keyword) const;
@@ -90,7 +106,16 @@ private:
     ModuleFactory(const ModuleFactory&);                  // not implemented
     const ModuleFactory& operator=(const ModuleFactory&); // not implemented
 
-    /// Pimpl for class internals.
+    /// Find a built-in module.
+    /// @return NULL if not found.
+    const ModuleEntry* FindStandard(unsigned int type, StringRef keyword)
+        const;
+
+    /// Built-in module tables.
+    const ModuleEntry* const* m_standard;
+
+    /// Pimpl for class internals; only allocated once a module is added
+    /// with AddCreateFn().
     class Impl;
     util::scoped_ptr<Impl> m_impl;
 };
@@ -103,6 +128,17 @@ void* CreateInstance()
 
 } // namespace impl
 
+/// Module table entry for a module keyword.
+/// @param ancestor     module base class (e.g. ArchModule)
+/// @param manufactured module implementation class
+/// @param keyword      module keyword (string literal)
+#define YASM_MODULE_ENTRY(ancestor, manufactured, keyword) \
+    { ancestor::module_type, keyword, \
+      &yasm::impl::CreateInstance< manufactured > }
+
+/// Module table terminator.
+#define YASM_MODULE_TABLE_END   { 0, 0, 0 }
+
 template <typename Ancestor, typename Manufactured>
 inline void
 RegisterModule(StringRef keyword)
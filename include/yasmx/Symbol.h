@@ -29,9 +29,11 @@
 /// POSSIBILITY OF SUCH DAMAGE.
 /// @endlicense
 ///
+#include <memory>
 #include <string>
 
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Atomic.h"
 #include "yasmx/Basic/LLVM.h"
 #include "yasmx/Basic/SourceLocation.h"
 #include "yasmx/Config/export.h"
@@ -53,7 +55,10 @@ class YASM_LIB_EXPORT Symbol : public AssocDataContainer
     friend class Object;
 
 public:
-    /// Constructor.
+    /// Constructor.  The name is not copied; it must remain valid for the
+    /// life of the symbol.  Object interns the names of the symbols it
+    /// creates.
+    /// @param name         symbol name
     explicit Symbol(StringRef name);
 
     /// Destructor.
@@ -91,6 +96,14 @@ public:
     bool isUsed() const { return (m_status & USED) ? true : false; }
     bool isDefined() const { return (m_status & DEFINED) ? true : false; }
     bool isValued() const { return (m_status & VALUED) ? true : false; }
+    bool isDifferenced() const { return m_differenced != 0; }
+
+    /// Mark a label as used in a difference with another label in the same
+    /// section.  The value of such a difference depends on the distance
+    /// between the labels, so they must not be moved independently once
+    /// the difference is resolved.
+    /// @note Safe to call concurrently; values are finalized in parallel.
+    void UseInDifference();
 
     /// Set the source location where a symbol was first defined.
     /// @param source   source location
@@ -116,6 +129,25 @@ public:
     /// @return EQU value, or NULL if symbol is not an EQU or is not defined.
     /*@null@*/ const Expr* getEqu() const;
 
+    /// Get fully expanded EQU value of a symbol, as memoized by ExpandEqu().
+    /// The expanded value contains no further EQU references.
+    /// @return Expanded EQU value, or NULL if not memoized.
+    /*@null@*/ const Expr* getExpandedEqu() const
+    { return m_equ_expanded.get(); }
+
+    /// Get EQU value of a symbol folded to an integer constant, as memoized
+    /// by ExpandEqu().
+    /// @return Folded EQU value, or NULL if not memoized or not constant.
+    /*@null@*/ const Expr* getFoldedEqu() const
+    { return m_equ_folded.get(); }
+
+    /// Memoize the fully expanded EQU value of a symbol.
+    /// @param expanded expanded EQU value
+    /// @param folded   expanded EQU value folded to an integer constant
+    ///                 (may be NULL)
+    void setExpandedEqu(std::auto_ptr<Expr> expanded,
+                        std::auto_ptr<Expr> folded);
+
     /// Get the label location of a symbol.
     /// @param sym       symbol
     /// @param loc       label location (output)
@@ -167,6 +199,12 @@ public:
                             SourceLocation source,
                             DiagnosticsEngine& diags);
 
+    /// Move a label to a new location, e.g. when the contents of its
+    /// section are rearranged after optimization.
+    /// @note Asserts if not a label.
+    /// @param loc      new location of label
+    void MoveLabel(Location loc);
+
     /// Define a special symbol.  Special symbols have no generic associated
     /// data (such as an expression or precbc).
     /// @note Asserts if already defined.
@@ -231,10 +269,11 @@ private:
 
     bool DefineCheck(SourceLocation source, DiagnosticsEngine& diags) const;
 
-    std::string m_name;
+    StringRef m_name;
     Type m_type;
     int m_status;
     int m_visibility;
+    volatile llvm::sys::cas_flag m_differenced; ///< see UseInDifference()
     SourceLocation m_def_source;    ///< where symbol was first defined
     SourceLocation m_decl_source;   ///< where symbol was first declared
     SourceLocation m_use_source;    ///< where symbol was first used
@@ -242,6 +281,8 @@ private:
     // Possible data
 
     util::scoped_ptr<Expr> m_equ;   ///< EQU value
+    util::scoped_ptr<Expr> m_equ_expanded;  ///< memoized expanded EQU value
+    util::scoped_ptr<Expr> m_equ_folded;    ///< memoized folded EQU value
 
     /// Label location
     Location m_loc;
@@ -32,8 +32,6 @@
 #include <algorithm>
 #include <memory>
 
-#include <boost/scoped_ptr.hpp>
-
 #include "yasmx/Basic/DiagnosticKinds.h"
 #include "yasmx/Basic/SourceLocation.h"
 #include "yasmx/Config/export.h"
@@ -166,12 +164,13 @@ public:
 
     /// Get the absolute portion of the value.
     /// @return Absolute expression, or NULL if there is no absolute portion.
-    Expr* getAbs() { return m_abs.get(); }
-    const Expr* getAbs() const { return m_abs.get(); }
+    Expr* getAbs() { return m_abs_int ? ExpandAbs() : m_abs.expr; }
+    const Expr* getAbs() const
+    { return m_abs_int ? ExpandAbs() : m_abs.expr; }
 
     /// Determine if the value has an absolute portion.
     /// @return True if value has absolute portion, false if not.
-    bool hasAbs() const { return m_abs.get() != 0; }
+    bool hasAbs() const { return m_abs_int || m_abs.expr != 0; }
 
     /// Add integer to the absolute portion of the value.
     void AddAbs(const IntNum& delta);
@@ -185,12 +184,13 @@ public:
 
     /// Get the WRT portion of the value.
     /// @return WRT symbol, or NULL if there isn't one.
-    SymbolRef getWRT() const { return m_wrt; }
+    SymbolRef getWRT() const
+    { return m_extra ? m_extra->wrt : SymbolRef(0); }
 
     /// Get the subtractive relative portion of the value as a symbol.
     /// @return Subtractive symbol, or NULL if there isn't one.
     SymbolRef getSubSymbol() const
-    { return SymbolRef(m_sub_sym ? m_sub.sym : 0); }
+    { return SymbolRef(m_sub_sym ? m_extra->sub.sym : 0); }
 
     /// Get the subtractive relative portion of the value as a location.
     /// Handles both locations and labels.
@@ -249,7 +249,7 @@ public:
 
     /// Determine if the value is WRT anything.
     /// @return True if value has WRT portion, false if not.
-    bool isWRT() const { return m_wrt != 0; }
+    bool isWRT() const { return m_extra && m_extra->wrt != 0; }
 
     /// Determine if there is a subtractive relative portion of the value.
     /// @return True if value has a subtractive relative portion, false if not.
@@ -326,38 +326,77 @@ public:
     enum { RSHIFT_MAX = 127 };
 
 private:
+    /// Parts of the value most values don't have; allocated on first use.
+    struct Extra
+    {
+        /// What the relative portion is in reference to.  NULL if the
+        /// default.
+        SymbolRef wrt;
+
+        /// Subtractive relative element.
+        /// Usually in a different section than m_rel; unless there's a WRT
+        /// portion or other modification of m_rel, differences in the same
+        /// section should be in m_abs.
+        union
+        {
+            Symbol* sym;    ///< Symbol if m_sub_sym is nonzero.
+            Location loc;   ///< Location if m_sub_loc is nonzero.
+        } sub;
+    };
+
     bool FinalizeScan(Expr& e, bool ssym_ok, int* pos);
 
+    /// Store the absolute portion as a plain integer if it is one that fits,
+    /// freeing the expression.
+    void CompactAbs();
+
+    /// Turn a plain integer absolute portion back into an expression.
+    /// @return Absolute expression.
+    Expr* ExpandAbs() const;
+
+    /// Free the absolute portion.
+    void ClearAbs();
+
+    /// Get the absolute portion as an expression, creating an empty one if
+    /// there is no absolute portion.
+    Expr& MakeAbs();
+
+    /// Get the rarely used parts of the value, allocating them if needed.
+    Extra& MakeExtra();
+
+    /// Absolute portion storage.
+    union Abs
+    {
+        Expr* expr;         ///< Expression if m_abs_int is zero (owned).
+        long intn;          ///< Integer if m_abs_int is nonzero.
+    };
+
     /// The absolute portion of the value.  May contain *differences* between
     /// symrecs but not standalone symrecs.  May be NULL if there is no
-    /// absolute portion (e.g. the absolute portion is 0).
-    boost::scoped_ptr<Expr> m_abs;
+    /// absolute portion (e.g. the absolute portion is 0).  An integer that
+    /// fits in a long is kept as just the integer (m_abs_int is set) to
+    /// save allocating an expression for the common symbol+addend case;
+    /// getAbs() expands it on demand.
+    mutable Abs m_abs;
 
     /// The relative portion of the value.  This is the portion that may
     /// need to generate a relocation.  May be NULL if no relative portion.
     SymbolRef m_rel;
 
-    /// What the relative portion is in reference to.  NULL if the default.
-    SymbolRef m_wrt;
-
-    /// Subtractive relative element.
-    /// Usually in a different section than m_rel; unless there's a WRT portion
-    /// or other modification of m_rel, differences in the same section should
-    /// be in m_abs.
-    union
-    {
-        Symbol* sym;        ///< Symbol if m_sub_sym is nonzero.
-        Location loc;       ///< Location if m_sub_loc is nonzero.
-    } m_sub;
+    /// WRT and subtractive relative portions, or NULL if neither (owned).
+    Extra* m_extra;
 
     /// Source range.
     SourceRange m_source;
 
-    /// If m_sub is a symbol.  Boolean.
+    /// If m_abs is an integer rather than an expression.  Boolean.
+    mutable unsigned int m_abs_int : 1;
+
+    /// If m_extra->sub is a symbol.  Boolean.
     /// Should not be set if m_sub_loc is set.
     unsigned int m_sub_sym : 1;
 
-    /// If m_sub is a location.  Boolean.
+    /// If m_extra->sub is a location.  Boolean.
     /// Should not be set if m_sub_sym is set.
     unsigned int m_sub_loc : 1;
 
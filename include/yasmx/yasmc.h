@@ -0,0 +1,139 @@
+#ifndef YASM_YASMC_H
+#define YASM_YASMC_H
+/*
+ * @file
+ * @brief C interface for embedding the assembler.
+ *
+ * @license
+ *  Copyright (C) 2026  Peter Johnson
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  - Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  - Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * @endlicense
+ *
+ * Unlike the C++ classes, this interface is kept stable across releases.
+ * A context holds an assembler configured for one architecture, parser,
+ * and object format; it keeps its instruction tables and file caches
+ * from one assembly to the next.  A context may only be used by one
+ * thread at a time, but different contexts may be used concurrently
+ * (contexts using the nasm parser take turns, as its preprocessor keeps
+ * global state).  Note the nasm preprocessor still prints its warnings and
+ * nonfatal errors on stderr; fatal ones such as a missing include file
+ * are reported in the diagnostics.
+ */
+#include <stddef.h>
+
+#include "yasmx/Config/export.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Assembler context. */
+typedef struct yasm_ctx yasm_ctx;
+
+/**
+ * Object file output callback.
+ * @param data      user data passed to yasm_assemble_buffer()
+ * @param obj       object file contents
+ * @param len       length of object file, in bytes
+ */
+typedef void (*yasm_output_func)(void* data, const void* obj, size_t len);
+
+/**
+ * Create an assembler context.
+ * @param arch      architecture keyword (e.g. "x86")
+ * @param parser    parser keyword (e.g. "nasm"); NULL for the default
+ * @param objfmt    object format keyword (e.g. "elf64")
+ * @return New context, or NULL if a keyword is unknown.
+ */
+YASM_C_EXPORT
+yasm_ctx* yasm_ctx_create(const char* arch,
+                          const char* parser,
+                          const char* objfmt);
+
+/**
+ * Destroy an assembler context.
+ * @param ctx       context (may be NULL)
+ */
+YASM_C_EXPORT
+void yasm_ctx_destroy(yasm_ctx* ctx);
+
+/**
+ * Set the machine of the architecture (e.g. "amd64").
+ * @param ctx       context
+ * @param machine   machine keyword
+ * @return 0 on success, nonzero if the machine is unknown.
+ */
+YASM_C_EXPORT
+int yasm_ctx_set_machine(yasm_ctx* ctx, const char* machine);
+
+/**
+ * Add a directory to search for include files.  The assembled buffer has
+ * no directory of its own, so relative includes are only found here.
+ * Like yasm_ctx_reset(), this releases the results of the last assembly.
+ * @param ctx       context
+ * @param path      directory path
+ * @return 0 on success, nonzero if the directory doesn't exist.
+ */
+YASM_C_EXPORT
+int yasm_ctx_add_include_path(yasm_ctx* ctx, const char* path);
+
+/**
+ * Assemble source text into an object file.  Diagnostics are available
+ * from yasm_ctx_diagnostics() until the next call.
+ * @param ctx       context
+ * @param src       source text
+ * @param len       length of source text, in bytes
+ * @param out       called with the object file on success
+ * @param data      user data passed to out
+ * @return 0 on success, nonzero if an error occurred.
+ */
+YASM_C_EXPORT
+int yasm_assemble_buffer(yasm_ctx* ctx,
+                         const char* src,
+                         size_t len,
+                         yasm_output_func out,
+                         void* data);
+
+/**
+ * Get the diagnostics (errors and warnings) of the last assembly, formatted
+ * as the yasm command prints them.
+ * @param ctx       context
+ * @return Diagnostics text; valid until the context is next used.
+ */
+YASM_C_EXPORT
+const char* yasm_ctx_diagnostics(yasm_ctx* ctx);
+
+/**
+ * Release the results of the last assembly and forget all cached files,
+ * so included files changed since are read again.  The configuration and
+ * instruction tables are kept.
+ * @param ctx       context
+ */
+YASM_C_EXPORT
+void yasm_ctx_reset(yasm_ctx* ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -28,6 +28,7 @@
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/Mutex.h"
+#include "llvm/Support/Timer.h"
 #include "llvm/ADT/StringExtras.h"
 #include <algorithm>
 #include <cstring>
@@ -42,6 +43,10 @@ namespace llvm { extern raw_ostream *CreateInfoOutputFile(); }
 static cl::opt<bool>
 Enabled("stats", cl::desc("Enable statistics output from program"));
 
+/// -stats-json - Emit statistics (and any running timers) as JSON.
+static cl::opt<bool>
+StatsAsJSON("stats-json", cl::desc("Display statistics as json data"));
+
 
 namespace {
 /// StatisticInfo - This class is used in a ManagedStatic so that it is created
@@ -51,6 +56,7 @@ class StatisticInfo {
   std::vector<const Statistic*> Stats;
   friend void llvm::PrintStatistics();
   friend void llvm::PrintStatistics(raw_ostream &OS);
+  friend void llvm::PrintStatisticsJSON(raw_ostream &OS);
 public:
   ~StatisticInfo();
 
@@ -70,7 +76,7 @@ void Statistic::RegisterStatistic() {
   // printed.
   sys::SmartScopedLock<true> Writer(*StatLock);
   if (!Initialized) {
-    if (Enabled)
+    if (Enabled || StatsAsJSON)
       StatInfo->addStatistic(this);
 
     TsanHappensBefore(this);
@@ -109,6 +115,10 @@ bool llvm::AreStatisticsEnabled() {
   return Enabled;
 }
 
+bool llvm::AreStatisticsJSONEnabled() {
+  return StatsAsJSON;
+}
+
 void llvm::PrintStatistics(raw_ostream &OS) {
   StatisticInfo &Stats = *StatInfo;
 
@@ -141,6 +151,39 @@ void llvm::PrintStatistics(raw_ostream &OS) {
 
 }
 
+static void WriteJSONString(raw_ostream &OS, StringRef Str) {
+  OS << '"';
+  for (StringRef::iterator I = Str.begin(), E = Str.end(); I != E; ++I) {
+    if (*I == '"' || *I == '\\')
+      OS << '\\';
+    OS << *I;
+  }
+  OS << '"';
+}
+
+void llvm::PrintStatisticsJSON(raw_ostream &OS) {
+  StatisticInfo &Stats = *StatInfo;
+
+  std::stable_sort(Stats.Stats.begin(), Stats.Stats.end(), NameCompare());
+
+  // Keys are "<debug type>.<description>", as the variable name of a
+  // statistic is not recorded.
+  OS << "{\n";
+  const char *delim = "";
+  for (size_t i = 0, e = Stats.Stats.size(); i != e; ++i) {
+    const Statistic *Stat = Stats.Stats[i];
+    OS << delim << '\t';
+    WriteJSONString(OS, std::string(Stat->getName()) + '.' + Stat->getDesc());
+    OS << ": " << Stat->getValue();
+    delim = ",\n";
+  }
+  // Print timers.
+  TimerGroup::printAllJSONValues(OS, delim);
+
+  OS << "\n}\n";
+  OS.flush();
+}
+
 void llvm::PrintStatistics() {
   StatisticInfo &Stats = *StatInfo;
 
@@ -149,6 +192,9 @@ void llvm::PrintStatistics() {
 
   // Get the stream to write to.
   raw_ostream &OutStream = *CreateInfoOutputFile();
-  PrintStatistics(OutStream);
+  if (StatsAsJSON)
+    PrintStatisticsJSON(OutStream);
+  else
+    PrintStatistics(OutStream);
   delete &OutStream;   // Close the file.
 }
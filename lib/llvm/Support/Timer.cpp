@@ -12,6 +12,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/Support/Timer.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ManagedStatic.h"
@@ -41,6 +42,29 @@ static std::string &getLibSupportInfoOutputFilename() {
 
 static ManagedStatic<sys::SmartMutex<true> > TimerLock;
 
+typedef std::vector<std::pair<TimeRecord, std::string> > JSONTimerList;
+
+/// getJSONTimers - Timing data of groups that went away while -stats-json is
+/// active, keyed by "<group>.<timer>".  These are emitted along with the
+/// statistics rather than printed on their own.  This is a plain static
+/// rather than a ManagedStatic so it outlives the statistics, which are
+/// printed during llvm_shutdown.  Protected by TimerLock.
+static JSONTimerList &getJSONTimers() {
+  static JSONTimerList Timers;
+  return Timers;
+}
+
+static const char *printJSONTimeRecord(raw_ostream &OS, const char *delim,
+                                       StringRef Key, const TimeRecord &T) {
+  OS << delim << "\t\"time." << Key << ".wall\": "
+     << format("%.6f", T.getWallTime());
+  OS << ",\n\t\"time." << Key << ".user\": "
+     << format("%.6f", T.getUserTime());
+  OS << ",\n\t\"time." << Key << ".sys\": "
+     << format("%.6f", T.getSystemTime());
+  return ",\n";
+}
+
 namespace {
   static cl::opt<bool>
   TrackSpace("track-memory", cl::desc("Enable -time-passes memory "
@@ -291,7 +315,16 @@ void TimerGroup::removeTimer(Timer &T) {
   // them were started.
   if (FirstTimer != 0 || TimersToPrint.empty())
     return;
-  
+
+  // Leave the report for PrintStatisticsJSON().
+  if (AreStatisticsJSONEnabled()) {
+    for (unsigned i = 0, e = TimersToPrint.size(); i != e; ++i)
+      getJSONTimers().push_back(std::make_pair(TimersToPrint[i].first,
+          Name + '.' + TimersToPrint[i].second));
+    TimersToPrint.clear();
+    return;
+  }
+
   raw_ostream *OutStream = CreateInfoOutputFile();
   PrintQueuedTimers(*OutStream);
   delete OutStream;   // Close the file.
@@ -384,3 +417,37 @@ void TimerGroup::printAll(raw_ostream &OS) {
   for (TimerGroup *TG = TimerGroupList; TG; TG = TG->Next)
     TG->print(OS);
 }
+
+const char *TimerGroup::printJSONValues(raw_ostream &OS, const char *delim) {
+  sys::SmartScopedLock<true> L(*TimerLock);
+
+  // Queue started timers along with any already queued by removeTimer().
+  for (Timer *T = FirstTimer; T; T = T->Next) {
+    if (!T->Started) continue;
+    TimersToPrint.push_back(std::make_pair(T->Time, T->Name));
+    T->Started = 0;
+    T->Time = TimeRecord();
+  }
+
+  for (unsigned i = 0, e = TimersToPrint.size(); i != e; ++i)
+    delim = printJSONTimeRecord(OS, delim,
+                                Name + '.' + TimersToPrint[i].second,
+                                TimersToPrint[i].first);
+  TimersToPrint.clear();
+  return delim;
+}
+
+const char *TimerGroup::printAllJSONValues(raw_ostream &OS,
+                                           const char *delim) {
+  sys::SmartScopedLock<true> L(*TimerLock);
+
+  JSONTimerList &Timers = getJSONTimers();
+  for (unsigned i = 0, e = Timers.size(); i != e; ++i)
+    delim = printJSONTimeRecord(OS, delim, Timers[i].second,
+                                Timers[i].first);
+  Timers.clear();
+
+  for (TimerGroup *TG = TimerGroupList; TG; TG = TG->Next)
+    delim = TG->printJSONValues(OS, delim);
+  return delim;
+}
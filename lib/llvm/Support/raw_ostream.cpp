@@ -426,7 +426,7 @@ void format_object_base::home() {
 /// if no error occurred.
 raw_fd_ostream::raw_fd_ostream(const char *Filename, std::string &ErrorInfo,
                                unsigned Flags)
-  : Error(false), UseAtomicWrites(false), pos(0)
+  : Error(false), UseAtomicWrites(false), SupportsSeeking(false), pos(0)
 {
   assert(Filename != 0 && "Filename is null");
   // Verify that we don't have both "append" and "excl".
@@ -472,13 +472,19 @@ raw_fd_ostream::raw_fd_ostream(const char *Filename, std::string &ErrorInfo,
 
   // Ok, we successfully opened the file, so it'll need to be closed.
   ShouldClose = true;
+
+  // Appended writes ignore the file position, and pipes and devices
+  // cannot seek at all.
+  SupportsSeeking = !(Flags & F_Append) &&
+                    ::lseek(FD, 0, SEEK_CUR) != (off_t)-1;
 }
 
 /// raw_fd_ostream ctor - FD is the file descriptor that this writes to.  If
 /// ShouldClose is true, this closes the file when the stream is destroyed.
 raw_fd_ostream::raw_fd_ostream(int fd, bool shouldClose, bool unbuffered)
   : raw_ostream(unbuffered), FD(fd),
-    ShouldClose(shouldClose), Error(false), UseAtomicWrites(false) {
+    ShouldClose(shouldClose), Error(false), UseAtomicWrites(false),
+    SupportsSeeking(false) {
 #ifdef O_BINARY
   // Setting STDOUT and STDERR to binary mode is necessary in Win32
   // to avoid undesirable linefeed conversion.
@@ -3467,6 +3467,20 @@ namespace pugi
 		return *this;
 	}
 
+#ifdef PUGIXML_HAS_LONG_LONG
+	xml_attribute& xml_attribute::operator=(long long rhs)
+	{
+		set_value(rhs);
+		return *this;
+	}
+
+	xml_attribute& xml_attribute::operator=(unsigned long long rhs)
+	{
+		set_value(rhs);
+		return *this;
+	}
+#endif
+
 	xml_attribute& xml_attribute::operator=(double rhs)
 	{
 		set_value(rhs);
@@ -3553,6 +3567,38 @@ namespace pugi
 	#endif
 	}
 
+#ifdef PUGIXML_HAS_LONG_LONG
+	bool xml_attribute::set_value(long long rhs)
+	{
+		char buf[128];
+		sprintf(buf, "%lld", rhs);
+
+	#ifdef PUGIXML_WCHAR_MODE
+		char_t wbuf[128];
+		widen_ascii(wbuf, buf);
+
+		return set_value(wbuf);
+	#else
+		return set_value(buf);
+	#endif
+	}
+
+	bool xml_attribute::set_value(unsigned long long rhs)
+	{
+		char buf[128];
+		sprintf(buf, "%llu", rhs);
+
+	#ifdef PUGIXML_WCHAR_MODE
+		char_t wbuf[128];
+		widen_ascii(wbuf, buf);
+
+		return set_value(wbuf);
+	#else
+		return set_value(buf);
+	#endif
+	}
+#endif
+
 	bool xml_attribute::set_value(double rhs)
 	{
 		char buf[128];
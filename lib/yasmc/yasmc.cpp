@@ -0,0 +1,227 @@
+//
+// C interface for embedding the assembler.
+//
+//  Copyright (C) 2026  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include "yasmx/yasmc.h"
+
+#include <string>
+#include <vector>
+
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Mutex.h"
+#include "llvm/Support/raw_ostream.h"
+#include "yasmx/Basic/Diagnostic.h"
+#include "yasmx/Basic/FileManager.h"
+#include "yasmx/Basic/SourceManager.h"
+#include "yasmx/Frontend/DiagnosticOptions.h"
+#include "yasmx/Frontend/TextDiagnosticPrinter.h"
+#include "yasmx/Parse/DirectoryLookup.h"
+#include "yasmx/Parse/HeaderSearch.h"
+#include "yasmx/Support/scoped_ptr.h"
+#include "yasmx/System/plugin.h"
+#include "yasmx/Assembler.h"
+
+
+using namespace yasm;
+
+// Guards loading the standard modules.
+static llvm::sys::Mutex init_lock;
+static bool initialized = false;
+
+// The nasm preprocessor keeps its state in globals, so only one context at
+// a time can use it.
+static llvm::sys::Mutex nasm_lock;
+
+struct yasm_ctx
+{
+    yasm_ctx(StringRef arch, StringRef parser, StringRef objfmt);
+
+    // Set up the file and source managers and header search.
+    void InitFiles();
+
+    // Prepare for the next assembly.
+    void Clear();
+
+    std::string diag_text;
+    llvm::raw_string_ostream diag_os;
+    DiagnosticOptions diag_opts;
+    TextDiagnosticPrinter diag_printer;
+    DiagnosticsEngine diags;
+    FileSystemOptions fs_opts;
+    util::scoped_ptr<FileManager> file_mgr;
+    util::scoped_ptr<SourceManager> source_mgr;
+    util::scoped_ptr<HeaderSearch> headers;
+    std::vector<std::string> include_paths;
+    util::scoped_ptr<Assembler> assembler;
+    bool nasm;
+    bool used;
+};
+
+yasm_ctx::yasm_ctx(StringRef arch, StringRef parser, StringRef objfmt)
+    : diag_os(diag_text)
+    , diag_printer(diag_os, diag_opts)
+    , diags(IntrusiveRefCntPtr<DiagnosticIDs>(new DiagnosticIDs),
+            &diag_printer, false)
+    , nasm(parser.equals_lower("nasm"))
+    , used(false)
+{
+    InitFiles();
+    assembler.reset(new Assembler(arch, objfmt, diags));
+    if (!diags.hasErrorOccurred())
+        assembler->setParser(parser, diags);
+}
+
+void
+yasm_ctx::InitFiles()
+{
+    headers.reset(0);
+    source_mgr.reset(0);
+    file_mgr.reset(new FileManager(fs_opts));
+    source_mgr.reset(new SourceManager(diags, *file_mgr));
+    diags.setSourceManager(source_mgr.get());
+    headers.reset(new HeaderSearch(*file_mgr));
+
+    std::vector<DirectoryLookup> dirs;
+    for (std::vector<std::string>::iterator i=include_paths.begin(),
+         end=include_paths.end(); i != end; ++i)
+        dirs.push_back(DirectoryLookup(file_mgr->getDirectory(*i), true));
+    headers->SetSearchPaths(dirs, 0, false);
+}
+
+void
+yasm_ctx::Clear()
+{
+    if (used)
+    {
+        assembler->Reset();
+        source_mgr->clearIDTables();
+        used = false;
+    }
+    diags.Reset();
+    diag_os.flush();
+    diag_text.clear();
+}
+
+yasm_ctx*
+yasm_ctx_create(const char* arch, const char* parser, const char* objfmt)
+{
+    {
+        llvm::sys::ScopedLock lock(init_lock);
+        if (!initialized)
+        {
+            if (!LoadStandardPlugins())
+                return 0;
+            initialized = true;
+        }
+    }
+
+    yasm_ctx* ctx = new yasm_ctx(arch, parser ? parser : "nasm", objfmt);
+    if (ctx->diags.hasErrorOccurred())
+    {
+        delete ctx;
+        return 0;
+    }
+    return ctx;
+}
+
+void
+yasm_ctx_destroy(yasm_ctx* ctx)
+{
+    delete ctx;
+}
+
+int
+yasm_ctx_set_machine(yasm_ctx* ctx, const char* machine)
+{
+    ctx->Clear();
+    return ctx->assembler->setMachine(machine, ctx->diags) ? 0 : 1;
+}
+
+int
+yasm_ctx_add_include_path(yasm_ctx* ctx, const char* path)
+{
+    const DirectoryEntry* dir = ctx->file_mgr->getDirectory(path);
+    if (!dir)
+        return 1;
+    // The assembler and parser of the last assembly refer to the file
+    // managers about to be replaced.
+    ctx->Clear();
+    ctx->include_paths.push_back(path);
+    ctx->InitFiles();
+    return 0;
+}
+
+int
+yasm_assemble_buffer(yasm_ctx* ctx,
+                     const char* src,
+                     size_t len,
+                     yasm_output_func out,
+                     void* data)
+{
+    ctx->Clear();
+    ctx->used = true;
+
+    Assembler& assembler = *ctx->assembler;
+    SourceManager& source_mgr = *ctx->source_mgr;
+    DiagnosticsEngine& diags = ctx->diags;
+
+    source_mgr.createMainFileIDForMemBuffer(
+        MemoryBuffer::getMemBufferCopy(StringRef(src, len), "<buffer>"));
+
+    std::vector<char> obj;
+    if (ctx->nasm)
+        nasm_lock.acquire();
+    bool ok = assembler.InitObject(source_mgr, diags);
+    if (ok)
+    {
+        assembler.InitParser(source_mgr, diags, *ctx->headers);
+        ok = !diags.hasErrorOccurred()
+            && assembler.Assemble(source_mgr, diags)
+            && assembler.Output(obj, diags);
+    }
+    if (ctx->nasm)
+        nasm_lock.release();
+
+    ctx->diag_os.flush();
+    if (!ok)
+        return 1;
+    if (out)
+        out(data, obj.empty() ? 0 : &obj[0], obj.size());
+    return 0;
+}
+
+const char*
+yasm_ctx_diagnostics(yasm_ctx* ctx)
+{
+    ctx->diag_os.flush();
+    return ctx->diag_text.c_str();
+}
+
+void
+yasm_ctx_reset(yasm_ctx* ctx)
+{
+    ctx->Clear();
+    ctx->InitFiles();
+}
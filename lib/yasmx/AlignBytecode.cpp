@@ -26,6 +26,8 @@
 ///
 #include "yasmx/BytecodeContainer.h"
 
+#include <algorithm>
+
 #include "yasmx/Basic/Diagnostic.h"
 #include "yasmx/Support/scoped_ptr.h"
 #include "yasmx/BytecodeOutput.h"
@@ -53,22 +55,26 @@ public:
 
     /// Calculates the minimum size of a bytecode.
     bool CalcLen(Bytecode& bc,
-                 /*@out@*/ unsigned long* len,
+                 /*@out@*/ uint64_t* len,
                  const Bytecode::AddSpanFunc& add_span,
                  DiagnosticsEngine& diags);
 
     /// Recalculates the bytecode's length based on an expanded span
     /// length.
     bool Expand(Bytecode& bc,
-                unsigned long* len,
+                uint64_t* len,
                 int span,
-                long old_val,
-                long new_val,
+                int64_t old_val,
+                int64_t new_val,
                 bool* keep,
-                /*@out@*/ long* neg_thres,
-                /*@out@*/ long* pos_thres,
+                /*@out@*/ int64_t* neg_thres,
+                /*@out@*/ int64_t* pos_thres,
                 DiagnosticsEngine& diags);
 
+    /// Gets the period of offsets with the same length.
+    bool getOffsetPeriod(const Bytecode& bc,
+                         /*@out@*/ uint64_t* period) const;
+
     /// Convert a bytecode into its byte representation.
     bool Output(Bytecode& bc, BytecodeOutput& bc_out);
 
@@ -161,31 +167,31 @@ AlignBytecode::Finalize(Bytecode& bc, DiagnosticsEngine& diags)
 
 bool
 AlignBytecode::CalcLen(Bytecode& bc,
-                       /*@out@*/ unsigned long* len,
+                       /*@out@*/ uint64_t* len,
                        const Bytecode::AddSpanFunc& add_span,
                        DiagnosticsEngine& diags)
 {
     bool keep = false;
-    long neg_thres = 0;
-    long pos_thres = 0;
+    int64_t neg_thres = 0;
+    int64_t pos_thres = 0;
 
     *len = 0;
-    return Expand(bc, len, 0, 0, static_cast<long>(bc.getTailOffset()),
+    return Expand(bc, len, 0, 0, static_cast<int64_t>(bc.getTailOffset()),
                   &keep, &neg_thres, &pos_thres, diags);
 }
 
 bool
 AlignBytecode::Expand(Bytecode& bc,
-                      unsigned long* len,
+                      uint64_t* len,
                       int span,
-                      long old_val,
-                      long new_val,
+                      int64_t old_val,
+                      int64_t new_val,
                       bool* keep,
-                      /*@out@*/ long* neg_thres,
-                      /*@out@*/ long* pos_thres,
+                      /*@out@*/ int64_t* neg_thres,
+                      /*@out@*/ int64_t* pos_thres,
                       DiagnosticsEngine& diags)
 {
-    unsigned long boundary = m_boundary.getIntNum().getUInt();
+    uint64_t boundary = m_boundary.getIntNum().getUInt64();
 
     if (boundary == 0)
     {
@@ -195,19 +201,19 @@ AlignBytecode::Expand(Bytecode& bc,
         return true;
     }
 
-    unsigned long end = static_cast<unsigned long>(new_val);
+    uint64_t end = static_cast<uint64_t>(new_val);
     if (end & (boundary-1))
         end = (end & ~(boundary-1)) + boundary;
 
-    *pos_thres = static_cast<long>(end);
-    *len = end - static_cast<unsigned long>(new_val);
+    *pos_thres = static_cast<int64_t>(end);
+    *len = end - static_cast<uint64_t>(new_val);
 
     if (!m_maxskip.isEmpty())
     {
-        unsigned long maxskip = m_maxskip.getIntNum().getUInt();
+        uint64_t maxskip = m_maxskip.getIntNum().getUInt64();
         if (*len > maxskip)
         {
-            *pos_thres = static_cast<long>(end-maxskip)-1;
+            *pos_thres = static_cast<int64_t>(end-maxskip)-1;
             *len = 0;
         }
     }
@@ -215,19 +221,34 @@ AlignBytecode::Expand(Bytecode& bc,
     return true;
 }
 
+bool
+AlignBytecode::getOffsetPeriod(const Bytecode& bc, uint64_t* period) const
+{
+    // The padding (and so the maximum skip check) only depends on the
+    // offset modulo the boundary.
+    uint64_t boundary = m_boundary.getIntNum().getUInt64();
+    if (boundary == 0)
+        *period = 1;
+    else if ((boundary & (boundary-1)) == 0)
+        *period = boundary;
+    else
+        return false;
+    return true;
+}
+
 bool
 AlignBytecode::Output(Bytecode& bc, BytecodeOutput& bc_out)
 {
-    unsigned long len;
-    unsigned long boundary = m_boundary.getIntNum().getUInt();
+    uint64_t len;
+    uint64_t boundary = m_boundary.getIntNum().getUInt64();
     Bytes& bytes = bc_out.getScratch();
 
     if (boundary == 0)
         return true;
     else
     {
-        unsigned long tail = bc.getTailOffset();
-        unsigned long end = tail;
+        uint64_t tail = bc.getTailOffset();
+        uint64_t end = tail;
         if (tail & (boundary-1))
             end = (tail & ~(boundary-1)) + boundary;
         len = end - tail;
@@ -235,7 +256,7 @@ AlignBytecode::Output(Bytecode& bc, BytecodeOutput& bc_out)
             return true;
         if (!m_maxskip.isEmpty())
         {
-            unsigned long maxskip = m_maxskip.getIntNum().getUInt();
+            uint64_t maxskip = m_maxskip.getIntNum().getUInt64();
             if (len > maxskip)
                 return true;
         }
@@ -263,13 +284,20 @@ AlignBytecode::Output(Bytecode& bc, BytecodeOutput& bc_out)
             return false;
         }
 
-        // Fill with maximum code fill as much as possible
-        while (len > maxlen)
+        // Fill with maximum code fill as much as possible.  Large gaps are
+        // built by copying the first pattern and then repeatedly doubling
+        // the filled block.
+        if (len > maxlen)
         {
-            bytes.insert(bytes.end(),
-                         &m_code_fill[maxlen][0],
-                         &m_code_fill[maxlen][maxlen]);
-            len -= maxlen;
+            unsigned long full = ((len-1)/maxlen)*maxlen;
+            Bytes::size_type start = bytes.size();
+            bytes.resize(start+full);
+            Bytes::iterator first = bytes.begin()+start;
+            std::copy(&m_code_fill[maxlen][0], &m_code_fill[maxlen][maxlen],
+                      first);
+            for (unsigned long done = maxlen; done < full; done *= 2)
+                std::copy(first, first+std::min(done, full-done), first+done);
+            len -= full;
         }
 
         if (!m_code_fill[len])
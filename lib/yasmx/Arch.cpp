@@ -26,6 +26,8 @@
 //
 #include "yasmx/Arch.h"
 
+#include <stdexcept>
+
 #include "yasmx/Bytecode.h"
 #include "yasmx/Insn.h"
 
@@ -53,6 +55,40 @@ Arch::AddDirectives(Directives& dirs, StringRef parser)
 {
 }
 
+void
+Arch::Reset()
+{
+}
+
+std::auto_ptr<Arch>
+Arch::Clone() const
+{
+    return std::auto_ptr<Arch>(0);
+}
+
+bool
+Arch::SaveRegister(const Register& reg, RecordWriter& out) const
+{
+    return false;
+}
+
+const Register*
+Arch::LoadRegister(RecordReader& in) const
+{
+    throw std::out_of_range("register not supported in parse record");
+}
+
+bool
+Arch::LoadContents(StringRef type, RecordReader& in, Bytecode& bc) const
+{
+    return false;
+}
+
+void
+Arch::FinalizeObject(Object& object, DiagnosticsEngine& diags)
+{
+}
+
 bool
 Arch::hasParseInsn() const
 {
@@ -66,6 +102,59 @@ Arch::ParseInsn(BytecodeContainer& container, ParserImpl& parser) const
     return false;
 }
 
+void
+Arch::ReuseInsn(std::auto_ptr<Insn>& insn, const InsnInfo* info) const
+{
+    insn.reset();
+    if (info)
+        insn = CreateInsn(info);
+    else
+        insn = CreateEmptyInsn();
+}
+
+bool
+Arch::Disassemble(const unsigned char* bytes,
+                  std::size_t len,
+                  uint64_t addr,
+                  DisasmInsn* insn,
+                  raw_ostream* os) const
+{
+    return false;
+}
+
+unsigned long
+Arch::getFeatureUsage(const Section& sect, FeatureUsage* usage) const
+{
+    usage->clear();
+    return 0;
+}
+
+bool
+Arch::setCostModel(StringRef model)
+{
+    return model.empty();
+}
+
+unsigned int
+Arch::getIssueWidth() const
+{
+    return 0;
+}
+
+bool
+Arch::getLineCost(const Section& sect,
+                  SourceLocation line,
+                  InsnCost* cost) const
+{
+    return false;
+}
+
+int
+Arch::getDwarfRegNum(const Register& reg) const
+{
+    return -1;
+}
+
 ArchModule::~ArchModule()
 {
 }
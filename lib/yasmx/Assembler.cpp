@@ -24,25 +24,52 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 //
+#define DEBUG_TYPE "Assembler"
+
 #include "yasmx/Assembler.h"
 
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/system_error.h"
+#include "llvm/Support/raw_ostream.h"
 #include "yasmx/Basic/Diagnostic.h"
+#include "yasmx/Basic/FileManager.h"
 #include "yasmx/Basic/SourceManager.h"
+#include "yasmx/Config/functional.h"
 #include "yasmx/Parse/Directive.h"
+#include "yasmx/Parse/HeaderSearch.h"
 #include "yasmx/Parse/Parser.h"
+#include "yasmx/Support/MemoryStats.h"
+#include "yasmx/Support/OutputFileStream.h"
 #include "yasmx/Support/registry.h"
 #include "yasmx/Support/scoped_ptr.h"
+#include "yasmx/Support/ThreadPool.h"
+#include "yasmx/Support/Trace.h"
 #include "yasmx/Arch.h"
+#include "yasmx/Bytecode.h"
+#include "yasmx/Bytes.h"
 #include "yasmx/DebugFormat.h"
 #include "yasmx/ListFormat.h"
 #include "yasmx/Object.h"
+#include "yasmx/ObjectDumper.h"
 #include "yasmx/ObjectFormat.h"
+#include "yasmx/Section.h"
 
 
 using namespace yasm;
 
+static const char* TIMER_GROUP = "Assembler Phases";
+
+STATISTIC(num_optimize_bytes, "Number of section bytes after Optimize");
+STATISTIC(num_debug_bytes, "Number of section bytes added by Debug Generate");
+STATISTIC(num_output_bytes, "Number of bytes written by Output");
+
 namespace {
 class NocaseEquals
 {
@@ -56,6 +83,95 @@ public:
 };
 } // anonymous namespace
 
+// Get the total size of all sections, in bytes.
+static uint64_t
+getSectionBytes(Object& object)
+{
+    uint64_t total = 0;
+    for (Object::section_iterator sect=object.sections_begin(),
+         end=object.sections_end(); sect != end; ++sect)
+    {
+        if (sect->bytecodes_begin() != sect->bytecodes_end())
+            total += sect->bytecodes_back().getNextOffset();
+    }
+    return total;
+}
+
+static void
+PrintMemoryLine(raw_ostream& os, const char* name, std::size_t current,
+                std::size_t peak)
+{
+    os << llvm::format("%12lu %12lu  %s\n",
+                       static_cast<unsigned long>(current),
+                       static_cast<unsigned long>(peak), name);
+}
+
+static void
+PrintMemoryLine(raw_ostream& os, const char* name, std::size_t current)
+{
+    os << llvm::format("%12lu %12s  %s\n",
+                       static_cast<unsigned long>(current),
+                       static_cast<const char*>("-"), name);
+}
+
+/// Report memory use at the end of an assembly phase (for --stats).
+/// Allocation-counted categories show current and peak use; the others
+/// are measured by walking the object at the end of the phase.
+static void
+ReportMemory(const char* phase, const Object& object,
+             const SourceManager* source_mgr)
+{
+    if (!isMemoryStatsEnabled())
+        return;
+
+    raw_ostream& os = llvm::errs();
+    os << "===" << std::string(73, '-') << "===\n"
+       << "  Memory use after " << phase << " (bytes)\n"
+       << "===" << std::string(73, '-') << "===\n"
+       << "     current         peak  category\n";
+
+    for (int i=0; i<NUM_MEMORY_CATEGORIES; ++i)
+    {
+        MemoryCategory cat = static_cast<MemoryCategory>(i);
+        std::size_t current, peak;
+        getMemoryStats(cat, &current, &peak);
+        PrintMemoryLine(os, getMemoryCategoryName(cat), current, peak);
+    }
+
+    // Fixed bytecode data, split out for debug information sections.
+    std::size_t fixed = 0, debug_fixed = 0;
+    for (Object::const_section_iterator sect=object.sections_begin(),
+         end=object.sections_end(); sect != end; ++sect)
+    {
+        StringRef name = sect->getName();
+        bool debug = name.startswith(".debug") || name.startswith(".stab");
+        for (BytecodeContainer::const_bc_iterator
+             bc=sect->bytecodes_begin(), bcend=sect->bytecodes_end();
+             bc != bcend; ++bc)
+        {
+            std::size_t size = bc->getFixed().capacity();
+            if (debug)
+                debug_fixed += size;
+            else
+                fixed += size;
+        }
+    }
+    PrintMemoryLine(os, "bytecode fixed data", fixed);
+    PrintMemoryLine(os, "debug section data", debug_fixed);
+
+    if (source_mgr)
+    {
+        SourceManager::MemoryBufferSizes buffers =
+            source_mgr->getMemoryBufferSizes();
+        PrintMemoryLine(os, "source buffers (malloc)", buffers.malloc_bytes);
+        PrintMemoryLine(os, "source buffers (mmap)", buffers.mmap_bytes);
+        PrintMemoryLine(os, "source manager tables",
+                        source_mgr->getContentCacheSize() +
+                        source_mgr->getDataStructureSizes());
+    }
+    os << '\n';
+}
+
 Assembler::Assembler(StringRef arch_keyword,
                      StringRef objfmt_keyword,
                      DiagnosticsEngine& diags,
@@ -70,8 +186,18 @@ Assembler::Assembler(StringRef arch_keyword,
       m_objfmt(0),
       m_dbgfmt(0),
       m_listfmt(0),
+      m_pieces_owner(m_pieces),
       m_object(0),
-      m_dump_time(dump_time)
+      m_dump_time(dump_time),
+#ifdef WITH_XML
+      m_dump_format(DUMP_XML),
+#else
+      m_dump_format(DUMP_JSON),
+#endif
+      m_num_jobs(1),
+      m_split_parse(false),
+      m_piece_cache(0),
+      m_time_report(false)
 {
     if (m_arch_module.get() == 0)
     {
@@ -87,6 +213,10 @@ Assembler::Assembler(StringRef arch_keyword,
         return;
     }
 
+    // Count memory use from here on if statistics were requested.
+    if (llvm::AreStatisticsEnabled())
+        EnableMemoryStats();
+
     // Create architecture.
     m_arch.reset(m_arch_module->Create().release());
 
@@ -97,6 +227,10 @@ Assembler::Assembler(StringRef arch_keyword,
 
 }
 
+PieceCache::~PieceCache()
+{
+}
+
 Assembler::~Assembler()
 {
 }
@@ -196,12 +330,46 @@ Assembler::setListFormat(StringRef listfmt_keyword, DiagnosticsEngine& diags)
     return true;
 }
 
+const FileEntry*
+Assembler::AddVirtualFile(SourceManager& source_mgr,
+                          StringRef filename,
+                          StringRef contents)
+{
+    // Includes relative to a file in the current directory are looked up
+    // as "./name", and lookups match paths exactly.
+    SmallString<128> path;
+    if (!llvm::sys::path::has_parent_path(filename))
+        path = "./";
+    path += filename;
+    return AddVirtualFileAs(source_mgr, path, contents);
+}
+
+void
+Assembler::setMainSource(SourceManager& source_mgr,
+                         StringRef filename,
+                         StringRef source)
+{
+    source_mgr.createMainFileID(AddVirtualFileAs(source_mgr, filename,
+                                                 source));
+}
+
+const FileEntry*
+Assembler::AddVirtualFileAs(SourceManager& source_mgr,
+                            StringRef path,
+                            StringRef contents)
+{
+    const FileEntry* file =
+        source_mgr.getFileManager().getVirtualFile(path, contents.size(), 0);
+    source_mgr.overrideFileContents(file,
+        MemoryBuffer::getMemBufferCopy(contents, path));
+    return file;
+}
+
 bool
 Assembler::InitObject(SourceManager& source_mgr, DiagnosticsEngine& diags)
 {
     StringRef in_filename =
         source_mgr.getBuffer(source_mgr.getMainFileID())->getBufferIdentifier();
-    StringRef parser_keyword = m_parser_module->getKeyword();
 
     // determine the object filename if not specified
     if (m_obj_filename.empty())
@@ -224,6 +392,34 @@ Assembler::InitObject(SourceManager& source_mgr, DiagnosticsEngine& diags)
         }
     }
 
+    return CreateObject(in_filename, true, diags);
+}
+
+bool
+Assembler::Merge(const std::vector<StringRef>& objects,
+                 DiagnosticsEngine& diags)
+{
+    if (!CreateObject("", false, diags))
+        return false;
+
+    for (std::vector<StringRef>::const_iterator i=objects.begin(),
+         end=objects.end(); i != end; ++i)
+    {
+        OwningPtr<MemoryBuffer> in(MemoryBuffer::getMemBuffer(*i, "", false));
+        if (!m_objfmt->Merge(*in, diags))
+            return false;
+    }
+    m_object->ExternUndefinedSymbols();
+    return !diags.hasErrorOccurred();
+}
+
+bool
+Assembler::CreateObject(StringRef src_filename,
+                        bool default_section,
+                        DiagnosticsEngine& diags)
+{
+    StringRef parser_keyword = m_parser_module->getKeyword();
+
     if (m_machine.empty())
     {
         // If we're using x86 and the default objfmt bits is 64, default the
@@ -238,7 +434,8 @@ Assembler::InitObject(SourceManager& source_mgr, DiagnosticsEngine& diags)
     }
 
     // Create object
-    m_object.reset(new Object(in_filename, m_obj_filename, m_arch.get()));
+    m_object.reset(new Object(src_filename, m_obj_filename, m_arch.get()));
+    m_object->getConfig().NumJobs = m_num_jobs;
 
     // See if the object format supports such an object
     if (!m_objfmt_module->isOkObject(*m_object))
@@ -257,13 +454,19 @@ Assembler::InitObject(SourceManager& source_mgr, DiagnosticsEngine& diags)
     m_objfmt->InitSymbols(parser_keyword);
 
     // Add an initial "default" section to object
-    m_object->setCurSection(m_objfmt->AddDefaultSection());
+    if (default_section)
+        m_object->setCurSection(m_objfmt->AddDefaultSection());
 
     // Default debug format if not specified
     if (m_dbgfmt_module.get() == 0)
     {
-        if (!setDebugFormat(m_objfmt_module->getDefaultDebugFormatKeyword(),
-                            diags))
+        // Builds with a subset of the standard modules may not include
+        // the object format's default; fall back to no debug information.
+        StringRef dbgfmt_keyword =
+            m_objfmt_module->getDefaultDebugFormatKeyword();
+        if (!isModule<DebugFormatModule>(dbgfmt_keyword))
+            dbgfmt_keyword = "null";
+        if (!setDebugFormat(dbgfmt_keyword, diags))
             return false;
     }
 
@@ -291,6 +494,289 @@ Assembler::InitParser(SourceManager& source_mgr,
     return *m_parser;
 }
 
+/// A piece of the main source, parsed on its own into its own object by
+/// ParsePieces().  Everything the parse touches is separate from the
+/// other pieces, so pieces can be parsed concurrently.
+struct Assembler::Piece
+{
+    Piece(const DiagnosticsEngine& parent, const MemoryBuffer& main)
+        : diags(parent)
+        , file_mgr(FileSystemOptions())
+        , source_mgr(diags.getDiagnostics(), file_mgr)
+        , headers(file_mgr)
+        , begin(0)
+        , end(0)
+        , failed(false)
+    {
+        // Report everything, so any diagnostic the source may warrant
+        // makes the pieces be discarded.
+        diags.getDiagnostics().setEnableAllWarnings(true);
+        source_mgr.createMainFileIDForMemBuffer(
+            MemoryBuffer::getMemBuffer(main.getBuffer(),
+                                       main.getBufferIdentifier()));
+    }
+
+    DiagnosticBuffer diags;
+    FileManager file_mgr;
+    SourceManager source_mgr;
+    HeaderSearch headers;
+    util::scoped_ptr<Arch> arch;
+    util::scoped_ptr<Parser> parser;
+    util::scoped_ptr<ObjectFormat> objfmt;
+    util::scoped_ptr<Object> object;
+    Directives dirs;
+    unsigned int begin;     ///< offset of start in main source
+    unsigned int end;       ///< offset of end in main source
+    std::string key;        ///< piece cache key
+    std::string replay;     ///< piece cache record to replay
+    Bytes record;           ///< piece cache record being written
+    bool failed;            ///< replaying the record failed
+};
+
+namespace {
+struct PieceJob
+{
+    Parser* parser;
+    Object* object;
+    Directives* dirs;
+    DiagnosticsEngine* diags;
+    unsigned int begin;
+    unsigned int end;
+    Bytes* record;
+    ArrayRef<unsigned char> replay;
+    bool* failed;
+};
+} // anonymous namespace
+
+static void
+ParsePieceJob(const std::vector<PieceJob>& jobs,
+              const std::vector<unsigned int>& setup,
+              std::size_t i)
+{
+    const PieceJob& job = jobs[i];
+    TraceRegion t("Parse Piece", job.replay.empty() ? "" : "replay");
+    if (!job.parser->ParsePiece(*job.object, *job.dirs, *job.diags, setup,
+                                job.begin, job.end, job.record, job.replay))
+        *job.failed = true;
+}
+
+// Don't split the source into pieces smaller than this.
+static const unsigned int MIN_PIECE_BYTES = 4096;
+
+// With a piece cache, split where a hash of the text before a split point
+// has its low bits clear (about every SPLIT_HASH_MASK+1 points), so bounds
+// move with the text around them rather than with their offsets.
+static const unsigned int SPLIT_HASH_MASK = 7;
+static const unsigned int SPLIT_HASH_BYTES = 64;
+
+static bool
+isContentBound(StringRef text, unsigned int offset)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (unsigned int i=offset-SPLIT_HASH_BYTES; i<offset; ++i)
+    {
+        hash ^= static_cast<unsigned char>(text[i]);
+        hash *= 16777619u;
+    }
+    return (hash & SPLIT_HASH_MASK) == 0;
+}
+
+bool
+Assembler::ParsePieces(SourceManager& source_mgr, DiagnosticsEngine& diags)
+{
+    unsigned int num_threads =
+        m_num_jobs == 0 ? ThreadPool::getNumProcessors() : m_num_jobs;
+    if (!m_split_parse || num_threads <= 1 || m_listfmt.get() != 0 ||
+        m_object->isMarkLines() || m_object->isMarkLayout() ||
+        !m_object->getConfig().SymbolOrderingFile.empty())
+        return false;
+
+    // Pieces get no debug format directives; the CFI ones are never in
+    // pieces, but the others also describe the source as a whole.
+    StringRef dbgfmt_keyword = m_dbgfmt_module->getKeyword();
+    if (!dbgfmt_keyword.equals_lower("null") &&
+        !dbgfmt_keyword.equals_lower("cfi"))
+        return false;
+
+    std::vector<unsigned int> splits, setup;
+    if (!m_parser->SplitSource(&splits, &setup))
+        return false;
+
+    // Use several pieces per thread so threads that finish early can
+    // pick up the remaining ones.
+    const MemoryBuffer* main =
+        source_mgr.getBuffer(source_mgr.getMainFileID());
+    unsigned int size = static_cast<unsigned int>(main->getBufferSize());
+    unsigned int piece_bytes = size / (4*num_threads);
+    if (piece_bytes < MIN_PIECE_BYTES)
+        piece_bytes = MIN_PIECE_BYTES;
+    std::vector<unsigned int> bounds(1, 0);
+    if (m_piece_cache)
+    {
+        // Keep pieces small, so an edit invalidates little of the cache.
+        StringRef text = main->getBuffer();
+        for (std::vector<unsigned int>::const_iterator i=splits.begin(),
+             end=splits.end(); i != end; ++i)
+        {
+            unsigned int len = *i - bounds.back();
+            if (size - *i < MIN_PIECE_BYTES)
+                break;
+            if (len >= 16*MIN_PIECE_BYTES ||
+                (len >= MIN_PIECE_BYTES && isContentBound(text, *i)))
+                bounds.push_back(*i);
+        }
+    }
+    else
+    {
+        for (std::vector<unsigned int>::const_iterator i=splits.begin(),
+             end=splits.end(); i != end; ++i)
+        {
+            if (*i - bounds.back() >= piece_bytes && size - *i >= piece_bytes)
+                bounds.push_back(*i);
+        }
+    }
+    if (bounds.size() < 2)
+        return false;
+    bounds.push_back(size);
+
+    TraceRegion tr("Split Parse");
+    StringRef parser_keyword = m_parser_module->getKeyword();
+    std::vector<PieceJob> jobs;
+    for (std::size_t i=0; i+1<bounds.size(); ++i)
+    {
+        m_pieces.push_back(new Piece(diags, *main));
+        Piece& piece = m_pieces.back();
+        piece.begin = bounds[i];
+        piece.end = bounds[i+1];
+
+        // Source locations are only the same if the main files are.
+        if (piece.source_mgr.getLocForStartOfFile(
+                piece.source_mgr.getMainFileID()) !=
+            source_mgr.getLocForStartOfFile(source_mgr.getMainFileID()))
+            break;
+
+        std::auto_ptr<Arch> arch = m_arch->Clone();
+        if (arch.get() == 0)
+            break;
+        piece.arch.reset(arch.release());
+
+        piece.object.reset(new Object(m_object->getSourceFilename(),
+                                      m_obj_filename, piece.arch.get()));
+        piece.object->getConfig() = m_object->getConfig();
+        piece.object->getOptions() = m_object->getOptions();
+        piece.objfmt.reset(m_objfmt_module->Create(*piece.object).release());
+        piece.objfmt->InitSymbols(parser_keyword);
+        // Every piece starts with the default section current, as the
+        // setup lines may switch sections before anything else does.
+        if (m_object->getCurSection())
+            piece.object->setCurSection(piece.objfmt->AddDefaultSection());
+        if (i == 0)
+        {
+            // Anything else already in the object (e.g. predefined
+            // symbols) would be missing from the pieces.
+            if (std::distance(m_object->symbols_begin(),
+                              m_object->symbols_end()) !=
+                std::distance(piece.object->symbols_begin(),
+                              piece.object->symbols_end()) ||
+                std::distance(m_object->sections_begin(),
+                              m_object->sections_end()) !=
+                std::distance(piece.object->sections_begin(),
+                              piece.object->sections_end()))
+                break;
+        }
+
+        piece.parser.reset(m_parser_module->Create(piece.diags.getDiagnostics(),
+                                                   piece.source_mgr,
+                                                   piece.headers).release());
+        piece.arch->AddDirectives(piece.dirs, parser_keyword);
+        piece.parser->AddDirectives(piece.dirs, parser_keyword);
+        piece.objfmt->AddDirectives(piece.dirs, parser_keyword);
+        piece.objfmt->AddFallbackDirectives(piece.dirs, parser_keyword);
+
+        PieceJob job = {piece.parser.get(), piece.object.get(), &piece.dirs,
+                        &piece.diags.getDiagnostics(), piece.begin,
+                        piece.end, 0, ArrayRef<unsigned char>(),
+                        &piece.failed};
+        if (m_piece_cache)
+        {
+            // The parse of a piece depends on the setup lines before it
+            // as well as its own text.
+            StringRef text = main->getBuffer();
+            for (std::vector<unsigned int>::const_iterator j=setup.begin(),
+                 setup_end=setup.end(); j != setup_end && *j < piece.begin;
+                 ++j)
+            {
+                piece.key += text.substr(*j).split('\n').first;
+                piece.key += '\n';
+            }
+            piece.key += '\0';
+            piece.key += text.slice(piece.begin, piece.end);
+
+            // An empty record is stored when one can't be replayed, so
+            // the piece gets recorded again.
+            if (m_piece_cache->FetchPiece(piece.key, piece.replay) &&
+                !piece.replay.empty())
+                job.replay = ArrayRef<unsigned char>(
+                    reinterpret_cast<const unsigned char*>(
+                        piece.replay.data()),
+                    piece.replay.size());
+            else
+                job.record = &piece.record;
+        }
+        jobs.push_back(job);
+    }
+
+    bool ok = jobs.size() == m_pieces.size();
+    if (ok)
+    {
+        ThreadPool pool(num_threads);
+        pool.Run(jobs.size(), TR1::bind(&ParsePieceJob, TR1::cref(jobs),
+                                        TR1::cref(setup), _1));
+    }
+
+    // Combine the pieces into the first one, so the object is only
+    // changed once they've all been combined.
+    for (std::size_t i=0; ok && i<m_pieces.size(); ++i)
+        ok = m_pieces[i].diags.empty();
+
+    // Only store records of pieces parsed without diagnostics.  A piece
+    // whose record couldn't be replayed is left partly parsed; forget the
+    // record and parse the source as usual.
+    for (std::size_t i=0; m_piece_cache && i<m_pieces.size(); ++i)
+    {
+        Piece& piece = m_pieces[i];
+        if (piece.failed)
+        {
+            m_piece_cache->StorePiece(piece.key, StringRef());
+            ok = false;
+        }
+        else if (!piece.record.empty() && piece.diags.empty())
+            m_piece_cache->StorePiece(piece.key, StringRef(
+                reinterpret_cast<const char*>(&piece.record[0]),
+                piece.record.size()));
+    }
+    for (std::size_t i=1; ok && i<m_pieces.size(); ++i)
+        ok = m_pieces[0].objfmt->AppendPiece(*m_pieces[i].objfmt);
+    if (ok)
+        ok = m_objfmt->AppendPiece(*m_pieces[0].objfmt);
+    if (!ok)
+    {
+        ClearPieces();
+        return false;
+    }
+
+    m_parser->FinishPieces(*m_object);
+    return true;
+}
+
+void
+Assembler::ClearPieces()
+{
+    while (!m_pieces.empty())
+        delete m_pieces.pop_back();
+}
+
 bool
 Assembler::Assemble(SourceManager& source_mgr, DiagnosticsEngine& diags)
 {
@@ -302,41 +788,70 @@ Assembler::Assemble(SourceManager& source_mgr, DiagnosticsEngine& diags)
     m_parser->AddDirectives(dirs, parser_keyword);
     m_objfmt->AddDirectives(dirs, parser_keyword);
     m_dbgfmt->AddDirectives(dirs, parser_keyword);
+    m_objfmt->AddFallbackDirectives(dirs, parser_keyword);
     if (m_listfmt_module.get() != 0)
     {
         m_listfmt.reset(m_listfmt_module->Create().release());
         m_listfmt->AddDirectives(dirs, parser_keyword);
+        // Have the parser note where each line's output starts.
+        m_object->setListFormat(m_listfmt.get());
     }
 
     // Inform the diagnostic consumer we are processing a source file
     diags.getClient()->BeginSourceFile();
 
     // Parse!
-    m_parser->Parse(*m_object, dirs, diags);
+    {
+        llvm::NamedRegionTimer t("Parse", TIMER_GROUP, m_time_report);
+        TraceRegion tr("Parse", m_object->getSourceFilename());
+        if (!ParsePieces(source_mgr, diags))
+            m_parser->Parse(*m_object, dirs, diags);
+        m_object->setListLine(SourceLocation());
+    }
+    ReportMemory("Parse", *m_object, &source_mgr);
 
-    if (m_dump_time == Assembler::DUMP_AFTER_PARSE)
-        DumpXml(*m_object);
+    DumpObject(DUMP_AFTER_PARSE);
     if (diags.hasErrorOccurred())
         return false;
 
     // Finalize parse
-    m_object->Finalize(diags);
-    if (m_dump_time == Assembler::DUMP_AFTER_FINALIZE)
-        DumpXml(*m_object);
+    {
+        llvm::NamedRegionTimer t("Finalize", TIMER_GROUP, m_time_report);
+        TraceRegion tr("Finalize");
+        m_object->Finalize(diags, m_num_jobs);
+        if (!diags.hasErrorOccurred())
+            m_arch->FinalizeObject(*m_object, diags);
+    }
+    ReportMemory("Finalize", *m_object, &source_mgr);
+    DumpObject(DUMP_AFTER_FINALIZE);
     if (diags.hasErrorOccurred())
         return false;
 
     // Optimize
-    m_object->Optimize(diags);
+    {
+        llvm::NamedRegionTimer t("Optimize", TIMER_GROUP, m_time_report);
+        TraceRegion tr("Optimize");
+        m_object->Optimize(diags, m_num_jobs);
+    }
+    uint64_t optimize_bytes = getSectionBytes(*m_object);
+    num_optimize_bytes += static_cast<unsigned int>(optimize_bytes);
+    ReportMemory("Optimize", *m_object, &source_mgr);
 
-    if (m_dump_time == Assembler::DUMP_AFTER_OPTIMIZE)
-        DumpXml(*m_object);
+    DumpObject(DUMP_AFTER_OPTIMIZE);
 
     if (diags.hasErrorOccurred())
         return false;
 
     // generate any debugging information
-    m_dbgfmt->Generate(*m_objfmt, source_mgr, diags);
+    {
+        llvm::NamedRegionTimer t("Debug Generate", TIMER_GROUP,
+                                 m_time_report);
+        TraceRegion tr("Debug Generate");
+        m_dbgfmt->Generate(*m_objfmt, source_mgr, diags);
+    }
+    num_debug_bytes +=
+        static_cast<unsigned int>(getSectionBytes(*m_object) - optimize_bytes);
+    ReportMemory("Debug Generate", *m_object, &source_mgr);
 
     // Inform the diagnostic consumer we are done processing source.
     diags.getClient()->EndSourceFile();
@@ -344,26 +859,250 @@ Assembler::Assemble(SourceManager& source_mgr, DiagnosticsEngine& diags)
     return true;
 }
 
+void
+Assembler::AddFeatureNote(DiagnosticsEngine& diags)
+{
+    std::string desc;
+    llvm::raw_string_ostream desc_os(desc);
+    Arch::FeatureUsage usage;
+    for (Object::section_iterator sect=m_object->sections_begin(),
+         end=m_object->sections_end(); sect != end; ++sect)
+    {
+        unsigned long insns = m_arch->getFeatureUsage(*sect, &usage);
+        if (insns == 0)
+            continue;
+        desc_os << sect->getName() << ' ' << insns;
+        for (Arch::FeatureUsage::const_iterator i=usage.begin(),
+             endi=usage.end(); i != endi; ++i)
+            desc_os << ' ' << i->first << '=' << i->second;
+        desc_os << '\n';
+    }
+    desc_os.flush();
+
+    Section* note = m_objfmt->AppendSection(".note.yasm.isa",
+                                            SourceLocation(), diags);
+    note->setAlign(4);
+    AppendData(*note, 5, 4, *m_arch);       // name size
+    AppendData(*note, static_cast<unsigned long>(desc.size()+1), 4,
+               *m_arch);                        // desc size
+    AppendData(*note, 1, 4, *m_arch);       // type
+    AppendData(*note, "yasm", 4, true);     // name
+    AppendData(*note, desc, 4, true);       // desc
+    note->UpdateOffsets(diags);
+    note->Finalize(diags);
+}
+
 bool
-Assembler::Output(raw_fd_ostream& os, DiagnosticsEngine& diags)
+Assembler::Output(raw_fd_ostream& os,
+                  DiagnosticsEngine& diags,
+                  raw_ostream* list_os)
+{
+    OutputFileStream file_os(os);
+    bool ok = Output(file_os, diags, list_os);
+
+    if (os.has_error())
+    {
+        diags.Report(SourceLocation(), diag::err_file_output_write);
+        os.clear_error();
+        ok = false;
+    }
+    return ok;
+}
+
+bool
+Assembler::Output(std::vector<char>& image,
+                  DiagnosticsEngine& diags,
+                  raw_ostream* list_os)
+{
+    OutputFileStream file_os(image);
+    return Output(file_os, diags, list_os);
+}
+
+bool
+Assembler::OutputCode(uint64_t base,
+                      std::vector<char>& image,
+                      std::vector<CodeFixup>& fixups,
+                      DiagnosticsEngine& diags)
 {
     // Inform the diagnostic consumer we are processing a source file
     diags.getClient()->BeginSourceFile();
 
-    // Write the object file
-    m_objfmt->Output(os,
-                     !m_dbgfmt_module->getKeyword().equals_lower("null"),
-                     *m_dbgfmt,
-                     diags);
+    // There's no listing of a code image.
+    m_object->setListFormat(0);
+    fixups.clear();
+
+    {
+        llvm::NamedRegionTimer t("Output", TIMER_GROUP, m_time_report);
+        TraceRegion tr("Output");
+        OutputFileStream file_os(image);
+        m_objfmt->OutputCode(file_os, base, fixups, diags);
+        if (!diags.hasErrorOccurred())
+            file_os.close();
+        num_output_bytes += static_cast<unsigned int>(file_os.size());
+    }
+    ReportMemory("Output", *m_object, 0);
 
     // Inform the diagnostic consumer we are done processing source.
     diags.getClient()->EndSourceFile();
 
-    if (m_dump_time == DUMP_AFTER_OUTPUT)
-        DumpXml(*m_object);
+    DumpObject(DUMP_AFTER_OUTPUT);
 
     if (diags.hasErrorOccurred())
         return false;
 
     return true;
 }
+
+bool
+Assembler::OutputIfChanged(DiagnosticsEngine& diags,
+                           raw_ostream* list_os,
+                           bool* unchanged)
+{
+    if (unchanged)
+        *unchanged = false;
+
+    // Build the file image in memory, so the existing file is only
+    // touched if it differs.  Without an existing file, write directly.
+    std::string err;
+    if (!llvm::sys::fs::exists(m_obj_filename))
+    {
+        raw_fd_ostream os(m_obj_filename.c_str(), err,
+                          raw_fd_ostream::F_Binary);
+        if (!err.empty())
+        {
+            diags.Report(SourceLocation(), diag::err_cannot_open_file)
+                << m_obj_filename << err;
+            return false;
+        }
+        return Output(os, diags, list_os);
+    }
+
+    std::vector<char> image;
+    if (!Output(image, diags, list_os))
+        return false;
+    return WriteObjectIfChanged(StringRef(image.empty() ? 0 : &image[0],
+                                          image.size()),
+                                diags, unchanged);
+}
+
+bool
+Assembler::WriteObjectIfChanged(StringRef image,
+                                DiagnosticsEngine& diags,
+                                bool* unchanged)
+{
+    if (unchanged)
+        *unchanged = false;
+
+    OwningPtr<MemoryBuffer> old;
+    if (!MemoryBuffer::getFile(m_obj_filename, old)
+        && old->getBuffer() == image)
+    {
+        if (unchanged)
+            *unchanged = true;
+        return true;
+    }
+    old.reset();
+
+    std::string err;
+    raw_fd_ostream os(m_obj_filename.c_str(), err, raw_fd_ostream::F_Binary);
+    if (!err.empty())
+    {
+        diags.Report(SourceLocation(), diag::err_cannot_open_file)
+            << m_obj_filename << err;
+        return false;
+    }
+    os << image;
+    os.close();
+    if (os.has_error())
+    {
+        diags.Report(SourceLocation(), diag::err_file_output_write);
+        os.clear_error();
+        return false;
+    }
+    return true;
+}
+
+bool
+Assembler::Output(OutputFileStream& file_os,
+                  DiagnosticsEngine& diags,
+                  raw_ostream* list_os)
+{
+    // Inform the diagnostic consumer we are processing a source file
+    diags.getClient()->BeginSourceFile();
+
+    // The listing is written as sections are output, which must then be
+    // done in order on this thread.
+    Object::Config& config = m_object->getConfig();
+    unsigned int num_jobs = config.NumJobs;
+    if (!list_os)
+        m_object->setListFormat(0);
+    else if (m_object->getListFormat() != 0)
+    {
+        m_listfmt->Begin(*list_os, diags.getSourceManager());
+        config.NumJobs = 1;
+    }
+
+    // Write the object file.  The object format builds the file image in
+    // memory; it is written to os in one piece once complete.
+    {
+        llvm::NamedRegionTimer t("Output", TIMER_GROUP, m_time_report);
+        TraceRegion tr("Output");
+        m_objfmt->Output(file_os,
+                         !m_dbgfmt_module->getKeyword().equals_lower("null"),
+                         *m_dbgfmt,
+                         diags);
+        if (!diags.hasErrorOccurred())
+            file_os.close();
+        num_output_bytes += static_cast<unsigned int>(file_os.size());
+    }
+
+    if (m_object->getListFormat() != 0)
+    {
+        m_listfmt->End();
+        m_object->setListFormat(0);
+        config.NumJobs = num_jobs;
+    }
+    ReportMemory("Output", *m_object, 0);
+
+    // Inform the diagnostic consumer we are done processing source.
+    diags.getClient()->EndSourceFile();
+
+    DumpObject(DUMP_AFTER_OUTPUT);
+
+    if (diags.hasErrorOccurred())
+        return false;
+
+    return true;
+}
+
+void
+Assembler::Reset()
+{
+    m_object.reset(0);
+    ClearPieces();
+    m_listfmt.reset(0);
+    m_dbgfmt.reset(0);
+    m_objfmt.reset(0);
+    m_parser.reset(0);
+    m_obj_filename.clear();
+
+    // Undo any architecture changes made by directives in the previous
+    // source file.
+    m_arch->Reset();
+    if (m_parser_module.get() != 0)
+        m_arch->setParser(m_parser_module->getKeyword());
+    if (m_arch_module->getKeyword().equals_lower("x86"))
+        m_arch->setVar("mode_bits",
+                       m_objfmt_module->getDefaultX86ModeBits());
+}
+
+void
+Assembler::DumpObject(ObjectDumpTime dump_time) const
+{
+    if (m_dump_time != dump_time)
+        return;
+    if (m_dump_format == DUMP_JSON)
+        DumpJsonLines(*m_object, llvm::errs());
+    else
+        DumpXml(*m_object);
+}
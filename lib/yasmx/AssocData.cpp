@@ -37,11 +37,13 @@ AssocData::~AssocData()
 }
 
 AssocDataContainer::AssocDataContainer()
+    : m_slot_key(0), m_slot(0)
 {
 }
 
 AssocDataContainer::~AssocDataContainer()
 {
+    delete m_slot;
     for (AssocMap::iterator i=m_assoc_map.begin(), end=m_assoc_map.end();
          i != end; ++i)
         delete i->value;
@@ -49,8 +51,16 @@ AssocDataContainer::~AssocDataContainer()
 
 std::auto_ptr<AssocData>
 AssocDataContainer::AddAssocData(const void* key,
-                                 std::auto_ptr<AssocData> data)
+                                 std::auto_ptr<AssocData> data,
+                                 bool inline_slot)
 {
+    if (key == m_slot_key)
+    {
+        std::auto_ptr<AssocData> rv(m_slot);
+        m_slot = data.release();
+        return rv;
+    }
+
     // simple linear search
     for (AssocMap::iterator i=m_assoc_map.begin(), end=m_assoc_map.end();
          i != end; ++i)
@@ -63,27 +73,52 @@ AssocDataContainer::AddAssocData(const void* key,
         }
     }
 
-    // not found, insert at end
+    // not found; use the inline slot if it's still free
+    if (inline_slot && !m_slot_key)
+    {
+        m_slot_key = key;
+        m_slot = data.release();
+        return std::auto_ptr<AssocData>(0);
+    }
+
+    // otherwise insert at end
     AssocMapEntry entry = {key, data.release()};
     m_assoc_map.push_back(entry);
     return std::auto_ptr<AssocData>(0);
 }
 
-AssocData*
-AssocDataContainer::getAssocData(const void* key)
+bool
+AssocDataContainer::canMoveAssocData(const AssocDataContainer& from) const
 {
-    // simple linear search
-    for (AssocMap::iterator i=m_assoc_map.begin(), end=m_assoc_map.end();
-         i != end; ++i)
+    if (from.m_slot && getAssocData(from.m_slot_key))
+        return false;
+    for (AssocMap::const_iterator i=from.m_assoc_map.begin(),
+         end=from.m_assoc_map.end(); i != end; ++i)
     {
-        if (i->key == key)
-            return i->value;
+        if (getAssocData(i->key))
+            return false;
     }
-    return 0;
+    return true;
+}
+
+void
+AssocDataContainer::MoveAssocData(AssocDataContainer& from)
+{
+    assert(canMoveAssocData(from) && "data in both containers");
+    if (from.m_slot)
+    {
+        AddAssocData(from.m_slot_key, std::auto_ptr<AssocData>(from.m_slot),
+                     true);
+        from.m_slot = 0;
+    }
+    for (AssocMap::iterator i=from.m_assoc_map.begin(),
+         end=from.m_assoc_map.end(); i != end; ++i)
+        AddAssocData(i->key, std::auto_ptr<AssocData>(i->value));
+    from.m_assoc_map.clear();
 }
 
-const AssocData*
-AssocDataContainer::getAssocData(const void* key) const
+AssocData*
+AssocDataContainer::FindAssocData(const void* key) const
 {
     // simple linear search
     for (AssocMap::const_iterator i=m_assoc_map.begin(), end=m_assoc_map.end();
@@ -96,21 +131,27 @@ AssocDataContainer::getAssocData(const void* key) const
 }
 
 #ifdef WITH_XML
+static void
+WriteEntry(pugi::xml_node out, const void* key, const AssocData& data)
+{
+    pugi::xml_node node = append_data(out, data);
+    if (node.attribute("key").empty())
+    {
+        SmallString<128> ss;
+        llvm::raw_svector_ostream oss(ss);
+        oss << (uint64_t)(key) << '\0';
+        node.append_attribute("key") = oss.str().data();
+    }
+}
+
 pugi::xml_node
 AssocDataContainer::Write(pugi::xml_node out) const
 {
+    if (m_slot)
+        WriteEntry(out, m_slot_key, *m_slot);
     for (AssocMap::const_iterator i=m_assoc_map.begin(), end=m_assoc_map.end();
          i != end; ++i)
-    {
-        pugi::xml_node node = append_data(out, *i->value);
-        if (node.attribute("key").empty())
-        {
-            SmallString<128> ss;
-            llvm::raw_svector_ostream oss(ss);
-            oss << (uint64_t)(i->key) << '\0';
-            node.append_attribute("key") = oss.str().data();
-        }
-    }
+        WriteEntry(out, i->key, *i->value);
     return out;
 }
 #endif // WITH_XML
@@ -10,6 +10,10 @@
 #include "yasmx/Basic/ConvertUTF.h"
 #include "yasmx/Basic/LLVM.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 namespace clang {
 
 bool ConvertUTF8toWide(unsigned WideCharWidth, llvm::StringRef Source,
@@ -51,6 +55,88 @@ bool ConvertUTF8toWide(unsigned WideCharWidth, llvm::StringRef Source,
   return result == conversionOK;
 }
 
+static inline void StoreUnit(char *&Out, unsigned Width, bool BigEndian,
+                             UTF32 C) {
+  for (unsigned i = 0; i < Width; ++i) {
+    unsigned Shift = 8 * (BigEndian ? Width - 1 - i : i);
+    *Out++ = static_cast<char>((C >> Shift) & 0xff);
+  }
+}
+
+bool ConvertUTF8toWideUnits(unsigned WideCharWidth, bool BigEndian,
+                            llvm::StringRef Source, char *&ResultPtr) {
+  assert(WideCharWidth == 2 || WideCharWidth == 4);
+  const UTF8 *Cur = reinterpret_cast<const UTF8*>(Source.begin());
+  const UTF8 *End = reinterpret_cast<const UTF8*>(Source.end());
+  char *Out = ResultPtr;
+  while (Cur != End) {
+#ifdef __SSE2__
+    // Widen 16 ASCII characters at a time by interleaving with zeros; the
+    // zeros go first for big endian.  Each chunk is loaded before anything
+    // is stored, as Source may lie within the result buffer.
+    __m128i Zero = _mm_setzero_si128();
+    while (End - Cur >= 16) {
+      __m128i Chunk = _mm_loadu_si128((const __m128i*)Cur);
+      if (_mm_movemask_epi8(Chunk) != 0)
+        break;
+      __m128i Lo = BigEndian ? _mm_unpacklo_epi8(Zero, Chunk)
+                             : _mm_unpacklo_epi8(Chunk, Zero);
+      __m128i Hi = BigEndian ? _mm_unpackhi_epi8(Zero, Chunk)
+                             : _mm_unpackhi_epi8(Chunk, Zero);
+      if (WideCharWidth == 2) {
+        _mm_storeu_si128((__m128i*)Out, Lo);
+        _mm_storeu_si128((__m128i*)(Out + 16), Hi);
+      } else if (BigEndian) {
+        _mm_storeu_si128((__m128i*)Out, _mm_unpacklo_epi16(Zero, Lo));
+        _mm_storeu_si128((__m128i*)(Out + 16), _mm_unpackhi_epi16(Zero, Lo));
+        _mm_storeu_si128((__m128i*)(Out + 32), _mm_unpacklo_epi16(Zero, Hi));
+        _mm_storeu_si128((__m128i*)(Out + 48), _mm_unpackhi_epi16(Zero, Hi));
+      } else {
+        _mm_storeu_si128((__m128i*)Out, _mm_unpacklo_epi16(Lo, Zero));
+        _mm_storeu_si128((__m128i*)(Out + 16), _mm_unpackhi_epi16(Lo, Zero));
+        _mm_storeu_si128((__m128i*)(Out + 32), _mm_unpacklo_epi16(Hi, Zero));
+        _mm_storeu_si128((__m128i*)(Out + 48), _mm_unpackhi_epi16(Hi, Zero));
+      }
+      Cur += 16;
+      Out += 16 * WideCharWidth;
+    }
+#endif
+    while (Cur != End && *Cur < 0x80)
+      StoreUnit(Out, WideCharWidth, BigEndian, *Cur++);
+    if (Cur == End)
+      break;
+
+    // Convert a run of non-ASCII characters.  ASCII bytes never occur
+    // within a multibyte sequence, so the run ends on a character boundary
+    // unless it is cut short to fit the buffer; then back up to the start
+    // of the sequence that would be split.
+    UTF32 Buf[64];
+    const UTF8 *RunEnd = Cur;
+    while (RunEnd != End && *RunEnd >= 0x80 && RunEnd - Cur < 64)
+      ++RunEnd;
+    if (RunEnd != End && *RunEnd >= 0x80) {
+      while (RunEnd != Cur && (*RunEnd & 0xC0) == 0x80)
+        --RunEnd;
+      if (RunEnd == Cur)
+        return false;
+    }
+    UTF32 *BufEnd = Buf;
+    if (ConvertUTF8toUTF32(&Cur, RunEnd, &BufEnd, Buf + 64,
+                           strictConversion) != conversionOK)
+      return false;
+    for (const UTF32 *C = Buf; C != BufEnd; ++C) {
+      if (WideCharWidth == 2 && *C > UNI_MAX_BMP) {
+        UTF32 V = *C - 0x10000;
+        StoreUnit(Out, 2, BigEndian, 0xD800 + (V >> 10));
+        StoreUnit(Out, 2, BigEndian, 0xDC00 + (V & 0x3FF));
+      } else
+        StoreUnit(Out, WideCharWidth, BigEndian, *C);
+    }
+  }
+  ResultPtr = Out;
+  return true;
+}
+
 bool ConvertCodePointToUTF8(unsigned Source, char *&ResultPtr) {
   const UTF32 *SourceStart = &Source;
   const UTF32 *SourceEnd = SourceStart + 1;
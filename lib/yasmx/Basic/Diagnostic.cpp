@@ -350,7 +350,8 @@ void DiagnosticsEngine::setMappingToAllDiagnostics(diag::Mapping Map,
       setDiagnosticMapping(AllDiags[i], Map, Loc);
 }
 
-void DiagnosticsEngine::Report(const StoredDiagnostic &storedDiag) {
+void DiagnosticsEngine::SetCurrentDiagnostic(
+    const StoredDiagnostic &storedDiag) {
   assert(CurDiagID == ~0U && "Multiple diagnostics in flight at once!");
 
   CurDiagLoc = storedDiag.getLocation();
@@ -373,6 +374,10 @@ void DiagnosticsEngine::Report(const StoredDiagnostic &storedDiag) {
          FI = storedDiag.fixit_begin(),
          FE = storedDiag.fixit_end(); FI != FE; ++FI)
     DiagFixItHints[NumDiagFixItHints++] = *FI;
+}
+
+void DiagnosticsEngine::Report(const StoredDiagnostic &storedDiag) {
+  SetCurrentDiagnostic(storedDiag);
 
   assert(Client && "DiagnosticConsumer not set!");
   Level DiagLevel = storedDiag.getLevel();
@@ -381,11 +386,25 @@ void DiagnosticsEngine::Report(const StoredDiagnostic &storedDiag) {
   if (Client->IncludeInDiagnosticCounts()) {
     if (DiagLevel == DiagnosticsEngine::Warning)
       ++NumWarnings;
+    else if (DiagLevel >= DiagnosticsEngine::Error) {
+      ErrorOccurred = true;
+      ++NumErrors;
+    }
   }
+  if (DiagLevel >= DiagnosticsEngine::Error)
+    ++TrapNumErrorsOccurred;
+  if (DiagLevel == DiagnosticsEngine::Fatal)
+    FatalErrorOccurred = true;
 
   CurDiagID = ~0U;
 }
 
+void DiagnosticsEngine::Replay(const StoredDiagnostic &storedDiag) {
+  SetCurrentDiagnostic(storedDiag);
+  CurDiagMessage = storedDiag.getMessage();
+  EmitCurrentDiagnostic();
+}
+
 bool DiagnosticsEngine::EmitCurrentDiagnostic(bool Force) {
   assert(getClient() && "DiagnosticClient not set!");
 
@@ -854,7 +873,7 @@ StoredDiagnostic::StoredDiagnostic(DiagnosticsEngine::Level Level, unsigned ID,
   : ID(ID), Level(Level), Loc(Loc), Message(Message) 
 {
   this->Ranges.assign(Ranges.begin(), Ranges.end());
-  this->FixIts.assign(FixIts.begin(), FixIts.end());
+  this->FixIts.assign(Fixits.begin(), Fixits.end());
 }
 
 StoredDiagnostic::~StoredDiagnostic() { }
@@ -867,6 +886,36 @@ bool DiagnosticConsumer::IncludeInDiagnosticCounts() const { return true; }
 
 void IgnoringDiagConsumer::anchor() { }
 
+StoredDiagnosticConsumer::~StoredDiagnosticConsumer() { }
+
+void StoredDiagnosticConsumer::HandleDiagnostic(DiagnosticsEngine::Level Level,
+                                                const Diagnostic &Info) {
+  DiagnosticConsumer::HandleDiagnostic(Level, Info);
+  StoredDiags.push_back(StoredDiagnostic(Level, Info));
+}
+
+void StoredDiagnosticConsumer::Replay(
+    DiagnosticsEngine &Diags,
+    const std::vector<StoredDiagnostic> &StoredDiags) {
+  for (std::vector<StoredDiagnostic>::const_iterator I = StoredDiags.begin(),
+       E = StoredDiags.end(); I != E; ++I)
+    Diags.Replay(*I);
+}
+
+DiagnosticBuffer::DiagnosticBuffer(const DiagnosticsEngine &Parent)
+  : Diags(Parent.getDiagnosticIDs(),
+          new StoredDiagnosticConsumer(StoredDiags)) {
+  if (Parent.hasSourceManager())
+    Diags.setSourceManager(&Parent.getSourceManager());
+}
+
+DiagnosticBuffer::~DiagnosticBuffer() { }
+
+void DiagnosticBuffer::Replay(DiagnosticsEngine &Parent) {
+  StoredDiagnosticConsumer::Replay(Parent, StoredDiags);
+  StoredDiags.clear();
+}
+
 PartialDiagnostic::StorageAllocator::StorageAllocator() {
   for (unsigned I = 0; I != NumCached; ++I)
     FreeList[I] = Cached + I;
@@ -26,6 +26,7 @@
 #include "llvm/Support/system_error.h"
 #include "llvm/Config/llvm-config.h"
 #include "yasmx/Basic/FileSystemStatCache.h"
+#include "yasmx/Support/FilePrefetcher.h"
 #include <map>
 #include <set>
 #include <string>
@@ -177,6 +178,8 @@ FileManager::FileManager(const FileSystemOptions &FSO)
     SeenDirEntries(64), SeenFileEntries(64), NextFileUID(0) {
   NumDirLookups = NumFileLookups = 0;
   NumDirCacheMisses = NumFileCacheMisses = 0;
+  if (FilePrefetcher::isAvailable())
+    Prefetcher.reset(new FilePrefetcher);
 }
 
 FileManager::~FileManager() {
@@ -515,9 +518,12 @@ getBufferForFile(const FileEntry *Entry, std::string *ErrorStr,
     return Result.take();
   }
 
-  // Otherwise, open the file.
+  // Otherwise, open the file, unless it has been prefetched.
 
   if (FileSystemOpts.WorkingDir.empty()) {
+    if (Prefetcher)
+      if (llvm::MemoryBuffer *Buf = Prefetcher->Take(Filename))
+        return Buf;
     ec = llvm::MemoryBuffer::getFile(Filename, Result, FileSize);
     if (ec && ErrorStr)
       *ErrorStr = ec.message();
@@ -526,6 +532,9 @@ getBufferForFile(const FileEntry *Entry, std::string *ErrorStr,
 
   SmallString<128> FilePath(Entry->getName());
   FixupRelativePath(FilePath);
+  if (Prefetcher)
+    if (llvm::MemoryBuffer *Buf = Prefetcher->Take(FilePath.str()))
+      return Buf;
   ec = llvm::MemoryBuffer::getFile(FilePath.str(), Result, FileSize);
   if (ec && ErrorStr)
     *ErrorStr = ec.message();
@@ -551,6 +560,25 @@ getBufferForFile(StringRef Filename, std::string *ErrorStr) {
   return Result.take();
 }
 
+void FileManager::prefetchFile(const std::vector<std::string> &Paths,
+                               bool Keep) {
+  if (!Prefetcher)
+    return;
+  if (FileSystemOpts.WorkingDir.empty()) {
+    Prefetcher->Prefetch(Paths, Keep);
+    return;
+  }
+
+  std::vector<std::string> FixedPaths;
+  FixedPaths.reserve(Paths.size());
+  for (unsigned i = 0, e = Paths.size(); i != e; ++i) {
+    SmallString<128> FilePath(Paths[i]);
+    FixupRelativePath(FilePath);
+    FixedPaths.push_back(FilePath.str());
+  }
+  Prefetcher->Prefetch(FixedPaths, Keep);
+}
+
 /// getStatValue - Get the 'stat' information for the specified path,
 /// using the cache to accelerate it if possible.  This returns true
 /// if the path points to a virtual file or does not exist, or returns
@@ -611,6 +639,15 @@ void FileManager::GetUniqueIDMapping(
       UIDToFiles[(*VFE)->getUID()] = *VFE;
 }
 
+void FileManager::GetNonExistentFiles(
+                   SmallVectorImpl<StringRef> &Paths) const {
+  for (llvm::StringMap<FileEntry*, llvm::BumpPtrAllocator>::const_iterator
+         FE = SeenFileEntries.begin(), FEEnd = SeenFileEntries.end();
+       FE != FEEnd; ++FE)
+    if (FE->getValue() == NON_EXISTENT_FILE)
+      Paths.push_back(FE->getKey());
+}
+
 void FileManager::modifyFileEntry(FileEntry *File,
                                   off_t Size, time_t ModificationTime) {
   File->Size = Size;
@@ -12,7 +12,14 @@
 //===----------------------------------------------------------------------===//
 
 #include "yasmx/Basic/FileSystemStatCache.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cerrno>
+#include <cstdlib>
 #include <fcntl.h>
 
 // FIXME: This is terrible, we need this for ::close.
@@ -120,3 +127,147 @@ MemorizeStatCalls::getStat(const char *Path, struct stat &StatBuf,
   
   return Result;
 }
+
+static const char PersistentStatCacheMagic[] = "yasm-stat-cache 1";
+
+PersistentStatCache::PersistentStatCache()
+  : StartTime(time(0)), Dirty(false) {
+  SmallString<256> Cwd;
+  if (!llvm::sys::fs::current_path(Cwd))
+    CurDir = Cwd.str();
+}
+
+/// getDirInfo - Get the entry for a directory, checking it against the file
+/// system the first time it's used in this run.
+PersistentStatCache::DirInfo &
+PersistentStatCache::getDirInfo(StringRef Dir) {
+  SmallString<256> AbsDir;
+  if (!llvm::sys::path::is_absolute(Dir)) {
+    // Without the current directory, a relative path can't be recorded.
+    if (CurDir.empty()) {
+      static DirInfo Untrusted;
+      Untrusted.Checked = true;
+      return Untrusted;
+    }
+    AbsDir = CurDir;
+    llvm::sys::path::append(AbsDir, Dir);
+    Dir = AbsDir.str();
+  }
+
+  DirInfo &D = Dirs.GetOrCreateValue(Dir).getValue();
+  if (D.Checked)
+    return D;
+  D.Checked = true;
+
+  SmallString<256> DirPath(Dir);
+  struct stat DirBuf;
+  D.Trusted = ::stat(DirPath.c_str(), &DirBuf) == 0 &&
+              S_ISDIR(DirBuf.st_mode) && DirBuf.st_mtime < StartTime;
+  if (!D.Trusted || DirBuf.st_mtime != D.MTime) {
+    if (!D.Missing.empty())
+      Dirty = true;
+    D.Missing.clear();
+  }
+  if (D.Trusted)
+    D.MTime = DirBuf.st_mtime;
+  return D;
+}
+
+PersistentStatCache::LookupResult
+PersistentStatCache::getStat(const char *Path, struct stat &StatBuf,
+                             int *FileDescriptor) {
+  StringRef P(Path);
+  StringRef Dir = llvm::sys::path::parent_path(P);
+  DirInfo &D = getDirInfo(Dir.empty() ? StringRef(".") : Dir);
+  StringRef Name = llvm::sys::path::filename(P);
+  if (D.Trusted && D.Missing.count(Name))
+    return CacheMissing;
+
+  errno = 0;
+  LookupResult Result = statChained(Path, StatBuf, FileDescriptor);
+
+  // Only remember files that don't exist, not ones that can't be accessed.
+  if (Result == CacheMissing && errno == ENOENT && D.Trusted) {
+    D.Missing.GetOrCreateValue(Name);
+    Dirty = true;
+  }
+  return Result;
+}
+
+/// load - The cache file is a line identifying the format, followed by, for
+/// each directory, a line with its modification time and path and then a
+/// line with a leading space for each missing name.
+bool PersistentStatCache::load(StringRef Filename) {
+  OwningPtr<llvm::MemoryBuffer> Buf;
+  if (llvm::MemoryBuffer::getFile(Filename, Buf))
+    return true;
+
+  std::pair<StringRef, StringRef> Split = Buf->getBuffer().split('\n');
+  if (Split.first != PersistentStatCacheMagic)
+    return true;
+
+  DirInfo *D = 0;
+  while (!Split.second.empty()) {
+    Split = Split.second.split('\n');
+    StringRef Line = Split.first;
+    if (Line.empty())
+      continue;
+    if (Line[0] == ' ') {
+      if (!D)
+        return true;
+      D->Missing.GetOrCreateValue(Line.substr(1));
+      continue;
+    }
+    std::pair<StringRef, StringRef> Fields = Line.split(' ');
+    unsigned long long MTime;
+    if (Fields.first.getAsInteger(10, MTime) || Fields.second.empty())
+      return true;
+    D = &Dirs.GetOrCreateValue(Fields.second).getValue();
+    D->MTime = static_cast<time_t>(MTime);
+  }
+  return false;
+}
+
+bool PersistentStatCache::save(StringRef Filename) const {
+  if (!Dirty)
+    return false;
+
+  // Write to a temporary file and rename it into place, so concurrent runs
+  // sharing a cache file don't see a partial file.
+  int FD;
+  SmallString<256> TmpPath;
+  if (llvm::sys::fs::unique_file(Filename + ".tmp-%%%%%%%%", FD, TmpPath,
+                                 false, 0644))
+    return true;
+  {
+    llvm::raw_fd_ostream OS(FD, true);
+    OS << PersistentStatCacheMagic << '\n';
+    for (llvm::StringMap<DirInfo>::const_iterator I = Dirs.begin(),
+         E = Dirs.end(); I != E; ++I) {
+      const DirInfo &D = I->getValue();
+      if ((D.Checked && !D.Trusted) || D.Missing.empty() ||
+          I->getKey().find('\n') != StringRef::npos)
+        continue;
+      OS << static_cast<unsigned long long>(D.MTime) << ' ' << I->getKey()
+         << '\n';
+      for (llvm::StringMap<char>::const_iterator J = D.Missing.begin(),
+           JE = D.Missing.end(); J != JE; ++J) {
+        if (J->getKey().find('\n') == StringRef::npos)
+          OS << ' ' << J->getKey() << '\n';
+      }
+    }
+    OS.close();
+    if (OS.has_error()) {
+      OS.clear_error();
+      bool Existed;
+      llvm::sys::fs::remove(TmpPath.str(), Existed);
+      return true;
+    }
+  }
+  if (llvm::sys::fs::rename(TmpPath.str(), Filename)) {
+    bool Existed;
+    llvm::sys::fs::remove(TmpPath.str(), Existed);
+    return true;
+  }
+  return false;
+}
@@ -193,9 +193,11 @@ unsigned LineTableInfo::getLineTableFilenameID(StringRef Name) {
 
 /// AddLineNote - Add a line note to the line table that indicates that there
 /// is a \#line at the specified FID/Offset location which changes the presumed
-/// location to LineNo/FilenameID.
+/// location to LineNo/FilenameID, with each following line advancing the
+/// presumed line by LineInc.
 void LineTableInfo::AddLineNote(FileID FID, unsigned Offset,
-                                unsigned LineNo, int FilenameID) {
+                                unsigned LineNo, int FilenameID,
+                                unsigned LineInc) {
   std::vector<LineEntry> &Entries = LineEntries[FID];
 
   assert((Entries.empty() || Entries.back().FileOffset < Offset) &&
@@ -217,7 +219,7 @@ void LineTableInfo::AddLineNote(FileID FID, unsigned Offset,
   }
 
   Entries.push_back(LineEntry::get(Offset, LineNo, FilenameID, Kind,
-                                   IncludeOffset));
+                                   IncludeOffset, LineInc));
 }
 
 /// AddLineNote This is the same as the previous version of AddLineNote, but is
@@ -296,7 +298,7 @@ unsigned SourceManager::getLineTableFilenameID(StringRef Name) {
 /// specified by Loc.  If FilenameID is -1, it is considered to be
 /// unspecified.
 void SourceManager::AddLineNote(SourceLocation Loc, unsigned LineNo,
-                                int FilenameID) {
+                                int FilenameID, unsigned LineInc) {
   std::pair<FileID, unsigned> LocInfo = getDecomposedExpansionLoc(Loc);
 
   bool Invalid = false;
@@ -311,7 +313,8 @@ void SourceManager::AddLineNote(SourceLocation Loc, unsigned LineNo,
 
   if (LineTable == 0)
     LineTable = new LineTableInfo();
-  LineTable->AddLineNote(LocInfo.first, LocInfo.second, LineNo, FilenameID);
+  LineTable->AddLineNote(LocInfo.first, LocInfo.second, LineNo, FilenameID,
+                         LineInc);
 }
 
 /// AddLineNote - Add a GNU line marker to the line table.
@@ -502,9 +505,9 @@ const SrcMgr::SLocEntry &SourceManager::loadSLocEntry(unsigned Index,
   return LoadedSLocEntryTable[Index];
 }
 
-std::pair<int, unsigned>
+std::pair<int, SourceLocation::UIntTy>
 SourceManager::AllocateLoadedSLocEntries(unsigned NumSLocEntries,
-                                         unsigned TotalSize) {
+                                         SourceLocation::UIntTy TotalSize) {
   assert(ExternalSLocEntries && "Don't have an external sloc source");
   LoadedSLocEntryTable.resize(LoadedSLocEntryTable.size() + NumSLocEntries);
   SLocEntryLoaded.resize(LoadedSLocEntryTable.size());
@@ -546,7 +549,8 @@ SourceManager::getFakeContentCacheForRecovery() const {
 FileID SourceManager::createFileID(const ContentCache *File,
                                    SourceLocation IncludePos,
                                    SrcMgr::CharacteristicKind FileCharacter,
-                                   int LoadedID, unsigned LoadedOffset) {
+                                   int LoadedID,
+                                   SourceLocation::UIntTy LoadedOffset) {
   if (LoadedID < 0) {
     assert(LoadedID != -1 && "Loading sentinel FileID");
     unsigned Index = unsigned(-LoadedID) - 2;
@@ -557,13 +561,16 @@ FileID SourceManager::createFileID(const ContentCache *File,
     SLocEntryLoaded[Index] = true;
     return FileID::get(LoadedID);
   }
+  unsigned FileSize = File->getSize();
+  if (!(NextLocalOffset + FileSize + 1 > NextLocalOffset &&
+        NextLocalOffset + FileSize + 1 <= CurrentLoadedOffset)) {
+    // Ran out of source locations.
+    Diag.Report(IncludePos, diag::err_sloc_space_too_large);
+    return FileID();
+  }
   LocalSLocEntryTable.push_back(SLocEntry::get(NextLocalOffset,
                                                FileInfo::get(IncludePos, File,
                                                              FileCharacter)));
-  unsigned FileSize = File->getSize();
-  assert(NextLocalOffset + FileSize + 1 > NextLocalOffset &&
-         NextLocalOffset + FileSize + 1 <= CurrentLoadedOffset &&
-         "Ran out of source locations!");
   // We do a +1 here because we want a SourceLocation that means "the end of the
   // file", e.g. for the "no newline at the end of the file" diagnostic.
   NextLocalOffset += FileSize + 1;
@@ -589,7 +596,7 @@ SourceManager::createExpansionLoc(SourceLocation SpellingLoc,
                                   SourceLocation ExpansionLocEnd,
                                   unsigned TokLength,
                                   int LoadedID,
-                                  unsigned LoadedOffset) {
+                                  SourceLocation::UIntTy LoadedOffset) {
   ExpansionInfo Info = ExpansionInfo::create(SpellingLoc, ExpansionLocStart,
                                              ExpansionLocEnd);
   return createExpansionLocImpl(Info, TokLength, LoadedID, LoadedOffset);
@@ -599,7 +606,7 @@ SourceLocation
 SourceManager::createExpansionLocImpl(const ExpansionInfo &Info,
                                       unsigned TokLength,
                                       int LoadedID,
-                                      unsigned LoadedOffset) {
+                                      SourceLocation::UIntTy LoadedOffset) {
   if (LoadedID < 0) {
     assert(LoadedID != -1 && "Loading sentinel FileID");
     unsigned Index = unsigned(-LoadedID) - 2;
@@ -692,7 +699,7 @@ StringRef SourceManager::getBufferData(FileID FID, bool *Invalid) const {
 /// This is the cache-miss path of getFileID. Not as hot as that function, but
 /// still very important. It is responsible for finding the entry in the
 /// SLocEntry tables that contains the specified location.
-FileID SourceManager::getFileIDSlow(unsigned SLocOffset) const {
+FileID SourceManager::getFileIDSlow(SourceLocation::UIntTy SLocOffset) const {
   if (!SLocOffset)
     return FileID::get(0);
 
@@ -707,7 +714,8 @@ FileID SourceManager::getFileIDSlow(unsigned SLocOffset) const {
 ///
 /// This function knows that the SourceLocation is in a local buffer, not a
 /// loaded one.
-FileID SourceManager::getFileIDLocal(unsigned SLocOffset) const {
+FileID
+SourceManager::getFileIDLocal(SourceLocation::UIntTy SLocOffset) const {
   assert(SLocOffset < NextLocalOffset && "Bad function choice");
 
   // After the first and second level caches, I see two common sorts of
@@ -762,7 +770,8 @@ FileID SourceManager::getFileIDLocal(unsigned SLocOffset) const {
   while (1) {
     bool Invalid = false;
     unsigned MiddleIndex = (GreaterIndex-LessIndex)/2+LessIndex;
-    unsigned MidOffset = getLocalSLocEntry(MiddleIndex, &Invalid).getOffset();
+    SourceLocation::UIntTy MidOffset =
+      getLocalSLocEntry(MiddleIndex, &Invalid).getOffset();
     if (Invalid)
       return FileID::get(0);
     
@@ -798,7 +807,8 @@ FileID SourceManager::getFileIDLocal(unsigned SLocOffset) const {
 ///
 /// This function knows that the SourceLocation is in a loaded buffer, not a
 /// local one.
-FileID SourceManager::getFileIDLoaded(unsigned SLocOffset) const {
+FileID
+SourceManager::getFileIDLoaded(SourceLocation::UIntTy SLocOffset) const {
   // Sanity checking, otherwise a bug may lead to hanging in release build.
   if (SLocOffset < CurrentLoadedOffset) {
     assert(0 && "Invalid SLocOffset or bad function choice");
@@ -1030,6 +1040,24 @@ unsigned SourceManager::getColumnNumber(FileID FID, unsigned FilePos,
   }
 
   const char *Buf = MemBuf->getBufferStart();
+
+  // See if we just calculated the line number for this FilePos and can use
+  // that to lookup the start of the line instead of searching for it.  This
+  // keeps diagnostics on long lines from rescanning the line each time.
+  if (LastLineNoFileIDQuery == FID &&
+      LastLineNoContentCache->SourceLineCache != 0 &&
+      LastLineNoResult < LastLineNoContentCache->NumLines) {
+    unsigned *SourceLineCache = LastLineNoContentCache->SourceLineCache;
+    unsigned LineStart = SourceLineCache[LastLineNoResult - 1];
+    unsigned LineEnd = SourceLineCache[LastLineNoResult];
+    // LineEnd is the start of the next line, so FilePos may be within the
+    // line's separator; leave the second character of "\r\n" to the scan.
+    if (FilePos >= LineStart && FilePos < LineEnd &&
+        (FilePos == LineStart ||
+         (Buf[FilePos - 1] != '\r' && Buf[FilePos - 1] != '\n')))
+      return FilePos - LineStart + 1;
+  }
+
   unsigned LineStart = FilePos;
   while (LineStart && Buf[LineStart-1] != '\n' && Buf[LineStart-1] != '\r')
     --LineStart;
@@ -1395,10 +1423,10 @@ PresumedLoc SourceManager::getPresumedLoc(SourceLocation Loc) const {
 
       // Use the line number specified by the LineEntry.  This line number may
       // be multiple lines down from the line entry.  Add the difference in
-      // physical line numbers from the query point and the line marker to the
-      // total.
+      // physical line numbers from the query point and the line marker
+      // (times the entry's line increment) to the total.
       unsigned MarkerLineNo = getLineNumber(LocInfo.first, Entry->FileOffset);
-      LineNo = Entry->LineNo + (LineNo-MarkerLineNo-1);
+      LineNo = Entry->LineNo + (LineNo-MarkerLineNo-1)*Entry->LineInc;
 
       // Note that column numbers are not molested by line markers.
 
@@ -1413,6 +1441,148 @@ PresumedLoc SourceManager::getPresumedLoc(SourceLocation Loc) const {
   return PresumedLoc(Filename, LineNo, ColNo, IncludeLoc);
 }
 
+//===----------------------------------------------------------------------===//
+// SourceLineCursor
+//===----------------------------------------------------------------------===//
+
+/// \brief Number of lines or line directives to step through before
+/// giving up and searching.
+static const unsigned CursorMaxSteps = 8;
+
+SourceLineCursor::SourceLineCursor(const SourceManager &SM)
+  : SM(SM), FileName(0), Buf(0), BufEnd(0), LineStarts(0), NumLines(0),
+    Line(0), Entries(0), EntriesEnd(0), Entry(0), EntryLine(0) {
+}
+
+bool SourceLineCursor::setFile(FileID NewFID) {
+  FID = FileID();
+  bool Invalid = false;
+  const SLocEntry &SLoc = SM.getSLocEntry(NewFID, &Invalid);
+  if (Invalid || !SLoc.isFile())
+    return false;
+
+  const SrcMgr::FileInfo &FI = SLoc.getFile();
+  ContentCache *Content = const_cast<ContentCache*>(FI.getContentCache());
+  if (Content->SourceLineCache == 0) {
+    ComputeLineNumbers(SM.Diag, Content, SM.ContentCacheAlloc, SM, Invalid);
+    if (Invalid)
+      return false;
+  }
+  const MemoryBuffer *Buffer = Content->getBuffer(SM.Diag, SM,
+                                                  SourceLocation(), &Invalid);
+  if (Invalid)
+    return false;
+
+  FID = NewFID;
+  if (Content->OrigEntry)
+    FileName = Content->OrigEntry->getName();
+  else
+    FileName = Buffer->getBufferIdentifier();
+  FileIncludeLoc = FI.getIncludeLoc();
+  Buf = Buffer->getBufferStart();
+  BufEnd = Buffer->getBufferEnd();
+  LineStarts = Content->SourceLineCache;
+  NumLines = Content->NumLines;
+  Line = 0;
+
+  Entries = EntriesEnd = Entry = 0;
+  if (FI.hasLineDirectives()) {
+    assert(SM.LineTable && "Can't have linetable entries without a LineTable!");
+    if (const std::vector<LineEntry> *V =
+          SM.LineTable->getLineEntries(NewFID)) {
+      Entries = Entry = &V->front();
+      EntriesEnd = Entries + V->size();
+    }
+  }
+  return true;
+}
+
+void SourceLineCursor::seekLine(unsigned Offset) {
+  if (Offset < LineStarts[Line]) {
+    Line = std::upper_bound(LineStarts, LineStarts+Line, Offset)
+      - LineStarts - 1;
+    return;
+  }
+  for (unsigned Steps = 0; Line+1 < NumLines && LineStarts[Line+1] <= Offset;
+       ++Line) {
+    if (++Steps > CursorMaxSteps) {
+      Line = std::upper_bound(LineStarts+Line, LineStarts+NumLines, Offset)
+        - LineStarts - 1;
+      return;
+    }
+  }
+}
+
+void SourceLineCursor::seekEntry(unsigned Offset) {
+  // Entry is one past the last line directive at or before Offset.
+  const LineEntry *Prev = Entry;
+  if (Entry != Entries && Offset < Entry[-1].FileOffset)
+    Entry = std::upper_bound(Entries, Entry, Offset);
+  else {
+    for (unsigned Steps = 0;
+         Entry != EntriesEnd && Entry->FileOffset <= Offset; ++Entry) {
+      if (++Steps > CursorMaxSteps) {
+        Entry = std::upper_bound(Entry, EntriesEnd, Offset);
+        break;
+      }
+    }
+  }
+  if (Entry != Prev && Entry != Entries) {
+    // Physical line of the directive; it's generally close behind the
+    // current line.
+    unsigned EntryOffset = Entry[-1].FileOffset;
+    const unsigned *Pos = LineStarts+Line;
+    if (EntryOffset < *Pos || (Line+1 < NumLines && Pos[1] <= EntryOffset))
+      Pos = std::upper_bound(LineStarts, LineStarts+NumLines, EntryOffset)-1;
+    EntryLine = Pos - LineStarts + 1;
+  }
+}
+
+PresumedLoc SourceLineCursor::getPresumedLoc(SourceLocation Loc) {
+  if (Loc.isInvalid())
+    return PresumedLoc();
+
+  // Presumed locations are always for expansion points.
+  std::pair<FileID, unsigned> LocInfo = SM.getDecomposedExpansionLoc(Loc);
+  if (LocInfo.first != FID && !setFile(LocInfo.first))
+    return PresumedLoc();
+
+  unsigned Offset = LocInfo.second;
+  seekLine(Offset);
+  unsigned LineNo = Line + 1;
+  unsigned ColNo = Offset - LineStarts[Line] + 1;
+
+  // Apply the last line directive before the location, as
+  // SourceManager::getPresumedLoc() does.
+  const char *Filename = FileName;
+  SourceLocation IncludeLoc = FileIncludeLoc;
+  if (Entries) {
+    seekEntry(Offset);
+    if (Entry != Entries) {
+      const LineEntry &E = Entry[-1];
+      if (E.FilenameID != -1)
+        Filename = SM.LineTable->getFilename(E.FilenameID);
+      LineNo = E.LineNo + (LineNo-EntryLine-1)*E.LineInc;
+      if (E.IncludeOffset) {
+        IncludeLoc = SM.getLocForStartOfFile(FID);
+        IncludeLoc = IncludeLoc.getLocWithOffset(E.IncludeOffset);
+      }
+    }
+  }
+
+  return PresumedLoc(Filename, LineNo, ColNo, IncludeLoc);
+}
+
+StringRef SourceLineCursor::getLineText() const {
+  if (FID.isInvalid())
+    return StringRef();
+  const char *Start = Buf + LineStarts[Line];
+  const char *End = Start;
+  while (End != BufEnd && *End != '\n' && *End != '\r')
+    ++End;
+  return StringRef(Start, End-Start);
+}
+
 /// \brief The size of the SLocEnty that \arg FID represents.
 unsigned SourceManager::getFileIDSize(FileID FID) const {
   bool Invalid = false;
@@ -1421,7 +1591,7 @@ unsigned SourceManager::getFileIDSize(FileID FID) const {
     return 0;
 
   int ID = FID.ID;
-  unsigned NextOffset;
+  SourceLocation::UIntTy NextOffset;
   if ((ID > 0 && unsigned(ID+1) == local_sloc_entry_size()))
     NextOffset = getNextLocalOffset();
   else if (ID+1 == -1)
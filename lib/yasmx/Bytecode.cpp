@@ -31,6 +31,7 @@
 #include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/Twine.h"
 #include "yasmx/Basic/Diagnostic.h"
+#include "yasmx/Support/MemoryStats.h"
 #include "yasmx/BytecodeContainer.h"
 #include "yasmx/BytecodeOutput.h"
 #include "yasmx/Bytes.h"
@@ -59,21 +60,53 @@ Bytecode::Contents::~Contents()
 {
 }
 
+void*
+Bytecode::Contents::operator new(std::size_t size)
+{
+    CountAlloc(MEM_BYTECODE, size);
+    return ::operator new(size);
+}
+
+void
+Bytecode::Contents::operator delete(void* ptr, std::size_t size)
+{
+    CountFree(MEM_BYTECODE, size);
+    ::operator delete(ptr);
+}
+
 bool
 Bytecode::Contents::Expand(Bytecode& bc,
-                           unsigned long* len,
+                           uint64_t* len,
                            int span,
-                           long old_val,
-                           long new_val,
+                           int64_t old_val,
+                           int64_t new_val,
                            bool* keep,
-                           /*@out@*/ long* neg_thres,
-                           /*@out@*/ long* pos_thres,
+                           /*@out@*/ int64_t* neg_thres,
+                           /*@out@*/ int64_t* pos_thres,
                            DiagnosticsEngine& diags)
 {
     assert(false && "bytecode does not have any dependent spans");
     return false;
 }
 
+bool
+Bytecode::Contents::getMaxGrowth(const Bytecode& bc, uint64_t* growth) const
+{
+    return false;
+}
+
+bool
+Bytecode::Contents::getOffsetPeriod(const Bytecode& bc, uint64_t* period) const
+{
+    return false;
+}
+
+bool
+Bytecode::Contents::Save(RecordWriter& out) const
+{
+    return false;
+}
+
 Bytecode::Contents::SpecialType
 Bytecode::Contents::getSpecial() const
 {
@@ -88,12 +121,14 @@ void
 Bytecode::Transform(std::auto_ptr<Contents> contents)
 {
     m_contents.reset(contents.release());
+    m_special = getSpecial();
 }
 
 Bytecode::Bytecode(std::auto_ptr<Contents> contents, SourceLocation source)
     : m_contents(contents),
       m_container(0),
       m_len(0),
+      m_special(getSpecial()),
       m_source(source),
       m_offset(0),
       m_index(~0UL)
@@ -104,6 +139,7 @@ Bytecode::Bytecode()
     : m_contents(0),
       m_container(0),
       m_len(0),
+      m_special(Contents::SPECIAL_NONE),
       m_offset(0),
       m_index(~0UL)
 {
@@ -113,6 +149,7 @@ Bytecode::Bytecode(const Bytecode& oth)
     : m_contents(oth.m_contents->clone()),
       m_container(oth.m_container),
       m_len(oth.m_len),
+      m_special(oth.m_special),
       m_source(oth.m_source),
       m_offset(oth.m_offset),
       m_index(oth.m_index)
@@ -122,6 +159,20 @@ Bytecode::~Bytecode()
 {
 }
 
+void*
+Bytecode::operator new(std::size_t size)
+{
+    CountAlloc(MEM_BYTECODE, size);
+    return ::operator new(size);
+}
+
+void
+Bytecode::operator delete(void* ptr, std::size_t size)
+{
+    CountFree(MEM_BYTECODE, size);
+    ::operator delete(ptr);
+}
+
 void
 Bytecode::swap(Bytecode& oth)
 {
@@ -130,6 +181,7 @@ Bytecode::swap(Bytecode& oth)
     m_contents.swap(oth.m_contents);
     std::swap(m_container, oth.m_container);
     std::swap(m_len, oth.m_len);
+    std::swap(m_special, oth.m_special);
     std::swap(m_source, oth.m_source);
     std::swap(m_offset, oth.m_offset);
     std::swap(m_index, oth.m_index);
@@ -176,25 +228,26 @@ Bytecode::CalcLen(const AddSpanFunc& add_span, DiagnosticsEngine& diags)
         m_len = 0;
         return true;
     }
-    unsigned long len;
+    uint64_t len;
     if (!m_contents->CalcLen(*this, &len, add_span, diags))
         return false;
     m_len = len;
+    m_special = getSpecial();
     return true;
 }
 
 bool
 Bytecode::Expand(int span,
-                 long old_val,
-                 long new_val,
+                 int64_t old_val,
+                 int64_t new_val,
                  bool* keep,
-                 /*@out@*/ long* neg_thres,
-                 /*@out@*/ long* pos_thres,
+                 /*@out@*/ int64_t* neg_thres,
+                 /*@out@*/ int64_t* pos_thres,
                  DiagnosticsEngine& diags)
 {
     if (m_contents.get() == 0)
         return true;
-    unsigned long len = m_len;
+    uint64_t len = m_len;
     if (!m_contents->Expand(*this, &len, span, old_val, new_val, keep,
                             neg_thres, pos_thres, diags))
         return false;
@@ -202,10 +255,32 @@ Bytecode::Expand(int span,
     return true;
 }
 
+bool
+Bytecode::getMaxGrowth(uint64_t* growth) const
+{
+    if (m_contents.get() == 0)
+    {
+        *growth = 0;
+        return true;
+    }
+    return m_contents->getMaxGrowth(*this, growth);
+}
+
+bool
+Bytecode::getOffsetPeriod(uint64_t* period) const
+{
+    if (m_contents.get() == 0)
+        return false;
+    return m_contents->getOffsetPeriod(*this, period);
+}
+
 bool
 Bytecode::Output(BytecodeOutput& bc_out)
 {
-    unsigned long start = bc_out.getNumOutput();
+    if (bc_out.m_listfmt)
+        bc_out.m_listfmt->BeginBytecode(*this);
+
+    uint64_t start = bc_out.getNumOutput();
 
     // make a copy of fixed portion
     Bytes& fixed = bc_out.m_bc_scratch;
@@ -226,14 +301,11 @@ Bytecode::Output(BytecodeOutput& bc_out)
         bytes.insert(bytes.end(), fixed.begin() + off,
                      fixed.begin() + off + size);
 
-        // Make a copy of the value to ensure things like
-        // "TIMES x JMP label" work.
-        Value vcopy = *i;
-
-        // Convert the value to bytes.
+        // Convert the value to bytes.  This does not modify the value, so
+        // it's not copied (copying the expression for every fixup is costly).
         NumericOutput num_out(bytes);
         i->ConfigureOutput(&num_out);
-        if (!bc_out.ConvertValueToBytes(vcopy, loc, num_out))
+        if (!bc_out.ConvertValueToBytes(*i, loc, num_out))
             return false;
         num_out.EmitWarnings(bc_out.getDiagnostics());
 
@@ -264,21 +336,15 @@ Bytecode::Output(BytecodeOutput& bc_out)
     return true;
 }
 
-unsigned long
-Bytecode::UpdateOffset(unsigned long offset, DiagnosticsEngine& diags)
+void
+Bytecode::ExpandOffsetSetter(uint64_t offset, DiagnosticsEngine& diags)
 {
-    if (m_contents.get() != 0 &&
-        m_contents->getSpecial() == Contents::SPECIAL_OFFSET)
-    {
-        // Recalculate/adjust len of offset-based bytecodes here
-        bool keep = false;
-        long neg_thres = 0;
-        long pos_thres = static_cast<long>(getNextOffset());
-        Expand(1, 0, static_cast<long>(offset+getFixedLen()), &keep,
-               &neg_thres, &pos_thres, diags);
-    }
-    m_offset = offset;
-    return getNextOffset();
+    // Recalculate/adjust len of offset-based bytecodes here
+    bool keep = false;
+    int64_t neg_thres = 0;
+    int64_t pos_thres = static_cast<int64_t>(getNextOffset());
+    Expand(1, 0, static_cast<int64_t>(offset+getFixedLen()), &keep,
+           &neg_thres, &pos_thres, diags);
 }
 
 void
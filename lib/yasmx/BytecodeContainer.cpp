@@ -27,10 +27,13 @@
 #include "yasmx/BytecodeContainer.h"
 
 #include "yasmx/Basic/Diagnostic.h"
+#include "yasmx/Support/MemoryStats.h"
 #include "yasmx/BytecodeOutput.h"
 #include "yasmx/Bytecode.h"
 #include "yasmx/Expr.h"
+#include "yasmx/Object.h"
 #include "yasmx/Optimizer.h"
+#include "yasmx/Section.h"
 
 
 using namespace yasm;
@@ -39,7 +42,7 @@ namespace {
 class GapBytecode : public Bytecode::Contents
 {
 public:
-    GapBytecode(unsigned long size);
+    GapBytecode(uint64_t size);
     ~GapBytecode();
 
     /// Finalizes the bytecode after parsing.
@@ -47,7 +50,7 @@ public:
 
     /// Calculates the minimum size of a bytecode.
     bool CalcLen(Bytecode& bc,
-                 /*@out@*/ unsigned long* len,
+                 /*@out@*/ uint64_t* len,
                  const Bytecode::AddSpanFunc& add_span,
                  DiagnosticsEngine& diags);
 
@@ -56,7 +59,10 @@ public:
 
     /// Increase the gap size.
     /// @param size     size in bytes
-    void Extend(unsigned long size);
+    void Extend(uint64_t size);
+
+    /// Get the gap size.
+    uint64_t getSize() const { return m_size; }
 
     StringRef getType() const;
 
@@ -68,11 +74,11 @@ public:
 #endif // WITH_XML
 
 private:
-    unsigned long m_size;       ///< size of gap (in bytes)
+    uint64_t m_size;            ///< size of gap (in bytes)
 };
 } // anonymous namespace
 
-GapBytecode::GapBytecode(unsigned long size)
+GapBytecode::GapBytecode(uint64_t size)
     : m_size(size)
 {
 }
@@ -89,7 +95,7 @@ GapBytecode::Finalize(Bytecode& bc, DiagnosticsEngine& diags)
 
 bool
 GapBytecode::CalcLen(Bytecode& bc,
-                     /*@out@*/ unsigned long* len,
+                     /*@out@*/ uint64_t* len,
                      const Bytecode::AddSpanFunc& add_span,
                      DiagnosticsEngine& diags)
 {
@@ -117,7 +123,7 @@ GapBytecode::clone() const
 }
 
 void
-GapBytecode::Extend(unsigned long size)
+GapBytecode::Extend(uint64_t size)
 {
     m_size += size;
 }
@@ -134,7 +140,6 @@ GapBytecode::Write(pugi::xml_node out) const
 
 BytecodeContainer::BytecodeContainer(Section* sect)
     : m_sect(sect),
-      m_bcs_owner(m_bcs),
       m_last_gap(false)
 {
     // A container always has at least one bytecode.
@@ -143,26 +148,22 @@ BytecodeContainer::BytecodeContainer(Section* sect)
 
 BytecodeContainer::~BytecodeContainer()
 {
-}
-
-void
-BytecodeContainer::AppendBytecode(std::auto_ptr<Bytecode> bc)
-{
-    if (bc.get() != 0)
-    {
-        bc->m_container = this; // record parent
-        m_bcs.push_back(bc.release());
-    }
-    m_last_gap = false;
+    // The bytecodes live in the arena, so only need destroying.
+    for (bc_iterator bc=m_bcs.begin(), end=m_bcs.end(); bc != end; ++bc)
+        bc->~Bytecode();
+    CountFree(MEM_BYTECODE, m_bcs.size()*sizeof(Bytecode));
 }
 
 Bytecode&
-BytecodeContainer::AppendGap(unsigned long size, SourceLocation source)
+BytecodeContainer::AppendGap(uint64_t size, SourceLocation source)
 {
     if (m_last_gap)
     {
-        static_cast<GapBytecode&>(*m_bcs.back().m_contents).Extend(size);
-        return m_bcs.back();
+        Bytecode& last = m_bcs.back();
+        GapBytecode& gap = static_cast<GapBytecode&>(*last.m_contents);
+        MarkLine(last, last.getFixedLen() + gap.getSize());
+        gap.Extend(size);
+        return last;
     }
     Bytecode& bc = FreshBytecode();
     bc.Transform(Bytecode::Contents::Ptr(new GapBytecode(size)));
@@ -174,7 +175,10 @@ BytecodeContainer::AppendGap(unsigned long size, SourceLocation source)
 Bytecode&
 BytecodeContainer::StartBytecode()
 {
-    Bytecode* bc = new Bytecode;
+    // Bytecodes are only ever appended, and all live as long as the
+    // container, so construct them in place in the arena.
+    Bytecode* bc = new (m_bc_alloc.Allocate<Bytecode>()) Bytecode;
+    CountAlloc(MEM_BYTECODE, sizeof(Bytecode));
     bc->m_container = this; // record parent
     m_bcs.push_back(bc);
     m_last_gap = false;
@@ -184,10 +188,72 @@ BytecodeContainer::StartBytecode()
 Bytecode&
 BytecodeContainer::FreshBytecode()
 {
-    Bytecode& bc = bytecodes_back();
-    if (bc.hasContents())
-        return StartBytecode();
-    return bc;
+    Bytecode* bc = &bytecodes_back();
+    if (bc->hasContents())
+        bc = &StartBytecode();
+
+    // All output is appended through here, so this is where a listed
+    // line's output starts.
+    MarkLine(*bc, bc->getFixedLen());
+    return *bc;
+}
+
+void
+BytecodeContainer::TakeBytecodes(BytecodeContainer& other)
+{
+    std::vector<Bytecode*> bcs;
+    other.m_bcs.swap(bcs);
+    m_bcs.reserve(m_bcs.size() + bcs.size());
+    for (std::vector<Bytecode*>::iterator i=bcs.begin(), end=bcs.end();
+         i != end; ++i)
+    {
+        (*i)->m_container = this;
+        m_bcs.push_back(*i);
+    }
+    m_last_gap = other.m_last_gap;
+    other.m_last_gap = false;
+
+    m_lines.insert(m_lines.end(), other.m_lines.begin(), other.m_lines.end());
+    other.m_lines.clear();
+    m_insns.insert(m_insns.end(), other.m_insns.begin(), other.m_insns.end());
+    other.m_insns.clear();
+}
+
+void
+BytecodeContainer::MarkLine(const Bytecode& bc, unsigned long offset)
+{
+    Object* object = m_sect ? m_sect->getObject() : 0;
+    if (!object)
+        return;
+    SourceLocation source = object->getListLine();
+    if (source.isInvalid())
+        return;
+
+    if (!m_lines.empty())
+    {
+        LineMark& last = m_lines.back();
+        if (last.source == source)
+            return;
+        // Lines without output don't need a mark of their own.
+        if (last.bc == &bc && last.offset == offset)
+        {
+            last.source = source;
+            return;
+        }
+    }
+    LineMark mark = { &bc, offset, source };
+    m_lines.push_back(mark);
+}
+
+void
+BytecodeContainer::MarkInsn()
+{
+    Object* object = m_sect ? m_sect->getObject() : 0;
+    if (!object || !object->isMarkLayout())
+        return;
+    Bytecode& bc = FreshBytecode();
+    Location loc = { &bc, bc.getFixedLen() };
+    m_insns.push_back(loc);
 }
 
 Location
@@ -208,7 +274,7 @@ BytecodeContainer::Finalize(DiagnosticsEngine& diags)
 void
 BytecodeContainer::UpdateOffsets(DiagnosticsEngine& diags)
 {
-    unsigned long offset = 0;
+    uint64_t offset = 0;
     m_bcs.front().setOffset(0);
     for (bc_iterator bc=m_bcs.begin(), end=m_bcs.end(); bc != end; ++bc)
         offset = bc->UpdateOffset(offset, diags);
@@ -221,7 +287,8 @@ BytecodeContainer::Optimize(DiagnosticsEngine& diags)
 
     // Step 1a
     unsigned long bc_index = 0;
-    unsigned long offset = 0;
+    uint64_t offset = 0;
+    opt.StartContainer();
 
     // Set the offset of the first (empty) bytecode.
     m_bcs.front().setIndex(bc_index++);
@@ -26,14 +26,17 @@
 //
 #include "yasmx/BytecodeOutput.h"
 
+#include <algorithm>
+
 #include "llvm/Support/raw_ostream.h"
 #include "yasmx/Basic/Diagnostic.h"
+#include "yasmx/Support/OutputFileStream.h"
 
 
 using namespace yasm;
 
 BytecodeOutput::BytecodeOutput(DiagnosticsEngine& diags)
-    : m_diags(diags), m_num_output(0)
+    : m_diags(diags), m_num_output(0), m_listfmt(0)
 {
 }
 
@@ -55,6 +58,63 @@ BytecodeOutput::ConvertSymbolToBytes(SymbolRef sym,
     return true;
 }
 
+void
+BytecodeOutput::OutputFill(const Bytes& bytes,
+                           uint64_t count,
+                           SourceLocation source)
+{
+    if (bytes.empty() || count == 0)
+        return;
+    DoOutputFill(bytes, count, source);
+    m_num_output += static_cast<uint64_t>(bytes.size()) * count;
+    if (m_listfmt)
+    {
+        ArrayRef<unsigned char> copy(&bytes[0], bytes.size());
+        for (; count != 0; --count)
+            m_listfmt->OutputBytes(copy);
+    }
+}
+
+void
+BytecodeOutput::DoOutputFill(const Bytes& bytes,
+                             uint64_t count,
+                             SourceLocation source)
+{
+    // Replicate the bytes into a large block so long fills are output in
+    // a few big pieces rather than one copy at a time.
+    static const size_t BLOCK_SIZE = 64*1024;
+    uint64_t per_block = std::max<uint64_t>(1, BLOCK_SIZE / bytes.size());
+    per_block = std::min(per_block, count);
+    Bytes block;
+    block.reserve(static_cast<size_t>(bytes.size() * per_block));
+    for (uint64_t i=0; i<per_block; ++i)
+        block.insert(block.end(), bytes.begin(), bytes.end());
+
+    for (; count >= per_block; count -= per_block)
+        DoOutputBytes(block, source);
+    if (count != 0)
+    {
+        block.resize(static_cast<size_t>(count * bytes.size()));
+        DoOutputBytes(block, source);
+    }
+}
+
+void
+BytecodeOutput::DoOutputRaw(StringRef data, SourceLocation source)
+{
+    static const size_t BLOCK_SIZE = 64*1024;
+
+    Bytes bytes;
+    while (!data.empty())
+    {
+        StringRef chunk = data.substr(0, BLOCK_SIZE);
+        bytes.resize(0);
+        bytes.WriteString(chunk);
+        DoOutputBytes(bytes, source);
+        data = data.substr(chunk.size());
+    }
+}
+
 BytecodeNoOutput::~BytecodeNoOutput()
 {
 }
@@ -75,7 +135,7 @@ BytecodeNoOutput::ConvertValueToBytes(Value& value,
 }
 
 void
-BytecodeNoOutput::DoOutputGap(unsigned long size, SourceLocation source)
+BytecodeNoOutput::DoOutputGap(uint64_t size, SourceLocation source)
 {
     // expected
 }
@@ -88,12 +148,34 @@ BytecodeNoOutput::DoOutputBytes(const Bytes& bytes, SourceLocation source)
     Diag(source, diag::warn_nobits_data);
 }
 
+void
+BytecodeNoOutput::DoOutputRaw(StringRef data, SourceLocation source)
+{
+    if (data.empty())
+        return;
+    Diag(source, diag::warn_nobits_data);
+}
+
+void
+BytecodeNoOutput::DoOutputFill(const Bytes& bytes,
+                               uint64_t count,
+                               SourceLocation source)
+{
+    Diag(source, diag::warn_nobits_data);
+}
+
+BytecodeStreamOutput::BytecodeStreamOutput(OutputFileStream& os,
+                                           DiagnosticsEngine& diags)
+    : BytecodeOutput(diags), m_os(os), m_file_os(&os)
+{
+}
+
 BytecodeStreamOutput::~BytecodeStreamOutput()
 {
 }
 
 void
-BytecodeStreamOutput::DoOutputGap(unsigned long size, SourceLocation source)
+BytecodeStreamOutput::DoOutputGap(uint64_t size, SourceLocation source)
 {
     // Warn that gaps are converted to 0 and write out the 0's.
     static const unsigned long BLOCK_SIZE = 4096;
@@ -103,6 +185,12 @@ BytecodeStreamOutput::DoOutputGap(unsigned long size, SourceLocation source)
 
     Diag(source, diag::warn_uninit_zero);
 
+    if (m_file_os)
+    {
+        m_file_os->write_zeros(size);
+        return;
+    }
+
     // Write out in chunks
     Bytes& bytes = getScratch();
     bytes.resize(BLOCK_SIZE);
@@ -121,3 +209,25 @@ BytecodeStreamOutput::DoOutputBytes(const Bytes& bytes, SourceLocation source)
     // Output bytes to file
     m_os << bytes;
 }
+
+void
+BytecodeStreamOutput::DoOutputRaw(StringRef data, SourceLocation source)
+{
+    // Large writes bypass the stream buffer, so this goes straight from
+    // the data (e.g. a mapped file) to the file.
+    m_os << data;
+}
+
+void
+BytecodeStreamOutput::DoOutputFill(const Bytes& bytes,
+                                   uint64_t count,
+                                   SourceLocation source)
+{
+    if (!m_file_os)
+    {
+        BytecodeOutput::DoOutputFill(bytes, count, source);
+        return;
+    }
+    m_file_os->write_fill(reinterpret_cast<const char*>(&bytes[0]),
+                          bytes.size(), count);
+}
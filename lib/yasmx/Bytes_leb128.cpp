@@ -35,8 +35,6 @@
 using namespace yasm;
 using llvm::APInt;
 
-static APInt staticbv(IntNum::BITVECT_NATIVE_SIZE, 0);
-
 static inline uint64_t
 Extract(const APInt& bv, unsigned int width, unsigned int lsb)
 {
@@ -45,6 +43,65 @@ Extract(const APInt& bv, unsigned int width, unsigned int lsb)
     return v;
 }
 
+/// Get the number of bits needed to represent a value that fits in a long.
+/// @return False if the value doesn't fit in a long or is negative and
+///         unsigned, in which case the full bitvector must be used.
+static bool
+getSmallBitCount(const IntNum& intn, bool sign, int* bits)
+{
+    if (!intn.isInt())
+        return false;
+    long v = intn.getInt();
+    if (!sign && v < 0)
+        return false;
+    unsigned long u = static_cast<unsigned long>(v < 0 ? ~v : v);
+    *bits = 0;
+    for (; u != 0; u >>= 1)
+        ++*bits;
+    if (sign)
+        ++*bits;
+    return true;
+}
+
+/// Encode a value that fits in a long directly from the word, into a local
+/// buffer, so the output is extended only once.
+/// @return Number of bytes written.
+static unsigned long
+WriteSmallLEB128(Bytes& bytes, long v, bool sign)
+{
+    unsigned char buf[(sizeof(long)*8+6)/7+1];
+    unsigned int n = 0;
+    if (sign)
+    {
+        for (;;)
+        {
+            unsigned char byte = static_cast<unsigned char>(v & 0x7F);
+            v = (v < 0) ? ~(~v >> 7) : (v >> 7);
+            // done once the rest is all sign bits, matching bit 6
+            if ((v == 0 && (byte & 0x40) == 0) ||
+                (v == -1 && (byte & 0x40) != 0))
+            {
+                buf[n++] = byte;
+                break;
+            }
+            buf[n++] = byte | 0x80;
+        }
+    }
+    else
+    {
+        unsigned long u = static_cast<unsigned long>(v);
+        do {
+            unsigned char byte = static_cast<unsigned char>(u & 0x7F);
+            u >>= 7;
+            if (u != 0)
+                byte |= 0x80;
+            buf[n++] = byte;
+        } while (u != 0);
+    }
+    bytes.insert(bytes.end(), buf, buf+n);
+    return n;
+}
+
 unsigned long
 yasm::WriteLEB128(Bytes& bytes, const IntNum& intn, bool sign)
 {
@@ -55,15 +112,22 @@ yasm::WriteLEB128(Bytes& bytes, const IntNum& intn, bool sign)
         return 1;
     }
 
-    const APInt* bv = intn.getBV(&staticbv);
+    // Values that fit in a long (the common case) are encoded from the
+    // word; negative unsigned values need the full bitvector.
+    if (intn.isInt() && (sign || intn.getSign() >= 0))
+        return WriteSmallLEB128(bytes, intn.getInt(), sign);
+
+    Bytes::size_type orig_size = bytes.size();
     int size;
+    int i = 0;
+
+    APInt intbv(IntNum::BITVECT_NATIVE_SIZE, 0);
+    const APInt* bv = intn.getBV(&intbv);
     if (sign)
         size = bv->getMinSignedBits();
     else
         size = bv->getActiveBits();
 
-    Bytes::size_type orig_size = bytes.size();
-    int i = 0;
     for (; i<size-7; i += 7)
         bytes.push_back(static_cast<unsigned char>(Extract(*bv, 7, i)) | 0x80);
     // last byte does not have MSB set
@@ -78,7 +142,12 @@ yasm::SizeLEB128(const IntNum& intn, bool sign)
     if (intn.isZero())
         return 1;
 
-    const APInt* bv = intn.getBV(&staticbv);
+    int size;
+    if (getSmallBitCount(intn, sign, &size))
+        return (size+6)/7;
+
+    APInt intbv(IntNum::BITVECT_NATIVE_SIZE, 0);
+    const APInt* bv = intn.getBV(&intbv);
     if (sign)
         return (bv->getMinSignedBits()+6)/7;
     else
@@ -38,7 +38,6 @@
 using namespace yasm;
 using llvm::APInt;
 
-static APInt staticbv(IntNum::BITVECT_NATIVE_SIZE, 0);
 
 void
 yasm::Write8(Bytes& bytes, const IntNum& intn)
@@ -61,35 +60,9 @@ yasm::Write32(Bytes& bytes, const IntNum& intn)
 void
 yasm::Write64(Bytes& bytes, const IntNum& intn)
 {
-    unsigned long low = intn.Extract(32, 0);
-    unsigned long high = intn.Extract(32, 32);
-    if (bytes.isBigEndian())
-    {
-        Write32(bytes, high);
-        Write32(bytes, low);
-    }
-    else
-    {
-        Write32(bytes, low);
-        Write32(bytes, high);
-    }
-}
-
-static inline void
-Write64I(Bytes& bytes, uint64_t val)
-{
-    unsigned long low = static_cast<unsigned long>(val);
-    unsigned long high = static_cast<unsigned long>(val >> 32);
-    if (bytes.isBigEndian())
-    {
-        Write32(bytes, high);
-        Write32(bytes, low);
-    }
-    else
-    {
-        Write32(bytes, low);
-        Write32(bytes, high);
-    }
+    uint64_t low = intn.Extract(32, 0);
+    uint64_t high = intn.Extract(32, 32);
+    Write64(bytes, (high << 32) | low);
 }
 
 void
@@ -108,7 +81,8 @@ yasm::WriteN(Bytes& bytes, const IntNum& intn, int n)
     }
 
     // harder cases
-    const APInt* bv = intn.getBV(&staticbv);
+    APInt intbv(IntNum::BITVECT_NATIVE_SIZE, 0);
+    const APInt* bv = intn.getBV(&intbv);
     const uint64_t* words = bv->getRawData();
     unsigned int nwords = bv->getNumWords();
     APInt tmp;    // must be here so it stays in scope
@@ -136,7 +110,7 @@ yasm::WriteN(Bytes& bytes, const IntNum& intn, int n)
         // rest (if any) is whole words
         unsigned int w = nwords-2;
         for (; i>=64; i-=64, --w)
-            Write64I(bytes, words[w]);
+            Write64(bytes, words[w]);
     }
     else
     {
@@ -144,7 +118,7 @@ yasm::WriteN(Bytes& bytes, const IntNum& intn, int n)
         unsigned int w = 0;
         int i = 0;
         for (; i<=n-64; i+=64, ++w)
-            Write64I(bytes, words[w]);
+            Write64(bytes, words[w]);
         // finish with bytes
         if (i < n)
         {
@@ -26,6 +26,7 @@
 ///
 #include "yasmx/BytecodeContainer.h"
 
+#include "llvm/ADT/ArrayRef.h"
 #include "yasmx/Arch.h"
 #include "yasmx/Bytecode.h"
 #include "yasmx/Bytes_util.h"
@@ -90,6 +91,30 @@ yasm::AppendData(BytecodeContainer& container,
     bc.getFixed().insert(bc.getFixed().end(), zero.begin(), zero.end());
 }
 
+void
+yasm::AppendDataArray(BytecodeContainer& container,
+                      ArrayRef<uint64_t> vals,
+                      unsigned int size,
+                      const Arch& arch)
+{
+    assert(size <= 8 && "data value too large");
+    Bytes& fixed = container.FreshBytecode().getFixed();
+    Bytes endian;
+    arch.setEndian(endian);
+    bool big = endian.isBigEndian();
+
+    Bytes::size_type start = fixed.size();
+    fixed.resize(start + vals.size()*size);
+    Bytes::iterator out = fixed.begin() + start;
+    for (ArrayRef<uint64_t>::iterator i=vals.begin(), end=vals.end();
+         i != end; ++i, out += size)
+    {
+        uint64_t val = *i;
+        for (unsigned int j=0; j<size; ++j, val >>= 8)
+            out[big ? size-1-j : j] = static_cast<unsigned char>(val & 0xff);
+    }
+}
+
 void
 yasm::AppendData(BytecodeContainer& container,
                  std::auto_ptr<Expr> expr,
@@ -104,6 +104,26 @@ yasm::append_data(pugi::xml_node node, unsigned long val)
     return append_data(node, oss.str().data());
 }
 
+#ifdef YASM_HAVE_LONG_LONG
+pugi::xml_node
+yasm::append_data(pugi::xml_node node, long long val)
+{
+    SmallString<128> ss;
+    llvm::raw_svector_ostream oss(ss);
+    oss << val << '\0';
+    return append_data(node, oss.str().data());
+}
+
+pugi::xml_node
+yasm::append_data(pugi::xml_node node, unsigned long long val)
+{
+    SmallString<128> ss;
+    llvm::raw_svector_ostream oss(ss);
+    oss << val << '\0';
+    return append_data(node, oss.str().data());
+}
+#endif
+
 pugi::xml_node
 yasm::append_data(pugi::xml_node node, bool val)
 {
@@ -178,6 +198,26 @@ yasm::append_child(pugi::xml_node node, const char* name, unsigned long val)
     return child;
 }
 
+#ifdef YASM_HAVE_LONG_LONG
+pugi::xml_node
+yasm::append_child(pugi::xml_node node, const char* name, long long val)
+{
+    pugi::xml_node child = node.append_child(name);
+    append_data(child, val);
+    return child;
+}
+
+pugi::xml_node
+yasm::append_child(pugi::xml_node node,
+                   const char* name,
+                   unsigned long long val)
+{
+    pugi::xml_node child = node.append_child(name);
+    append_data(child, val);
+    return child;
+}
+#endif
+
 pugi::xml_node
 yasm::append_child(pugi::xml_node node, const char* name, bool val)
 {
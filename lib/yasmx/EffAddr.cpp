@@ -26,6 +26,7 @@
 //
 #include "yasmx/EffAddr.h"
 
+#include "llvm/ADT/SmallVector.h"
 #include "yasmx/Arch.h"
 #include "yasmx/Expr.h"
 
@@ -40,7 +41,11 @@ EffAddr::EffAddr(std::auto_ptr<Expr> e)
       m_nosplit(false),
       m_strong(false),
       m_pc_rel(false),
-      m_not_pc_rel(false)
+      m_not_pc_rel(false),
+      m_decomposed(false),
+      m_base(0),
+      m_index(0),
+      m_scale(0)
 {
 }
 
@@ -52,7 +57,12 @@ EffAddr::EffAddr(const EffAddr& rhs)
       m_nosplit(rhs.m_nosplit),
       m_strong(rhs.m_strong),
       m_pc_rel(rhs.m_pc_rel),
-      m_not_pc_rel(rhs.m_not_pc_rel)
+      m_not_pc_rel(rhs.m_not_pc_rel),
+      m_decomposed(rhs.m_decomposed),
+      m_base(rhs.m_base),
+      m_index(rhs.m_index),
+      m_scale(rhs.m_scale),
+      m_const_disp(rhs.m_const_disp)
 {
 }
 
@@ -60,6 +70,172 @@ EffAddr::~EffAddr()
 {
 }
 
+namespace {
+// Up to two registers with multipliers plus a constant, built up while
+// evaluating an address expression.
+struct LinearAddr
+{
+    LinearAddr() : nregs(0) {}
+
+    const Register* reg[2];
+    unsigned int mult[2];
+    bool scaled[2];     // multiplied explicitly (even if by 1)
+    int nregs;
+    IntNum num;
+};
+} // anonymous namespace
+
+static bool
+AddLinear(LinearAddr& lhs, const LinearAddr& rhs)
+{
+    for (int i=0; i<rhs.nregs; ++i)
+    {
+        if (lhs.nregs == 2 || (lhs.nregs == 1 && lhs.reg[0] == rhs.reg[i]))
+            return false;
+        lhs.reg[lhs.nregs] = rhs.reg[i];
+        lhs.mult[lhs.nregs] = rhs.mult[i];
+        lhs.scaled[lhs.nregs] = rhs.scaled[i];
+        ++lhs.nregs;
+    }
+    lhs.num += rhs.num;
+    return true;
+}
+
+// Evaluate e as a LinearAddr.  Only ADD, SUB, NEG, and MUL by a constant
+// are accepted; anything else (symbols, other operators, negative or
+// large multipliers) fails.
+static bool
+EvalLinear(const Expr& e, LinearAddr* out)
+{
+    const ExprTerms& terms = e.getTerms();
+    SmallVector<LinearAddr, 4> stack;
+
+    for (ExprTerms::const_iterator i=terms.begin(), end=terms.end(); i != end;
+         ++i)
+    {
+        if (i->isEmpty())
+            continue;
+        if (const IntNum* intn = i->getIntNum())
+        {
+            stack.push_back(LinearAddr());
+            stack.back().num = *intn;
+            continue;
+        }
+        if (const Register* reg = i->getRegister())
+        {
+            stack.push_back(LinearAddr());
+            LinearAddr& lin = stack.back();
+            lin.reg[0] = reg;
+            lin.mult[0] = 1;
+            lin.scaled[0] = false;
+            lin.nregs = 1;
+            continue;
+        }
+        if (!i->isOp())
+            return false;
+
+        unsigned int nchild = i->getNumChild();
+        if (nchild == 0 || nchild > stack.size())
+            return false;
+        LinearAddr* first = &stack[stack.size()-nchild];
+
+        if (i->isOp(Op::ADD))
+        {
+            for (unsigned int n=1; n<nchild; ++n)
+            {
+                if (!AddLinear(*first, first[n]))
+                    return false;
+            }
+        }
+        else if (i->isOp(Op::SUB) && nchild == 2 && first[1].nregs == 0)
+            first->num -= first[1].num;
+        else if (i->isOp(Op::NEG) && nchild == 1 && first->nregs == 0)
+            first->num = -first->num;
+        else if (i->isOp(Op::MUL) && nchild == 2)
+        {
+            LinearAddr* other = first;
+            LinearAddr* factor = &first[1];
+            if (factor->nregs != 0)
+                std::swap(other, factor);
+            if (factor->nregs != 0 || !factor->num.isInRange(0, 255))
+                return false;
+            if (other->nregs == 0)
+                other->num *= factor->num;
+            else if (other->nregs == 1 && other->num.isZero())
+            {
+                other->mult[0] *= factor->num.getUInt();
+                other->scaled[0] = true;
+                if (other->mult[0] > 255)
+                    return false;
+            }
+            else
+                return false;
+            if (other != first)
+                std::swap(*first, *other);
+        }
+        else
+            return false;
+
+        stack.resize(stack.size()-nchild+1);
+    }
+
+    if (stack.size() != 1)
+        return false;
+    *out = stack.front();
+    return true;
+}
+
+void
+EffAddr::setDecomposed(const Register* base,
+                       const Register* index,
+                       unsigned int scale,
+                       const Expr& disp)
+{
+    m_decomposed = false;
+    if (base != 0 && base == index)
+        return;
+
+    LinearAddr lin;
+    if (!disp.isEmpty() && (!EvalLinear(disp, &lin) || lin.nregs != 0))
+        return;
+
+    m_decomposed = true;
+    m_base = base;
+    m_index = index;
+    m_scale = scale;
+    m_const_disp = lin.num;
+}
+
+bool
+EffAddr::Decompose()
+{
+    m_decomposed = false;
+    LinearAddr lin;
+    if (!m_disp.hasAbs() || !EvalLinear(*m_disp.getAbs(), &lin) ||
+        lin.nregs == 0)
+        return false;
+
+    // The base (if any) is the unscaled register; the index is the
+    // scaled one.
+    int base = -1, index = -1;
+    for (int i=0; i<lin.nregs; ++i)
+    {
+        if (lin.mult[i] == 0)
+            return false;
+        int& slot = lin.scaled[i] ? index : base;
+        if (slot != -1)
+            return false;
+        slot = i;
+    }
+
+    m_decomposed = true;
+    m_base = (base == -1) ? 0 : lin.reg[base];
+    m_index = (index == -1) ? 0 : lin.reg[index];
+    m_scale = (index == -1) ? 0 : lin.mult[index];
+    m_const_disp = lin.num;
+    return true;
+}
+
 #ifdef WITH_XML
 pugi::xml_node
 EffAddr::Write(pugi::xml_node out) const
@@ -34,6 +34,7 @@
 #include "llvm/Support/raw_ostream.h"
 #include "yasmx/Basic/Diagnostic.h"
 #include "yasmx/Config/functional.h"
+#include "yasmx/Support/MemoryStats.h"
 #include "yasmx/Arch.h"
 #include "yasmx/IntNum.h"
 #include "yasmx/Symbol.h"
@@ -348,6 +349,20 @@ Expr::~Expr()
 {
 }
 
+void*
+Expr::operator new(std::size_t size)
+{
+    CountAlloc(MEM_EXPR, size);
+    return ::operator new(size);
+}
+
+void
+Expr::operator delete(void* ptr, std::size_t size)
+{
+    CountFree(MEM_EXPR, size);
+    ::operator delete(ptr);
+}
+
 void
 Expr::swap(Expr& oth)
 {
@@ -772,10 +787,78 @@ again:
         root.Zero();    // If operator has no children, replace it with a zero.
 }
 
+namespace {
+/// Operator enclosing the current term in FlattenAssociative().
+struct FlattenParent
+{
+    int depth;      ///< original depth
+    Op::Op op;      ///< operator
+    int target;     ///< operator term children are leveled into
+    int delta;      ///< depth reduction of children
+};
+} // anonymous namespace
+
+/// Level all nested same-operator terms of associative operators in a
+/// single pass, e.g. ((a+b)+c)+d -> a+b+c+d.  LevelOp() does the same one
+/// level at a time, but each level rescans and readjusts the depth of the
+/// entire subtree, which is quadratic for long chains.
+/// Float chains and (when simplify_reg_mul is disabled) MUL chains are left
+/// to LevelOp(), as their results can depend on the order of leveling.
+/// @param terms            expression terms
+/// @param simplify_reg_mul simplify REG*1 identities
+static void
+FlattenAssociative(ExprTerms& terms, bool simplify_reg_mul)
+{
+    bool floats = false;
+    for (ExprTerms::const_iterator i=terms.begin(), end=terms.end();
+         i != end; ++i)
+    {
+        if (i->isType(ExprTerm::FLOAT))
+        {
+            floats = true;
+            break;
+        }
+    }
+
+    // Walking from the root down, keep the chain of operators enclosing
+    // the current term.
+    SmallVector<FlattenParent, 8> parents;
+
+    for (int n=terms.size()-1; n >= 0; --n)
+    {
+        ExprTerm& term = terms[n];
+        if (term.isEmpty())
+            continue;
+        int depth = term.m_depth;
+        while (!parents.empty() && parents.back().depth >= depth)
+            parents.pop_back();
+        int delta = parents.empty() ? 0 : parents.back().delta;
+        term.m_depth -= delta;
+        if (!term.isOp())
+            continue;
+
+        Op::Op op = term.getOp();
+        FlattenParent parent = {depth, op, n, delta};
+        if (!parents.empty() && parents.back().op == op &&
+            isAssociative(op) &&
+            !(floats && (op == Op::ADD || op == Op::MUL)) &&
+            (simplify_reg_mul || op != Op::MUL))
+        {
+            // Level into parent's target.
+            parent.target = parents.back().target;
+            parent.delta = delta+1;
+            terms[parent.target].AddNumChild(term.getNumChild() - 1);
+            term.Clear();
+        }
+        parents.push_back(parent);
+    }
+}
+
 void
 Expr::Simplify(DiagnosticsEngine& diags, bool simplify_reg_mul)
 {
     TransformNeg();
+    FlattenAssociative(m_terms, simplify_reg_mul);
 
     for (int pos=0, size=m_terms.size(); pos<size; ++pos)
     {
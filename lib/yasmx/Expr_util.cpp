@@ -24,39 +24,123 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 //
+#define DEBUG_TYPE "Expr"
+
 #include "yasmx/Expr_util.h"
 
 #include <algorithm>
 
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Support/Mutex.h"
+#include "yasmx/Basic/Diagnostic.h"
 #include "yasmx/Expr.h"
 #include "yasmx/Symbol.h"
 
 
 using namespace yasm;
 
-namespace {
-struct SawEqu
+STATISTIC(num_equ_memo_hits, "Number of equ expansions from memoized value");
+STATISTIC(num_equ_folded, "Number of equ values folded to a constant");
+
+// Held while marking symbols used and memoizing equ expansions, as
+// Object::Finalize() may expand the same equ's on several threads.
+static llvm::sys::Mutex equ_lock;
+
+// Returns true if an expression can be folded to a single integer without
+// any diagnostics: all leaves must be integers, and division (which can
+// fail with divide by zero) and non-numeric operators are excluded.
+static bool
+isFoldable(const Expr& e)
+{
+    for (ExprTerms::const_iterator i=e.getTerms().begin(),
+         end=e.getTerms().end(); i != end; ++i)
+    {
+        if (i->isType(ExprTerm::INT))
+            continue;
+        if (!i->isType(ExprTerm::OP))
+            return false;
+        switch (i->getOp())
+        {
+            case Op::DIV:
+            case Op::SIGNDIV:
+            case Op::MOD:
+            case Op::SIGNMOD:
+                return false;
+            default:
+                if (i->getOp() >= Op::NONNUM)
+                    return false;
+                break;
+        }
+    }
+    return true;
+}
+
+// Returns true if an expanded EQU value can be memoized.  Any symbol
+// remaining after expansion must already be defined; an undefined symbol
+// may still become an EQU later in the parse.
+static bool
+isMemoizable(const Expr& e)
 {
-    Symbol* sym;
-    int depth_delta;
-    int end_n;
-};
+    for (ExprTerms::const_iterator i=e.getTerms().begin(),
+         end=e.getTerms().end(); i != end; ++i)
+    {
+        Symbol* sym = i->getSymbol();
+        if (sym && !sym->isDefined())
+            return false;
+    }
+    return true;
+}
 
-class MatchSawEqu
+static bool ExpandEquImpl(Expr& e,
+                          bool fold_constants,
+                          SmallVectorImpl<Symbol*>& expanding);
+
+// Fully expand the EQU value of sym into expanded, memoizing the result on
+// the symbol when possible.  Returns false on a circular reference.
+static bool
+ExpandEquValue(Symbol* sym,
+               const Expr& equ,
+               Expr& expanded,
+               SmallVectorImpl<Symbol*>& expanding)
 {
-    Symbol* m_sym;
-public:
-    MatchSawEqu(Symbol* sym) : m_sym(sym) {}
-    bool operator() (SawEqu& sawequ) { return sawequ.sym == m_sym; }
-};
-} // anonymous namespace
+    if (std::find(expanding.begin(), expanding.end(), sym) != expanding.end())
+        return false;
 
-bool
-yasm::ExpandEqu(Expr& e)
+    expanded = equ;
+    expanding.push_back(sym);
+    bool ok = ExpandEquImpl(expanded, false, expanding);
+    expanding.pop_back();
+    if (!ok)
+        return false;
+
+    if (!isMemoizable(expanded))
+        return true;
+
+    // Fold constant integer values once here rather than at every use.
+    std::auto_ptr<Expr> folded(0);
+    if (isFoldable(expanded))
+    {
+        folded.reset(new Expr(expanded));
+        IntrusiveRefCntPtr<DiagnosticIDs> diagids(new DiagnosticIDs);
+        DiagnosticsEngine nodiags(diagids);
+        folded->Simplify(nodiags);
+        if (folded->isIntNum())
+            ++num_equ_folded;
+        else
+            folded.reset(0);
+    }
+
+    sym->setExpandedEqu(std::auto_ptr<Expr>(new Expr(expanded)), folded);
+    return true;
+}
+
+static bool
+ExpandEquImpl(Expr& e,
+              bool fold_constants,
+              SmallVectorImpl<Symbol*>& expanding)
 {
     if (e.isEmpty())
         return true;
-    SmallVector<SawEqu, 8> seen;
     ExprTerms& terms = e.getTerms();
 
     int n = terms.size()-1;
@@ -69,15 +153,6 @@ yasm::ExpandEqu(Expr& e)
             continue;
         }
 
-        while (seen.size() > 0 && seen.back().end_n > n)
-            seen.pop_back();
-
-        // Update depth as needed
-        int depth_delta = 0;
-        if (seen.size() > 0)
-            depth_delta = seen.back().depth_delta;
-        child->m_depth += depth_delta;
-
         yasm::Symbol* sym;
         if (!(sym = child->getSymbol()))
         {
@@ -87,7 +162,11 @@ yasm::ExpandEqu(Expr& e)
 
         // Mark symbol as used if it wasn't already.
         if (!sym->isUsed())
-            sym->Use(child->getSource());
+        {
+            llvm::sys::ScopedLock lock(equ_lock);
+            if (!sym->isUsed())
+                sym->Use(child->getSource());
+        }
 
         // Only look at equ's.
         const Expr* equ;
@@ -97,22 +176,51 @@ yasm::ExpandEqu(Expr& e)
             continue;
         }
 
-        // Check for circular reference
-        if (std::find_if(seen.begin(), seen.end(), MatchSawEqu(sym))
-            != seen.end())
-            return false;
-
-        // Remember we saw this equ
-        SawEqu justsaw = {sym, child->m_depth, n};
-        seen.push_back(justsaw);
+        // Use the memoized expansion if there is one; otherwise expand the
+        // equ value (memoizing it if possible).  Either way the result
+        // contains no further equ's, so it doesn't need to be rescanned.
+        Expr expanded;
+        const Expr* value;
+        {
+            llvm::sys::ScopedLock lock(equ_lock);
+            value = sym->getExpandedEqu();
+            if (value)
+                ++num_equ_memo_hits;
+            else
+            {
+                if (!ExpandEquValue(sym, *equ, expanded, expanding))
+                    return false;
+                value = &expanded;
+            }
+            if (fold_constants && sym->getFoldedEqu())
+                value = sym->getFoldedEqu();
+        }
 
-        // Insert copy of equ value and empty current term.
-        terms.insert(terms.begin()+n, equ->getTerms().begin(),
-                     equ->getTerms().end());
-        n += equ->getTerms().size();
-        terms[n].Clear();
+        // Insert copy of expanded value and empty current term.  A single
+        // term value (e.g. a folded constant) simply replaces the current
+        // term, so long chains of equ's don't shift the terms after it.
+        int depth = child->m_depth;
+        const ExprTerms& vterms = value->getTerms();
+        if (vterms.size() == 1)
+        {
+            *child = vterms.front();
+            child->m_depth += depth;
+            --n;
+            continue;
+        }
+        terms.insert(terms.begin()+n, vterms.begin(), vterms.end());
+        for (int i=n, end=n+vterms.size(); i<end; ++i)
+            terms[i].m_depth += depth;
+        terms[n+vterms.size()].Clear();
         --n;
     }
     e.Cleanup();
     return true;
 }
+
+bool
+yasm::ExpandEqu(Expr& e, bool fold_constants)
+{
+    SmallVector<Symbol*, 8> expanding;
+    return ExpandEquImpl(e, fold_constants, expanding);
+}
@@ -61,6 +61,13 @@ static void applyTemplateHighlighting(raw_ostream &OS, StringRef Str,
 /// \brief Number of spaces to indent when word-wrapping.
 const unsigned WordWrapIndentation = 6;
 
+/// \brief Whether a byte is a printable ASCII character, which displays as
+/// itself in one column.  Source lines are mostly made of these, so they are
+/// handled without going through printableTextForNextCharacter().
+static inline bool isPrintableASCII(char c) {
+  return c >= 0x20 && c < 0x7f;
+}
+
 static int bytesSincePreviousTabOrLineBegin(StringRef SourceLine, size_t i) {
   int bytes = 0;
   while (0<i) {
@@ -217,6 +224,11 @@ static void byteToColumn(StringRef SourceLine, unsigned TabStop,
   size_t i = 0;
   while (i<SourceLine.size()) {
     out[i] = columns;
+    if (isPrintableASCII(SourceLine[i])) {
+      ++i;
+      ++columns;
+      continue;
+    }
     std::pair<SmallString<16>,bool> res
       = printableTextForNextCharacter(SourceLine, &i, TabStop);
     columns += llvm::sys::locale::columnWidth(res.first);
@@ -250,6 +262,11 @@ static void columnToByte(StringRef SourceLine, unsigned TabStop,
   while (i<SourceLine.size()) {
     out.resize(columns+1, -1);
     out.back() = i;
+    if (isPrintableASCII(SourceLine[i])) {
+      ++i;
+      ++columns;
+      continue;
+    }
     std::pair<SmallString<16>,bool> res
       = printableTextForNextCharacter(SourceLine, &i, TabStop);
     columns += llvm::sys::locale::columnWidth(res.first);
@@ -651,7 +668,7 @@ static bool printWordWrapped(raw_ostream &OS, StringRef Str,
 
 TextDiagnostic::TextDiagnostic(raw_ostream &OS,
                                const DiagnosticOptions &DiagOpts)
-  : DiagnosticRenderer(DiagOpts), OS(OS) {}
+  : DiagnosticRenderer(DiagOpts), OS(OS), LastLineStart(0) {}
 
 TextDiagnostic::~TextDiagnostic() {}
 
@@ -909,21 +926,28 @@ void TextDiagnostic::emitSnippetAndCaret(
   const char *TokPtr = BufStart+FileOffset;
   const char *LineStart = TokPtr-ColNo+1; // Column # is 1-based.
 
-
-  // Compute the line end.  Scan forward from the error position to the end of
-  // the line.
-  const char *LineEnd = TokPtr;
-  while (*LineEnd != '\n' && *LineEnd != '\r' && *LineEnd != '\0')
-    ++LineEnd;
+  // Reuse the last line if this diagnostic is on it.
+  if (!LastLineMap || LastLineFID != FID || LastLineStart != LineStart) {
+    // Compute the line end.  Scan forward from the error position to the end
+    // of the line.
+    const char *LineEnd = TokPtr;
+    while (*LineEnd != '\n' && *LineEnd != '\r' && *LineEnd != '\0')
+      ++LineEnd;
+
+    LastLineMap.reset(new SourceColumnMap(StringRef(LineStart,
+                                                    LineEnd-LineStart),
+                                          DiagOpts.TabStop));
+    LastLineFID = FID;
+    LastLineStart = LineStart;
+  }
+  const SourceColumnMap &sourceColMap = *LastLineMap;
 
   // Copy the line of code into an std::string for ease of manipulation.
-  std::string SourceLine(LineStart, LineEnd);
+  std::string SourceLine = sourceColMap.getSourceLine();
 
   // Create a line for the caret that is filled with spaces that is the same
   // length as the line of source code.
-  std::string CaretLine(LineEnd-LineStart, ' ');
-
-  const SourceColumnMap sourceColMap(SourceLine, DiagOpts.TabStop);
+  std::string CaretLine(SourceLine.size(), ' ');
 
   // Highlight all of the characters covered by Ranges with ~ characters.
   for (SmallVectorImpl<CharSourceRange>::iterator I = Ranges.begin(),
@@ -995,9 +1019,22 @@ void TextDiagnostic::emitSnippet(StringRef line) {
   bool print_reversed = false;
   
   while (i<line.size()) {
-    std::pair<SmallString<16>,bool> res
-        = printableTextForNextCharacter(line, &i, DiagOpts.TabStop);
-    bool was_printable = res.second;
+    std::pair<SmallString<16>,bool> res;
+    StringRef text;
+    bool was_printable;
+    if (isPrintableASCII(line[i])) {
+      // Take the whole run of printable ASCII at once.
+      size_t end = i+1;
+      while (end<line.size() && isPrintableASCII(line[end]))
+        ++end;
+      text = line.slice(i, end);
+      was_printable = true;
+      i = end;
+    } else {
+      res = printableTextForNextCharacter(line, &i, DiagOpts.TabStop);
+      text = res.first.str();
+      was_printable = res.second;
+    }
     
     if (DiagOpts.ShowColors && was_printable == print_reversed) {
       if (print_reversed)
@@ -1009,7 +1046,7 @@ void TextDiagnostic::emitSnippet(StringRef line) {
     }
     
     print_reversed = !was_printable;
-    to_print += res.first.str();
+    to_print += text;
   }
   
   if (print_reversed && DiagOpts.ShowColors)
@@ -28,7 +28,7 @@ TextDiagnosticPrinter::TextDiagnosticPrinter(raw_ostream &os,
                                              const DiagnosticOptions &diags,
                                              bool _OwnsOutputStream)
   : OS(os), DiagOpts(&diags),
-    OwnsOutputStream(_OwnsOutputStream) {
+    OwnsOutputStream(_OwnsOutputStream), SuppressingNotes(false) {
 }
 
 TextDiagnosticPrinter::~TextDiagnosticPrinter() {
@@ -45,6 +45,35 @@ void TextDiagnosticPrinter::EndSourceFile() {
   TextDiag.reset(0);
 }
 
+void TextDiagnosticPrinter::finish() {
+  for (std::vector<std::pair<unsigned, std::string> >::const_iterator
+       I = Suppressed.begin(), E = Suppressed.end(); I != E; ++I) {
+    SmallString<100> OutStr;
+    llvm::raw_svector_ostream MessageStream(OutStr);
+    MessageStream << (RepeatCounts[I->first] - DiagOpts->RepeatLimit)
+                  << " more diagnostics like '" << I->second
+                  << "' suppressed";
+    StringRef Opt = DiagnosticIDs::getWarningOptionForDiag(I->first);
+    if (!Opt.empty())
+      MessageStream << " [-W" << Opt << ']';
+
+    uint64_t StartOfLocationInfo = OS.tell();
+    if (!Prefix.empty())
+      OS << Prefix << ": ";
+    TextDiagnostic::printDiagnosticLevel(OS, DiagnosticsEngine::Note,
+                                         DiagOpts->ShowColors);
+    TextDiagnostic::printDiagnosticMessage(OS, DiagnosticsEngine::Note,
+                                           MessageStream.str(),
+                                           OS.tell() - StartOfLocationInfo,
+                                           DiagOpts->MessageLength,
+                                           DiagOpts->ShowColors);
+  }
+  Suppressed.clear();
+  RepeatCounts.clear();
+  SuppressingNotes = false;
+  OS.flush();
+}
+
 /// \brief Print any diagnostic option information to a raw_ostream.
 ///
 /// This implements all of the logic for adding diagnostic options to a message
@@ -109,6 +138,29 @@ void TextDiagnosticPrinter::HandleDiagnostic(DiagnosticsEngine::Level Level,
   // Default implementation (Warnings/errors count).
   DiagnosticConsumer::HandleDiagnostic(Level, Info);
 
+  // Past the repeat limit, a diagnostic (and its notes) is only counted.
+  // Fatal errors are always shown as they end assembly.
+  if (DiagOpts->RepeatLimit != 0) {
+    if (Level == DiagnosticsEngine::Note) {
+      if (SuppressingNotes)
+        return;
+    } else if (Level == DiagnosticsEngine::Fatal) {
+      SuppressingNotes = false;
+    } else {
+      unsigned &Count = RepeatCounts[Info.getID()];
+      SuppressingNotes = ++Count > DiagOpts->RepeatLimit;
+      if (SuppressingNotes) {
+        if (Count == DiagOpts->RepeatLimit+1) {
+          SmallString<100> Message;
+          Info.FormatDiagnostic(Message);
+          Suppressed.push_back(std::make_pair(Info.getID(),
+                                              std::string(Message.str())));
+        }
+        return;
+      }
+    }
+  }
+
   // Render the diagnostic message into a temporary buffer eagerly. We'll use
   // this later as we print out the diagnostic to the terminal.
   SmallString<100> OutStr;
@@ -136,7 +188,8 @@ void TextDiagnosticPrinter::HandleDiagnostic(DiagnosticsEngine::Level Level,
                                            OS.tell() - StartOfLocationInfo,
                                            DiagOpts->MessageLength,
                                            DiagOpts->ShowColors);
-    OS.flush();
+    if (Level == DiagnosticsEngine::Fatal)
+      OS.flush();
     return;
   }
 
@@ -152,7 +205,10 @@ void TextDiagnosticPrinter::HandleDiagnostic(DiagnosticsEngine::Level Level,
                                               Info.getNumFixItHints()),
                            &Info.getSourceManager());
 
-  OS.flush();
+  // Leave it to the output stream's buffering to batch up floods of
+  // warnings and errors; make sure a fatal error is out before exiting.
+  if (Level == DiagnosticsEngine::Fatal)
+    OS.flush();
 }
 
 DiagnosticConsumer *
@@ -35,6 +35,8 @@
 #include "yasmx/Bytes.h"
 #include "yasmx/Expr.h"
 #include "yasmx/IntNum.h"
+#include "yasmx/Object.h"
+#include "yasmx/Section.h"
 #include "yasmx/Value.h"
 
 
@@ -54,7 +56,7 @@ public:
 
     /// Calculates the minimum size of a bytecode.
     bool CalcLen(Bytecode& bc,
-                 /*@out@*/ unsigned long* len,
+                 /*@out@*/ uint64_t* len,
                  const Bytecode::AddSpanFunc& add_span,
                  DiagnosticsEngine& diags);
 
@@ -99,7 +101,11 @@ IncbinBytecode::~IncbinBytecode()
 bool
 IncbinBytecode::Finalize(Bytecode& bc, DiagnosticsEngine& diags)
 {
-    if (llvm::error_code err = MemoryBuffer::getFile(m_filename, m_buf))
+    // The contents are only ever copied to the output, so don't require a
+    // null terminator; this lets large files always be memory mapped
+    // rather than read onto the heap.
+    if (llvm::error_code err =
+        MemoryBuffer::getFile(m_filename, m_buf, -1, false))
     {
         diags.Report(bc.getSource(), diag::err_file_read) << m_filename
             << err.message();
@@ -136,17 +142,17 @@ IncbinBytecode::Finalize(Bytecode& bc, DiagnosticsEngine& diags)
 
 bool
 IncbinBytecode::CalcLen(Bytecode& bc,
-                        /*@out@*/ unsigned long* len,
+                        /*@out@*/ uint64_t* len,
                         const Bytecode::AddSpanFunc& add_span,
                         DiagnosticsEngine& diags)
 {
-    unsigned long start = 0, maxlen = 0xFFFFFFFFUL;
+    uint64_t start = 0, maxlen = UINT64_MAX;
 
     // Try to convert start to integer value
     if (m_start)
     {
         if (m_start->isIntNum())
-            start = m_start->getIntNum().getUInt();
+            start = m_start->getIntNum().getUInt64();
         else
         {
             // FIXME
@@ -159,7 +165,7 @@ IncbinBytecode::CalcLen(Bytecode& bc,
     if (m_maxlen)
     {
         if (m_maxlen->isIntNum())
-            maxlen = m_maxlen->getIntNum().getUInt();
+            maxlen = m_maxlen->getIntNum().getUInt64();
         else
         {
             // FIXME
@@ -169,7 +175,7 @@ IncbinBytecode::CalcLen(Bytecode& bc,
     }
 
     // Compute length of incbin from start, maxlen, and len
-    unsigned long flen = m_buf->getBufferSize();
+    uint64_t flen = m_buf->getBufferSize();
     if (start > flen)
     {
         diags.Report(bc.getSource(), diag::warn_incbin_start_after_eof);
@@ -188,20 +194,19 @@ IncbinBytecode::CalcLen(Bytecode& bc,
 bool
 IncbinBytecode::Output(Bytecode& bc, BytecodeOutput& bc_out)
 {
-    unsigned long start = 0;
+    uint64_t start = 0;
 
     // Convert start to integer value
     if (m_start)
     {
         assert(m_start->isIntNum()
                && "could not determine start in incbin::output");
-        start = m_start->getIntNum().getUInt();
+        start = m_start->getIntNum().getUInt64();
     }
 
-    // Copy len bytes
-    Bytes& bytes = bc_out.getScratch();
-    bytes.WriteString(m_buf->getBuffer().substr(start, bc.getTailLen()));
-    bc_out.OutputBytes(bytes, bc.getSource());
+    // Output len bytes directly from the file buffer
+    bc_out.OutputRaw(m_buf->getBuffer().substr(start, bc.getTailLen()),
+                     bc.getSource());
     return true;
 }
 
@@ -244,4 +249,11 @@ yasm::AppendIncbin(BytecodeContainer& container,
     bc.Transform(Bytecode::Contents::Ptr(
         new IncbinBytecode(filename, start, maxlen)));
     bc.setSource(source);
+
+    // Record the file so the frontend knows the output depends on it.
+    if (Section* sect = container.getSection())
+    {
+        if (Object* object = sect->getObject())
+            object->AddInputFile(filename);
+    }
 }
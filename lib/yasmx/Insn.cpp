@@ -31,6 +31,7 @@
 #include "yasmx/Basic/Diagnostic.h"
 #include "yasmx/Config/functional.h"
 #include "yasmx/Arch.h"
+#include "yasmx/BytecodeContainer.h"
 #include "yasmx/EffAddr.h"
 #include "yasmx/Expr.h"
 #include "yasmx/Expr_util.h"
@@ -92,6 +93,27 @@ Operand::Operand(std::auto_ptr<Expr> val)
         m_val = val.release();
 }
 
+Operand::Operand(Expr& val)
+    : m_seg(0),
+      m_targetmod(0),
+      m_size(0),
+      m_deref(0),
+      m_strict(0),
+      m_type(IMM)
+{
+    if (val.isRegister())
+    {
+        m_type = REG;
+        m_reg = val.getRegister();
+        val.Clear();
+    }
+    else
+    {
+        m_val = new Expr;
+        m_val->swap(val);
+    }
+}
+
 void
 Operand::Destroy()
 {
@@ -146,7 +168,7 @@ Operand::Finalize(DiagnosticsEngine& diags)
                 break;
             if (Expr* abs = m_ea->m_disp.getAbs())
             {
-                if (!ExpandEqu(*abs))
+                if (!ExpandEqu(*abs, true))
                 {
                     diags.Report(m_source, diag::err_equ_circular_reference_mem);
                     return false;
@@ -159,7 +181,7 @@ Operand::Finalize(DiagnosticsEngine& diags)
             }
             break;
         case IMM:
-            if (!ExpandEqu(*m_val))
+            if (!ExpandEqu(*m_val, true))
             {
                 diags.Report(m_source, diag::err_equ_circular_reference_imm);
                 return false;
@@ -278,6 +300,17 @@ Insn::~Insn()
                   TR1::mem_fn(&Operand::Destroy));
 }
 
+void
+Insn::Clear()
+{
+    std::for_each(m_operands.begin(), m_operands.end(),
+                  TR1::mem_fn(&Operand::Destroy));
+    m_operands.clear();
+    m_prefixes.clear();
+    m_segreg = 0;
+    m_segreg_source = SourceLocation();
+}
+
 bool
 Insn::Append(BytecodeContainer& container,
              SourceLocation source,
@@ -293,6 +326,7 @@ Insn::Append(BytecodeContainer& container,
     }
     if (!ok)
         return false;
+    container.MarkInsn();
     return DoAppend(container, source, diags);
 }
 
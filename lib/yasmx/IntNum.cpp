@@ -26,6 +26,8 @@
 //
 #include "yasmx/IntNum.h"
 
+#include "config.h"
+
 #include <cctype>
 #include <climits>
 #include <cstdio>
@@ -36,30 +38,63 @@
 #include "llvm/ADT/SmallString.h"
 #include "llvm/Support/raw_ostream.h"
 #include "yasmx/Basic/Diagnostic.h"
+#include "yasmx/Support/HexFormat.h"
+#include "yasmx/Support/MemoryStats.h"
 
 
 using namespace yasm;
 using llvm::APInt;
 
-/// Static bitvect used for conversions.
-static APInt conv_bv(IntNum::BITVECT_NATIVE_SIZE, 0);
-
-/// Static bitvects used for computation.
-static APInt result(IntNum::BITVECT_NATIVE_SIZE, 0);
-static APInt spare(IntNum::BITVECT_NATIVE_SIZE, 0);
-static APInt op1static(IntNum::BITVECT_NATIVE_SIZE, 0);
-static APInt op2static(IntNum::BITVECT_NATIVE_SIZE, 0);
-
-/// Static bitvect used for sign extension.
-static APInt signext_bv(IntNum::BITVECT_NATIVE_SIZE, 0);
-
 enum
 {
     SV_BITS = std::numeric_limits<IntNumData::SmallValue>::digits,
+    DV_BITS = 128,
     LONG_BITS = std::numeric_limits<long>::digits,
     ULONG_BITS = std::numeric_limits<unsigned long>::digits
 };
 
+#ifdef HAVE_INT128_OVERFLOW_BUILTINS
+typedef __int128 DoubleValue;
+typedef unsigned __int128 UDoubleValue;
+
+static const DoubleValue DV_MAX =
+    static_cast<DoubleValue>(~static_cast<UDoubleValue>(0) >> 1);
+static const DoubleValue DV_MIN = -DV_MAX - 1;
+
+/// Get the value of a small or double-width intnum as a DoubleValue.
+static inline DoubleValue
+getDoubleValue(const IntNumData& intn)
+{
+    if (intn.m_type == IntNumData::INTNUM_SV)
+        return intn.m_val.sv;
+    return static_cast<DoubleValue>(
+        (static_cast<UDoubleValue>(static_cast<uint64_t>(intn.m_val.dv.hi))
+         << 64) | intn.m_val.dv.lo);
+}
+#endif
+
+/// Sign extend a double-width value into words of a full bitvector.
+static inline void
+DVToWords(uint64_t words[IntNum::BITVECT_NATIVE_SIZE/64],
+          uint64_t lo,
+          int64_t hi)
+{
+    uint64_t sign = hi < 0 ? ~static_cast<uint64_t>(0) : 0;
+    words[0] = lo;
+    words[1] = static_cast<uint64_t>(hi);
+    for (unsigned int i=2; i<IntNum::BITVECT_NATIVE_SIZE/64; ++i)
+        words[i] = sign;
+}
+
+/// Convert a double-width value into a bitvector.
+static inline void
+DVToBV(APInt* bv, uint64_t lo, int64_t hi)
+{
+    uint64_t words[IntNum::BITVECT_NATIVE_SIZE/64];
+    DVToWords(words, lo, hi);
+    *bv = APInt(IntNum::BITVECT_NATIVE_SIZE, words);
+}
+
 bool
 yasm::isOkSize(const APInt& intn,
                unsigned int size,
@@ -88,17 +123,47 @@ yasm::isOkSize(const APInt& intn,
     return (intn_size <= (size-rshift));
 }
 
+// Bitvectors are kept at the native size, so count them at that size.
+static const std::size_t BV_ALLOC_SIZE =
+    sizeof(APInt) + IntNum::BITVECT_NATIVE_SIZE/8;
+
+APInt*
+IntNum::NewBV(const APInt& bv)
+{
+    CountAlloc(MEM_INTNUM, BV_ALLOC_SIZE);
+    return new APInt(bv);
+}
+
+void
+IntNum::DeleteBV(APInt* bv)
+{
+    CountFree(MEM_INTNUM, BV_ALLOC_SIZE);
+    delete bv;
+}
+
 void
 IntNum::setBV(const APInt& bv)
 {
-    if (bv.getMinSignedBits() <= SV_BITS)
+    unsigned int minbits = bv.getMinSignedBits();
+    if (minbits <= SV_BITS)
     {
         if (m_type == INTNUM_BV)
-            delete m_val.bv;
+            DeleteBV(m_val.bv);
         m_type = INTNUM_SV;
         m_val.sv = static_cast<SmallValue>(bv.getSExtValue());
         return;
     }
+    else if (minbits <= DV_BITS)
+    {
+        if (m_type == INTNUM_BV)
+            DeleteBV(m_val.bv);
+        m_type = INTNUM_DV;
+        m_val.dv.lo = bv.getRawData()[0];
+        m_val.dv.hi = static_cast<int64_t>(
+            bv.getBitWidth() > 64 ? bv.getRawData()[1]
+                                  : (bv.isNegative() ? ~0ULL : 0));
+        return;
+    }
     else if (m_type == INTNUM_BV)
     {
         *m_val.bv = bv;
@@ -106,7 +171,7 @@ IntNum::setBV(const APInt& bv)
     else
     {
         m_type = INTNUM_BV;
-        m_val.bv = new APInt(bv);
+        m_val.bv = NewBV(bv);
     }
     *m_val.bv = m_val.bv->sextOrTrunc(BITVECT_NATIVE_SIZE);
 }
@@ -117,6 +182,12 @@ IntNum::getBV(APInt* bv) const
     if (m_type == INTNUM_BV)
         return m_val.bv;
 
+    if (m_type == INTNUM_DV)
+    {
+        DVToBV(bv, m_val.dv.lo, m_val.dv.hi);
+        return bv;
+    }
+
     if (m_val.sv >= 0)
         *bv = static_cast<USmallValue>(m_val.sv);
     else
@@ -133,6 +204,12 @@ IntNum::getBV(APInt* bv)
     if (m_type == INTNUM_BV)
         return m_val.bv;
 
+    if (m_type == INTNUM_DV)
+    {
+        DVToBV(bv, m_val.dv.lo, m_val.dv.hi);
+        return bv;
+    }
+
     if (m_val.sv >= 0)
         *bv = static_cast<USmallValue>(m_val.sv);
     else
@@ -203,18 +280,15 @@ IntNum::setStr(StringRef str, unsigned int radix)
     }
 
     // long case
-    conv_bv = 0;
+    APInt conv_bv(BITVECT_NATIVE_SIZE, 0);
 
     // Figure out if we can shift instead of multiply
     unsigned int shift =
         (radix == 16 ? 4 : radix == 8 ? 3 : radix == 2 ? 1 : 0);
 
-    APInt& radixval = op1static;
-    APInt& charval = op2static;
-    APInt& oldval = spare;
-
-    radixval = radix;
-    oldval = 0;
+    APInt radixval(BITVECT_NATIVE_SIZE, radix);
+    APInt charval(BITVECT_NATIVE_SIZE, 0);
+    APInt oldval(BITVECT_NATIVE_SIZE, 0);
 
     bool overflowed = false;
     for (StringRef::iterator i=begin, end=str.end(); i != end; ++i)
@@ -258,9 +332,30 @@ IntNum::IntNum(const IntNum& rhs)
 {
     m_type = rhs.m_type;
     if (rhs.m_type == INTNUM_BV)
-        m_val.bv = new APInt(*rhs.m_val.bv);
+        m_val.bv = NewBV(*rhs.m_val.bv);
     else
-        m_val.sv = rhs.m_val.sv;
+        m_val = rhs.m_val;
+}
+
+void
+IntNum::setDV(uint64_t lo, int64_t hi)
+{
+    if (m_type == INTNUM_BV)
+        DeleteBV(m_val.bv);
+
+    // Same small value range as setBV().
+    int64_t v = static_cast<int64_t>(lo);
+    if (hi == (v < 0 ? -1 : 0) &&
+        v >= -(static_cast<int64_t>(1) << (SV_BITS-1)) &&
+        v < (static_cast<int64_t>(1) << (SV_BITS-1)))
+    {
+        m_type = INTNUM_SV;
+        m_val.sv = static_cast<SmallValue>(v);
+        return;
+    }
+    m_type = INTNUM_DV;
+    m_val.dv.lo = lo;
+    m_val.dv.hi = hi;
 }
 
 // Speedup function for non-bitvect calculations.
@@ -282,6 +377,32 @@ CalcSmallValue(bool* handled,
     *handled = false;
     switch (op)
     {
+#ifdef HAVE_INT128_OVERFLOW_BUILTINS
+        case Op::ADD:
+        {
+            IntNumData::SmallValue result;
+            if (__builtin_add_overflow(*lhs, rhs, &result))
+                return true;
+            *lhs = result;
+            break;
+        }
+        case Op::SUB:
+        {
+            IntNumData::SmallValue result;
+            if (__builtin_sub_overflow(*lhs, rhs, &result))
+                return true;
+            *lhs = result;
+            break;
+        }
+        case Op::MUL:
+        {
+            IntNumData::SmallValue result;
+            if (__builtin_mul_overflow(*lhs, rhs, &result))
+                return true;
+            *lhs = result;
+            break;
+        }
+#else
         case Op::ADD:
             if (*lhs >= SV_MAX/2 || *lhs <= SV_MIN/2 ||
                 rhs >= SV_MAX/2 || rhs <= SV_MIN/2)
@@ -309,6 +430,7 @@ CalcSmallValue(bool* handled,
             // maybe someday?
             return true;
         }
+#endif
         case Op::DIV:
             // TODO: make sure lhs and rhs are unsigned
         case Op::SIGNDIV:
@@ -403,6 +525,161 @@ CalcSmallValue(bool* handled,
     return true;
 }
 
+#ifdef HAVE_INT128_OVERFLOW_BUILTINS
+// Speedup function for double-width calculations, so values up to 128 bits
+// never need a heap-allocated bitvector.  Like CalcSmallValue(), this is
+// conservative: anything that would not produce exactly the same result as
+// the full bitvector calculation (overflow, unsigned division of negative
+// values, errors) is left unhandled.
+static void
+CalcDoubleValue(bool* handled,
+                Op::Op op,
+                DoubleValue* lhs,
+                DoubleValue rhs,
+                bool rhs_small)
+{
+    *handled = false;
+    switch (op)
+    {
+        case Op::ADD:
+        {
+            DoubleValue result;
+            if (__builtin_add_overflow(*lhs, rhs, &result))
+                return;
+            *lhs = result;
+            break;
+        }
+        case Op::SUB:
+        {
+            DoubleValue result;
+            if (__builtin_sub_overflow(*lhs, rhs, &result))
+                return;
+            *lhs = result;
+            break;
+        }
+        case Op::MUL:
+        {
+            DoubleValue result;
+            if (__builtin_mul_overflow(*lhs, rhs, &result))
+                return;
+            *lhs = result;
+            break;
+        }
+        case Op::DIV:
+            if (*lhs < 0 || rhs <= 0)
+                return;
+            *lhs /= rhs;
+            break;
+        case Op::SIGNDIV:
+            if (rhs == 0 || (*lhs == DV_MIN && rhs == -1))
+                return;
+            *lhs /= rhs;
+            break;
+        case Op::MOD:
+            if (*lhs < 0 || rhs <= 0)
+                return;
+            *lhs %= rhs;
+            break;
+        case Op::SIGNMOD:
+            if (rhs == 0 || (*lhs == DV_MIN && rhs == -1))
+                return;
+            *lhs %= rhs;
+            break;
+        case Op::NEG:
+            if (*lhs == DV_MIN)
+                return;
+            *lhs = -(*lhs);
+            break;
+        case Op::NOT:
+            *lhs = ~(*lhs);
+            break;
+        case Op::OR:
+            *lhs |= rhs;
+            break;
+        case Op::AND:
+            *lhs &= rhs;
+            break;
+        case Op::XOR:
+            *lhs ^= rhs;
+            break;
+        case Op::XNOR:
+            *lhs = ~(*lhs ^ rhs);
+            break;
+        case Op::NOR:
+            *lhs = ~(*lhs | rhs);
+            break;
+        case Op::SHL:
+        case Op::SHR:
+        {
+            // Bitvector shifts by a non-small value zero the result.
+            if (!rhs_small)
+                return;
+            // Normalize to a left shift (positive) or right shift (negative).
+            DoubleValue amount = (op == Op::SHL) ? rhs : -rhs;
+            if (amount >= 0)
+            {
+                if (amount >= DV_BITS)
+                    return;
+                UDoubleValue shifted = static_cast<UDoubleValue>(*lhs)
+                    << static_cast<unsigned int>(amount);
+                DoubleValue result = static_cast<DoubleValue>(shifted);
+                if ((result >> static_cast<unsigned int>(amount)) != *lhs)
+                    return;     // bits shifted out
+                *lhs = result;
+            }
+            else
+            {
+                if (amount < -(DV_BITS-1))
+                    amount = -(DV_BITS-1);
+                *lhs >>= static_cast<unsigned int>(-amount);
+            }
+            break;
+        }
+        case Op::LOR:
+            *lhs = (*lhs || rhs);
+            break;
+        case Op::LAND:
+            *lhs = (*lhs && rhs);
+            break;
+        case Op::LNOT:
+            *lhs = !*lhs;
+            break;
+        case Op::LXOR:
+            *lhs = (!!(*lhs) ^ !!rhs);
+            break;
+        case Op::LXNOR:
+            *lhs = !(!!(*lhs) ^ !!rhs);
+            break;
+        case Op::LNOR:
+            *lhs = !(*lhs || rhs);
+            break;
+        case Op::EQ:
+            *lhs = (*lhs == rhs);
+            break;
+        case Op::LT:
+            *lhs = (*lhs < rhs);
+            break;
+        case Op::GT:
+            *lhs = (*lhs > rhs);
+            break;
+        case Op::LE:
+            *lhs = (*lhs <= rhs);
+            break;
+        case Op::GE:
+            *lhs = (*lhs >= rhs);
+            break;
+        case Op::NE:
+            *lhs = (*lhs != rhs);
+            break;
+        case Op::IDENT:
+            break;
+        default:
+            return;
+    }
+    *handled = true;
+}
+#endif
+
 /*@-nullderef -nullpass -branchstate@*/
 bool
 IntNum::CalcImpl(Op::Op op,
@@ -423,12 +700,33 @@ IntNum::CalcImpl(Op::Op op,
             return true;
     }
 
+#ifdef HAVE_INT128_OVERFLOW_BUILTINS
+    if (m_type != INTNUM_BV && (!operand || operand->m_type != INTNUM_BV))
+    {
+        DoubleValue lhs = getDoubleValue(*this);
+        bool handled = false;
+        CalcDoubleValue(&handled, op, &lhs,
+                        operand ? getDoubleValue(*operand) : 0,
+                        !operand || operand->m_type == INTNUM_SV);
+        if (handled)
+        {
+            setDV(static_cast<uint64_t>(lhs),
+                  static_cast<int64_t>(static_cast<UDoubleValue>(lhs) >> 64));
+            return true;
+        }
+    }
+#endif
+
     // Always do computations with in full bit vector.
     // Bit vector results must be calculated through intermediate storage.
-    const APInt* op1 = getBV(&op1static);
+    // This storage is local (rather than static) as computations may be
+    // performed concurrently, e.g. by the optimizer.
+    APInt op1bv(BITVECT_NATIVE_SIZE, 0), op2bv(BITVECT_NATIVE_SIZE, 0);
+    APInt result(BITVECT_NATIVE_SIZE, 0);
+    const APInt* op1 = getBV(&op1bv);
     const APInt* op2 = 0;
     if (operand)
-        op2 = operand->getBV(&op2static);
+        op2 = operand->getBV(&op2bv);
 
     // A operation does a bitvector computation if result is allocated.
     switch (op)
@@ -604,7 +902,20 @@ IntNum::CalcImpl(Op::Op op,
 void
 IntNum::SignExtend(unsigned int size)
 {
-    // For now, always implement with full bit vector.
+#ifdef HAVE_INT128_OVERFLOW_BUILTINS
+    if (m_type != INTNUM_BV && size > 0 && size <= DV_BITS)
+    {
+        unsigned int shift = DV_BITS - size;
+        DoubleValue v = static_cast<DoubleValue>(
+            static_cast<UDoubleValue>(getDoubleValue(*this)) << shift);
+        v >>= shift;
+        setDV(static_cast<uint64_t>(v),
+              static_cast<int64_t>(static_cast<UDoubleValue>(v) >> 64));
+        return;
+    }
+#endif
+    // Otherwise implement with full bit vector.
+    APInt signext_bv(BITVECT_NATIVE_SIZE, 0);
     APInt* bv = getBV(&signext_bv);
     *bv = bv->trunc(size).sext(BITVECT_NATIVE_SIZE);
     setBV(*bv);
@@ -616,20 +927,16 @@ IntNum::set(IntNum::USmallValue val)
     if (val > static_cast<USmallValue>(std::numeric_limits<SmallValue>::max()))
     {
         if (m_type == INTNUM_BV)
-            *m_val.bv = val;
-        else
-        {
-            m_val.bv = new APInt(BITVECT_NATIVE_SIZE, val);
-            m_type = INTNUM_BV;
-        }
+            DeleteBV(m_val.bv);
+        m_type = INTNUM_DV;
+        m_val.dv.lo = val;
+        m_val.dv.hi = 0;
     }
     else
     {
         if (m_type == INTNUM_BV)
-        {
-            delete m_val.bv;
-            m_type = INTNUM_SV;
-        }
+            DeleteBV(m_val.bv);
+        m_type = INTNUM_SV;
         m_val.sv = static_cast<SmallValue>(val);
     }
 }
@@ -646,6 +953,8 @@ IntNum::getSign() const
         else
             return 1;
     }
+    else if (m_type == INTNUM_DV)
+        return m_val.dv.hi < 0 ? -1 : 1;
     else if (m_val.bv->isNegative())
         return -1;
     else
@@ -662,6 +971,15 @@ IntNum::getUInt() const
         return static_cast<unsigned long>(m_val.sv);
     }
 
+    if (m_type == INTNUM_DV)
+    {
+        if (m_val.dv.hi < 0)
+            return 0;
+        if (m_val.dv.hi != 0 || m_val.dv.lo > ULONG_MAX)
+            return ULONG_MAX;
+        return static_cast<unsigned long>(m_val.dv.lo);
+    }
+
     // Handle bigval
     if (m_val.bv->isNegative())
         return 0;
@@ -670,6 +988,33 @@ IntNum::getUInt() const
     return static_cast<unsigned long>(m_val.bv->getZExtValue());
 }
 
+uint64_t
+IntNum::getUInt64() const
+{
+    if (m_type == INTNUM_SV)
+    {
+        if (m_val.sv < 0)
+            return 0;
+        return static_cast<uint64_t>(m_val.sv);
+    }
+
+    if (m_type == INTNUM_DV)
+    {
+        if (m_val.dv.hi < 0)
+            return 0;
+        if (m_val.dv.hi != 0)
+            return UINT64_MAX;
+        return m_val.dv.lo;
+    }
+
+    // Handle bigval
+    if (m_val.bv->isNegative())
+        return 0;
+    if (m_val.bv->getActiveBits() > 64)
+        return UINT64_MAX;
+    return m_val.bv->getZExtValue();
+}
+
 long
 IntNum::getInt() const
 {
@@ -682,12 +1027,35 @@ IntNum::getInt() const
         return m_val.sv;
     }
 
-    // since it's a BV, it must be >0x7FFFFFFF or <0x80000000
-    if (m_val.bv->isNegative())
+    // since it's a DV or BV, it must be >0x7FFFFFFF or <0x80000000
+    if (getSign() < 0)
         return LONG_MIN;
     return LONG_MAX;
 }
 
+int64_t
+IntNum::getInt64() const
+{
+    if (m_type == INTNUM_SV)
+        return m_val.sv;
+
+    if (m_type == INTNUM_DV)
+    {
+        if (m_val.dv.hi == 0 &&
+            m_val.dv.lo <= static_cast<uint64_t>(INT64_MAX))
+            return static_cast<int64_t>(m_val.dv.lo);
+        if (m_val.dv.hi == -1 &&
+            m_val.dv.lo > static_cast<uint64_t>(INT64_MAX))
+            return static_cast<int64_t>(m_val.dv.lo);
+    }
+    else if (m_val.bv->getMinSignedBits() <= 64)
+        return m_val.bv->getSExtValue();
+
+    if (getSign() < 0)
+        return INT64_MIN;
+    return INT64_MAX;
+}
+
 bool
 IntNum::isInt() const
 {
@@ -748,6 +1116,7 @@ IntNum::isOkSize(unsigned int size, unsigned int rshift, int rangetype) const
                 return false;
         }
     }
+    APInt conv_bv(BITVECT_NATIVE_SIZE, 0);
     return yasm::isOkSize(*getBV(&conv_bv), size, rshift, rangetype);
 }
 
@@ -767,14 +1136,7 @@ IntNum::operator++()
         m_val.sv < std::numeric_limits<SmallValue>::max())
         ++m_val.sv;
     else
-    {
-        if (m_type == INTNUM_SV)
-        {
-            m_val.bv = getBV(new APInt(BITVECT_NATIVE_SIZE, 0));
-            m_type = INTNUM_BV;
-        }
-        ++(*m_val.bv);
-    }
+        CalcAssert(Op::ADD, IntNum(1));
     return *this;
 }
 
@@ -785,14 +1147,7 @@ IntNum::operator--()
         m_val.sv > std::numeric_limits<SmallValue>::min())
         --m_val.sv;
     else
-    {
-        if (m_type == INTNUM_SV)
-        {
-            m_val.bv = getBV(new APInt(BITVECT_NATIVE_SIZE, 0));
-            m_type = INTNUM_BV;
-        }
-        --(*m_val.bv);
-    }
+        CalcAssert(Op::SUB, IntNum(1));
     return *this;
 }
 
@@ -807,9 +1162,22 @@ yasm::Compare(const IntNum& lhs, const IntNum& rhs)
             return 1;
         return 0;
     }
+#ifdef HAVE_INT128_OVERFLOW_BUILTINS
+    if (lhs.m_type != IntNum::INTNUM_BV && rhs.m_type != IntNum::INTNUM_BV)
+    {
+        DoubleValue op1 = getDoubleValue(lhs), op2 = getDoubleValue(rhs);
+        if (op1 < op2)
+            return -1;
+        if (op1 > op2)
+            return 1;
+        return 0;
+    }
+#endif
 
-    const APInt* op1 = lhs.getBV(&op1static);
-    const APInt* op2 = rhs.getBV(&op2static);
+    APInt op1bv(IntNum::BITVECT_NATIVE_SIZE, 0);
+    APInt op2bv(IntNum::BITVECT_NATIVE_SIZE, 0);
+    const APInt* op1 = lhs.getBV(&op1bv);
+    const APInt* op2 = rhs.getBV(&op2bv);
     if (op1->slt(*op2))
         return -1;
     if (op1->sgt(*op2))
@@ -822,9 +1190,15 @@ yasm::operator==(const IntNum& lhs, const IntNum& rhs)
 {
     if (lhs.m_type == IntNum::INTNUM_SV && rhs.m_type == IntNum::INTNUM_SV)
         return lhs.m_val.sv == rhs.m_val.sv;
-
-    const APInt* op1 = lhs.getBV(&op1static);
-    const APInt* op2 = rhs.getBV(&op2static);
+#ifdef HAVE_INT128_OVERFLOW_BUILTINS
+    if (lhs.m_type != IntNum::INTNUM_BV && rhs.m_type != IntNum::INTNUM_BV)
+        return getDoubleValue(lhs) == getDoubleValue(rhs);
+#endif
+
+    APInt op1bv(IntNum::BITVECT_NATIVE_SIZE, 0);
+    APInt op2bv(IntNum::BITVECT_NATIVE_SIZE, 0);
+    const APInt* op1 = lhs.getBV(&op1bv);
+    const APInt* op2 = rhs.getBV(&op2bv);
     return op1->eq(*op2);
 }
 
@@ -833,9 +1207,15 @@ yasm::operator<(const IntNum& lhs, const IntNum& rhs)
 {
     if (lhs.m_type == IntNum::INTNUM_SV && rhs.m_type == IntNum::INTNUM_SV)
         return lhs.m_val.sv < rhs.m_val.sv;
-
-    const APInt* op1 = lhs.getBV(&op1static);
-    const APInt* op2 = rhs.getBV(&op2static);
+#ifdef HAVE_INT128_OVERFLOW_BUILTINS
+    if (lhs.m_type != IntNum::INTNUM_BV && rhs.m_type != IntNum::INTNUM_BV)
+        return getDoubleValue(lhs) < getDoubleValue(rhs);
+#endif
+
+    APInt op1bv(IntNum::BITVECT_NATIVE_SIZE, 0);
+    APInt op2bv(IntNum::BITVECT_NATIVE_SIZE, 0);
+    const APInt* op1 = lhs.getBV(&op1bv);
+    const APInt* op2 = rhs.getBV(&op2bv);
     return op1->slt(*op2);
 }
 
@@ -844,19 +1224,26 @@ yasm::operator>(const IntNum& lhs, const IntNum& rhs)
 {
     if (lhs.m_type == IntNum::INTNUM_SV && rhs.m_type == IntNum::INTNUM_SV)
         return lhs.m_val.sv > rhs.m_val.sv;
-
-    const APInt* op1 = lhs.getBV(&op1static);
-    const APInt* op2 = rhs.getBV(&op2static);
+#ifdef HAVE_INT128_OVERFLOW_BUILTINS
+    if (lhs.m_type != IntNum::INTNUM_BV && rhs.m_type != IntNum::INTNUM_BV)
+        return getDoubleValue(lhs) > getDoubleValue(rhs);
+#endif
+
+    APInt op1bv(IntNum::BITVECT_NATIVE_SIZE, 0);
+    APInt op2bv(IntNum::BITVECT_NATIVE_SIZE, 0);
+    const APInt* op1 = lhs.getBV(&op1bv);
+    const APInt* op2 = rhs.getBV(&op2bv);
     return op1->sgt(*op2);
 }
 
 void
 IntNum::getStr(SmallVectorImpl<char>& str, int base, bool lowercase) const
 {
-    if (m_type == INTNUM_BV)
+    if (m_type != INTNUM_SV)
     {
-        m_val.bv->toString(str, static_cast<unsigned>(base), true, false,
-                           lowercase);
+        APInt conv_bv(BITVECT_NATIVE_SIZE, 0);
+        getBV(&conv_bv)->toString(str, static_cast<unsigned>(base), true,
+                                  false, lowercase);
         return;
     }
 
@@ -879,10 +1266,13 @@ IntNum::getStr(SmallVectorImpl<char>& str, int base, bool lowercase) const
                 fmt = "%lX";
             break;
         default:
+        {
             // fall back to bigval
+            APInt conv_bv(BITVECT_NATIVE_SIZE, 0);
             getBV(&conv_bv)->toString(str, static_cast<unsigned>(base), true,
                                       false, lowercase);
             return;
+        }
     }
 
     char s[40];
@@ -910,6 +1300,14 @@ IntNum::Extract(unsigned int width, unsigned int lsb) const
             rv &= ((1UL << width) - 1);
         return rv;
     }
+    else if (m_type == INTNUM_DV)
+    {
+        uint64_t words[BITVECT_NATIVE_SIZE/64];
+        DVToWords(words, m_val.dv.lo, m_val.dv.hi);
+        uint64_t v;
+        APInt::tcExtract(&v, 1, words, width, lsb);
+        return static_cast<unsigned long>(v);
+    }
     else
     {
         uint64_t v;
@@ -936,6 +1334,31 @@ IntNum::Print(raw_ostream& os,
               bool showbase,
               int bits) const
 {
+    // Hex values that fit in 64 bits don't need a bitvector conversion.
+    if (base == 16 && (m_type == INTNUM_SV ||
+                       (m_type == INTNUM_DV && m_val.dv.hi == 0)))
+    {
+        uint64_t val;
+        if (m_type == INTNUM_DV)
+            val = m_val.dv.lo;
+        else if (m_val.sv < 0)
+        {
+            val = -static_cast<USmallValue>(m_val.sv);
+            os << '-';
+        }
+        else
+            val = m_val.sv;
+        if (showbase)
+            os << '0' << (lowercase ? 'x' : 'X');
+        unsigned int digits = bits > 0 ? (bits+3)/4 : 1;
+        for (; digits > 16; --digits)
+            os << '0';
+        char buf[16];
+        os.write(buf, FormatHex(buf, val, digits, lowercase) - buf);
+        return;
+    }
+
+    APInt conv_bv(BITVECT_NATIVE_SIZE, 0);
     const APInt* bv = getBV(&conv_bv);
 
     if (bv->isNegative())
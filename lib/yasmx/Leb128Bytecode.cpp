@@ -51,20 +51,20 @@ public:
 
     /// Calculates the minimum size of a bytecode.
     bool CalcLen(Bytecode& bc,
-                 /*@out@*/ unsigned long* len,
+                 /*@out@*/ uint64_t* len,
                  const Bytecode::AddSpanFunc& add_span,
                  DiagnosticsEngine& diags);
 
     /// Recalculates the bytecode's length based on an expanded span
     /// length.
     bool Expand(Bytecode& bc,
-                unsigned long* len,
+                uint64_t* len,
                 int span,
-                long old_val,
-                long new_val,
+                int64_t old_val,
+                int64_t new_val,
                 bool* keep,
-                /*@out@*/ long* neg_thres,
-                /*@out@*/ long* pos_thres,
+                /*@out@*/ int64_t* neg_thres,
+                /*@out@*/ int64_t* pos_thres,
                 DiagnosticsEngine& diags);
 
     /// Convert a bytecode into its byte representation.
@@ -105,7 +105,7 @@ LEB128Bytecode::Finalize(Bytecode& bc, DiagnosticsEngine& diags)
 
 bool
 LEB128Bytecode::CalcLen(Bytecode& bc,
-                        /*@out@*/ unsigned long* len,
+                        /*@out@*/ uint64_t* len,
                         const Bytecode::AddSpanFunc& add_span,
                         DiagnosticsEngine& diags)
 {
@@ -132,13 +132,13 @@ LEB128Bytecode::CalcLen(Bytecode& bc,
 
 bool
 LEB128Bytecode::Expand(Bytecode& bc,
-                       unsigned long* len,
+                       uint64_t* len,
                        int span,
-                       long old_val,
-                       long new_val,
+                       int64_t old_val,
+                       int64_t new_val,
                        bool* keep,
-                       /*@out@*/ long* neg_thres,
-                       /*@out@*/ long* pos_thres,
+                       /*@out@*/ int64_t* neg_thres,
+                       /*@out@*/ int64_t* pos_thres,
                        DiagnosticsEngine& diags)
 {
     unsigned long size = SizeLEB128(new_val, m_value.isSigned());
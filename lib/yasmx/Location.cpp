@@ -35,12 +35,6 @@
 
 using namespace yasm;
 
-unsigned long
-Location::getOffset() const
-{
-    return bc->getOffset() + off;
-}
-
 #ifdef WITH_XML
 pugi::xml_node
 Location::Write(pugi::xml_node out) const
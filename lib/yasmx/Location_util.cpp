@@ -26,6 +26,8 @@
 //
 #include "yasmx/Location_util.h"
 
+#include <algorithm>
+
 #include "llvm/ADT/APFloat.h"
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/SmallVector.h"
@@ -258,6 +260,22 @@ yasm::SubstDist(Expr& e, DiagnosticsEngine& diags,
     return functor.m_subst;
 }
 
+// Get the location of a symbol or location term, if it has one.
+static bool
+getTermLocation(const ExprTerm& term, /*@out@*/ Location* loc)
+{
+    if (const Location* termloc = term.getLocation())
+        *loc = *termloc;
+    else if (SymbolRef sym = term.getSymbol())
+    {
+        if (!sym->getLabel(loc))
+            return false;
+    }
+    else
+        return false;
+    return loc->bc != 0;
+}
+
 bool
 yasm::Evaluate(const Expr& e,
                DiagnosticsEngine& diags,
@@ -279,6 +297,28 @@ yasm::Evaluate(const Expr& e,
         return true;
     }
 
+    // Shortcut a label difference, e.g. in "dd label2-label1" jump tables:
+    // after simplification this is label2+(label1*-1).
+    if (valueloc && terms.size() == 5
+        && terms[4].isOp(Op::ADD) && terms[4].getNumChild() == 2
+        && terms[3].isOp(Op::MUL) && terms[3].getNumChild() == 2)
+    {
+        const ExprTerm* sub = &terms[1];
+        const ExprTerm* neg1 = &terms[2];
+        if (neg1->isType(ExprTerm::SYM|ExprTerm::LOC))
+            std::swap(sub, neg1);
+        Location loc, sub_loc;
+        if (neg1->isType(ExprTerm::INT) && neg1->getIntNum()->isNeg1()
+            && getTermLocation(terms[0], &loc)
+            && getTermLocation(*sub, &sub_loc))
+        {
+            IntNum dist(loc.getOffset());
+            dist -= sub_loc.getOffset();
+            *result = ExprTerm(dist, terms[0].getSource(), terms[4].m_depth);
+            return true;
+        }
+    }
+
     SmallVector<ExprTerm, 8> stack;
 
     for (ExprTerms::const_iterator i=terms.begin(), end=terms.end();
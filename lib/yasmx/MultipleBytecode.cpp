@@ -89,20 +89,20 @@ public:
 
     /// Calculates the minimum size of a bytecode.
     bool CalcLen(Bytecode& bc,
-                 /*@out@*/ unsigned long* len,
+                 /*@out@*/ uint64_t* len,
                  const Bytecode::AddSpanFunc& add_span,
                  DiagnosticsEngine& diags);
 
     /// Recalculates the bytecode's length based on an expanded span
     /// length.
     bool Expand(Bytecode& bc,
-                unsigned long* len,
+                uint64_t* len,
                 int span,
-                long old_val,
-                long new_val,
+                int64_t old_val,
+                int64_t new_val,
                 bool* keep,
-                /*@out@*/ long* neg_thres,
-                /*@out@*/ long* pos_thres,
+                /*@out@*/ int64_t* neg_thres,
+                /*@out@*/ int64_t* pos_thres,
                 DiagnosticsEngine& diags);
 
     /// Convert a bytecode into its byte representation.
@@ -142,20 +142,20 @@ public:
 
     /// Calculates the minimum size of a bytecode.
     bool CalcLen(Bytecode& bc,
-                 /*@out@*/ unsigned long* len,
+                 /*@out@*/ uint64_t* len,
                  const Bytecode::AddSpanFunc& add_span,
                  DiagnosticsEngine& diags);
 
     /// Recalculates the bytecode's length based on an expanded span
     /// length.
     bool Expand(Bytecode& bc,
-                unsigned long* len,
+                uint64_t* len,
                 int span,
-                long old_val,
-                long new_val,
+                int64_t old_val,
+                int64_t new_val,
                 bool* keep,
-                /*@out@*/ long* neg_thres,
-                /*@out@*/ long* pos_thres,
+                /*@out@*/ int64_t* neg_thres,
+                /*@out@*/ int64_t* pos_thres,
                 DiagnosticsEngine& diags);
 
     /// Convert a bytecode into its byte representation.
@@ -332,8 +332,8 @@ public:
     void operator() (Bytecode& bc,
                      int id,
                      const Value& value,
-                     long neg_thres,
-                     long pos_thres);
+                     int64_t neg_thres,
+                     int64_t pos_thres);
 
 private:
     Bytecode& m_outer_bc;
@@ -346,8 +346,8 @@ void
 AddSpanInner::operator() (Bytecode& bc,
                           int id,
                           const Value& value,
-                          long neg_thres,
-                          long pos_thres)
+                          int64_t neg_thres,
+                          int64_t pos_thres)
 {
     int outer_id = id + (id < 0 ? -m_base : m_base);
     m_outer_addspan(m_outer_bc, outer_id, value, neg_thres, pos_thres);
@@ -355,7 +355,7 @@ AddSpanInner::operator() (Bytecode& bc,
 
 bool
 MultipleBytecode::CalcLen(Bytecode& bc,
-                          /*@out@*/ unsigned long* len,
+                          /*@out@*/ uint64_t* len,
                           const Bytecode::AddSpanFunc& add_span,
                           DiagnosticsEngine& diags)
 {
@@ -364,7 +364,7 @@ MultipleBytecode::CalcLen(Bytecode& bc,
 
     AddSpanInner add_span_inner(bc, add_span);
     int base = 100;
-    unsigned long ilen = 0;
+    uint64_t ilen = 0;
     for (BytecodeContainer::bc_iterator i = m_contents->bytecodes_begin(),
          end = m_contents->bytecodes_end(); i != end; ++i)
     {
@@ -381,13 +381,13 @@ MultipleBytecode::CalcLen(Bytecode& bc,
 
 bool
 MultipleBytecode::Expand(Bytecode& bc,
-                         unsigned long* len,
+                         uint64_t* len,
                          int span,
-                         long old_val,
-                         long new_val,
+                         int64_t old_val,
+                         int64_t new_val,
                          bool* keep,
-                         /*@out@*/ long* neg_thres,
-                         /*@out@*/ long* pos_thres,
+                         /*@out@*/ int64_t* neg_thres,
+                         /*@out@*/ int64_t* pos_thres,
                          DiagnosticsEngine& diags)
 {
     if (span < 0)
@@ -501,7 +501,7 @@ FillBytecode::Finalize(Bytecode& bc, DiagnosticsEngine& diags)
 
 bool
 FillBytecode::CalcLen(Bytecode& bc,
-                      /*@out@*/ unsigned long* len,
+                      /*@out@*/ uint64_t* len,
                       const Bytecode::AddSpanFunc& add_span,
                       DiagnosticsEngine& diags)
 {
@@ -514,13 +514,13 @@ FillBytecode::CalcLen(Bytecode& bc,
 
 bool
 FillBytecode::Expand(Bytecode& bc,
-                     unsigned long* len,
+                     uint64_t* len,
                      int span,
-                     long old_val,
-                     long new_val,
+                     int64_t old_val,
+                     int64_t new_val,
                      bool* keep,
-                     /*@out@*/ long* neg_thres,
-                     /*@out@*/ long* pos_thres,
+                     /*@out@*/ int64_t* neg_thres,
+                     /*@out@*/ int64_t* pos_thres,
                      DiagnosticsEngine& diags)
 {
     if (span < 0)
@@ -558,9 +558,8 @@ FillBytecode::Output(Bytecode& bc, BytecodeOutput& bc_out)
     num_out.EmitWarnings(bc_out.getDiagnostics());
     num_out.ClearWarnings();
 
-    for (long mult=0, multend=m_multiple.getInt(); mult<multend; mult++)
-        bc_out.OutputBytes(bytes, source);
-
+    bc_out.OutputFill(bytes, static_cast<uint64_t>(m_multiple.getInt()),
+                      source);
     return true;
 }
 
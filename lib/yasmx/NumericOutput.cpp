@@ -42,8 +42,6 @@ using namespace yasm;
 using llvm::APInt;
 using llvm::APFloat;
 
-static APInt staticbv(IntNum::BITVECT_NATIVE_SIZE, 0);
-
 NumericOutput::NumericOutput(Bytes& bytes)
     : m_bytes(bytes)
     , m_size(0)
@@ -178,7 +176,10 @@ NumericOutput::OutputInteger(const IntNum& intn)
 {
     // Handle bigval specially
     if (!intn.isInt())
-        return OutputInteger(*intn.getBV(&staticbv));
+    {
+        APInt intbv(IntNum::BITVECT_NATIVE_SIZE, 0);
+        return OutputInteger(*intn.getBV(&intbv));
+    }
 
     int destsize = m_bytes.size();
 
@@ -28,17 +28,30 @@
 
 #include "yasmx/Object.h"
 
+#include <algorithm>
+#include <map>
 #include <memory>
 
 #include <boost/pool/object_pool.hpp>
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/OwningPtr.h"
 #include "llvm/ADT/Twine.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Mutex.h"
+#include "llvm/Support/system_error.h"
+#include "llvm/Support/raw_ostream.h"
 #include "yasmx/Basic/Diagnostic.h"
+#include "yasmx/Basic/SourceManager.h"
 #include "yasmx/Config/functional.h"
+#include "yasmx/Support/ThreadPool.h"
+#include "yasmx/Support/Trace.h"
 #include "yasmx/Arch.h"
 #include "yasmx/Bytecode.h"
+#include "yasmx/IntNum.h"
 #include "yasmx/Optimizer.h"
 #include "yasmx/Section.h"
 #include "yasmx/Symbol.h"
@@ -48,9 +61,16 @@
 
 STATISTIC(num_exist_symbol, "Number of existing symbols found by name");
 STATISTIC(num_new_symbol, "Number of symbols created by name");
+STATISTIC(num_exist_loc_symbol, "Number of existing location symbols found");
+STATISTIC(num_new_loc_symbol, "Number of location symbols created");
+STATISTIC(num_relax_rejected,
+          "Number of recorded span forms rejected by the optimizer");
 
 using namespace yasm;
 
+// Relaxation passes per group of sections at OPTIMIZE_BASIC.
+static const unsigned int OPTIMIZE_BASIC_PASSES = 3;
+
 namespace {
 /// Get name helper for symbol table HAMT.
 class SymGetName
@@ -65,15 +85,22 @@ namespace yasm {
 class Object::Impl
 {
 public:
-    Impl(bool nocase)
-        : sym_map(nocase)
-        , special_sym_map(true)
+    Impl()
+        : special_sym_map(true),
+          next_bc_index(0)
     {}
     ~Impl() {}
 
     Symbol* NewSymbol(StringRef name)
     {
-        return m_sym_pool.construct(name);
+        return m_sym_pool.construct(InternName(name));
+    }
+
+    /// Get the interned copy of a name for a symbol not in the symbol
+    /// table.  Symbol table names are stored once, as the sym_map keys.
+    StringRef InternName(StringRef name)
+    {
+        return m_names.GetOrCreateValue(name).getKey();
     }
 
     void DeleteSymbol(Symbol* sym)
@@ -81,18 +108,49 @@ public:
         m_sym_pool.destroy(sym);
     }
 
-    typedef hamt<StringRef, Symbol, SymGetName> SymbolTable;
+    /// Symbol table symbols, indexed by name (case sensitive).
+    /// This is the hottest lookup in the assembler, so use a flat
+    /// open-addressed table rather than the HAMT.
+    llvm::StringMap<Symbol*> sym_map;
 
-    /// Symbol table symbols, indexed by name.
-    SymbolTable sym_map;
+    typedef hamt<StringRef, Symbol, SymGetName> SpecialSymbolTable;
 
-    /// Special symbols, indexed by name.
-    SymbolTable special_sym_map;
+    /// Special symbols, indexed by name (case insensitive).
+    SpecialSymbolTable special_sym_map;
 
     /// Sections, indexed by name.
     llvm::StringMap<Section*> section_map;
 
+    /// Symbols created by getSymbol(Location), indexed by location.
+    llvm::DenseMap<std::pair<const Bytecode*, uint64_t>, Symbol*> loc_sym_map;
+
+    /// First bytecode index not yet used by Optimize().  Sections that are
+    /// optimized again get new indexes, so indexes in the others stay
+    /// distinct from them.
+    unsigned long next_bc_index;
+
+    /// Sections coupled by span terms since the last full Optimize().
+    Optimizer::Couplings couplings;
+
+    /// Report from the last Optimize() or Reoptimize() (see
+    /// Config::ExplainRelax).
+    std::string relax_report;
+
+    /// Bytecodes that took their longest form while marking layout, with
+    /// their containers, sorted by bytecode.
+    typedef std::vector<std::pair<const Bytecode*, const BytecodeContainer*> >
+        LongForms;
+    LongForms long_forms;
+
+    /// Held while creating the absolute symbol, as Finalize() may need it
+    /// from several threads.
+    llvm::sys::Mutex abs_sym_lock;
+
 private:
+    /// Names of symbols not in the symbol table.  Allocated from an arena
+    /// and never freed individually, so each distinct name is stored once.
+    llvm::StringMap<char, llvm::BumpPtrAllocator> m_names;
+
     /// Pool for symbols not in the symbol table.
     boost::object_pool<Symbol> m_sym_pool;
 };
@@ -100,16 +158,29 @@ private:
 
 Object::Object(StringRef src_filename, StringRef obj_filename, Arch* arch)
     : m_src_filename(src_filename),
+      m_obj_filename(obj_filename),
       m_arch(arch),
+      m_listfmt(0),
+      m_mark_lines(false),
+      m_mark_layout(false),
       m_cur_section(0),
       m_sections_owner(m_sections),
       m_symbols_owner(m_symbols),
-      m_impl(new Impl(false))
+      m_impl(new Impl)
 {
     m_options.DisableGlobalSubRelative = false;
+    m_options.DisableNonTempSubRelative = false;
     m_options.PowerOfTwoAlignment = false;
     m_config.ExecStack = false;
     m_config.NoExecStack = false;
+    m_config.NumJobs = 1;
+    m_config.OptimizeLevel = OPTIMIZE_FULL;
+    m_config.CompressDebugSections = COMPRESS_NONE;
+    m_config.MergeSections = false;
+    m_config.RelaxRelocations = true;
+    m_config.PackRelativeRelocs = false;
+    m_config.ExplainRelax = false;
+    m_config.ReadParts = READ_ALL;
 }
 
 void
@@ -128,12 +199,90 @@ Object::~Object()
 {
 }
 
+// Minimum number of bytecodes given to each job by Finalize().
+static const std::size_t MIN_FINALIZE_BYTECODES = 512;
+
+namespace {
+/// A run of bytecodes finalized by one job of Object::Finalize().
+struct FinalizeChunk
+{
+    std::size_t begin, end;     ///< indexes into the bytecode list
+    DiagnosticsEngine* diags;
+};
+} // anonymous namespace
+
+static void
+FinalizeBytecodes(const std::vector<Bytecode*>& bcs,
+                  const std::vector<FinalizeChunk>& chunks,
+                  std::size_t i)
+{
+    const FinalizeChunk& chunk = chunks[i];
+    TraceRegion t("Finalize Bytecodes");
+    for (std::size_t n=chunk.begin; n<chunk.end; ++n)
+        bcs[n]->Finalize(*chunk.diags);
+}
+
 void
-Object::Finalize(DiagnosticsEngine& diags)
+Object::Finalize(DiagnosticsEngine& diags, unsigned int num_jobs)
 {
+    std::size_t nbcs = 0;
+    for (section_iterator i=m_sections.begin(), end=m_sections.end();
+         i != end; ++i)
+        nbcs += i->size();
+
+    unsigned int num_threads =
+        num_jobs == 0 ? ThreadPool::getNumProcessors() : num_jobs;
+    if (num_threads <= 1 || nbcs < 2*MIN_FINALIZE_BYTECODES)
+    {
+        for (section_iterator i=m_sections.begin(), end=m_sections.end();
+             i != end; ++i)
+        {
+            TraceRegion t("Finalize Section", i->getName());
+            i->Finalize(diags);
+        }
+        return;
+    }
+
+    // Each bytecode only finalizes its own values, so the bytecodes of all
+    // sections are split into chunks that may run concurrently.  Use
+    // several chunks per thread so threads that finish early can pick up
+    // the remaining ones.  Diagnostics are replayed in bytecode order, so
+    // the outcome doesn't depend on num_jobs.
+    std::vector<Bytecode*> bcs;
+    bcs.reserve(nbcs);
     for (section_iterator i=m_sections.begin(), end=m_sections.end();
          i != end; ++i)
-        i->Finalize(diags);
+    {
+        for (Section::bc_iterator bc=i->bytecodes_begin(),
+             bcend=i->bytecodes_end(); bc != bcend; ++bc)
+            bcs.push_back(&*bc);
+    }
+
+    std::size_t chunk_bcs = nbcs / (8*num_threads);
+    if (chunk_bcs < MIN_FINALIZE_BYTECODES)
+        chunk_bcs = MIN_FINALIZE_BYTECODES;
+
+    // The diagnostic engines must be created here as DiagnosticIDs is not
+    // reference counted in a thread-safe manner.
+    stdx::ptr_vector<DiagnosticBuffer> chunk_diags;
+    stdx::ptr_vector_owner<DiagnosticBuffer> chunk_diags_owner(chunk_diags);
+    std::vector<FinalizeChunk> chunks;
+    for (std::size_t begin=0; begin<nbcs; begin+=chunk_bcs)
+    {
+        chunk_diags.push_back(new DiagnosticBuffer(diags));
+        FinalizeChunk chunk;
+        chunk.begin = begin;
+        chunk.end = std::min(begin+chunk_bcs, nbcs);
+        chunk.diags = &chunk_diags.back().getDiagnostics();
+        chunks.push_back(chunk);
+    }
+
+    ThreadPool pool(num_threads);
+    pool.Run(chunks.size(), TR1::bind(&FinalizeBytecodes, TR1::cref(bcs),
+                                      TR1::cref(chunks), _1));
+
+    for (std::size_t i=0; i<chunk_diags.size(); ++i)
+        chunk_diags[i].Replay(diags);
 }
 
 void
@@ -150,9 +299,151 @@ Object::FindSection(StringRef name)
     return m_impl->section_map[name];
 }
 
+// Determine if a symbol is defined or declared external, ignoring the
+// label starting a section that's appended to an existing section.
+static bool
+isDefinedOrExternal(const Symbol& sym,
+                    const llvm::SmallPtrSet<Symbol*, 8>& sect_syms)
+{
+    if (sect_syms.count(const_cast<Symbol*>(&sym)))
+        return false;
+    return sym.isDefined() ||
+        (sym.getVisibility() & (Symbol::EXTERN | Symbol::COMMON)) != 0;
+}
+
+bool
+Object::AppendObject(Object& other)
+{
+    // Labels starting the sections appended to existing ones; they're
+    // replaced by the existing sections' labels.
+    llvm::SmallPtrSet<Symbol*, 8> sect_syms;
+    for (section_iterator sect=other.m_sections.begin(),
+         end=other.m_sections.end(); sect != end; ++sect)
+    {
+        if (!m_impl->section_map.lookup(sect->getName()))
+            continue;
+        Symbol* sym = sect->getSymbol();
+        if (sym && sym->m_type == Symbol::LABEL &&
+            sym->m_loc.bc == &sect->bytecodes_front() && sym->m_loc.off == 0)
+            sect_syms.insert(sym);
+    }
+
+    // Check every symbol before changing anything.
+    for (symbol_iterator psym=other.m_symbols.begin(),
+         end=other.m_symbols.end(); psym != end; ++psym)
+    {
+        if (other.m_impl->sym_map.lookup(psym->getName()) != &*psym)
+            continue;
+        Symbol* sym = m_impl->sym_map.lookup(psym->getName());
+        if (!sym)
+            continue;
+        if (isDefinedOrExternal(*psym, sect_syms) &&
+            isDefinedOrExternal(*sym, sect_syms))
+            return false;
+        if (!sym->canMoveAssocData(*psym))
+            return false;
+    }
+
+    // Sections, in order.
+    std::vector<Section*> moved;
+    std::vector<Section*> sections;
+    other.m_sections.swap(sections);
+    for (std::vector<Section*>::iterator i=sections.begin(),
+         end=sections.end(); i != end; ++i)
+    {
+        std::auto_ptr<Section> psect(*i);
+        *i = 0;
+        Section* sect = m_impl->section_map.lookup(psect->getName());
+        if (!sect)
+        {
+            if (other.m_cur_section == psect.get())
+                m_cur_section = psect.get();
+            moved.push_back(psect.get());
+            AppendSection(psect);
+            continue;
+        }
+        sect->TakeBytecodes(*psect);
+        if (psect->getAlign() > sect->getAlign())
+            sect->setAlign(psect->getAlign());
+        if (!psect->isDefault())
+            sect->setDefault(false);
+        if (other.m_cur_section == psect.get())
+            m_cur_section = sect;
+        // keep the (now empty) section with the memory of its bytecodes
+        other.m_sections.push_back(psect.release());
+    }
+    other.m_cur_section = 0;
+
+    // Symbols, in order.
+    std::vector<Symbol*> symbols;
+    other.m_symbols.swap(symbols);
+    for (std::vector<Symbol*>::iterator i=symbols.begin(),
+         end=symbols.end(); i != end; ++i)
+    {
+        Symbol* psym = *i;
+        if (other.m_impl->sym_map.lookup(psym->getName()) != psym)
+        {
+            other.m_symbols.push_back(psym);
+            continue;
+        }
+        llvm::StringMapEntry<Symbol*>& entry =
+            m_impl->sym_map.GetOrCreateValue(psym->getName());
+        if (!entry.getValue())
+        {
+            psym->m_name = entry.getKey();
+            entry.setValue(psym);
+            m_symbols.push_back(psym);
+            continue;
+        }
+
+        Symbol* sym = entry.getValue();
+        int status = psym->m_status;
+        if (sect_syms.count(psym))
+            status &= ~(Symbol::DEFINED | Symbol::VALUED);
+        else if (psym->m_type != Symbol::UNKNOWN)
+        {
+            sym->m_type = psym->m_type;
+            sym->m_loc = psym->m_loc;
+            sym->m_equ.swap(psym->m_equ);
+            sym->m_def_source = psym->m_def_source;
+        }
+        sym->m_status |= status;
+        sym->m_visibility |= psym->m_visibility;
+        if (!sym->m_decl_source.isValid())
+            sym->m_decl_source = psym->m_decl_source;
+        if (!sym->m_use_source.isValid())
+            sym->m_use_source = psym->m_use_source;
+        sym->MoveAssocData(*psym);
+
+        // leave the other object's symbol as an alias
+        psym->m_type = Symbol::EQU;
+        psym->m_status = Symbol::USED | Symbol::DEFINED | Symbol::VALUED;
+        psym->m_equ.reset(new Expr(SymbolRef(sym)));
+        other.m_symbols.push_back(psym);
+    }
+
+    // The labels starting the moved sections may have become aliases.
+    for (std::vector<Section*>::iterator i=moved.begin(), end=moved.end();
+         i != end; ++i)
+    {
+        Symbol* psym = (*i)->getSymbol();
+        if (!psym)
+            continue;
+        if (Symbol* sym = m_impl->sym_map.lookup(psym->getName()))
+            (*i)->setSymbol(SymbolRef(sym));
+    }
+
+    for (std::vector<std::string>::const_iterator
+         i=other.m_input_files.begin(), end=other.m_input_files.end();
+         i != end; ++i)
+        AddInputFile(*i);
+    return true;
+}
+
 SymbolRef
 Object::getAbsoluteSymbol()
 {
+    llvm::sys::ScopedLock lock(m_impl->abs_sym_lock);
     SymbolRef sym = getSymbol("");
 
     // If we already defined it, we're done.
@@ -168,7 +459,10 @@ Object::getAbsoluteSymbol()
 SymbolRef
 Object::FindSymbol(StringRef name)
 {
-    return SymbolRef(m_impl->sym_map.Find(name));
+    llvm::StringMap<Symbol*>::iterator i = m_impl->sym_map.find(name);
+    if (i == m_impl->sym_map.end())
+        return SymbolRef(0);
+    return SymbolRef(i->second);
 }
 
 SymbolRef
@@ -179,33 +473,44 @@ Object::getSymbol(StringRef name)
     // table, so it's easy enough to reuse that for deleting the symbols.
     // The memory impact of keeping a second linked list (internal to the pool)
     // seems to outweigh the moderate time savings of pool deletion.
-    std::auto_ptr<Symbol> sym(new Symbol(name));
-    Symbol* sym2 = m_impl->sym_map.Insert(sym.get());
-    if (sym2)
+    // The symbol name is stored only once, as the key of its table entry.
+    llvm::StringMapEntry<Symbol*>& entry =
+        m_impl->sym_map.GetOrCreateValue(name);
+    if (entry.getValue())
     {
         ++num_exist_symbol;
-        return SymbolRef(sym2);
+        return SymbolRef(entry.getValue());
     }
 
     ++num_new_symbol;
-    sym2 = sym.get();
-    m_symbols.push_back(sym.release());
-    return SymbolRef(sym2);
+    std::auto_ptr<Symbol> sym(new Symbol(entry.getKey()));
+    m_symbols.push_back(sym.get());
+    entry.setValue(sym.release());
+    return SymbolRef(entry.getValue());
 }
 
 SymbolRef
 Object::getSymbol(Location loc)
 {
-    // TODO: try to find a matching named symbol.
-    SymbolRef sym = AddNonTableSymbol("$");
+    // Named labels aren't substituted: relocations against a global label
+    // are not the same as against its location.
+    Symbol*& sym = m_impl->loc_sym_map[std::make_pair(loc.bc, loc.off)];
+    if (sym)
+    {
+        ++num_exist_loc_symbol;
+        return SymbolRef(sym);
+    }
+
+    ++num_new_loc_symbol;
+    sym = m_impl->NewSymbol("$");
     sym->DefineLabel(loc);
-    return sym;
+    return SymbolRef(sym);
 }
 
 SymbolRef
 Object::AppendSymbol(StringRef name)
 {
-    Symbol* sym = new Symbol(name);
+    Symbol* sym = new Symbol(m_impl->InternName(name));
     m_symbols.push_back(sym);
     return SymbolRef(sym);
 }
@@ -220,9 +525,13 @@ Object::AddNonTableSymbol(StringRef name)
 void
 Object::RenameSymbol(SymbolRef sym, StringRef name)
 {
-    m_impl->sym_map.Remove(sym->getName());
-    sym->m_name = name;
-    m_impl->sym_map.Insert(sym);
+    // Add the new entry before removing the old one; the symbol's current
+    // name may be the old entry's key.
+    StringRef old_name = sym->getName();
+    if (old_name == name)
+        return;
+    sym->m_name = m_impl->sym_map.GetOrCreateValue(name, sym).getKey();
+    m_impl->sym_map.erase(old_name);
 }
 
 void
@@ -272,6 +581,29 @@ Object::FindSpecialSymbol(StringRef name)
     return SymbolRef(m_impl->special_sym_map.Find(name));
 }
 
+void
+Object::AddInputFile(StringRef filename)
+{
+    if (std::find(m_input_files.begin(), m_input_files.end(), filename)
+        == m_input_files.end())
+        m_input_files.push_back(filename);
+}
+
+const std::string&
+Object::getRelaxReport() const
+{
+    return m_impl->relax_report;
+}
+
+bool
+Object::isLongForm(const Bytecode& bc) const
+{
+    Impl::LongForms::const_iterator i = std::lower_bound(
+        m_impl->long_forms.begin(), m_impl->long_forms.end(),
+        std::make_pair(&bc, static_cast<const BytecodeContainer*>(0)));
+    return i != m_impl->long_forms.end() && i->first == &bc;
+}
+
 #ifdef WITH_XML
 pugi::xml_node
 Object::Write(pugi::xml_node out) const
@@ -308,25 +640,402 @@ Object::UpdateBytecodeOffsets(DiagnosticsEngine& diags)
         sect->UpdateOffsets(diags);
 }
 
+static void
+UpdateOffsets(const std::vector<Section*>& sections, DiagnosticsEngine& diags)
+{
+    for (std::vector<Section*>::const_iterator sect=sections.begin(),
+         end=sections.end(); sect != end; ++sect)
+        (*sect)->UpdateOffsets(diags);
+}
+
+// Get keys identifying spans across assemblies of the same (or a lightly
+// changed) source: the span id, the number of earlier spans with the same
+// id and source position, and the source position of the span's bytecode.
+// Spans without a source position get an empty key.
+static void
+getSpanKeys(const Optimizer::SpanIds& spans,
+            DiagnosticsEngine& diags,
+            /*@out@*/ std::vector<std::string>* keys)
+{
+    keys->resize(spans.size());
+    if (!diags.hasSourceManager())
+        return;
+    SourceManager& smgr = diags.getSourceManager();
+
+    llvm::StringMap<unsigned int> seen;
+    for (size_t i=0; i<spans.size(); ++i)
+    {
+        PresumedLoc ploc = smgr.getPresumedLoc(spans[i].first->getSource());
+        if (ploc.isInvalid())
+            continue;
+
+        std::string pos;
+        llvm::raw_string_ostream oss(pos);
+        oss << ploc.getFilename() << ':' << ploc.getLine() << ':'
+            << ploc.getColumn();
+        oss.flush();
+        std::string id = Twine(spans[i].second).str();
+        unsigned int n = seen[id + ' ' + pos]++;
+        keys->at(i) = id + ' ' + Twine(n).str() + ' ' + pos;
+    }
+}
+
+// Read the keys of spans recorded in their long form.  Returns false if the
+// file could not be read.
+static bool
+LoadLongKeys(const std::string& filename,
+             /*@out@*/ std::vector<std::string>* keys)
+{
+    OwningPtr<MemoryBuffer> buf;
+    if (MemoryBuffer::getFile(filename, buf))
+        return false;
+
+    // One span per line: its form, then its key.
+    StringRef rest = buf->getBuffer();
+    while (!rest.empty())
+    {
+        std::pair<StringRef, StringRef> split = rest.split('\n');
+        rest = split.second;
+        std::pair<StringRef, StringRef> form = split.first.split(' ');
+        if (form.first == "long")
+            keys->push_back(form.second);
+    }
+    std::sort(keys->begin(), keys->end());
+    return true;
+}
+
+// Write the source position of a bytecode, or its section and offset if
+// it has none.
+static void
+WriteBytecodePos(const Bytecode& bc,
+                 DiagnosticsEngine& diags,
+                 raw_ostream& os)
+{
+    if (diags.hasSourceManager())
+    {
+        PresumedLoc ploc =
+            diags.getSourceManager().getPresumedLoc(bc.getSource());
+        if (ploc.isValid())
+        {
+            os << ploc.getFilename() << ':' << ploc.getLine() << ':'
+               << ploc.getColumn();
+            return;
+        }
+    }
+    const Section* sect = bc.getContainer()->getSection();
+    os << (sect ? sect->getName() : StringRef("?")) << "+0x";
+    os.write_hex(bc.getOffset());
+}
+
+namespace {
+struct LongSpanReasonLess
+{
+    bool operator() (const Optimizer::LongSpanReason& lhs,
+                     const Optimizer::LongSpanReason& rhs) const
+    {
+        if (lhs.bc->getIndex() != rhs.bc->getIndex())
+            return lhs.bc->getIndex() < rhs.bc->getIndex();
+        return lhs.id < rhs.id;
+    }
+};
+
+struct GrowthMore
+{
+    bool operator() (const std::pair<Bytecode*, int64_t>& lhs,
+                     const std::pair<Bytecode*, int64_t>& rhs) const
+    { return lhs.second > rhs.second; }
+};
+
+struct GrowthIndexLess
+{
+    bool operator() (const std::pair<Bytecode*, int64_t>& lhs,
+                     const std::pair<Bytecode*, int64_t>& rhs) const
+    { return lhs.first->getIndex() < rhs.first->getIndex(); }
+};
+} // anonymous namespace
+
+// Number of grown bytecodes listed for each span in the relax report.
+static const size_t RELAX_REPORT_GROWTH = 8;
+
+// Write why spans took their longest form, in source order.
+static void
+WriteRelaxReport(const Object& object,
+                 Optimizer::LongSpanReasons& reasons,
+                 DiagnosticsEngine& diags,
+                 raw_ostream& os)
+{
+    std::sort(reasons.begin(), reasons.end(), LongSpanReasonLess());
+
+    // Name distance targets after the labels at them, other than section
+    // symbols.
+    std::map<std::pair<const Bytecode*, uint64_t>, StringRef> labels;
+    for (Object::const_symbol_iterator sym=object.symbols_begin(),
+         end=object.symbols_end(); sym != end; ++sym)
+    {
+        Location loc;
+        if (!sym->getLabel(&loc))
+            continue;
+        const Section* sect = loc.bc->getContainer()->getSection();
+        if (sect && sect->getSymbol() == &(*sym))
+            continue;
+        labels.insert(std::make_pair(std::make_pair(loc.bc, loc.off),
+                                     sym->getName()));
+    }
+
+    for (Optimizer::LongSpanReasons::iterator i=reasons.begin(),
+         end=reasons.end(); i != end; ++i)
+    {
+        WriteBytecodePos(*i->bc, diags, os);
+        os << ": long form: ";
+        switch (i->reason)
+        {
+            case Optimizer::LongSpanReason::OUT_OF_RANGE:
+                os << "out of range";
+                break;
+            case Optimizer::LongSpanReason::RELATIVE:
+                os << "target in another section or external";
+                break;
+            case Optimizer::LongSpanReason::COMPLEX:
+                os << "value too complex to calculate";
+                break;
+            case Optimizer::LongSpanReason::PASS_LIMIT:
+                os << "relaxation pass limit reached";
+                break;
+            case Optimizer::LongSpanReason::SEEDED:
+                os << "recorded as long by an earlier assembly";
+                break;
+        }
+
+        if (i->dist)
+        {
+            // The target is the end of the distance away from the span's
+            // own bytecode.
+            Location target = i->loc;
+            Location other = i->loc2;
+            if (target.bc == i->bc || (target.bc && other.bc &&
+                                       target.bc->getIndex()+1 ==
+                                       i->bc->getIndex()))
+                std::swap(target, other);
+            os << "; distance " << i->value << " to ";
+            std::map<std::pair<const Bytecode*, uint64_t>, StringRef>::
+                const_iterator label =
+                    labels.find(std::make_pair(target.bc, target.off));
+            if (label != labels.end())
+                os << '\'' << label->second << '\'';
+            else if (target.bc)
+                WriteBytecodePos(*target.bc, diags, os);
+            IntNum final_dist;
+            if (CalcDist(i->loc, i->loc2, &final_dist))
+                os << " (final " << final_dist.getInt64() + i->add << ')';
+        }
+        else if (i->value != INT64_MAX)
+            os << "; value " << i->value;
+        if (i->reason == Optimizer::LongSpanReason::OUT_OF_RANGE
+            || i->reason == Optimizer::LongSpanReason::PASS_LIMIT)
+            os << "; short range [" << i->neg_thres << ", " << i->pos_thres
+               << ']';
+
+        int64_t total = 0;
+        for (std::vector<std::pair<Bytecode*, int64_t> >::const_iterator
+             j=i->growth.begin(), jend=i->growth.end(); j != jend; ++j)
+            total += j->second;
+        if (!i->growth.empty())
+            os << "; grown by " << total << " bytes";
+        os << '\n';
+
+        // List the bytecodes that grew the most, in source order.
+        size_t shown = std::min(i->growth.size(), RELAX_REPORT_GROWTH);
+        std::partial_sort(i->growth.begin(), i->growth.begin()+shown,
+                          i->growth.end(), GrowthMore());
+        std::sort(i->growth.begin(), i->growth.begin()+shown,
+                  GrowthIndexLess());
+        for (size_t j=0; j<shown; ++j)
+        {
+            WriteBytecodePos(*i->growth[j].first, diags, os);
+            os << ": note: grew by " << i->growth[j].second << " bytes\n";
+            total -= i->growth[j].second;
+        }
+        if (shown < i->growth.size())
+        {
+            WriteBytecodePos(*i->bc, diags, os);
+            os << ": note: " << (i->growth.size() - shown)
+               << " more grew by " << total << " bytes\n";
+        }
+    }
+}
+
+void
+Object::Optimize(DiagnosticsEngine& diags, unsigned int num_jobs)
+{
+    std::vector<Section*> sections;
+    sections.reserve(m_sections.size());
+    for (section_iterator sect=m_sections.begin(), end=m_sections.end();
+         sect != end; ++sect)
+        sections.push_back(&(*sect));
+
+    m_impl->next_bc_index = 0;
+    m_impl->couplings.clear();
+    m_impl->relax_report.clear();
+    m_impl->long_forms.clear();
+
+    std::string forms;
+    std::string* save = m_config.SaveRelaxFile.empty() ? 0 : &forms;
+    std::vector<std::string> long_keys;
+    bool done = false;
+    if (!m_config.LoadRelaxFile.empty()
+        && LoadLongKeys(m_config.LoadRelaxFile, &long_keys))
+    {
+        // Only keep the diagnostics if the recorded forms hold up.
+        DiagnosticBuffer seeded_diags(diags);
+        done = OptimizeSections(sections, seeded_diags.getDiagnostics(),
+                                num_jobs, &long_keys, save);
+        if (done)
+            seeded_diags.Replay(diags);
+        else
+        {
+            ++num_relax_rejected;
+            forms.clear();
+        }
+    }
+    if (!done)
+        OptimizeSections(sections, diags, num_jobs, 0, save);
+
+    if (!save || diags.hasErrorOccurred())
+        return;
+    std::string err;
+    raw_fd_ostream os(m_config.SaveRelaxFile.c_str(), err);
+    if (!err.empty())
+    {
+        diags.Report(SourceLocation(), diag::err_cannot_open_file)
+            << m_config.SaveRelaxFile << err;
+        return;
+    }
+    os << forms;
+}
+
 void
-Object::Optimize(DiagnosticsEngine& diags)
+Object::Reoptimize(const std::vector<Section*>& changed,
+                   DiagnosticsEngine& diags,
+                   unsigned int num_jobs)
+{
+    // Sections with spans depending on an affected section are affected
+    // too, as their lengths may change with it.
+    llvm::SmallPtrSet<const BytecodeContainer*, 8> affected;
+    std::vector<const BytecodeContainer*> work(changed.begin(), changed.end());
+    while (!work.empty())
+    {
+        const BytecodeContainer* container = work.back();
+        work.pop_back();
+        if (!affected.insert(container))
+            continue;
+        for (Optimizer::Couplings::const_iterator
+             i=m_impl->couplings.begin(), end=m_impl->couplings.end();
+             i != end; ++i)
+        {
+            if (i->second == container)
+                work.push_back(i->first);
+        }
+    }
+
+    // Forget the couplings of the affected sections; optimizing them
+    // records them again.
+    Optimizer::Couplings& couplings = m_impl->couplings;
+    Optimizer::Couplings::iterator outi = couplings.begin();
+    for (Optimizer::Couplings::iterator i=couplings.begin(),
+         end=couplings.end(); i != end; ++i)
+    {
+        if (!affected.count(i->first))
+            *outi++ = *i;
+    }
+    couplings.erase(outi, couplings.end());
+    m_impl->relax_report.clear();
+
+    // Likewise the long forms; the bytecodes may no longer exist.
+    Impl::LongForms& long_forms = m_impl->long_forms;
+    Impl::LongForms::iterator longi = long_forms.begin();
+    for (Impl::LongForms::iterator i=long_forms.begin(),
+         end=long_forms.end(); i != end; ++i)
+    {
+        if (!affected.count(i->second))
+            *longi++ = *i;
+    }
+    long_forms.erase(longi, long_forms.end());
+
+    std::vector<Section*> sections;
+    for (section_iterator sect=m_sections.begin(), end=m_sections.end();
+         sect != end; ++sect)
+    {
+        if (affected.count(&(*sect)))
+            sections.push_back(&(*sect));
+    }
+    OptimizeSections(sections, diags, num_jobs);
+}
+
+// Returns false if the long forms of long_keys were not all needed, in
+// which case the sections are left as they were before.
+bool
+Object::OptimizeSections(const std::vector<Section*>& sections,
+                         DiagnosticsEngine& diags,
+                         unsigned int num_jobs,
+                         /*@null@*/ const std::vector<std::string>* long_keys,
+                         /*@null@*/ std::string* forms)
 {
     Optimizer opt(diags);
-    unsigned long bc_index = 0;
+    opt.setExplain(m_config.ExplainRelax);
+    unsigned long bc_index = m_impl->next_bc_index;
+
+    switch (m_config.OptimizeLevel)
+    {
+        case OPTIMIZE_NONE:
+            opt.setMaxPasses(0);
+            break;
+        case OPTIMIZE_BASIC:
+            opt.setMaxPasses(OPTIMIZE_BASIC_PASSES);
+            break;
+        default:
+            break;
+    }
+
+    // To start from recorded long forms, save the contents of the
+    // bytecodes first (calculating their lengths may change them), so the
+    // sections can be restored if the long forms turn out not to be needed.
+    // The contents of TIMES can't be saved.
+    stdx::ptr_vector<Bytecode::Contents> saved;
+    stdx::ptr_vector_owner<Bytecode::Contents> saved_owner(saved);
+    std::vector<Bytecode*> saved_bcs;
+    for (std::vector<Section*>::const_iterator sect=sections.begin(),
+         sectend=sections.end(); long_keys && sect != sectend; ++sect)
+    {
+        for (Section::bc_iterator bc=(*sect)->bytecodes_begin(),
+             bcend=(*sect)->bytecodes_end(); bc != bcend; ++bc)
+        {
+            if (!bc->hasContents())
+                continue;
+            if (bc->getContents().getType() == "yasm::MultipleBytecode")
+            {
+                long_keys = 0;
+                break;
+            }
+            saved_bcs.push_back(&(*bc));
+            saved.push_back(bc->getContents().clone());
+        }
+    }
 
     // Step 1a
-    for (section_iterator sect=m_sections.begin(), sectend=m_sections.end();
-         sect != sectend; ++sect)
+    for (std::vector<Section*>::const_iterator sect=sections.begin(),
+         sectend=sections.end(); sect != sectend; ++sect)
     {
-        unsigned long offset = 0;
+        TraceRegion t("Optimize Section", (*sect)->getName());
+        uint64_t offset = 0;
+        opt.StartContainer();
 
         // Set the offset of the first (empty) bytecode.
-        sect->bytecodes_front().setIndex(bc_index++);
-        sect->bytecodes_front().setOffset(0);
+        (*sect)->bytecodes_front().setIndex(bc_index++);
+        (*sect)->bytecodes_front().setOffset(0);
 
         // Iterate through the remainder, if any.
-        for (Section::bc_iterator bc=sect->bytecodes_begin(),
-             bcend=sect->bytecodes_end(); bc != bcend; ++bc)
+        for (Section::bc_iterator bc=(*sect)->bytecodes_begin(),
+             bcend=(*sect)->bytecodes_end(); bc != bcend; ++bc)
         {
             bc->setIndex(bc_index++);
             bc->setOffset(offset);
@@ -343,33 +1052,120 @@ Object::Optimize(DiagnosticsEngine& diags)
         }
     }
 
+    m_impl->next_bc_index = bc_index;
+
     if (diags.hasErrorOccurred())
-        return;
+        return true;
+
+    Optimizer::SpanIds span_ids;
+    std::vector<std::string> span_keys;
+    if (long_keys || forms)
+    {
+        bool all_long = opt.getSpanIds(&span_ids);
+        getSpanKeys(span_ids, diags, &span_keys);
+        if (!all_long)
+            long_keys = 0;
+    }
+
+    size_t num_couplings = m_impl->couplings.size();
+    bool seeded = false;
+    if (long_keys)
+    {
+        Optimizer::SpanIds long_spans;
+        for (size_t i=0; i<span_ids.size(); ++i)
+        {
+            if (!span_keys[i].empty()
+                && std::binary_search(long_keys->begin(), long_keys->end(),
+                                      span_keys[i]))
+                long_spans.push_back(span_ids[i]);
+        }
+        if (!long_spans.empty())
+        {
+            std::sort(long_spans.begin(), long_spans.end());
+            opt.setLongSpans(long_spans);
+            seeded = true;
+        }
+    }
+
+    // Steps 1b through 3 resolve the spans between bytecodes.
+    TraceRegion t("Optimize Spans");
 
     // Step 1b
-    opt.Step1b();
+    opt.Step1b(num_jobs);
+    const Optimizer::Couplings& couplings = opt.getCouplings();
+    m_impl->couplings.insert(m_impl->couplings.end(), couplings.begin(),
+                             couplings.end());
     if (diags.hasErrorOccurred())
-        return;
+        return true;
 
     // Step 1c
-    UpdateBytecodeOffsets(diags);
+    UpdateOffsets(sections, diags);
     if (diags.hasErrorOccurred())
-        return;
+        return true;
 
     // Step 1d
-    if (opt.Step1d())
-        return;
+    if (!opt.Step1d(num_jobs))
+    {
+        // Step 1e
+        opt.Step1e();
+        if (diags.hasErrorOccurred())
+            return true;
 
-    // Step 1e
-    opt.Step1e();
-    if (diags.hasErrorOccurred())
-        return;
+        // Step 2
+        opt.Step2(num_jobs);
+        if (diags.hasErrorOccurred())
+            return true;
 
-    // Step 2
-    opt.Step2();
-    if (diags.hasErrorOccurred())
-        return;
+        // Step 3
+        UpdateOffsets(sections, diags);
+    }
+
+    if (seeded && !opt.VerifyLongSpans())
+    {
+        for (size_t i=0; i<saved_bcs.size(); ++i)
+            saved_bcs[i]->Transform(Bytecode::Contents::Ptr(saved[i].clone()));
+        m_impl->couplings.resize(num_couplings);
+        return false;
+    }
+
+    if (m_mark_layout)
+    {
+        Optimizer::SpanIds long_spans;
+        opt.getLongSpans(&long_spans);
+        Impl::LongForms& long_forms = m_impl->long_forms;
+        for (Optimizer::SpanIds::const_iterator i=long_spans.begin(),
+             end=long_spans.end(); i != end; ++i)
+            long_forms.push_back(std::make_pair(i->first,
+                                                i->first->getContainer()));
+        std::sort(long_forms.begin(), long_forms.end());
+        long_forms.erase(std::unique(long_forms.begin(), long_forms.end()),
+                         long_forms.end());
+    }
 
-    // Step 3
-    UpdateBytecodeOffsets(diags);
+    if (m_config.ExplainRelax)
+    {
+        Optimizer::LongSpanReasons reasons;
+        opt.getLongSpanReasons(&reasons);
+        llvm::raw_string_ostream oss(m_impl->relax_report);
+        WriteRelaxReport(*this, reasons, diags, oss);
+    }
+
+    if (forms)
+    {
+        Optimizer::SpanIds long_spans;
+        opt.getLongSpans(&long_spans);
+        llvm::raw_string_ostream oss(*forms);
+        for (size_t i=0; i<span_ids.size(); ++i)
+        {
+            if (span_keys[i].empty())
+                continue;
+            if (std::binary_search(long_spans.begin(), long_spans.end(),
+                                   span_ids[i]))
+                oss << "long ";
+            else
+                oss << "short ";
+            oss << span_keys[i] << '\n';
+        }
+    }
+    return true;
 }
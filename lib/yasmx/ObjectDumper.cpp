@@ -0,0 +1,332 @@
+//
+// Streaming object dump implementation.
+//
+//  Copyright (C) 2026  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include "yasmx/ObjectDumper.h"
+
+#include <string>
+
+#include "llvm/Support/raw_ostream.h"
+#include "yasmx/Arch.h"
+#include "yasmx/Bytecode.h"
+#include "yasmx/Expr.h"
+#include "yasmx/IntNum.h"
+#include "yasmx/Location.h"
+#include "yasmx/Object.h"
+#include "yasmx/Reloc.h"
+#include "yasmx/Section.h"
+#include "yasmx/Symbol.h"
+#include "yasmx/Value.h"
+
+
+using namespace yasm;
+
+namespace {
+/// Writes the members of a single-line JSON object.
+class JsonRecord
+{
+public:
+    JsonRecord(raw_ostream& os, const char* record)
+        : m_os(os), m_first(true)
+    {
+        m_os << '{';
+        String("record", record);
+    }
+    ~JsonRecord() { m_os << "}\n"; }
+
+    void String(const char* key, StringRef val)
+    {
+        Key(key);
+        Quote(val);
+    }
+    void Number(const char* key, unsigned long val)
+    {
+        Key(key);
+        m_os << val;
+    }
+    void Bool(const char* key, bool val)
+    {
+        Key(key);
+        m_os << (val ? "true" : "false");
+    }
+    template <typename T>
+    void Printed(const char* key, const T& val)
+    {
+        std::string s;
+        llvm::raw_string_ostream ss(s);
+        ss << val;
+        String(key, ss.str());
+    }
+    void Hex(const char* key, const Bytes& bytes);
+    void BeginArray(const char* key)
+    {
+        Key(key);
+        m_os << '[';
+        m_first = true;
+    }
+    void EndArray()
+    {
+        m_os << ']';
+        m_first = false;
+    }
+    void BeginObject()
+    {
+        if (!m_first)
+            m_os << ',';
+        m_os << '{';
+        m_first = true;
+    }
+    void EndObject()
+    {
+        m_os << '}';
+        m_first = false;
+    }
+
+private:
+    void Key(const char* key)
+    {
+        if (!m_first)
+            m_os << ',';
+        m_first = false;
+        m_os << '"' << key << "\":";
+    }
+    void Quote(StringRef val);
+
+    raw_ostream& m_os;
+    bool m_first;
+};
+} // anonymous namespace
+
+void
+JsonRecord::Hex(const char* key, const Bytes& bytes)
+{
+    static const char hexdig[] = "0123456789abcdef";
+    Key(key);
+    m_os << '"';
+    for (Bytes::const_iterator i=bytes.begin(), end=bytes.end(); i != end;
+         ++i)
+        m_os << hexdig[(*i >> 4) & 0xf] << hexdig[*i & 0xf];
+    m_os << '"';
+}
+
+void
+JsonRecord::Quote(StringRef val)
+{
+    static const char hexdig[] = "0123456789abcdef";
+    m_os << '"';
+    for (StringRef::iterator i=val.begin(), end=val.end(); i != end; ++i)
+    {
+        unsigned char ch = static_cast<unsigned char>(*i);
+        switch (ch)
+        {
+            case '"':   m_os << "\\\""; break;
+            case '\\':  m_os << "\\\\"; break;
+            case '\n':  m_os << "\\n"; break;
+            case '\t':  m_os << "\\t"; break;
+            default:
+                if (ch < 0x20)
+                    m_os << "\\u00" << hexdig[ch >> 4] << hexdig[ch & 0xf];
+                else
+                    m_os << *i;
+        }
+    }
+    m_os << '"';
+}
+
+static void
+DumpLocation(JsonRecord& rec, Location loc)
+{
+    const Section* sect = loc.bc->getContainer()->getSection();
+    if (sect)
+        rec.String("section", sect->getName());
+    rec.Number("offset", loc.getOffset());
+}
+
+static void
+DumpValue(JsonRecord& rec, const Value& value)
+{
+    rec.Number("size", value.getSize());
+    if (value.hasAbs())
+        rec.Printed("abs", *value.getAbs());
+    if (SymbolRef rel = value.getRelative())
+        rec.String("rel", rel->getName());
+    if (SymbolRef wrt = value.getWRT())
+        rec.String("wrt", wrt->getName());
+    if (SymbolRef sub = value.getSubSymbol())
+        rec.String("sub", sub->getName());
+    if (value.isSegOf())
+        rec.Bool("seg_of", true);
+    if (value.getRShift() > 0)
+        rec.Number("rshift", value.getRShift());
+    if (value.getShift() > 0)
+        rec.Number("shift", value.getShift());
+    if (value.isIPRelative())
+        rec.Bool("ip_rel", true);
+    if (value.isSectionRelative())
+        rec.Bool("section_rel", true);
+    if (value.isSigned())
+        rec.Bool("signed", true);
+}
+
+static void
+DumpBytecode(raw_ostream& os, const Section& sect, const Bytecode& bc)
+{
+    JsonRecord rec(os, "bytecode");
+    rec.String("section", sect.getName());
+    if (bc.getIndex() != ~0UL)
+        rec.Number("index", bc.getIndex());
+    rec.Number("offset", bc.getOffset());
+    rec.Number("source", bc.getSource().getRawEncoding());
+    if (!bc.getFixed().empty())
+        rec.Hex("fixed", bc.getFixed());
+
+    const std::vector<Bytecode::Fixup>& fixups = bc.getFixups();
+    if (!fixups.empty())
+    {
+        rec.BeginArray("fixups");
+        for (std::vector<Bytecode::Fixup>::const_iterator i=fixups.begin(),
+             end=fixups.end(); i != end; ++i)
+        {
+            rec.BeginObject();
+            rec.Number("offset", i->getOffset());
+            DumpValue(rec, *i);
+            rec.EndObject();
+        }
+        rec.EndArray();
+    }
+
+    if (bc.hasContents())
+    {
+        rec.String("contents", bc.getContents().getType());
+        rec.Number("tail_len", bc.getTailLen());
+    }
+}
+
+static void
+DumpSection(raw_ostream& os, const Section& sect)
+{
+    {
+        JsonRecord rec(os, "section");
+        rec.String("name", sect.getName());
+        rec.Printed("vma", sect.getVMA());
+        rec.Printed("lma", sect.getLMA());
+        rec.Number("filepos", sect.getFilePos());
+        rec.Number("align", sect.getAlign());
+        rec.Bool("code", sect.isCode());
+        rec.Bool("bss", sect.isBSS());
+        rec.Bool("default", sect.isDefault());
+    }
+
+    for (Section::const_bc_iterator i=sect.bytecodes_begin(),
+         end=sect.bytecodes_end(); i != end; ++i)
+        DumpBytecode(os, sect, *i);
+
+    for (Section::const_reloc_iterator i=sect.relocs_begin(),
+         end=sect.relocs_end(); i != end; ++i)
+    {
+        JsonRecord rec(os, "reloc");
+        rec.String("section", sect.getName());
+        rec.Printed("address", i->getAddress());
+        rec.String("type", i->getTypeName());
+        rec.Printed("value", i->getValue());
+    }
+}
+
+static void
+DumpSymbol(raw_ostream& os, const Symbol& sym)
+{
+    JsonRecord rec(os, "symbol");
+    rec.String("name", sym.getName());
+
+    Location loc;
+    if (const Expr* equ = sym.getEqu())
+    {
+        rec.String("type", "equ");
+        rec.Printed("equ", *equ);
+    }
+    else if (sym.getLabel(&loc))
+    {
+        rec.String("type", "label");
+        DumpLocation(rec, loc);
+    }
+    else if (sym.isSpecial())
+        rec.String("type", "special");
+    else
+        rec.String("type", "unknown");
+
+    rec.Bool("used", sym.isUsed());
+    rec.Bool("defined", sym.isDefined());
+
+    int vis = sym.getVisibility();
+    if (vis != Symbol::LOCAL)
+    {
+        rec.BeginArray("visibility");
+        static const struct
+        {
+            Symbol::Visibility vis;
+            const char* name;
+        } visnames[] =
+        {
+            {Symbol::GLOBAL, "global"},
+            {Symbol::COMMON, "common"},
+            {Symbol::EXTERN, "extern"},
+            {Symbol::DLOCAL, "dlocal"}
+        };
+        for (unsigned int i=0; i<sizeof(visnames)/sizeof(visnames[0]); ++i)
+        {
+            if (vis & visnames[i].vis)
+            {
+                rec.BeginObject();
+                rec.String("kind", visnames[i].name);
+                rec.Number("source", sym.getDeclSource().getRawEncoding());
+                rec.EndObject();
+            }
+        }
+        rec.EndArray();
+    }
+}
+
+void
+yasm::DumpJsonLines(const Object& object, raw_ostream& os)
+{
+    {
+        JsonRecord rec(os, "object");
+        rec.String("source", object.getSourceFilename());
+        if (!object.getObjectFilename().empty())
+            rec.String("output", object.getObjectFilename());
+        if (const Arch* arch = object.getArch())
+            rec.String("arch", arch->getModule().getKeyword());
+    }
+
+    for (Object::const_section_iterator i=object.sections_begin(),
+         end=object.sections_end(); i != end; ++i)
+        DumpSection(os, *i);
+
+    for (Object::const_symbol_iterator i=object.symbols_begin(),
+         end=object.symbols_end(); i != end; ++i)
+        DumpSymbol(os, *i);
+
+    os.flush();
+}
@@ -40,6 +40,11 @@ ObjectFormat::AddDirectives(Directives& dirs, StringRef parser)
 {
 }
 
+void
+ObjectFormat::AddFallbackDirectives(Directives& dirs, StringRef parser)
+{
+}
+
 bool
 ObjectFormat::Read(SourceManager& sm, DiagnosticsEngine& diags)
 {
@@ -47,11 +52,33 @@ ObjectFormat::Read(SourceManager& sm, DiagnosticsEngine& diags)
     return false;
 }
 
+bool
+ObjectFormat::Merge(const MemoryBuffer& in, DiagnosticsEngine& diags)
+{
+    diags.Report(SourceLocation(), diag::err_object_merge_not_supported);
+    return false;
+}
+
+bool
+ObjectFormat::AppendPiece(ObjectFormat& piece)
+{
+    return false;
+}
+
 void
 ObjectFormat::InitSymbols(StringRef parser)
 {
 }
 
+void
+ObjectFormat::OutputCode(OutputFileStream& os,
+                         uint64_t base,
+                         std::vector<CodeFixup>& fixups,
+                         DiagnosticsEngine& diags)
+{
+    diags.Report(SourceLocation(), diag::err_object_code_not_supported);
+}
+
 ObjectFormatModule::~ObjectFormatModule()
 {
 }
@@ -29,21 +29,24 @@
 #include "yasmx/Optimizer.h"
 
 #include <algorithm>
+#include <climits>
 #include <deque>
-#include <list>
 #include <memory>
 #include <vector>
 
 #include "llvm/ADT/ArrayRef.h"
-#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/Twine.h"
+#include "llvm/Support/Allocator.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
 #include "yasmx/Basic/Diagnostic.h"
 #include "yasmx/Config/functional.h"
-#include "yasmx/Support/IntervalTree.h"
+#include "yasmx/Support/IntervalIndex.h"
+#include "yasmx/Support/ThreadPool.h"
+#include "yasmx/Support/ptr_vector.h"
 #include "yasmx/Bytecode.h"
 #include "yasmx/DebugDumper.h"
 #include "yasmx/Expr.h"
@@ -55,12 +58,26 @@
 
 STATISTIC(num_span_terms, "Number of span terms created");
 STATISTIC(num_spans, "Number of spans created");
+STATISTIC(num_dist_spans, "Number of spans that are a single distance");
 STATISTIC(num_step1d, "Number of spans after step 1b");
+STATISTIC(num_short_retired,
+          "Number of spans retired as short in the worst case");
 STATISTIC(num_itree, "Number of span terms added to interval tree");
+STATISTIC(num_itree_max, "Largest interval tree built (span terms)");
 STATISTIC(num_offset_setters, "Number of offset setters");
+STATISTIC(num_fixed_offset_setters,
+          "Number of offset setters with fixed offset (not tracked)");
 STATISTIC(num_recalc, "Number of span recalculations performed");
 STATISTIC(num_expansions, "Number of expansions performed");
+STATISTIC(num_long_forced, "Number of spans forced to their longest form");
+STATISTIC(num_long_seeded,
+          "Number of spans given their longest form by an earlier optimization");
 STATISTIC(num_initial_qb, "Number of spans on initial QB");
+STATISTIC(num_qa_iters, "Number of spans processed from QA");
+STATISTIC(num_qb_iters, "Number of spans processed from QB");
+STATISTIC(num_qb_batches, "Number of QB batches processed");
+STATISTIC(num_deferred_recalc, "Number of span recalculations deferred");
+STATISTIC(num_groups, "Number of independent section groups");
 
 using namespace yasm;
 
@@ -99,6 +116,11 @@ using namespace yasm;
 //  - Negative/Positive thresholds
 //  - Span ID (unique within each bytecode)
 //
+// Most spans (e.g. jumps to a label in the same section) are simply the
+// distance between two locations plus a constant.  These are recognized
+// when their terms are created, and their value is recalculated directly
+// from the single term rather than by evaluating the dependent value.
+//
 // How org and align and any other offset-based bytecodes are handled:
 //
 // Some portions are critical values that must not depend on any bytecode
@@ -149,7 +171,11 @@ using namespace yasm;
 //     (expanded) lengths calculated in 1b.
 //  d. Iterate over active spans.  Add span to interval tree.  Update span's
 //     length based on new bytecode offsets determined in 1c.  If span's
-//     length exceeds long threshold, add that span to Q.
+//     length exceeds long threshold, add that span to Q.  Then retire
+//     distance spans that stay within their thresholds even if every
+//     bytecode they cross grows to its maximum length (e.g. a backward
+//     jump within a block of short instructions); these are never added
+//     to the interval tree.
 // 2. Main loop:
 //   While Q not empty:
 //     Expand BC dependent on span at head of Q (and remove span from Q).
@@ -160,6 +186,21 @@ using namespace yasm;
 //       Increase span length by difference between short and long BC length.
 //       If span exceeds long threshold (or is flagged to recalculate on any
 //       change), add it to tail of Q.
+//   QB is processed in batches: all spans on QB at the start of a batch are
+//   expanded in order.  Spans (with id>0) in "independent" sections that are
+//   touched by those expansions are only marked dirty; their term values are
+//   kept exact, but the (comparatively expensive) threshold recalculation is
+//   performed only once per span at the end of the batch.  A section is
+//   independent if it contains no offset-setters and no span terms cross
+//   into or out of it; expansion within such a section is monotonic, so the
+//   order in which its spans are requeued does not affect the final result.
+//   Spans with id<=0 are always recalculated immediately, and if one is added
+//   to QA, the remainder of the batch is put back on the head of QB so that
+//   TIMES are still processed first.
+//   Sections are also partitioned into groups connected by span terms; as
+//   no expansion in one group can affect another, each group has a separate
+//   QA and QB and the groups may be relaxed in parallel.  Diagnostics for
+//   each group are buffered and reported in section order afterwards.
 // 3. Final pass over bytecodes to generate final offsets.
 //
 namespace {
@@ -172,10 +213,32 @@ public:
     pugi::xml_node Write(pugi::xml_node out) const;
 #endif // WITH_XML
 
+    void Shift(int64_t diff)
+    {
+        m_cur_val += diff;
+        m_new_val += diff;
+        m_thres += diff;
+    }
+
     Bytecode* m_bc;
-    unsigned long m_cur_val;
-    unsigned long m_new_val;
-    unsigned long m_thres;
+    uint64_t m_cur_val;
+    uint64_t m_new_val;
+    uint64_t m_thres;
+
+    // Length when added in Step 1a.
+    uint64_t m_orig_len;
+
+    // Period of offsets with the same length (see
+    // Bytecode::getOffsetPeriod()); UINT64_MAX if none.
+    uint64_t m_period;
+
+    // Run of offset setters in the same container, [m_run_begin,
+    // m_run_end).  Offset changes propagate only within a run.
+    size_t m_run_begin;
+    size_t m_run_end;
+
+    // Next offset setter in the run with a longer period, or m_run_end.
+    size_t m_next_longer;
 };
 } // anonymous namespace
 
@@ -183,7 +246,12 @@ OffsetSetter::OffsetSetter()
     : m_bc(0),
       m_cur_val(0),
       m_new_val(0),
-      m_thres(0)
+      m_thres(0),
+      m_orig_len(0),
+      m_period(UINT64_MAX),
+      m_run_begin(0),
+      m_run_end(0),
+      m_next_longer(0)
 {
 }
 
@@ -215,7 +283,7 @@ public:
              Location loc,
              Location loc2,
              Span* span,
-             long new_val);
+             int64_t new_val);
         ~Term() {}
 #ifdef WITH_XML
         pugi::xml_node Write(pugi::xml_node out) const;
@@ -224,21 +292,25 @@ public:
         Location m_loc;
         Location m_loc2;
         Span* m_span;       // span this term is a member of
-        long m_cur_val;
-        long m_new_val;
+        int64_t m_cur_val;
+        int64_t m_new_val;
         unsigned int m_subst;
     };
 
     Span(Bytecode& bc,
          int id,
          const Value& value,
-         long neg_thres,
-         long pos_thres,
+         int64_t neg_thres,
+         int64_t pos_thres,
          size_t os_index);
     ~Span();
 
-    bool CreateTerms(Optimizer::Impl* optimize, DiagnosticsEngine& diags);
+    bool CreateTerms(std::vector<Term>& scratch,
+                     llvm::BumpPtrAllocator& alloc,
+                     DiagnosticsEngine& diags);
     bool RecalcNormal(DiagnosticsEngine& diags);
+    bool hasLongForm() const;
+    void setLongForm();
 
     std::string getName() const;
 #ifdef WITH_XML
@@ -250,34 +322,142 @@ private:
     Span(const Span&);                  // not implemented
     const Span& operator=(const Span&); // not implemented
 
-    void AddTerm(unsigned int subst, Location loc, Location loc2);
+    void AddTerm(std::vector<Term>* terms,
+                 unsigned int subst,
+                 Location loc,
+                 Location loc2);
 
     Bytecode& m_bc;
 
     Value m_depval;
 
-    // span terms in absolute portion of value
-    typedef std::vector<Term> Terms;
+    // span terms in absolute portion of value; allocated from the
+    // optimizer arena
+    typedef llvm::MutableArrayRef<Term> Terms;
     Terms m_span_terms;
     ExprTerms m_expr_terms;
 
-    long m_cur_val;
-    long m_new_val;
+    // Span value is m_span_terms[0] + m_dist_add.
+    bool m_dist;
+    int64_t m_dist_add;
+
+    int64_t m_cur_val;
+    int64_t m_new_val;
 
-    long m_neg_thres;
-    long m_pos_thres;
+    int64_t m_neg_thres;
+    int64_t m_pos_thres;
 
     int m_id;
 
     enum { INACTIVE = 0, ACTIVE, ON_Q } m_active;
 
-    // Spans that led to this span.  Used only for
-    // checking for circular references (cycles) with id=0 spans.
-    typedef llvm::SmallPtrSet<Span*, 4> BacktraceSpans;
-    BacktraceSpans m_backtrace;
+    // Span is in an independent section; recalculation may be deferred.
+    bool m_batchable;
+
+    // Terms have changed since the last recalculation; span is on the
+    // optimizer dirty list.
+    bool m_dirty;
+
+    // Span is to take its longest form at its next expansion.
+    bool m_long;
+
+    // Span was given its longest form by setLongSpans(); kept after its
+    // expansion for VerifyLongSpans().
+    bool m_seeded;
 
     // Index of first offset setter following this span's bytecode
     size_t m_os_index;
+
+    // Index of the independent section group this span belongs to
+    size_t m_group;
+};
+
+/// Changes in bytecode length, in the order they were made.
+typedef std::vector<std::pair<Bytecode*, int64_t> > GrowthLog;
+
+/// A span that took its longest form, with what's needed to explain why.
+struct ExplainedSpan
+{
+    Optimizer::LongSpanReason reason;
+
+    // Bytecode index ranges spanned by the terms of the value.
+    std::vector<std::pair<long, long> > ranges;
+
+    // Growth log (see Optimizer::Impl::m_growth_logs) and the number of
+    // its entries made before the expansion.
+    size_t log;
+    size_t log_end;
+};
+
+/// Step 2 state for a group of sections that can be relaxed independently
+/// of all other sections.
+class SpanGroup
+{
+public:
+    SpanGroup(DiagnosticsEngine& diags, long index)
+        : m_diags(diags),
+          m_index(index),
+          m_passes(0),
+          m_batching(false),
+          m_defer_recalc(false)
+    {}
+    ~SpanGroup() {}
+
+    DiagnosticsEngine& m_diags;
+
+    // Index of the independent section group, or -1 for all groups.
+    long m_index;
+
+    typedef std::deque<Span*> SpanQueue;
+    SpanQueue m_QA, m_QB;
+
+    // Number of QB batches processed so far.
+    unsigned int m_passes;
+
+    // Spans with changed terms awaiting recalculation.
+    std::vector<Span*> m_dirty;
+    bool m_batching;
+    bool m_defer_recalc;
+
+    // Growth of bytecodes and the spans that took their longest form, if
+    // explaining (see Optimizer::setExplain()).
+    GrowthLog m_growth;
+    std::vector<ExplainedSpan> m_explained;
+
+    // Index of the growth log for this group in Optimizer::Impl.
+    size_t getLog() const { return m_index < 0 ? 1 : m_index+1; }
+
+private:
+    SpanGroup(const SpanGroup&);                    // not implemented
+    const SpanGroup& operator=(const SpanGroup&);   // not implemented
+};
+
+/// A contiguous range of spans processed by a single job in steps 1b and
+/// 1d, with its own term arena and diagnostics.
+class SpanChunk
+{
+public:
+    SpanChunk(DiagnosticsEngine& diags,
+              llvm::BumpPtrAllocator& alloc,
+              size_t begin,
+              size_t end)
+        : m_diags(diags), m_alloc(alloc), m_begin(begin), m_end(end)
+    {}
+    ~SpanChunk() {}
+
+    DiagnosticsEngine& m_diags;
+    llvm::BumpPtrAllocator& m_alloc;
+
+    // Scratch term list reused by Span::CreateTerms().
+    std::vector<Span::Term> m_term_scratch;
+
+    // Indexes into the optimizer span list, [m_begin, m_end).
+    size_t m_begin;
+    size_t m_end;
+
+private:
+    SpanChunk(const SpanChunk&);                    // not implemented
+    const SpanChunk& operator=(const SpanChunk&);   // not implemented
 };
 } // anonymous namespace
 
@@ -288,30 +468,111 @@ public:
     Impl(DiagnosticsEngine& diags);
     ~Impl();
 
-    void Step1b();
-    bool Step1d();
+    void Step1b(unsigned int num_jobs);
+    bool Step1d(unsigned int num_jobs);
     void Step1e();
-    void Step2();
+    void Step2(unsigned int num_jobs);
 
 #ifdef WITH_XML
     pugi::xml_node Write(pugi::xml_node out) const;
 #endif // WITH_XML
 
+    typedef void (Impl::*ChunkFunc)(SpanChunk& chunk);
+    void RunChunks(unsigned int num_jobs, ChunkFunc func);
+    void RunChunk(ChunkFunc func, stdx::ptr_vector<SpanChunk>& chunks,
+                  size_t i);
+    void CreateTerms(SpanChunk& chunk);
+    void UpdateTerms(SpanChunk& chunk);
+    void RetireShortSpans();
     void ITreeAdd(Span& span, Span::Term& term);
-    void CheckCycle(IntervalTreeNode<Span::Term*> * node,
-                    Span& span);
-    void ExpandTerm(IntervalTreeNode<Span::Term*> * node, long len_diff);
+    void CheckCycles();
+    void ExpandTerm(SpanGroup& group, Span::Term* term, int64_t len_diff);
+    void ExpandTerms(SpanGroup& group, const Bytecode& bc,
+                     int64_t len_diff);
+    void ExpandSpan(SpanGroup& group, Span& span);
+    void ExplainSpan(const Span& span,
+                     int64_t neg_thres,
+                     int64_t pos_thres,
+                     size_t log,
+                     size_t log_end,
+                     std::vector<ExplainedSpan>& explained) const;
+    size_t SkipOffsetSetters(size_t i, int64_t diff) const;
+    void AddPendingShift(size_t i, int64_t diff);
+    int64_t getPendingShift(size_t i) const;
+    void ShiftOffsetSetters(size_t begin, size_t end, int64_t diff);
+    OffsetSetter& SettleOffsetSetter(size_t i);
+    void FlushDirty(SpanGroup& group);
+    void SetLongForms(SpanGroup& group);
+    bool getSpanIds(/*@out@*/ Optimizer::SpanIds* spans) const;
+    bool VerifyLongSpans();
+    void getLongSpans(/*@out@*/ Optimizer::SpanIds* spans) const;
+    void getLongSpanReasons(/*@out@*/ Optimizer::LongSpanReasons* reasons)
+        const;
+    void Relax(SpanGroup& group);
+    void RelaxGroup(stdx::ptr_vector<SpanGroup>& groups, size_t i);
 
     DiagnosticsEngine& m_diags;
 
-    typedef std::list<Span*> Spans;
-    Spans m_spans;      // ownership list
+    // Arena for spans and their terms; released all at once on destruction.
+    llvm::BumpPtrAllocator m_alloc;
+
+    // Additional term arenas for the jobs run in parallel by Step1b().
+    stdx::ptr_vector<llvm::BumpPtrAllocator> m_job_allocs;
+    stdx::ptr_vector_owner<llvm::BumpPtrAllocator> m_job_allocs_owner;
+
+    typedef std::vector<Span*> Spans;
+    Spans m_spans;      // ownership list (objects live in m_alloc)
+
+    // Per-span results of the jobs run by RunChunks(), indexed as m_spans:
+    // true if the span exceeded its thresholds.
+    std::vector<char> m_span_exceeded;
 
     typedef std::deque<Span*> SpanQueue;
     SpanQueue m_QA, m_QB;
 
-    IntervalTree<Span::Term*> m_itree;
+    IntervalIndex<Span::Term*> m_itree;
     std::vector<OffsetSetter> m_offset_setters;
+
+    // Offset changes not yet applied to offset setters: one Fenwick tree
+    // per run of offset setters (see OffsetSetter::m_run_begin), each in
+    // the part of the vector matching its run.  Keeping runs apart lets
+    // independent groups update them concurrently.
+    std::vector<int64_t> m_os_pending;
+
+    // Containers coupled by span terms (see Step1b).
+    Optimizer::Couplings m_couplings;
+
+    // Number of independent section groups (see Step1e).
+    size_t m_num_groups;
+
+    // Relaxation passes per group before spans take their longest form.
+    unsigned int m_max_passes;
+
+    // Spans to take their longest form in Step 1b (see setLongSpans()),
+    // sorted.
+    Optimizer::SpanIds m_seed;
+
+    // Spans from m_seed, after their expansion in Step 1b.
+    Spans m_seeded_spans;
+
+    // Spans that took their longest form in Step 1b.
+    Optimizer::SpanIds m_long_spans;
+
+    // Record why spans take their longest form (see setExplain()).
+    bool m_explain;
+
+    // Growth logs: Step 1b and 1c first, then one per group of Step 2.
+    std::vector<GrowthLog> m_growth_logs;
+
+    // Spans that took their longest form, if m_explain.
+    std::vector<ExplainedSpan> m_explained;
+
+    // No spans have been added in the current container (Step 1a), so
+    // offsets are still final.
+    bool m_fixed_offsets;
+
+    // Last offset setter not tracked due to m_fixed_offsets.
+    /*@null@*/ Bytecode* m_fixed_os;
 };
 } // namespace yasm
 
@@ -327,7 +588,7 @@ Span::Term::Term(unsigned int subst,
                  Location loc,
                  Location loc2,
                  Span* span,
-                 long new_val)
+                 int64_t new_val)
     : m_loc(loc),
       m_loc2(loc2),
       m_span(span),
@@ -355,18 +616,25 @@ Span::Term::Write(pugi::xml_node out) const
 Span::Span(Bytecode& bc,
            int id,
            /*@null@*/ const Value& value,
-           long neg_thres,
-           long pos_thres,
+           int64_t neg_thres,
+           int64_t pos_thres,
            size_t os_index)
     : m_bc(bc),
       m_depval(value),
+      m_dist(false),
+      m_dist_add(0),
       m_cur_val(0),
       m_new_val(0),
       m_neg_thres(neg_thres),
       m_pos_thres(pos_thres),
       m_id(id),
       m_active(ACTIVE),
-      m_os_index(os_index)
+      m_batchable(false),
+      m_dirty(false),
+      m_long(false),
+      m_seeded(false),
+      m_os_index(os_index),
+      m_group(0)
 {
     ++num_spans;
 }
@@ -375,41 +643,99 @@ void
 Optimizer::AddSpan(Bytecode& bc,
                    int id,
                    const Value& value,
-                   long neg_thres,
-                   long pos_thres)
+                   int64_t neg_thres,
+                   int64_t pos_thres)
 {
-    m_impl->m_spans.push_back(new Span(bc, id, value, neg_thres, pos_thres,
-                                       m_impl->m_offset_setters.size()-1));
+    // The preceding offset setter may depend on this bytecode's length
+    // (see ExpandSpan), so it needs to be tracked after all.
+    if (m_impl->m_fixed_offsets && m_impl->m_fixed_os)
+    {
+        m_impl->m_fixed_offsets = false;
+        AddOffsetSetter(*m_impl->m_fixed_os);
+    }
+    m_impl->m_fixed_offsets = false;
+    m_impl->m_fixed_os = 0;
+    void* mem = m_impl->m_alloc.Allocate<Span>();
+    m_impl->m_spans.push_back(new (mem) Span(bc, id, value, neg_thres,
+        pos_thres, m_impl->m_offset_setters.size()-1));
 }
 
 void
-Span::AddTerm(unsigned int subst, Location loc, Location loc2)
+Span::AddTerm(std::vector<Term>* terms,
+              unsigned int subst,
+              Location loc,
+              Location loc2)
 {
     IntNum intn;
     bool ok = CalcDist(loc, loc2, &intn);
     ok = ok;    // avoid warning due to assert usage
     assert(ok && "could not calculate bc distance");
 
-    if (subst >= m_span_terms.size())
-        m_span_terms.resize(subst+1);
-    m_span_terms[subst] = Term(subst, loc, loc2, this, intn.getInt());
+    if (subst >= terms->size())
+        terms->resize(subst+1);
+    (*terms)[subst] = Term(subst, loc, loc2, this, intn.getInt64());
+}
+
+// Determine if e is a lone substitution term, optionally added to an
+// integer.  If so, sets *add to the integer (or 0).
+static bool
+getDistAdd(const Expr& e, int64_t* add)
+{
+    const ExprTerms& terms = e.getTerms();
+    if (terms.size() == 1 && terms[0].isType(ExprTerm::SUBST))
+    {
+        *add = 0;
+        return true;
+    }
+    if (terms.size() != 3 || !terms[2].isOp(Op::ADD)
+        || terms[2].getNumChild() != 2)
+        return false;
+
+    const ExprTerm* intn;
+    if (terms[0].isType(ExprTerm::SUBST))
+        intn = &terms[1];
+    else if (terms[1].isType(ExprTerm::SUBST))
+        intn = &terms[0];
+    else
+        return false;
+    if (!intn->isType(ExprTerm::INT))
+        return false;
+    *add = intn->getIntNum()->getInt64();
+    return *add > INT64_MIN/2 && *add < INT64_MAX/2;   // leave room for dist
 }
 
 bool
-Span::CreateTerms(Optimizer::Impl* optimize, DiagnosticsEngine& diags)
+Span::CreateTerms(std::vector<Term>& scratch,
+                  llvm::BumpPtrAllocator& alloc,
+                  DiagnosticsEngine& diags)
 {
     // Split out sym-sym terms in absolute portion of dependent value
     if (m_depval.hasAbs())
     {
+        scratch.clear();
         SubstDist(*m_depval.getAbs(), diags,
-                  TR1::bind(&Span::AddTerm, this, _1, _2, _3));
-        if (m_span_terms.size() > 0)
+                  TR1::bind(&Span::AddTerm, this, &scratch, _1, _2, _3));
+        if (!scratch.empty())
         {
+            // Move terms into a single arena block; terms are referenced
+            // by pointer from the interval tree, so they must not move
+            // once created.
+            Term* terms = alloc.Allocate<Term>(scratch.size());
+            std::uninitialized_copy(scratch.begin(), scratch.end(), terms);
+            m_span_terms = Terms(terms, scratch.size());
+
+            // Check for single distance (+ constant), e.g. a jump.
+            if (m_span_terms.size() == 1)
+                m_dist = getDistAdd(*m_depval.getAbs(), &m_dist_add);
+            if (m_dist)
+                ++num_dist_spans;
+
             for (Terms::iterator i=m_span_terms.begin(),
                  end=m_span_terms.end(); i != end; ++i)
             {
                 // Create expression terms with dummy value
-                m_expr_terms.push_back(ExprTerm(0));
+                if (!m_dist)
+                    m_expr_terms.push_back(ExprTerm(0));
 
                 // Check for circular references
                 if (m_id <= 0 &&
@@ -436,8 +762,10 @@ Span::RecalcNormal(DiagnosticsEngine& diags)
     ++num_recalc;
     m_new_val = 0;
 
-    if (m_depval.isRelative())
-        m_new_val = LONG_MAX;       // too complex; force to longest form
+    if (m_long || m_depval.isRelative())
+        m_new_val = INT64_MAX;       // force to longest form
+    else if (m_dist)
+        m_new_val = m_span_terms.front().m_new_val + m_dist_add;
     else if (m_depval.hasAbs())
     {
         ExprTerm result;
@@ -449,12 +777,12 @@ Span::RecalcNormal(DiagnosticsEngine& diags)
         if (!Evaluate(*m_depval.getAbs(), diags, &result, m_expr_terms, false,
                       false)
             || !result.isType(ExprTerm::INT))
-            m_new_val = LONG_MAX;   // too complex; force to longest form
+            m_new_val = INT64_MAX;   // too complex; force to longest form
         else
-            m_new_val = result.getIntNum()->getInt();
+            m_new_val = result.getIntNum()->getInt64();
     }
 
-    if (m_new_val == LONG_MAX)
+    if (m_new_val == INT64_MAX)
         m_active = INACTIVE;
 
     DEBUG(llvm::errs() << "updated " << getName() << " newval to "
@@ -467,6 +795,24 @@ Span::RecalcNormal(DiagnosticsEngine& diags)
     return (m_new_val < m_neg_thres || m_new_val > m_pos_thres);
 }
 
+// Returns true if the span's bytecode has a longest form that it can be
+// expanded to directly, without calculating the span value.
+bool
+Span::hasLongForm() const
+{
+    uint64_t growth;
+    return m_id > 0 && m_bc.getMaxGrowth(&growth);
+}
+
+// Make the next expansion go to the longest form, after which the span is
+// no longer tracked.
+void
+Span::setLongForm()
+{
+    m_long = true;
+    ++num_long_forced;
+}
+
 Span::~Span()
 {
 }
@@ -515,11 +861,6 @@ Span::Write(pugi::xml_node out) const
         case ON_Q:      root.append_attribute("active") = "queued"; break;
     }
 
-    pugi::xml_node backtrace = root.append_child("Backtrace");
-    for (BacktraceSpans::const_iterator i=m_backtrace.begin(),
-         end=m_backtrace.end(); i != end; ++i)
-        (*i)->WriteRef(backtrace);
-
     root.append_attribute("os_index") = static_cast<unsigned long>(m_os_index);
     return root;
 }
@@ -535,7 +876,14 @@ Span::WriteRef(pugi::xml_node out) const
 #endif // WITH_XML
 
 Optimizer::Impl::Impl(DiagnosticsEngine& diags)
-    : m_diags(diags)
+    : m_diags(diags),
+      m_job_allocs_owner(m_job_allocs),
+      m_num_groups(1),
+      m_max_passes(UINT_MAX),
+      m_explain(false),
+      m_growth_logs(1),
+      m_fixed_offsets(false),
+      m_fixed_os(0)
 {
     // Create an placeholder offset setter for spans to point to; this will
     // get updated if/when we actually run into one.
@@ -544,11 +892,12 @@ Optimizer::Impl::Impl(DiagnosticsEngine& diags)
 
 Optimizer::Impl::~Impl()
 {
-    while (!m_spans.empty())
-    {
-        delete m_spans.back();
-        m_spans.pop_back();
-    }
+    // Memory is owned by m_alloc; only run the destructors.
+    for (Spans::iterator i=m_spans.begin(), end=m_spans.end(); i != end; ++i)
+        (*i)->~Span();
+    for (Spans::iterator i=m_seeded_spans.begin(), end=m_seeded_spans.end();
+         i != end; ++i)
+        (*i)->~Span();
 }
 
 #ifdef WITH_XML
@@ -577,9 +926,13 @@ Optimizer::Impl::Write(pugi::xml_node out) const
 
     // offset setters
     pugi::xml_node osetters = root.append_child("OffsetSetters");
-    for (std::vector<OffsetSetter>::const_iterator m=m_offset_setters.begin(),
-         end=m_offset_setters.end(); m != end; ++m)
-        append_data(osetters, *m);
+    for (size_t i=0; i<m_offset_setters.size(); ++i)
+    {
+        OffsetSetter os = m_offset_setters[i];
+        if (!m_os_pending.empty())
+            os.Shift(getPendingShift(i));
+        append_data(osetters, os);
+    }
 
     return root;
 }
@@ -588,20 +941,37 @@ Optimizer::Impl::Write(pugi::xml_node out) const
 void
 Optimizer::AddOffsetSetter(Bytecode& bc)
 {
+    // Nothing before it in the container can change length, so neither
+    // can it.
+    if (m_impl->m_fixed_offsets)
+    {
+        m_impl->m_fixed_os = &bc;
+        ++num_fixed_offset_setters;
+        return;
+    }
+
     // Remember it
     OffsetSetter& os = m_impl->m_offset_setters.back();
     os.m_bc = &bc;
     os.m_thres = bc.getNextOffset();
+    os.m_orig_len = bc.getTotalLen();
 
     // Create new placeholder
     m_impl->m_offset_setters.push_back(OffsetSetter());
 }
 
+void
+Optimizer::StartContainer()
+{
+    m_impl->m_fixed_offsets = true;
+    m_impl->m_fixed_os = 0;
+}
+
 void
 Optimizer::Impl::ITreeAdd(Span& span, Span::Term& term)
 {
     long precbc_index, precbc2_index;
-    unsigned long low, high;
+    long low, high;
 
     // Update term length
     if (term.m_loc.bc)
@@ -627,40 +997,160 @@ Optimizer::Impl::ITreeAdd(Span& span, Span::Term& term)
     else
         return;     // difference is same bc - always 0!
 
-    m_itree.Insert(static_cast<long>(low), static_cast<long>(high), &term);
+    m_itree.Insert(low, high, &term);
     ++num_itree;
 }
 
-void
-Optimizer::Impl::CheckCycle(IntervalTreeNode<Span::Term*> * node, Span& span)
+namespace {
+// IntervalIndex visitors for the term queries.
+class DependentSpansVisitor
+{
+public:
+    DependentSpansVisitor(const llvm::DenseMap<Span*, unsigned int>& nodes,
+                          std::vector<unsigned int>& edges)
+        : m_nodes(nodes), m_edges(edges)
+    {}
+    void operator() (Span::Term* term)
+    {
+        llvm::DenseMap<Span*, unsigned int>::const_iterator i =
+            m_nodes.find(term->m_span);
+        if (i != m_nodes.end())
+            m_edges.push_back(i->second);
+    }
+
+private:
+    const llvm::DenseMap<Span*, unsigned int>& m_nodes;
+    std::vector<unsigned int>& m_edges;
+};
+
+class ExpandTermVisitor
 {
-    Span::Term* term = node->getData();
-    Span* depspan = term->m_span;
+public:
+    ExpandTermVisitor(Optimizer::Impl& impl, SpanGroup& group,
+                      int64_t len_diff)
+        : m_impl(impl), m_group(group), m_len_diff(len_diff)
+    {}
+    void operator() (Span::Term* term)
+    { m_impl.ExpandTerm(m_group, term, m_len_diff); }
 
-    // Only check for cycles in id=0 spans
-    if (depspan->m_id > 0)
-        return;
+private:
+    Optimizer::Impl& m_impl;
+    SpanGroup& m_group;
+    int64_t m_len_diff;
+};
+} // anonymous namespace
 
-    // Check for a circular reference by looking to see if this dependent
-    // span is in our backtrace.
-    if (span.m_backtrace.count(depspan))
+// Look for cycles in times expansion (span.id<=0).  The length of such a
+// span's bytecode can change the value of every id<=0 span with a term
+// across it, and vice versa; a strongly connected component of this
+// dependency graph (found with Tarjan's algorithm) is a circular reference.
+void
+Optimizer::Impl::CheckCycles()
+{
+    // Number the nodes in span order.
+    std::vector<Span*> spans;
+    llvm::DenseMap<Span*, unsigned int> nodes;
+    for (Spans::iterator spani=m_spans.begin(), endspan=m_spans.end();
+         spani != endspan; ++spani)
     {
-        m_diags.Report(span.m_bc.getSource(),
-                       diag::err_optimizer_circular_reference);
+        if ((*spani)->m_id > 0)
+            continue;
+        nodes[*spani] = spans.size();
+        spans.push_back(*spani);
+    }
+    size_t n = spans.size();
+    if (n == 0)
         return;
+
+    // Edges from each node to the nodes that depend on its length.
+    std::vector<size_t> edge_begin(n+1);
+    std::vector<unsigned int> edges;
+    DependentSpansVisitor visit(nodes, edges);
+    for (size_t i=0; i<n; ++i)
+    {
+        edge_begin[i] = edges.size();
+        long index = static_cast<long>(spans[i]->m_bc.getIndex());
+        m_itree.Enumerate(index, index, visit);
     }
+    edge_begin[n] = edges.size();
+
+    // Iterative Tarjan SCC.
+    const unsigned int UNVISITED = ~0U;
+    std::vector<unsigned int> order(n, UNVISITED), lowlink(n);
+    std::vector<bool> on_stack(n, false);
+    std::vector<unsigned int> stack;
+    std::vector<std::pair<unsigned int, size_t> > call;   // node, next edge
+    std::vector<unsigned int> members;
+    unsigned int next_order = 0;
+
+    for (unsigned int root=0; root<n; ++root)
+    {
+        if (order[root] != UNVISITED)
+            continue;
+        call.push_back(std::make_pair(root, edge_begin[root]));
+        order[root] = lowlink[root] = next_order++;
+        stack.push_back(root);
+        on_stack[root] = true;
+
+        while (!call.empty())
+        {
+            unsigned int v = call.back().first;
+            size_t& e = call.back().second;
+            if (e < edge_begin[v+1])
+            {
+                unsigned int w = edges[e++];
+                if (order[w] == UNVISITED)
+                {
+                    order[w] = lowlink[w] = next_order++;
+                    stack.push_back(w);
+                    on_stack[w] = true;
+                    call.push_back(std::make_pair(w, edge_begin[w]));
+                }
+                else if (on_stack[w] && order[w] < lowlink[v])
+                    lowlink[v] = order[w];
+                continue;
+            }
+
+            call.pop_back();
+            if (!call.empty())
+            {
+                unsigned int u = call.back().first;
+                if (lowlink[v] < lowlink[u])
+                    lowlink[u] = lowlink[v];
+            }
+            if (lowlink[v] != order[v])
+                continue;
 
-    // Add our complete backtrace and ourselves to backtrace of dependent
-    // span.
-    depspan->m_backtrace.insert(span.m_backtrace.begin(),
-                                span.m_backtrace.end());
-    depspan->m_backtrace.insert(&span);
+            // v is the root of a component; pop it off.
+            members.clear();
+            unsigned int w;
+            do
+            {
+                w = stack.back();
+                stack.pop_back();
+                on_stack[w] = false;
+                members.push_back(w);
+            } while (w != v);
+            if (members.size() == 1)
+                continue;   // self-references are caught in CreateTerms()
+
+            // Report at the first member, noting the others.
+            std::sort(members.begin(), members.end());
+            m_diags.Report(spans[members.front()]->m_bc.getSource(),
+                           diag::err_optimizer_circular_reference);
+            for (std::vector<unsigned int>::iterator i=members.begin()+1,
+                 end=members.end(); i != end; ++i)
+                m_diags.Report(spans[*i]->m_bc.getSource(),
+                               diag::note_optimizer_circular_member);
+        }
+    }
 }
 
 void
-Optimizer::Impl::ExpandTerm(IntervalTreeNode<Span::Term*> * node, long len_diff)
+Optimizer::Impl::ExpandTerm(SpanGroup& group,
+                            Span::Term* term,
+                            int64_t len_diff)
 {
-    Span::Term* term = node->getData();
     Span* span = term->m_span;
     long precbc_index, precbc2_index;
 
@@ -697,8 +1187,20 @@ Optimizer::Impl::ExpandTerm(IntervalTreeNode<Span::Term*> * node, long len_diff)
         return;
     }
 
+    // When batching, defer recalculation until the end of the batch.
+    if (group.m_defer_recalc && span->m_batchable && span->m_id > 0)
+    {
+        if (!span->m_dirty)
+        {
+            span->m_dirty = true;
+            group.m_dirty.push_back(span);
+            ++num_deferred_recalc;
+        }
+        return;
+    }
+
     // Update term and check against thresholds
-    if (!span->RecalcNormal(m_diags))
+    if (!span->RecalcNormal(group.m_diags))
     {
         DEBUG(llvm::errs() << span->getName()
               << " didn't change, not readded\n");
@@ -708,29 +1210,165 @@ Optimizer::Impl::ExpandTerm(IntervalTreeNode<Span::Term*> * node, long len_diff)
     // Exceeded thresholds, need to add to Q for expansion
     DEBUG(llvm::errs() << span->getName() << " added back on queue\n");
     if (span->m_id <= 0)
-        m_QA.push_back(span);
+        group.m_QA.push_back(span);
     else
-        m_QB.push_back(span);
+        group.m_QB.push_back(span);
     span->m_active = Span::ON_Q;    // Mark as being in Q
 }
 
+// Minimum number of spans given to each job by RunChunks().
+static const size_t MIN_CHUNK_SPANS = 256;
+
+void
+Optimizer::Impl::RunChunk(ChunkFunc func,
+                          stdx::ptr_vector<SpanChunk>& chunks,
+                          size_t i)
+{
+    (this->*func)(chunks[i]);
+}
+
+// Run func over m_spans, split into chunks that may run concurrently.
+// Results are saved per span in m_span_exceeded and diagnostics are
+// replayed in span order, so the outcome doesn't depend on num_jobs.
+void
+Optimizer::Impl::RunChunks(unsigned int num_jobs, ChunkFunc func)
+{
+    size_t nspans = m_spans.size();
+    m_span_exceeded.assign(nspans, 0);
+
+    unsigned int num_threads =
+        num_jobs == 0 ? ThreadPool::getNumProcessors() : num_jobs;
+    if (num_threads <= 1 || nspans < 2*MIN_CHUNK_SPANS)
+    {
+        SpanChunk chunk(m_diags, m_alloc, 0, nspans);
+        (this->*func)(chunk);
+        return;
+    }
+
+    // Use several chunks per thread so threads that finish early can
+    // pick up the remaining ones.
+    size_t chunk_spans = nspans / (8*num_threads);
+    if (chunk_spans < MIN_CHUNK_SPANS)
+        chunk_spans = MIN_CHUNK_SPANS;
+
+    // The diagnostic engines must be created here as DiagnosticIDs is not
+    // reference counted in a thread-safe manner.
+    stdx::ptr_vector<DiagnosticBuffer> chunk_diags;
+    stdx::ptr_vector_owner<DiagnosticBuffer> chunk_diags_owner(chunk_diags);
+    stdx::ptr_vector<SpanChunk> chunks;
+    stdx::ptr_vector_owner<SpanChunk> chunks_owner(chunks);
+    for (size_t begin=0; begin<nspans; begin+=chunk_spans)
+    {
+        size_t end = std::min(begin+chunk_spans, nspans);
+        // Terms must outlive the chunk, so each job gets its own arena.
+        m_job_allocs.push_back(new llvm::BumpPtrAllocator);
+        chunk_diags.push_back(new DiagnosticBuffer(m_diags));
+        chunks.push_back(new SpanChunk(chunk_diags.back().getDiagnostics(),
+                                       m_job_allocs.back(), begin, end));
+    }
+
+    ThreadPool pool(num_threads);
+    pool.Run(chunks.size(), TR1::bind(&Optimizer::Impl::RunChunk, this,
+                                      func, TR1::ref(chunks), _1));
+
+    for (size_t i=0; i<chunk_diags.size(); ++i)
+        chunk_diags[i].Replay(m_diags);
+}
+
+void
+Optimizer::Impl::CreateTerms(SpanChunk& chunk)
+{
+    for (size_t i=chunk.m_begin; i<chunk.m_end; ++i)
+    {
+        Span* span = m_spans[i];
+        if (!m_seed.empty() && span->hasLongForm()
+            && std::binary_search(m_seed.begin(), m_seed.end(),
+                   Optimizer::SpanIds::value_type(&span->m_bc, span->m_id)))
+        {
+            span->m_seeded = true;
+            ++num_long_seeded;
+        }
+        if ((m_max_passes == 0 || span->m_seeded) && span->hasLongForm())
+        {
+            // No relaxation; the terms aren't needed.
+            span->setLongForm();
+            span->RecalcNormal(chunk.m_diags);
+            m_span_exceeded[i] = 1;
+            continue;
+        }
+        if (span->CreateTerms(chunk.m_term_scratch, chunk.m_alloc,
+                              chunk.m_diags) &&
+            span->RecalcNormal(chunk.m_diags))
+            m_span_exceeded[i] = 1;
+    }
+}
+
 void
-Optimizer::Impl::Step1b()
+Optimizer::Impl::Step1b(unsigned int num_jobs)
 {
-    Spans::iterator spani = m_spans.begin();
-    while (spani != m_spans.end())
+    // Terms are created independently for each span; expansion may touch
+    // bytecodes shared between spans, so it's done afterwards in order.
+    RunChunks(num_jobs, &Optimizer::Impl::CreateTerms);
+
+    // Note containers coupled by terms before any spans are retired.
+    for (Spans::iterator spani=m_spans.begin(), endspan=m_spans.end();
+         spani != endspan; ++spani)
+    {
+        Span* span = *spani;
+        const BytecodeContainer* container = span->m_bc.getContainer();
+        for (Span::Terms::iterator term=span->m_span_terms.begin(),
+             endterm=span->m_span_terms.end(); term != endterm; ++term)
+        {
+            Bytecode* bcs[2] = {term->m_loc.bc, term->m_loc2.bc};
+            for (int i=0; i<2; ++i)
+            {
+                if (bcs[i] && bcs[i]->getContainer() != container)
+                    m_couplings.push_back(
+                        std::make_pair(container, bcs[i]->getContainer()));
+            }
+        }
+    }
+    std::sort(m_couplings.begin(), m_couplings.end());
+    m_couplings.erase(std::unique(m_couplings.begin(), m_couplings.end()),
+                      m_couplings.end());
+
+    // Compact m_spans in place as spans are retired.
+    Spans::iterator spani = m_spans.begin(), outi = m_spans.begin();
+    std::vector<char>::const_iterator exceededi = m_span_exceeded.begin();
+    for (; spani != m_spans.end(); ++spani, ++exceededi)
     {
         Span* span = *spani;
-        if (span->CreateTerms(this, m_diags) && span->RecalcNormal(m_diags))
+        if (*exceededi)
         {
+            // Keep the thresholds of the shortest form of seeded spans.
             bool still_depend = false;
+            int64_t neg_thres = span->m_neg_thres;
+            int64_t pos_thres = span->m_pos_thres;
+            uint64_t orig_len = span->m_bc.getTotalLen();
             if (!span->m_bc.Expand(span->m_id, span->m_cur_val, span->m_new_val,
-                                   &still_depend, &span->m_neg_thres,
-                                   &span->m_pos_thres, m_diags))
+                                   &still_depend, &neg_thres, &pos_thres,
+                                   m_diags))
             {
+                span->~Span();
                 continue; // error
             }
-            else if (still_depend)
+            if (m_explain)
+            {
+                int64_t len_diff = span->m_bc.getTotalLen() - orig_len;
+                if (len_diff != 0)
+                    m_growth_logs[0].push_back(
+                        std::make_pair(&span->m_bc, len_diff));
+                // Values are at minimum lengths, so no growth is involved.
+                if (!still_depend && span->hasLongForm())
+                    ExplainSpan(*span, span->m_neg_thres, span->m_pos_thres,
+                                0, 0, m_explained);
+            }
+            if (!span->m_seeded)
+            {
+                span->m_neg_thres = neg_thres;
+                span->m_pos_thres = pos_thres;
+            }
+            if (still_depend)
             {
                 if (span->m_active == Span::INACTIVE)
                 {
@@ -740,26 +1378,32 @@ Optimizer::Impl::Step1b()
             }
             else
             {
-                delete *spani;
-                spani = m_spans.erase(spani);
+                if (span->hasLongForm())
+                    m_long_spans.push_back(
+                        std::make_pair(&span->m_bc, span->m_id));
+                if (span->m_seeded)
+                    m_seeded_spans.push_back(span);
+                else
+                    span->~Span();
                 continue;
             }
         }
         DEBUG(llvm::errs() << "updated " << span->getName() << " curval from "
               << span->m_cur_val << " to " << span->m_new_val << '\n');
         span->m_cur_val = span->m_new_val;
-        ++spani;
+        *outi++ = span;
     }
+    m_spans.erase(outi, m_spans.end());
+    m_span_exceeded.clear();
 }
 
-bool
-Optimizer::Impl::Step1d()
+void
+Optimizer::Impl::UpdateTerms(SpanChunk& chunk)
 {
-    for (Spans::iterator spani=m_spans.begin(), endspan=m_spans.end();
-         spani != endspan; ++spani)
+    for (size_t i=chunk.m_begin; i<chunk.m_end; ++i)
     {
         ++num_step1d;
-        Span* span = *spani;
+        Span* span = m_spans[i];
 
         // Update span terms based on new bc offsets
         for (Span::Terms::iterator term=span->m_span_terms.begin(),
@@ -770,181 +1414,821 @@ Optimizer::Impl::Step1d()
             ok = ok;    // avoid warning due to assert usage
             assert(ok && "could not calculate bc distance");
             term->m_cur_val = term->m_new_val;
-            term->m_new_val = intn.getInt();
+            term->m_new_val = intn.getInt64();
             DEBUG(llvm::errs() << "updated " << span->getName() << " term "
                   << (term-span->m_span_terms.begin())
                   << " newval to " << term->m_new_val << '\n');
         }
 
-        if (span->RecalcNormal(m_diags))
+        if (span->RecalcNormal(chunk.m_diags))
+            m_span_exceeded[i] = 1;
+    }
+}
+
+bool
+Optimizer::Impl::Step1d(unsigned int num_jobs)
+{
+    RunChunks(num_jobs, &Optimizer::Impl::UpdateTerms);
+
+    for (size_t i=0, end=m_spans.size(); i<end; ++i)
+    {
+        if (m_span_exceeded[i])
         {
             // Exceeded threshold, add span to QB
-            m_QB.push_back(&(*span));
+            Span* span = m_spans[i];
+            m_QB.push_back(span);
             span->m_active = Span::ON_Q;
             ++num_initial_qb;
         }
     }
+    m_span_exceeded.clear();
 
     // Do we need step 2?  If not, go ahead and exit.
-    return m_QB.empty();
+    if (m_QB.empty())
+        return true;
+
+    RetireShortSpans();
+    return false;
+}
+
+namespace {
+// Maximum growth of a bytecode that may still change length in step 2.
+// After RetireShortSpans() sorts and accumulates them, max and nunbound
+// are running totals over all bytecodes up to and including this one.
+struct Growth
+{
+    unsigned long index;        // bytecode index
+    uint64_t max;               // maximum growth in bytes
+    unsigned long nunbound;     // 1 if growth is unbounded
+};
+
+inline bool
+operator<(const Growth& lhs, const Growth& rhs)
+{
+    return lhs.index < rhs.index;
+}
+
+inline bool
+operator==(const Growth& lhs, const Growth& rhs)
+{
+    return lhs.index == rhs.index;
+}
+
+inline bool
+operator<(const Growth& lhs, unsigned long rhs)
+{
+    return lhs.index < rhs;
+}
+} // anonymous namespace
+
+// Get the total growth of the bytecodes with index in [low, high].
+// Returns false if it's unbounded.
+static bool
+SumGrowth(const std::vector<Growth>& growth,
+          unsigned long low,
+          unsigned long high,
+          uint64_t* sum)
+{
+    std::vector<Growth>::const_iterator first =
+        std::lower_bound(growth.begin(), growth.end(), low);
+    std::vector<Growth>::const_iterator last =
+        std::lower_bound(first, growth.end(), high+1);
+    if (first == last)
+    {
+        *sum = 0;
+        return true;
+    }
+    --last;
+    if (first == growth.begin())
+    {
+        *sum = last->max;
+        return last->nunbound == 0;
+    }
+    --first;
+    *sum = last->max - first->max;
+    return last->nunbound == first->nunbound;
 }
 
+// Retire distance spans that stay within their thresholds even if every
+// bytecode they cross grows to its maximum length.
 void
-Optimizer::Impl::Step1e()
+Optimizer::Impl::RetireShortSpans()
 {
-    // Update offset-setters values
+    // Only bytecodes with an active span or tracked offset setters can
+    // change length.  Offset setters can move by any amount.
+    std::vector<Growth> growth;
+    growth.reserve(m_spans.size() + m_offset_setters.size());
+    for (Spans::iterator spani=m_spans.begin(), endspan=m_spans.end();
+         spani != endspan; ++spani)
+    {
+        Growth g = {(*spani)->m_bc.getIndex(), 0, 0};
+        if (!(*spani)->m_bc.getMaxGrowth(&g.max))
+            g.nunbound = 1;
+        growth.push_back(g);
+    }
     for (std::vector<OffsetSetter>::iterator os=m_offset_setters.begin(),
          osend=m_offset_setters.end(); os != osend; ++os)
     {
         if (!os->m_bc)
             continue;
-        os->m_thres = os->m_bc->getNextOffset();
-        os->m_new_val = os->m_bc->getOffset() + os->m_bc->getFixedLen();
-        os->m_cur_val = os->m_new_val;
-        ++num_offset_setters;
+        Growth g = {os->m_bc->getIndex(), 0, 1};
+        growth.push_back(g);
     }
 
-    // Build up interval tree
-    for (Spans::iterator spani=m_spans.begin(), endspan=m_spans.end();
-         spani != endspan; ++spani)
+    // Several spans may share a bytecode; count its growth once.
+    std::sort(growth.begin(), growth.end());
+    growth.erase(std::unique(growth.begin(), growth.end()), growth.end());
+    for (std::vector<Growth>::iterator i=growth.begin(), end=growth.end();
+         i != end; ++i)
     {
-        Span* span = *spani;
-        for (Span::Terms::iterator term=span->m_span_terms.begin(),
-             endterm=span->m_span_terms.end(); term != endterm; ++term)
-            ITreeAdd(*span, *term);
+        if (i == growth.begin())
+            continue;
+        i->max += (i-1)->max;
+        i->nunbound += (i-1)->nunbound;
     }
 
-    // Look for cycles in times expansion (span.id==0)
+    Spans::iterator outi = m_spans.begin();
     for (Spans::iterator spani=m_spans.begin(), endspan=m_spans.end();
          spani != endspan; ++spani)
     {
         Span* span = *spani;
-        if (span->m_id > 0)
+        if (span->m_active != Span::ACTIVE || !span->m_dist || span->m_id <= 0)
+        {
+            *outi++ = span;
             continue;
-        m_itree.Enumerate(static_cast<long>(span->m_bc.getIndex()),
-                          static_cast<long>(span->m_bc.getIndex()),
-                          TR1::bind(&Optimizer::Impl::CheckCycle, this, _1,
-                                    TR1::ref(*span)));
-    }
-}
-
-void
-Optimizer::Impl::Step2()
-{
-    DEBUG(DumpXml(*this));
-
-    while (!m_QA.empty() || !m_QB.empty())
-    {
-        Span* span;
+        }
 
-        // QA is for TIMES, update those first, then update non-TIMES.
-        // This is so that TIMES can absorb increases before we look at
-        // expanding non-TIMES BCs.
-        if (!m_QA.empty())
+        // Same bytecode range as ITreeAdd().
+        const Span::Term& term = span->m_span_terms.front();
+        long precbc_index = term.m_loc.bc ? term.m_loc.bc->getIndex()
+                                          : span->m_bc.getIndex()-1;
+        long precbc2_index = term.m_loc2.bc ? term.m_loc2.bc->getIndex()
+                                            : span->m_bc.getIndex()-1;
+        uint64_t max = 0;
+        if (precbc_index != precbc2_index
+            && !SumGrowth(growth, std::min(precbc_index, precbc2_index),
+                          std::max(precbc_index, precbc2_index)-1, &max))
         {
-            span = m_QA.front();
-            m_QA.pop_front();
+            *outi++ = span;
+            continue;
         }
+
+        // Growth moves the value away from zero, in the direction of the
+        // term.
+        int64_t low = span->m_new_val, high = span->m_new_val;
+        if (precbc_index < precbc2_index)
+            high += static_cast<int64_t>(max);
         else
+            low -= static_cast<int64_t>(max);
+        if (low < span->m_neg_thres || high > span->m_pos_thres)
         {
-            span = m_QB.front();
-            m_QB.pop_front();
-        }
-
-        if (span->m_active == Span::INACTIVE)
+            *outi++ = span;
             continue;
-        span->m_active = Span::ACTIVE;  // no longer in Q
+        }
 
-        // Make sure we ended up ultimately exceeding thresholds; due to
-        // offset BCs we may have been placed on Q and then reduced in size
-        // again.
-        if (!span->RecalcNormal(m_diags))
-            continue;
+        DEBUG(llvm::errs() << span->getName() << " retired: short for growth "
+              << max << '\n');
+        ++num_short_retired;
+        span->~Span();
+    }
+    m_spans.erase(outi, m_spans.end());
+}
 
-        ++num_expansions;
+// Find the root of the union-find group for a container, adding the
+// container as its own group if it has not been seen before.
+static size_t
+FindGroup(std::vector<size_t>& parent,
+          llvm::DenseMap<const BytecodeContainer*, size_t>& container_index,
+          const BytecodeContainer* container)
+{
+    std::pair<llvm::DenseMap<const BytecodeContainer*, size_t>::iterator,
+              bool> ins = container_index.insert(
+                  std::make_pair(container, parent.size()));
+    if (ins.second)
+    {
+        parent.push_back(parent.size());
+        return parent.size()-1;
+    }
 
-        unsigned long orig_len = span->m_bc.getTotalLen();
+    size_t root = ins.first->second;
+    while (parent[root] != root)
+    {
+        parent[root] = parent[parent[root]];    // path halving
+        root = parent[root];
+    }
+    return root;
+}
 
-        bool still_depend = false;
-        if (!span->m_bc.Expand(span->m_id, span->m_cur_val, span->m_new_val,
-                               &still_depend, &span->m_neg_thres,
-                               &span->m_pos_thres, m_diags))
-        {
-            // error
+void
+Optimizer::Impl::Step1e()
+{
+    // Update offset-setters values
+    for (std::vector<OffsetSetter>::iterator os=m_offset_setters.begin(),
+         osend=m_offset_setters.end(); os != osend; ++os)
+    {
+        if (!os->m_bc)
             continue;
+        os->m_thres = os->m_bc->getNextOffset();
+        if (m_explain && os->m_bc->getTotalLen() != os->m_orig_len)
+            m_growth_logs[0].push_back(std::make_pair(os->m_bc,
+                static_cast<int64_t>(os->m_bc->getTotalLen() -
+                                     os->m_orig_len)));
+        os->m_new_val = os->m_bc->getOffset() + os->m_bc->getFixedLen();
+        os->m_cur_val = os->m_new_val;
+        if (!os->m_bc->getOffsetPeriod(&os->m_period))
+            os->m_period = UINT64_MAX;
+        ++num_offset_setters;
+    }
+
+    // Find the runs of offset setters in the same container, and for each
+    // setter the next one in its run with a longer period.
+    size_t num_os = m_offset_setters.size();
+    m_os_pending.assign(num_os, 0);
+    std::vector<size_t> longer;
+    for (size_t begin=0, end; begin<num_os; begin=end)
+    {
+        const Bytecode* bc = m_offset_setters[begin].m_bc;
+        end = begin+1;
+        while (bc && end < num_os && m_offset_setters[end].m_bc
+               && m_offset_setters[end].m_bc->getContainer()
+                  == bc->getContainer())
+            ++end;
+
+        longer.clear();
+        for (size_t i=end; i-- > begin; )
+        {
+            OffsetSetter& os = m_offset_setters[i];
+            os.m_run_begin = begin;
+            os.m_run_end = end;
+            while (!longer.empty()
+                   && m_offset_setters[longer.back()].m_period <= os.m_period)
+                longer.pop_back();
+            os.m_next_longer = longer.empty() ? end : longer.back();
+            longer.push_back(i);
         }
-        else if (still_depend)
+    }
+
+    // Find sections that are not independent: those containing
+    // offset-setters, and those connected to another section by a span term.
+    std::vector<const BytecodeContainer*> coupled;
+    for (std::vector<OffsetSetter>::iterator os=m_offset_setters.begin(),
+         osend=m_offset_setters.end(); os != osend; ++os)
+    {
+        if (os->m_bc)
+            coupled.push_back(os->m_bc->getContainer());
+    }
+    for (Spans::iterator spani=m_spans.begin(), endspan=m_spans.end();
+         spani != endspan; ++spani)
+    {
+        Span* span = *spani;
+        const BytecodeContainer* container = span->m_bc.getContainer();
+        for (Span::Terms::iterator term=span->m_span_terms.begin(),
+             endterm=span->m_span_terms.end(); term != endterm; ++term)
         {
-            // another threshold, keep active
-            for (Span::Terms::iterator term=span->m_span_terms.begin(),
-                 endterm=span->m_span_terms.end(); term != endterm; ++term)
-                term->m_cur_val = term->m_new_val;
-            DEBUG(llvm::errs() << "updated " << span->getName()
-                  << " curval from " << span->m_cur_val << " to "
-                  << span->m_new_val << '\n');
-            span->m_cur_val = span->m_new_val;
+            Bytecode* bcs[2] = {term->m_loc.bc, term->m_loc2.bc};
+            for (int i=0; i<2; ++i)
+            {
+                if (bcs[i] && bcs[i]->getContainer() != container)
+                {
+                    coupled.push_back(container);
+                    coupled.push_back(bcs[i]->getContainer());
+                }
+            }
         }
-        else
-            span->m_active = Span::INACTIVE;    // we're done with this span
-
-        long len_diff = span->m_bc.getTotalLen() - orig_len;
-        if (len_diff == 0)
-            continue;   // didn't increase in size
-
-        DEBUG(llvm::errs() << "BC@" << &span->m_bc << " ("
-              << span->m_bc.getIndex() << ") expansion by "
-              << len_diff << ":\n");
-        // Iterate over all spans dependent across the bc just expanded
-        m_itree.Enumerate(static_cast<long>(span->m_bc.getIndex()),
-                          static_cast<long>(span->m_bc.getIndex()),
-                          TR1::bind(&Optimizer::Impl::ExpandTerm, this, _1,
-                                    len_diff));
-
-        // Iterate over offset-setters that follow the bc just expanded.
-        // Stop iteration if:
-        //  - no more offset-setters in this section
-        //  - offset-setter didn't move its following offset
-        std::vector<OffsetSetter>::iterator os =
-            m_offset_setters.begin() + span->m_os_index;
-        long offset_diff = len_diff;
-        while (os != m_offset_setters.end()
-               && os->m_bc
-               && os->m_bc->getContainer() == span->m_bc.getContainer()
-               && offset_diff != 0)
+    }
+    std::sort(coupled.begin(), coupled.end());
+    for (Spans::iterator spani=m_spans.begin(), endspan=m_spans.end();
+         spani != endspan; ++spani)
+    {
+        Span* span = *spani;
+        span->m_batchable = !std::binary_search(coupled.begin(), coupled.end(),
+                                                span->m_bc.getContainer());
+    }
+
+    // Partition sections into groups connected by span terms (union-find).
+    llvm::DenseMap<const BytecodeContainer*, size_t> container_index;
+    std::vector<size_t> parent;
+    for (Spans::iterator spani=m_spans.begin(), endspan=m_spans.end();
+         spani != endspan; ++spani)
+    {
+        Span* span = *spani;
+        size_t root = FindGroup(parent, container_index,
+                                span->m_bc.getContainer());
+        for (Span::Terms::iterator term=span->m_span_terms.begin(),
+             endterm=span->m_span_terms.end(); term != endterm; ++term)
         {
-            unsigned long old_next_offset =
-                os->m_cur_val + os->m_bc->getTotalLen();
+            Bytecode* bcs[2] = {term->m_loc.bc, term->m_loc2.bc};
+            for (int i=0; i<2; ++i)
+            {
+                if (!bcs[i])
+                    continue;
+                size_t other = FindGroup(parent, container_index,
+                                         bcs[i]->getContainer());
+                if (other != root)
+                {
+                    // Keep the lowest (first seen) index as the root.
+                    if (other < root)
+                        std::swap(root, other);
+                    parent[other] = root;
+                }
+            }
+        }
+    }
+
+    // Number the groups in section order.
+    std::vector<size_t> group_num(parent.size(), parent.size());
+    m_num_groups = 0;
+    for (Spans::iterator spani=m_spans.begin(), endspan=m_spans.end();
+         spani != endspan; ++spani)
+    {
+        Span* span = *spani;
+        size_t root = FindGroup(parent, container_index,
+                                span->m_bc.getContainer());
+        if (group_num[root] == parent.size())
+            group_num[root] = m_num_groups++;
+        span->m_group = group_num[root];
+    }
+    num_groups += m_num_groups;
 
-            assert((offset_diff >= 0 ||
-                    static_cast<unsigned long>(-offset_diff) <= os->m_new_val)
-                   && "org/align went to negative offset");
-            os->m_new_val += offset_diff;
+    // Build up interval tree
+    for (Spans::iterator spani=m_spans.begin(), endspan=m_spans.end();
+         spani != endspan; ++spani)
+    {
+        Span* span = *spani;
+        for (Span::Terms::iterator term=span->m_span_terms.begin(),
+             endterm=span->m_span_terms.end(); term != endterm; ++term)
+            ITreeAdd(*span, *term);
+    }
+    m_itree.Build();
+    if (m_itree.size() > num_itree_max)
+        num_itree_max = static_cast<unsigned int>(m_itree.size());
+
+    CheckCycles();
+}
 
-            orig_len = os->m_bc->getTailLen();
+// Expand the terms of all spans across a bytecode whose length changed.
+void
+Optimizer::Impl::ExpandTerms(SpanGroup& group,
+                             const Bytecode& bc,
+                             int64_t len_diff)
+{
+    ExpandTermVisitor visit(*this, group, len_diff);
+    m_itree.Enumerate(static_cast<long>(bc.getIndex()),
+                      static_cast<long>(bc.getIndex()), visit);
+}
+
+void
+Optimizer::Impl::ExpandSpan(SpanGroup& group, Span& span)
+{
+    if (span.m_active == Span::INACTIVE)
+        return;
+    span.m_active = Span::ACTIVE;  // no longer in Q
+
+    // Make sure we ended up ultimately exceeding thresholds; due to
+    // offset BCs we may have been placed on Q and then reduced in size
+    // again.
+    if (!span.RecalcNormal(group.m_diags))
+        return;
+
+    ++num_expansions;
+
+    uint64_t orig_len = span.m_bc.getTotalLen();
+    int64_t orig_neg_thres = span.m_neg_thres;
+    int64_t orig_pos_thres = span.m_pos_thres;
+
+    bool still_depend = false;
+    if (!span.m_bc.Expand(span.m_id, span.m_cur_val, span.m_new_val,
+                          &still_depend, &span.m_neg_thres,
+                          &span.m_pos_thres, group.m_diags))
+    {
+        // error
+        return;
+    }
+    else if (still_depend)
+    {
+        // another threshold, keep active
+        for (Span::Terms::iterator term=span.m_span_terms.begin(),
+             endterm=span.m_span_terms.end(); term != endterm; ++term)
+            term->m_cur_val = term->m_new_val;
+        DEBUG(llvm::errs() << "updated " << span.getName()
+              << " curval from " << span.m_cur_val << " to "
+              << span.m_new_val << '\n');
+        span.m_cur_val = span.m_new_val;
+    }
+    else
+    {
+        span.m_active = Span::INACTIVE;    // we're done with this span
+        if (m_explain && span.hasLongForm())
+            ExplainSpan(span, orig_neg_thres, orig_pos_thres, group.getLog(),
+                        group.m_growth.size(), group.m_explained);
+    }
+
+    int64_t len_diff = span.m_bc.getTotalLen() - orig_len;
+    if (len_diff == 0)
+        return;     // didn't increase in size
+    if (m_explain)
+        group.m_growth.push_back(std::make_pair(&span.m_bc, len_diff));
+
+    DEBUG(llvm::errs() << "BC@" << &span.m_bc << " ("
+          << span.m_bc.getIndex() << ") expansion by "
+          << len_diff << ":\n");
+    // Iterate over all spans dependent across the bc just expanded
+    group.m_defer_recalc = group.m_batching && span.m_batchable;
+    ExpandTerms(group, span.m_bc, len_diff);
+
+    // The offset setter preceding the bc just expanded may also depend on
+    // the length of the following bytecodes (e.g. padding to keep a branch
+    // from crossing a boundary); give it a chance to update at its current
+    // offset.
+    if (span.m_os_index > 0)
+    {
+        OffsetSetter& prev = SettleOffsetSetter(span.m_os_index-1);
+        if (prev.m_bc
+            && prev.m_bc->getContainer() == span.m_bc.getContainer())
+        {
+            orig_len = prev.m_bc->getTailLen();
             bool still_depend_temp;
-            long neg_thres_temp, pos_thres_temp;
-            os->m_bc->Expand(1, static_cast<long>(os->m_cur_val),
-                             static_cast<long>(os->m_new_val),
-                             &still_depend_temp, &neg_thres_temp,
-                             &pos_thres_temp, m_diags);
-            os->m_thres = static_cast<long>(pos_thres_temp);
-
-            offset_diff =
-                os->m_new_val + os->m_bc->getTotalLen() - old_next_offset;
-            len_diff = os->m_bc->getTailLen() - orig_len;
-            if (len_diff != 0)
+            int64_t neg_thres_temp, pos_thres_temp;
+            prev.m_bc->Expand(1, static_cast<int64_t>(prev.m_cur_val),
+                              static_cast<int64_t>(prev.m_cur_val),
+                              &still_depend_temp, &neg_thres_temp,
+                              &pos_thres_temp, group.m_diags);
+            prev.m_thres = static_cast<uint64_t>(pos_thres_temp);
+
+            int64_t prev_diff = prev.m_bc->getTailLen() - orig_len;
+            if (prev_diff != 0)
             {
-                DEBUG(llvm::errs() << "BC@" << os->m_bc << " ("
-                      << os->m_bc->getIndex() << ") offset setter change by "
-                      << len_diff << ":\n");
-                m_itree.Enumerate(static_cast<long>(os->m_bc->getIndex()),
-                                  static_cast<long>(os->m_bc->getIndex()),
-                                  TR1::bind(&Optimizer::Impl::ExpandTerm, this,
-                                            _1, len_diff));
+                DEBUG(llvm::errs() << "BC@" << prev.m_bc << " ("
+                      << prev.m_bc->getIndex() << ") offset setter change by "
+                      << prev_diff << ":\n");
+                if (m_explain)
+                    group.m_growth.push_back(
+                        std::make_pair(prev.m_bc, prev_diff));
+                ExpandTerms(group, *prev.m_bc, prev_diff);
+                len_diff += prev_diff;
             }
+        }
+    }
+    group.m_defer_recalc = false;
+
+    // Iterate over offset-setters that follow the bc just expanded.
+    // Stop iteration if:
+    //  - no more offset-setters in this section
+    //  - offset-setter didn't move its following offset
+    size_t os_index = span.m_os_index;
+    int64_t offset_diff = len_diff;
+    while (os_index < m_offset_setters.size()
+           && m_offset_setters[os_index].m_bc
+           && m_offset_setters[os_index].m_bc->getContainer()
+              == span.m_bc.getContainer()
+           && offset_diff != 0)
+    {
+        // Offset setters moved by a multiple of their period keep their
+        // length; just note their new offset for when they're next used.
+        size_t skip_end = SkipOffsetSetters(os_index, offset_diff);
+        if (skip_end != os_index)
+        {
+            ShiftOffsetSetters(os_index, skip_end, offset_diff);
+            os_index = skip_end;
+            continue;
+        }
 
-            os->m_cur_val = os->m_new_val;
-            ++os;
+        OffsetSetter* os = &SettleOffsetSetter(os_index);
+        uint64_t old_next_offset =
+            os->m_cur_val + os->m_bc->getTotalLen();
+
+        assert((offset_diff >= 0 ||
+                static_cast<uint64_t>(-offset_diff) <= os->m_new_val)
+               && "org/align went to negative offset");
+        os->m_new_val += offset_diff;
+
+        orig_len = os->m_bc->getTailLen();
+        bool still_depend_temp;
+        int64_t neg_thres_temp, pos_thres_temp;
+        os->m_bc->Expand(1, static_cast<int64_t>(os->m_cur_val),
+                         static_cast<int64_t>(os->m_new_val),
+                         &still_depend_temp, &neg_thres_temp,
+                         &pos_thres_temp, group.m_diags);
+        os->m_thres = static_cast<uint64_t>(pos_thres_temp);
+
+        offset_diff =
+            os->m_new_val + os->m_bc->getTotalLen() - old_next_offset;
+        len_diff = os->m_bc->getTailLen() - orig_len;
+        if (len_diff != 0)
+        {
+            DEBUG(llvm::errs() << "BC@" << os->m_bc << " ("
+                  << os->m_bc->getIndex() << ") offset setter change by "
+                  << len_diff << ":\n");
+            if (m_explain)
+                group.m_growth.push_back(std::make_pair(os->m_bc, len_diff));
+            ExpandTerms(group, *os->m_bc, len_diff);
+        }
+
+        os->m_cur_val = os->m_new_val;
+        ++os_index;
+    }
+}
+
+// Record why a span is taking its longest form.  The thresholds are those
+// of the form it's expanded from; the growth before the expansion is the
+// first log_end entries of growth log number log.
+void
+Optimizer::Impl::ExplainSpan(const Span& span,
+                             int64_t neg_thres,
+                             int64_t pos_thres,
+                             size_t log,
+                             size_t log_end,
+                             std::vector<ExplainedSpan>& explained) const
+{
+    explained.push_back(ExplainedSpan());
+    ExplainedSpan& out = explained.back();
+    Optimizer::LongSpanReason& reason = out.reason;
+    reason.bc = &span.m_bc;
+    reason.id = span.m_id;
+    reason.neg_thres = neg_thres;
+    reason.pos_thres = pos_thres;
+    reason.dist = span.m_dist;
+    reason.add = span.m_dist_add;
+    if (span.m_dist)
+    {
+        const Span::Term& term = span.m_span_terms.front();
+        reason.loc = term.m_loc;
+        reason.loc2 = term.m_loc2;
+        reason.value = term.m_new_val + span.m_dist_add;
+    }
+    else
+        reason.value = span.m_new_val;
+
+    if (span.m_seeded)
+        reason.reason = Optimizer::LongSpanReason::SEEDED;
+    else if (span.m_long)
+        reason.reason = Optimizer::LongSpanReason::PASS_LIMIT;
+    else if (span.m_depval.isRelative())
+        reason.reason = Optimizer::LongSpanReason::RELATIVE;
+    else if (!span.m_dist && span.m_new_val == INT64_MAX)
+        reason.reason = Optimizer::LongSpanReason::COMPLEX;
+    else
+        reason.reason = Optimizer::LongSpanReason::OUT_OF_RANGE;
+
+    // Same bytecode ranges as ITreeAdd().
+    for (Span::Terms::const_iterator term=span.m_span_terms.begin(),
+         endterm=span.m_span_terms.end(); term != endterm; ++term)
+    {
+        long precbc_index = term->m_loc.bc ? term->m_loc.bc->getIndex()
+                                           : span.m_bc.getIndex()-1;
+        long precbc2_index = term->m_loc2.bc ? term->m_loc2.bc->getIndex()
+                                             : span.m_bc.getIndex()-1;
+        if (precbc_index != precbc2_index)
+            out.ranges.push_back(std::make_pair(
+                std::min(precbc_index, precbc2_index),
+                std::max(precbc_index, precbc2_index)-1));
+    }
+
+    out.log = log;
+    out.log_end = log_end;
+}
+
+// Get the end of the offset setters starting at i that pass on a change
+// in offset of diff without changing length: those with a period that
+// divides diff.  As periods are powers of two, that's any period up to
+// the lowest set bit of diff.
+size_t
+Optimizer::Impl::SkipOffsetSetters(size_t i, int64_t diff) const
+{
+    uint64_t udiff = static_cast<uint64_t>(diff < 0 ? -diff : diff);
+    uint64_t lowbit = udiff & (~udiff + 1);
+    size_t end = m_offset_setters[i].m_run_end;
+    while (i < end && m_offset_setters[i].m_period <= lowbit)
+        i = m_offset_setters[i].m_next_longer;
+    return i;
+}
+
+void
+Optimizer::Impl::AddPendingShift(size_t i, int64_t diff)
+{
+    size_t begin = m_offset_setters[i].m_run_begin;
+    size_t n = m_offset_setters[i].m_run_end - begin;
+    for (size_t j=i-begin+1; j<=n; j += j & (~j+1))
+        m_os_pending[begin+j-1] += diff;
+}
+
+int64_t
+Optimizer::Impl::getPendingShift(size_t i) const
+{
+    size_t begin = m_offset_setters[i].m_run_begin;
+    int64_t shift = 0;
+    for (size_t j=i-begin+1; j>0; j -= j & (~j+1))
+        shift += m_os_pending[begin+j-1];
+    return shift;
+}
+
+// Shift the offsets of setters [begin, end) in the same run by diff.
+void
+Optimizer::Impl::ShiftOffsetSetters(size_t begin, size_t end, int64_t diff)
+{
+    AddPendingShift(begin, diff);
+    if (end < m_offset_setters[begin].m_run_end)
+        AddPendingShift(end, -diff);
+}
+
+// Apply any pending shift to an offset setter.
+OffsetSetter&
+Optimizer::Impl::SettleOffsetSetter(size_t i)
+{
+    OffsetSetter& os = m_offset_setters[i];
+    int64_t shift = getPendingShift(i);
+    if (shift != 0)
+    {
+        os.Shift(shift);
+        ShiftOffsetSetters(i, i+1, -shift);
+    }
+    return os;
+}
+
+void
+Optimizer::Impl::FlushDirty(SpanGroup& group)
+{
+    for (std::vector<Span*>::iterator i=group.m_dirty.begin(),
+         end=group.m_dirty.end(); i != end; ++i)
+    {
+        Span* span = *i;
+        span->m_dirty = false;
+
+        if (span->m_active != Span::ACTIVE)
+            continue;
+
+        if (!span->RecalcNormal(group.m_diags))
+        {
+            DEBUG(llvm::errs() << span->getName()
+                  << " didn't change, not readded\n");
+            continue;
+        }
+
+        DEBUG(llvm::errs() << span->getName() << " added back on queue\n");
+        group.m_QB.push_back(span);
+        span->m_active = Span::ON_Q;
+    }
+    group.m_dirty.clear();
+}
+
+// Queue all spans of a group that may still expand to take their longest
+// form.  As the longest form is final, this bounds the number of further
+// passes over the group.
+void
+Optimizer::Impl::SetLongForms(SpanGroup& group)
+{
+    for (Spans::iterator i=m_spans.begin(), end=m_spans.end(); i != end; ++i)
+    {
+        Span* span = *i;
+        if (span->m_active == Span::INACTIVE
+            || (group.m_index >= 0
+                && span->m_group != static_cast<size_t>(group.m_index))
+            || !span->hasLongForm())
+            continue;
+        span->setLongForm();
+        if (span->m_active == Span::ACTIVE)
+        {
+            group.m_QB.push_back(span);
+            span->m_active = Span::ON_Q;
+        }
+    }
+}
+
+bool
+Optimizer::Impl::VerifyLongSpans()
+{
+    for (Spans::iterator i=m_seeded_spans.begin(), end=m_seeded_spans.end();
+         i != end; ++i)
+    {
+        Span* span = *i;
+        IntNum value;
+        if (span->m_depval.isRelative()
+            || !span->m_depval.getIntNum(&value, true, m_diags))
+            continue;   // only the longest form can handle it
+        if (value.isInRange(static_cast<long>(span->m_neg_thres),
+                            static_cast<long>(span->m_pos_thres)))
+        {
+            DEBUG(llvm::errs() << span->getName() << " did not need its "
+                  << "longest form\n");
+            return false;
+        }
+    }
+    return true;
+}
+
+void
+Optimizer::Impl::Relax(SpanGroup& group)
+{
+    while (!group.m_QA.empty() || !group.m_QB.empty())
+    {
+        // QA is for TIMES, update those first, then update non-TIMES.
+        // This is so that TIMES can absorb increases before we look at
+        // expanding non-TIMES BCs.
+        if (!group.m_QA.empty())
+        {
+            Span* span = group.m_QA.front();
+            group.m_QA.pop_front();
+            ++num_qa_iters;
+            ExpandSpan(group, *span);
+            continue;
+        }
+
+        // Out of passes; give up on minimizing the remaining spans.
+        if (group.m_passes++ == m_max_passes)
+            SetLongForms(group);
+
+        // Expand everything currently on QB as a single batch.
+        ++num_qb_batches;
+        SpanGroup::SpanQueue batch;
+        batch.swap(group.m_QB);
+        group.m_batching = true;
+        while (!batch.empty())
+        {
+            Span* span = batch.front();
+            batch.pop_front();
+            ++num_qb_iters;
+            ExpandSpan(group, *span);
+
+            // A TIMES span was queued; stop the batch so it is handled
+            // before the rest of QB.
+            if (!group.m_QA.empty())
+                break;
+        }
+        group.m_batching = false;
+        FlushDirty(group);
+
+        // Put any unprocessed portion of the batch back ahead of the
+        // spans queued during the batch.
+        group.m_QB.insert(group.m_QB.begin(), batch.begin(), batch.end());
+    }
+}
+
+void
+Optimizer::Impl::RelaxGroup(stdx::ptr_vector<SpanGroup>& groups, size_t i)
+{
+    Relax(groups[i]);
+}
+
+void
+Optimizer::Impl::Step2(unsigned int num_jobs)
+{
+    DEBUG(DumpXml(*this));
+
+    if (num_jobs == 1 || m_num_groups <= 1)
+    {
+        SpanGroup group(m_diags, -1);
+        group.m_QA.swap(m_QA);
+        group.m_QB.swap(m_QB);
+        Relax(group);
+        if (m_explain)
+        {
+            m_growth_logs.resize(2);
+            m_growth_logs[1].swap(group.m_growth);
+            m_explained.insert(m_explained.end(), group.m_explained.begin(),
+                               group.m_explained.end());
+        }
+        return;
+    }
+
+    // Give each group its own queues and buffered diagnostics.  The
+    // diagnostic engines must be created here as DiagnosticIDs is not
+    // reference counted in a thread-safe manner.
+    stdx::ptr_vector<DiagnosticBuffer> group_diags;
+    stdx::ptr_vector_owner<DiagnosticBuffer> group_diags_owner(group_diags);
+    stdx::ptr_vector<SpanGroup> groups;
+    stdx::ptr_vector_owner<SpanGroup> groups_owner(groups);
+    for (size_t i=0; i<m_num_groups; ++i)
+    {
+        group_diags.push_back(new DiagnosticBuffer(m_diags));
+        groups.push_back(new SpanGroup(group_diags.back().getDiagnostics(),
+                                       static_cast<long>(i)));
+    }
+
+    for (SpanQueue::iterator i=m_QA.begin(), end=m_QA.end(); i != end; ++i)
+        groups[(*i)->m_group].m_QA.push_back(*i);
+    for (SpanQueue::iterator i=m_QB.begin(), end=m_QB.end(); i != end; ++i)
+        groups[(*i)->m_group].m_QB.push_back(*i);
+    m_QA.clear();
+    m_QB.clear();
+
+    ThreadPool pool(num_jobs);
+    pool.Run(groups.size(), TR1::bind(&Optimizer::Impl::RelaxGroup, this,
+                                      TR1::ref(groups), _1));
+
+    // Replay diagnostics in group (section) order, letting the main
+    // diagnostics engine decide their final severity.
+    for (size_t i=0; i<m_num_groups; ++i)
+        group_diags[i].Replay(m_diags);
+
+    if (m_explain)
+    {
+        m_growth_logs.resize(m_num_groups+1);
+        for (size_t i=0; i<m_num_groups; ++i)
+        {
+            m_growth_logs[i+1].swap(groups[i].m_growth);
+            m_explained.insert(m_explained.end(),
+                               groups[i].m_explained.begin(),
+                               groups[i].m_explained.end());
         }
     }
 }
@@ -959,15 +2243,203 @@ Optimizer::~Optimizer()
 }
 
 void
-Optimizer::Step1b()
+Optimizer::setMaxPasses(unsigned int max_passes)
+{
+    m_impl->m_max_passes = max_passes;
+}
+
+bool
+Optimizer::getSpanIds(/*@out@*/ SpanIds* spans) const
+{
+    return m_impl->getSpanIds(spans);
+}
+
+void
+Optimizer::setLongSpans(const SpanIds& spans)
+{
+    m_impl->m_seed = spans;
+}
+
+bool
+Optimizer::VerifyLongSpans()
+{
+    return m_impl->VerifyLongSpans();
+}
+
+void
+Optimizer::getLongSpans(/*@out@*/ SpanIds* spans) const
+{
+    m_impl->getLongSpans(spans);
+}
+
+void
+Optimizer::setExplain(bool explain)
+{
+    m_impl->m_explain = explain;
+}
+
+void
+Optimizer::getLongSpanReasons(/*@out@*/ LongSpanReasons* reasons) const
+{
+    m_impl->getLongSpanReasons(reasons);
+}
+
+bool
+Optimizer::Impl::getSpanIds(/*@out@*/ Optimizer::SpanIds* spans) const
+{
+    bool all = true;
+    for (Spans::const_iterator i=m_spans.begin(), end=m_spans.end();
+         i != end; ++i)
+    {
+        if ((*i)->hasLongForm())
+            spans->push_back(std::make_pair(&(*i)->m_bc, (*i)->m_id));
+        else
+            all = false;
+    }
+    return all;
+}
+
+void
+Optimizer::Impl::getLongSpans(/*@out@*/ Optimizer::SpanIds* spans) const
+{
+    *spans = m_long_spans;
+    for (Spans::const_iterator i=m_spans.begin(), end=m_spans.end();
+         i != end; ++i)
+    {
+        // Spans still tracked after step 2 are inactive once expanded to
+        // their last form.
+        if ((*i)->m_active == Span::INACTIVE && (*i)->hasLongForm())
+            spans->push_back(std::make_pair(&(*i)->m_bc, (*i)->m_id));
+    }
+    std::sort(spans->begin(), spans->end());
+}
+
+namespace {
+// Entry of a growth log, for finding the entries within bytecode ranges.
+struct GrowthEntry
+{
+    unsigned long index;        // bytecode index
+    size_t seq;                 // position in the log
+    Bytecode* bc;
+    int64_t diff;
+};
+
+inline bool
+operator<(const GrowthEntry& lhs, const GrowthEntry& rhs)
+{
+    return lhs.index < rhs.index;
+}
+
+inline bool
+operator<(const GrowthEntry& lhs, unsigned long rhs)
+{
+    return lhs.index < rhs;
+}
+
+struct GrowthIndexLess
+{
+    bool operator() (const std::pair<Bytecode*, int64_t>& lhs,
+                     const std::pair<Bytecode*, int64_t>& rhs) const
+    { return lhs.first->getIndex() < rhs.first->getIndex(); }
+};
+} // anonymous namespace
+
+// Add the entries of a growth log, sorted by bytecode index, that are
+// within the given bytecode ranges and before position end in the log.
+static void
+AddGrowth(const std::vector<GrowthEntry>& log,
+          size_t end,
+          const std::vector<std::pair<long, long> >& ranges,
+          GrowthLog* growth)
+{
+    if (end == 0)
+        return;
+    for (std::vector<std::pair<long, long> >::const_iterator
+         range=ranges.begin(), endrange=ranges.end(); range != endrange;
+         ++range)
+    {
+        for (std::vector<GrowthEntry>::const_iterator i=std::lower_bound(
+             log.begin(), log.end(),
+             static_cast<unsigned long>(range->first)), iend=log.end();
+             i != iend && i->index <= static_cast<unsigned long>(range->second);
+             ++i)
+        {
+            if (i->seq < end)
+                growth->push_back(std::make_pair(i->bc, i->diff));
+        }
+    }
+}
+
+void
+Optimizer::Impl::getLongSpanReasons(
+    /*@out@*/ Optimizer::LongSpanReasons* reasons) const
+{
+    // Index the growth logs by bytecode.
+    std::vector<std::vector<GrowthEntry> > logs(m_growth_logs.size());
+    for (size_t i=0; i<m_growth_logs.size(); ++i)
+    {
+        logs[i].reserve(m_growth_logs[i].size());
+        for (size_t j=0; j<m_growth_logs[i].size(); ++j)
+        {
+            GrowthEntry entry = {m_growth_logs[i][j].first->getIndex(), j,
+                                 m_growth_logs[i][j].first,
+                                 m_growth_logs[i][j].second};
+            logs[i].push_back(entry);
+        }
+        std::stable_sort(logs[i].begin(), logs[i].end());
+    }
+
+    reasons->reserve(reasons->size() + m_explained.size());
+    for (std::vector<ExplainedSpan>::const_iterator i=m_explained.begin(),
+         end=m_explained.end(); i != end; ++i)
+    {
+        reasons->push_back(i->reason);
+        if (i->ranges.empty())
+            continue;
+
+        // Growth in Step 1b and 1c precedes all of Step 2.
+        GrowthLog growth;
+        if (i->log > 0)
+            AddGrowth(logs[0], logs[0].size(), i->ranges, &growth);
+        size_t mid = growth.size();
+        AddGrowth(logs[i->log], i->log_end, i->ranges, &growth);
+
+        // Total the growth of each bytecode.
+        if (i->ranges.size() > 1)
+            std::sort(growth.begin(), growth.end(), GrowthIndexLess());
+        else
+            std::inplace_merge(growth.begin(), growth.begin()+mid,
+                               growth.end(), GrowthIndexLess());
+        GrowthLog& out = reasons->back().growth;
+        for (GrowthLog::const_iterator j=growth.begin(), jend=growth.end();
+             j != jend; ++j)
+        {
+            if (!out.empty() && out.back().first == j->first)
+                out.back().second += j->second;
+            else
+                out.push_back(*j);
+            if (out.back().second == 0)
+                out.pop_back();
+        }
+    }
+}
+
+void
+Optimizer::Step1b(unsigned int num_jobs)
+{
+    m_impl->Step1b(num_jobs);
+}
+
+const Optimizer::Couplings&
+Optimizer::getCouplings() const
 {
-    m_impl->Step1b();
+    return m_impl->m_couplings;
 }
 
 bool
-Optimizer::Step1d()
+Optimizer::Step1d(unsigned int num_jobs)
 {
-    return m_impl->Step1d();
+    return m_impl->Step1d(num_jobs);
 }
 
 void
@@ -977,9 +2449,9 @@ Optimizer::Step1e()
 }
 
 void
-Optimizer::Step2()
+Optimizer::Step2(unsigned int num_jobs)
 {
-    m_impl->Step2();
+    m_impl->Step2(num_jobs);
 }
 
 #ifdef WITH_XML
@@ -26,6 +26,8 @@
 ///
 #include "yasmx/Parse/Directive.h"
 
+#include <cassert>
+
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/StringMap.h"
 #include "yasmx/Basic/Diagnostic.h"
@@ -50,9 +52,9 @@ public:
             : m_handler(handler), m_flags(flags)
         {}
         ~Dir() {}
-        void operator() (StringRef name,
-                         DirectiveInfo& info,
-                         DiagnosticsEngine& diags);
+        void operator() (DirectiveInfo& info, DiagnosticsEngine& diags);
+
+        ParsedDirective m_parsed;
 
     private:
         Directive m_handler;
@@ -88,14 +90,32 @@ Directives::get(Directive* dir, StringRef name) const
     if (p == m_impl->m_dirs.end())
         return false;
 
-    *dir =
-        TR1::bind(&Impl::Dir::operator(), TR1::ref(p->second), name, _1, _2);
+    // Wrap a reference rather than a bind object so that no allocation is
+    // needed to construct the returned functor.
+    *dir = TR1::ref(p->second);
+    return true;
+}
+
+void
+Directives::AddParsed(StringRef name, ParsedDirective handler)
+{
+    Impl::DirMap::iterator p = m_impl->m_dirs.find(name);
+    assert(p != m_impl->m_dirs.end() && "parsed directive without handler");
+    p->second.m_parsed = handler;
+}
+
+bool
+Directives::getParsed(ParsedDirective* handler, StringRef name) const
+{
+    Impl::DirMap::iterator p = m_impl->m_dirs.find(name);
+    if (p == m_impl->m_dirs.end() || !p->second.m_parsed)
+        return false;
+    *handler = p->second.m_parsed;
     return true;
 }
 
 void
-Directives::Impl::Dir::operator() (StringRef name,
-                                   DirectiveInfo& info,
+Directives::Impl::Dir::operator() (DirectiveInfo& info,
                                    DiagnosticsEngine& diags)
 {
     NameValues& namevals = info.getNameValues();
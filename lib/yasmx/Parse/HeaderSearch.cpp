@@ -32,6 +32,7 @@
 
 #include "llvm/Support/Path.h"
 #include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/Twine.h"
 #include "yasmx/Basic/FileManager.h"
 #include "yasmx/Parse/IdentifierTable.h"
 #include <cstdio>
@@ -131,6 +132,52 @@ HeaderSearch::LookupFile(StringRef Filename,
                          const DirectoryLookup *FromDir,
                          const DirectoryLookup *&CurDir,
                          const FileEntry *CurFileEnt)
+{
+  // #include_next lookups depend on where the includer was found, so aren't
+  // worth caching.
+  if (FromDir)
+    return SearchFile(Filename, isAngled, FromDir, CurDir, CurFileEnt);
+
+  // The includer's directory only matters for "" lookups.
+  SmallString<256> Key;
+  if (CurFileEnt && !isAngled && !NoCurDirSearch)
+    Key += CurFileEnt->getDir()->getName();
+  Key.push_back('\0');
+  Key.push_back(isAngled ? '<' : '"');
+  Key += Filename;
+
+  IncluderLookup &Cached = IncluderLookupCache.GetOrCreateValue(Key).getValue();
+  if (!Cached.Valid) {
+    Cached.File = SearchFile(Filename, isAngled, 0, Cached.Dir, CurFileEnt);
+    Cached.Valid = true;
+  }
+  CurDir = Cached.Dir;
+  return Cached.File;
+}
+
+void
+HeaderSearch::PrefetchFile(StringRef Filename, StringRef IncluderDir) const
+{
+  // Candidates are named just as SearchFile() names them, so the prefetched
+  // contents are found by FileManager::getBufferForFile().
+  std::vector<std::string> Paths;
+  if (llvm::sys::path::is_absolute(Filename)) {
+    Paths.push_back(Filename);
+  } else {
+    if (!IncluderDir.empty() && !NoCurDirSearch)
+      Paths.push_back((Twine(IncluderDir) + "/" + Filename).str());
+    for (unsigned i = 0, e = SearchDirs.size(); i != e; ++i)
+      Paths.push_back((Twine(SearchDirs[i].getName()) + "/" + Filename).str());
+  }
+  FileMgr.prefetchFile(Paths);
+}
+
+const FileEntry *
+HeaderSearch::SearchFile(StringRef Filename,
+                         bool isAngled,
+                         const DirectoryLookup *FromDir,
+                         const DirectoryLookup *&CurDir,
+                         const FileEntry *CurFileEnt)
 {
   // If 'Filename' is absolute, check to see if it exists and no searching.
   if (llvm::sys::path::is_absolute(Filename)) {
@@ -46,12 +46,10 @@ STATISTIC(num_reg_lookup_none, "Number of register lookups to identifier");
 using namespace yasm;
 
 void
-IdentifierInfo::DoInsnLookup(const Arch& arch,
-                             SourceLocation source,
-                             DiagnosticsEngine& diags)
+IdentifierInfo::DoInsnLookupSlow(const Arch& arch,
+                                 SourceLocation source,
+                                 DiagnosticsEngine& diags)
 {
-    if (m_flags & DID_INSN_LOOKUP)
-        return;
     ++num_insn_lookup;
     m_flags &= ~(IS_INSN | IS_PREFIX);
     Arch::InsnPrefix ip = arch.ParseCheckInsnPrefix(getName(), source, diags);
@@ -75,12 +73,10 @@ IdentifierInfo::DoInsnLookup(const Arch& arch,
 }
 
 void
-IdentifierInfo::DoRegLookup(const Arch& arch,
-                            SourceLocation source,
-                            DiagnosticsEngine& diags)
+IdentifierInfo::DoRegLookupSlow(const Arch& arch,
+                                SourceLocation source,
+                                DiagnosticsEngine& diags)
 {
-    if (m_flags & DID_REG_LOOKUP)
-        return;
     ++num_reg_lookup;
     m_flags &= ~(IS_REGISTER | IS_REGGROUP | IS_SEGREG | IS_TARGETMOD);
     Arch::RegTmod regtmod = arch.ParseCheckRegTmod(getName(), source, diags);
@@ -32,10 +32,14 @@
 
 #include <cctype>
 
+#include "llvm/Support/MathExtras.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "yasmx/Basic/Diagnostic.h"
 #include "yasmx/Parse/Preprocessor.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 using namespace yasm;
 
@@ -349,10 +353,31 @@ Lexer::SkipLineComment(Token* result, const char* cur_ptr)
     // loop.
     char ch;
     do {
+#ifdef __SSE2__
+        // Skip over 16 byte chunks that contain none of the characters the
+        // loop below stops at.
+        __m128i zeros = _mm_setzero_si128();
+        __m128i backslashes = _mm_set1_epi8('\\');
+        __m128i crs = _mm_set1_epi8('\r');
+        __m128i lfs = _mm_set1_epi8('\n');
+        while (cur_ptr+16 <= m_buf_end)
+        {
+            __m128i chunk = _mm_loadu_si128((const __m128i*)cur_ptr);
+            __m128i cmp = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, zeros),
+                             _mm_cmpeq_epi8(chunk, backslashes)),
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, crs),
+                             _mm_cmpeq_epi8(chunk, lfs)));
+            unsigned int mask = _mm_movemask_epi8(cmp);
+            if (mask != 0)
+            {
+                cur_ptr += llvm::CountTrailingZeros_32(mask);
+                break;
+            }
+            cur_ptr += 16;
+        }
+#endif
         ch = *cur_ptr;
-        // FIXME: Speedup BCPL comment lexing.  Just scan for a \n or \r
-        // character.  If we find a \n character, scan backwards, checking
-        // to see if it's an escaped newline, like we do for block comments.
 
         // Skip over characters in the fast loop.
         while (ch != 0 &&                   // Potentially EOF.
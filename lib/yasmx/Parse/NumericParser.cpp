@@ -30,9 +30,13 @@
 //
 #include "yasmx/Parse/NumericParser.h"
 
+#include <cstddef>
+
 #include "llvm/ADT/APFloat.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Support/DataTypes.h"
+#include "yasmx/Support/DecimalFloat.h"
 #include "yasmx/IntNum.h"
 
 
@@ -51,16 +55,114 @@ NumericParser::~NumericParser()
 {
 }
 
+/// Convert 8 decimal digits at once (SWAR).  Characters are packed with the
+/// first digit in the low byte, independent of host byte order.
+/// @param s        digits
+/// @param val      output value (0-99999999)
+/// @return False if any of the 8 characters is not a decimal digit.
+static inline bool
+ParseEightDigits(const char* s, uint64_t* val)
+{
+    uint64_t chunk = 0;
+    for (int i=0; i<8; ++i)
+        chunk |= static_cast<uint64_t>(static_cast<unsigned char>(s[i]))
+            << (8*i);
+
+    // Each byte must be 0x30-0x39: high nibble 3, and adding 6 must not
+    // carry out of the low nibble.
+    if ((chunk & UINT64_C(0xF0F0F0F0F0F0F0F0)) != UINT64_C(0x3030303030303030)
+        || ((chunk + UINT64_C(0x0606060606060606)) &
+            UINT64_C(0xF0F0F0F0F0F0F0F0)) != UINT64_C(0x3030303030303030))
+        return false;
+
+    chunk -= UINT64_C(0x3030303030303030);
+    chunk = (chunk * 10 + (chunk >> 8)) & UINT64_C(0x00FF00FF00FF00FF);
+    chunk = (chunk * 100 + (chunk >> 16)) & UINT64_C(0x0000FFFF0000FFFF);
+    chunk = (chunk * 10000 + (chunk >> 32)) & UINT64_C(0x00000000FFFFFFFF);
+    *val = chunk;
+    return true;
+}
+
+/// Convert digits that are known to fit in 64 bits.  Decimal strings of up
+/// to 19 digits and power-of-two radix strings of up to 64 bits always fit.
+/// @param s        digits
+/// @param len      number of digits
+/// @param radix    numeric base (2, 8, 10, or 16)
+/// @param val      output value
+/// @return False if a character isn't a plain digit (e.g. a '_' separator);
+///         the caller should use the general path in that case.
+static bool
+ParseSmallInteger(const char* s, std::size_t len, unsigned int radix,
+                  uint64_t* val)
+{
+    uint64_t v = 0;
+    if (radix == 10)
+    {
+        for (; len >= 8; s += 8, len -= 8)
+        {
+            uint64_t chunk;
+            if (!ParseEightDigits(s, &chunk))
+                return false;
+            v = v * 100000000 + chunk;
+        }
+        for (; len > 0; ++s, --len)
+        {
+            unsigned int c = static_cast<unsigned char>(*s) - '0';
+            if (c > 9)
+                return false;
+            v = v * 10 + c;
+        }
+        *val = v;
+        return true;
+    }
+
+    unsigned int shift = (radix == 16 ? 4 : radix == 8 ? 3 : 1);
+    for (; len > 0; ++s, --len)
+    {
+        unsigned int ch = static_cast<unsigned char>(*s);
+        unsigned int c;
+        if (ch - '0' <= 9)
+            c = ch - '0';
+        else if ((ch | 0x20) - 'a' <= 5)
+            c = (ch | 0x20) - 'a' + 10;
+        else
+            return false;
+        if (c >= radix)
+            return false;
+        v = (v << shift) | c;
+    }
+    *val = v;
+    return true;
+}
+
 bool
 NumericParser::getIntegerValue(IntNum* val)
 {
-    if ((m_digits_end-m_digits_begin) == 0)
+    std::size_t len = m_digits_end-m_digits_begin;
+    if (len == 0)
     {
         val->Zero();
         return false;
     }
-    return val->setStr(StringRef(m_digits_begin, m_digits_end-m_digits_begin),
-                       m_radix);
+
+    // Fast path for values that are guaranteed to fit in 64 bits.
+    std::size_t max_len;
+    switch (m_radix)
+    {
+        case 2:     max_len = 64; break;
+        case 8:     max_len = 21; break;
+        case 10:    max_len = 19; break;
+        case 16:    max_len = 16; break;
+        default:    max_len = 0; break;
+    }
+    uint64_t v;
+    if (len <= max_len && ParseSmallInteger(m_digits_begin, len, m_radix, &v))
+    {
+        val->setUInt64(v);
+        return true;
+    }
+
+    return val->setStr(StringRef(m_digits_begin, len), m_radix);
 }
 
 APFloat
@@ -91,3 +193,89 @@ NumericParser::getFloatValue(const llvm::fltSemantics& format,
 
     return val;
 }
+
+bool
+NumericParser::getIEEEBits(unsigned int size, uint64_t* bits) const
+{
+    if (!m_is_float || m_radix != 10)
+        return false;
+    return getDecimalFloatBits(StringRef(m_digits_begin,
+                                         m_digits_end-m_digits_begin),
+                               size, bits);
+}
+
+bool
+NumericParser::getDecimalFloatBits(StringRef str,
+                                   unsigned int size,
+                                   uint64_t* bits)
+{
+    const char* s = str.begin();
+    const char* end = str.end();
+
+    bool neg = false;
+    if (s != end && (*s == '-' || *s == '+'))
+    {
+        neg = (*s == '-');
+        ++s;
+    }
+
+    // Significand; leading zeros don't count toward the 19 digits.
+    uint64_t w = 0;
+    int ndigits = 0;
+    int q = 0;
+    bool any_digits = false;
+    for (; s != end && *s >= '0' && *s <= '9'; ++s)
+    {
+        any_digits = true;
+        if (w == 0 && *s == '0')
+            continue;
+        if (++ndigits > 19)
+            return false;
+        w = w*10 + (*s - '0');
+    }
+    if (s != end && *s == '.')
+    {
+        for (++s; s != end && *s >= '0' && *s <= '9'; ++s)
+        {
+            any_digits = true;
+            --q;
+            if (w == 0 && *s == '0')
+                continue;
+            if (++ndigits > 19)
+                return false;
+            w = w*10 + (*s - '0');
+        }
+    }
+    if (!any_digits)
+        return false;
+
+    if (s != end && (*s == 'e' || *s == 'E'))
+    {
+        ++s;
+        bool exp_neg = false;
+        if (s != end && (*s == '-' || *s == '+'))
+        {
+            exp_neg = (*s == '-');
+            ++s;
+        }
+        if (s == end)
+            return false;
+        int exp = 0;
+        for (; s != end && *s >= '0' && *s <= '9'; ++s)
+        {
+            if (exp < 100000)
+                exp = exp*10 + (*s - '0');
+        }
+        q += exp_neg ? -exp : exp;
+    }
+    if (s != end)
+        return false;
+
+    uint64_t v = 0;
+    if (w != 0 && !DecimalToIEEE(w, q, size, &v))
+        return false;
+    if (neg)
+        v |= UINT64_C(1) << (size-1);
+    *bits = v;
+    return true;
+}
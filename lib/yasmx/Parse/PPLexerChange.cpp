@@ -16,6 +16,7 @@
 #include "yasmx/Basic/SourceManager.h"
 #include "yasmx/Parse/HeaderSearch.h"
 #include "yasmx/Parse/Preprocessor.h"
+#include "yasmx/Support/Trace.h"
 
 using namespace yasm;
 
@@ -72,6 +73,10 @@ Preprocessor::EnterSourceFile(FileID FID,
         return;
     }
 
+    // Trace included files (but not the main file) until their end.
+    if (m_cur_lexer || m_cur_token_lexer)
+        TraceBegin("Include", InputFile->getBufferIdentifier());
+
     EnterSourceFileWithLexer(CreateLexer(FID, InputFile), CurDir);
 }
 
@@ -101,7 +106,8 @@ void
 Preprocessor::EnterTokenStream(const Token* toks,
                                unsigned int num_toks,
                                bool disable_macro_expansion,
-                               bool owns_tokens)
+                               bool owns_tokens,
+                               unsigned long repeat_count)
 {
     // Save our current state.
     PushIncludeMacroStack();
@@ -112,16 +118,35 @@ Preprocessor::EnterTokenStream(const Token* toks,
     {
         m_cur_token_lexer.reset(new TokenLexer(toks, num_toks,
                                                disable_macro_expansion,
-                                               owns_tokens, *this));
+                                               owns_tokens, *this,
+                                               repeat_count));
     }
     else
     {
         m_cur_token_lexer.reset(m_token_lexer_cache[--m_num_cached_token_lexers]);
         m_cur_token_lexer->Init(toks, num_toks, disable_macro_expansion,
-                                owns_tokens);
+                                owns_tokens, repeat_count);
     }
 }
 
+void
+Preprocessor::EnterTokenStream(TokenBuffer* toks,
+                               bool disable_macro_expansion,
+                               unsigned long repeat_count)
+{
+    // Save our current state.
+    PushIncludeMacroStack();
+    m_cur_dir_lookup = 0;
+
+    // Get a macro expander to expand from the buffer.
+    if (m_num_cached_token_lexers == 0)
+        m_cur_token_lexer.reset(new TokenLexer(0, 0, disable_macro_expansion,
+                                               false, *this));
+    else
+        m_cur_token_lexer.reset(m_token_lexer_cache[--m_num_cached_token_lexers]);
+    m_cur_token_lexer->Init(toks, disable_macro_expansion, repeat_count);
+}
+
 /// HandleEndOfFile - This callback is invoked when the lexer hits the end of
 /// the current file.  This either returns the EOF token or pops a level off
 /// the include stack and keeps going.
@@ -136,6 +161,8 @@ Preprocessor::HandleEndOfFile(Token* Result, bool isEndOfMacro)
     if (!m_include_macro_stack.empty())
     {
         // We're done with the #included file.
+        if (!isEndOfMacro)
+            TraceEnd();
         RemoveTopOfLexerStack();
 
 #if 0
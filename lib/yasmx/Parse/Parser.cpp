@@ -29,6 +29,8 @@
 ///
 #include "yasmx/Parse/Parser.h"
 
+#include "llvm/ADT/ArrayRef.h"
+#include "yasmx/Basic/Diagnostic.h"
 
 using namespace yasm;
 
@@ -41,6 +43,40 @@ Parser::AddDirectives(Directives& dirs, StringRef parser)
 {
 }
 
+bool
+Parser::Preprocess(raw_ostream& os, DiagnosticsEngine& diags)
+{
+    diags.Report(SourceLocation(), diag::fatal_preproc_only_unsupported)
+        << m_module.getKeyword();
+    return false;
+}
+
+bool
+Parser::SplitSource(std::vector<unsigned int>* splits,
+                    std::vector<unsigned int>* setup)
+{
+    return false;
+}
+
+bool
+Parser::ParsePiece(Object& object,
+                   Directives& dirs,
+                   DiagnosticsEngine& diags,
+                   const std::vector<unsigned int>& setup,
+                   unsigned int begin,
+                   unsigned int end,
+                   Bytes* record,
+                   ArrayRef<unsigned char> replay)
+{
+    assert(false && "parser can't split source");
+    return false;
+}
+
+void
+Parser::FinishPieces(Object& object)
+{
+}
+
 ParserModule::~ParserModule()
 {
 }
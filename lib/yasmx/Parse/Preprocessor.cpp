@@ -120,8 +120,8 @@ Preprocessor::RegisterBuiltinMacros()
 {
 }
 
-std::string
-Preprocessor::getSpelling(const Token& tok) const
+StringRef
+Preprocessor::getRawSpelling(const Token& tok) const
 {
     assert((int)tok.getLength() >= 0 && "Token character range is bogus!");
 
@@ -139,15 +139,23 @@ Preprocessor::getSpelling(const Token& tok) const
     if (tok_start == 0)
         tok_start = m_source_mgr.getCharacterData(tok.getLocation());
 
+    return StringRef(tok_start, tok.getLength());
+}
+
+std::string
+Preprocessor::getSpelling(const Token& tok) const
+{
+    StringRef raw = getRawSpelling(tok);
+
     // If this token contains nothing interesting, return it directly.
-    if (!tok.needsCleaning())
-        return std::string(tok_start, tok_start+tok.getLength());
+    if (tok.getIdentifierInfo() || !tok.needsCleaning())
+        return raw;
   
     std::string result;
     result.reserve(tok.getLength());
   
     // Otherwise, hard case, relex the characters into the string.
-    for (const char *ptr = tok_start, *end = tok_start+tok.getLength();
+    for (const char *ptr = raw.begin(), *end = raw.end();
          ptr != end; )
     {
         unsigned int char_size;
@@ -163,35 +171,18 @@ Preprocessor::getSpelling(const Token& tok) const
 unsigned int
 Preprocessor::getSpelling(const Token& tok, const char*& buffer) const
 {
-    assert((int)tok.getLength() >= 0 && "Token character range is bogus!");
-  
-    // If this token is an identifier, just return the string from the
-    // identifier table, which is very quick.
-    if (const IdentifierInfo* ii = tok.getIdentifierInfo())
-    {
-        buffer = ii->getNameStart();
-        return ii->getLength();
-    }
-
-    // Otherwise, compute the start of the token in the input lexer buffer.
-    const char* tok_start = 0;
-  
-    if (tok.isLiteral())
-        tok_start = tok.getLiteralData();
-  
-    if (tok_start == 0)
-        tok_start = m_source_mgr.getCharacterData(tok.getLocation());
+    StringRef raw = getRawSpelling(tok);
 
     // If this token contains nothing interesting, return it directly.
-    if (!tok.needsCleaning())
+    if (tok.getIdentifierInfo() || !tok.needsCleaning())
     {
-        buffer = tok_start;
-        return tok.getLength();
+        buffer = raw.data();
+        return raw.size();
     }
   
     // Otherwise, hard case, relex the characters into the string.
     char* out_buf = const_cast<char*>(buffer);
-    for (const char *ptr = tok_start, *end = tok_start+tok.getLength();
+    for (const char *ptr = raw.begin(), *end = raw.end();
          ptr != end; )
     {
         unsigned int char_size;
@@ -208,12 +199,11 @@ StringRef
 Preprocessor::getSpelling(const Token &Tok, SmallVectorImpl<char> &Buffer) const
 {
     // Try the fast path.
-    if (const IdentifierInfo *II = Tok.getIdentifierInfo())
-        return II->getName();
+    if (Tok.getIdentifierInfo() || !Tok.needsCleaning())
+        return getRawSpelling(Tok);
 
-    // Resize the buffer if we need to copy into it.
-    if (Tok.needsCleaning())
-        Buffer.resize(Tok.getLength());
+    // Resize the buffer to copy into it.
+    Buffer.resize(Tok.getLength());
 
     const char *Ptr = Buffer.data();
     unsigned Len = getSpelling(Tok, Ptr);
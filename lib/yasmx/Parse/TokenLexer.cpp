@@ -76,7 +76,8 @@ void TokenLexer::Init(Token &Tok, SourceLocation ILEnd, MacroArgs *Actuals) {
 /// take ownership of the specified token vector.
 void
 TokenLexer::Init(const Token *TokArray, unsigned NumToks,
-                 bool disableMacroExpansion, bool ownsTokens)
+                 bool disableMacroExpansion, bool ownsTokens,
+                 unsigned long repeatCount)
 {
     // If the client is reusing a TokenLexer, make sure to free any memory
     // associated with it.
@@ -91,19 +92,36 @@ TokenLexer::Init(const Token *TokArray, unsigned NumToks,
     m_disable_macro_expansion = disableMacroExpansion;
     m_num_tokens = NumToks;
     m_cur_token = 0;
+    m_repeat_count = repeatCount;
     m_expand_loc_start = m_expand_loc_end = SourceLocation();
     m_at_start_of_line = false;
     m_has_leading_space = false;
 
+    // An empty pass repeated any number of times is just an empty stream.
+    if (NumToks == 0 || repeatCount == 0)
+    {
+        m_num_tokens = 0;
+        m_repeat_count = 1;
+    }
+
     // Set HasLeadingSpace/AtStartOfLine so that the first token will be
     // returned unmodified.
-    if (NumToks != 0)
+    if (m_num_tokens != 0)
     {
         m_at_start_of_line = TokArray[0].isAtStartOfLine();
         m_has_leading_space = TokArray[0].hasLeadingSpace();
     }
 }
 
+void
+TokenLexer::Init(TokenBuffer* buffer, bool disable_macro_expansion,
+                 unsigned long repeat_count)
+{
+    Init(buffer->getTokens(), buffer->size(), disable_macro_expansion, false,
+         repeat_count);
+    m_buffer = buffer;
+}
+
 
 void
 TokenLexer::destroy()
@@ -116,6 +134,7 @@ TokenLexer::destroy()
         m_tokens = 0;
         m_owns_tokens = false;
     }
+    m_buffer = 0;
 
 #if 0
     // TokenLexer owns its formal arguments.
@@ -343,6 +362,12 @@ void TokenLexer::Lex(Token* Tok) {
     return PPCache.Lex(Tok);
   }
 
+  // Finished one pass of a repeated token stream; replay it from the start.
+  if (m_cur_token == m_num_tokens) {
+    --m_repeat_count;
+    m_cur_token = 0;
+  }
+
   // If this is the first token of the expanded result, we inherit spacing
   // properties later.
   bool isFirstToken = m_cur_token == 0;
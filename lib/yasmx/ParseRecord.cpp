@@ -0,0 +1,516 @@
+//
+// Parse record implementation.
+//
+//  Copyright (C) 2026  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// A record is a sequence of unsigned LEB128 numbers and the things built
+// from them.  Source locations are stored as their offset from the start
+// of the recorded source plus one (0 for an invalid location), and
+// symbols by name, so a record can be replayed into a different object
+// parsed from the same source text at a different place.
+//
+#include "yasmx/ParseRecord.h"
+
+#include <stdexcept>
+
+#include "yasmx/Arch.h"
+#include "yasmx/BytecodeContainer.h"
+#include "yasmx/Bytes.h"
+#include "yasmx/Bytes_leb128.h"
+#include "yasmx/Expr.h"
+#include "yasmx/InputBuffer.h"
+#include "yasmx/IntNum.h"
+#include "yasmx/Object.h"
+#include "yasmx/Symbol.h"
+#include "yasmx/Value.h"
+
+
+using namespace yasm;
+
+// Symbol kinds.
+enum
+{
+    SYM_NONE = 0,
+    SYM_NAMED,
+    SYM_SPECIAL
+};
+
+// Value flags.
+enum
+{
+    VAL_SIGNED = 1<<0,
+    VAL_IP_REL = 1<<1,
+    VAL_JUMP_TARGET = 1<<2,
+    VAL_SECTION_REL = 1<<3,
+    VAL_NO_WARN = 1<<4,
+    VAL_ABS = 1<<5
+};
+
+RecordWriter::RecordWriter(Bytes& out,
+                           const Arch& arch,
+                           Object& object,
+                           SourceLocation begin,
+                           SourceLocation end)
+    : m_out(out),
+      m_arch(arch),
+      m_object(object),
+      m_begin(begin),
+      m_end(end)
+{
+}
+
+void
+RecordWriter::WriteUnsigned(uint64_t val)
+{
+    do
+    {
+        unsigned char byte = val & 0x7F;
+        val >>= 7;
+        if (val != 0)
+            byte |= 0x80;
+        m_out.push_back(byte);
+    } while (val != 0);
+}
+
+void
+RecordWriter::WriteString(StringRef str)
+{
+    WriteUnsigned(str.size());
+    m_out.WriteString(str);
+}
+
+void
+RecordWriter::WriteIntNum(const IntNum& intn)
+{
+    WriteSLEB128(m_out, intn);
+}
+
+bool
+RecordWriter::WriteSource(SourceLocation source)
+{
+    if (source.isInvalid())
+    {
+        WriteUnsigned(0);
+        return true;
+    }
+    if (!source.isFileID() || source < m_begin || m_end < source)
+        return false;
+    WriteUnsigned(source.getRawEncoding() - m_begin.getRawEncoding() + 1);
+    return true;
+}
+
+bool
+RecordWriter::WriteSymbol(SymbolRef sym)
+{
+    if (!sym)
+    {
+        WriteUnsigned(SYM_NONE);
+        return true;
+    }
+    StringRef name = sym->getName();
+    if (sym->isSpecial())
+    {
+        if (m_object.FindSpecialSymbol(name) != sym)
+            return false;
+        WriteUnsigned(SYM_SPECIAL);
+    }
+    else
+    {
+        if (m_object.FindSymbol(name) != sym)
+            return false;
+        WriteUnsigned(SYM_NAMED);
+    }
+    WriteString(name);
+    return true;
+}
+
+bool
+RecordWriter::WriteRegister(const Register* reg)
+{
+    WriteUnsigned(reg != 0);
+    return !reg || m_arch.SaveRegister(*reg, *this);
+}
+
+bool
+RecordWriter::WriteExpr(const Expr& e)
+{
+    const ExprTerms& terms = e.getTerms();
+    WriteUnsigned(terms.size());
+    for (ExprTerms::const_iterator i=terms.begin(), end=terms.end();
+         i != end; ++i)
+    {
+        if (i->m_depth < 0)
+            return false;
+        WriteUnsigned(i->getType());
+        WriteUnsigned(i->m_depth);
+        if (!WriteSource(i->getSource()))
+            return false;
+        switch (i->getType())
+        {
+            case ExprTerm::INT:
+                WriteIntNum(*i->getIntNum());
+                break;
+            case ExprTerm::SYM:
+                if (!WriteSymbol(i->getSymbol()))
+                    return false;
+                break;
+            case ExprTerm::REG:
+                if (!WriteRegister(i->getRegister()))
+                    return false;
+                break;
+            case ExprTerm::OP:
+                if (i->getNumChild() < 0)
+                    return false;
+                WriteUnsigned(i->getOp());
+                WriteUnsigned(i->getNumChild());
+                break;
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+bool
+RecordWriter::WriteValue(const Value& value)
+{
+    if (value.isRelative() || value.isWRT() || value.hasSubRelative() ||
+        value.isSegOf() || value.getRShift() != 0)
+        return false;
+
+    unsigned int flags = 0;
+    if (value.isSigned())
+        flags |= VAL_SIGNED;
+    if (value.isIPRelative())
+        flags |= VAL_IP_REL;
+    if (value.isJumpTarget())
+        flags |= VAL_JUMP_TARGET;
+    if (value.isSectionRelative())
+        flags |= VAL_SECTION_REL;
+    if (!value.isWarnEnabled())
+        flags |= VAL_NO_WARN;
+    if (value.hasAbs())
+        flags |= VAL_ABS;
+
+    WriteUnsigned(flags);
+    WriteUnsigned(value.getSize());
+    WriteUnsigned(value.getShift());
+    WriteUnsigned(value.getInsnStart());
+    WriteUnsigned(value.getNextInsn());
+    SourceRange source = value.getSource();
+    if (!WriteSource(source.getBegin()) || !WriteSource(source.getEnd()))
+        return false;
+    return !value.hasAbs() || WriteExpr(*value.getAbs());
+}
+
+bool
+RecordWriter::WriteContents(const Bytecode::Contents& contents)
+{
+    WriteString(contents.getType());
+    return contents.Save(*this);
+}
+
+RecordWriter::Mark
+RecordWriter::getMark(BytecodeContainer& container)
+{
+    const Bytecode& last = container.bytecodes_back();
+    Mark mark;
+    mark.bcs = container.size();
+    mark.fixed = last.getFixed().size();
+    mark.fixups = last.getFixups().size();
+    mark.contents = last.hasContents();
+    return mark;
+}
+
+bool
+RecordWriter::WriteAppended(BytecodeContainer& container, const Mark& mark)
+{
+    // Output always starts at the bytecode BytecodeContainer::
+    // FreshBytecode() gives, which is how RecordReader::ReadAppended()
+    // starts too: the last one if it has no contents, otherwise a new one.
+    std::size_t num = container.size();
+    if (num < mark.bcs)
+        return false;
+    BytecodeContainer::bc_iterator bc = container.bytecodes_begin();
+    bc += mark.bcs-1;
+    if (mark.contents)
+    {
+        if (bc->getFixed().size() != mark.fixed ||
+            bc->getFixups().size() != mark.fixups)
+            return false;
+        ++bc;
+    }
+    else if (num > mark.bcs && !bc->hasContents())
+        return false;
+
+    std::size_t count = container.bytecodes_end() - bc;
+    if (count == 0)
+        return false;
+    WriteUnsigned(count);
+
+    std::size_t fixed_start = mark.contents ? 0 : mark.fixed;
+    std::size_t fixups_start = mark.contents ? 0 : mark.fixups;
+    for (BytecodeContainer::bc_iterator end=container.bytecodes_end();
+         bc != end; ++bc)
+    {
+        const Bytes& fixed = bc->getFixed();
+        WriteUnsigned(fixed.size() - fixed_start);
+        m_out.insert(m_out.end(), fixed.begin() + fixed_start, fixed.end());
+
+        const std::vector<Bytecode::Fixup>& fixups = bc->getFixups();
+        WriteUnsigned(fixups.size() - fixups_start);
+        for (std::vector<Bytecode::Fixup>::const_iterator
+             i=fixups.begin() + fixups_start, fend=fixups.end();
+             i != fend; ++i)
+        {
+            WriteUnsigned(i->getOffset() - fixed_start);
+            if (!WriteValue(*i))
+                return false;
+        }
+
+        WriteUnsigned(bc->hasContents());
+        if (bc->hasContents())
+        {
+            if (!WriteSource(bc->getSource()) ||
+                !WriteContents(bc->getContents()))
+                return false;
+        }
+        fixed_start = 0;
+        fixups_start = 0;
+    }
+    return true;
+}
+
+RecordReader::RecordReader(InputBuffer& in,
+                           const Arch& arch,
+                           Object& object,
+                           SourceLocation begin,
+                           SourceLocation end)
+    : m_in(in),
+      m_arch(arch),
+      m_object(object),
+      m_begin(begin),
+      m_end(end)
+{
+}
+
+uint64_t
+RecordReader::ReadUnsigned()
+{
+    uint64_t val = 0;
+    for (unsigned int shift = 0; shift < 64; shift += 7)
+    {
+        unsigned char byte = ReadU8(m_in);
+        val |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+            return val;
+    }
+    throw std::out_of_range("bad number in parse record");
+}
+
+uint64_t
+RecordReader::ReadUnsigned(uint64_t max)
+{
+    uint64_t val = ReadUnsigned();
+    if (val > max)
+        throw std::out_of_range("number too large in parse record");
+    return val;
+}
+
+StringRef
+RecordReader::ReadString()
+{
+    return m_in.ReadString(ReadUnsigned());
+}
+
+IntNum
+RecordReader::ReadIntNum()
+{
+    return ReadSLEB128(m_in);
+}
+
+SourceLocation
+RecordReader::ReadSource()
+{
+    uint64_t offset = ReadUnsigned();
+    if (offset == 0)
+        return SourceLocation();
+    if (offset-1 > m_end.getRawEncoding() - m_begin.getRawEncoding())
+        throw std::out_of_range("bad source location in parse record");
+    return m_begin.getLocWithOffset(offset-1);
+}
+
+SymbolRef
+RecordReader::ReadSymbol()
+{
+    uint64_t kind = ReadUnsigned();
+    if (kind == SYM_NONE)
+        return SymbolRef(0);
+    StringRef name = ReadString();
+    SymbolRef sym;
+    if (kind == SYM_NAMED)
+        sym = m_object.FindSymbol(name);
+    else if (kind == SYM_SPECIAL)
+        sym = m_object.FindSpecialSymbol(name);
+    if (!sym)
+        throw std::out_of_range("bad symbol in parse record");
+    return sym;
+}
+
+const Register*
+RecordReader::ReadRegister()
+{
+    if (ReadUnsigned() == 0)
+        return 0;
+    const Register* reg = m_arch.LoadRegister(*this);
+    if (!reg)
+        throw std::out_of_range("bad register in parse record");
+    return reg;
+}
+
+void
+RecordReader::ReadExpr(Expr& e)
+{
+    ExprTerms& terms = e.getTerms();
+    terms.clear();
+    uint64_t num = ReadUnsigned();
+    if (num > m_in.getReadableSize())
+        throw std::out_of_range("bad expression in parse record");
+    terms.reserve(num);
+    for (; num > 0; --num)
+    {
+        uint64_t type = ReadUnsigned();
+        int depth = static_cast<int>(ReadUnsigned());
+        SourceLocation source = ReadSource();
+        switch (type)
+        {
+            case ExprTerm::INT:
+                terms.push_back(ExprTerm(ReadIntNum(), source, depth));
+                break;
+            case ExprTerm::SYM:
+            {
+                SymbolRef sym = ReadSymbol();
+                if (!sym)
+                    throw std::out_of_range("bad symbol in parse record");
+                terms.push_back(ExprTerm(sym, source, depth));
+                break;
+            }
+            case ExprTerm::REG:
+            {
+                const Register* reg = ReadRegister();
+                if (!reg)
+                    throw std::out_of_range("bad register in parse record");
+                terms.push_back(ExprTerm(*reg, source, depth));
+                break;
+            }
+            case ExprTerm::OP:
+            {
+                uint64_t op = ReadUnsigned(Op::SEGOFF);
+                uint64_t nchild = ReadUnsigned(terms.size());
+                if (op == Op::NONNUM)
+                    throw std::out_of_range("bad operator in parse record");
+                terms.push_back(ExprTerm(static_cast<Op::Op>(op),
+                                         static_cast<int>(nchild), source,
+                                         depth));
+                break;
+            }
+            default:
+                throw std::out_of_range("bad expression in parse record");
+        }
+    }
+}
+
+void
+RecordReader::ReadValue(Value& value)
+{
+    unsigned int flags = static_cast<unsigned int>(ReadUnsigned(0xff));
+    unsigned int size = static_cast<unsigned int>(ReadUnsigned(255));
+    unsigned int shift = static_cast<unsigned int>(ReadUnsigned(63));
+    unsigned int insn_start = static_cast<unsigned int>(ReadUnsigned(15));
+    unsigned int next_insn = static_cast<unsigned int>(ReadUnsigned(15));
+    SourceLocation begin = ReadSource();
+    SourceLocation end = ReadSource();
+
+    Value v(size);
+    if (flags & VAL_ABS)
+    {
+        std::auto_ptr<Expr> e(new Expr);
+        ReadExpr(*e);
+        Value(size, e).swap(v);
+    }
+    v.setSigned((flags & VAL_SIGNED) != 0);
+    v.setIPRelative((flags & VAL_IP_REL) != 0);
+    v.setJumpTarget((flags & VAL_JUMP_TARGET) != 0);
+    v.setSectionRelative((flags & VAL_SECTION_REL) != 0);
+    if (flags & VAL_NO_WARN)
+        v.DisableWarn();
+    v.setShift(shift);
+    v.setInsnStart(insn_start);
+    v.setNextInsn(next_insn);
+    v.setSource(SourceRange(begin, end));
+    value.swap(v);
+}
+
+void
+RecordReader::ReadContents(Bytecode& bc)
+{
+    StringRef type = ReadString();
+    if (!m_arch.LoadContents(type, *this, bc))
+        throw std::out_of_range("bad contents in parse record");
+}
+
+void
+RecordReader::ReadAppended(BytecodeContainer& container)
+{
+    uint64_t count = ReadUnsigned();
+    if (count == 0 || count > m_in.getReadableSize())
+        throw std::out_of_range("bad bytecodes in parse record");
+    for (uint64_t n = 0; n < count; ++n)
+    {
+        Bytecode& bc = n == 0 ? container.FreshBytecode()
+                              : container.StartBytecode();
+        Bytes& fixed = bc.getFixed();
+        std::size_t fixed_start = fixed.size();
+        ArrayRef<unsigned char> bytes = m_in.Read(ReadUnsigned());
+        fixed.Write(bytes);
+
+        for (uint64_t fixups = ReadUnsigned(); fixups > 0; --fixups)
+        {
+            uint64_t offset = ReadUnsigned();
+            std::auto_ptr<Value> value(new Value(0));
+            ReadValue(*value);
+            if (offset + value->getSize()/8 > bytes.size())
+                throw std::out_of_range("bad fixup in parse record");
+            bc.AppendFixup(Bytecode::Fixup(
+                static_cast<unsigned int>(fixed_start + offset), value));
+        }
+
+        if (ReadUnsigned() != 0)
+        {
+            SourceLocation source = ReadSource();
+            ReadContents(bc);
+            bc.setSource(source);
+        }
+    }
+}
@@ -26,6 +26,7 @@
 //
 #include "yasmx/Reloc.h"
 
+#include "yasmx/Section.h"
 
 using namespace yasm;
 
@@ -39,6 +40,22 @@ Reloc::~Reloc()
 {
 }
 
+void*
+Reloc::operator new(std::size_t size, Section& sect)
+{
+    return sect.AllocateReloc(size);
+}
+
+void
+Reloc::operator delete(void* ptr, Section& sect)
+{
+}
+
+void
+Reloc::operator delete(void* ptr)
+{
+}
+
 Expr
 Reloc::getValue() const
 {
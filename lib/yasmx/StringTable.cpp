@@ -36,6 +36,7 @@ StringTable::StringTable(unsigned long first_index)
     : m_first_index(first_index)
 {
     m_storage.push_back('\0');
+    m_indexes[""] = first_index;
 }
 
 StringTable::~StringTable()
@@ -45,9 +46,15 @@ StringTable::~StringTable()
 unsigned long
 StringTable::getIndex(StringRef str)
 {
+    llvm::StringMapEntry<unsigned long>& entry =
+        m_indexes.GetOrCreateValue(str, ~0UL);
+    if (entry.getValue() != ~0UL)
+        return entry.getValue();
+
     unsigned long end = m_storage.size();
     m_storage.insert(m_storage.end(), str.begin(), str.end());
     m_storage.push_back('\0');
+    entry.setValue(m_first_index+end);
     return m_first_index+end;
 }
 
@@ -67,5 +74,6 @@ void
 StringTable::Read(StringRef buf)
 {
     m_storage.clear();
+    m_indexes.clear();
     m_storage.insert(m_storage.end(), buf.begin(), buf.end());
 }
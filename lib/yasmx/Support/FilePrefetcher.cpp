@@ -0,0 +1,309 @@
+//
+// Background file reader implementation.
+//
+//  Copyright (C) 2026  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include "yasmx/Support/Pipeline.h"
+#include "yasmx/Support/FilePrefetcher.h"
+
+#include "llvm/Config/config.h"
+
+#include <deque>
+
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/system_error.h"
+
+#if LLVM_ENABLE_THREADS != 0 && defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+#define YASM_PREFETCH_PTHREADS 1
+#endif
+
+
+using namespace yasm;
+using llvm::MemoryBuffer;
+using llvm::OwningPtr;
+using llvm::StringRef;
+
+#ifdef YASM_PREFETCH_PTHREADS
+namespace yasm {
+class FilePrefetcher::Impl
+{
+public:
+    Impl();
+    ~Impl();
+
+    void Prefetch(const std::vector<std::string>& paths, bool keep);
+    MemoryBuffer* Take(StringRef path);
+
+private:
+    static void* ThreadMain(void* arg);
+    void Work();
+
+    enum State
+    {
+        PENDING,                    // queued or being read
+        MISSING,                    // could not be read
+        FOUND                       // read; buf is 0 once taken
+    };
+    struct File
+    {
+        File() : state(PENDING), buf(0) {}
+        State state;
+        MemoryBuffer* buf;
+    };
+    struct Request
+    {
+        std::vector<std::string> paths;
+        bool keep;
+    };
+
+    pthread_mutex_t m_lock;
+    pthread_cond_t m_work_cv;       // signaled when a request is queued or
+                                    // the thread should stop
+    pthread_cond_t m_done_cv;       // signaled when a file has been read
+    std::deque<Request> m_queue;
+    llvm::StringMap<File> m_files;
+
+    pthread_t m_thread;
+    bool m_started;
+    bool m_failed;                  // thread could not be started
+    bool m_stop;
+};
+} // namespace yasm
+
+FilePrefetcher::Impl::Impl()
+    : m_started(false),
+      m_failed(false),
+      m_stop(false)
+{
+    pthread_mutex_init(&m_lock, 0);
+    pthread_cond_init(&m_work_cv, 0);
+    pthread_cond_init(&m_done_cv, 0);
+}
+
+FilePrefetcher::Impl::~Impl()
+{
+    pthread_mutex_lock(&m_lock);
+    m_stop = true;
+    m_queue.clear();
+    pthread_cond_signal(&m_work_cv);
+    pthread_mutex_unlock(&m_lock);
+    if (m_started)
+        pthread_join(m_thread, 0);
+
+    for (llvm::StringMap<File>::iterator i=m_files.begin(), end=m_files.end();
+         i != end; ++i)
+        delete i->getValue().buf;
+
+    pthread_cond_destroy(&m_done_cv);
+    pthread_cond_destroy(&m_work_cv);
+    pthread_mutex_destroy(&m_lock);
+}
+
+void*
+FilePrefetcher::Impl::ThreadMain(void* arg)
+{
+    static_cast<Impl*>(arg)->Work();
+    return 0;
+}
+
+void
+FilePrefetcher::Impl::Prefetch(const std::vector<std::string>& paths,
+                               bool keep)
+{
+    pthread_mutex_lock(&m_lock);
+    if (m_failed)
+    {
+        pthread_mutex_unlock(&m_lock);
+        return;
+    }
+
+    // Skip candidates already known to be missing; stop at one that has
+    // been found (or may yet be), as the rest would be shadowed by it.
+    Request req;
+    req.keep = keep;
+    for (std::vector<std::string>::const_iterator i=paths.begin(),
+         end=paths.end(); i != end; ++i)
+    {
+        llvm::StringMap<File>::iterator file = m_files.find(*i);
+        if (file == m_files.end())
+            req.paths.push_back(*i);
+        else if (file->getValue().state != MISSING)
+            break;
+    }
+    if (req.paths.empty())
+    {
+        pthread_mutex_unlock(&m_lock);
+        return;
+    }
+
+    if (!m_started)
+    {
+        if (pthread_create(&m_thread, 0, &ThreadMain, this) != 0)
+        {
+            m_failed = true;
+            pthread_mutex_unlock(&m_lock);
+            return;
+        }
+        m_started = true;
+    }
+
+    for (std::vector<std::string>::const_iterator i=req.paths.begin(),
+         end=req.paths.end(); i != end; ++i)
+        m_files.GetOrCreateValue(*i);
+    m_queue.push_back(Request());
+    m_queue.back().paths.swap(req.paths);
+    m_queue.back().keep = keep;
+    pthread_cond_signal(&m_work_cv);
+    pthread_mutex_unlock(&m_lock);
+}
+
+// Touch every page of a buffer, so a memory mapped file is actually read
+// now rather than when the page is first used.
+static void
+TouchPages(const MemoryBuffer& buf)
+{
+    volatile char sink;
+    for (const char* p=buf.getBufferStart(), *end=buf.getBufferEnd(); p < end;
+         p += 4096)
+        sink = *p;
+    (void)sink;
+}
+
+void
+FilePrefetcher::Impl::Work()
+{
+    pthread_mutex_lock(&m_lock);
+    for (;;)
+    {
+        while (!m_stop && m_queue.empty())
+            pthread_cond_wait(&m_work_cv, &m_lock);
+        if (m_stop)
+            break;
+
+        Request req;
+        req.paths.swap(m_queue.front().paths);
+        req.keep = m_queue.front().keep;
+        m_queue.pop_front();
+
+        for (std::size_t i=0; i<req.paths.size(); ++i)
+        {
+            pthread_mutex_unlock(&m_lock);
+            OwningPtr<MemoryBuffer> buf;
+            bool found = !MemoryBuffer::getFile(req.paths[i], buf);
+            if (found)
+                TouchPages(*buf);
+            pthread_mutex_lock(&m_lock);
+
+            File& file = m_files[req.paths[i]];
+            if (!found)
+            {
+                file.state = MISSING;
+                pthread_cond_broadcast(&m_done_cv);
+                if (m_stop)
+                    break;
+                continue;
+            }
+
+            file.state = FOUND;
+            if (req.keep)
+                file.buf = buf.take();
+
+            // The remaining candidates weren't looked at, so forget them.
+            for (std::size_t j=i+1; j<req.paths.size(); ++j)
+                m_files.erase(req.paths[j]);
+            pthread_cond_broadcast(&m_done_cv);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&m_lock);
+}
+
+MemoryBuffer*
+FilePrefetcher::Impl::Take(StringRef path)
+{
+    pthread_mutex_lock(&m_lock);
+    MemoryBuffer* buf = 0;
+    for (;;)
+    {
+        llvm::StringMap<File>::iterator file = m_files.find(path);
+        if (file == m_files.end())
+            break;
+        if (file->getValue().state != PENDING)
+        {
+            buf = file->getValue().buf;
+            file->getValue().buf = 0;
+            break;
+        }
+        pthread_cond_wait(&m_done_cv, &m_lock);
+    }
+    pthread_mutex_unlock(&m_lock);
+    return buf;
+}
+#else
+namespace yasm {
+class FilePrefetcher::Impl
+{
+public:
+    Impl() {}
+    ~Impl() {}
+
+    void Prefetch(const std::vector<std::string>& paths, bool keep) {}
+    MemoryBuffer* Take(StringRef path) { return 0; }
+};
+} // namespace yasm
+#endif
+
+FilePrefetcher::FilePrefetcher()
+    : m_impl(new Impl)
+{
+}
+
+FilePrefetcher::~FilePrefetcher()
+{
+}
+
+bool
+FilePrefetcher::isAvailable()
+{
+#ifdef YASM_PREFETCH_PTHREADS
+    return true;
+#else
+    return false;
+#endif
+}
+
+void
+FilePrefetcher::Prefetch(const std::vector<std::string>& paths, bool keep)
+{
+    m_impl->Prefetch(paths, keep);
+}
+
+MemoryBuffer*
+FilePrefetcher::Take(StringRef path)
+{
+    return m_impl->Take(path);
+}
@@ -0,0 +1,103 @@
+//
+// Memory use accounting implementation.
+//
+//  Copyright (C) 2026  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include "yasmx/Support/MemoryStats.h"
+
+#include "llvm/Support/Mutex.h"
+
+
+using namespace yasm;
+
+static bool memory_stats_enabled = false;
+static llvm::sys::Mutex* memory_stats_lock = 0;
+static std::size_t memory_current[NUM_MEMORY_CATEGORIES];
+static std::size_t memory_peak[NUM_MEMORY_CATEGORIES];
+
+void
+yasm::EnableMemoryStats()
+{
+    if (memory_stats_enabled)
+        return;
+    memory_stats_lock = new llvm::sys::Mutex;
+    memory_stats_enabled = true;
+}
+
+bool
+yasm::isMemoryStatsEnabled()
+{
+    return memory_stats_enabled;
+}
+
+void
+yasm::CountAlloc(MemoryCategory cat, std::size_t size)
+{
+    if (!memory_stats_enabled)
+        return;
+    llvm::sys::ScopedLock lock(*memory_stats_lock);
+    memory_current[cat] += size;
+    if (memory_current[cat] > memory_peak[cat])
+        memory_peak[cat] = memory_current[cat];
+}
+
+void
+yasm::CountFree(MemoryCategory cat, std::size_t size)
+{
+    if (!memory_stats_enabled)
+        return;
+    llvm::sys::ScopedLock lock(*memory_stats_lock);
+    // Guard against frees of memory allocated before counting started.
+    if (size > memory_current[cat])
+        memory_current[cat] = 0;
+    else
+        memory_current[cat] -= size;
+}
+
+void
+yasm::getMemoryStats(MemoryCategory cat, std::size_t* current,
+                     std::size_t* peak)
+{
+    if (!memory_stats_enabled)
+    {
+        *current = *peak = 0;
+        return;
+    }
+    llvm::sys::ScopedLock lock(*memory_stats_lock);
+    *current = memory_current[cat];
+    *peak = memory_peak[cat];
+}
+
+const char*
+yasm::getMemoryCategoryName(MemoryCategory cat)
+{
+    switch (cat)
+    {
+        case MEM_BYTECODE:  return "bytecodes";
+        case MEM_EXPR:      return "expressions";
+        case MEM_SYMBOL:    return "symbols";
+        case MEM_INTNUM:    return "big integers";
+        default:            return "unknown";
+    }
+}
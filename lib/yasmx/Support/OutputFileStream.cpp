@@ -0,0 +1,446 @@
+//
+// Seekable in-memory output file stream implementation.
+//
+//  Copyright (C) 2026  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include "yasmx/Support/OutputFileStream.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+
+using namespace yasm;
+
+// Literal data is kept in pieces of at most this size, so growing or
+// splitting a piece never copies more than this much.
+static const size_t MAX_LITERAL = 1024*1024;
+
+// Fills of at most this many bytes are stored as literal data.
+static const uint64_t MIN_RUN = 4096;
+
+static inline bool
+isZeroBlock(const char* p, size_t size)
+{
+    return p[0] == 0 && std::memcmp(p, p+1, size-1) == 0;
+}
+
+// Write count copies of pattern to dest, doubling the copied region so
+// long fills take few copies.
+static void
+Replicate(char* dest, const std::vector<char>& pattern, uint64_t count)
+{
+    size_t total = static_cast<size_t>(pattern.size() * count);
+    if (total == 0)
+        return;
+    std::memcpy(dest, &pattern[0], pattern.size());
+    for (size_t done = pattern.size(); done < total; )
+    {
+        size_t n = std::min(done, total - done);
+        std::memcpy(dest + done, dest, n);
+        done += n;
+    }
+}
+
+namespace {
+/// Writes a file image to a stream in order.  If the stream is a seekable
+/// file, runs of at least SPARSE_THRESHOLD zeros are skipped over.
+class ImageWriter
+{
+public:
+    ImageWriter(raw_ostream& os, raw_fd_ostream* fd_os);
+
+    void Literal(const std::vector<char>& data);
+    void Fill(const std::vector<char>& pattern, uint64_t count);
+    void Zeros(uint64_t size) { m_zeros += size; }
+    void Finish();
+
+private:
+    void Data(const char* data, size_t size);
+    void FlushZeros();
+
+    raw_ostream& m_os;
+    raw_fd_ostream* m_fd_os;    // m_os if holes can be left
+    uint64_t m_base;            // file position of start of image
+    uint64_t m_pos;             // end of image written or skipped so far
+    uint64_t m_zeros;           // zeros pending after m_pos
+};
+} // anonymous namespace
+
+ImageWriter::ImageWriter(raw_ostream& os, raw_fd_ostream* fd_os)
+    : m_os(os)
+    , m_fd_os(fd_os)
+    , m_base(0)
+    , m_pos(0)
+    , m_zeros(0)
+{
+    // Holes are placed relative to the starting file position, which is
+    // normally the start of a freshly truncated file.
+    if (m_fd_os)
+        m_base = m_fd_os->tell();
+}
+
+void
+ImageWriter::FlushZeros()
+{
+    static const char zeros[4096] = {0};
+
+    if (m_fd_os && m_zeros >= OutputFileStream::SPARSE_THRESHOLD)
+    {
+        m_pos += m_zeros;
+        m_fd_os->seek(m_base + m_pos);
+        m_zeros = 0;
+        return;
+    }
+
+    for (; m_zeros != 0; )
+    {
+        size_t n = static_cast<size_t>(
+            std::min<uint64_t>(m_zeros, sizeof(zeros)));
+        m_os.write(zeros, n);
+        m_pos += n;
+        m_zeros -= n;
+    }
+}
+
+void
+ImageWriter::Data(const char* data, size_t size)
+{
+    if (size == 0)
+        return;
+    FlushZeros();
+    m_os.write(data, size);
+    m_pos += size;
+}
+
+void
+ImageWriter::Literal(const std::vector<char>& data)
+{
+    static const size_t BLOCK_SIZE = 4096;
+
+    if (data.empty())
+        return;
+    const char* p = &data[0];
+    size_t size = data.size();
+    if (!m_fd_os)
+    {
+        Data(p, size);
+        return;
+    }
+
+    // Look for whole zero blocks that may join a hole.
+    size_t start = 0;
+    for (size_t pos = 0; pos+BLOCK_SIZE <= size; pos += BLOCK_SIZE)
+    {
+        if (!isZeroBlock(p+pos, BLOCK_SIZE))
+            continue;
+        Data(p+start, pos-start);
+        Zeros(BLOCK_SIZE);
+        start = pos+BLOCK_SIZE;
+    }
+    Data(p+start, size-start);
+}
+
+void
+ImageWriter::Fill(const std::vector<char>& pattern, uint64_t count)
+{
+    static const size_t BLOCK_SIZE = 64*1024;
+
+    if (isZeroBlock(&pattern[0], pattern.size()))
+    {
+        Zeros(pattern.size() * count);
+        return;
+    }
+
+    // Write a block of as many copies as fit at a time.
+    uint64_t per_block = std::max<uint64_t>(1, BLOCK_SIZE / pattern.size());
+    per_block = std::min(per_block, count);
+    std::vector<char> block(static_cast<size_t>(pattern.size() * per_block));
+    Replicate(&block[0], pattern, per_block);
+    for (; count >= per_block; count -= per_block)
+        Data(&block[0], block.size());
+    Data(&block[0], static_cast<size_t>(pattern.size() * count));
+}
+
+void
+ImageWriter::Finish()
+{
+    if (m_fd_os && m_zeros >= OutputFileStream::SPARSE_THRESHOLD)
+    {
+        // The image ends in a hole; write its last byte to set the size.
+        m_pos += m_zeros - 1;
+        m_zeros = 1;
+        m_fd_os->seek(m_base + m_pos);
+    }
+    FlushZeros();
+}
+
+OutputFileStream::OutputFileStream(raw_ostream& os)
+    : m_os(&os)
+    , m_image(0)
+    , m_fd_os(0)
+    , m_size(0)
+    , m_pos(0)
+    , m_closed(false)
+{
+}
+
+OutputFileStream::OutputFileStream(raw_fd_ostream& os)
+    : m_os(&os)
+    , m_image(0)
+    , m_fd_os(os.supportsSeeking() ? &os : 0)
+    , m_size(0)
+    , m_pos(0)
+    , m_closed(false)
+{
+}
+
+OutputFileStream::OutputFileStream(std::vector<char>& image)
+    : m_os(0)
+    , m_image(&image)
+    , m_fd_os(0)
+    , m_size(0)
+    , m_pos(0)
+    , m_closed(false)
+{
+}
+
+OutputFileStream::~OutputFileStream()
+{
+    // raw_ostream requires an empty buffer on destruction.
+    if (!m_closed)
+        flush();
+}
+
+uint64_t
+OutputFileStream::seek(uint64_t off)
+{
+    flush();
+    if (off > m_size)
+    {
+        m_pos = m_size;
+        write_zeros(off - m_size);
+    }
+    m_pos = off;
+    return m_pos;
+}
+
+void
+OutputFileStream::write_zeros(uint64_t size)
+{
+    static const char zero = 0;
+    write_fill(&zero, 1, size);
+}
+
+void
+OutputFileStream::write_fill(const char* pattern, size_t size, uint64_t count)
+{
+    flush();
+    assert(!m_closed && "write to closed output file stream");
+    if (size == 0 || count == 0)
+        return;
+
+    if (count <= MIN_RUN / size)
+    {
+        for (; count != 0; --count)
+            write_impl(pattern, size);
+        return;
+    }
+
+    Extent run;
+    run.data.assign(pattern, pattern+size);
+    run.count = count;
+    replace(run);
+}
+
+void
+OutputFileStream::close()
+{
+    assert(!m_closed && "output file stream already closed");
+    flush();
+    m_closed = true;
+    if (m_image)
+    {
+        std::vector<char> image(static_cast<size_t>(m_size));
+        size_t pos = 0;
+        for (Extents::const_iterator i=m_extents.begin(),
+             end=m_extents.end(); i != end; ++i)
+        {
+            Replicate(&image[pos], i->second.data, i->second.count);
+            pos += static_cast<size_t>(i->second.size());
+        }
+        m_image->swap(image);
+    }
+    else
+    {
+        ImageWriter writer(*m_os, m_size >= SPARSE_THRESHOLD ? m_fd_os : 0);
+        for (Extents::const_iterator i=m_extents.begin(),
+             end=m_extents.end(); i != end; ++i)
+        {
+            if (i->second.count == 1)
+                writer.Literal(i->second.data);
+            else
+                writer.Fill(i->second.data, i->second.count);
+        }
+        writer.Finish();
+        m_os->flush();
+    }
+
+    Extents empty;
+    m_extents.swap(empty);
+}
+
+OutputFileStream::Extents::iterator
+OutputFileStream::split(uint64_t off)
+{
+    assert(off < m_size && "split past end of file image");
+    Extents::iterator i = m_extents.upper_bound(off);
+    --i;
+    if (i->first == off)
+        return i;
+
+    Extent& extent = i->second;
+    uint64_t rel = off - i->first;
+    if (extent.count == 1)
+    {
+        Extents::iterator tail =
+            m_extents.insert(i, Extents::value_type(off, Extent()));
+        tail->second.data.assign(extent.data.begin() + rel,
+                                 extent.data.end());
+        tail->second.count = 1;
+        extent.data.resize(static_cast<size_t>(rel));
+        return tail;
+    }
+
+    // Separate the copy of the pattern containing off from the whole
+    // copies before and after it, then split that copy.
+    uint64_t len = extent.data.size();
+    uint64_t copy = rel / len;
+    uint64_t copy_start = i->first + copy*len;
+    if (copy+1 < extent.count)
+    {
+        Extents::iterator after =
+            m_extents.insert(i, Extents::value_type(copy_start+len, extent));
+        after->second.count = extent.count - copy - 1;
+    }
+    if (copy == 0)
+        extent.count = 1;
+    else
+    {
+        Extents::iterator middle =
+            m_extents.insert(i, Extents::value_type(copy_start, Extent()));
+        middle->second.data = extent.data;
+        middle->second.count = 1;
+        extent.count = copy;
+    }
+    return split(off);
+}
+
+void
+OutputFileStream::replace(Extent& extent)
+{
+    uint64_t end = m_pos + extent.size();
+    Extents::iterator next = m_extents.end();
+    if (m_pos < m_size)
+    {
+        Extents::iterator first = split(m_pos);
+        next = end < m_size ? split(end) : m_extents.end();
+        m_extents.erase(first, next);
+    }
+    else if (!m_extents.empty())
+    {
+        // Extend the last run if this continues it.
+        Extent& back = (--m_extents.end())->second;
+        if (back.data == extent.data)
+        {
+            back.count += extent.count;
+            m_pos = m_size = end;
+            return;
+        }
+    }
+
+    Extents::iterator i =
+        m_extents.insert(next, Extents::value_type(m_pos, Extent()));
+    i->second.data.swap(extent.data);
+    i->second.count = extent.count;
+    m_pos = end;
+    m_size = std::max(m_size, end);
+}
+
+void
+OutputFileStream::write_impl(const char* ptr, size_t size)
+{
+    assert(!m_closed && "write to closed output file stream");
+    assert(m_pos <= m_size && "position past end of file image");
+
+    // Overwrite any existing data; runs are replaced rather than expanded.
+    while (size != 0 && m_pos < m_size)
+    {
+        Extents::iterator i = m_extents.upper_bound(m_pos);
+        --i;
+        Extent& extent = i->second;
+        uint64_t rel = m_pos - i->first;
+        size_t n = static_cast<size_t>(
+            std::min<uint64_t>(size, extent.size() - rel));
+        if (extent.count == 1)
+        {
+            std::memcpy(&extent.data[rel], ptr, n);
+            m_pos += n;
+        }
+        else
+        {
+            Extent literal;
+            literal.data.assign(ptr, ptr+n);
+            literal.count = 1;
+            replace(literal);
+        }
+        ptr += n;
+        size -= n;
+    }
+
+    // Append the remainder as literal data.
+    while (size != 0)
+    {
+        Extent* back = 0;
+        if (!m_extents.empty())
+            back = &(--m_extents.end())->second;
+        if (!back || back->count != 1 || back->data.size() >= MAX_LITERAL)
+        {
+            back = &m_extents[m_pos];
+            back->count = 1;
+        }
+        size_t n = std::min(size, MAX_LITERAL - back->data.size());
+        back->data.insert(back->data.end(), ptr, ptr+n);
+        ptr += n;
+        size -= n;
+        m_pos += n;
+        m_size = m_pos;
+    }
+}
+
+uint64_t
+OutputFileStream::current_pos() const
+{
+    return m_pos;
+}
@@ -0,0 +1,255 @@
+//
+// Two-stage producer/consumer pipeline implementation.
+//
+//  Copyright (C) 2026  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include "yasmx/Support/Pipeline.h"
+
+#include "llvm/Config/config.h"
+
+#include <deque>
+
+#if LLVM_ENABLE_THREADS != 0 && defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+#define YASM_PIPELINE_PTHREADS 1
+#endif
+
+
+using namespace yasm;
+
+#ifdef YASM_PIPELINE_PTHREADS
+namespace yasm {
+class Pipeline::Impl
+{
+public:
+    Impl(std::size_t max_chunks);
+    ~Impl();
+
+    bool Run(const Stage& producer, const Stage& consumer);
+    void Push(std::string& chunk);
+    void Close();
+    void WaitIdle();
+    bool Pop(std::string& chunk);
+    void Abandon();
+
+private:
+    static void* ProducerMain(void* arg);
+
+    pthread_mutex_t m_lock;
+    pthread_cond_t m_producer_cv;   // signaled when the consumer takes a
+                                    // chunk, waits, or abandons
+    pthread_cond_t m_consumer_cv;   // signaled when a chunk is queued or
+                                    // the pipeline is closed
+    std::deque<std::string> m_queue;
+    std::size_t m_max_chunks;
+
+    const Stage* m_producer;
+    bool m_closed;
+    bool m_abandoned;
+    bool m_waiting;                 // consumer is waiting for a chunk
+};
+} // namespace yasm
+
+Pipeline::Impl::Impl(std::size_t max_chunks)
+    : m_max_chunks(max_chunks == 0 ? 1 : max_chunks),
+      m_producer(0),
+      m_closed(false),
+      m_abandoned(false),
+      m_waiting(false)
+{
+    pthread_mutex_init(&m_lock, 0);
+    pthread_cond_init(&m_producer_cv, 0);
+    pthread_cond_init(&m_consumer_cv, 0);
+}
+
+Pipeline::Impl::~Impl()
+{
+    pthread_cond_destroy(&m_consumer_cv);
+    pthread_cond_destroy(&m_producer_cv);
+    pthread_mutex_destroy(&m_lock);
+}
+
+void*
+Pipeline::Impl::ProducerMain(void* arg)
+{
+    Impl* pipe = static_cast<Impl*>(arg);
+    (*pipe->m_producer)();
+    return 0;
+}
+
+bool
+Pipeline::Impl::Run(const Stage& producer, const Stage& consumer)
+{
+    m_queue.clear();
+    m_producer = &producer;
+    m_closed = false;
+    m_abandoned = false;
+    m_waiting = false;
+
+    pthread_t thread;
+    if (pthread_create(&thread, 0, &ProducerMain, this) != 0)
+        return false;
+    consumer();
+    pthread_join(thread, 0);
+    m_producer = 0;
+    return true;
+}
+
+void
+Pipeline::Impl::Push(std::string& chunk)
+{
+    pthread_mutex_lock(&m_lock);
+    while (!m_abandoned && m_queue.size() >= m_max_chunks)
+        pthread_cond_wait(&m_producer_cv, &m_lock);
+    if (!m_abandoned)
+    {
+        m_queue.push_back(std::string());
+        m_queue.back().swap(chunk);
+        pthread_cond_signal(&m_consumer_cv);
+    }
+    pthread_mutex_unlock(&m_lock);
+    chunk.clear();
+}
+
+void
+Pipeline::Impl::Close()
+{
+    pthread_mutex_lock(&m_lock);
+    m_closed = true;
+    pthread_cond_signal(&m_consumer_cv);
+    pthread_mutex_unlock(&m_lock);
+}
+
+void
+Pipeline::Impl::WaitIdle()
+{
+    pthread_mutex_lock(&m_lock);
+    while (!m_abandoned && (!m_queue.empty() || !m_waiting))
+        pthread_cond_wait(&m_producer_cv, &m_lock);
+    pthread_mutex_unlock(&m_lock);
+}
+
+bool
+Pipeline::Impl::Pop(std::string& chunk)
+{
+    pthread_mutex_lock(&m_lock);
+    while (m_queue.empty() && !m_closed)
+    {
+        m_waiting = true;
+        pthread_cond_signal(&m_producer_cv);
+        pthread_cond_wait(&m_consumer_cv, &m_lock);
+        m_waiting = false;
+    }
+    bool ok = !m_queue.empty();
+    if (ok)
+    {
+        chunk.swap(m_queue.front());
+        m_queue.pop_front();
+        pthread_cond_signal(&m_producer_cv);
+    }
+    pthread_mutex_unlock(&m_lock);
+    return ok;
+}
+
+void
+Pipeline::Impl::Abandon()
+{
+    pthread_mutex_lock(&m_lock);
+    m_abandoned = true;
+    m_queue.clear();
+    pthread_cond_signal(&m_producer_cv);
+    pthread_mutex_unlock(&m_lock);
+}
+#else
+namespace yasm {
+class Pipeline::Impl
+{
+public:
+    Impl(std::size_t max_chunks) {}
+    ~Impl() {}
+
+    bool Run(const Stage& producer, const Stage& consumer) { return false; }
+    void Push(std::string& chunk) { chunk.clear(); }
+    void Close() {}
+    void WaitIdle() {}
+    bool Pop(std::string& chunk) { return false; }
+    void Abandon() {}
+};
+} // namespace yasm
+#endif
+
+Pipeline::Pipeline(std::size_t max_chunks)
+    : m_impl(new Impl(max_chunks))
+{
+}
+
+Pipeline::~Pipeline()
+{
+}
+
+bool
+Pipeline::isAvailable()
+{
+#ifdef YASM_PIPELINE_PTHREADS
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool
+Pipeline::Run(const Stage& producer, const Stage& consumer)
+{
+    return m_impl->Run(producer, consumer);
+}
+
+void
+Pipeline::Push(std::string& chunk)
+{
+    m_impl->Push(chunk);
+}
+
+void
+Pipeline::Close()
+{
+    m_impl->Close();
+}
+
+void
+Pipeline::WaitIdle()
+{
+    m_impl->WaitIdle();
+}
+
+bool
+Pipeline::Pop(std::string& chunk)
+{
+    return m_impl->Pop(chunk);
+}
+
+void
+Pipeline::Abandon()
+{
+    m_impl->Abandon();
+}
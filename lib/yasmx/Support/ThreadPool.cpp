@@ -0,0 +1,226 @@
+//
+// Worker thread pool implementation.
+//
+//  Copyright (C) 2026  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include "yasmx/Support/ThreadPool.h"
+
+#include "llvm/Config/config.h"
+
+#include <vector>
+
+#if LLVM_ENABLE_THREADS != 0 && defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+#define YASM_THREADPOOL_PTHREADS 1
+#endif
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef LLVM_ON_WIN32
+#include <windows.h>
+#endif
+
+
+using namespace yasm;
+
+#ifdef YASM_THREADPOOL_PTHREADS
+namespace yasm {
+class ThreadPool::Impl
+{
+public:
+    Impl(unsigned int num_workers);
+    ~Impl();
+
+    void Run(std::size_t count, const Job& job);
+
+private:
+    static void* WorkerMain(void* arg);
+
+    // Run jobs until there are none left to start.  Called with
+    // m_lock held; returns with m_lock held.
+    void RunJobs();
+
+    pthread_mutex_t m_lock;
+    pthread_cond_t m_work_cv;       // signaled when jobs are available
+    pthread_cond_t m_done_cv;       // signaled when the last job finishes
+    std::vector<pthread_t> m_workers;
+
+    const Job* m_job;
+    std::size_t m_next;             // next job index to start
+    std::size_t m_count;            // total number of jobs
+    std::size_t m_running;          // number of jobs currently running
+    bool m_shutdown;
+};
+} // namespace yasm
+
+ThreadPool::Impl::Impl(unsigned int num_workers)
+    : m_job(0),
+      m_next(0),
+      m_count(0),
+      m_running(0),
+      m_shutdown(false)
+{
+    pthread_mutex_init(&m_lock, 0);
+    pthread_cond_init(&m_work_cv, 0);
+    pthread_cond_init(&m_done_cv, 0);
+
+    m_workers.reserve(num_workers);
+    for (unsigned int i=0; i<num_workers; ++i)
+    {
+        pthread_t thread;
+        if (pthread_create(&thread, 0, &WorkerMain, this) != 0)
+            break;  // run with what we have
+        m_workers.push_back(thread);
+    }
+}
+
+ThreadPool::Impl::~Impl()
+{
+    pthread_mutex_lock(&m_lock);
+    m_shutdown = true;
+    pthread_cond_broadcast(&m_work_cv);
+    pthread_mutex_unlock(&m_lock);
+
+    for (std::vector<pthread_t>::iterator i=m_workers.begin(),
+         end=m_workers.end(); i != end; ++i)
+        pthread_join(*i, 0);
+
+    pthread_cond_destroy(&m_done_cv);
+    pthread_cond_destroy(&m_work_cv);
+    pthread_mutex_destroy(&m_lock);
+}
+
+void*
+ThreadPool::Impl::WorkerMain(void* arg)
+{
+    Impl* pool = static_cast<Impl*>(arg);
+    pthread_mutex_lock(&pool->m_lock);
+    for (;;)
+    {
+        while (!pool->m_shutdown &&
+               (!pool->m_job || pool->m_next >= pool->m_count))
+            pthread_cond_wait(&pool->m_work_cv, &pool->m_lock);
+        if (pool->m_shutdown)
+            break;
+        pool->RunJobs();
+    }
+    pthread_mutex_unlock(&pool->m_lock);
+    return 0;
+}
+
+void
+ThreadPool::Impl::RunJobs()
+{
+    while (m_next < m_count)
+    {
+        std::size_t index = m_next++;
+        const Job& job = *m_job;
+        ++m_running;
+        pthread_mutex_unlock(&m_lock);
+        job(index);
+        pthread_mutex_lock(&m_lock);
+        --m_running;
+    }
+    if (m_running == 0)
+        pthread_cond_broadcast(&m_done_cv);
+}
+
+void
+ThreadPool::Impl::Run(std::size_t count, const Job& job)
+{
+    pthread_mutex_lock(&m_lock);
+    m_job = &job;
+    m_next = 0;
+    m_count = count;
+    pthread_cond_broadcast(&m_work_cv);
+
+    // Help out, then wait for any stragglers.
+    RunJobs();
+    while (m_running != 0)
+        pthread_cond_wait(&m_done_cv, &m_lock);
+
+    m_job = 0;
+    m_count = 0;
+    pthread_mutex_unlock(&m_lock);
+}
+#else
+namespace yasm {
+class ThreadPool::Impl
+{
+public:
+    Impl(unsigned int num_workers) {}
+    ~Impl() {}
+
+    void Run(std::size_t count, const Job& job)
+    {
+        for (std::size_t i=0; i<count; ++i)
+            job(i);
+    }
+};
+} // namespace yasm
+#endif
+
+ThreadPool::ThreadPool(unsigned int num_threads)
+    : m_num_threads(num_threads == 0 ? getNumProcessors() : num_threads),
+      m_impl(0)
+{
+#ifndef YASM_THREADPOOL_PTHREADS
+    m_num_threads = 1;
+#endif
+    if (m_num_threads > 1)
+        m_impl.reset(new Impl(m_num_threads-1));
+}
+
+ThreadPool::~ThreadPool()
+{
+}
+
+void
+ThreadPool::Run(std::size_t count, const Job& job)
+{
+    if (m_impl.get() == 0 || count <= 1)
+    {
+        for (std::size_t i=0; i<count; ++i)
+            job(i);
+        return;
+    }
+    m_impl->Run(count, job);
+}
+
+unsigned int
+ThreadPool::getNumProcessors()
+{
+    long n = 1;
+#if defined(LLVM_ON_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    n = static_cast<long>(info.dwNumberOfProcessors);
+#elif defined(_SC_NPROCESSORS_ONLN)
+    n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (n < 1)
+        n = 1;
+    return static_cast<unsigned int>(n);
+}
@@ -0,0 +1,191 @@
+//
+// Phase tracing implementation.
+//
+//  Copyright (C) 2026  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include "yasmx/Support/Trace.h"
+
+#include <vector>
+
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Mutex.h"
+#include "llvm/Support/ThreadLocal.h"
+#include "llvm/Support/TimeValue.h"
+#include "llvm/Support/raw_ostream.h"
+#include "yasmx/Basic/LLVM.h"
+
+
+using namespace yasm;
+
+namespace {
+struct TraceEvent
+{
+    std::string name;
+    std::string detail;
+    char phase;                 // 'X' (complete), 'B' (begin), or 'E' (end)
+    double ts;                  // start time, in microseconds
+    double dur;                 // duration ('X' only), in microseconds
+    unsigned long tid;
+};
+} // anonymous namespace
+
+static bool trace_enabled = false;
+static double trace_start = 0;
+static std::vector<TraceEvent>* trace_events = 0;
+static llvm::sys::Mutex* trace_lock = 0;
+static llvm::sys::ThreadLocal<const void>* trace_tid = 0;
+static unsigned long trace_num_threads = 0;
+
+// Get the current time, in microseconds.
+static double
+getTime()
+{
+    llvm::sys::TimeValue now = llvm::sys::TimeValue::now();
+    return now.seconds() * 1e6 + now.nanoseconds() / 1e3;
+}
+
+// Get the time since tracing started, in microseconds.
+static double
+getTraceTime()
+{
+    return getTime() - trace_start;
+}
+
+// Record an event.  The thread is identified by a small index assigned
+// the first time it records an event.
+static void
+AddEvent(StringRef name, StringRef detail, char phase, double ts, double dur)
+{
+    llvm::sys::ScopedLock lock(*trace_lock);
+    unsigned long tid = reinterpret_cast<unsigned long>(trace_tid->get());
+    if (tid == 0)
+    {
+        tid = ++trace_num_threads;
+        trace_tid->set(reinterpret_cast<const void*>(tid));
+    }
+
+    TraceEvent event;
+    event.name = name;
+    event.detail = detail;
+    event.phase = phase;
+    event.ts = ts;
+    event.dur = dur;
+    event.tid = tid;
+    trace_events->push_back(event);
+}
+
+// Write a JSON string.
+static void
+WriteString(llvm::raw_ostream& os, StringRef str)
+{
+    os << '"';
+    for (StringRef::iterator i=str.begin(), end=str.end(); i != end; ++i)
+    {
+        unsigned char ch = *i;
+        if (ch == '"' || ch == '\\')
+            os << '\\' << ch;
+        else if (ch < 0x20)
+            os << llvm::format("\\u%04x", ch);
+        else
+            os << ch;
+    }
+    os << '"';
+}
+
+void
+yasm::EnableTrace()
+{
+    if (trace_enabled)
+        return;
+    trace_events = new std::vector<TraceEvent>;
+    trace_lock = new llvm::sys::Mutex;
+    trace_tid = new llvm::sys::ThreadLocal<const void>;
+    trace_start = getTime();
+    trace_enabled = true;
+}
+
+bool
+yasm::isTraceEnabled()
+{
+    return trace_enabled;
+}
+
+void
+yasm::WriteTrace(llvm::raw_ostream& os)
+{
+    if (!trace_enabled)
+        return;
+    llvm::sys::ScopedLock lock(*trace_lock);
+
+    os << "{\"traceEvents\":[";
+    for (std::vector<TraceEvent>::const_iterator i=trace_events->begin(),
+         end=trace_events->end(); i != end; ++i)
+    {
+        if (i != trace_events->begin())
+            os << ',';
+        os << "\n{\"name\":";
+        WriteString(os, i->name);
+        os << ",\"cat\":\"yasm\",\"ph\":\"" << i->phase << '"';
+        os << ",\"ts\":" << llvm::format("%.3f", i->ts);
+        if (i->phase == 'X')
+            os << ",\"dur\":" << llvm::format("%.3f", i->dur);
+        os << ",\"pid\":1,\"tid\":" << i->tid;
+        if (!i->detail.empty())
+        {
+            os << ",\"args\":{\"detail\":";
+            WriteString(os, i->detail);
+            os << '}';
+        }
+        os << '}';
+    }
+    os << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+void
+yasm::TraceBegin(StringRef name, StringRef detail)
+{
+    if (trace_enabled)
+        AddEvent(name, detail, 'B', getTraceTime(), 0);
+}
+
+void
+yasm::TraceEnd()
+{
+    if (trace_enabled)
+        AddEvent("", "", 'E', getTraceTime(), 0);
+}
+
+void
+TraceRegion::Start(StringRef name, StringRef detail)
+{
+    m_name = name;
+    m_detail = detail;
+    m_start = getTraceTime();
+}
+
+void
+TraceRegion::Stop()
+{
+    AddEvent(m_name, m_detail, 'X', m_start, getTraceTime() - m_start);
+}
@@ -30,6 +30,7 @@
 #include "yasmx/Support/registry.h"
 
 #include <algorithm>
+#include <cstring>
 
 #include "llvm/ADT/IndexedMap.h"
 #include "llvm/ADT/StringMap.h"
@@ -58,7 +59,7 @@ public:
 }} // namespace yasm::impl
 
 ModuleFactory::ModuleFactory()
-    : m_impl(new Impl)
+    : m_standard(0)
 {
 }
 
@@ -77,11 +78,38 @@ ModuleFactory::Instance()
 // with the function used to create the class.  The return value is a dummy
 // value, which is used to allow static initialization of the registry.
 // See example implementations in base.cc and derived.cc
+void
+ModuleFactory::setStandardModules(const ModuleEntry* const* tables)
+{
+    m_standard = tables;
+}
+
+const ModuleEntry*
+ModuleFactory::FindStandard(unsigned int type, StringRef keyword) const
+{
+    if (!m_standard)
+        return 0;
+    for (const ModuleEntry* const* table = m_standard; *table; ++table)
+    {
+        for (const ModuleEntry* entry = *table; entry->keyword; ++entry)
+        {
+            if (entry->type == type
+                && std::strncmp(entry->keyword, keyword.data(),
+                                keyword.size()) == 0
+                && entry->keyword[keyword.size()] == '\0')
+                return entry;
+        }
+    }
+    return 0;
+}
+
 void
 ModuleFactory::AddCreateFn(unsigned int type,
                            StringRef keyword,
                            BASE_CREATE_FN func)
 {
+    if (!m_impl)
+        m_impl.reset(new Impl);
     m_impl->registry.grow(type);
     if (!m_impl->registry[type])
         m_impl->registry[type] = new Impl::FN_REGISTRY();
@@ -93,48 +121,58 @@ ModuleFactory::AddCreateFn(unsigned int type,
 ModuleFactory::BASE_CREATE_FN
 ModuleFactory::getCreateFn(unsigned int type, StringRef keyword) const
 {
-    if (type >= m_impl->registry.size())
-        return 0;
-    Impl::FN_REGISTRY* module_entry = m_impl->registry[type];
-    if (!module_entry)
-        return 0;
+    if (m_impl && type < m_impl->registry.size())
+    {
+        Impl::FN_REGISTRY* module_entry = m_impl->registry[type];
+        if (module_entry)
+        {
+            Impl::FN_REGISTRY::const_iterator func_entry =
+                module_entry->find(keyword);
+            if (func_entry != module_entry->end())
+                return func_entry->getValue();
+        }
+    }
 
-    Impl::FN_REGISTRY::const_iterator func_entry = module_entry->find(keyword);
-    if (func_entry == module_entry->end())
+    const ModuleEntry* entry = FindStandard(type, keyword);
+    if (!entry)
         return 0;
-
-    return func_entry->getValue();
+    return entry->create;
 }
 
 // Just return a list of the classIDKeys used.
 ModuleNames
 ModuleFactory::getRegistered(unsigned int type) const
 {
-    if (type >= m_impl->registry.size())
-        return ModuleNames();
-
-    Impl::FN_REGISTRY* module_entry = m_impl->registry[type];
-    if (!module_entry)
-        return ModuleNames();
+    ModuleNames ret;
+    if (m_standard)
+    {
+        for (const ModuleEntry* const* table = m_standard; *table; ++table)
+        {
+            for (const ModuleEntry* entry = *table; entry->keyword; ++entry)
+            {
+                if (entry->type == type)
+                    ret.push_back(entry->keyword);
+            }
+        }
+    }
 
-    ModuleNames ret(module_entry->size());
-    int count = 0;
-    for (Impl::FN_REGISTRY::const_iterator func_entry = module_entry->begin(),
-         end = module_entry->end(); func_entry != end; ++func_entry, ++count)
+    if (m_impl && type < m_impl->registry.size() && m_impl->registry[type])
     {
-        ret[count] = func_entry->getKey();
+        Impl::FN_REGISTRY* module_entry = m_impl->registry[type];
+        for (Impl::FN_REGISTRY::const_iterator
+             func_entry = module_entry->begin(), end = module_entry->end();
+             func_entry != end; ++func_entry)
+        {
+            ret.push_back(func_entry->getKey());
+        }
     }
     std::sort(ret.begin(), ret.end());
+    ret.erase(std::unique(ret.begin(), ret.end()), ret.end());
     return ret;
 }
 
 bool
 ModuleFactory::isRegistered(unsigned int type, StringRef keyword) const
 {
-    if (type >= m_impl->registry.size())
-        return false;
-    Impl::FN_REGISTRY* module_entry = m_impl->registry[type];
-    if (!module_entry)
-        return false;
-    return module_entry->find(keyword) != module_entry->end();
+    return getCreateFn(type, keyword) != 0;
 }
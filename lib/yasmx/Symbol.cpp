@@ -27,6 +27,7 @@
 #include "yasmx/Symbol.h"
 
 #include "yasmx/Basic/Diagnostic.h"
+#include "yasmx/Support/MemoryStats.h"
 #include "yasmx/Expr.h"
 
 
@@ -37,12 +38,19 @@ Symbol::Symbol(StringRef name)
       m_type(UNKNOWN),
       m_status(NOSTATUS),
       m_visibility(LOCAL),
-      m_equ(0)
+      m_differenced(0),
+      m_equ(0),
+      m_equ_expanded(0),
+      m_equ_folded(0)
 {
+    // Symbols are allocated both individually and from pools, so count
+    // them here rather than in an operator new.
+    CountAlloc(MEM_SYMBOL, sizeof(Symbol));
 }
 
 Symbol::~Symbol()
 {
+    CountFree(MEM_SYMBOL, sizeof(Symbol));
 }
 
 bool
@@ -79,6 +87,15 @@ Symbol::DefineEqu(const Expr& e)
     m_equ.reset(new Expr(e));
 }
 
+void
+Symbol::setExpandedEqu(std::auto_ptr<Expr> expanded,
+                       std::auto_ptr<Expr> folded)
+{
+    assert(m_type == EQU && "memoizing expansion of non-EQU symbol");
+    m_equ_expanded.reset(expanded.release());
+    m_equ_folded.reset(folded.release());
+}
+
 void
 Symbol::CheckedDefineEqu(const Expr& e,
                          SourceLocation source,
@@ -99,6 +116,22 @@ Symbol::DefineLabel(Location loc)
     m_loc = loc;
 }
 
+void
+Symbol::UseInDifference()
+{
+    // Jobs in Object::Finalize() may mark the same label at once; a plain
+    // store would race, so swap the flag in atomically.
+    if (m_differenced == 0)
+        llvm::sys::CompareAndSwap(&m_differenced, 1, 0);
+}
+
+void
+Symbol::MoveLabel(Location loc)
+{
+    assert(m_type == LABEL && "symbol not a label");
+    m_loc = loc;
+}
+
 void
 Symbol::CheckedDefineLabel(Location loc,
                            SourceLocation source,
@@ -190,7 +223,7 @@ pugi::xml_node
 Symbol::Write(pugi::xml_node out) const
 {
     pugi::xml_node root = out.append_child("Symbol");
-    root.append_attribute("id") = m_name.c_str();
+    root.append_attribute("id") = m_name.str().c_str();
     append_child(root, "Name", m_name);
     pugi::xml_attribute type = root.append_attribute("type");
     switch (m_type)
@@ -224,6 +257,8 @@ Symbol::Write(pugi::xml_node out) const
             m_def_source.getRawEncoding();
     if (m_status & VALUED)
         root.append_attribute("Valued") = true;
+    if (m_differenced)
+        root.append_attribute("Differenced") = true;
 
     if (m_visibility & GLOBAL)
         root.append_child("Global").append_attribute("source") =
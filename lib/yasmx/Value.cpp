@@ -65,9 +65,9 @@ private:
 } // anonymous namespace
 
 Value::Value(unsigned int size)
-    : m_abs(0),
-      m_rel(0),
-      m_wrt(0),
+    : m_rel(0),
+      m_extra(0),
+      m_abs_int(false),
       m_sub_sym(false),
       m_sub_loc(false),
       m_insn_start(0),
@@ -82,12 +82,13 @@ Value::Value(unsigned int size)
       m_sign(false),
       m_size(size)
 {
+    m_abs.expr = 0;
 }
 
 Value::Value(unsigned int size, std::auto_ptr<Expr> e)
-    : m_abs(e.release()),
-      m_rel(0),
-      m_wrt(0),
+    : m_rel(0),
+      m_extra(0),
+      m_abs_int(false),
       m_sub_sym(false),
       m_sub_loc(false),
       m_insn_start(0),
@@ -102,12 +103,13 @@ Value::Value(unsigned int size, std::auto_ptr<Expr> e)
       m_sign(false),
       m_size(size)
 {
+    m_abs.expr = e.release();
 }
 
 Value::Value(unsigned int size, SymbolRef sym)
-    : m_abs(0),
-      m_rel(sym),
-      m_wrt(0),
+    : m_rel(sym),
+      m_extra(0),
+      m_abs_int(false),
       m_sub_sym(false),
       m_sub_loc(false),
       m_insn_start(0),
@@ -122,14 +124,14 @@ Value::Value(unsigned int size, SymbolRef sym)
       m_sign(false),
       m_size(size)
 {
+    m_abs.expr = 0;
 }
 
 Value::Value(const Value& oth)
-    : m_abs(0),
-      m_rel(oth.m_rel),
-      m_wrt(oth.m_wrt),
-      m_sub(oth.m_sub),
+    : m_rel(oth.m_rel),
+      m_extra(oth.m_extra ? new Extra(*oth.m_extra) : 0),
       m_source(oth.m_source),
+      m_abs_int(oth.m_abs_int),
       m_sub_sym(oth.m_sub_sym),
       m_sub_loc(oth.m_sub_loc),
       m_insn_start(oth.m_insn_start),
@@ -144,40 +146,30 @@ Value::Value(const Value& oth)
       m_sign(oth.m_sign),
       m_size(oth.m_size)
 {
-    if (oth.m_abs)
-        m_abs.reset(oth.m_abs->clone());
+    if (m_abs_int)
+        m_abs.intn = oth.m_abs.intn;
+    else
+        m_abs.expr = oth.m_abs.expr ? oth.m_abs.expr->clone() : 0;
 }
 
 Value::~Value()
 {
+    if (!m_abs_int)
+        delete m_abs.expr;
+    delete m_extra;
 }
 
 void
 Value::swap(Value& oth)
 {
-    m_abs.swap(oth.m_abs);
+    std::swap(m_abs, oth.m_abs);
     std::swap(m_rel, oth.m_rel);
-    std::swap(m_wrt, oth.m_wrt);
+    std::swap(m_extra, oth.m_extra);
     std::swap(m_source, oth.m_source);
 
-    // XXX: Can't std::swap the union, so do it the hard way.
-    Symbol* sym = 0;        // avoid warning
-    Location loc = {0, 0};  // avoid warning
-    if (m_sub_sym)
-        sym = m_sub.sym;
-    else if (m_sub_loc)
-        loc = m_sub.loc;
-    if (oth.m_sub_sym)
-        m_sub.sym = oth.m_sub.sym;
-    else if (oth.m_sub_loc)
-        m_sub.loc = oth.m_sub.loc;
-    if (m_sub_sym)
-        oth.m_sub.sym = sym;
-    else if (m_sub_loc)
-        oth.m_sub.loc = loc;
-
     // XXX: Have to do manual copy-construct/assignment "swap", as we can't
     // std::swap individual bitfield members.
+    unsigned int abs_int = m_abs_int;
     unsigned int sub_sym = m_sub_sym;
     unsigned int sub_loc = m_sub_loc;
     unsigned int insn_start = m_insn_start;
@@ -192,6 +184,7 @@ Value::swap(Value& oth)
     unsigned int sign = m_sign;
     unsigned int size = m_size;
 
+    m_abs_int = oth.m_abs_int;
     m_sub_sym = oth.m_sub_sym;
     m_sub_loc = oth.m_sub_loc;
     m_insn_start = oth.m_insn_start;
@@ -206,6 +199,7 @@ Value::swap(Value& oth)
     m_sign = oth.m_sign;
     m_size = oth.m_size;
 
+    oth.m_abs_int = abs_int;
     oth.m_sub_sym = sub_sym;
     oth.m_sub_loc = sub_loc;
     oth.m_insn_start = insn_start;
@@ -224,9 +218,10 @@ Value::swap(Value& oth)
 void
 Value::Clear()
 {
-    m_abs.reset(0);
+    ClearAbs();
     m_rel = SymbolRef(0);
-    m_wrt = SymbolRef(0);
+    delete m_extra;
+    m_extra = 0;
     m_source = SourceRange();
     m_sub_sym = false;
     m_sub_loc = false;
@@ -247,7 +242,8 @@ void
 Value::ClearRelative()
 {
     m_rel = SymbolRef(0);
-    m_wrt = SymbolRef(0);
+    delete m_extra;
+    m_extra = 0;
     m_sub_sym = false;
     m_sub_loc = false;
     m_seg_of = false;
@@ -260,30 +256,76 @@ Value&
 Value::operator= (const Value& rhs)
 {
     if (this != &rhs)
+        Value(rhs).swap(*this);
+    return *this;
+}
+
+void
+Value::CompactAbs()
+{
+    if (m_abs_int || !m_abs.expr || !m_abs.expr->isIntNum())
+        return;
+    IntNum intn = m_abs.expr->getIntNum();
+    if (!intn.isInt())
+        return;
+    delete m_abs.expr;
+    m_abs.intn = intn.getInt();
+    m_abs_int = true;
+}
+
+Expr*
+Value::ExpandAbs() const
+{
+    Expr* e = new Expr(IntNum(m_abs.intn));
+    m_abs.expr = e;
+    m_abs_int = false;
+    return e;
+}
+
+void
+Value::ClearAbs()
+{
+    if (!m_abs_int)
+        delete m_abs.expr;
+    m_abs.expr = 0;
+    m_abs_int = false;
+}
+
+Expr&
+Value::MakeAbs()
+{
+    if (m_abs_int)
+        return *ExpandAbs();
+    if (!m_abs.expr)
+        m_abs.expr = new Expr();
+    return *m_abs.expr;
+}
+
+Value::Extra&
+Value::MakeExtra()
+{
+    if (!m_extra)
     {
-        if (rhs.m_abs)
-            m_abs.reset(rhs.m_abs->clone());
-        else
-            m_abs.reset(0);
-        m_rel = rhs.m_rel;
-        m_wrt = rhs.m_wrt;
-        m_sub = rhs.m_sub;
-        m_source = rhs.m_source;
-        m_sub_sym = rhs.m_sub_sym;
-        m_sub_loc = rhs.m_sub_loc;
-        m_insn_start = rhs.m_insn_start;
-        m_next_insn = rhs.m_next_insn;
-        m_seg_of = rhs.m_seg_of;
-        m_rshift = rhs.m_rshift;
-        m_shift = rhs.m_shift;
-        m_ip_rel = rhs.m_ip_rel;
-        m_jump_target = rhs.m_jump_target;
-        m_section_rel = rhs.m_section_rel;
-        m_no_warn = rhs.m_no_warn;
-        m_sign = rhs.m_sign;
-        m_size = rhs.m_size;
+        m_extra = new Extra;
+        m_extra->wrt = SymbolRef(0);
     }
-    return *this;
+    return *m_extra;
+}
+
+// Determine if a symbol must be kept relative under the object options
+// rather than moved into the absolute portion of a value.
+static bool
+isKeptRelative(Object& object, const Symbol& sym)
+{
+    const Object::Options& opts = object.getOptions();
+    if (opts.DisableNonTempSubRelative)
+    {
+        StringRef name = sym.getName();
+        if (!name.empty() && name[0] != 'L' && name[0] != 'l')
+            return true;
+    }
+    return opts.DisableGlobalSubRelative &&
+        (sym.getVisibility() & Symbol::GLOBAL) != 0;
 }
 
 bool
@@ -298,7 +340,7 @@ Value::SubRelative(Object* object, Location sub)
         m_rel = object->getAbsoluteSymbol();
         if (hasSubRelative())
             return false;
-        m_sub.loc = sub;
+        MakeExtra().sub.loc = sub;
         m_sub_loc = true;
     }
     else
@@ -307,22 +349,19 @@ Value::SubRelative(Object* object, Location sub)
         // If same section as m_rel, move both into absolute portion.
         // Can't do this if we're doing something fancier with the relative
         // portion.
-        if (!m_wrt && !m_seg_of && !m_rshift && !m_section_rel
+        if (!isWRT() && !m_seg_of && !m_rshift && !m_section_rel
             && m_rel->getLabel(&loc)
             && loc.bc->getContainer() == sub.bc->getContainer()
-            && (!object->getOptions().DisableGlobalSubRelative ||
-                (m_rel->getVisibility() & Symbol::GLOBAL) == 0))
+            && !isKeptRelative(*object, *m_rel))
         {
-            if (!m_abs)
-                m_abs.reset(new Expr());
-            *m_abs += SUB(m_rel, sub);
+            MakeAbs() += SUB(m_rel, sub);
             m_rel = SymbolRef(0);
         }
         else
         {
             if (hasSubRelative())
                 return false;
-            m_sub.loc = sub;
+            MakeExtra().sub.loc = sub;
             m_sub_loc = true;
         }
     }
@@ -449,6 +488,8 @@ Value::FinalizeScan(Expr& e, bool ssym_ok, int* pos)
                     if (rel_loc.bc->getContainer() ==
                         sub_loc.bc->getContainer())
                     {
+                        rel->UseInDifference();
+                        sub->UseInDifference();
                         *j = -1;        // mark as matched
                         matched = true;
                         break;
@@ -479,7 +520,7 @@ Value::FinalizeScan(Expr& e, bool ssym_ok, int* pos)
                 // Must be subtractive portion
                 if (hasSubRelative())
                     return false;   // already have one
-                m_sub.sym = sub;
+                MakeExtra().sub.sym = sub;
                 m_sub_sym = true;
 
                 // Set term to 0 (will remove from expression during simplify)
@@ -565,9 +606,9 @@ Value::FinalizeScan(Expr& e, bool ssym_ok, int* pos)
             // Handle RHS
             if (SymbolRef sym = terms[rhs].getSymbol())
             {
-                if (m_wrt)
+                if (isWRT())
                     return false;
-                m_wrt = sym;
+                MakeExtra().wrt = sym;
                 // change the WRT into a +0 expression
                 terms[rhs].Zero();
                 root.setOp(Op::ADD);
@@ -638,32 +679,39 @@ Value::FinalizeScan(Expr& e, bool ssym_ok, int* pos)
 bool
 Value::Finalize(DiagnosticsEngine& diags, unsigned int err_too_complex)
 {
-    if (!m_abs)
+    if (m_abs_int)
+    {
+        if (m_abs.intn == 0)
+            ClearAbs();
+        return true;
+    }
+    Expr* abs = m_abs.expr;
+    if (!abs)
         return true;
 
-    if (m_abs->isEmpty())
+    if (abs->isEmpty())
     {
-        m_abs.reset(0);
+        ClearAbs();
         return true;
     }
 
-    if (!ExpandEqu(*m_abs))
+    if (!ExpandEqu(*abs, true))
     {
         diags.Report(m_source.getBegin(), diag::err_equ_circular_reference);
         return false;
     }
-    m_abs->Simplify(diags, false);
+    abs->Simplify(diags, false);
 
     // Strip top-level AND masking to an all-1s mask the same size
     // of the value size.  This allows forced avoidance of overflow warnings.
-    if (m_abs->isOp(Op::AND))
+    if (abs->isOp(Op::AND))
     {
         // Calculate 1<<size - 1 value
         IntNum mask = 1;
         mask <<= m_size;
         mask -= 1;
 
-        ExprTerms& terms = m_abs->getTerms();
+        ExprTerms& terms = abs->getTerms();
 
         // See if any top-level terms match mask and remove them.
         bool found = false;
@@ -688,38 +736,42 @@ Value::Finalize(DiagnosticsEngine& diags, unsigned int err_too_complex)
         if (found)
         {
             m_no_warn = true;
-            m_abs->MakeIdent(diags);
+            abs->MakeIdent(diags);
         }
     }
 
     // Handle trivial (IDENT) cases immediately
-    if (m_abs->isIntNum())
+    if (abs->isIntNum())
     {
-        if (m_abs->getIntNum().isZero())
-            m_abs.reset(0);
+        if (abs->getIntNum().isZero())
+            ClearAbs();
+        else
+            CompactAbs();
         return true;
     }
-    else if (m_abs->isSymbol())
+    else if (abs->isSymbol())
     {
-        m_rel = m_abs->getSymbol();
-        m_abs.reset(0);
+        m_rel = abs->getSymbol();
+        ClearAbs();
         return true;
     }
 
     int pos = -1;
-    if (!FinalizeScan(*m_abs, true, &pos))
+    if (!FinalizeScan(*abs, true, &pos))
     {
         diags.Report(m_source.getBegin(), err_too_complex);
         return false;
     }
 
-    m_abs->Simplify(diags, false);
+    abs->Simplify(diags, false);
 
     // Simplify 0 in abs to NULL
-    if (m_abs->isIntNum())
+    if (abs->isIntNum())
     {
-        if (m_abs->getIntNum().isZero())
-            m_abs.reset(0);
+        if (abs->getIntNum().isZero())
+            ClearAbs();
+        else
+            CompactAbs();
     }
 
     return true;
@@ -750,19 +802,22 @@ Value::getIntNum(IntNum* out, bool calc_bc_dist, DiagnosticsEngine& diags)
 {
     // This code could be written more simply, but this is a very hot method,
     // so we need to shortcut all of the common cases.
-    if (m_rel || hasSubRelative() || m_wrt)
+    if (m_rel || hasSubRelative() || isWRT())
         return false;   // can't handle relative values
 
-    if (!m_abs)
+    Expr* abs = m_abs.expr;
+    if (m_abs_int)
+        *out = m_abs.intn;
+    else if (!abs)
         *out = 0;
-    else if (m_abs->isIntNum())
-        *out = m_abs->getIntNum();
-    else if (m_abs->isFloat())
+    else if (abs->isIntNum())
+        *out = abs->getIntNum();
+    else if (abs->isFloat())
         return false;   // a float
     else
     {
         ExprTerm term;
-        if (!Evaluate(*m_abs, diags, &term, calc_bc_dist, false)
+        if (!Evaluate(*abs, diags, &term, calc_bc_dist, false)
             || !term.isType(ExprTerm::INT))
             return false;
         out->swap(*term.getIntNum());
@@ -774,19 +829,30 @@ Value::getIntNum(IntNum* out, bool calc_bc_dist, DiagnosticsEngine& diags)
 void
 Value::AddAbs(const IntNum& delta)
 {
-    if (m_abs.get() == 0)
-        m_abs.reset(new Expr(delta));
+    if (m_abs_int)
+    {
+        IntNum sum = m_abs.intn;
+        sum += delta;
+        if (sum.isInt())
+        {
+            m_abs.intn = sum.getInt();
+            return;
+        }
+        ExpandAbs();
+    }
+    if (!m_abs.expr)
+        m_abs.expr = new Expr(delta);
     else
-        *m_abs += delta;
+        *m_abs.expr += delta;
 }
 
 void
 Value::AddAbs(const Expr& delta)
 {
-    if (m_abs.get() == 0)
-        m_abs.reset(delta.clone());
+    if (!hasAbs())
+        m_abs.expr = delta.clone();
     else
-        *m_abs += delta;
+        MakeAbs() += delta;
 }
 
 bool
@@ -794,11 +860,11 @@ Value::getSubLocation(Location* loc) const
 {
     if (m_sub_loc)
     {
-        *loc = m_sub.loc;
+        *loc = m_extra->sub.loc;
         return true;
     }
     else if (m_sub_sym)
-        return m_sub.sym->getLabel(loc);
+        return m_extra->sub.sym->getLabel(loc);
     else
         return false;
 }
@@ -824,40 +890,51 @@ Value::OutputBasic(NumericOutput& num_out,
 {
     // This code could be written more simply, but this is a very hot method,
     // so we need to shortcut all of the common cases.
-    bool rel = m_rel || hasSubRelative() || m_wrt;
+    bool rel = m_rel || hasSubRelative() || isWRT();
+    Expr* abs = m_abs.expr;
 
     // Try to handle common cases first
     if (!rel)
     {
-        if (!m_abs)
+        if (m_abs_int)
+        {
+            num_out.OutputInteger(m_abs.intn);
+            return true;
+        }
+        else if (!abs)
         {
             num_out.OutputInteger(0);
             return true;
         }
-        else if (m_abs->isIntNum())
+        else if (abs->isIntNum())
         {
-            num_out.OutputInteger(*m_abs->getTerms().front().getIntNum());
+            num_out.OutputInteger(*abs->getTerms().front().getIntNum());
             return true;
         }
-        else if (m_abs->isFloat())
+        else if (abs->isFloat())
         {
-            num_out.OutputFloat(*m_abs->getFloat());
+            num_out.OutputFloat(*abs->getFloat());
             return true;
         }
     }
     else
     {
-        if (!m_abs)
+        if (m_abs_int)
+        {
+            *outval = m_abs.intn;
+            return false;
+        }
+        else if (!abs)
         {
             *outval = 0;
             return false;
         }
-        else if (m_abs->isIntNum())
+        else if (abs->isIntNum())
         {
-            *outval = m_abs->getIntNum();
+            *outval = abs->getIntNum();
             return false;
         }
-        else if (m_abs->isFloat())
+        else if (abs->isFloat())
         {
             diags.Report(m_source.getBegin(), diag::err_reloc_contains_float);
             return true;
@@ -866,10 +943,10 @@ Value::OutputBasic(NumericOutput& num_out,
 
     // Not trivial, need to evaluate
     ExprTerm term;
-    if (!Evaluate(*m_abs, diags, &term))
+    if (!Evaluate(*abs, diags, &term))
     {
         // Check for complex float expressions
-        if (m_abs->Contains(ExprTerm::FLOAT))
+        if (abs->Contains(ExprTerm::FLOAT))
             diags.Report(m_source.getBegin(), diag::err_reloc_contains_float);
         else
             diags.Report(m_source.getBegin(), diag::err_reloc_too_complex);
@@ -905,22 +982,22 @@ Value::Write(pugi::xml_node out) const
     pugi::xml_node root = out.append_child("Value");
 
     // abs
-    if (m_abs.get() != 0)
-        append_data(root, *m_abs);
+    if (const Expr* abs = getAbs())
+        append_data(root, *abs);
 
     // rel
     if (m_rel)
         append_child(root, "Rel", m_rel);
 
     // wrt
-    if (m_wrt)
-        append_child(root, "WRT", m_wrt);
+    if (SymbolRef wrt = getWRT())
+        append_child(root, "WRT", wrt);
 
     // sub
     if (m_sub_sym)
-        append_child(root, "Sub", m_sub.sym->getName());
+        append_child(root, "Sub", m_extra->sub.sym->getName());
     else if (m_sub_loc)
-        append_child(root, "Sub", m_sub.loc);
+        append_child(root, "Sub", m_extra->sub.loc);
 
     root.append_attribute("source.begin") = m_source.getBegin().getRawEncoding();
     root.append_attribute("source.end") = m_source.getEnd().getRawEncoding();
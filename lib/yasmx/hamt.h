@@ -34,11 +34,11 @@
 /// POSSIBILITY OF SUCH DAMAGE.
 /// @endlicense
 ///
-#include <cctype>
 #include <cstring>
 
 #include <boost/pool/pool.hpp>
 
+#include "llvm/Support/DataTypes.h"
 #include "yasmx/Support/bitcount.h"
 
 
@@ -91,7 +91,8 @@ private:
     /// A node.
     /// Nodes come in two forms:
     /// (a) a value-containing node that contains:
-    ///     - bitmap_key = hash key of value
+    ///     - bitmap_key = hash key of value, so splitting the node never
+    ///       needs to hash the value's key again
     ///     - value = pointer to value
     /// (b) a node tree that contains:
     ///     - bitmap_key = bitmap (1=present), indexed by 5 bits of hash
@@ -99,7 +100,7 @@ private:
     ///     - followed in memory by between 1 and 32 Node*'s
     struct Node
     {
-        unsigned long bitmap_key;   ///< 32 bits, bitmap or hash key
+        uint64_t bitmap_key;        ///< 32 bit bitmap or 64 bit hash key
 
         /// Value pointer; if NULL an array of nodes immediately follow this
         /// node structure
@@ -127,86 +128,115 @@ private:
     /// @return Old data from HAMT; if no old data, NULL.
     T* InsRep(T* data, bool replace);
 
-    static unsigned long HashKey(const Key& key);
-    static unsigned long RehashKey(const Key& key, int Level);
-    static unsigned long HashKeyNocase(const Key& key);
-    static unsigned long RehashKeyNocase(const Key& key, int Level);
-    static bool Equals(const Key& k1, const Key& k2);
-    static bool EqualsNocase(const Key& k1, const Key& k2);
+    /// Hash a key 8 bytes at a time.  The trie uses 5 bits of the hash
+    /// per level; once 60 bits are used up, the key is rehashed with the
+    /// level as the seed, which only happens for 60 bit hash collisions.
+    /// @param key      Key
+    /// @param nocase   True to fold ASCII letters to lowercase
+    /// @param seed     Seed (0 for the initial hash)
+    static uint64_t HashKey(const Key& key, bool nocase, uint64_t seed=0);
+
+    static bool Equals(const Key& k1, const Key& k2, bool nocase);
 };
 
-template <typename Key, typename T, typename GetKey>
-unsigned long
-hamt<Key,T,GetKey>::HashKey(const Key& key)
+namespace detail
 {
-    unsigned long a=31415, b=27183, vHash=0;
-    for (typename Key::const_iterator i=key.begin(), end=key.end();
-         i != end; ++i, a*=b)
-        vHash = a*vHash + *i;
-    return vHash;
-}
 
-template <typename Key, typename T, typename GetKey>
-unsigned long
-hamt<Key,T,GetKey>::RehashKey(const Key& key, int Level)
+/// Load up to 8 bytes as a word, zero-padded.
+inline uint64_t
+HamtLoadWord(const char* p, std::size_t n)
 {
-    unsigned long a=31415, b=27183, vHash=0;
-    for (typename Key::const_iterator i=key.begin(), end=key.end();
-         i != end; ++i, a*=b)
-        vHash = a*vHash*static_cast<unsigned long>(Level) + *i;
-    return vHash;
+    uint64_t w = 0;
+    if (n == 8)
+        std::memcpy(&w, p, 8);
+    else
+    {
+        for (std::size_t i=0; i<n; ++i)
+            w |= static_cast<uint64_t>(static_cast<unsigned char>(p[i]))
+                << (8*i);
+    }
+    return w;
 }
 
-template <typename Key, typename T, typename GetKey>
-unsigned long
-hamt<Key,T,GetKey>::HashKeyNocase(const Key& key)
+/// Fold the ASCII uppercase letters in each byte of a word to lowercase.
+inline uint64_t
+HamtFoldWord(uint64_t w)
 {
-    unsigned long a=31415, b=27183, vHash=0;
-    for (typename Key::const_iterator i=key.begin(), end=key.end();
-         i != end; ++i, a*=b)
-        vHash = a*vHash + std::tolower(*i);
-    return vHash;
+    const uint64_t ones = UINT64_C(0x0101010101010101);
+    uint64_t heptets = w & (ones * 0x7f);
+    // Bit 7 of each byte is set if the byte is >= 'A' (resp. > 'Z'); the
+    // additions cannot carry between bytes.
+    uint64_t ge_a = heptets + ones * (0x80 - 'A');
+    uint64_t gt_z = heptets + ones * (0x80 - 'Z' - 1);
+    uint64_t upper = (ge_a ^ gt_z) & ~w & (ones * 0x80);
+    return w | (upper >> 2);
 }
 
-template <typename Key, typename T, typename GetKey>
-unsigned long
-hamt<Key,T,GetKey>::RehashKeyNocase(const Key& key, int Level)
+inline uint64_t
+HamtRotl(uint64_t x, int r)
 {
-    unsigned long a=31415, b=27183, vHash=0;
-    for (typename Key::const_iterator i=key.begin(), end=key.end();
-         i != end; ++i, a*=b)
-        vHash = a*vHash*static_cast<unsigned long>(Level) + std::tolower(*i);
-    return vHash;
+    return (x << r) | (x >> (64 - r));
 }
 
+} // namespace detail
+
 template <typename Key, typename T, typename GetKey>
-bool
-hamt<Key,T,GetKey>::Equals(const Key& k1, const Key& k2)
+uint64_t
+hamt<Key,T,GetKey>::HashKey(const Key& key, bool nocase, uint64_t seed)
 {
-    if (k1.size() != k2.size())
-        return false;
-    for (typename Key::const_iterator i=k1.begin(), i2=k2.begin(), end=k1.end();
-         i != end; ++i, ++i2)
+    // Rounds and final mix from xxHash64.
+    const uint64_t P1 = UINT64_C(0x9e3779b185ebca87);
+    const uint64_t P2 = UINT64_C(0xc2b2ae3d27d4eb4f);
+    const uint64_t P3 = UINT64_C(0x165667b19e3779f9);
+    const uint64_t P4 = UINT64_C(0x85ebca77c2b2ae63);
+
+    const char* p = key.data();
+    std::size_t len = key.size();
+    uint64_t h = seed + P3 + len;
+    for (;;)
     {
-        if (*i != *i2)
-            return false;
+        std::size_t n = len < 8 ? len : 8;
+        if (n == 0)
+            break;
+        uint64_t w = detail::HamtLoadWord(p, n);
+        if (nocase)
+            w = detail::HamtFoldWord(w);
+        h ^= detail::HamtRotl(w * P2, 31) * P1;
+        h = detail::HamtRotl(h, 27) * P1 + P4;
+        p += n;
+        len -= n;
     }
-    return true;
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    h ^= h >> 32;
+    return h;
 }
 
 template <typename Key, typename T, typename GetKey>
 bool
-hamt<Key,T,GetKey>::EqualsNocase(const Key& k1, const Key& k2)
+hamt<Key,T,GetKey>::Equals(const Key& k1, const Key& k2, bool nocase)
 {
-    if (k1.size() != k2.size())
+    std::size_t len = k1.size();
+    if (len != k2.size())
         return false;
-    for (typename Key::const_iterator i=k1.begin(), i2=k2.begin(), end=k1.end();
-         i != end; ++i, ++i2)
+    if (!nocase)
+        return std::memcmp(k1.data(), k2.data(), len) == 0;
+    const char* p1 = k1.data();
+    const char* p2 = k2.data();
+    for (;;)
     {
-        if (std::tolower(*i) != std::tolower(*i2))
+        std::size_t n = len < 8 ? len : 8;
+        if (n == 0)
+            return true;
+        if (detail::HamtFoldWord(detail::HamtLoadWord(p1, n)) !=
+            detail::HamtFoldWord(detail::HamtLoadWord(p2, n)))
             return false;
+        p1 += n;
+        p2 += n;
+        len -= n;
     }
-    return true;
 }
 
 template <typename Key, typename T, typename GetKey>
@@ -230,11 +260,7 @@ template <typename Key, typename T, typename GetKey>
 T*
 hamt<Key,T,GetKey>::InsRep(T* data, bool replace)
 {
-    unsigned long key;
-    if (m_nocase)
-        key = HashKeyNocase(get_key(data));
-    else
-        key = HashKey(get_key(data));
+    uint64_t key = HashKey(get_key(data), m_nocase);
     unsigned long keypart = key & 0x1F;
     Node** pnode = &m_root[keypart];
     Node* node = *pnode;
@@ -253,8 +279,7 @@ hamt<Key,T,GetKey>::InsRep(T* data, bool replace)
         if (node->value != 0)
         {
             if (node->bitmap_key == key &&
-                ((!m_nocase && Equals(get_key(data), get_key(node->value))) ||
-                 (m_nocase && EqualsNocase(get_key(data), get_key(node->value)))))
+                Equals(get_key(data), get_key(node->value), m_nocase))
             {
                 T* oldvalue = node->value;
                 if (replace || !oldvalue)
@@ -263,25 +288,17 @@ hamt<Key,T,GetKey>::InsRep(T* data, bool replace)
             }
             else
             {
-                unsigned long key2 = node->bitmap_key;
+                uint64_t key2 = node->bitmap_key;
                 // build tree downward until keys differ
                 for (;;)
                 {
                     // replace node with subtrie
                     keypartbits += 5;
-                    if (keypartbits > 30)
+                    if (keypartbits > 55)
                     {
-                        // Exceeded 32 bits: rehash
-                        if (m_nocase)
-                        {
-                            key = RehashKeyNocase(get_key(data), level);
-                            key2 = RehashKeyNocase(get_key(node->value), level);
-                        }
-                        else
-                        {
-                            key = RehashKey(get_key(data), level);
-                            key2 = RehashKey(get_key(node->value), level);
-                        }
+                        // Exceeded 60 bits: rehash
+                        key = HashKey(get_key(data), m_nocase, level);
+                        key2 = HashKey(get_key(node->value), m_nocase, level);
                         keypartbits = 0;
                     }
                     keypart = (key >> keypartbits) & 0x1F;
@@ -294,7 +311,7 @@ hamt<Key,T,GetKey>::InsRep(T* data, bool replace)
                         Node* newnode =
                             static_cast<Node*>(m_pools[1]->malloc());
                         node->bitmap_key = key2;    // update in case we rehashed
-                        newnode->bitmap_key = 1<<keypart;
+                        newnode->bitmap_key = 1UL<<keypart;
                         newnode->value = 0;  // subtrie indication
                         newnode->SubTrie(0) = node;
                         *pnode = newnode;
@@ -345,17 +362,14 @@ hamt<Key,T,GetKey>::InsRep(T* data, bool replace)
 
         // Subtrie: look up in bitmap
         keypartbits += 5;
-        if (keypartbits > 30)
+        if (keypartbits > 55)
         {
-            // Exceeded 32 bits of current key: rehash
-            if (m_nocase)
-                key = RehashKeyNocase(get_key(data), level);
-            else
-                key = RehashKey(get_key(data), level);
+            // Exceeded 60 bits of current key: rehash
+            key = HashKey(get_key(data), m_nocase, level);
             keypartbits = 0;
         }
         keypart = (key >> keypartbits) & 0x1F;
-        if (!(node->bitmap_key & (1<<keypart)))
+        if (!(node->bitmap_key & (1UL<<keypart)))
         {
             // bit is 0 in bitmap -> add node to table
 
@@ -365,7 +379,7 @@ hamt<Key,T,GetKey>::InsRep(T* data, bool replace)
             entry->value = data;
 
             // set bit to 1
-            node->bitmap_key |= (1<<keypart);
+            node->bitmap_key |= (1UL<<keypart);
 
             // Count total number of bits in bitmap to determine new size
             unsigned long size = BitCount(node->bitmap_key);
@@ -415,7 +429,7 @@ template <typename Key, typename T, typename GetKey>
 T*
 hamt<Key,T,GetKey>::Find(const Key& str)
 {
-    unsigned long key = m_nocase ? HashKeyNocase(str) : HashKey(str);
+    uint64_t key = HashKey(str, m_nocase);
     unsigned long keypart = key & 0x1F;
     Node* node = m_root[keypart];
 
@@ -427,8 +441,7 @@ hamt<Key,T,GetKey>::Find(const Key& str)
         if (node->value != 0)
         {
             if (node->bitmap_key == key &&
-                ((!m_nocase && Equals(str, get_key(node->value))) ||
-                 (m_nocase && EqualsNocase(str, get_key(node->value)))))
+                Equals(str, get_key(node->value), m_nocase))
                 return node->value;
             else
                 return 0;
@@ -436,17 +449,14 @@ hamt<Key,T,GetKey>::Find(const Key& str)
 
         // Subtree: look up in bitmap
         keypartbits += 5;
-        if (keypartbits > 30)
+        if (keypartbits > 55)
         {
-            // Exceeded 32 bits of current key: rehash
-            if (m_nocase)
-                key = RehashKeyNocase(str, level);
-            else
-                key = RehashKey(str, level);
+            // Exceeded 60 bits of current key: rehash
+            key = HashKey(str, m_nocase, level);
             keypartbits = 0;
         }
         keypart = (key >> keypartbits) & 0x1F;
-        if (!(node->bitmap_key & (1<<keypart)))
+        if (!(node->bitmap_key & (1UL<<keypart)))
             return 0;       // bit is 0 in bitmap -> no match
 
         // Count bits below
@@ -463,7 +473,7 @@ template <typename Key, typename T, typename GetKey>
 T*
 hamt<Key,T,GetKey>::Remove(const Key& str)
 {
-    unsigned long key = m_nocase ? HashKeyNocase(str) : HashKey(str);
+    uint64_t key = HashKey(str, m_nocase);
     unsigned long keypart = key & 0x1F;
     Node* node = m_root[keypart];
 
@@ -481,8 +491,7 @@ hamt<Key,T,GetKey>::Remove(const Key& str)
         if (node->value != 0)
         {
             if (node->bitmap_key == key &&
-                ((!m_nocase && Equals(str, get_key(node->value))) ||
-                 (m_nocase && EqualsNocase(str, get_key(node->value)))))
+                Equals(str, get_key(node->value), m_nocase))
                 break;
             else
                 return 0;
@@ -490,17 +499,14 @@ hamt<Key,T,GetKey>::Remove(const Key& str)
 
         // Subtree: look up in bitmap
         keypartbits += 5;
-        if (keypartbits > 30)
+        if (keypartbits > 55)
         {
-            // Exceeded 32 bits of current key: rehash
-            if (m_nocase)
-                key = RehashKeyNocase(str, level);
-            else
-                key = RehashKey(str, level);
+            // Exceeded 60 bits of current key: rehash
+            key = HashKey(str, m_nocase, level);
             keypartbits = 0;
         }
         keypart = (key >> keypartbits) & 0x1F;
-        if (!(node->bitmap_key & (1<<keypart)))
+        if (!(node->bitmap_key & (1UL<<keypart)))
             return 0;       // bit is 0 in bitmap -> no match
 
         // Count bits below
@@ -530,10 +536,11 @@ hamt<Key,T,GetKey>::Remove(const Key& str)
     }
 
     // downsize parent and copy remaining nodes into it
+    // (a full subtrie has 32 entries, so don't clamp the count here)
     unsigned long size = BitCount(parent->bitmap_key);
-    size &= 0x1F;       // Clamp to <32
     Node* newparent = static_cast<Node*>(m_pools[size-1]->malloc());
-    newparent->bitmap_key = parent->bitmap_key & ~(1 << node_keypart);
+    newparent->bitmap_key = parent->bitmap_key & ~(1UL << node_keypart);
+    newparent->value = 0;   // subtrie indication
     assert(newparent->bitmap_key != parent->bitmap_key);
     std::memcpy(&newparent->SubTrie(0), &parent->SubTrie(0),
                 node_off*sizeof(Node*));
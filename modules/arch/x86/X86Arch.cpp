@@ -38,11 +38,21 @@
 #include "yasmx/Expr.h"
 #include "yasmx/IntNum.h"
 #include "yasmx/Object.h"
+#include "yasmx/ParseRecord.h"
+#include "yasmx/Section.h"
 
+#include "X86Cost.h"
 #include "X86EffAddr.h"
+#include "X86General.h"
+#include "X86Insn.h"
+#include "X86Jmp.h"
 #include "X86RegisterGroup.h"
 
 
+#ifndef NELEMS
+#define NELEMS(array)   (sizeof(array) / sizeof(array[0]))
+#endif
+
 using namespace yasm;
 using namespace yasm::arch;
 
@@ -53,10 +63,28 @@ X86Arch::X86Arch(const ArchModule& module)
       m_mode_bits(0),
       m_force_strict(false),
       m_default_rel(false),
-      m_nop(NOP_BASIC)
+      m_branch_align(0),
+      m_thread_jumps(false),
+      m_optimize(false),
+      m_feature_usage(false),
+      m_cost_model(0),
+      m_nop(NOP_BASIC),
+      m_match_cache(new X86MatchCache)
 {
     // default to all instructions/features enabled
     m_active_cpu.set();
+    UpdateActiveCpuBits();
+}
+
+void
+X86Arch::UpdateActiveCpuBits()
+{
+    m_active_cpu_bits = 0;
+    for (unsigned int i=0; i<m_active_cpu.size(); ++i)
+    {
+        if (m_active_cpu[i])
+            m_active_cpu_bits |= UINT64_C(1) << i;
+    }
 }
 
 bool
@@ -71,6 +99,7 @@ X86Arch::setParser(StringRef parser)
         m_parser = PARSER_GAS_INTEL;
     else
         return false;
+    InvalidateLookups();
     return true;
 }
 
@@ -90,6 +119,162 @@ X86Arch::~X86Arch()
 {
 }
 
+// Feature names, as used by the CPU directive, indexed by CpuFeature.
+static const char* cpu_feature_names[] =
+{
+    "",         "186",      "286",      "386",      "486",
+    "586",      "686",      "p3",       "p4",       "ia64",
+    "k6",       "athlon",   "hammer",   "fpu",      "mmx",
+    "sse",      "sse2",     "sse3",     "3dnow",    "cyrix",
+    "amd",      "smm",      "prot",     "undoc",    "obs",
+    "priv",     "svm",      "padlock",  "em64t",    "ssse3",
+    "sse4.1",   "sse4.2",   "sse4a",    "xsave",    "avx",
+    "fma",      "aes",      "clmul",    "movbe",    "xop",
+    "fma4",     "f16c",     "fsgsbase", "rdrand",   "xsaveopt",
+    "eptvpid",  "smx",      "avx2",     "bmi1",     "bmi2",
+    "invpcid",  "lzcnt",    "tbm",      "tsx"
+};
+
+unsigned long
+X86Arch::getFeatureUsage(const Section& sect, FeatureUsage* usage) const
+{
+    usage->clear();
+    const X86FeatureUsage* data = sect.getAssocData<X86FeatureUsage>();
+    if (!data)
+        return 0;
+    for (unsigned int i=1; i<NELEMS(cpu_feature_names); ++i)
+    {
+        if (data->m_counts[i] != 0)
+            usage->push_back(std::make_pair(cpu_feature_names[i],
+                                            data->m_counts[i]));
+    }
+    return data->m_insns;
+}
+
+bool
+X86Arch::setCostModel(StringRef model)
+{
+    if (model.empty())
+    {
+        m_cost_model = 0;
+        return true;
+    }
+    const X86CostModel* cost_model = FindX86CostModel(model);
+    if (!cost_model)
+        return false;
+    m_cost_model = cost_model;
+    return true;
+}
+
+unsigned int
+X86Arch::getIssueWidth() const
+{
+    return m_cost_model ? m_cost_model->issue_width : 0;
+}
+
+bool
+X86Arch::getLineCost(const Section& sect,
+                     SourceLocation line,
+                     InsnCost* cost) const
+{
+    const X86InsnCosts* data = sect.getAssocData<X86InsnCosts>();
+    if (!data)
+        return false;
+    X86InsnCosts::Lines::const_iterator i =
+        data->m_lines.find(line.getRawEncoding());
+    if (i == data->m_lines.end())
+        return false;
+    *cost = i->second;
+    return true;
+}
+
+// DWARF register numbers by register type and number, as used by GNU as
+// and the i386 and x86-64 psABIs; -1 if there is none.  Registers that only
+// exist in the other mode have no number.
+static const signed char dwarf_regnum_32[X86Register::TYPE_COUNT][16] = {
+    {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, // REG8
+    {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, // REG8X
+    {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, // REG16
+    { 0,  1,  2,  3,  4,  5,  6,  7, -1, -1, -1, -1, -1, -1, -1, -1}, // REG32
+    {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, // REG64
+    {11, 12, 13, 14, 15, 16, 17, 18, -1, -1, -1, -1, -1, -1, -1, -1}, // FPUREG
+    {29, 30, 31, 32, 33, 34, 35, 36, -1, -1, -1, -1, -1, -1, -1, -1}, // MMXREG
+    {21, 22, 23, 24, 25, 26, 27, 28, -1, -1, -1, -1, -1, -1, -1, -1}, // XMMREG
+    {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, // YMMREG
+    {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, // CRREG
+    {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, // DRREG
+    {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, // TRREG
+    {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}  // RIP
+};
+
+static const signed char dwarf_regnum_64[X86Register::TYPE_COUNT][16] = {
+    {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, // REG8
+    {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, // REG8X
+    {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, // REG16
+    {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, // REG32
+    { 0,  2,  1,  3,  7,  6,  4,  5,  8,  9, 10, 11, 12, 13, 14, 15}, // REG64
+    {33, 34, 35, 36, 37, 38, 39, 40, -1, -1, -1, -1, -1, -1, -1, -1}, // FPUREG
+    {41, 42, 43, 44, 45, 46, 47, 48, -1, -1, -1, -1, -1, -1, -1, -1}, // MMXREG
+    {17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32}, // XMMREG
+    {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, // YMMREG
+    {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, // CRREG
+    {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, // DRREG
+    {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, // TRREG
+    {16, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}  // RIP
+};
+
+int
+X86Arch::getDwarfRegNum(const Register& reg) const
+{
+    const X86Register& x86reg = static_cast<const X86Register&>(reg);
+    unsigned int num = x86reg.getNum();
+    if (num >= 16)
+        return -1;
+    if (m_mode_bits == 64)
+        return dwarf_regnum_64[x86reg.getType()][num];
+    return dwarf_regnum_32[x86reg.getType()][num];
+}
+
+const char* X86FeatureUsage::key = "arch::x86::X86FeatureUsage";
+
+X86FeatureUsage::X86FeatureUsage()
+    : m_insns(0)
+{
+    for (unsigned int i=0; i<NELEMS(m_counts); ++i)
+        m_counts[i] = 0;
+}
+
+X86FeatureUsage::~X86FeatureUsage()
+{
+}
+
+void
+X86FeatureUsage::Add(uint64_t cpu)
+{
+    ++m_insns;
+    for (unsigned int i=1; cpu >> i != 0; ++i)
+    {
+        if (cpu & (UINT64_C(1) << i))
+            ++m_counts[i];
+    }
+}
+
+#ifdef WITH_XML
+pugi::xml_node
+X86FeatureUsage::Write(pugi::xml_node out) const
+{
+    pugi::xml_node root = out.append_child("X86FeatureUsage");
+    root.append_attribute("key") = key;
+    append_child(root, "Insns", m_insns);
+    for (unsigned int i=1; i<NELEMS(cpu_feature_names); ++i)
+    {
+        if (m_counts[i] != 0)
+            append_child(root, cpu_feature_names[i], m_counts[i]);
+    }
+    return root;
+}
+#endif // WITH_XML
+
 StringRef
 X86Arch::getMachine() const
 {
@@ -127,6 +312,7 @@ X86Arch::setVar(StringRef var, unsigned long val)
         assert((val == 16 || val == 32 || val == 64) &&
                "mode_bits must be 16, 32, or 64");
         m_mode_bits = static_cast<unsigned int>(val);
+        InvalidateLookups();
     }
     else if (var.equals_lower("force_strict"))
         m_force_strict = (val != 0);
@@ -136,11 +322,96 @@ X86Arch::setVar(StringRef var, unsigned long val)
                "default_rel requires bits=64");
         m_default_rel = (val != 0);
     }
+    else if (var.equals_lower("branch_align"))
+    {
+        assert((val & (val-1)) == 0 && "branch_align must be a power of 2");
+        m_branch_align = val;
+    }
+    else if (var.equals_lower("thread_jumps"))
+        m_thread_jumps = (val != 0);
+    else if (var.equals_lower("optimize"))
+        m_optimize = (val != 0);
+    else if (var.equals_lower("feature_usage"))
+        m_feature_usage = (val != 0);
+    else
+        return false;
+    return true;
+}
+
+void
+X86Arch::Reset()
+{
+    m_active_cpu.set();
+    UpdateActiveCpuBits();
+    m_default_rel = false;
+    m_nop = NOP_BASIC;
+    InvalidateLookups();
+}
+
+std::auto_ptr<Arch>
+X86Arch::Clone() const
+{
+    // Feature usage is gathered per section, and would be lost when the
+    // sections of the pieces are combined.
+    if (m_feature_usage)
+        return std::auto_ptr<Arch>(0);
+
+    std::auto_ptr<X86Arch> arch(new X86Arch(getModule()));
+    arch->m_active_cpu = m_active_cpu;
+    arch->m_active_cpu_bits = m_active_cpu_bits;
+    arch->m_amd64_machine = m_amd64_machine;
+    arch->m_parser = m_parser;
+    arch->m_mode_bits = m_mode_bits;
+    arch->m_force_strict = m_force_strict;
+    arch->m_default_rel = m_default_rel;
+    arch->m_branch_align = m_branch_align;
+    arch->m_thread_jumps = m_thread_jumps;
+    arch->m_optimize = m_optimize;
+    arch->m_cost_model = m_cost_model;
+    arch->m_nop = m_nop;
+    return std::auto_ptr<Arch>(arch.release());
+}
+
+bool
+X86Arch::SaveRegister(const Register& reg, RecordWriter& out) const
+{
+    const X86Register& x86reg = static_cast<const X86Register&>(reg);
+    out.WriteUnsigned(x86reg.getType());
+    out.WriteUnsigned(x86reg.getNum());
+    return true;
+}
+
+const Register*
+X86Arch::LoadRegister(RecordReader& in) const
+{
+    X86Register::Type type = static_cast<X86Register::Type>(
+        in.ReadUnsigned(X86Register::TYPE_COUNT-1));
+    unsigned int num = static_cast<unsigned int>(
+        in.ReadUnsigned(X86RegTmod::getRegCount(type)-1));
+    return X86RegTmod::Instance().getReg(type, num);
+}
+
+bool
+X86Arch::LoadContents(StringRef type, RecordReader& in, Bytecode& bc) const
+{
+    Bytecode::Contents::Ptr contents;
+    if (type == "yasm::arch::X86General")
+        contents = X86General::Load(in);
+    else if (type == "yasm::arch::X86Jmp")
+        contents = LoadJmp(in);
     else
         return false;
+    bc.Transform(contents);
     return true;
 }
 
+void
+X86Arch::FinalizeObject(Object& object, DiagnosticsEngine& diags)
+{
+    if (m_thread_jumps)
+        ThreadJumps(object, diags);
+}
+
 void
 X86Arch::DirCpu(DirectiveInfo& info, DiagnosticsEngine& diags)
 {
@@ -188,6 +459,7 @@ X86Arch::DirBits(DirectiveInfo& info, DiagnosticsEngine& diags)
             if (v == 16 || v == 32 || v == 64)
             {
                 m_mode_bits = v;
+                InvalidateLookups();
                 return;
             }
         }
@@ -202,18 +474,21 @@ void
 X86Arch::DirCode16(DirectiveInfo& info, DiagnosticsEngine& diags)
 {
     m_mode_bits = 16;
+    InvalidateLookups();
 }
 
 void
 X86Arch::DirCode32(DirectiveInfo& info, DiagnosticsEngine& diags)
 {
     m_mode_bits = 32;
+    InvalidateLookups();
 }
 
 void
 X86Arch::DirCode64(DirectiveInfo& info, DiagnosticsEngine& diags)
 {
     m_mode_bits = 64;
+    InvalidateLookups();
 }
 
 void
@@ -296,8 +571,7 @@ X86Arch::getFill() const
     static const unsigned char fill16_15[15] =
         {0xeb, 0x0d, 0x90, 0x90, 0x90, 0x90,    // 15 - jmp $+15; nop fill
          0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90};
-    static const unsigned char *fill16[16] =
-    {
+    static const unsigned char *fill16[16] = {
         NULL,      fill16_1,  fill16_2,  fill16_3,
         fill16_4,  fill16_5,  fill16_6,  fill16_7,
         fill16_8,  fill16_9,  fill16_10, fill16_11,
@@ -374,8 +648,7 @@ X86Arch::getFill() const
     static const unsigned char fill32_15[15] =
         {0xeb, 0x0d, 0x90, 0x90, 0x90, 0x90,    // 15 - jmp $+15; nop fill
          0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90};
-    static const unsigned char *fill32[16] =
-    {
+    static const unsigned char *fill32[16] = {
         NULL,      fill32_1,  fill32_2,  fill32_3,
         fill32_4,  fill32_5,  fill32_6,  fill32_7,
         fill32_8,  fill32_9,  fill32_10, fill32_11,
@@ -442,15 +715,13 @@ X86Arch::getFill() const
         {0x0f, 0x1f, 0x80, 0x00, 0x00, 0x00, 0x00,        // 15 - nop(7)
          0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00}; //      nop(8)
 
-    static const unsigned char *fill32_intel[16] =
-    {
+    static const unsigned char *fill32_intel[16] = {
         NULL,           fill32_1,       fill32_2,       fill32new_3,
         fill32new_4,    fill32new_5,    fill32new_6,    fill32new_7,
         fill32new_8,    fill32new_9,    fill32intel_10, fill32intel_11,
         fill32intel_12, fill32intel_13, fill32intel_14, fill32intel_15
     };
-    static const unsigned char *fill32_amd[16] =
-    {
+    static const unsigned char *fill32_amd[16] = {
         NULL,           fill32_1,       fill32_2,       fill32new_3,
         fill32new_4,    fill32new_5,    fill32new_6,    fill32new_7,
         fill32new_8,    fill32new_9,    fill32amd_10,   fill32amd_11,
@@ -515,8 +786,8 @@ X86Arch::CreateEffAddr(std::auto_ptr<Expr> e) const
     return std::auto_ptr<EffAddr>(new X86EffAddr(m_parser == PARSER_GAS, e));
 }
 
-void
-yasm_arch_x86_DoRegister()
+extern const yasm::impl::ModuleEntry yasm_arch_x86_modules[] =
 {
-    RegisterModule<ArchModule, ArchModuleImpl<X86Arch> >("x86");
-}
+    YASM_MODULE_ENTRY(ArchModule, ArchModuleImpl<X86Arch>, "x86"),
+    YASM_MODULE_TABLE_END
+};
@@ -28,8 +28,11 @@
 //
 #include <bitset>
 
+#include "llvm/Support/DataTypes.h"
 #include "yasmx/Config/export.h"
+#include "yasmx/Support/scoped_ptr.h"
 #include "yasmx/Arch.h"
+#include "yasmx/AssocData.h"
 
 #include "X86Register.h"
 #include "X86TargetModifier.h"
@@ -45,7 +48,29 @@ class Object;
 namespace arch
 {
 
+class X86MatchCache;
 class X86RegisterGroup;
+struct X86CostModel;
+
+/// Number of instructions in a section requiring each CPU feature.
+/// Attached to sections while the "feature_usage" variable is set.
+struct YASM_STD_EXPORT X86FeatureUsage : public AssocData
+{
+    static const char* key;
+
+    X86FeatureUsage();
+    ~X86FeatureUsage();
+#ifdef WITH_XML
+    pugi::xml_node Write(pugi::xml_node out) const;
+#endif // WITH_XML
+
+    /// Count an instruction.
+    /// @param cpu      required features, bit N set for X86Arch::CpuFeature N
+    void Add(uint64_t cpu);
+
+    unsigned long m_insns;          ///< number of instructions
+    unsigned long m_counts[64];     ///< instructions per CpuFeature
+};
 
 class YASM_STD_EXPORT X86RegTmod
 {
@@ -55,6 +80,9 @@ public:
     const X86Register* getReg(X86Register::Type type, unsigned int num) const
     { return m_reg[type][num]; }
 
+    /// Get the number of registers of a type (for getReg()).
+    static unsigned int getRegCount(X86Register::Type type);
+
     const X86RegisterGroup* getRegGroup(X86Register::Type type) const
     { return m_reg_group[type]; }
 
@@ -176,6 +204,12 @@ public:
     unsigned int getAddressSize() const;
 
     bool setVar(StringRef var, unsigned long val);
+    void Reset();
+    std::auto_ptr<Arch> Clone() const;
+    bool SaveRegister(const Register& reg, RecordWriter& out) const;
+    const Register* LoadRegister(RecordReader& in) const;
+    bool LoadContents(StringRef type, RecordReader& in, Bytecode& bc) const;
+    void FinalizeObject(Object& object, DiagnosticsEngine& diags);
 
     InsnPrefix ParseCheckInsnPrefix(StringRef id,
                                     SourceLocation source,
@@ -192,11 +226,42 @@ public:
 
     std::auto_ptr<Insn> CreateEmptyInsn() const;
     std::auto_ptr<Insn> CreateInsn(const InsnInfo* info) const;
+    void ReuseInsn(std::auto_ptr<Insn>& insn, const InsnInfo* info) const;
+
+    bool Disassemble(const unsigned char* bytes,
+                     std::size_t len,
+                     uint64_t addr,
+                     DisasmInsn* insn,
+                     raw_ostream* os = 0) const;
+
+    unsigned long getFeatureUsage(const Section& sect,
+                                  FeatureUsage* usage) const;
+
+    bool setCostModel(StringRef model);
+    unsigned int getIssueWidth() const;
+    bool getLineCost(const Section& sect,
+                     SourceLocation line,
+                     InsnCost* cost) const;
+    int getDwarfRegNum(const Register& reg) const;
 
     ParserSelect getParser() const { return m_parser; }
 
     unsigned int getModeBits() const { return m_mode_bits; }
 
+    /// Get boundary that branches are padded to not cross; 0 if disabled.
+    unsigned long getBranchAlign() const { return m_branch_align; }
+
+    /// Get whether shorter equivalent instruction forms are substituted.
+    bool isOptimize() const { return m_optimize; }
+
+    /// Get whether CPU feature usage is recorded (see X86FeatureUsage).
+    bool isFeatureUsage() const { return m_feature_usage; }
+
+    /// Get the selected cost model; NULL if none.
+    const X86CostModel* getCostModel() const { return m_cost_model; }
+
+    X86MatchCache& getMatchCache() const { return *m_match_cache; }
+
     static const char* getName()
     { return "x86 (IA-32 and derivatives), AMD64"; }
     static const char* getKeyword() { return "x86"; }
@@ -208,6 +273,9 @@ private:
     // Returns false if cpuid not recognized
     bool ParseCpu(StringRef cpuid);
 
+    // Recompute m_active_cpu_bits from m_active_cpu
+    void UpdateActiveCpuBits();
+
     // Directives
     void DirCpu(DirectiveInfo& info, DiagnosticsEngine& diags);
     void DirBits(DirectiveInfo& info, DiagnosticsEngine& diags);
@@ -219,12 +287,23 @@ private:
     // What instructions/features are enabled?
     CpuMask m_active_cpu;
 
+    // m_active_cpu as a single word, bit N set for CpuFeature N
+    uint64_t m_active_cpu_bits;
+
     bool m_amd64_machine;
     ParserSelect m_parser;
     unsigned int m_mode_bits;
     bool m_force_strict;
     bool m_default_rel;
+    unsigned long m_branch_align;
+    bool m_thread_jumps;
+    bool m_optimize;
+    bool m_feature_usage;
+    const X86CostModel* m_cost_model;
     NopFormat m_nop;
+
+    // Instruction form matches
+    util::scoped_ptr<X86MatchCache> m_match_cache;
 };
 
 }} // namespace yasm::arch
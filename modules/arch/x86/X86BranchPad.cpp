@@ -0,0 +1,316 @@
+//
+// x86 branch padding bytecode
+//
+//  Copyright (C) 2026  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#define DEBUG_TYPE "x86"
+
+#include "X86BranchPad.h"
+
+#include "llvm/ADT/Statistic.h"
+#include "yasmx/BytecodeContainer.h"
+#include "yasmx/BytecodeOutput.h"
+#include "yasmx/Bytecode.h"
+#include "yasmx/Bytes.h"
+
+
+STATISTIC(num_branch_pad, "Number of branch padding bytecodes created");
+STATISTIC(num_branch_pad_fused, "Number of fused branches padded");
+
+using namespace yasm;
+using namespace yasm::arch;
+
+namespace {
+class X86BranchPad : public Bytecode::Contents
+{
+public:
+    X86BranchPad(unsigned long boundary, const unsigned char** code_fill);
+    ~X86BranchPad();
+
+    bool Finalize(Bytecode& bc, DiagnosticsEngine& diags);
+    bool CalcLen(Bytecode& bc,
+                 /*@out@*/ uint64_t* len,
+                 const Bytecode::AddSpanFunc& add_span,
+                 DiagnosticsEngine& diags);
+    bool Expand(Bytecode& bc,
+                uint64_t* len,
+                int span,
+                int64_t old_val,
+                int64_t new_val,
+                bool* keep,
+                /*@out@*/ int64_t* neg_thres,
+                /*@out@*/ int64_t* pos_thres,
+                DiagnosticsEngine& diags);
+    bool Output(Bytecode& bc, BytecodeOutput& bc_out);
+
+    StringRef getType() const;
+
+    SpecialType getSpecial() const;
+
+    X86BranchPad* clone() const;
+
+#ifdef WITH_XML
+    pugi::xml_node Write(pugi::xml_node out) const;
+#endif // WITH_XML
+
+    unsigned long m_boundary;
+    const unsigned char** m_code_fill;
+
+    /// Bytecode a possibly-fused instruction was appended to, and its
+    /// fixed length and whether it had a tail afterwards; NULL if none.
+    /*@null@*/ const Bytecode* m_fused;
+    unsigned long m_fused_len;
+    bool m_fused_tail;
+
+    /// Bytecode containing the branch; NULL if inactive.  If the fused
+    /// instruction is in the preceding bytecode, m_fused is also padded.
+    /*@null@*/ const Bytecode* m_branch;
+};
+} // anonymous namespace
+
+X86BranchPad::X86BranchPad(unsigned long boundary,
+                           const unsigned char** code_fill)
+    : m_boundary(boundary),
+      m_code_fill(code_fill),
+      m_fused(0),
+      m_fused_len(0),
+      m_fused_tail(false),
+      m_branch(0)
+{
+}
+
+X86BranchPad::~X86BranchPad()
+{
+}
+
+bool
+X86BranchPad::Finalize(Bytecode& bc, DiagnosticsEngine& diags)
+{
+    return true;
+}
+
+bool
+X86BranchPad::CalcLen(Bytecode& bc,
+                      /*@out@*/ uint64_t* len,
+                      const Bytecode::AddSpanFunc& add_span,
+                      DiagnosticsEngine& diags)
+{
+    bool keep = false;
+    int64_t neg_thres = 0;
+    int64_t pos_thres = 0;
+
+    *len = 0;
+    return Expand(bc, len, 0, 0, static_cast<long>(bc.getTailOffset()),
+                  &keep, &neg_thres, &pos_thres, diags);
+}
+
+bool
+X86BranchPad::Expand(Bytecode& bc,
+                     uint64_t* len,
+                     int span,
+                     int64_t old_val,
+                     int64_t new_val,
+                     bool* keep,
+                     /*@out@*/ int64_t* neg_thres,
+                     /*@out@*/ int64_t* pos_thres,
+                     DiagnosticsEngine& diags)
+{
+    unsigned long start = static_cast<unsigned long>(new_val);
+    *len = 0;
+    *pos_thres = new_val;
+    *keep = true;
+
+    if (!m_branch)
+        return true;
+
+    // The branch length may change during optimization, so always use its
+    // current length.  If the branch cannot fit within the boundary, don't
+    // bother padding it.
+    unsigned long branch_len = m_branch->getTotalLen();
+    if (m_fused)
+        branch_len += m_fused->getTotalLen();
+    if (branch_len == 0 || branch_len >= m_boundary)
+        return true;
+
+    // Pad to the boundary if the branch would cross or end at it.
+    unsigned long mask = ~(m_boundary-1);
+    if ((start & mask) != ((start+branch_len) & mask))
+        *len = m_boundary - (start & (m_boundary-1));
+    return true;
+}
+
+bool
+X86BranchPad::Output(Bytecode& bc, BytecodeOutput& bc_out)
+{
+    unsigned long len = bc.getTailLen();
+    if (len == 0)
+        return true;
+
+    if (!bc_out.isBits())
+    {
+        // Output as a gap.
+        bc_out.OutputGap(len, bc.getSource());
+        return true;
+    }
+
+    Bytes& bytes = bc_out.getScratch();
+    unsigned long maxlen = 15;
+    while (!m_code_fill[maxlen] && maxlen>0)
+        maxlen--;
+    assert(maxlen > 0 && "no x86 code fill");
+
+    // Fill with maximum code fill as much as possible
+    while (len > maxlen)
+    {
+        bytes.insert(bytes.end(),
+                     &m_code_fill[maxlen][0],
+                     &m_code_fill[maxlen][maxlen]);
+        len -= maxlen;
+    }
+    bytes.insert(bytes.end(), &m_code_fill[len][0], &m_code_fill[len][len]);
+    bc_out.OutputBytes(bytes, bc.getSource());
+    return true;
+}
+
+StringRef
+X86BranchPad::getType() const
+{
+    return "yasm::arch::X86BranchPad";
+}
+
+X86BranchPad::SpecialType
+X86BranchPad::getSpecial() const
+{
+    // Inactive padding is always empty.
+    return m_branch ? SPECIAL_OFFSET : SPECIAL_NONE;
+}
+
+X86BranchPad*
+X86BranchPad::clone() const
+{
+    return new X86BranchPad(*this);
+}
+
+#ifdef WITH_XML
+pugi::xml_node
+X86BranchPad::Write(pugi::xml_node out) const
+{
+    pugi::xml_node root = out.append_child("X86BranchPad");
+    root.append_attribute("boundary") = m_boundary;
+    root.append_attribute("fused") = (m_fused != 0);
+    root.append_attribute("active") = (m_branch != 0);
+    return root;
+}
+#endif // WITH_XML
+
+// Get the branch padding n bytecodes back from the end of the container, if
+// any.
+static X86BranchPad*
+getPad(BytecodeContainer& container, int n)
+{
+    if (container.size() <= static_cast<unsigned int>(n))
+        return 0;
+    Bytecode& bc = *(container.bytecodes_end()-(n+1));
+    if (!bc.hasContents()
+        || bc.getContents().getType() != "yasm::arch::X86BranchPad")
+        return 0;
+    return static_cast<X86BranchPad*>(&bc.getContents());
+}
+
+void
+arch::AppendBranchPad(BytecodeContainer& container,
+                      unsigned long boundary,
+                      const unsigned char** code_fill,
+                      SourceLocation source)
+{
+    Bytecode& bc = container.FreshBytecode();
+    bc.Transform(Bytecode::Contents::Ptr(
+        new X86BranchPad(boundary, code_fill)));
+    bc.setSource(source);
+    container.StartBytecode();
+    ++num_branch_pad;
+}
+
+void
+arch::SetBranchPadFused(BytecodeContainer& container)
+{
+    X86BranchPad* pad = getPad(container, 1);
+    if (!pad || pad->m_branch)
+        return;
+    const Bytecode& last = container.bytecodes_back();
+    pad->m_fused = &last;
+    pad->m_fused_len = last.getFixedLen();
+    pad->m_fused_tail = last.hasContents();
+}
+
+void
+arch::StartPaddedBranch(BytecodeContainer& container,
+                        bool fusible,
+                        unsigned long boundary,
+                        const unsigned char** code_fill,
+                        SourceLocation source)
+{
+    // Nothing may have been appended since the fused instruction.
+    X86BranchPad* pad = getPad(container, 1);
+    const Bytecode& last = container.bytecodes_back();
+    if (fusible && pad && !pad->m_branch && pad->m_fused == &last
+        && last.getFixedLen() == pad->m_fused_len
+        && last.hasContents() == pad->m_fused_tail)
+    {
+        // Mark as in use; EndPaddedBranch() will set the actual branch.
+        pad->m_branch = &last;
+        ++num_branch_pad_fused;
+        return;
+    }
+    AppendBranchPad(container, boundary, code_fill, source);
+}
+
+void
+arch::EndPaddedBranch(BytecodeContainer& container)
+{
+    Bytecode& last = container.bytecodes_back();
+    X86BranchPad* pad = getPad(container, 1);
+    if (pad && pad->m_branch == &last)
+    {
+        // Fused instruction and branch in same bytecode.
+        pad->m_fused = 0;
+    }
+    else if ((pad = getPad(container, 2)) != 0
+             && pad->m_branch == &*(container.bytecodes_end()-2))
+    {
+        // Branch in the bytecode following the fused instruction.
+        pad->m_branch = &last;
+    }
+    else
+    {
+        pad = getPad(container, 1);
+        assert(pad != 0 && "branch not started with StartPaddedBranch()");
+        pad->m_fused = 0;
+        pad->m_branch = &last;
+    }
+
+    // Make sure nothing else is added to the branch bytecode.
+    if (!last.hasContents())
+        container.StartBytecode();
+}
@@ -0,0 +1,84 @@
+#ifndef YASM_X86BRANCHPAD_H
+#define YASM_X86BRANCHPAD_H
+//
+// x86 branch padding bytecode header file
+//
+//  Copyright (C) 2026  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include "yasmx/Config/export.h"
+
+
+namespace yasm
+{
+
+class BytecodeContainer;
+class SourceLocation;
+
+namespace arch
+{
+
+/// Append (inactive) branch padding ahead of an instruction that may be
+/// macro-fused with an immediately following branch.
+/// @param container    container
+/// @param boundary     branch alignment boundary (power of 2)
+/// @param code_fill    code fill patterns
+/// @param source       source location
+YASM_STD_EXPORT
+void AppendBranchPad(BytecodeContainer& container,
+                     unsigned long boundary,
+                     const unsigned char** code_fill,
+                     SourceLocation source);
+
+/// Note that the instruction following the last branch padding has been
+/// appended.  A branch appended immediately after it is fused with it and
+/// shares the padding.
+/// @param container    container
+YASM_STD_EXPORT
+void SetBranchPadFused(BytecodeContainer& container);
+
+/// Prepare to append a branch.  If the branch would be fused with the
+/// previous instruction, reuses that instruction's padding; otherwise
+/// appends new branch padding.
+/// @param container    container
+/// @param fusible      true if the branch may be fused (conditional jump)
+/// @param boundary     branch alignment boundary (power of 2)
+/// @param code_fill    code fill patterns
+/// @param source       source location
+YASM_STD_EXPORT
+void StartPaddedBranch(BytecodeContainer& container,
+                       bool fusible,
+                       unsigned long boundary,
+                       const unsigned char** code_fill,
+                       SourceLocation source);
+
+/// Finish appending a branch started with StartPaddedBranch().  The
+/// padding is activated so the bytecode containing the branch (and any
+/// instruction fused with it) does not cross or end at the boundary.
+/// @param container    container
+YASM_STD_EXPORT
+void EndPaddedBranch(BytecodeContainer& container);
+
+}} // namespace yasm::arch
+
+#endif
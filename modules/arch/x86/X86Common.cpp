@@ -30,6 +30,7 @@
 #include "yasmx/Basic/Diagnostic.h"
 #include "yasmx/Bytes.h"
 #include "yasmx/Bytes_util.h"
+#include "yasmx/ParseRecord.h"
 
 #include "X86Prefix.h"
 #include "X86Register.h"
@@ -139,6 +140,26 @@ X86Common::Finish()
         m_opersize = (m_mode_bits == 64 ? 32 : m_mode_bits);
 }
 
+void
+X86Common::Save(RecordWriter& out) const
+{
+    out.WriteUnsigned(m_addrsize);
+    out.WriteUnsigned(m_opersize);
+    out.WriteUnsigned(m_lockrep_pre);
+    out.WriteUnsigned(m_acqrel_pre);
+    out.WriteUnsigned(m_mode_bits);
+}
+
+void
+X86Common::Load(RecordReader& in)
+{
+    m_addrsize = static_cast<unsigned char>(in.ReadUnsigned(0xff));
+    m_opersize = static_cast<unsigned char>(in.ReadUnsigned(0xff));
+    m_lockrep_pre = static_cast<unsigned char>(in.ReadUnsigned(0xff));
+    m_acqrel_pre = static_cast<unsigned char>(in.ReadUnsigned(0xff));
+    m_mode_bits = static_cast<unsigned char>(in.ReadUnsigned(0xff));
+}
+
 #ifdef WITH_XML
 pugi::xml_node
 X86Common::Write(pugi::xml_node out) const
@@ -177,16 +198,25 @@ X86Common::getLen() const
 void
 X86Common::ToBytes(Bytes& bytes, const X86SegmentRegister* segreg) const
 {
+    unsigned char buf[5];
+    bytes.Write(llvm::makeArrayRef(buf, Encode(buf, segreg)));
+}
+
+unsigned int
+X86Common::Encode(unsigned char* out, const X86SegmentRegister* segreg) const
+{
+    unsigned char* start = out;
     if (segreg != 0)
-        Write8(bytes, segreg->getPrefix());
+        *out++ = segreg->getPrefix();
     if (m_addrsize != 0 && m_addrsize != m_mode_bits)
-        Write8(bytes, 0x67);
+        *out++ = 0x67;
     if ((m_mode_bits != 64 && m_opersize != m_mode_bits) ||
         (m_mode_bits == 64 && m_opersize == 16))
-        Write8(bytes, 0x66);
+        *out++ = 0x66;
     // TSX hints come before lock prefix
     if (m_acqrel_pre != 0)
-        Write8(bytes, m_acqrel_pre);
+        *out++ = m_acqrel_pre;
     if (m_lockrep_pre != 0)
-        Write8(bytes, m_lockrep_pre);
+        *out++ = m_lockrep_pre;
+    return static_cast<unsigned int>(out - start);
 }
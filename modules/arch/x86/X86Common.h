@@ -35,6 +35,10 @@
 
 namespace yasm
 {
+
+class RecordReader;
+class RecordWriter;
+
 namespace arch
 {
 
@@ -54,6 +58,18 @@ public:
     unsigned long getLen() const;
     void ToBytes(Bytes& bytes, const X86SegmentRegister* segreg) const;
 
+    /// Encode the prefixes into a raw buffer, which must have room for at
+    /// least 5 bytes.
+    /// @return Number of bytes written.
+    unsigned int Encode(unsigned char* out,
+                        const X86SegmentRegister* segreg) const;
+
+    /// Write to a parse record.
+    void Save(RecordWriter& out) const;
+
+    /// Read from a parse record written by Save().
+    void Load(RecordReader& in);
+
 #ifdef WITH_XML
     pugi::xml_node Write(pugi::xml_node out) const;
 #endif // WITH_XML
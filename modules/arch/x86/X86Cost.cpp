@@ -0,0 +1,236 @@
+//
+// x86 instruction cost models
+//
+//  Copyright (C) 2026  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#define DEBUG_TYPE "x86"
+#include "X86Cost.h"
+
+#include <algorithm>
+
+#include "yasmx/Basic/SourceLocation.h"
+
+
+using namespace yasm;
+using namespace yasm::arch;
+
+// Costs are for register operands, in X86CostClass order, as {uops,
+// latency, reciprocal throughput in 1/100 cycles}.  They're rough figures
+// for a typical instruction of each class, from published measurements.
+static const X86CostModel cost_models[] =
+{
+    {"skylake", 4, 5, 6,
+     {{0, 0, 0},        // None
+      {1, 1, 25},       // Mov
+      {1, 1, 25},       // Alu
+      {1, 1, 25},       // Cmp
+      {1, 1, 50},       // Shift
+      {1, 1, 50},       // Lea
+      {1, 3, 100},      // Mul
+      {10, 26, 600},    // Div
+      {36, 35, 2100},   // Div64
+      {1, 1, 50},       // Branch
+      {1, 1, 100},      // Push
+      {1, 5, 50},       // Pop
+      {1, 3, 100},      // BitCount
+      {1, 1, 50},       // Bmi
+      {1, 3, 100},      // Pdep
+      {2, 4, 100},      // Mulx
+      {1, 1, 33},       // SimdMov
+      {1, 1, 33},       // SimdInt
+      {1, 1, 50},       // SimdShift
+      {2, 2, 67},       // Blendv
+      {1, 1, 100},      // Shuffle
+      {1, 3, 100},      // LaneShuffle
+      {2, 3, 100},      // Extract
+      {1, 2, 100},      // Movmsk
+      {1, 4, 50},       // FAdd
+      {1, 4, 50},       // FMul
+      {1, 4, 50},       // Fma
+      {1, 11, 300},     // FDiv
+      {1, 14, 400},     // FDivD
+      {1, 12, 300},     // FSqrt
+      {1, 18, 600},     // FSqrtD
+      {1, 4, 100},      // Rcp
+      {2, 8, 100},      // Round
+      {2, 5, 100},      // Cvt
+      {2, 3, 100},      // Comis
+      {1, 5, 50},       // PMul
+      {2, 10, 100},     // PMulld
+      {3, 6, 200},      // HAdd
+      {4, 13, 150},     // Dpps
+      {4, 22, 500},     // Gather
+      {1, 4, 100},      // Aes
+      {1, 7, 100}}},    // Clmul
+    {"zen2", 5, 4, 7,
+     {{0, 0, 0},        // None
+      {1, 1, 25},       // Mov
+      {1, 1, 25},       // Alu
+      {1, 1, 25},       // Cmp
+      {1, 1, 25},       // Shift
+      {1, 1, 25},       // Lea
+      {1, 3, 100},      // Mul
+      {2, 14, 1400},    // Div
+      {2, 14, 1400},    // Div64
+      {1, 1, 50},       // Branch
+      {1, 1, 100},      // Push
+      {1, 4, 50},       // Pop
+      {1, 2, 50},       // BitCount
+      {1, 1, 25},       // Bmi
+      {127, 134, 5200}, // Pdep (microcoded)
+      {2, 3, 100},      // Mulx
+      {1, 1, 25},       // SimdMov
+      {1, 1, 33},       // SimdInt
+      {1, 1, 50},       // SimdShift
+      {1, 1, 50},       // Blendv
+      {1, 1, 50},       // Shuffle
+      {2, 6, 100},      // LaneShuffle
+      {2, 3, 100},      // Extract
+      {1, 3, 100},      // Movmsk
+      {1, 3, 50},       // FAdd
+      {1, 3, 50},       // FMul
+      {1, 5, 50},       // Fma
+      {1, 10, 350},     // FDiv
+      {1, 13, 450},     // FDivD
+      {1, 14, 500},     // FSqrt
+      {1, 20, 900},     // FSqrtD
+      {1, 5, 100},      // Rcp
+      {1, 3, 100},      // Round
+      {2, 4, 100},      // Cvt
+      {1, 4, 100},      // Comis
+      {1, 4, 100},      // PMul
+      {1, 4, 100},      // PMulld
+      {4, 7, 200},      // HAdd
+      {8, 15, 400},     // Dpps
+      {38, 24, 1600},   // Gather
+      {1, 4, 50},       // Aes
+      {4, 4, 200}}},    // Clmul
+};
+
+const X86CostModel*
+yasm::arch::FindX86CostModel(StringRef name)
+{
+    for (unsigned int i=0; i<sizeof(cost_models)/sizeof(cost_models[0]); ++i)
+    {
+        if (name.equals_lower(cost_models[i].name))
+            return &cost_models[i];
+    }
+    return 0;
+}
+
+void
+yasm::arch::GetX86InsnCost(const X86CostModel& model,
+                           X86CostClass cls,
+                           bool mem,
+                           bool mem_dest,
+                           Arch::InsnCost* cost)
+{
+    cost->insns = 1;
+    cost->unknown = (cls == COST_None) ? 1 : 0;
+
+    const X86CostModel::Cost& base = model.costs[cls];
+    cost->uops = base.uops;
+    cost->latency = base.latency;
+    cost->rthroughput = base.rthroughput;
+    if (!mem || cls == COST_None || cls == COST_Lea)
+        return;
+
+    unsigned int load_latency = (cls >= COST_SimdMov) ?
+        model.simd_load_latency : model.load_latency;
+    switch (cls)
+    {
+        case COST_Mov:
+        case COST_SimdMov:
+        case COST_Extract:
+            if (mem_dest)
+            {
+                // Plain store.
+                cost->uops = 1;
+                cost->latency = 1;
+                cost->rthroughput = 100;
+                return;
+            }
+            if (cls != COST_Extract)
+            {
+                // Plain load.
+                cost->uops = 1;
+                cost->latency = load_latency;
+                cost->rthroughput = 50;
+                return;
+            }
+            break;
+        case COST_Alu:
+        case COST_Shift:
+            if (mem_dest)
+            {
+                // Read-modify-write: add the store.
+                cost->uops += 1;
+                cost->rthroughput = std::max(cost->rthroughput, 100U);
+            }
+            break;
+        default:
+            break;
+    }
+
+    // Add the load.
+    cost->uops += 1;
+    cost->latency += load_latency;
+    cost->rthroughput = std::max(cost->rthroughput, 50U);
+}
+
+const char* X86InsnCosts::key = "arch::x86::X86InsnCosts";
+
+X86InsnCosts::X86InsnCosts()
+{
+}
+
+X86InsnCosts::~X86InsnCosts()
+{
+}
+
+void
+X86InsnCosts::Add(SourceLocation line, const Arch::InsnCost& cost)
+{
+    std::pair<Lines::iterator, bool> ins =
+        m_lines.insert(std::make_pair(line.getRawEncoding(), cost));
+    if (ins.second)
+        return;
+    Arch::InsnCost& total = ins.first->second;
+    total.insns += cost.insns;
+    total.unknown += cost.unknown;
+    total.uops += cost.uops;
+    total.latency += cost.latency;
+    total.rthroughput += cost.rthroughput;
+}
+
+#ifdef WITH_XML
+pugi::xml_node
+X86InsnCosts::Write(pugi::xml_node out) const
+{
+    pugi::xml_node root = out.append_child("X86InsnCosts");
+    root.append_attribute("key") = key;
+    append_child(root, "Lines", m_lines.size());
+    return root;
+}
+#endif // WITH_XML
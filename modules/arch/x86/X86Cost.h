@@ -0,0 +1,156 @@
+#ifndef YASM_X86COST_H
+#define YASM_X86COST_H
+//
+// x86 instruction cost models
+//
+//  Copyright (C) 2026  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#define DEBUG_TYPE "x86"
+#include <map>
+
+#include "llvm/ADT/StringRef.h"
+#include "yasmx/Basic/SourceLocation.h"
+#include "yasmx/Config/export.h"
+#include "yasmx/Arch.h"
+#include "yasmx/AssocData.h"
+
+
+namespace yasm
+{
+
+namespace arch
+{
+
+/// Instruction cost classes, by the kind of work an instruction does.
+/// Instruction mnemonics are assigned a class by gen_x86_insn.py.  The
+/// general purpose classes come before the SIMD classes (COST_SimdMov on).
+enum X86CostClass
+{
+    COST_None = 0,      // not modeled
+    COST_Mov,           // moves and sign/zero extension
+    COST_Alu,           // simple arithmetic and logic, cmov, setcc
+    COST_Cmp,           // compares (no result written)
+    COST_Shift,         // shifts and rotates
+    COST_Lea,           // address computation
+    COST_Mul,           // integer multiply
+    COST_Div,           // integer divide
+    COST_Div64,         // integer divide, 64-bit operand size
+    COST_Branch,        // jumps, calls, and returns
+    COST_Push,
+    COST_Pop,
+    COST_BitCount,      // popcnt, lzcnt, tzcnt, bsf, bsr, crc32
+    COST_Bmi,           // simple BMI1/BMI2 instructions
+    COST_Pdep,          // pdep, pext
+    COST_Mulx,
+    COST_SimdMov,       // SIMD moves
+    COST_SimdInt,       // SIMD integer arithmetic and logic, blends
+    COST_SimdShift,     // SIMD shifts
+    COST_Blendv,        // variable blends
+    COST_Shuffle,       // in-lane shuffles, packs, and extensions
+    COST_LaneShuffle,   // cross-lane shuffles and broadcasts
+    COST_Extract,       // element insertion and extraction
+    COST_Movmsk,
+    COST_FAdd,          // FP add, subtract, min, max, and compare
+    COST_FMul,          // FP multiply
+    COST_Fma,           // FP fused multiply-add
+    COST_FDiv,          // single precision FP divide
+    COST_FDivD,         // double precision FP divide
+    COST_FSqrt,         // single precision FP square root
+    COST_FSqrtD,        // double precision FP square root
+    COST_Rcp,           // FP reciprocal approximations
+    COST_Round,         // FP rounding
+    COST_Cvt,           // conversions
+    COST_Comis,         // FP compares setting flags, ptest
+    COST_PMul,          // SIMD integer multiply
+    COST_PMulld,
+    COST_HAdd,          // horizontal add and subtract
+    COST_Dpps,          // dot products
+    COST_Gather,
+    COST_Aes,
+    COST_Clmul,
+    NUM_COST_CLASSES
+};
+
+/// Instruction costs of a microarchitecture, as rough estimates of the
+/// typical form of each instruction class.
+struct X86CostModel
+{
+    struct Cost
+    {
+        unsigned char uops;         ///< micro-operations
+        unsigned char latency;      ///< latency, in cycles
+        unsigned short rthroughput; ///< reciprocal throughput, 1/100 cycles
+    };
+
+    const char* name;               ///< keyword
+    unsigned int issue_width;       ///< micro-operations issued per cycle
+    unsigned int load_latency;      ///< load latency to general registers
+    unsigned int simd_load_latency; ///< load latency to SIMD registers
+    Cost costs[NUM_COST_CLASSES];   ///< costs with register operands
+};
+
+/// Find a cost model.
+/// @param name         microarchitecture keyword
+/// @return Cost model, or NULL if not found.
+YASM_STD_EXPORT
+const X86CostModel* FindX86CostModel(StringRef name);
+
+/// Estimate the cost of an instruction.
+/// @param model        cost model
+/// @param cls          instruction cost class
+/// @param mem          instruction has a memory operand
+/// @param mem_dest     the memory operand is the first (destination) operand
+/// @param cost         estimated cost of one instruction (output)
+YASM_STD_EXPORT
+void GetX86InsnCost(const X86CostModel& model,
+                    X86CostClass cls,
+                    bool mem,
+                    bool mem_dest,
+                    Arch::InsnCost* cost);
+
+/// Estimated instruction costs of the listed lines of a section.
+/// Attached to sections while a cost model is selected.
+struct YASM_STD_EXPORT X86InsnCosts : public AssocData
+{
+    static const char* key;
+
+    X86InsnCosts();
+    ~X86InsnCosts();
+#ifdef WITH_XML
+    pugi::xml_node Write(pugi::xml_node out) const;
+#endif // WITH_XML
+
+    /// Add the cost of an instruction to a line.
+    /// @param line         source line
+    /// @param cost         instruction cost
+    void Add(SourceLocation line, const Arch::InsnCost& cost);
+
+    /// Line costs, keyed by raw source location encoding.
+    typedef std::map<SourceLocation::UIntTy, Arch::InsnCost> Lines;
+    Lines m_lines;
+};
+
+}} // namespace yasm::arch
+
+#endif
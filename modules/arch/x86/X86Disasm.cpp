@@ -0,0 +1,889 @@
+//
+// x86 instruction decoding
+//
+//  Copyright (C) 2026  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include "X86Arch.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+
+using namespace yasm;
+using namespace yasm::arch;
+
+namespace {
+// Decoding flags.
+enum X86DisasmFlags
+{
+    DIS_ONLY_64 = 1<<0,     // Only valid in 64-bit mode
+    DIS_NOT_64 = 1<<1,      // Not valid in 64-bit mode
+    DIS_MODRM = 1<<2,       // Has a ModRM byte
+    DIS_MEM = 1<<3,         // ModRM must select memory
+    DIS_OPREG = 1<<4,       // Register in low 3 bits of opcode byte
+    DIS_SUFFIX = 1<<5,      // Opcode suffix byte after operands
+    DIS_VEX = 1<<6,         // VEX encoded; prefix is VEX W, L, and pp
+    DIS_XOP = 1<<7          // XOP encoded; prefix is XOP W, L, and pp
+};
+
+// Operand kinds.
+enum X86DisasmOperandKind
+{
+    DOP_GPR = 0,            // general purpose register (or memory if EA)
+    DOP_SIMD,               // MMX/XMM/YMM register (or memory if EA)
+    DOP_Seg,                // segment register
+    DOP_CR,                 // control register
+    DOP_DR,                 // debug register
+    DOP_TR,                 // test register
+    DOP_ST,                 // FPU register
+    DOP_Mem,                // memory
+    DOP_MemOffs,            // memory at absolute offset
+    DOP_MemXMMIndex,        // memory with VSIB XMM index
+    DOP_MemYMMIndex,        // memory with VSIB YMM index
+    DOP_Imm,                // immediate
+    DOP_SImm,               // sign-extended immediate
+    DOP_Rel,                // relative branch target
+    DOP_Far,                // far (segment:offset) branch target
+    DOP_One,                // implicit immediate 1
+    DOP_Imm4,               // immediate in low 4 bits of IS4 byte
+    DOP_AdSizeReg           // CX/ECX/RCX selecting address size
+};
+
+// Where an operand's register number or value comes from.
+enum X86DisasmOperandSource
+{
+    DSRC_None = 0,          // fixed register number
+    DSRC_EA,                // ModRM r/m field (or memory)
+    DSRC_Spare,             // ModRM reg field
+    DSRC_OpReg,             // low 3 bits of opcode byte
+    DSRC_VEX,               // VEX/XOP vvvv field
+    DSRC_IS4,               // high 4 bits of IS4 byte
+    DSRC_Imm                // immediate bytes
+};
+
+struct X86DisasmOperand
+{
+    unsigned char kind;     // X86DisasmOperandKind
+    unsigned short size;    // size in bits; 0=unspecified, 1=operand size
+    unsigned char source;   // X86DisasmOperandSource
+    unsigned char num;      // register number for DSRC_None
+};
+
+struct X86DisasmInfo
+{
+    const char* name;
+    const char* features;
+    unsigned char flags;        // X86DisasmFlags
+    unsigned char prefix;       // required 66/F2/F3 prefix; VEX/XOP data
+    unsigned char opersize;     // required operand size (0=any)
+    unsigned char addrsize;     // required address size (0=any)
+    unsigned char def_opersize_64;
+    unsigned char modrm;        // required ModRM bits
+    unsigned char modrm_mask;   // ModRM bits that must match
+    unsigned char suffix;       // opcode suffix (DIS_SUFFIX)
+    unsigned char num_operands;
+    unsigned short operands_index;
+};
+
+#include "X86DisasmTable.cpp"
+
+class X86Decoder
+{
+public:
+    X86Decoder(const unsigned char* bytes,
+               std::size_t avail,
+               unsigned int mode_bits);
+
+    /// Decode the instruction.
+    /// @return False if not recognized.
+    bool Decode();
+
+    const X86DisasmInfo& getInfo() const { return *m_info; }
+    unsigned int getLength() const { return m_len; }
+
+    void Print(raw_ostream& os, uint64_t addr) const;
+
+private:
+    bool Match(const X86DisasmInfo& info, bool relaxed);
+    bool CalcLength();
+    unsigned int getImmSize(const X86DisasmOperand& op) const;
+    uint64_t getImm(unsigned int pos, unsigned int size) const;
+    unsigned int getRegNum(const X86DisasmOperand& op) const;
+    bool isReg(const X86DisasmOperand& op) const;
+    void PrintReg(raw_ostream& os,
+                  const X86DisasmOperand& op,
+                  unsigned int size) const;
+    void PrintEA(raw_ostream& os,
+                 const X86DisasmOperand& op,
+                 uint64_t addr) const;
+    void PrintSize(raw_ostream& os, unsigned int size) const;
+
+    const unsigned char* m_bytes;
+    std::size_t m_avail;
+    unsigned int m_mode_bits;
+
+    // Prefixes
+    unsigned char m_seg;            // segment override prefix, or 0
+    unsigned char m_rep;            // last F2/F3 prefix, or 0
+    bool m_opsize_prefix;
+    bool m_addrsize_prefix;
+    bool m_lock;
+    unsigned char m_rex;            // REX prefix (or VEX equivalent), or 0
+    unsigned char m_vex;            // VEX/XOP W, L, pp as in X86DisasmInfo
+    unsigned char m_vexreg;         // VEX/XOP vvvv
+
+    unsigned int m_map;
+    unsigned char m_opcode;
+    unsigned int m_modrm_pos;       // position of ModRM byte (if any)
+
+    // Matched instruction
+    const X86DisasmInfo* m_info;
+    unsigned int m_opersize;
+    unsigned int m_addrsize;
+    unsigned int m_disp_pos;        // position of displacement
+    unsigned int m_disp_len;        // length of displacement
+    unsigned int m_imm_pos;         // position of first immediate
+    unsigned int m_len;
+};
+} // anonymous namespace
+
+X86Decoder::X86Decoder(const unsigned char* bytes,
+                       std::size_t avail,
+                       unsigned int mode_bits)
+    : m_bytes(bytes)
+    , m_avail(avail > 15 ? 15 : avail)
+    , m_mode_bits(mode_bits)
+    , m_seg(0)
+    , m_rep(0)
+    , m_opsize_prefix(false)
+    , m_addrsize_prefix(false)
+    , m_lock(false)
+    , m_rex(0)
+    , m_vex(0)
+    , m_vexreg(0)
+    , m_map(0)
+    , m_opcode(0)
+    , m_modrm_pos(0)
+    , m_info(0)
+    , m_opersize(0)
+    , m_addrsize(0)
+    , m_disp_pos(0)
+    , m_disp_len(0)
+    , m_imm_pos(0)
+    , m_len(0)
+{
+}
+
+bool
+X86Decoder::Decode()
+{
+    // Legacy and REX prefixes.  A REX prefix only counts if it comes last.
+    unsigned int pos = 0;
+    for (;; ++pos)
+    {
+        if (pos >= m_avail)
+            return false;
+        unsigned char b = m_bytes[pos];
+        switch (b)
+        {
+            case 0x26: case 0x2E: case 0x36: case 0x3E: case 0x64: case 0x65:
+                m_seg = b;
+                break;
+            case 0x66:
+                m_opsize_prefix = true;
+                break;
+            case 0x67:
+                m_addrsize_prefix = true;
+                break;
+            case 0xF0:
+                m_lock = true;
+                break;
+            case 0xF2:
+            case 0xF3:
+                m_rep = b;
+                break;
+            default:
+                if (m_mode_bits == 64 && (b & 0xF0) == 0x40)
+                {
+                    m_rex = b;
+                    continue;
+                }
+                goto opcode;
+        }
+        m_rex = 0;
+    }
+
+opcode:
+    unsigned char b = m_bytes[pos];
+    if ((b == 0xC4 || b == 0xC5 || b == 0x8F) && pos+1 < m_avail)
+    {
+        // VEX and XOP prefixes.  Outside 64-bit mode, C4 and C5 are LES
+        // and LDS unless the next byte would be a register ModRM; 8F is
+        // POP unless the map select is 8 or higher.
+        unsigned char b1 = m_bytes[pos+1];
+        bool vex;
+        if (b == 0x8F)
+            vex = (b1 & 0x1F) >= 8;
+        else
+            vex = m_mode_bits == 64 || (b1 & 0xC0) == 0xC0;
+        if (vex)
+        {
+            unsigned char b2;
+            if (b == 0xC5)
+            {
+                b2 = b1;
+                m_rex = 0x40 | ((~b1 >> 5) & 0x04);
+                m_map = 1;
+                pos += 2;
+            }
+            else
+            {
+                if (pos+2 >= m_avail)
+                    return false;
+                b2 = m_bytes[pos+2];
+                m_rex = 0x40 | ((~b1 >> 5) & 0x07) | ((b2 >> 4) & 0x08);
+                unsigned int mmmmm = b1 & 0x1F;
+                if (b == 0x8F)
+                {
+                    if (mmmmm > 0x0A)
+                        return false;
+                    m_map = 4 + mmmmm - 8;
+                }
+                else
+                {
+                    if (mmmmm < 1 || mmmmm > 3)
+                        return false;
+                    m_map = mmmmm;
+                }
+                pos += 3;
+            }
+            m_vex = (b == 0x8F ? 0x80 : 0xC0) | (b2 & 0x07);
+            if (b != 0xC5)
+                m_vex |= (b2 >> 4) & 0x08;      // W
+            m_vexreg = (~b2 >> 3) & 0x0F;
+            if (m_mode_bits != 64)
+            {
+                // Only 8 registers can be selected
+                m_rex &= 0x48;
+                m_vexreg &= 0x07;
+            }
+        }
+    }
+    if (!m_vex && b == 0x0F)
+    {
+        if (++pos >= m_avail)
+            return false;
+        m_map = 1;
+        b = m_bytes[pos];
+        if (b == 0x38 || b == 0x3A)
+        {
+            m_map = (b == 0x38) ? 2 : 3;
+            ++pos;
+        }
+    }
+    if (pos >= m_avail)
+        return false;
+    m_opcode = m_bytes[pos];
+    m_modrm_pos = pos+1;
+
+    unsigned int slot = m_map*256 + m_opcode;
+    const X86DisasmInfo* first = &disasm_info[disasm_index[slot]];
+    const X86DisasmInfo* last = &disasm_info[disasm_index[slot+1]];
+
+    for (const X86DisasmInfo* info = first; info != last; ++info)
+    {
+        if (Match(*info, false))
+            return true;
+    }
+
+    // Encoders may set VEX W or L in instructions that ignore them.
+    if (m_vex)
+    {
+        for (const X86DisasmInfo* info = first; info != last; ++info)
+        {
+            if (Match(*info, true))
+                return true;
+        }
+    }
+    return false;
+}
+
+bool
+X86Decoder::Match(const X86DisasmInfo& info, bool relaxed)
+{
+    unsigned int flags = info.flags;
+    if (m_mode_bits == 64 ? (flags & DIS_NOT_64) : (flags & DIS_ONLY_64))
+        return false;
+
+    if (m_vex)
+    {
+        if ((flags & (DIS_VEX|DIS_XOP)) == 0)
+            return false;
+        unsigned char mask = relaxed ? 0x03 : 0x0F;
+        if (((m_vex ^ info.prefix) & mask) != 0)
+            return false;
+    }
+    else
+    {
+        if ((flags & (DIS_VEX|DIS_XOP)) != 0)
+            return false;
+        switch (info.prefix)
+        {
+            case 0x66:
+                if (!m_opsize_prefix)
+                    return false;
+                break;
+            case 0xF2:
+            case 0xF3:
+                if (m_rep != info.prefix)
+                    return false;
+                break;
+        }
+    }
+
+    // Operand and address size, as X86Common::ApplyPrefixes() sets them
+    bool opsize_prefix = m_opsize_prefix && info.prefix != 0x66;
+    if (m_mode_bits == 64)
+    {
+        if (m_rex & 0x08)
+            m_opersize = 64;
+        else if (opsize_prefix && !m_vex)
+            m_opersize = 16;
+        else if (info.def_opersize_64 == 64 && !m_vex)
+            m_opersize = 64;
+        else
+            m_opersize = 32;
+        m_addrsize = m_addrsize_prefix ? 32 : 64;
+    }
+    else
+    {
+        m_opersize = m_mode_bits;
+        if (opsize_prefix && !m_vex)
+            m_opersize ^= 16 | 32;
+        else if (m_vex)
+            m_opersize = 32;
+        m_addrsize = m_mode_bits;
+        if (m_addrsize_prefix)
+            m_addrsize ^= 16 | 32;
+    }
+    if (info.opersize != 0 && !m_vex && info.opersize != m_opersize)
+        return false;
+    if (info.addrsize != 0 && info.addrsize != m_addrsize)
+        return false;
+
+    if (flags & DIS_MODRM)
+    {
+        if (m_modrm_pos >= m_avail)
+            return false;
+        unsigned char modrm = m_bytes[m_modrm_pos];
+        if ((modrm & info.modrm_mask) != info.modrm)
+            return false;
+        if ((flags & DIS_MEM) && (modrm & 0xC0) == 0xC0)
+            return false;
+    }
+
+    m_info = &info;
+    if (!CalcLength())
+        return false;
+    if ((flags & DIS_SUFFIX) && m_bytes[m_len-1] != info.suffix)
+        return false;
+    return true;
+}
+
+bool
+X86Decoder::CalcLength()
+{
+    unsigned int pos = m_modrm_pos;
+    m_disp_len = 0;
+    if (m_info->flags & DIS_MODRM)
+    {
+        unsigned char modrm = m_bytes[pos++];
+        unsigned int mod = modrm >> 6;
+        unsigned int rm = modrm & 7;
+        if (mod == 3)
+            ;
+        else if (m_addrsize == 16)
+        {
+            if (mod == 1)
+                m_disp_len = 1;
+            else if (mod == 2 || rm == 6)
+                m_disp_len = 2;
+        }
+        else
+        {
+            if (rm == 4)
+            {
+                if (pos >= m_avail)
+                    return false;
+                unsigned char sib = m_bytes[pos++];
+                if (mod == 0 && (sib & 7) == 5)
+                    m_disp_len = 4;
+            }
+            if (mod == 1)
+                m_disp_len = 1;
+            else if (mod == 2 || (mod == 0 && rm == 5))
+                m_disp_len = 4;
+        }
+    }
+    m_disp_pos = pos;
+    pos += m_disp_len;
+
+    m_imm_pos = pos;
+    bool is4 = false;
+    const X86DisasmOperand* op = &disasm_operands[m_info->operands_index];
+    for (unsigned int i=0; i<m_info->num_operands; ++i, ++op)
+    {
+        switch (op->kind)
+        {
+            case DOP_MemOffs:
+                pos += m_addrsize/8;
+                break;
+            case DOP_Imm:
+            case DOP_SImm:
+            case DOP_Rel:
+                pos += getImmSize(*op)/8;
+                break;
+            case DOP_Far:
+                pos += getImmSize(*op)/8 + 2;
+                break;
+            case DOP_Imm4:
+                is4 = true;
+                break;
+            default:
+                if (op->source == DSRC_IS4)
+                    is4 = true;
+                break;
+        }
+    }
+    if (is4)
+        ++pos;
+    if (m_info->flags & DIS_SUFFIX)
+        ++pos;
+    if (pos > m_avail)
+        return false;
+    m_len = pos;
+    return true;
+}
+
+unsigned int
+X86Decoder::getImmSize(const X86DisasmOperand& op) const
+{
+    if (op.size > 1)
+        return op.size;
+    // Branch offsets are at most 32 bits
+    if (m_opersize == 64 && (op.kind == DOP_Rel || op.kind == DOP_Far))
+        return 32;
+    return m_opersize;
+}
+
+uint64_t
+X86Decoder::getImm(unsigned int pos, unsigned int size) const
+{
+    uint64_t val = 0;
+    for (unsigned int i=size/8; i>0; --i)
+        val = (val << 8) | m_bytes[pos+i-1];
+    return val;
+}
+
+static int64_t
+SignExtend(uint64_t val, unsigned int size)
+{
+    if (size >= 64)
+        return static_cast<int64_t>(val);
+    uint64_t sign = UINT64_C(1) << (size-1);
+    return static_cast<int64_t>((val ^ sign) - sign);
+}
+
+static void
+PrintHex(raw_ostream& os, uint64_t val)
+{
+    os << "0x";
+    os.write_hex(val);
+}
+
+static void
+PrintSignedHex(raw_ostream& os, int64_t val)
+{
+    if (val < 0)
+    {
+        os << '-';
+        PrintHex(os, -static_cast<uint64_t>(val));
+    }
+    else
+        PrintHex(os, static_cast<uint64_t>(val));
+}
+
+unsigned int
+X86Decoder::getRegNum(const X86DisasmOperand& op) const
+{
+    switch (op.source)
+    {
+        case DSRC_EA:
+            return (m_bytes[m_modrm_pos] & 7) | ((m_rex & 0x01) << 3);
+        case DSRC_Spare:
+            return ((m_bytes[m_modrm_pos] >> 3) & 7) | ((m_rex & 0x04) << 1);
+        case DSRC_OpReg:
+            return (m_opcode & 7) | ((m_rex & 0x01) << 3);
+        case DSRC_VEX:
+            return m_vexreg;
+        case DSRC_IS4:
+        {
+            unsigned int pos = m_len - 1;
+            if (m_info->flags & DIS_SUFFIX)
+                --pos;
+            unsigned int num = m_bytes[pos] >> 4;
+            return m_mode_bits == 64 ? num : (num & 7);
+        }
+        default:
+            return op.num;
+    }
+}
+
+bool
+X86Decoder::isReg(const X86DisasmOperand& op) const
+{
+    switch (op.kind)
+    {
+        case DOP_GPR:
+        case DOP_SIMD:
+            return op.source != DSRC_EA
+                || (m_bytes[m_modrm_pos] & 0xC0) == 0xC0;
+        case DOP_Seg:
+        case DOP_CR:
+        case DOP_DR:
+        case DOP_TR:
+        case DOP_ST:
+            return true;
+        default:
+            return false;
+    }
+}
+
+void
+X86Decoder::PrintReg(raw_ostream& os,
+                     const X86DisasmOperand& op,
+                     unsigned int size) const
+{
+    static const char* reg8[] =
+        {"al", "cl", "dl", "bl", "ah", "ch", "dh", "bh"};
+    static const char* reg8x[] =
+        {"al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil"};
+    static const char* reg16[] =
+        {"ax", "cx", "dx", "bx", "sp", "bp", "si", "di"};
+    static const char* segreg[] =
+        {"es", "cs", "ss", "ds", "fs", "gs", "segr6", "segr7"};
+
+    unsigned int num = getRegNum(op);
+    switch (op.kind)
+    {
+        case DOP_GPR:
+        case DOP_AdSizeReg:
+            if (num >= 8)
+            {
+                os << 'r' << num;
+                if (size == 8)
+                    os << 'b';
+                else if (size == 16)
+                    os << 'w';
+                else if (size == 32)
+                    os << 'd';
+            }
+            else if (size == 8)
+                os << (m_rex != 0 ? reg8x[num] : reg8[num]);
+            else if (size == 16)
+                os << reg16[num];
+            else
+                os << (size == 64 ? 'r' : 'e') << reg16[num];
+            break;
+        case DOP_SIMD:
+            if (size == 64)
+                os << "mm" << (num & 7);
+            else
+                os << (size == 256 ? "ymm" : "xmm") << num;
+            break;
+        case DOP_Seg:
+            os << segreg[num & 7];
+            break;
+        case DOP_CR:
+            os << "cr" << num;
+            break;
+        case DOP_DR:
+            os << "dr" << num;
+            break;
+        case DOP_TR:
+            os << "tr" << (num & 7);
+            break;
+        case DOP_ST:
+            os << "st" << (num & 7);
+            break;
+    }
+}
+
+void
+X86Decoder::PrintSize(raw_ostream& os, unsigned int size) const
+{
+    switch (size)
+    {
+        case 8: os << "byte "; break;
+        case 16: os << "word "; break;
+        case 32: os << "dword "; break;
+        case 64: os << "qword "; break;
+        case 80: os << "tword "; break;
+        case 128: os << "oword "; break;
+        case 256: os << "yword "; break;
+    }
+}
+
+void
+X86Decoder::PrintEA(raw_ostream& os,
+                    const X86DisasmOperand& op,
+                    uint64_t addr) const
+{
+    static const char* base16[] =
+        {"bx+si", "bx+di", "bp+si", "bp+di", "si", "di", "bp", "bx"};
+
+    PrintSize(os, op.size == 1 ? m_opersize : op.size);
+    os << '[';
+    if (m_seg != 0)
+    {
+        static const char* segname[] = {"es", "cs", "ss", "ds"};
+        if (m_seg == 0x64)
+            os << "fs:";
+        else if (m_seg == 0x65)
+            os << "gs:";
+        else
+            os << segname[(m_seg >> 3) & 3] << ':';
+    }
+
+    uint64_t mask = m_addrsize == 64 ? ~UINT64_C(0)
+        : ((UINT64_C(1) << m_addrsize) - 1);
+
+    if (op.kind == DOP_MemOffs)
+    {
+        PrintHex(os, getImm(m_imm_pos, m_addrsize));
+        os << ']';
+        return;
+    }
+
+    unsigned char modrm = m_bytes[m_modrm_pos];
+    unsigned int mod = modrm >> 6;
+    unsigned int rm = modrm & 7;
+    int64_t disp = SignExtend(getImm(m_disp_pos, m_disp_len*8),
+                              m_disp_len*8);
+    if (m_disp_len == 0)
+        disp = 0;
+
+    if (m_addrsize == 16)
+    {
+        if (mod == 0 && rm == 6)
+            PrintHex(os, static_cast<uint64_t>(disp) & mask);
+        else
+        {
+            os << base16[rm];
+            if (disp != 0)
+            {
+                if (disp > 0)
+                    os << '+';
+                PrintSignedHex(os, disp);
+            }
+        }
+        os << ']';
+        return;
+    }
+
+    if (mod == 0 && rm == 5)
+    {
+        if (m_mode_bits == 64)
+        {
+            // RIP-relative
+            os << "rel ";
+            PrintHex(os, (addr + m_len + disp) & mask);
+        }
+        else
+            PrintHex(os, static_cast<uint64_t>(disp) & mask);
+        os << ']';
+        return;
+    }
+
+    unsigned int base = rm | ((m_rex & 0x01) << 3);
+    bool has_base = true;
+    unsigned int index = 0, scale = 1;
+    bool has_index = false;
+    if (rm == 4)
+    {
+        unsigned char sib = m_bytes[m_modrm_pos+1];
+        base = (sib & 7) | ((m_rex & 0x01) << 3);
+        has_base = !(mod == 0 && (sib & 7) == 5);
+        index = ((sib >> 3) & 7) | ((m_rex & 0x02) << 2);
+        scale = 1 << (sib >> 6);
+        has_index = index != 4 || op.kind == DOP_MemXMMIndex
+            || op.kind == DOP_MemYMMIndex;
+    }
+
+    X86DisasmOperand reg = {DOP_GPR, 0, DSRC_None, 0};
+    if (has_base)
+    {
+        reg.num = base;
+        PrintReg(os, reg, m_addrsize);
+    }
+    if (has_index)
+    {
+        if (has_base)
+            os << '+';
+        reg.num = index;
+        if (op.kind == DOP_MemXMMIndex || op.kind == DOP_MemYMMIndex)
+        {
+            reg.kind = DOP_SIMD;
+            PrintReg(os, reg, op.kind == DOP_MemYMMIndex ? 256 : 128);
+        }
+        else
+            PrintReg(os, reg, m_addrsize);
+        if (scale != 1)
+            os << '*' << scale;
+    }
+    if (!has_base && !has_index)
+        PrintHex(os, static_cast<uint64_t>(disp) & mask);
+    else if (disp != 0)
+    {
+        if (disp > 0)
+            os << '+';
+        PrintSignedHex(os, disp);
+    }
+    os << ']';
+}
+
+void
+X86Decoder::Print(raw_ostream& os, uint64_t addr) const
+{
+    const X86DisasmOperand* ops = &disasm_operands[m_info->operands_index];
+    unsigned int num_operands = m_info->num_operands;
+
+    if (m_lock)
+        os << "lock ";
+    if (m_rep != 0 && m_info->prefix != m_rep)
+        os << (m_rep == 0xF3 ? "rep " : "repne ");
+    os << m_info->name;
+
+    unsigned int imm_pos = m_imm_pos;
+    const char* sep = " ";
+    for (unsigned int i=0; i<num_operands; ++i)
+    {
+        const X86DisasmOperand& op = ops[i];
+        unsigned int size = op.size <= 1 ? m_opersize : op.size;
+
+        if (op.kind == DOP_AdSizeReg)
+        {
+            // Only needed if overriding the address size
+            if (!m_addrsize_prefix)
+                continue;
+        }
+        os << sep;
+        sep = ", ";
+
+        switch (op.kind)
+        {
+            case DOP_GPR:
+            case DOP_SIMD:
+            case DOP_Mem:
+            case DOP_MemXMMIndex:
+            case DOP_MemYMMIndex:
+                if (isReg(op))
+                    PrintReg(os, op, size);
+                else
+                    PrintEA(os, op, addr);
+                break;
+            case DOP_MemOffs:
+                PrintEA(os, op, addr);
+                imm_pos += m_addrsize/8;
+                break;
+            case DOP_Imm:
+            {
+                unsigned int isize = getImmSize(op);
+                PrintHex(os, getImm(imm_pos, isize));
+                imm_pos += isize/8;
+                break;
+            }
+            case DOP_SImm:
+            {
+                unsigned int isize = getImmSize(op);
+                PrintSignedHex(os, SignExtend(getImm(imm_pos, isize), isize));
+                imm_pos += isize/8;
+                break;
+            }
+            case DOP_Rel:
+            {
+                unsigned int isize = getImmSize(op);
+                uint64_t target = addr + m_len
+                    + SignExtend(getImm(imm_pos, isize), isize);
+                if (m_mode_bits != 64)
+                    target &= m_opersize == 16 ? 0xFFFF : 0xFFFFFFFF;
+                PrintHex(os, target);
+                imm_pos += isize/8;
+                break;
+            }
+            case DOP_Far:
+            {
+                unsigned int isize = getImmSize(op);
+                PrintHex(os, getImm(imm_pos+isize/8, 16));
+                os << ':';
+                PrintHex(os, getImm(imm_pos, isize));
+                imm_pos += isize/8 + 2;
+                break;
+            }
+            case DOP_One:
+                os << '1';
+                break;
+            case DOP_Imm4:
+            {
+                unsigned int pos = m_len - 1;
+                if (m_info->flags & DIS_SUFFIX)
+                    --pos;
+                PrintHex(os, m_bytes[pos] & 0x0F);
+                break;
+            }
+            default:
+                PrintReg(os, op, size);
+                break;
+        }
+    }
+}
+
+bool
+X86Arch::Disassemble(const unsigned char* bytes,
+                     std::size_t len,
+                     uint64_t addr,
+                     DisasmInsn* insn,
+                     raw_ostream* os) const
+{
+    X86Decoder decoder(bytes, len, getAddressSize());
+    if (!decoder.Decode())
+        return false;
+
+    const X86DisasmInfo& info = decoder.getInfo();
+    insn->length = decoder.getLength();
+    insn->mnemonic = info.name;
+    insn->features = info.features;
+    if (os)
+        decoder.Print(*os, addr);
+    return true;
+}
@@ -32,7 +32,9 @@
 #include "yasmx/Expr.h"
 #include "yasmx/Expr_util.h"
 #include "yasmx/IntNum.h"
+#include "yasmx/ParseRecord.h"
 
+#include "X86Arch.h"
 #include "X86Register.h"
 
 
@@ -188,6 +190,62 @@ X86EffAddr::clone() const
     return new X86EffAddr(*this);
 }
 
+bool
+X86EffAddr::Save(RecordWriter& out) const
+{
+    if (!out.WriteValue(m_disp))
+        return false;
+    const X86SegmentRegister* segreg =
+        static_cast<const X86SegmentRegister*>(m_segreg);
+    out.WriteUnsigned(segreg ? segreg->getNum()+1 : 0);
+    out.WriteUnsigned(m_need_nonzero_len | m_need_disp << 1 |
+                      m_nosplit << 2 | m_strong << 3 | m_pc_rel << 4 |
+                      m_not_pc_rel << 5 | m_decomposed << 6 |
+                      m_valid_modrm << 7 | m_need_modrm << 8 |
+                      m_valid_sib << 9);
+    if (!out.WriteRegister(m_base) || !out.WriteRegister(m_index))
+        return false;
+    out.WriteUnsigned(m_scale);
+    out.WriteIntNum(m_const_disp);
+    out.WriteUnsigned(m_modrm);
+    out.WriteUnsigned(m_sib);
+    out.WriteUnsigned(m_need_sib);
+    out.WriteUnsigned(m_vsib_mode);
+    return true;
+}
+
+std::auto_ptr<X86EffAddr>
+X86EffAddr::Load(RecordReader& in)
+{
+    std::auto_ptr<X86EffAddr> ea(new X86EffAddr());
+    in.ReadValue(ea->m_disp);
+    unsigned int segreg = static_cast<unsigned int>(
+        in.ReadUnsigned(X86SegmentRegister::TYPE_COUNT));
+    if (segreg != 0)
+        ea->m_segreg = X86RegTmod::Instance().getSegReg(
+            static_cast<X86SegmentRegister::Type>(segreg-1));
+    unsigned int flags = static_cast<unsigned int>(in.ReadUnsigned(0x3ff));
+    ea->m_need_nonzero_len = (flags & 1) != 0;
+    ea->m_need_disp = (flags & 1<<1) != 0;
+    ea->m_nosplit = (flags & 1<<2) != 0;
+    ea->m_strong = (flags & 1<<3) != 0;
+    ea->m_pc_rel = (flags & 1<<4) != 0;
+    ea->m_not_pc_rel = (flags & 1<<5) != 0;
+    ea->m_decomposed = (flags & 1<<6) != 0;
+    ea->m_valid_modrm = (flags & 1<<7) != 0;
+    ea->m_need_modrm = (flags & 1<<8) != 0;
+    ea->m_valid_sib = (flags & 1<<9) != 0;
+    ea->m_base = in.ReadRegister();
+    ea->m_index = in.ReadRegister();
+    ea->m_scale = static_cast<unsigned int>(in.ReadUnsigned(8));
+    ea->m_const_disp = in.ReadIntNum();
+    ea->m_modrm = static_cast<unsigned char>(in.ReadUnsigned(0xff));
+    ea->m_sib = static_cast<unsigned char>(in.ReadUnsigned(0xff));
+    ea->m_need_sib = static_cast<unsigned char>(in.ReadUnsigned(0xff));
+    ea->m_vsib_mode = static_cast<unsigned char>(in.ReadUnsigned(2));
+    return ea;
+}
+
 #ifdef WITH_XML
 pugi::xml_node
 X86EffAddr::DoWrite(pugi::xml_node out) const
@@ -230,6 +288,10 @@ public:
     }
 
     int GetRegUsage(Expr& e, /*@null@*/ int* indexreg, bool* ip_rel);
+    bool SetRegUsage(const X86Register* base,
+                     const X86Register* index,
+                     unsigned int scale,
+                     int* indexreg);
 
     enum RegIndex
     {
@@ -250,6 +312,7 @@ private:
                          int* indexval,
                          bool* indexmult);
     bool getReg(ExprTerm& term, int* regnum);
+    bool getRegNum(const X86Register* reg, int* regnum);
 
 private:
     unsigned int m_bits;
@@ -281,6 +344,17 @@ X86EAChecker::getReg(ExprTerm& term, int* regnum)
     const X86Register* reg =
         static_cast<const X86Register*>(term.getRegister());
     assert(reg != 0);
+    if (!getRegNum(reg, regnum))
+        return false;
+
+    // overwrite with 0 to eliminate register from displacement expr
+    term.Zero();
+    return true;
+}
+
+bool
+X86EAChecker::getRegNum(const X86Register* reg, int* regnum)
+{
     unsigned int myregnum = reg->getNum();
 
     switch (reg->getType())
@@ -327,9 +401,6 @@ X86EAChecker::getReg(ExprTerm& term, int* regnum)
             return false;
     }
 
-    // overwrite with 0 to eliminate register from displacement expr
-    term.Zero();
-
     // we're okay
     assert(myregnum < static_cast<unsigned int>(m_regcount)
            && "register number too large");
@@ -625,6 +696,29 @@ X86EAChecker::GetRegUsage(Expr& e, /*@null@*/ int* indexreg, bool* ip_rel)
     return 0;
 }
 
+// Same register usage as GetRegUsage() would find for base+index*scale,
+// from registers the parser already separated out.  RIP and invalid
+// registers are left to GetRegUsage() to diagnose.
+bool
+X86EAChecker::SetRegUsage(const X86Register* base,
+                          const X86Register* index,
+                          unsigned int scale,
+                          int* indexreg)
+{
+    int basenum = kREG_NONE, indexnum = kREG_NONE;
+    if (base && (!getRegNum(base, &basenum) || basenum == kREG_RIP))
+        return false;
+    if (index && (!getRegNum(index, &indexnum) || indexnum == kREG_RIP))
+        return false;
+
+    if (base)
+        ++m_regmult[basenum];
+    if (index)
+        m_regmult[indexnum] += scale;
+    *indexreg = index ? indexnum : basenum;
+    return true;
+}
+
 /*@-nullstate@*/
 bool
 X86EffAddr::CalcDispLen(unsigned int wordsize,
@@ -811,7 +905,16 @@ X86EffAddr::Check3264(unsigned int addrsize,
 
     X86EAChecker checker(bits, addrsize, m_vsib_mode, diags);
 
-    if (m_disp.hasAbs())
+    if (m_decomposed && m_vsib_mode == 0 &&
+        checker.SetRegUsage(static_cast<const X86Register*>(m_base),
+                            static_cast<const X86Register*>(m_index),
+                            m_scale, &indexreg))
+    {
+        // The parser already split out the registers; what's left is the
+        // constant displacement.
+        *m_disp.getAbs() = Expr(m_const_disp, m_disp.getSource().getBegin());
+    }
+    else if (m_disp.hasAbs())
     {
         switch (checker.GetRegUsage(*m_disp.getAbs(), &indexreg, ip_rel))
         {
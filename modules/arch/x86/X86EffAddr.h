@@ -35,6 +35,8 @@ namespace yasm
 {
 
 class DiagnosticsEngine;
+class RecordReader;
+class RecordWriter;
 
 namespace arch
 {
@@ -116,6 +118,13 @@ public:
 
     X86EffAddr* clone() const;
 
+    /// Write to a parse record.
+    /// @return False if the effective address can't be recorded.
+    bool Save(RecordWriter& out) const;
+
+    /// Read from a parse record written by Save().
+    static std::auto_ptr<X86EffAddr> Load(RecordReader& in);
+
 #ifdef WITH_XML
     pugi::xml_node DoWrite(pugi::xml_node out) const;
 #endif // WITH_XML
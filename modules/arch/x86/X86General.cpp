@@ -28,6 +28,8 @@
 
 #include "X86General.h"
 
+#include <cstring>
+
 #include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/Twine.h"
 #include "yasmx/Basic/Diagnostic.h"
@@ -38,6 +40,7 @@
 #include "yasmx/Expr.h"
 #include "yasmx/IntNum.h"
 #include "yasmx/Object.h"
+#include "yasmx/ParseRecord.h"
 #include "yasmx/Section.h"
 #include "yasmx/Symbol.h"
 
@@ -48,6 +51,8 @@
 
 STATISTIC(num_generic, "Number of generic instructions appended");
 STATISTIC(num_generic_bc, "Number of generic bytecodes created");
+STATISTIC(num_generic_ea_fixed, "Number of EA instructions output as fixed");
+STATISTIC(num_postop_resolved, "Number of post-ops resolved at append time");
 
 using namespace yasm;
 using namespace yasm::arch;
@@ -67,7 +72,8 @@ X86General::X86General(const X86Common& common,
       m_special_prefix(special_prefix),
       m_rex(rex),
       m_default_rel(default_rel),
-      m_postop(postop)
+      m_postop(postop),
+      m_template_len(0)
 {
 }
 
@@ -79,8 +85,10 @@ X86General::X86General(const X86General& rhs)
       m_imm(0),
       m_special_prefix(rhs.m_special_prefix),
       m_rex(rhs.m_rex),
-      m_postop(rhs.m_postop)
+      m_postop(rhs.m_postop),
+      m_template_len(rhs.m_template_len)
 {
+    std::memcpy(m_template, rhs.m_template, sizeof(m_template));
     if (rhs.m_ea != 0)
         m_ea.reset(rhs.m_ea->clone());
     if (rhs.m_imm != 0)
@@ -201,7 +209,7 @@ VexOptimize(X86Opcode& opcode,
 
 bool
 X86General::CalcLen(Bytecode& bc,
-                    /*@out@*/ unsigned long* len,
+                    /*@out@*/ uint64_t* len,
                     const Bytecode::AddSpanFunc& add_span,
                     DiagnosticsEngine& diags)
 {
@@ -251,9 +259,9 @@ X86General::CalcLen(Bytecode& bc,
         if (m_postop == X86_POSTOP_ADDRESS16)
             m_common.m_addrsize = 0;
 
-        // Compute length of ea and add to total
+        // Compute length of ea and add to total (any segment override is
+        // counted as part of the template)
         ilen += m_ea->m_need_modrm + (m_ea->m_need_sib ? 1:0);
-        ilen += (m_ea->m_segreg != 0) ? 1 : 0;
     }
 
     if (m_imm != 0)
@@ -323,14 +331,11 @@ X86General::CalcLen(Bytecode& bc,
     // so we need to see if we can optimize to the two byte form.
     // We can't do it earlier, as we don't know all of the REX byte until now.
     VexOptimize(m_opcode, m_special_prefix, m_rex);
-    if (m_rex != 0xff && m_rex != 0 &&
-        m_special_prefix != 0xC5 && m_special_prefix != 0xC4 &&
-        m_special_prefix != 0x8F)
-        ilen++;
 
-    ilen += m_opcode.getLen();
-    ilen += m_common.getLen();
-    ilen += (m_special_prefix != 0) ? 1:0;
+    // The prefixes, REX, and opcode are now fixed (other than the word-sized
+    // opcode switch in Expand()), so encode them once.
+    BuildTemplate();
+    ilen += m_template_len;
 
     *len = ilen;
     return true;
@@ -338,13 +343,13 @@ X86General::CalcLen(Bytecode& bc,
 
 bool
 X86General::Expand(Bytecode& bc,
-                   unsigned long* len,
+                   uint64_t* len,
                    int span,
-                   long old_val,
-                   long new_val,
+                   int64_t old_val,
+                   int64_t new_val,
                    bool* keep,
-                   /*@out@*/ long* neg_thres,
-                   /*@out@*/ long* pos_thres,
+                   /*@out@*/ int64_t* neg_thres,
+                   /*@out@*/ int64_t* pos_thres,
                    DiagnosticsEngine& diags)
 {
     if (m_ea != 0 && span == 1)
@@ -372,6 +377,7 @@ X86General::Expand(Bytecode& bc,
             // Change to the word-sized opcode
             m_opcode.MakeAlt1();
             m_postop = X86_POSTOP_NONE;
+            BuildTemplate();
         }
     }
 
@@ -379,21 +385,34 @@ X86General::Expand(Bytecode& bc,
     return true;
 }
 
-static void
-GeneralToBytes(Bytes& bytes,
-               const X86Common& common,
-               X86Opcode opcode,
-               const X86EffAddr* ea,
-               unsigned char special_prefix,
-               unsigned char rex)
+bool
+X86General::getMaxGrowth(const Bytecode& bc, uint64_t* growth) const
+{
+    // Byte displacement to word-sized
+    *growth = 0;
+    if (m_ea != 0 && m_ea->m_disp.getSize() == 8)
+        *growth += ((m_common.m_addrsize == 16) ? 2 : 4) - 1;
+
+    // Sign-extended imm8 to full-sized immediate
+    if (m_imm != 0 && m_postop == X86_POSTOP_SIGNEXT_IMM8)
+        *growth += m_imm->getSize()/8;
+    return true;
+}
+
+unsigned int
+arch::EncodeGeneral(unsigned char* out,
+                    const X86Common& common,
+                    X86Opcode opcode,
+                    const X86SegmentRegister* segreg,
+                    unsigned char special_prefix,
+                    unsigned char rex)
 {
     VexOptimize(opcode, special_prefix, rex);
 
     // Prefixes
-    common.ToBytes(bytes,
-        ea != 0 ? static_cast<const X86SegmentRegister*>(ea->m_segreg) : 0);
+    unsigned int len = common.Encode(out, segreg);
     if (special_prefix != 0)
-        Write8(bytes, special_prefix);
+        out[len++] = special_prefix;
     if (special_prefix == 0xC4 || special_prefix == 0x8F)
     {
         // 3-byte VEX/XOP; merge in 1s complement of REX.R, REX.X, REX.B
@@ -419,11 +438,35 @@ GeneralToBytes(Bytes& bytes,
     {
         assert(common.m_mode_bits == 64 &&
                "x86: got a REX prefix in non-64-bit mode");
-        Write8(bytes, rex);
+        out[len++] = rex;
     }
 
     // Opcode
-    opcode.ToBytes(bytes);
+    return len + opcode.Encode(out+len);
+}
+
+void
+arch::GeneralToBytes(Bytes& bytes,
+                     const X86Common& common,
+                     X86Opcode opcode,
+                     const X86EffAddr* ea,
+                     unsigned char special_prefix,
+                     unsigned char rex)
+{
+    unsigned char buf[X86_MAX_PREFIX_OPCODE];
+    unsigned int len = EncodeGeneral(buf, common, opcode,
+        ea != 0 ? static_cast<const X86SegmentRegister*>(ea->m_segreg) : 0,
+        special_prefix, rex);
+    bytes.Write(llvm::makeArrayRef(buf, len));
+}
+
+void
+X86General::BuildTemplate()
+{
+    m_template_len = EncodeGeneral(m_template, m_common, m_opcode,
+        m_ea != 0 ? static_cast<const X86SegmentRegister*>(m_ea->m_segreg)
+                  : 0,
+        m_special_prefix, m_rex);
 }
 
 bool
@@ -432,8 +475,9 @@ X86General::Output(Bytecode& bc, BytecodeOutput& bc_out)
     Bytes& bytes = bc_out.getScratch();
     bytes.setLittleEndian();
 
-    GeneralToBytes(bytes, m_common, m_opcode, m_ea.get(), m_special_prefix,
-                   m_rex);
+    if (m_template_len == 0)
+        BuildTemplate();
+    bytes.Write(llvm::makeArrayRef(m_template, m_template_len));
 
     // Effective address: ModR/M (if required), SIB (if required)
     if (m_ea != 0)
@@ -520,6 +564,53 @@ X86General::clone() const
     return new X86General(*this);
 }
 
+bool
+X86General::Save(RecordWriter& out) const
+{
+    // The template is only built once the bytecode is finalized.
+    if (m_template_len != 0)
+        return false;
+    m_common.Save(out);
+    m_opcode.Save(out);
+    out.WriteUnsigned(m_ea != 0);
+    if (m_ea != 0 && !m_ea->Save(out))
+        return false;
+    out.WriteUnsigned(m_imm != 0);
+    if (m_imm != 0 && !out.WriteValue(*m_imm))
+        return false;
+    out.WriteUnsigned(m_special_prefix);
+    out.WriteUnsigned(m_rex);
+    out.WriteUnsigned(m_default_rel);
+    out.WriteUnsigned(m_postop);
+    return true;
+}
+
+Bytecode::Contents::Ptr
+X86General::Load(RecordReader& in)
+{
+    X86Common common;
+    common.Load(in);
+    X86Opcode opcode;
+    opcode.Load(in);
+    std::auto_ptr<X86EffAddr> ea;
+    if (in.ReadUnsigned(1) != 0)
+        ea = X86EffAddr::Load(in);
+    std::auto_ptr<Value> imm;
+    if (in.ReadUnsigned(1) != 0)
+    {
+        imm.reset(new Value(0));
+        in.ReadValue(*imm);
+    }
+    unsigned char special_prefix =
+        static_cast<unsigned char>(in.ReadUnsigned(0xff));
+    unsigned char rex = static_cast<unsigned char>(in.ReadUnsigned(0xff));
+    bool default_rel = in.ReadUnsigned(1) != 0;
+    X86GeneralPostOp postop = static_cast<X86GeneralPostOp>(
+        in.ReadUnsigned(X86_POSTOP_SIMM32_AVAIL));
+    return Bytecode::Contents::Ptr(new X86General(
+        common, opcode, ea, imm, special_prefix, rex, postop, default_rel));
+}
+
 #ifdef WITH_XML
 pugi::xml_node
 X86General::Write(pugi::xml_node out) const
@@ -555,6 +646,66 @@ X86General::Write(pugi::xml_node out) const
 }
 #endif // WITH_XML
 
+// Try to fully resolve an effective address made up of only registers and
+// integer constants, so the instruction can go directly into the fixed
+// portion of the bytecode.  The check runs on a copy with diagnostics
+// suppressed; if anything goes wrong, null is returned and the caller falls
+// back to a full X86General bytecode, which reports any diagnostics at the
+// usual point.  On success, common and rex are updated for the resolved EA.
+static std::auto_ptr<X86EffAddr>
+ResolveSimpleEA(const X86EffAddr& ea,
+                X86Common& common,
+                unsigned char* rex,
+                DiagnosticsEngine& diags)
+{
+    std::auto_ptr<X86EffAddr> none;
+    const Value& disp = ea.m_disp;
+
+    // Already complete (e.g. a register built by a post-op).
+    if (ea.m_need_modrm && ea.m_valid_modrm && !ea.m_need_sib &&
+        !ea.m_need_disp && ea.m_segreg == 0)
+        return std::auto_ptr<X86EffAddr>(ea.clone());
+
+    // No MemOffs, explicit displacement sizes, or anything needing symbol
+    // or location resolution.
+    if (!ea.m_need_modrm || disp.getSize() != 0 || disp.isRelative() ||
+        disp.isIPRelative() || !disp.hasAbs() ||
+        disp.getAbs()->Contains(ExprTerm::SUBST|ExprTerm::FLOAT|
+                                ExprTerm::SYM|ExprTerm::LOC))
+        return none;
+
+    std::auto_ptr<X86EffAddr> resolved(ea.clone());
+    unsigned char addrsize = common.m_addrsize;
+    unsigned char new_rex = *rex;
+    bool ip_rel = false;
+
+    bool suppress = diags.getSuppressAllDiagnostics();
+    diags.setSuppressAllDiagnostics(true);
+    bool ok = resolved->Finalize(diags) &&
+        resolved->Check(&addrsize, common.m_mode_bits, false, &new_rex,
+                        &ip_rel, diags);
+    diags.setSuppressAllDiagnostics(suppress);
+
+    if (!ok || ip_rel || !resolved->m_valid_modrm ||
+        (resolved->m_need_sib && !resolved->m_valid_sib))
+        return none;
+
+    // The displacement must now be a sized plain integer that fits (so
+    // there is no overflow warning to generate at output).
+    Value& rdisp = resolved->m_disp;
+    if (resolved->m_need_disp &&
+        (rdisp.getSize() == 0 || rdisp.isRelative() ||
+         (rdisp.hasAbs() &&
+          (!rdisp.getAbs()->isIntNum() ||
+           !rdisp.getAbs()->getIntNum().isOkSize(rdisp.getSize(), 0,
+                                                 rdisp.isSigned() ? 1 : 2)))))
+        return none;
+
+    common.m_addrsize = addrsize;
+    *rex = new_rex;
+    return resolved;
+}
+
 void
 arch::AppendGeneral(BytecodeContainer& container,
                     const X86Common& common,
@@ -565,17 +716,74 @@ arch::AppendGeneral(BytecodeContainer& container,
                     unsigned char rex,
                     X86GeneralPostOp postop,
                     bool default_rel,
-                    SourceLocation source)
+                    SourceLocation source,
+                    DiagnosticsEngine& diags)
 {
     Bytecode& bc = container.FreshBytecode();
     ++num_generic;
 
+    // Resolve post-ops that depend only on a constant immediate now, in the
+    // same way as Finalize() and CalcLen() would.
+    X86Opcode ropcode = opcode;
+    if (imm.get() != 0 && imm->hasAbs() && !imm->isRelative() &&
+        imm->getAbs()->isIntNum())
+    {
+        if (postop == X86_POSTOP_SIGNEXT_IMM8)
+        {
+            unsigned int immlen = imm->getSize();
+            IntNum num = imm->getAbs()->getIntNum();
+
+            // Leave truncation warnings for CalcLen().
+            if (num.isOkSize(immlen, 0, 2))
+            {
+                num.SignExtend(immlen);
+                if (num.isInRange(-128, 127))
+                {
+                    imm->setSize(8);
+                    imm->setSigned();
+                    *imm->getAbs() = num;
+                }
+                else
+                    ropcode.MakeAlt1();
+                postop = X86_POSTOP_NONE;
+                ++num_postop_resolved;
+            }
+        }
+        else if (postop == X86_POSTOP_SIMM32_AVAIL && ea.get() == 0)
+        {
+            if (imm->getAbs()->getIntNum().isOkSize(32, 0, 1))
+            {
+                // Build ModRM EA - CAUTION: this depends on
+                // opcode 0 being a mov instruction!
+                unsigned char rex_temp = 0;
+                std::auto_ptr<X86EffAddr> regea(new X86EffAddr());
+                if (regea->setReg(X86RegTmod::Instance().
+                                  getReg(X86Register::REG64,
+                                         ropcode.get(0)-0xB8),
+                                  &rex_temp, 64))
+                {
+                    ea = regea;
+                    ropcode.MakeAlt1();
+                    imm->setSize(32);
+                    imm->setSigned();
+                    postop = X86_POSTOP_NONE;
+                    ++num_postop_resolved;
+                }
+            }
+            else
+            {
+                postop = X86_POSTOP_NONE;
+                ++num_postop_resolved;
+            }
+        }
+    }
+
     // if no postop and no effective address, output the fixed contents
     if (postop == X86_POSTOP_NONE && ea.get() == 0)
     {
         Bytes& bytes = bc.getFixed();
         unsigned long orig_size = bytes.size();
-        GeneralToBytes(bytes, common, opcode, ea.get(), special_prefix, rex);
+        GeneralToBytes(bytes, common, ropcode, ea.get(), special_prefix, rex);
         if (imm.get() != 0)
         {
             imm->setInsnStart(bytes.size()-orig_size);
@@ -584,9 +792,47 @@ arch::AppendGeneral(BytecodeContainer& container,
         return;
     }
 
-    // TODO: optimize EA case
+    // The short mov form is only possible for an EA without registers.
+    if (postop == X86_POSTOP_SHORT_MOV && ea.get() != 0 &&
+        ea->m_disp.hasAbs() && ea->m_disp.getAbs()->Contains(ExprTerm::REG))
+        postop = X86_POSTOP_NONE;
+
+    // likewise if the effective address can be completely resolved now
+    if (postop == X86_POSTOP_NONE && ea.get() != 0)
+    {
+        X86Common rcommon = common;
+        unsigned char rrex = rex;
+        std::auto_ptr<X86EffAddr> rea =
+            ResolveSimpleEA(*ea, rcommon, &rrex, diags);
+        if (rea.get() != 0)
+        {
+            Bytes& bytes = bc.getFixed();
+            unsigned long orig_size = bytes.size();
+            GeneralToBytes(bytes, rcommon, ropcode, rea.get(), special_prefix,
+                           rrex);
+            Write8(bytes, rea->m_modrm);
+            if (rea->m_need_sib)
+                Write8(bytes, rea->m_sib);
+            if (rea->m_need_disp)
+            {
+                const Value& disp = rea->m_disp;
+                if (disp.hasAbs())
+                    WriteN(bytes, disp.getAbs()->getIntNum(), disp.getSize());
+                else
+                    bytes.Write(disp.getSize()/8, 0);
+            }
+            if (imm.get() != 0)
+            {
+                imm->setInsnStart(bytes.size()-orig_size);
+                bc.AppendFixed(imm);
+            }
+            ++num_generic_ea_fixed;
+            return;
+        }
+    }
+
     bc.Transform(Bytecode::Contents::Ptr(new X86General(
-        common, opcode, ea, imm, special_prefix, rex, postop, default_rel)));
+        common, ropcode, ea, imm, special_prefix, rex, postop, default_rel)));
     bc.setSource(source);
     ++num_generic_bc;
 }
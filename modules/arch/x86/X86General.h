@@ -38,7 +38,10 @@
 namespace yasm
 {
 
+class Bytes;
 class BytecodeContainer;
+class RecordReader;
+class RecordWriter;
 class SourceLocation;
 class Value;
 
@@ -48,6 +51,12 @@ namespace arch
 class X86Common;
 class X86EffAddr;
 class X86Opcode;
+class X86SegmentRegister;
+
+/// Buffer size for the prefix, REX/VEX, and opcode bytes of an instruction:
+/// up to 5 prefixes, a special prefix, a REX byte (or the VEX/XOP bytes
+/// held in the opcode), and 3 opcode bytes.
+enum { X86_MAX_PREFIX_OPCODE = 10 };
 
 // Postponed (from parsing to later binding) action options.
 enum X86GeneralPostOp
@@ -89,24 +98,30 @@ public:
 
     bool Finalize(Bytecode& bc, DiagnosticsEngine& diags);
     bool CalcLen(Bytecode& bc,
-                 /*@out@*/ unsigned long* len,
+                 /*@out@*/ uint64_t* len,
                  const Bytecode::AddSpanFunc& add_span,
                  DiagnosticsEngine& diags);
     bool Expand(Bytecode& bc,
-                unsigned long* len,
+                uint64_t* len,
                 int span,
-                long old_val,
-                long new_val,
+                int64_t old_val,
+                int64_t new_val,
                 bool* keep,
-                /*@out@*/ long* neg_thres,
-                /*@out@*/ long* pos_thres,
+                /*@out@*/ int64_t* neg_thres,
+                /*@out@*/ int64_t* pos_thres,
                 DiagnosticsEngine& diags);
+    bool getMaxGrowth(const Bytecode& bc, uint64_t* growth) const;
     bool Output(Bytecode& bc, BytecodeOutput& bc_out);
 
     StringRef getType() const;
 
     X86General* clone() const;
 
+    bool Save(RecordWriter& out) const;
+
+    /// Read from a parse record written by Save().
+    static Bytecode::Contents::Ptr Load(RecordReader& in);
+
 #ifdef WITH_XML
     pugi::xml_node Write(pugi::xml_node out) const;
 #endif // WITH_XML
@@ -116,6 +131,9 @@ public:
 private:
     X86General(const X86General& rhs);
 
+    /// Build m_template from the current prefixes, REX, and opcode.
+    void BuildTemplate();
+
     X86Common m_common;
     X86Opcode m_opcode;
 
@@ -132,8 +150,36 @@ private:
     unsigned char m_default_rel;
 
     X86GeneralPostOp m_postop;
+
+    // Encoded prefix, REX/VEX, and opcode bytes, built once the REX byte
+    // is known (in CalcLen) and rebuilt whenever the opcode changes.
+    // Output copies these in one step; 0 length means not yet built.
+    unsigned char m_template_len;
+    unsigned char m_template[X86_MAX_PREFIX_OPCODE];
 };
 
+/// Encode the prefixes, REX/VEX, and opcode bytes of a general instruction
+/// into a raw buffer of at least X86_MAX_PREFIX_OPCODE bytes.
+/// @return Number of bytes written.
+YASM_STD_EXPORT
+unsigned int EncodeGeneral(unsigned char* out,
+                           const X86Common& common,
+                           X86Opcode opcode,
+                           const X86SegmentRegister* segreg,
+                           unsigned char special_prefix,
+                           unsigned char rex);
+
+/// Write the prefixes, REX/VEX, and opcode bytes of a general instruction.
+/// The effective address is used only for its segment override; the
+/// caller writes any ModRM, SIB, displacement, and immediate that follow.
+YASM_STD_EXPORT
+void GeneralToBytes(Bytes& bytes,
+                    const X86Common& common,
+                    X86Opcode opcode,
+                    const X86EffAddr* ea,
+                    unsigned char special_prefix,
+                    unsigned char rex);
+
 YASM_STD_EXPORT
 void AppendGeneral(BytecodeContainer& container,
                    const X86Common& common,
@@ -144,7 +190,8 @@ void AppendGeneral(BytecodeContainer& container,
                    unsigned char rex,
                    X86GeneralPostOp postop,
                    bool default_rel,
-                   SourceLocation source);
+                   SourceLocation source,
+                   DiagnosticsEngine& diags);
 
 }} // namespace yasm::arch
 
@@ -39,13 +39,19 @@
 #include "yasmx/Basic/Diagnostic.h"
 #include "yasmx/Config/functional.h"
 #include "yasmx/Support/phash.h"
+#include "yasmx/BytecodeContainer.h"
 #include "yasmx/Bytes.h"
+#include "yasmx/Bytes_util.h"
 #include "yasmx/EffAddr.h"
 #include "yasmx/Expr.h"
 #include "yasmx/IntNum.h"
+#include "yasmx/Object.h"
+#include "yasmx/Section.h"
 
 #include "X86Arch.h"
+#include "X86BranchPad.h"
 #include "X86Common.h"
+#include "X86Cost.h"
 #include "X86EffAddr.h"
 #include "X86General.h"
 #include "X86Jmp.h"
@@ -56,17 +62,24 @@
 
 #ifndef NELEMS
 #define NELEMS(array)   (sizeof(array) / sizeof(array[0]))
+
+// Mask of up to three X86Arch::CpuFeature values; unused slots are CPU_Any.
+#define CPU_BITS(cpu0, cpu1, cpu2) \
+    ((UINT64_C(1) << (cpu0)) | (UINT64_C(1) << (cpu1)) | \
+     (UINT64_C(1) << (cpu2)))
 #endif
 
 STATISTIC(num_groups_scanned, "Total number of instruction groups scanned");
 STATISTIC(num_jmp_groups_scanned, "Total number of jump groups scanned");
 STATISTIC(num_empty_insn, "Number of empty instructions created");
+STATISTIC(num_match_cache_hits, "Number of instruction match cache hits");
+STATISTIC(num_simple, "Number of instructions encoded by the simple path");
+STATISTIC(num_shortened, "Number of instructions with shorter operands");
 
 using namespace yasm;
 using namespace yasm::arch;
 
-static std::string CpuFindReverse(unsigned int cpu0, unsigned int cpu1,
-                                  unsigned int cpu2);
+static std::string CpuFindReverse(uint64_t cpu_bits);
 
 namespace {
 // Opcode modifiers.
@@ -321,13 +334,10 @@ struct X86InsnInfo
     // Tests against BITS==64, AVX, and XOP
     unsigned int misc_flags:5;
 
-    // The CPU feature flags needed to execute this instruction.  This is OR'ed
-    // with arch-specific data[2].  This combined value is compared with
-    // cpu_enabled to see if all bits set here are set in cpu_enabled--if so,
-    // the instruction is available on this CPU.
-    unsigned int cpu0:6;
-    unsigned int cpu1:6;
-    unsigned int cpu2:6;
+    // The CPU feature flags needed to execute this instruction, as a CPU_BITS
+    // mask.  If all bits set here are set in the active CPU mask, the
+    // instruction is available on this CPU.
+    uint64_t cpu;
 
     // Opcode modifiers for variations of instruction.  As each modifier reads
     // its parameter in LSB->MSB order from the arch-specific data[1] from the
@@ -375,6 +385,18 @@ struct X86InsnInfo
     // The index into the insn_operands array which contains the type of each
     // operand, see above
     unsigned int operands_index:12;
+
+    // The Operand::Type classes each operand accepts, 4 bits per operand
+    // (1<<(type-1)), for a quick check before matching operands in detail.
+    unsigned int operand_classes:20;
+};
+
+// Prefix type and value.  Kept as plain data so the prefix tables need no
+// startup construction; the X86Prefix objects are created on first use.
+struct X86PrefixInfo
+{
+    X86Prefix::Type type;
+    unsigned char value;
 };
 }} // namespace yasm::arch
 
@@ -418,6 +440,31 @@ X86Prefix::Write(pugi::xml_node out) const
 
 #include "X86Insns.cpp"
 
+namespace {
+// Lazily constructed prefixes, indexed the same as x86_prefix_info.
+class X86PrefixCache
+{
+public:
+    X86PrefixCache() { std::memset(m_prefixes, 0, sizeof(m_prefixes)); }
+    ~X86PrefixCache()
+    {
+        for (unsigned int i=0; i<NELEMS(m_prefixes); ++i)
+            delete m_prefixes[i];
+    }
+
+    const X86Prefix* get(const X86PrefixInfo* info)
+    {
+        const X86Prefix*& prefix = m_prefixes[info - x86_prefix_info];
+        if (!prefix)
+            prefix = new X86Prefix(info->type, info->value);
+        return prefix;
+    }
+
+private:
+    const X86Prefix* m_prefixes[NELEMS(x86_prefix_info)];
+};
+} // anonymous namespace
+
 bool
 X86Insn::DoAppendJmpFar(BytecodeContainer& container,
                         const X86InsnInfo& info,
@@ -497,9 +544,7 @@ X86Insn::MatchJmpInfo(const X86InsnInfo& info, unsigned int opersize,
     if (m_mode_bits == 64 && (info.misc_flags & NOT_64))
         return false;
 
-    if (!m_active_cpu[info.cpu0] ||
-        !m_active_cpu[info.cpu1] ||
-        !m_active_cpu[info.cpu2])
+    if ((info.cpu & m_active_cpu) != info.cpu)
         return false;
 
     if (info.num_operands == 0)
@@ -616,8 +661,18 @@ X86Insn::DoAppendJmp(BytecodeContainer& container,
     common.ApplyPrefixes(jinfo.def_opersize_64, m_prefixes, diags);
     common.Finish();
 
+    unsigned long branch_align = getBranchAlign(container);
+    if (branch_align != 0)
+    {
+        // Only conditional jumps are fused.
+        bool jcc = !shortop.isEmpty() && (shortop.get(0) & 0xF0) == 0x70;
+        StartPaddedBranch(container, jcc, branch_align, m_arch.getFill(),
+                          source);
+    }
     AppendJmp(container, common, shortop, nearop, imm, imm_source, source,
               op_sel);
+    if (branch_align != 0)
+        EndPaddedBranch(container);
     return true;
 }
 
@@ -937,23 +992,15 @@ X86Insn::MatchOperand(const Operand& op, const X86InfoOperand& info_op,
 
 bool
 X86Insn::MatchInfo(const X86InsnInfo& info, const unsigned int* size_lookup,
-                   int bypass) const
+                   int bypass, unsigned int classes,
+                   unsigned int rev_classes) const
 {
     ++num_groups_scanned;
 
-    // Match CPU
-    if (m_mode_bits != 64 && (info.misc_flags & ONLY_64))
-        return false;
-    if (m_mode_bits == 64 && (info.misc_flags & NOT_64))
-        return false;
-
-    if (bypass != 8 && (!m_active_cpu[info.cpu0] ||
-                        !m_active_cpu[info.cpu1] ||
-                        !m_active_cpu[info.cpu2]))
-        return false;
+    // BITS and # of operands are already matched by the group index.
 
-    // Match # of operands
-    if (m_operands.size() != info.num_operands)
+    // Match CPU
+    if (bypass != 8 && (info.cpu & m_active_cpu) != info.cpu)
         return false;
 
     // Match AVX
@@ -977,8 +1024,16 @@ X86Insn::MatchInfo(const X86InsnInfo& info, const unsigned int* size_lookup,
     if (m_operands.size() == 0)
         return true;    // no operands -> must have a match here.
 
-    // Match each operand type and size
     // Use reversed operands in GAS mode if not otherwise specified
+    bool reverse = m_parser == X86Arch::PARSER_GAS && !(gas_flags & GAS_NO_REV);
+
+    // Quick check of operand types
+    if (reverse)
+        classes = rev_classes;
+    if ((info.operand_classes & classes) != classes)
+        return false;
+
+    // Match each operand type and size
 #if 0
     if (m_parser == X86Arch::PARSER_GAS && !(gas_flags & GAS_NO_REV))
         return std::equal(m_operands.rbegin(), m_operands.rend(),
@@ -994,7 +1049,7 @@ X86Insn::MatchInfo(const X86InsnInfo& info, const unsigned int* size_lookup,
                                     size_lookup, bypass));
 #else
     const X86InfoOperand* first2 = &insn_operands[info.operands_index];
-    if (m_parser == X86Arch::PARSER_GAS && !(gas_flags & GAS_NO_REV))
+    if (reverse)
     {
         const Operand& first = m_operands.back();
         Operands::const_reverse_iterator
@@ -1028,14 +1083,150 @@ X86Insn::MatchInfo(const X86InsnInfo& info, const unsigned int* size_lookup,
 const X86InsnInfo*
 X86Insn::FindMatch(const unsigned int* size_lookup, int bypass) const
 {
-    // Just do a simple linear search through the info array for a match.
-    // First match wins.
-    const X86InsnInfo* info =
-        std::find_if(&m_group[0], &m_group[m_num_info],
-                     TR1::bind(&X86Insn::MatchInfo, this, _1, size_lookup,
-                               bypass));
-    if (info == &m_group[m_num_info])
+    // Operand type classes, in both forward and reverse operand order,
+    // in the same format as X86InsnInfo::operand_classes.
+    unsigned int classes = 0, rev_classes = 0;
+    unsigned int num_operands = m_operands.size();
+    for (unsigned int i=0; i<num_operands; ++i)
+    {
+        unsigned int type = m_operands[i].getType();
+        if (type == Operand::NONE)
+            continue;
+        classes |= 1U << (4*i + type-1);
+        rev_classes |= 1U << (4*(num_operands-1-i) + type-1);
+    }
+
+    // Search the group index for the forms valid in this BITS mode with
+    // the right number of operands.  First match wins.
+    const unsigned char* bucket =
+        &m_index[(m_mode_bits == 64 ? 7 : 0) + num_operands];
+    for (const unsigned char* i = &m_index[bucket[0]],
+         *end = &m_index[bucket[1]]; i != end; ++i)
+    {
+        const X86InsnInfo& info = m_group[*i];
+        if (MatchInfo(info, size_lookup, bypass, classes, rev_classes))
+            return &info;
+    }
+    return 0;
+}
+
+X86MatchCache::X86MatchCache()
+{
+    std::memset(m_entries, 0, sizeof(m_entries));
+}
+
+X86MatchCache::~X86MatchCache()
+{
+}
+
+unsigned int
+X86MatchCache::Hash(const Key& key)
+{
+    uintptr_t h = 0;
+    for (unsigned int i=0; i<KEY_WORDS; ++i)
+        h = h*31 + (key[i] ^ (key[i] >> 8));
+    return static_cast<unsigned int>(h ^ (h >> 16)) % NUM_ENTRIES;
+}
+
+const X86InsnInfo*
+X86MatchCache::Find(const Key& key) const
+{
+    const Entry& entry = m_entries[Hash(key)];
+    if (entry.info == 0 || std::memcmp(entry.key, key, sizeof(Key)) != 0)
         return 0;
+    return entry.info;
+}
+
+void
+X86MatchCache::Insert(const Key& key, const X86InsnInfo* info)
+{
+    Entry& entry = m_entries[Hash(key)];
+    std::memcpy(entry.key, key, sizeof(Key));
+    entry.info = info;
+}
+
+void
+X86Insn::getMatchKey(X86MatchCache::Key& key) const
+{
+    // Memory operand flags
+    enum
+    {
+        KEY_PC_REL = 1<<0,
+        KEY_NOT_PC_REL = 1<<1,
+        KEY_DISP_REG = 1<<2,
+        KEY_DISP_XMM = 1<<3,
+        KEY_DISP_YMM = 1<<4,
+        KEY_IMM_1 = 1<<5,
+        KEY_IMM_SEG = 1<<6
+    };
+
+    std::memset(key, 0, sizeof(X86MatchCache::Key));
+    key[0] = reinterpret_cast<uintptr_t>(m_group);
+    key[1] = m_suffix | (m_misc_flags << 9) | (m_default_rel << 14) |
+             (m_operands.size() << 15);
+    key[2] = m_lookup_gen;
+
+    // Everything MatchOperand() looks at.
+    uintptr_t* opkey = &key[X86MatchCache::KEY_HEADER];
+    for (Operands::const_iterator op = m_operands.begin(),
+         end = m_operands.end(); op != end;
+         ++op, opkey += X86MatchCache::KEY_OPERAND)
+    {
+        unsigned int flags = 0;
+        if (const EffAddr* ea = op->getMemory())
+        {
+            const Expr* abs = ea->m_disp.getAbs();
+            if (ea->m_pc_rel)
+                flags |= KEY_PC_REL;
+            if (ea->m_not_pc_rel)
+                flags |= KEY_NOT_PC_REL;
+            if (!abs->isEmpty())
+            {
+                if (abs->Contains(ExprTerm::REG))
+                    flags |= KEY_DISP_REG;
+                if (ContainsMatch(*abs, IsRegType(X86Register::XMMREG)))
+                    flags |= KEY_DISP_XMM;
+                if (ContainsMatch(*abs, IsRegType(X86Register::YMMREG)))
+                    flags |= KEY_DISP_YMM;
+                if (abs->isRegister())
+                    opkey[4] = reinterpret_cast<uintptr_t>(abs->getRegister());
+            }
+            flags |= ea->m_disp.getSize() << 8;
+        }
+        else if (const Expr* imm = op->getImm())
+        {
+            if (imm->isIntNum() && imm->getIntNum().isPos1())
+                flags |= KEY_IMM_1;
+            if (op->getSeg() != 0)
+                flags |= KEY_IMM_SEG;
+        }
+
+        opkey[0] = op->getType() | (op->getSize() << 4);
+        opkey[1] = flags;
+        if (const Register* reg = op->getReg())
+            opkey[2] = reinterpret_cast<uintptr_t>(reg);
+        else if (const SegmentRegister* segreg = op->getSegReg())
+            opkey[2] = reinterpret_cast<uintptr_t>(segreg);
+        opkey[3] = reinterpret_cast<uintptr_t>(op->getTargetMod());
+    }
+}
+
+const X86InsnInfo*
+X86Insn::FindMatchCached(const unsigned int* size_lookup) const
+{
+    X86MatchCache& cache = m_arch.getMatchCache();
+    X86MatchCache::Key key;
+    getMatchKey(key);
+
+    if (const X86InsnInfo* info = cache.Find(key))
+    {
+        ++num_match_cache_hits;
+        return info;
+    }
+
+    const X86InsnInfo* info = FindMatch(size_lookup, 0);
+    if (info)
+        cache.Insert(key, info);
     return info;
 }
 
@@ -1096,9 +1287,8 @@ X86Insn::MatchError(const unsigned int* size_lookup,
             break;
         case 8:
         {
-            unsigned int cpu0 = i->cpu0, cpu1 = i->cpu1, cpu2 = i->cpu2;
             diags.Report(source, diag::err_requires_cpu)
-                << CpuFindReverse(cpu0, cpu1, cpu2);
+                << CpuFindReverse(i->cpu);
             break;
         }
         default:
@@ -1107,6 +1297,74 @@ X86Insn::MatchError(const unsigned int* size_lookup,
     }
 }
 
+// Replace a register operand, keeping its source location.
+static void
+ReplaceReg(Operand& op, const Register* reg)
+{
+    SourceLocation source = op.getSource();
+    op = Operand(reg);
+    op.setSource(source);
+}
+
+bool
+X86Insn::ShortenOperands()
+{
+    // 32-bit operations zero-extend to 64 bits, so only 64-bit mode has
+    // shorter equivalents for 64-bit destinations.
+    if (m_mode_bits != 64 || m_operands.size() != 2)
+        return false;
+
+    // The destination is the last operand in GAS syntax.
+    bool gas = m_parser == X86Arch::PARSER_GAS;
+    Operand& dest = m_operands[gas ? 1 : 0];
+    Operand& src = m_operands[gas ? 0 : 1];
+
+    const X86Register* reg = static_cast<const X86Register*>(dest.getReg());
+    if (!reg || reg->isNot(X86Register::REG64) || dest.getSize() != 0)
+        return false;
+    const X86RegTmod& regtmod = X86RegTmod::Instance();
+    const X86Register* reg32 =
+        regtmod.getReg(X86Register::REG32, reg->getNum());
+
+    if (const Register* srcreg = src.getReg())
+    {
+        // XOR and SUB of a register with itself (zero idiom).
+        if (srcreg != reg || m_group != arith_insn
+            || (m_mod_data[1] != 5 && m_mod_data[1] != 6))
+            return false;
+        ReplaceReg(src, reg32);
+    }
+    else if (const Expr* imm = src.getImm())
+    {
+        if (src.getSize() != 0 || src.isStrict() || !imm->isIntNum())
+            return false;
+        IntNum val = imm->getIntNum();
+        if (m_group == mov_insn)
+        {
+            // MOV of a value that zero-extends from 32 bits.
+            if (!val.isOkSize(32, 0, 0))
+                return false;
+        }
+        else if (m_group == test_insn
+                 || (m_group == arith_insn && m_mod_data[1] == 4))
+        {
+            // AND and TEST with a value that is positive when
+            // sign-extended from 32 bits.
+            if (!val.isOkSize(31, 0, 0))
+                return false;
+        }
+        else
+            return false;
+    }
+    else
+        return false;
+
+    ReplaceReg(dest, reg32);
+    if (m_suffix & SUF_Q)
+        m_suffix = (m_suffix & ~SUF_Q) | SUF_L;
+    return true;
+}
+
 bool
 X86Insn::DoAppend(BytecodeContainer& container,
                   SourceLocation source,
@@ -1152,7 +1410,29 @@ X86Insn::DoAppend(BytecodeContainer& container,
         }
     }
 
-    const X86InsnInfo* info = FindMatch(size_lookup, 0);
+    const X86InsnInfo* info = 0;
+    if (m_arch.isOptimize() && m_operands.size() == 2)
+    {
+        // Try a shorter equivalent form first, falling back to the
+        // original operands if it doesn't match.  Only register operands
+        // are replaced, so the (bit) copies are safe to restore.
+        Operand orig0 = m_operands[0], orig1 = m_operands[1];
+        unsigned int orig_suffix = m_suffix;
+        if (ShortenOperands())
+        {
+            info = FindMatchCached(size_lookup);
+            if (info)
+                ++num_shortened;
+            else
+            {
+                m_operands[0] = orig0;
+                m_operands[1] = orig1;
+                m_suffix = orig_suffix;
+            }
+        }
+    }
+    if (!info)
+        info = FindMatchCached(size_lookup);
 
     if (!info)
     {
@@ -1161,6 +1441,52 @@ X86Insn::DoAppend(BytecodeContainer& container,
         return false;
     }
 
+    if (m_arch.isFeatureUsage())
+    {
+        Section* sect = container.getSection();
+        X86FeatureUsage* usage = sect->getAssocData<X86FeatureUsage>();
+        if (!usage)
+        {
+            usage = new X86FeatureUsage;
+            sect->AddAssocData(std::auto_ptr<X86FeatureUsage>(usage));
+        }
+        usage->Add(info->cpu | m_cpu);
+    }
+
+    if (const X86CostModel* model = m_arch.getCostModel())
+    {
+        Section* sect = container.getSection();
+        SourceLocation line = sect->getObject()->getListLine();
+        if (line.isValid())
+        {
+            bool mem = false;
+            for (Operands::const_iterator i=m_operands.begin(),
+                 end=m_operands.end(); i != end; ++i)
+            {
+                if (i->getMemory())
+                    mem = true;
+            }
+            // Memory operands are always in the EA field.
+            bool mem_dest = mem && info->num_operands > 0 &&
+                insn_operands[info->operands_index+0].action == OPA_EA;
+
+            X86CostClass cls = static_cast<X86CostClass>(m_cost_class);
+            if (cls == COST_Div && info->opersize == 64)
+                cls = COST_Div64;
+
+            Arch::InsnCost cost;
+            GetX86InsnCost(*model, cls, mem, mem_dest, &cost);
+
+            X86InsnCosts* costs = sect->getAssocData<X86InsnCosts>();
+            if (!costs)
+            {
+                costs = new X86InsnCosts;
+                sect->AddAssocData(std::auto_ptr<X86InsnCosts>(costs));
+            }
+            costs->Add(line, cost);
+        }
+    }
+
     if (m_operands.size() > 0)
     {
         switch (insn_operands[info->operands_index+0].action)
@@ -1199,6 +1525,8 @@ public:
                 const Insn::Prefixes& prefixes,
                 SourceLocation source);
 
+    bool isJccFusible() const;
+
 private:
     void ApplyOperand(const X86InfoOperand& info_op, Operand& op);
 
@@ -1698,6 +2026,45 @@ BuildGeneral::ApplySegReg(const SegmentRegister* segreg, SourceLocation source)
     CheckSegReg(static_cast<const X86SegmentRegister*>(segreg), source);
 }
 
+// Determine if the instruction may be macro-fused with a following
+// conditional jump: CMP and TEST (except memory with immediate), and ADD,
+// AND, SUB, INC, and DEC with a register destination.
+bool
+BuildGeneral::isJccFusible() const
+{
+    // A second opcode byte is either the short immediate alternative or
+    // part of a two-byte (0F) opcode.
+    if (m_vexdata != 0 || m_special_prefix != 0 || m_opcode.get(0) == 0x0F)
+        return false;
+
+    const X86EffAddr* x86_ea = m_x86_ea.get();
+    bool mem = x86_ea && !(x86_ea->m_valid_modrm
+                           && (x86_ea->m_modrm & 0xC0) == 0xC0);
+    unsigned char op = m_opcode.get(0);
+
+    // CMP, TEST
+    if ((op >= 0x38 && op <= 0x3D) || op == 0x84 || op == 0x85
+        || op == 0xA8 || op == 0xA9)
+        return true;
+    if (((op >= 0x80 && op <= 0x83) && m_spare == 7)
+        || ((op == 0xF6 || op == 0xF7) && m_spare == 0))
+        return !mem;
+
+    // ADD, AND, SUB
+    if (op <= 0x05 || (op >= 0x20 && op <= 0x25) || (op >= 0x28 && op <= 0x2D))
+        return !mem || (op & 7) >= 2;
+    if ((op >= 0x80 && op <= 0x83)
+        && (m_spare == 0 || m_spare == 4 || m_spare == 5))
+        return !mem;
+
+    // INC, DEC
+    if ((op == 0xFE || op == 0xFF) && m_spare <= 1)
+        return !mem;
+    if (op >= 0x40 && op <= 0x4F && m_mode_bits != 64)
+        return true;
+    return false;
+}
+
 bool
 BuildGeneral::Finish(BytecodeContainer& container,
                      const Insn::Prefixes& prefixes,
@@ -1808,7 +2175,314 @@ BuildGeneral::Finish(BytecodeContainer& container,
                   m_rex,
                   m_postop,
                   m_default_rel,
-                  source);
+                  source,
+                  m_diags);
+    return true;
+}
+
+// Decompose a memory operand of the form [base] or [base+disp] with a
+// BITS-sized base register and nothing else (no segment override, explicit
+// displacement size, or relative/pc-relative parts).
+static bool
+getBaseDisp(const EffAddr& ea,
+            unsigned int mode_bits,
+            const X86Register** base,
+            IntNum* disp)
+{
+    const Value& val = ea.m_disp;
+    if (ea.m_segreg != 0 || ea.m_need_nonzero_len || ea.m_pc_rel ||
+        val.getSize() != 0 || val.isRelative() || val.isIPRelative() ||
+        !val.hasAbs())
+        return false;
+
+    const ExprTerms& terms = val.getAbs()->getTerms();
+    const ExprTerm* regterm;
+    if (terms.size() == 1)
+    {
+        regterm = &terms[0];
+        disp->Zero();
+    }
+    else if (terms.size() == 3 && terms[2].isOp(Op::ADD))
+    {
+        const ExprTerm* intterm;
+        if (terms[0].isType(ExprTerm::REG))
+        {
+            regterm = &terms[0];
+            intterm = &terms[1];
+        }
+        else
+        {
+            regterm = &terms[1];
+            intterm = &terms[0];
+        }
+        if (!intterm->isType(ExprTerm::INT))
+            return false;
+        *disp = *intterm->getIntNum();
+        if (!disp->isOkSize(32, 0, 1))
+            return false;
+    }
+    else
+        return false;
+
+    const X86Register* reg =
+        static_cast<const X86Register*>(regterm->getRegister());
+    if (!reg)
+        return false;
+    if (!(mode_bits == 64 && reg->is(X86Register::REG64)) &&
+        !(mode_bits == 32 && reg->is(X86Register::REG32)))
+        return false;
+    *base = reg;
+    return true;
+}
+
+bool
+X86Insn::DoAppendSimple(BytecodeContainer& container,
+                        const X86InsnInfo& info,
+                        const unsigned int* size_lookup)
+{
+    if (!m_prefixes.empty() || m_segreg != 0)
+        return false;
+
+    // No VEX/XOP
+    unsigned char special_prefix = info.special_prefix;
+    if ((special_prefix & 0xF0) == 0xC0 || (special_prefix & 0xF0) == 0x80)
+        return false;
+
+    X86Opcode opcode(info.opcode_len, info.opcode);
+    unsigned char spare = info.spare;
+    unsigned char opersize = info.opersize;
+    unsigned int def_opersize_64 = info.def_opersize_64;
+
+    for (unsigned int i=0; i<NELEMS(info.modifiers); i++)
+    {
+        switch (info.modifiers[i])
+        {
+            case MOD_Gap:
+                break;
+            case MOD_PreAdd:
+                special_prefix += m_mod_data[i];
+                break;
+            case MOD_Op0Add:
+                opcode.Add(0, m_mod_data[i]);
+                break;
+            case MOD_Op1Add:
+                opcode.Add(1, m_mod_data[i]);
+                break;
+            case MOD_Op2Add:
+                opcode.Add(2, m_mod_data[i]);
+                break;
+            case MOD_SpAdd:
+                spare += m_mod_data[i];
+                break;
+            case MOD_OpSizeR:
+                opersize = m_mod_data[i];
+                break;
+            case MOD_DOpS64R:
+                def_opersize_64 = m_mod_data[i];
+                break;
+            case MOD_Op1AddSp:
+                opcode.Add(1, m_mod_data[i]<<3);
+                break;
+            default:
+                return false;
+        }
+    }
+
+    unsigned char rex = 0;
+    if (m_mode_bits == 64 && opersize == 64 && def_opersize_64 != 64)
+        rex = 0x48;
+
+    // ModRM is always needed if there is an EA; SIB and displacement are
+    // only needed for memory.
+    bool need_modrm = false;
+    unsigned char modrm = 0;
+    bool need_sib = false;
+    unsigned int disp_len = 0;
+    IntNum disp;
+    bool imm = false;
+    IntNum immval;
+    unsigned int imm_len = 0;
+    bool imm_sign = false;
+    X86GeneralPostOp postop = X86_POSTOP_NONE;
+
+    const X86InfoOperand* info_ops = &insn_operands[info.operands_index];
+    bool rev = (m_parser == X86Arch::PARSER_GAS &&
+                !(info.gas_flags & GAS_NO_REV));
+    for (unsigned int i=0, n=m_operands.size(); i<n; ++i)
+    {
+        const X86InfoOperand& info_op = info_ops[i];
+        const Operand& op = m_operands[rev ? n-i-1 : i];
+        unsigned char low3;
+
+        switch (info_op.action)
+        {
+            case OPA_None:
+                break;
+            case OPA_EA:
+                if (const Register* reg = op.getReg())
+                {
+                    if (!setRexFromReg(&rex, &low3,
+                                       static_cast<const X86Register*>(reg),
+                                       m_mode_bits, X86_REX_B))
+                        return false;
+                    modrm = 0xC0 | low3;
+                }
+                else if (const EffAddr* ea = op.getMemory())
+                {
+                    const X86Register* base;
+                    if (info_op.type == OPT_MemOffs ||
+                        info_op.type == OPT_MemXMMIndex ||
+                        info_op.type == OPT_MemYMMIndex ||
+                        op.getSeg() != 0 ||
+                        !getBaseDisp(*ea, m_mode_bits, &base, &disp) ||
+                        !setRexFromReg(&rex, &low3, base, m_mode_bits,
+                                       X86_REX_B))
+                        return false;
+
+                    // [bp]/[r13] has no mod=00 form; [sp]/[r12] needs a SIB.
+                    if (disp.isZero() && low3 != 5)
+                        modrm = low3;
+                    else if (disp.isInRange(-128, 127))
+                    {
+                        modrm = 0100 | low3;
+                        disp_len = 8;
+                    }
+                    else
+                    {
+                        modrm = 0200 | low3;
+                        disp_len = 32;
+                    }
+                    need_sib = (low3 == 4);
+                }
+                else
+                    return false;
+                need_modrm = true;
+                break;
+            case OPA_Spare:
+                if (const SegmentRegister* segreg = op.getSegReg())
+                {
+                    spare =
+                        static_cast<const X86SegmentRegister*>(segreg)->getNum();
+                }
+                else if (const Register* reg = op.getReg())
+                {
+                    if (!setRexFromReg(&rex, &spare,
+                                       static_cast<const X86Register*>(reg),
+                                       m_mode_bits, X86_REX_R))
+                        return false;
+                }
+                else
+                    return false;
+                break;
+            case OPA_Op0Add:
+            case OPA_Op1Add:
+            {
+                const Register* reg = op.getReg();
+                if (!reg || !setRexFromReg(&rex, &low3,
+                                           static_cast<const X86Register*>(reg),
+                                           m_mode_bits, X86_REX_B))
+                    return false;
+                opcode.Add(info_op.action == OPA_Op0Add ? 0 : 1, low3);
+                break;
+            }
+            case OPA_Imm:
+            case OPA_SImm:
+            {
+                const Expr* e = op.getImm();
+                if (!e || op.getSeg() != 0 || !e->isIntNum())
+                    return false;
+                imm = true;
+                immval = e->getIntNum();
+                imm_len = size_lookup[info_op.size];
+                if (imm_len != 8 && imm_len != 16 && imm_len != 32 &&
+                    imm_len != 64)
+                    return false;
+                imm_sign = (info_op.action == OPA_SImm);
+                break;
+            }
+            default:
+                return false;
+        }
+
+        if (info_op.size == OPS_BITS)
+            opersize = static_cast<unsigned char>(m_mode_bits);
+
+        switch (info_op.post_action)
+        {
+            case OPAP_None:
+                break;
+            case OPAP_SImm8:
+                if (!(m_force_strict || op.isStrict()) || op.getSize() == 0)
+                    postop = X86_POSTOP_SIGNEXT_IMM8;
+                else if (op.getSize() != 8)
+                    opcode.MakeAlt1();
+                break;
+            case OPAP_SImm32Avail:
+                postop = X86_POSTOP_SIMM32_AVAIL;
+                break;
+            case OPAP_ShortMov:
+                // Needs a 32-bit address size and no registers in the EA;
+                // neither is possible here.
+                break;
+            default:
+                return false;
+        }
+    }
+
+    if (need_modrm)
+        modrm = (modrm & 0xC7) | ((spare << 3) & 0x38);
+
+    // Resolve post-ops the same way AppendGeneral() does.
+    if (postop == X86_POSTOP_SIGNEXT_IMM8)
+    {
+        if (!imm || !immval.isOkSize(imm_len, 0, 2))
+            return false;
+        IntNum num = immval;
+        num.SignExtend(imm_len);
+        if (num.isInRange(-128, 127))
+        {
+            immval = num;
+            imm_len = 8;
+            imm_sign = true;
+        }
+        else
+            opcode.MakeAlt1();
+    }
+    else if (postop == X86_POSTOP_SIMM32_AVAIL)
+    {
+        if (!imm || need_modrm)
+            return false;
+        if (immval.isOkSize(32, 0, 1))
+        {
+            // Same as AppendGeneral(): opcode 0 must be a mov
+            modrm = 0xC0 | ((opcode.get(0)-0xB8) & 7);
+            need_modrm = true;
+            opcode.MakeAlt1();
+            imm_len = 32;
+            imm_sign = true;
+        }
+    }
+
+    // Anything that would warn at output goes through the general path.
+    if (imm && !immval.isOkSize(imm_len, 0, imm_sign ? 1 : 2))
+        return false;
+
+    X86Common common;
+    common.m_opersize = opersize;
+    common.m_mode_bits = m_mode_bits;
+    common.Finish();
+
+    Bytes& bytes = container.FreshBytecode().getFixed();
+    GeneralToBytes(bytes, common, opcode, 0, special_prefix, rex);
+    if (need_modrm)
+        Write8(bytes, modrm);
+    if (need_sib)
+        Write8(bytes, 0x24);    // no index, base in ModRM
+    if (disp_len != 0)
+        WriteN(bytes, disp, disp_len);
+    if (imm)
+        WriteN(bytes, immval, imm_len);
+    ++num_simple;
     return true;
 }
 
@@ -1819,6 +2493,12 @@ X86Insn::DoAppendGeneral(BytecodeContainer& container,
                          SourceLocation source,
                          DiagnosticsEngine& diags)
 {
+    // When padding branches, instructions that may be fused with a
+    // following branch need to be recognized, so skip the direct encoding.
+    unsigned long branch_align = getBranchAlign(container);
+    if (branch_align == 0 && DoAppendSimple(container, info, size_lookup))
+        return true;
+
     BuildGeneral buildgen(info, m_mode_bits, size_lookup, m_force_strict,
                           m_default_rel, diags);
 
@@ -1827,9 +2507,27 @@ X86Insn::DoAppendGeneral(BytecodeContainer& container,
     buildgen.ApplyOperands(static_cast<X86Arch::ParserSelect>(m_parser),
                            m_operands);
     buildgen.ApplySegReg(m_segreg, m_segreg_source);
+
+    if (branch_align != 0 && m_prefixes.empty() && buildgen.isJccFusible())
+    {
+        AppendBranchPad(container, branch_align, m_arch.getFill(), source);
+        bool ok = buildgen.Finish(container, m_prefixes, source);
+        SetBranchPadFused(container);
+        return ok;
+    }
     return buildgen.Finish(container, m_prefixes, source);
 }
 
+unsigned long
+X86Insn::getBranchAlign(BytecodeContainer& container) const
+{
+    // Padding is an offset setter, so it can only be used at the section
+    // level (e.g. not within TIMES).
+    if (static_cast<BytecodeContainer*>(container.getSection()) != &container)
+        return 0;
+    return m_arch.getBranchAlign();
+}
+
 namespace {
 // Static parse data structure for instructions
 struct InsnPrefixParseData
@@ -1837,9 +2535,13 @@ struct InsnPrefixParseData
     const char* name;
 
     // If num_info > 0, instruction parse group
-    // If num_info == 0, prefix
+    // If num_info == 0, prefix (X86PrefixInfo)
     const void* struc;
 
+    // For instruction, index of group forms by BITS and number of operands.
+    // 0 if prefix
+    const unsigned char* index;
+
     // For instruction, number of elements in group.
     // 0 if prefix
     unsigned int num_info:8;
@@ -1859,6 +2561,9 @@ struct InsnPrefixParseData
     unsigned int cpu0:6;
     unsigned int cpu1:6;
     unsigned int cpu2:6;
+
+    // Cost class (X86CostClass)
+    unsigned int cost_class:6;
 };
 
 // Pull in all parse data
@@ -1867,15 +2572,17 @@ struct InsnPrefixParseData
 } // anonymous namespace
 
 static std::string
-CpuFindReverse(unsigned int cpu0, unsigned int cpu1, unsigned int cpu2)
+CpuFindReverse(uint64_t cpu_bits)
 {
     std::string s;
     llvm::raw_string_ostream cpuname(s);
     X86Arch::CpuMask cpu;
 
-    cpu.set(cpu0);
-    cpu.set(cpu1);
-    cpu.set(cpu2);
+    for (unsigned int i=0; i<cpu.size(); ++i)
+    {
+        if (cpu_bits & (UINT64_C(1) << i))
+            cpu.set(i);
+    }
 
     if (cpu[X86Arch::CPU_Prot])
         cpuname << " Protected";
@@ -1955,7 +2662,7 @@ X86Arch::ParseCheckInsnPrefix(StringRef id,
     if (id_len > 16)
         return InsnPrefix();
 
-    static char lcaseid[17];
+    char lcaseid[17];
     for (size_t i=0; i<id_len; i++)
         lcaseid[i] = tolower(id[i]);
     lcaseid[id_len] = '\0';
@@ -1989,12 +2696,11 @@ X86Arch::ParseCheckInsnPrefix(StringRef id,
             return InsnPrefix();
         }
 
-        if (!m_active_cpu[pdata->cpu0] ||
-            !m_active_cpu[pdata->cpu1] ||
-            !m_active_cpu[pdata->cpu2])
+        uint64_t cpu = CPU_BITS(pdata->cpu0, pdata->cpu1, pdata->cpu2);
+        if ((cpu & m_active_cpu_bits) != cpu)
         {
             diags.Report(source, diag::warn_insn_with_cpu)
-                << CpuFindReverse(pdata->cpu0, pdata->cpu1, pdata->cpu2);
+                << CpuFindReverse(cpu);
             return InsnPrefix();
         }
 
@@ -2002,46 +2708,72 @@ X86Arch::ParseCheckInsnPrefix(StringRef id,
     }
     else
     {
-        const X86Prefix* prefix = static_cast<const X86Prefix*>(pdata->struc);
-
         if (m_mode_bits != 64 && (pdata->misc_flags & ONLY_64))
         {
             diags.Report(source, diag::warn_prefix_in_64mode);
             return InsnPrefix();
         }
 
-        return prefix;
+        static X86PrefixCache prefixes;
+        return prefixes.get(static_cast<const X86PrefixInfo*>(pdata->struc));
     }
 }
 
 inline
-X86Insn::X86Insn(const X86Arch& arch,
-                 const X86InsnInfo* group,
-                 const X86Arch::CpuMask& active_cpu,
-                 unsigned char mod_data0,
-                 unsigned char mod_data1,
-                 unsigned char mod_data2,
-                 unsigned int num_info,
-                 unsigned int mode_bits,
-                 unsigned int suffix,
-                 unsigned int misc_flags,
-                 X86Arch::ParserSelect parser,
-                 bool force_strict,
-                 bool default_rel)
+X86Insn::X86Insn(const X86Arch& arch)
     : m_arch(arch),
-      m_group(group),
-      m_active_cpu(active_cpu),
-      m_num_info(num_info),
-      m_mode_bits(mode_bits),
-      m_suffix(suffix),
-      m_misc_flags(misc_flags),
-      m_parser(parser),
-      m_force_strict(force_strict),
-      m_default_rel(default_rel)
+      m_group(0),
+      m_index(0),
+      m_active_cpu(0),
+      m_cpu(0),
+      m_lookup_gen(0),
+      m_num_info(0),
+      m_mode_bits(0),
+      m_suffix(0),
+      m_misc_flags(0),
+      m_parser(0),
+      m_force_strict(0),
+      m_default_rel(0),
+      m_cost_class(0)
 {
+    m_mod_data[0] = m_mod_data[1] = m_mod_data[2] = 0;
+}
+
+void
+X86Insn::Init(const X86InsnInfo* group,
+              const unsigned char* index,
+              uint64_t active_cpu,
+              uint64_t cpu,
+              unsigned int lookup_gen,
+              unsigned char mod_data0,
+              unsigned char mod_data1,
+              unsigned char mod_data2,
+              unsigned int num_info,
+              unsigned int mode_bits,
+              unsigned int suffix,
+              unsigned int misc_flags,
+              unsigned int cost_class,
+              X86Arch::ParserSelect parser,
+              bool force_strict,
+              bool default_rel)
+{
+    Clear();
+    m_group = group;
+    m_index = index;
+    m_active_cpu = active_cpu;
+    m_cpu = cpu;
+    m_lookup_gen = lookup_gen;
     m_mod_data[0] = mod_data0;
     m_mod_data[1] = mod_data1;
     m_mod_data[2] = mod_data2;
+    m_num_info = num_info;
+    m_mode_bits = mode_bits;
+    m_suffix = suffix;
+    m_misc_flags = misc_flags;
+    m_parser = parser;
+    m_force_strict = force_strict;
+    m_default_rel = default_rel;
+    m_cost_class = cost_class;
 }
 
 X86Insn::~X86Insn()
@@ -2060,9 +2792,8 @@ X86Insn::DoWrite(pugi::xml_node out) const
 {
     pugi::xml_node root = out.append_child("X86Insn");
 
-    append_child(root, "ActiveCpu",
-                 m_active_cpu.to_string<char, std::char_traits<char>,
-                                        std::allocator<char> >());
+    append_child(root, "ActiveCpu", Twine::utohexstr(m_active_cpu).str());
+    append_child(root, "Cpu", Twine::utohexstr(m_cpu).str());
 
     append_child(root, "ModData", Bytes(m_mod_data, m_mod_data+2));
     
@@ -2085,41 +2816,66 @@ X86Insn::DoWrite(pugi::xml_node out) const
 std::auto_ptr<Insn>
 X86Arch::CreateEmptyInsn() const
 {
-    ++num_empty_insn;
-    return std::auto_ptr<Insn>(new X86Insn(
-        *this,
-        empty_insn,
-        m_active_cpu,
-        0,
-        0,
-        0,
-        NELEMS(empty_insn),
-        m_mode_bits,
-        (m_parser == PARSER_GAS) ? SUF_Z : 0,
-        0,
-        m_parser,
-        m_force_strict,
-        m_default_rel));
+    std::auto_ptr<Insn> insn;
+    ReuseInsn(insn, 0);
+    return insn;
 }
 
 std::auto_ptr<Insn>
 X86Arch::CreateInsn(const Arch::InsnInfo* info) const
 {
+    std::auto_ptr<Insn> insn;
+    ReuseInsn(insn, info);
+    return insn;
+}
+
+void
+X86Arch::ReuseInsn(std::auto_ptr<Insn>& insn,
+                   const Arch::InsnInfo* info) const
+{
+    if (insn.get() == 0)
+        insn.reset(new X86Insn(*this));
+    X86Insn& x86insn = static_cast<X86Insn&>(*insn);
+
+    if (!info)
+    {
+        ++num_empty_insn;
+        x86insn.Init(empty_insn,
+                     empty_index,
+                     m_active_cpu_bits,
+                     0,
+                     getLookupGeneration(),
+                     0,
+                     0,
+                     0,
+                     NELEMS(empty_insn),
+                     m_mode_bits,
+                     (m_parser == PARSER_GAS) ? SUF_Z : 0,
+                     0,
+                     COST_None,
+                     m_parser,
+                     m_force_strict,
+                     m_default_rel);
+        return;
+    }
+
     const InsnPrefixParseData* pdata =
         reinterpret_cast<const InsnPrefixParseData*>(info);
 
-    return std::auto_ptr<Insn>(new X86Insn(
-        *this,
-        static_cast<const X86InsnInfo*>(pdata->struc),
-        m_active_cpu,
-        pdata->mod_data0,
-        pdata->mod_data1,
-        pdata->mod_data2,
-        pdata->num_info,
-        m_mode_bits,
-        pdata->flags,
-        pdata->misc_flags,
-        m_parser,
-        m_force_strict,
-        m_default_rel));
+    x86insn.Init(static_cast<const X86InsnInfo*>(pdata->struc),
+                 pdata->index,
+                 m_active_cpu_bits,
+                 CPU_BITS(pdata->cpu0, pdata->cpu1, pdata->cpu2),
+                 getLookupGeneration(),
+                 pdata->mod_data0,
+                 pdata->mod_data1,
+                 pdata->mod_data2,
+                 pdata->num_info,
+                 m_mode_bits,
+                 pdata->flags,
+                 pdata->misc_flags,
+                 pdata->cost_class,
+                 m_parser,
+                 m_force_strict,
+                 m_default_rel);
 }
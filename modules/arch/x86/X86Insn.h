@@ -26,6 +26,7 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 //
+#include "llvm/Support/DataTypes.h"
 #include "yasmx/Config/export.h"
 #include "yasmx/Insn.h"
 
@@ -43,24 +44,73 @@ struct X86InfoOperand;
 struct X86InsnInfo;
 class X86Opcode;
 
+/// Cache of instruction form matches.  The key holds everything about an
+/// instruction that form matching looks at, so instructions with the same
+/// mnemonic and operand shape can skip matching entirely.  Direct mapped;
+/// a colliding insert replaces the previous entry.
+class YASM_STD_EXPORT X86MatchCache
+{
+public:
+    enum
+    {
+        KEY_HEADER = 3,         ///< group, flags, arch lookup generation
+        KEY_OPERAND = 5,        ///< words per operand
+        KEY_WORDS = KEY_HEADER + 5*KEY_OPERAND,
+        NUM_ENTRIES = 256
+    };
+    typedef uintptr_t Key[KEY_WORDS];
+
+    X86MatchCache();
+    ~X86MatchCache();
+
+    /// Look up a match.
+    /// @param key      match key
+    /// @return Matched form, or NULL if not cached.
+    const X86InsnInfo* Find(const Key& key) const;
+
+    /// Record a match.
+    /// @param key      match key
+    /// @param info     matched form
+    void Insert(const Key& key, const X86InsnInfo* info);
+
+private:
+    static unsigned int Hash(const Key& key);
+
+    struct Entry
+    {
+        Key key;
+        const X86InsnInfo* info;
+    };
+    Entry m_entries[NUM_ENTRIES];
+};
+
 class YASM_STD_EXPORT X86Insn : public Insn
 {
 public:
-    X86Insn(const X86Arch& arch,
-            const X86InsnInfo* group,
-            const X86Arch::CpuMask& active_cpu,
-            unsigned char mod_data0,
-            unsigned char mod_data1,
-            unsigned char mod_data2,
-            unsigned int num_info,
-            unsigned int mode_bits,
-            unsigned int suffix,
-            unsigned int misc_flags,
-            X86Arch::ParserSelect parser,
-            bool force_strict,
-            bool default_rel);
+    /// Constructor.  The instruction must be set up with Init() before
+    /// use.
+    explicit X86Insn(const X86Arch& arch);
     ~X86Insn();
 
+    /// Set up the instruction, removing any operands and prefixes left
+    /// from a previous use.
+    void Init(const X86InsnInfo* group,
+              const unsigned char* index,
+              uint64_t active_cpu,
+              uint64_t cpu,
+              unsigned int lookup_gen,
+              unsigned char mod_data0,
+              unsigned char mod_data1,
+              unsigned char mod_data2,
+              unsigned int num_info,
+              unsigned int mode_bits,
+              unsigned int suffix,
+              unsigned int misc_flags,
+              unsigned int cost_class,
+              X86Arch::ParserSelect parser,
+              bool force_strict,
+              bool default_rel);
+
     X86Insn* clone() const;
 
 protected:
@@ -86,17 +136,36 @@ private:
                      SourceLocation source,
                      DiagnosticsEngine& diags);
 
+    // Encode common register, constant immediate, and [base+disp] forms
+    // directly as fixed bytes.  Returns false (having done nothing) if the
+    // instruction needs the general path.
+    bool DoAppendSimple(BytecodeContainer& container,
+                        const X86InsnInfo& info,
+                        const unsigned int* size_lookup);
+
     bool DoAppendGeneral(BytecodeContainer& container,
                          const X86InsnInfo& info,
                          const unsigned int* size_lookup,
                          SourceLocation source,
                          DiagnosticsEngine& diags);
 
+    // Boundary to pad branches in container to; 0 if none.
+    unsigned long getBranchAlign(BytecodeContainer& container) const;
+
+    // Substitute shorter equivalent operands (e.g. a 32-bit destination
+    // register that zero-extends to 64 bits).  Returns false (having done
+    // nothing) if there is no shorter form.
+    bool ShortenOperands();
+
     const X86InsnInfo* FindMatch(const unsigned int* size_lookup, int bypass)
         const;
+    const X86InsnInfo* FindMatchCached(const unsigned int* size_lookup) const;
+    void getMatchKey(X86MatchCache::Key& key) const;
     bool MatchInfo(const X86InsnInfo& info,
                    const unsigned int* size_lookup,
-                   int bypass) const;
+                   int bypass,
+                   unsigned int classes,
+                   unsigned int rev_classes) const;
     bool MatchOperand(const Operand& op,
                       const X86InfoOperand& info_op,
                       const Operand& op0,
@@ -112,8 +181,20 @@ private:
     // instruction parse group - NULL if empty instruction (just prefixes)
     /*@null@*/ const X86InsnInfo* m_group;
 
-    // CPU feature flags enabled at the time of parsing the instruction
-    X86Arch::CpuMask m_active_cpu;
+    // index of the parse group forms by BITS and number of operands
+    // (generated alongside the group)
+    const unsigned char* m_index;
+
+    // CPU feature flags enabled at the time of parsing the instruction,
+    // bit N set for X86Arch::CpuFeature N
+    uint64_t m_active_cpu;
+
+    // CPU feature flags required by the instruction name (in addition to
+    // those of the matched form), as for m_active_cpu
+    uint64_t m_cpu;
+
+    // Arch lookup generation at the time of parsing the instruction
+    unsigned int m_lookup_gen;
 
     // Modifier data
     unsigned char m_mod_data[3];
@@ -138,6 +219,9 @@ private:
 
     // Default rel setting at the time of parsing the instruction
     unsigned int m_default_rel:1;
+
+    // Cost class of the instruction name (X86CostClass)
+    unsigned int m_cost_class:6;
 };
 
 }} // namespace yasm::arch
@@ -28,6 +28,7 @@
 
 #include "X86Jmp.h"
 
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/Statistic.h"
 #include "yasmx/Basic/Diagnostic.h"
 #include "yasmx/BytecodeContainer.h"
@@ -36,6 +37,8 @@
 #include "yasmx/Bytes.h"
 #include "yasmx/Expr.h"
 #include "yasmx/IntNum.h"
+#include "yasmx/Object.h"
+#include "yasmx/ParseRecord.h"
 #include "yasmx/Section.h"
 #include "yasmx/Symbol.h"
 
@@ -45,6 +48,7 @@
 
 STATISTIC(num_jmp, "Number of jump instructions appended");
 STATISTIC(num_jmp_bc, "Number of jump bytecodes created");
+STATISTIC(num_jmp_threaded, "Number of jumps retargeted past other jumps");
 
 using namespace yasm;
 using namespace yasm::arch;
@@ -63,28 +67,45 @@ public:
 
     bool Finalize(Bytecode& bc, DiagnosticsEngine& diags);
     bool CalcLen(Bytecode& bc,
-                 /*@out@*/ unsigned long* len,
+                 /*@out@*/ uint64_t* len,
                  const Bytecode::AddSpanFunc& add_span,
                  DiagnosticsEngine& diags);
     bool Expand(Bytecode& bc,
-                unsigned long* len,
+                uint64_t* len,
                 int span,
-                long old_val,
-                long new_val,
+                int64_t old_val,
+                int64_t new_val,
                 bool* keep,
-                /*@out@*/ long* neg_thres,
-                /*@out@*/ long* pos_thres,
+                /*@out@*/ int64_t* neg_thres,
+                /*@out@*/ int64_t* pos_thres,
                 DiagnosticsEngine& diags);
+    bool getMaxGrowth(const Bytecode& bc, uint64_t* growth) const;
     bool Output(Bytecode& bc, BytecodeOutput& bc_out);
 
     StringRef getType() const;
 
     X86Jmp* clone() const;
 
+    bool Save(RecordWriter& out) const;
+
+    /// Read from a parse record written by Save().
+    static Bytecode::Contents::Ptr Load(RecordReader& in);
+
 #ifdef WITH_XML
     pugi::xml_node Write(pugi::xml_node out) const;
 #endif // WITH_XML
 
+    /// Determine if the jump always transfers control to its target
+    /// and does nothing else.
+    bool isUnconditional() const;
+
+    /// Change the jump target to a label in the same container.
+    void Retarget(Bytecode& bc, SymbolRef label, DiagnosticsEngine& diags);
+
+    /// Label targeted by the jump, if the target is nothing more than a
+    /// label in the same container; NULL otherwise.
+    SymbolRef m_label;
+
 private:
     X86Common m_common;
     X86Opcode m_shortop, m_nearop;
@@ -104,6 +125,7 @@ X86Jmp::X86Jmp(const X86Common& common,
                std::auto_ptr<Expr> target,
                SourceLocation target_source)
     : Bytecode::Contents(),
+      m_label(0),
       m_common(common),
       m_shortop(shortop),
       m_nearop(nearop),
@@ -131,6 +153,10 @@ X86Jmp::Finalize(Bytecode& bc, DiagnosticsEngine& diags)
         return false;
     }
 
+    SymbolRef label = m_target.getRelative();
+    if (m_target.hasAbs() || m_target.isWRT())
+        label = SymbolRef(0);
+
     // Need to adjust target to the end of the instruction.
     // However, we don't know the instruction length yet (short/near).
     // So just adjust to the start of the instruction, and handle the
@@ -142,6 +168,10 @@ X86Jmp::Finalize(Bytecode& bc, DiagnosticsEngine& diags)
                      diag::err_too_complex_expression);
     m_target.setIPRelative();
 
+    // The target is only a label in the same container if the subtraction
+    // made the value absolute.
+    m_label = m_target.isRelative() ? SymbolRef(0) : label;
+
     Location target_loc;
     if (m_target.isRelative()
         && (!m_target.getRelative()->getLabel(&target_loc)
@@ -162,7 +192,7 @@ X86Jmp::Finalize(Bytecode& bc, DiagnosticsEngine& diags)
 
 bool
 X86Jmp::CalcLen(Bytecode& bc,
-                /*@out@*/ unsigned long* len,
+                /*@out@*/ uint64_t* len,
                 const Bytecode::AddSpanFunc& add_span,
                 DiagnosticsEngine& diags)
 {
@@ -185,13 +215,13 @@ X86Jmp::CalcLen(Bytecode& bc,
 
 bool
 X86Jmp::Expand(Bytecode& bc,
-               unsigned long* len,
+               uint64_t* len,
                int span,
-               long old_val,
-               long new_val,
+               int64_t old_val,
+               int64_t new_val,
                bool* keep,
-               /*@out@*/ long* neg_thres,
-               /*@out@*/ long* pos_thres,
+               /*@out@*/ int64_t* neg_thres,
+               /*@out@*/ int64_t* pos_thres,
                DiagnosticsEngine& diags)
 {
     assert(span == 1 && "unrecognized span id");
@@ -207,6 +237,17 @@ X86Jmp::Expand(Bytecode& bc,
     return true;
 }
 
+bool
+X86Jmp::getMaxGrowth(const Bytecode& bc, uint64_t* growth) const
+{
+    if (m_op_sel == X86_JMP_NEAR)
+        *growth = 0;
+    else
+        *growth = m_nearop.getLen() + ((m_common.m_opersize == 16) ? 2 : 4)
+            - (m_shortop.getLen() + 1);
+    return true;
+}
+
 bool
 X86Jmp::Output(Bytecode& bc, BytecodeOutput& bc_out)
 {
@@ -256,6 +297,27 @@ X86Jmp::Output(Bytecode& bc, BytecodeOutput& bc_out)
     return true;
 }
 
+bool
+X86Jmp::isUnconditional() const
+{
+    // An operand size override outside of 16-bit mode truncates the
+    // target, and the BND prefix affects more than the jump.
+    return m_shortop.getLen() == 1 && m_shortop.get(0) == 0xEB
+        && m_common.m_lockrep_pre == 0 && m_common.m_acqrel_pre == 0
+        && (m_common.m_opersize != 16 || m_common.m_mode_bits == 16);
+}
+
+void
+X86Jmp::Retarget(Bytecode& bc, SymbolRef label, DiagnosticsEngine& diags)
+{
+    Value target(0, Expr::Ptr(new Expr(label)));
+    target.setJumpTarget();
+    target.setSigned();
+    target.setSource(m_target.getSource());
+    m_target.swap(target);
+    Finalize(bc, diags);
+}
+
 StringRef
 X86Jmp::getType() const
 {
@@ -268,6 +330,42 @@ X86Jmp::clone() const
     return new X86Jmp(*this);
 }
 
+bool
+X86Jmp::Save(RecordWriter& out) const
+{
+    // The label is only looked up once the bytecode is finalized.
+    if (m_label)
+        return false;
+    m_common.Save(out);
+    m_shortop.Save(out);
+    m_nearop.Save(out);
+    out.WriteUnsigned(m_op_sel);
+    return out.WriteValue(m_target);
+}
+
+Bytecode::Contents::Ptr
+X86Jmp::Load(RecordReader& in)
+{
+    X86Common common;
+    common.Load(in);
+    X86Opcode shortop, nearop;
+    shortop.Load(in);
+    nearop.Load(in);
+    X86JmpOpcodeSel op_sel =
+        static_cast<X86JmpOpcodeSel>(in.ReadUnsigned(X86_JMP_NEAR));
+    std::auto_ptr<X86Jmp> jmp(new X86Jmp(common, op_sel, shortop, nearop,
+                                         std::auto_ptr<Expr>(new Expr),
+                                         SourceLocation()));
+    in.ReadValue(jmp->m_target);
+    return Bytecode::Contents::Ptr(jmp.release());
+}
+
+Bytecode::Contents::Ptr
+arch::LoadJmp(RecordReader& in)
+{
+    return X86Jmp::Load(in);
+}
+
 #ifdef WITH_XML
 pugi::xml_node
 X86Jmp::Write(pugi::xml_node out) const
@@ -289,6 +387,63 @@ X86Jmp::Write(pugi::xml_node out) const
 }
 #endif // WITH_XML
 
+// Get the jump that a label points at, if any.
+static X86Jmp*
+getLabelJmp(SymbolRef label, /*@out@*/ Bytecode** bc)
+{
+    Location loc;
+    if (!label->getLabel(&loc) || !loc.bc->hasContents()
+        || loc.off != loc.bc->getFixedLen()
+        || loc.bc->getContents().getType() != "yasm::arch::X86Jmp")
+        return 0;
+    *bc = loc.bc;
+    return static_cast<X86Jmp*>(&loc.bc->getContents());
+}
+
+void
+arch::ThreadJumps(Object& object, DiagnosticsEngine& diags)
+{
+    // Limit on the number of jumps followed from each jump.
+    static const int MAX_HOPS = 16;
+
+    llvm::SmallPtrSet<const Bytecode*, 8> visited;
+    for (Object::section_iterator sect=object.sections_begin(),
+         end=object.sections_end(); sect != end; ++sect)
+    {
+        for (Section::bc_iterator bc=sect->bytecodes_begin(),
+             bcend=sect->bytecodes_end(); bc != bcend; ++bc)
+        {
+            if (!bc->hasContents()
+                || bc->getContents().getType() != "yasm::arch::X86Jmp")
+                continue;
+            X86Jmp& jmp = static_cast<X86Jmp&>(bc->getContents());
+            if (!jmp.m_label)
+                continue;
+
+            // Follow the chain of unconditional jumps.  A cycle of jumps
+            // never exits, so any jump in it is as good a target as any.
+            visited.clear();
+            visited.insert(&*bc);
+            SymbolRef label = jmp.m_label;
+            for (int hops=0; hops<MAX_HOPS; ++hops)
+            {
+                Bytecode* next_bc;
+                X86Jmp* next = getLabelJmp(label, &next_bc);
+                if (!next || !next->m_label || !next->isUnconditional()
+                    || !visited.insert(next_bc))
+                    break;
+                label = next->m_label;
+            }
+
+            if (label != jmp.m_label)
+            {
+                jmp.Retarget(*bc, label, diags);
+                ++num_jmp_threaded;
+            }
+        }
+    }
+}
+
 void
 arch::AppendJmp(BytecodeContainer& container,
                 const X86Common& common,
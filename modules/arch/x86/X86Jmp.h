@@ -29,13 +29,17 @@
 #include <memory>
 
 #include "yasmx/Config/export.h"
+#include "yasmx/Bytecode.h"
 
 
 namespace yasm
 {
 
 class BytecodeContainer;
+class DiagnosticsEngine;
 class Expr;
+class Object;
+class RecordReader;
 class SourceLocation;
 
 namespace arch
@@ -61,6 +65,21 @@ void AppendJmp(BytecodeContainer& container,
                SourceLocation source,
                X86JmpOpcodeSel op_sel = X86_JMP_NONE);
 
+/// Read jump bytecode contents from a parse record.
+/// @param in           parse record reader
+/// @return Contents.
+YASM_STD_EXPORT
+Bytecode::Contents::Ptr LoadJmp(RecordReader& in);
+
+/// Retarget jumps to labels that point at unconditional jumps to the
+/// final destination of the chain, so the optimizer can shorten them.
+/// Only jumps and labels within a single section are considered.
+/// Must be called after the object is finalized.
+/// @param object       object
+/// @param diags        diagnostic reporting
+YASM_STD_EXPORT
+void ThreadJumps(Object& object, DiagnosticsEngine& diags);
+
 }} // namespace yasm::arch
 
 #endif
@@ -27,6 +27,7 @@
 #include "X86Opcode.h"
 
 #include "yasmx/Bytes.h"
+#include "yasmx/ParseRecord.h"
 
 
 using namespace yasm;
@@ -49,6 +50,23 @@ X86Opcode::ToBytes(Bytes& bytes) const
     bytes.Write(llvm::makeArrayRef(m_opcode, m_len));
 }
 
+void
+X86Opcode::Save(RecordWriter& out) const
+{
+    // The bytes past the length may hold an alternate opcode.
+    out.WriteUnsigned(m_len);
+    for (int i=0; i<3; ++i)
+        out.WriteUnsigned(m_opcode[i]);
+}
+
+void
+X86Opcode::Load(RecordReader& in)
+{
+    m_len = static_cast<unsigned char>(in.ReadUnsigned(3));
+    for (int i=0; i<3; ++i)
+        m_opcode[i] = static_cast<unsigned char>(in.ReadUnsigned(0xff));
+}
+
 void
 X86Opcode::MakeAlt1()
 {
@@ -34,6 +34,8 @@ namespace yasm
 {
 
 class Bytes;
+class RecordReader;
+class RecordWriter;
 
 namespace arch
 {
@@ -56,6 +58,16 @@ public:
 
     void ToBytes(Bytes& bytes) const;
 
+    /// Copy the active opcode bytes into a raw buffer (at most 3 bytes).
+    /// @return Number of bytes written.
+    unsigned int Encode(unsigned char* out) const
+    {
+        out[0] = m_opcode[0];
+        out[1] = m_opcode[1];
+        out[2] = m_opcode[2];
+        return m_len;
+    }
+
     /// Switch to the "alternate" one-byte opcode.  Some optimizations
     /// store two opcodes in the three bytes of opcode storage available;
     /// one or two bytes of "primary" opcode, followed by one byte of
@@ -78,6 +90,12 @@ public:
 
     unsigned char get(int byte) const { return m_opcode[byte]; }
 
+    /// Write to a parse record.
+    void Save(RecordWriter& out) const;
+
+    /// Read from a parse record written by Save().
+    void Load(RecordReader& in);
+
 #ifdef WITH_XML
     pugi::xml_node Write(pugi::xml_node out) const;
 #endif // WITH_XML
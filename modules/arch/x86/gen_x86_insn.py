@@ -147,6 +147,18 @@ class Operand(object):
                 self.tmod != other.tmod or
                 self.opt != other.opt)
 
+# Operand::Type classes accepted by each operand type, as a mask of
+# 1<<(Operand::Type-1): REG=1, SEGREG=2, MEMORY=4, IMM=8.
+operand_type_classes = {
+    "Imm": 8, "Imm1": 8, "ImmNotSegOff": 8,
+    "Reg": 1, "SIMDReg": 1, "CRReg": 1, "DRReg": 1, "TRReg": 1, "ST0": 1,
+    "Areg": 1, "Creg": 1, "Dreg": 1, "CR4": 1, "XMM0": 1,
+    "RM": 1|4, "SIMDRM": 1|4,
+    "Mem": 4, "MemOffs": 4, "MemrAX": 4, "MemEAX": 4, "MemDX": 4,
+    "MemXMMIndex": 4, "MemYMMIndex": 4,
+    "SegReg": 2, "CS": 2, "DS": 2, "ES": 2, "FS": 2, "GS": 2, "SS": 2,
+}
+
 class GroupForm(object):
     def __init__(self, **kwargs):
         # Parsers
@@ -356,9 +368,7 @@ class GroupForm(object):
         # Build instruction info structure initializer
         return "{ "+ ", ".join([gas_flags or "0",
                                 "|".join(self.misc_flags) or "0",
-                                cpus_str[0],
-                                cpus_str[1],
-                                cpus_str[2],
+                                "CPU_BITS(%s)" % ", ".join(cpus_str[0:3]),
                                 mod_str,
                                 "%d" % (self.opersize or 0),
                                 "%d" % (self.def_opersize_64 or 0),
@@ -367,7 +377,16 @@ class GroupForm(object):
                                 opcodes_str,
                                 "%d" % (self.spare or 0),
                                 "%d" % len(self.operands),
-                                "%d" % self.all_operands_index]) + " }"
+                                "%d" % self.all_operands_index,
+                                "0x%05X" % self.operand_classes()]) + " }"
+
+    def operand_classes(self):
+        """Operand type classes accepted by this form, 4 bits per operand
+        in operand order."""
+        classes = 0
+        for i, op in enumerate(self.operands):
+            classes |= operand_type_classes[op.type] << (4*i)
+        return classes
 
 groups = {}
 groupnames_ordered = []
@@ -381,6 +400,7 @@ class Insn(object):
                  cpu=None, misc_flags=None, only64=False, not64=False,
                  avx=False):
         self.groupname = groupname
+        self.cost = "None"
         if suffix is None:
             self.suffix = None
         else:
@@ -457,11 +477,13 @@ class Insn(object):
 
     def copy(self):
         """Return a shallow copy."""
-        return Insn(self.groupname,
+        insn = Insn(self.groupname,
                     suffix=self.suffix,
                     modifiers=self.modifiers,
                     cpu=self.cpu,
                     misc_flags=self.misc_flags)
+        insn.cost = self.cost
+        return insn
 
     def __str__(self):
         if self.suffix is None:
@@ -488,6 +510,7 @@ class Insn(object):
         mods_str.extend(["0", "0", "0"])
 
         return ",\t".join(["%s_insn" % self.groupname,
+                           "%s_index" % self.groupname,
                            "%d" % len(groups[self.groupname]),
                            suffix_str,
                            mods_str[0],
@@ -496,7 +519,8 @@ class Insn(object):
                            "|".join(self.misc_flags or []) or "0",
                            cpus_str[0],
                            cpus_str[1],
-                           cpus_str[2]])
+                           cpus_str[2],
+                           "COST_%s" % self.cost])
 
 insns = {}
 def add_insn(name, groupname, **kwargs):
@@ -509,13 +533,15 @@ class Prefix(object):
         self.groupname = groupname
         self.value = value
         self.only64 = only64
+        self.index = len(prefixes)
 
     def code_str(self):
-        return "static const X86Prefix i_%s(X86Prefix::%s, 0x%02X);" % (
-            self.name, self.groupname, self.value)
+        return "{X86Prefix::%s, 0x%02X},\t// %s" % (
+            self.groupname, self.value, self.name)
 
     def __str__(self):
-        return ",\t".join(["&i_%s" % self.name,
+        return ",\t".join(["&x86_prefix_info[%d]" % self.index,
+                           "0",
                            "0",
                            "0",
                            "0",
@@ -524,7 +550,8 @@ class Prefix(object):
                            self.only64 and "ONLY_64" or "0",
                            "0",
                            "0",
-                           "0"])
+                           "0",
+                           "COST_None"])
 
 gas_insns = {}
 nasm_insns = {}
@@ -538,12 +565,113 @@ def add_prefix(name, groupname, value, parser=None, **kwargs):
     if parser is None or parser == "nasm":
         nasm_insns[name] = prefix
 
+# Cost classes (see X86Cost.h) by mnemonic, for estimating instruction
+# costs in listings.  AVX mnemonics take the class of the SSE mnemonic
+# without the "v" if not listed themselves.  Instructions not listed (or
+# matched by insn_cost_class() below) aren't modeled.
+cost_classes = {
+    "Mov": "mov movabs movzx movsx movsxd movzbw movzbl movzbq movzwl movzwq "
+           "movsbw movsbl movsbq movswl movswq movslq movbe movnti xchg "
+           "cbw cwde cdqe cwd cdq cqo cbtw cwtl cltq cwtd cltd cqto",
+    "Alu": "add sub and or xor adc sbb inc dec neg not bswap clc stc cmc "
+           "nop",
+    "Cmp": "cmp test bt",
+    "Shift": "shl shr sal sar rol ror shld shrd",
+    "Lea": "lea",
+    "Mul": "imul mul",
+    "Div": "div idiv",
+    "Branch": "jmp call ret retn retq jcxz jecxz jrcxz",
+    "Push": "push",
+    "Pop": "pop",
+    "BitCount": "popcnt lzcnt tzcnt bsf bsr crc32",
+    "Bmi": "andn blsi blsr blsmsk bzhi sarx shlx shrx rorx bextr",
+    "Pdep": "pdep pext",
+    "Mulx": "mulx",
+    "SimdMov": "movdqa movdqu movaps movups movapd movupd movd movq movss "
+               "movsd lddqu movntdq movntps movntpd movntdqa movq2dq movdq2q "
+               "movhps movhpd movlps movlpd maskmovdqu",
+    "SimdInt": "paddb paddw paddd paddq paddsb paddsw paddusb paddusw "
+               "psubb psubw psubd psubq psubsb psubsw psubusb psubusw "
+               "pand pandn por pxor andps andnps orps xorps andpd andnpd "
+               "orpd xorpd pcmpeqb pcmpeqw pcmpeqd pcmpeqq pcmpgtb pcmpgtw "
+               "pcmpgtd pcmpgtq pmaxsb pmaxsw pmaxsd pmaxub pmaxuw pmaxud "
+               "pminsb pminsw pminsd pminub pminuw pminud pavgb pavgw pabsb "
+               "pabsw pabsd psignb psignw psignd blendps blendpd pblendw "
+               "pblendd",
+    "SimdShift": "psllw pslld psllq psrlw psrld psrlq psraw psrad psllvd "
+                 "psllvq psrlvd psrlvq psravd",
+    "Blendv": "blendvps blendvpd pblendvb",
+    "Shuffle": "pshufb pshufd pshufhw pshuflw shufps shufpd unpcklps "
+               "unpckhps unpcklpd unpckhpd punpcklbw punpcklwd punpckldq "
+               "punpcklqdq punpckhbw punpckhwd punpckhdq punpckhqdq palignr "
+               "packsswb packssdw packuswb packusdw pslldq psrldq movlhps "
+               "movhlps movsldup movshdup movddup permilps permilpd insertps "
+               "pmovzxbw pmovzxbd pmovzxbq pmovzxwd pmovzxwq pmovzxdq "
+               "pmovsxbw pmovsxbd pmovsxbq pmovsxwd pmovsxwq pmovsxdq",
+    "LaneShuffle": "perm2f128 perm2i128 permd permps permq permpd "
+                   "insertf128 inserti128 extractf128 extracti128 "
+                   "broadcastss broadcastsd broadcastf128 broadcasti128 "
+                   "pbroadcastb pbroadcastw pbroadcastd pbroadcastq",
+    "Extract": "pextrb pextrw pextrd pextrq pinsrb pinsrw pinsrd pinsrq "
+               "extractps",
+    "Movmsk": "movmskps movmskpd pmovmskb",
+    "FAdd": "addps addpd addss addsd subps subpd subss subsd addsubps "
+            "addsubpd maxps maxpd maxss maxsd minps minpd minss minsd",
+    "FMul": "mulps mulpd mulss mulsd",
+    "FDiv": "divps divss",
+    "FDivD": "divpd divsd",
+    "FSqrt": "sqrtps sqrtss",
+    "FSqrtD": "sqrtpd sqrtsd",
+    "Rcp": "rcpps rcpss rsqrtps rsqrtss",
+    "Round": "roundps roundpd roundss roundsd",
+    "Cvt": "cvtdq2pd cvtdq2ps cvtpd2dq cvtpd2ps cvtps2dq cvtps2pd cvtsd2si "
+           "cvtsd2ss cvtsi2sd cvtsi2ss cvtss2sd cvtss2si cvttpd2dq "
+           "cvttps2dq cvttsd2si cvttss2si cvtpd2dqx cvtpd2dqy cvtpd2psx "
+           "cvtpd2psy cvttpd2dqx cvttpd2dqy cvtph2ps cvtps2ph",
+    "Comis": "comiss comisd ucomiss ucomisd ptest testps testpd",
+    "PMul": "pmullw pmulhw pmulhuw pmuludq pmuldq pmaddwd pmaddubsw "
+            "pmulhrsw psadbw",
+    "PMulld": "pmulld",
+    "HAdd": "haddps haddpd hsubps hsubpd phaddw phaddd phaddsw phsubw "
+            "phsubd phsubsw",
+    "Dpps": "dpps dppd",
+    "Gather": "gatherdps gatherdpd gatherqps gatherqpd pgatherdd "
+              "pgatherdq pgatherqd pgatherqq",
+    "Aes": "aesenc aesenclast aesdec aesdeclast",
+    "Clmul": "pclmulqdq pclmullqlqdq pclmulhqlqdq pclmullqhqdq "
+             "pclmulhqhqdq",
+}
+cost_class_of = {}
+for cls, names in cost_classes.items():
+    for name in names.split():
+        cost_class_of[name] = cls
+
+def insn_cost_class(name):
+    """Determine the cost class of an instruction mnemonic."""
+    if name in cost_class_of:
+        return cost_class_of[name]
+    if name.startswith("cmov") or name.startswith("set"):
+        return "Alu"
+    if name.startswith("j"):
+        return "Branch"
+    if name.startswith("vf") and ("madd" in name or "msub" in name):
+        return "Fma"
+    # SSE/AVX compares (but not the string compares)
+    if name.startswith("cmp") and name[-2:] in ("ps", "pd", "ss", "sd"):
+        return "FAdd"
+    if name.startswith("vcmp"):
+        return "FAdd"
+    if name.startswith("v") and name[1:] in cost_class_of:
+        return cost_class_of[name[1:]]
+    return "None"
+
 def finalize_insns():
     unused_groups = set(groups.keys())
     for name in insns:
         for insn in insns[name]:
             group = groups[insn.groupname]
             unused_groups.discard(insn.groupname)
+            insn.cost = insn_cost_class(name)
 
             parsers = set()
             for form in group:
@@ -611,6 +739,27 @@ def output_gas_insns(f):
 def output_nasm_insns(f):
     output_insns(f, "Nasm", nasm_insns)
 
+def output_group_index(f, name, forms):
+    # Candidate forms by mode (BITS!=64, BITS==64) and number of operands,
+    # in original order so the first match still wins.  The first 14
+    # entries are offsets into the index; for mode m and n operands the
+    # candidates are index[index[m*7+n]] up to index[index[m*7+n+1]].
+    header = []
+    candidates = []
+    for misc_flag in ["ONLY_64", "NOT_64"]:
+        for num_operands in range(6):
+            header.append(14 + len(candidates))
+            candidates.extend(i for i, form in enumerate(forms)
+                              if len(form.operands) == num_operands and
+                              misc_flag not in form.misc_flags)
+        header.append(14 + len(candidates))
+    if header[-1] > 255:
+        raise ValueError("index too large for group %s" % name)
+    lprint("static const unsigned char %s_index[] = {" % name, file=f)
+    lprint("    " + ", ".join("%d" % x for x in header) + ",", file=f)
+    lprint("    " + ", ".join("%d" % x for x in candidates), file=f)
+    lprint("};\n", file=f)
+
 def output_groups(f):
     # Merge all operand lists into single list
     # Sort by number of operands to shorten output
@@ -647,10 +796,390 @@ def output_groups(f):
         lprint("   ", end='', file=f)
         lprint(",\n    ".join(str(x) for x in groups[name]), file=f)
         lprint("};\n", file=f)
+        output_group_index(f, name, groups[name])
 
     # Output prefixes
-    for name in sorted(prefixes):
-        lprint(prefixes[name].code_str(), file=f)
+    lprint("static const X86PrefixInfo x86_prefix_info[] = {", file=f)
+    for prefix in sorted(prefixes.values(), key=lambda x: x.index):
+        lprint("    %s" % prefix.code_str(), file=f)
+    lprint("};\n", file=f)
+
+# Disassembler opcode maps: one-byte, 0F, 0F38, 0F3A, and XOP maps 8-A.
+# The decode index has 256 entries (one per opcode byte) for each map.
+disasm_escapes = {(0x0F,): 1, (0x0F, 0x38): 2, (0x0F, 0x3A): 3}
+disasm_xop_maps = {0x08: 4, 0x09: 5, 0x0A: 6}
+num_disasm_maps = 7
+
+# Aliases never chosen for decoding; the preferred name has the same
+# encoding.
+disasm_aliases = set(["sal"])
+
+# Operand kind and value source for each operand type and destination.
+disasm_kinds = {
+    "Reg": "GPR", "RM": "GPR", "Areg": "GPR", "Creg": "GPR", "Dreg": "GPR",
+    "SIMDReg": "SIMD", "SIMDRM": "SIMD", "XMM0": "SIMD",
+    "SegReg": "Seg", "CS": "Seg", "DS": "Seg", "ES": "Seg", "FS": "Seg",
+    "GS": "Seg", "SS": "Seg", "CRReg": "CR", "CR4": "CR", "DRReg": "DR",
+    "TRReg": "TR", "ST0": "ST", "Mem": "Mem", "MemOffs": "MemOffs",
+    "MemXMMIndex": "MemXMMIndex", "MemYMMIndex": "MemYMMIndex",
+    "Imm": "Imm", "ImmNotSegOff": "Imm", "Imm1": "One",
+}
+disasm_fixed_regs = {
+    "Areg": 0, "Creg": 1, "Dreg": 2, "XMM0": 0, "ST0": 0, "CR4": 4,
+    "ES": 0, "CS": 1, "SS": 2, "DS": 3, "FS": 4, "GS": 5,
+}
+disasm_sources = {
+    None: "None", "EA": "EA", "EA64": "EA", "Spare": "Spare",
+    "SpareEA": "Spare", "SpareVEX": "Spare", "EAVEX": "EA", "VEX": "VEX",
+    "VEXImmSrc": "IS4", "VEXImm": "IS4", "Imm": "Imm", "SImm": "Imm",
+    "JmpRel": "Imm", "JmpFar": "Imm", "AdSizeR": "None",
+}
+
+class DisasmOperand(object):
+    def __init__(self, op, opregpos):
+        self.kind = disasm_kinds[op.type]
+        self.source = disasm_sources.get(op.dest)
+        self.num = disasm_fixed_regs.get(op.type, 0)
+        if op.size == "Any":
+            self.size = 0
+        elif op.size == "BITS":
+            self.size = 1
+        else:
+            self.size = op.size
+        if op.dest in ["Op0Add", "Op1Add"]:
+            self.source = opregpos
+        if self.kind == "GPR" and self.size == 80:
+            self.kind = "ST"
+        if self.kind == "Imm":
+            if op.dest == "SImm":
+                self.kind = "SImm"
+            elif op.dest == "JmpRel":
+                self.kind = "Rel"
+                if op.tmod == "Short":
+                    self.size = 8
+            elif op.dest == "JmpFar":
+                self.kind = "Far"
+            self.source = "Imm"
+        if op.dest == "AdSizeR":
+            self.kind = "AdSizeReg"
+        if op.dest == "VEXImm":
+            self.kind = "Imm4"
+
+    def key(self):
+        return (self.kind, self.size, self.source, self.num)
+
+    def __str__(self):
+        return "{DOP_%s, %d, DSRC_%s, %d}" % self.key()
+
+class DisasmInfo(object):
+    def __init__(self, name, features, flags, prefix, opersize, addrsize,
+                 def_opersize_64, modrm, modrm_mask, suffix, operands):
+        self.name = name
+        self.features = features
+        self.flags = flags
+        self.prefix = prefix
+        self.opersize = opersize
+        self.addrsize = addrsize
+        self.def_opersize_64 = def_opersize_64
+        self.modrm = modrm
+        self.modrm_mask = modrm_mask
+        self.suffix = suffix
+        self.operands = operands
+
+    def key(self):
+        return (sorted(self.flags), self.prefix, self.opersize,
+                self.addrsize, self.modrm, self.modrm_mask, self.suffix)
+
+    def score(self):
+        """Specificity; more specific encodings are tried first."""
+        score = 4 * bin(self.modrm_mask).count("1")
+        if self.prefix:
+            score += 64
+        if "SUFFIX" in self.flags:
+            score += 128
+        if self.opersize:
+            score += 2
+        if self.addrsize:
+            score += 2
+        if "MEM" in self.flags:
+            score += 1
+        if "OPREG" in self.flags:
+            score -= 32
+        return score
+
+    def __str__(self):
+        return "{ " + ", ".join([
+            '"%s"' % self.name,
+            '"%s"' % self.features,
+            "|".join("DIS_%s" % x for x in sorted(self.flags)) or "0",
+            "0x%02X" % self.prefix,
+            "%d" % self.opersize,
+            "%d" % self.addrsize,
+            "%d" % self.def_opersize_64,
+            "0x%02X" % self.modrm,
+            "0x%02X" % self.modrm_mask,
+            "0x%02X" % (self.suffix or 0),
+            "%d" % len(self.operands),
+            "%d" % self.operands_index]) + " }"
+
+def disasm_encodings(name, insn, form):
+    """Generate (slot, DisasmInfo) decodings of a form of an instruction."""
+    insn_flags = insn.misc_flags or set()
+    if "ONLY_AVX" in form.misc_flags and "ONLY_AVX" not in insn_flags:
+        return
+    if "NOT_AVX" in form.misc_flags and "ONLY_AVX" in insn_flags:
+        return
+    if form.opcode_len == 0:
+        return      # placeholder for relaxed jumps
+    if form.operands and form.operands[0].dest == "JmpRel" and \
+            form.operands[0].tmod is None:
+        return      # jump size placeholder; real forms are short or near
+    for op in form.operands:
+        if op.type in ["MemrAX", "MemEAX", "MemDX"]:
+            return  # implicit operand; operand-less forms decode these
+
+    # Apply modifiers as BuildGeneral::ApplyModifiers() does.
+    if hasattr(form, "opcode"):
+        opcode = list(form.opcode)
+        alt = None
+    else:
+        opcode = list(form.opcode1) + list(form.opcode2)
+        alt = (len(form.opcode1), len(form.opcode1) + len(form.opcode2))
+    opcode.extend([0] * (3 - len(opcode)))
+    prefix = int(form.special_prefix, 16)
+    vex = 0
+    if (prefix & 0xF0) in [0xC0, 0x80]:
+        vex = prefix
+        prefix = 0
+    spare = form.spare
+    opersize = form.opersize
+    def_opersize_64 = form.def_opersize_64
+    addrsize = 0
+    suffix = None
+    mods = list(insn.modifiers) + [0, 0, 0]
+    for mod, val in zip(form.modifiers, mods):
+        if mod == "PreAdd":
+            prefix += val
+        elif mod == "Op0Add":
+            opcode[0] += val
+        elif mod == "Op1Add":
+            opcode[1] += val
+        elif mod == "Op2Add":
+            opcode[2] += val
+        elif mod == "SpAdd":
+            spare += val
+        elif mod == "OpSizeR":
+            opersize = val
+        elif mod == "Imm8":
+            suffix = val
+        elif mod == "AdSizeR":
+            addrsize = val
+        elif mod == "DOpS64R":
+            def_opersize_64 = val
+        elif mod == "Op1AddSp":
+            opcode[1] += val << 3
+        elif mod == "SetVEX":
+            vex = val
+    opcode = [x & 0xFF for x in opcode]
+    if opersize == 8:
+        opersize = 0
+    if vex and prefix:
+        vex = (vex & ~3) | {0x66: 1, 0xF3: 2, 0xF2: 3}[prefix]
+        prefix = 0
+    if prefix not in [0, 0x66, 0xF2, 0xF3]:
+        return      # e.g. FWAIT-prefixed forms; decoded as two insns
+
+    # Shorthands naming one register for two fields; the full forms decode
+    # the same bytes.
+    dests = [op.dest for op in form.operands]
+    if "SpareEA" in dests:
+        return
+    if vex and ("SpareVEX" in dests or "EAVEX" in dests) and "VEX" not in dests:
+        return
+
+    if vex and opersize == 64:
+        vex |= 0x08     # REX.W is carried in VEX.W
+
+    flags = set()
+    if vex:
+        flags.add((vex & 0xF0) == 0x80 and "XOP" or "VEX")
+        prefix = vex
+    misc_flags = form.misc_flags | insn_flags
+    if "ONLY_64" in misc_flags:
+        flags.add("ONLY_64")
+    if "NOT_64" in misc_flags:
+        flags.add("NOT_64")
+
+    features = set(form.cpu) | set(insn.cpu or [])
+    features = " ".join(sorted(features - set(ordered_cpus)))
+
+    # Try the optimized (sign-extended imm8) form of a two-opcode form
+    # as well; the other "opt" alternatives duplicate other forms.
+    variants = []
+    if alt is None:
+        variants.append((opcode[:form.opcode_len], None))
+    else:
+        variants.append((opcode[:alt[0]], "primary"))
+        if any(op.opt == "SImm8" for op in form.operands):
+            variants.append((opcode[alt[0]:alt[1]], "alt"))
+
+    for ops, variant in variants:
+        operands = list(form.operands)
+        if variant == "primary" and any(op.opt == "SImm8" for op in operands):
+            if len(ops) > 1:
+                continue    # Areg form with fixed ModRM; decoded generally
+            operands = [op.opt == "SImm8" and
+                        Operand(type="Imm", size=8, dest="SImm") or op
+                        for op in operands]
+
+        # Split off the opcode map escape bytes.
+        if vex and (vex & 0xF0) == 0x80:
+            mapnum = disasm_xop_maps[ops[0]]
+            nesc = 1
+        elif len(ops) > 2 and tuple(ops[0:2]) in disasm_escapes:
+            mapnum = disasm_escapes[tuple(ops[0:2])]
+            nesc = 2
+        elif len(ops) > 1 and ops[0] == 0x0F:
+            mapnum = 1
+            nesc = 1
+        else:
+            mapnum = 0
+            nesc = 0
+        if vex and mapnum == 0:
+            raise ValueError("VEX opcode without escape in %s" % name)
+        rest = ops[nesc:]
+        if len(rest) > 2:
+            continue    # FWAIT-prefixed x87; decoded as two insns
+
+        modrm = 0
+        modrm_mask = 0
+        fl = set(flags)
+        if len(rest) > 1:
+            # Last opcode byte is a fixed ModRM byte.
+            modrm = rest[1]
+            modrm_mask = 0xFF
+            fl.add("MODRM")
+
+        dops = []
+        adsize = addrsize
+        for op in operands:
+            if op.dest == "AdSizeR":
+                adsize = op.size
+            opregpos = None
+            if op.dest in ["Op0Add", "Op1Add"]:
+                pos = int(op.dest[2]) - nesc
+                if pos == 0:
+                    opregpos = "OpReg"
+                    fl.add("OPREG")
+                elif pos == 1 and modrm_mask == 0xFF:
+                    opregpos = "EA"
+                    modrm_mask = 0xF8
+                else:
+                    raise ValueError("bad register position in %s" % name)
+            if (op.dest in ["Spare", "SpareEA", "SpareVEX", "EAVEX"] or
+                (op.dest == "EA" and
+                 op.type not in ["Imm", "ImmNotSegOff", "MemOffs"])):
+                fl.add("MODRM")
+            if op.type in ["Mem", "MemXMMIndex", "MemYMMIndex"]:
+                fl.add("MEM")
+            elif (op.dest in ["EA", "EAVEX", "SpareEA"] and
+                  op.type not in ["RM", "SIMDRM", "Imm", "ImmNotSegOff",
+                                  "MemOffs"]):
+                modrm |= 0xC0
+                modrm_mask |= 0xC0
+            dop = DisasmOperand(op, opregpos)
+            if insn.groupname == "lea" and op.dest == "EA":
+                dop.size = 0    # only the address is used
+            dops.append(dop)
+
+        # SETcc ignores the spare field; yasm just emits 2 there.
+        if "MODRM" in fl and modrm_mask != 0xFF and not any(
+                op.dest in ["Spare", "SpareEA", "SpareVEX"]
+                for op in operands) and insn.groupname != "setcc":
+            modrm |= (spare & 7) << 3
+            modrm_mask |= 0x38
+        if suffix is not None:
+            fl.add("SUFFIX")
+
+        slots = [mapnum*256 + rest[0]]
+        if "OPREG" in fl:
+            slots = [mapnum*256 + (rest[0] & ~7) + i for i in range(8)]
+        for slot in slots:
+            yield slot, DisasmInfo(name, features, fl, prefix, opersize,
+                                   adsize, def_opersize_64 or 0, modrm,
+                                   modrm_mask, suffix, dops)
+
+def output_disasm(f):
+    # Gather decodings in order of NASM keyword, dropping any with the
+    # same encoding as an earlier one.
+    slots = [[] for i in range(num_disasm_maps*256)]
+    seen = set()
+    order = 0
+    for name in sorted(nasm_insns):
+        insn = nasm_insns[name]
+        if not isinstance(insn, Insn) or name in disasm_aliases:
+            continue
+        for form in groups[insn.groupname]:
+            if "nasm" not in form.parsers:
+                continue
+            for slot, info in disasm_encodings(name, insn, form):
+                key = (slot,) + tuple(repr(x) for x in info.key())
+                if key in seen:
+                    continue
+                seen.add(key)
+                slots[slot].append((-info.score(), order, info))
+                order += 1
+
+    # Decodings with no instruction to assemble them: the hint NOPs
+    # (0F 19-1F /r), used for code fill, and the CET branch markers.
+    rm = DisasmOperand(Operand(type="RM", size="BITS", dest="EA"), None)
+    for opcode in range(0x19, 0x20):
+        nop = DisasmInfo("nop", "", set(["MODRM"]), 0, 0, 0, 0, 0x00, 0x00,
+                         None, [rm])
+        slots[1*256+opcode].append((-nop.score(), order, nop))
+    for name, modrm in [("endbr64", 0xFA), ("endbr32", 0xFB)]:
+        endbr = DisasmInfo(name, "", set(["MODRM"]), 0xF3, 0, 0, 0, modrm,
+                           0xFF, None, [])
+        slots[1*256+0x1E].append((-endbr.score(), order, endbr))
+
+    # Merge operand lists
+    all_operands = []
+    operands_index = {}
+    infos = []
+    for slot in slots:
+        slot.sort(key=lambda x: x[:2])
+        for score, order, info in slot:
+            key = tuple(op.key() for op in info.operands)
+            if key not in operands_index:
+                operands_index[key] = len(all_operands)
+                all_operands.extend(info.operands)
+            info.operands_index = operands_index[key]
+            infos.append(info)
+
+    lprint("// Generated by %s, do not edit" % scriptname, file=f)
+    lprint("static const X86DisasmOperand disasm_operands[] = {", file=f)
+    lprint("   ", end='', file=f)
+    lprint(",\n    ".join(str(x) for x in all_operands), file=f)
+    lprint("};\n", file=f)
+
+    lprint("static const X86DisasmInfo disasm_info[] = {", file=f)
+    lprint("   ", end='', file=f)
+    lprint(",\n    ".join(str(x) for x in infos), file=f)
+    lprint("};\n", file=f)
+
+    # Index of first decoding for each map and opcode byte; the last entry
+    # is the total.
+    lprint("static const unsigned short disasm_index[] = {", file=f)
+    index = []
+    total = 0
+    for slot in slots:
+        index.append(total)
+        total += len(slot)
+    index.append(total)
+    for i in range(0, len(index), 12):
+        lprint("    " + ", ".join("%d" % x for x in index[i:i+12]) + ",",
+               file=f)
+    lprint("};\n", file=f)
 
 #####################################################################
 # General instruction groupings
@@ -8548,10 +9077,12 @@ for val, suf in enumerate(["", "z", "y", "yz", "x", "xz", "xy", "xyz"]):
 #####################################################################
 
 if __name__ == "__main__":
-    if len(sys.argv) != 4:
+    if len(sys.argv) != 5:
         lprint("Usage: gen_x86_insn.py <x86insns.cpp>", file=sys.stderr)
         lprint("    <x86insn_gas.gperf> <x86insn_nasm.gperf>", file=sys.stderr)
+        lprint("    <x86disasm.cpp>", file=sys.stderr)
         sys.exit(2)
     output_groups(open(sys.argv[1], "wt"))
     output_gas_insns(open(sys.argv[2], "wt"))
     output_nasm_insns(open(sys.argv[3], "wt"))
+    output_disasm(open(sys.argv[4], "wt"))
@@ -0,0 +1,181 @@
+//
+// CodeView debugging format
+//
+//  Copyright (C) 2006-2007  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include "CvDebug.h"
+
+#include "yasmx/Config/functional.h"
+#include "yasmx/Support/ThreadPool.h"
+#include "yasmx/Support/registry.h"
+#include "yasmx/Arch.h"
+#include "yasmx/Bytecode.h"
+#include "yasmx/Bytes_util.h"
+#include "yasmx/Expr.h"
+#include "yasmx/Object.h"
+#include "yasmx/ObjectFormat.h"
+#include "yasmx/Section.h"
+#include "yasmx/Value.h"
+
+#include "CvTypes.h"
+
+
+using namespace yasm;
+using namespace yasm::dbgfmt;
+
+CvRecords::CvRecords()
+{
+    m_bytes.setLittleEndian();
+}
+
+CvRecords::~CvRecords()
+{
+}
+
+void
+CvRecords::AppendSecRel(SymbolRef sym, unsigned long offset)
+{
+    Fixup fixup = { m_bytes.size(), sym, offset, false };
+    m_fixups.push_back(fixup);
+    Write32(m_bytes, 0);
+}
+
+void
+CvRecords::AppendSection(SymbolRef sym)
+{
+    Fixup fixup = { m_bytes.size(), sym, 0, true };
+    m_fixups.push_back(fixup);
+    Write16(m_bytes, 0);
+}
+
+void
+CvRecords::Output(Bytecode& bc) const
+{
+    Bytes& fixed = bc.getFixed();
+    Bytes::const_iterator pos = m_bytes.begin();
+    for (std::vector<Fixup>::const_iterator i=m_fixups.begin(),
+         end=m_fixups.end(); i != end; ++i)
+    {
+        fixed.insert(fixed.end(), pos, m_bytes.begin()+i->pos);
+
+        Expr::Ptr e(new Expr(i->sym));
+        if (i->section)
+        {
+            e->Calc(Op::SEG);
+            bc.AppendFixed(2, e, SourceLocation());
+            pos = m_bytes.begin()+i->pos+2;
+        }
+        else
+        {
+            if (i->offset != 0)
+                e->Calc(Op::ADD, i->offset);
+            bc.AppendFixed(4, e, SourceLocation()).setSectionRelative();
+            pos = m_bytes.begin()+i->pos+4;
+        }
+    }
+    fixed.insert(fixed.end(), pos, m_bytes.end());
+}
+
+CvDebug::CvDebug(const DebugFormatModule& module, Object& object)
+    : DebugFormat(module, object)
+    , m_smgr(0)
+{
+    // Line numbers come from where each source line's output starts.
+    object.setMarkLines(true);
+}
+
+CvDebug::~CvDebug()
+{
+}
+
+bool
+CvDebug::isOkObject(Object& object)
+{
+    Arch* arch = object.getArch();
+    if (!arch->getModule().getKeyword().equals_lower("x86"))
+        return false;
+    return arch->getMachine().equals_lower("x86") ||
+           arch->getMachine().equals_lower("amd64");
+}
+
+void
+CvDebug::GeneratePart(unsigned int part)
+{
+    switch (part)
+    {
+        case 0: GenerateLines(m_lines); break;
+        case 1: GenerateSymbols(m_symbols); break;
+        case 2: GenerateTypes(m_types); break;
+    }
+}
+
+static Section&
+getDebugSection(ObjectFormat& objfmt,
+                Object& object,
+                StringRef name,
+                DiagnosticsEngine& diags)
+{
+    Section* sect = object.FindSection(name);
+    if (!sect)
+        sect = objfmt.AppendSection(name, SourceLocation(), diags);
+    sect->setAlign(1);
+    return *sect;
+}
+
+void
+CvDebug::Generate(ObjectFormat& objfmt,
+                  SourceManager& smgr,
+                  DiagnosticsEngine& diags)
+{
+    // The parts only read the object, and only the line numbers use the
+    // source manager, so they can be built concurrently.  They're then
+    // appended to the sections in order on this thread.
+    m_smgr = &smgr;
+    ThreadPool pool(m_object.getConfig().NumJobs);
+    pool.Run(3, TR1::bind(&CvDebug::GeneratePart, this, _1));
+
+    Section& debug_s = getDebugSection(objfmt, m_object, ".debug$S", diags);
+    Bytecode& sbc = debug_s.FreshBytecode();
+    sbc.getFixed().setLittleEndian();
+    Write32(sbc.getFixed(), CV8_SIGNATURE);
+    m_lines.Output(sbc);
+    m_symbols.Output(sbc);
+    debug_s.Finalize(diags);
+    debug_s.Optimize(diags);
+
+    Section& debug_t = getDebugSection(objfmt, m_object, ".debug$T", diags);
+    Bytecode& tbc = debug_t.FreshBytecode();
+    tbc.getFixed().setLittleEndian();
+    Write32(tbc.getFixed(), CV8_SIGNATURE);
+    m_types.Output(tbc);
+    debug_t.Finalize(diags);
+    debug_t.Optimize(diags);
+}
+
+extern const yasm::impl::ModuleEntry yasm_dbgfmt_codeview_modules[] =
+{
+    YASM_MODULE_ENTRY(DebugFormatModule,
+                      DebugFormatModuleImpl<CvDebug>, "cv8"),
+    YASM_MODULE_TABLE_END
+};
@@ -0,0 +1,120 @@
+#ifndef YASM_CVDEBUG_H
+#define YASM_CVDEBUG_H
+//
+// CodeView debugging format
+//
+//  Copyright (C) 2006-2007  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include <vector>
+
+#include "yasmx/Config/export.h"
+#include "yasmx/Bytes.h"
+#include "yasmx/DebugFormat.h"
+#include "yasmx/SymbolRef.h"
+
+
+namespace yasm
+{
+class Bytecode;
+
+namespace dbgfmt
+{
+
+/// CodeView record data, plus the section-relative offsets and section
+/// indexes within it that need relocations.  Records are built into this
+/// rather than directly into a section, so they can be built on any thread.
+class YASM_STD_EXPORT CvRecords
+{
+public:
+    CvRecords();
+    ~CvRecords();
+
+    Bytes& getBytes() { return m_bytes; }
+
+    /// Append a 32-bit offset of a location relative to the start of its
+    /// section (SECREL).
+    /// @param sym      section start symbol
+    /// @param offset   offset from sym
+    void AppendSecRel(SymbolRef sym, unsigned long offset);
+
+    /// Append the 16-bit section index of a symbol (SECTION).
+    /// @param sym      section start symbol
+    void AppendSection(SymbolRef sym);
+
+    /// Append the data and relocations to a bytecode.
+    /// @param bc       bytecode
+    void Output(Bytecode& bc) const;
+
+private:
+    struct Fixup
+    {
+        Bytes::size_type pos;
+        SymbolRef sym;
+        unsigned long offset;
+        bool section;           ///< Section index rather than SECREL
+    };
+
+    Bytes m_bytes;
+    std::vector<Fixup> m_fixups;
+};
+
+/// CodeView 8 (Visual Studio 2005 and later) debugging format.  Generates
+/// line numbers for the assembly source and symbols for its labels into
+/// .debug$S, and a minimal type table into .debug$T.
+class YASM_STD_EXPORT CvDebug : public DebugFormat
+{
+public:
+    CvDebug(const DebugFormatModule& module, Object& object);
+    ~CvDebug();
+
+    static StringRef getName() { return "CodeView debugging format for VC8"; }
+    static StringRef getKeyword() { return "cv8"; }
+    static bool isOkObject(Object& object);
+
+    void Generate(ObjectFormat& objfmt,
+                  SourceManager& smgr,
+                  DiagnosticsEngine& diags);
+
+    /// Build the records of one part of the debug information.
+    /// @param part     part to build (see Generate())
+    void GeneratePart(unsigned int part);
+
+private:
+    // CvDebug_type.cpp
+    void GenerateTypes(CvRecords& out);
+
+    // CvDebug_symline.cpp
+    void GenerateSymbols(CvRecords& out);
+    void GenerateLines(CvRecords& out);
+
+    /*@null@*/ SourceManager* m_smgr;
+
+    CvRecords m_types;          ///< .debug$T records
+    CvRecords m_symbols;        ///< .debug$S symbol subsection
+    CvRecords m_lines;          ///< .debug$S file and line subsections
+};
+
+}} // namespace yasm::dbgfmt
+
+#endif
@@ -0,0 +1,389 @@
+//
+// CodeView debugging format - symbol and line information
+//
+//  Copyright (C) 2006-2007  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include "CvDebug.h"
+
+#include <cstdlib>
+#include <vector>
+
+#include "config.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/PathV2.h"
+#include "yasmx/Basic/FileManager.h"
+#include "yasmx/Basic/SourceManager.h"
+#include "yasmx/Support/MD5.h"
+#include "yasmx/Arch.h"
+#include "yasmx/Bytecode.h"
+#include "yasmx/Bytes_util.h"
+#include "yasmx/Location.h"
+#include "yasmx/Object.h"
+#include "yasmx/Section.h"
+#include "yasmx/Symbol.h"
+
+#include "CvTypes.h"
+
+
+using namespace yasm;
+using namespace yasm::dbgfmt;
+
+namespace {
+// A line table row.  Rows are kept by value, one per source line with
+// output, and written out in one pass per section.
+struct CvLine
+{
+    unsigned long offset;   // offset from start of section
+    unsigned long line;     // line number
+    unsigned int file;      // index into file table
+};
+
+struct CvFile
+{
+    std::string name;
+    unsigned long str_offset;       // offset in string table
+    unsigned long info_offset;      // offset in file info subsection
+    bool has_md5;
+    unsigned char md5[16];
+};
+} // anonymous namespace
+
+static inline void
+Patch32(Bytes& bytes, Bytes::size_type pos, unsigned long val)
+{
+    bytes[pos] = val & 0xff;
+    bytes[pos+1] = (val >> 8) & 0xff;
+    bytes[pos+2] = (val >> 16) & 0xff;
+    bytes[pos+3] = (val >> 24) & 0xff;
+}
+
+// Start a .debug$S subsection; returns the position of its length.
+static Bytes::size_type
+BeginSubsection(Bytes& bytes, unsigned long type)
+{
+    Write32(bytes, type);
+    Bytes::size_type head = bytes.size();
+    Write32(bytes, 0);          // length (following this field)
+    return head;
+}
+
+// Finish a .debug$S subsection: fill in its length (which doesn't include
+// padding) and pad to a 4-byte boundary.
+static void
+EndSubsection(Bytes& bytes, Bytes::size_type head)
+{
+    Patch32(bytes, head, bytes.size() - head - 4);
+    while (bytes.size() & 3)
+        Write8(bytes, 0);
+}
+
+// Start a symbol record; returns the position of its length.
+static Bytes::size_type
+BeginSymbol(Bytes& bytes, unsigned int type)
+{
+    Bytes::size_type head = bytes.size();
+    Write16(bytes, 0);          // length (following this field)
+    Write16(bytes, type);
+    return head;
+}
+
+static void
+EndSymbol(Bytes& bytes, Bytes::size_type head)
+{
+    unsigned long len = bytes.size() - head - 2;
+    bytes[head] = len & 0xff;
+    bytes[head+1] = (len >> 8) & 0xff;
+}
+
+static void
+WriteName(Bytes& bytes, StringRef name)
+{
+    bytes.WriteString(name);
+    Write8(bytes, 0);
+}
+
+// Get an absolute path; CodeView consumers expect full paths.  The test
+// suite gets just the file name, so its output doesn't depend on where
+// it's run.
+static std::string
+getAbsolutePath(StringRef path)
+{
+    if (std::getenv("YASM_TEST_SUITE"))
+        return llvm::sys::path::filename(path);
+    SmallString<256> abspath(path);
+    if (llvm::sys::fs::make_absolute(abspath))
+        return path;
+    return abspath.str();
+}
+
+// Get the MD5 digest of a source file.  Only files the source manager has
+// already read are considered.
+static bool
+getFileMD5(SourceManager& smgr, StringRef path, unsigned char digest[16])
+{
+    const FileEntry* file = smgr.getFileManager().getFile(path);
+    if (!file || !smgr.hasFileInfo(file))
+        return false;
+    bool invalid = false;
+    const llvm::MemoryBuffer* buf = smgr.getMemoryBufferForFile(file, &invalid);
+    if (invalid || !buf)
+        return false;
+
+    MD5 md5;
+    md5.Update(reinterpret_cast<const unsigned char*>(buf->getBufferStart()),
+               buf->getBufferSize());
+    md5.Final(digest);
+    return true;
+}
+
+void
+CvDebug::GenerateLines(CvRecords& out)
+{
+    SourceManager& smgr = *m_smgr;
+    SourceLineCursor cursor(smgr);
+
+    // Collect the rows of each code section, numbering files as they're
+    // first seen.
+    std::vector<CvFile> files;
+    llvm::StringMap<unsigned int> file_index;
+    std::vector<std::pair<Section*, std::vector<CvLine> > > sections;
+
+    for (Object::section_iterator sect=m_object.sections_begin(),
+         sect_end=m_object.sections_end(); sect != sect_end; ++sect)
+    {
+        if (!sect->isCode() || sect->lines_begin() == sect->lines_end())
+            continue;
+        unsigned long size = sect->bytecodes_back().getNextOffset();
+
+        sections.push_back(std::make_pair(&*sect, std::vector<CvLine>()));
+        std::vector<CvLine>& rows = sections.back().second;
+
+        const char* last_filename = 0;
+        unsigned int file = 0;
+        for (BytecodeContainer::const_line_iterator i=sect->lines_begin(),
+             end=sect->lines_end(); i != end; ++i)
+        {
+            unsigned long offset = i->bc->getOffset() + i->offset;
+            if (offset >= size)
+                break;
+            PresumedLoc ploc = cursor.getPresumedLoc(i->source);
+            if (ploc.isInvalid())
+                continue;
+
+            if (ploc.getFilename() != last_filename)
+            {
+                last_filename = ploc.getFilename();
+                llvm::StringMapEntry<unsigned int>& entry =
+                    file_index.GetOrCreateValue(last_filename, files.size());
+                file = entry.getValue();
+                if (file == files.size())
+                {
+                    files.push_back(CvFile());
+                    files.back().name = getAbsolutePath(last_filename);
+                    files.back().has_md5 =
+                        getFileMD5(smgr, last_filename, files.back().md5);
+                }
+            }
+
+            CvLine row = { offset, ploc.getLine(), file };
+            if (!rows.empty())
+            {
+                CvLine& last = rows.back();
+                if (last.file == row.file && last.line == row.line)
+                    continue;
+                // Replace a line that turned out to have no output.
+                if (last.offset == row.offset)
+                {
+                    last = row;
+                    continue;
+                }
+            }
+            rows.push_back(row);
+        }
+    }
+
+    if (sections.empty())
+        return;
+
+    Bytes& bytes = out.getBytes();
+
+    // Filename string table
+    Bytes::size_type head = BeginSubsection(bytes, CV8_FILE_STRTAB);
+    Write8(bytes, 0);
+    for (std::vector<CvFile>::iterator i=files.begin(), end=files.end();
+         i != end; ++i)
+    {
+        i->str_offset = bytes.size() - head - 4;
+        WriteName(bytes, i->name);
+    }
+    EndSubsection(bytes, head);
+
+    // File info (checksums)
+    head = BeginSubsection(bytes, CV8_FILE_INFO);
+    for (std::vector<CvFile>::iterator i=files.begin(), end=files.end();
+         i != end; ++i)
+    {
+        i->info_offset = bytes.size() - head - 4;
+        Write32(bytes, i->str_offset);
+        if (i->has_md5)
+        {
+            Write8(bytes, 16);
+            Write8(bytes, CV8_CHECKSUM_MD5);
+            bytes.Write(ArrayRef<unsigned char>(i->md5, 16));
+        }
+        else
+        {
+            Write8(bytes, 0);
+            Write8(bytes, CV8_CHECKSUM_NONE);
+        }
+        while ((bytes.size() - head - 4) & 3)
+            Write8(bytes, 0);
+    }
+    EndSubsection(bytes, head);
+
+    // Line numbers; one subsection per section, with a block of rows for
+    // each run of rows from the same file.
+    for (std::vector<std::pair<Section*, std::vector<CvLine> > >::iterator
+         i=sections.begin(), end=sections.end(); i != end; ++i)
+    {
+        Section& sect = *i->first;
+        const std::vector<CvLine>& rows = i->second;
+        if (rows.empty())
+            continue;
+
+        head = BeginSubsection(bytes, CV8_LINE_NUMS);
+        out.AppendSecRel(sect.getSymbol(), 0);
+        out.AppendSection(sect.getSymbol());
+        Write16(bytes, 0);          // flags
+        Write32(bytes, sect.bytecodes_back().getNextOffset());
+
+        bytes.reserve(bytes.size() + rows.size()*8 + 12);
+        Bytes::size_type block = 0;
+        unsigned long count = 0;
+        for (std::vector<CvLine>::const_iterator row=rows.begin(),
+             rows_end=rows.end(); row != rows_end; ++row)
+        {
+            if (row == rows.begin() || row->file != row[-1].file)
+            {
+                if (row != rows.begin())
+                {
+                    Patch32(bytes, block+4, count);
+                    Patch32(bytes, block+8, 12 + count*8);
+                }
+                block = bytes.size();
+                count = 0;
+                Write32(bytes, files[row->file].info_offset);
+                Write32(bytes, 0);  // number of rows
+                Write32(bytes, 0);  // size of block
+            }
+            Write32(bytes, row->offset);
+            Write32(bytes, row->line | CV8_LINE_STATEMENT);
+            ++count;
+        }
+        Patch32(bytes, block+4, count);
+        Patch32(bytes, block+8, 12 + count*8);
+        EndSubsection(bytes, head);
+    }
+}
+
+// Parse the assembler version for S_COMPILE2 (zero in the test suite).
+static void
+getVersion(unsigned int ver[3])
+{
+    const char* s = std::getenv("YASM_TEST_SUITE") ? "" : PACKAGE_VERSION;
+    for (int i=0; i<3; ++i)
+    {
+        ver[i] = 0;
+        while (*s >= '0' && *s <= '9')
+            ver[i] = ver[i]*10 + (*s++ - '0');
+        if (*s == '.')
+            ++s;
+    }
+}
+
+void
+CvDebug::GenerateSymbols(CvRecords& out)
+{
+    Bytes& bytes = out.getBytes();
+    Bytes::size_type head = BeginSubsection(bytes, CV8_DEBUG_SYMS);
+
+    // Object file name
+    Bytes::size_type sym = BeginSymbol(bytes, CV8_S_OBJNAME);
+    Write32(bytes, 0);              // signature
+    WriteName(bytes, getAbsolutePath(m_object.getObjectFilename()));
+    EndSymbol(bytes, sym);
+
+    // Assembler information
+    unsigned int ver[3];
+    getVersion(ver);
+    sym = BeginSymbol(bytes, CV8_S_COMPILE2);
+    Write32(bytes, CV_CFL_MASM);    // flags (source language)
+    Write16(bytes, m_object.getArch()->getMachine().equals_lower("amd64") ?
+            CV_CFL_AMD64 : CV_CFL_80386);
+    for (int i=0; i<3; ++i)
+        Write16(bytes, ver[i]);     // front end version
+    for (int i=0; i<3; ++i)
+        Write16(bytes, ver[i]);     // back end version
+    WriteName(bytes, std::getenv("YASM_TEST_SUITE") ?
+              PACKAGE_NAME : PACKAGE_NAME " " PACKAGE_VERSION);
+    Write8(bytes, 0);               // end of (empty) string list
+    EndSymbol(bytes, sym);
+
+    // Labels.  Names starting with "." are generally generated (e.g.
+    // section names or local labels), so leave them out.
+    for (Object::symbol_iterator i=m_object.symbols_begin(),
+         end=m_object.symbols_end(); i != end; ++i)
+    {
+        Location loc;
+        StringRef name = i->getName();
+        if (name.empty() || name[0] == '.' || !i->getLabel(&loc))
+            continue;
+        Section* sect = loc.bc->getContainer()->getSection();
+        if (!sect || !sect->getSymbol())
+            continue;
+
+        if (sect->isCode())
+        {
+            sym = BeginSymbol(bytes, CV8_S_LABEL32);
+            out.AppendSecRel(sect->getSymbol(), loc.getOffset());
+            out.AppendSection(sect->getSymbol());
+            Write8(bytes, 0);       // flags
+        }
+        else
+        {
+            sym = BeginSymbol(bytes, (i->getVisibility() & Symbol::GLOBAL) ?
+                              CV8_S_GDATA32 : CV8_S_LDATA32);
+            Write32(bytes, CV_T_UCHAR);
+            out.AppendSecRel(sect->getSymbol(), loc.getOffset());
+            out.AppendSection(sect->getSymbol());
+        }
+        WriteName(bytes, name);
+        EndSymbol(bytes, sym);
+    }
+
+    EndSubsection(bytes, head);
+}
@@ -0,0 +1,77 @@
+//
+// CodeView debugging format - type information
+//
+//  Copyright (C) 2006-2007  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include "CvDebug.h"
+
+#include "yasmx/Bytes_util.h"
+
+#include "CvTypes.h"
+
+
+using namespace yasm;
+using namespace yasm::dbgfmt;
+
+// Start a type record; returns the position of its length.
+static Bytes::size_type
+BeginLeaf(Bytes& bytes, unsigned int leaf)
+{
+    Bytes::size_type head = bytes.size();
+    Write16(bytes, 0);          // length (following this field)
+    Write16(bytes, leaf);
+    return head;
+}
+
+// Finish a type record: pad to a 4-byte boundary with LF_PADn bytes and
+// fill in its length.
+static void
+EndLeaf(Bytes& bytes, Bytes::size_type head)
+{
+    while ((bytes.size() - head) & 3)
+        Write8(bytes, CV_LF_PAD0 + (4 - ((bytes.size() - head) & 3)));
+    unsigned long len = bytes.size() - head - 2;
+    bytes[head] = len & 0xff;
+    bytes[head+1] = (len >> 8) & 0xff;
+}
+
+void
+CvDebug::GenerateTypes(CvRecords& out)
+{
+    Bytes& bytes = out.getBytes();
+
+    // CV_FIRST_TYPE: empty argument list
+    Bytes::size_type head = BeginLeaf(bytes, CV_LF_ARGLIST);
+    Write32(bytes, 0);          // argument count
+    EndLeaf(bytes, head);
+
+    // CV_FIRST_TYPE+1: void procedure taking no arguments
+    head = BeginLeaf(bytes, CV_LF_PROCEDURE);
+    Write32(bytes, CV_T_VOID);  // return type
+    Write8(bytes, 0);           // calling convention (near C)
+    Write8(bytes, 0);           // attributes
+    Write16(bytes, 0);          // parameter count
+    Write32(bytes, CV_FIRST_TYPE);  // argument list type
+    EndLeaf(bytes, head);
+}
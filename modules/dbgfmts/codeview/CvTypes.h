@@ -0,0 +1,92 @@
+#ifndef YASM_CVTYPES_H
+#define YASM_CVTYPES_H
+//
+// CodeView debugging format - constants
+//
+//  Copyright (C) 2006-2007  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+namespace yasm {
+namespace dbgfmt {
+
+/// .debug$S and .debug$T signature
+enum { CV8_SIGNATURE = 4 };
+
+// .debug$S subsection types
+enum Cv8Subsection
+{
+    CV8_DEBUG_SYMS = 0xF1,
+    CV8_LINE_NUMS = 0xF2,
+    CV8_FILE_STRTAB = 0xF3,
+    CV8_FILE_INFO = 0xF4
+};
+
+// File checksum types
+enum Cv8Checksum
+{
+    CV8_CHECKSUM_NONE = 0,
+    CV8_CHECKSUM_MD5 = 1
+};
+
+// Line number flags
+enum { CV8_LINE_STATEMENT = 0x80000000UL };
+
+// Symbol record types
+enum Cv8Symbol
+{
+    CV8_S_OBJNAME = 0x1101,
+    CV8_S_LABEL32 = 0x1105,
+    CV8_S_LDATA32 = 0x110C,
+    CV8_S_GDATA32 = 0x110D,
+    CV8_S_COMPILE2 = 0x1116
+};
+
+// S_COMPILE2 source language and target machine
+enum Cv8Compile
+{
+    CV_CFL_MASM = 0x03,
+    CV_CFL_80386 = 0x03,
+    CV_CFL_AMD64 = 0xD0
+};
+
+// Type record (leaf) types
+enum CvLeaf
+{
+    CV_LF_PROCEDURE = 0x1008,
+    CV_LF_ARGLIST = 0x1201,
+    CV_LF_PAD0 = 0xF0
+};
+
+// Primitive types
+enum CvPrimitiveType
+{
+    CV_T_VOID = 0x0003,
+    CV_T_UCHAR = 0x0020
+};
+
+/// First type index of a type table
+enum { CV_FIRST_TYPE = 0x1000 };
+
+}} // namespace yasm::dbgfmt
+
+#endif
@@ -26,6 +26,11 @@
 //
 #include "DwarfCfi.h"
 
+#include <algorithm>
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/raw_ostream.h"
 #include "yasmx/Basic/Diagnostic.h"
 #include "yasmx/Parse/Directive.h"
 #include "yasmx/Parse/DirHelpers.h"
@@ -49,6 +54,11 @@ using namespace yasm::dbgfmt;
 #define DW_OP_addr      0x03
 #define DW_OP_GNU_encoded_addr 0xf1
 
+// Mach-O x86-64 compact unwind encoding
+#define UNWIND_X86_64_MODE_RBP_FRAME    0x01000000UL
+#define UNWIND_X86_64_MODE_STACK_IMMD   0x02000000UL
+#define UNWIND_X86_64_MODE_DWARF        0x04000000UL
+
 namespace
 {
 
@@ -76,67 +86,44 @@ enum DwarfCfiPersonality
     DW_EH_PE_indirect = 0x80
 };
 
-class IsFdeMatch
-{
-public:
-    IsFdeMatch(const DwarfCfiFde& fde) : m_fde(fde) {}
-    bool operator() (const DwarfCfiCie& fde);
-private:
-    const DwarfCfiFde& m_fde;
-};
-
 } // anonymous namespace
 
-bool
-IsFdeMatch::operator() (const DwarfCfiCie& cie)
+// Build the key under which a CIE made from this FDE is indexed.  An FDE
+// can share a CIE when the header fields match and the CIE initial
+// instructions are exactly the instructions the FDE has before its first
+// advance_loc, remember_state, escape, or val_encoded_addr (the same
+// prefix DwarfCfiCie takes).  Returns false if the FDE can never share
+// a CIE.
+static bool
+getCieKey(const DwarfCfiFde& fde, SmallVectorImpl<char>& key)
 {
-    if (cie.m_fde->m_personality_encoding != m_fde.m_personality_encoding ||
-        cie.m_fde->m_lsda_encoding != m_fde.m_lsda_encoding ||
-        cie.m_fde->m_return_column != m_fde.m_return_column ||
-        cie.m_fde->m_signal_frame != m_fde.m_signal_frame)
-        return false;
-
-    if (cie.m_fde->m_personality_encoding != DW_EH_PE_omit)
-    {
-        // check for equal personality
-    }
-
-    // check for commonality in instructions
-    stdx::ptr_vector<DwarfCfiInsn>::const_iterator
-         lhs = cie.m_fde->m_insns.begin(),
-         lhsend = cie.m_fde->m_insns.begin() + cie.m_num_insns,
-         rhs = m_fde.m_insns.begin(),
-         rhsend = m_fde.m_insns.end();
-    for (; lhs != lhsend && rhs != rhsend; ++lhs, ++rhs)
+    key.clear();
+    llvm::raw_svector_ostream os(key);
+    os << static_cast<unsigned int>(fde.m_personality_encoding) << ','
+       << static_cast<unsigned int>(fde.m_lsda_encoding) << ','
+       << fde.m_return_column << ','
+       << (fde.m_signal_frame ? 1 : 0) << ';';
+
+    for (DwarfCfiFde::Insns::const_iterator
+         i = fde.m_insns.begin(), end = fde.m_insns.end(); i != end; ++i)
     {
-        switch (lhs->getOp())
+        switch (i->getOp())
         {
             case DwarfCfiInsn::DW_CFA_advance_loc:
             case DwarfCfiInsn::DW_CFA_remember_state:
             case DwarfCfiInsn::CFI_escape:
             case DwarfCfiInsn::CFI_val_encoded_addr:
-                // should have reached end of CIE list first
-                return false;
+                os.flush();
+                return true;
             default:
-                if (*lhs != *rhs)
+                if (!i->WriteKey(os))
                     return false;
+                os << ';';
                 break;
         }
     }
-    if (lhs != lhsend)
-        return false;
-    if (rhs == rhsend)
-        return true;
-    switch (rhs->getOp())
-    {
-        case DwarfCfiInsn::DW_CFA_advance_loc:
-        case DwarfCfiInsn::DW_CFA_remember_state:
-        case DwarfCfiInsn::CFI_escape:
-        case DwarfCfiInsn::CFI_val_encoded_addr:
-            return true;
-        default:
-            return false;
-    }
+    os.flush();
+    return true;
 }
 
 static unsigned int
@@ -204,105 +191,199 @@ DwarfCfiInsn::operator== (const DwarfCfiInsn& oth) const
     }
 }
 
-DwarfCfiInsn*
+bool
+DwarfCfiInsn::WriteKey(raw_ostream& os) const
+{
+    // Must be kept consistent with operator==.
+    os << static_cast<unsigned int>(m_op) << ',';
+    switch (m_op)
+    {
+        case DW_CFA_advance_loc:
+        case DW_CFA_set_loc:
+        case DW_CFA_advance_loc1:
+        case DW_CFA_advance_loc2:
+        case DW_CFA_advance_loc4:
+            os << static_cast<const void*>(m_from.bc) << ',' << m_from.off
+               << ',' << static_cast<const void*>(m_to.bc) << ',' << m_to.off;
+            return true;
+        case DW_CFA_offset:
+        case DW_CFA_offset_extended:
+        case DW_CFA_offset_extended_sf:
+        case DW_CFA_def_cfa:
+        case DW_CFA_def_cfa_sf:
+            os << m_regs[0] << ',' << m_off;
+            return true;
+        case DW_CFA_nop:
+        case DW_CFA_remember_state:
+        case DW_CFA_restore_state:
+        case DW_CFA_GNU_window_save:
+            return true;
+        case DW_CFA_restore:
+        case DW_CFA_restore_extended:
+        case DW_CFA_undefined:
+        case DW_CFA_same_value:
+        case DW_CFA_def_cfa_register:
+            os << m_regs[0];
+            return true;
+        case DW_CFA_register:
+            os << m_regs[0] << ',' << m_regs[1];
+            return true;
+        case DW_CFA_def_cfa_offset:
+        case DW_CFA_def_cfa_offset_sf:
+        case DW_CFA_GNU_args_size:
+            os << m_off;
+            return true;
+        case DW_CFA_def_cfa_expression:
+        case DW_CFA_expression:
+        case DW_CFA_val_offset:
+        case DW_CFA_val_offset_sf:
+        case DW_CFA_val_expression:
+        case CFI_escape:
+        case CFI_val_encoded_addr:
+            return false;
+        default:
+            assert(false && "bad op value");
+            return false;
+    }
+}
+
+DwarfCfiInsn
 DwarfCfiInsn::MakeOffset(unsigned int reg, const IntNum& off)
 {
-    DwarfCfiInsn* insn = new DwarfCfiInsn(DW_CFA_offset, off);
-    insn->m_regs[0] = reg;
+    DwarfCfiInsn insn(DW_CFA_offset, off);
+    insn.m_regs[0] = reg;
     return insn;
 }
 
-DwarfCfiInsn*
+DwarfCfiInsn
 DwarfCfiInsn::MakeRestore(unsigned int reg)
 {
-    DwarfCfiInsn* insn = new DwarfCfiInsn(DW_CFA_restore);
-    insn->m_regs[0] = reg;
+    DwarfCfiInsn insn(DW_CFA_restore);
+    insn.m_regs[0] = reg;
     return insn;
 }
 
-DwarfCfiInsn*
+DwarfCfiInsn
 DwarfCfiInsn::MakeUndefined(unsigned int reg)
 {
-    DwarfCfiInsn* insn = new DwarfCfiInsn(DW_CFA_undefined);
-    insn->m_regs[0] = reg;
+    DwarfCfiInsn insn(DW_CFA_undefined);
+    insn.m_regs[0] = reg;
     return insn;
 }
 
-DwarfCfiInsn*
+DwarfCfiInsn
 DwarfCfiInsn::MakeSameValue(unsigned int reg)
 {
-    DwarfCfiInsn* insn = new DwarfCfiInsn(DW_CFA_same_value);
-    insn->m_regs[0] = reg;
+    DwarfCfiInsn insn(DW_CFA_same_value);
+    insn.m_regs[0] = reg;
     return insn;
 }
 
-DwarfCfiInsn*
+DwarfCfiInsn
 DwarfCfiInsn::MakeRegister(unsigned int reg1, unsigned int reg2)
 {
-    DwarfCfiInsn* insn = new DwarfCfiInsn(DW_CFA_register);
-    insn->m_regs[0] = reg1;
-    insn->m_regs[1] = reg2;
+    DwarfCfiInsn insn(DW_CFA_register);
+    insn.m_regs[0] = reg1;
+    insn.m_regs[1] = reg2;
     return insn;
 }
 
-DwarfCfiInsn*
+DwarfCfiInsn
 DwarfCfiInsn::MakeDefCfa(unsigned int reg, const IntNum& off)
 {
-    DwarfCfiInsn* insn = new DwarfCfiInsn(DW_CFA_def_cfa, off);
-    insn->m_regs[0] = reg;
+    DwarfCfiInsn insn(DW_CFA_def_cfa, off);
+    insn.m_regs[0] = reg;
     return insn;
 }
 
-DwarfCfiInsn*
+DwarfCfiInsn
 DwarfCfiInsn::MakeDefCfaRegister(unsigned int reg)
 {
-    DwarfCfiInsn* insn = new DwarfCfiInsn(DW_CFA_def_cfa_register);
-    insn->m_regs[0] = reg;
+    DwarfCfiInsn insn(DW_CFA_def_cfa_register);
+    insn.m_regs[0] = reg;
     return insn;
 }
 
-DwarfCfiInsn*
+DwarfCfiInsn
 DwarfCfiInsn::MakeAdvanceLoc(Location from, Location to)
 {
-    DwarfCfiInsn* insn = new DwarfCfiInsn(DW_CFA_advance_loc);
-    insn->m_from = from;
-    insn->m_to = to;
+    DwarfCfiInsn insn(DW_CFA_advance_loc);
+    insn.m_from = from;
+    insn.m_to = to;
     return insn;
 }
 
-DwarfCfiInsn*
+DwarfCfiInsn
 DwarfCfiInsn::MakeEscape(std::vector<Expr>* esc)
 {
-    DwarfCfiInsn* insn = new DwarfCfiInsn(CFI_escape);
-    esc->swap(insn->m_esc);
+    DwarfCfiInsn insn(CFI_escape);
+    insn.m_esc = new std::vector<Expr>;
+    esc->swap(*insn.m_esc);
     return insn;
 }
 
-DwarfCfiInsn*
+DwarfCfiInsn
 DwarfCfiInsn::MakeValEncodedAddr(unsigned int reg,
                                  unsigned int encoding,
                                  Expr e)
 {
-    DwarfCfiInsn* insn = new DwarfCfiInsn(CFI_val_encoded_addr);
+    DwarfCfiInsn insn(CFI_val_encoded_addr);
     // somewhat of a hack to store it this way
-    insn->m_regs[0] = reg;
-    insn->m_regs[1] = encoding;
-    insn->m_esc.push_back(e);
+    insn.m_regs[0] = reg;
+    insn.m_regs[1] = encoding;
+    insn.m_esc = new std::vector<Expr>(1, e);
     return insn;
 }
 
 DwarfCfiInsn::DwarfCfiInsn(Op op)
-    : m_op(op)
+    : m_op(op), m_esc(0)
 {
 }
 
 DwarfCfiInsn::DwarfCfiInsn(Op op, const IntNum& off)
-    : m_op(op), m_off(off)
+    : m_op(op), m_off(off), m_esc(0)
+{
+}
+
+DwarfCfiInsn::DwarfCfiInsn(const DwarfCfiInsn& oth)
+    : m_op(oth.m_op)
+    , m_source(oth.m_source)
+    , m_from(oth.m_from)
+    , m_to(oth.m_to)
+    , m_off(oth.m_off)
+    , m_esc(oth.m_esc ? new std::vector<Expr>(*oth.m_esc) : 0)
 {
+    m_regs[0] = oth.m_regs[0];
+    m_regs[1] = oth.m_regs[1];
 }
 
 DwarfCfiInsn::~DwarfCfiInsn()
 {
+    delete m_esc;
+}
+
+DwarfCfiInsn&
+DwarfCfiInsn::operator= (const DwarfCfiInsn& oth)
+{
+    if (this != &oth)
+    {
+        DwarfCfiInsn tmp(oth);
+        swap(tmp);
+    }
+    return *this;
+}
+
+void
+DwarfCfiInsn::swap(DwarfCfiInsn& oth)
+{
+    std::swap(m_op, oth.m_op);
+    std::swap(m_source, oth.m_source);
+    std::swap(m_regs[0], oth.m_regs[0]);
+    std::swap(m_regs[1], oth.m_regs[1]);
+    std::swap(m_from, oth.m_from);
+    std::swap(m_to, oth.m_to);
+    m_off.swap(oth.m_off);
+    std::swap(m_esc, oth.m_esc);
 }
 
 void
@@ -438,8 +519,8 @@ DwarfCfiInsn::Output(DwarfCfiOutput& out)
             break;
 
         case CFI_escape:
-            for (std::vector<Expr>::const_iterator i=m_esc.begin(),
-                 end=m_esc.end(); i != end; ++i)
+            for (std::vector<Expr>::const_iterator i=m_esc->begin(),
+                 end=m_esc->end(); i != end; ++i)
                 AppendByte(container, Expr::Ptr(new Expr(*i)), m_source, diags);
             break;
 
@@ -447,7 +528,7 @@ DwarfCfiInsn::Output(DwarfCfiOutput& out)
         {
             unsigned int reg = m_regs[0];
             unsigned int encoding = m_regs[1];
-            Expr::Ptr e(new Expr(m_esc.back()));
+            Expr::Ptr e(new Expr(m_esc->back()));
 
             unsigned int size = getEncodingSize(encoding, arch);
             if (size == 0)
@@ -483,7 +564,7 @@ DwarfCfiInsn::Output(DwarfCfiOutput& out)
 DwarfCfiCie::DwarfCfiCie(DwarfCfiFde* fde)
     : m_fde(fde), m_num_insns(0)
 {
-    for (stdx::ptr_vector<DwarfCfiInsn>::const_iterator
+    for (DwarfCfiFde::Insns::const_iterator
          i = fde->m_insns.begin(), end = fde->m_insns.end(); i != end; ++i)
     {
         switch (i->getOp())
@@ -615,11 +696,11 @@ DwarfCfiFde::DwarfCfiFde(const DwarfDebug& debug,
                          SourceLocation source)
     : m_source(source)
     , m_start(start)
-    , m_insns_owner(m_insns)
     , m_personality_encoding(DW_EH_PE_omit)
     , m_lsda_encoding(DW_EH_PE_omit)
     , m_return_column(debug.m_default_return_column)
     , m_signal_frame(false)
+    , m_compact_unwind(false)
 {
 }
 
@@ -627,6 +708,178 @@ DwarfCfiFde::~DwarfCfiFde()
 {
 }
 
+void
+DwarfCfiFde::Close(Location end)
+{
+    m_end = end;
+
+    // Release the slack left by growing the instruction list.
+    if (m_insns.capacity() > m_insns.size())
+        Insns(m_insns).swap(m_insns);
+}
+
+// Map an AMD64 DWARF register number to a compact unwind register number.
+// Only callee-saved registers can be described.
+static unsigned int
+getCompactUnwindReg(unsigned int reg)
+{
+    switch (reg)
+    {
+        case 3: return 1;   // rbx
+        case 12: return 2;  // r12
+        case 13: return 3;  // r13
+        case 14: return 4;  // r14
+        case 15: return 5;  // r15
+        case 6: return 6;   // rbp
+        default: return 0;
+    }
+}
+
+unsigned long
+DwarfCfiFde::getCompactUnwindX86_64() const
+{
+    // The personality and LSDA would need entries of their own.
+    if (m_personality_encoding != DW_EH_PE_omit ||
+        m_lsda_encoding != DW_EH_PE_omit ||
+        m_signal_frame || m_return_column != 16)
+        return UNWIND_X86_64_MODE_DWARF;
+
+    // Compact unwind describes a single state, that of the procedure body.
+    // Accept only prologue-style CFI: the CFA offset may only grow, the CFA
+    // may move from RSP to RBP once, and registers are only ever saved.
+    enum { CFA_NONE, CFA_RSP, CFA_RBP } cfa = CFA_NONE;
+    long cfa_off = 0;
+    long saved[17] = {0};   // CFA-relative save slot by DWARF register
+
+    for (Insns::const_iterator i=m_insns.begin(), end=m_insns.end();
+         i != end; ++i)
+    {
+        const IntNum& off = i->getOffset();
+        switch (i->getOp())
+        {
+            case DwarfCfiInsn::DW_CFA_advance_loc:
+            case DwarfCfiInsn::DW_CFA_set_loc:
+            case DwarfCfiInsn::DW_CFA_advance_loc1:
+            case DwarfCfiInsn::DW_CFA_advance_loc2:
+            case DwarfCfiInsn::DW_CFA_advance_loc4:
+            case DwarfCfiInsn::DW_CFA_nop:
+                break;
+            case DwarfCfiInsn::DW_CFA_def_cfa:
+                if (!off.isInRange(0, 0x7FFF))
+                    return UNWIND_X86_64_MODE_DWARF;
+                if (i->getReg() == 7 && cfa != CFA_RBP &&
+                    off.getInt() >= cfa_off)
+                    cfa = CFA_RSP;
+                else if (i->getReg() == 6 && cfa == CFA_RSP)
+                    cfa = CFA_RBP;
+                else
+                    return UNWIND_X86_64_MODE_DWARF;
+                cfa_off = off.getInt();
+                break;
+            case DwarfCfiInsn::DW_CFA_def_cfa_register:
+                if (i->getReg() == 6 && cfa == CFA_RSP)
+                    cfa = CFA_RBP;
+                else if (i->getReg() != 7 || cfa != CFA_RSP)
+                    return UNWIND_X86_64_MODE_DWARF;
+                break;
+            case DwarfCfiInsn::DW_CFA_def_cfa_offset:
+                if (cfa != CFA_RSP || !off.isInRange(cfa_off, 0x7FFF))
+                    return UNWIND_X86_64_MODE_DWARF;
+                cfa_off = off.getInt();
+                break;
+            case DwarfCfiInsn::DW_CFA_offset:
+            {
+                unsigned int reg = i->getReg();
+                if ((reg != 16 && getCompactUnwindReg(reg) == 0) ||
+                    !off.isInRange(-0x7FFF, -8) || (off.getInt() & 7) != 0)
+                    return UNWIND_X86_64_MODE_DWARF;
+                if (saved[reg] != 0 && saved[reg] != off.getInt())
+                    return UNWIND_X86_64_MODE_DWARF;
+                saved[reg] = off.getInt();
+                break;
+            }
+            default:
+                return UNWIND_X86_64_MODE_DWARF;
+        }
+    }
+
+    // The return address must be just below the CFA.
+    if (cfa == CFA_NONE || saved[16] != -8)
+        return UNWIND_X86_64_MODE_DWARF;
+
+    // Each saved register other than the return address (and RBP in a
+    // frame) is in its own 8-byte slot, counting down from the top.
+    long top = (cfa == CFA_RBP) ? 16 : 8;
+    if (cfa == CFA_RBP && (cfa_off != 16 || saved[6] != -16))
+        return UNWIND_X86_64_MODE_DWARF;
+    unsigned long slot[16];
+    unsigned int count = 0;
+    unsigned long last = 0;
+    for (unsigned int reg=0; reg<16; ++reg)
+    {
+        if (saved[reg] == 0 || (cfa == CFA_RBP && reg == 6))
+            continue;
+        if (-saved[reg] <= top || -saved[reg]-top > 8*0xFF)
+            return UNWIND_X86_64_MODE_DWARF;
+        for (unsigned int other=0; other<reg; ++other)
+        {
+            if (saved[other] == saved[reg])
+                return UNWIND_X86_64_MODE_DWARF;
+        }
+        slot[reg] = (-saved[reg]-top)/8;
+        last = std::max(last, slot[reg]);
+        ++count;
+    }
+
+    if (cfa == CFA_RBP)
+    {
+        // Frame set up by "push rbp; mov rbp, rsp"; the registers are in
+        // up to five slots below the last one used, listed from the lowest
+        // address up.
+        unsigned long regs = 0;
+        for (unsigned int reg=0; reg<16; ++reg)
+        {
+            if (saved[reg] == 0 || reg == 6)
+                continue;
+            if (last - slot[reg] > 4)
+                return UNWIND_X86_64_MODE_DWARF;
+            regs |= getCompactUnwindReg(reg) << (3*(last - slot[reg]));
+        }
+        return UNWIND_X86_64_MODE_RBP_FRAME | (last << 16) | regs;
+    }
+
+    // Frameless: the registers must be pushed right below the return
+    // address, and are listed from the lowest address up.
+    if ((cfa_off & 7) != 0 || cfa_off/8 > 0xFF || count > 6 || last != count)
+        return UNWIND_X86_64_MODE_DWARF;
+    unsigned int regs[6];
+    for (unsigned int reg=0; reg<16; ++reg)
+    {
+        if (saved[reg] != 0)
+            regs[count - slot[reg]] = getCompactUnwindReg(reg);
+    }
+
+    // Encode the register order as a permutation of the 6 registers:
+    // each register is numbered among those not yet used, and the numbers
+    // combined in a mixed radix.
+    unsigned long permutation = 0;
+    for (unsigned int i=0; i<count; ++i)
+    {
+        unsigned int renum = regs[i] - 1;
+        for (unsigned int j=0; j<i; ++j)
+        {
+            if (regs[j] < regs[i])
+                --renum;
+        }
+        unsigned long radix = 1;
+        for (unsigned int k=i+1; k<count; ++k)
+            radix *= 6-k;
+        permutation += renum * radix;
+    }
+    return UNWIND_X86_64_MODE_STACK_IMMD | ((cfa_off/8) << 16) |
+        (count << 10) | permutation;
+}
+
 void
 DwarfCfiFde::Output(DwarfCfiOutput& out, DwarfCfiCie& cie, unsigned int align)
 {
@@ -791,15 +1044,37 @@ DwarfDebug::DirRegNum(NameValue& nv,
                       unsigned int* out,
                       bool* out_set)
 {
-#if 0
-    // TODO: dwarf has its own register numbering
+    // Registers are numbered by the architecture; "%rbp" is parsed as a
+    // register, but "rbp" is only a name.
+    Arch& arch = *obj->getArch();
+    int num = -1;
     if (nv.isRegister())
+        num = arch.getDwarfRegNum(*nv.getRegister());
+    else if (nv.isId())
+    {
+        if (m_cfi_regnames_gen != arch.getLookupGeneration())
+        {
+            m_cfi_regnames.clear();
+            m_cfi_regnames_gen = arch.getLookupGeneration();
+        }
+        llvm::StringMapEntry<int>& entry =
+            m_cfi_regnames.GetOrCreateValue(nv.getId(), -2);
+        if (entry.getValue() == -2)
+        {
+            Arch::RegTmod regtmod =
+                arch.ParseCheckRegTmod(nv.getId(), nv.getNameSource(), diags);
+            const Register* reg = regtmod.getReg();
+            entry.setValue(reg ? arch.getDwarfRegNum(*reg) : -1);
+        }
+        num = entry.getValue();
+    }
+    if (num >= 0)
     {
-        *out = nv.getRegister()->getNum();
+        *out = num;
         *out_set = true;
         return;
     }
-#endif
+
     if (nv.isExpr())
     {
         Expr e = nv.getExpr(*obj);
@@ -819,8 +1094,8 @@ DwarfDebug::AdvanceCfiAddress(Location loc, SourceLocation source)
 {
     if (loc == m_last_address)
         return;
-    DwarfCfiInsn* insn = DwarfCfiInsn::MakeAdvanceLoc(m_last_address, loc);
-    insn->setSource(source);
+    DwarfCfiInsn insn = DwarfCfiInsn::MakeAdvanceLoc(m_last_address, loc);
+    insn.setSource(source);
     m_cur_fde->m_insns.push_back(insn);
     m_last_address = loc;
 }
@@ -926,8 +1201,8 @@ DwarfDebug::DirCfiDefCfa(DirectiveInfo& info, DiagnosticsEngine& diags)
         return;
 
     AdvanceCfiAddress(info.getLocation(), info.getSource());
-    DwarfCfiInsn* insn = DwarfCfiInsn::MakeDefCfa(reg, off);
-    insn->setSource(info.getSource());
+    DwarfCfiInsn insn = DwarfCfiInsn::MakeDefCfa(reg, off);
+    insn.setSource(info.getSource());
     m_cur_fde->m_insns.push_back(insn);
 }
 
@@ -946,8 +1221,8 @@ DwarfDebug::DirCfiDefCfaRegister(DirectiveInfo& info, DiagnosticsEngine& diags)
         return;
 
     AdvanceCfiAddress(info.getLocation(), info.getSource());
-    DwarfCfiInsn* insn = DwarfCfiInsn::MakeDefCfaRegister(reg);
-    insn->setSource(info.getSource());
+    DwarfCfiInsn insn = DwarfCfiInsn::MakeDefCfaRegister(reg);
+    insn.setSource(info.getSource());
     m_cur_fde->m_insns.push_back(insn);
 }
 
@@ -966,8 +1241,8 @@ DwarfDebug::DirCfiDefCfaOffset(DirectiveInfo& info, DiagnosticsEngine& diags)
         return;
 
     AdvanceCfiAddress(info.getLocation(), info.getSource());
-    DwarfCfiInsn* insn = DwarfCfiInsn::MakeDefCfaOffset(off);
-    insn->setSource(info.getSource());
+    DwarfCfiInsn insn = DwarfCfiInsn::MakeDefCfaOffset(off);
+    insn.setSource(info.getSource());
     m_cur_fde->m_insns.push_back(insn);
 }
 
@@ -986,8 +1261,8 @@ DwarfDebug::DirCfiAdjustCfaOffset(DirectiveInfo& info, DiagnosticsEngine& diags)
         return;
 
     AdvanceCfiAddress(info.getLocation(), info.getSource());
-    DwarfCfiInsn* insn = DwarfCfiInsn::MakeDefCfaOffset(m_cfa_cur_offset+off);
-    insn->setSource(info.getSource());
+    DwarfCfiInsn insn = DwarfCfiInsn::MakeDefCfaOffset(m_cfa_cur_offset+off);
+    insn.setSource(info.getSource());
     m_cur_fde->m_insns.push_back(insn);
 }
 
@@ -1008,8 +1283,8 @@ DwarfDebug::DirCfiOffset(DirectiveInfo& info, DiagnosticsEngine& diags)
         return;
 
     AdvanceCfiAddress(info.getLocation(), info.getSource());
-    DwarfCfiInsn* insn = DwarfCfiInsn::MakeOffset(reg, off);
-    insn->setSource(info.getSource());
+    DwarfCfiInsn insn = DwarfCfiInsn::MakeOffset(reg, off);
+    insn.setSource(info.getSource());
     m_cur_fde->m_insns.push_back(insn);
 }
 
@@ -1030,8 +1305,8 @@ DwarfDebug::DirCfiRelOffset(DirectiveInfo& info, DiagnosticsEngine& diags)
         return;
 
     AdvanceCfiAddress(info.getLocation(), info.getSource());
-    DwarfCfiInsn* insn = DwarfCfiInsn::MakeOffset(reg, off-m_cfa_cur_offset);
-    insn->setSource(info.getSource());
+    DwarfCfiInsn insn = DwarfCfiInsn::MakeOffset(reg, off-m_cfa_cur_offset);
+    insn.setSource(info.getSource());
     m_cur_fde->m_insns.push_back(insn);
 }
 
@@ -1052,8 +1327,8 @@ DwarfDebug::DirCfiRegister(DirectiveInfo& info, DiagnosticsEngine& diags)
         return;
 
     AdvanceCfiAddress(info.getLocation(), info.getSource());
-    DwarfCfiInsn* insn = DwarfCfiInsn::MakeRegister(reg1, reg2);
-    insn->setSource(info.getSource());
+    DwarfCfiInsn insn = DwarfCfiInsn::MakeRegister(reg1, reg2);
+    insn.setSource(info.getSource());
     m_cur_fde->m_insns.push_back(insn);
 }
 
@@ -1072,8 +1347,8 @@ DwarfDebug::DirCfiRestore(DirectiveInfo& info, DiagnosticsEngine& diags)
         return;
 
     AdvanceCfiAddress(info.getLocation(), info.getSource());
-    DwarfCfiInsn* insn = DwarfCfiInsn::MakeRestore(reg);
-    insn->setSource(info.getSource());
+    DwarfCfiInsn insn = DwarfCfiInsn::MakeRestore(reg);
+    insn.setSource(info.getSource());
     m_cur_fde->m_insns.push_back(insn);
 }
 
@@ -1092,8 +1367,8 @@ DwarfDebug::DirCfiUndefined(DirectiveInfo& info, DiagnosticsEngine& diags)
         return;
 
     AdvanceCfiAddress(info.getLocation(), info.getSource());
-    DwarfCfiInsn* insn = DwarfCfiInsn::MakeUndefined(reg);
-    insn->setSource(info.getSource());
+    DwarfCfiInsn insn = DwarfCfiInsn::MakeUndefined(reg);
+    insn.setSource(info.getSource());
     m_cur_fde->m_insns.push_back(insn);
 }
 
@@ -1112,8 +1387,8 @@ DwarfDebug::DirCfiSameValue(DirectiveInfo& info, DiagnosticsEngine& diags)
         return;
 
     AdvanceCfiAddress(info.getLocation(), info.getSource());
-    DwarfCfiInsn* insn = DwarfCfiInsn::MakeSameValue(reg);
-    insn->setSource(info.getSource());
+    DwarfCfiInsn insn = DwarfCfiInsn::MakeSameValue(reg);
+    insn.setSource(info.getSource());
     m_cur_fde->m_insns.push_back(insn);
 }
 
@@ -1126,8 +1401,8 @@ DwarfDebug::DirCfiRememberState(DirectiveInfo& info, DiagnosticsEngine& diags)
     m_cfa_stack.push_back(m_cfa_cur_offset);
 
     AdvanceCfiAddress(info.getLocation(), info.getSource());
-    DwarfCfiInsn* insn = DwarfCfiInsn::MakeRememberState();
-    insn->setSource(info.getSource());
+    DwarfCfiInsn insn = DwarfCfiInsn::MakeRememberState();
+    insn.setSource(info.getSource());
     m_cur_fde->m_insns.push_back(insn);
 }
 
@@ -1146,8 +1421,8 @@ DwarfDebug::DirCfiRestoreState(DirectiveInfo& info, DiagnosticsEngine& diags)
     m_cfa_stack.pop_back();
 
     AdvanceCfiAddress(info.getLocation(), info.getSource());
-    DwarfCfiInsn* insn = DwarfCfiInsn::MakeRememberState();
-    insn->setSource(info.getSource());
+    DwarfCfiInsn insn = DwarfCfiInsn::MakeRememberState();
+    insn.setSource(info.getSource());
     m_cur_fde->m_insns.push_back(insn);
 }
 
@@ -1182,8 +1457,8 @@ DwarfDebug::DirCfiWindowSave(DirectiveInfo& info, DiagnosticsEngine& diags)
     if (!DirCheck(info, diags, 0))
         return;
     AdvanceCfiAddress(info.getLocation(), info.getSource());
-    DwarfCfiInsn* insn = DwarfCfiInsn::MakeGNUWindowSave();
-    insn->setSource(info.getSource());
+    DwarfCfiInsn insn = DwarfCfiInsn::MakeGNUWindowSave();
+    insn.setSource(info.getSource());
     m_cur_fde->m_insns.push_back(insn);
 }
 
@@ -1212,8 +1487,8 @@ DwarfDebug::DirCfiEscape(DirectiveInfo& info, DiagnosticsEngine& diags)
     }
 
     AdvanceCfiAddress(info.getLocation(), info.getSource());
-    DwarfCfiInsn* insn = DwarfCfiInsn::MakeEscape(&esc);
-    insn->setSource(info.getSource());
+    DwarfCfiInsn insn = DwarfCfiInsn::MakeEscape(&esc);
+    insn.setSource(info.getSource());
     m_cur_fde->m_insns.push_back(insn);
 }
 
@@ -1240,8 +1515,8 @@ DwarfDebug::DirCfiValEncodedAddr(DirectiveInfo& info, DiagnosticsEngine& diags)
         return;
 
     AdvanceCfiAddress(info.getLocation(), info.getSource());
-    DwarfCfiInsn* insn = DwarfCfiInsn::MakeValEncodedAddr(reg, encoding, func);
-    insn->setSource(info.getSource());
+    DwarfCfiInsn insn = DwarfCfiInsn::MakeValEncodedAddr(reg, encoding, func);
+    insn.setSource(info.getSource());
     m_cur_fde->m_insns.push_back(insn);
 }
 
@@ -1333,6 +1608,39 @@ DwarfDebug::AddCfiDirectives(Directives& dirs, StringRef parser)
         dirs.AddArray(this, gas_dirs);
 }
 
+void
+DwarfDebug::GenerateCompactUnwind(ObjectFormat& ofmt, DiagnosticsEngine& diags)
+{
+    Section* sect = m_object.FindSection(".compact_unwind");
+    if (!sect)
+        sect = ofmt.AppendSection(".compact_unwind", SourceLocation(), diags);
+    sect->setAlign(8);
+
+    // One entry per procedure: start address, length, encoding,
+    // personality, and LSDA.  Procedures that need DWARF also get an entry;
+    // the linker connects it to the FDE.
+    Arch& arch = *m_object.getArch();
+    for (FDEs::iterator i=m_fdes.begin(), end=m_fdes.end(); i != end; ++i)
+    {
+        unsigned long encoding = i->getCompactUnwindX86_64();
+        i->m_compact_unwind = (encoding != UNWIND_X86_64_MODE_DWARF);
+
+        SymbolRef start = m_object.getSymbol(i->m_start);
+        AppendData(*sect, Expr::Ptr(new Expr(start)), 8, arch, i->m_source,
+                   diags);
+        AppendData(*sect,
+                   Expr::Ptr(new Expr(SUB(m_object.getSymbol(i->m_end),
+                                          start))),
+                   4, arch, i->m_source, diags);
+        AppendData(*sect, encoding, 4, arch);
+        AppendData(*sect, 0, 8, arch);
+        AppendData(*sect, 0, 8, arch);
+    }
+
+    sect->Finalize(diags);
+    sect->Optimize(diags);
+}
+
 void
 DwarfDebug::GenerateCfiSection(ObjectFormat& ofmt,
                                DiagnosticsEngine& diags,
@@ -1352,9 +1660,22 @@ DwarfDebug::GenerateCfiSection(ObjectFormat& ofmt,
 
     DwarfCfiOutput out(*sect, diags, *this, m_object, eh_frame);
     std::vector<DwarfCfiCie> cies;
+    llvm::StringMap<size_t> cie_index;  // getCieKey() to index into cies
+    SmallString<128> key;
 
+    // Procedures described by compact unwind need no .eh_frame FDE.
+    FDEs::iterator last = m_fdes.end();
     for (FDEs::iterator i=m_fdes.begin(), end=m_fdes.end(); i != end; ++i)
     {
+        if (!eh_frame || !i->m_compact_unwind)
+            last = i;
+    }
+
+    for (FDEs::iterator i=m_fdes.begin(), end=m_fdes.end(); i != end; ++i)
+    {
+        if (eh_frame && i->m_compact_unwind)
+            continue;
+
         if (!eh_frame)
         {
             // Modify directly; note this means eh_frame version must be
@@ -1364,19 +1685,23 @@ DwarfDebug::GenerateCfiSection(ObjectFormat& ofmt,
         }
 
         // Try to find an existing CIE that matches this FDE
-        IsFdeMatch matcher(*i);
-        std::vector<DwarfCfiCie>::iterator ciep =
-            std::find_if(cies.begin(), cies.end(), matcher);
-        DwarfCfiCie* cie;
-        if (ciep != cies.end())
-            cie = &(*ciep);
-        else
+        bool keyed = getCieKey(*i, key);
+        DwarfCfiCie* cie = 0;
+        if (keyed)
         {
+            llvm::StringMap<size_t>::iterator ciep = cie_index.find(key);
+            if (ciep != cie_index.end())
+                cie = &cies[ciep->getValue()];
+        }
+        if (!cie)
+        {
+            if (keyed)
+                cie_index[key] = cies.size();
             cies.push_back(DwarfCfiCie(&(*i)));
             cie = &cies.back();
             cie->Output(out, eh_frame ? 4 : align);
         }
-        i->Output(out, *cie, (eh_frame && (i+1) != m_fdes.end()) ? 4 : align);
+        i->Output(out, *cie, (eh_frame && i != last) ? 4 : align);
     }
 
     sect->Finalize(diags);
@@ -1396,7 +1721,23 @@ DwarfDebug::GenerateCfi(ObjectFormat& ofmt,
     if (m_fdes.empty())
         return;
 
-    if (m_eh_frame)
+    // Mach-O x86-64 describes most procedures with compact unwind entries,
+    // leaving .eh_frame for the rest.
+    bool need_eh_frame = m_eh_frame;
+    if (m_eh_frame && ofmt.getModule().getKeyword().startswith("macho") &&
+        m_object.getArch()->getMachine() == "amd64")
+    {
+        GenerateCompactUnwind(ofmt, diags);
+        need_eh_frame = false;
+        for (FDEs::iterator i=m_fdes.begin(), end=m_fdes.end(); i != end;
+             ++i)
+        {
+            if (!i->m_compact_unwind)
+                need_eh_frame = true;
+        }
+    }
+
+    if (need_eh_frame)
         GenerateCfiSection(ofmt, diags, ".eh_frame", true);
 
     if (m_debug_frame)
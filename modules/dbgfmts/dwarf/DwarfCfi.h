@@ -26,7 +26,8 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 //
-#include "yasmx/Support/ptr_vector.h"
+#include <vector>
+
 #include "yasmx/Expr.h"
 #include "yasmx/IntNum.h"
 #include "yasmx/Location.h"
@@ -68,33 +69,38 @@ public:
     bool eh_frame;
 };
 
+/// A call frame instruction.  These are stored by value, so the rarely
+/// used escape expressions are kept out of line.
 class YASM_STD_EXPORT DwarfCfiInsn
 {
 public:
+    DwarfCfiInsn(const DwarfCfiInsn& oth);
     ~DwarfCfiInsn();
+    DwarfCfiInsn& operator= (const DwarfCfiInsn& oth);
+    void swap(DwarfCfiInsn& oth);
 
     void setSource(SourceLocation source) { m_source = source; }
     void Output(DwarfCfiOutput& out);
 
-    static DwarfCfiInsn* MakeAdvanceLoc(Location from, Location to);
-    static DwarfCfiInsn* MakeOffset(unsigned int reg, const IntNum& off);
-    static DwarfCfiInsn* MakeRestore(unsigned int reg);
-    static DwarfCfiInsn* MakeUndefined(unsigned int reg);
-    static DwarfCfiInsn* MakeSameValue(unsigned int reg);
-    static DwarfCfiInsn* MakeRegister(unsigned int reg1, unsigned int reg2);
-    static DwarfCfiInsn* MakeRememberState()
-    { return new DwarfCfiInsn(DW_CFA_remember_state); }
-    static DwarfCfiInsn* MakeRestoreState()
-    { return new DwarfCfiInsn(DW_CFA_restore_state); }
-    static DwarfCfiInsn* MakeDefCfa(unsigned int reg, const IntNum& off);
-    static DwarfCfiInsn* MakeDefCfaRegister(unsigned int reg);
-    static DwarfCfiInsn* MakeDefCfaOffset(const IntNum& off)
-    { return new DwarfCfiInsn(DW_CFA_def_cfa_offset, off); }
-    static DwarfCfiInsn* MakeGNUWindowSave()
-    { return new DwarfCfiInsn(DW_CFA_GNU_window_save); }
-
-    static DwarfCfiInsn* MakeEscape(std::vector<Expr>* esc);
-    static DwarfCfiInsn* MakeValEncodedAddr(unsigned int reg,
+    static DwarfCfiInsn MakeAdvanceLoc(Location from, Location to);
+    static DwarfCfiInsn MakeOffset(unsigned int reg, const IntNum& off);
+    static DwarfCfiInsn MakeRestore(unsigned int reg);
+    static DwarfCfiInsn MakeUndefined(unsigned int reg);
+    static DwarfCfiInsn MakeSameValue(unsigned int reg);
+    static DwarfCfiInsn MakeRegister(unsigned int reg1, unsigned int reg2);
+    static DwarfCfiInsn MakeRememberState()
+    { return DwarfCfiInsn(DW_CFA_remember_state); }
+    static DwarfCfiInsn MakeRestoreState()
+    { return DwarfCfiInsn(DW_CFA_restore_state); }
+    static DwarfCfiInsn MakeDefCfa(unsigned int reg, const IntNum& off);
+    static DwarfCfiInsn MakeDefCfaRegister(unsigned int reg);
+    static DwarfCfiInsn MakeDefCfaOffset(const IntNum& off)
+    { return DwarfCfiInsn(DW_CFA_def_cfa_offset, off); }
+    static DwarfCfiInsn MakeGNUWindowSave()
+    { return DwarfCfiInsn(DW_CFA_GNU_window_save); }
+
+    static DwarfCfiInsn MakeEscape(std::vector<Expr>* esc);
+    static DwarfCfiInsn MakeValEncodedAddr(unsigned int reg,
                                           unsigned int encoding,
                                           Expr e);
 
@@ -134,20 +140,28 @@ public:
     };
 
     Op getOp() const { return m_op; }
+    unsigned int getReg() const { return m_regs[0]; }
+    const IntNum& getOffset() const { return m_off; }
 
     bool operator== (const DwarfCfiInsn& oth) const;
     bool operator!= (const DwarfCfiInsn& oth) const { return !(*this == oth); }
 
+    /// Write a key for the instruction.  Two instructions have the same key
+    /// exactly when they compare equal.
+    /// @param os       output stream
+    /// @return False if the instruction never compares equal (no key).
+    bool WriteKey(raw_ostream& os) const;
+
 private:
     DwarfCfiInsn(Op op);
     DwarfCfiInsn(Op op, const IntNum& off);
 
     Op m_op;
-    Location m_from, m_to;
+    SourceLocation m_source;
     unsigned int m_regs[2];
-    std::vector<Expr> m_esc;
+    Location m_from, m_to;
     IntNum m_off;
-    SourceLocation m_source;
+    std::vector<Expr>* m_esc;   ///< escape/encoded address expressions
 };
 
 class YASM_STD_EXPORT DwarfCfiCie
@@ -171,13 +185,18 @@ public:
     ~DwarfCfiFde();
 
     void Output(DwarfCfiOutput& out, DwarfCfiCie& cie, unsigned int align);
-    void Close(Location end) { m_end = end; }
+    void Close(Location end);
+
+    /// Get the Mach-O x86-64 compact unwind encoding of the frame.
+    /// @return Encoding, or UNWIND_X86_64_MODE_DWARF if the frame can
+    ///         only be described by its FDE.
+    unsigned long getCompactUnwindX86_64() const;
 
     SourceLocation m_source;
     Location m_start;
     Location m_end;
-    stdx::ptr_vector<DwarfCfiInsn> m_insns;
-    stdx::ptr_vector_owner<DwarfCfiInsn> m_insns_owner;
+    typedef std::vector<DwarfCfiInsn> Insns;
+    Insns m_insns;
     Expr m_personality;
     Expr m_lsda;
     SourceLocation m_personality_source;
@@ -186,6 +205,8 @@ public:
     unsigned char m_lsda_encoding;
     unsigned int m_return_column;
     bool m_signal_frame;
+    bool m_compact_unwind;  ///< described by compact unwind; omit from
+                            ///< .eh_frame
 };
 
 }} // namespace yasm::dbgfmt
@@ -28,6 +28,7 @@
 
 #include <algorithm>
 
+#include "yasmx/Basic/Diagnostic.h"
 #include "yasmx/Parse/Directive.h"
 #include "yasmx/Support/registry.h"
 #include "yasmx/Arch.h"
@@ -42,13 +43,21 @@
 using namespace yasm;
 using namespace yasm::dbgfmt;
 
-DwarfDebug::DwarfDebug(const DebugFormatModule& module, Object& object)
+DwarfDebug::DwarfDebug(const DebugFormatModule& module,
+                       Object& object,
+                       unsigned int version)
     : DebugFormat(module, object)
+    , m_first_free_file(0)
     , m_format(FORMAT_32BIT)    // TODO: flexible?
+    , m_version(version)
     , m_sizeof_address(object.getArch()->getAddressSize()/8)
     , m_min_insn_len(object.getArch()->getModule().getMinInsnLen())
+    , m_line_str(0)
+    , m_line_str_data(0)
+    , m_line_str_base(0)
     , m_fdes_owner(m_fdes)
     , m_cur_fde(0)
+    , m_cfi_regnames_gen(0)
 {
     m_last_address.bc = 0;
     m_last_address.off = 0;
@@ -89,11 +98,33 @@ DwarfDebug::GenerateDebug(ObjectFormat& objfmt,
         (!debug_info ||
          debug_info->bytecodes_begin() == debug_info->bytecodes_end()))
     {
-        debug_info = &Generate_info(debug_line, main_code);
+        // For split DWARF, the unit in the object file is just a skeleton
+        // pointing to the split DWARF file.
+        unsigned char dwo_id[16];
+        bool split = !m_object.getConfig().SplitDwarfFile.empty();
+        if (split && m_version < 5)
+        {
+            diags.Report(SourceLocation(), diag::warn_split_dwarf_version);
+            split = false;
+        }
+        if (split)
+            getDwoId(dwo_id);
+
+        debug_info = &Generate_info(debug_line, main_code,
+                                    split ? dwo_id : 0);
         debug_info->Finalize(diags);
         Section& aranges = Generate_aranges(*debug_info);
         aranges.Finalize(diags);
         //Generate_pubnames(*debug_info);
+
+        if (split)
+            OutputDwo(dwo_id);
+    }
+
+    if (m_line_str)
+    {
+        m_line_str->UpdateOffsets(diags);
+        m_line_str->Finalize(diags);
     }
 }
 
@@ -126,6 +157,7 @@ DwarfPassDebug::Generate(ObjectFormat& objfmt,
 
 Location
 DwarfDebug::AppendHead(Section& sect,
+                       unsigned int version,
                        /*@null@*/ Section* debug_ptr,
                        bool with_address,
                        bool with_segment)
@@ -144,7 +176,7 @@ DwarfDebug::AppendHead(Section& sect,
     AppendData(sect, 0, m_sizeof_offset, *m_object.getArch());
 
     // DWARF version
-    AppendData(sect, 2, 2, *m_object.getArch());
+    AppendData(sect, version, 2, *m_object.getArch());
 
     // Pointer to another debug section
     if (debug_ptr)
@@ -196,7 +228,11 @@ DwarfDebug::AddDebugDirectives(Directives& dirs, StringRef parser)
     if (parser.equals_lower("nasm"))
         dirs.AddArray(this, nasm_dirs);
     else if (parser.equals_lower("gas") || parser.equals_lower("gnu"))
+    {
         dirs.AddArray(this, gas_dirs);
+        dirs.AddParsed(".loc", TR1::bind(&DwarfDebug::ParseLoc, this,
+                                         _1, _2, _3));
+    }
 }
 
 void
@@ -206,6 +242,14 @@ DwarfDebug::AddDirectives(Directives& dirs, StringRef parser)
     AddCfiDirectives(dirs, parser);
 }
 
+Dwarf5Debug::~Dwarf5Debug()
+{
+}
+
+Dwarf5PassDebug::~Dwarf5PassDebug()
+{
+}
+
 CfiDebug::~CfiDebug()
 {
 }
@@ -224,17 +268,21 @@ CfiDebug::Generate(ObjectFormat& objfmt,
     GenerateCfi(objfmt, smgr, diags);
 }
 
-void
-yasm_dbgfmt_dwarf_DoRegister()
-{
-    RegisterModule<DebugFormatModule,
-                   DebugFormatModuleImpl<DwarfDebug> >("dwarf");
-    RegisterModule<DebugFormatModule,
-                   DebugFormatModuleImpl<DwarfPassDebug> >("dwarfpass");
-    RegisterModule<DebugFormatModule,
-                   DebugFormatModuleImpl<DwarfDebug> >("dwarf2");
-    RegisterModule<DebugFormatModule,
-                   DebugFormatModuleImpl<DwarfPassDebug> >("dwarf2pass");
-    RegisterModule<DebugFormatModule,
-                   DebugFormatModuleImpl<CfiDebug> >("cfi");
-}
+extern const yasm::impl::ModuleEntry yasm_dbgfmt_dwarf_modules[] =
+{
+    YASM_MODULE_ENTRY(DebugFormatModule,
+                      DebugFormatModuleImpl<DwarfDebug>, "dwarf"),
+    YASM_MODULE_ENTRY(DebugFormatModule,
+                      DebugFormatModuleImpl<DwarfPassDebug>, "dwarfpass"),
+    YASM_MODULE_ENTRY(DebugFormatModule,
+                      DebugFormatModuleImpl<DwarfDebug>, "dwarf2"),
+    YASM_MODULE_ENTRY(DebugFormatModule,
+                      DebugFormatModuleImpl<DwarfPassDebug>, "dwarf2pass"),
+    YASM_MODULE_ENTRY(DebugFormatModule,
+                      DebugFormatModuleImpl<Dwarf5Debug>, "dwarf5"),
+    YASM_MODULE_ENTRY(DebugFormatModule,
+                      DebugFormatModuleImpl<Dwarf5PassDebug>, "dwarf5pass"),
+    YASM_MODULE_ENTRY(DebugFormatModule,
+                      DebugFormatModuleImpl<CfiDebug>, "cfi"),
+    YASM_MODULE_TABLE_END
+};
@@ -28,8 +28,10 @@
 //
 #include <vector>
 
+#include "llvm/ADT/StringMap.h"
 #include "yasmx/Basic/SourceLocation.h"
 #include "yasmx/Config/export.h"
+#include "yasmx/Support/ptr_vector.h"
 #include "yasmx/DebugFormat.h"
 #include "yasmx/Location.h"
 #include "yasmx/SymbolRef.h"
@@ -41,8 +43,11 @@
 
 namespace yasm {
 class BytecodeContainer;
+class Bytecode;
+class Bytes;
 class DirectiveInfo;
 class FileEntry;
+class ParserImpl;
 class Section;
 
 namespace dbgfmt {
@@ -52,7 +57,9 @@ struct DwarfLineState;
 class YASM_STD_EXPORT DwarfDebug : public DebugFormat
 {
 public:
-    DwarfDebug(const DebugFormatModule& module, Object& object);
+    DwarfDebug(const DebugFormatModule& module,
+               Object& object,
+               unsigned int version = 2);
     ~DwarfDebug();
 
     static StringRef getName() { return "DWARF debugging format"; }
@@ -73,6 +80,8 @@ public:
         unsigned long dir;
         unsigned long time;
         unsigned long length;
+        bool has_md5;               // true if md5 is valid
+        unsigned char md5[16];      // MD5 digest of file contents
     };
 
     bool gotFile() { return !m_filenames.empty(); }
@@ -93,15 +102,28 @@ private:
     friend class DwarfCfiFde;
     friend class DwarfCfiInsn;
 
+    /// Get the current working directory for DW_AT_comp_dir and the
+    /// DWARF 5 line table.  The test suite gets a fixed one, so its expected
+    /// output doesn't depend on where it runs.
+    static std::string getCompDir();
+
     ObjectFormat* m_objfmt;
     DiagnosticsEngine* m_diags;
 
     typedef std::vector<std::string> Dirs;
     Dirs m_dirs;
+    llvm::StringMap<unsigned long> m_dir_index;     ///< index into m_dirs
 
     typedef std::vector<Filename> Filenames;
     Filenames m_filenames;
 
+    /// Lowest index into m_filenames of each (dir, filename) pair.
+    /// Keyed by FileKey().
+    llvm::StringMap<size_t> m_file_index;
+
+    /// No entry of m_filenames below this index has an empty filename.
+    size_t m_first_free_file;
+
     enum Format
     {
         FORMAT_32BIT,
@@ -110,8 +132,17 @@ private:
 
     Format m_format;
 
+    /// DWARF version of the generated line number and debug information.
+    unsigned int m_version;
+
     unsigned int m_sizeof_address, m_sizeof_offset, m_min_insn_len;
 
+    // Line number string table (.debug_line_str), DWARF 5 only
+    Section* m_line_str;
+    Bytes* m_line_str_data;             ///< strings appended by us
+    unsigned long m_line_str_base;      ///< section offset of m_line_str_data
+    llvm::StringMap<unsigned long> m_line_str_index;    ///< offsets
+
     // CFI FDEs
     typedef stdx::ptr_vector<DwarfCfiFde> FDEs;
     FDEs m_fdes;
@@ -133,11 +164,20 @@ private:
     void (*m_frame_initial_instructions) (DwarfCfiFde& fde);
     unsigned int m_fde_reloc_size;
 
+    // DWARF numbers of the register names given to CFI directives without
+    // a "%" (-1 if not a register with one), so each name is only looked
+    // up once.  Redone when the architecture lookup generation changes.
+    llvm::StringMap<int> m_cfi_regnames;
+    unsigned int m_cfi_regnames_gen;
+
     // Initialize CFI settings
     void InitCfi(Arch& arch);
 
     // Line number directives
     void DirLoc(DirectiveInfo& info, DiagnosticsEngine& diags);
+    bool ParseLoc(DirectiveInfo& info,
+                  ParserImpl& parser,
+                  DiagnosticsEngine& diags);
     void DirFile(DirectiveInfo& info, DiagnosticsEngine& diags);
 
     // CFI directives
@@ -175,6 +215,9 @@ private:
                    bool* out_set);
     void AdvanceCfiAddress(Location loc, SourceLocation source);
 
+    // Generate Mach-O compact unwind section.
+    void GenerateCompactUnwind(ObjectFormat& ofmt, DiagnosticsEngine& diags);
+
     // Generate CFI section.
     void GenerateCfiSection(ObjectFormat& ofmt,
                             DiagnosticsEngine& diags,
@@ -186,16 +229,6 @@ private:
                            bool asm_source,
                            /*@out@*/ Section** main_code,
                            /*@out@*/ size_t* num_line_sections);
-    void AppendLineOp(BytecodeContainer& container,
-                      unsigned int opcode);
-    void AppendLineOp(BytecodeContainer& container,
-                      unsigned int opcode,
-                      const IntNum& operand);
-    void AppendLineExtOp(BytecodeContainer& container,
-                         DwarfLineNumberExtOp ext_opcode);
-    void AppendLineExtOp(BytecodeContainer& container,
-                         DwarfLineNumberExtOp ext_opcode,
-                         const IntNum& operand);
     void AppendLineExtOp(BytecodeContainer& container,
                          DwarfLineNumberExtOp ext_opcode,
                          unsigned long ext_operandsize,
@@ -206,7 +239,7 @@ private:
                              bool asm_source,
                              Section** last_code,
                              size_t* num_line_sections);
-    void GenerateLineOp(Section& debug_line,
+    void GenerateLineOp(Bytes& program,
                         DwarfLineState* state,
                         const DwarfLoc& loc,
                         const DwarfLoc* nextloc);
@@ -217,7 +250,21 @@ private:
                         DwarfLoc* loc,
                         unsigned long* lastfile);
     /// Append statement program prologue
-    void AppendSPP(BytecodeContainer& container);
+    void AppendSPP(BytecodeContainer& container, SourceManager& smgr);
+    /// Append a DWARF 5 file_names entry to a prologue.
+    /// @param md5      MD5 digest of the file contents; NULL if the
+    ///                 prologue has no MD5 column
+    void AppendFileEntry(Bytecode& bc,
+                         StringRef pathname,
+                         unsigned long dir,
+                         /*@null@*/ const unsigned char* md5);
+    /// Look up the MD5 digests of the files in the filename table.
+    /// @return True if every file has a digest.
+    bool FindFileMD5s(SourceManager& smgr);
+
+    /// Append a DW_FORM_line_strp reference to a .debug_line_str string,
+    /// adding the string to .debug_line_str if it is not already present.
+    void AppendLineStrp(Bytecode& bc, StringRef str);
 
     /// Generate .debug_aranges section (address range table).
     Section& Generate_aranges(Section& debug_info);
@@ -228,11 +275,28 @@ private:
 #endif
 
     /// Generate .debug_info section.
-    Section& Generate_info(Section& debug_line, /*@null@*/ Section* main_code);
+    /// @param dwo_id   if not NULL, generate a split DWARF skeleton unit
+    ///                 with this 8-byte id rather than a full unit
+    Section& Generate_info(Section& debug_line,
+                           /*@null@*/ Section* main_code,
+                           /*@null@*/ const unsigned char* dwo_id = 0);
+
+    /// Append the producer and language attributes of a unit.
+    void AppendProducer(Section& debug_info, Bytes& abbrev);
+
+    /// Compute the id linking a skeleton unit to its split unit.
+    /// @param id       16-byte buffer; the id is the first 8 bytes
+    void getDwoId(unsigned char id[16]);
+
+    /// Generate the split DWARF object for a skeleton unit and write it
+    /// to the split DWARF file.
+    /// @param dwo_id   8-byte id of the skeleton unit
+    void OutputDwo(const unsigned char* dwo_id);
 
     /// Append a debug header.
     /// @return The location of the aranges length field (used by setHeadLength).
     Location AppendHead(Section& sect,
+                        unsigned int version,
                         /*@null@*/ Section* debug_ptr,
                         bool with_address,
                         bool with_segment);
@@ -243,16 +307,24 @@ private:
     /// @param tail     end of data
     void setHeadEnd(Location head, Location tail);
 
+    /// Get the name of the primary source file: file 1 if specified,
+    /// otherwise the source filename.
+    StringRef getPrimaryFilename() const;
+
     size_t AddFile(unsigned long filenum, StringRef pathname);
     size_t AddFile(const FileEntry* file);
     unsigned long AddDir(StringRef dirname);
+    void IndexFile(size_t filenum);
+    void UnindexFile(size_t filenum);
 };
 
 class YASM_STD_EXPORT DwarfPassDebug : public DwarfDebug
 {
 public:
-    DwarfPassDebug(const DebugFormatModule& module, Object& object)
-        : DwarfDebug(module, object)
+    DwarfPassDebug(const DebugFormatModule& module,
+                   Object& object,
+                   unsigned int version = 2)
+        : DwarfDebug(module, object, version)
     {}
     ~DwarfPassDebug();
 
@@ -265,6 +337,32 @@ public:
                   DiagnosticsEngine& diags);
 };
 
+class YASM_STD_EXPORT Dwarf5Debug : public DwarfDebug
+{
+public:
+    Dwarf5Debug(const DebugFormatModule& module, Object& object)
+        : DwarfDebug(module, object, 5)
+    {}
+    ~Dwarf5Debug();
+
+    static StringRef getName() { return "DWARF 5 debugging format"; }
+    static StringRef getKeyword() { return "dwarf5"; }
+    static bool isOkObject(Object& object) { return true; }
+};
+
+class YASM_STD_EXPORT Dwarf5PassDebug : public DwarfPassDebug
+{
+public:
+    Dwarf5PassDebug(const DebugFormatModule& module, Object& object)
+        : DwarfPassDebug(module, object, 5)
+    {}
+    ~Dwarf5PassDebug();
+
+    static StringRef getName() { return "DWARF 5 passthrough only"; }
+    static StringRef getKeyword() { return "dwarf5pass"; }
+    static bool isOkObject(Object& object) { return true; }
+};
+
 class YASM_STD_EXPORT CfiDebug : public DwarfDebug
 {
 public:
@@ -26,8 +26,10 @@
 //
 #include "DwarfDebug.h"
 
+#include "yasmx/Arch.h"
 #include "yasmx/Bytecode.h"
 #include "yasmx/BytecodeContainer.h"
+#include "yasmx/Bytes_util.h"
 #include "yasmx/Expr.h"
 #include "yasmx/Object.h"
 #include "yasmx/ObjectFormat.h"
@@ -59,10 +61,27 @@ DwarfDebug::Generate_aranges(Section& debug_info)
     }
 
     // header
-    Location head = AppendHead(*debug_aranges, &debug_info, true, true);
+    Location head = AppendHead(*debug_aranges, 2, &debug_info, true, true);
     AppendAlign(*debug_aranges, Expr(m_sizeof_address), Expr(), Expr(), 0,
                 SourceLocation());
 
+    // Debug information is generated after optimization, so section sizes
+    // are final.  Build the whole descriptor table into a single bytecode:
+    // the lengths are written directly, and only the start addresses need
+    // fixups.
+    Bytecode& bc = debug_aranges->FreshBytecode();
+    Bytes& fixed = bc.getFixed();
+    m_object.getArch()->setEndian(fixed);
+
+    size_t nranges = 0;
+    for (Object::const_section_iterator i=m_object.sections_begin(),
+         end=m_object.sections_end(); i != end; ++i)
+    {
+        if (i->getAssocData<DwarfSection>())
+            ++nranges;
+    }
+    fixed.reserve(fixed.size() + (nranges+1)*2*m_sizeof_address);
+
     for (Object::section_iterator i=m_object.sections_begin(),
          end=m_object.sections_end(); i != end; ++i)
     {
@@ -71,19 +90,15 @@ DwarfDebug::Generate_aranges(Section& debug_info)
             continue;   // no line data for this section
 
         // Create address range descriptor
-        Expr::Ptr start(new Expr(i->getSymbol()));
-        AppendData(*debug_aranges, start, m_sizeof_address, *m_object.getArch(),
-                   SourceLocation(), *m_diags);
-
-        IntNum length;
-        CalcDist(i->getBeginLoc(), i->getEndLoc(), &length);
-        AppendData(*debug_aranges, length, m_sizeof_address,
-                   *m_object.getArch());
+        bc.AppendFixed(m_sizeof_address, Expr::Ptr(new Expr(i->getSymbol())),
+                       SourceLocation());
+        WriteN(fixed, IntNum(i->getEndLoc().getOffset() -
+                             i->getBeginLoc().getOffset()),
+               m_sizeof_address*8);
     }
 
     // Terminate with empty address range descriptor
-    AppendData(*debug_aranges, 0, m_sizeof_address, *m_object.getArch());
-    AppendData(*debug_aranges, 0, m_sizeof_address, *m_object.getArch());
+    fixed.Write(2*m_sizeof_address, 0);
 
     // mark end of aranges information
     debug_aranges->UpdateOffsets(*m_diags);
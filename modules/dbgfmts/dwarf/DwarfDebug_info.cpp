@@ -26,8 +26,14 @@
 //
 #include "DwarfDebug.h"
 
+#include <cstdlib>
+
 #include "config.h"
 #include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "yasmx/Basic/Diagnostic.h"
+#include "yasmx/Support/MD5.h"
+#include "yasmx/Support/OutputFileStream.h"
 #include "yasmx/Bytecode.h"
 #include "yasmx/Bytes.h"
 #include "yasmx/Bytes_leb128.h"
@@ -66,8 +72,38 @@ AppendAbbrevTail(Bytes& bytes)
     Write8(bytes, 0);
 }
 
+std::string
+DwarfDebug::getCompDir()
+{
+    if (std::getenv("YASM_TEST_SUITE"))
+        return "/";
+    return llvm::sys::Path::GetCurrentDirectory().str();
+}
+
+void
+DwarfDebug::getDwoId(unsigned char id[16])
+{
+    // Hash everything that identifies this unit.  The strings are
+    // separated by their terminating NULs.
+    StringRef name = getPrimaryFilename();
+    std::string comp_dir = getCompDir();
+    StringRef dwo_name = m_object.getConfig().SplitDwarfFile;
+
+    MD5 md5;
+    md5.Update(reinterpret_cast<const unsigned char*>(name.data()),
+               name.size());
+    md5.Update(reinterpret_cast<const unsigned char*>(""), 1);
+    md5.Update(reinterpret_cast<const unsigned char*>(comp_dir.c_str()),
+               comp_dir.size()+1);
+    md5.Update(reinterpret_cast<const unsigned char*>(dwo_name.data()),
+               dwo_name.size());
+    md5.Final(id);
+}
+
 Section&
-DwarfDebug::Generate_info(Section& debug_line, Section* main_code)
+DwarfDebug::Generate_info(Section& debug_line,
+                          Section* main_code,
+                          const unsigned char* dwo_id)
 {
     Section& debug_abbrev =
         *m_objfmt->AppendSection(".debug_abbrev", SourceLocation(), *m_diags);
@@ -79,10 +115,29 @@ DwarfDebug::Generate_info(Section& debug_line, Section* main_code)
 
     // Create abbreviation table entry for compilation unit
     Bytes& abbrev = debug_abbrev.FreshBytecode().getFixed();
-    AppendAbbrevHeader(abbrev, 1, DW_TAG_compile_unit, false);
+    AppendAbbrevHeader(abbrev, 1,
+                       dwo_id ? DW_TAG_skeleton_unit : DW_TAG_compile_unit,
+                       false);
 
-    // info header
-    Location head = AppendHead(debug_info, &debug_abbrev, true, false);
+    // info header; DWARF 5 adds a unit type and moves the address size
+    // ahead of the abbreviation offset
+    Location head;
+    if (m_version >= 5)
+    {
+        head = AppendHead(debug_info, 5, NULL, false, false);
+        AppendByte(debug_info, dwo_id ? DW_UT_skeleton : DW_UT_compile);
+        AppendByte(debug_info, m_sizeof_address);
+        AppendData(debug_info, Expr::Ptr(new Expr(debug_abbrev.getSymbol())),
+                   m_sizeof_offset, *m_object.getArch(), SourceLocation(),
+                   *m_diags);
+        if (dwo_id)
+        {
+            Bytes& id = debug_info.FreshBytecode().getFixed();
+            id.insert(id.end(), dwo_id, dwo_id+8);
+        }
+    }
+    else
+        head = AppendHead(debug_info, 2, &debug_abbrev, true, false);
 
     // Generate abbreviations at the same time as info (since they're linked
     // and we're only generating one piece of info).
@@ -91,7 +146,8 @@ DwarfDebug::Generate_info(Section& debug_line, Section* main_code)
     AppendLEB128(debug_info, 1, false, SourceLocation(), *m_diags);
 
     // statement list (line numbers)
-    AppendAbbrevAttr(abbrev, DW_AT_stmt_list, DW_FORM_data4);
+    AppendAbbrevAttr(abbrev, DW_AT_stmt_list,
+                     m_version >= 4 ? DW_FORM_sec_offset : DW_FORM_data4);
     AppendData(debug_info, Expr::Ptr(new Expr(debug_line.getSymbol())),
                m_sizeof_offset, *m_object.getArch(), SourceLocation(),
                *m_diags);
@@ -113,32 +169,131 @@ DwarfDebug::Generate_info(Section& debug_line, Section* main_code)
     }
 
     // input filename: use file 1 if specified, otherwise use source filename
-    AppendAbbrevAttr(abbrev, DW_AT_name, DW_FORM_string);
-    if (!m_filenames.empty() && !m_filenames[0].pathname.empty())
-        AppendData(debug_info, m_filenames[0].pathname, true);
-    else
-        AppendData(debug_info, m_object.getSourceFilename(), true);
+    StringRef name = getPrimaryFilename();
 
     // compile directory (current working directory)
-    AppendAbbrevAttr(abbrev, DW_AT_comp_dir, DW_FORM_string);
-    AppendData(debug_info, llvm::sys::Path::GetCurrentDirectory().str(), true);
+    std::string comp_dir = getCompDir();
+
+    if (dwo_id)
+    {
+        // a skeleton names the split DWARF file instead; everything else
+        // is in the split unit
+        AppendAbbrevAttr(abbrev, DW_AT_dwo_name, DW_FORM_line_strp);
+        AppendLineStrp(debug_info.FreshBytecode(),
+                       m_object.getConfig().SplitDwarfFile);
+        AppendAbbrevAttr(abbrev, DW_AT_comp_dir, DW_FORM_line_strp);
+        AppendLineStrp(debug_info.FreshBytecode(), comp_dir);
+    }
+    else if (m_version >= 5)
+    {
+        // share the strings with the line number header
+        AppendAbbrevAttr(abbrev, DW_AT_name, DW_FORM_line_strp);
+        AppendLineStrp(debug_info.FreshBytecode(), name);
+        AppendAbbrevAttr(abbrev, DW_AT_comp_dir, DW_FORM_line_strp);
+        AppendLineStrp(debug_info.FreshBytecode(), comp_dir);
+    }
+    else
+    {
+        AppendAbbrevAttr(abbrev, DW_AT_name, DW_FORM_string);
+        AppendData(debug_info, name, true);
+        AppendAbbrevAttr(abbrev, DW_AT_comp_dir, DW_FORM_string);
+        AppendData(debug_info, comp_dir, true);
+    }
+
+    if (!dwo_id)
+        AppendProducer(debug_info, abbrev);
 
-    // producer - assembler name
+    // Terminate list of abbreviations
+    AppendAbbrevTail(abbrev);
+    Write8(abbrev, 0);
+
+    // mark end of info
+    debug_info.UpdateOffsets(*m_diags);
+    setHeadEnd(head, debug_info.getEndLoc());
+
+    return debug_info;
+}
+
+void
+DwarfDebug::AppendProducer(Section& debug_info, Bytes& abbrev)
+{
+    // producer - assembler name (without the version in the test suite)
     AppendAbbrevAttr(abbrev, DW_AT_producer, DW_FORM_string);
-    AppendData(debug_info, PACKAGE_NAME " " PACKAGE_VERSION, true);
+    AppendData(debug_info, std::getenv("YASM_TEST_SUITE") ?
+               PACKAGE_NAME : PACKAGE_NAME " " PACKAGE_VERSION, true);
 
     // language - no standard code for assembler, use MIPS as a substitute
     AppendAbbrevAttr(abbrev, DW_AT_language, DW_FORM_data2);
     AppendData(debug_info, static_cast<unsigned int>(DW_LANG_Mips_Assembler),
                2, *m_object.getArch());
+}
+
+void
+DwarfDebug::OutputDwo(const unsigned char* dwo_id)
+{
+    StringRef filename = m_object.getConfig().SplitDwarfFile;
+
+    // The split DWARF file is a separate object with the same format.  It
+    // has no relocations, as the split unit does not reference addresses or
+    // other sections.
+    Object dwo(m_object.getSourceFilename(), filename, m_object.getArch());
+    std::auto_ptr<ObjectFormat> dwo_objfmt =
+        m_objfmt->getModule().Create(dwo);
+
+    Section& debug_abbrev = *dwo_objfmt->AppendSection(".debug_abbrev.dwo",
+                                                       SourceLocation(),
+                                                       *m_diags);
+    Section& debug_info = *dwo_objfmt->AppendSection(".debug_info.dwo",
+                                                     SourceLocation(),
+                                                     *m_diags);
+    debug_abbrev.setAlign(0);
+    debug_info.setAlign(0);
+
+    Bytes& abbrev = debug_abbrev.FreshBytecode().getFixed();
+    AppendAbbrevHeader(abbrev, 1, DW_TAG_compile_unit, false);
+
+    // split unit header; abbreviations are at the start of the (only)
+    // abbreviation table
+    Location head = AppendHead(debug_info, 5, NULL, false, false);
+    AppendByte(debug_info, DW_UT_split_compile);
+    AppendByte(debug_info, m_sizeof_address);
+    AppendData(debug_info, 0, m_sizeof_offset, *m_object.getArch());
+    Bytes& id = debug_info.FreshBytecode().getFixed();
+    id.insert(id.end(), dwo_id, dwo_id+8);
+
+    AppendLEB128(debug_info, 1, false, SourceLocation(), *m_diags);
+
+    // strings are inline as the split file has no string offset table
+    AppendAbbrevAttr(abbrev, DW_AT_name, DW_FORM_string);
+    AppendData(debug_info, getPrimaryFilename(), true);
+
+    AppendProducer(debug_info, abbrev);
 
-    // Terminate list of abbreviations
     AppendAbbrevTail(abbrev);
     Write8(abbrev, 0);
 
-    // mark end of info
+    debug_abbrev.UpdateOffsets(*m_diags);
     debug_info.UpdateOffsets(*m_diags);
     setHeadEnd(head, debug_info.getEndLoc());
+    debug_abbrev.Finalize(*m_diags);
+    debug_info.Finalize(*m_diags);
 
-    return debug_info;
+    std::string err;
+    raw_fd_ostream fd(filename.str().c_str(), err, raw_fd_ostream::F_Binary);
+    if (!err.empty())
+    {
+        m_diags->Report(SourceLocation(), diag::err_cannot_open_file)
+            << filename << err;
+        return;
+    }
+
+    OutputFileStream os(fd);
+    dwo_objfmt->Output(os, false, *this, *m_diags);
+    if (!m_diags->hasErrorOccurred())
+        os.close();
+    if (fd.has_error())
+    {
+        m_diags->Report(SourceLocation(), diag::err_file_output_write);
+        fd.clear_error();
+    }
 }
@@ -31,14 +31,22 @@
 
 #include <algorithm>
 
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
 #include "yasmx/Basic/Diagnostic.h"
 #include "yasmx/Basic/FileManager.h"
 #include "yasmx/Basic/SourceManager.h"
 #include "yasmx/Parse/Directive.h"
+#include "yasmx/Parse/IdentifierTable.h"
 #include "yasmx/Parse/NameValue.h"
+#include "yasmx/Parse/ParserImpl.h"
+#include "yasmx/Support/MD5.h"
+#include "yasmx/Arch.h"
 #include "yasmx/Bytecode.h"
 #include "yasmx/BytecodeContainer.h"
+#include "yasmx/Bytes.h"
 #include "yasmx/Bytes_leb128.h"
 #include "yasmx/Bytes_util.h"
 #include "yasmx/Expr.h"
@@ -103,38 +111,68 @@ struct DwarfLineState
 };
 }} // namespace yasm::dbgfmt
 
-namespace {
-class MatchFileDir
+// Key for the file index: directory number and filename.
+static StringRef
+FileKey(SmallVectorImpl<char>& key, unsigned long dir, StringRef filename)
 {
-public:
-    MatchFileDir(StringRef name, unsigned long dir)
-        : m_name(name), m_dir(dir)
-    {}
-
-    bool operator() (const DwarfDebug::Filename& file)
-    {
-        if (file.filename.empty())
-            return true;
-        return (m_dir == file.dir && m_name == file.filename);
-    }
-
-private:
-    StringRef m_name;
-    unsigned long m_dir;
-};
-} // anonymous namespace
+    key.clear();
+    llvm::raw_svector_ostream os(key);
+    os << dir << '/' << filename;
+    return os.str();
+}
 
 unsigned long
 DwarfDebug::AddDir(StringRef dirname)
 {
     // Put the directory into the directory table (checking for duplicates)
-    Dirs::iterator d =
-        std::find(m_dirs.begin(), m_dirs.end(), dirname);
-    if (d != m_dirs.end())
-        return d-m_dirs.begin();
+    llvm::StringMapEntry<unsigned long>& d =
+        m_dir_index.GetOrCreateValue(dirname, m_dirs.size());
+    if (d.getValue() == m_dirs.size())
+        m_dirs.push_back(dirname);
+    return d.getValue();
+}
+
+void
+DwarfDebug::IndexFile(size_t filenum)
+{
+    const Filename& f = m_filenames[filenum];
+    if (f.filename.empty())
+    {
+        if (filenum < m_first_free_file)
+            m_first_free_file = filenum;
+        return;
+    }
+    SmallString<64> key;
+    llvm::StringMapEntry<size_t>& entry =
+        m_file_index.GetOrCreateValue(FileKey(key, f.dir, f.filename),
+                                      filenum);
+    if (filenum < entry.getValue())
+        entry.setValue(filenum);
+}
+
+void
+DwarfDebug::UnindexFile(size_t filenum)
+{
+    const Filename& f = m_filenames[filenum];
+    if (f.filename.empty())
+        return;
+    SmallString<64> key;
+    llvm::StringMap<size_t>::iterator entry =
+        m_file_index.find(FileKey(key, f.dir, f.filename));
+    if (entry == m_file_index.end() || entry->getValue() != filenum)
+        return;
 
-    m_dirs.push_back(dirname);
-    return m_dirs.size()-1;
+    // Fall back to any later duplicate of the entry being replaced.
+    // Redefining a file number is rare, so a scan is acceptable here.
+    for (size_t i=filenum+1, end=m_filenames.size(); i<end; ++i)
+    {
+        if (m_filenames[i].dir == f.dir && m_filenames[i].filename == f.filename)
+        {
+            entry->setValue(i);
+            return;
+        }
+    }
+    m_file_index.erase(entry);
 }
 
 size_t
@@ -142,26 +180,28 @@ DwarfDebug::AddFile(const FileEntry* file)
 {
     unsigned long dir = AddDir(file->getDir()->getName());
 
-    // Put the filename into the filename table (checking for duplicates)
-    Filenames::iterator f = std::find_if(m_filenames.begin(), m_filenames.end(),
-                                         MatchFileDir(file->getName(), dir));
-
-    size_t filenum;
-    if (f != m_filenames.end())
-    {
-        filenum = f-m_filenames.begin();
-        if (!f->filename.empty())
-            return filenum;
-    }
-    else
-    {
-        filenum = m_filenames.size();
+    // Put the filename into the filename table (checking for duplicates).
+    // Unused entries left by sparse .file numbering are filled first, so
+    // the first empty or matching entry is used.
+    while (m_first_free_file < m_filenames.size() &&
+           !m_filenames[m_first_free_file].filename.empty())
+        ++m_first_free_file;
+
+    SmallString<64> key;
+    llvm::StringMap<size_t>::iterator f =
+        m_file_index.find(FileKey(key, dir, file->getName()));
+    if (f != m_file_index.end() && f->getValue() < m_first_free_file)
+        return f->getValue();
+
+    size_t filenum = m_first_free_file;
+    if (filenum == m_filenames.size())
         m_filenames.push_back(Filename());
-    }
     m_filenames[filenum].filename = file->getName();
     m_filenames[filenum].dir = dir;
     m_filenames[filenum].time = file->getModificationTime();
     m_filenames[filenum].length = file->getSize();
+    m_filenames[filenum].has_md5 = false;
+    IndexFile(filenum);
     return filenum;
 }
 
@@ -180,6 +220,8 @@ DwarfDebug::AddFile(unsigned long filenum, StringRef pathname)
     // Ensure table is sufficient size
     if (filenum >= m_filenames.size())
         m_filenames.resize(filenum+1);
+    else
+        UnindexFile(filenum);
 
     // Save in table
     m_filenames[filenum].pathname = pathname;
@@ -187,48 +229,135 @@ DwarfDebug::AddFile(unsigned long filenum, StringRef pathname)
     m_filenames[filenum].dir = dir;
     m_filenames[filenum].time = 0;
     m_filenames[filenum].length = 0;
+    m_filenames[filenum].has_md5 = false;
+    IndexFile(filenum);
 
     return filenum;
 }
 
-// Create and add a new line opcode to a section.
-void
-DwarfDebug::AppendLineOp(BytecodeContainer& container,
-                          unsigned int opcode)
+StringRef
+DwarfDebug::getPrimaryFilename() const
 {
-    AppendByte(container, opcode);
+    if (!m_filenames.empty() && !m_filenames[0].pathname.empty())
+        return m_filenames[0].pathname;
+    return m_object.getSourceFilename();
 }
 
-void
-DwarfDebug::AppendLineOp(BytecodeContainer& container,
-                          unsigned int opcode,
-                          const IntNum& operand)
+// Get the MD5 digest of a source file.  Only files read by the source
+// manager are considered, so no extra file I/O is needed.
+static bool
+getFileMD5(SourceManager& smgr, StringRef path, unsigned char digest[16])
 {
-    AppendByte(container, opcode);
-    AppendLEB128(container, operand, opcode == DW_LNS_advance_line,
-                 SourceLocation(), *m_diags);
+    const FileEntry* file = smgr.getFileManager().getFile(path);
+    if (!file || !smgr.hasFileInfo(file))
+        return false;
+    bool invalid = false;
+    const llvm::MemoryBuffer* buf = smgr.getMemoryBufferForFile(file, &invalid);
+    if (invalid || !buf)
+        return false;
+
+    MD5 md5;
+    md5.Update(reinterpret_cast<const unsigned char*>(buf->getBufferStart()),
+               buf->getBufferSize());
+    md5.Final(digest);
+    return true;
+}
+
+bool
+DwarfDebug::FindFileMD5s(SourceManager& smgr)
+{
+    bool all = true;
+    for (Filenames::iterator i=m_filenames.begin(), end=m_filenames.end();
+         i != end; ++i)
+    {
+        if (!i->has_md5)
+        {
+            StringRef path = i->pathname.empty() ? i->filename : i->pathname;
+            i->has_md5 = getFileMD5(smgr, path, i->md5);
+        }
+        all = all && i->has_md5;
+    }
+    return all;
 }
 
-// Create and add a new extended line opcode to a section.
 void
-DwarfDebug::AppendLineExtOp(BytecodeContainer& container,
-                            DwarfLineNumberExtOp ext_opcode)
+DwarfDebug::AppendLineStrp(Bytecode& bc, StringRef str)
 {
-    AppendByte(container, DW_LNS_extended_op);
-    AppendLEB128(container, 1, false, SourceLocation(), *m_diags);
-    AppendByte(container, ext_opcode);
+    if (!m_line_str)
+    {
+        m_line_str = m_object.FindSection(".debug_line_str");
+        if (!m_line_str)
+        {
+            m_line_str = m_objfmt->AppendSection(".debug_line_str",
+                                                 SourceLocation(), *m_diags);
+            m_line_str->setAlign(0);
+        }
+        // Strings are appended after any existing section contents.
+        m_line_str->UpdateOffsets(*m_diags);
+        unsigned long end = m_line_str->bytecodes_back().getNextOffset();
+        Bytecode& strbc = m_line_str->FreshBytecode();
+        m_line_str_data = &strbc.getFixed();
+        m_line_str_base = end - strbc.getFixedLen();
+    }
+
+    llvm::StringMapEntry<unsigned long>& entry =
+        m_line_str_index.GetOrCreateValue(str, ~0UL);
+    if (entry.getValue() == ~0UL)
+    {
+        entry.setValue(m_line_str_base + m_line_str_data->size());
+        m_line_str_data->WriteString(str);
+        Write8(*m_line_str_data, 0);
+    }
+
+    Expr::Ptr strp(new Expr(m_line_str->getSymbol()));
+    strp->Calc(Op::ADD, entry.getValue());
+    bc.AppendFixed(m_sizeof_offset, strp, SourceLocation());
 }
 
 void
-DwarfDebug::AppendLineExtOp(BytecodeContainer& container,
-                            DwarfLineNumberExtOp ext_opcode,
-                            const IntNum& operand)
+DwarfDebug::AppendFileEntry(Bytecode& bc,
+                            StringRef pathname,
+                            unsigned long dir,
+                            /*@null@*/ const unsigned char* md5)
 {
-    AppendByte(container, DW_LNS_extended_op);
-    AppendLEB128(container, 1 + SizeLEB128(operand, false), false,
-                 SourceLocation(), *m_diags);
-    AppendByte(container, ext_opcode);
-    AppendLEB128(container, operand, false, SourceLocation(), *m_diags);
+    AppendLineStrp(bc, pathname);           // DW_LNCT_path
+    WriteULEB128(bc.getFixed(), dir);       // DW_LNCT_directory_index
+    if (md5)                                // DW_LNCT_MD5
+        bc.getFixed().Write(ArrayRef<unsigned char>(md5, 16));
+}
+
+// Write a line opcode to a line number program.
+static inline void
+WriteLineOp(Bytes& program, unsigned int opcode)
+{
+    program.push_back(static_cast<unsigned char>(opcode));
+}
+
+static inline void
+WriteLineOp(Bytes& program, unsigned int opcode, const IntNum& operand)
+{
+    program.push_back(static_cast<unsigned char>(opcode));
+    WriteLEB128(program, operand, opcode == DW_LNS_advance_line);
+}
+
+// Write an extended line opcode to a line number program.
+static void
+WriteLineExtOp(Bytes& program, DwarfLineNumberExtOp ext_opcode)
+{
+    program.push_back(DW_LNS_extended_op);
+    program.push_back(1);
+    program.push_back(static_cast<unsigned char>(ext_opcode));
+}
+
+static void
+WriteLineExtOp(Bytes& program,
+               DwarfLineNumberExtOp ext_opcode,
+               const IntNum& operand)
+{
+    program.push_back(DW_LNS_extended_op);
+    WriteULEB128(program, 1 + SizeLEB128(operand, false));
+    program.push_back(static_cast<unsigned char>(ext_opcode));
+    WriteULEB128(program, operand);
 }
 
 void
@@ -246,7 +375,7 @@ DwarfDebug::AppendLineExtOp(BytecodeContainer& container,
 }
 
 void
-DwarfDebug::GenerateLineOp(Section& debug_line,
+DwarfDebug::GenerateLineOp(Bytes& program,
                            DwarfLineState* state,
                            const DwarfLoc& loc,
                            const DwarfLoc* nextloc)
@@ -254,59 +383,59 @@ DwarfDebug::GenerateLineOp(Section& debug_line,
     if (state->file != loc.file)
     {
         state->file = loc.file;
-        AppendLineOp(debug_line, DW_LNS_set_file, state->file);
+        WriteLineOp(program, DW_LNS_set_file, state->file);
     }
     if (state->column != loc.column)
     {
         state->column = loc.column;
-        AppendLineOp(debug_line, DW_LNS_set_column, state->column);
+        WriteLineOp(program, DW_LNS_set_column, state->column);
     }
     if (loc.discriminator != 0)
     {
-        AppendLineExtOp(debug_line, DW_LNE_set_discriminator,
-                        loc.discriminator);
+        WriteLineExtOp(program, DW_LNE_set_discriminator, loc.discriminator);
     }
 #ifdef WITH_DWARF3
     if (loc.isa_change)
     {
         state->isa = loc.isa;
-        AppendLineOp(debug_line, DW_LNS_set_isa, state->isa);
+        WriteLineOp(program, DW_LNS_set_isa, state->isa);
     }
 #endif
     if (!state->is_stmt && loc.is_stmt == DwarfLoc::IS_STMT_SET)
     {
         state->is_stmt = true;
-        AppendLineOp(debug_line, DW_LNS_negate_stmt);
+        WriteLineOp(program, DW_LNS_negate_stmt);
     }
     else if (state->is_stmt && loc.is_stmt == DwarfLoc::IS_STMT_CLEAR)
     {
         state->is_stmt = false;
-        AppendLineOp(debug_line, DW_LNS_negate_stmt);
+        WriteLineOp(program, DW_LNS_negate_stmt);
     }
     if (loc.basic_block)
     {
-        AppendLineOp(debug_line, DW_LNS_set_basic_block);
+        WriteLineOp(program, DW_LNS_set_basic_block);
     }
 #ifdef WITH_DWARF3
     if (loc.prologue_end)
     {
-        AppendLineOp(debug_line, DW_LNS_set_prologue_end);
+        WriteLineOp(program, DW_LNS_set_prologue_end);
     }
     if (loc.epilogue_begin)
     {
-        AppendLineOp(debug_line, DW_LNS_set_epilogue_begin);
+        WriteLineOp(program, DW_LNS_set_epilogue_begin);
     }
 #endif
 
-    IntNum addr_delta;
-    if (!state->prevloc.bc)
-    {
-        addr_delta.Zero();
-    }
-    else
+    // Offsets are final by the time debug information is generated, so the
+    // address delta is a plain difference within the section.
+    unsigned long addr_delta = 0;
+    if (state->prevloc.bc)
     {
-        CalcDist(state->prevloc, loc.loc, &addr_delta);
-        assert(addr_delta.getSign() >= 0 && "dwarf2 address went backwards");
+        assert(state->prevloc.bc->getContainer() == loc.loc.bc->getContainer());
+        unsigned long prev_addr = state->prevloc.getOffset();
+        unsigned long addr = loc.loc.getOffset();
+        assert(addr >= prev_addr && "dwarf2 address went backwards");
+        addr_delta = addr - prev_addr;
     }
 
     // Generate appropriate opcode(s).  Address can only increment,
@@ -320,7 +449,7 @@ DwarfDebug::GenerateLineOp(Section& debug_line,
         || line_delta >= DWARF_LINE_BASE+DWARF_LINE_RANGE)
     {
         // Won't fit in special opcode, use (signed) line advance
-        AppendLineOp(debug_line, DW_LNS_advance_line, line_delta);
+        WriteLineOp(program, DW_LNS_advance_line, line_delta);
         line_delta.Zero();
     }
 
@@ -328,38 +457,38 @@ DwarfDebug::GenerateLineOp(Section& debug_line,
     int opcode1, opcode2;
     opcode1 = opcode2 =
         DWARF_LINE_OPCODE_BASE + line_delta.getInt() - DWARF_LINE_BASE;
-    opcode1 += DWARF_LINE_RANGE * (addr_delta.getUInt() / m_min_insn_len);
+    opcode1 += DWARF_LINE_RANGE * (addr_delta / m_min_insn_len);
     opcode2 += DWARF_LINE_RANGE *
-        ((addr_delta.getUInt() - DWARF_MAX_SPECIAL_ADDR_DELTA) / m_min_insn_len);
-    if (line_delta.isZero() && addr_delta.isZero())
+        ((addr_delta - DWARF_MAX_SPECIAL_ADDR_DELTA) / m_min_insn_len);
+    if (line_delta.isZero() && addr_delta == 0)
     {
         // Both line and addr deltas are 0: do DW_LNS_copy
-        AppendLineOp(debug_line, DW_LNS_copy);
+        WriteLineOp(program, DW_LNS_copy);
     }
-    else if (addr_delta.getUInt() <= DWARF_MAX_SPECIAL_ADDR_DELTA &&
+    else if (addr_delta <= DWARF_MAX_SPECIAL_ADDR_DELTA &&
              opcode1 <= 255)
     {
         // Addr delta in range of special opcode
-        AppendLineOp(debug_line, opcode1);
+        WriteLineOp(program, opcode1);
     }
-    else if (addr_delta.getUInt() <= 2*DWARF_MAX_SPECIAL_ADDR_DELTA &&
+    else if (addr_delta <= 2*DWARF_MAX_SPECIAL_ADDR_DELTA &&
              opcode2 <= 255)
     {
         // Addr delta in range of const_add_pc + special
-        AppendLineOp(debug_line, DW_LNS_const_add_pc);
-        AppendLineOp(debug_line, opcode2);
+        WriteLineOp(program, DW_LNS_const_add_pc);
+        WriteLineOp(program, opcode2);
     }
     else
     {
         // Need advance_pc
-        AppendLineOp(debug_line, DW_LNS_advance_pc, addr_delta);
+        WriteLineOp(program, DW_LNS_advance_pc, addr_delta);
         // Take care of any remaining line_delta and add entry to matrix
         if (line_delta.isZero())
-            AppendLineOp(debug_line, DW_LNS_copy);
+            WriteLineOp(program, DW_LNS_copy);
         else
         {
-            AppendLineOp(debug_line, DWARF_LINE_OPCODE_BASE +
-                                     line_delta.getInt() - DWARF_LINE_BASE);
+            WriteLineOp(program, DWARF_LINE_OPCODE_BASE +
+                                 line_delta.getInt() - DWARF_LINE_BASE);
         }
     }
     state->prevloc = loc.loc;
@@ -439,6 +568,9 @@ DwarfDebug::GenerateLineSection(Section& sect,
     AppendLineExtOp(debug_line, DW_LNE_set_address, m_sizeof_address,
                     sect.getSymbol());
 
+    // The rest of the sequence is plain data; build it in one buffer.
+    Bytes& program = debug_line.FreshBytecode().getFixed();
+
     if (asm_source)
     {
 #if 0
@@ -454,11 +586,12 @@ DwarfDebug::GenerateLineSection(Section& sect,
     }
     else
     {
+        program.reserve(program.size() + 2*dwarf2sect->locs.size());
         for (DwarfSection::Locs::const_iterator i=dwarf2sect->locs.begin(),
              end=dwarf2sect->locs.end(); i != end; ++i)
         {
             DwarfSection::Locs::const_iterator next = i+1;
-            GenerateLineOp(debug_line, &state, *i, next != end ? &*next : 0);
+            GenerateLineOp(program, &state, *i, next != end ? &*next : 0);
         }
     }
 
@@ -467,13 +600,13 @@ DwarfDebug::GenerateLineSection(Section& sect,
     // want an extra entry in the line matrix.
     if (!state.prevloc.bc)
         state.prevloc = sect.getBeginLoc();
-    IntNum addr_delta;
-    CalcDist(state.prevloc, sect.getEndLoc(), &addr_delta);
+    unsigned long addr_delta =
+        sect.getEndLoc().getOffset() - state.prevloc.getOffset();
     if (addr_delta == DWARF_MAX_SPECIAL_ADDR_DELTA)
-        AppendLineOp(debug_line, DW_LNS_const_add_pc);
+        WriteLineOp(program, DW_LNS_const_add_pc);
     else if (addr_delta > 0)
-        AppendLineOp(debug_line, DW_LNS_advance_pc, addr_delta);
-    AppendLineExtOp(debug_line, DW_LNE_end_sequence);
+        WriteLineOp(program, DW_LNS_advance_pc, addr_delta);
+    WriteLineExtOp(program, DW_LNE_end_sequence);
 }
 
 Section&
@@ -500,11 +633,12 @@ DwarfDebug::Generate_line(SourceManager& smgr,
         debug_line->setAlign(0);
     }
 
-    // header
-    Location head = AppendHead(*debug_line, NULL, false, false);
+    // header; DWARF 5 adds address and segment selector sizes
+    Location head = AppendHead(*debug_line, m_version, NULL, m_version >= 5,
+                               m_version >= 5);
 
     // statement program prologue
-    AppendSPP(*debug_line);
+    AppendSPP(*debug_line, smgr);
 
     // statement program
     *num_line_sections = 0;
@@ -528,11 +662,19 @@ DwarfDebug::Generate_line(SourceManager& smgr,
 }
 
 void
-DwarfDebug::AppendSPP(BytecodeContainer& container)
+DwarfDebug::AppendSPP(BytecodeContainer& container, SourceManager& smgr)
 {
-    Bytes bytes;
+    Bytecode& bc = container.FreshBytecode();
+    Bytes& bytes = bc.getFixed();
+    m_object.getArch()->setEndian(bytes);
+
+    // Prologue length (following this field); filled in at the end
+    Bytes::size_type head = bytes.size();
+    bytes.Write(m_sizeof_offset, 0);
 
     Write8(bytes, m_min_insn_len);                  // minimum_instr_len
+    if (m_version >= 4)
+        Write8(bytes, 1);                           // maximum_ops_per_instr
     Write8(bytes, DWARF_LINE_DEFAULT_IS_STMT);      // default_is_stmt
     Write8(bytes, DWARF_LINE_BASE);                 // line_base
     Write8(bytes, DWARF_LINE_RANGE);                // line_range
@@ -542,14 +684,55 @@ DwarfDebug::AppendSPP(BytecodeContainer& container)
     for (unsigned int i=0; i<NELEMS(line_opcode_num_operands); ++i)
         Write8(bytes, line_opcode_num_operands[i]);
 
-    // directory list
-    for (Dirs::const_iterator i=m_dirs.begin(), end=m_dirs.end(); i != end; ++i)
+    bool with_md5 = false;
+    if (m_version >= 5)
     {
-        bytes.WriteString(*i);
+        // Path names are references into .debug_line_str, so identical
+        // names are shared, and can be merged across objects by the linker.
+        // Directory 0 is the compilation directory and file 0 the primary
+        // source file; the rest keep the numbering used by .file.
+        with_md5 = FindFileMD5s(smgr);
+        unsigned char primary_md5[16];
+        StringRef primary = getPrimaryFilename();
+        if (with_md5)
+            with_md5 = getFileMD5(smgr, primary, primary_md5);
+
+        // directory table
+        Write8(bytes, 1);                           // format count
+        WriteULEB128(bytes, DW_LNCT_path);
+        WriteULEB128(bytes, DW_FORM_line_strp);
+        WriteULEB128(bytes, m_dirs.size()+1);
+        AppendLineStrp(bc, getCompDir());
+        for (Dirs::const_iterator i=m_dirs.begin(), end=m_dirs.end();
+             i != end; ++i)
+            AppendLineStrp(bc, *i);
+
+        // filename table
+        Write8(bytes, with_md5 ? 3 : 2);            // format count
+        WriteULEB128(bytes, DW_LNCT_path);
+        WriteULEB128(bytes, DW_FORM_line_strp);
+        WriteULEB128(bytes, DW_LNCT_directory_index);
+        WriteULEB128(bytes, DW_FORM_udata);
+        if (with_md5)
+        {
+            WriteULEB128(bytes, DW_LNCT_MD5);
+            WriteULEB128(bytes, DW_FORM_data16);
+        }
+        WriteULEB128(bytes, m_filenames.size()+1);
+        AppendFileEntry(bc, primary, 0, with_md5 ? primary_md5 : 0);
+    }
+    else
+    {
+        // directory list
+        for (Dirs::const_iterator i=m_dirs.begin(), end=m_dirs.end();
+             i != end; ++i)
+        {
+            bytes.WriteString(*i);
+            Write8(bytes, 0);
+        }
+        // finish with single 0 byte
         Write8(bytes, 0);
     }
-    // finish with single 0 byte
-    Write8(bytes, 0);
 
     // filename list
     for (Filenames::const_iterator i=m_filenames.begin(), end=m_filenames.end();
@@ -561,6 +744,11 @@ DwarfDebug::AppendSPP(BytecodeContainer& container)
                 << static_cast<unsigned int>((i-m_filenames.begin())+1);
             continue;
         }
+        if (m_version >= 5)
+        {
+            AppendFileEntry(bc, i->filename, i->dir+1, with_md5 ? i->md5 : 0);
+            continue;
+        }
         bytes.WriteString(i->filename);
         Write8(bytes, 0);
 
@@ -569,14 +757,125 @@ DwarfDebug::AppendSPP(BytecodeContainer& container)
         WriteULEB128(bytes, i->length); // length
     }
     // finish with single 0 byte
-    Write8(bytes, 0);
+    if (m_version < 5)
+        Write8(bytes, 0);
 
     // Prologue length (following this field)
-    AppendData(container, bytes.size(), m_sizeof_offset, *m_object.getArch());
+    Bytes len;
+    len.setEndian(bytes);
+    WriteN(len, bytes.size()-head-m_sizeof_offset, m_sizeof_offset*8);
+    std::copy(len.begin(), len.end(), bytes.begin()+head);
+}
+
+// Get the line information for a section, creating it if needed.
+static DwarfSection&
+getDwarfSection(Section& section)
+{
+    DwarfSection* dwarf2sect = section.getAssocData<DwarfSection>();
+    if (!dwarf2sect)
+    {
+        dwarf2sect = new DwarfSection;
+        section.AddAssocData(std::auto_ptr<DwarfSection>(dwarf2sect));
+    }
+    return *dwarf2sect;
+}
 
-    // Prologue data
-    Bytes& fixed = container.FreshBytecode().getFixed();
-    fixed.insert(fixed.end(), bytes.begin(), bytes.end());
+// Get a plain decimal number (as a compiler writes it) from a token.
+static bool
+getDecimal(const Token& tok, unsigned long* val)
+{
+    if (tok.isNot(Token::numeric_constant) || tok.needsCleaning())
+        return false;
+    StringRef str = tok.getLiteral();
+    if (str.empty() || str.size() > 9 || (str[0] == '0' && str.size() > 1))
+        return false;
+    *val = 0;
+    for (StringRef::iterator i=str.begin(), end=str.end(); i != end; ++i)
+    {
+        if (*i < '0' || *i > '9')
+            return false;
+        *val = *val*10 + (*i - '0');
+    }
+    return true;
+}
+
+bool
+DwarfDebug::ParseLoc(DirectiveInfo& info,
+                     ParserImpl& parser,
+                     DiagnosticsEngine& diags)
+{
+    // Only the form compilers emit is handled here: decimal numbers and
+    // known options.  Anything else, including anything DirLoc() would
+    // report an error for, is declined before consuming any tokens.
+    Section* section = m_object.getCurSection();
+    if (!section)
+        return false;
+
+    unsigned long file, line, column = 0, isa = 0, discriminator = 0;
+    unsigned int n = 0;
+    if (!getDecimal(parser.getLookAheadToken(n++), &file) || file == 0 ||
+        !getDecimal(parser.getLookAheadToken(n++), &line))
+        return false;
+    if (getDecimal(parser.getLookAheadToken(n), &column))
+        ++n;
+
+    DwarfLoc::IsStmt is_stmt = DwarfLoc::IS_STMT_NOCHANGE;
+    bool isa_change = false, has_discriminator = false;
+    bool basic_block = false, prologue_end = false, epilogue_begin = false;
+    for (;;)
+    {
+        const Token& tok = parser.getLookAheadToken(n++);
+        if (tok.isEndOfStatement())
+            break;
+        IdentifierInfo* ii = tok.getIdentifierInfo();
+        if (tok.isNot(Token::identifier) || !ii)
+            return false;
+        StringRef name = ii->getName();
+        unsigned long val;
+        if (name.equals_lower("basic_block"))
+            basic_block = true;
+        else if (name.equals_lower("prologue_end"))
+            prologue_end = true;
+        else if (name.equals_lower("epilogue_begin"))
+            epilogue_begin = true;
+        else if (!getDecimal(parser.getLookAheadToken(n++), &val))
+            return false;
+        else if (name.equals_lower("is_stmt") && val <= 1)
+            is_stmt = (val == 0) ? DwarfLoc::IS_STMT_SET
+                                 : DwarfLoc::IS_STMT_CLEAR;
+        else if (name.equals_lower("isa"))
+        {
+            isa_change = true;
+            isa = val;
+        }
+        else if (name.equals_lower("discriminator"))
+        {
+            has_discriminator = true;
+            discriminator = val;
+        }
+        else
+            return false;
+    }
+
+    // Consume everything up to the end of the statement.
+    for (--n; n > 0; --n)
+        parser.ConsumeToken();
+
+    DwarfSection& dwarf2sect = getDwarfSection(*section);
+    Bytecode& herebc = section->FreshBytecode();
+    Location here = { &herebc, herebc.getFixedLen() };
+    dwarf2sect.locs.push_back(DwarfLoc(here, info.getSource(), file, line));
+    DwarfLoc& loc = dwarf2sect.locs.back();
+    loc.column = column;
+    loc.is_stmt = is_stmt;
+    loc.isa_change = isa_change;
+    loc.isa = isa;
+    if (has_discriminator)
+        loc.discriminator = discriminator;
+    loc.basic_block = basic_block;
+    loc.prologue_end = prologue_end;
+    loc.epilogue_begin = epilogue_begin;
+    return true;
 }
 
 void
@@ -632,22 +931,16 @@ DwarfDebug::DirLoc(DirectiveInfo& info, DiagnosticsEngine& diags)
         return;
     }
 
-    DwarfSection* dwarf2sect = section->getAssocData<DwarfSection>();
-    if (!dwarf2sect)
-    {
-        dwarf2sect = new DwarfSection;
-        section->AddAssocData(std::auto_ptr<DwarfSection>(dwarf2sect));
-    }
+    DwarfSection& dwarf2sect = getDwarfSection(*section);
 
     // Defaults for optional settings
     Bytecode& herebc = info.getObject().getCurSection()->FreshBytecode();
     Location here = { &herebc, herebc.getFixedLen() };
-    std::auto_ptr<DwarfLoc> loc(new DwarfLoc(here, info.getSource(),
-                                             file.getUInt(), line.getUInt()));
+    DwarfLoc loc(here, info.getSource(), file.getUInt(), line.getUInt());
 
-    // Optional column number
+    // Optional column number (options are identifiers)
     ++nv;
-    if (nv != end && nv->isExpr())
+    if (nv != end && nv->isExpr() && !nv->isId())
     {
         Expr col_e = nv->getExpr(m_object);
         if (!col_e.isIntNum())
@@ -656,7 +949,7 @@ DwarfDebug::DirLoc(DirectiveInfo& info, DiagnosticsEngine& diags)
                          diag::err_loc_column_number_not_integer);
             return;
         }
-        loc->column = col_e.getIntNum().getUInt();
+        loc.column = col_e.getIntNum().getUInt();
         ++nv;
     }
 
@@ -687,9 +980,9 @@ restart:
             }
             IntNum is_stmt = is_stmt_e.getIntNum();
             if (is_stmt.isZero())
-                loc->is_stmt = DwarfLoc::IS_STMT_SET;
+                loc.is_stmt = DwarfLoc::IS_STMT_SET;
             else if (is_stmt.isPos1())
-                loc->is_stmt = DwarfLoc::IS_STMT_CLEAR;
+                loc.is_stmt = DwarfLoc::IS_STMT_CLEAR;
             else
             {
                 diags.Report(nv->getValueRange().getBegin(),
@@ -720,8 +1013,8 @@ restart:
                              diag::err_loc_isa_less_than_zero);
                 return;
             }
-            loc->isa_change = true;
-            loc->isa = isa.getUInt();
+            loc.isa_change = true;
+            loc.isa = isa.getUInt();
         }
         else if (in_discriminator)
         {
@@ -746,7 +1039,7 @@ restart:
                              diag::err_loc_discriminator_less_than_zero);
                 return;
             }
-            loc->discriminator = discriminator;
+            loc.discriminator = discriminator;
         }
         else if (name.empty() && nv->isId())
         {
@@ -758,11 +1051,11 @@ restart:
             else if (s.equals_lower("discriminator"))
                 in_discriminator = true;
             else if (s.equals_lower("basic_block"))
-                loc->basic_block = true;
+                loc.basic_block = true;
             else if (s.equals_lower("prologue_end"))
-                loc->prologue_end = true;
+                loc.prologue_end = true;
             else if (s.equals_lower("epilogue_begin"))
-                loc->epilogue_begin = true;
+                loc.epilogue_begin = true;
             else
                 diags.Report(nv->getValueRange().getBegin(),
                              diag::warn_unrecognized_loc_option) << s;
@@ -801,7 +1094,7 @@ restart:
     }
 
     // Append new location
-    dwarf2sect->locs.push_back(loc.release());
+    dwarf2sect.locs.push_back(loc);
 }
 
 void
@@ -37,17 +37,17 @@ DwarfLoc::DwarfLoc(Location loc_,
                    SourceLocation source_,
                    unsigned long file_,
                    unsigned long line_)
-    : source(source_)
-    , file(file_)
+    : file(file_)
     , line(line_)
     , column(0)
-    , isa_change(false)
     , isa(0)
+    , loc(loc_)
+    , source(source_)
     , is_stmt(IS_STMT_NOCHANGE)
+    , isa_change(false)
     , basic_block(false)
     , prologue_end(false)
     , epilogue_begin(false)
-    , loc(loc_)
 {
 }
 
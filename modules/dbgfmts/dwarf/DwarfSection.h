@@ -26,8 +26,9 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 //
+#include <vector>
+
 #include "yasmx/Basic/SourceLocation.h"
-#include "yasmx/Support/ptr_vector.h"
 #include "yasmx/AssocData.h"
 #include "yasmx/IntNum.h"
 #include "yasmx/Location.h"
@@ -39,7 +40,8 @@ class Section;
 
 namespace dbgfmt {
 
-/// .loc directive data
+/// .loc directive data.  There is one per line table row, so fields are
+/// ordered to avoid padding.
 struct YASM_STD_EXPORT DwarfLoc
 {
     DwarfLoc(Location loc_,
@@ -47,15 +49,17 @@ struct YASM_STD_EXPORT DwarfLoc
              unsigned long file_,
              unsigned long line_);
 
-    SourceLocation source;    // source location of .loc directive
-
     // source information
     unsigned long file;     // index into table of filenames
     unsigned long line;     // source line number
     unsigned long column;   // source column
-    IntNum discriminator;
-    bool isa_change;
     unsigned long isa;
+    IntNum discriminator;
+
+    Location loc;           // location following
+
+    SourceLocation source;  // source location of .loc directive
+
     enum IsStmt
     {
         IS_STMT_NOCHANGE = 0,
@@ -63,11 +67,10 @@ struct YASM_STD_EXPORT DwarfLoc
         IS_STMT_CLEAR
     };
     IsStmt is_stmt;
+    bool isa_change;
     bool basic_block;
     bool prologue_end;
     bool epilogue_begin;
-
-    Location loc;           // location following
 };
 
 /// Per-section DWARF data
@@ -83,8 +86,8 @@ public:
 #endif // WITH_XML
 
     /// The locations set by the .loc directives in this section, in assembly
-    /// source order.
-    typedef stdx::ptr_vector<DwarfLoc> Locs;
+    /// source order.  Stored by value as there is one per source line.
+    typedef std::vector<DwarfLoc> Locs;
     Locs locs;
 };
 
@@ -84,7 +84,9 @@ enum DwarfTag
     DW_TAG_try_block = 0x32,
     DW_TAG_variant_part = 0x33,
     DW_TAG_variable = 0x34,
-    DW_TAG_volatile_type = 0x35
+    DW_TAG_volatile_type = 0x35,
+    // DWARF 5 extensions
+    DW_TAG_skeleton_unit = 0x4a
 };
 
 // Attribute form encodings
@@ -110,7 +112,20 @@ enum DwarfForm
     DW_FORM_ref4 = 0x13,
     DW_FORM_ref8 = 0x14,
     DW_FORM_ref_udata = 0x15,
-    DW_FORM_indirect = 0x16
+    DW_FORM_indirect = 0x16,
+    // DWARF 4 extensions
+    DW_FORM_sec_offset = 0x17,
+    // DWARF 5 extensions
+    DW_FORM_data16 = 0x1e,
+    DW_FORM_line_strp = 0x1f
+};
+
+// Unit header unit type encodings (DWARF 5)
+enum DwarfUnitType
+{
+    DW_UT_compile = 0x01,
+    DW_UT_skeleton = 0x04,
+    DW_UT_split_compile = 0x05
 };
 
 // Attribute encodings
@@ -177,7 +192,9 @@ enum DwarfAttribute
     DW_AT_use_location = 0x4a,
     DW_AT_variable_parameter = 0x4b,
     DW_AT_virtuality = 0x4c,
-    DW_AT_vtable_elem_location = 0x4d
+    DW_AT_vtable_elem_location = 0x4d,
+    // DWARF 5 extensions
+    DW_AT_dwo_name = 0x76
 };
 
 // DWARF line number opcodes
@@ -211,6 +228,16 @@ enum DwarfLineNumberExtOp
     DW_LNE_set_discriminator
 };
 
+// Line number header entry format content type codes (DWARF 5)
+enum DwarfLineNumberContent
+{
+    DW_LNCT_path = 1,
+    DW_LNCT_directory_index,
+    DW_LNCT_timestamp,
+    DW_LNCT_size,
+    DW_LNCT_MD5
+};
+
 }} // namespace yasm::dbgfmt
 
 #endif
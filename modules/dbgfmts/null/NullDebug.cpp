@@ -43,9 +43,9 @@ NullDebug::Generate(ObjectFormat& objfmt,
 {
 }
 
-void
-yasm_dbgfmt_null_DoRegister()
+extern const yasm::impl::ModuleEntry yasm_dbgfmt_null_modules[] =
 {
-    RegisterModule<DebugFormatModule,
-                   DebugFormatModuleImpl<NullDebug> >("null");
-}
+    YASM_MODULE_ENTRY(DebugFormatModule,
+                      DebugFormatModuleImpl<NullDebug>, "null"),
+    YASM_MODULE_TABLE_END
+};
@@ -0,0 +1,365 @@
+//
+// NASM-style list format
+//
+//  Copyright (C) 2026  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include "NasmListFormat.h"
+
+#include <algorithm>
+
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+#include "yasmx/Support/HexFormat.h"
+#include "yasmx/Support/registry.h"
+#include "yasmx/Bytecode.h"
+#include "yasmx/Location.h"
+#include "yasmx/Object.h"
+#include "yasmx/Section.h"
+#include "yasmx/Symbol.h"
+
+
+using namespace yasm;
+using namespace yasm::listfmt;
+
+// Bytes listed on each row.
+static const unsigned int BYTES_PER_ROW = 8;
+
+// Width of the bytes column: two hex digits per byte plus a continuation
+// mark, and a space.
+static const unsigned int BYTES_WIDTH = BYTES_PER_ROW*2+2;
+
+// Width of the cost column: uops, latency, and reciprocal throughput.
+static const unsigned int COST_WIDTH = 17;
+
+namespace {
+// Orders line marks before a bytecode index.
+struct MarkBefore
+{
+    bool operator() (const BytecodeContainer::LineMark& mark,
+                     unsigned long index) const
+    {
+        return mark.bc->getIndex() < index;
+    }
+};
+
+// Orders labels by offset.
+struct LabelBefore
+{
+    bool operator() (const std::pair<unsigned long, StringRef>& a,
+                     const std::pair<unsigned long, StringRef>& b) const
+    {
+        return a.first < b.first;
+    }
+};
+} // anonymous namespace
+
+NasmListFormat::NasmListFormat(const ListFormatModule& module)
+    : ListFormat(module)
+    , m_os(0)
+    , m_container(0)
+    , m_bc(0)
+    , m_pos(0)
+    , m_active(false)
+    , m_line_start(0)
+    , m_line(0)
+    , m_offset(0)
+    , m_gap(0)
+    , m_arch(0)
+    , m_issue_width(0)
+    , m_has_cost(false)
+    , m_cost()
+    , m_block()
+    , m_block_max_rthroughput(0)
+{
+}
+
+NasmListFormat::~NasmListFormat()
+{
+}
+
+void
+NasmListFormat::Begin(raw_ostream& os, SourceManager& smgr)
+{
+    m_os = &os;
+    m_cursor.reset(new SourceLineCursor(smgr));
+    m_container = 0;
+    m_active = false;
+}
+
+void
+NasmListFormat::BeginBytecode(const Bytecode& bc)
+{
+    // Output of bytecodes nested in another (e.g. by times) is part of
+    // the outer bytecode's output.
+    const BytecodeContainer* container = bc.getContainer();
+    if (container != container->getSection())
+        return;
+
+    // Sections may be output in any order; start over on a new one.
+    if (container != m_container)
+    {
+        EndLine();
+        EndBlock();
+        m_active = false;
+        m_line_start = 0;
+        m_container = container;
+        m_mark = container->lines_begin();
+        m_mark_end = container->lines_end();
+
+        const Section* sect = container->getSection();
+        const Object* object = sect->getObject();
+        m_arch = object ? object->getArch() : 0;
+        m_issue_width = m_arch ? m_arch->getIssueWidth() : 0;
+
+        // Each label starts a new block of code for the cost summary.
+        m_labels.clear();
+        if (m_issue_width != 0)
+        {
+            for (Object::const_symbol_iterator i=object->symbols_begin(),
+                 end=object->symbols_end(); i != end; ++i)
+            {
+                Location loc;
+                if (i->getLabel(&loc) && loc.bc->getContainer() == sect)
+                    m_labels.push_back(std::make_pair(
+                        static_cast<unsigned long>(loc.getOffset()),
+                        StringRef(i->getName())));
+            }
+            std::stable_sort(m_labels.begin(), m_labels.end(), LabelBefore());
+        }
+        m_next_label = m_labels.begin();
+        m_block_name = sect->getName();
+    }
+
+    // Skip marks of lines without any output.
+    m_mark = std::lower_bound(m_mark, m_mark_end, bc.getIndex(),
+                              MarkBefore());
+    m_bc = &bc;
+    m_pos = 0;
+}
+
+unsigned long
+NasmListFormat::NextLine()
+{
+    for (; m_mark != m_mark_end && m_mark->bc == m_bc; ++m_mark)
+    {
+        if (m_mark->offset > m_pos)
+            return m_mark->offset - m_pos;
+        StartLine(m_mark->source, m_bc->getOffset() + m_pos);
+    }
+    return ~0UL;
+}
+
+void
+NasmListFormat::StartLine(SourceLocation source, unsigned long offset)
+{
+    PresumedLoc ploc = m_cursor->getPresumedLoc(source);
+    StringRef text = m_cursor->getLineText();
+
+    // Further output from the current line (e.g. from another line of a
+    // macro expansion) continues it.
+    if (m_active && text.data() == m_line_start
+        && offset == m_offset + m_bytes.size() + m_gap)
+        return;
+
+    EndLine();
+    StartBlocks(offset);
+
+    // Instructions of a line split by output of other lines are only
+    // counted once.
+    m_has_cost = m_issue_width != 0 && text.data() != m_line_start &&
+        m_arch->getLineCost(*m_container->getSection(), source, &m_cost);
+    if (m_has_cost)
+    {
+        m_block.insns += m_cost.insns;
+        m_block.unknown += m_cost.unknown;
+        m_block.uops += m_cost.uops;
+        m_block.latency += m_cost.latency;
+        m_block_max_rthroughput =
+            std::max(m_block_max_rthroughput, m_cost.rthroughput);
+    }
+
+    m_active = true;
+    m_line_start = text.data();
+    m_line = ploc.isValid() ? ploc.getLine() : 0;
+    m_text = text;
+    m_offset = offset;
+}
+
+void
+NasmListFormat::OutputBytes(ArrayRef<unsigned char> bytes)
+{
+    while (!bytes.empty())
+    {
+        unsigned long n = std::min<unsigned long>(NextLine(), bytes.size());
+        m_pos += n;
+        if (m_active)
+        {
+            for (unsigned long i=0; i<n; ++i)
+            {
+                if (m_gap != 0 || m_bytes.size() == BYTES_PER_ROW)
+                    WriteRow(true);
+                m_bytes.push_back(bytes[i]);
+            }
+        }
+        bytes = bytes.slice(n);
+    }
+}
+
+void
+NasmListFormat::OutputGap(uint64_t size)
+{
+    while (size != 0)
+    {
+        unsigned long n =
+            static_cast<unsigned long>(std::min<uint64_t>(NextLine(), size));
+        m_pos += n;
+        if (m_active)
+        {
+            if (!m_bytes.empty())
+                WriteRow(true);
+            m_gap += n;
+        }
+        size -= n;
+    }
+}
+
+void
+NasmListFormat::End()
+{
+    EndLine();
+    EndBlock();
+    m_os->flush();
+    m_os = 0;
+    m_cursor.reset(0);
+}
+
+void
+NasmListFormat::WriteRow(bool more)
+{
+    char buf[BYTES_PER_ROW*2+16];
+
+    *m_os << llvm::format("%6u ", m_line);
+    char* end = FormatHex(buf, m_offset, 8, false);
+    *end++ = ' ';
+    m_os->write(buf, end-buf);
+    unsigned int width = 0;
+    if (m_gap != 0)
+    {
+        *m_os << "<res ";
+        m_os->write(buf, FormatHex(buf, m_gap, 8, false) - buf);
+        *m_os << '>';
+        width = 14;
+        m_offset += m_gap;
+        m_gap = 0;
+    }
+    else
+    {
+        if (!m_bytes.empty())
+            m_os->write(buf, FormatHexBytes(buf, &m_bytes[0], m_bytes.size(),
+                                            false) - buf);
+        width += m_bytes.size()*2;
+        if (more)
+        {
+            *m_os << '-';
+            ++width;
+        }
+        m_offset += m_bytes.size();
+        m_bytes.clear();
+    }
+
+    // Only the first row for a line shows its text.
+    if (m_text.empty())
+        *m_os << '\n';
+    else
+    {
+        m_os->indent(BYTES_WIDTH - width);
+        if (m_issue_width != 0)
+            WriteCost(m_has_cost ? &m_cost : 0);
+        *m_os << m_text << '\n';
+        m_text = StringRef();
+    }
+}
+
+void
+NasmListFormat::WriteCost(const Arch::InsnCost* cost)
+{
+    if (!cost)
+        m_os->indent(COST_WIDTH);
+    else if (cost->uops == 0)
+    {
+        m_os->indent(COST_WIDTH-2);
+        *m_os << "? ";
+    }
+    else
+        *m_os << llvm::format("%4u %4u %6.2f ", cost->uops, cost->latency,
+                              cost->rthroughput/100.0);
+}
+
+void
+NasmListFormat::StartBlocks(unsigned long offset)
+{
+    while (m_next_label != m_labels.end() && m_next_label->first <= offset)
+    {
+        EndBlock();
+        m_block_name = m_next_label->second;
+        ++m_next_label;
+    }
+}
+
+void
+NasmListFormat::EndBlock()
+{
+    if (m_issue_width != 0 && m_block.insns != 0)
+    {
+        // The block can't run faster than the front end can issue its
+        // uops, or than its slowest instruction can be started.
+        double cycles = static_cast<double>(m_block.uops) / m_issue_width;
+        cycles = std::max(cycles, m_block_max_rthroughput/100.0);
+
+        m_os->indent(16+BYTES_WIDTH+COST_WIDTH);
+        *m_os << "; " << m_block_name << ": " << m_block.insns
+              << " instructions, " << m_block.uops << " uops, "
+              << llvm::format(">=%.2f", cycles) << " cycles/iteration, "
+              << "latency sum " << m_block.latency;
+        if (m_block.unknown != 0)
+            *m_os << ", " << m_block.unknown << " not modeled";
+        *m_os << '\n';
+    }
+    m_block = Arch::InsnCost();
+    m_block_max_rthroughput = 0;
+}
+
+void
+NasmListFormat::EndLine()
+{
+    if (m_gap != 0 || !m_bytes.empty())
+        WriteRow(false);
+}
+
+extern const yasm::impl::ModuleEntry yasm_listfmt_nasm_modules[] =
+{
+    YASM_MODULE_ENTRY(ListFormatModule,
+                      ListFormatModuleImpl<NasmListFormat>, "nasm"),
+    YASM_MODULE_TABLE_END
+};
@@ -0,0 +1,149 @@
+#ifndef YASM_NASMLISTFORMAT_H
+#define YASM_NASMLISTFORMAT_H
+//
+// NASM-style list format
+//
+//  Copyright (C) 2026  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "llvm/ADT/SmallVector.h"
+#include "yasmx/Basic/SourceLocation.h"
+#include "yasmx/Basic/SourceManager.h"
+#include "yasmx/Config/export.h"
+#include "yasmx/Support/scoped_ptr.h"
+#include "yasmx/Arch.h"
+#include "yasmx/BytecodeContainer.h"
+#include "yasmx/ListFormat.h"
+
+
+namespace yasm
+{
+
+namespace listfmt
+{
+
+/// Writes a row for each source line that generates output, with the line
+/// number, offset within the section, generated bytes (as hex), and the
+/// source line text.  Output longer than a row continues on following rows.
+/// If the architecture has a cost model selected, a column with the
+/// estimated cost of each line's instructions precedes the text, and a
+/// summary of the instructions between labels follows each block of code.
+class YASM_STD_EXPORT NasmListFormat : public ListFormat
+{
+public:
+    NasmListFormat(const ListFormatModule& module);
+    ~NasmListFormat();
+
+    static StringRef getName() { return "NASM-style list format"; }
+    static StringRef getKeyword() { return "nasm"; }
+
+    void Begin(raw_ostream& os, SourceManager& smgr);
+    void BeginBytecode(const Bytecode& bc);
+    void OutputBytes(ArrayRef<unsigned char> bytes);
+    void OutputGap(uint64_t size);
+    void End();
+
+private:
+    /// Start any lines whose output starts at the current position.
+    /// @return Bytes until the next line starts in the current bytecode.
+    unsigned long NextLine();
+
+    /// Start a source line.
+    /// @param source       line location
+    /// @param offset       offset of the line's output within its section
+    void StartLine(SourceLocation source, unsigned long offset);
+
+    /// Write a row with the pending bytes or gap.
+    /// @param more         more output follows for the same line
+    void WriteRow(bool more);
+
+    /// Write any rows left for the current line.
+    void EndLine();
+
+    /// Start the block of code for each label at or before an offset.
+    /// @param offset       offset within the current section
+    void StartBlocks(unsigned long offset);
+
+    /// Write the summary of the current block of code, if it has any
+    /// instructions.
+    void EndBlock();
+
+    /// Write the estimated cost column of a row.
+    /// @param cost         cost, or NULL for a blank column
+    void WriteCost(const Arch::InsnCost* cost);
+
+    raw_ostream* m_os;
+    util::scoped_ptr<SourceLineCursor> m_cursor;
+
+    /// Container of the current bytecode, and its line marks not yet
+    /// reached.
+    const BytecodeContainer* m_container;
+    BytecodeContainer::const_line_iterator m_mark, m_mark_end;
+
+    const Bytecode* m_bc;       ///< Current bytecode
+    unsigned long m_pos;        ///< Position within the current bytecode
+
+    /// Whether the current output is being listed.
+    bool m_active;
+
+    /// Start of the current line's text, to tell when a line mark
+    /// continues the current line (e.g. a macro expansion).
+    const char* m_line_start;
+
+    unsigned int m_line;        ///< Current line number
+    StringRef m_text;           ///< Current line text; empty once written
+    unsigned long m_offset;     ///< Offset of the pending output
+
+    /// Pending bytes and gap size for the current row.
+    SmallVector<unsigned char, 8> m_bytes;
+    unsigned long m_gap;
+
+    /// Architecture of the current section.
+    const Arch* m_arch;
+
+    /// Issue width of the cost model; 0 if costs aren't listed.
+    unsigned int m_issue_width;
+
+    /// Estimated cost of the current line, if it has instructions.
+    bool m_has_cost;
+    Arch::InsnCost m_cost;
+
+    /// Labels of the current section by offset, and the next to reach.
+    std::vector<std::pair<unsigned long, StringRef> > m_labels;
+    std::vector<std::pair<unsigned long, StringRef> >::const_iterator
+        m_next_label;
+
+    /// Name and total cost of the current block, and the largest
+    /// reciprocal throughput of its lines.
+    std::string m_block_name;
+    Arch::InsnCost m_block;
+    unsigned int m_block_max_rthroughput;
+};
+
+}} // namespace yasm::listfmt
+
+#endif
@@ -27,7 +27,10 @@
 #include "BinLink.h"
 
 #include <algorithm>
+#include <vector>
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/Twine.h"
 #include "llvm/Support/raw_ostream.h"
 #include "yasmx/Basic/Diagnostic.h"
@@ -74,38 +77,83 @@ yasm::objfmt::append_data(pugi::xml_node out, const BinGroups& groups)
 }
 #endif // WITH_XML
 
-// Recursive function to find group containing named section.
+// Find the group at the top of the follows tree containing group.
+// The up map links each group towards the top of its tree; paths are
+// compressed as they are walked so repeated lookups stay cheap.
 static BinGroup*
-FindGroup(BinGroups& groups, const std::string& name)
+FindTopGroup(llvm::DenseMap<BinGroup*, BinGroup*>& up, BinGroup* group)
 {
-    for (BinGroups::iterator group = groups.begin(), end = groups.end();
-         group != end; ++group)
+    BinGroup* top = group;
+    for (;;)
+    {
+        llvm::DenseMap<BinGroup*, BinGroup*>::iterator i = up.find(top);
+        if (i == up.end())
+            break;
+        top = i->second;
+    }
+    while (group != top)
     {
-        if (group->m_section.getName() == name)
-            return &(*group);
-        // Recurse to loop through follow groups
-        BinGroup* found = FindGroup(group->m_follow_groups, name);
-        if (found)
-            return found;
+        BinGroup*& next = up[group];
+        group = next;
+        next = top;
     }
-    return 0;
+    return top;
 }
 
-// Recursive function to find group.  Returns NULL if not found.
-static BinGroup*
-FindGroup(BinGroups& groups, const Section& section)
+// Move each top-level group with a follows (or vfollows) setting into the
+// follow groups of the group containing the section it follows.  Sections
+// are looked up by name through a map and loops are detected by checking
+// whether the followed section is already in the follower's tree, so this
+// is near-linear in the number of groups.
+static bool
+LinkFollowGroups(BinGroups& groups,
+                 std::string BinSection::*follows,
+                 unsigned int unknown_diag,
+                 unsigned int loop_diag,
+                 DiagnosticsEngine& diags)
 {
+    llvm::StringMap<BinGroup*> by_name;
     for (BinGroups::iterator group = groups.begin(), end = groups.end();
          group != end; ++group)
+        by_name[group->m_section.getName()] = &(*group);
+
+    llvm::DenseMap<BinGroup*, BinGroup*> up;
+    BinGroups::iterator group = groups.begin();
+    while (group != groups.end())
     {
-        if (&group->m_section == &section)
-            return &(*group);
-        // Recurse to loop through follow groups
-        BinGroup* found = FindGroup(group->m_follow_groups, section);
-        if (found)
-            return found;
+        const std::string& name = group->m_bsd.*follows;
+        if (name.empty())
+        {
+            ++group;
+            continue;
+        }
+
+        // Need to find group containing section this section follows.
+        llvm::StringMap<BinGroup*>::iterator found_iter = by_name.find(name);
+        if (found_iter == by_name.end())
+        {
+            diags.Report(SourceLocation(), unknown_diag)
+                << group->m_section.getName() << name;
+            return false;
+        }
+        BinGroup* found = found_iter->second;
+
+        // Check for loops: the followed section can't be this section or
+        // one of the sections already following it.
+        if (FindTopGroup(up, found) == &(*group))
+        {
+            diags.Report(SourceLocation(), loop_diag)
+                << group->m_section.getName()
+                << found->m_section.getName();
+            return false;
+        }
+
+        // Remove this section from main groups list and
+        // add it after the section it's supposed to follow.
+        up[&(*group)] = found;
+        found->m_follow_groups.push_back(groups.detach(group));
     }
-    return 0;
+    return true;
 }
 
 BinLink::BinLink(Object& object, DiagnosticsEngine& diags)
@@ -239,40 +287,10 @@ BinLink::DoLink(const IntNum& origin)
 
     // Look at each group with follows specified, and find the section
     // that group is supposed to follow.
-    group = m_lma_groups.begin();
-    while (group != m_lma_groups.end())
-    {
-        if (!group->m_bsd.follows.empty())
-        {
-            BinGroup* found;
-            // Need to find group containing section this section follows.
-            found = FindGroup(m_lma_groups, group->m_bsd.follows);
-            if (!found)
-            {
-                m_diags.Report(SourceLocation(),
-                               diag::err_section_follows_unknown)
-                    << group->m_section.getName()
-                    << group->m_bsd.follows;
-                return false;
-            }
-
-            // Check for loops
-            if (&group->m_section == &found->m_section ||
-                FindGroup(group->m_follow_groups, found->m_section))
-            {
-                m_diags.Report(SourceLocation(), diag::err_section_follows_loop)
-                    << group->m_section.getName()
-                    << found->m_section.getName();
-                return false;
-            }
-
-            // Remove this section from main lma groups list and
-            // add it after the section it's supposed to follow.
-            found->m_follow_groups.push_back(m_lma_groups.detach(group));
-        }
-        else
-            ++group;
-    }
+    if (!LinkFollowGroups(m_lma_groups, &BinSection::follows,
+                          diag::err_section_follows_unknown,
+                          diag::err_section_follows_loop, m_diags))
+        return false;
 
     // Move BSS sections without a start to the end of the top-level groups
     BinGroups::iterator bss_begin =
@@ -330,41 +348,10 @@ BinLink::DoLink(const IntNum& origin)
 
     // Look at each group with vfollows specified, and find the section
     // that group is supposed to follow.
-    group = m_vma_groups.begin();
-    while (group != m_vma_groups.end())
-    {
-        if (!group->m_bsd.vfollows.empty())
-        {
-            BinGroup* found;
-            // Need to find group containing section this section follows.
-            found = FindGroup(m_vma_groups, group->m_bsd.vfollows);
-            if (!found)
-            {
-                m_diags.Report(SourceLocation(),
-                               diag::err_section_vfollows_unknown)
-                    << group->m_section.getName()
-                    << group->m_bsd.vfollows;
-                return false;
-            }
-
-            // Check for loops
-            if (&group->m_section == &found->m_section ||
-                FindGroup(group->m_follow_groups, found->m_section))
-            {
-                m_diags.Report(SourceLocation(),
-                               diag::err_section_vfollows_loop)
-                    << group->m_section.getName()
-                    << found->m_section.getName();
-                return false;
-            }
-
-            // Remove this section from main lma groups list and
-            // add it after the section it's supposed to follow.
-            found->m_follow_groups.push_back(m_vma_groups.detach(group));
-        }
-        else
-            ++group;
-    }
+    if (!LinkFollowGroups(m_vma_groups, &BinSection::vfollows,
+                          diag::err_section_vfollows_unknown,
+                          diag::err_section_vfollows_loop, m_diags))
+        return false;
 
     // Due to the combination of steps above, we now know that all top-level
     // groups have integer ivstart:
@@ -424,18 +411,61 @@ BinLink::CheckLMAOverlap(const Section& sect, const Section& other)
     return true;
 }
 
-// Check for LMA overlap using a simple N^2 algorithm.
+namespace {
+struct LMAOrder
+{
+    const Section* sect;
+    unsigned long index;        // position in the object's section list
+};
+} // anonymous namespace
+
+static inline bool
+CompareLMA(const LMAOrder& lhs, const LMAOrder& rhs)
+{
+    return lhs.sect->getLMA() < rhs.sect->getLMA();
+}
+
+// Check for LMA overlap by sorting the non-empty sections by LMA and
+// sweeping through them, keeping the section that extends furthest so far;
+// any later section starting before its end overlaps it.
 bool
 BinLink::CheckLMAOverlap()
 {
+    std::vector<LMAOrder> order;
+    order.reserve(m_object.getNumSections());
+    unsigned long index = 0;
     for (Object::const_section_iterator i=m_object.sections_begin(),
-         end=m_object.sections_end(); i != end; ++i)
+         end=m_object.sections_end(); i != end; ++i, ++index)
     {
-        for (Object::const_section_iterator j=i+1, end=m_object.sections_end();
-             j != end; ++j)
+        const BinSection* bsd = i->getAssocData<BinSection>();
+        assert(bsd);
+        if (bsd->length.isZero())
+            continue;
+        LMAOrder entry = {&(*i), index};
+        order.push_back(entry);
+    }
+    std::stable_sort(order.begin(), order.end(), CompareLMA);
+
+    const LMAOrder* furthest = 0;
+    IntNum furthest_end;
+    for (std::vector<LMAOrder>::const_iterator i=order.begin(),
+         end=order.end(); i != end; ++i)
+    {
+        const Section& sect = *i->sect;
+        if (furthest && sect.getLMA() < furthest_end)
+        {
+            // Report the pair in section order.
+            if (furthest->index < i->index)
+                return CheckLMAOverlap(*furthest->sect, sect);
+            return CheckLMAOverlap(sect, *furthest->sect);
+        }
+
+        IntNum sect_end = sect.getLMA();
+        sect_end += sect.getAssocData<BinSection>()->length;
+        if (!furthest || sect_end > furthest_end)
         {
-            if (!CheckLMAOverlap(*i, *j))
-                return false;
+            furthest = &(*i);
+            furthest_end = sect_end;
         }
     }
     return true;
@@ -26,6 +26,8 @@
 //
 #include "BinMapOutput.h"
 
+#include <algorithm>
+
 #include "llvm/Support/Format.h"
 #include "llvm/Support/raw_ostream.h"
 #include "yasmx/Bytecode.h"
@@ -209,51 +211,72 @@ BinMapOutput::OutputSectionsDetail()
     InnerSectionsDetail(m_groups);
 }
 
-static unsigned long
-CountSymbols(const Object& object, const Section* sect)
+// Sort every symbol into its section's list in a single pass over the
+// symbol table, rather than rescanning the table for each section.
+void
+BinMapOutput::BucketSymbols()
 {
-    unsigned long count = 0;
+    m_symbols.resize(m_object.getNumSections() + 1);
+    unsigned int index = 1;
+    for (Object::const_section_iterator sect = m_object.sections_begin(),
+         end = m_object.sections_end(); sect != end; ++sect)
+        m_sect_index[&(*sect)] = index++;
 
-    for (Object::const_symbol_iterator sym = object.symbols_begin(),
-         end = object.symbols_end(); sym != end; ++sym)
+    for (Object::const_symbol_iterator sym = m_object.symbols_begin(),
+         end = m_object.symbols_end(); sym != end; ++sym)
     {
         Location loc;
-        // TODO: autodetect wider size
-        if ((sect == 0 && sym->getEqu()) ||
-            (sym->getLabel(&loc) && loc.bc->getContainer() == sect))
-            count++;
+        MapSymbol msym = {0, &(*sym)};
+        if (sym->getEqu())
+            m_symbols[0].push_back(msym);
+        else if (sym->getLabel(&loc))
+        {
+            const Section* sect = loc.bc->getContainer()->getSection();
+            if (!sect)
+                continue;
+            msym.offset = loc.getOffset();
+            m_symbols[m_sect_index.lookup(sect)].push_back(msym);
+        }
     }
 
-    return count;
+    // Labels are listed by address; symbols at the same address keep
+    // symbol table order.
+    for (std::vector<MapSymbols>::iterator i = m_symbols.begin()+1,
+         end = m_symbols.end(); i != end; ++i)
+        std::stable_sort(i->begin(), i->end(), CompareOffset);
+}
+
+const BinMapOutput::MapSymbols&
+BinMapOutput::getSymbols(const Section* sect) const
+{
+    return m_symbols[sect ? m_sect_index.lookup(sect) : 0];
 }
 
 void
-BinMapOutput::OutputSymbols(const Section* sect)
+BinMapOutput::OutputSymbols(const Section* sect, const MapSymbols& syms)
 {
-    for (Object::const_symbol_iterator sym = m_object.symbols_begin(),
-         end = m_object.symbols_end(); sym != end; ++sym)
+    for (MapSymbols::const_iterator i = syms.begin(), end = syms.end();
+         i != end; ++i)
     {
-        const std::string& name = sym->getName();
-        const Expr* equ;
-        Location loc;
+        const std::string& name = i->sym->getName();
 
-        if (sect == 0 && (equ = sym->getEqu()))
+        if (sect == 0)
         {
-            std::auto_ptr<Expr> realequ(equ->clone());
+            std::auto_ptr<Expr> realequ(i->sym->getEqu()->clone());
             realequ->Simplify(m_diags);
             BinSimplify(*realequ);
             realequ->Simplify(m_diags);
             OutputIntNum(realequ->getIntNum());
             m_os << "  " << name << '\n';
         }
-        else if (sym->getLabel(&loc) && loc.bc->getContainer() == sect)
+        else
         {
             // Real address
-            OutputIntNum(sect->getLMA() + loc.getOffset());
+            OutputIntNum(sect->getLMA() + i->offset);
             m_os << "  ";
 
             // Virtual address
-            OutputIntNum(sect->getVMA() + loc.getOffset());
+            OutputIntNum(sect->getVMA() + i->offset);
 
             // Name
             m_os << "  " << name << '\n';
@@ -267,7 +290,8 @@ BinMapOutput::InnerSectionsSymbols(const BinGroups& groups)
     for (BinGroups::const_iterator group = groups.begin(), end=groups.end();
          group != end; ++group)
     {
-        if (CountSymbols(m_object, &group->m_section) > 0)
+        const MapSymbols& syms = getSymbols(&group->m_section);
+        if (!syms.empty())
         {
             StringRef name = group->m_section.getName();
             m_os << "---- Section " << name << ' ';
@@ -278,7 +302,7 @@ BinMapOutput::InnerSectionsSymbols(const BinGroups& groups)
             m_os << format("%-*s", m_bytes*2+2, (const char*)"Real");
             m_os << format("%-*s", m_bytes*2+2, (const char*)"Virtual");
             m_os << "Name\n";
-            OutputSymbols(&group->m_section);
+            OutputSymbols(&group->m_section, syms);
             m_os << "\n\n";
         }
 
@@ -295,12 +319,11 @@ BinMapOutput::OutputSectionsSymbols()
         m_os << '-';
     m_os << "\n\n";
 
-    // We do two passes for EQU and each section; the first pass
-    // determines the byte width to use for the value and whether any
-    // symbols are present, the second pass actually outputs the text.
+    BucketSymbols();
 
     // EQUs
-    if (CountSymbols(m_object, 0) > 0)
+    const MapSymbols& equs = getSymbols(0);
+    if (!equs.empty())
     {
         m_os << "---- No Section ";
         for (int i=0; i<63; ++i)
@@ -308,7 +331,7 @@ BinMapOutput::OutputSectionsSymbols()
         m_os << "\n\n";
         m_os << format("%-*s", m_bytes*2+2, (const char*)"Value");
         m_os << "Name\n";
-        OutputSymbols(0);
+        OutputSymbols(0, equs);
         m_os << "\n\n";
     }
 
@@ -26,6 +26,9 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 //
+#include <vector>
+
+#include "llvm/ADT/DenseMap.h"
 #include "yasmx/Config/export.h"
 #include "BinLink.h"
 
@@ -36,6 +39,7 @@ namespace yasm
 class DiagnosticsEngine;
 class IntNum;
 class Object;
+class Symbol;
 
 namespace objfmt
 {
@@ -60,7 +64,21 @@ private:
     void OutputIntNum(const IntNum& intn);
     void InnerSectionsSummary(const BinGroups& groups);
     void InnerSectionsDetail(const BinGroups& groups);
-    void OutputSymbols(const Section* sect);
+    struct MapSymbol
+    {
+        unsigned long offset;   // offset within section
+        const Symbol* sym;
+    };
+    typedef std::vector<MapSymbol> MapSymbols;
+
+    static bool CompareOffset(const MapSymbol& lhs, const MapSymbol& rhs)
+    {
+        return lhs.offset < rhs.offset;
+    }
+
+    void BucketSymbols();
+    const MapSymbols& getSymbols(const Section* sect) const;
+    void OutputSymbols(const Section* sect, const MapSymbols& syms);
     void InnerSectionsSymbols(const BinGroups& groups);
 
     // address width
@@ -71,6 +89,11 @@ private:
     const IntNum& m_origin;     // origin
     const BinGroups& m_groups;  // section groups
     DiagnosticsEngine& m_diags;     // diagnostic reporting
+
+    // Symbols bucketed by section (EQUs under section 0), labels sorted by
+    // offset; filled once by BucketSymbols().
+    llvm::DenseMap<const Section*, unsigned int> m_sect_index;
+    std::vector<MapSymbols> m_symbols;
 };
 
 }} // namespace yasm::objfmt
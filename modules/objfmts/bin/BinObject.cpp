@@ -33,6 +33,8 @@
 #include "yasmx/Parse/Directive.h"
 #include "yasmx/Parse/DirHelpers.h"
 #include "yasmx/Parse/NameValue.h"
+#include "yasmx/Support/OutputFileStream.h"
+#include "yasmx/Support/Trace.h"
 #include "yasmx/Support/bitcount.h"
 #include "yasmx/Support/registry.h"
 #include "yasmx/Arch.h"
@@ -106,31 +108,50 @@ namespace {
 class BinOutput : public BytecodeStreamOutput
 {
 public:
-    BinOutput(raw_fd_ostream& os, Object& object, DiagnosticsEngine& diags);
+    /// @param fixups   if non-NULL, external references are added to it
+    ///                 rather than being errors
+    BinOutput(OutputFileStream& os,
+              Object& object,
+              const IntNum& origin,
+              std::vector<CodeFixup>* fixups,
+              DiagnosticsEngine& diags);
     ~BinOutput();
 
-    void OutputSection(Section& sect, const IntNum& origin);
+    void OutputSection(Section& sect);
 
     // OutputBytecode overrides
     bool ConvertValueToBytes(Value& value,
                              Location loc,
                              NumericOutput& num_out);
 
+protected:
+    void DoOutputGap(uint64_t size, SourceLocation source);
+
 private:
+    bool AddFixup(Value& value, Location loc, NumericOutput& num_out);
+
     Object& m_object;
-    raw_fd_ostream& m_fd_os;
+    OutputFileStream& m_file_os;
+    const IntNum& m_origin;
+    std::vector<CodeFixup>* m_fixups;
     BytecodeNoOutput m_no_output;
 };
 } // anonymous namespace
 
-BinOutput::BinOutput(raw_fd_ostream& os,
+BinOutput::BinOutput(OutputFileStream& os,
                      Object& object,
+                     const IntNum& origin,
+                     std::vector<CodeFixup>* fixups,
                      DiagnosticsEngine& diags)
     : BytecodeStreamOutput(os, diags),
       m_object(object),
-      m_fd_os(os),
+      m_file_os(os),
+      m_origin(origin),
+      m_fixups(fixups),
       m_no_output(diags)
 {
+    setListFormat(object.getListFormat());
+    m_no_output.setListFormat(object.getListFormat());
 }
 
 BinOutput::~BinOutput()
@@ -138,8 +159,9 @@ BinOutput::~BinOutput()
 }
 
 void
-BinOutput::OutputSection(Section& sect, const IntNum& origin)
+BinOutput::OutputSection(Section& sect)
 {
+    TraceRegion t("Output Section", sect.getName());
     BytecodeOutput* outputter;
 
     if (sect.isBSS())
@@ -149,7 +171,7 @@ BinOutput::OutputSection(Section& sect, const IntNum& origin)
     else
     {
         IntNum file_start = sect.getLMA();
-        file_start -= origin;
+        file_start -= m_origin;
         if (file_start.getSign() < 0)
         {
             Diag(SourceLocation(), diag::err_section_before_origin)
@@ -162,7 +184,7 @@ BinOutput::OutputSection(Section& sect, const IntNum& origin)
                 << sect.getName();
             return;
         }
-        m_fd_os.seek(file_start.getUInt());
+        m_file_os.seek(file_start.getUInt());
         if (m_os.has_error())
         {
             Diag(SourceLocation(), diag::err_file_output_seek);
@@ -179,11 +201,37 @@ BinOutput::OutputSection(Section& sect, const IntNum& origin)
     }
 }
 
+void
+BinOutput::DoOutputGap(uint64_t size, SourceLocation source)
+{
+    if (size == 0)
+        return;
+
+    Diag(source, diag::warn_uninit_zero);
+
+    // Large reserved areas are common in flat images, so zero the file
+    // image directly (and leave a hole on disk) rather than copying zeros.
+    m_file_os.write_zeros(size);
+}
+
 bool
-BinOutput::ConvertValueToBytes(Value& value,
+BinOutput::ConvertValueToBytes(Value& orig_value,
                                Location loc,
                                NumericOutput& num_out)
 {
+    // Plain integers need no resolving.
+    if (!orig_value.isRelative()
+        && (!orig_value.hasAbs() || orig_value.getAbs()->isIntNum()))
+    {
+        IntNum intn;
+        m_object.getArch()->setEndian(num_out.getBytes());
+        orig_value.OutputBasic(num_out, &intn, getDiagnostics());
+        return true;
+    }
+
+    // Resolving modifies the value, so work on a copy.
+    Value value(orig_value);
+
     // Binary objects we need to resolve against object, not against section.
     if (value.isRelative())
     {
@@ -224,12 +272,63 @@ done:
         return true;
 
     // Couldn't output, assume it contains an external reference.
+    if (m_fixups)
+        return AddFixup(value, loc, num_out);
     Diag(value.getSource().getBegin(), diag::err_bin_extern_ref);
     return false;
 }
 
+bool
+BinOutput::AddFixup(Value& value, Location loc, NumericOutput& num_out)
+{
+    if (!value.isRelative() || value.isSegOf() || value.isSectionRelative()
+        || value.getWRT() || value.getShift() > 0 || value.getRShift() > 0)
+    {
+        Diag(value.getSource().getBegin(), diag::err_reloc_too_complex);
+        return false;
+    }
+
+    // The symbol isn't in the object, so the relative portion was left
+    // alone above; fold everything else into the addend.  A PC-relative
+    // value subtracts the (known) address of its location.
+    Expr addend(0);
+    if (Expr* abs = value.getAbs())
+        addend = *abs;
+    Location sub_loc;
+    if (value.getSubLocation(&sub_loc) && sub_loc.bc->getContainer())
+        addend -= sub_loc;
+    else if (value.hasSubRelative())
+    {
+        Diag(value.getSource().getBegin(), diag::err_reloc_too_complex);
+        return false;
+    }
+    BinSimplify(addend);
+    addend.Simplify(getDiagnostics());
+    if (!addend.isIntNum() || !addend.getIntNum().isOkSize(64, 0, 1))
+    {
+        Diag(value.getSource().getBegin(), diag::err_reloc_too_complex);
+        return false;
+    }
+
+    IntNum offset = loc.bc->getContainer()->getSection()->getLMA();
+    offset -= m_origin;
+    offset += loc.getOffset();
+
+    CodeFixup fixup;
+    fixup.offset = offset.getUInt64();
+    fixup.size = value.getSize();
+    fixup.is_signed = value.isSigned();
+    fixup.addend = addend.getIntNum().getInt64();
+    fixup.symbol = value.getRelative()->getName();
+    m_fixups->push_back(fixup);
+
+    m_object.getArch()->setEndian(num_out.getBytes());
+    num_out.OutputInteger(0);
+    return true;
+}
+
 static void
-CheckSymbol(const Symbol& sym, DiagnosticsEngine& diags)
+CheckSymbol(const Symbol& sym, bool allow_extern, DiagnosticsEngine& diags)
 {
     int vis = sym.getVisibility();
 
@@ -240,8 +339,9 @@ CheckSymbol(const Symbol& sym, DiagnosticsEngine& diags)
 
     if (vis & Symbol::EXTERN)
     {
-        diags.Report(sym.getDeclSource(), diag::warn_bin_unsupported_decl)
-            << "EXTERN";
+        if (!allow_extern)
+            diags.Report(sym.getDeclSource(),
+                         diag::warn_bin_unsupported_decl) << "EXTERN";
     }
     else if (vis & Symbol::GLOBAL)
     {
@@ -256,7 +356,7 @@ CheckSymbol(const Symbol& sym, DiagnosticsEngine& diags)
 }
 
 void
-BinObject::Output(raw_fd_ostream& os,
+BinObject::Output(OutputFileStream& os,
                   bool all_syms,
                   DebugFormat& dbgfmt,
                   DiagnosticsEngine& diags)
@@ -280,10 +380,30 @@ BinObject::Output(raw_fd_ostream& os,
         origin = orgi;
     }
 
+    DoOutput(os, origin, 0, diags);
+}
+
+void
+BinObject::OutputCode(OutputFileStream& os,
+                      uint64_t base,
+                      std::vector<CodeFixup>& fixups,
+                      DiagnosticsEngine& diags)
+{
+    // The load address takes the place of ORG.
+    DoOutput(os, IntNum(static_cast<unsigned long long>(base)), &fixups,
+             diags);
+}
+
+void
+BinObject::DoOutput(OutputFileStream& os,
+                    const IntNum& origin,
+                    std::vector<CodeFixup>* fixups,
+                    DiagnosticsEngine& diags)
+{
     // Check symbol table
     for (Object::const_symbol_iterator i=m_object.symbols_begin(),
          end=m_object.symbols_end(); i != end; ++i)
-        CheckSymbol(*i, diags);
+        CheckSymbol(*i, fixups != 0, diags);
 
     BinLink link(m_object, diags);
 
@@ -298,11 +418,11 @@ BinObject::Output(raw_fd_ostream& os,
         return;
 
     // Output sections
-    BinOutput out(os, m_object, diags);
+    BinOutput out(os, m_object, origin, fixups, diags);
     for (Object::section_iterator i=m_object.sections_begin(),
          end=m_object.sections_end(); i != end; ++i)
     {
-        out.OutputSection(*i, origin);
+        out.OutputSection(*i);
     }
 }
 
@@ -568,9 +688,9 @@ BinObject::AddDirectives(Directives& dirs, StringRef parser)
         dirs.AddArray(this, gas_dirs);
 }
 
-void
-yasm_objfmt_bin_DoRegister()
+extern const yasm::impl::ModuleEntry yasm_objfmt_bin_modules[] =
 {
-    RegisterModule<ObjectFormatModule,
-                   ObjectFormatModuleImpl<BinObject> >("bin");
-}
+    YASM_MODULE_ENTRY(ObjectFormatModule,
+                      ObjectFormatModuleImpl<BinObject>, "bin"),
+    YASM_MODULE_TABLE_END
+};
@@ -56,10 +56,14 @@ public:
 
     void AddDirectives(Directives& dirs, StringRef parser);
 
-    void Output(raw_fd_ostream& os,
+    void Output(OutputFileStream& os,
                 bool all_syms,
                 DebugFormat& dbgfmt,
                 DiagnosticsEngine& diags);
+    void OutputCode(OutputFileStream& os,
+                    uint64_t base,
+                    std::vector<CodeFixup>& fixups,
+                    DiagnosticsEngine& diags);
 
     Section* AddDefaultSection();
     Section* AppendSection(StringRef name,
@@ -86,6 +90,10 @@ private:
                         SourceLocation dir_source,
                         DiagnosticsEngine& diags);
 
+    void DoOutput(OutputFileStream& os,
+                  const IntNum& origin,
+                  std::vector<CodeFixup>* fixups,
+                  DiagnosticsEngine& diags);
     void OutputMap(const IntNum& origin,
                    const BinGroups& groups,
                    DiagnosticsEngine& diags) const;
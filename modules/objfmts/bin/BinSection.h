@@ -47,6 +47,7 @@ namespace objfmt
 struct YASM_STD_EXPORT BinSection : public AssocData
 {
     static const char* key;
+    static const bool inline_slot = true;
 
     BinSection();
     ~BinSection();
@@ -50,6 +50,7 @@ class YASM_STD_EXPORT BinSymbol : public AssocData
 {
 public:
     static const char* key;
+    static const bool inline_slot = true;
 
     enum SpecialSym
     {
@@ -56,6 +56,7 @@ CoffObject::CoffObject(const ObjectFormatModule& module,
     , m_set_vma(set_vma)
     , m_win32(win32)
     , m_win64(win64)
+    , m_bigobj(false)
     , m_machine(MACHINE_UNKNOWN)
     , m_file_coffsym(0)
     , m_def_sym(0)
@@ -560,9 +561,9 @@ CoffObject::AddDirectives(Directives& dirs, StringRef parser)
         dirs.AddArray(this, gas_dirs);
 }
 
-void
-yasm_objfmt_coff_DoRegister()
+extern const yasm::impl::ModuleEntry yasm_objfmt_coff_modules[] =
 {
-    RegisterModule<ObjectFormatModule,
-                   ObjectFormatModuleImpl<CoffObject> >("coff");
-}
+    YASM_MODULE_ENTRY(ObjectFormatModule,
+                      ObjectFormatModuleImpl<CoffObject>, "coff"),
+    YASM_MODULE_TABLE_END
+};
@@ -63,10 +63,8 @@ public:
     virtual void AddDirectives(Directives& dirs, StringRef parser);
 
     virtual void InitSymbols(StringRef parser);
-#if 0
-    virtual void read(std::istream& is);
-#endif
-    virtual void Output(raw_fd_ostream& os,
+    virtual bool Read(SourceManager& sm, DiagnosticsEngine& diags);
+    virtual void Output(OutputFileStream& os,
                         bool all_syms,
                         DebugFormat& dbgfmt,
                         DiagnosticsEngine& diags);
@@ -81,6 +79,10 @@ public:
     bool isWin32() const { return m_win32; }
     bool isWin64() const { return m_win64; }
 
+    /// Determine if the object is being output in the big object (bigobj)
+    /// format, with 32-bit section numbers.  Only valid during Output().
+    bool isBigObj() const { return m_bigobj; }
+
     static StringRef getName() { return "COFF (DJGPP)"; }
     static StringRef getKeyword() { return "coff"; }
     static StringRef getExtension() { return ".o"; }
@@ -90,10 +92,24 @@ public:
     static bool isOkObject(Object& object);
     static bool Taste(const MemoryBuffer& in,
                       /*@out@*/ std::string* arch_keyword,
-                      /*@out@*/ std::string* machine)
-    { return false; }
+                      /*@out@*/ std::string* machine);
 
 protected:
+    /// Taste object file to see if it is a COFF file of a particular kind.
+    /// @param in           object file contents
+    /// @param win32        whether to accept Win32/Win64 objects rather
+    ///                     than DJGPP ones
+    /// @param machine_type COFF machine to accept, or MACHINE_UNKNOWN for
+    ///                     any supported machine
+    /// @param arch_keyword architecture keyword (output)
+    /// @param machine      machine (output)
+    /// @return True if object file is readable.
+    static bool TasteCoff(const MemoryBuffer& in,
+                          bool win32,
+                          Machine machine_type,
+                          /*@out@*/ std::string* arch_keyword,
+                          /*@out@*/ std::string* machine);
+
     /// Initialize section (and COFF data) based on section name.
     /// @return True if section name recognized, false otherwise.
     virtual bool InitSection(StringRef name,
@@ -116,6 +132,11 @@ private:
 
     bool m_win32;               // win32 or win64 output?
     bool m_win64;               // win64 output?
+    bool m_bigobj;              // outputting bigobj format?
+
+    /// Maximum number of sections in a regular COFF file; section numbers
+    /// from 0xFF00 up are reserved.
+    static const unsigned int MAX_SECTIONS = 0xFEFF;
 
     enum Flags
     {
@@ -28,10 +28,16 @@
 
 #include <cstdlib>
 #include <ctime>
+#include <string>
 #include <vector>
 
 #include "llvm/Support/raw_ostream.h"
 #include "yasmx/Basic/Diagnostic.h"
+#include "yasmx/Config/functional.h"
+#include "yasmx/Support/OutputFileStream.h"
+#include "yasmx/Support/ThreadPool.h"
+#include "yasmx/Support/Trace.h"
+#include "yasmx/Support/ptr_vector.h"
 #include "yasmx/Arch.h"
 #include "yasmx/BytecodeOutput.h"
 #include "yasmx/Bytecode.h"
@@ -59,7 +65,7 @@ namespace {
 class CoffOutput : public BytecodeStreamOutput
 {
 public:
-    CoffOutput(raw_ostream& os,
+    CoffOutput(OutputFileStream& os,
                CoffObject& objfmt,
                Object& object,
                bool all_syms,
@@ -67,7 +73,16 @@ public:
     ~CoffOutput();
 
     bool OutputSection(Section& sect);
+    void OutputSections(unsigned int num_jobs);
     void OutputSectionHeader(const Section& sect);
+
+    // Individual steps of OutputSection(), so the bytecodes and relocation
+    // table can be encoded separately (e.g. on a worker thread).
+    bool BeginSection(Section& sect);
+    bool BeginData(Section& sect);
+    void OutputBytecodes(Section& sect);
+    void EncodeRelocs(Section& sect, Bytes& bytes);
+    bool EndSection(Section& sect, const Bytes& relocs);
     unsigned long CountSymbols();
     void OutputSymbolTable();
     void OutputStringTable();
@@ -87,7 +102,7 @@ private:
 };
 } // anonymous namespace
 
-CoffOutput::CoffOutput(raw_ostream& os,
+CoffOutput::CoffOutput(OutputFileStream& os,
                        CoffObject& objfmt,
                        Object& object,
                        bool all_syms,
@@ -99,6 +114,8 @@ CoffOutput::CoffOutput(raw_ostream& os,
     , m_strtab(4)   // first 4 bytes in string table are length
     , m_no_output(diags)
 {
+    setListFormat(object.getListFormat());
+    m_no_output.setListFormat(object.getListFormat());
 }
 
 CoffOutput::~CoffOutput()
@@ -315,9 +332,9 @@ CoffOutput::ConvertValueToBytes(Value& value,
         Section* sect = loc.bc->getContainer()->getSection();
         Reloc* reloc = 0;
         if (machine == CoffObject::MACHINE_I386)
-            reloc = new Coff32Reloc(addr, sym, rtype);
+            reloc = new (*sect) Coff32Reloc(addr, sym, rtype);
         else if (machine == CoffObject::MACHINE_AMD64)
-            reloc = new Coff64Reloc(addr, sym, rtype);
+            reloc = new (*sect) Coff64Reloc(addr, sym, rtype);
         else
             assert(false && "nonexistent machine");
         sect->AddReloc(std::auto_ptr<Reloc>(reloc));
@@ -331,13 +348,10 @@ CoffOutput::ConvertValueToBytes(Value& value,
 }
 
 bool
-CoffOutput::OutputSection(Section& sect)
+CoffOutput::BeginSection(Section& sect)
 {
-    BytecodeOutput* outputter = this;
-
     CoffSection* coffsect = sect.getAssocData<CoffSection>();
     assert(coffsect != 0);
-    m_coffsect = coffsect;
 
     // Add to strtab if in win32 format and name > 8 chars
     if (m_objfmt.isWin32())
@@ -347,53 +361,40 @@ CoffOutput::OutputSection(Section& sect)
             coffsect->m_strtab_name = m_strtab.getIndex(sect.getName());
     }
 
-    long pos;
-    if (sect.isBSS())
-    {
-        // Don't output BSS sections.
-        outputter = &m_no_output;
-        pos = 0;    // position = 0 because it's not in the file
-    }
-    else
-    {
-        if (sect.bytecodes_back().getNextOffset() == 0)
-            return true;
+    // Empty sections are not output at all.
+    if (!sect.isBSS() && sect.bytecodes_back().getNextOffset() == 0)
+        return false;
 
-        pos = m_os.tell();
-        if (pos < 0)
-        {
-            Diag(SourceLocation(), diag::err_file_output_position);
-            return false;
-        }
-    }
-    sect.setFilePos(static_cast<unsigned long>(pos));
     coffsect->m_size = 0;
+    return true;
+}
+
+void
+CoffOutput::OutputBytecodes(Section& sect)
+{
+    CoffSection* coffsect = sect.getAssocData<CoffSection>();
+    assert(coffsect != 0);
+    m_coffsect = coffsect;
+
+    // Don't output BSS sections.
+    BytecodeOutput* outputter = this;
+    if (sect.isBSS())
+        outputter = &m_no_output;
 
-    // Output bytecodes
     for (Section::bc_iterator i=sect.bytecodes_begin(),
          end=sect.bytecodes_end(); i != end; ++i)
     {
         if (i->Output(*outputter))
             coffsect->m_size += i->getTotalLen();
     }
+}
 
-    if (getDiagnostics().hasErrorOccurred())
-        return false;
-
-    // Sanity check final section size
-    assert(coffsect->m_size == sect.bytecodes_back().getNextOffset());
-
-    // No relocations to output?  Go on to next section
+void
+CoffOutput::EncodeRelocs(Section& sect, Bytes& bytes)
+{
+    bytes.resize(0);
     if (sect.getRelocs().size() == 0)
-        return true;
-
-    pos = m_os.tell();
-    if (pos < 0)
-    {
-        Diag(SourceLocation(), diag::err_file_output_position);
-        return false;
-    }
-    coffsect->m_relptr = static_cast<unsigned long>(pos);
+        return;
 
     // If >=64K relocs (for Win32/64), we set a flag in the section header
     // (NRELOC_OVFL) and the first relocation contains the number of relocs.
@@ -402,13 +403,12 @@ CoffOutput::OutputSection(Section& sect)
 #if 0
         if (m_objfmt.isWin32())
         {
-            coffsect->m_flags |= CoffSection::NRELOC_OVFL;
-            Bytes& bytes = getScratch();
+            sect.getAssocData<CoffSection>()->m_flags |=
+                CoffSection::NRELOC_OVFL;
             bytes << little_endian;
             Write32(bytes, sect.getRelocs().size()+1);  // address (# relocs)
             Write32(bytes, 0);                          // relocated symbol
             Write16(bytes, 0);                          // type of relocation
-            m_os << bytes;
         }
         else
 #endif
@@ -418,18 +418,185 @@ CoffOutput::OutputSection(Section& sect)
         }
     }
 
+    bytes.reserve(bytes.size() + 10*sect.getRelocs().size());
     for (Section::const_reloc_iterator i=sect.relocs_begin(),
          end=sect.relocs_end(); i != end; ++i)
     {
         const CoffReloc& reloc = static_cast<const CoffReloc&>(*i);
-        Bytes& scratch = getScratch();
-        reloc.Write(scratch);
-        assert(scratch.size() == 10);
-        m_os << scratch;
+        reloc.Write(bytes);
+    }
+    assert(bytes.size() % 10 == 0);
+}
+
+bool
+CoffOutput::BeginData(Section& sect)
+{
+    long pos = 0;   // position = 0 for BSS because it's not in the file
+    if (!sect.isBSS())
+    {
+        pos = m_os.tell();
+        if (pos < 0)
+        {
+            Diag(SourceLocation(), diag::err_file_output_position);
+            return false;
+        }
+    }
+    sect.setFilePos(static_cast<unsigned long>(pos));
+    return true;
+}
+
+bool
+CoffOutput::EndSection(Section& sect, const Bytes& relocs)
+{
+    CoffSection* coffsect = sect.getAssocData<CoffSection>();
+    assert(coffsect != 0);
+
+    // Sanity check final section size
+    assert(coffsect->m_size == sect.bytecodes_back().getNextOffset());
+
+    // No relocations to output?  Go on to next section
+    if (relocs.empty())
+        return true;
+
+    long pos = m_os.tell();
+    if (pos < 0)
+    {
+        Diag(SourceLocation(), diag::err_file_output_position);
+        return false;
     }
+    coffsect->m_relptr = static_cast<unsigned long>(pos);
+    m_os << relocs;
     return true;
 }
 
+bool
+CoffOutput::OutputSection(Section& sect)
+{
+    TraceRegion t("Output Section", sect.getName());
+    if (!BeginSection(sect))
+        return true;
+    if (!BeginData(sect))
+        return false;
+
+    OutputBytecodes(sect);
+    if (getDiagnostics().hasErrorOccurred())
+        return false;
+
+    Bytes& scratch = getScratch();
+    EncodeRelocs(sect, scratch);
+    if (getDiagnostics().hasErrorOccurred())
+        return false;
+
+    return EndSection(sect, scratch);
+}
+
+namespace {
+/// A section being encoded into memory on a worker thread.  Everything
+/// a job touches (diagnostics, scratch, relocations) belongs to its section.
+class CoffSectionOutput
+{
+public:
+    CoffSectionOutput(Section& sect,
+                      CoffObject& objfmt,
+                      Object& object,
+                      bool all_syms,
+                      DiagnosticsEngine& diags);
+    ~CoffSectionOutput();
+
+    void Output();
+
+    Section& m_sect;
+    DiagnosticBuffer m_diags;
+    std::vector<char> m_data;
+    OutputFileStream m_os;
+    CoffOutput m_out;
+    Bytes m_relocs;
+};
+} // anonymous namespace
+
+CoffSectionOutput::CoffSectionOutput(Section& sect,
+                                     CoffObject& objfmt,
+                                     Object& object,
+                                     bool all_syms,
+                                     DiagnosticsEngine& diags)
+    : m_sect(sect)
+    , m_diags(diags)
+    , m_os(m_data)
+    , m_out(m_os, objfmt, object, all_syms, m_diags.getDiagnostics())
+{
+}
+
+CoffSectionOutput::~CoffSectionOutput()
+{
+}
+
+void
+CoffSectionOutput::Output()
+{
+    TraceRegion t("Output Section", m_sect.getName());
+    m_out.OutputBytecodes(m_sect);
+    m_os.close();
+    if (!m_diags.getDiagnostics().hasErrorOccurred())
+        m_out.EncodeRelocs(m_sect, m_relocs);
+}
+
+static void
+CoffSectionOutputJob(stdx::ptr_vector<CoffSectionOutput>& jobs, size_t i)
+{
+    jobs[i].Output();
+}
+
+void
+CoffOutput::OutputSections(unsigned int num_jobs)
+{
+    if (num_jobs == 1 || m_object.getNumSections() <= 1)
+    {
+        for (Object::section_iterator i=m_object.sections_begin(),
+             end=m_object.sections_end(); i != end; ++i)
+        {
+            if (!OutputSection(*i))
+                return;
+        }
+        return;
+    }
+
+    // Encode each section and its relocations into its own buffers.  The
+    // diagnostic engines must be created here as DiagnosticIDs is not
+    // reference counted in a thread-safe manner.
+    stdx::ptr_vector<CoffSectionOutput> jobs;
+    stdx::ptr_vector_owner<CoffSectionOutput> jobs_owner(jobs);
+    for (Object::section_iterator i=m_object.sections_begin(),
+         end=m_object.sections_end(); i != end; ++i)
+    {
+        if (!BeginSection(*i))
+            continue;
+        jobs.push_back(new CoffSectionOutput(*i, m_objfmt, m_object,
+                                             m_all_syms, getDiagnostics()));
+    }
+
+    ThreadPool pool(num_jobs);
+    pool.Run(jobs.size(),
+             TR1::bind(&CoffSectionOutputJob, TR1::ref(jobs), _1));
+
+    // Write the buffers out in section order, replaying diagnostics in the
+    // same order.  As in the serial path, stop at the first section with
+    // an error.
+    DiagnosticsEngine& diags = getDiagnostics();
+    for (stdx::ptr_vector<CoffSectionOutput>::iterator i=jobs.begin(),
+         end=jobs.end(); i != end; ++i)
+    {
+        i->m_diags.Replay(diags);
+        if (diags.hasErrorOccurred())
+            return;
+        if (!BeginData(i->m_sect))
+            return;
+        if (!i->m_data.empty())
+            m_os.write(&i->m_data[0], i->m_data.size());
+        if (!EndSection(i->m_sect, i->m_relocs))
+            return;
+    }
+}
+
 unsigned long
 CoffOutput::CountSymbols()
 {
@@ -483,7 +650,8 @@ CoffOutput::OutputSymbolTable()
 
         Bytes& bytes = getScratch();
         assert(coffsym != 0);
-        coffsym->Write(bytes, *i, getDiagnostics(), m_strtab);
+        coffsym->Write(bytes, *i, getDiagnostics(), m_strtab,
+                       m_objfmt.isBigObj());
         m_os << bytes;
     }
 }
@@ -508,7 +676,7 @@ CoffOutput::OutputSectionHeader(const Section& sect)
 }
 
 void
-CoffObject::Output(raw_fd_ostream& os,
+CoffObject::Output(OutputFileStream& os,
                    bool all_syms,
                    DebugFormat& dbgfmt,
                    DiagnosticsEngine& diags)
@@ -546,8 +714,24 @@ CoffObject::Output(raw_fd_ostream& os,
         }
     }
 
+    // Win32/Win64 objects with too many sections for 16-bit section
+    // numbers use the bigobj format instead; it has a larger file header
+    // and symbol table entries, but is otherwise the same.
+    unsigned int nsects = scnum-1;
+    m_bigobj = false;
+    if (nsects > MAX_SECTIONS)
+    {
+        if (!m_win32)
+        {
+            diags.Report(SourceLocation(), diag::err_coff_too_many_sections)
+                << nsects << MAX_SECTIONS;
+            return;
+        }
+        m_bigobj = true;
+    }
+
     // Allocate space for headers by seeking forward.
-    os.seek(20+40*(scnum-1));
+    os.seek((m_bigobj ? 56 : 20)+40*nsects);
     if (os.has_error())
     {
         diags.Report(SourceLocation(), diag::err_file_output_seek);
@@ -560,12 +744,9 @@ CoffObject::Output(raw_fd_ostream& os,
     unsigned long symtab_count = out.CountSymbols();
 
     // Section data/relocs
-    for (Object::section_iterator i=m_object.sections_begin(),
-         end=m_object.sections_end(); i != end; ++i)
-    {
-        if (!out.OutputSection(*i))
-            return;
-    }
+    out.OutputSections(m_object.getConfig().NumJobs);
+    if (diags.hasErrorOccurred())
+        return;
 
     // Symbol table
     long pos = os.tell();
@@ -591,27 +772,56 @@ CoffObject::Output(raw_fd_ostream& os,
     // Write file header
     Bytes& bytes = out.getScratch();
     bytes.setLittleEndian();
-    Write16(bytes, m_machine);          // magic number
-    Write16(bytes, scnum-1);            // number of sects
     unsigned long ts;
+    const char* epoch = std::getenv("SOURCE_DATE_EPOCH");
     if (std::getenv("YASM_TEST_SUITE"))
         ts = 0;
+    else if (epoch)
+        ts = std::strtoul(epoch, NULL, 10);     // reproducible builds
     else
         ts = static_cast<unsigned long>(std::time(NULL));
-    Write32(bytes, ts);                 // time/date stamp
-    Write32(bytes, symtab_pos);         // file ptr to symtab
-    Write32(bytes, symtab_count);       // number of symtabs
-    Write16(bytes, 0);                  // size of optional header (none)
-
-    // flags
-    unsigned int flags = 0;
-    if (dbgfmt.getModule().getKeyword().equals_lower("null"))
-        flags |= F_LNNO;
-    if (!all_syms)
-        flags |= F_LSYMS;
-    if (m_machine != MACHINE_AMD64)
-        flags |= F_AR32WR;
-    Write16(bytes, flags);
+
+    if (m_bigobj)
+    {
+        // ANON_OBJECT_HEADER_BIGOBJ
+        static const unsigned char classid[16] =
+        {
+            0xC7, 0xA1, 0xBA, 0xD1, 0xEE, 0xBA, 0xA9, 0x4B,
+            0xAF, 0x20, 0xFA, 0xF6, 0x6A, 0xA4, 0xDC, 0xB8
+        };
+        Write16(bytes, MACHINE_UNKNOWN);    // sig1
+        Write16(bytes, 0xffff);             // sig2
+        Write16(bytes, 2);                  // version
+        Write16(bytes, m_machine);          // machine
+        Write32(bytes, ts);                 // time/date stamp
+        bytes.Write(classid);               // class ID
+        Write32(bytes, 0);                  // size of data
+        Write32(bytes, 0);                  // flags
+        Write32(bytes, 0);                  // metadata size
+        Write32(bytes, 0);                  // metadata offset
+        Write32(bytes, nsects);             // number of sects
+        Write32(bytes, symtab_pos);         // file ptr to symtab
+        Write32(bytes, symtab_count);       // number of symtabs
+    }
+    else
+    {
+        Write16(bytes, m_machine);          // magic number
+        Write16(bytes, nsects);             // number of sects
+        Write32(bytes, ts);                 // time/date stamp
+        Write32(bytes, symtab_pos);         // file ptr to symtab
+        Write32(bytes, symtab_count);       // number of symtabs
+        Write16(bytes, 0);                  // size of optional header (none)
+
+        // flags
+        unsigned int flags = 0;
+        if (dbgfmt.getModule().getKeyword().equals_lower("null"))
+            flags |= F_LNNO;
+        if (!all_syms)
+            flags |= F_LSYMS;
+        if (m_machine != MACHINE_AMD64)
+            flags |= F_AR32WR;
+        Write16(bytes, flags);
+    }
     os << bytes;
 
     // Section headers
@@ -0,0 +1,479 @@
+//
+// COFF (DJGPP) object format reader
+//
+//  Copyright (C) 2026  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include "CoffObject.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "llvm/Support/MemoryBuffer.h"
+#include "yasmx/Basic/Diagnostic.h"
+#include "yasmx/Basic/SourceManager.h"
+#include "yasmx/Bytecode.h"
+#include "yasmx/Bytes.h"
+#include "yasmx/Expr.h"
+#include "yasmx/InputBuffer.h"
+#include "yasmx/IntNum.h"
+#include "yasmx/Object.h"
+#include "yasmx/Section.h"
+#include "yasmx/StringTable.h"
+#include "yasmx/Symbol.h"
+#include "yasmx/Symbol_util.h"
+
+#include "CoffReloc.h"
+#include "CoffSection.h"
+#include "CoffSymbol.h"
+
+
+using namespace yasm;
+using namespace yasm::objfmt;
+
+namespace {
+/// COFF file header fields needed to find the rest of the file.
+struct CoffHeader
+{
+    unsigned int machine;
+    bool bigobj;
+    unsigned long nsects;
+    unsigned long symtab_pos;
+    unsigned long nsyms;
+    unsigned long secthead_pos;
+};
+} // anonymous namespace
+
+// ANON_OBJECT_HEADER_BIGOBJ class ID.
+static const unsigned char bigobj_classid[16] =
+{
+    0xC7, 0xA1, 0xBA, 0xD1, 0xEE, 0xBA, 0xA9, 0x4B,
+    0xAF, 0x20, 0xFA, 0xF6, 0x6A, 0xA4, 0xDC, 0xB8
+};
+
+static const unsigned int SECTHEAD_SIZE = 40;
+static const unsigned int RELOC_SIZE = 10;
+
+static bool
+ReadCoffHeader(const MemoryBuffer& in, CoffHeader* hdr)
+{
+    InputBuffer inbuf(in);
+    inbuf.setLittleEndian();
+    if (inbuf.getReadableSize() < 20)
+        return false;
+
+    unsigned int sig1 = ReadU16(inbuf);
+    unsigned int sig2 = ReadU16(inbuf);
+    if (sig1 == CoffObject::MACHINE_UNKNOWN && sig2 == 0xffff)
+    {
+        // bigobj
+        if (inbuf.getReadableSize() < 52)
+            return false;
+        if (ReadU16(inbuf) < 2)                     // version
+            return false;
+        hdr->machine = ReadU16(inbuf);
+        ReadU32(inbuf);                             // time/date stamp
+        if (std::memcmp(inbuf.Read(16).data(), bigobj_classid, 16) != 0)
+            return false;
+        inbuf.setPosition(44);
+        hdr->bigobj = true;
+        hdr->nsects = ReadU32(inbuf);
+        hdr->symtab_pos = ReadU32(inbuf);
+        hdr->nsyms = ReadU32(inbuf);
+        hdr->secthead_pos = 56;
+    }
+    else
+    {
+        hdr->machine = sig1;
+        hdr->bigobj = false;
+        hdr->nsects = sig2;
+        ReadU32(inbuf);                             // time/date stamp
+        hdr->symtab_pos = ReadU32(inbuf);
+        hdr->nsyms = ReadU32(inbuf);
+        hdr->secthead_pos = 20 + ReadU16(inbuf);    // skip optional header
+    }
+
+    if (hdr->machine != CoffObject::MACHINE_I386 &&
+        hdr->machine != CoffObject::MACHINE_AMD64)
+        return false;
+
+    // Section headers must all be present.
+    return hdr->secthead_pos + SECTHEAD_SIZE*hdr->nsects <= in.getBufferSize();
+}
+
+bool
+CoffObject::TasteCoff(const MemoryBuffer& in,
+                      bool win32,
+                      Machine machine_type,
+                      /*@out@*/ std::string* arch_keyword,
+                      /*@out@*/ std::string* machine)
+{
+    CoffHeader hdr;
+    if (!ReadCoffHeader(in, &hdr))
+        return false;
+    if (machine_type != MACHINE_UNKNOWN && hdr.machine != machine_type)
+        return false;
+
+    // Win32 and Win64 objects are told apart from DJGPP ones by their
+    // section flags; only the former use the upper flag bits.
+    bool is_win32 = hdr.bigobj;
+    InputBuffer inbuf(in, hdr.secthead_pos);
+    inbuf.setLittleEndian();
+    for (unsigned long i=0; i<hdr.nsects && !is_win32; ++i)
+    {
+        inbuf.setPosition(hdr.secthead_pos + SECTHEAD_SIZE*i + 36);
+        if ((ReadU32(inbuf) & CoffSection::WIN32_MASK) != 0)
+            is_win32 = true;
+    }
+    if (is_win32 != win32)
+        return false;
+
+    arch_keyword->assign("x86");
+    if (hdr.machine == MACHINE_AMD64)
+        machine->assign("amd64");
+    else
+        machine->assign("x86");
+    return true;
+}
+
+bool
+CoffObject::Taste(const MemoryBuffer& in,
+                  /*@out@*/ std::string* arch_keyword,
+                  /*@out@*/ std::string* machine)
+{
+    return TasteCoff(in, false, MACHINE_UNKNOWN, arch_keyword, machine);
+}
+
+static void
+NoAddSpan(Bytecode& bc,
+          int id,
+          const Value& value,
+          int64_t neg_thres,
+          int64_t pos_thres)
+{
+}
+
+/// Size a section with a single gap bytecode of the given length.
+static void
+AppendSizedGap(Section& sect, unsigned long size)
+{
+    Bytecode& gap = sect.AppendGap(size, SourceLocation());
+    IntrusiveRefCntPtr<DiagnosticIDs> diagids(new DiagnosticIDs);
+    DiagnosticsEngine nodiags(diagids);
+    gap.CalcLen(NoAddSpan, nodiags); // force length calculation
+}
+
+/// Get a name from an 8-byte name field, which either holds the name
+/// itself or a reference to the string table.
+static bool
+ReadName(InputBuffer& inbuf,
+         const StringTable& strtab,
+         unsigned long strtab_size,
+         bool section,
+         DiagnosticsEngine& diags,
+         /*@out@*/ std::string* name)
+{
+    StringRef field = inbuf.ReadString(8);
+    unsigned long offset;
+    if (section && field.startswith("/"))
+    {
+        // Section names give the string table offset in decimal.
+        StringRef digits = field.substr(1, field.find('\0')-1);
+        if (digits.getAsInteger(10, offset))
+            offset = 0;
+    }
+    else if (!section && field.startswith(StringRef("\0\0\0\0", 4)))
+    {
+        InputBuffer offbuf(ArrayRef<unsigned char>(
+            reinterpret_cast<const unsigned char*>(field.data()+4), 4));
+        offbuf.setLittleEndian();
+        offset = ReadU32(offbuf);
+    }
+    else
+    {
+        name->assign(field.data(), std::min<size_t>(field.find('\0'), 8));
+        return true;
+    }
+
+    if (offset < 4 || offset >= strtab_size)
+    {
+        diags.Report(SourceLocation(), diag::err_invalid_string_offset);
+        return false;
+    }
+    name->assign(strtab.getString(offset));
+    return true;
+}
+
+bool
+CoffObject::Read(SourceManager& sm, DiagnosticsEngine& diags)
+{
+    const MemoryBuffer& in = *sm.getBuffer(sm.getMainFileID());
+    unsigned int parts = m_object.getConfig().ReadParts;
+    if ((parts & Object::READ_RELOCS) != 0)
+        parts |= Object::READ_SYMBOLS;  // relocs refer to symbols by index
+
+    // Read header
+    CoffHeader hdr;
+    if (!ReadCoffHeader(in, &hdr))
+    {
+        diags.Report(SourceLocation(), diag::err_not_file_type) << "COFF";
+        return false;
+    }
+    m_bigobj = hdr.bigobj;
+    const unsigned int symsize = m_bigobj ? 20 : 18;
+
+    // Read string table (needed for long section names); it immediately
+    // follows the symbol table.  Offsets include its 4-byte size field.
+    StringTable strtab;
+    unsigned long strtab_size = 0;
+    if (hdr.symtab_pos != 0)
+    {
+        uint64_t strtab_pos =
+            hdr.symtab_pos + static_cast<uint64_t>(symsize)*hdr.nsyms;
+        if (strtab_pos > in.getBufferSize())
+        {
+            diags.Report(SourceLocation(), diag::err_symbol_unreadable);
+            return false;
+        }
+        InputBuffer inbuf(in, static_cast<size_t>(strtab_pos));
+        inbuf.setLittleEndian();
+        if (inbuf.getReadableSize() >= 4)
+        {
+            strtab_size = ReadU32(inbuf);
+            StringRef buf = in.getBuffer().substr(strtab_pos, strtab_size);
+            if (buf.size() < strtab_size)
+            {
+                diags.Report(SourceLocation(),
+                             diag::err_string_table_unreadable);
+                return false;
+            }
+            strtab.Read(buf);
+        }
+    }
+
+    // Read section headers.
+    std::vector<Section*> sections(hdr.nsects+1, 0);    // by section number
+    std::vector<unsigned long> nrelocs(hdr.nsects+1, 0);
+    InputBuffer inbuf(in, hdr.secthead_pos);
+    inbuf.setLittleEndian();
+    for (unsigned long scnum=1; scnum<=hdr.nsects; ++scnum)
+    {
+        std::string name;
+        if (!ReadName(inbuf, strtab, strtab_size, true, diags, &name))
+            return false;
+        unsigned long paddr = ReadU32(inbuf);
+        unsigned long vaddr = ReadU32(inbuf);
+        unsigned long size = ReadU32(inbuf);
+        unsigned long scnptr = ReadU32(inbuf);
+        unsigned long relptr = ReadU32(inbuf);
+        ReadU32(inbuf);                         // file ptr to line nums
+        nrelocs[scnum] = ReadU16(inbuf);
+        ReadU16(inbuf);                         // num of line number entries
+        unsigned long flags = ReadU32(inbuf);
+
+        bool bss = (flags & CoffSection::BSS) != 0 || scnptr == 0;
+        std::auto_ptr<Section> section(new Section(
+            name, (flags & (CoffSection::TEXT | CoffSection::EXECUTE)) != 0,
+            bss, SourceLocation()));
+        section->setFilePos(scnptr);
+        section->setVMA(vaddr);
+        section->setLMA(paddr);
+        unsigned long align = (flags & CoffSection::ALIGN_MASK) >>
+            CoffSection::ALIGN_SHIFT;
+        if (align != 0)
+            section->setAlign(1UL << (align-1));
+
+        if (bss || (parts & Object::READ_CONTENTS) == 0)
+            AppendSizedGap(*section, size);
+        else
+        {
+            StringRef data = in.getBuffer().substr(scnptr, size);
+            if (data.size() < size)
+            {
+                diags.Report(SourceLocation(),
+                             diag::err_section_data_unreadable) << name;
+                return false;
+            }
+            section->bytecodes_front().getFixed().WriteString(data);
+        }
+
+        std::auto_ptr<CoffSection> coffsect(new CoffSection(SymbolRef(0)));
+        coffsect->m_scnum = scnum;
+        coffsect->m_flags = flags;
+        coffsect->m_size = size;
+        coffsect->m_relptr = relptr;
+        coffsect->m_isdebug = StringRef(name).startswith(".debug");
+        section->AddAssocData(coffsect);
+
+        sections[scnum] = section.get();
+        m_object.AppendSection(section);
+    }
+
+    if ((parts & Object::READ_SYMBOLS) == 0 || hdr.symtab_pos == 0)
+        return true;
+
+    // Read symbol table.  Aux entries take up indexes, but have no symbol.
+    std::vector<SymbolRef> symtab;
+    symtab.reserve(hdr.nsyms);
+    inbuf.setPosition(hdr.symtab_pos);
+    while (symtab.size() < hdr.nsyms)
+    {
+        if (inbuf.getReadableSize() < symsize)
+        {
+            diags.Report(SourceLocation(), diag::err_symbol_unreadable);
+            return false;
+        }
+        unsigned long index = symtab.size();
+        std::string name;
+        if (!ReadName(inbuf, strtab, strtab_size, false, diags, &name))
+            return false;
+        unsigned long value = ReadU32(inbuf);
+        long scnum = m_bigobj ? ReadS32(inbuf) : ReadS16(inbuf);
+        unsigned int type = ReadU16(inbuf);
+        CoffSymbol::StorageClass sclass =
+            static_cast<CoffSymbol::StorageClass>(ReadU8(inbuf));
+        unsigned int numaux = ReadU8(inbuf);
+
+        SymbolRef sym(0);
+        if (sclass == CoffSymbol::SCL_EXT || sclass == CoffSymbol::SCL_ALIAS)
+        {
+            sym = m_object.getSymbol(name);
+            if (scnum != 0)
+                sym->Declare(Symbol::GLOBAL);
+            else if (value != 0)
+            {
+                sym->Declare(Symbol::COMMON);
+                setCommonSize(*sym, Expr(value));
+            }
+            else
+                sym->Declare(Symbol::EXTERN);
+        }
+        else
+            sym = m_object.AppendSymbol(name);  // don't index by name
+
+        if (scnum > 0 && static_cast<unsigned long>(scnum) <= hdr.nsects)
+        {
+            Section* sect = sections[scnum];
+            IntNum offset = value;
+            offset -= sect->getVMA();
+            Location loc = {&sect->bytecodes_front(), offset.getUInt()};
+            sym->DefineLabel(loc);
+        }
+        else if (scnum == -1)
+            sym->DefineEqu(Expr(value));
+
+        CoffSymbol::AuxType auxtype = CoffSymbol::AUX_NONE;
+        if (sclass == CoffSymbol::SCL_FILE)
+            auxtype = CoffSymbol::AUX_FILE;
+        else if (sclass == CoffSymbol::SCL_STAT && numaux != 0 && scnum > 0
+                 && value == 0)
+            auxtype = CoffSymbol::AUX_SECT;
+        std::auto_ptr<CoffSymbol> coffsym(new CoffSymbol(sclass, auxtype));
+        coffsym->m_index = index;
+        coffsym->m_type = type;
+        coffsym->m_aux.resize(numaux);
+
+        // Filename aux entries hold the name itself.
+        if (auxtype == CoffSymbol::AUX_FILE && numaux != 0)
+        {
+            if (inbuf.getReadableSize() < symsize*numaux)
+            {
+                diags.Report(SourceLocation(), diag::err_symbol_unreadable);
+                return false;
+            }
+            StringRef fname = inbuf.ReadString(symsize*numaux);
+            coffsym->m_aux[0].fname = fname.substr(0, fname.find('\0'));
+            coffsym->m_aux.resize(1);
+        }
+        else
+            inbuf.setPosition(inbuf.getPosition() + symsize*numaux);
+
+        sym->AddAssocData(coffsym);
+        symtab.push_back(sym);
+        for (unsigned int i=0; i<numaux && symtab.size() < hdr.nsyms; ++i)
+            symtab.push_back(SymbolRef(0));
+    }
+
+    if ((parts & Object::READ_RELOCS) == 0)
+        return true;
+
+    // Read relocations.
+    for (unsigned long scnum=1; scnum<=hdr.nsects; ++scnum)
+    {
+        Section& sect = *sections[scnum];
+        const CoffSection* coffsect = sect.getAssocData<CoffSection>();
+        unsigned long nreloc = nrelocs[scnum];
+        if (nreloc == 0)
+            continue;
+
+        inbuf.setPosition(coffsect->m_relptr);
+        if (inbuf.getReadableSize() < RELOC_SIZE)
+        {
+            diags.Report(SourceLocation(), diag::err_section_relocs_unreadable)
+                << sect.getName();
+            return false;
+        }
+
+        // With too many relocations for the header field, the count
+        // (including this entry) is in the address of the first one.
+        if ((coffsect->m_flags & CoffSection::NRELOC_OVFL) != 0 &&
+            nreloc == 0xffff)
+        {
+            nreloc = ReadU32(inbuf) - 1;
+            inbuf.setPosition(inbuf.getPosition() + RELOC_SIZE-4);
+        }
+
+        if (inbuf.getReadableSize() / RELOC_SIZE < nreloc)
+        {
+            diags.Report(SourceLocation(), diag::err_section_relocs_unreadable)
+                << sect.getName();
+            return false;
+        }
+
+        for (unsigned long i=0; i<nreloc; ++i)
+        {
+            IntNum addr = ReadU32(inbuf);
+            addr -= sect.getVMA();
+            unsigned long symindex = ReadU32(inbuf);
+            CoffReloc::Type type =
+                static_cast<CoffReloc::Type>(ReadU16(inbuf));
+            if (symindex >= symtab.size() || !symtab[symindex])
+            {
+                diags.Report(SourceLocation(),
+                             diag::err_section_relocs_unreadable)
+                    << sect.getName();
+                return false;
+            }
+
+            Reloc* reloc;
+            if (m_machine == MACHINE_AMD64)
+                reloc = new (sect) Coff64Reloc(addr, symtab[symindex], type);
+            else
+                reloc = new (sect) Coff32Reloc(addr, symtab[symindex], type);
+            sect.AddReloc(std::auto_ptr<Reloc>(reloc));
+        }
+    }
+    return true;
+}
@@ -43,6 +43,7 @@ namespace objfmt
 struct YASM_STD_EXPORT CoffSection : public AssocData
 {
     static const char* key;
+    static const bool inline_slot = true;
 
     CoffSection(SymbolRef sym);
     ~CoffSection();
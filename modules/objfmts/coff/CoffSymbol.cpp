@@ -89,12 +89,14 @@ void
 CoffSymbol::Write(Bytes& bytes,
                   const Symbol& sym,
                   DiagnosticsEngine& diags,
-                  StringTable& strtab) const
+                  StringTable& strtab,
+                  bool bigobj) const
 {
     int vis = sym.getVisibility();
+    const unsigned int symsize = bigobj ? 20 : 18;
 
     IntNum value = 0;
-    unsigned int scnum = 0xfffe;    // -2 = debugging symbol
+    long scnum = -2;                // -2 = debugging symbol
     unsigned long scnlen = 0;   // for sect auxent
     unsigned long nreloc = 0;   // for sect auxent
 
@@ -133,7 +135,7 @@ CoffSymbol::Write(Bytes& bytes,
         // trivial case: simple integer
         if (equ_expr.isIntNum())
         {
-            scnum = 0xffff;     // -1 = absolute symbol
+            scnum = -1;         // -1 = absolute symbol
             value = equ_expr.getIntNum();
         }
         else
@@ -173,7 +175,7 @@ CoffSymbol::Write(Bytes& bytes,
             }
             else
             {
-                scnum = 0xffff;     // -1 = absolute symbol
+                scnum = -1;         // -1 = absolute symbol
                 value = 0;
             }
 
@@ -229,12 +231,15 @@ CoffSymbol::Write(Bytes& bytes,
         bytes.Write(8-len, 0);
     }
     Write32(bytes, value);          // value
-    Write16(bytes, scnum);          // section number
+    if (bigobj)                     // section number
+        Write32(bytes, static_cast<unsigned long>(scnum) & 0xffffffffUL);
+    else
+        Write16(bytes, static_cast<unsigned short>(scnum & 0xffff));
     Write16(bytes, m_type);         // type
     Write8(bytes, m_sclass);        // storage class
     Write8(bytes, m_aux.size());    // number of aux entries
 
-    assert(bytes.size() == 18);
+    assert(bytes.size() == symsize);
 
     for (std::vector<AuxEntry>::const_iterator i=m_aux.begin(), end=m_aux.end();
          i != end; ++i)
@@ -242,25 +247,25 @@ CoffSymbol::Write(Bytes& bytes,
         switch (m_auxtype)
         {
             case AUX_NONE:
-                bytes.Write(18, 0);
+                bytes.Write(symsize, 0);
                 break;
             case AUX_SECT:
                 Write32(bytes, scnlen);     // section length
                 Write16(bytes, nreloc);     // number relocs
-                bytes.Write(12, 0);         // number line nums, 0 fill
+                bytes.Write(symsize-6, 0);  // number line nums, 0 fill
                 break;
             case AUX_FILE:
                 len = i->fname.length();
-                if (len > 18)
+                if (len > symsize)
                 {
                     Write32(bytes, 0);
                     Write32(bytes, strtab.getIndex(i->fname));
-                    bytes.Write(18-8, 0);
+                    bytes.Write(symsize-8, 0);
                 }
                 else
                 {
                     bytes.WriteString(i->fname);
-                    bytes.Write(18-len, 0);
+                    bytes.Write(symsize-len, 0);
                 }
                 break;
             default:
@@ -268,5 +273,5 @@ CoffSymbol::Write(Bytes& bytes,
         }
     }
 
-    assert(bytes.size() == 18+18*m_aux.size());
+    assert(bytes.size() == symsize*(1+m_aux.size()));
 }
@@ -47,6 +47,7 @@ namespace objfmt
 struct YASM_STD_EXPORT CoffSymbol : public AssocData
 {
     static const char* key;
+    static const bool inline_slot = true;
 
     enum StorageClass
     {
@@ -98,10 +99,14 @@ struct YASM_STD_EXPORT CoffSymbol : public AssocData
 #ifdef WITH_XML
     pugi::xml_node Write(pugi::xml_node out) const;
 #endif // WITH_XML
+    /// Append the symbol table entry and its aux entries to bytes.
+    /// @param bigobj       write bigobj (20-byte) entries with 32-bit
+    ///                     section numbers rather than 18-byte ones
     void Write(Bytes& bytes,
                const Symbol& sym,
                DiagnosticsEngine& diags,
-               StringTable& strtab) const;
+               StringTable& strtab,
+               bool bigobj = false) const;
 
     bool m_forcevis;                ///< force visibility in symbol table
     unsigned long m_index;          ///< assigned COFF symbol table index
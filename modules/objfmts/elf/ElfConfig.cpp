@@ -61,17 +61,15 @@ ElfConfig::ElfConfig()
 }
 
 ElfSymbolIndex
-ElfConfig::AssignSymbolIndices(Object& object, ElfSymbolIndex* nlocal) const
+ElfConfig::AssignSymbolIndices(ElfOutputSymtab& symtab,
+                               ElfSymbolIndex* nlocal) const
 {
     ElfSymbolIndex num = *nlocal;
 
-    for (Object::symbol_iterator i=object.symbols_begin(),
-         end=object.symbols_end(); i != end; ++i)
+    for (ElfOutputSymtab::iterator i=symtab.begin(), end=symtab.end();
+         i != end; ++i)
     {
-        ElfSymbol* elfsym = i->getAssocData<ElfSymbol>();
-        if (!elfsym || !elfsym->isInTable())
-            continue;
-
+        ElfSymbol* elfsym = *i;
         if (elfsym->getSymbolIndex() != 0)
             continue;
 
@@ -81,43 +79,63 @@ ElfConfig::AssignSymbolIndices(Object& object, ElfSymbolIndex* nlocal) const
         if (elfsym->isLocal())
             *nlocal = num;
     }
+
+    // Place each symbol at its index.  Preassigned indices (section and
+    // file symbols) are all below num.
+    ElfOutputSymtab ordered(num, static_cast<ElfSymbol*>(0));
+    for (ElfOutputSymtab::iterator i=symtab.begin(), end=symtab.end();
+         i != end; ++i)
+    {
+        ElfSymbolIndex index = (*i)->getSymbolIndex();
+        assert(index < num && ordered[index] == 0 && "bad symbol index");
+        ordered[index] = *i;
+    }
+    symtab.swap(ordered);
     return num;
 }
 
 unsigned long
 ElfConfig::WriteSymbolTable(raw_ostream& os,
-                            Object& object,
+                            const ElfOutputSymtab& symtab,
                             DiagnosticsEngine& diags,
-                            Bytes& scratch) const
+                            Bytes& scratch,
+                            Bytes* shndx) const
 {
-    unsigned long size = 0;
+    scratch.resize(0);
+    scratch.reserve((cls == ELFCLASS32 ? SYMTAB32_SIZE : SYMTAB64_SIZE)
+                    * symtab.size());
+    if (shndx)
+    {
+        shndx->resize(0);
+        shndx->reserve(4 * symtab.size());
+        setEndian(*shndx);
+    }
 
     // write undef symbol
     ElfSymbol undef;
-    scratch.resize(0);
     undef.Write(scratch, *this, diags);
-    os << scratch;
-    size += scratch.size();
+    if (shndx)
+        Write32(*shndx, 0);
 
     // write other symbols
-    for (Object::symbol_iterator sym=object.symbols_begin(),
-         end=object.symbols_end(); sym != end; ++sym)
+    for (ElfOutputSymtab::const_iterator i=symtab.begin(), end=symtab.end();
+         i != end; ++i)
     {
-        ElfSymbol* elfsym = sym->getAssocData<ElfSymbol>();
-        if (!elfsym || !elfsym->isInTable())
+        if (!*i)
             continue;
-
-        scratch.resize(0);
-        elfsym->Write(scratch, *this, diags);
-        os << scratch;
-        size += scratch.size();
+        ElfSectionIndex xindex = (*i)->Write(scratch, *this, diags);
+        if (shndx)
+            Write32(*shndx, xindex);
     }
-    return size;
+
+    os << scratch;
+    return scratch.size();
 }
 
 bool
 ElfConfig::ReadSymbolTable(const MemoryBuffer&  in,
                            const ElfSection&    symtab_sect,
+                           const ElfSection*    shndx_sect,
                            ElfSymtab&           symtab,
                            Object&              object,
                            const StringTable&   strtab,
@@ -140,7 +158,8 @@ ElfConfig::ReadSymbolTable(const MemoryBuffer&  in,
     for (unsigned long pos=symsize; pos<size; pos += symsize, ++index)
     {
         std::auto_ptr<ElfSymbol> elfsym(
-            new ElfSymbol(*this, in, symtab_sect, index, sections, diags));
+            new ElfSymbol(*this, in, symtab_sect, shndx_sect, index,
+                          sections, diags));
         if (diags.hasErrorOccurred())
             return false;
 
@@ -219,8 +238,8 @@ ElfConfig::ReadProgramHeader(const MemoryBuffer& in)
     else if (cls == ELFCLASS64)
     {
         start = ReadU64(inbuf);
-        proghead_pos = ReadU64(inbuf).getUInt();
-        secthead_pos = ReadU64(inbuf).getUInt();
+        proghead_pos = ReadU64(inbuf).getUInt64();
+        secthead_pos = ReadU64(inbuf).getUInt64();
     }
 
     machine_flags = ReadU32(inbuf);
@@ -281,8 +300,15 @@ ElfConfig::WriteProgramHeader(raw_ostream& os, Bytes& scratch)
     Write16(scratch, proghead_size);    // e_phentsize
     Write16(scratch, proghead_count);   // e_phnum
     Write16(scratch, secthead_size);    // e_shentsize
-    Write16(scratch, secthead_count);   // e_shnum
-    Write16(scratch, shstrtab_index);   // e_shstrndx
+    // If these don't fit, they're in section header 0 (size and link).
+    if (secthead_count >= SHN_LORESERVE)
+        Write16(scratch, 0);            // e_shnum
+    else
+        Write16(scratch, secthead_count);
+    if (shstrtab_index >= SHN_LORESERVE)
+        Write16(scratch, SHN_XINDEX);   // e_shstrndx
+    else
+        Write16(scratch, shstrtab_index);
 
     assert(scratch.size() == getProgramHeaderSize());
 
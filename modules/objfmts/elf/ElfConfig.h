@@ -61,11 +61,11 @@ struct YASM_STD_EXPORT ElfConfig
     bool            rela;           // relocations have explicit addends?
 
     // other program header fields; may not always be valid
-    unsigned long   proghead_pos;   // file offset of program header (0=none)
+    ElfOffset       proghead_pos;   // file offset of program header (0=none)
     unsigned int    proghead_count; // number of program header entries (0=none)
     unsigned int    proghead_size;  // program header entry size (0=none)
 
-    unsigned long   secthead_pos;   // file offset of section header (0=none)
+    ElfOffset       secthead_pos;   // file offset of section header (0=none)
     unsigned int    secthead_count; // number of section header entries (0=none)
     unsigned int    secthead_size;  // section header entry size (0=none)
 
@@ -79,15 +79,30 @@ struct YASM_STD_EXPORT ElfConfig
     bool ReadProgramHeader(const MemoryBuffer& in);
     void WriteProgramHeader(raw_ostream& os, Bytes& scratch);
 
-    ElfSymbolIndex AssignSymbolIndices(Object& object, ElfSymbolIndex* nlocal)
-        const;
-
+    /// Assign indices to the symbols in symtab that do not yet have one,
+    /// in table order, then rearrange symtab so that each symbol sits at
+    /// its own index.  Unused slots (including 0) are left null.
+    /// @param symtab       in-table symbols, local symbols first
+    /// @param nlocal       first index to assign; updated to one past the
+    ///                     last local symbol
+    /// @return Number of symbol indices (table entries, including undef).
+    ElfSymbolIndex AssignSymbolIndices(ElfOutputSymtab& symtab,
+                                       ElfSymbolIndex* nlocal) const;
+
+    /// Write the symbol table.  All entries are encoded into scratch and
+    /// output with a single write.
+    /// @param symtab       symbols in index order (from AssignSymbolIndices)
+    /// @param shndx        if not NULL, the contents of the extended section
+    ///                     index table (SHT_SYMTAB_SHNDX) are encoded here
+    /// @return Number of bytes written.
     unsigned long WriteSymbolTable(raw_ostream& os,
-                                   Object& object,
+                                   const ElfOutputSymtab& symtab,
                                    DiagnosticsEngine& diags,
-                                   Bytes& scratch) const;
+                                   Bytes& scratch,
+                                   /*@null@*/ Bytes* shndx = 0) const;
     bool ReadSymbolTable(const MemoryBuffer&    in,
                          const ElfSection&      symtab_sect,
+                         /*@null@*/ const ElfSection* shndx_sect,
                          ElfSymtab&             symtab,
                          Object&                object,
                          const StringTable&     strtab,
@@ -68,6 +68,8 @@ ElfSpecialSymbol::Write(pugi::xml_node out) const
     append_child(root, "Name", name);
     append_child(root, "RelocType", reloc);
     append_child(root, "DataSize", size);
+    if (reloc64 != 0)
+        append_child(root, "RelocType64", reloc64);
     append_child(root, "SymRelative", sym_relative);
     append_child(root, "ThreadLocal", thread_local);
     append_child(root, "CurposAdjust", curpos_adjust);
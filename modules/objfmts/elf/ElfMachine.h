@@ -42,6 +42,7 @@ namespace yasm
 class Arch;
 class IntNum;
 class Object;
+class Section;
 
 namespace objfmt
 {
@@ -58,6 +59,9 @@ struct ElfSpecialSymbolData
     bool thread_local:1;    // thread local
     bool curpos_adjust:1;   //
     bool needs_got:1;       // needs GOT symbol in symbol table
+
+    unsigned int reloc64;   // relocation type for 64-bit data, if also
+                            // legal (0 if not)
 };
 
 struct YASM_STD_EXPORT ElfSpecialSymbol
@@ -115,10 +119,11 @@ public:
                   const ElfSymtab& symtab,
                   const MemoryBuffer& in,
                   unsigned long* pos,
-                  bool rela) const = 0;
+                  bool rela,
+                  Section& sect) const = 0;
 
     virtual std::auto_ptr<ElfReloc>
-        MakeReloc(SymbolRef sym, const IntNum& addr) const = 0;
+        MakeReloc(SymbolRef sym, const IntNum& addr, Section& sect) const = 0;
 };
 
 YASM_STD_EXPORT
@@ -42,15 +42,27 @@
 //
 #include "ElfObject.h"
 
+#include <algorithm>
+#include <cstring>
+
+#include "config.h"
+
+#include "llvm/ADT/OwningPtr.h"
 #include "llvm/ADT/SmallString.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/system_error.h"
 #include "yasmx/Basic/Diagnostic.h"
 #include "yasmx/Basic/SourceManager.h"
+#include "yasmx/Config/functional.h"
 #include "yasmx/Parse/Directive.h"
 #include "yasmx/Parse/DirHelpers.h"
 #include "yasmx/Parse/NameValue.h"
+#include "yasmx/Support/OutputFileStream.h"
+#include "yasmx/Support/ThreadPool.h"
+#include "yasmx/Support/Trace.h"
 #include "yasmx/Support/bitcount.h"
+#include "yasmx/Support/ptr_vector.h"
 #include "yasmx/Support/registry.h"
 #include "yasmx/Support/scoped_array.h"
 #include "yasmx/Arch.h"
@@ -84,20 +96,6 @@ isLocal(const Symbol& sym)
     return (vis == Symbol::LOCAL || (vis & Symbol::DLOCAL) != 0);
 }
 
-static inline bool
-byIndex(const Symbol& s1, const Symbol& s2)
-{
-    const ElfSymbol* e1 = s1.getAssocData<ElfSymbol>();
-    const ElfSymbol* e2 = s2.getAssocData<ElfSymbol>();
-    if (e1 && !e2)
-        return true;
-    if (!e1 && e2)
-        return false;
-    if (!e1 && !e2)
-        return false;   // doesn't matter
-    return e1->getSymbolIndex() < e2->getSymbolIndex();
-}
-
 ElfGroup::ElfGroup()
     : flags(0)
 {
@@ -114,8 +112,10 @@ ElfObject::ElfObject(const ObjectFormatModule& module,
     , m_machine(0)
     , m_file_elfsym(0)
     , m_dotdotsym(0)
+    , m_merged(false)
     , m_symvers_owner(m_symvers)
     , m_groups_owner(m_groups)
+    , m_ordering_loaded(false)
 {
     if (bits == 32)
         m_config.cls = ELFCLASS32;
@@ -130,6 +130,9 @@ ElfObject::ElfObject(const ObjectFormatModule& module,
     m_machine.reset(CreateElfMachine(*m_object.getArch(),
                                      m_config.cls).release());
     m_machine->Configure(&m_config);
+
+    m_object.setLabelHandler(TR1::bind(&ElfObject::StartLabel, this,
+                                       _1, _2, _3));
 }
 
 ElfObject::~ElfObject()
@@ -245,6 +248,9 @@ bool
 ElfObject::Read(SourceManager& sm, DiagnosticsEngine& diags)
 {
     const MemoryBuffer& in = *sm.getBuffer(sm.getMainFileID());
+    unsigned int parts = m_object.getConfig().ReadParts;
+    if ((parts & Object::READ_RELOCS) != 0)
+        parts |= Object::READ_SYMBOLS;  // relocs refer to symbols by index
 
     // Read header
     if (!m_config.ReadProgramHeader(in))
@@ -260,6 +266,19 @@ ElfObject::Read(SourceManager& sm, DiagnosticsEngine& diags)
         return false;
     }
 
+    // With extended section numbering, the section count and section
+    // string table index are in section header 0.
+    if (m_config.secthead_count == 0 || m_config.shstrtab_index == SHN_XINDEX)
+    {
+        ElfSection null_sect(m_config, in, 0, diags);
+        if (diags.hasErrorOccurred())
+            return false;
+        if (m_config.secthead_count == 0)
+            m_config.secthead_count = null_sect.getSize().getUInt();
+        if (m_config.shstrtab_index == SHN_XINDEX)
+            m_config.shstrtab_index = null_sect.getLink();
+    }
+
     // Read section string table (needed for section names)
     std::auto_ptr<ElfSection>
         shstrtab_sect(new ElfSection(m_config, in, m_config.shstrtab_index,
@@ -287,6 +306,7 @@ ElfObject::Read(SourceManager& sm, DiagnosticsEngine& diags)
     // special sections
     ElfSection* strtab_sect = 0;
     ElfSection* symtab_sect = 0;
+    ElfSection* shndx_sect = 0;
 
     // read section headers
     for (unsigned int i=0; i<m_config.secthead_count; ++i)
@@ -312,6 +332,7 @@ ElfObject::Read(SourceManager& sm, DiagnosticsEngine& diags)
         if (secttype == SHT_NULL ||
             secttype == SHT_SYMTAB ||
             secttype == SHT_STRTAB ||
+            secttype == SHT_SYMTAB_SHNDX ||
             secttype == SHT_RELA ||
             secttype == SHT_REL)
         {
@@ -323,6 +344,8 @@ ElfObject::Read(SourceManager& sm, DiagnosticsEngine& diags)
                 symtab_sect = elfsect.get();
             else if (secttype == SHT_STRTAB && strtab_sect == 0)
                 strtab_sect = elfsect.get();
+            else if (secttype == SHT_SYMTAB_SHNDX)
+                shndx_sect = elfsects[i];
 
             // if any section is RELA, set config to RELA
             if (secttype == SHT_RELA)
@@ -331,7 +354,9 @@ ElfObject::Read(SourceManager& sm, DiagnosticsEngine& diags)
         else
         {
             std::auto_ptr<Section> section = elfsect->CreateSection(shstrtab);
-            if (!elfsect->LoadSectionData(*section, in, diags))
+            if ((parts & Object::READ_CONTENTS) == 0)
+                elfsect->SkipSectionData(*section);
+            else if (!elfsect->LoadSectionData(*section, in, diags))
                 return false;
             sections[i] = section.get();
 
@@ -346,6 +371,9 @@ ElfObject::Read(SourceManager& sm, DiagnosticsEngine& diags)
     // Symbol table by index (needed for relocation lookups by index)
     std::vector<SymbolRef> symtab;
 
+    if ((parts & Object::READ_SYMBOLS) == 0)
+        return true;
+
     // read symtab string table and symbol table (if present)
     if (symtab_sect != 0)
     {
@@ -367,11 +395,24 @@ ElfObject::Read(SourceManager& sm, DiagnosticsEngine& diags)
             return false;
 
         // load symbol table
-        if (!m_config.ReadSymbolTable(in, *symtab_sect, symtab, m_object,
+        // the extended section index table must go with this symbol table
+        if (shndx_sect != 0)
+        {
+            link = shndx_sect->getLink();
+            if (link >= m_config.secthead_count
+                || elfsects[link] != symtab_sect)
+                shndx_sect = 0;
+        }
+
+        if (!m_config.ReadSymbolTable(in, *symtab_sect, shndx_sect,
+                                      symtab, m_object,
                                       strtab, &sections[0], diags))
             return false;
     }
 
+    if ((parts & Object::READ_RELOCS) == 0)
+        return true;
+
     // go through misc sections to load relocations
     for (unsigned int i=0; i<m_config.secthead_count; ++i)
     {
@@ -406,6 +447,436 @@ ElfObject::Read(SourceManager& sm, DiagnosticsEngine& diags)
     return true;
 }
 
+namespace {
+/// Where the contents of a section of an object being merged were placed.
+struct ElfMergePiece
+{
+    ElfMergePiece() : sect(0), offset(0) {}
+
+    Section* sect;          // merged section (0 if not merged)
+    unsigned long offset;   // offset of the contents within sect
+};
+} // anonymous namespace
+
+// Pad the contents of a merged section, with NOPs if it is code.
+static void
+ElfMergePad(Section& sect, unsigned long size, const Arch& arch)
+{
+    Bytes& fixed = sect.bytecodes_front().getFixed();
+    const unsigned char** fill = sect.isCode() ? arch.getFill() : 0;
+    if (!fill)
+    {
+        fixed.Write(size, 0);
+        return;
+    }
+    while (size > 0)
+    {
+        unsigned long n = std::min(size, 15UL);
+        fixed.Write(ArrayRef<unsigned char>(fill[n], n));
+        size -= n;
+    }
+}
+
+// Copy the type, visibility, and size of a symbol being merged.
+static void
+ElfMergeSymbolInfo(ElfSymbol& elfsym, ElfSymbol& entry)
+{
+    elfsym.setType(entry.getType());
+    elfsym.setVisibility(entry.getVisibility());
+    const Expr& size = entry.getSize();
+    if (size.isIntNum() && !size.getIntNum().isZero())
+        elfsym.setSize(size, SourceLocation());
+}
+
+bool
+ElfObject::Merge(const MemoryBuffer& in, DiagnosticsEngine& diags)
+{
+    // Don't deduplicate mergeable sections on output; relocations read
+    // from the merged objects refer to their contents by offset.
+    m_merged = true;
+
+    // Read header; the file must be of the same class and machine.
+    ElfConfig config;
+    if (!config.ReadProgramHeader(in))
+    {
+        diags.Report(SourceLocation(), diag::err_not_file_type) << "ELF";
+        return false;
+    }
+    if (config.cls != m_config.cls ||
+        config.machine_type != m_config.machine_type ||
+        config.file_type != ET_REL)
+    {
+        diags.Report(SourceLocation(), diag::err_merge_object_mismatch);
+        return false;
+    }
+    if (config.secthead_pos == 0)
+    {
+        diags.Report(SourceLocation(), diag::err_no_section_table);
+        return false;
+    }
+    if (config.secthead_count == 0 || config.shstrtab_index == SHN_XINDEX)
+    {
+        ElfSection null_sect(config, in, 0, diags);
+        if (diags.hasErrorOccurred())
+            return false;
+        if (config.secthead_count == 0)
+            config.secthead_count = null_sect.getSize().getUInt();
+        if (config.shstrtab_index == SHN_XINDEX)
+            config.shstrtab_index = null_sect.getLink();
+    }
+
+    ElfSection shstrtab_sect(config, in, config.shstrtab_index, diags);
+    if (diags.hasErrorOccurred())
+        return false;
+    StringTable shstrtab;
+    if (!LoadStringTable(&shstrtab, in, shstrtab_sect, diags))
+        return false;
+
+    // Read all section headers, appending the contents of each section to
+    // the section of the same name.
+    stdx::ptr_vector<ElfSection> elfsects;
+    stdx::ptr_vector_owner<ElfSection> elfsects_owner(elfsects);
+    elfsects.reserve(config.secthead_count);
+    std::vector<ElfMergePiece> pieces(config.secthead_count);
+    ElfSection* symtab_sect = 0;
+    ElfSection* shndx_sect = 0;
+
+    for (unsigned int i=0; i<config.secthead_count; ++i)
+    {
+        elfsects.push_back(new ElfSection(config, in, i, diags));
+        if (diags.hasErrorOccurred())
+            return false;
+        ElfSection& elfsect = elfsects.back();
+
+        ElfSectionType type = elfsect.getType();
+        if (type == SHT_SYMTAB)
+        {
+            if (symtab_sect != 0)
+            {
+                diags.Report(SourceLocation(),
+                             diag::err_multiple_symbol_tables);
+                return false;
+            }
+            symtab_sect = &elfsect;
+            continue;
+        }
+        if (type == SHT_SYMTAB_SHNDX)
+            shndx_sect = &elfsect;
+        if (type == SHT_NULL || type == SHT_STRTAB ||
+            type == SHT_SYMTAB_SHNDX || type == SHT_REL || type == SHT_RELA)
+            continue;
+
+        StringRef name = shstrtab.getString(elfsect.getName());
+        ElfSectionFlags flags = elfsect.getFlags();
+        if (type == SHT_GROUP || (flags & SHF_GROUP) != 0)
+        {
+            diags.Report(SourceLocation(), diag::err_merge_section_group)
+                << name;
+            return false;
+        }
+        if ((flags & SHF_COMPRESSED) != 0)
+        {
+            diags.Report(SourceLocation(), diag::err_merge_compressed)
+                << name;
+            return false;
+        }
+
+        bool bss = (type == SHT_NOBITS);
+        unsigned long align = elfsect.getAlign();
+        Section* sect = m_object.FindSection(name);
+        if (!sect)
+        {
+            sect = AppendSection(name, SourceLocation(), diags);
+            ElfSection* merged = sect->getAssocData<ElfSection>();
+            merged->setTypeFlags(type, flags);
+            merged->setEntSize(elfsect.getEntSize());
+            sect->setCode((flags & SHF_EXECINSTR) != 0);
+            sect->setBSS(bss);
+            sect->setAlign(align);
+        }
+        else
+        {
+            ElfSection* merged = sect->getAssocData<ElfSection>();
+            if (merged->getType() != type)
+            {
+                diags.Report(SourceLocation(), diag::err_merge_section_type)
+                    << name;
+                return false;
+            }
+
+            // Entries can only be merged by the linker if they all match.
+            ElfSectionFlags mflags = merged->getFlags() | flags;
+            if (merged->getEntSize() != elfsect.getEntSize() ||
+                ((merged->getFlags() ^ flags) & (SHF_MERGE|SHF_STRINGS)) != 0)
+            {
+                mflags &= ~(SHF_MERGE|SHF_STRINGS);
+                merged->setEntSize(0);
+            }
+            merged->setTypeFlags(type, mflags);
+            if (align > sect->getAlign())
+                sect->setAlign(align);
+        }
+
+        // Data is kept in the first bytecode; BSS is sized with gaps.
+        unsigned long mask = (align > 1) ? align-1 : 0;
+        ElfMergePiece& piece = pieces[i];
+        piece.sect = sect;
+        if (bss)
+        {
+            unsigned long end = sect->bytecodes_back().getNextOffset();
+            piece.offset = (end + mask) & ~mask;
+            AppendSizedGap(*sect, piece.offset - end +
+                           elfsect.getSize().getUInt());
+        }
+        else
+        {
+            unsigned long end = sect->bytecodes_front().getFixed().size();
+            piece.offset = (end + mask) & ~mask;
+            ElfMergePad(*sect, piece.offset - end, *m_object.getArch());
+            if (!elfsect.LoadSectionData(*sect, in, diags))
+                return false;
+        }
+        sect->UpdateOffsets(diags);
+    }
+
+    // Symbol table by index (needed for relocation lookups by index)
+    ElfSymtab symtab;
+    // Amount to add to the addends of relocations against section symbols
+    std::map<const Symbol*, IntNum> sect_addends;
+
+    if (symtab_sect != 0)
+    {
+        ElfSectionIndex link = symtab_sect->getLink();
+        if (link >= config.secthead_count ||
+            elfsects[link].getType() != SHT_STRTAB)
+        {
+            diags.Report(SourceLocation(), diag::err_no_symbol_string_table);
+            return false;
+        }
+        StringTable strtab;
+        if (!LoadStringTable(&strtab, in, elfsects[link], diags))
+            return false;
+
+        if (shndx_sect != 0 && (shndx_sect->getLink() >= config.secthead_count
+            || &elfsects[shndx_sect->getLink()] != symtab_sect))
+            shndx_sect = 0;
+
+        ElfSize symsize = symtab_sect->getEntSize();
+        if (symsize == 0)
+        {
+            diags.Report(SourceLocation(), diag::err_symbol_entity_size_zero);
+            return false;
+        }
+        unsigned long nsyms = symtab_sect->getSize().getUInt() / symsize;
+
+        // Sections are found through pieces instead.
+        std::vector<Section*> no_sections(config.secthead_count, 0);
+
+        symtab.reserve(nsyms);
+        symtab.push_back(SymbolRef(0));
+        for (ElfSymbolIndex index=1; index<nsyms; ++index)
+        {
+            ElfSymbol entry(config, in, *symtab_sect, shndx_sect, index,
+                            &no_sections[0], diags);
+            if (diags.hasErrorOccurred())
+                return false;
+
+            StringRef name = strtab.getString(entry.getName());
+            ElfSectionIndex shndx = entry.getSectionIndex();
+            bool header_index = entry.isSectionHeaderIndex();
+            const ElfMergePiece* piece = 0;
+            if (header_index && shndx != SHN_UNDEF &&
+                shndx < config.secthead_count && pieces[shndx].sect != 0)
+                piece = &pieces[shndx];
+
+            Location loc = {0, 0};
+            if (piece)
+            {
+                loc.bc = &piece->sect->bytecodes_front();
+                loc.off = piece->offset + entry.getValue().getUInt();
+            }
+
+            SymbolRef sym(0);
+            ElfSymbolBinding bind = entry.getBinding();
+            ElfSymbolType type = entry.getType();
+            if (type == STT_SECTION)
+            {
+                if (!piece)
+                    ;   // relocations against it are dropped
+                else if (piece->offset == 0 || m_config.rela)
+                {
+                    sym = piece->sect->getSymbol();
+                    sect_addends[sym] = piece->offset;
+                }
+                else
+                {
+                    // The addend is in the section contents, so refer to
+                    // the start of this file's contents with a label.
+                    sym = m_object.AppendSymbol("");
+                    sym->DefineLabel(loc);
+                    BuildSymbol(*sym);
+                }
+            }
+            else if (type == STT_FILE && m_file_elfsym != 0 &&
+                     m_object.getSourceFilename().empty())
+            {
+                // The first file names the merged object.
+                m_object.setSourceFilename(name);
+            }
+            else if (type == STT_FILE)
+            {
+                sym = m_object.AppendSymbol(name);
+                sym->DefineSpecial(Symbol::LOCAL);
+                ElfSymbol& elfsym = BuildSymbol(*sym);
+                elfsym.setSectionIndex(SHN_ABS);
+                elfsym.setType(STT_FILE);
+            }
+            else if (bind == STB_LOCAL)
+            {
+                sym = m_object.AppendSymbol(name);
+                if (piece)
+                    sym->DefineLabel(loc);
+                else
+                    sym->DefineEqu(Expr(entry.getValue()));
+                ElfMergeSymbolInfo(BuildSymbol(*sym), entry);
+            }
+            else
+            {
+                // Global symbols are resolved between merged files.
+                sym = m_object.getSymbol(name);
+                ElfSymbol& elfsym = BuildSymbol(*sym);
+                int vis = sym->getVisibility();
+                bool common = !header_index && shndx == SHN_COMMON;
+                bool prev_common = (vis & Symbol::COMMON) != 0;
+
+                if (header_index && shndx == SHN_UNDEF)
+                {
+                    // A reference; weak only if all references are weak.
+                    if (!sym->isDefined() && !prev_common)
+                    {
+                        sym->Use(SourceLocation());
+                        if (elfsym.getBinding() != STB_GLOBAL)
+                            elfsym.setBinding(bind);
+                    }
+                }
+                else if (common && sym->isDefined())
+                    ;   // a definition takes precedence over common
+                else if (common && prev_common)
+                {
+                    // use the largest size
+                    Expr* size = getCommonSize(*sym);
+                    if (size && size->isIntNum() &&
+                        entry.getSize().getIntNum() > size->getIntNum())
+                        *size = entry.getSize();
+                }
+                else if (common)
+                {
+                    sym->Declare(Symbol::COMMON);
+                    setCommonSize(*sym, entry.getSize());
+                    NameValues nvs;
+                    nvs.push_back(new NameValue(std::auto_ptr<Expr>(
+                        new Expr(entry.getValue()))));
+                    setObjextNameValues(*sym, nvs);
+                    elfsym.setBinding(bind);
+                    elfsym.setType(type);
+                    elfsym.setVisibility(entry.getVisibility());
+                }
+                else if (!sym->isDefined() && !prev_common)
+                {
+                    if (piece)
+                        sym->DefineLabel(loc);
+                    else
+                        sym->DefineEqu(Expr(entry.getValue()));
+                    sym->Declare(Symbol::GLOBAL);
+                    elfsym.setBinding(bind);
+                    ElfMergeSymbolInfo(elfsym, entry);
+                }
+                else if (bind == STB_WEAK)
+                    ;   // keep the previous definition
+                else if (elfsym.getBinding() == STB_WEAK && piece &&
+                         sym->getLabel(&loc))
+                {
+                    // A strong definition replaces a weak one.
+                    loc.bc = &piece->sect->bytecodes_front();
+                    loc.off = piece->offset + entry.getValue().getUInt();
+                    sym->MoveLabel(loc);
+                    elfsym.setBinding(STB_GLOBAL);
+                    ElfMergeSymbolInfo(elfsym, entry);
+                }
+                else
+                {
+                    diags.Report(SourceLocation(), diag::err_symbol_redefined)
+                        << name;
+                    return false;
+                }
+            }
+            symtab.push_back(sym);
+        }
+    }
+
+    // Read relocations, moving them to where their section's contents
+    // were placed.
+    for (unsigned int i=0; i<config.secthead_count; ++i)
+    {
+        const ElfSection& reloc_sect = elfsects[i];
+        ElfSectionType type = reloc_sect.getType();
+        if (type != SHT_REL && type != SHT_RELA)
+            continue;
+
+        ElfSectionIndex info = reloc_sect.getInfo();
+        if (info >= config.secthead_count || pieces[info].sect == 0)
+            continue;
+        const ElfMergePiece& piece = pieces[info];
+
+        bool rela = (type == SHT_RELA);
+        if (rela != m_config.rela)
+        {
+            diags.Report(SourceLocation(), diag::err_merge_object_mismatch);
+            return false;
+        }
+
+        unsigned long pos = reloc_sect.getFileOffset();
+        unsigned long end = pos + reloc_sect.getSize().getUInt();
+        while (pos < end)
+        {
+            unsigned long start = pos;
+            std::auto_ptr<ElfReloc> reloc =
+                m_machine->ReadReloc(config, symtab, in, &pos, rela,
+                                     *piece.sect);
+            if (pos == start)
+            {
+                diags.Report(SourceLocation(),
+                             diag::err_section_relocs_unreadable)
+                    << piece.sect->getName();
+                return false;
+            }
+
+            SymbolRef sym = reloc->getSymbol();
+            if (!sym)
+                continue;
+            IntNum addend(0);
+            std::map<const Symbol*, IntNum>::const_iterator sect_addend =
+                sect_addends.find(sym);
+            if (sect_addend != sect_addends.end())
+                addend = sect_addend->second;
+            reloc->Rebase(piece.offset, addend);
+            piece.sect->AddReloc(std::auto_ptr<Reloc>(reloc.release()));
+        }
+    }
+    return !diags.hasErrorOccurred();
+}
+
+bool
+ElfObject::AppendPiece(ObjectFormat& piece)
+{
+    // Symbol versions and section groups are recorded here rather than
+    // in the object, so pieces with any can't be appended.
+    ElfObject& elf = static_cast<ElfObject&>(piece);
+    if (!elf.m_symvers.empty() || !elf.m_groups.empty() || elf.m_merged)
+        return false;
+    return m_object.AppendObject(elf.m_object);
+}
+
 void
 ElfObject::InitSymbols(StringRef parser)
 {
@@ -751,11 +1222,32 @@ ElfObject::FinalizeSymbol(Symbol& sym,
         elfsym->setName(strtab.getIndex(sym.getName()));
 }
 
+/// Advance the output position to pos by writing zeros.
+/// @return False if pos is behind the current output position.
+static bool
+ElfPadOutput(raw_ostream& os, uint64_t pos)
+{
+    static const char zeros[64] = {0};
+
+    uint64_t cur = os.tell();
+    if (pos < cur)
+        return false;
+
+    uint64_t delta = pos - cur;
+    while (delta > sizeof(zeros))
+    {
+        os.write(zeros, sizeof(zeros));
+        delta -= sizeof(zeros);
+    }
+    os.write(zeros, static_cast<size_t>(delta));
+    return true;
+}
+
 namespace {
 class ElfOutput : public BytecodeStreamOutput
 {
 public:
-    ElfOutput(raw_fd_ostream& os,
+    ElfOutput(OutputFileStream& os,
               ElfObject& objfmt,
               Object& object,
               DiagnosticsEngine& diags);
@@ -764,6 +1256,22 @@ public:
     void OutputGroup(ElfGroup& group);
     void OutputSection(Section& sect, StringTable& shstrtab);
 
+    /// Output all user sections.  If num_jobs is not 1, the sections are
+    /// serialized into memory concurrently and then written in order.
+    /// Debug sections are compressed by the same jobs.
+    /// @param shstrtab     section header string table
+    /// @param num_jobs     maximum number of threads; 0 selects the number
+    ///                     of processors
+    /// @param compress     debug section compression (ELFCOMPRESS_*), or 0
+    ///                     for none
+    void OutputSections(StringTable& shstrtab,
+                        unsigned int num_jobs,
+                        unsigned int compress);
+
+    bool BeginSection(Section& sect, StringTable& shstrtab);
+    void OutputBytecodes(Section& sect);
+    void EndSection(Section& sect, StringTable& shstrtab);
+
     // OutputBytecode overrides
     bool ConvertValueToBytes(Value& value,
                              Location loc,
@@ -774,45 +1282,107 @@ public:
 
     bool NeedsGOT() const { return m_needs_GOT; }
 
+protected:
+    void DoOutputGap(uint64_t size, SourceLocation source);
+    void DoOutputBytes(const Bytes& bytes, SourceLocation source);
+    void DoOutputRaw(StringRef data, SourceLocation source);
+    void DoOutputFill(const Bytes& bytes,
+                      uint64_t count,
+                      SourceLocation source);
+
 private:
     ElfObject& m_objfmt;
     Object& m_object;
-    raw_fd_ostream& m_fd_os;
     BytecodeNoOutput m_no_output;
     SymbolRef m_GOT_sym;
     bool m_needs_GOT;
+    bool m_relax_relocs;
+    bool m_pack_relative;
+
+    // The last bytes output (up to the longest instruction), so relocations
+    // within an instruction can look at the bytes preceding the value.
+    enum { TAIL_SIZE = 15 };
+    unsigned char m_tail[TAIL_SIZE];
+    unsigned int m_tail_len;
 };
 } // anonymous namespace
 
-ElfOutput::ElfOutput(raw_fd_ostream& os,
+ElfOutput::ElfOutput(OutputFileStream& os,
                      ElfObject& objfmt,
                      Object& object,
                      DiagnosticsEngine& diags)
     : BytecodeStreamOutput(os, diags)
     , m_objfmt(objfmt)
     , m_object(object)
-    , m_fd_os(os)
     , m_no_output(diags)
     , m_GOT_sym(object.FindSymbol("_GLOBAL_OFFSET_TABLE_"))
     , m_needs_GOT(false)
+    , m_relax_relocs(object.getConfig().RelaxRelocations)
+    , m_pack_relative(object.getConfig().PackRelativeRelocs)
+    , m_tail_len(0)
 {
+    setListFormat(object.getListFormat());
+    m_no_output.setListFormat(object.getListFormat());
 }
 
 ElfOutput::~ElfOutput()
 {
 }
 
+void
+ElfOutput::DoOutputGap(uint64_t size, SourceLocation source)
+{
+    m_tail_len = 0;
+    BytecodeStreamOutput::DoOutputGap(size, source);
+}
+
+void
+ElfOutput::DoOutputBytes(const Bytes& bytes, SourceLocation source)
+{
+    Bytes::size_type size = bytes.size();
+    if (size >= TAIL_SIZE)
+    {
+        std::memcpy(m_tail, &bytes[size-TAIL_SIZE], TAIL_SIZE);
+        m_tail_len = TAIL_SIZE;
+    }
+    else if (size > 0)
+    {
+        unsigned int keep = std::min<unsigned int>(m_tail_len,
+                                                   TAIL_SIZE - size);
+        std::memmove(m_tail, m_tail + m_tail_len - keep, keep);
+        std::memcpy(m_tail + keep, &bytes[0], size);
+        m_tail_len = keep + size;
+    }
+    BytecodeStreamOutput::DoOutputBytes(bytes, source);
+}
+
+void
+ElfOutput::DoOutputRaw(StringRef data, SourceLocation source)
+{
+    m_tail_len = 0;
+    BytecodeStreamOutput::DoOutputRaw(data, source);
+}
+
+void
+ElfOutput::DoOutputFill(const Bytes& bytes,
+                        uint64_t count,
+                        SourceLocation source)
+{
+    m_tail_len = 0;
+    BytecodeStreamOutput::DoOutputFill(bytes, count, source);
+}
+
 bool
 ElfOutput::ConvertSymbolToBytes(SymbolRef sym,
                                 Location loc,
                                 NumericOutput& num_out)
 {
+    Section* sect = loc.bc->getContainer()->getSection();
     std::auto_ptr<ElfReloc> reloc =
-        m_objfmt.m_machine->MakeReloc(sym, loc.getOffset());
+        m_objfmt.m_machine->MakeReloc(sym, loc.getOffset(), *sect);
     if (reloc->setRel(false, m_GOT_sym, num_out.getSize(), false))
     {
         // allocate .rel[a] sections on a need-basis
-        Section* sect = loc.bc->getContainer()->getSection();
         sect->AddReloc(std::auto_ptr<Reloc>(reloc.release()));
     }
     else
@@ -848,6 +1418,7 @@ ElfOutput::ConvertValueToBytes(Value& value,
 
         SymbolRef sym = value.getRelative();
         SymbolRef wrt = value.getWRT();
+        Section* target = 0;    // section relocated against, if any
 
         // create GOT symbol if we don't already have one.
         if (wrt && !m_GOT_sym && isWRTElfNeedsGOT(*wrt))
@@ -878,6 +1449,7 @@ ElfOutput::ConvertValueToBytes(Value& value,
                 {
                     // Relocate to section start
                     sym = sym_sect->getSymbol();
+                    target = sym_sect;
 
                     intn += symloc.getOffset();
                 }
@@ -901,7 +1473,7 @@ ElfOutput::ConvertValueToBytes(Value& value,
         // Create relocation
         Section* sect = loc.bc->getContainer()->getSection();
         std::auto_ptr<ElfReloc> reloc =
-            m_objfmt.m_machine->MakeReloc(sym, loc.getOffset());
+            m_objfmt.m_machine->MakeReloc(sym, loc.getOffset(), *sect);
         if (wrt)
         {
             if (!reloc->setWrt(wrt, value.getSize()))
@@ -919,7 +1491,30 @@ ElfOutput::ConvertValueToBytes(Value& value,
             }
         }
 
-        if (reloc->isValid())
+        // The instruction bytes before the value were output just before it.
+        unsigned int insn_start = value.getInsnStart();
+        if (m_relax_relocs && reloc->isValid() && insn_start > 0 &&
+            insn_start <= m_tail_len)
+        {
+            reloc->setInsn(llvm::ArrayRef<unsigned char>(
+                m_tail + m_tail_len - insn_start, insn_start));
+        }
+
+        // Addresses of allocated sections stored in allocated sections may
+        // be packed into a relative relocation section, which keeps the
+        // address within the target section in place.  Their offsets must
+        // be even for the encoding.
+        ElfSection* elfsect = sect->getAssocData<ElfSection>();
+        if (m_pack_relative && target && !pc_rel && reloc->isValid() &&
+            reloc->isAbsoluteAddress() && (loc.getOffset() & 1) == 0 &&
+            (elfsect->getFlags() & SHF_ALLOC) != 0 &&
+            (target->getAssocData<ElfSection>()->getFlags() & SHF_ALLOC) != 0)
+        {
+            elfsect->AddRelativeReloc(
+                target->getAssocData<ElfSection>()->getIndex(),
+                loc.getOffset());
+        }
+        else if (reloc->isValid())
         {
             reloc->HandleAddend(&intn, m_objfmt.m_config, value.getInsnStart());
             sect->AddReloc(std::auto_ptr<Reloc>(reloc.release()));
@@ -940,8 +1535,8 @@ ElfOutput::OutputGroup(ElfGroup& group)
         return;
     }
 
-    m_fd_os.seek(group.elfsect->setFileOffset(pos));
-    if (m_os.has_error())
+    if (!ElfPadOutput(m_os, group.elfsect->setFileOffset(pos)) ||
+        m_os.has_error())
     {
         Diag(SourceLocation(), diag::err_file_output_seek);
         return;
@@ -969,11 +1564,9 @@ ElfOutput::OutputGroup(ElfGroup& group)
     OutputBytes(scratch, SourceLocation());
 }
 
-void
-ElfOutput::OutputSection(Section& sect, StringTable& shstrtab)
+bool
+ElfOutput::BeginSection(Section& sect, StringTable& shstrtab)
 {
-    BytecodeOutput* outputter = this;
-
     ElfSection* elfsect = sect.getAssocData<ElfSection>();
     assert(elfsect != 0);
 
@@ -982,48 +1575,63 @@ ElfOutput::OutputSection(Section& sect, StringTable& shstrtab)
 
     elfsect->setName(shstrtab.getIndex(sect.getName()));
 
-    uint64_t pos;
+    // Don't output BSS sections; they stay at position 0 as they're not
+    // in the file.
     if (sect.isBSS())
+        return true;
+
+    uint64_t pos = m_os.tell();
+    if (m_os.has_error())
     {
-        // Don't output BSS sections.
-        outputter = &m_no_output;
-        pos = 0;    // position = 0 because it's not in the file
+        Diag(SourceLocation(), diag::err_file_output_position);
+        return false;
     }
-    else
-    {
-        pos = m_os.tell();
-        if (m_os.has_error())
-        {
-            Diag(SourceLocation(), diag::err_file_output_position);
-            return;
-        }
 
-        m_fd_os.seek(elfsect->setFileOffset(pos));
-        if (m_os.has_error())
-        {
-            Diag(SourceLocation(), diag::err_file_output_seek);
-            return;
-        }
+    if (!ElfPadOutput(m_os, elfsect->setFileOffset(pos)) ||
+        m_os.has_error())
+    {
+        Diag(SourceLocation(), diag::err_file_output_seek);
+        return false;
     }
+    return true;
+}
+
+void
+ElfOutput::OutputBytecodes(Section& sect)
+{
+    BytecodeOutput* outputter = this;
+    if (sect.isBSS())
+        outputter = &m_no_output;
+
+    ElfSection* elfsect = sect.getAssocData<ElfSection>();
+    assert(elfsect != 0);
 
-    // Output bytecodes
     for (Section::bc_iterator i=sect.bytecodes_begin(),
          end=sect.bytecodes_end(); i != end; ++i)
     {
         if (i->Output(*outputter))
             elfsect->AddSize(i->getTotalLen());
     }
+}
 
-    if (getDiagnostics().hasErrorOccurred())
-        return;
+void
+ElfOutput::EndSection(Section& sect, StringTable& shstrtab)
+{
+    ElfSection* elfsect = sect.getAssocData<ElfSection>();
+    assert(elfsect != 0);
 
     // Sanity check final section size
-    assert(elfsect->getSize() == sect.bytecodes_back().getNextOffset());
+    assert((elfsect->getFlags() & SHF_COMPRESSED) != 0 ||
+           elfsect->getSize() == sect.bytecodes_back().getNextOffset());
 
     // Empty?  Go on to next section
     if (elfsect->isEmpty())
         return;
 
+    // name the relative relocation section(s) .relr.foo
+    if (!elfsect->getRelativeRelocs().empty())
+        elfsect->setRelrName(shstrtab.getIndex(".relr" + sect.getName().str()));
+
     // No relocations?  Go on to next section
     if (sect.getRelocs().size() == 0)
         return;
@@ -1033,8 +1641,191 @@ ElfOutput::OutputSection(Section& sect, StringTable& shstrtab)
     elfsect->setRelName(shstrtab.getIndex(relname));
 }
 
-static unsigned long
-ElfAlignOutput(raw_fd_ostream& os,
+void
+ElfOutput::OutputSection(Section& sect, StringTable& shstrtab)
+{
+    TraceRegion t("Output Section", sect.getName());
+    if (!BeginSection(sect, shstrtab))
+        return;
+
+    OutputBytecodes(sect);
+    if (getDiagnostics().hasErrorOccurred())
+        return;
+
+    EndSection(sect, shstrtab);
+}
+
+namespace {
+/// A section being serialized into memory on a worker thread.  Everything
+/// a job touches (diagnostics, scratch, relocations) belongs to its section.
+class ElfSectionOutput
+{
+public:
+    ElfSectionOutput(Section& sect,
+                     ElfObject& objfmt,
+                     Object& object,
+                     DiagnosticsEngine& diags,
+                     unsigned int compress);
+    ~ElfSectionOutput();
+
+    void Output();
+
+    Section& m_sect;
+    unsigned int m_compress;
+    DiagnosticBuffer m_diags;
+    std::vector<char> m_data;
+    OutputFileStream m_os;
+    ElfOutput m_out;
+};
+} // anonymous namespace
+
+ElfSectionOutput::ElfSectionOutput(Section& sect,
+                                   ElfObject& objfmt,
+                                   Object& object,
+                                   DiagnosticsEngine& diags,
+                                   unsigned int compress)
+    : m_sect(sect)
+    , m_compress(compress)
+    , m_diags(diags)
+    , m_os(m_data)
+    , m_out(m_os, objfmt, object, m_diags.getDiagnostics())
+{
+}
+
+ElfSectionOutput::~ElfSectionOutput()
+{
+}
+
+void
+ElfSectionOutput::Output()
+{
+    TraceRegion t("Output Section", m_sect.getName());
+    m_out.OutputBytecodes(m_sect);
+    m_os.close();
+    if (m_compress == 0 || m_diags.getDiagnostics().hasErrorOccurred())
+        return;
+
+    // The compression header records the original alignment, so settle it
+    // the same way BeginSection() would.
+    ElfSection* elfsect = m_sect.getAssocData<ElfSection>();
+    if (elfsect->getAlign() == 0)
+        elfsect->setAlign(m_sect.getAlign());
+    Bytes scratch;
+    elfsect->Compress(m_data, static_cast<ElfCompressionType>(m_compress),
+                      scratch);
+}
+
+/// Determine whether a section's contents should be compressed: only
+/// non-allocated debug sections are, as the loader never sees them.
+static unsigned int
+ElfSectionCompression(const Section& sect, unsigned int compress)
+{
+    if (compress == 0 || sect.isBSS() || !sect.getName().startswith(".debug"))
+        return 0;
+    const ElfSection* elfsect = sect.getAssocData<ElfSection>();
+    if (elfsect->getFlags() & SHF_ALLOC)
+        return 0;
+    return compress;
+}
+
+static void
+ElfSectionOutputJob(stdx::ptr_vector<ElfSectionOutput>& jobs, size_t i)
+{
+    jobs[i].Output();
+}
+
+void
+ElfOutput::OutputSections(StringTable& shstrtab,
+                          unsigned int num_jobs,
+                          unsigned int compress)
+{
+    if (compress == 0 && (num_jobs == 1 || m_object.getNumSections() <= 1))
+    {
+        for (Object::section_iterator i=m_object.sections_begin(),
+             end=m_object.sections_end(); i != end; ++i)
+        {
+            OutputSection(*i, shstrtab);
+        }
+        return;
+    }
+
+    // Serialize each section into its own buffer.  The diagnostic engines
+    // must be created here as DiagnosticIDs is not reference counted in a
+    // thread-safe manner.
+    stdx::ptr_vector<ElfSectionOutput> jobs;
+    stdx::ptr_vector_owner<ElfSectionOutput> jobs_owner(jobs);
+    for (Object::section_iterator i=m_object.sections_begin(),
+         end=m_object.sections_end(); i != end; ++i)
+    {
+        jobs.push_back(new ElfSectionOutput(*i, m_objfmt, m_object,
+                                            getDiagnostics(),
+                                            ElfSectionCompression(*i,
+                                                                  compress)));
+    }
+
+    ThreadPool pool(num_jobs);
+    pool.Run(jobs.size(), TR1::bind(&ElfSectionOutputJob, TR1::ref(jobs), _1));
+
+    // Write the buffers out in section order, replaying diagnostics in the
+    // same order.  Once an error has occurred nothing more is written, but
+    // the remaining sections' diagnostics are still reported.
+    DiagnosticsEngine& diags = getDiagnostics();
+    for (stdx::ptr_vector<ElfSectionOutput>::iterator i=jobs.begin(),
+         end=jobs.end(); i != end; ++i)
+    {
+        i->m_diags.Replay(diags);
+        if (i->m_out.NeedsGOT())
+            m_needs_GOT = true;
+        if (diags.hasErrorOccurred())
+            continue;
+
+        if (!BeginSection(i->m_sect, shstrtab))
+            return;
+        if (!i->m_data.empty())
+            m_os.write(&i->m_data[0], i->m_data.size());
+        EndSection(i->m_sect, shstrtab);
+    }
+}
+
+// Encode relocations in the SHT_RELR format: an even entry is the offset
+// of a field to relocate, and an odd entry is a bitmap of which of the 63
+// words following the last field covered are also relocated.  Offsets must
+// be sorted.
+static void
+EncodeRelativeRelocs(ElfSection::RelativeRelocs::const_iterator begin,
+                     ElfSection::RelativeRelocs::const_iterator end,
+                     Bytes& bytes)
+{
+    const uint64_t wordsize = 8;
+    const uint64_t nbits = 63;
+    ElfSection::RelativeRelocs::const_iterator i = begin;
+    while (i != end)
+    {
+        uint64_t base = i->second;
+        Write64(bytes, base);
+        base += wordsize;
+        ++i;
+
+        for (;;)
+        {
+            uint64_t bitmap = 0;
+            for (; i != end; ++i)
+            {
+                uint64_t delta = i->second - base;
+                if (delta >= nbits*wordsize || delta % wordsize != 0)
+                    break;
+                bitmap |= static_cast<uint64_t>(1) << (delta / wordsize);
+            }
+            if (bitmap == 0)
+                break;
+            Write64(bytes, (bitmap << 1) | 1);
+            base += nbits*wordsize;
+        }
+    }
+}
+
+static ElfOffset
+ElfAlignOutput(raw_ostream& os,
                unsigned int align,
                DiagnosticsEngine& diags)
 {
@@ -1051,18 +1842,153 @@ ElfAlignOutput(raw_fd_ostream& os,
     if (delta != align)
     {
         pos += delta;
-        os.seek(pos);
-        if (os.has_error())
+        if (!ElfPadOutput(os, pos) || os.has_error())
         {
             diags.Report(SourceLocation(), diag::err_file_output_seek);
             return 0;
         }
     }
-    return static_cast<unsigned long>(pos);
+    return pos;
+}
+
+// Remove duplicate entries from a SHF_MERGE section at assembly time, as the
+// linker would.  Only sections made entirely of constant data are handled.
+// Labels into removed entries are moved to the kept copy; relocations
+// against labels in merge sections are always symbol-relative (see
+// ElfOutput::ConvertValueToBytes), so they follow the labels.  Differences
+// between labels are not relocated, so sections with labels used in one
+// are left alone.
+static void
+MergeSection(Object& object, Section& sect, DiagnosticsEngine& diags)
+{
+    ElfSection* elfsect = sect.getAssocData<ElfSection>();
+    bool strings = (elfsect->getFlags() & SHF_STRINGS) != 0;
+    unsigned long entsize = elfsect->getEntSize();
+    if (entsize == 0)
+    {
+        if (!strings)
+            return;
+        entsize = 1;
+    }
+
+    // Flatten the section contents.
+    std::string data;
+    for (Section::bc_iterator bc=sect.bytecodes_begin(),
+         end=sect.bytecodes_end(); bc != end; ++bc)
+    {
+        if (bc->hasContents() || !bc->getFixups().empty())
+            return;
+        const Bytes& fixed = bc->getFixed();
+        data.append(fixed.begin(), fixed.end());
+    }
+    unsigned long size = static_cast<unsigned long>(data.size());
+    if (size % entsize != 0)
+        return;
+
+    // Split into entries; starts has a trailing entry for the section end.
+    std::vector<unsigned long> starts;
+    if (strings)
+    {
+        unsigned long start = 0;
+        for (unsigned long i=0; i<size; i += entsize)
+        {
+            unsigned long j = 0;
+            while (j < entsize && data[i+j] == '\0')
+                ++j;
+            if (j != entsize)
+                continue;
+            starts.push_back(start);
+            start = i + entsize;
+        }
+        if (start != size)
+            return;     // unterminated string
+    }
+    else
+    {
+        for (unsigned long i=0; i<size; i += entsize)
+            starts.push_back(i);
+    }
+    starts.push_back(size);
+
+    // Find the new position of each entry (that of its first copy).
+    std::size_t nentries = starts.size()-1;
+    std::vector<unsigned long> newpos(nentries);
+    std::vector<bool> keep(nentries);
+    llvm::StringMap<unsigned long> seen;
+    unsigned long newsize = 0;
+    for (std::size_t i=0; i<nentries; ++i)
+    {
+        StringRef entry(data.data()+starts[i], starts[i+1]-starts[i]);
+        llvm::StringMapEntry<unsigned long>& first =
+            seen.GetOrCreateValue(entry, newsize);
+        keep[i] = (first.getValue() == newsize);
+        newpos[i] = first.getValue();
+        if (keep[i])
+            newsize += starts[i+1]-starts[i];
+    }
+    if (newsize == size)
+        return;
+
+    // Find the labels in the section (at their old offsets).
+    std::vector<std::pair<Symbol*, unsigned long> > labels;
+    for (Object::symbol_iterator sym=object.symbols_begin(),
+         end=object.symbols_end(); sym != end; ++sym)
+    {
+        Location loc;
+        if (sym->getLabel(&loc) && loc.bc->getContainer() == &sect)
+        {
+            if (sym->isDifferenced())
+                return;
+            labels.push_back(std::make_pair(&*sym, loc.getOffset()));
+        }
+    }
+
+    // Rebuild the bytecodes, each keeping the entries that start in it.
+    std::size_t i = 0;
+    for (Section::bc_iterator bc=sect.bytecodes_begin(),
+         end=sect.bytecodes_end(); bc != end; ++bc)
+    {
+        unsigned long bcend = bc->getNextOffset();
+        Bytes& fixed = bc->getFixed();
+        fixed.clear();
+        for (; i<nentries && starts[i] < bcend; ++i)
+        {
+            if (keep[i])
+                fixed.insert(fixed.end(), data.begin()+starts[i],
+                             data.begin()+starts[i+1]);
+        }
+    }
+    sect.UpdateOffsets(diags);
+
+    // Move the labels.
+    std::vector<unsigned long> bcends;
+    for (Section::bc_iterator bc=sect.bytecodes_begin(),
+         end=sect.bytecodes_end(); bc != end; ++bc)
+        bcends.push_back(bc->getNextOffset());
+
+    for (std::vector<std::pair<Symbol*, unsigned long> >::iterator
+         label=labels.begin(), end=labels.end(); label != end; ++label)
+    {
+        unsigned long off = label->second;
+        std::size_t n = std::upper_bound(starts.begin(), starts.end()-1, off)
+            - starts.begin();
+        if (off == size)
+            off = newsize;
+        else
+            off = newpos[n-1] + (off - starts[n-1]);
+
+        std::size_t b = std::upper_bound(bcends.begin(), bcends.end(), off)
+            - bcends.begin();
+        if (b == bcends.size())
+            --b;
+        Bytecode& bc = *(sect.bytecodes_begin() + b);
+        Location loc = {&bc, off - bc.getOffset()};
+        label->first->MoveLabel(loc);
+    }
 }
 
 void
-ElfObject::Output(raw_fd_ostream& os,
+ElfObject::Output(OutputFileStream& os,
                   bool all_syms,
                   DebugFormat& dbgfmt,
                   DiagnosticsEngine& diags)
@@ -1080,9 +2006,23 @@ ElfObject::Output(raw_fd_ostream& os,
         m_file_elfsym->setName(strtab.getIndex(m_object.getSourceFilename()));
     }
 
+    Object::Config& oconfig = m_object.getConfig();
+
+    // Deduplicate mergeable sections.  Skipped when listing, as the listing
+    // shows the bytecodes as assembled.
+    if (oconfig.MergeSections && !m_object.getListFormat() && !m_merged)
+    {
+        for (Object::section_iterator sect=m_object.sections_begin(),
+             end=m_object.sections_end(); sect != end; ++sect)
+        {
+            ElfSection* elfsect = sect->getAssocData<ElfSection>();
+            if (elfsect && (elfsect->getFlags() & SHF_MERGE) != 0)
+                MergeSection(m_object, *sect, diags);
+        }
+    }
+
     // Create .note.GNU-stack if we need to advise linker about executable
     // stack.
-    Object::Config& oconfig = m_object.getConfig();
     if (oconfig.ExecStack || oconfig.NoExecStack)
     {
         Section* gnu_stack = m_object.FindSection(".note.GNU-stack");
@@ -1104,9 +2044,30 @@ ElfObject::Output(raw_fd_ostream& os,
         }
     }
 
-    // Allocate space for Ehdr by seeking forward
-    os.seek(m_config.getProgramHeaderSize());
-    if (os.has_error())
+    // Select debug section compression.
+    unsigned int compress = 0;
+    switch (oconfig.CompressDebugSections)
+    {
+        case Object::COMPRESS_ZLIB:
+#ifdef HAVE_ZLIB
+            compress = ELFCOMPRESS_ZLIB;
+#else
+            diags.Report(SourceLocation(), diag::err_compression_unsupported)
+                << "zlib";
+#endif
+            break;
+        case Object::COMPRESS_ZSTD:
+#ifdef HAVE_ZSTD
+            compress = ELFCOMPRESS_ZSTD;
+#else
+            diags.Report(SourceLocation(), diag::err_compression_unsupported)
+                << "zstd";
+#endif
+            break;
+    }
+
+    // Allocate space for Ehdr; it is filled in once everything else is out
+    if (!ElfPadOutput(os, m_config.getProgramHeaderSize()) || os.has_error())
     {
         diags.Report(SourceLocation(), diag::err_file_output_seek);
         return;
@@ -1201,7 +2162,7 @@ ElfObject::Output(raw_fd_ostream& os,
             group.elfsect->setName(shstrtab.getIndex(i->name));
             elfsym = &BuildSymbol(*i->sym);
             elfsym->setType(STT_SECTION);
-            elfsym->setSectionIndex(m_config.secthead_count);
+            elfsym->setSectionHeaderIndex(m_config.secthead_count);
         }
 
         group.elfsect->setIndex(m_config.secthead_count++);
@@ -1227,6 +2188,11 @@ ElfObject::Output(raw_fd_ostream& os,
         elfsect->setIndex(m_config.secthead_count++);
     }
 
+    // Symbols can only refer to group and user sections (numbered above);
+    // if their indices don't all fit in st_shndx, an extended section
+    // index table (.symtab_shndx) is needed.
+    bool need_shndx = (m_config.secthead_count > SHN_LORESERVE);
+
     // Output group sections.
     for (Groups::iterator i=m_groups.begin(), end=m_groups.end(); i != end; ++i)
     {
@@ -1234,12 +2200,8 @@ ElfObject::Output(raw_fd_ostream& os,
     }
 
     // Output user sections.
-    // Assign indices and names as we go (including relocation section names).
-    for (Object::section_iterator i=m_object.sections_begin(),
-         end=m_object.sections_end(); i != end; ++i)
-    {
-        out.OutputSection(*i, shstrtab);
-    }
+    // Assign names as we go (including relocation section names).
+    out.OutputSections(shstrtab, oconfig.NumJobs, compress);
 
     // Go through relocations and force referenced symbols into symbol table,
     // because relocation needs a symtab index.
@@ -1270,9 +2232,22 @@ ElfObject::Output(raw_fd_ostream& os,
         FinalizeSymbol(*GOT_sym, strtab, false, diags);
     }
 
-    // Partition symbol table to put local symbols first
-    stdx::stable_partition(m_object.symbols_begin(), m_object.symbols_end(),
-                           isLocal);
+    // Gather the in-table symbols into a flat array, local symbols first
+    // (in object order within each group).
+    ElfOutputSymtab symtab, nonlocal;
+    for (Object::symbol_iterator i=m_object.symbols_begin(),
+         end=m_object.symbols_end(); i != end; ++i)
+    {
+        ElfSymbol* elfsym = i->getAssocData<ElfSymbol>();
+        if (!elfsym || !elfsym->isInTable())
+            continue;
+        if (isLocal(*i))
+            symtab.push_back(elfsym);
+        else
+            nonlocal.push_back(elfsym);
+    }
+    symtab.insert(symtab.end(), nonlocal.begin(), nonlocal.end());
+    ElfOutputSymtab().swap(nonlocal);
 
     // Number symbols.  Start at 2 due to undefined symbol (0)
     // and file symbol (1).
@@ -1288,16 +2263,17 @@ ElfObject::Output(raw_fd_ostream& os,
         elfsectsym->setSymbolIndex(symtab_nlocal++);
     }
 
-    // The remainder of the symbols.
-    m_config.AssignSymbolIndices(m_object, &symtab_nlocal);
+    // The remainder of the symbols; this also puts symtab in index order.
+    m_config.AssignSymbolIndices(symtab, &symtab_nlocal);
 
-    // Sort the symbols by symbol index.
-    stdx::sort(m_object.symbols_begin(), m_object.symbols_end(), byIndex);
-
-    unsigned long offset, size;
+    ElfOffset offset;
+    unsigned long size;
     ElfStringIndex shstrtab_name = shstrtab.getIndex(".shstrtab");
     ElfStringIndex strtab_name = shstrtab.getIndex(".strtab");
     ElfStringIndex symtab_name = shstrtab.getIndex(".symtab");
+    ElfStringIndex symtab_shndx_name = 0;
+    if (need_shndx)
+        symtab_shndx_name = shstrtab.getIndex(".symtab_shndx");
 
     // section header string table (.shstrtab)
     offset = ElfAlignOutput(os, align, diags);
@@ -1324,7 +2300,9 @@ ElfObject::Output(raw_fd_ostream& os,
 
     // symbol table (.symtab)
     offset = ElfAlignOutput(os, align, diags);
-    size = m_config.WriteSymbolTable(os, m_object, diags, out.getScratch());
+    Bytes shndx;
+    size = m_config.WriteSymbolTable(os, symtab, diags, out.getScratch(),
+                                     need_shndx ? &shndx : 0);
 
     ElfSection symtab_sect(m_config, SHT_SYMTAB, 0, true);
     symtab_sect.setName(symtab_name);
@@ -1334,6 +2312,22 @@ ElfObject::Output(raw_fd_ostream& os,
     symtab_sect.setInfo(symtab_nlocal);
     symtab_sect.setLink(strtab_sect.getIndex());    // link to .strtab
 
+    // extended section index table (.symtab_shndx)
+    ElfSection symtab_shndx_sect(m_config, SHT_SYMTAB_SHNDX, 0);
+    if (need_shndx)
+    {
+        offset = ElfAlignOutput(os, 4, diags);
+        os << shndx;
+
+        symtab_shndx_sect.setName(symtab_shndx_name);
+        symtab_shndx_sect.setIndex(m_config.secthead_count++);
+        symtab_shndx_sect.setFileOffset(offset);
+        symtab_shndx_sect.setSize(shndx.size());
+        symtab_shndx_sect.setLink(symtab_sect.getIndex());
+        symtab_shndx_sect.setEntSize(4);
+        symtab_shndx_sect.setAlign(4);
+    }
+
     // output relocations
     for (Object::section_iterator i=m_object.sections_begin(),
          end=m_object.sections_end(); i != end; ++i)
@@ -1350,6 +2344,52 @@ ElfObject::Output(raw_fd_ostream& os,
         elfsect->WriteRelocs(os, *i, out.getScratch(), *m_machine, diags);
     }
 
+    // output relative relocations, in one section for each pair of
+    // relocated and target sections.  Like the section headers of
+    // relocation sections, sh_info is the index of the relocated section;
+    // sh_link is the index of the section the addresses are relative to.
+    stdx::ptr_vector<ElfSection> relr_sects;
+    stdx::ptr_vector_owner<ElfSection> relr_sects_owner(relr_sects);
+    for (Object::section_iterator i=m_object.sections_begin(),
+         end=m_object.sections_end(); i != end; ++i)
+    {
+        ElfSection* elfsect = i->getAssocData<ElfSection>();
+        ElfSection::RelativeRelocs& relocs = elfsect->getRelativeRelocs();
+        if (relocs.empty())
+            continue;
+
+        TraceRegion t("Output Relative Relocations", i->getName());
+        std::sort(relocs.begin(), relocs.end());
+        for (ElfSection::RelativeRelocs::const_iterator j=relocs.begin(),
+             endj=relocs.end(); j != endj; )
+        {
+            ElfSectionIndex target = j->first;
+            ElfSection::RelativeRelocs::const_iterator k = j;
+            while (k != endj && k->first == target)
+                ++k;
+
+            Bytes& scratch = out.getScratch();
+            scratch.resize(0);
+            m_config.setEndian(scratch);
+            EncodeRelativeRelocs(j, k, scratch);
+            j = k;
+
+            offset = ElfAlignOutput(os, 8, diags);
+            os << scratch;
+
+            ElfSection* relr = new ElfSection(m_config, SHT_RELR, 0);
+            relr_sects.push_back(relr);
+            relr->setName(elfsect->getRelrName());
+            relr->setIndex(m_config.secthead_count++);
+            relr->setFileOffset(offset);
+            relr->setSize(scratch.size());
+            relr->setLink(target);
+            relr->setInfo(elfsect->getIndex());
+            relr->setEntSize(8);
+            relr->setAlign(8);
+        }
+    }
+
     // output section header table
     m_config.secthead_pos = ElfAlignOutput(os, 16, diags);
 
@@ -1369,7 +2409,12 @@ ElfObject::Output(raw_fd_ostream& os,
     }
 #endif
 
-    // null section header
+    // null section header; holds the section count and string table index
+    // if they don't fit in the ELF header
+    if (m_config.secthead_count >= SHN_LORESERVE)
+        null_sect.setSize(m_config.secthead_count);
+    if (m_config.shstrtab_index >= SHN_LORESERVE)
+        null_sect.setLink(m_config.shstrtab_index);
     null_sect.Write(os, out.getScratch());
 
     // group section headers
@@ -1398,6 +2443,8 @@ ElfObject::Output(raw_fd_ostream& os,
     shstrtab_sect.Write(os, out.getScratch());
     strtab_sect.Write(os, out.getScratch());
     symtab_sect.Write(os, out.getScratch());
+    if (need_shndx)
+        symtab_shndx_sect.Write(os, out.getScratch());
 
     // relocation section headers
     for (Object::section_iterator i=m_object.sections_begin(),
@@ -1410,6 +2457,11 @@ ElfObject::Output(raw_fd_ostream& os,
         elfsect->WriteRel(os, symtab_sect.getIndex(), *i, out.getScratch());
     }
 
+    // relative relocation section headers
+    for (stdx::ptr_vector<ElfSection>::const_iterator i=relr_sects.begin(),
+         end=relr_sects.end(); i != end; ++i)
+        i->Write(os, out.getScratch());
+
     // output Ehdr
     os.seek(0);
     if (os.has_error())
@@ -1472,12 +2524,23 @@ ElfObject::AppendSection(StringRef name,
         type = SHT_PROGBITS;
         flags = 0;
     }
+    else if (name == ".debug_line_str")
+    {
+        align = 0;
+        type = SHT_PROGBITS;
+        flags = SHF_MERGE + SHF_STRINGS;
+    }
     else if (name.startswith(".debug_"))
     {
         align = 0;
         type = SHT_PROGBITS;
         flags = 0;
     }
+    else if (name.startswith(".note."))
+    {
+        type = SHT_NOTE;
+        flags = 0;
+    }
     else
     {
         // Default to code, but align=1
@@ -1503,11 +2566,96 @@ ElfObject::AppendSection(StringRef name,
 
     // Add ELF data to the section
     ElfSection* elfsect = new ElfSection(m_config, type, flags);
+    if ((flags & SHF_STRINGS) != 0)
+        elfsect->setEntSize(1);
     section->AddAssocData(std::auto_ptr<ElfSection>(elfsect));
 
     return section;
 }
 
+bool
+ElfObject::LoadOrderingFile(DiagnosticsEngine& diags)
+{
+    m_ordering_loaded = true;
+    const std::string& filename = m_object.getConfig().SymbolOrderingFile;
+
+    OwningPtr<MemoryBuffer> buf;
+    if (llvm::error_code err = MemoryBuffer::getFile(filename, buf))
+    {
+        diags.Report(SourceLocation(), diag::err_cannot_open_file)
+            << filename << err.message();
+        return false;
+    }
+
+    // One function per line; "!name" marks a cold function.
+    StringRef rest = buf->getBuffer();
+    while (!rest.empty())
+    {
+        std::pair<StringRef, StringRef> split = rest.split('\n');
+        rest = split.second;
+        StringRef line = split.first.trim();
+        if (line.empty() || line[0] == '#')
+            continue;
+        bool cold = (line[0] == '!');
+        if (cold)
+            line = line.substr(1).ltrim();
+        m_ordered_funcs.GetOrCreateValue(line, cold);
+    }
+    return true;
+}
+
+// Places functions from the symbol ordering file in their own .text.hot.*
+// or .text.unlikely.* section, so the linker can group them even if the
+// source has them all in .text.  Each runs until the next non-local label;
+// code following an unlisted label goes back to .text.
+void
+ElfObject::StartLabel(SymbolRef sym,
+                      SourceLocation source,
+                      DiagnosticsEngine& diags)
+{
+    if (m_object.getConfig().SymbolOrderingFile.empty())
+        return;
+    if (!m_ordering_loaded && !LoadOrderingFile(diags))
+        return;
+
+    StringRef name = sym->getName();
+    if (name.startswith(".L"))
+        return;     // assembler-local label
+
+    Section* cur = m_object.getCurSection();
+    if (!cur)
+        return;
+    Section* home = cur;
+    std::map<Section*, Section*>::iterator split = m_split_from.find(cur);
+    if (split != m_split_from.end())
+        home = split->second;
+    else if (cur->getName() != ".text")
+        return;
+
+    llvm::StringMap<bool>::iterator func = m_ordered_funcs.find(name);
+    if (func == m_ordered_funcs.end())
+    {
+        m_object.setCurSection(home);
+        return;
+    }
+
+    SmallString<64> sectname;
+    sectname += func->getValue() ? ".text.unlikely." : ".text.hot.";
+    sectname += name;
+    Section* sect = m_object.FindSection(sectname);
+    if (!sect)
+    {
+        sect = AppendSection(sectname, source, diags);
+        ElfSection* homeelf = home->getAssocData<ElfSection>();
+        sect->getAssocData<ElfSection>()->setTypeFlags(homeelf->getType(),
+                                                       homeelf->getFlags());
+        sect->setCode(true);
+        sect->setAlign(home->getAlign());
+        m_split_from[sect] = home;
+    }
+    m_object.setCurSection(sect);
+}
+
 void
 ElfObject::DirGasSection(DirectiveInfo& info, DiagnosticsEngine& diags)
 {
@@ -2066,7 +3214,9 @@ ElfObject::getDebugFormatKeywords()
         "dwarf",
         "dwarfpass",
         "dwarf2",
-        "dwarf2pass"
+        "dwarf2pass",
+        "dwarf5",
+        "dwarf5pass"
     };
     size_t keywords_size = sizeof(keywords)/sizeof(keywords[0]);
     return std::vector<StringRef>(keywords, keywords+keywords_size);
@@ -2127,15 +3277,15 @@ static const yasm_stdmac elf_objfmt_stdmacs[] = {
     { NULL, NULL, NULL }
 };
 #endif
-void
-yasm_objfmt_elf_DoRegister()
+extern const yasm::impl::ModuleEntry yasm_objfmt_elf_modules[] =
 {
-    RegisterModule<ObjectFormatModule,
-                   ObjectFormatModuleImpl<ElfObject> >("elf");
-    RegisterModule<ObjectFormatModule,
-                   ObjectFormatModuleImpl<Elf32Object> >("elf32");
-    RegisterModule<ObjectFormatModule,
-                   ObjectFormatModuleImpl<Elf64Object> >("elf64");
-    RegisterModule<ObjectFormatModule,
-                   ObjectFormatModuleImpl<Elfx32Object> >("elfx32");
-}
+    YASM_MODULE_ENTRY(ObjectFormatModule,
+                      ObjectFormatModuleImpl<ElfObject>, "elf"),
+    YASM_MODULE_ENTRY(ObjectFormatModule,
+                      ObjectFormatModuleImpl<Elf32Object>, "elf32"),
+    YASM_MODULE_ENTRY(ObjectFormatModule,
+                      ObjectFormatModuleImpl<Elf64Object>, "elf64"),
+    YASM_MODULE_ENTRY(ObjectFormatModule,
+                      ObjectFormatModuleImpl<Elfx32Object>, "elfx32"),
+    YASM_MODULE_TABLE_END
+};
@@ -42,6 +42,8 @@
 //
 // Each Section is spatially disjoint, and has exactly one SHT entry.
 //
+#include <map>
+
 #include "llvm/ADT/StringMap.h"
 #include "yasmx/Support/ptr_vector.h"
 #include "yasmx/Support/scoped_ptr.h"
@@ -124,7 +126,9 @@ public:
     void InitSymbols(StringRef parser);
 
     bool Read(SourceManager& sm, DiagnosticsEngine& diags);
-    void Output(raw_fd_ostream& os,
+    bool Merge(const MemoryBuffer& in, DiagnosticsEngine& diags);
+    bool AppendPiece(ObjectFormat& piece);
+    void Output(OutputFileStream& os,
                 bool all_syms,
                 DebugFormat& dbgfmt,
                 DiagnosticsEngine& diags);
@@ -160,11 +164,17 @@ public:
     void DirIdent(DirectiveInfo& info, DiagnosticsEngine& diags);
     void DirVersion(DirectiveInfo& info, DiagnosticsEngine& diags);
 
+    void StartLabel(SymbolRef sym,
+                    SourceLocation source,
+                    DiagnosticsEngine& diags);
+    bool LoadOrderingFile(DiagnosticsEngine& diags);
+
     ElfConfig m_config;                     // ELF configuration
     util::scoped_ptr<ElfMachine> m_machine; // ELF machine interface
 
     ElfSymbol* m_file_elfsym;               // .file symbol
     SymbolRef m_dotdotsym;                  // ..sym symbol
+    bool m_merged;                          // contents merged from objects
 
     typedef stdx::ptr_vector<ElfSymVersion> SymVers;
     SymVers m_symvers;                      // symbol version aliases
@@ -175,6 +185,12 @@ public:
     stdx::ptr_vector_owner<ElfGroup> m_groups_owner;
 
     llvm::StringMap<ElfGroup*> m_group_map; // section groups by name
+
+    // Functions from the symbol ordering file; true if cold.
+    llvm::StringMap<bool> m_ordered_funcs;
+    bool m_ordering_loaded;
+    // .text.hot.* and .text.unlikely.* sections split from another section.
+    std::map<Section*, Section*> m_split_from;
 };
 
 class YASM_STD_EXPORT Elf32Object : public ElfObject
@@ -104,8 +104,15 @@ ElfReloc::setWrt(SymbolRef wrt, size_t valsize)
     assert(wrt != 0 && "wrt is null");
 
     const ElfSpecialSymbol* ssym = wrt->getAssocData<ElfSpecialSymbol>();
-    if (!ssym || valsize != ssym->size)
+    if (!ssym)
         return false;
+    unsigned int type = ssym->reloc;
+    if (valsize != ssym->size)
+    {
+        if (valsize != 64 || ssym->reloc64 == 0)
+            return false;
+        type = ssym->reloc64;
+    }
 
     // Force TLS type; this is required by the linker.
     if (ssym->thread_local)
@@ -114,10 +121,21 @@ ElfReloc::setWrt(SymbolRef wrt, size_t valsize)
             esym->setType(STT_TLS);
     }
     m_wrt = wrt;
-    m_type = ssym->reloc;
+    m_type = type;
     return true;
 }
 
+void
+ElfReloc::setInsn(llvm::ArrayRef<unsigned char> insn)
+{
+}
+
+bool
+ElfReloc::isAbsoluteAddress() const
+{
+    return false;
+}
+
 Expr
 ElfReloc::getValue() const
 {
@@ -152,7 +170,6 @@ ElfReloc::Write(Bytes& bytes, const ElfConfig& config)
     if (ElfSymbol* esym = getSymbol()->getAssocData<ElfSymbol>())
         r_sym = esym->getSymbolIndex();
 
-    bytes.resize(0);
     config.setEndian(bytes);
 
     if (config.cls == ELFCLASS32)
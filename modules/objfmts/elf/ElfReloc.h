@@ -26,6 +26,7 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 //
+#include "llvm/ADT/ArrayRef.h"
 #include "yasmx/Config/export.h"
 #include "yasmx/IntNum.h"
 #include "yasmx/Reloc.h"
@@ -71,16 +72,43 @@ public:
     /// @return False if invalid wrt.
     bool setWrt(SymbolRef wrt, size_t valsize);
 
+    /// Refine the relocation type using the instruction containing the
+    /// relocated value, e.g. to use a type the linker may relax.  Only
+    /// called for values within an instruction, after setRel() or setWrt().
+    /// The default implementation does nothing.
+    /// @param insn     instruction bytes preceding the value
+    virtual void setInsn(llvm::ArrayRef<unsigned char> insn);
+
     bool isValid() const { return m_type != 0xff; }
 
+    /// Determine if the relocation just adds the symbol's address to an
+    /// address-sized field (e.g. R_X86_64_64), so that against a section
+    /// it can be packed into a relative relocation (SHT_RELR) section.
+    /// The default implementation returns false.
+    virtual bool isAbsoluteAddress() const;
+
     Expr getValue() const;
     virtual std::string getTypeName() const = 0;
 
     virtual void HandleAddend(IntNum* intn,
                               const ElfConfig& config,
                               unsigned int insn_start);
+
+    /// Append the relocation entry to bytes.
+    /// @param bytes        output bytes
+    /// @param config       ELF configuration
     void Write(Bytes& bytes, const ElfConfig& config);
 
+    /// Adjust a relocation read from an object being merged into another.
+    /// @param offset       offset of the section contents in the merged
+    ///                     section
+    /// @param addend       amount to add to the addend
+    void Rebase(const IntNum& offset, const IntNum& addend)
+    {
+        m_addr += offset;
+        m_addend += addend;
+    }
+
 protected:
     SymbolRef           m_wrt;
     ElfRelocationType   m_type;
@@ -26,8 +26,18 @@
 //
 #include "ElfSection.h"
 
+#include "config.h"
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
 #include "llvm/Support/raw_ostream.h"
 #include "yasmx/Basic/Diagnostic.h"
+#include "yasmx/Support/Trace.h"
 #include "yasmx/Bytecode.h"
 #include "yasmx/Bytes.h"
 #include "yasmx/Bytes_util.h"
@@ -54,6 +64,7 @@ ElfSection::ElfSection(const ElfConfig&     config,
     , m_rel_name_index(0)
     , m_rel_index(0)
     , m_rel_offset(0)
+    , m_relr_name_index(0)
 {
     InputBuffer inbuf(in);
 
@@ -81,7 +92,7 @@ ElfSection::ElfSection(const ElfConfig&     config,
         m_flags = static_cast<ElfSectionFlags>(ReadU32(inbuf));
         m_addr = ReadU32(inbuf);
 
-        m_offset = static_cast<ElfAddress>(ReadU32(inbuf));
+        m_offset = static_cast<ElfOffset>(ReadU32(inbuf));
         m_size = ReadU32(inbuf);
         m_link = static_cast<ElfSectionIndex>(ReadU32(inbuf));
         m_info = static_cast<ElfSectionInfo>(ReadU32(inbuf));
@@ -100,7 +111,7 @@ ElfSection::ElfSection(const ElfConfig&     config,
         m_flags = static_cast<ElfSectionFlags>(ReadU64(inbuf).getUInt());
         m_addr = ReadU64(inbuf);
 
-        m_offset = static_cast<ElfAddress>(ReadU64(inbuf).getUInt());
+        m_offset = static_cast<ElfOffset>(ReadU64(inbuf).getUInt64());
         m_size = ReadU64(inbuf);
         m_link = static_cast<ElfSectionIndex>(ReadU32(inbuf));
         m_info = static_cast<ElfSectionInfo>(ReadU32(inbuf));
@@ -129,6 +140,7 @@ ElfSection::ElfSection(const ElfConfig&     config,
     , m_rel_name_index(0)
     , m_rel_index(0)
     , m_rel_offset(0)
+    , m_relr_name_index(0)
 {
     if (symtab)
     {
@@ -241,13 +253,95 @@ ElfSection::Write(raw_ostream& os, Bytes& scratch) const
     return scratch.size();
 }
 
+bool
+ElfSection::Compress(std::vector<char>& data,
+                     ElfCompressionType type,
+                     Bytes& scratch)
+{
+    scratch.resize(0);
+    m_config.setEndian(scratch);
+
+    unsigned long addralign = m_align == 0 ? 1 : m_align;
+    if (m_config.cls == ELFCLASS32)
+    {
+        Write32(scratch, type);
+        Write32(scratch, data.size());
+        Write32(scratch, addralign);
+        assert(scratch.size() == CHDR32_SIZE);
+    }
+    else if (m_config.cls == ELFCLASS64)
+    {
+        Write32(scratch, type);
+        Write32(scratch, 0);        // ch_reserved
+        Write64(scratch, data.size());
+        Write64(scratch, addralign);
+        assert(scratch.size() == CHDR64_SIZE);
+    }
+    size_t hdrsize = scratch.size();
+
+    // Compress directly after the header; give up if the result would not
+    // be smaller than the original.
+    size_t avail = data.size() > hdrsize ? data.size() - hdrsize : 0;
+    if (avail == 0)
+        return false;
+    scratch.resize(data.size());
+    unsigned char* dest = &scratch[hdrsize];
+    size_t destlen = 0;
+    switch (type)
+    {
+#ifdef HAVE_ZLIB
+        case ELFCOMPRESS_ZLIB:
+        {
+            uLongf len = avail;
+            if (compress2(dest, &len,
+                          reinterpret_cast<const Bytef*>(&data[0]),
+                          data.size(), Z_BEST_COMPRESSION) != Z_OK)
+                return false;
+            destlen = len;
+            break;
+        }
+#endif
+#ifdef HAVE_ZSTD
+        case ELFCOMPRESS_ZSTD:
+        {
+            size_t len = ZSTD_compress(dest, avail, &data[0], data.size(),
+                                       ZSTD_CLEVEL_DEFAULT);
+            if (ZSTD_isError(len))
+                return false;
+            destlen = len;
+            break;
+        }
+#endif
+        default:
+            return false;
+    }
+    if (hdrsize + destlen >= data.size())
+        return false;
+
+    const char* compressed = reinterpret_cast<const char*>(&scratch[0]);
+    data.assign(compressed, compressed + hdrsize + destlen);
+    m_flags |= SHF_COMPRESSED;
+    m_align = (m_config.cls == ELFCLASS32) ? 4 : 8;
+    m_size = data.size();
+    return true;
+}
+
 static void
 NoAddSpan(Bytecode& bc,
           int id,
           const Value& value,
-          long neg_thres,
-          long pos_thres)
+          int64_t neg_thres,
+          int64_t pos_thres)
+{
+}
+
+void
+yasm::objfmt::AppendSizedGap(Section& sect, unsigned long size)
 {
+    Bytecode& gap = sect.AppendGap(size, SourceLocation());
+    IntrusiveRefCntPtr<DiagnosticIDs> diagids(new DiagnosticIDs);
+    DiagnosticsEngine nodiags(diagids);
+    gap.CalcLen(NoAddSpan, nodiags); // force length calculation
 }
 
 std::auto_ptr<Section>
@@ -265,13 +359,7 @@ ElfSection::CreateSection(const StringTable& shstrtab) const
     section->setAlign(m_align);
 
     if (bss)
-    {
-        Bytecode& gap =
-            section->AppendGap(m_size.getUInt(), SourceLocation());
-        IntrusiveRefCntPtr<DiagnosticIDs> diagids(new DiagnosticIDs);
-        DiagnosticsEngine nodiags(diagids);
-        gap.CalcLen(NoAddSpan, nodiags); // force length calculation
-    }
+        AppendSizedGap(*section, m_size.getUInt());
 
     return section;
 }
@@ -299,6 +387,14 @@ ElfSection::LoadSectionData(Section& sect,
     return true;
 }
 
+void
+ElfSection::SkipSectionData(Section& sect) const
+{
+    if (sect.isBSS())
+        return;
+    AppendSizedGap(sect, m_size.getUInt());
+}
+
 unsigned long
 ElfSection::WriteRel(raw_ostream& os,
                      ElfSectionIndex symtab_idx,
@@ -358,6 +454,8 @@ ElfSection::WriteRelocs(raw_ostream& os,
     if (sect.getRelocs().size() == 0)
         return 0;
 
+    TraceRegion t("Output Relocations", sect.getName());
+
     // first align section to multiple of 4
     uint64_t pos = os.tell();
     if (os.has_error())
@@ -368,19 +466,26 @@ ElfSection::WriteRelocs(raw_ostream& os,
     uint64_t apos = (pos + 3) & ~3;
     for (; pos < apos; ++pos)
         os << '\0';
-    m_rel_offset = static_cast<unsigned long>(pos);
+    m_rel_offset = pos;
+
+    // Encode the entire table, then write it out at once.
+    unsigned int entsize;
+    if (m_config.cls == ELFCLASS32)
+        entsize = m_config.rela ? RELOC32A_SIZE : RELOC32_SIZE;
+    else
+        entsize = m_config.rela ? RELOC64A_SIZE : RELOC64_SIZE;
 
-    unsigned long size = 0;
+    scratch.resize(0);
+    scratch.reserve(entsize * sect.getRelocs().size());
+    m_config.setEndian(scratch);
     for (Section::reloc_iterator i=sect.relocs_begin(), end=sect.relocs_end();
          i != end; ++i)
     {
         ElfReloc& reloc = static_cast<ElfReloc&>(*i);
-        scratch.resize(0);
         reloc.Write(scratch, m_config);
-        os << scratch;
-        size += scratch.size();
     }
-    return size;
+    os << scratch;
+    return scratch.size();
 }
 
 void
@@ -396,14 +501,15 @@ ElfSection::ReadRelocs(const MemoryBuffer&  in,
     for (unsigned long pos = start; pos < end; )
     {
         sect.AddReloc(std::auto_ptr<Reloc>(
-            machine.ReadReloc(m_config, symtab, in, &pos, rela).release()));
+            machine.ReadReloc(m_config, symtab, in, &pos, rela, sect)
+                .release()));
     }
 }
 
-unsigned long
-ElfSection::setFileOffset(unsigned long pos)
+ElfOffset
+ElfSection::setFileOffset(ElfOffset pos)
 {
-    const unsigned long align = m_align;
+    const ElfOffset align = m_align;
 
     if (align == 0 || align == 1)
     {
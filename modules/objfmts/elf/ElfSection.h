@@ -27,6 +27,8 @@
 // POSSIBILITY OF SUCH DAMAGE.
 //
 #include <iosfwd>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include "yasmx/Config/export.h"
@@ -53,6 +55,7 @@ class YASM_STD_EXPORT ElfSection : public AssocData
 {
 public:
     static const char* key;
+    static const bool inline_slot = true;
 
     // Constructor that reads from memory buffer.
     ElfSection(const ElfConfig&     config,
@@ -73,10 +76,24 @@ public:
 
     unsigned long Write(raw_ostream& os, Bytes& scratch) const;
 
+    /// Compress section contents in place, prefixing them with an
+    /// Elf_Chdr.  The contents are left untouched if compression does not
+    /// make them smaller; otherwise the section is marked SHF_COMPRESSED
+    /// and its size and alignment are updated to match.
+    /// @param data     serialized section contents
+    /// @param type     compression algorithm
+    /// @param scratch  scratch buffer
+    /// @return True if the contents were compressed.
+    bool Compress(std::vector<char>& data,
+                  ElfCompressionType type,
+                  Bytes& scratch);
+
     std::auto_ptr<Section> CreateSection(const StringTable& shstrtab) const;
     bool LoadSectionData(Section& sect,
                          const MemoryBuffer& in,
                          DiagnosticsEngine& diags) const;
+    /// Give a section its file size without loading its data.
+    void SkipSectionData(Section& sect) const;
 
     ElfSectionType getType() const { return m_type; }
 
@@ -108,6 +125,25 @@ public:
     void setRelIndex(ElfSectionIndex sectidx) { m_rel_index = sectidx; }
     void setRelName(ElfStringIndex nameidx) { m_rel_name_index = nameidx; }
 
+    /// Relocations packed into relative relocation (SHT_RELR) sections:
+    /// pairs of the index of the section the address is relative to and
+    /// the offset of the address-sized field in this section.
+    typedef std::vector<std::pair<ElfSectionIndex, uint64_t> >
+        RelativeRelocs;
+
+    /// Record a relocation to be packed into a relative relocation
+    /// section instead of being written with the other relocations.  The
+    /// field holds the offset of the address within the target section.
+    /// @param target   index of the section the address is relative to
+    /// @param offset   offset of the field in this section
+    void AddRelativeReloc(ElfSectionIndex target, uint64_t offset)
+    { m_relr.push_back(std::make_pair(target, offset)); }
+
+    RelativeRelocs& getRelativeRelocs() { return m_relr; }
+
+    void setRelrName(ElfStringIndex nameidx) { m_relr_name_index = nameidx; }
+    ElfStringIndex getRelrName() const { return m_relr_name_index; }
+
     void setEntSize(ElfSize size) { m_entsize = size; }
     ElfSize getEntSize() const { return m_entsize; }
 
@@ -131,8 +167,8 @@ public:
                     const ElfSymtab& symtab,
                     bool rela) const;
 
-    unsigned long setFileOffset(unsigned long pos);
-    unsigned long getFileOffset() const { return m_offset; }
+    ElfOffset setFileOffset(ElfOffset pos);
+    ElfOffset getFileOffset() const { return m_offset; }
 
 private:
     const ElfConfig&    m_config;
@@ -140,7 +176,7 @@ private:
     ElfSectionType      m_type;
     ElfSectionFlags     m_flags;
     IntNum              m_addr;
-    ElfAddress          m_offset;
+    ElfOffset           m_offset;
     IntNum              m_size;
     ElfSectionIndex     m_link;
     ElfSectionInfo      m_info;         // see note ESD1
@@ -152,9 +188,17 @@ private:
 
     ElfStringIndex      m_rel_name_index;
     ElfSectionIndex     m_rel_index;
-    ElfAddress          m_rel_offset;
+    ElfOffset           m_rel_offset;
+
+    RelativeRelocs      m_relr;
+    ElfStringIndex      m_relr_name_index;
 };
 
+/// Append a gap bytecode of the given length to a section, with its
+/// length already calculated.
+YASM_STD_EXPORT
+void AppendSizedGap(Section& sect, unsigned long size);
+
 // Note ESD1:
 //   for section types SHT_REL, SHT_RELA:
 //     link -> index of associated symbol table
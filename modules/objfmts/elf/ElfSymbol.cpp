@@ -49,6 +49,7 @@ const char* ElfSymbol::key = "objfmt::elf::ElfSymbol";
 ElfSymbol::ElfSymbol(const ElfConfig&       config,
                      const MemoryBuffer&    in,
                      const ElfSection&      symtab_sect,
+                     const ElfSection*      shndx_sect,
                      ElfSymbolIndex         index,
                      Section*               sections[],
                      DiagnosticsEngine&     diags)
@@ -56,6 +57,7 @@ ElfSymbol::ElfSymbol(const ElfConfig&       config,
     , m_name_index(0)
     , m_value(0)
     , m_symindex(index)
+    , m_header_index(false)
     , m_in_table(true)
     , m_weak_ref(false)
     , m_weak_refr(false)
@@ -86,7 +88,24 @@ ElfSymbol::ElfSymbol(const ElfConfig&       config,
     m_vis = ELF_ST_VISIBILITY(ReadU8(inbuf));
 
     m_index = static_cast<ElfSectionIndex>(ReadU16(inbuf));
-    if (m_index != SHN_UNDEF && m_index < config.secthead_count)
+    if (m_index == SHN_XINDEX && shndx_sect != 0)
+    {
+        // real index is in the extended section index table
+        InputBuffer shndx_buf(in);
+        shndx_buf.setPosition(shndx_sect->getFileOffset() + index * 4);
+        if (shndx_buf.getReadableSize() < 4)
+        {
+            diags.Report(SourceLocation(), diag::err_symbol_unreadable);
+            return;
+        }
+        config.setEndian(shndx_buf);
+        m_index = static_cast<ElfSectionIndex>(ReadU32(shndx_buf));
+        m_header_index = true;
+    }
+    else
+        m_header_index = (m_index < SHN_LORESERVE);
+    if (m_header_index && m_index != SHN_UNDEF
+        && m_index < config.secthead_count)
         m_sect = sections[m_index];
 
     if (config.cls == ELFCLASS64)
@@ -105,6 +124,7 @@ ElfSymbol::ElfSymbol()
     , m_type(STT_NOTYPE)
     , m_vis(STV_DEFAULT)
     , m_symindex(STN_UNDEF)
+    , m_header_index(false)
     , m_in_table(true)
     , m_weak_ref(false)
     , m_weak_refr(false)
@@ -135,22 +155,22 @@ ElfSymbol::CreateSymbol(Object& object, const StringTable& strtab) const
         sym = object.AppendSymbol(name);
     }
 
-    if (m_index == SHN_ABS)
+    if (m_sect != 0)
+    {
+        Location loc = {&m_sect->bytecodes_front(), m_value.getUInt()};
+        sym->DefineLabel(loc);
+    }
+    else if (!m_header_index && m_index == SHN_ABS)
     {
         if (hasSize())
             sym->DefineEqu(m_size);
         else
             sym->DefineEqu(Expr(0));
     }
-    else if (m_index == SHN_COMMON)
+    else if (!m_header_index && m_index == SHN_COMMON)
     {
         sym->Declare(Symbol::COMMON);
     }
-    else if (m_sect != 0)
-    {
-        Location loc = {&m_sect->bytecodes_front(), m_value.getUInt()};
-        sym->DefineLabel(loc);
-    }
 
     return sym;
 }
@@ -348,7 +368,7 @@ ElfSymbol::Finalize(Symbol& sym, DiagnosticsEngine& diags)
     }
 }
 
-void
+ElfSectionIndex
 ElfSymbol::Write(Bytes& bytes,
                  const ElfConfig& config,
                  DiagnosticsEngine& diags)
@@ -373,7 +393,7 @@ ElfSymbol::Write(Bytes& bytes,
         }
     }
 
-    bytes.resize(0);
+    Bytes::size_type start = bytes.size();
     config.setEndian(bytes);
 
     Write32(bytes, m_name_index);
@@ -387,16 +407,24 @@ ElfSymbol::Write(Bytes& bytes,
     Write8(bytes, ELF_ST_INFO(m_bind, m_type));
     Write8(bytes, ELF_ST_OTHER(m_vis));
 
+    // Section header indices that don't fit (or would look like a special
+    // index) go in the extended section index table instead.
+    ElfSectionIndex index = m_index;
+    bool header_index = m_header_index;
     if (m_sect)
     {
         ElfSection* elfsect = m_sect->getAssocData<ElfSection>();
         assert(elfsect != 0);
-        Write16(bytes, elfsect->getIndex());
+        index = elfsect->getIndex();
+        header_index = true;
     }
-    else
+    ElfSectionIndex xindex = 0;
+    if (header_index && index >= SHN_LORESERVE)
     {
-        Write16(bytes, m_index);
+        xindex = index;
+        index = SHN_XINDEX;
     }
+    Write16(bytes, index);
 
     if (config.cls == ELFCLASS64)
     {
@@ -405,7 +433,8 @@ ElfSymbol::Write(Bytes& bytes,
     }
 
     if (config.cls == ELFCLASS32)
-        assert(bytes.size() == SYMTAB32_SIZE);
+        assert(bytes.size() - start == SYMTAB32_SIZE);
     else if (config.cls == ELFCLASS64)
-        assert(bytes.size() == SYMTAB64_SIZE);
+        assert(bytes.size() - start == SYMTAB64_SIZE);
+    return xindex;
 }
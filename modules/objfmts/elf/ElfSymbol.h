@@ -58,11 +58,14 @@ class YASM_STD_EXPORT ElfSymbol : public AssocData
 {
 public:
     static const char* key;
+    static const bool inline_slot = true;
 
-    // Constructor that reads from memory buffer (e.g. from file)
+    // Constructor that reads from memory buffer (e.g. from file).
+    // shndx_sect is the extended section index table (may be NULL).
     ElfSymbol(const ElfConfig&          config,
               const MemoryBuffer& in,
               const ElfSection&         symtab_sect,
+              /*@null@*/ const ElfSection* shndx_sect,
               ElfSymbolIndex            index,
               Section*                  sections[],
               DiagnosticsEngine&        diags);
@@ -77,12 +80,34 @@ public:
 #endif // WITH_XML
 
     void Finalize(Symbol& sym, DiagnosticsEngine& diags);
-    void Write(Bytes& bytes, const ElfConfig& config, DiagnosticsEngine& diags);
+    /// Append the symbol table entry to bytes.
+    /// @return Section index to put in the extended section index table
+    ///         (SHT_SYMTAB_SHNDX), or 0 if the entry holds the index.
+    ElfSectionIndex Write(Bytes& bytes,
+                          const ElfConfig& config,
+                          DiagnosticsEngine& diags);
 
     void setSection(Section* sect) { m_sect = sect; }
     void setName(ElfStringIndex index) { m_name_index = index; }
+    ElfStringIndex getName() const { return m_name_index; }
     bool hasName() const { return m_name_index != 0; }
-    void setSectionIndex(ElfSectionIndex index) { m_index = index; }
+    /// Set a special section index (e.g. SHN_ABS).
+    void setSectionIndex(ElfSectionIndex index)
+    {
+        m_index = index;
+        m_header_index = false;
+    }
+    /// Set the section header index of a section without a Section
+    /// (e.g. a group section).
+    void setSectionHeaderIndex(ElfSectionIndex index)
+    {
+        m_index = index;
+        m_header_index = true;
+    }
+    ElfSectionIndex getSectionIndex() const { return m_index; }
+    /// Is getSectionIndex() a section header index (rather than a
+    /// special index such as SHN_ABS)?
+    bool isSectionHeaderIndex() const { return m_header_index; }
 
     ElfSymbolVis getVisibility() const { return m_vis; }
     void setVisibility(ElfSymbolVis vis)
@@ -112,6 +137,7 @@ public:
     SourceLocation getSizeSource() { return m_size_source; }
 
     void setValue(ElfAddress value) { m_value = value; }
+    const IntNum& getValue() const { return m_value; }
     void setSymbolIndex(ElfSymbolIndex symindex) { m_symindex = symindex; }
     ElfSymbolIndex getSymbolIndex() const { return m_symindex; }
 
@@ -135,6 +161,7 @@ private:
     ElfSymbolType           m_type;
     ElfSymbolVis            m_vis;
     ElfSymbolIndex          m_symindex;
+    bool                    m_header_index; // m_index is not a special one
     bool                    m_in_table;
     bool                    m_weak_ref;
     bool                    m_weak_refr;
@@ -28,6 +28,7 @@
 
 #include <vector>
 
+#include "llvm/Support/DataTypes.h"
 #include "yasmx/SymbolRef.h"
 
 
@@ -42,8 +43,8 @@ class ElfReloc;
 class ElfSection;
 class ElfSymbol;
 
-typedef unsigned long ElfAddress;
-typedef unsigned long ElfOffset;
+typedef uint64_t ElfAddress;
+typedef uint64_t ElfOffset;
 typedef unsigned long ElfSize;
 typedef unsigned long ElfSectionInfo;
 typedef unsigned long ElfStringIndex;
@@ -157,7 +158,8 @@ enum ElfSectionType
     SHT_PREINIT_ARRAY = 16,     // Array of pre-constructors
     SHT_GROUP = 17,             // Section group
     SHT_SYMTAB_SHNDX = 18,      // Extended section indices
-    SHT_NUM = 19,               // Number of defined types
+    SHT_RELR = 19,              // Relative relocations, bitmap-encoded
+    SHT_NUM = 20,               // Number of defined types
     SHT_LOOS = 0x60000000,      // reserved for environment specific use
     SHT_HIOS = 0x6fffffff,
     SHT_LOPROC = 0x70000000,    // reserved for processor specific semantics
@@ -177,11 +179,19 @@ enum ElfSectionFlagValues
     SHF_STRINGS = 0x20,         // contains 0-terminated strings
     SHF_GROUP = 0x200,          // member of a section group
     SHF_TLS = 0x400,            // thread local storage
+    SHF_COMPRESSED = 0x800,     // contents compressed (Elf_Chdr header)
     SHF_MASKOS = 0x0f000000/*,  // environment specific use
     SHF_MASKPROC = 0xf0000000*/ // bits reserved for processor specific needs
 };
 typedef unsigned long ElfSectionFlags;
 
+// elf compression header types (ch_type)
+enum ElfCompressionType
+{
+    ELFCOMPRESS_ZLIB = 1,       // zlib/deflate
+    ELFCOMPRESS_ZSTD = 2        // Zstandard
+};
+
 // elf section index - just the special ones
 enum ElfSectionIndexValues
 {
@@ -193,6 +203,8 @@ enum ElfSectionIndexValues
     SHN_HIOS = 0xff3f,
     SHN_ABS = 0xfff1,           // associated symbols don't change on reloc
     SHN_COMMON = 0xfff2,        // associated symbols refer to unallocated
+    SHN_XINDEX = 0xffff,        // index is in extended (SHT_SYMTAB_SHNDX)
+                                // table, or header field is in section 0
     SHN_HIRESERVE = 0xffff
 };
 typedef unsigned int ElfSectionIndex;
@@ -271,6 +283,9 @@ enum ElfSymbolVis
 #define SHDR64_SIZE 64
 #define SHDR_MAXSIZE 64
 
+#define CHDR32_SIZE 12
+#define CHDR64_SIZE 24
+
 #define SYMTAB32_SIZE 16
 #define SYMTAB64_SIZE 24
 #define SYMTAB_MAXSIZE 24
@@ -382,11 +397,17 @@ enum ElfRelocationType_x86_64
     R_X86_64_TLSDESC_CALL = 35, // Marker for call through TLS descriptor
     R_X86_64_TLSDESC = 36,      // TLS descriptor
     R_X86_64_IRELATIVE = 37,    // wordclass, indirect (B + A)
-    R_X86_64_RELATIVE64 = 38    // word64, B + A
+    R_X86_64_RELATIVE64 = 38,   // word64, B + A
+    R_X86_64_GOTPCRELX = 41,    // like GOTPCREL, but linker may relax
+    R_X86_64_REX_GOTPCRELX = 42 // like GOTPCRELX, instruction has REX prefix
 };
 
 typedef std::vector<SymbolRef> ElfSymtab;
 
+/// Flat symbol table used for output, indexed by symbol index once
+/// indices have been assigned.
+typedef std::vector<ElfSymbol*> ElfOutputSymtab;
+
 }} // namespace yasm::objfmt
 
 #endif
@@ -47,16 +47,17 @@ public:
               const ElfSymtab& symtab,
               const MemoryBuffer& in,
               unsigned long* pos,
-              bool rela) const
+              bool rela,
+              Section& sect) const
     {
         return std::auto_ptr<ElfReloc>
-            (new ElfReloc_x86_amd64(config, symtab, in, pos, rela));
+            (new (sect) ElfReloc_x86_amd64(config, symtab, in, pos, rela));
     }
 
     std::auto_ptr<ElfReloc>
-    MakeReloc(SymbolRef sym, const IntNum& addr) const
+    MakeReloc(SymbolRef sym, const IntNum& addr, Section& sect) const
     {
-        return std::auto_ptr<ElfReloc>(new ElfReloc_x86_amd64(sym, addr));
+        return std::auto_ptr<ElfReloc>(new (sect) ElfReloc_x86_amd64(sym, addr));
     }
 };
 } // anonymous namespace
@@ -93,7 +94,8 @@ Elf_x86_amd64::AddSpecialSymbols(Object& object, StringRef parser) const
 {
     static const ElfSpecialSymbolData ssyms[] =
     {
-        //name,         type,             size,symrel,thread,curpos,needsgot
+        //name,         type,             size,symrel,thread,curpos,needsgot,
+        //  type for 64-bit data
         {"pltoff",      R_X86_64_PLTOFF64,  64,  true, false, false, false},
         {"plt",         R_X86_64_PLT32,     32,  true, false, false, true},
         {"gotplt",      R_X86_64_GOTPLT64,  64,  true, false, false, false},
@@ -102,8 +104,10 @@ Elf_x86_amd64::AddSpecialSymbols(Object& object, StringRef parser) const
         {"tlsgd",       R_X86_64_TLSGD,     32,  true,  true, false, true},
         {"tlsld",       R_X86_64_TLSLD,     32,  true,  true, false, true},
         {"gottpoff",    R_X86_64_GOTTPOFF,  32,  true,  true, false, true},
-        {"tpoff",       R_X86_64_TPOFF32,   32,  true,  true, false, true},
-        {"dtpoff",      R_X86_64_DTPOFF32,  32,  true,  true, false, true},
+        {"tpoff",       R_X86_64_TPOFF32,   32,  true,  true, false, true,
+            R_X86_64_TPOFF64},
+        {"dtpoff",      R_X86_64_DTPOFF32,  32,  true,  true, false, true,
+            R_X86_64_DTPOFF64},
         {"got",         R_X86_64_GOT32,     32,  true, false, false, true},
         {"tlsdesc", R_X86_64_GOTPC32_TLSDESC, 32,true,  true, false, false},
         {"tlscall", R_X86_64_TLSDESC_CALL,  32,  true,  true, false, false}
@@ -156,6 +160,49 @@ ElfReloc_x86_amd64::setRel(bool rel,
     return true;
 }
 
+// Use GOTPCRELX or REX_GOTPCRELX for GOT loads the linker may turn into
+// direct references: RIP-relative call/jmp through the GOT, and mov, test
+// or a binary ALU operation reading the GOT entry.  Only instructions
+// with at most a REX prefix (none for call/jmp) are considered, as the
+// linker rewrites the opcode and ModRM bytes in place.
+void
+ElfReloc_x86_amd64::setInsn(llvm::ArrayRef<unsigned char> insn)
+{
+    if (m_type != R_X86_64_GOTPCREL || insn.size() < 2 || insn.size() > 3)
+        return;
+
+    bool rex = false;
+    if (insn.size() == 3)
+    {
+        if ((insn[0] & 0xf0) != 0x40)
+            return;
+        rex = true;
+    }
+
+    unsigned char opcode = insn[insn.size()-2];
+    unsigned char modrm = insn[insn.size()-1];
+    if ((modrm & 0xc7) != 0x05)
+        return;                         // not RIP-relative
+
+    if (opcode == 0xff && !rex)
+    {
+        unsigned int reg = (modrm >> 3) & 7;
+        if (reg == 2 || reg == 4)       // call, jmp
+            m_type = R_X86_64_GOTPCRELX;
+    }
+    else if (opcode == 0x8b || opcode == 0x85 || (opcode & 0xc7) == 0x03)
+    {
+        // mov, test, adc/add/and/cmp/or/sbb/sub/xor reg, mem
+        m_type = rex ? R_X86_64_REX_GOTPCRELX : R_X86_64_GOTPCRELX;
+    }
+}
+
+bool
+ElfReloc_x86_amd64::isAbsoluteAddress() const
+{
+    return m_type == R_X86_64_64;
+}
+
 std::string
 ElfReloc_x86_amd64::getTypeName() const
 {
@@ -199,6 +246,8 @@ ElfReloc_x86_amd64::getTypeName() const
         case R_X86_64_TLSDESC: name = "R_X86_64_TLSDESC"; break;
         case R_X86_64_IRELATIVE: name = "R_X86_64_IRELATIVE"; break;
         case R_X86_64_RELATIVE64: name = "R_X86_64_RELATIVE64"; break;
+        case R_X86_64_GOTPCRELX: name = "R_X86_64_GOTPCRELX"; break;
+        case R_X86_64_REX_GOTPCRELX: name = "R_X86_64_REX_GOTPCRELX"; break;
     }
 
     return name;
@@ -51,6 +51,8 @@ public:
     virtual ~ElfReloc_x86_amd64() {}
 
     virtual bool setRel(bool rel, SymbolRef GOT_sym, size_t valsize, bool sign);
+    virtual void setInsn(llvm::ArrayRef<unsigned char> insn);
+    virtual bool isAbsoluteAddress() const;
     virtual std::string getTypeName() const;
 };
 
@@ -51,6 +51,9 @@ public:
     ~ElfReloc_x86_x32() {}
 
     bool setRel(bool rel, SymbolRef GOT_sym, size_t valsize, bool sign);
+
+    // The relaxable GOT relocations are not used for x32.
+    void setInsn(llvm::ArrayRef<unsigned char> insn) {}
 };
 
 class Elf_x86_x32 : public ElfMachine
@@ -66,16 +69,17 @@ public:
               const ElfSymtab& symtab,
               const MemoryBuffer& in,
               unsigned long* pos,
-              bool rela) const
+              bool rela,
+              Section& sect) const
     {
         return std::auto_ptr<ElfReloc>
-            (new ElfReloc_x86_x32(config, symtab, in, pos, rela));
+            (new (sect) ElfReloc_x86_x32(config, symtab, in, pos, rela));
     }
 
     std::auto_ptr<ElfReloc>
-    MakeReloc(SymbolRef sym, const IntNum& addr) const
+    MakeReloc(SymbolRef sym, const IntNum& addr, Section& sect) const
     {
-        return std::auto_ptr<ElfReloc>(new ElfReloc_x86_x32(sym, addr));
+        return std::auto_ptr<ElfReloc>(new (sect) ElfReloc_x86_x32(sym, addr));
     }
 };
 } // anonymous namespace
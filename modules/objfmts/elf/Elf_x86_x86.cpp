@@ -70,16 +70,17 @@ public:
               const ElfSymtab& symtab,
               const MemoryBuffer& in,
               unsigned long* pos,
-              bool rela) const
+              bool rela,
+              Section& sect) const
     {
         return std::auto_ptr<ElfReloc>
-            (new ElfReloc_x86_x86(config, symtab, in, pos, rela));
+            (new (sect) ElfReloc_x86_x86(config, symtab, in, pos, rela));
     }
 
     std::auto_ptr<ElfReloc>
-    MakeReloc(SymbolRef sym, const IntNum& addr) const
+    MakeReloc(SymbolRef sym, const IntNum& addr, Section& sect) const
     {
-        return std::auto_ptr<ElfReloc>(new ElfReloc_x86_x86(sym, addr));
+        return std::auto_ptr<ElfReloc>(new (sect) ElfReloc_x86_x86(sym, addr));
     }
 };
 } // anonymous namespace
@@ -230,6 +230,8 @@ static const MachObject::StaticSectionConfig mach_x86_64_sections[] =
         MachSection::S_COALESCED|MachSection::S_ATTR_LIVE_SUPPORT|
         MachSection::S_ATTR_STRIP_STATIC_SYMS|MachSection::S_ATTR_NO_TOC,
         8},
+    {".compact_unwind", "__LD", "__compact_unwind",
+        MachSection::S_ATTR_DEBUG, 8},
     {0, 0, 0, 0, 0}
 };
 
@@ -477,6 +479,12 @@ MachObject::LookupSection(StringRef segname, StringRef sectname)
     return config;
 }
 
+std::string
+MachObject::getSectionName(StringRef segname, StringRef sectname)
+{
+    return LookupSection(segname, sectname).name;
+}
+
 Section*
 MachObject::AppendSection(const SectionConfig& config,
                           SourceLocation source,
@@ -888,6 +896,21 @@ MachObject::DirPrivateExtern(DirectiveInfo& info, DiagnosticsEngine& diags)
     }
 }
 
+void
+MachObject::DirAltEntry(DirectiveInfo& info, DiagnosticsEngine& diags)
+{
+    assert(info.isObject(m_object));
+    NameValues& namevals = info.getNameValues();
+    for (NameValues::iterator nv = namevals.begin(), end = namevals.end();
+         nv != end; ++nv)
+    {
+        SymbolRef sym = info.getObject().getSymbol(nv->getId());
+        MachSymbol& msym = MachSymbol::Build(*sym);
+        msym.m_alt_entry = true;
+        msym.m_required = true;
+    }
+}
+
 void
 MachObject::DirDesc(DirectiveInfo& info, DiagnosticsEngine& diags)
 {
@@ -932,6 +955,12 @@ MachObject::DirSubsectionsViaSymbols(DirectiveInfo& info,
                                      DiagnosticsEngine& diags)
 {
     m_subsections_via_symbols = true;
+
+    // The linker may reorder or dead strip the atoms the section is split
+    // into at each non-temporary symbol, local or global, so references to
+    // those symbols in the same section can't be resolved here; keep the
+    // relocation.
+    m_object.getOptions().DisableNonTempSubRelative = true;
 }
 
 void
@@ -956,6 +985,8 @@ MachObject::AddDirectives(Directives& dirs, StringRef parser)
             Directives::ID_REQUIRED},
         {".weak_definition",            &MachObject::DirWeakDefinition,
             Directives::ID_REQUIRED},
+        {".alt_entry",                  &MachObject::DirAltEntry,
+            Directives::ID_REQUIRED},
         {".private_extern",             &MachObject::DirPrivateExtern,
             Directives::ID_REQUIRED},
         {".desc",                       &MachObject::DirDesc,
@@ -990,13 +1021,13 @@ MachObject::AddDirectives(Directives& dirs, StringRef parser)
     }
 }
 
-void
-yasm_objfmt_mach_DoRegister()
+extern const yasm::impl::ModuleEntry yasm_objfmt_mach_modules[] =
 {
-    RegisterModule<ObjectFormatModule,
-                   ObjectFormatModuleImpl<MachObject> >("macho");
-    RegisterModule<ObjectFormatModule,
-                   ObjectFormatModuleImpl<Mach32Object> >("macho32");
-    RegisterModule<ObjectFormatModule,
-                   ObjectFormatModuleImpl<Mach64Object> >("macho64");
-}
+    YASM_MODULE_ENTRY(ObjectFormatModule,
+                      ObjectFormatModuleImpl<MachObject>, "macho"),
+    YASM_MODULE_ENTRY(ObjectFormatModule,
+                      ObjectFormatModuleImpl<Mach32Object>, "macho32"),
+    YASM_MODULE_ENTRY(ObjectFormatModule,
+                      ObjectFormatModuleImpl<Mach64Object>, "macho64"),
+    YASM_MODULE_TABLE_END
+};
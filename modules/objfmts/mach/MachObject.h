@@ -56,7 +56,9 @@ public:
 
     void InitSymbols(StringRef parser);
 
-    void Output(raw_fd_ostream& os,
+    bool Read(SourceManager& sm, DiagnosticsEngine& diags);
+
+    void Output(OutputFileStream& os,
                 bool all_syms,
                 DebugFormat& dbgfmt,
                 DiagnosticsEngine& diags);
@@ -85,10 +87,24 @@ public:
                       /*@out@*/ std::string* machine)
     { return false; }
 
+protected:
+    /// Taste object file to see if it is an x86 Mach-O object file.
+    /// @param in           object file contents
+    /// @param bits         32 or 64 to accept 32-bit or 64-bit objects
+    /// @param arch_keyword architecture keyword (output)
+    /// @param machine      machine (output)
+    /// @return True if object file is readable.
+    static bool TasteMach(const MemoryBuffer& in,
+                          unsigned int bits,
+                          /*@out@*/ std::string* arch_keyword,
+                          /*@out@*/ std::string* machine);
+
 private:
     void InitSection(const SectionConfig& config, Section& section);
     SectionConfig LookupSection(StringRef name);
     SectionConfig LookupSection(StringRef segname, StringRef sectname);
+    /// Get the name used for a section of a segment (e.g. ".text").
+    std::string getSectionName(StringRef segname, StringRef sectname);
     void DirGasSection(DirectiveInfo& info, DiagnosticsEngine& diags);
     void DirSection(DirectiveInfo& info, DiagnosticsEngine& diags);
     void DirGasStandardSection(const StaticSectionConfig* config,
@@ -101,6 +117,7 @@ private:
     void DirWeakReference(DirectiveInfo& info, DiagnosticsEngine& diags);
     void DirWeakDefinition(DirectiveInfo& info, DiagnosticsEngine& diags);
     void DirPrivateExtern(DirectiveInfo& info, DiagnosticsEngine& diags);
+    void DirAltEntry(DirectiveInfo& info, DiagnosticsEngine& diags);
     void DirDesc(DirectiveInfo& info, DiagnosticsEngine& diags);
     void DirNoDeadStrip(DirectiveInfo& info, DiagnosticsEngine& diags);
     void DirSubsectionsViaSymbols(DirectiveInfo& info,
@@ -134,7 +151,7 @@ public:
     static bool Taste(const MemoryBuffer& in,
                       /*@out@*/ std::string* arch_keyword,
                       /*@out@*/ std::string* machine)
-    { return false; }
+    { return TasteMach(in, 32, arch_keyword, machine); }
 };
 
 class YASM_STD_EXPORT Mach64Object : public MachObject
@@ -159,7 +176,7 @@ public:
     static bool Taste(const MemoryBuffer& in,
                       /*@out@*/ std::string* arch_keyword,
                       /*@out@*/ std::string* machine)
-    { return false; }
+    { return TasteMach(in, 64, arch_keyword, machine); }
 };
 
 }} // namespace yasm::objfmt
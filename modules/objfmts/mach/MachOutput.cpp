@@ -26,8 +26,17 @@
 //
 #include "MachObject.h"
 
-#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
 
+#include "llvm/Support/raw_ostream.h"
+#include "yasmx/Basic/Diagnostic.h"
+#include "yasmx/Config/functional.h"
+#include "yasmx/Support/OutputFileStream.h"
+#include "yasmx/Support/ThreadPool.h"
+#include "yasmx/Support/ptr_vector.h"
 #include "yasmx/Arch.h"
 #include "yasmx/BytecodeOutput.h"
 #include "yasmx/Bytecode.h"
@@ -133,7 +142,7 @@ namespace {
 class MachOutput : public BytecodeStreamOutput
 {
 public:
-    MachOutput(raw_ostream& os,
+    MachOutput(OutputFileStream& os,
                Object& object,
                DiagnosticsEngine& diags,
                SymbolRef gotpcrel_sym,
@@ -142,7 +151,14 @@ public:
     ~MachOutput();
 
     bool OutputSection(Section& sect);
+    void OutputSections(unsigned int num_jobs);
     void OutputSectionRelocs(Section& sect, unsigned long* relocs_offset);
+
+    // Individual steps of OutputSection(), so the bytecodes can be encoded
+    // separately (e.g. on a worker thread).
+    bool BeginSection(Section& sect);
+    void OutputBytecodes(Section& sect);
+    void MarkRequiredSymbols();
     void OutputFileHeader(unsigned long flags);
     void OutputSegmentCommand(unsigned long total_vmsize,
                               unsigned long total_filesize);
@@ -174,6 +190,7 @@ private:
     unsigned int m_segcmd;
 
     // symbol table info
+    std::vector<Symbol*> m_symtab;      // symbols in output order
     StringTable m_strtab;
     unsigned long m_symtab_offset;
     unsigned long m_symtab_count;
@@ -187,6 +204,10 @@ private:
 
     // current section
     MachSection* m_machsect;
+
+    // symbols referenced by external relocations; marked as required in
+    // the symbol table by MarkRequiredSymbols()
+    std::vector<SymbolRef> m_required_syms;
 };
 } // anonymous namespace
 
@@ -211,7 +232,7 @@ isSectionLabel(const Symbol& sym)
     return true;
 }
 
-MachOutput::MachOutput(raw_ostream& os,
+MachOutput::MachOutput(OutputFileStream& os,
                        Object& object,
                        DiagnosticsEngine& diags,
                        SymbolRef gotpcrel_sym,
@@ -234,6 +255,9 @@ MachOutput::MachOutput(raw_ostream& os,
     , m_undefsym_count(0)
     , m_machsect(0)
 {
+    setListFormat(object.getListFormat());
+    m_no_output.setListFormat(object.getListFormat());
+
     // Size MACH-O Header, Seg CMD, Sect CMDs, Sym Tab, Reloc Data
     if (is64)
     {
@@ -368,7 +392,8 @@ MachOutput::ConvertValueToBytes(Value& value,
 
                 // build and add a subtractor reloc
                 MachReloc* sub_reloc;
-                sub_reloc = new Mach64Reloc(addr, sub_sym,
+                sub_reloc =
+                    new (*sect) Mach64Reloc(addr, sub_sym,
                                             MachReloc::X86_64_RELOC_SUBTRACTOR,
                                             false, length, ext);
                 sect->AddReloc(std::auto_ptr<Reloc>(sub_reloc));
@@ -385,6 +410,18 @@ MachOutput::ConvertValueToBytes(Value& value,
                     return false;
                 }
                 rtype = MachReloc::X86_64_RELOC_UNSIGNED;
+
+                // Generated location symbols (e.g. compact unwind function
+                // starts) never reach the symbol table; relocate them
+                // against their section instead.
+                Location sym_loc;
+                if (sym && m_object.FindSymbol(sym->getName()) != sym &&
+                    sym->getLabel(&sym_loc))
+                {
+                    ext = false;
+                    intn += sym_loc.bc->getContainer()->getSection()->getVMA();
+                    intn += sym_loc.getOffset();
+                }
             }
         }
         else
@@ -419,33 +456,16 @@ MachOutput::ConvertValueToBytes(Value& value,
 
             // external relocations must be in the symbol table
             if (sub_sym)
-            {
-                MachSymbol* msubsym = sub_sym->getAssocData<MachSymbol>();
-                if (!msubsym)
-                {
-                    msubsym = new MachSymbol;
-                    sub_sym->AddAssocData(std::auto_ptr<MachSymbol>(msubsym));
-                }
-                msubsym->m_required = true;
-            }
-
+                m_required_syms.push_back(sub_sym);
             if (sym)
-            {
-                MachSymbol* msym = sym->getAssocData<MachSymbol>();
-                if (!msym)
-                {
-                    msym = new MachSymbol;
-                    sym->AddAssocData(std::auto_ptr<MachSymbol>(msym));
-                }
-                msym->m_required = true;
-            }
+                m_required_syms.push_back(sym);
         }
 
         MachReloc* reloc;
         if (m_is64)
-            reloc = new Mach32Reloc(addr, sym, rtype, pcrel, length, ext);
+            reloc = new (*sect) Mach32Reloc(addr, sym, rtype, pcrel, length, ext);
         else
-            reloc = new Mach64Reloc(addr, sym, rtype, pcrel, length, ext);
+            reloc = new (*sect) Mach64Reloc(addr, sym, rtype, pcrel, length, ext);
         sect->AddReloc(std::auto_ptr<Reloc>(reloc));
     }
     num_out.OutputInteger(intn);
@@ -453,34 +473,36 @@ MachOutput::ConvertValueToBytes(Value& value,
 }
 
 bool
-MachOutput::OutputSection(Section& sect)
+MachOutput::BeginSection(Section& sect)
 {
-    BytecodeOutput* outputter = this;
+    if (sect.isBSS())
+        return true;
 
+    unsigned long pos = m_os.tell();
+    if (m_os.has_error() || pos > sect.getFilePos())
+    {
+        Diag(SourceLocation(), diag::err_file_output_position);
+        return false;
+    }
+    // pad with zeros to section start
+    Bytes& scratch = getScratch();
+    scratch.Write(sect.getFilePos() - pos, 0);
+    m_os << scratch;
+    return true;
+}
+
+void
+MachOutput::OutputBytecodes(Section& sect)
+{
     MachSection* msect = sect.getAssocData<MachSection>();
     assert(msect != NULL);
     m_machsect = msect;
 
+    // Don't output BSS sections.
+    BytecodeOutput* outputter = this;
     if (sect.isBSS())
-    {
-        // Don't output BSS sections.
         outputter = &m_no_output;
-    }
-    else
-    {
-        unsigned long pos = m_os.tell();
-        if (m_os.has_error() || pos > sect.getFilePos())
-        {
-            Diag(SourceLocation(), diag::err_file_output_position);
-            return false;
-        }
-        // pad with zeros to section start
-        Bytes& scratch = getScratch();
-        scratch.Write(sect.getFilePos() - pos, 0);
-        m_os << scratch;
-    }
 
-    // Output bytecodes
     unsigned long size = 0;
     for (Section::bc_iterator i=sect.bytecodes_begin(),
          end=sect.bytecodes_end(); i != end; ++i)
@@ -489,15 +511,135 @@ MachOutput::OutputSection(Section& sect)
             size += i->getTotalLen();
     }
 
-    if (getDiagnostics().hasErrorOccurred())
+    // Sanity check final section size
+    assert(getDiagnostics().hasErrorOccurred() ||
+           size == sect.bytecodes_back().getNextOffset());
+}
+
+void
+MachOutput::MarkRequiredSymbols()
+{
+    for (std::vector<SymbolRef>::iterator i=m_required_syms.begin(),
+         end=m_required_syms.end(); i != end; ++i)
+    {
+        MachSymbol* msym = (*i)->getAssocData<MachSymbol>();
+        if (!msym)
+        {
+            msym = new MachSymbol;
+            (*i)->AddAssocData(std::auto_ptr<MachSymbol>(msym));
+        }
+        msym->m_required = true;
+    }
+    m_required_syms.clear();
+}
+
+bool
+MachOutput::OutputSection(Section& sect)
+{
+    if (!BeginSection(sect))
         return false;
 
-    // Sanity check final section size
-    assert(size == sect.bytecodes_back().getNextOffset());
+    OutputBytecodes(sect);
+    MarkRequiredSymbols();
+    return !getDiagnostics().hasErrorOccurred();
+}
 
-    return true;
+namespace {
+/// A section being encoded into memory on a worker thread.  Everything
+/// a job touches (diagnostics, scratch, relocations) belongs to its section.
+class MachSectionOutput
+{
+public:
+    MachSectionOutput(Section& sect,
+                      Object& object,
+                      DiagnosticsEngine& diags,
+                      SymbolRef gotpcrel_sym,
+                      bool is64,
+                      bool all_syms);
+    ~MachSectionOutput();
+
+    void Output() { m_out.OutputBytecodes(m_sect); m_os.close(); }
+
+    Section& m_sect;
+    DiagnosticBuffer m_diags;
+    std::vector<char> m_data;
+    OutputFileStream m_os;
+    MachOutput m_out;
+};
+} // anonymous namespace
+
+MachSectionOutput::MachSectionOutput(Section& sect,
+                                     Object& object,
+                                     DiagnosticsEngine& diags,
+                                     SymbolRef gotpcrel_sym,
+                                     bool is64,
+                                     bool all_syms)
+    : m_sect(sect)
+    , m_diags(diags)
+    , m_os(m_data)
+    , m_out(m_os, object, m_diags.getDiagnostics(), gotpcrel_sym, is64,
+            all_syms)
+{
 }
 
+MachSectionOutput::~MachSectionOutput()
+{
+}
+
+static void
+MachSectionOutputJob(stdx::ptr_vector<MachSectionOutput>& jobs, size_t i)
+{
+    jobs[i].Output();
+}
+
+void
+MachOutput::OutputSections(unsigned int num_jobs)
+{
+    if (num_jobs == 1 || m_object.getNumSections() <= 1)
+    {
+        for (Object::section_iterator i=m_object.sections_begin(),
+             end=m_object.sections_end(); i != end; ++i)
+        {
+            if (!OutputSection(*i))
+                return;
+        }
+        return;
+    }
+
+    // Encode each section into its own buffer.  The diagnostic engines
+    // must be created here as DiagnosticIDs is not reference counted in a
+    // thread-safe manner.
+    stdx::ptr_vector<MachSectionOutput> jobs;
+    stdx::ptr_vector_owner<MachSectionOutput> jobs_owner(jobs);
+    for (Object::section_iterator i=m_object.sections_begin(),
+         end=m_object.sections_end(); i != end; ++i)
+    {
+        jobs.push_back(new MachSectionOutput(*i, m_object, getDiagnostics(),
+                                             m_gotpcrel_sym, m_is64,
+                                             m_all_syms));
+    }
+
+    ThreadPool pool(num_jobs);
+    pool.Run(jobs.size(),
+             TR1::bind(&MachSectionOutputJob, TR1::ref(jobs), _1));
+
+    // Write the buffers out in section order, replaying diagnostics in the
+    // same order.  As in the serial path, stop at the first section with
+    // an error.
+    DiagnosticsEngine& diags = getDiagnostics();
+    for (stdx::ptr_vector<MachSectionOutput>::iterator i=jobs.begin(),
+         end=jobs.end(); i != end; ++i)
+    {
+        i->m_diags.Replay(diags);
+        i->m_out.MarkRequiredSymbols();
+        if (diags.hasErrorOccurred())
+            return;
+        if (!BeginSection(i->m_sect))
+            return;
+        if (!i->m_data.empty())
+            m_os.write(&i->m_data[0], i->m_data.size());
+    }
+}
 
 void
 MachOutput::OutputSectionRelocs(Section& sect, unsigned long* relocs_offset)
@@ -505,15 +647,17 @@ MachOutput::OutputSectionRelocs(Section& sect, unsigned long* relocs_offset)
     MachSection* msect = sect.getAssocData<MachSection>();
     assert(msect != 0);
 
+    // Encode the entire table, then write it out at once.
+    Bytes& scratch = getScratch();
+    scratch.reserve(RELINFO_SIZE * sect.getRelocs().size());
     for (Section::const_reloc_iterator i=sect.relocs_begin(),
          end=sect.relocs_end(); i != end; ++i)
     {
         const MachReloc& reloc = static_cast<const MachReloc&>(*i);
-        Bytes& scratch = getScratch();
         reloc.Write(scratch);
-        assert(scratch.size() == RELINFO_SIZE);
-        m_os << scratch;
     }
+    assert(scratch.size() == RELINFO_SIZE * sect.getRelocs().size());
+    m_os << scratch;
 
     msect->reloff = *relocs_offset;
     *relocs_offset += RELINFO_SIZE * sect.getRelocs().size();
@@ -617,35 +761,21 @@ MachOutput::OutputSegmentCommand(unsigned long total_vmsize,
     }
 }
 
-static inline bool
-MachSymbolIsInTable(const Symbol& sym)
-{
-    const MachSymbol* msym = sym.getAssocData<MachSymbol>();
-    return msym && msym->m_required;
-}
-
-static inline bool
-MachSymbolIsLocal(const Symbol& sym)
-{
-    const MachSymbol* msym = sym.getAssocData<MachSymbol>();
-    assert(msym);
-    return (msym->getType() & MachSymbol::N_EXT) == 0;
-}
-
-static inline bool
-MachSymbolIsDefined(const Symbol& sym)
-{
-    const MachSymbol* msym = sym.getAssocData<MachSymbol>();
-    assert(msym);
-    return (msym->getType() & MachSymbol::N_TYPE) != MachSymbol::N_UNDF;
-}
-
 void
 MachOutput::EnumerateSymbols()
 {
-    m_symtab_count = 0;
-
-    // finalize symbols (to determine type field, which is used for sorting)
+    // Finalize symbols (to determine the type field) and sort them into
+    // groups in a single pass.  This also gives us the indexes and counts
+    // needed for OutputDysymtabCommand().
+    // 1) local symbols, in definition order
+    // 2) external defined symbols, sorted by name
+    // 3) undefined symbols, sorted by name
+    //
+    // External symbols are sorted with their names alongside, which keeps
+    // the comparisons from chasing each symbol pointer.
+    typedef std::pair<StringRef, Symbol*> NamedSymbol;
+    std::vector<NamedSymbol> extdef, undef;
+    m_symtab.clear();
     for (Object::symbol_iterator i = m_object.symbols_begin(),
          end = m_object.symbols_end(); i != end; ++i)
     {
@@ -669,54 +799,51 @@ MachOutput::EnumerateSymbols()
         }
         msym->m_required = true;
         msym->Finalize(*i, getDiagnostics());
+
+        unsigned int type = msym->getType();
+        if ((type & MachSymbol::N_EXT) == 0)
+            m_symtab.push_back(&*i);
+        else if ((type & MachSymbol::N_TYPE) != MachSymbol::N_UNDF)
+            extdef.push_back(NamedSymbol(i->getName(), &*i));
+        else
+            undef.push_back(NamedSymbol(i->getName(), &*i));
     }
 
-    // Order symbols based on type field.  This also gives us the indexes
-    // and counts needed for OutputDysymtabCommand().
-    // 1) put table symbols before non-table
-    // 2) put local symbols before external
-    // 3) put external defined symbols before undefined
-    Object::symbol_iterator table_end =
-        stdx::stable_partition(m_object.symbols_begin(), m_object.symbols_end(),
-                               MachSymbolIsInTable);
-    Object::symbol_iterator extdef_begin =
-        stdx::stable_partition(m_object.symbols_begin(), table_end,
-                               MachSymbolIsLocal);
-    Object::symbol_iterator undef_begin =
-        stdx::stable_partition(extdef_begin, table_end, MachSymbolIsDefined);
+    // Names are unique, so the pointers never take part in the ordering.
+    std::sort(extdef.begin(), extdef.end());
+    std::sort(undef.begin(), undef.end());
 
     m_localsym_index = 0;
-    m_localsym_count = extdef_begin - m_object.symbols_begin();
+    m_localsym_count = m_symtab.size();
     m_extdefsym_index = m_localsym_count;
-    m_extdefsym_count = undef_begin - extdef_begin;
-    m_undefsym_index = undef_begin - m_object.symbols_begin();
-    m_undefsym_count = table_end - undef_begin;
+    m_extdefsym_count = extdef.size();
+    m_undefsym_index = m_extdefsym_index + m_extdefsym_count;
+    m_undefsym_count = undef.size();
+
+    m_symtab.reserve(m_symtab.size() + extdef.size() + undef.size());
+    for (std::vector<NamedSymbol>::const_iterator i = extdef.begin(),
+         end = extdef.end(); i != end; ++i)
+        m_symtab.push_back(i->second);
+    for (std::vector<NamedSymbol>::const_iterator i = undef.begin(),
+         end = undef.end(); i != end; ++i)
+        m_symtab.push_back(i->second);
 
     // number symbols
-    for (Object::symbol_iterator i = m_object.symbols_begin(),
-         end = m_object.symbols_end(); i != end; ++i)
-    {
-        MachSymbol* msym = i->getAssocData<MachSymbol>();
-        if (!msym || !msym->m_required)
-            continue;
-
-        msym->m_index = m_symtab_count++;
-    }
+    m_symtab_count = m_symtab.size();
+    for (unsigned long n = 0; n < m_symtab_count; ++n)
+        m_symtab[n]->getAssocData<MachSymbol>()->m_index = n;
 }
 
 void
 MachOutput::OutputSymbolTable()
 {
     m_symtab_offset = m_os.tell();
-    for (Object::symbol_iterator i = m_object.symbols_begin(),
-         end = m_object.symbols_end(); i != end; ++i)
+    for (std::vector<Symbol*>::const_iterator i = m_symtab.begin(),
+         end = m_symtab.end(); i != end; ++i)
     {
-        const MachSymbol* msym = i->getAssocData<MachSymbol>();
-        if (!msym || !msym->m_required)
-            continue;
-
+        const MachSymbol* msym = (*i)->getAssocData<MachSymbol>();
         Bytes& scratch = getScratch();
-        msym->Write(scratch, *i, m_strtab, m_longint_size);
+        msym->Write(scratch, **i, m_strtab, m_longint_size);
         assert(scratch.size() == m_nlist_size);
         m_os << scratch;
     }
@@ -785,7 +912,7 @@ MachIsNotZeroFill(const Section& sect)
 }
 
 void
-MachObject::Output(raw_fd_ostream& os,
+MachObject::Output(OutputFileStream& os,
                    bool all_syms,
                    DebugFormat& dbgfmt,
                    DiagnosticsEngine& diags)
@@ -860,12 +987,9 @@ MachObject::Output(raw_fd_ostream& os,
     }
 
     // output sections to file
-    for (Object::section_iterator i=m_object.sections_begin(),
-         end=m_object.sections_end(); i != end; ++i)
-    {
-        if (!out.OutputSection(*i))
-            return;
-    }
+    out.OutputSections(m_object.getConfig().NumJobs);
+    if (diags.hasErrorOccurred())
+        return;
 
     // number symbols before generating relocations
     out.EnumerateSymbols();
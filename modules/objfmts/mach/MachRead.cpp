@@ -0,0 +1,440 @@
+//
+// Mac OS X ABI Mach-O File Format reader
+//
+//  Copyright (C) 2026  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include "MachObject.h"
+
+#include <string>
+#include <vector>
+
+#include "llvm/Support/MemoryBuffer.h"
+#include "yasmx/Basic/Diagnostic.h"
+#include "yasmx/Basic/SourceManager.h"
+#include "yasmx/Bytecode.h"
+#include "yasmx/Bytes.h"
+#include "yasmx/Expr.h"
+#include "yasmx/InputBuffer.h"
+#include "yasmx/IntNum.h"
+#include "yasmx/Object.h"
+#include "yasmx/Section.h"
+#include "yasmx/StringTable.h"
+#include "yasmx/Symbol.h"
+#include "yasmx/Symbol_util.h"
+
+#include "MachReloc.h"
+#include "MachSection.h"
+#include "MachSymbol.h"
+
+// Mach-O file header values
+#define MH_MAGIC                0xfeedface
+#define MH_MAGIC_64             0xfeedfacf
+#define MH_OBJECT               0x1     // object file
+
+// CPU machine type
+#define CPU_TYPE_I386           7       // x86 platform
+#define CPU_TYPE_X86_64         (CPU_TYPE_I386|CPU_ARCH_ABI64)
+#define CPU_ARCH_ABI64          0x01000000      // 64 bit ABI
+
+#define LC_SEGMENT              0x1     // segment load command
+#define LC_SYMTAB               0x2     // symbol table load command
+#define LC_SEGMENT_64           0x19    // segment load command
+
+#define R_SCATTERED             0x80000000UL    // scattered relocation
+#define R_ABS                   0       // absolute relocation
+
+using namespace yasm;
+using namespace yasm::objfmt;
+
+/// Read the start of a Mach-O file header.
+/// @return 32 or 64 for a 32-bit or 64-bit x86 object file, 0 otherwise.
+static unsigned int
+ReadMachHeader(InputBuffer& inbuf)
+{
+    inbuf.setLittleEndian();
+    if (inbuf.getReadableSize() < 28)
+        return 0;
+
+    unsigned int bits;
+    unsigned long magic = ReadU32(inbuf);
+    unsigned long cputype = ReadU32(inbuf);
+    if (magic == MH_MAGIC && cputype == CPU_TYPE_I386)
+        bits = 32;
+    else if (magic == MH_MAGIC_64 && cputype == CPU_TYPE_X86_64)
+        bits = 64;
+    else
+        return 0;
+
+    ReadU32(inbuf);                 // cpu subtype
+    if (ReadU32(inbuf) != MH_OBJECT)
+        return 0;
+    return bits;
+}
+
+bool
+MachObject::TasteMach(const MemoryBuffer& in,
+                      unsigned int bits,
+                      /*@out@*/ std::string* arch_keyword,
+                      /*@out@*/ std::string* machine)
+{
+    InputBuffer inbuf(in);
+    if (ReadMachHeader(inbuf) != bits)
+        return false;
+    arch_keyword->assign("x86");
+    machine->assign(bits == 64 ? "amd64" : "x86");
+    return true;
+}
+
+static void
+NoAddSpan(Bytecode& bc,
+          int id,
+          const Value& value,
+          int64_t neg_thres,
+          int64_t pos_thres)
+{
+}
+
+/// Size a section with a single gap bytecode of the given length.
+static void
+AppendSizedGap(Section& sect, unsigned long size)
+{
+    Bytecode& gap = sect.AppendGap(size, SourceLocation());
+    IntrusiveRefCntPtr<DiagnosticIDs> diagids(new DiagnosticIDs);
+    DiagnosticsEngine nodiags(diagids);
+    gap.CalcLen(NoAddSpan, nodiags); // force length calculation
+}
+
+/// Get the symbol relocations use to refer to a section, creating it
+/// if needed.
+static SymbolRef
+getSectionSymbol(Object& object, Section& sect)
+{
+    SymbolRef sym = sect.getSymbol();
+    if (!sym)
+    {
+        sym = object.AppendSymbol(sect.getName());
+        Location loc = {&sect.bytecodes_front(), 0};
+        sym->DefineLabel(loc);
+        sect.setSymbol(sym);
+    }
+    return sym;
+}
+
+/// Get a 16-byte name field, which is NUL-terminated only if shorter.
+static StringRef
+ReadName(InputBuffer& inbuf)
+{
+    StringRef name = inbuf.ReadString(16);
+    return name.substr(0, name.find('\0'));
+}
+
+bool
+MachObject::Read(SourceManager& sm, DiagnosticsEngine& diags)
+{
+    const MemoryBuffer& in = *sm.getBuffer(sm.getMainFileID());
+    unsigned int parts = m_object.getConfig().ReadParts;
+    if ((parts & Object::READ_RELOCS) != 0)
+        parts |= Object::READ_SYMBOLS;  // relocs refer to symbols by index
+
+    // Read header
+    InputBuffer inbuf(in);
+    unsigned int bits = ReadMachHeader(inbuf);
+    if (bits == 0)
+    {
+        diags.Report(SourceLocation(), diag::err_not_file_type) << "Mach-O";
+        return false;
+    }
+    const int long_int_size = bits/8;
+    unsigned long ncmds = ReadU32(inbuf);
+    ReadU32(inbuf);                 // size of commands
+    ReadU32(inbuf);                 // flags
+    if (bits == 64)
+        ReadU32(inbuf);             // reserved
+
+    // Walk the load commands, creating sections as they're found.
+    std::vector<Section*> sections;     // by section number - 1
+    std::vector<unsigned long> nrelocs;
+    unsigned long symoff = 0, nsyms = 0, stroff = 0, strsize = 0;
+    for (unsigned long i=0; i<ncmds; ++i)
+    {
+        size_t cmd_pos = inbuf.getPosition();
+        if (inbuf.getReadableSize() < 8)
+        {
+            diags.Report(SourceLocation(),
+                         diag::err_object_header_unreadable);
+            return false;
+        }
+        unsigned long cmd = ReadU32(inbuf);
+        unsigned long cmdsize = ReadU32(inbuf);
+        if (cmdsize < 8 || inbuf.getReadableSize() < cmdsize-8)
+        {
+            diags.Report(SourceLocation(),
+                         diag::err_object_header_unreadable);
+            return false;
+        }
+
+        if (cmd == LC_SYMTAB)
+        {
+            symoff = ReadU32(inbuf);
+            nsyms = ReadU32(inbuf);
+            stroff = ReadU32(inbuf);
+            strsize = ReadU32(inbuf);
+        }
+        else if ((bits == 32 && cmd == LC_SEGMENT) ||
+                 (bits == 64 && cmd == LC_SEGMENT_64))
+        {
+            inbuf.setPosition(inbuf.getPosition() + 16 + 4*long_int_size
+                              + 8);     // name, addresses, protection
+            unsigned long nsects = ReadU32(inbuf);
+            ReadU32(inbuf);             // flags
+
+            for (unsigned long j=0; j<nsects; ++j)
+            {
+                std::string sectname = ReadName(inbuf);
+                std::string segname = ReadName(inbuf);
+                unsigned long addr =
+                    ReadUnsigned(inbuf, long_int_size*8).getUInt();
+                unsigned long size =
+                    ReadUnsigned(inbuf, long_int_size*8).getUInt();
+                unsigned long offset = ReadU32(inbuf);
+                unsigned long align = ReadU32(inbuf);
+                unsigned long reloff = ReadU32(inbuf);
+                unsigned long nreloc = ReadU32(inbuf);
+                unsigned long flags = ReadU32(inbuf);
+                ReadU32(inbuf);         // reserved1
+                ReadU32(inbuf);         // reserved2
+                if (bits == 64)
+                    ReadU32(inbuf);     // reserved3
+
+                unsigned long type = flags & MachSection::SECTION_TYPE;
+                bool bss = type == MachSection::S_ZEROFILL ||
+                    type == MachSection::S_GB_ZEROFILL;
+                bool code = (flags & (MachSection::S_ATTR_PURE_INSTRUCTIONS |
+                    MachSection::S_ATTR_SOME_INSTRUCTIONS)) != 0;
+                std::auto_ptr<Section> section(new Section(
+                    getSectionName(segname, sectname), code, bss,
+                    SourceLocation()));
+                section->setFilePos(offset);
+                section->setVMA(addr);
+                section->setLMA(addr);
+                section->setAlign(align < 32 ? 1UL << align : 0);
+
+                if (bss || (parts & Object::READ_CONTENTS) == 0)
+                    AppendSizedGap(*section, size);
+                else
+                {
+                    StringRef data = in.getBuffer().substr(offset, size);
+                    if (data.size() < size)
+                    {
+                        diags.Report(SourceLocation(),
+                                     diag::err_section_data_unreadable)
+                            << section->getName();
+                        return false;
+                    }
+                    section->bytecodes_front().getFixed().WriteString(data);
+                }
+
+                std::auto_ptr<MachSection> msect(
+                    new MachSection(segname, sectname));
+                msect->scnum = sections.size();
+                msect->flags = flags;
+                msect->size = size;
+                msect->extreloc = (flags & MachSection::S_ATTR_EXT_RELOC) != 0;
+                msect->reloff = reloff;
+                section->AddAssocData(msect);
+
+                sections.push_back(section.get());
+                nrelocs.push_back(nreloc);
+                m_object.AppendSection(section);
+            }
+        }
+        inbuf.setPosition(cmd_pos + cmdsize);
+    }
+
+    if ((parts & Object::READ_SYMBOLS) == 0)
+        return true;
+
+    // Read symbol table.  Debugging entries have no symbol.
+    StringTable strtab;
+    StringRef strbuf = in.getBuffer().substr(stroff, strsize);
+    if (strbuf.size() < strsize)
+    {
+        diags.Report(SourceLocation(), diag::err_string_table_unreadable);
+        return false;
+    }
+    strtab.Read(strbuf);
+
+    const unsigned long nlist_size = 8 + long_int_size;
+    std::vector<SymbolRef> symtab;
+    symtab.reserve(nsyms);
+    inbuf.setPosition(symoff);
+    if (inbuf.getReadableSize() / nlist_size < nsyms)
+    {
+        diags.Report(SourceLocation(), diag::err_symbol_unreadable);
+        return false;
+    }
+    for (unsigned long i=0; i<nsyms; ++i)
+    {
+        unsigned long strx = ReadU32(inbuf);
+        unsigned int n_type = ReadU8(inbuf);
+        unsigned int n_sect = ReadU8(inbuf);
+        unsigned int n_desc = ReadU16(inbuf);
+        IntNum value = ReadUnsigned(inbuf, long_int_size*8);
+
+        if ((n_type & MachSymbol::N_STAB) != 0)
+        {
+            symtab.push_back(SymbolRef(0));
+            continue;
+        }
+        if (strx >= strsize)
+        {
+            diags.Report(SourceLocation(), diag::err_invalid_string_offset);
+            return false;
+        }
+        std::string name = strtab.getString(strx);
+
+        SymbolRef sym(0);
+        unsigned int type = n_type & MachSymbol::N_TYPE;
+        if ((n_type & MachSymbol::N_EXT) != 0)
+        {
+            sym = m_object.getSymbol(name);
+            if (type != MachSymbol::N_UNDF)
+                sym->Declare(Symbol::GLOBAL);
+            else if (!value.isZero())
+            {
+                sym->Declare(Symbol::COMMON);
+                setCommonSize(*sym, Expr(value));
+            }
+            else
+                sym->Declare(Symbol::EXTERN);
+        }
+        else
+            sym = m_object.AppendSymbol(name);  // don't index by name
+
+        if (type == MachSymbol::N_SECT && n_sect != MachSymbol::NO_SECT &&
+            n_sect <= sections.size())
+        {
+            Section* sect = sections[n_sect-1];
+            value -= sect->getVMA();
+            Location loc = {&sect->bytecodes_front(), value.getUInt()};
+            sym->DefineLabel(loc);
+        }
+        else if (type == MachSymbol::N_ABS)
+            sym->DefineEqu(Expr(value));
+
+        std::auto_ptr<MachSymbol> msym(new MachSymbol);
+        msym->m_private_extern = (n_type & MachSymbol::N_PEXT) != 0;
+        msym->m_no_dead_strip = (n_desc & MachSymbol::N_NO_DEAD_STRIP) != 0;
+        msym->m_weak_ref = (n_desc & MachSymbol::N_WEAK_REF) != 0;
+        msym->m_weak_def = (n_desc & MachSymbol::N_WEAK_DEF) != 0;
+        msym->m_alt_entry = (n_desc & MachSymbol::N_ALT_ENTRY) != 0;
+        msym->m_ref_flag = n_desc & MachSymbol::REFERENCE_TYPE;
+        msym->m_required = true;
+        msym->m_index = i;
+        sym->AddAssocData(msym);
+        symtab.push_back(sym);
+    }
+
+    if ((parts & Object::READ_RELOCS) == 0)
+        return true;
+
+    // Read relocations.  Relocations not against a symbol are against a
+    // section (or, if scattered, an address within one); these refer to
+    // a symbol for the start of the section.
+    for (std::vector<Section*>::size_type i=0; i<sections.size(); ++i)
+    {
+        Section& sect = *sections[i];
+        const MachSection* msect = sect.getAssocData<MachSection>();
+        inbuf.setPosition(msect->reloff);
+        if (inbuf.getReadableSize() / 8 < nrelocs[i])
+        {
+            diags.Report(SourceLocation(), diag::err_section_relocs_unreadable)
+                << sect.getName();
+            return false;
+        }
+
+        for (unsigned long j=0; j<nrelocs[i]; ++j)
+        {
+            unsigned long word0 = ReadU32(inbuf);
+            unsigned long word1 = ReadU32(inbuf);
+
+            IntNum addr;
+            SymbolRef sym(0);
+            MachReloc::Type type;
+            bool pcrel, ext = false;
+            unsigned int length;
+            if ((word0 & R_SCATTERED) != 0)
+            {
+                addr = word0 & 0x00ffffffUL;
+                type = static_cast<MachReloc::Type>((word0 >> 24) & 0xf);
+                length = (word0 >> 28) & 3;
+                pcrel = ((word0 >> 30) & 1) != 0;
+                for (std::vector<Section*>::iterator s=sections.begin(),
+                     end=sections.end(); s != end; ++s)
+                {
+                    unsigned long vma = (*s)->getVMA().getUInt();
+                    if (word1 >= vma &&
+                        word1 - vma <= (*s)->bytecodes_back().getNextOffset())
+                    {
+                        sym = getSectionSymbol(m_object, **s);
+                        break;
+                    }
+                }
+            }
+            else
+            {
+                addr = word0;
+                unsigned long symnum = word1 & 0x00ffffffUL;
+                pcrel = ((word1 >> 24) & 1) != 0;
+                length = (word1 >> 25) & 3;
+                ext = ((word1 >> 27) & 1) != 0;
+                type = static_cast<MachReloc::Type>((word1 >> 28) & 0xf);
+                if (ext && symnum < symtab.size())
+                    sym = symtab[symnum];
+                else if (!ext && symnum == R_ABS)
+                    continue;
+                else if (!ext && symnum <= sections.size())
+                    sym = getSectionSymbol(m_object, *sections[symnum-1]);
+            }
+
+            if (!sym)
+            {
+                diags.Report(SourceLocation(),
+                             diag::err_section_relocs_unreadable)
+                    << sect.getName();
+                return false;
+            }
+
+            Reloc* reloc;
+            if (bits == 64)
+                reloc = new (sect) Mach64Reloc(addr, sym, type, pcrel, length,
+                                               ext);
+            else
+                reloc = new (sect) Mach32Reloc(addr, sym, type, pcrel, length,
+                                               ext);
+            sect.AddReloc(std::auto_ptr<Reloc>(reloc));
+        }
+    }
+    return true;
+}
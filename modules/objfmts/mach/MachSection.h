@@ -45,6 +45,7 @@ namespace objfmt
 struct YASM_STD_EXPORT MachSection : public AssocData
 {
     static const char* key;
+    static const bool inline_slot = true;
 
     MachSection(StringRef segname_, StringRef sectname_);
     ~MachSection();
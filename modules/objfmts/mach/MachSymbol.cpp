@@ -64,6 +64,7 @@ MachSymbol::MachSymbol()
     , m_no_dead_strip(false)
     , m_weak_ref(false)
     , m_weak_def(false)
+    , m_alt_entry(false)
     , m_ref_flag(REFERENCE_TYPE)
     , m_required(false)
     , m_index(0)
@@ -189,6 +190,8 @@ MachSymbol::Finalize(const Symbol& sym, DiagnosticsEngine& diags)
             n_desc |= N_NO_DEAD_STRIP;
         if (m_weak_def)
             n_desc |= N_WEAK_DEF;
+        if (m_alt_entry && (n_type & N_TYPE) == N_SECT)
+            n_desc |= N_ALT_ENTRY;
         if (m_ref_flag != REFERENCE_TYPE && (n_type & N_TYPE) == N_UNDF)
         {
             n_desc |= m_ref_flag & REFERENCE_TYPE;
@@ -45,6 +45,7 @@ namespace objfmt
 struct YASM_STD_EXPORT MachSymbol : public AssocData
 {
     static const char* key;
+    static const bool inline_slot = true;
 
     static MachSymbol& Build(Symbol& sym);
 
@@ -92,7 +93,8 @@ struct YASM_STD_EXPORT MachSymbol : public AssocData
         // other flags
         N_NO_DEAD_STRIP = 0x0020,   // symbol is not to be dead stripped
         N_WEAK_REF      = 0x0040,   // symbol is weak referenced
-        N_WEAK_DEF      = 0x0080    // coalesced symbol is a weak definition
+        N_WEAK_DEF      = 0x0080,   // coalesced symbol is a weak definition
+        N_ALT_ENTRY     = 0x0200    // symbol doesn't start a new atom
     };
 
     void setDesc(unsigned int desc)
@@ -109,6 +111,7 @@ struct YASM_STD_EXPORT MachSymbol : public AssocData
     bool m_no_dead_strip;       // don't dead strip symbol
     bool m_weak_ref;            // weak referenced
     bool m_weak_def;            // weak definition
+    bool m_alt_entry;           // alternate entry point into preceding atom
     unsigned int m_ref_flag;    // reference flag
 
     // Symbol is required to be in symbol table, e.g. if it's used in a reloc.
@@ -33,6 +33,7 @@
 #include "yasmx/Parse/Directive.h"
 #include "yasmx/Parse/DirHelpers.h"
 #include "yasmx/Parse/NameValue.h"
+#include "yasmx/Support/OutputFileStream.h"
 #include "yasmx/Support/bitcount.h"
 #include "yasmx/Support/registry.h"
 #include "yasmx/Arch.h"
@@ -94,7 +95,10 @@ public:
     void OutputSectionRelocs(const Section& sect);
     void OutputSectionToFile(const Section& sect);
 
-    void OutputSymbol(Symbol& sym, bool all_syms, unsigned int* indx);
+    void OutputSymbol(Symbol& sym,
+                      bool all_syms,
+                      unsigned int* indx,
+                      Bytes& records);
 
     void OutputBSS();
 
@@ -102,8 +106,9 @@ public:
     bool ConvertValueToBytes(Value& value,
                              Location loc,
                              NumericOutput& num_out);
-    void DoOutputGap(unsigned long size, SourceLocation source);
+    void DoOutputGap(uint64_t size, SourceLocation source);
     void DoOutputBytes(const Bytes& bytes, SourceLocation source);
+    void DoOutputRaw(StringRef data, SourceLocation source);
 
 private:
     raw_ostream& m_os;
@@ -123,6 +128,8 @@ RdfOutput::RdfOutput(raw_ostream& os, Object& object, DiagnosticsEngine& diags)
     , m_no_output(diags)
     , m_bss_size(0)
 {
+    setListFormat(object.getListFormat());
+    m_no_output.setListFormat(object.getListFormat());
 }
 
 RdfOutput::~RdfOutput()
@@ -207,7 +214,8 @@ RdfOutput::ConvertValueToBytes(Value& value,
         }
 
         sect->AddReloc(std::auto_ptr<Reloc>(
-            new RdfReloc(addr, sym, type, value.getSize()/8, refseg)));
+            new (*sect) RdfReloc(addr, sym, type, value.getSize()/8,
+                                 refseg)));
     }
 
     num_out.OutputInteger(intn);
@@ -215,7 +223,7 @@ RdfOutput::ConvertValueToBytes(Value& value,
 }
 
 void
-RdfOutput::DoOutputGap(unsigned long size, SourceLocation source)
+RdfOutput::DoOutputGap(uint64_t size, SourceLocation source)
 {
     Diag(source, diag::warn_uninit_zero);
     m_rdfsect->raw_data.insert(m_rdfsect->raw_data.end(), size, 0);
@@ -228,6 +236,13 @@ RdfOutput::DoOutputBytes(const Bytes& bytes, SourceLocation source)
                                bytes.end());
 }
 
+void
+RdfOutput::DoOutputRaw(StringRef data, SourceLocation source)
+{
+    m_rdfsect->raw_data.insert(m_rdfsect->raw_data.end(), data.begin(),
+                               data.end());
+}
+
 void
 RdfOutput::OutputSectionToMemory(Section& sect)
 {
@@ -276,15 +291,18 @@ RdfOutput::OutputSectionRelocs(const Section& sect)
     if (sect.getRelocs().size() == 0)
         return;
 
+    // Encode all the section's relocation records, then write them out at
+    // once.
+    Bytes& scratch = getScratch();
+    scratch.reserve(10 * sect.getRelocs().size());
     for (Section::const_reloc_iterator i=sect.relocs_begin(),
          end=sect.relocs_end(); i != end; ++i)
     {
         const RdfReloc& reloc = static_cast<const RdfReloc&>(*i);
-        Bytes& scratch = getScratch();
         reloc.Write(scratch, rdfsect->scnum);
-        assert(scratch.size() == 10);
-        m_os << scratch;
     }
+    assert(scratch.size() == 10 * sect.getRelocs().size());
+    m_os << scratch;
 }
 
 void
@@ -334,7 +352,7 @@ ParseFlags(Symbol& sym, DiagnosticsEngine& diags)
     int vis = sym.getVisibility();
 
     NameValues* objext_nvs = getObjextNameValues(sym);
-    if (!objext_nvs)
+    if (!objext_nvs || objext_nvs->empty())
         return 0;
 
     DirHelpers helpers;
@@ -369,7 +387,10 @@ ParseFlags(Symbol& sym, DiagnosticsEngine& diags)
 }
 
 void
-RdfOutput::OutputSymbol(Symbol& sym, bool all_syms, unsigned int* indx)
+RdfOutput::OutputSymbol(Symbol& sym,
+                        bool all_syms,
+                        unsigned int* indx,
+                        Bytes& records)
 {
     int vis = sym.getVisibility();
 
@@ -405,7 +426,7 @@ RdfOutput::OutputSymbol(Symbol& sym, bool all_syms, unsigned int* indx)
         len = EXIM_LABEL_MAX-1;
     }
 
-    Bytes& bytes = getScratch();
+    Bytes& bytes = records;
     bytes.setLittleEndian();
     if (vis & Symbol::GLOBAL)
     {
@@ -502,8 +523,6 @@ RdfOutput::OutputSymbol(Symbol& sym, bool all_syms, unsigned int* indx)
     // Symbol name
     bytes.insert(bytes.end(), name.begin(), name.begin()+len);
     Write8(bytes, 0);           // 0-terminated name
-
-    m_os << bytes;
 }
 
 void
@@ -521,7 +540,7 @@ RdfOutput::OutputBSS()
 }
 
 void
-RdfObject::Output(raw_fd_ostream& os,
+RdfObject::Output(OutputFileStream& os,
                   bool all_syms,
                   DebugFormat& dbgfmt,
                   DiagnosticsEngine& diags)
@@ -567,11 +586,15 @@ RdfObject::Output(raw_fd_ostream& os,
         os << *i << '\0';                       // 0-terminated name
     }
 
-    // Output symbol table
-    for (Object::symbol_iterator sym = m_object.symbols_begin(),
-         end = m_object.symbols_end(); sym != end; ++sym)
+    // Output symbol table; the records are collected and written at once.
     {
-        out.OutputSymbol(*sym, all_syms, &scnum);
+        Bytes records;
+        for (Object::symbol_iterator sym = m_object.symbols_begin(),
+             end = m_object.symbols_end(); sym != end; ++sym)
+        {
+            out.OutputSymbol(*sym, all_syms, &scnum, records);
+        }
+        os << records;
     }
 
     // UGH! Due to the fact the relocs go at the beginning of the file, and
@@ -680,8 +703,8 @@ static void
 NoAddSpan(Bytecode& bc,
           int id,
           const Value& value,
-          long neg_thres,
-          long pos_thres)
+          int64_t neg_thres,
+          int64_t pos_thres)
 {
 }
 
@@ -945,7 +968,7 @@ RdfObject::Read(SourceManager& sm, DiagnosticsEngine& diags)
                     return false;
                 }
                 sect.AddReloc(std::auto_ptr<Reloc>(
-                    new RdfReloc(addr, sym, rtype, size, refseg)));
+                    new (sect) RdfReloc(addr, sym, rtype, size, refseg)));
                 break;
             }
             default:
@@ -1175,9 +1198,9 @@ static const yasm_stdmac rdf_objfmt_stdmacs[] = {
 };
 #endif
 
-void
-yasm_objfmt_rdf_DoRegister()
+extern const yasm::impl::ModuleEntry yasm_objfmt_rdf_modules[] =
 {
-    RegisterModule<ObjectFormatModule,
-                   ObjectFormatModuleImpl<RdfObject> >("rdf");
-}
+    YASM_MODULE_ENTRY(ObjectFormatModule,
+                      ObjectFormatModuleImpl<RdfObject>, "rdf"),
+    YASM_MODULE_TABLE_END
+};
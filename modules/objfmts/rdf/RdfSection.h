@@ -47,6 +47,7 @@ namespace objfmt
 struct YASM_STD_EXPORT RdfSection : public AssocData
 {
     static const char* key;
+    static const bool inline_slot = true;
 
     enum { SECTHEAD_SIZE = 10 };
 
@@ -38,6 +38,7 @@ namespace objfmt
 struct YASM_STD_EXPORT RdfSymbol : public AssocData
 {
     static const char* key;
+    static const bool inline_slot = true;
 
     RdfSymbol(unsigned long segment_) : segment(segment_) {}
     ~RdfSymbol();
@@ -26,6 +26,8 @@
 //
 #include "SxData.h"
 
+#include <vector>
+
 #include "yasmx/BytecodeContainer.h"
 #include "yasmx/BytecodeOutput.h"
 #include "yasmx/Bytecode.h"
@@ -38,18 +40,23 @@ using namespace yasm;
 using namespace yasm::objfmt;
 
 namespace {
+/// Consecutive SAFESEH handlers share a single bytecode, one 32-bit symbol
+/// index per handler.
 class SxData : public Bytecode::Contents
 {
 public:
     SxData(SymbolRef sym);
     ~SxData();
 
+    /// Add another handler.
+    void Add(SymbolRef sym) { m_syms.push_back(sym); }
+
     /// Finalizes the bytecode after parsing.
     bool Finalize(Bytecode& bc, DiagnosticsEngine& diags);
 
     /// Calculates the minimum size of a bytecode.
     bool CalcLen(Bytecode& bc,
-                 /*@out@*/ unsigned long* len,
+                 /*@out@*/ uint64_t* len,
                  const Bytecode::AddSpanFunc& add_span,
                  DiagnosticsEngine& diags);
 
@@ -66,12 +73,12 @@ public:
 #endif // WITH_XML
 
 private:
-    SymbolRef m_sym;            ///< symbol
+    std::vector<SymbolRef> m_syms;  ///< handler symbols
 };
 } // anonymous namespace
 
 SxData::SxData(SymbolRef sym)
-    : m_sym(sym)
+    : m_syms(1, sym)
 {
 }
 
@@ -87,23 +94,27 @@ SxData::Finalize(Bytecode& bc, DiagnosticsEngine& diags)
 
 bool
 SxData::CalcLen(Bytecode& bc,
-                /*@out@*/ unsigned long* len,
+                /*@out@*/ uint64_t* len,
                 const Bytecode::AddSpanFunc& add_span,
                 DiagnosticsEngine& diags)
 {
-    *len = 4;
+    *len = 4*m_syms.size();
     return true;
 }
 
 bool
 SxData::Output(Bytecode& bc, BytecodeOutput& bc_out)
 {
-    CoffSymbol* coffsym = m_sym->getAssocData<CoffSymbol>();
-    assert(coffsym && "no symbol data for SAFESEH symbol");
-
     Bytes& bytes = bc_out.getScratch();
     bytes.setLittleEndian();
-    Write32(bytes, coffsym->m_index);
+    bytes.reserve(4*m_syms.size());
+    for (std::vector<SymbolRef>::const_iterator i=m_syms.begin(),
+         end=m_syms.end(); i != end; ++i)
+    {
+        const CoffSymbol* coffsym = (*i)->getAssocData<CoffSymbol>();
+        assert(coffsym && "no symbol data for SAFESEH symbol");
+        Write32(bytes, coffsym->m_index);
+    }
     bc_out.OutputBytes(bytes, bc.getSource());
     return true;
 }
@@ -117,7 +128,7 @@ SxData::getType() const
 SxData*
 SxData::clone() const
 {
-    return new SxData(m_sym);
+    return new SxData(*this);
 }
 
 #ifdef WITH_XML
@@ -125,7 +136,9 @@ pugi::xml_node
 SxData::Write(pugi::xml_node out) const
 {
     pugi::xml_node root = out.append_child("SxData");
-    append_child(root, "Sym", m_sym);
+    for (std::vector<SymbolRef>::const_iterator i=m_syms.begin(),
+         end=m_syms.end(); i != end; ++i)
+        append_child(root, "Sym", *i);
     return root;
 }
 #endif // WITH_XML
@@ -135,6 +148,15 @@ objfmt::AppendSxData(BytecodeContainer& container,
                      SymbolRef sym,
                      SourceLocation source)
 {
+    // Extend the previous entry's bytecode if nothing was added after it.
+    Bytecode& last = container.bytecodes_back();
+    if (last.hasContents() &&
+        last.getContents().getType() == "yasm::objfmt::SxData")
+    {
+        static_cast<SxData&>(last.getContents()).Add(sym);
+        return;
+    }
+
     Bytecode& bc = container.FreshBytecode();
     bc.Transform(Bytecode::Contents::Ptr(new SxData(sym)));
     bc.setSource(source);
@@ -322,9 +322,9 @@ static const yasm_stdmac win32_objfmt_stdmacs[] =
 };
 #endif
 
-void
-yasm_objfmt_win32_DoRegister()
+extern const yasm::impl::ModuleEntry yasm_objfmt_win32_modules[] =
 {
-    RegisterModule<ObjectFormatModule,
-                   ObjectFormatModuleImpl<Win32Object> >("win32");
-}
+    YASM_MODULE_ENTRY(ObjectFormatModule,
+                      ObjectFormatModuleImpl<Win32Object>, "win32"),
+    YASM_MODULE_TABLE_END
+};
@@ -46,7 +46,6 @@ public:
     virtual void InitSymbols(StringRef parser);
 
     //virtual void InitSymbols()
-    //virtual void Read()
     //virtual void Output()
 
     static StringRef getName() { return "Win32"; }
@@ -63,7 +62,7 @@ public:
     static bool Taste(const MemoryBuffer& in,
                       /*@out@*/ std::string* arch_keyword,
                       /*@out@*/ std::string* machine)
-    { return false; }
+    { return TasteCoff(in, true, MACHINE_I386, arch_keyword, machine); }
 
 protected:
     virtual bool InitSection(StringRef name,
@@ -32,6 +32,7 @@
 #include "yasmx/Bytes.h"
 #include "yasmx/Bytes_util.h"
 #include "yasmx/Expr.h"
+#include "yasmx/IntNum.h"
 #include "yasmx/Symbol.h"
 
 
@@ -52,7 +53,7 @@ UnwindCode::Finalize(Bytecode& bc, DiagnosticsEngine& diags)
 
 bool
 UnwindCode::CalcLen(Bytecode& bc,
-                    /*@out@*/ unsigned long* len,
+                    /*@out@*/ uint64_t* len,
                     const Bytecode::AddSpanFunc& add_span,
                     DiagnosticsEngine& diags)
 {
@@ -138,13 +139,13 @@ UnwindCode::CalcLen(Bytecode& bc,
 
 bool
 UnwindCode::Expand(Bytecode& bc,
-                   unsigned long* len,
+                   uint64_t* len,
                    int span,
-                   long old_val,
-                   long new_val,
+                   int64_t old_val,
+                   int64_t new_val,
                    bool* keep,
-                   /*@out@*/ long* neg_thres,
-                   /*@out@*/ long* pos_thres,
+                   /*@out@*/ int64_t* neg_thres,
+                   /*@out@*/ int64_t* pos_thres,
                    DiagnosticsEngine& diags)
 {
     if (new_val < 0)
@@ -195,6 +196,23 @@ UnwindCode::Output(Bytecode& bc, BytecodeOutput& bc_out)
 {
     Bytes& bytes = bc_out.getScratch();
 
+    IntNum intn;
+    if (!m_off.getIntNum(&intn, true, bc_out.getDiagnostics()))
+    {
+        bc_out.Diag(m_off.getSource().getBegin(),
+                    diag::err_too_complex_expression);
+        return false;
+    }
+
+    if (!Encode(bytes, intn, bc_out.getDiagnostics()))
+        return false;
+    bc_out.OutputBytes(bytes, bc.getSource());
+    return true;
+}
+
+bool
+UnwindCode::Encode(Bytes& bytes, IntNum& intn, DiagnosticsEngine& diags)
+{
     // Offset value
     unsigned int size;
     int shift;
@@ -241,24 +259,16 @@ UnwindCode::Output(Bytecode& bc, BytecodeOutput& bc_out)
     }
 
     // Check for overflow
-    IntNum intn;
-    if (!m_off.getIntNum(&intn, true, bc_out.getDiagnostics()))
-    {
-        bc_out.Diag(m_off.getSource().getBegin(),
-                    diag::err_too_complex_expression);
-        return false;
-    }
-
     if (size != 4 && !intn.isInRange(low, high))
     {
-        bc_out.Diag(m_off.getSource().getBegin(), diag::err_offset_out_of_range)
+        diags.Report(m_off.getSource().getBegin(), diag::err_offset_out_of_range)
             << intn.getStr() << static_cast<int>(low) << static_cast<int>(high);
         return false;
     }
 
     if ((intn.getUInt() & mask) != 0)
     {
-        bc_out.Diag(m_off.getSource().getBegin(), diag::err_offset_not_multiple)
+        diags.Report(m_off.getSource().getBegin(), diag::err_offset_not_multiple)
             << intn.getStr() << static_cast<int>(mask+1);
         return false;
     }
@@ -276,7 +286,6 @@ UnwindCode::Output(Bytecode& bc, BytecodeOutput& bc_out)
         Write16(bytes, intn);
     else if (size == 4)
         Write32(bytes, intn);
-    bc_out.OutputBytes(bytes, bc.getSource());
     return true;
 }
 
@@ -320,9 +329,17 @@ UnwindCode::Write(pugi::xml_node out) const
 }
 #endif // WITH_XML
 
-void
+// A known offset never moves, so there is nothing for a span to track.
+static void
+IgnoreSpan(Bytecode& bc, int id, const Value& value, int64_t neg_thres,
+           int64_t pos_thres)
+{
+}
+
+bool
 objfmt::AppendUnwindCode(BytecodeContainer& container,
-                         std::auto_ptr<UnwindCode> uwcode)
+                         std::auto_ptr<UnwindCode> uwcode,
+                         DiagnosticsEngine& diags)
 {
     // Offset in prolog
     Bytecode& bc = container.FreshBytecode();
@@ -335,13 +352,26 @@ objfmt::AppendUnwindCode(BytecodeContainer& container,
         case UnwindCode::SET_FPREG:
         case UnwindCode::PUSH_MACHFRAME:
             // just 1 node, no offset; write opcode and info and we're done
-            AppendByte(container,
-                       (uwcode->m_info << 4) | (uwcode->m_opcode & 0xF));
-            return;
+            Write8(bc.getFixed(),
+                   (uwcode->m_info << 4) | (uwcode->m_opcode & 0xF));
+            return true;
         default:
             break;
     }
 
+    // If the offset is already known (the usual case), pick the encoding
+    // now and append it as fixed data.  Consecutive codes then share one
+    // bytecode and don't participate in optimization.
+    IntNum intn;
+    if (uwcode->m_off.getIntNum(&intn, false, diags))
+    {
+        unsigned long len;
+        if (!uwcode->CalcLen(bc, &len, IgnoreSpan, diags))
+            return false;
+        return uwcode->Encode(bc.getFixed(), intn, diags);
+    }
+
     bc.setSource(uwcode->m_loc->getDefSource());
     bc.Transform(Bytecode::Contents::Ptr(uwcode));
+    return true;
 }
@@ -45,8 +45,9 @@ namespace objfmt
 class YASM_STD_EXPORT UnwindCode : public Bytecode::Contents
 {
     friend YASM_STD_EXPORT
-        void AppendUnwindCode(BytecodeContainer& container,
-                              std::auto_ptr<UnwindCode> uwcode);
+        bool AppendUnwindCode(BytecodeContainer& container,
+                              std::auto_ptr<UnwindCode> uwcode,
+                              DiagnosticsEngine& diags);
 
 public:
     // Operation codes
@@ -93,17 +94,17 @@ public:
 
     virtual bool Finalize(Bytecode& bc, DiagnosticsEngine& diags);
     virtual bool CalcLen(Bytecode& bc,
-                         /*@out@*/ unsigned long* len,
+                         /*@out@*/ uint64_t* len,
                          const Bytecode::AddSpanFunc& add_span,
                          DiagnosticsEngine& diags);
     virtual bool Expand(Bytecode& bc,
-                        unsigned long* len,
+                        uint64_t* len,
                         int span,
-                        long old_val,
-                        long new_val,
+                        int64_t old_val,
+                        int64_t new_val,
                         bool* keep,
-                        /*@out@*/ long* neg_thres,
-                        /*@out@*/ long* pos_thres,
+                        /*@out@*/ int64_t* neg_thres,
+                        /*@out@*/ int64_t* pos_thres,
                         DiagnosticsEngine& diags);
     virtual bool Output(Bytecode& bc, BytecodeOutput& bc_out);
     StringRef getType() const;
@@ -113,6 +114,10 @@ public:
 #endif // WITH_XML
 
 private:
+    /// Encode the code and info node and any offset nodes.
+    /// @param off      offset value
+    bool Encode(Bytes& bytes, IntNum& off, DiagnosticsEngine& diags);
+
     SymbolRef m_proc;       // Start of procedure
     SymbolRef m_loc;        // Location of operation
 
@@ -121,9 +126,14 @@ private:
     Value m_off;            // Offset expression (used for some codes)
 };
 
+/// Append an unwind code to a container.  If the offset is already known,
+/// the code is encoded directly into fixed data rather than becoming a
+/// span-dependent bytecode.
+/// @return False if the offset was known and invalid.
 YASM_STD_EXPORT
-void AppendUnwindCode(BytecodeContainer& container,
-                      std::auto_ptr<UnwindCode> uwcode);
+bool AppendUnwindCode(BytecodeContainer& container,
+                      std::auto_ptr<UnwindCode> uwcode,
+                      DiagnosticsEngine& diags);
 
 }} // namespace yasm::objfmt
 
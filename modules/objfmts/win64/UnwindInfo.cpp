@@ -32,6 +32,7 @@
 #include "yasmx/Bytes.h"
 #include "yasmx/Bytes_util.h"
 #include "yasmx/Expr.h"
+#include "yasmx/Location.h"
 #include "yasmx/Symbol.h"
 
 
@@ -76,16 +77,18 @@ UnwindInfo::Finalize(Bytecode& bc, DiagnosticsEngine& diags)
 
 bool
 UnwindInfo::CalcLen(Bytecode& bc,
-                    /*@out@*/ unsigned long* len,
+                    /*@out@*/ uint64_t* len,
                     const Bytecode::AddSpanFunc& add_span,
                     DiagnosticsEngine& diags)
 {
     // Want to make sure prolog size and codes count doesn't exceed
     // byte-size, and scaled frame offset doesn't exceed 4 bits.
-    add_span(bc, 1, m_prolog_size, 0, 255);
-    add_span(bc, 2, m_codes_count, 0, 255);
-
+    // The prolog size is checked at output instead of being tracked as a
+    // span, and a known codes count has already been checked by Generate().
     IntNum intn;
+    if (!m_codes_count.getIntNum(&intn, false, diags))
+        add_span(bc, 2, m_codes_count, 0, 255);
+
     if (m_frameoff.getIntNum(&intn, false, diags))
     {
         if (!intn.isInRange(0, 240))
@@ -112,25 +115,17 @@ UnwindInfo::CalcLen(Bytecode& bc,
 
 bool
 UnwindInfo::Expand(Bytecode& bc,
-                   unsigned long* len,
+                   uint64_t* len,
                    int span,
-                   long old_val,
-                   long new_val,
+                   int64_t old_val,
+                   int64_t new_val,
                    bool* keep,
-                   /*@out@*/ long* neg_thres,
-                   /*@out@*/ long* pos_thres,
+                   /*@out@*/ int64_t* neg_thres,
+                   /*@out@*/ int64_t* pos_thres,
                    DiagnosticsEngine& diags)
 {
     switch (span)
     {
-        case 1:
-        {
-            diags.Report(m_prolog_size.getSource().getBegin(),
-                         diag::err_prologue_too_large)
-                << static_cast<int>(new_val);
-            diags.Report(m_prolog->getDefSource(), diag::note_prologue_end);
-            return false;
-        }
         case 2:
             diags.Report(m_frameoff.getSource().getBegin(),
                          diag::err_too_many_unwind_codes)
@@ -162,6 +157,16 @@ UnwindInfo::Output(Bytecode& bc, BytecodeOutput& bc_out)
     bc_out.OutputBytes(bytes, bc.getSource());
 
     // Size of prolog
+    IntNum intn;
+    Location proc_loc, prolog_loc;
+    if (m_proc->getLabel(&proc_loc) && m_prolog->getLabel(&prolog_loc) &&
+        CalcDist(proc_loc, prolog_loc, &intn) && !intn.isInRange(0, 255))
+    {
+        bc_out.Diag(bc.getSource(), diag::err_prologue_too_large)
+            << static_cast<int>(intn.getInt());
+        bc_out.Diag(m_prolog->getDefSource(), diag::note_prologue_end);
+        return false;
+    }
     {
         bytes.resize(0);
         Write8(bytes, 0);
@@ -180,7 +185,6 @@ UnwindInfo::Output(Bytecode& bc, BytecodeOutput& bc_out)
     }
 
     // Frame register and offset
-    IntNum intn;
     if (!m_frameoff.getIntNum(&intn, true, bc_out.getDiagnostics()))
     {
         bc_out.Diag(m_frameoff.getSource().getBegin(),
@@ -292,7 +296,7 @@ objfmt::Generate(std::auto_ptr<UnwindInfo> uwinfo,
     for (std::vector<UnwindCode*>::reverse_iterator i=info->m_codes.rbegin(),
          end=info->m_codes.rend(); i != end; ++i)
     {
-        AppendUnwindCode(xdata, std::auto_ptr<UnwindCode>(*i));
+        AppendUnwindCode(xdata, std::auto_ptr<UnwindCode>(*i), diags);
         *i = 0; // don't double-free
     }
 
@@ -301,7 +305,20 @@ objfmt::Generate(std::auto_ptr<UnwindInfo> uwinfo,
     {
         Bytecode& bc = xdata.FreshBytecode();
         Location endloc = {&bc, bc.getFixedLen()};
-        info->m_codes_count.AddAbs(SHR(SUB(endloc, startloc), 1));
+        if (endloc.bc == startloc.bc)
+        {
+            // All codes were encoded as fixed data, so the count is known.
+            unsigned long count = (endloc.off - startloc.off) >> 1;
+            if (count > 255)
+            {
+                diags.Report(source, diag::err_too_many_unwind_codes)
+                    << static_cast<int>(count);
+                return;
+            }
+            info->m_codes_count.AddAbs(count);
+        }
+        else
+            info->m_codes_count.AddAbs(SHR(SUB(endloc, startloc), 1));
     }
 
     // 4-byte align
@@ -28,6 +28,7 @@
 
 #include "yasmx/Basic/Diagnostic.h"
 #include "yasmx/Parse/Directive.h"
+#include "yasmx/Parse/DirHelpers.h"
 #include "yasmx/Parse/NameValue.h"
 #include "yasmx/Support/registry.h"
 #include "yasmx/Arch.h"
@@ -45,6 +46,8 @@ using namespace yasm::objfmt;
 Win64Object::Win64Object(const ObjectFormatModule& module, Object& object)
     : Win32Object(module, object)
     , m_unwind(0)
+    , m_cfi(false)
+    , m_cfa_reg(4)
 {
 }
 
@@ -53,7 +56,7 @@ Win64Object::~Win64Object()
 }
 
 void
-Win64Object::Output(raw_fd_ostream& os,
+Win64Object::Output(OutputFileStream& os,
                     bool all_syms,
                     DebugFormat& dbgfmt,
                     DiagnosticsEngine& diags)
@@ -329,7 +332,7 @@ Win64Object::DirEndProcFrame(DirectiveInfo& info, DiagnosticsEngine& diags)
     assert(info.isObject(m_object));
     SourceLocation source = info.getSource();
 
-    if (!m_proc_frame.isValid())
+    if (!m_proc_frame.isValid() || m_cfi)
     {
         diags.Report(source,
                      diags.getCustomDiagID(DiagnosticsEngine::Error,
@@ -350,9 +353,15 @@ Win64Object::DirEndProcFrame(DirectiveInfo& info, DiagnosticsEngine& diags)
     }
     assert(m_unwind.get() != 0 && "unwind info not present");
 
-    SymbolRef proc_sym = m_unwind->getProc();
+    EndProcFrame(m_object.getSymbol(info.getLocation()), source, diags);
+}
 
-    SymbolRef curpos = m_object.getSymbol(info.getLocation());
+void
+Win64Object::EndProcFrame(SymbolRef curpos,
+                          SourceLocation source,
+                          DiagnosticsEngine& diags)
+{
+    SymbolRef proc_sym = m_unwind->getProc();
 
     //
     // Add unwind info to end of .xdata section.
@@ -397,6 +406,435 @@ Win64Object::DirEndProcFrame(DirectiveInfo& info, DiagnosticsEngine& diags)
 
     m_proc_frame = SourceLocation();
     m_done_prolog = SourceLocation();
+    m_cfi = false;
+}
+
+// DWARF register numbers for AMD64, mapped to unwind register numbers.
+// Numbers 17-32 are XMM registers; the return address (16) and anything
+// beyond XMM15 cannot be described by unwind codes.
+static const unsigned int dwarf_to_unwind_gpr[16] =
+{
+    0, 2, 1, 3, 6, 7, 5, 4, 8, 9, 10, 11, 12, 13, 14, 15
+};
+
+/// Get a CFI register operand as an unwind register number.
+/// Accepts both DWARF register numbers and register names.
+/// @param xmm      set to true if register is an XMM register
+/// @return False if the operand is not a register usable in unwind codes.
+static bool
+CfiRegNum(NameValue& nv,
+          DiagnosticsEngine& diags,
+          Object& object,
+          unsigned int* out,
+          bool* xmm)
+{
+    if (nv.isRegister())
+    {
+        const Register* reg = nv.getRegister();
+        if (reg->getSize() != 64 && reg->getSize() != 128)
+        {
+            diags.Report(nv.getValueRange().getBegin(),
+                         diag::warn_cfi_not_unwindable);
+            return false;
+        }
+        *out = reg->getNum() & 0xF;
+        *xmm = (reg->getSize() == 128);
+        return true;
+    }
+
+    IntNum num;
+    bool have_num = false;
+    DirIntNum(nv, diags, &object, &num, &have_num);
+    if (!have_num)
+        return false;
+
+    if (num.getUInt() < 16)
+    {
+        *out = dwarf_to_unwind_gpr[num.getUInt()];
+        *xmm = false;
+        return true;
+    }
+    if (num.getUInt() >= 17 && num.getUInt() <= 32)
+    {
+        *out = num.getUInt() - 17;
+        *xmm = true;
+        return true;
+    }
+    diags.Report(nv.getValueRange().getBegin(), diag::warn_cfi_not_unwindable);
+    return false;
+}
+
+bool
+Win64Object::CheckCfiState(DirectiveInfo& info, DiagnosticsEngine& diags)
+{
+    if (!m_cfi)
+    {
+        diags.Report(info.getSource(), diag::warn_outside_cfiproc);
+        return false;
+    }
+    // Directives after the prologue describe the procedure body and
+    // epilogues, which the win64 unwinder handles without unwind codes.
+    return !m_done_prolog.isValid();
+}
+
+void
+Win64Object::CfiAddCode(Location loc,
+                        UnwindCode::Opcode op,
+                        unsigned int info,
+                        unsigned int size,
+                        const IntNum& off)
+{
+    if (size == 0)
+        m_unwind->AddCode(std::auto_ptr<UnwindCode>(new UnwindCode(
+            m_unwind->getProc(),
+            m_object.getSymbol(loc),
+            op,
+            info)));
+    else
+        m_unwind->AddCode(std::auto_ptr<UnwindCode>(new UnwindCode(
+            m_unwind->getProc(),
+            m_object.getSymbol(loc),
+            op,
+            info,
+            size,
+            std::auto_ptr<Expr>(new Expr(off)))));
+    m_cfi_last = loc;
+}
+
+void
+Win64Object::CfiFlushPush()
+{
+    // An 8-byte CFA adjustment not followed by a save of the pushed
+    // register is just a small stack allocation.
+    if (m_cfi_push.bc == 0)
+        return;
+    CfiAddCode(m_cfi_push, UnwindCode::ALLOC_SMALL, 0, 7, 8);
+    m_cfi_push = Location();
+}
+
+void
+Win64Object::CfiEndProlog(SourceLocation source)
+{
+    CfiFlushPush();
+    m_done_prolog = source;
+}
+
+void
+Win64Object::DirCfiStartproc(DirectiveInfo& info, DiagnosticsEngine& diags)
+{
+    assert(info.isObject(m_object));
+    SourceLocation source = info.getSource();
+
+    if (m_proc_frame.isValid())
+    {
+        diags.Report(source, diag::err_nested_cfi);
+        diags.Report(m_proc_frame, diag::note_proc_started_here);
+        return;
+    }
+    m_proc_frame = source;
+    m_done_prolog = SourceLocation();
+    m_unwind.reset(new UnwindInfo);
+    m_unwind->setProc(m_object.getSymbol(info.getLocation()));
+
+    // On entry, the CFA is RSP+8 (just above the return address).
+    m_cfi = true;
+    m_cfa_reg = 4;
+    m_cfa_off = 8;
+    m_frame_off = 0;
+    m_cfi_push = Location();
+    m_cfi_last = info.getLocation();
+}
+
+void
+Win64Object::DirCfiEndproc(DirectiveInfo& info, DiagnosticsEngine& diags)
+{
+    assert(info.isObject(m_object));
+    if (!m_cfi)
+    {
+        diags.Report(info.getSource(),
+                     diag::warn_cfi_endproc_before_startproc);
+        return;
+    }
+
+    // The prologue ends with the last unwind code.
+    CfiFlushPush();
+    m_unwind->setProlog(m_object.getSymbol(m_cfi_last));
+
+    EndProcFrame(m_object.getSymbol(info.getLocation()), info.getSource(),
+                 diags);
+}
+
+void
+Win64Object::DirCfiPersonality(DirectiveInfo& info, DiagnosticsEngine& diags)
+{
+    assert(info.isObject(m_object));
+    NameValues& namevals = info.getNameValues();
+    if (!m_cfi)
+    {
+        diags.Report(info.getSource(), diag::warn_outside_cfiproc);
+        return;
+    }
+
+    IntNum encoding;
+    bool have_encoding = false;
+    DirIntNum(namevals.front(), diags, &m_object, &encoding, &have_encoding);
+    if (!have_encoding || encoding.getUInt() == 0xff)
+        return;     // DW_EH_PE_omit
+
+    if (namevals.size() < 2)
+    {
+        diags.Report(info.getSource(), diag::err_cfi_routine_required);
+        return;
+    }
+    NameValue& ehandler_nv = namevals[1];
+    if (!ehandler_nv.isId())
+    {
+        diags.Report(info.getSource(), diag::err_value_id)
+            << ehandler_nv.getValueRange();
+        return;
+    }
+
+    // The personality routine becomes the exception handler.
+    SymbolRef ehandler = m_object.getSymbol(ehandler_nv.getId());
+    ehandler->Use(ehandler_nv.getValueRange().getBegin());
+    m_unwind->setEHandler(ehandler);
+}
+
+void
+Win64Object::CfiSetCfaOffset(DirectiveInfo& info,
+                             const IntNum& off,
+                             DiagnosticsEngine& diags)
+{
+    // Once a frame register is established, the stack pointer is no
+    // longer tracked by the CFA.
+    if (m_cfa_reg != 4)
+    {
+        CfiEndProlog(info.getSource());
+        return;
+    }
+
+    IntNum delta = off;
+    delta -= m_cfa_off;
+    if (delta.getSign() < 0)
+    {
+        // Stack deallocation; this is an epilogue.
+        CfiEndProlog(info.getSource());
+        return;
+    }
+    if (delta.isZero())
+        return;
+
+    CfiFlushPush();
+    m_cfa_off = off;
+
+    // An 8-byte adjustment may be a push; defer until we know.
+    if (delta == 8)
+        m_cfi_push = info.getLocation();
+    else
+        CfiAddCode(info.getLocation(), UnwindCode::ALLOC_SMALL, 0, 7, delta);
+}
+
+void
+Win64Object::CfiSetFrame(DirectiveInfo& info,
+                         unsigned int reg,
+                         const IntNum& off,
+                         DiagnosticsEngine& diags)
+{
+    if (m_cfa_reg != 4)
+    {
+        CfiEndProlog(info.getSource());
+        return;
+    }
+
+    // CFA = RSP + old offset = frame + new offset.
+    IntNum frame_off = m_cfa_off;
+    frame_off -= off;
+
+    CfiFlushPush();
+    m_cfa_reg = reg;
+    m_cfa_off = off;
+    m_frame_off = frame_off;
+
+    m_unwind->setFrameReg(reg);
+    m_unwind->setFrameOff(Value(8, std::auto_ptr<Expr>(new Expr(frame_off))));
+    CfiAddCode(info.getLocation(), UnwindCode::SET_FPREG, reg, 8, frame_off);
+}
+
+void
+Win64Object::CfiSave(DirectiveInfo& info, bool rel, DiagnosticsEngine& diags)
+{
+    NameValues& namevals = info.getNameValues();
+    if (namevals.size() < 2)
+    {
+        diags.Report(info.getSource(), diag::err_directive_too_few_args) << 2;
+        return;
+    }
+
+    unsigned int reg;
+    bool xmm;
+    IntNum off;
+    bool have_off = false;
+    if (!CfiRegNum(namevals.front(), diags, m_object, &reg, &xmm))
+        return;
+    DirIntNum(namevals[1], diags, &m_object, &off, &have_off);
+    if (!have_off)
+        return;
+
+    // Unwind codes take offsets from RSP.  Relative offsets are from the
+    // CFA base register; others are from the CFA itself.
+    if (rel)
+        off += m_frame_off;
+    else
+    {
+        off += m_cfa_off;
+        off += m_frame_off;
+    }
+
+    // A register stored at the top of the stack right after an 8-byte
+    // adjustment was pushed.
+    if (!xmm && m_cfi_push.bc != 0 && off.isZero())
+    {
+        CfiAddCode(m_cfi_push, UnwindCode::PUSH_NONVOL, reg, 0, 0);
+        m_cfi_push = Location();
+        return;
+    }
+
+    CfiFlushPush();
+    CfiAddCode(info.getLocation(),
+               xmm ? UnwindCode::SAVE_XMM128 : UnwindCode::SAVE_NONVOL,
+               reg, 16, off);
+}
+
+void
+Win64Object::DirCfiDefCfa(DirectiveInfo& info, DiagnosticsEngine& diags)
+{
+    assert(info.isObject(m_object));
+    NameValues& namevals = info.getNameValues();
+    if (!CheckCfiState(info, diags))
+        return;
+    if (namevals.size() < 2)
+    {
+        diags.Report(info.getSource(), diag::err_directive_too_few_args) << 2;
+        return;
+    }
+
+    unsigned int reg;
+    bool xmm;
+    IntNum off;
+    bool have_off = false;
+    if (!CfiRegNum(namevals.front(), diags, m_object, &reg, &xmm))
+        return;
+    DirIntNum(namevals[1], diags, &m_object, &off, &have_off);
+    if (!have_off)
+        return;
+    if (xmm)
+    {
+        diags.Report(info.getSource(), diag::warn_cfi_not_unwindable);
+        return;
+    }
+
+    if (reg == 4)
+        CfiSetCfaOffset(info, off, diags);
+    else
+        CfiSetFrame(info, reg, off, diags);
+}
+
+void
+Win64Object::DirCfiDefCfaRegister(DirectiveInfo& info,
+                                  DiagnosticsEngine& diags)
+{
+    assert(info.isObject(m_object));
+    if (!CheckCfiState(info, diags))
+        return;
+
+    unsigned int reg;
+    bool xmm;
+    if (!CfiRegNum(info.getNameValues().front(), diags, m_object, &reg, &xmm))
+        return;
+    if (xmm)
+    {
+        diags.Report(info.getSource(), diag::warn_cfi_not_unwindable);
+        return;
+    }
+    if (reg == m_cfa_reg)
+        return;
+
+    if (reg == 4)
+        CfiEndProlog(info.getSource());     // frame torn down
+    else
+        CfiSetFrame(info, reg, m_cfa_off, diags);
+}
+
+void
+Win64Object::DirCfiDefCfaOffset(DirectiveInfo& info, DiagnosticsEngine& diags)
+{
+    assert(info.isObject(m_object));
+    if (!CheckCfiState(info, diags))
+        return;
+
+    IntNum off;
+    bool have_off = false;
+    DirIntNum(info.getNameValues().front(), diags, &m_object, &off,
+              &have_off);
+    if (have_off)
+        CfiSetCfaOffset(info, off, diags);
+}
+
+void
+Win64Object::DirCfiAdjustCfaOffset(DirectiveInfo& info,
+                                   DiagnosticsEngine& diags)
+{
+    assert(info.isObject(m_object));
+    if (!CheckCfiState(info, diags))
+        return;
+
+    IntNum off;
+    bool have_off = false;
+    DirIntNum(info.getNameValues().front(), diags, &m_object, &off,
+              &have_off);
+    if (!have_off)
+        return;
+    off += m_cfa_off;
+    CfiSetCfaOffset(info, off, diags);
+}
+
+void
+Win64Object::DirCfiOffset(DirectiveInfo& info, DiagnosticsEngine& diags)
+{
+    assert(info.isObject(m_object));
+    if (CheckCfiState(info, diags))
+        CfiSave(info, false, diags);
+}
+
+void
+Win64Object::DirCfiRelOffset(DirectiveInfo& info, DiagnosticsEngine& diags)
+{
+    assert(info.isObject(m_object));
+    if (CheckCfiState(info, diags))
+        CfiSave(info, true, diags);
+}
+
+void
+Win64Object::DirCfiEpilog(DirectiveInfo& info, DiagnosticsEngine& diags)
+{
+    // Register restores and state save/restore only occur after the
+    // prologue.
+    assert(info.isObject(m_object));
+    if (CheckCfiState(info, diags))
+        CfiEndProlog(info.getSource());
+}
+
+void
+Win64Object::DirCfiUnsupported(DirectiveInfo& info, DiagnosticsEngine& diags)
+{
+    assert(info.isObject(m_object));
+    if (CheckCfiState(info, diags))
+        diags.Report(info.getSource(), diag::warn_cfi_not_unwindable);
+}
+
+void
+Win64Object::DirCfiIgnore(DirectiveInfo& info, DiagnosticsEngine& diags)
+{
 }
 
 void
@@ -438,6 +876,49 @@ Win64Object::AddDirectives(Directives& dirs, StringRef parser)
     CoffObject::AddDirectives(dirs, parser);
 }
 
+void
+Win64Object::AddFallbackDirectives(Directives& dirs, StringRef parser)
+{
+    // CFI directives generate unwind codes, unless the debug format
+    // handles them (e.g. as DWARF frames).
+    static const Directives::Init<Win64Object> gas_dirs[] =
+    {
+        {".cfi_startproc", &Win64Object::DirCfiStartproc, Directives::ANY},
+        {".cfi_endproc", &Win64Object::DirCfiEndproc, Directives::ANY},
+        {".cfi_sections", &Win64Object::DirCfiIgnore, Directives::ANY},
+        {".cfi_personality", &Win64Object::DirCfiPersonality,
+         Directives::ARG_REQUIRED},
+        {".cfi_lsda", &Win64Object::DirCfiUnsupported, Directives::ANY},
+        {".cfi_def_cfa", &Win64Object::DirCfiDefCfa, Directives::ARG_REQUIRED},
+        {".cfi_def_cfa_register", &Win64Object::DirCfiDefCfaRegister,
+         Directives::ARG_REQUIRED},
+        {".cfi_def_cfa_offset", &Win64Object::DirCfiDefCfaOffset,
+         Directives::ARG_REQUIRED},
+        {".cfi_adjust_cfa_offset", &Win64Object::DirCfiAdjustCfaOffset,
+         Directives::ARG_REQUIRED},
+        {".cfi_offset", &Win64Object::DirCfiOffset, Directives::ARG_REQUIRED},
+        {".cfi_rel_offset", &Win64Object::DirCfiRelOffset,
+         Directives::ARG_REQUIRED},
+        {".cfi_register", &Win64Object::DirCfiUnsupported, Directives::ANY},
+        {".cfi_restore", &Win64Object::DirCfiEpilog, Directives::ANY},
+        {".cfi_undefined", &Win64Object::DirCfiUnsupported, Directives::ANY},
+        {".cfi_same_value", &Win64Object::DirCfiEpilog, Directives::ANY},
+        {".cfi_remember_state", &Win64Object::DirCfiEpilog, Directives::ANY},
+        {".cfi_restore_state", &Win64Object::DirCfiEpilog, Directives::ANY},
+        {".cfi_return_column", &Win64Object::DirCfiUnsupported,
+         Directives::ANY},
+        {".cfi_signal_frame", &Win64Object::DirCfiUnsupported,
+         Directives::ANY},
+        {".cfi_window_save", &Win64Object::DirCfiUnsupported, Directives::ANY},
+        {".cfi_escape", &Win64Object::DirCfiUnsupported, Directives::ANY},
+        {".cfi_val_encoded_addr", &Win64Object::DirCfiUnsupported,
+         Directives::ANY},
+    };
+
+    if (parser.equals_lower("gas") || parser.equals_lower("gnu"))
+        dirs.AddArray(this, gas_dirs);
+}
+
 bool
 Win64Object::InitSection(StringRef name,
                          Section& section,
@@ -481,11 +962,11 @@ static const yasm_stdmac win64_objfmt_stdmacs[] =
 };
 #endif
 
-void
-yasm_objfmt_win64_DoRegister()
+extern const yasm::impl::ModuleEntry yasm_objfmt_win64_modules[] =
 {
-    RegisterModule<ObjectFormatModule,
-                   ObjectFormatModuleImpl<Win64Object> >("win64");
-    RegisterModule<ObjectFormatModule,
-                   ObjectFormatModuleImpl<Win64Object> >("x64");
-}
+    YASM_MODULE_ENTRY(ObjectFormatModule,
+                      ObjectFormatModuleImpl<Win64Object>, "win64"),
+    YASM_MODULE_ENTRY(ObjectFormatModule,
+                      ObjectFormatModuleImpl<Win64Object>, "x64"),
+    YASM_MODULE_TABLE_END
+};
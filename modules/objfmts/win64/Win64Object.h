@@ -26,6 +26,9 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 //
+#include "yasmx/IntNum.h"
+#include "yasmx/Location.h"
+
 #include "modules/objfmts/win32/Win32Object.h"
 
 #include "UnwindCode.h"
@@ -44,10 +47,10 @@ public:
     virtual ~Win64Object();
 
     virtual void AddDirectives(Directives& dirs, StringRef parser);
+    virtual void AddFallbackDirectives(Directives& dirs, StringRef parser);
 
     //virtual void InitSymbols()
-    //virtual void Read()
-    virtual void Output(raw_fd_ostream& os,
+    virtual void Output(OutputFileStream& os,
                         bool all_syms,
                         DebugFormat& dbgfmt,
                         DiagnosticsEngine& diags);
@@ -67,7 +70,7 @@ public:
     static bool Taste(const MemoryBuffer& in,
                       /*@out@*/ std::string* arch_keyword,
                       /*@out@*/ std::string* machine)
-    { return false; }
+    { return TasteCoff(in, true, MACHINE_AMD64, arch_keyword, machine); }
 
 private:
     virtual bool InitSection(StringRef name,
@@ -92,11 +95,52 @@ private:
     void DirPushFrame(DirectiveInfo& info, DiagnosticsEngine& diags);
     void DirEndProlog(DirectiveInfo& info, DiagnosticsEngine& diags);
     void DirEndProcFrame(DirectiveInfo& info, DiagnosticsEngine& diags);
+    void EndProcFrame(SymbolRef curpos,
+                      SourceLocation source,
+                      DiagnosticsEngine& diags);
+
+    // CFI directives, translated into unwind codes
+    bool CheckCfiState(DirectiveInfo& info, DiagnosticsEngine& diags);
+    void CfiFlushPush();
+    void CfiEndProlog(SourceLocation source);
+    void CfiAddCode(Location loc,
+                    UnwindCode::Opcode op,
+                    unsigned int info,
+                    unsigned int size,
+                    const IntNum& off);
+    void CfiSetCfaOffset(DirectiveInfo& info,
+                         const IntNum& off,
+                         DiagnosticsEngine& diags);
+    void CfiSetFrame(DirectiveInfo& info,
+                     unsigned int reg,
+                     const IntNum& off,
+                     DiagnosticsEngine& diags);
+    void CfiSave(DirectiveInfo& info, bool rel, DiagnosticsEngine& diags);
+    void DirCfiStartproc(DirectiveInfo& info, DiagnosticsEngine& diags);
+    void DirCfiEndproc(DirectiveInfo& info, DiagnosticsEngine& diags);
+    void DirCfiPersonality(DirectiveInfo& info, DiagnosticsEngine& diags);
+    void DirCfiDefCfa(DirectiveInfo& info, DiagnosticsEngine& diags);
+    void DirCfiDefCfaRegister(DirectiveInfo& info, DiagnosticsEngine& diags);
+    void DirCfiDefCfaOffset(DirectiveInfo& info, DiagnosticsEngine& diags);
+    void DirCfiAdjustCfaOffset(DirectiveInfo& info, DiagnosticsEngine& diags);
+    void DirCfiOffset(DirectiveInfo& info, DiagnosticsEngine& diags);
+    void DirCfiRelOffset(DirectiveInfo& info, DiagnosticsEngine& diags);
+    void DirCfiEpilog(DirectiveInfo& info, DiagnosticsEngine& diags);
+    void DirCfiUnsupported(DirectiveInfo& info, DiagnosticsEngine& diags);
+    void DirCfiIgnore(DirectiveInfo& info, DiagnosticsEngine& diags);
 
     // data for proc_frame and related directives
     SourceLocation m_proc_frame;        // start of proc source location
     SourceLocation m_done_prolog;       // end of prologue source location
     std::auto_ptr<UnwindInfo> m_unwind; // Unwind info
+
+    // data for CFI directives
+    bool m_cfi;                 // procedure started by .cfi_startproc
+    unsigned int m_cfa_reg;     // CFA base register (unwind numbering)
+    IntNum m_cfa_off;           // CFA offset from base register
+    IntNum m_frame_off;         // frame register offset from RSP
+    Location m_cfi_push;        // end of possible push (bc=0 if none)
+    Location m_cfi_last;        // location of last unwind code
 };
 
 }} // namespace yasm::objfmt
@@ -32,6 +32,7 @@
 #include "yasmx/Parse/Directive.h"
 #include "yasmx/Parse/DirHelpers.h"
 #include "yasmx/Parse/NameValue.h"
+#include "yasmx/Support/OutputFileStream.h"
 #include "yasmx/Support/bitcount.h"
 #include "yasmx/Support/registry.h"
 #include "yasmx/Arch.h"
@@ -93,13 +94,14 @@ namespace {
 class XdfOutput : public BytecodeStreamOutput
 {
 public:
-    XdfOutput(raw_ostream& os, Object& object, DiagnosticsEngine& diags);
+    XdfOutput(OutputFileStream& os, Object& object, DiagnosticsEngine& diags);
     ~XdfOutput();
 
     void OutputSection(Section& sect);
     void OutputSymbol(const Symbol& sym,
                       bool all_syms,
-                      unsigned long* strtab_offset);
+                      unsigned long* strtab_offset,
+                      Bytes& symtab);
 
     // OutputBytecode overrides
     bool ConvertValueToBytes(Value& value,
@@ -112,11 +114,13 @@ private:
 };
 } // anonymous namespace
 
-XdfOutput::XdfOutput(raw_ostream& os, Object& object, DiagnosticsEngine& diags)
+XdfOutput::XdfOutput(OutputFileStream& os, Object& object, DiagnosticsEngine& diags)
     : BytecodeStreamOutput(os, diags)
     , m_object(object)
     , m_no_output(diags)
 {
+    setListFormat(object.getListFormat());
+    m_no_output.setListFormat(object.getListFormat());
 }
 
 XdfOutput::~XdfOutput()
@@ -156,11 +160,11 @@ XdfOutput::ConvertValueToBytes(Value& value,
             return false;
         }
 
+        Section* sect = loc.bc->getContainer()->getSection();
         std::auto_ptr<XdfReloc>
-            reloc(new XdfReloc(loc.getOffset(), value, pc_rel));
+            reloc(new (*sect) XdfReloc(loc.getOffset(), value, pc_rel));
         if (pc_rel)
             intn -= loc.getOffset();    // Adjust to start of section
-        Section* sect = loc.bc->getContainer()->getSection();
         sect->AddReloc(std::auto_ptr<Reloc>(reloc.release()));
     }
 
@@ -223,21 +227,24 @@ XdfOutput::OutputSection(Section& sect)
     }
     xsect->relptr = static_cast<unsigned long>(pos);
 
+    // Encode the entire table, then write it out at once.
+    Bytes& scratch = getScratch();
+    scratch.reserve(RELOC_SIZE * sect.getRelocs().size());
     for (Section::const_reloc_iterator i=sect.relocs_begin(),
          end=sect.relocs_end(); i != end; ++i)
     {
         const XdfReloc& reloc = static_cast<const XdfReloc&>(*i);
-        Bytes& scratch = getScratch();
         reloc.Write(scratch);
-        assert(scratch.size() == RELOC_SIZE);
-        m_os << scratch;
     }
+    assert(scratch.size() == RELOC_SIZE * sect.getRelocs().size());
+    m_os << scratch;
 }
 
 void
 XdfOutput::OutputSymbol(const Symbol& sym,
                         bool all_syms,
-                        unsigned long* strtab_offset)
+                        unsigned long* strtab_offset,
+                        Bytes& symtab)
 {
     int vis = sym.getVisibility();
 
@@ -290,21 +297,18 @@ XdfOutput::OutputSymbol(const Symbol& sym,
         scnum = -1;
     }
 
-    Bytes& scratch = getScratch();
-    scratch.setLittleEndian();
+    symtab.setLittleEndian();
 
-    Write32(scratch, scnum);        // section number
-    Write32(scratch, value);        // value
-    Write32(scratch, *strtab_offset);
-    Write32(scratch, flags);        // flags
-    assert(scratch.size() == SYMBOL_SIZE);
-    m_os << scratch;
+    Write32(symtab, scnum);         // section number
+    Write32(symtab, value);         // value
+    Write32(symtab, *strtab_offset);
+    Write32(symtab, flags);         // flags
 
     *strtab_offset += static_cast<unsigned long>(sym.getName().size()+1);
 }
 
 void
-XdfObject::Output(raw_fd_ostream& os,
+XdfObject::Output(OutputFileStream& os,
                   bool all_syms,
                   DebugFormat& dbgfmt,
                   DiagnosticsEngine& diags)
@@ -357,11 +361,16 @@ XdfObject::Output(raw_fd_ostream& os,
     unsigned long strtab_offset =
         FILEHEAD_SIZE + SECTHEAD_SIZE*scnum + SYMBOL_SIZE*symtab_count;
 
-    // Output symbol table
-    for (Object::const_symbol_iterator sym = m_object.symbols_begin(),
-         end = m_object.symbols_end(); sym != end; ++sym)
+    // Output symbol table; the entries are encoded and written at once.
     {
-        out.OutputSymbol(*sym, all_syms, &strtab_offset);
+        Bytes symtab;
+        symtab.reserve(SYMBOL_SIZE*symtab_count);
+        for (Object::const_symbol_iterator sym = m_object.symbols_begin(),
+             end = m_object.symbols_end(); sym != end; ++sym)
+        {
+            out.OutputSymbol(*sym, all_syms, &strtab_offset, symtab);
+        }
+        os << symtab;
     }
 
     // Output string table
@@ -470,8 +479,8 @@ static void
 NoAddSpan(Bytecode& bc,
           int id,
           const Value& value,
-          long neg_thres,
-          long pos_thres)
+          int64_t neg_thres,
+          int64_t pos_thres)
 {
 }
 
@@ -631,7 +640,7 @@ XdfObject::Read(SourceManager& sm, DiagnosticsEngine& diags)
             if (type == XdfReloc::XDF_WRT)
                 basesym = m_object.getSymbol(basesym_index);
             sect->AddReloc(std::auto_ptr<Reloc>(
-                new XdfReloc(addr, sym, basesym, type, size, shift)));
+                new (*sect) XdfReloc(addr, sym, basesym, type, size, shift)));
         }
     }
     if (diags.hasErrorOccurred())
@@ -790,9 +799,9 @@ XdfObject::AddDirectives(Directives& dirs, StringRef parser)
         dirs.AddArray(this, nasm_dirs);
 }
 
-void
-yasm_objfmt_xdf_DoRegister()
+extern const yasm::impl::ModuleEntry yasm_objfmt_xdf_modules[] =
 {
-    RegisterModule<ObjectFormatModule,
-                   ObjectFormatModuleImpl<XdfObject> >("xdf");
-}
+    YASM_MODULE_ENTRY(ObjectFormatModule,
+                      ObjectFormatModuleImpl<XdfObject>, "xdf"),
+    YASM_MODULE_TABLE_END
+};
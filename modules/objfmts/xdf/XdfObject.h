@@ -53,7 +53,7 @@ public:
     void AddDirectives(Directives& dirs, StringRef parser);
 
     bool Read(SourceManager& sm, DiagnosticsEngine& diags);
-    void Output(raw_fd_ostream& os,
+    void Output(OutputFileStream& os,
                 bool all_syms,
                 DebugFormat& dbgfmt,
                 DiagnosticsEngine& diags);
@@ -44,6 +44,7 @@ namespace objfmt
 struct YASM_STD_EXPORT XdfSection : public AssocData
 {
     static const char* key;
+    static const bool inline_slot = true;
 
     XdfSection(SymbolRef sym_);
     ~XdfSection();
@@ -40,6 +40,7 @@ namespace objfmt
 struct YASM_STD_EXPORT XdfSymbol : public AssocData
 {
     static const char* key;
+    static const bool inline_slot = true;
 
     XdfSymbol(unsigned long index_) : index(index_) {}
     ~XdfSymbol();
@@ -35,9 +35,13 @@
 #include <cctype>
 
 #include "llvm/ADT/Statistic.h"
+#include "llvm/Support/MathExtras.h"
 #include "yasmx/Basic/Diagnostic.h"
 #include "yasmx/Parse/Preprocessor.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 STATISTIC(num_identifier, "Number of identifiers lexed");
 STATISTIC(num_numeric_constant, "Number of numeric constants lexed");
@@ -375,6 +379,22 @@ GasLexer::SkipBlockComment(Token* result, const char* cur_ptr)
                 goto FoundSlash;
 
             // Scan for '/' quickly.  Many block comments are very large.
+#ifdef __SSE2__
+            __m128i slashes = _mm_set1_epi8('/');
+            while (cur_ptr+16 <= m_buf_end)
+            {
+                unsigned int mask = _mm_movemask_epi8(
+                    _mm_cmpeq_epi8(*(const __m128i*)cur_ptr, slashes));
+                if (mask != 0)
+                {
+                    cur_ptr += llvm::CountTrailingZeros_32(mask);
+                    ch = *cur_ptr++;
+                    assert(ch == '/');
+                    goto FoundSlash;
+                }
+                cur_ptr += 16;
+            }
+#else
             while (cur_ptr[0] != '/' &&
                    cur_ptr[1] != '/' &&
                    cur_ptr[2] != '/' &&
@@ -383,6 +403,7 @@ GasLexer::SkipBlockComment(Token* result, const char* cur_ptr)
             {
                 cur_ptr += 4;
             }
+#endif
 
             // It has to be one of the bytes scanned, increment to it and read one.
             ch = *cur_ptr++;
@@ -29,9 +29,17 @@
 //
 #include "GasParser.h"
 
+#include <algorithm>
+#include <cstring>
+
+#include "llvm/Support/MemoryBuffer.h"
+#include "yasmx/Basic/SourceManager.h"
 #include "yasmx/Parse/Directive.h"
 #include "yasmx/Support/registry.h"
+#include "yasmx/Support/scoped_ptr.h"
 #include "yasmx/Arch.h"
+#include "yasmx/Bytes.h"
+#include "yasmx/InputBuffer.h"
 #include "yasmx/Object.h"
 #include "yasmx/Op.h"
 #include "yasmx/Symbol_util.h"
@@ -50,6 +58,10 @@ GasParser::GasParser(const ParserModule& module,
     , m_intel(false)
     , m_reg_prefix(true)
     , m_previous_section(0)
+    , m_macro_count(0)
+    , m_record(0)
+    , m_record_ok(false)
+    , m_replay(0)
 {
     static const GasDirLookup gas_dirs_init[] =
     {
@@ -107,10 +119,9 @@ GasParser::GasParser(const ParserModule& module,
         {".previous",   &GasParser::ParseDirPrevious,       0},
         // macro directives
         {".include",    &GasParser::ParseDirInclude,    0},
-#if 0
         {".macro",      &GasParser::ParseDirMacro,      0},
         {".endm",       &GasParser::ParseDirEndm,       0},
-#endif
+        {".purgem",     &GasParser::ParseDirPurgem,     0},
         {".rept",       &GasParser::ParseDirRept,       0},
         {".endr",       &GasParser::ParseDirEndr,       0},
         // empty space/fill directives
@@ -175,11 +186,12 @@ GasParser::~GasParser()
 }
 
 void
-GasParser::Parse(Object& object, Directives& dirs, DiagnosticsEngine& diags)
+GasParser::StartParse(Object& object, Directives& dirs)
 {
     m_object = &object;
     m_dirs = &dirs;
     m_arch = object.getArch();
+    m_insn.reset();
 
     m_locallabel_base = "";
 
@@ -190,6 +202,11 @@ GasParser::Parse(Object& object, Directives& dirs, DiagnosticsEngine& diags)
 
     m_local.clear();
     m_cond_stack.clear();
+    m_section_specs.clear();
+    m_section_spec.clear();
+    m_macros.clear();
+    m_macro_count = 0;
+    m_rept_bodies.clear();
 
     // Set up arch-sized directives
     m_sized_gas_dirs[0].name = ".word";
@@ -198,7 +215,12 @@ GasParser::Parse(Object& object, Directives& dirs, DiagnosticsEngine& diags)
     for (size_t i=0; i<sizeof(m_sized_gas_dirs)/sizeof(m_sized_gas_dirs[0]);
          ++i)
         m_gas_dirs[m_sized_gas_dirs[i].name] = &m_sized_gas_dirs[i];
+}
 
+void
+GasParser::Parse(Object& object, Directives& dirs, DiagnosticsEngine& diags)
+{
+    StartParse(object, dirs);
     m_preproc.EnterMainSourceFile();
     m_preproc.Lex(&m_token);
     DoParse();
@@ -216,6 +238,310 @@ GasParser::Parse(Object& object, Directives& dirs, DiagnosticsEngine& diags)
     object.ExternUndefinedSymbols();
 }
 
+// Start of the records of ParsePiece(), changed whenever what a record
+// holds changes.
+static const char RECORD_HEADER[] = "yasm gas piece 1";
+
+bool
+GasParser::ParsePiece(Object& object,
+                      Directives& dirs,
+                      DiagnosticsEngine& diags,
+                      const std::vector<unsigned int>& setup,
+                      unsigned int begin,
+                      unsigned int end,
+                      Bytes* record,
+                      ArrayRef<unsigned char> replay)
+{
+    StartParse(object, dirs);
+
+    SourceManager& sm = m_preproc.getSourceManager();
+    FileID main = sm.getMainFileID();
+    StringRef text = sm.getBuffer(main)->getBuffer();
+    SourceLocation start = sm.getLocForStartOfFile(main);
+
+    // Parse the lines giving the attributes of sections the piece may
+    // switch back to first, so the piece creates them the same way.
+    m_gas_preproc.EnterMainSourcePiece(0);
+    for (std::vector<unsigned int>::const_iterator i=setup.begin(),
+         setup_end=setup.end(); i != setup_end && *i < begin; ++i)
+    {
+        std::size_t eol = text.find('\n', *i);
+        if (eol == StringRef::npos)
+            break;
+        m_preproc.getCurrentFileLexer()->SeekToLine(*i);
+        m_piece_end = start.getLocWithOffset(eol+1);
+        m_preproc.Lex(&m_token);
+        DoParse();
+    }
+
+    // Instructions are recorded and replayed; everything else in the
+    // piece is parsed again.
+    SourceLocation piece_begin = start.getLocWithOffset(begin);
+    SourceLocation piece_end = start.getLocWithOffset(end);
+    util::scoped_ptr<RecordWriter> writer;
+    if (record)
+    {
+        writer.reset(new RecordWriter(*record, *m_arch, object, piece_begin,
+                                      piece_end));
+        writer->WriteString(RECORD_HEADER);
+    }
+    InputBuffer replay_in(replay);
+    util::scoped_ptr<RecordReader> reader;
+    bool ok = true;
+    try
+    {
+        if (!replay.empty())
+        {
+            reader.reset(new RecordReader(replay_in, *m_arch, object,
+                                          piece_begin, piece_end));
+            if (reader->ReadString() != RECORD_HEADER)
+                throw std::out_of_range("bad piece record header");
+            m_replay_next = reader->ReadSource();
+        }
+        m_record = writer.get();
+        m_replay = reader.get();
+
+        m_preproc.getCurrentFileLexer()->SeekToLine(begin);
+        m_piece_end = end < text.size() ? piece_end : SourceLocation();
+        m_preproc.Lex(&m_token);
+        DoParse();
+
+        // The whole record must have been replayed.
+        if (m_replay_next.isValid())
+            ok = false;
+    }
+    catch (std::out_of_range&)
+    {
+        ok = false;
+    }
+    if (writer)
+        writer->WriteSource(SourceLocation());
+
+    m_piece_end = SourceLocation();
+    m_record = 0;
+    m_record_uses.clear();
+    m_replay = 0;
+    m_replay_next = SourceLocation();
+    return ok;
+}
+
+void
+GasParser::FinishPieces(Object& object)
+{
+    // Convert all undefined symbols into extern symbols
+    object.ExternUndefinedSymbols();
+}
+
+// Directives that can be parsed the same in any piece of a split source.
+// Anything that changes parser, preprocessor or arch state that later
+// lines depend on (macros, conditionals, symbol assignments, .code64,
+// .org, .previous, CFI and line directives, ...) is left out.
+static const char* split_dirs[] =
+{
+    ".2byte", ".4byte", ".8byte", ".align", ".ascii", ".asciz", ".balign",
+    ".bss", ".byte", ".comm", ".data", ".double", ".extern", ".file",
+    ".fill", ".float", ".global", ".globl", ".hidden", ".hword", ".ident",
+    ".int", ".internal", ".lcomm", ".local", ".long", ".octa", ".p2align",
+    ".protected", ".quad", ".section", ".short", ".single", ".size",
+    ".skip", ".sleb128", ".space", ".string", ".text", ".type", ".uleb128",
+    ".value", ".weak", ".word", ".zero"
+};
+
+static inline bool
+isIdentChar(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+           (c >= '0' && c <= '9') || c == '_' || c == '.' || c == '$';
+}
+
+// Check a statement of the main source for SplitSource().  For a section
+// switch, the section name and the rest of the arguments are returned.
+// @return False if the statement prevents splitting.
+static bool
+CheckSplitStatement(StringRef stmt, StringRef* sect_name, StringRef* args)
+{
+    bool label = false;
+    for (;;)
+    {
+        std::size_t ident_len = 0;
+        while (ident_len < stmt.size() && isIdentChar(stmt[ident_len]))
+            ++ident_len;
+        if (ident_len == 0)
+            return !stmt.startswith("\"");  // quoted symbol name
+        StringRef ident = stmt.substr(0, ident_len);
+        StringRef rest = stmt.substr(ident_len).ltrim(" \t");
+        if (rest.startswith("=") && !rest.startswith("=="))
+            return false;                   // symbol assignment
+        if (!rest.startswith(":"))
+            break;
+        if (ident.find_first_not_of("0123456789") == StringRef::npos)
+            return false;                   // numeric local label
+        stmt = rest.substr(1).ltrim(" \t");
+        if (stmt.empty())
+            return true;
+        label = true;
+    }
+
+    if (!stmt.startswith("."))
+        return true;                        // instruction
+
+    std::size_t dir_len = 1;
+    while (dir_len < stmt.size() && isIdentChar(stmt[dir_len]))
+        ++dir_len;
+    std::string dir = stmt.substr(0, dir_len).lower();
+    *args = stmt.substr(dir_len).ltrim(" \t");
+
+    const char** dirs_end = split_dirs + sizeof(split_dirs)/sizeof(char*);
+    if (std::find(split_dirs, dirs_end, dir) == dirs_end)
+        return false;
+
+    if (dir == ".file")
+        return args->startswith("\"");      // not the DWARF form
+
+    if (dir == ".text" || dir == ".data" || dir == ".bss")
+    {
+        *sect_name = stmt.substr(0, dir_len);
+        return !label && args->empty();     // no subsection
+    }
+    if (dir != ".section")
+        return true;
+
+    if (label)
+        return false;
+    if (args->startswith("\""))
+    {
+        std::size_t close = args->find('"', 1);
+        if (close == StringRef::npos)
+            return false;
+        *sect_name = args->slice(1, close);
+        *args = args->substr(close+1);
+    }
+    else
+    {
+        *sect_name = args->substr(0, args->find_first_of(", \t"));
+        *args = args->substr(sect_name->size());
+    }
+    *args = args->ltrim(" \t");
+    if (args->startswith(","))
+        *args = args->substr(1).ltrim(" \t");
+    else if (!args->empty())
+        return false;                       // subsection
+
+    // Section groups and linked sections are kept by the object format
+    // rather than the object.
+    StringRef flags;
+    if (args->startswith("\""))
+        flags = args->slice(1, args->find('"', 1));
+    return !sect_name->empty() &&
+        flags.find_first_of("Go?") == StringRef::npos &&
+        args->find("comdat") == StringRef::npos;
+}
+
+bool
+GasParser::SplitSource(std::vector<unsigned int>* splits,
+                       std::vector<unsigned int>* setup)
+{
+    SourceManager& sm = m_preproc.getSourceManager();
+    const MemoryBuffer* buf = sm.getBuffer(sm.getMainFileID());
+    const char* start = buf->getBufferStart();
+    const char* end = buf->getBufferEnd();
+
+    // Arguments of the first switch to each section.  Later switches must
+    // have none or the same ones.
+    llvm::StringMap<StringRef> sect_args;
+
+    for (const char* p = start; p < end; )
+    {
+        const char* line = p;
+        const char* eol =
+            static_cast<const char*>(std::memchr(p, '\n', end-p));
+        if (!eol)
+            eol = end;
+        p = eol+1;
+
+        // Split the line into statements.
+        StringRef text(line, eol-line);
+        bool first = true;
+        bool setup_line = false;
+        while (!text.empty())
+        {
+            std::size_t stmt_end = text.size();
+            bool comment = false;
+            bool in_string = false;
+            for (std::size_t i=0; i<text.size(); ++i)
+            {
+                char c = text[i];
+                if (in_string)
+                {
+                    if (c == '\\')
+                        ++i;
+                    else if (c == '"')
+                        in_string = false;
+                    continue;
+                }
+                if (c == '"')
+                    in_string = true;
+                else if (c == '\'' || c == '\\')
+                    return false;           // character or macro argument
+                else if (c == '/' && i+1 < text.size() && text[i+1] == '*')
+                    return false;           // block comment
+                else if (c == ';')
+                {
+                    stmt_end = i;
+                    break;
+                }
+                else if (c == '#' ||
+                         (c == '/' && i+1 < text.size() && text[i+1] == '/'))
+                {
+                    stmt_end = i;
+                    comment = true;
+                    break;
+                }
+            }
+            if (in_string)
+                return false;
+
+            StringRef stmt = text.substr(0, stmt_end).trim(" \t\r\f\v");
+            if (first && stmt.empty() && comment && text[stmt_end] == '#' &&
+                text.substr(stmt_end+1).ltrim(" \t").find_first_of(
+                    "0123456789") == 0)
+                return false;               // line marker
+
+            if (!stmt.empty())
+            {
+                if (setup_line)
+                    return false;   // would be parsed again in setup
+                StringRef sect_name, args;
+                if (!CheckSplitStatement(stmt, &sect_name, &args))
+                    return false;
+                if (!sect_name.empty())
+                {
+                    llvm::StringMapEntry<StringRef>& entry =
+                        sect_args.GetOrCreateValue(sect_name, args);
+                    if (entry.getValue().data() == args.data() &&
+                        !args.empty())
+                    {
+                        // first switch, setting the section's attributes
+                        if (!first)
+                            return false;
+                        setup->push_back(line-start);
+                        setup_line = true;
+                    }
+                    else if (!args.empty() && entry.getValue() != args)
+                        return false;
+                    if (first && line != start)
+                        splits->push_back(line-start);
+                }
+                first = false;
+            }
+            if (comment || stmt_end == text.size())
+                break;
+            text = text.substr(stmt_end+1);
+        }
+    }
+    return true;
+}
+
 void
 GasParser::AddDirectives(Directives& dirs, StringRef parser)
 {
@@ -233,9 +559,9 @@ GasParser::getPreprocessor() const
     return ParserImpl::getPreprocessor();
 }
 
-void
-yasm_parser_gas_DoRegister()
+extern const yasm::impl::ModuleEntry yasm_parser_gas_modules[] =
 {
-    RegisterModule<ParserModule, ParserModuleImpl<GasParser> >("gas");
-    RegisterModule<ParserModule, ParserModuleImpl<GasParser> >("gnu");
-}
+    YASM_MODULE_ENTRY(ParserModule, ParserModuleImpl<GasParser>, "gas"),
+    YASM_MODULE_ENTRY(ParserModule, ParserModuleImpl<GasParser>, "gnu"),
+    YASM_MODULE_TABLE_END
+};
@@ -29,19 +29,24 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 //
+#include <deque>
 #include <map>
 #include <memory>
 #include <string>
 #include <vector>
 
 #include "llvm/ADT/APFloat.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/StringMap.h"
 #include "yasmx/Basic/SourceLocation.h"
 #include "yasmx/Config/export.h"
+#include "yasmx/Parse/Directive.h"
 #include "yasmx/Parse/Parser.h"
 #include "yasmx/Parse/ParserImpl.h"
+#include "yasmx/Parse/TokenBuffer.h"
 #include "yasmx/Insn.h"
 #include "yasmx/IntNum.h"
+#include "yasmx/ParseRecord.h"
 
 #include "GasPreproc.h"
 
@@ -50,7 +55,6 @@ namespace yasm
 
 class Arch;
 class Bytecode;
-class Directives;
 class Expr;
 class FloatNum;
 class IntNum;
@@ -72,6 +76,16 @@ struct GasDirLookup
     unsigned int param;
 };
 
+/// Result of looking up a directive name, cached on the name's
+/// IdentifierInfo so each distinct name is only looked up once.
+struct GasDirCache
+{
+    const GasDirLookup* gas;    ///< GAS-specific directive, or NULL
+    Directive dir;              ///< Generic directive handler, if !gas
+    ParsedDirective parsed;     ///< Parsed directive handler, if any
+    bool found;                 ///< False if the directive is unknown
+};
+
 class YASM_STD_EXPORT GasParser : public Parser, public ParserImpl
 {
 public:
@@ -90,23 +104,44 @@ public:
 
     void Parse(Object& object, Directives& dirs, DiagnosticsEngine& diags);
 
+    bool SplitSource(std::vector<unsigned int>* splits,
+                     std::vector<unsigned int>* setup);
+    bool ParsePiece(Object& object,
+                    Directives& dirs,
+                    DiagnosticsEngine& diags,
+                    const std::vector<unsigned int>& setup,
+                    unsigned int begin,
+                    unsigned int end,
+                    Bytes* record,
+                    ArrayRef<unsigned char> replay);
+    void FinishPieces(Object& object);
+
 private:
+    /// Set up the parse state for parsing into an object.
+    void StartParse(Object& object, Directives& dirs);
 
-    /// Get the local label name for the given numeric index + suffix.
-    /// @param name     label name (output)
+    /// Get the local label symbol for the given numeric index + suffix.
     /// @param num      numeric index string
     /// @param suffix   suffix (e.g. 'f', 'b' for reference, ':' for
     ///                 definition)
     /// @param source   source location of numeric index
     /// @param inc      increment label index (typically used for definition).
-    /// @return True on success, false on error.
-    bool getLocalLabel(SmallVectorImpl<char>& name,
-                       StringRef num,
-                       char suffix,
-                       SourceLocation source,
-                       bool inc = false);
+    /// @return Symbol, or NULL on error.
+    SymbolRef getLocalLabel(StringRef num,
+                            char suffix,
+                            SourceLocation source,
+                            bool inc = false);
 
     bool ParseLine();
+    struct GasMacro;
+    bool ParseMacroParams(GasMacro& macro, StringRef name);
+    bool ExpandMacro(const GasMacro& macro, SourceLocation source);
+    void PasteTokens(std::vector<Token>& toks,
+                     const std::vector<unsigned int>& paste);
+    bool SubstituteString(Token* tok,
+                          const GasMacro& macro,
+                          const std::vector<std::vector<Token> >& args);
+    const GasDirCache& LookupDirective(IdentifierInfo* ii);
     void setDebugFile(StringRef filename,
                       SourceRange filename_source,
                       SourceLocation dir_source);
@@ -122,7 +157,11 @@ private:
     bool ParseDirInclude(unsigned int, SourceLocation source);
     bool ParseDirMacro(unsigned int, SourceLocation source);
     bool ParseDirEndm(unsigned int, SourceLocation source);
+    bool ParseDirPurgem(unsigned int, SourceLocation source);
     bool ParseDirRept(unsigned int, SourceLocation source);
+    bool isConstantDataBody(const SmallVectorImpl<Token>& tokens) const;
+    TokenBuffer* getReptBody(const SmallVectorImpl<Token>& tokens,
+                             SourceLocation source);
     bool ParseDirEndr(unsigned int, SourceLocation source);
     bool ParseDirAlign(unsigned int power2, SourceLocation source);
     bool ParseDirOrg(unsigned int, SourceLocation source);
@@ -130,6 +169,7 @@ private:
     bool ParseDirComm(unsigned int is_lcomm, SourceLocation source);
     bool ParseDirAscii(unsigned int withzero, SourceLocation source);
     bool ParseDirFloat(unsigned int size, SourceLocation source);
+    bool ParsePlainInteger(uint64_t* val);
     bool ParseDirData(unsigned int size, SourceLocation source);
     bool ParseDirLeb128(unsigned int sign, SourceLocation source);
     bool ParseDirZero(unsigned int, SourceLocation source);
@@ -157,7 +197,21 @@ private:
 
     bool ParseDirSyntax(unsigned int intel, SourceLocation source);
 
-    Insn::Ptr ParseInsn();
+    Insn* ParseInsn();
+
+    /// Replay the instruction statement starting at source from the
+    /// replay record, if it's the next one the record has.
+    /// @return True if replayed; the end of the statement is left to parse.
+    bool ReplayInsn(SourceLocation source);
+
+    /// Write the instruction statement just appended to the record.
+    /// @param source       start of the statement
+    /// @param mark         end of the container before the instruction
+    /// @param num_symbols  number of symbols before the instruction
+    void RecordInsn(SourceLocation source,
+                    const RecordWriter::Mark& mark,
+                    std::size_t num_symbols);
+
     bool ParseDirective(NameValues* nvs, const ParseExprTerm* parse_term = 0);
     Operand ParseMemoryAddress();
     Operand ParseRegOperand();
@@ -177,12 +231,14 @@ private:
     bool ParseInteger(IntNum* intn);
     const Register* ParseRegister();
 
-    void DefineLabel(StringRef name, SourceLocation source);
+    void DefineLabel(SymbolRef sym, SourceLocation source);
     void DefineLcomm(SymbolRef sym,
                      SourceLocation source,
                      std::auto_ptr<Expr> size,
                      const Expr& align);
     void SwitchSection(StringRef name, bool builtin, SourceRange source);
+    bool SwitchCachedSection(StringRef spec);
+    void DoSectionHandler(StringRef spec, DirectiveInfo& info);
     Section& getSection(StringRef name, bool builtin, SourceRange source);
 
     void DoParse();
@@ -191,6 +247,10 @@ private:
     Arch* m_arch;
     Directives* m_dirs;
 
+    // Instruction being parsed.  Reused for every instruction so that
+    // parsing an instruction doesn't allocate.
+    Insn::Ptr m_insn;
+
     GasPreproc m_gas_preproc;
 
     BytecodeContainer* m_container;
@@ -201,6 +261,9 @@ private:
                             false> GasDirMap;
     GasDirMap m_gas_dirs;
 
+    // Directive lookup results, pointed to by IdentifierInfo custom data.
+    std::deque<GasDirCache> m_dir_cache;
+
     // last "base" label for local (.) labels
     std::string m_locallabel_base;
 
@@ -218,9 +281,17 @@ private:
     // Have we seen a line marker?
     bool m_seen_line_marker;
 
-    // Index of local labels; what's stored here is the /next/ index,
-    // so these are all 0 at start.
-    SmallVector<unsigned long, 10> m_local;
+    // Numeric local labels, indexed by label number.  Only the instances
+    // "Nb" and "Nf" can be referenced, so just those symbols are kept.
+    struct LocalLabel
+    {
+        LocalLabel() : count(0), back(0), fwd(0) {}
+
+        unsigned long count;    // instances defined so far
+        Symbol* back;           // "Nb" instance; NULL if not yet looked up
+        Symbol* fwd;            // "Nf" instance; NULL if not yet looked up
+    };
+    std::vector<LocalLabel> m_local;
 
     // Start of comment.
     SourceLocation m_comment_start;
@@ -245,6 +316,85 @@ private:
     };
     std::vector<SectionState> m_section_stack;
     Section* m_previous_section;
+
+    // Section directives seen so far, keyed by their name/values.  Once a
+    // spec has been repeated without the .section handler reporting
+    // anything, later repeats just switch to the section.
+    struct SectionSpec
+    {
+        SectionSpec() : sect(0), count(0) {}
+
+        Section* sect;          // section switched to; NULL if stale
+        unsigned int count;     // quiet handler runs giving sect
+    };
+    typedef llvm::StringMap<SectionSpec> SectionSpecMap;
+    SectionSpecMap m_section_specs;
+    // Last spec applied to each section; its entry goes stale when a
+    // different spec is applied to the section.
+    llvm::DenseMap<Section*, SectionSpecMap::value_type*> m_section_spec;
+
+    // Macro definition.  The body is saved as lexed tokens, with the
+    // parameter references taken out of it and recorded as slots that the
+    // arguments are spliced into when the macro is expanded.
+    struct GasMacro
+    {
+        struct Param
+        {
+            IdentifierInfo* name;
+            std::vector<Token> def;     // default value
+            bool required;
+            bool vararg;
+        };
+        struct Slot
+        {
+            enum
+            {
+                COUNTER = -1,           // \@
+                SEPARATOR = -2          // \()
+            };
+            unsigned int pos;           // index of body token to insert before
+            int param;                  // parameter index, or one of above
+            SourceLocation source;      // location of the reference
+            bool start_of_line;         // reference starts a line
+            bool leading_space;         // reference has leading whitespace
+            bool paste_next;            // following token is adjacent
+        };
+        SourceLocation source;
+        std::vector<Param> params;
+        std::vector<Token> body;
+        std::vector<Slot> slots;
+        std::vector<unsigned int> strings;  // body strings with references
+        // The body, shared by all expansions, if it has no references.
+        IntrusiveRefCntPtr<TokenBuffer> fixed;
+    };
+    // Macros, keyed by lowercase name.
+    typedef llvm::StringMap<GasMacro> GasMacroMap;
+    GasMacroMap m_macros;
+
+    // Number of macros expanded so far (for \@).
+    unsigned long m_macro_count;
+
+    // Bodies of .rept blocks, keyed by the raw location of the .rept, so
+    // a nested .rept entered again with the same body can share it.
+    std::map<SourceLocation::UIntTy, IntrusiveRefCntPtr<TokenBuffer> >
+        m_rept_bodies;
+
+    // End of the piece of the main file being parsed (see ParsePiece());
+    // invalid if parsing to the end of the file.
+    SourceLocation m_piece_end;
+
+    // Record being written of the instructions of the piece being
+    // parsed, or NULL.  For the instruction being parsed, the symbols used
+    // (in order, with the location of each use) are kept, and whether
+    // anything else that can't be recorded was seen.
+    RecordWriter* m_record;
+    std::vector<std::pair<SymbolRef, SourceLocation> > m_record_uses;
+    bool m_record_ok;
+
+    // Record being replayed into the piece being parsed, or NULL, and the
+    // start of the next instruction statement it has.
+    RecordReader* m_replay;
+    SourceLocation m_replay_next;
 };
 
 }} // namespace yasm::parser
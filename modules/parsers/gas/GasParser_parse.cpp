@@ -32,6 +32,7 @@
 #include <cmath>
 #include <cstdio>
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/SmallString.h"
 #include "yasmx/Basic/Diagnostic.h"
 #include "yasmx/Basic/SourceManager.h"
@@ -41,6 +42,8 @@
 #include "yasmx/Arch.h"
 #include "yasmx/Bytecode.h"
 #include "yasmx/BytecodeContainer.h"
+#include "yasmx/Bytes.h"
+#include "yasmx/EffAddr.h"
 #include "yasmx/Expr_util.h"
 #include "yasmx/Object.h"
 #include "yasmx/Section.h"
@@ -56,34 +59,61 @@
 using namespace yasm;
 using namespace yasm::parser;
 
-bool
-GasParser::getLocalLabel(SmallVectorImpl<char>& name,
-                         StringRef num,
+SymbolRef
+GasParser::getLocalLabel(StringRef num,
                          char suffix,
                          SourceLocation source,
                          bool inc)
 {
-    // GasNumericParser needs a terminated StringRef; ensure it gets one.
-    SmallString<20> refnum;
-    refnum += num;
-    refnum.push_back('\0');
-    GasNumericParser numparse(refnum.str().substr(0, num.size()),
-                              m_token.getLocation(), m_preproc);
-    if (numparse.hadError() || !numparse.isInteger())
-        return false;
+    unsigned long ndx = 0;
+    if (!num.empty() && num.size() < 10 && (num[0] != '0' || num.size() == 1)
+        && num.find_first_not_of("0123456789") == StringRef::npos)
+    {
+        // Plain decimal: by far the most common case.
+        for (StringRef::iterator i=num.begin(), end=num.end(); i != end; ++i)
+            ndx = ndx*10 + (*i - '0');
+    }
+    else
+    {
+        // GasNumericParser needs a terminated StringRef; ensure it gets one.
+        SmallString<20> refnum;
+        refnum += num;
+        refnum.push_back('\0');
+        GasNumericParser numparse(refnum.str().substr(0, num.size()),
+                                  m_token.getLocation(), m_preproc);
+        if (numparse.hadError() || !numparse.isInteger())
+            return SymbolRef(0);
+
+        IntNum val;
+        numparse.getIntegerValue(&val);
+        ndx = val.getUInt();
+    }
 
-    IntNum val;
-    numparse.getIntegerValue(&val);
-    name.push_back('L');
-    val.getStr(name);
-    name.push_back('\001');
-    unsigned long ndx = val.getUInt();
     if (ndx >= m_local.size())
         m_local.resize(ndx+1);
-    IntNum(m_local[ndx] + (suffix == 'b' ? 0 : 1)).getStr(name);
+    LocalLabel& local = m_local[ndx];
+
+    // Only look up each instance by name once.
+    bool back = (suffix == 'b');
+    Symbol*& sym = back ? local.back : local.fwd;
+    if (!sym)
+    {
+        SmallString<20> name;
+        name.push_back('L');
+        IntNum(ndx).getStr(name);
+        name.push_back('\001');
+        IntNum(local.count + (back ? 0 : 1)).getStr(name);
+        sym = m_object->getSymbol(name);
+    }
+    SymbolRef result(sym);
+
     if (inc)
-        ++m_local[ndx];
-    return true;
+    {
+        ++local.count;
+        local.back = local.fwd;
+        local.fwd = 0;
+    }
+    return result;
 }
 
 bool
@@ -101,6 +131,7 @@ next:
     m_container = m_object->getCurSection();
 
     SourceLocation exp_source = m_token.getLocation();
+    m_object->setListLine(exp_source);
 
     switch (m_token.getKind())
     {
@@ -115,9 +146,16 @@ next:
                 // Label
                 SourceLocation id_source = ConsumeToken();
                 ConsumeToken(); // consume the colon too
-                ParseSymbol(ii)->CheckedDefineLabel(m_container->getEndLoc(),
-                                                    id_source,
-                                                    m_preproc.getDiagnostics());
+                SymbolRef sym = ParseSymbol(ii);
+                // The object format may move the label (not within .rept).
+                if (m_container == m_object->getCurSection())
+                {
+                    m_object->StartLabel(sym, id_source,
+                                         m_preproc.getDiagnostics());
+                    m_container = m_object->getCurSection();
+                }
+                sym->CheckedDefineLabel(m_container->getEndLoc(), id_source,
+                                        m_preproc.getDiagnostics());
                 goto next;
             }
             else if (peek_token.is(GasToken::equal))
@@ -138,28 +176,42 @@ next:
                 break;
             }
 
-            // possibly a directive; try to parse it
+            // macro invocation
             StringRef name = ii->getName();
+            if (!m_macros.empty())
+            {
+                SmallString<32> key;
+                for (StringRef::iterator i=name.begin(), end=name.end();
+                     i != end; ++i)
+                    key.push_back(std::tolower(*i));
+                GasMacroMap::const_iterator macro = m_macros.find(key);
+                if (macro != m_macros.end())
+                    return ExpandMacro(macro->second, exp_source);
+            }
+
+            // possibly a directive; try to parse it
             if (name[0] == '.')
             {
                 SourceLocation id_source = ConsumeToken();
 
                 // See if it's a gas-specific directive
-                GasDirMap::iterator p = m_gas_dirs.find(name);
-                if (p != m_gas_dirs.end())
+                const GasDirCache& cache = LookupDirective(ii);
+                if (cache.gas)
                 {
                     // call directive handler (function in this class) w/parameter
-                    return (this->*(p->second->handler))(p->second->param,
+                    return (this->*(cache.gas->handler))(cache.gas->param,
                                                          id_source);
                 }
 
                 DirectiveInfo dirinfo(*m_object, m_container->getEndLoc(),
                                       id_source);
+                if (cache.parsed &&
+                    cache.parsed(dirinfo, *this, m_preproc.getDiagnostics()))
+                    break;
                 ParseDirective(&dirinfo.getNameValues());
-                Directive dir;
-                if (m_dirs->get(&dir, name))
+                if (cache.found)
                 {
-                    dir(dirinfo, m_preproc.getDiagnostics());
+                    cache.dir(dirinfo, m_preproc.getDiagnostics());
                     break;
                 }
 
@@ -171,11 +223,27 @@ next:
             if (m_arch->hasParseInsn())
                 return m_arch->ParseInsn(*m_container, *this);
 
-            Insn::Ptr insn = ParseInsn();
-            if (insn.get() != 0)
+            if (m_replay && ReplayInsn(exp_source))
+                break;
+
+            RecordWriter::Mark mark;
+            std::size_t num_symbols = 0;
+            if (m_record)
+            {
+                mark = RecordWriter::getMark(*m_container);
+                num_symbols = m_object->symbols_end() -
+                    m_object->symbols_begin();
+                m_record_uses.clear();
+                m_record_ok = true;
+            }
+
+            Insn* insn = ParseInsn();
+            if (insn)
             {
-                insn->Append(*m_container, exp_source,
-                             m_preproc.getDiagnostics());
+                bool appended = insn->Append(*m_container, exp_source,
+                                             m_preproc.getDiagnostics());
+                if (m_record && appended)
+                    RecordInsn(exp_source, mark, num_symbols);
                 break;
             }
 
@@ -187,15 +255,16 @@ next:
         {
             // If it's an integer from 0-9 and followed by a colon,
             // it's a local label.
-            SmallString<20> labelname;
-            if (NextToken().isNot(Token::colon) ||
-                !getLocalLabel(labelname, m_token.getLiteral(), ':',
-                               m_token.getLocation(), true))
+            SymbolRef sym;
+            if (NextToken().is(Token::colon))
+                sym = getLocalLabel(m_token.getLiteral(), ':',
+                                    m_token.getLocation(), true);
+            if (!sym)
             {
                 Diag(m_token, diag::err_expected_insn_or_label_after_eol);
                 return false;
             }
-            DefineLabel(labelname, m_token.getLocation());
+            DefineLabel(sym, m_token.getLocation());
             ConsumeToken();
             ConsumeToken(); // also eat the :
             goto next;
@@ -217,6 +286,32 @@ next:
     return true;
 }
 
+const GasDirCache&
+GasParser::LookupDirective(IdentifierInfo* ii)
+{
+    if (GasDirCache* cache = ii->getCustom<GasDirCache>())
+        return *cache;
+
+    m_dir_cache.push_back(GasDirCache());
+    GasDirCache& cache = m_dir_cache.back();
+    StringRef name = ii->getName();
+    GasDirMap::iterator p = m_gas_dirs.find(name);
+    if (p != m_gas_dirs.end())
+    {
+        cache.gas = p->second;
+        cache.found = true;
+    }
+    else
+    {
+        cache.gas = 0;
+        cache.found = m_dirs->get(&cache.dir, name);
+        if (cache.found)
+            m_dirs->getParsed(&cache.parsed, name);
+    }
+    ii->setCustom(&cache);
+    return cache;
+}
+
 void
 GasParser::setDebugFile(StringRef filename,
                         SourceRange filename_source,
@@ -475,6 +570,516 @@ GasParser::ParseDirInclude(unsigned int param, SourceLocation source)
     return m_gas_preproc.HandleInclude(filename, filename_source);
 }
 
+static bool
+isBackslash(const Token& tok, const Preprocessor& preproc)
+{
+    if (tok.isNot(GasToken::unknown) || tok.getLength() != 1)
+        return false;
+    return preproc.getRawSpelling(tok)[0] == '\\';
+}
+
+bool
+GasParser::ParseMacroParams(GasMacro& macro, StringRef name)
+{
+    // Parameters, separated by commas or whitespace.  Each may be followed
+    // by a qualifier (:req or :vararg) and/or a default value (=value).
+    if (m_token.is(GasToken::comma))
+        ConsumeToken();
+    while (!m_token.isEndOfStatement())
+    {
+        if (m_token.isNot(GasToken::identifier) &&
+            m_token.isNot(GasToken::label))
+        {
+            Diag(m_token, diag::err_expected_ident);
+            return false;
+        }
+        GasMacro::Param p;
+        p.name = m_token.getIdentifierInfo();
+        p.required = false;
+        p.vararg = false;
+        for (std::vector<GasMacro::Param>::const_iterator
+             i=macro.params.begin(), end=macro.params.end(); i != end; ++i)
+        {
+            if (i->name == p.name)
+            {
+                Diag(m_token, diag::err_macro_duplicate_param)
+                    << p.name->getName() << name;
+                return false;
+            }
+        }
+        ConsumeToken();
+
+        if (m_token.is(GasToken::colon))
+        {
+            ConsumeToken();
+            IdentifierInfo* qual = m_token.getIdentifierInfo();
+            if ((m_token.isNot(GasToken::identifier) &&
+                 m_token.isNot(GasToken::label)) ||
+                (!qual->isStr("req") && !qual->isStr("vararg")))
+            {
+                SmallString<32> buf;
+                Diag(m_token, diag::err_macro_bad_qualifier)
+                    << m_preproc.getSpelling(m_token, buf);
+                return false;
+            }
+            p.required = qual->isStr("req");
+            p.vararg = qual->isStr("vararg");
+            ConsumeToken();
+        }
+
+        if (m_token.is(GasToken::equal))
+        {
+            ConsumeToken();
+            while (!m_token.isEndOfStatement() &&
+                   m_token.isNot(GasToken::comma) &&
+                   (p.def.empty() || !m_token.hasLeadingSpace()))
+            {
+                p.def.push_back(m_token);
+                ConsumeAnyToken();
+            }
+        }
+        macro.params.push_back(p);
+
+        if (m_token.is(GasToken::comma))
+            ConsumeToken();
+    }
+    return true;
+}
+
+bool
+GasParser::ParseDirMacro(unsigned int param, SourceLocation source)
+{
+    // On error, the body is still skipped.
+    GasMacro macro;
+    macro.source = source;
+    std::string key;
+    bool ok = false;
+    if (m_token.isNot(GasToken::identifier) && m_token.isNot(GasToken::label))
+        Diag(m_token, diag::err_expected_ident);
+    else
+    {
+        StringRef name = m_token.getIdentifierInfo()->getName();
+        key = name.lower();
+        if (m_macros.find(key) != m_macros.end())
+            Diag(m_token, diag::err_macro_redefined) << name;
+        else
+        {
+            ConsumeToken();
+            ok = ParseMacroParams(macro, name);
+        }
+    }
+    if (!ok)
+        SkipUntil(GasToken::eol, GasToken::semi, true, true);
+
+    // Lex and save tokens until we get an .endm.  References to parameters
+    // are taken out and recorded as slots.
+    int depth = 1;
+    for (;;)
+    {
+        if (m_token.isAtStartOfLine() && m_token.is(GasToken::label))
+        {
+            IdentifierInfo* ii = m_token.getIdentifierInfo();
+            if (ii->isStr(".endm"))
+            {
+                if (depth == 1)
+                    break;
+                --depth;
+            }
+            else if (ii->isStr(".macro"))
+                ++depth;    // handle nesting
+        }
+        if (m_token.is(GasToken::eof))
+        {
+            Diag(source, diag::err_macro_without_endm);
+            return false;
+        }
+
+        if (isBackslash(m_token, m_preproc))
+        {
+            bool found = true;
+            GasMacro::Slot slot;
+            slot.pos = macro.body.size();
+            slot.source = m_token.getLocation();
+            slot.start_of_line = m_token.isAtStartOfLine();
+            slot.leading_space = m_token.hasLeadingSpace();
+
+            const Token& next = NextToken();
+            IdentifierInfo* ii = next.getIdentifierInfo();
+            if (next.hasLeadingSpace() || next.isEndOfStatement())
+                found = false;
+            else if (ii)
+            {
+                found = false;
+                for (unsigned int i=0, n=macro.params.size(); i<n; ++i)
+                {
+                    if (macro.params[i].name == ii)
+                    {
+                        slot.param = i;
+                        found = true;
+                    }
+                }
+            }
+            else if (next.is(GasToken::at))
+                slot.param = GasMacro::Slot::COUNTER;
+            else if (next.is(GasToken::l_paren) &&
+                     m_preproc.LookAhead(1).is(GasToken::r_paren))
+                slot.param = GasMacro::Slot::SEPARATOR;
+            else
+                found = false;
+
+            if (found)
+            {
+                ConsumeToken(); // backslash
+                if (slot.param == GasMacro::Slot::SEPARATOR)
+                {
+                    ConsumeParen();
+                    ConsumeParen();
+                }
+                else
+                    ConsumeToken();
+                slot.paste_next = !m_token.hasLeadingSpace() &&
+                    !m_token.isAtStartOfLine();
+                macro.slots.push_back(slot);
+                continue;
+            }
+        }
+        if (m_token.is(GasToken::string_literal) &&
+            m_token.getLiteral().find('\\') != StringRef::npos)
+            macro.strings.push_back(macro.body.size());
+        macro.body.push_back(m_token);
+        ConsumeAnyToken();
+    }
+    ConsumeToken(); // consume the .endm
+
+    if (!ok)
+        return false;
+    if (macro.slots.empty() && macro.strings.empty() && !macro.body.empty())
+        macro.fixed = new TokenBuffer(&macro.body[0], macro.body.size());
+    m_macros[key] = macro;
+    return true;
+}
+
+bool
+GasParser::ParseDirEndm(unsigned int param, SourceLocation source)
+{
+    // Shouldn't ever get here unless we didn't get a .macro first
+    Diag(source, diag::err_endm_without_macro);
+    return false;
+}
+
+bool
+GasParser::ParseDirPurgem(unsigned int param, SourceLocation source)
+{
+    if (m_token.isNot(GasToken::identifier) && m_token.isNot(GasToken::label))
+    {
+        Diag(m_token, diag::err_expected_ident);
+        return false;
+    }
+    StringRef name = m_token.getIdentifierInfo()->getName();
+    GasMacroMap::iterator macro = m_macros.find(name.lower());
+    if (macro == m_macros.end())
+    {
+        Diag(m_token, diag::err_macro_undefined) << name;
+        return false;
+    }
+    m_macros.erase(macro);
+    ConsumeToken();
+    return true;
+}
+
+bool
+GasParser::ExpandMacro(const GasMacro& macro, SourceLocation source)
+{
+    StringRef name = m_token.getIdentifierInfo()->getName();
+    ConsumeToken();
+
+    // Arguments are separated by commas, or by whitespace outside of
+    // parentheses.  An argument may name its parameter (param=value).
+    unsigned int nparams = macro.params.size();
+    std::vector<std::vector<Token> > args(nparams);
+    std::vector<bool> given(nparams, false);
+    unsigned int next = 0;
+    if (m_token.is(GasToken::comma))
+        ConsumeToken();
+    while (!m_token.isEndOfStatement())
+    {
+        unsigned int n = next;
+        if ((m_token.is(GasToken::identifier) ||
+             m_token.is(GasToken::label)) &&
+            NextToken().is(GasToken::equal))
+        {
+            IdentifierInfo* ii = m_token.getIdentifierInfo();
+            for (n=0; n<nparams; ++n)
+            {
+                if (macro.params[n].name == ii)
+                    break;
+            }
+            if (n == nparams)
+            {
+                Diag(m_token, diag::err_macro_unknown_param)
+                    << name << ii->getName();
+                return false;
+            }
+            ConsumeToken();
+            ConsumeToken(); // also eat the =
+        }
+        else if (n >= nparams)
+        {
+            Diag(m_token, diag::err_macro_too_many_args) << name;
+            return false;
+        }
+        next = n+1;
+
+        std::vector<Token>& arg = args[n];
+        arg.clear();
+        given[n] = true;
+        int parens = 0;
+        while (!m_token.isEndOfStatement())
+        {
+            if (!macro.params[n].vararg && parens == 0 &&
+                (m_token.is(GasToken::comma) ||
+                 (!arg.empty() && m_token.hasLeadingSpace())))
+                break;
+            if (m_token.is(GasToken::l_paren))
+                ++parens;
+            else if (m_token.is(GasToken::r_paren) && parens > 0)
+                --parens;
+            arg.push_back(m_token);
+            ConsumeAnyToken();
+        }
+        if (m_token.is(GasToken::comma))
+            ConsumeToken();
+    }
+
+    for (unsigned int n=0; n<nparams; ++n)
+    {
+        if (given[n] && !args[n].empty())
+            continue;
+        if (macro.params[n].required)
+        {
+            Diag(source, diag::err_macro_missing_arg)
+                << macro.params[n].name->getName() << name;
+            return false;
+        }
+        if (!given[n])
+            args[n] = macro.params[n].def;
+    }
+
+    if (macro.fixed)
+    {
+        ++m_macro_count;
+        return m_gas_preproc.EnterMacro(macro.fixed.getPtr(), source);
+    }
+
+    // Splice the arguments into the body.  Tokens that were adjacent to a
+    // reference in the source are pasted together.
+    std::vector<Token> toks;
+    std::vector<unsigned int> paste;
+    toks.reserve(macro.body.size());
+    std::vector<GasMacro::Slot>::const_iterator slot = macro.slots.begin();
+    std::vector<GasMacro::Slot>::const_iterator slotend = macro.slots.end();
+    std::vector<unsigned int>::const_iterator str = macro.strings.begin();
+    for (unsigned int i=0, end=macro.body.size(); i<=end; ++i)
+    {
+        for (; slot != slotend && slot->pos == i; ++slot)
+        {
+            unsigned int start = toks.size();
+            if (slot->param == GasMacro::Slot::COUNTER)
+            {
+                SmallString<16> num;
+                IntNum(m_macro_count).getStr(num);
+                char* data = m_preproc.getPreprocessorAllocator()
+                    .Allocate<char>(num.size()+1);
+                std::copy(num.begin(), num.end(), data);
+                data[num.size()] = '\0';
+
+                Token tok;
+                tok.StartToken();
+                tok.setKind(GasToken::numeric_constant);
+                tok.setFlag(Token::Literal);
+                tok.setLiteralData(data);
+                tok.setLength(num.size());
+                tok.setLocation(slot->source);
+                toks.push_back(tok);
+            }
+            else if (slot->param >= 0)
+            {
+                const std::vector<Token>& arg = args[slot->param];
+                toks.insert(toks.end(), arg.begin(), arg.end());
+            }
+
+            if (toks.size() > start)
+            {
+                // The first token takes the place of the reference.
+                Token& first = toks[start];
+                first.setFlagValue(Token::StartOfLine, slot->start_of_line);
+                first.setFlagValue(Token::LeadingSpace, slot->leading_space);
+                if (start > 0 && !slot->leading_space &&
+                    !slot->start_of_line)
+                    paste.push_back(start);
+            }
+            else if (slot->leading_space || slot->start_of_line)
+                continue;   // nothing to paste to the following token
+            if (slot->paste_next)
+                paste.push_back(toks.size());
+        }
+        if (i == end)
+            break;
+        toks.push_back(macro.body[i]);
+        if (str != macro.strings.end() && *str == i)
+        {
+            SubstituteString(&toks.back(), macro, args);
+            ++str;
+        }
+    }
+    ++m_macro_count;
+
+    PasteTokens(toks, paste);
+    if (toks.empty())
+        return true;
+
+    Token* alloc_tokens = new Token[toks.size()];
+    std::copy(toks.begin(), toks.end(), alloc_tokens);
+    return m_gas_preproc.EnterMacro(alloc_tokens, toks.size(), source);
+}
+
+bool
+GasParser::SubstituteString(Token* tok,
+                            const GasMacro& macro,
+                            const std::vector<std::vector<Token> >& args)
+{
+    // References within strings can't be taken out when the body is lexed,
+    // so they are substituted as text.
+    StringRef str = tok->getLiteral();
+    SmallString<128> out;
+    bool changed = false;
+    for (size_t i=0, len=str.size(); i<len; ++i)
+    {
+        out.push_back(str[i]);
+        if (str[i] != '\\' || i+1 == len)
+            continue;
+        if (str[i+1] == '\\')
+        {
+            out.push_back(str[++i]);    // escaped backslash
+            continue;
+        }
+        if (str[i+1] == '@')
+        {
+            out.pop_back();
+            IntNum(m_macro_count).getStr(out);
+            ++i;
+            changed = true;
+            continue;
+        }
+        if (str.substr(i+1, 2) == "()")
+        {
+            out.pop_back();
+            i += 2;
+            changed = true;
+            continue;
+        }
+
+        size_t end = i+1;
+        while (end < len && (std::isalnum(str[end]) || str[end] == '_' ||
+                             str[end] == '.' || str[end] == '$'))
+            ++end;
+        StringRef name = str.slice(i+1, end);
+        for (unsigned int n=0, nparams=macro.params.size(); n<nparams; ++n)
+        {
+            if (!macro.params[n].name->getName().equals(name))
+                continue;
+            out.pop_back();
+            const std::vector<Token>& arg = args[n];
+            for (std::vector<Token>::const_iterator j=arg.begin(),
+                 jend=arg.end(); j != jend; ++j)
+            {
+                if (j != arg.begin() && j->hasLeadingSpace())
+                    out.push_back(' ');
+                SmallString<32> buf;
+                out += m_preproc.getSpelling(*j, buf);
+            }
+            i = end-1;
+            changed = true;
+            break;
+        }
+    }
+    if (!changed)
+        return false;
+
+    char* data =
+        m_preproc.getPreprocessorAllocator().Allocate<char>(out.size()+1);
+    std::copy(out.begin(), out.end(), data);
+    data[out.size()] = '\0';
+    tok->setLiteralData(data);
+    tok->setLength(out.size());
+    return true;
+}
+
+void
+GasParser::PasteTokens(std::vector<Token>& toks,
+                       const std::vector<unsigned int>& paste)
+{
+    if (paste.empty())
+        return;
+
+    // Paste identifiers and numbers into a single identifier or number;
+    // anything else is already a separate token.
+    std::vector<Token>::iterator out = toks.begin() + paste.front();
+    std::vector<unsigned int>::const_iterator p = paste.begin();
+    SmallString<64> spelling;
+    for (unsigned int i=paste.front(), end=toks.size(); i<end; ++i)
+    {
+        const Token& tok = toks[i];
+        bool do_paste = false;
+        if (p != paste.end() && *p == i)
+        {
+            ++p;
+            while (p != paste.end() && *p == i)
+                ++p;
+            do_paste = (tok.is(GasToken::identifier) ||
+                        tok.is(GasToken::label) ||
+                        tok.is(GasToken::numeric_constant)) &&
+                       (out[-1].is(GasToken::identifier) ||
+                        out[-1].is(GasToken::label) ||
+                        out[-1].is(GasToken::numeric_constant));
+        }
+        if (!do_paste)
+        {
+            *out++ = tok;
+            continue;
+        }
+
+        Token& prev = out[-1];
+        SmallString<32> buf1, buf2;
+        spelling = m_preproc.getSpelling(prev, buf1);
+        spelling += m_preproc.getSpelling(tok, buf2);
+        prev.setLength(spelling.size());
+        if (spelling[0] >= '0' && spelling[0] <= '9')
+        {
+            char* data = m_preproc.getPreprocessorAllocator()
+                .Allocate<char>(spelling.size()+1);
+            std::copy(spelling.begin(), spelling.end(), data);
+            data[spelling.size()] = '\0';
+            prev.setKind(GasToken::numeric_constant);
+            prev.setFlag(Token::Literal);
+            prev.setLiteralData(data);
+        }
+        else
+        {
+            IdentifierInfo* ii = m_preproc.getIdentifierInfo(spelling);
+            prev.clearFlag(Token::Literal);
+            prev.setIdentifierInfo(ii);
+            if (ii->getTokenKind() != Token::unknown)
+                prev.setKind(ii->getTokenKind());
+            else if (spelling[0] == '.' || spelling[0] == '_')
+                prev.setKind(GasToken::label);
+            else
+                prev.setKind(GasToken::identifier);
+        }
+    }
+    toks.erase(out, toks.end());
+}
+
 bool
 GasParser::ParseDirRept(unsigned int param, SourceLocation source)
 {
@@ -530,16 +1135,132 @@ GasParser::ParseDirRept(unsigned int param, SourceLocation source)
             return false;
         }
         tokens.push_back(m_token);
-        ConsumeToken();
+        ConsumeAnyToken();
+    }
+    // A body of nothing but constant data is parsed once and wrapped in a
+    // multiple bytecode rather than being replayed count times.
+    if (count > 1 && isConstantDataBody(tokens))
+    {
+        // Terminate the body with an eof so we know when it's been parsed.
+        Token end;
+        end.StartToken();
+        end.setKind(GasToken::eof);
+        end.setFlag(Token::EndOfStatement);
+        end.setLocation(m_token.getLocation());
+        tokens.push_back(end);
+
+        m_preproc.EnterTokenStream(getReptBody(tokens, source), false);
+        ConsumeToken(); // consume the .endr and get the first body token
+
+        BytecodeContainer* outer = m_container;
+        std::auto_ptr<BytecodeContainer>
+            inner(new BytecodeContainer(outer->getSection()));
+        while (m_token.isNot(GasToken::eof))
+        {
+            if (m_token.isEndOfStatement())
+            {
+                ConsumeToken();
+                continue;
+            }
+            const GasDirLookup* dir =
+                m_gas_dirs.find(m_token.getIdentifierInfo()->getName())
+                ->second;
+            SourceLocation id_source = ConsumeToken();
+            m_container = inner.get();
+            bool result = (this->*(dir->handler))(dir->param, id_source);
+            if (result && !m_token.isEndOfStatement())
+                Diag(m_token, diag::err_eol_junk);
+            SkipUntil(GasToken::eol, GasToken::semi, true, false);
+        }
+        m_container = outer;
+        ConsumeToken(); // consume the eof and get the token after the .endr
+
+        if (inner->size() > 0)
+            AppendMultiple(*m_container, inner, Expr::Ptr(new Expr(intn)),
+                           source);
+        return true;
     }
-    Token* alloc_tokens = new Token[count*tokens.size()];
-    for (unsigned long i=0; i<count; ++i)
-        std::copy(tokens.begin(), tokens.end(), &alloc_tokens[i*tokens.size()]);
-    m_preproc.EnterTokenStream(alloc_tokens, count*tokens.size(), false, true);
+
+    // Save a single copy of the body; the token lexer replays it count times.
+    m_preproc.EnterTokenStream(getReptBody(tokens, source), false, count);
     ConsumeToken(); // consume the .endr and get the first repeated token
     return true;
 }
 
+TokenBuffer*
+GasParser::getReptBody(const SmallVectorImpl<Token>& tokens,
+                       SourceLocation source)
+{
+    // A .rept inside a repeated block or macro is lexed again each time
+    // it's reached, usually with the same body as the time before.
+    IntrusiveRefCntPtr<TokenBuffer>& body =
+        m_rept_bodies[source.getRawEncoding()];
+    if (!body || !body->equals(tokens.data(), tokens.size()))
+        body = new TokenBuffer(tokens.data(), tokens.size());
+    return body.getPtr();
+}
+
+bool
+GasParser::isConstantDataBody(const SmallVectorImpl<Token>& tokens) const
+{
+    bool start = true;
+    bool has_data = false;
+    for (SmallVectorImpl<Token>::const_iterator i = tokens.begin(),
+         end = tokens.end(); i != end; ++i)
+    {
+        if (i->isEndOfStatement())
+        {
+            start = true;
+            continue;
+        }
+
+        if (start)
+        {
+            // Each statement must be a data directive; anything else
+            // (labels, instructions, other directives) may have side effects
+            // or depend on the current position.
+            if (i->isNot(GasToken::identifier) && i->isNot(GasToken::label))
+                return false;
+            GasDirMap::const_iterator p =
+                m_gas_dirs.find(i->getIdentifierInfo()->getName());
+            if (p == m_gas_dirs.end())
+                return false;
+            bool (GasParser::*handler) (unsigned int, SourceLocation) =
+                p->second->handler;
+            if (handler != &GasParser::ParseDirData &&
+                handler != &GasParser::ParseDirAscii &&
+                handler != &GasParser::ParseDirFloat &&
+                handler != &GasParser::ParseDirZero &&
+                handler != &GasParser::ParseDirFill)
+                return false;
+            start = false;
+            has_data = true;
+            continue;
+        }
+
+        // Operands must be constant: no symbol references (including ".")
+        // and no local label references.
+        switch (i->getKind())
+        {
+            case GasToken::identifier:
+            case GasToken::label:
+                return false;
+            case GasToken::numeric_constant:
+            {
+                StringRef literal = i->getLiteral();
+                bool ishex = (literal.size() > 2 && literal[0] == '0' &&
+                              (literal[1] == 'x' || literal[1] == 'X'));
+                if (!ishex && (literal.back() == 'b' || literal.back() == 'f'))
+                    return false;
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    return has_data;
+}
+
 bool
 GasParser::ParseDirEndr(unsigned int param, SourceLocation source)
 {
@@ -730,11 +1451,19 @@ GasParser::ParseDirAscii(unsigned int withzero, SourceLocation source)
         }
         else if (m_token.is(GasToken::string_literal))
         {
-            SmallString<64> strbuf;
             GasStringParser str(m_token.getLiteral(), m_token.getLocation(),
                                 m_preproc);
             if (!str.hadError())
-                AppendData(*m_container, str.getString(strbuf), withzero);
+            {
+                // Unescape straight into the fixed data; the zero
+                // terminator is already there from the resize.
+                Bytes& fixed = m_container->FreshBytecode().getFixed();
+                Bytes::size_type pos = fixed.size();
+                fixed.resize(pos + str.getMaxLength() + 1);
+                std::size_t len =
+                    str.CopyString(reinterpret_cast<char*>(&fixed[pos]));
+                fixed.resize(pos + len + (withzero ? 1 : 0));
+            }
             ConsumeToken();
         }
         else if (m_token.isEndOfStatement())
@@ -758,6 +1487,11 @@ GasParser::ParseDirFloat(unsigned int size, SourceLocation source)
     if (m_token.isEndOfStatement())
         return true;
 
+    // Single and double precision values that convert exactly are
+    // gathered into runs and written directly.
+    SmallVector<uint64_t, 64> vals;
+    bool plain = (size == 4 || size == 8);
+
     SourceLocation lastcomma = m_token.getLocation().getLocWithOffset(-1);
     for (;;)
     {
@@ -799,14 +1533,24 @@ GasParser::ParseDirFloat(unsigned int size, SourceLocation source)
         }
 
         GasNumericParser num(num_str, num_source, m_preproc, true);
+        uint64_t bits;
         if (num.hadError())
             ;
         else if (num.isInteger())
         {
             Diag(num_source, diag::err_expected_float);
         }
+        else if (plain && num.getIEEEBits(size*8, &bits))
+        {
+            vals.push_back(bits);
+        }
         else if (num.isFloat())
         {
+            if (!vals.empty())
+            {
+                AppendDataArray(*m_container, vals, size, *m_arch);
+                vals.clear();
+            }
             // FIXME: Make arch-dependent
             Expr::Ptr e(new Expr(std::auto_ptr<llvm::APFloat>(new llvm::APFloat(
                 num.getFloatValue(llvm::APFloat::x87DoubleExtended))),
@@ -819,6 +1563,72 @@ GasParser::ParseDirFloat(unsigned int size, SourceLocation source)
         lastcomma = m_token.getLocation();
         ConsumeToken();
     }
+    if (!vals.empty())
+        AppendDataArray(*m_container, vals, size, *m_arch);
+    return true;
+}
+
+/// Get the value of an integer literal with no suffix that fits in 64 bits.
+static bool
+getPlainInteger(StringRef literal, uint64_t* val)
+{
+    unsigned int radix = 10;
+    StringRef digits = literal;
+    if (literal.size() > 2 && literal[0] == '0' &&
+        (literal[1] == 'x' || literal[1] == 'X'))
+    {
+        radix = 16;
+        digits = literal.substr(2);
+    }
+    else if (literal.size() > 2 && literal[0] == '0' &&
+             (literal[1] == 'b' || literal[1] == 'B'))
+    {
+        radix = 2;
+        digits = literal.substr(2);
+    }
+    else if (literal.size() > 1 && literal[0] == '0')
+        radix = 8;
+
+    uint64_t v = 0;
+    for (StringRef::iterator i=digits.begin(), end=digits.end(); i != end;
+         ++i)
+    {
+        unsigned int digit;
+        if (*i >= '0' && *i <= '9')
+            digit = *i - '0';
+        else if (*i >= 'a' && *i <= 'f')
+            digit = *i - 'a' + 10;
+        else if (*i >= 'A' && *i <= 'F')
+            digit = *i - 'A' + 10;
+        else
+            return false;
+        if (digit >= radix || v > (UINT64_MAX - digit) / radix)
+            return false;
+        v = v*radix + digit;
+    }
+    *val = v;
+    return true;
+}
+
+bool
+GasParser::ParsePlainInteger(uint64_t* val)
+{
+    // Only a literal (optionally negated) that is the whole data value.
+    bool neg = m_token.is(GasToken::minus);
+    const Token& num = neg ? NextToken() : m_token;
+    if (num.isNot(GasToken::numeric_constant) ||
+        !getPlainInteger(num.getLiteral(), val))
+        return false;
+    const Token& next = neg ? m_preproc.LookAhead(1) : NextToken();
+    if (next.isNot(GasToken::comma) && !next.isEndOfStatement())
+        return false;
+
+    if (neg)
+    {
+        *val = -*val;
+        ConsumeToken();
+    }
+    ConsumeToken();
     return true;
 }
 
@@ -828,24 +1638,40 @@ GasParser::ParseDirData(unsigned int size, SourceLocation source)
     if (m_token.isEndOfStatement())
         return true;
 
+    // Runs of plain integer literals are written directly rather than
+    // building an expression for each value.
+    SmallVector<uint64_t, 64> vals;
     SourceLocation lastcomma = m_token.getLocation().getLocWithOffset(-1);
     for (;;)
     {
-        SourceLocation cur_source = m_token.getLocation();
-        std::auto_ptr<Expr> e(new Expr);
-        if (!ParseExpr(*e))
+        uint64_t val;
+        if (size <= 8 && ParsePlainInteger(&val))
+            vals.push_back(val);
+        else
         {
-            Diag(lastcomma.getLocWithOffset(1),
-                 diag::warn_zero_assumed_for_missing_expression);
-            *e = 0;
+            if (!vals.empty())
+            {
+                AppendDataArray(*m_container, vals, size, *m_arch);
+                vals.clear();
+            }
+            SourceLocation cur_source = m_token.getLocation();
+            std::auto_ptr<Expr> e(new Expr);
+            if (!ParseExpr(*e))
+            {
+                Diag(lastcomma.getLocWithOffset(1),
+                     diag::warn_zero_assumed_for_missing_expression);
+                *e = 0;
+            }
+            AppendData(*m_container, e, size, *m_arch, cur_source,
+                       m_preproc.getDiagnostics());
         }
-        AppendData(*m_container, e, size, *m_arch, cur_source,
-                   m_preproc.getDiagnostics());
         if (m_token.isNot(GasToken::comma))
             break;
         lastcomma = m_token.getLocation();
         ConsumeToken();
     }
+    if (!vals.empty())
+        AppendDataArray(*m_container, vals, size, *m_arch);
     return true;
 }
 
@@ -1109,6 +1935,51 @@ ParseDirSectionExprTerm::operator()
     return true;
 }
 
+// Append a name/value to a section spec, the key used to cache section
+// directives.
+static void
+AppendSectionSpec(SmallVectorImpl<char>& spec,
+                  StringRef name,
+                  char type,
+                  StringRef value)
+{
+    spec.append(name.begin(), name.end());
+    spec.push_back('=');
+    spec.push_back(type);
+    spec.append(value.begin(), value.end());
+    spec.push_back('\0');
+}
+
+// Returns false if the value can't be compared this way.
+static bool
+AppendSectionSpec(SmallVectorImpl<char>& spec,
+                  const NameValue& nv,
+                  Object& object)
+{
+    if (nv.isId())
+        AppendSectionSpec(spec, nv.getName(), 'i', nv.getString());
+    else if (nv.isString())
+        AppendSectionSpec(spec, nv.getName(), 's', nv.getString());
+    else if (nv.isToken())
+    {
+        char kind[2] = {'\0', '\0'};
+        kind[0] = static_cast<char>(nv.getToken().getKind());
+        AppendSectionSpec(spec, nv.getName(), 't', StringRef(kind, 1));
+    }
+    else if (nv.isExpr())
+    {
+        Expr e = nv.getExpr(object);
+        if (!e.isIntNum())
+            return false;
+        SmallString<32> num;
+        e.getIntNum().getStr(num);
+        AppendSectionSpec(spec, nv.getName(), 'n', num);
+    }
+    else
+        return false;
+    return true;
+}
+
 bool
 GasParser::ParseDirSection(unsigned int param, SourceLocation source)
 {
@@ -1156,12 +2027,18 @@ GasParser::ParseDirSection(unsigned int param, SourceLocation source)
 
     m_previous_section = m_object->getCurSection();
 
-    Directive handler;
-    if (m_dirs->get(&handler, ".section"))
-        handler(info, m_preproc.getDiagnostics());
-    else
-        Diag(info.getSource(), diag::err_unrecognized_directive);
-
+    SmallString<128> spec;
+    for (NameValues::const_iterator nv=nvs.begin(), end=nvs.end();
+         nv != end; ++nv)
+    {
+        if (!AppendSectionSpec(spec, *nv, *m_object))
+        {
+            spec.clear();
+            break;
+        }
+    }
+    if (!SwitchCachedSection(spec))
+        DoSectionHandler(spec, info);
     return true;
 }
 
@@ -1323,7 +2200,7 @@ GasParser::SkipConditional(SourceLocation begin)
         if (!m_token.isAtStartOfLine() || m_token.isNot(GasToken::label))
         {
             prev_token = m_token;
-            ConsumeToken();
+            ConsumeAnyToken();
             continue;
         }
         IdentifierInfo* ii = m_token.getIdentifierInfo();
@@ -1352,7 +2229,7 @@ GasParser::SkipConditional(SourceLocation begin)
             }
         }
         prev_token = m_token;
-        ConsumeToken();
+        ConsumeAnyToken();
     }
 }
 
@@ -1574,11 +2451,11 @@ GasParser::ParseDirSyntax(unsigned int intel, SourceLocation source)
     return true;
 }
 
-Insn::Ptr
+Insn*
 GasParser::ParseInsn()
 {
     if (m_token.isNot(GasToken::identifier))
-        return Insn::Ptr(0);
+        return 0;
 
     IdentifierInfo* ii = m_token.getIdentifierInfo();
     ii->DoInsnLookup(*m_arch, m_token.getLocation(),
@@ -1587,7 +2464,8 @@ GasParser::ParseInsn()
     {
         ConsumeToken();
 
-        Insn::Ptr insn(m_arch->CreateInsn(insninfo));
+        m_arch->ReuseInsn(m_insn, insninfo);
+        Insn* insn = m_insn.get();
         if (m_token.isEndOfStatement())
             return insn; // no operands
 
@@ -1609,9 +2487,12 @@ GasParser::ParseInsn()
     if (const Prefix* prefix = ii->getPrefix())
     {
         SourceLocation prefix_source = ConsumeToken();
-        Insn::Ptr insn = ParseInsn();
-        if (insn.get() == 0)
-            insn = m_arch->CreateEmptyInsn();
+        Insn* insn = ParseInsn();
+        if (!insn)
+        {
+            m_arch->ReuseInsn(m_insn, 0);
+            insn = m_insn.get();
+        }
         insn->AddPrefix(prefix, prefix_source);
         return insn;
     }
@@ -1621,16 +2502,85 @@ GasParser::ParseInsn()
     if (const SegmentRegister* segreg = ii->getSegReg())
     {
         SourceLocation segreg_source = ConsumeToken();
-        Insn::Ptr insn = ParseInsn();
-        if (insn.get() == 0)
-            insn = m_arch->CreateEmptyInsn();
+        Insn* insn = ParseInsn();
+        if (!insn)
+        {
+            m_arch->ReuseInsn(m_insn, 0);
+            insn = m_insn.get();
+        }
         else if (insn->hasSegPrefix())
             Diag(segreg_source, diag::warn_multiple_seg_override);
         insn->setSegPrefix(segreg, segreg_source);
         return insn;
     }
 
-    return Insn::Ptr(0);
+    return 0;
+}
+
+bool
+GasParser::ReplayInsn(SourceLocation source)
+{
+    if (source != m_replay_next)
+        return false;
+
+    // Use the symbols as parsing the operands would have, creating them
+    // in the same order.
+    for (uint64_t n = m_replay->ReadUnsigned(); n > 0; --n)
+    {
+        StringRef name = m_replay->ReadString();
+        SourceLocation use_source = m_replay->ReadSource();
+        m_object->getSymbol(name)->Use(use_source);
+    }
+    m_container->MarkInsn();
+    m_replay->ReadAppended(*m_container);
+    m_replay_next = m_replay->ReadSource();
+
+    // Leave the end of the statement to the caller.
+    SkipUntil(GasToken::eol, GasToken::semi, true, true);
+    return true;
+}
+
+void
+GasParser::RecordInsn(SourceLocation source,
+                      const RecordWriter::Mark& mark,
+                      std::size_t num_symbols)
+{
+    Bytes& bytes = m_record->getBytes();
+    std::size_t start = bytes.size();
+
+    // Symbols created by the instruction must have been created by its
+    // uses, so replaying the uses creates them again.
+    bool ok = m_record_ok;
+    for (Object::symbol_iterator i=m_object->symbols_begin()+num_symbols,
+         end=m_object->symbols_end(); ok && i != end; ++i)
+    {
+        ok = false;
+        for (std::size_t j=0; j<m_record_uses.size(); ++j)
+        {
+            if (m_record_uses[j].first == SymbolRef(&*i))
+                ok = true;
+        }
+    }
+
+    if (ok)
+        ok = m_record->WriteSource(source);
+    if (ok)
+    {
+        m_record->WriteUnsigned(m_record_uses.size());
+        for (std::size_t j=0; ok && j<m_record_uses.size(); ++j)
+        {
+            SymbolRef sym = m_record_uses[j].first;
+            ok = m_object->FindSymbol(sym->getName()) == sym;
+            m_record->WriteString(sym->getName());
+            ok = ok && m_record->WriteSource(m_record_uses[j].second);
+        }
+    }
+    if (ok)
+        ok = m_record->WriteAppended(*m_container, mark);
+
+    // Drop what can't be recorded; it will be parsed again on replay.
+    if (!ok)
+        bytes.resize(start);
 }
 
 bool
@@ -1693,7 +2643,7 @@ GasParser::ParseDirective(NameValues* nvs, const ParseExprTerm* parse_term)
             case GasToken::percent:
             {
                 // some kind of register
-                ConsumeToken();
+                SourceLocation reg_src = ConsumeToken();
                 if (m_token.isNot(GasToken::identifier))
                 {
                     Diag(m_token, diag::err_bad_register_name);
@@ -1704,18 +2654,21 @@ GasParser::ParseDirective(NameValues* nvs, const ParseExprTerm* parse_term)
                                 m_preproc.getDiagnostics());
                 if (const Register* reg = ii->getRegister())
                 {
-                    ConsumeToken();
+                    SourceLocation name_src = ConsumeToken();
                     nvs->push_back(new NameValue(Expr::Ptr(new Expr(*reg))));
+                    nvs->back().setValueRange(SourceRange(reg_src, name_src));
                     break;
                 }
                 if (const RegisterGroup* reggroup = ii->getRegGroup())
                 {
-                    ConsumeToken();
+                    SourceLocation name_src = ConsumeToken();
 
                     if (m_token.isNot(GasToken::l_paren))
                     {
                         nvs->push_back(new NameValue(Expr::Ptr(
                             new Expr(*reggroup->getReg(0)))));
+                        nvs->back().setValueRange(SourceRange(reg_src,
+                                                              name_src));
                         break;
                     }
                     SourceLocation lparen_loc = ConsumeParen();
@@ -1738,6 +2691,8 @@ GasParser::ParseDirective(NameValues* nvs, const ParseExprTerm* parse_term)
                         return false;
                     }
                     nvs->push_back(new NameValue(Expr::Ptr(new Expr(*reg))));
+                    nvs->back().setValueRange(SourceRange(reg_src,
+                                                          regindex_source));
                     break;
                 }
                 // didn't recognize it?
@@ -1774,6 +2729,14 @@ GasParser::ParseMemoryAddress()
 {
     bool strong = false;
 
+    // Registers and displacement of a (base,index,scale) address, for
+    // EffAddr::setDecomposed().
+    const Register* basereg = 0;
+    const Register* indexreg = 0;
+    unsigned int scalenum = 0;
+    bool decompose = true;
+    Expr disp;
+
     // We want to parse a leading expression, except when it's actually
     // just a memory address (with no preceding expression) such as
     // (REG...) or (,...).
@@ -1798,7 +2761,7 @@ GasParser::ParseMemoryAddress()
         if (m_token.is(GasToken::percent))
         {
             ConsumeToken();
-            const Register* basereg = ParseRegister();
+            basereg = ParseRegister();
             if (!basereg)
             {
                 Diag(m_token, diag::err_bad_register_name);
@@ -1864,6 +2827,13 @@ done:
             else
             {
                 e2 += MUL(*reg, scale);
+                if (scale.isIntNum() && scale.getIntNum().isInRange(1, 255))
+                {
+                    indexreg = reg;
+                    scalenum = scale.getIntNum().getUInt();
+                }
+                else
+                    decompose = false;
             }
         }
 
@@ -1871,7 +2841,9 @@ done:
         {
             // Ordering is critical here to correctly detecting presence of
             // RIP in RIP-relative expressions.
-            e1 = ADD(e2, e1);
+            Expr sum = ADD(e2, e1);
+            std::swap(disp, e1);
+            std::swap(e1, sum);
         }
         else
             std::swap(e1, e2);
@@ -1888,7 +2860,17 @@ done:
     Operand op(m_object->getArch()->CreateEffAddr(e1_copy));
 
     if (strong)
-        op.getMemory()->m_strong = true;
+    {
+        EffAddr* ea = op.getMemory();
+        ea->m_strong = true;
+        // As in GNU as, an index without a base is kept as written
+        // rather than turned into a base register, so (,%ebx,1) stays
+        // a SIB address (as the i386 TLS general dynamic sequence needs).
+        if (indexreg && !basereg)
+            ea->m_nosplit = true;
+        if (decompose && (basereg || indexreg))
+            ea->setDecomposed(basereg, indexreg, scalenum, disp);
+    }
     return op;
 }
 
@@ -2488,16 +3470,18 @@ GasParser::ParseExpr3(Expr& e, const ParseExprTerm* parse_term)
         {
             // handle forward/backward local label reference
             StringRef literal = m_token.getLiteral();
-            SmallString<20> llname;
             bool ishex = (literal.size() > 2 && literal[0] == '0' &&
                           (literal[1] == 'x' || literal[1] == 'X'));
-            if (!ishex && (literal.back() == 'b' || literal.back() == 'f') &&
-                getLocalLabel(llname, literal.substr(0, literal.size()-1),
-                                  literal.back(), m_token.getLocation()))
+            SymbolRef sym;
+            if (!ishex && (literal.back() == 'b' || literal.back() == 'f'))
+                sym = getLocalLabel(literal.substr(0, literal.size()-1),
+                                    literal.back(), m_token.getLocation());
+            if (sym)
             {
                 SourceLocation id_source = ConsumeToken();
-                SymbolRef sym = m_object->getSymbol(llname);
                 sym->Use(id_source);
+                if (m_record)
+                    m_record_uses.push_back(std::make_pair(sym, id_source));
                 e = Expr(sym, id_source);
                 break;
             }
@@ -2545,15 +3529,16 @@ GasParser::ParseExpr3(Expr& e, const ParseExprTerm* parse_term)
             // "." references the current assembly position
             if (ii->isStr("."))
             {
-                SymbolRef sym = m_object->AddNonTableSymbol(".");
-                sym->CheckedDefineLabel(m_container->getEndLoc(), id_source,
-                                        m_preproc.getDiagnostics());
+                SymbolRef sym = m_object->getSymbol(m_container->getEndLoc());
                 e = Expr(sym, id_source);
+                m_record_ok = false;    // location symbols aren't named
             }
             else
             {
                 SymbolRef sym = ParseSymbol(ii);
                 sym->Use(id_source);
+                if (m_record)
+                    m_record_uses.push_back(std::make_pair(sym, id_source));
                 e = Expr(sym, id_source);
             }
 
@@ -2632,9 +3617,8 @@ GasParser::ParseRegister()
 }
 
 void
-GasParser::DefineLabel(StringRef name, SourceLocation source)
+GasParser::DefineLabel(SymbolRef sym, SourceLocation source)
 {
-    SymbolRef sym = m_object->getSymbol(name);
     sym->CheckedDefineLabel(m_container->getEndLoc(), source,
                             m_preproc.getDiagnostics());
 }
@@ -2674,16 +3658,74 @@ GasParser::DefineLcomm(SymbolRef sym,
 void
 GasParser::SwitchSection(StringRef name, bool builtin, SourceRange source)
 {
+    SmallString<64> spec;
+    AppendSectionSpec(spec, StringRef(), 'i', name);
+    if (SwitchCachedSection(spec))
+        return;
+
     DirectiveInfo info(*m_object, m_container->getEndLoc(), source.getBegin());
     NameValues& nvs = info.getNameValues();
     nvs.push_back(new NameValue(name, '\0'));
     nvs.back().setValueRange(source);
+    DoSectionHandler(spec, info);
+}
+
+bool
+GasParser::SwitchCachedSection(StringRef spec)
+{
+    SectionSpecMap::const_iterator i = m_section_specs.find(spec);
+    if (i == m_section_specs.end() || !i->getValue().sect ||
+        i->getValue().count < 2)
+        return false;
+    m_object->setCurSection(i->getValue().sect);
+    return true;
+}
 
+void
+GasParser::DoSectionHandler(StringRef spec, DirectiveInfo& info)
+{
     Directive handler;
-    if (m_dirs->get(&handler, ".section"))
-        handler(info, m_preproc.getDiagnostics());
-    else
+    if (!m_dirs->get(&handler, ".section"))
+    {
         Diag(info.getSource(), diag::err_unrecognized_directive);
+        return;
+    }
+
+    DiagnosticsEngine& diags = m_preproc.getDiagnostics();
+    DiagnosticErrorTrap trap(diags);
+    unsigned int num_warnings = diags.getNumWarnings();
+    handler(info, diags);
+    if (spec.empty())
+        return;
+
+    // The first run may create or set up the section, so a spec is only
+    // trusted once a repeat has given the same section without reporting
+    // anything (e.g. COFF warns on every repeat with flags).
+    Section* sect = m_object->getCurSection();
+    SectionSpecMap::value_type& entry =
+        m_section_specs.GetOrCreateValue(spec);
+    SectionSpec& cached = entry.getValue();
+    if (trap.hasErrorOccurred() || diags.getNumWarnings() != num_warnings)
+    {
+        cached.sect = 0;
+        cached.count = 0;
+    }
+    else if (cached.sect == sect)
+        ++cached.count;
+    else
+    {
+        cached.sect = sect;
+        cached.count = 1;
+    }
+
+    // A different spec may have changed the section's flags.
+    SectionSpecMap::value_type*& last = m_section_spec[sect];
+    if (last && last != &entry)
+    {
+        last->getValue().sect = 0;
+        last->getValue().count = 0;
+    }
+    last = &entry;
 }
 
 Section&
@@ -2701,6 +3743,8 @@ GasParser::DoParse()
 {
     while (m_token.isNot(GasToken::eof))
     {
+        if (m_piece_end.isValid() && !(m_token.getLocation() < m_piece_end))
+            break;
         if (m_token.isEndOfStatement())
             ConsumeToken();
         else
@@ -30,7 +30,11 @@
 //
 #include "GasPreproc.h"
 
+#include <cstring>
+
+#include "llvm/Support/MemoryBuffer.h"
 #include "yasmx/Basic/FileManager.h"
+#include "yasmx/Basic/SourceManager.h"
 #include "yasmx/Parse/HeaderSearch.h"
 
 #include "GasLexer.h"
@@ -42,6 +46,7 @@ GasPreproc::GasPreproc(DiagnosticsEngine& diags,
                        SourceManager& sm,
                        HeaderSearch& headers)
     : Preprocessor(diags, sm, headers)
+    , m_prefetch(true)
 {
 }
 
@@ -107,13 +112,103 @@ GasPreproc::HandleInclude(StringRef filename, SourceLocation source)
     return true;
 }
 
+bool
+GasPreproc::EnterMacro(Token* toks, unsigned int num_toks,
+                       SourceLocation source)
+{
+    if (m_include_macro_stack.size() >= MaxAllowedIncludeStackDepth-1)
+    {
+        delete[] toks;
+        Diag(source, diag::err_macro_too_deep);
+        return false;
+    }
+    EnterTokenStream(toks, num_toks, false, true);
+    return true;
+}
+
+bool
+GasPreproc::EnterMacro(TokenBuffer* toks, SourceLocation source)
+{
+    if (m_include_macro_stack.size() >= MaxAllowedIncludeStackDepth-1)
+    {
+        Diag(source, diag::err_macro_too_deep);
+        return false;
+    }
+    EnterTokenStream(toks, false);
+    return true;
+}
+
 void
 GasPreproc::RegisterBuiltinMacros()
 {
 }
 
+// Start reading the files a just-entered file will .include in the
+// background, so they're ready by the time they're reached rather than
+// stalling on a slow file system.  Only directives outside of conditionals,
+// macro definitions and .rept blocks are looked at, so files that won't be
+// used are seldom read.
+void
+GasPreproc::PrefetchIncludes(FileID fid, const MemoryBuffer* input_buffer)
+{
+    const FileEntry* file = m_source_mgr.getFileEntryForID(fid);
+    if (file && !m_prefetched.insert(file))
+        return;
+    StringRef dir = file ? StringRef(file->getDir()->getName()) : StringRef();
+
+    int depth = 0;
+    const char* p = input_buffer->getBufferStart();
+    const char* end = input_buffer->getBufferEnd();
+    while (p < end)
+    {
+        const char* eol = static_cast<const char*>(std::memchr(p, '\n',
+                                                               end-p));
+        if (!eol)
+            eol = end;
+        StringRef line = StringRef(p, eol-p).ltrim(" \t");
+        p = eol+1;
+        if (line.empty() || line[0] != '.')
+            continue;
+
+        StringRef directive = line.substr(0, line.find_first_of(" \t\r\"#"));
+        if (directive.startswith(".if") || directive == ".macro" ||
+            directive == ".rept")
+            ++depth;
+        else if (directive == ".endif" || directive == ".endc" ||
+                 directive == ".endm" || directive == ".endr")
+        {
+            if (depth > 0)
+                --depth;
+        }
+        else if (depth == 0 && directive == ".include")
+        {
+            // Only plain strings; escapes are left to the parser.
+            StringRef arg = line.substr(directive.size()).ltrim(" \t");
+            if (arg.empty() || arg[0] != '"')
+                continue;
+            std::size_t close = arg.find('"', 1);
+            if (close == StringRef::npos)
+                continue;
+            StringRef filename = arg.slice(1, close);
+            if (!filename.empty() && filename.find('\\') == StringRef::npos)
+                m_header_info.PrefetchFile(filename, dir);
+        }
+    }
+}
+
 Lexer*
 GasPreproc::CreateLexer(FileID fid, const MemoryBuffer* input_buffer)
 {
+    if (m_prefetch)
+        PrefetchIncludes(fid, input_buffer);
     return new GasLexer(fid, input_buffer, *this);
 }
+
+void
+GasPreproc::EnterMainSourcePiece(unsigned int offset)
+{
+    m_prefetch = false;
+    EnterSourceFile(m_source_mgr.getMainFileID(), 0, SourceLocation());
+    m_prefetch = true;
+    getCurrentFileLexer()->SeekToLine(offset);
+}
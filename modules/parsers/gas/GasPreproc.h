@@ -30,6 +30,7 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 //
+#include "llvm/ADT/SmallPtrSet.h"
 #include "yasmx/Basic/SourceLocation.h"
 #include "yasmx/Config/export.h"
 #include "yasmx/Parse/Preprocessor.h"
@@ -38,6 +39,7 @@
 namespace yasm
 {
 
+class FileEntry;
 class IdentifierInfo;
 
 namespace parser
@@ -57,11 +59,35 @@ public:
 
     bool HandleInclude(StringRef filename, SourceLocation source);
 
+    /// Enter the tokens of a macro expansion, to be lexed next.
+    /// @param toks     tokens, allocated with new[]; ownership is taken
+    /// @param num_toks number of tokens
+    /// @param source   source location of macro invocation
+    /// @return False if macro expansions are nested too deeply.
+    bool EnterMacro(Token* toks, unsigned int num_toks, SourceLocation source);
+
+    /// Enter a macro expansion that is shared with other expansions.
+    /// @param toks     tokens
+    /// @param source   source location of macro invocation
+    /// @return False if macro expansions are nested too deeply.
+    bool EnterMacro(TokenBuffer* toks, SourceLocation source);
+
+    /// Enter the main source file to lex only the part of it starting at
+    /// the line at @p offset.  The file is not scanned for includes.
+    void EnterMainSourcePiece(unsigned int offset);
+
 protected:
     virtual void RegisterBuiltinMacros();
     virtual Lexer* CreateLexer(FileID fid, const MemoryBuffer* input_buffer);
 
 private:
+    void PrefetchIncludes(FileID fid, const MemoryBuffer* input_buffer);
+
+    /// Files whose .include targets have been prefetched.
+    llvm::SmallPtrSet<const FileEntry*, 16> m_prefetched;
+
+    /// Whether entered files are scanned for includes to prefetch.
+    bool m_prefetch;
 };
 
 }} // namespace yasm::parser
@@ -26,6 +26,8 @@
 //
 #include "GasStringParser.h"
 
+#include <cstring>
+
 #include "llvm/ADT/SmallString.h"
 #include "yasmx/Basic/SourceLocation.h"
 #include "yasmx/Parse/Preprocessor.h"
@@ -83,8 +85,10 @@ GasStringParser::GasStringParser(StringRef str,
     
     while (s < m_chars_end)
     {
-        if (*s++ != '\\')
-            continue;
+        s = static_cast<const char*>(std::memchr(s, '\\', m_chars_end-s));
+        if (!s)
+            break;
+        ++s;
         m_needs_unescape = true;
 
         assert (s < m_chars_end && "Lexer didn't maximally munch?");
@@ -157,30 +161,43 @@ GasStringParser::getString(SmallVectorImpl<char>& buffer) const
         return StringRef(m_chars_begin, m_chars_end-m_chars_begin);
 
     // slow path to do unescaping
-    buffer.clear();
+    buffer.resize(getMaxLength());
+    buffer.resize(CopyString(buffer.data()));
+    return StringRef(buffer.begin(), buffer.size());
+}
+
+std::size_t
+GasStringParser::CopyString(char* dest) const
+{
+    char* out = dest;
     const char* s = m_chars_begin;
 
     while (s < m_chars_end)
     {
-        if (*s != '\\')
-        {
-            buffer.push_back(*s++);
-            continue;
-        }
+        // Copy everything up to the next escape in one go.
+        const char* esc = static_cast<const char*>(
+            m_needs_unescape ? std::memchr(s, '\\', m_chars_end-s) : 0);
+        if (!esc)
+            esc = m_chars_end;
+        std::memcpy(out, s, esc-s);
+        out += esc-s;
+        s = esc;
+        if (s == m_chars_end)
+            break;
         ++s;
 
         assert (s < m_chars_end && "Lexer didn't maximally munch?");
         switch (*s++)
         {
             case '"': case '\\':
-                buffer.push_back(s[-1]);
+                *out++ = s[-1];
                 break;
-            case 'b': buffer.push_back('\x08'); break;
-            case 't': buffer.push_back('\x09'); break;
-            case 'n': buffer.push_back('\x0a'); break;
-            case 'v': buffer.push_back('\x0b'); break;
-            case 'f': buffer.push_back('\x0c'); break;
-            case 'r': buffer.push_back('\x0d'); break;
+            case 'b': *out++ = '\x08'; break;
+            case 't': *out++ = '\x09'; break;
+            case 'n': *out++ = '\x0a'; break;
+            case 'v': *out++ = '\x0b'; break;
+            case 'f': *out++ = '\x0c'; break;
+            case 'r': *out++ = '\x0d'; break;
             case '0': case '1': case '2': case '3': case '4': case '5':
             case '6': case '7':
             {
@@ -198,7 +215,7 @@ GasStringParser::getString(SmallVectorImpl<char>& buffer) const
                         ++s;
                     }
                 }
-                buffer.push_back(static_cast<char>(ch));
+                *out++ = static_cast<char>(ch);
                 break;
             }
             case 'x':
@@ -211,14 +228,14 @@ GasStringParser::getString(SmallVectorImpl<char>& buffer) const
                     ch |= fromxdigit(*s);
                     ++s;
                 }
-                buffer.push_back(static_cast<char>(ch));
+                *out++ = static_cast<char>(ch);
                 break;
             }
             default:
-                buffer.push_back(s[-1]);
+                *out++ = s[-1];
                 break;
         }
     }
 
-    return StringRef(buffer.begin(), buffer.size());
+    return out-dest;
 }
@@ -27,6 +27,7 @@
 // POSSIBILITY OF SUCH DAMAGE.
 //
 #include <cctype>
+#include <cstddef>
 #include <string>
 
 #include "yasmx/Basic/LLVM.h"
@@ -67,6 +68,15 @@ public:
     ///       if a copy can be avoided.
     StringRef getString(SmallVectorImpl<char>& buffer) const;
 
+    /// Get the length of the string data before unescaping.  The string
+    /// data is never longer than this.
+    std::size_t getMaxLength() const { return m_chars_end-m_chars_begin; }
+
+    /// Copy the string data into a buffer, unescaping as necessary.
+    /// @param dest     destination; must have room for getMaxLength() chars
+    /// @return Length of the string data.
+    std::size_t CopyString(char* dest) const;
+
     /// Convert this string literal value to an IntNum.
     /// This follows the NASM "character constant" conversion rules.
     void getIntegerValue(IntNum* val);
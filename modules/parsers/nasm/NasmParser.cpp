@@ -35,8 +35,12 @@
 #include "llvm/ADT/SmallString.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/raw_ostream.h"
+#include "yasmx/Basic/Diagnostic.h"
+#include "yasmx/Config/functional.h"
 #include "yasmx/Parse/Directive.h"
+#include "yasmx/Support/Pipeline.h"
 #include "yasmx/Support/registry.h"
+#include "yasmx/Support/Trace.h"
 #include "yasmx/Arch.h"
 #include "yasmx/Expr.h"
 #include "yasmx/Object.h"
@@ -55,32 +59,63 @@ using namespace yasm::parser;
 
 static unsigned int nasm_errors;
 
+// Thrown by nasm_efunc() to abandon preprocessing on a fatal error, with
+// the message saved in nasm_fatal; the process must not exit, as the
+// assembler may be embedded in another program.
+namespace {
+struct NasmFatal {};
+}
+static std::string nasm_fatal;
+
+// Size at which pipelined preprocessor output is queued to the parser,
+// and the number of such chunks that may be queued at once.
+static const std::size_t PIPELINE_CHUNK_SIZE = 64*1024;
+static const std::size_t PIPELINE_MAX_CHUNKS = 4;
+
+// Pipeline the preprocessor output is being queued to, if any.
+static Pipeline* nasm_pipe;
+
+static void
+nasm_sync()
+{
+    nasm_pipe->WaitIdle();
+}
+
 static void
 nasm_efunc(int severity, const char *fmt, ...)
 {
     va_list va;
 
-    fprintf(stderr, "%s:%ld: ", nasm::nasm_src_get_fname(),
-            nasm::nasm_src_get_linnum());
+    if (nasm::yasm_pp_sync)
+        nasm::yasm_pp_sync();
+    char where[512];
+    snprintf(where, sizeof(where), "%s:%ld: ", nasm::nasm_src_get_fname(),
+             nasm::nasm_src_get_linnum());
 
     va_start(va, fmt);
     switch (severity & ERR_MASK) {
         case ERR_WARNING:
+            fputs(where, stderr);
             vfprintf(stderr, fmt, va);
             fputc('\n', stderr);
             break;
         case ERR_NONFATAL:
+            fputs(where, stderr);
             vfprintf(stderr, fmt, va);
             fputc('\n', stderr);
             ++nasm_errors;
             break;
         case ERR_FATAL:
         case ERR_PANIC:
-            vfprintf(stderr, fmt, va);
-            fputc('\n', stderr);
-            exit(1);
-            /*@notreached@*/
-            break;
+        {
+            char msg[1024];
+            vsnprintf(msg, sizeof(msg), fmt, va);
+            va_end(va);
+            nasm_fatal = where;
+            nasm_fatal += msg;
+            ++nasm_errors;
+            throw NasmFatal();
+        }
         case ERR_DEBUG:
             break;
     }
@@ -107,6 +142,7 @@ NasmParser::Parse(Object& object, Directives& dirs, DiagnosticsEngine& diags)
     m_object = &object;
     m_dirs = &dirs;
     m_arch = object.getArch();
+    m_insn.reset();
     m_wordsize = m_arch->getModule().getWordSize();
 
     // Set up pseudo instructions.
@@ -125,18 +161,121 @@ NasmParser::Parse(Object& object, Directives& dirs, DiagnosticsEngine& diags)
     m_data_insns[DO].size = m_reserve_insns[DO].size = m_wordsize/8*8;  // o
 
     m_locallabel_base = "";
+    m_local_syms.clear();
 
     m_bc = 0;
 
     m_absstart.Clear();
     m_abspos.Clear();
+    m_strucs.clear();
 
-    // XXX: HACK: run through nasm preproc and replace main file contents
     nasm::yasm_preproc = &m_preproc;
     nasm::yasm_object = &object;
+
+    // With more than one job, the preprocessor runs on its own thread and
+    // its output is parsed as it is produced.
+    bool ok;
+    if (object.getConfig().NumJobs == 1 || !ParsePipelined(diags, &ok))
+        ok = ParseSerial(diags);
+    if (!ok)
+        return;
+
+    // Check for undefined symbols
+    object.FinalizeSymbols(m_preproc.getDiagnostics());
+}
+
+bool
+NasmParser::ParseSerial(DiagnosticsEngine& diags)
+{
+    // XXX: HACK: run through nasm preproc and replace main file contents
+    std::string result;
+    {
+        llvm::raw_string_ostream os(result);
+        if (!RunPreproc(os, diags))
+            return false;
+    }
+
+    //fputs(result.c_str(), stdout);    // for debugging
+
+    // override main file with preprocessed source
+    SourceManager& sm = m_preproc.getSourceManager();
+    const char* filename =
+        sm.getBuffer(sm.getMainFileID())->getBufferIdentifier();
+    sm.clearIDTables();
+    sm.createMainFileIDForMemBuffer(
+        MemoryBuffer::getMemBufferCopy(result, filename));
+
+    // Get first token
+    m_preproc.EnterMainSourceFile();
+    m_preproc.Lex(&m_token);
+    DoParse();
+    return true;
+}
+
+bool
+NasmParser::ParsePipelined(DiagnosticsEngine& diags, bool* ok)
+{
+    if (!Pipeline::isAvailable())
+        return false;
+
+    // The main file keeps its original contents (the preprocessor is
+    // still reading it); each chunk of output becomes a buffer of its own.
+    SourceManager& sm = m_preproc.getSourceManager();
+    const char* filename =
+        sm.getBuffer(sm.getMainFileID())->getBufferIdentifier();
+
+    Pipeline pipe(PIPELINE_MAX_CHUNKS);
+    DiagnosticBuffer pp_diags(diags);
+    nasm_pipe = &pipe;
+    nasm::yasm_pp_sync = &nasm_sync;
+    nasm::yasm_pp_diags = &pp_diags;
+
+    *ok = false;
+    bool ran = pipe.Run(TR1::bind(&NasmParser::PreprocStage, this,
+                                  TR1::ref(pipe), TR1::ref(diags), ok),
+                        TR1::bind(&NasmParser::ParseStage, this,
+                                  TR1::ref(pipe), filename));
+
+    nasm::yasm_pp_diags = 0;
+    nasm::yasm_pp_sync = 0;
+    nasm_pipe = 0;
+    return ran;
+}
+
+void
+NasmParser::PreprocStage(Pipeline& pipe, DiagnosticsEngine& diags, bool* ok)
+{
+    *ok = RunPreproc(llvm::nulls(), diags, &pipe);
+}
+
+void
+NasmParser::ParseStage(Pipeline& pipe, const char* filename)
+{
+    SourceManager& sm = m_preproc.getSourceManager();
+    std::string chunk;
+    while (pipe.Pop(chunk))
+    {
+        // Each chunk starts with a %line, so its lines continue on from
+        // those of the previous chunk.
+        FileID fid = sm.createFileIDForMemBuffer(
+            MemoryBuffer::getMemBufferCopy(chunk, filename));
+        if (fid.isInvalid())
+            continue;   // keep draining so the preprocessor can finish
+        m_preproc.EnterSourceFile(fid, 0, SourceLocation());
+        m_preproc.Lex(&m_token);
+        DoParse();
+    }
+}
+
+bool
+NasmParser::RunPreproc(raw_ostream& os,
+                       DiagnosticsEngine& diags,
+                       Pipeline* pipe)
+{
     SourceManager& sm = m_preproc.getSourceManager();
     nasm_errors = 0;
-    nasm::nasmpp.reset(sm.getMainFileID(), 2, nasm_efunc, nasm::nasm_evaluate);
+    nasm_fatal.clear();
+    nasm::nasmpp.reset(sm.getMainFileID(), nasm_efunc, nasm::nasm_evaluate);
 
     // pass down command line options
     for (std::vector<NasmPreproc::Predef>::iterator
@@ -191,54 +330,87 @@ NasmParser::Parse(Object& object, Directives& dirs, DiagnosticsEngine& diags)
     nasm::pp_extra_stdmac(const_cast<const char**>(nasm_version_mac));
 
     // add standard macros
-    nasm::pp_extra_stdmac(nasm_standard_mac);
+    nasm::pp_static_stdmac(nasm_standard_mac);
 
     // preprocess input
-    std::string result;
+    TraceBegin("Preprocess");
+    std::string chunk;
+    llvm::raw_string_ostream chunk_os(chunk);
+    raw_ostream& out = pipe ? chunk_os : os;
     long prior_linnum = 0;
     char *file_name = 0;
     int lineinc = 0;
-    while (char* line = nasm::nasmpp.getline())
+    try
     {
-        long linnum = prior_linnum += lineinc;
-        int altline = nasm::nasm_src_get(&linnum, &file_name);
-        if (altline != 0) {
-            lineinc = (altline != -1 || lineinc != 1);
-            SmallString<64> linestr;
-            llvm::raw_svector_ostream los(linestr);
-            los << "%line " << linnum << '+' << lineinc << ' ' << file_name
-                << '\n';
-            result += los.str();
-            prior_linnum = linnum;
+        while (char* line = nasm::nasmpp.getline())
+        {
+            // Once there are errors, the parser is given nothing more.
+            bool new_chunk = false;
+            if (pipe && chunk_os.tell() >= PIPELINE_CHUNK_SIZE)
+            {
+                chunk_os.flush();
+                if (nasm_errors == 0)
+                    pipe->Push(chunk);
+                chunk.clear();
+                new_chunk = true;
+            }
+
+            long linnum = prior_linnum += lineinc;
+            int altline = nasm::nasm_src_get(&linnum, &file_name);
+            if (altline != 0 || new_chunk) {
+                if (altline != 0)
+                    lineinc = (altline != -1 || lineinc != 1);
+                // Macro expansions produce a %line before and after each
+                // expansion, so only name the file when it changes (or at
+                // the start of a chunk).
+                out << "%line " << linnum << '+' << lineinc;
+                if (altline == -2 || new_chunk)
+                    out << ' ' << file_name;
+                out << '\n';
+                prior_linnum = linnum;
+            }
+            out << line << '\n';
+            nasm_free(line);
         }
-        result += line;
-        result += '\n';
+        nasm::nasmpp.cleanup(1);
+    }
+    catch (NasmFatal&)
+    {
+        // Stop where the preprocessor is; cleanup(0) below frees the
+        // files and macros it had open.
     }
-    nasm::nasmpp.cleanup(1);
+    nasm_free(file_name);
+    TraceEnd();
+    // Free the macros, so a later parse (of another file) starts afresh.
+    nasm::nasmpp.cleanup(0);
     for (int i=0; i<7; ++i)
         delete[] nasm_version_mac[i];
-    if (nasm_errors > 0)
+
+    bool ok = (nasm_errors == 0);
+    if (pipe)
     {
-        diags.Report(SourceLocation(), diag::fatal_pp_errors);
-        return;
+        chunk_os.flush();
+        if (ok && !chunk.empty())
+            pipe->Push(chunk);
+        if (!ok)
+            pipe->WaitIdle();   // before reporting below
     }
+    if (!ok && !nasm_fatal.empty())
+        diags.Report(SourceLocation(), diag::fatal_pp_fatal) << nasm_fatal;
+    else if (!ok)
+        diags.Report(SourceLocation(), diag::fatal_pp_errors);
+    if (pipe)
+        pipe->Close();
+    return ok;
+}
 
-    //fputs(result.c_str(), stdout);    // for debugging
-
-    // override main file with preprocessed source
-    const char* filename =
-        sm.getBuffer(sm.getMainFileID())->getBufferIdentifier();
-    sm.clearIDTables();
-    sm.createMainFileIDForMemBuffer(
-        MemoryBuffer::getMemBufferCopy(result, filename));
-
-    // Get first token
-    m_preproc.EnterMainSourceFile();
-    m_preproc.Lex(&m_token);
-    DoParse();
-
-    // Check for undefined symbols
-    object.FinalizeSymbols(m_preproc.getDiagnostics());
+bool
+NasmParser::Preprocess(raw_ostream& os, DiagnosticsEngine& diags)
+{
+    // There are no symbols for expressions to refer to.
+    nasm::yasm_preproc = &m_preproc;
+    nasm::yasm_object = 0;
+    return RunPreproc(os, diags);
 }
 
 void
@@ -248,6 +420,7 @@ NasmParser::AddDirectives(Directives& dirs, StringRef parser)
     {
         {"absolute", &NasmParser::DirAbsolute, Directives::ARG_REQUIRED},
         {"align", &NasmParser::DirAlign, Directives::ARG_REQUIRED},
+        {"endstruc", &NasmParser::DirEndStruc, Directives::ANY},
     };
 
     if (parser.equals_lower("nasm"))
@@ -265,8 +438,8 @@ NasmParser::getPreprocessor() const
     return ParserImpl::getPreprocessor();
 }
 
-void
-yasm_parser_nasm_DoRegister()
+extern const yasm::impl::ModuleEntry yasm_parser_nasm_modules[] =
 {
-    RegisterModule<ParserModule, ParserModuleImpl<NasmParser> >("nasm");
-}
+    YASM_MODULE_ENTRY(ParserModule, ParserModuleImpl<NasmParser>, "nasm"),
+    YASM_MODULE_TABLE_END
+};
@@ -27,8 +27,10 @@
 // POSSIBILITY OF SUCH DAMAGE.
 //
 #include <memory>
+#include <vector>
 
 #include "llvm/ADT/APFloat.h"
+#include "llvm/ADT/DenseMap.h"
 #include "yasmx/Config/export.h"
 #include "yasmx/Parse/Parser.h"
 #include "yasmx/Parse/ParserImpl.h"
@@ -46,6 +48,7 @@ class DirectiveInfo;
 class Directives;
 class Expr;
 class NameValues;
+class Pipeline;
 
 namespace parser
 {
@@ -81,11 +84,34 @@ public:
     static StringRef getKeyword() { return "nasm"; }
 
     void Parse(Object& object, Directives& dirs, DiagnosticsEngine& diags);
+    bool Preprocess(raw_ostream& os, DiagnosticsEngine& diags);
 
 private:
     friend class NasmParseDirExprTerm;
     friend class NasmParseDataExprTerm;
 
+    /// Run the NASM preprocessor over the main file, writing its output
+    /// (with %line directives) to os.
+    /// @param pipe     if set, the output is instead queued to pipe in
+    ///                 chunks of whole lines, each starting with a %line
+    /// @return False if the preprocessor reported errors.
+    bool RunPreproc(raw_ostream& os,
+                    DiagnosticsEngine& diags,
+                    Pipeline* pipe = 0);
+
+    /// Preprocess the whole main file, then parse the result.
+    /// @return False if the preprocessor reported errors.
+    bool ParseSerial(DiagnosticsEngine& diags);
+
+    /// Preprocess the main file on another thread, parsing the output
+    /// as it is produced.
+    /// @param ok       set false if the preprocessor reported errors
+    /// @return False if no thread could be started (nothing is done).
+    bool ParsePipelined(DiagnosticsEngine& diags, bool* ok);
+
+    void PreprocStage(Pipeline& pipe, DiagnosticsEngine& diags, bool* ok);
+    void ParseStage(Pipeline& pipe, const char* filename);
+
     struct PseudoInsn
     {
         enum Type
@@ -94,7 +120,11 @@ private:
             RESERVE_SPACE,
             INCBIN,
             EQU,
-            TIMES
+            TIMES,
+            STRUC,
+            ISTRUC,
+            AT,
+            IEND
         };
         Type type;
         unsigned int size;
@@ -109,7 +139,10 @@ private:
     bool ParseLine();
     bool ParseDirective(/*@out@*/ NameValues& nvs);
     bool ParseExp();
-    Insn::Ptr ParseInsn();
+    bool ParseStruc(const PseudoInsn& pseudo, SourceLocation exp_source);
+    bool ParsePlainValue(unsigned int size, uint64_t* val);
+    bool ParseUnicodeString(unsigned int size);
+    Insn* ParseInsn();
 
     unsigned int getSizeOverride(Token& tok);
     Operand ParseOperand();
@@ -130,12 +163,17 @@ private:
 
     void DirAbsolute(DirectiveInfo& info, DiagnosticsEngine& diags);
     void DirAlign(DirectiveInfo& info, DiagnosticsEngine& diags);
+    void DirEndStruc(DirectiveInfo& info, DiagnosticsEngine& diags);
 
     void DoDirective(StringRef name, DirectiveInfo& info);
 
     Object* m_object;
     Arch* m_arch;
     Directives* m_dirs;
+
+    // Instruction being parsed.  Reused for every instruction so that
+    // parsing an instruction doesn't allocate.
+    Insn::Ptr m_insn;
     unsigned int m_wordsize;
 
     NasmPreproc m_nasm_preproc;
@@ -148,6 +186,10 @@ private:
     // last "base" label for local (.) labels
     std::string m_locallabel_base;
 
+    // Local labels looked up under m_locallabel_base, so each is only
+    // looked up by name once.  Cleared when the base label changes.
+    llvm::DenseMap<IdentifierInfo*, Symbol*> m_local_syms;
+
     BytecodeContainer* m_container;
     /*@null@*/ Bytecode* m_bc;
 
@@ -162,12 +204,25 @@ private:
     // Delta to add to abspos when the current line completes.
     Expr m_absinc;
 
+    // Scratch expression for operands.  Reused across lines so that
+    // register operands need no heap expression.
+    Expr m_operand;
+
     // Current TIMES expression.  Empty if not in a TIMES.
     Expr m_times;
 
     // Original container when in a TIMES expression.
     // TIMES replaces m_container, saving the old one here.
     BytecodeContainer* m_times_outer_container;
+
+    // Open STRUC and ISTRUC blocks, innermost last.  These take the place
+    // of the preprocessor context the standard macros once used.
+    struct StrucContext
+    {
+        std::string name;   // structure name
+        Expr start;         // ISTRUC start location
+    };
+    std::vector<StrucContext> m_strucs;
 };
 
 }} // namespace yasm::parser
@@ -27,10 +27,13 @@
 #define DEBUG_TYPE "NasmParser"
 
 #include <math.h>
+#include <cstring>
 
 #include "llvm/ADT/APFloat.h"
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/Statistic.h"
+#include "yasmx/Basic/ConvertUTF.h"
 #include "yasmx/Basic/Diagnostic.h"
 #include "yasmx/Parse/Directive.h"
 #include "yasmx/Parse/IdentifierTable.h"
@@ -71,6 +74,10 @@ NasmParser::CheckPseudoInsn(IdentifierInfo* ii)
     static const PseudoInsn equ_insn = {PseudoInsn::EQU, 0};
     static const PseudoInsn incbin_insn = {PseudoInsn::INCBIN, 0};
     static const PseudoInsn times_insn = {PseudoInsn::TIMES, 0};
+    static const PseudoInsn struc_insn = {PseudoInsn::STRUC, 0};
+    static const PseudoInsn istruc_insn = {PseudoInsn::ISTRUC, 0};
+    static const PseudoInsn at_insn = {PseudoInsn::AT, 0};
+    static const PseudoInsn iend_insn = {PseudoInsn::IEND, 0};
 
     if (!ii->isUnknown())
         return;
@@ -84,6 +91,13 @@ NasmParser::CheckPseudoInsn(IdentifierInfo* ii)
     unsigned int len = ii->getLength();
     switch (name[0])
     {
+        case 'a':
+        case 'A':
+            // AT
+            if (len != 2 || (name[1] != 't' && name[1] != 'T'))
+                return;
+            ii->setCustom(&at_insn);
+            return;
         case 'e':
         case 'E':
             // EQU
@@ -95,6 +109,26 @@ NasmParser::CheckPseudoInsn(IdentifierInfo* ii)
             return;
         case 'i':
         case 'I':
+            // IEND
+            if (len == 4 &&
+                (name[1] == 'e' || name[1] == 'E') &&
+                (name[2] == 'n' || name[2] == 'N') &&
+                (name[3] == 'd' || name[3] == 'D'))
+            {
+                ii->setCustom(&iend_insn);
+                return;
+            }
+            // ISTRUC
+            if (len == 6 &&
+                (name[1] == 's' || name[1] == 'S') &&
+                (name[2] == 't' || name[2] == 'T') &&
+                (name[3] == 'r' || name[3] == 'R') &&
+                (name[4] == 'u' || name[4] == 'U') &&
+                (name[5] == 'c' || name[5] == 'C'))
+            {
+                ii->setCustom(&istruc_insn);
+                return;
+            }
             // INCBIN
             if (len != 6 ||
                 (name[1] != 'n' && name[1] != 'N') ||
@@ -123,6 +157,17 @@ NasmParser::CheckPseudoInsn(IdentifierInfo* ii)
             pseudo = m_reserve_insns;
             name += 3;
             break;
+        case 's':
+        case 'S':
+            // STRUC
+            if (len != 5 ||
+                (name[1] != 't' && name[1] != 'T') ||
+                (name[2] != 'r' && name[2] != 'R') ||
+                (name[3] != 'u' && name[3] != 'U') ||
+                (name[4] != 'c' && name[4] != 'C'))
+                return;
+            ii->setCustom(&struc_insn);
+            return;
         case 't':
         case 'T':
             // TIMES
@@ -391,6 +436,7 @@ bool
 NasmParser::ParseLine()
 {
     m_container = m_object->getCurSection();
+    m_object->setListLine(m_token.getLocation());
 
     if (ParseExp())
         return true;
@@ -468,12 +514,15 @@ NasmParser::ParseLine()
             StringRef filename =
                 MergeTokensUntil(toks, 1, &start, &end, filename_buf);
 
-            // %line indicates the line number of the *next* line, so subtract
-            // out the increment when setting the line number.
-            // FIXME: handle incr
+            // %line indicates the line number of the *next* line, and each
+            // line after that advances it by the increment.  A missing
+            // filename keeps the current one.
             SourceManager& smgr = m_preproc.getSourceManager();
             smgr.AddLineNote(m_token.getLocation(), line.getUInt(),
-                             smgr.getLineTableFilenameID(filename));
+                             filename.empty() ? -1 :
+                             static_cast<int>(
+                                 smgr.getLineTableFilenameID(filename)),
+                             incr.getUInt());
             break;
         }
         case NasmToken::l_square: // [ directive ]
@@ -618,7 +667,8 @@ NasmParser::ParseDirective(/*@out@*/ NameValues& nvs)
 {
     for (;;)
     {
-        std::string name;
+        SmallString<32> name_buf, id_buf;
+        StringRef name;
         std::auto_ptr<NameValue> nv(0);
         SourceLocation name_loc, equals_loc;
 
@@ -627,7 +677,7 @@ NasmParser::ParseDirective(/*@out@*/ NameValues& nvs)
         {
             if (NextToken().is(NasmToken::equal))
             {
-                name = m_preproc.getSpelling(m_token);
+                name = m_preproc.getSpelling(m_token, name_buf);
                 name_loc = ConsumeToken(); // id
                 equals_loc = ConsumeToken(); // '='
             }
@@ -676,8 +726,7 @@ NasmParser::ParseDirective(/*@out@*/ NameValues& nvs)
                     default:
                         // Just an id
                         nv.reset(new NameValue(name,
-                                               m_preproc.getSpelling(m_token),
-                                               '$'));
+                            m_preproc.getSpelling(m_token, id_buf), '$'));
                         nv->setValueRange(m_token.getSourceRange());
                         ConsumeToken();
                         goto next;
@@ -713,6 +762,148 @@ next:
     }
 }
 
+/// Get the value of a decimal or 0x-prefixed hexadecimal integer literal
+/// that fits in 64 bits.  Other forms are left to NasmNumericParser.
+static bool
+getPlainInteger(StringRef literal, uint64_t* val)
+{
+    unsigned int radix = 10;
+    StringRef digits = literal;
+    if (literal.size() > 2 && literal[0] == '0' &&
+        (literal[1] == 'x' || literal[1] == 'X') &&
+        literal.back() != 'b' && literal.back() != 'B')
+    {
+        radix = 16;
+        digits = literal.substr(2);
+    }
+    if (digits.empty())
+        return false;
+
+    uint64_t v = 0;
+    for (StringRef::iterator i=digits.begin(), end=digits.end(); i != end;
+         ++i)
+    {
+        unsigned int digit;
+        if (*i >= '0' && *i <= '9')
+            digit = *i - '0';
+        else if (radix == 16 && *i >= 'a' && *i <= 'f')
+            digit = *i - 'a' + 10;
+        else if (radix == 16 && *i >= 'A' && *i <= 'F')
+            digit = *i - 'A' + 10;
+        else
+            return false;
+        if (v > (UINT64_MAX - digit) / radix)
+            return false;
+        v = v*radix + digit;
+    }
+    *val = v;
+    return true;
+}
+
+bool
+NasmParser::ParsePlainValue(unsigned int size, uint64_t* val)
+{
+    // Only a literal (optionally negated) that is the whole data value.
+    bool neg = m_token.is(NasmToken::minus);
+    const Token& num = neg ? NextToken() : m_token;
+    if (num.isNot(NasmToken::numeric_constant))
+        return false;
+    bool is_float = false;
+    if (!getPlainInteger(num.getLiteral(), val))
+    {
+        // dd and dq also take single and double precision floats.
+        if ((size != 4 && size != 8) ||
+            !NumericParser::getDecimalFloatBits(num.getLiteral(), size*8,
+                                                val))
+            return false;
+        is_float = true;
+    }
+    const Token& next = neg ? m_preproc.LookAhead(1) : NextToken();
+    if (next.isNot(NasmToken::comma) && !next.isEndOfStatement())
+        return false;
+
+    if (neg)
+    {
+        if (is_float)
+            *val ^= UINT64_C(1) << (size*8-1);
+        else
+            *val = -*val;
+        ConsumeToken();
+    }
+    ConsumeToken();
+    return true;
+}
+
+// Handle a __utf16__, __utf16le__, __utf16be__, __utf32__, __utf32le__, or
+// __utf32be__ function of a string as a data value.  The string is
+// unescaped and converted in place at the end of the data bytecode, then
+// rounded up to the data size.  Returns false without consuming anything if
+// the current token does not start such a function.
+bool
+NasmParser::ParseUnicodeString(unsigned int size)
+{
+    // These start with an underscore, so lex as labels.
+    if (m_token.isNot(NasmToken::label))
+        return false;
+    StringRef name = m_token.getIdentifierInfo()->getName();
+    if (!name.startswith("__utf") || !name.endswith("__"))
+        return false;
+    StringRef form = name.substr(5, name.size()-7);
+    unsigned int width;
+    if (form.startswith("16"))
+        width = 2;
+    else if (form.startswith("32"))
+        width = 4;
+    else
+        return false;
+    form = form.substr(2);
+    if (!form.empty() && form != "le" && form != "be")
+        return false;
+    bool big_endian = (form == "be");
+    if (NextToken().isNot(NasmToken::l_paren))
+        return false;
+
+    SourceLocation func_source = ConsumeToken();
+    SourceLocation lparen_loc = ConsumeParen();
+    if (m_token.isNot(NasmToken::string_literal))
+    {
+        Diag(m_token, diag::err_expected_string);
+        SkipUntil(NasmToken::r_paren);
+        return true;
+    }
+    NasmStringParser str(m_token.getLiteral(), m_token.getLocation(),
+                         m_preproc);
+    if (!str.hadError())
+    {
+        // The UTF-8 goes at the end of the reserved space, so converting
+        // forward never overwrites bytes that have yet to be read.
+        Bytes& fixed = m_container->FreshBytecode().getFixed();
+        Bytes::size_type pos = fixed.size();
+        std::size_t maxlen = str.getMaxLength();
+        fixed.resize(pos + width*maxlen + size);
+        char* out = reinterpret_cast<char*>(&fixed[pos]);
+        char* utf8 = out + (width-1)*maxlen;
+        std::size_t len = str.CopyString(utf8);
+        if (clang::ConvertUTF8toWideUnits(width, big_endian,
+                                          StringRef(utf8, len), out))
+        {
+            len = out - reinterpret_cast<char*>(&fixed[pos]);
+            std::memset(&fixed[pos+len], 0, fixed.size()-pos-len);
+            if ((len % size) != 0)
+                len += size - (len % size);
+            fixed.resize(pos + len);
+        }
+        else
+        {
+            Diag(func_source, diag::err_invalid_utf8_string) << name;
+            fixed.resize(pos);
+        }
+    }
+    ConsumeToken();
+    MatchRHSPunctuation(NasmToken::r_paren, lparen_loc);
+    return true;
+}
+
 bool
 NasmParser::ParseExp()
 {
@@ -728,8 +919,8 @@ NasmParser::ParseExp()
         if (m_arch->hasParseInsn())
             return m_arch->ParseInsn(*m_container, *this);
 
-        Insn::Ptr insn = ParseInsn();
-        if (insn.get() != 0)
+        Insn* insn = ParseInsn();
+        if (insn)
         {
             if (!m_abspos.isEmpty())
             {
@@ -753,9 +944,27 @@ NasmParser::ParseExp()
             }
             ConsumeToken();
 
+            // Runs of plain integer (and float) literals are written
+            // directly rather than building an expression for each value.
+            SmallVector<uint64_t, 64> vals;
+            bool plain = pseudo->size <= 8 && m_times.isEmpty();
             unsigned int nvals = 0;
             for (;;)
             {
+                uint64_t val;
+                if (plain && ParsePlainValue(pseudo->size, &val))
+                {
+                    vals.push_back(val);
+                    goto dv_done;
+                }
+                if (!vals.empty())
+                {
+                    AppendDataArray(*m_container, vals, pseudo->size, *m_arch);
+                    vals.clear();
+                }
+
+                if (ParseUnicodeString(pseudo->size))
+                    goto dv_done;
                 if (m_token.is(NasmToken::string_literal))
                 {
                     // Peek ahead to see if we're in an expr.  If we're not,
@@ -768,9 +977,19 @@ NasmParser::ParseExp()
                                              m_token.getLocation(), m_preproc);
                         if (!str.hadError())
                         {
-                            SmallString<64> strbuf;
-                            AppendData(*m_container, str.getString(strbuf),
-                                       pseudo->size, false);
+                            // Unescape straight into the fixed data, then
+                            // round up to the data size with the zeros
+                            // left by the resize.
+                            Bytes& fixed =
+                                m_container->FreshBytecode().getFixed();
+                            Bytes::size_type pos = fixed.size();
+                            fixed.resize(pos + str.getMaxLength() +
+                                         pseudo->size);
+                            std::size_t len = str.CopyString(
+                                reinterpret_cast<char*>(&fixed[pos]));
+                            if ((len % pseudo->size) != 0)
+                                len += pseudo->size - (len % pseudo->size);
+                            fixed.resize(pos + len);
                         }
                         ConsumeToken();
                         goto dv_done;
@@ -812,6 +1031,8 @@ dv_done:
                 if (m_token.isEndOfStatement())
                     break;  // allow trailing , on list
             }
+            if (!vals.empty())
+                AppendDataArray(*m_container, vals, pseudo->size, *m_arch);
             return true;
         }
         case PseudoInsn::RESERVE_SPACE:
@@ -956,17 +1177,126 @@ incbin_done:
             }
             return true;
         }
+        case PseudoInsn::STRUC:
+        case PseudoInsn::ISTRUC:
+        case PseudoInsn::AT:
+        case PseudoInsn::IEND:
+            return ParseStruc(*pseudo, exp_source);
         default:
             break;
     }
     return false;
 }
 
-Insn::Ptr
+/// Parse STRUC, ISTRUC, AT and IEND.  These behave exactly as the standard
+/// macros they replace:
+///   STRUC name    -> [absolute 0] / name:
+///   ISTRUC name   -> start:
+///   AT field,data -> times field-($-start) db 0 / data
+///   IEND          -> times name_size-($-start) db 0
+/// but without the preprocessor context and TIMES expansion per line.
+/// ENDSTRUC is the [endstruc] directive.  Errors are reported here, so
+/// this always returns true.
+bool
+NasmParser::ParseStruc(const PseudoInsn& pseudo, SourceLocation exp_source)
+{
+    IdentifierInfo* ii = m_token.getIdentifierInfo();
+    ConsumeToken();
+
+    if (pseudo.type == PseudoInsn::STRUC || pseudo.type == PseudoInsn::ISTRUC)
+    {
+        if (m_token.isNot(NasmToken::identifier) &&
+            m_token.isNot(NasmToken::label))
+        {
+            Diag(m_token, diag::err_expected_ident);
+            return true;
+        }
+        IdentifierInfo* name_ii = m_token.getIdentifierInfo();
+        SourceLocation name_source = ConsumeToken();
+
+        m_strucs.push_back(StrucContext());
+        StrucContext& ctx = m_strucs.back();
+        ctx.name = name_ii->getName();
+
+        if (pseudo.type == PseudoInsn::STRUC)
+        {
+            // Allow definition of ".member" to work sanely.
+            m_absstart = Expr(IntNum(0));
+            m_abspos = m_absstart;
+            m_absinc = Expr();
+            m_object->setCurSection(0);
+            m_container = 0;
+            bool local;
+            SymbolRef sym = ParseSymbol(name_ii, &local);
+            DefineLabel(sym, name_source, local);
+        }
+        else if (!m_abspos.isEmpty())
+            ctx.start = m_abspos;
+        else
+        {
+            m_bc = &m_container->FreshBytecode();
+            ctx.start = Expr(m_object->getSymbol(m_container->getEndLoc()));
+        }
+        return true;
+    }
+
+    if (m_strucs.empty())
+    {
+        Diag(exp_source, diag::err_no_struc) << ii->getName().upper();
+        return true;
+    }
+    const StrucContext& ctx = m_strucs.back();
+
+    // Pad out to the field (AT) or the end of the structure (IEND).
+    Expr::Ptr offset(new Expr);
+    if (pseudo.type == PseudoInsn::AT)
+    {
+        NasmParseDataExprTerm parse_data_term;
+        if (!ParseExpr(*offset, &parse_data_term))
+        {
+            Diag(m_token, diag::err_expected_expression_after_id) << "AT";
+            return true;
+        }
+    }
+    else
+    {
+        SymbolRef size = ParseSymbol(
+            m_preproc.getIdentifierInfo(ctx.name + "_size"));
+        *offset = Expr(size, exp_source);
+    }
+
+    if (!m_abspos.isEmpty())
+    {
+        Diag(exp_source, diag::err_non_reserve_in_absolute_section);
+        return true;
+    }
+    m_bc = &m_container->FreshBytecode();
+    Expr here(m_object->getSymbol(m_container->getEndLoc()), exp_source);
+    *offset -= SUB(here, ctx.start);
+    AppendFill(*m_container, offset, 1, Expr::Ptr(new Expr(IntNum(0))),
+               *m_arch, exp_source, m_preproc.getDiagnostics());
+
+    if (pseudo.type == PseudoInsn::IEND)
+    {
+        m_strucs.pop_back();
+        return true;
+    }
+
+    // The data follows the comma as if on a line of its own.
+    if (m_token.is(NasmToken::comma))
+    {
+        ConsumeToken();
+        if (!m_token.isEndOfStatement())
+            return ParseLine();
+    }
+    return true;
+}
+
+Insn*
 NasmParser::ParseInsn()
 {
     if (m_token.isNot(NasmToken::identifier))
-        return Insn::Ptr(0);
+        return 0;
 
     IdentifierInfo* ii = m_token.getIdentifierInfo();
     ii->DoInsnLookup(*m_arch, m_token.getLocation(),
@@ -975,7 +1305,8 @@ NasmParser::ParseInsn()
     {
         ConsumeToken();
         ++num_insn;
-        Insn::Ptr insn(m_arch->CreateInsn(insninfo));
+        m_arch->ReuseInsn(m_insn, insninfo);
+        Insn* insn = m_insn.get();
         if (m_token.isEndOfStatement())
             return insn;    // no operands
 
@@ -998,9 +1329,12 @@ NasmParser::ParseInsn()
     if (const Prefix* prefix = ii->getPrefix())
     {
         SourceLocation prefix_source = ConsumeToken();
-        Insn::Ptr insn = ParseInsn();
-        if (insn.get() == 0)
-            insn = m_arch->CreateEmptyInsn();
+        Insn* insn = ParseInsn();
+        if (!insn)
+        {
+            m_arch->ReuseInsn(m_insn, 0);
+            insn = m_insn.get();
+        }
         insn->AddPrefix(prefix, prefix_source);
         return insn;
     }
@@ -1008,16 +1342,19 @@ NasmParser::ParseInsn()
     if (const SegmentRegister* segreg = ii->getSegReg())
     {
         SourceLocation segreg_source = ConsumeToken();
-        Insn::Ptr insn = ParseInsn();
-        if (insn.get() == 0)
-            insn = m_arch->CreateEmptyInsn();
+        Insn* insn = ParseInsn();
+        if (!insn)
+        {
+            m_arch->ReuseInsn(m_insn, 0);
+            insn = m_insn.get();
+        }
         else if (insn->hasSegPrefix())
             Diag(segreg_source, diag::warn_multiple_seg_override);
         insn->setSegPrefix(segreg, segreg_source);
         return insn;
     }
 
-    return Insn::Ptr(0);
+    return 0;
 }
 
 // Map token to size override value.  If not recognized, returns 0.
@@ -1040,6 +1377,15 @@ NasmParser::getSizeOverride(Token& tok)
     }
 }
 
+// Move the terms of the scratch operand expression into a new expression.
+static Expr::Ptr
+TakeExpr(Expr& e)
+{
+    Expr::Ptr taken(new Expr);
+    taken->swap(e);
+    return taken;
+}
+
 Operand
 NasmParser::ParseOperand()
 {
@@ -1122,8 +1468,9 @@ NasmParser::ParseOperand()
         }
         default:
         {
-            Expr::Ptr e(new Expr);
-            if (!ParseExpr(*e))
+            Expr& e = m_operand;
+            e.Clear();
+            if (!ParseExpr(e))
             {
                 Diag(m_token, diag::err_expected_operand);
                 return Operand(e);
@@ -1131,15 +1478,16 @@ NasmParser::ParseOperand()
             if (m_token.isNot(NasmToken::colon))
                 return Operand(e);
             ConsumeToken();
-            Expr::Ptr off(new Expr);
-            if (!ParseExpr(*off))
+            Expr::Ptr seg = TakeExpr(e);
+            if (!ParseExpr(e))
             {
                 Diag(m_token, diag::err_expected_expression_after)
                     << ":";
-                return Operand(e);
+                e.Clear();
+                return Operand(seg);
             }
-            Operand op(off);
-            op.setSeg(e);
+            Operand op(e);
+            op.setSeg(seg);
             return op;
         }
     }
@@ -1215,24 +1563,33 @@ NasmParser::ParseMemoryAddress()
         }
         default:
         {
-            Expr::Ptr e(new Expr);
-            if (!ParseExpr(*e))
+            Expr& e = m_operand;
+            e.Clear();
+            if (!ParseExpr(e))
             {
                 Diag(m_token, diag::err_expected_memory_address);
                 return Operand(e);
             }
             if (m_token.isNot(NasmToken::colon))
-                return Operand(m_object->getArch()->CreateEffAddr(e));
+            {
+                EffAddr::Ptr ea =
+                    m_object->getArch()->CreateEffAddr(TakeExpr(e));
+                ea->Decompose();
+                return Operand(ea);
+            }
             ConsumeToken();
-            Expr::Ptr off(new Expr);
-            if (!ParseExpr(*off))
+            Expr::Ptr seg = TakeExpr(e);
+            if (!ParseExpr(e))
             {
                 Diag(m_token, diag::err_expected_expression_after)
                     << ":";
-                return Operand(e);
+                e.Clear();
+                return Operand(seg);
             }
-            Operand op(m_object->getArch()->CreateEffAddr(off));
-            op.setSeg(e);
+            EffAddr::Ptr ea = m_object->getArch()->CreateEffAddr(TakeExpr(e));
+            ea->Decompose();
+            Operand op(ea);
+            op.setSeg(seg);
             return op;
         }
     }
@@ -1630,11 +1987,8 @@ NasmParser::ParseExpr6(Expr& e, const ParseExprTerm* parse_term)
                 e = m_abspos;
             else
             {
-                SymbolRef sym = m_object->AddNonTableSymbol("$");
                 m_bc = &m_container->FreshBytecode();
-                sym->CheckedDefineLabel(m_container->getEndLoc(),
-                                        m_token.getLocation(),
-                                        m_preproc.getDiagnostics());
+                SymbolRef sym = m_object->getSymbol(m_container->getEndLoc());
                 e = Expr(sym, m_token.getLocation());
             }
             break;
@@ -1644,10 +1998,8 @@ NasmParser::ParseExpr6(Expr& e, const ParseExprTerm* parse_term)
                 e = m_absstart;
             else
             {
-                SymbolRef sym = m_object->AddNonTableSymbol("$$");
-                sym->CheckedDefineLabel(m_container->getBeginLoc(),
-                                        m_token.getLocation(),
-                                        m_preproc.getDiagnostics());
+                SymbolRef sym =
+                    m_object->getSymbol(m_container->getBeginLoc());
                 e = Expr(sym, m_token.getLocation());
             }
             break;
@@ -1711,20 +2063,32 @@ NasmParser::ParseSymbol(IdentifierInfo* ii, bool* local)
     if (m_locallabel_base.empty())
         Diag(m_token, diag::warn_no_nonlocal);
 
-    // don't try to cache local labels
-    return m_object->getSymbol(m_locallabel_base + name);
+    // local labels can only be cached until the base label changes
+    Symbol*& sym = m_local_syms[ii];
+    if (!sym)
+        sym = m_object->getSymbol(m_locallabel_base + name);
+    return SymbolRef(sym);
 }
 
 void
 NasmParser::DefineLabel(SymbolRef sym, SourceLocation source, bool local)
 {
     if (!local)
+    {
         m_locallabel_base = sym->getName();
+        m_local_syms.clear();
+    }
 
     if (!m_abspos.isEmpty())
         sym->CheckedDefineEqu(m_abspos, source, m_preproc.getDiagnostics());
     else
     {
+        // The object format may move the label (not within TIMES).
+        if (!local && m_container == m_object->getCurSection())
+        {
+            m_object->StartLabel(sym, source, m_preproc.getDiagnostics());
+            m_container = m_object->getCurSection();
+        }
         m_bc = &m_container->FreshBytecode();
         sym->CheckedDefineLabel(m_container->getEndLoc(), source,
                                 m_preproc.getDiagnostics());
@@ -1787,6 +2151,23 @@ NasmParser::DirAlign(DirectiveInfo& info, DiagnosticsEngine& diags)
     }
 }
 
+void
+NasmParser::DirEndStruc(DirectiveInfo& info, DiagnosticsEngine& diags)
+{
+    if (m_strucs.empty())
+    {
+        diags.Report(info.getSource(), diag::err_no_struc) << "ENDSTRUC";
+        return;
+    }
+
+    // The caller returns to the prior section (__SECT__).
+    bool local;
+    SymbolRef sym = ParseSymbol(
+        m_preproc.getIdentifierInfo(m_strucs.back().name + "_size"), &local);
+    DefineLabel(sym, info.getSource(), local);
+    m_strucs.pop_back();
+}
+
 void
 NasmParser::DoDirective(StringRef name, DirectiveInfo& info)
 {
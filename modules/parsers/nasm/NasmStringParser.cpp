@@ -26,6 +26,8 @@
 //
 #include "NasmStringParser.h"
 
+#include <cstring>
+
 #include "llvm/ADT/SmallString.h"
 #include "yasmx/Basic/SourceLocation.h"
 #include "yasmx/Parse/Preprocessor.h"
@@ -81,8 +83,10 @@ NasmStringParser::NasmStringParser(StringRef str,
     
     while (s < m_chars_end)
     {
-        if (*s++ != '\\')
-            continue;
+        s = static_cast<const char*>(std::memchr(s, '\\', m_chars_end-s));
+        if (!s)
+            break;
+        ++s;
         m_needs_unescape = true;
 
         switch (*s++)
@@ -175,31 +179,44 @@ NasmStringParser::getString(SmallVectorImpl<char>& buffer) const
         return StringRef(m_chars_begin, m_chars_end-m_chars_begin);
 
     // slow path to do unescaping
-    buffer.clear();
+    buffer.resize(getMaxLength());
+    buffer.resize(CopyString(buffer.data()));
+    return StringRef(buffer.begin(), buffer.size());
+}
+
+std::size_t
+NasmStringParser::CopyString(char* dest) const
+{
+    char* out = dest;
     const char* s = m_chars_begin;
 
     while (s < m_chars_end)
     {
-        if (*s != '\\')
-        {
-            buffer.push_back(*s++);
-            continue;
-        }
+        // Copy everything up to the next escape in one go.
+        const char* esc = static_cast<const char*>(
+            m_needs_unescape ? std::memchr(s, '\\', m_chars_end-s) : 0);
+        if (!esc)
+            esc = m_chars_end;
+        std::memcpy(out, s, esc-s);
+        out += esc-s;
+        s = esc;
+        if (s == m_chars_end)
+            break;
         ++s;
 
         switch (*s++)
         {
             case '\'': case '"': case '`': case '\\': case '?':
-                buffer.push_back(s[-1]);
+                *out++ = s[-1];
                 break;
-            case 'a': buffer.push_back('\x07'); break;
-            case 'b': buffer.push_back('\x08'); break;
-            case 't': buffer.push_back('\x09'); break;
-            case 'n': buffer.push_back('\x0a'); break;
-            case 'v': buffer.push_back('\x0b'); break;
-            case 'f': buffer.push_back('\x0c'); break;
-            case 'r': buffer.push_back('\x0d'); break;
-            case 'e': buffer.push_back('\x1a'); break;
+            case 'a': *out++ = '\x07'; break;
+            case 'b': *out++ = '\x08'; break;
+            case 't': *out++ = '\x09'; break;
+            case 'n': *out++ = '\x0a'; break;
+            case 'v': *out++ = '\x0b'; break;
+            case 'f': *out++ = '\x0c'; break;
+            case 'r': *out++ = '\x0d'; break;
+            case 'e': *out++ = '\x1a'; break;
             case '0': case '1': case '2': case '3': case '4': case '5':
             case '6': case '7':
             {
@@ -217,7 +234,7 @@ NasmStringParser::getString(SmallVectorImpl<char>& buffer) const
                         ++s;
                     }
                 }
-                buffer.push_back(static_cast<char>(ch));
+                *out++ = static_cast<char>(ch);
                 break;
             }
             case 'x':
@@ -225,7 +242,7 @@ NasmStringParser::getString(SmallVectorImpl<char>& buffer) const
                 // hex escape, up to 2 hex digits
                 if (!isxdigit(*s))
                 {
-                    buffer.push_back('x'); // treat it like a unknown escape
+                    *out++ = 'x'; // treat it like a unknown escape
                     break;
                 }
                 int ch = fromxdigit(*s);
@@ -236,7 +253,7 @@ NasmStringParser::getString(SmallVectorImpl<char>& buffer) const
                     ch |= fromxdigit(*s);
                     ++s;
                 }
-                buffer.push_back(static_cast<char>(ch));
+                *out++ = static_cast<char>(ch);
                 break;
             }
             case 'u':
@@ -267,17 +284,16 @@ NasmStringParser::getString(SmallVectorImpl<char>& buffer) const
                 else                        { upper = 0xfc; sh = 30; }
                 for (; sh >= 0; sh -= 6)
                 {
-                    buffer.push_back(static_cast<char>
-                        (upper | ((v >> sh) & 0x3f)));
+                    *out++ = static_cast<char>(upper | ((v >> sh) & 0x3f));
                     upper = 0x80;
                 }
                 break;
             }
             default:
-                buffer.push_back(s[-1]);
+                *out++ = s[-1];
                 break;
         }
     }
 
-    return StringRef(buffer.begin(), buffer.size());
+    return out-dest;
 }
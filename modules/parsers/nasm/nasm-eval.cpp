@@ -8,6 +8,7 @@
  * initial version 27/iii/95 by Simon Tatham
  */
 #include <cctype>
+#include <vector>
 
 #include "yasmx/Expr.h"
 #include "yasmx/IntNum.h"
@@ -17,6 +18,7 @@
 #include "nasm.h"
 #include "nasmlib.h"
 #include "nasm-eval.h"
+#include "nasm-pp.h"
 
 
 using yasm::Expr;
@@ -337,6 +339,8 @@ static bool expr6(Expr* e)
             break;
           case TOKEN_ID:
             if (yasm_object) {
+                if (yasm_pp_sync)
+                    yasm_pp_sync();
                 yasm::SymbolRef sym = yasm_object->getSymbol(tokval->t_charptr);
                 if (sym) {
                     sym->Use(yasm::SourceLocation());
@@ -367,27 +371,185 @@ static bool expr6(Expr* e)
     }
 }
 
+/*
+ * Integer-only fast path.  Preprocessor expressions are nearly always
+ * small calculations on numbers (e.g. %assign i i+1), so these are
+ * evaluated directly on IntNums rather than building an Expr and
+ * simplifying it.  The grammar is the same as above, by precedence level
+ * (0 is rexp0, 4 is expr0, ..., 10 is expr6).  Anything else (symbols,
+ * $, SEG, bad numbers, division by zero, oversized shifts, syntax
+ * errors) makes the fast path give up, and the tokens it scanned are
+ * replayed to the full evaluator, which handles them and reports any
+ * errors.
+ */
+static std::vector<struct tokenval> fast_toks;  /* tokens scanned so far */
+static int fast_base;                           /* level of bexpr */
+
+static void fast_scan(void)
+{
+    i = scan(scpriv, tokval);
+    fast_toks.push_back(*tokval);
+}
+
+static bool fast_binop(int level, yasm::Op::Op *op)
+{
+    switch (level) {
+      case 0: if (i == TOKEN_DBL_OR) { *op = yasm::Op::LOR; return true; }
+              break;
+      case 1: if (i == TOKEN_DBL_XOR) { *op = yasm::Op::LXOR; return true; }
+              break;
+      case 2: if (i == TOKEN_DBL_AND) { *op = yasm::Op::LAND; return true; }
+              break;
+      case 3:
+        switch (i) {
+          case TOKEN_EQ: *op = yasm::Op::EQ; return true;
+          case TOKEN_LT: *op = yasm::Op::LT; return true;
+          case TOKEN_GT: *op = yasm::Op::GT; return true;
+          case TOKEN_NE: *op = yasm::Op::NE; return true;
+          case TOKEN_LE: *op = yasm::Op::LE; return true;
+          case TOKEN_GE: *op = yasm::Op::GE; return true;
+        }
+        break;
+      case 4: if (i == '|') { *op = yasm::Op::OR; return true; } break;
+      case 5: if (i == '^') { *op = yasm::Op::XOR; return true; } break;
+      case 6: if (i == '&') { *op = yasm::Op::AND; return true; } break;
+      case 7:
+        if (i == TOKEN_SHL) { *op = yasm::Op::SHL; return true; }
+        if (i == TOKEN_SHR) { *op = yasm::Op::SHR; return true; }
+        break;
+      case 8:
+        if (i == '+') { *op = yasm::Op::ADD; return true; }
+        if (i == '-') { *op = yasm::Op::SUB; return true; }
+        break;
+      case 9:
+        switch (i) {
+          case '*': *op = yasm::Op::MUL; return true;
+          case '/': *op = yasm::Op::DIV; return true;
+          case '%': *op = yasm::Op::MOD; return true;
+          case TOKEN_SDIV: *op = yasm::Op::SIGNDIV; return true;
+          case TOKEN_SMOD: *op = yasm::Op::SIGNMOD; return true;
+        }
+        break;
+    }
+    return false;
+}
+
+static bool fast_expr(int level, IntNum *v);
+
+static bool fast_term(IntNum *v)
+{
+    switch (i) {
+      case '-':
+      case '+':
+      case '~':
+      {
+        int j = i;
+        fast_scan();
+        if (!fast_term(v))
+            return false;
+        if (j == '-')
+            v->CalcAssert(yasm::Op::NEG);
+        else if (j == '~')
+            v->CalcAssert(yasm::Op::NOT);
+        return true;
+      }
+      case '(':
+        fast_scan();
+        if (!fast_expr(fast_base, v) || i != ')')
+            return false;
+        fast_scan();
+        return true;
+      case TOKEN_NUM:
+        *v = *tokval->t_integer;
+        fast_scan();
+        return true;
+      default:
+        return false;
+    }
+}
+
+static bool fast_expr(int level, IntNum *v)
+{
+    if (level == 10)
+        return fast_term(v);
+    if (!fast_expr(level+1, v))
+        return false;
+
+    yasm::Op::Op op;
+    while (fast_binop(level, &op)) {
+        fast_scan();
+        IntNum f;
+        if (!fast_expr(level+1, &f))
+            return false;
+        if ((op == yasm::Op::DIV || op == yasm::Op::SIGNDIV ||
+             op == yasm::Op::MOD || op == yasm::Op::SIGNMOD) && f.isZero())
+            return false;
+        if ((op == yasm::Op::SHL || op == yasm::Op::SHR) &&
+            !f.isInRange(-IntNum::BITVECT_NATIVE_SIZE,
+                         IntNum::BITVECT_NATIVE_SIZE))
+            return false;
+        v->CalcAssert(op, f);
+    }
+    return true;
+}
+
+/* Scanner that replays the fast path's tokens, then continues scanning. */
+struct replay_state {
+    scanner sc;
+    void *priv;
+    std::vector<struct tokenval>::size_type pos;
+};
+
+static int replay_scan(void *private_data, struct tokenval *tv)
+{
+    replay_state *rs = static_cast<replay_state *>(private_data);
+    if (rs->pos < fast_toks.size()) {
+        *tv = fast_toks[rs->pos++];
+        return tv->t_type;
+    }
+    return rs->sc(rs->priv, tv);
+}
+
 Expr *nasm_evaluate (scanner sc, void *scprivate, struct tokenval *tv,
                           int critical, efunc report_error)
 {
     if (critical & CRITICAL) {
         critical &= ~CRITICAL;
         bexpr = rexp0;
-    } else
+        fast_base = 0;
+    } else {
         bexpr = expr0;
+        fast_base = 4;
+    }
 
     scan = sc;
     scpriv = scprivate;
     tokval = tv;
     error = report_error;
 
+    fast_toks.clear();
     if (tokval->t_type == TOKEN_INVALID)
         i = scan(scpriv, tokval);
     else
         i = tokval->t_type;
+    fast_toks.push_back(*tokval);
+
+    IntNum val;
+    if (fast_expr(fast_base, &val))
+        return new Expr(val);
+
+    /* Replay the scanned tokens to the full evaluator. */
+    replay_state rs = { sc, scprivate, 1 };
+    scan = replay_scan;
+    scpriv = &rs;
+    *tokval = fast_toks[0];
+    i = tokval->t_type;
 
     Expr* e = new Expr;
-    if (bexpr(e))
+    bool ok = bexpr(e);
+    scan = sc;
+    scpriv = scprivate;
+    if (ok)
         return e;
     delete e;
     return NULL;
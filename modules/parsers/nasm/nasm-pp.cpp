@@ -33,18 +33,26 @@
  *
  * detoken is used to convert the line back to text
  */
+#include <cassert>
 #include <cctype>
 #include <climits>
 #include <cstdarg>
 #include <cstdio>
 #include <cstring>
+#include <string>
+#include <vector>
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallString.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "yasmx/IntNum.h"
 #include "yasmx/Expr.h"
+#include "yasmx/Basic/Diagnostic.h"
+#include "yasmx/Basic/FileManager.h"
 #include "yasmx/Parse/Preprocessor.h"
 #include "yasmx/Parse/HeaderSearch.h"
+#include "yasmx/Support/Trace.h"
 
 #include "nasm.h"
 #include "nasmlib.h"
@@ -66,6 +74,8 @@ int tasm_locals;
 const char *tasm_segment;
 
 yasm::Preprocessor* yasm_preproc;
+void (*yasm_pp_sync)(void);
+yasm::DiagnosticBuffer* yasm_pp_diags;
 
 const MemoryBuffer*
 yasm_fopen_include(StringRef filename,
@@ -74,6 +84,8 @@ yasm_fopen_include(StringRef filename,
                    FileID from_file,
                    FileID& cur_file)
 {
+    if (yasm_pp_sync)
+        yasm_pp_sync();
     yasm::SourceManager& srcmgr = yasm_preproc->getSourceManager();
 
     const yasm::FileEntry* from_file_ent = srcmgr.getFileEntryForID(from_file);
@@ -137,6 +149,7 @@ typedef struct Context Context;
 typedef struct Token Token;
 typedef struct Blocks Blocks;
 typedef struct Line Line;
+typedef struct RepLine RepLine;
 typedef struct Include Include;
 typedef struct Cond Cond;
 
@@ -147,6 +160,7 @@ struct SMacro
 {
     SMacro *next;
     char *name;
+    unsigned int hashval;       /* hash(name), compared before the name */
     int level;
     int casesense;
     int nparam;
@@ -175,6 +189,7 @@ struct MMacro
 {
     MMacro *next;
     char *name;
+    unsigned int hashval;       /* hash(name), compared before the name */
     int casesense;
     long nparam_min, nparam_max;
     int plus;                   /* is the last parameter greedy? */
@@ -192,6 +207,9 @@ struct MMacro
     long nparam, rotate, *paramlen;
     unsigned long unique;
     int lineno;                 /* Current line number on expansion */
+
+    RepLine *replines;          /* %rep body as replayed, see RepLine */
+    int nreplines;
 };
 
 /*
@@ -223,13 +241,21 @@ struct Context
  * which doesn't need quotes around it. Used in the pre-include
  * mechanism as an alternative to trying to find a sensible type of
  * quote to use on the filename we were passed.
+ *
+ * Short texts (the vast majority: identifiers, numbers, punctuation)
+ * are stored in `buf' rather than in a separate allocation, so copying
+ * macro bodies and parameters during expansion doesn't hit the heap.
+ * Code that frees, reallocs, or takes ownership of `text' must go
+ * through free_text() / own_text().
  */
+#define TOKEN_INLINE_TEXT 16
 struct Token
 {
     Token *next;
     char *text;
     SMacro *mac;                /* associated macro for TOK_SMAC_END */
     int type;
+    char buf[TOKEN_INLINE_TEXT];
 };
 enum
 {
@@ -265,6 +291,36 @@ struct Line
     Line *next;
     MMacro *finishes;
     Token *first;
+    RepLine *rep;               /* copy `first' from here when popped */
+};
+
+/*
+ * Each line of a `%rep' block is tokenised once, when the block is
+ * read, and copied afresh on every repetition. A line which contains
+ * no preprocessor tokens of its own (so it can't be a directive and
+ * has no macro parameters) usually expands to the same thing every
+ * time round, so its single-line macro expansion is kept and reused
+ * for as long as no macro it looked up has been (re)defined since;
+ * see smacro_changed(). Lines whose expansion turns out to change,
+ * like those using a counter that the block %assigns, are marked
+ * volatile and simply expanded every time.
+ *
+ * Lines replayed from a %rep block are pushed on to istk->expansion
+ * with `first' NULL and `rep' pointing at one of these; the tokens
+ * are copied when the line is popped, as it is only then that we
+ * know whether the cached expansion is still good.
+ */
+struct RepLine
+{
+    Token *first;               /* the line as read, owned by the Line */
+    Token *expansion;           /* cached single-line macro expansion */
+    unsigned long deps;         /* smacro_slot_gen[] entries looked up */
+    unsigned long gen;          /* smacro_gen when expanded */
+    int state;
+};
+enum
+{
+    REPLINE_NEW, REPLINE_CACHED, REPLINE_VOLATILE
 };
 
 /*
@@ -399,6 +455,28 @@ static int is_condition(int arg)
         ((arg >= PP_IF) && (arg <= PP_IFSTR));
 }
 
+/*
+ * Find a directive by name (including the leading %), case-insensitively.
+ * Returns its PP_ index, or -1 if it is not a directive name.
+ */
+static int find_directive(const char *name)
+{
+    int i = -1, j = elements(directives), k, m;
+
+    while (j - i > 1)
+    {
+        k = (j + i) / 2;
+        m = nasm_stricmp(name, directives[k]);
+        if (m == 0)
+            return k;
+        else if (m < 0)
+            j = k;
+        else
+            i = k;
+    }
+    return -1;
+}
+
 /* For TASM compatibility we need to be able to recognise TASM compatible
  * conditional compilation directives. Using the NASM pre-processor does
  * not work, so we look for them specifically from the following list and
@@ -435,8 +513,6 @@ static Include *istk;
 static efunc _error;            /* Pointer to client-provided error reporting function */
 static evalfunc evaluate;
 
-static int pass;                /* HACK: pass 0 = generate dependencies only */
-
 static unsigned long unique;    /* unique identifier numbers */
 
 static Line *builtindef = NULL;
@@ -445,21 +521,38 @@ static Line *predef = NULL;
 static int first_line = 1;
 
 /*
- * The number of hash values we use for the macro lookup tables.
- * FIXME: We should *really* be able to configure this at run time,
- * or even have the hash table automatically expanding when necessary.
+ * The initial number of hash buckets in each macro lookup table.
+ * Must be a power of two; a table doubles in size whenever it holds
+ * more macros than it has buckets.
  */
-#define NHASH 31
+#define NHASH 32
 
 /*
  * The current set of multi-line macros we have defined.
  */
-static MMacro *mmacros[NHASH];
+static MMacro **mmacros;
+static unsigned int mmacros_size, mmacros_count;
 
 /*
  * The current set of single-line macros we have defined.
  */
-static SMacro *smacros[NHASH];
+static SMacro **smacros;
+static unsigned int smacros_size, smacros_count;
+
+/*
+ * Change tracking for the %rep expansion cache (see RepLine). Macro
+ * names are spread by hash over SMACRO_SLOTS slots; (re)defining or
+ * undefining a single-line macro bumps `smacro_gen' and stamps its
+ * slot with it. While expanding, expand_smacro() collects the slots
+ * of the names it looks up in `smacro_deps', and anything that makes
+ * the result depend on more than the macro definitions (__LINE__,
+ * context-local macros, errors) sets `smacro_volatile'.
+ */
+#define SMACRO_SLOTS (sizeof(unsigned long) * CHAR_BIT)
+static unsigned long smacro_gen;
+static unsigned long smacro_slot_gen[SMACRO_SLOTS];
+static unsigned long smacro_deps;
+static int smacro_volatile;
 
 /*
  * The multi-line macro we are currently defining, or the %rep
@@ -543,6 +636,7 @@ struct Blocks {
 };
 
 static Blocks blocks = { NULL, NULL };
+static Blocks *blocks_tail = &blocks;
 
 /*
  * Forward declarations.
@@ -558,6 +652,8 @@ static void delete_Blocks(void);
 static Token *new_Token(Token * next, int type, const char *text,
                         size_t txtlen);
 static Token *delete_Token(Token * t);
+static void free_text(Token * t);
+static char **own_text(Token * t);
 static Token *tokenise(char *line);
 
 /*
@@ -1107,7 +1203,7 @@ static Token * tasm_join_tokens(Token *tline)
             else {
                 int lenp = strlen(prev->text);
                 int lenn = strlen(next->text);
-                prev->text = (char*)nasm_realloc(prev->text, lenp + lenn + 1);
+                prev->text = (char*)nasm_realloc(*own_text(prev), lenp + lenn + 1);
                 strncpy(prev->text + lenp, next->text, lenn + 1);
                 (void) delete_Token(t);
                 prev->next = delete_Token(next);
@@ -1178,33 +1274,128 @@ prepreproc(char *line)
  * The hash function for macro lookups. Note that due to some
  * macros having case-insensitive names, the hash function must be
  * invariant under case changes. We implement this by applying a
- * perfectly normal hash function to the uppercase of the string.
+ * perfectly normal hash function (FNV-1a) to the uppercase of the
+ * string. The full value is returned; callers mask it down to the
+ * size of the table, and keep it in the macro to skip most string
+ * compares.
  */
-static int
-hash(char *s)
+static unsigned int
+hash(const char *s)
 {
-    unsigned int h = 0;
-    unsigned int i = 0;
-    /*
-     * Powers of three, mod 31.
-     */
-    static const int multipliers[] = {
-        1, 3, 9, 27, 19, 26, 16, 17, 20, 29, 25, 13, 8, 24, 10,
-        30, 28, 22, 4, 12, 5, 15, 14, 11, 2, 6, 18, 23, 7, 21
-    };
-
+    unsigned int h = 2166136261U;
 
     while (*s)
     {
-        h += multipliers[i] * (unsigned char) (toupper(*s));
+        h ^= (unsigned char) (toupper(*s));
+        h *= 16777619U;
         s++;
-        if (++i >= elements(multipliers))
-            i = 0;
     }
-    h %= NHASH;
     return h;
 }
 
+/*
+ * Allocate an empty macro lookup table of NHASH buckets.
+ */
+template <typename T>
+static void
+init_macro_table(T ***table, unsigned int *size, unsigned int *count)
+{
+    *size = NHASH;
+    *count = 0;
+    *table = (T**)nasm_malloc(NHASH * sizeof(T*));
+    memset(*table, 0, NHASH * sizeof(T*));
+}
+
+/*
+ * Double the number of buckets in a macro lookup table if it holds
+ * more macros than buckets. Each chain keeps its relative order, as
+ * lookups rely on later definitions being found first.
+ */
+template <typename T>
+static void
+grow_macro_table(T ***table, unsigned int *size, unsigned int count)
+{
+    unsigned int newsize, i;
+    T **newtab, ***tails;
+
+    if (count <= *size)
+        return;
+    newsize = *size * 2;
+    newtab = (T**)nasm_malloc(newsize * sizeof(T*));
+    tails = (T***)nasm_malloc(newsize * sizeof(T**));
+    for (i = 0; i < newsize; i++)
+    {
+        newtab[i] = NULL;
+        tails[i] = &newtab[i];
+    }
+    for (i = 0; i < *size; i++)
+    {
+        T *m = (*table)[i];
+        while (m)
+        {
+            T *next = m->next;
+            unsigned int k = m->hashval & (newsize - 1);
+            m->next = NULL;
+            *tails[k] = m;
+            tails[k] = &m->next;
+            m = next;
+        }
+    }
+    nasm_free(tails);
+    nasm_free(*table);
+    *table = newtab;
+    *size = newsize;
+}
+
+/*
+ * Note that single-line macros with hash value `h' (or all of them,
+ * for ~0U) are being changed, invalidating cached expansions which
+ * looked them up.
+ */
+static void
+smacro_changed(unsigned int h)
+{
+    unsigned int i;
+
+    smacro_gen++;
+    if (h != ~0U)
+        smacro_slot_gen[h % SMACRO_SLOTS] = smacro_gen;
+    else
+        for (i = 0; i < SMACRO_SLOTS; i++)
+            smacro_slot_gen[i] = smacro_gen;
+}
+
+/*
+ * Return the list a single-line macro named `name' is to be defined
+ * on: either the local macros of `ctx', or the global hash bucket.
+ */
+static SMacro **
+smacro_list(Context *ctx, const char *name)
+{
+    smacro_changed(hash(name));
+    if (ctx)
+        return &ctx->localmac;
+    grow_macro_table(&smacros, &smacros_size, smacros_count);
+    return &smacros[hash(name) & (smacros_size - 1)];
+}
+
+/*
+ * Allocate a new single-line macro named `name' and link it at the
+ * head of `smhead' as returned by smacro_list(). The caller fills in
+ * everything but `next' and `hashval'.
+ */
+static SMacro *
+new_smacro(SMacro **smhead, Context *ctx, const char *name)
+{
+    SMacro *smac = (SMacro*)nasm_malloc(sizeof(SMacro));
+    smac->hashval = hash(name);
+    smac->next = *smhead;
+    *smhead = smac;
+    if (!ctx)
+        smacros_count++;
+    return smac;
+}
+
 /*
  * Free a linked list of tokens.
  */
@@ -1239,10 +1430,15 @@ free_llist(Line * list_)
 static void
 free_mmacro(MMacro * m)
 {
+    int i;
+
     nasm_free(m->name);
     free_tlist(m->dlist);
     nasm_free(m->defaults);
     free_llist(m->expansion);
+    for (i = 0; i < m->nreplines; i++)
+        free_tlist(m->replines[i].expansion);
+    nasm_free(m->replines);
     nasm_free(m);
 }
 
@@ -1521,11 +1717,8 @@ tokenise(char *line)
 static void *
 new_Block(size_t size)
 {
-        Blocks *b = &blocks;
-        
-        /* first, get to the end of the linked list      */
-        while (b->next)
-                b = b->next;
+        Blocks *b = blocks_tail;
+
         /* now allocate the requested chunk */
         b->chunk = nasm_malloc(size);
         
@@ -1534,6 +1727,7 @@ new_Block(size_t size)
         /* and initialize the contents of the new block */
         b->next->next = NULL;
         b->next->chunk = NULL;
+        blocks_tail = b->next;
         return b->chunk;
 }
 
@@ -1592,18 +1786,44 @@ new_Token(Token * next, int type, const char *text, size_t txtlen)
     {
         if (txtlen == 0)
             txtlen = strlen(text);
-        t->text = (char*)nasm_malloc(1 + txtlen);
+        if (txtlen < TOKEN_INLINE_TEXT)
+            t->text = t->buf;
+        else
+            t->text = (char*)nasm_malloc(1 + txtlen);
         strncpy(t->text, text, txtlen);
         t->text[txtlen] = '\0';
     }
     return t;
 }
 
+/*
+ * Free a token's text, wherever it's stored.
+ */
+static void
+free_text(Token * t)
+{
+    if (t->text != t->buf)
+        nasm_free(t->text);
+    t->text = NULL;
+}
+
+/*
+ * Make sure a token's text is separately allocated, so it can be
+ * realloc'ed, freed, or handed off by code that expects a heap string.
+ */
+static char **
+own_text(Token * t)
+{
+    if (t->text == t->buf)
+        t->text = nasm_strdup(t->buf);
+    return &t->text;
+}
+
 static Token *
 delete_Token(Token * t)
 {
     Token *next = t->next;
-    nasm_free(t->text);
+    free_text(t);
     t->next = freeTokens;
     freeTokens = t;
     return next;
@@ -1627,7 +1847,7 @@ detoken(Token * tlist, int expand_locals)
         if (t->type == TOK_PREPROC_ID && t->text[1] == '!')
         {
             char *p2 = getenv(t->text + 2);
-            nasm_free(t->text);
+            free_text(t);
             if (p2)
                 t->text = nasm_strdup(p2);
             else
@@ -1647,7 +1867,7 @@ detoken(Token * tlist, int expand_locals)
                 q += strspn(q, "$");
                 sprintf(buffer, "..@%lu.", ctx->number);
                 p2 = nasm_strcat(buffer, q);
-                nasm_free(t->text);
+                free_text(t);
                 t->text = p2;
             }
         }
@@ -1954,6 +2174,100 @@ inc_fopen(char *file,
     return in;
 }
 
+/*
+ * Include guards of files seen so far, keyed by file entry.  An empty
+ * string means the file is not wrapped in an include guard.
+ */
+static llvm::DenseMap<const yasm::FileEntry*, std::string> include_guards;
+
+/*
+ * Scan an include file for an include guard: the first non-blank,
+ * non-comment line is `%ifndef NAME', and its matching `%endif' is the
+ * last.  Such a file contributes nothing once NAME is defined, so it
+ * need not be read again.  Anything unusual (%else/%elif of the guard,
+ * line continuations, content outside the guard) gives no guard.
+ */
+static std::string
+find_include_guard(const MemoryBuffer *in)
+{
+    const char *p = in->getBufferStart();
+    const char *end = in->getBufferEnd();
+    std::string guard;
+    int depth = 0;
+    bool closed = false;
+
+    while (p < end)
+    {
+        const char *eol = (const char *)memchr(p, '\n', end - p);
+        if (!eol)
+            eol = end;
+        const char *q = eol;
+        while (q > p && isspace((unsigned char)q[-1]))
+            q--;
+        if (q > p && q[-1] == '\\')
+            return std::string();
+        while (p < q && isspace((unsigned char)*p))
+            p++;
+        const char *line = p;
+        p = eol + 1;
+
+        if (line == q || *line == ';')
+            continue;           /* blank or comment-only line */
+        if (closed)
+            return std::string();
+        if (*line != '%')
+        {
+            if (depth == 0)
+                return std::string();
+            continue;
+        }
+
+        const char *w = line + 1;
+        while (w < q && isidchar(*w))
+            w++;
+        char name[16];
+        if ((size_t)(w - line) >= sizeof(name))
+        {
+            if (depth == 0)
+                return std::string();
+            continue;
+        }
+        memcpy(name, line, w - line);
+        name[w - line] = '\0';
+        int i = find_directive(name);
+
+        if (depth == 0)
+        {
+            /* must be exactly `%ifndef NAME', optionally commented */
+            if (i != PP_IFNDEF || w == q || !isspace((unsigned char)*w))
+                return std::string();
+            while (w < q && isspace((unsigned char)*w))
+                w++;
+            const char *id = w;
+            if (!isidstart(*id))
+                return std::string();
+            while (w < q && isidchar(*w))
+                w++;
+            guard.assign(id, w);
+            while (w < q && isspace((unsigned char)*w))
+                w++;
+            if (w != q && *w != ';')
+                return std::string();
+            depth = 1;
+        }
+        else if (i >= PP_IF && i <= PP_IFSTR)
+            depth++;
+        else if (i == PP_ENDIF)
+        {
+            if (--depth == 0)
+                closed = true;
+        }
+        else if (depth == 1 && i >= PP_ELIF && i <= PP_ELSE)
+            return std::string();
+    }
+    return closed ? guard : std::string();
+}
+
 /*
  * Determine if we should warn on defining a single-line macro of
  * name `name', with `nparam' parameters. If nparam is 0 or -1, will
@@ -1981,6 +2295,7 @@ smacro_defined(Context * ctx, char *name, int nparam, SMacro ** defn,
 {
     SMacro *m;
     int highest_level = -1;
+    unsigned int h = hash(name);
 
     if (ctx)
         m = ctx->localmac;
@@ -1993,11 +2308,11 @@ smacro_defined(Context * ctx, char *name, int nparam, SMacro ** defn,
         m = ctx->localmac;
     }
     else
-        m = smacros[hash(name)];
+        m = smacros[h & (smacros_size - 1)];
 
     while (m)
     {
-        if (!mstrcmp(m->name, name, m->casesense && nocase) &&
+        if (m->hashval == h && !mstrcmp(m->name, name, m->casesense && nocase) &&
                 (nparam <= 0 || m->nparam == 0 || nparam == m->nparam) && (highest_level < 0 || m->level > highest_level))
         {
             highest_level = m->level;
@@ -2015,6 +2330,168 @@ smacro_defined(Context * ctx, char *name, int nparam, SMacro ** defn,
     return highest_level >= 0;
 }
 
+/*
+ * Determine if a just-opened include file may be skipped entirely because
+ * its include guard macro is already defined.
+ */
+static int
+include_guarded(FileID fid, const MemoryBuffer *in)
+{
+    if (tasm_compatible_mode)
+        return FALSE;
+
+    if (yasm_pp_sync)
+        yasm_pp_sync();
+    const yasm::FileEntry *file =
+        yasm_preproc->getSourceManager().getFileEntryForID(fid);
+    if (!file)
+        return FALSE;
+
+    llvm::DenseMap<const yasm::FileEntry*, std::string>::iterator guard =
+        include_guards.find(file);
+    if (guard == include_guards.end())
+        guard = include_guards.insert(
+            std::make_pair(file, find_include_guard(in))).first;
+    if (guard->second.empty())
+        return FALSE;
+
+    return smacro_defined(NULL, const_cast<char *>(guard->second.c_str()),
+                          0, NULL, 1);
+}
+
+/*
+ * Files whose %include and incbin targets have been prefetched.
+ */
+static llvm::SmallPtrSet<const yasm::FileEntry*, 16> prefetched_files;
+
+/*
+ * Get the file name of a %include or incbin argument if it is a plain
+ * quoted string; names that need macros or environment variables
+ * expanding give an empty string.
+ */
+static StringRef
+prefetch_name(const char *p, const char *q)
+{
+    while (p < q && isspace((unsigned char)*p))
+        p++;
+    if (p == q || (*p != '"' && *p != '\''))
+        return StringRef();
+    const char *name = p + 1;
+    const char *close = (const char *)memchr(name, *p, q - name);
+    if (!close)
+        return StringRef();
+    StringRef str(name, close - name);
+    if (str.find('%') != StringRef::npos)
+        return StringRef();
+    return str;
+}
+
+/*
+ * Start reading the files a just-entered file will %include or incbin
+ * in the background, so they're ready by the time they're reached
+ * rather than stalling on a slow file system.  Only directives outside
+ * of conditionals, macro definitions and %rep blocks are looked at (an
+ * include guard around the whole file doesn't count), so files that
+ * won't be used are seldom read.
+ */
+static void
+prefetch_includes(FileID fid, const MemoryBuffer *in)
+{
+    if (yasm_pp_sync)
+        yasm_pp_sync();
+    const yasm::FileEntry *file =
+        yasm_preproc->getSourceManager().getFileEntryForID(fid);
+    if (file && !prefetched_files.insert(file))
+        return;
+    StringRef dir = file ? StringRef(file->getDir()->getName()) : StringRef();
+    yasm::HeaderSearch &headers = yasm_preproc->getHeaderSearch();
+
+    const char *p = in->getBufferStart();
+    const char *end = in->getBufferEnd();
+    int depth = 0;
+    bool first = true;
+
+    while (p < end)
+    {
+        const char *eol = (const char *)memchr(p, '\n', end - p);
+        if (!eol)
+            eol = end;
+        const char *q = eol;
+        while (p < q && isspace((unsigned char)*p))
+            p++;
+        const char *line = p;
+        p = eol + 1;
+
+        if (line == q || *line == ';')
+            continue;           /* blank or comment-only line */
+        bool guard = first;
+        first = false;
+
+        const char *w = line;
+        if (*w == '%')
+            w++;
+        while (w < q && isidchar(*w))
+            w++;
+
+        if (*line != '%')
+        {
+            /* incbin, possibly after a label */
+            if (depth > 0)
+                continue;
+            if (!StringRef(line, w - line).equals_lower("incbin"))
+            {
+                if (w < q && *w == ':')
+                    w++;
+                while (w < q && isspace((unsigned char)*w))
+                    w++;
+                const char *word = w;
+                while (w < q && isidchar(*w))
+                    w++;
+                if (!StringRef(word, w - word).equals_lower("incbin"))
+                    continue;
+            }
+            /* incbin files are opened directly rather than through the
+             * file manager, so just get them into the OS cache */
+            StringRef name = prefetch_name(w, q);
+            if (!name.empty())
+                headers.getFileMgr().prefetchFile(
+                    std::vector<std::string>(1, name), false);
+            continue;
+        }
+
+        char name[16];
+        if ((size_t)(w - line) >= sizeof(name))
+            continue;
+        memcpy(name, line, w - line);
+        name[w - line] = '\0';
+        int i = find_directive(name);
+
+        if (i >= PP_IF && i <= PP_IFSTR)
+        {
+            if (!guard || i != PP_IFNDEF)
+                depth++;
+        }
+        else if (i == PP_MACRO || i == PP_IMACRO || i == PP_REP)
+            depth++;
+        else if (i == PP_ENDIF || i == PP_ENDMACRO || i == PP_ENDM ||
+                 i == PP_ENDREP)
+        {
+            if (depth > 0)
+                depth--;
+        }
+        else if (depth > 0)
+            continue;
+        else if (i >= PP_ELIF && i <= PP_ELSE)
+            return;             /* rest depends on the include guard */
+        else if (i == PP_INCLUDE)
+        {
+            StringRef fn = prefetch_name(w, q);
+            if (!fn.empty())
+                headers.PrefetchFile(fn, dir);
+        }
+    }
+}
+
 /*
  * Count and mark off the parameters in a multi-line macro call.
  * This is called both from within the multi-line macro expansion
@@ -2066,6 +2543,26 @@ count_mmac_params(Token * t, int *nparam, Token *** params)
     }
 }
 
+/*
+ * Simplify an evaluated expression.  Diagnostics are saved while the
+ * parser is running, and reported once it is idle.
+ */
+static void
+simplify_expr(Expr *e)
+{
+    if (!yasm_pp_diags)
+    {
+        e->Simplify(yasm_preproc->getDiagnostics());
+        return;
+    }
+    e->Simplify(yasm_pp_diags->getDiagnostics());
+    if (!yasm_pp_diags->empty())
+    {
+        yasm_pp_sync();
+        yasm_pp_diags->Replay(yasm_preproc->getDiagnostics());
+    }
+}
+
 /*
  * Determine whether one of the various `if' conditions is true or
  * not.
@@ -2279,10 +2776,12 @@ if_condition(Token * tline, int i)
                 tline = tline->next;
                 searching.plus = TRUE;
             }
-            mmac = mmacros[hash(searching.name)];
+            searching.hashval = hash(searching.name);
+            mmac = mmacros[searching.hashval & (mmacros_size - 1)];
             while (mmac)
             {
-                if (!strcmp(mmac->name, searching.name) &&
+                if (mmac->hashval == searching.hashval &&
+                        !strcmp(mmac->name, searching.name) &&
                         (mmac->nparam_min <= searching.nparam_max
                                 || searching.plus)
                         && (searching.nparam_min <= mmac->nparam_max
@@ -2352,7 +2851,7 @@ if_condition(Token * tline, int i)
             t = tline = expand_smacro(tline);
             tptr = &t;
             tokval.t_type = TOKEN_INVALID;
-            evalresult = evaluate(ppscan, tptr, &tokval, pass | CRITICAL,
+            evalresult = evaluate(ppscan, tptr, &tokval, CRITICAL,
                                   error);
             free_tlist(tline);
             if (!evalresult)
@@ -2360,7 +2859,7 @@ if_condition(Token * tline, int i)
             if (tokval.t_type)
                 error(ERR_WARNING,
                         "trailing garbage after expression ignored");
-            evalresult->Simplify(yasm_preproc->getDiagnostics());
+            simplify_expr(evalresult);
             if (!evalresult->isIntNum())
             {
                 error(ERR_NONFATAL,
@@ -2765,7 +3264,7 @@ do_directive(Token * tline)
             if (tline->next)
                 error(ERR_WARNING,
                         "trailing garbage after `%%clear' ignored");
-            for (j = 0; j < NHASH; j++)
+            for (j = 0; j < (int)mmacros_size; j++)
             {
                 while (mmacros[j])
                 {
@@ -2773,6 +3272,10 @@ do_directive(Token * tline)
                     mmacros[j] = m2->next;
                     free_mmacro(m2);
                 }
+            }
+            smacro_changed(~0U);
+            for (j = 0; j < (int)smacros_size; j++)
+            {
                 while (smacros[j])
                 {
                     SMacro *s = smacros[j];
@@ -2782,6 +3285,8 @@ do_directive(Token * tline)
                     nasm_free(s);
                 }
             }
+            mmacros_count = 0;
+            smacros_count = 0;
             free_tlist(origline);
             return DIRECTIVE_FOUND;
 
@@ -2807,12 +3312,20 @@ do_directive(Token * tline)
             else
                 p = tline->text;        /* internal_string is easier */
             expand_macros_in_string(&p);
+            const DirectoryLookup* to_dir;
+            FileID to_file;
+            const MemoryBuffer* in =
+                inc_fopen(p, istk->cur_dir, to_dir, istk->fid, to_file);
+            if (in && include_guarded(to_file, in))
+            {
+                free_tlist(origline);
+                return DIRECTIVE_FOUND;
+            }
+            prefetch_includes(to_file, in);
             inc = (Include*)nasm_malloc(sizeof(Include));
             inc->next = istk;
             inc->conds = NULL;
-            const DirectoryLookup* to_dir;
-            FileID to_file;
-            inc->in = inc_fopen(p, istk->cur_dir, to_dir, istk->fid, to_file);
+            inc->in = in;
             inc->fid = to_file;
             inc->cur_dir = to_dir;
             inc->pos = 0;
@@ -2822,6 +3335,7 @@ do_directive(Token * tline)
             inc->expansion = NULL;
             inc->mstk = NULL;
             istk = inc;
+            yasm::TraceBegin("Include", inc->in->getBufferIdentifier());
             //list->uplevel(LIST_INCLUDE);
             free_tlist(origline);
             return DIRECTIVE_FOUND;
@@ -2896,7 +3410,8 @@ do_directive(Token * tline)
                         "`%%endscope': already popped all levels");
             else
             {
-                for (k = 0; k < NHASH; k++)
+                smacro_changed(~0U);
+                for (k = 0; k < (int)smacros_size; k++)
                 {
                     SMacro **smlast = &smacros[k];
                     smac = smacros[k];
@@ -2914,6 +3429,7 @@ do_directive(Token * tline)
                             free_tlist(smac->expansion);
                             nasm_free(smac);
                             smac = *smlast;
+                            smacros_count--;
                         }
                     }
                 }
@@ -3135,10 +3651,12 @@ do_directive(Token * tline)
                 tline = tline->next;
                 defining->nolist = TRUE;
             }
-            mmac = mmacros[hash(defining->name)];
+            defining->hashval = hash(defining->name);
+            mmac = mmacros[defining->hashval & (mmacros_size - 1)];
             while (mmac)
             {
-                if (!strcmp(mmac->name, defining->name) &&
+                if (mmac->hashval == defining->hashval &&
+                        !strcmp(mmac->name, defining->name) &&
                         (mmac->nparam_min <= defining->nparam_max
                                 || defining->plus)
                         && (defining->nparam_min <= mmac->nparam_max
@@ -3167,6 +3685,8 @@ do_directive(Token * tline)
                 defining->defaults = NULL;
             }
             defining->expansion = NULL;
+            defining->replines = NULL;
+            defining->nreplines = 0;
             free_tlist(origline);
             return DIRECTIVE_FOUND;
 
@@ -3178,7 +3698,8 @@ do_directive(Token * tline)
                         tline->text);
                 return DIRECTIVE_FOUND;
             }
-            k = hash(defining->name);
+            grow_macro_table(&mmacros, &mmacros_size, ++mmacros_count);
+            k = defining->hashval & (mmacros_size - 1);
             defining->next = mmacros[k];
             mmacros[k] = defining;
             defining = NULL;
@@ -3200,14 +3721,14 @@ do_directive(Token * tline)
             tline = t;
             tptr = &t;
             tokval.t_type = TOKEN_INVALID;
-            evalresult = evaluate(ppscan, tptr, &tokval, pass, error);
+            evalresult = evaluate(ppscan, tptr, &tokval, 0, error);
             free_tlist(tline);
             if (!evalresult)
                 return DIRECTIVE_FOUND;
             if (tokval.t_type)
                 error(ERR_WARNING,
                         "trailing garbage after expression ignored");
-            evalresult->Simplify(yasm_preproc->getDiagnostics());
+            simplify_expr(evalresult);
             if (!evalresult->isIntNum())
             {
                 error(ERR_NONFATAL, "non-constant value given to `%%rotate'");
@@ -3259,7 +3780,7 @@ do_directive(Token * tline)
                 t = expand_smacro(tline);
                 tptr = &t;
                 tokval.t_type = TOKEN_INVALID;
-                evalresult = evaluate(ppscan, tptr, &tokval, pass, error);
+                evalresult = evaluate(ppscan, tptr, &tokval, 0, error);
                 if (!evalresult)
                 {
                     free_tlist(origline);
@@ -3268,7 +3789,7 @@ do_directive(Token * tline)
                 if (tokval.t_type)
                     error(ERR_WARNING,
                           "trailing garbage after expression ignored");
-                evalresult->Simplify(yasm_preproc->getDiagnostics());
+                simplify_expr(evalresult);
                 if (!evalresult->isIntNum())
                 {
                     error(ERR_NONFATAL, "non-constant value given to `%%rep'");
@@ -3296,6 +3817,8 @@ do_directive(Token * tline)
             defining->defaults = NULL;
             defining->dlist = NULL;
             defining->expansion = NULL;
+            defining->replines = NULL;
+            defining->nreplines = 0;
             defining->next_active = istk->mstk;
             defining->rep_nest = tmp_defining;
             return DIRECTIVE_FOUND;
@@ -3319,6 +3842,7 @@ do_directive(Token * tline)
              * from istk->expansion by a %exitrep.
              */
             l = (Line*)nasm_malloc(sizeof(Line));
+            l->rep = NULL;
             l->next = istk->expansion;
             l->finishes = defining;
             l->first = NULL;
@@ -3369,10 +3893,7 @@ do_directive(Token * tline)
             }
 
             ctx = get_ctx(tline->text, FALSE);
-            if (!ctx)
-                smhead = &smacros[hash(tline->text)];
-            else
-                smhead = &ctx->localmac;
+            smhead = smacro_list(ctx, tline->text);
             mname = tline->text;
             last = tline;
             param_start = tline = tline->next;
@@ -3476,16 +3997,12 @@ do_directive(Token * tline)
                 }
                 else
                 {
-                    smac = (SMacro*)nasm_malloc(sizeof(SMacro));
-                    smac->next = *smhead;
-                    *smhead = smac;
+                    smac = new_smacro(smhead, ctx, mname);
                 }
             }
             else
             {
-                smac = (SMacro*)nasm_malloc(sizeof(SMacro));
-                smac->next = *smhead;
-                *smhead = smac;
+                smac = new_smacro(smhead, ctx, mname);
             }
             smac->name = nasm_strdup(mname);
             smac->casesense = ((i == PP_DEFINE) || (i == PP_XDEFINE));
@@ -3516,10 +4033,7 @@ do_directive(Token * tline)
 
             /* Find the context that symbol belongs to */
             ctx = get_ctx(tline->text, FALSE);
-            if (!ctx)
-                smhead = &smacros[hash(tline->text)];
-            else
-                smhead = &ctx->localmac;
+            smhead = smacro_list(ctx, tline->text);
 
             mname = tline->text;
 
@@ -3537,6 +4051,8 @@ do_directive(Token * tline)
                     nasm_free(smac->name);
                     free_tlist(smac->expansion);
                     nasm_free(smac);
+                    if (!ctx)
+                        smacros_count--;
                 }
             }
             free_tlist(origline);
@@ -3556,10 +4072,7 @@ do_directive(Token * tline)
                 return DIRECTIVE_FOUND;
             }
             ctx = get_ctx(tline->text, FALSE);
-            if (!ctx)
-                smhead = &smacros[hash(tline->text)];
-            else
-                smhead = &ctx->localmac;
+            smhead = smacro_list(ctx, tline->text);
             mname = tline->text;
             last = tline;
             tline = expand_smacro(tline->next);
@@ -3607,9 +4120,7 @@ do_directive(Token * tline)
             }
             else
             {
-                smac = (SMacro*)nasm_malloc(sizeof(SMacro));
-                smac->next = *smhead;
-                *smhead = smac;
+                smac = new_smacro(smhead, ctx, mname);
             }
             smac->name = nasm_strdup(mname);
             smac->casesense = (i == PP_STRLEN);
@@ -3636,10 +4147,7 @@ do_directive(Token * tline)
                 return DIRECTIVE_FOUND;
             }
             ctx = get_ctx(tline->text, FALSE);
-            if (!ctx)
-                smhead = &smacros[hash(tline->text)];
-            else
-                smhead = &ctx->localmac;
+            smhead = smacro_list(ctx, tline->text);
             mname = tline->text;
             last = tline;
             tline = expand_smacro(tline->next);
@@ -3662,14 +4170,14 @@ do_directive(Token * tline)
             tt = t->next;
             tptr = &tt;
             tokval.t_type = TOKEN_INVALID;
-            evalresult = evaluate(ppscan, tptr, &tokval, pass, error);
+            evalresult = evaluate(ppscan, tptr, &tokval, 0, error);
             if (!evalresult)
             {
                 free_tlist(tline);
                 free_tlist(origline);
                 return DIRECTIVE_FOUND;
             }
-            evalresult->Simplify(yasm_preproc->getDiagnostics());
+            simplify_expr(evalresult);
             if (!evalresult->isIntNum())
             {
                 error(ERR_NONFATAL, "non-constant value given to `%%substr`");
@@ -3719,9 +4227,7 @@ do_directive(Token * tline)
             }
             else
             {
-                smac = (SMacro*)nasm_malloc(sizeof(SMacro));
-                smac->next = *smhead;
-                *smhead = smac;
+                smac = new_smacro(smhead, ctx, mname);
             }
             smac->name = nasm_strdup(mname);
             smac->casesense = (i == PP_SUBSTR);
@@ -3750,10 +4256,7 @@ do_directive(Token * tline)
                 return DIRECTIVE_FOUND;
             }
             ctx = get_ctx(tline->text, FALSE);
-            if (!ctx)
-                smhead = &smacros[hash(tline->text)];
-            else
-                smhead = &ctx->localmac;
+            smhead = smacro_list(ctx, tline->text);
             mname = tline->text;
             last = tline;
             tline = expand_smacro(tline->next);
@@ -3762,7 +4265,7 @@ do_directive(Token * tline)
             t = tline;
             tptr = &t;
             tokval.t_type = TOKEN_INVALID;
-            evalresult = evaluate(ppscan, tptr, &tokval, pass, error);
+            evalresult = evaluate(ppscan, tptr, &tokval, 0, error);
             free_tlist(tline);
             if (!evalresult)
             {
@@ -3774,7 +4277,7 @@ do_directive(Token * tline)
                 error(ERR_WARNING,
                         "trailing garbage after expression ignored");
 
-            evalresult->Simplify(yasm_preproc->getDiagnostics());
+            simplify_expr(evalresult);
             if (!evalresult->isIntNum())
             {
                 error(ERR_NONFATAL,
@@ -3815,9 +4318,7 @@ do_directive(Token * tline)
             }
             else
             {
-                smac = (SMacro*)nasm_malloc(sizeof(SMacro));
-                smac->next = *smhead;
-                *smhead = smac;
+                smac = new_smacro(smhead, ctx, mname);
             }
             smac->name = nasm_strdup(mname);
             smac->casesense = (i == PP_ASSIGN);
@@ -4107,7 +4608,7 @@ expand_mmac_params(Token * tline)
                 *tail = t;
                 tail = &t->next;
                 t->type = type;
-                nasm_free(t->text);
+                free_text(t);
                 t->text = text;
                 t->mac = NULL;
             }
@@ -4136,7 +4637,7 @@ expand_mmac_params(Token * tline)
                 if (tt->type == TOK_ID || tt->type == TOK_NUMBER)
                 {
                     char *tmp = nasm_strcat(t->text, tt->text);
-                    nasm_free(t->text);
+                    free_text(t);
                     t->text = tmp;
                     t->next = delete_Token(tt);
                 }
@@ -4145,7 +4646,7 @@ expand_mmac_params(Token * tline)
                 if (tt->type == TOK_NUMBER)
                 {
                     char *tmp = nasm_strcat(t->text, tt->text);
-                    nasm_free(t->text);
+                    free_text(t);
                     t->text = tmp;
                     t->next = delete_Token(tt);
                 }
@@ -4170,6 +4671,7 @@ expand_smacro(Token * tline)
     Token **params;
     int *paramsize;
     int nparam, sparam, brackets, rescan;
+    unsigned int h;
     Token *org_tline = tline;
     Context *ctx;
     char *mname;
@@ -4186,8 +4688,7 @@ expand_smacro(Token * tline)
                 new_Token(org_tline->next, org_tline->type, org_tline->text,
                 0);
         tline->mac = org_tline->mac;
-        nasm_free(org_tline->text);
-        org_tline->text = NULL;
+        free_text(org_tline);
     }
 
   again:
@@ -4203,10 +4704,15 @@ expand_smacro(Token * tline)
                 ctx = get_ctx(mname, TRUE);
             else
                 ctx = NULL;
+            h = hash(mname);
+            smacro_deps |= 1UL << (h % SMACRO_SLOTS);
             if (!ctx)
-                head = smacros[hash(mname)];
+                head = smacros[h & (smacros_size - 1)];
             else
+            {
                 head = ctx->localmac;
+                smacro_volatile = TRUE;
+            }
             /*
              * We've hit an identifier. As in is_mmacro below, we first
              * check whether the identifier is a single-line macro at
@@ -4214,7 +4720,7 @@ expand_smacro(Token * tline)
              * necessary.
              */
             for (m = head; m; m = m->next)
-                if (!mstrcmp(m->name, mname, m->casesense))
+                if (m->hashval == h && !mstrcmp(m->name, mname, m->casesense))
                     break;
             if (m)
             {
@@ -4230,17 +4736,18 @@ expand_smacro(Token * tline)
                      */
                     if (!m->expansion)
                     {
+                        smacro_volatile = TRUE;
                         if (!strcmp("__FILE__", m->name))
                         {
                             long num = 0;
-                            nasm_src_get(&num, &(tline->text));
-                            nasm_quote(&(tline->text));
+                            nasm_src_get(&num, own_text(tline));
+                            nasm_quote(own_text(tline));
                             tline->type = TOK_STRING;
                             continue;
                         }
                         if (!strcmp("__LINE__", m->name))
                         {
-                            nasm_free(tline->text);
+                            free_text(tline);
                             make_tok_num(tline, nasm_src_get_linnum());
                             continue;
                         }
@@ -4488,7 +4995,7 @@ expand_smacro(Token * tline)
                 t->next->type == TOK_NUMBER)
         {
             char *p = nasm_strcat(t->text, t->next->text);
-            nasm_free(t->text);
+            free_text(t);
             t->next = delete_Token(t->next);
             t->text = p;
             rescan = 1;
@@ -4521,6 +5028,8 @@ expand_smacro(Token * tline)
         if (thead)
         {
             *org_tline = *thead;
+            if (thead->text == thead->buf)
+                org_tline->text = org_tline->buf;
             /* since we just gave text to org_line, don't free it */
             thead->text = NULL;
             delete_Token(thead);
@@ -4612,8 +5121,10 @@ is_mmacro(Token * tline, Token *** params_array)
     MMacro *head, *m;
     Token **params;
     int nparam;
+    unsigned int h;
 
-    head = mmacros[hash(tline->text)];
+    h = hash(tline->text);
+    head = mmacros[h & (mmacros_size - 1)];
 
     /*
      * Efficiency: first we see if any macro exists with the given
@@ -4622,7 +5133,7 @@ is_mmacro(Token * tline, Token *** params_array)
      * list if necessary to find the proper MMacro.
      */
     for (m = head; m; m = m->next)
-        if (!mstrcmp(m->name, tline->text, m->casesense))
+        if (m->hashval == h && !mstrcmp(m->name, tline->text, m->casesense))
             break;
     if (!m)
         return NULL;
@@ -4804,6 +5315,7 @@ expand_mmacro(Token * tline)
      * variables.
      */
     ll = (Line*)nasm_malloc(sizeof(Line));
+    ll->rep = NULL;
     ll->next = istk->expansion;
     ll->finishes = m;
     ll->first = NULL;
@@ -4826,6 +5338,7 @@ expand_mmacro(Token * tline)
         Token **tail;
 
         ll = (Line*)nasm_malloc(sizeof(Line));
+        ll->rep = NULL;
         ll->finishes = NULL;
         ll->next = istk->expansion;
         istk->expansion = ll;
@@ -4859,6 +5372,7 @@ expand_mmacro(Token * tline)
         else
         {
             ll = (Line*)nasm_malloc(sizeof(Line));
+            ll->rep = NULL;
             ll->finishes = NULL;
             ll->next = istk->expansion;
             istk->expansion = ll;
@@ -4879,9 +5393,9 @@ expand_mmacro(Token * tline)
 
 /*
  * Since preprocessor always operates only on the line that didn't
- * arrive yet, we should always use ERR_OFFBY1. Also since user
- * won't want to see same error twice (preprocessing is done once
- * per pass) we will want to show errors only during pass one.
+ * arrive yet, we should always use ERR_OFFBY1. Errors are marked
+ * ERR_PASS1 for the benefit of NASM's multi-pass error handler; in
+ * yasm the preprocessor only ever runs once over the source.
  */
 static void
 error(int severity, const char *fmt, ...)
@@ -4889,6 +5403,8 @@ error(int severity, const char *fmt, ...)
     va_list arg;
     char buff[1024];
 
+    smacro_volatile = TRUE;
+
     /* If we're in a dead branch of IF or something like it, ignore the error */
     if (istk && istk->conds && !emitting(istk->conds->state))
         return;
@@ -4908,11 +5424,18 @@ error(int severity, const char *fmt, ...)
         _error(severity | ERR_PASS1, "%s", buff);
 }
 
+/*
+ * Start preprocessing a source file. Unlike NASM, yasm runs the
+ * preprocessor over the source exactly once: it doesn't need to know
+ * the values of labels (forward references are left in the output as
+ * symbols, and the assembler resolves them after parsing), so there's
+ * no pass number and no second pass. pp_cleanup(0) must be called
+ * before preprocessing another file.
+ */
 static void
-pp_reset(FileID fid, int apass, efunc errfunc, evalfunc eval)
+pp_reset(FileID fid, efunc errfunc, evalfunc eval)
 {
-    int h;
-
+    assert(!istk && "preprocessor already running");
     _error = errfunc;
     cstk = NULL;
     istk = (Include*)nasm_malloc(sizeof(Include));
@@ -4930,20 +5453,19 @@ pp_reset(FileID fid, int apass, efunc errfunc, evalfunc eval)
     nasm_free(nasm_src_set_fname(nasm_strdup(istk->in->getBufferIdentifier())));
     nasm_src_set_linnum(0);
     istk->lineinc = 1;
+    prefetch_includes(fid, istk->in);
     defining = NULL;
     nested_mac_count = 0;
     nested_rep_count = 0;
-    for (h = 0; h < NHASH; h++)
-    {
-        mmacros[h] = NULL;
-        smacros[h] = NULL;
-    }
+    nasm_free(mmacros);
+    nasm_free(smacros);
+    init_macro_table(&mmacros, &mmacros_size, &mmacros_count);
+    init_macro_table(&smacros, &smacros_size, &smacros_count);
     unique = 0;
     if (tasm_compatible_mode) {
-        pp_extra_stdmac(tasm_compat_macros);
+        pp_static_stdmac(tasm_compat_macros);
     }
     evaluate = eval;
-    pass = apass;
     first_line = 1;
 }
 
@@ -4969,6 +5491,7 @@ poke_predef(Line *predef_lines)
             tail = &(*tail)->next;
         }
         l = (Line*)nasm_malloc(sizeof(Line));
+        l->rep = NULL;
         l->next = istk->expansion;
         l->first = head;
         l->finishes = FALSE;
@@ -4976,11 +5499,100 @@ poke_predef(Line *predef_lines)
     }
 }
 
+/*
+ * Copy a list of tokens, leaving out any that have lost their text
+ * (other than whitespace).
+ */
+static Token *
+copy_tlist(const Token *t)
+{
+    Token *head = NULL, **tail = &head, *tt;
+
+    for (; t; t = t->next)
+    {
+        if (t->text || t->type == TOK_WHITESPACE)
+        {
+            tt = *tail = new_Token(NULL, t->type, t->text, 0);
+            tail = &tt->next;
+        }
+    }
+    return head;
+}
+
+/*
+ * Set up the RepLines for a %rep block about to be repeated for the
+ * first time. They're in the same (reverse) order as the Lines.
+ */
+static void
+compile_rep(MMacro *m)
+{
+    Line *l;
+    Token *t;
+    RepLine *rl;
+    int n = 0;
+
+    for (l = m->expansion; l; l = l->next)
+        n++;
+    rl = m->replines = (RepLine*)nasm_malloc(n * sizeof(RepLine));
+    m->nreplines = n;
+
+    for (l = m->expansion; l; l = l->next, rl++)
+    {
+        rl->first = l->first;
+        rl->expansion = NULL;
+        rl->deps = 0;
+        rl->gen = 0;
+        rl->state = REPLINE_NEW;
+        for (t = l->first; t; t = t->next)
+        {
+            if (t->type == TOK_PREPROC_ID)
+            {
+                rl->state = REPLINE_VOLATILE;
+                break;
+            }
+        }
+    }
+}
+
+/*
+ * Get the tokens for one repetition of a %rep line. If the line is
+ * going straight to single-line macro expansion (we're not defining
+ * a macro or skipping lines) and the expansion cached last time is
+ * still good, return a copy of that and set *expanded.
+ */
+static Token *
+rep_line_tokens(RepLine *rl, int *expanded)
+{
+    unsigned long deps;
+    unsigned int i;
+
+    *expanded = FALSE;
+    if (rl->state != REPLINE_CACHED || defining ||
+        (istk->conds && !emitting(istk->conds->state)) ||
+        (istk->mstk && !istk->mstk->in_progress))
+        return copy_tlist(rl->first);
+
+    for (deps = rl->deps, i = 0; deps; deps >>= 1, i++)
+    {
+        if ((deps & 1) && smacro_slot_gen[i] > rl->gen)
+        {
+            free_tlist(rl->expansion);
+            rl->expansion = NULL;
+            rl->state = REPLINE_VOLATILE;
+            return copy_tlist(rl->first);
+        }
+    }
+    *expanded = TRUE;
+    return copy_tlist(rl->expansion);
+}
+
 static char *
 pp_getline(void)
 {
     char *line;
     Token *tline;
+    RepLine *rep;
+    int expanded;
 
     while (1)
     {
@@ -4989,6 +5601,8 @@ pp_getline(void)
          * buffer or from the input file.
          */
         tline = NULL;
+        rep = NULL;
+        expanded = FALSE;
 
         if (first_line)
         {
@@ -5021,26 +5635,19 @@ pp_getline(void)
                  * marker: we'd only have to generate another one
                  * if we did.
                  */
-                l->finishes->in_progress--;
-                for (l = l->finishes->expansion; l; l = l->next)
-                {
-                    Token *t, *tt, **tail;
+                MMacro *m = l->finishes;
+                int i;
 
+                m->in_progress--;
+                if (!m->replines && m->expansion)
+                    compile_rep(m);
+                for (i = 0; i < m->nreplines; i++)
+                {
                     ll = (Line*)nasm_malloc(sizeof(Line));
+                    ll->rep = &m->replines[i];
                     ll->next = istk->expansion;
                     ll->finishes = NULL;
                     ll->first = NULL;
-                    tail = &ll->first;
-
-                    for (t = l->first; t; t = t->next)
-                    {
-                        if (t->text || t->type == TOK_WHITESPACE)
-                        {
-                            tt = *tail = new_Token(NULL, t->type, t->text, 0);
-                            tail = &tt->next;
-                        }
-                    }
-
                     istk->expansion = ll;
                 }
             }
@@ -5094,16 +5701,16 @@ pp_getline(void)
 
             if (istk->expansion)
             {                   /* from a macro expansion */
-                char *p;
                 Line *l = istk->expansion;
                 if (istk->mstk)
                     istk->mstk->lineno++;
                 tline = l->first;
+                rep = l->rep;
                 istk->expansion = l->next;
                 nasm_free(l);
-                p = detoken(tline, FALSE);
-                //list->line(LIST_MACRO, p);
-                nasm_free(p);
+                if (rep)
+                    tline = rep_line_tokens(rep, &expanded);
+                //list->line(LIST_MACRO, detoken(tline, FALSE));
                 break;
             }
             line = read_line();
@@ -5124,6 +5731,7 @@ pp_getline(void)
                 /* only set line and file name if there's a next node */
                 if (i->next) 
                 {
+                    yasm::TraceEnd();
                     nasm_src_set_linnum(i->lineno);
                     nasm_free(nasm_src_set_fname(nasm_strdup(i->fname)));
                 }
@@ -5147,13 +5755,14 @@ pp_getline(void)
          * condition, in which case we don't want to meddle with
          * anything.
          */
-        if (!defining && !(istk->conds && !emitting(istk->conds->state)))
+        if (!expanded && !defining &&
+            !(istk->conds && !emitting(istk->conds->state)))
             tline = expand_mmac_params(tline);
 
         /*
          * Check the line to see if it's a preprocessor directive.
          */
-        if (do_directive(tline) == DIRECTIVE_FOUND)
+        if (!expanded && do_directive(tline) == DIRECTIVE_FOUND)
         {
             continue;
         }
@@ -5165,6 +5774,7 @@ pp_getline(void)
              * shove the tokenised line on to the macro definition.
              */
             Line *l = (Line*)nasm_malloc(sizeof(Line));
+            l->rep = NULL;
             l->next = defining->expansion;
             l->first = tline;
             l->finishes = FALSE;
@@ -5197,7 +5807,28 @@ pp_getline(void)
         }
         else
         {
-            tline = expand_smacro(tline);
+            if (rep && rep->state == REPLINE_NEW)
+            {
+                /*
+                 * First time through this %rep line: note what the
+                 * expansion depends on, and keep it if that's only
+                 * macro definitions.
+                 */
+                smacro_deps = 0;
+                smacro_volatile = FALSE;
+                tline = expand_smacro(tline);
+                if (smacro_volatile)
+                    rep->state = REPLINE_VOLATILE;
+                else
+                {
+                    rep->expansion = copy_tlist(tline);
+                    rep->deps = smacro_deps;
+                    rep->gen = smacro_gen;
+                    rep->state = REPLINE_CACHED;
+                }
+            }
+            else if (!expanded)
+                tline = expand_smacro(tline);
             if (!expand_mmacro(tline))
             {
                 /*
@@ -5237,7 +5868,7 @@ pp_cleanup(int pass_)
     }
     while (cstk)
         ctx_pop();
-    for (h = 0; h < NHASH; h++)
+    for (h = 0; h < (int)mmacros_size; h++)
     {
         while (mmacros[h])
         {
@@ -5245,6 +5876,9 @@ pp_cleanup(int pass_)
             mmacros[h] = mmacros[h]->next;
             free_mmacro(m);
         }
+    }
+    for (h = 0; h < (int)smacros_size; h++)
+    {
         while (smacros[h])
         {
             SMacro *s = smacros[h];
@@ -5254,6 +5888,12 @@ pp_cleanup(int pass_)
             nasm_free(s);
         }
     }
+    nasm_free(mmacros);
+    nasm_free(smacros);
+    mmacros = NULL;
+    smacros = NULL;
+    mmacros_size = mmacros_count = 0;
+    smacros_size = smacros_count = 0;
     while (istk)
     {
         Include *i = istk;
@@ -5265,6 +5905,8 @@ pp_cleanup(int pass_)
         ctx_pop();
     if (pass_ == 0)
         {
+                include_guards.clear();
+                prefetched_files.clear();
                 free_llist(builtindef);
                 free_llist(stddef);
                 free_llist(predef);
@@ -5275,6 +5917,7 @@ pp_cleanup(int pass_)
                 delete_Blocks();
                 blocks.next = NULL;
                 blocks.chunk = NULL;
+                blocks_tail = &blocks;
         }
 }
 
@@ -5289,6 +5932,7 @@ pp_pre_include(const char *fname)
     inc = new_Token(space, TOK_PREPROC_ID, "%include", 0);
 
     l = (Line*)nasm_malloc(sizeof(Line));
+    l->rep = NULL;
     l->next = predef;
     l->first = inc;
     l->finishes = FALSE;
@@ -5312,6 +5956,7 @@ pp_pre_define(char *definition)
         *equals = '=';
 
     l = (Line*)nasm_malloc(sizeof(Line));
+    l->rep = NULL;
     l->next = predef;
     l->first = def;
     l->finishes = FALSE;
@@ -5329,6 +5974,7 @@ pp_pre_undefine(char *definition)
     space->next = tokenise(definition);
 
     l = (Line*)nasm_malloc(sizeof(Line));
+    l->rep = NULL;
     l->next = predef;
     l->first = def;
     l->finishes = FALSE;
@@ -5352,6 +5998,7 @@ pp_builtin_define(char *definition)
         *equals = '=';
 
     l = (Line*)nasm_malloc(sizeof(Line));
+    l->rep = NULL;
     l->next = builtindef;
     l->first = def;
     l->finishes = FALSE;
@@ -5374,6 +6021,7 @@ pp_extra_stdmac(const char **macros)
         nasm_free(macro);
 
         l = (Line*)nasm_malloc(sizeof(Line));
+        l->rep = NULL;
         l->next = stddef;
         l->first = t;
         l->finishes = FALSE;
@@ -5381,6 +6029,97 @@ pp_extra_stdmac(const char **macros)
     }
 }
 
+/*
+ * Tokenised form of a static macro table.  Tokens are allocated from the
+ * block pool, which is released between runs, so the table is kept as
+ * plain (type, text) pairs and only copied into tokens on later runs.
+ */
+namespace {
+struct StdMacToken
+{
+    int type;
+    bool has_text;
+    std::string text;
+};
+typedef std::vector<StdMacToken> StdMacLine;
+struct StdMacTable
+{
+    const char **macros;
+    std::vector<StdMacLine> lines;
+};
+} // anonymous namespace
+
+static std::vector<StdMacTable> stdmac_tables;
+
+void
+pp_static_stdmac(const char **macros)
+{
+    std::vector<StdMacTable>::const_iterator table = stdmac_tables.begin();
+    while (table != stdmac_tables.end() && table->macros != macros)
+        ++table;
+    if (table == stdmac_tables.end())
+    {
+        /* First use: tokenise as usual, keeping a copy of the tokens */
+        const char **lp;
+        stdmac_tables.push_back(StdMacTable());
+        StdMacTable& newtable = stdmac_tables.back();
+        newtable.macros = macros;
+        for (lp=macros; *lp; lp++)
+        {
+            char *macro;
+            Token *t;
+            Line *l;
+
+            macro = nasm_strdup(*lp);
+            t = tokenise(macro);
+            nasm_free(macro);
+
+            newtable.lines.push_back(StdMacLine());
+            StdMacLine& line = newtable.lines.back();
+            for (Token *tt = t; tt; tt = tt->next)
+            {
+                StdMacToken tok;
+                tok.type = tt->type;
+                tok.has_text = (tt->text != NULL);
+                if (tok.has_text)
+                    tok.text = tt->text;
+                line.push_back(tok);
+            }
+
+            l = (Line*)nasm_malloc(sizeof(Line));
+            l->rep = NULL;
+            l->next = stddef;
+            l->first = t;
+            l->finishes = FALSE;
+            stddef = l;
+        }
+        return;
+    }
+
+    for (std::vector<StdMacLine>::const_iterator line = table->lines.begin(),
+         end = table->lines.end(); line != end; ++line)
+    {
+        Token *head = NULL, **tail = &head;
+        Line *l;
+
+        for (StdMacLine::const_iterator tok = line->begin(),
+             tokend = line->end(); tok != tokend; ++tok)
+        {
+            *tail = new_Token(NULL, tok->type,
+                              tok->has_text ? tok->text.c_str() : NULL,
+                              tok->text.size());
+            tail = &(*tail)->next;
+        }
+
+        l = (Line*)nasm_malloc(sizeof(Line));
+        l->rep = NULL;
+        l->next = stddef;
+        l->first = head;
+        l->finishes = FALSE;
+        stddef = l;
+    }
+}
+
 static void
 make_tok_num(Token * tok, const IntNum& val)
 {
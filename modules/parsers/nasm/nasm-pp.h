@@ -9,7 +9,7 @@
 #ifndef YASM_NASM_PREPROC_H
 #define YASM_NASM_PREPROC_H
 
-namespace yasm { class Preprocessor; }
+namespace yasm { class DiagnosticBuffer; class Preprocessor; }
 
 namespace nasm {
 
@@ -18,10 +18,21 @@ void pp_pre_define (char *);
 void pp_pre_undefine (char *);
 void pp_builtin_define (char *);
 void pp_extra_stdmac (const char **);
+/* As pp_extra_stdmac, for a table that doesn't change while the program
+ * runs; it is only tokenised the first time it is used. */
+void pp_static_stdmac (const char **);
 
 extern Preproc nasmpp;
 extern yasm::Preprocessor* yasm_preproc;
 
+/* While the parser runs alongside the preprocessor (on another thread),
+ * yasm_pp_sync is called to wait for the parser to be idle before the
+ * source manager, diagnostics, or symbols are used, and expression
+ * diagnostics are saved to yasm_pp_diags until it is safe to report them.
+ * Otherwise both are NULL. */
+extern void (*yasm_pp_sync)(void);
+extern yasm::DiagnosticBuffer* yasm_pp_diags;
+
 void nasm_preproc_add_dep(char *);
 
 } // namespace nasm
@@ -210,11 +210,11 @@ typedef yasm::Expr *(*evalfunc) (scanner sc, void *scprivate, struct tokenval *t
  */
 typedef struct {
     /*
-     * Called at the start of a pass; given a file name, the number
-     * of the pass, an error reporting function, an evaluator
-     * function, and a listing generator to talk to.
+     * Called once per source file, before any lines are fetched;
+     * given the file, an error reporting function and an evaluator
+     * function. There's only ever one pass over the source.
      */
-    void (*reset) (yasm::FileID, int, efunc, evalfunc);
+    void (*reset) (yasm::FileID, efunc, evalfunc);
 
     /*
      * Called to fetch a line of preprocessed source. The line
@@ -224,7 +224,8 @@ typedef struct {
     char *(*getline) (void);
 
     /*
-     * Called at the end of a pass.
+     * Called with 1 once all lines have been fetched, to report
+     * unterminated definitions, and then with 0 to free everything.
      */
     void (*cleanup) (int);
 } Preproc;
@@ -0,0 +1,17 @@
+; [yasm -f bin --branch-align=32]
+; Jumps and macro-fusible compare/jump pairs must not cross or end on a
+; 32-byte boundary.
+[bits 64]
+start:
+times 27 nop
+cmp eax, 203
+jne start
+times 22 nop
+jmp near start
+times 24 nop
+add eax, 36
+je start
+mov eax, 1
+jnz start
+times 18 nop
+jmp start
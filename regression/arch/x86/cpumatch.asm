@@ -0,0 +1,8 @@
+; [fail]
+; A form matched before a CPU change must be checked again after it.
+[bits 16]
+shl ax, 2
+[cpu 8086]
+shl ax, 2
+[cpu 186]
+shl ax, 2
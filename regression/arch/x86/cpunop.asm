@@ -0,0 +1,27 @@
+; Code alignment fill follows the CPU selected with the CPU directive.
+[bits 32]
+cpu 486
+ret                             ; out: c3
+align 8                         ; out: 8d b4 26 00 00 00 00
+cpu p6
+ret                             ; out: c3
+align 8                         ; out: 0f 1f 80 00 00 00 00
+cpu k8
+ret                             ; out: c3
+align 16                        ; out: 0f 1f 80 00 00 00 00 0f 1f 84 00 00 00 00 00
+cpu k6
+ret                             ; out: c3
+align 8                         ; out: 0f 1f 80 00 00 00 00
+cpu p6 basicnop
+ret                             ; out: c3
+align 8                         ; out: 8d b4 26 00 00 00 00
+cpu nehalem
+ret                             ; out: c3
+align 16                        ; out: 66 66 66 66 66 66 2e 0f 1f 84 00 00 00 00 00
+ret                             ; out: c3
+align 64
+; out: 66 66 66 66 66 66 2e 0f 1f 84 00 00 00 00 00
+; out: 66 66 66 66 66 66 2e 0f 1f 84 00 00 00 00 00
+; out: 66 66 66 66 66 66 2e 0f 1f 84 00 00 00 00 00
+; out: 66 66 66 66 66 66 2e 0f 1f 84 00 00 00 00 00
+; out: 0f 1f 00
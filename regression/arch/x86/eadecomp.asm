@@ -0,0 +1,14 @@
+; Memory operands whose base/index/scale is split out by the parser.
+[bits 64]
+mov eax, [rbx+rax*4+8]          ; out: 8b 44 83 08
+mov eax, [rax*2]                ; out: 8b 04 00
+mov eax, [nosplit rax*2]        ; out: 8b 04 45 00 00 00 00
+mov eax, [r12+r13*8-8]          ; out: 43 8b 44 ec f8
+mov eax, [rsp+rax]              ; out: 8b 04 04
+mov eax, [rax+rsp]              ; out: 8b 04 04
+mov eax, [rax*1]                ; out: 8b 00
+mov eax, [rax*3+5]              ; out: 8b 44 40 05
+mov eax, [4*rcx+rdx-(3*2)]      ; out: 8b 44 8a fa
+[bits 32]
+mov eax, [esp+ebp*1]            ; out: 8b 04 2c
+mov eax, [ebp*1]                ; out: 8b 45 00
@@ -0,0 +1,24 @@
+; [yasm -f bin --explain-relax]
+; The first jump is only out of range once the four jumps it crosses have
+; taken their long form; the report lists them.
+[bits 64]
+top:
+jz done
+jnz far0
+times 28 nop
+jnz far1
+times 28 nop
+jnz far2
+times 28 nop
+jnz far3
+times 28 nop
+done:
+times 40 nop
+far0:
+times 40 nop
+far1:
+times 40 nop
+far2:
+times 40 nop
+far3:
+jmp top
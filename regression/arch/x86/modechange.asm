@@ -0,0 +1,7 @@
+; [fail]
+bits 32
+pusha
+bits 64
+pusha
+bits 32
+pusha
@@ -0,0 +1,16 @@
+; [yasm -f bin -Ox]
+; Shorter equivalent instruction forms.
+[bits 64]
+mov rax, 5                      ; out: b8 05 00 00 00
+mov r9, 0xffffffff              ; out: 41 b9 ff ff ff ff
+mov rax, -1                     ; out: 48 c7 c0 ff ff ff ff
+mov rax, 0x100000000            ; out: 48 b8 00 00 00 00 01 00 00 00
+xor rax, rax                    ; out: 31 c0
+sub r10, r10                    ; out: 45 29 d2
+xor rax, rbx                    ; out: 48 31 d8
+and rax, 0x7f                   ; out: 83 e0 7f
+and rax, -16                    ; out: 48 83 e0 f0
+test rcx, 0x1000                ; out: f7 c1 00 10 00 00
+add rax, 5                      ; out: 48 83 c0 05
+mov rax, qword 5                ; out: 48 b8 05 00 00 00 00 00 00 00
+mov rax, strict 5               ; out: 48 c7 c0 05 00 00 00
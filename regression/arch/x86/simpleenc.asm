@@ -0,0 +1,26 @@
+; Register, immediate, and [base+disp] forms encoded directly as fixed bytes.
+[bits 64]
+mov rax, [rbx]          ; out: 48 8b 03
+mov rax, [rbp]          ; out: 48 8b 45 00
+mov rax, [r13]          ; out: 49 8b 45 00
+mov rax, [rsp]          ; out: 48 8b 04 24
+mov rax, [r12+8]        ; out: 49 8b 44 24 08
+mov ecx, [rbx+127]      ; out: 8b 4b 7f
+mov ecx, [rbx+128]      ; out: 8b 8b 80 00 00 00
+mov ecx, [rbx-128]      ; out: 8b 4b 80
+mov ecx, [rbx-129]      ; out: 8b 8b 7f ff ff ff
+mov [rsi+16], r9        ; out: 4c 89 4e 10
+add rax, 5              ; out: 48 83 c0 05
+add rax, 300            ; out: 48 05 2c 01 00 00
+add eax, -1             ; out: 83 c0 ff
+add cl, 1               ; out: 80 c1 01
+mov r10, 1              ; out: 49 c7 c2 01 00 00 00
+mov r10, -1             ; out: 49 c7 c2 ff ff ff ff
+mov r10, 0x100000000    ; out: 49 ba 00 00 00 00 01 00 00 00
+mov ax, 0x1234          ; out: 66 b8 34 12
+mov dh, cl              ; out: 88 ce
+[bits 32]
+mov eax, [ebp]          ; out: 8b 45 00
+mov eax, [esp+4]        ; out: 8b 44 24 04
+add ecx, edx            ; out: 01 d1
+and ebx, 0xff           ; out: 81 e3 ff 00 00 00
@@ -0,0 +1,19 @@
+; [yasm -f bin --size-report]
+; Sizes run from each label to the next; the alignment padding just before
+; a label is reported with it.  Instructions inside times aren't counted.
+start:
+	mov eax, 1
+	jmp far_away
+	align 16
+func:
+	push ebp
+	jz start
+	times 200 nop
+	jnz start
+	ret
+	align 16
+far_away:
+	jmp func
+	ret
+section .data align=4
+tbl: dd 1,2,3
@@ -0,0 +1,20 @@
+; [yasm -f bin --thread-jumps]
+; Jumps to unconditional jumps are retargeted to the final destination,
+; which lets the first two become short.  Jumps in a loop of jumps stay in
+; the loop, and jumps with an offset from the label are left alone.
+[bits 32]
+start:
+jmp one
+jz one
+back:
+ret
+times 200 nop
+one:
+jmp two
+two:
+jmp back
+loop1:
+jmp loop2
+loop2:
+jmp loop1
+jmp one+2
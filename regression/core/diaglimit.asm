@@ -0,0 +1,11 @@
+; [yasm -f bin --diag-repeat-limit=2]
+; Past two of a kind, diagnostics are only counted, then summarized.
+a
+b
+c
+resb 1
+d
+resb 1
+resb 1
+resb 1
+e
@@ -0,0 +1,7 @@
+; [yasm -f bin --fast-exit]
+; Output and diagnostics must be complete without the normal teardown.
+label:
+	db 3
+	dw label+1234h
+	times 3 db 5
+orphan
@@ -0,0 +1,6 @@
+# [ygas -64 --fast-exit]
+# Output must be complete without the normal teardown.
+.text
+f:
+	movl $1, %eax
+	ret
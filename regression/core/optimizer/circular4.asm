@@ -0,0 +1,12 @@
+; [fail]
+label1:
+times label4-label3+1 db 0
+label2:
+db 0
+label3:
+times label6-label5+1 db 0
+label4:
+db 0
+label5:
+times label2-label1+1 db 0
+label6:
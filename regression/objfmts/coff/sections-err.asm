@@ -0,0 +1,8 @@
+; [oformat coff] [fail]
+; Plain COFF has no bigobj format, so more than 65279 sections is an error.
+%assign i 0
+%rep 65300
+[section s %+ i]
+	db 0
+%assign i i+1
+%endrep
@@ -0,0 +1,23 @@
+# [oformat elf32]
+# general dynamic
+leal x@tlsgd(,%ebx,1), %eax	# must stay a SIB address
+call ___tls_get_addr@PLT
+# local dynamic
+leal x@tlsldm(%ebx), %eax
+call ___tls_get_addr@PLT
+movl x@dtpoff(%eax), %edx
+# initial exec
+movl x@gotntpoff(%ebx), %eax
+movl %gs:(%eax), %eax
+movl x@indntpoff, %ecx
+movl x@gottpoff(%ebx), %eax
+addl %gs:0, %eax
+# local exec
+movl %gs:0, %eax
+leal x@ntpoff(%eax), %eax
+movl %gs:x@ntpoff, %eax
+movl $x@tpoff, %edx
+.section .debug_info
+.long x@dtpoff
+.section .tdata,"awT",@progbits
+x: .long 0
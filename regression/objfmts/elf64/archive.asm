@@ -0,0 +1,10 @@
+; [yasm -f elf64] [input archive-a.inc] [outext a]
+; Multiple inputs with an output file named *.a give a GNU archive of the
+; objects, with a symbol index of the global and common symbols each one
+; defines; externals and local symbols are left out of the index.
+global second
+extern first
+
+[section .text]
+second:
+	jmp first
@@ -0,0 +1,17 @@
+# [ygas -64]
+# CFI register operands, with and without %, use DWARF register numbers.
+.text
+f:
+.cfi_startproc
+pushq %rbp
+.cfi_def_cfa_offset 16
+.cfi_offset %rbp, -16
+movq %rsp, %rbp
+.cfi_def_cfa_register rbp
+pushq %r12
+.cfi_offset r12, -24
+.cfi_offset %xmm1, -32
+.cfi_register %rip, %rax
+.cfi_offset %st(1), -40
+ret
+.cfi_endproc
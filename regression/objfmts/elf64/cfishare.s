@@ -0,0 +1,44 @@
+# [ygas -64]
+# FDEs with the same initial instructions share a CIE; others get their own.
+.text
+f1:
+.cfi_startproc
+push %rbp
+.cfi_def_cfa_offset 16
+.cfi_offset 6, -16
+pop %rbp
+.cfi_def_cfa 7, 8
+ret
+.cfi_endproc
+f2:
+.cfi_startproc
+.cfi_def_cfa_offset 16
+nop
+.cfi_def_cfa_offset 8
+ret
+.cfi_endproc
+f3:
+.cfi_startproc
+nop
+ret
+.cfi_endproc
+f4:
+.cfi_startproc
+.cfi_def_cfa_offset 16
+ret
+.cfi_endproc
+f5:
+.cfi_startproc
+.cfi_signal_frame
+ret
+.cfi_endproc
+f6:
+.cfi_startproc
+.cfi_escape 0x2e, 0x10
+ret
+.cfi_endproc
+f7:
+.cfi_startproc
+.cfi_signal_frame
+nop
+.cfi_endproc
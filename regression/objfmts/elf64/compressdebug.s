@@ -0,0 +1,7 @@
+# [ygas -64 --compress-debug-sections]
+.text
+nop
+.section .debug_str
+.rept 64
+.asciz "compress"
+.endr
@@ -0,0 +1,11 @@
+# [oformat elf64]
+call *foo@GOTPCREL(%rip)
+jmp *foo@GOTPCREL(%rip)
+movl foo@GOTPCREL(%rip), %eax
+movq foo@GOTPCREL(%rip), %rax
+movq foo@GOTPCREL(%rip), %r12
+testq %rax, foo@GOTPCREL(%rip)
+addq foo@GOTPCREL(%rip), %rcx
+cmpq foo@GOTPCREL(%rip), %rdx
+leaq foo@GOTPCREL(%rip), %rax
+movq foo@GOTPCREL+4(%rip), %rax
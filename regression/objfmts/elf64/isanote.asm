@@ -0,0 +1,15 @@
+; [yasm -f elf64 --report-isa --isa-note]
+; The CPU features used by each section are reported and recorded in a
+; .note.yasm.isa note section.  Sections without instructions are left out.
+bits 64
+section .text
+mov eax, 1
+paddd xmm0, xmm1
+vpaddd ymm0, ymm1, ymm2
+vaddps ymm0, ymm1, ymm2
+andn rax, rbx, rcx
+ret
+section .data
+dd 1
+section .init exec
+cpuid
@@ -0,0 +1,19 @@
+# [yasm -p gas -f elf64 -g dwarf2pass]
+.file 1 "a.c"
+.file 2 "b.h"
+.section .debug_info,"",@progbits
+.long 0
+.text
+f:
+.loc 1 2 3
+nop
+.loc 1 3 prologue_end
+nop
+.loc 2 40 5 basic_block
+nop
+.loc 2 41 discriminator 7 basic_block
+nop
+.loc 1 0x10 1 isa 1
+nop
+.loc 1 17 0 epilogue_begin
+ret
@@ -0,0 +1,16 @@
+# [ygas -64 --merge-sections]
+# Strings in .rodata.str1.1 are deduplicated; .rodata.str1.2 is left alone
+# because the distance between two of its labels is used.
+.section .rodata.str1.1,"aMS",@progbits,1
+.LC0: .string "abc"
+.LC1: .string "xy"
+.LC2: .string "abc"
+.LC3: .string "q"
+.section .rodata.str1.2,"aMS",@progbits,1
+.LC4: .string "abc"
+.LC5: .string "xy"
+.LC6: .string "abc"
+.LC7: .string "q"
+.data
+.quad .LC2
+.long .LC7-.LC5
@@ -0,0 +1,16 @@
+# [yasm -p gas -f elf64 --merge-sections -j4]
+# As mergediff.s, but with enough bytecodes that Object::Finalize() runs
+# in parallel jobs which all mark the same labels as differenced.
+.section .rodata.str1.1,"aMS",@progbits,1
+.LC0: .string "abc"
+.LC1: .string "abc"
+.section .rodata.str1.2,"aMS",@progbits,1
+.LC4: .string "abc"
+.LC5: .string "xy"
+.LC6: .string "abc"
+.LC7: .string "q"
+.text
+.rept 1200
+jmp 1f
+1: .byte .LC7-.LC5
+.endr
@@ -0,0 +1,24 @@
+; [yasm -f elf64 --merge] [input mergeobj-a.inc] [objdump -h -t -r]
+; Merges two inputs into one relocatable object: same-named sections are
+; concatenated, same-named local labels kept apart, the weak definition of
+; shared_weak is overridden by this file's, and references between the
+; files are resolved to the merged symbols.
+global b_func
+global shared_weak
+extern a_func
+common buf 16:8
+
+[section .text]
+b_func:
+	call a_func
+	lea rax, [rel local_data]
+	mov rax, [rel buf]
+	ret
+shared_weak:
+	mov eax, 1
+	ret
+
+[section .data]
+local_data:
+	dd 2
+	dq b_func
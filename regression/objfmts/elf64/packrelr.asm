@@ -0,0 +1,21 @@
+; [yasm -f elf64 --pack-relative-relocs]
+; Table entries against local labels are packed into .relr sections, one
+; per target section; the external reference and the debug-style
+; unallocated section keep regular relocations.
+extern ext
+section .text
+f0: ret
+f1: ret
+f2: ret
+section .rodata align=8
+tab: dq f0, f1, f2, f0, d0
+dq ext
+dd 0
+dq f1
+section .data align=8
+d0: dq 5
+dq tab
+times 70 dq f2
+dq tab+8
+section .notalloc noalloc align=8
+dq f1
@@ -0,0 +1,19 @@
+# [yasm -p gas -f elf64 -g dwarf5] [dwo]
+# With --split-dwarf-file, the object keeps a skeleton unit with the
+# addresses and line table, and names the .dwo file, which gets the
+# full unit in .debug_info.dwo and .debug_abbrev.dwo.
+	.text
+	.globl	func
+func:
+	pushq	%rbp
+	movq	%rsp, %rbp
+	call	helper
+	popq	%rbp
+	ret
+helper:
+	xorl	%eax, %eax
+	ret
+
+	.data
+value:
+	.long	1
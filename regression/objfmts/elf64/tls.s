@@ -0,0 +1,28 @@
+# [oformat elf64]
+# general dynamic
+.byte 0x66
+leaq x@tlsgd(%rip), %rdi
+.word 0x6666
+rex64
+call __tls_get_addr@PLT
+# local dynamic
+leaq x@tlsld(%rip), %rdi
+call __tls_get_addr@PLT
+movl x@dtpoff(%rax), %edx
+leaq x@dtpoff(%rax), %rcx
+# initial exec
+movq x@gottpoff(%rip), %rax
+movl %fs:(%rax), %eax
+addq x@gottpoff(%rip), %r8
+# local exec
+movq %fs:0, %rax
+leaq x@tpoff(%rax), %rax
+movl %fs:x@tpoff, %eax
+.section .debug_info
+.long x@dtpoff
+.quad x@dtpoff
+.data
+.quad x@tpoff
+.quad x@dtpoff
+.section .tdata,"awT",@progbits
+x: .long 0
@@ -0,0 +1,18 @@
+; [oformat elf64]
+; More than 0xff00 sections need extended section numbering: e_shnum and
+; e_shstrndx move to section header 0, and symbols in the later sections
+; get SHN_XINDEX with their index in .symtab_shndx.  The relocation
+; section of the last section also links to it by a large index.
+[section .text]
+global first
+first:	ret
+
+%assign i 0
+%rep 65300
+[section s %+ i]
+	db i & 0xff
+%assign i i+1
+%endrep
+
+global last
+last:	dd first
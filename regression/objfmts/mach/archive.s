@@ -0,0 +1,7 @@
+# [oformat macho64] [input archive-a.inc] [outext a]
+# Multiple Mach-O inputs with an output file named *.a give a BSD archive
+# with a __.SYMDEF SORTED symbol index.
+	.globl	_second
+	.section __TEXT,__text,regular,pure_instructions
+_second:
+	jmp	_first
@@ -0,0 +1,42 @@
+# [oformat macho64]
+# CFI procedures get __LD,__compact_unwind entries: an RBP frame with a
+# saved register, a frameless function with an immediate stack size, and
+# one using .cfi_remember_state, which keeps its __eh_frame FDE and gets a
+# DWARF-mode entry.
+	.section __TEXT,__text,regular,pure_instructions
+	.globl	_frame
+_frame:
+	.cfi_startproc
+	pushq	%rbp
+	.cfi_def_cfa_offset 16
+	.cfi_offset %rbp, -16
+	movq	%rsp, %rbp
+	.cfi_def_cfa_register %rbp
+	pushq	%rbx
+	.cfi_offset %rbx, -24
+	callq	_leaf
+	popq	%rbx
+	popq	%rbp
+	retq
+	.cfi_endproc
+
+	.globl	_leaf
+_leaf:
+	.cfi_startproc
+	subq	$24, %rsp
+	.cfi_def_cfa_offset 32
+	addq	$24, %rsp
+	retq
+	.cfi_endproc
+
+	.globl	_dwarf
+_dwarf:
+	.cfi_startproc
+	pushq	%rbp
+	.cfi_def_cfa_offset 16
+	.cfi_remember_state
+	popq	%rbp
+	.cfi_def_cfa_offset 8
+	retq
+	.cfi_restore_state
+	.cfi_endproc
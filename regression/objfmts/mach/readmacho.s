@@ -0,0 +1,21 @@
+# [oformat macho64] [objdump -h -t -r]
+# Read back sections, symbols and relocations of a Mach-O object.
+	.globl	_entry
+	.section __TEXT,__text,regular,pure_instructions
+_entry:
+	callq	_ext_func
+	leaq	_table(%rip), %rax
+	callq	_local_func
+	retq
+_local_func:
+	retq
+
+	.section __DATA,__data
+_table:
+	.quad	_entry
+	.quad	_ext_func
+	.long	_table - _entry
+
+	.section __DATA,__bss,zerofill
+_buf:
+	.space	64
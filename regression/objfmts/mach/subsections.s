@@ -0,0 +1,19 @@
+# [oformat macho64]
+# With .subsections_via_symbols, references to non-temporary symbols in
+# the same section keep a relocation whether local (_g) or global (_h);
+# temporary (L) labels are still resolved here.
+	.section __TEXT,__text,regular,pure_instructions
+	.globl _h
+_f:
+	call _g
+	call _h
+	call L_t
+	jmp _g
+	ret
+_g:
+	ret
+_h:
+	ret
+L_t:
+	ret
+	.subsections_via_symbols
@@ -0,0 +1,17 @@
+; [oformat win64]
+; More than 65279 sections switch to the bigobj format: a bigobj file
+; header, 20-byte symbols, and 32-bit section numbers for symbols and
+; section definition aux entries.
+[section .text]
+global first
+first:	ret
+
+%assign i 0
+%rep 65300
+[section s %+ i]
+	db i & 0xff
+%assign i i+1
+%endrep
+
+global last
+last:	dq first
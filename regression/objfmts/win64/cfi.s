@@ -0,0 +1,46 @@
+# [oformat win64]
+# CFI directives generate the same unwind info as [PROC_FRAME] directives.
+.text
+proc1:
+.cfi_startproc
+    push %rbp
+    .cfi_def_cfa_offset 16
+    .cfi_offset %rbp, -16
+    push %rbx
+    .cfi_adjust_cfa_offset 8
+    .cfi_rel_offset 3, 0
+    sub $40, %rsp
+    .cfi_adjust_cfa_offset 40
+    lea 32(%rsp), %rbp
+    .cfi_def_cfa %rbp, 32
+    mov %rsi, 8(%rsp)
+    .cfi_offset 4, -56
+    movdqa %xmm6, 16(%rsp)
+    .cfi_offset %xmm6, -48
+    mov %rdi, %rax
+    .cfi_remember_state
+    lea -32(%rbp), %rsp
+    pop %rbx
+    pop %rbp
+    .cfi_def_cfa %rsp, 8
+    ret
+    .cfi_restore_state
+    ret
+.cfi_endproc
+
+proc2:
+.cfi_startproc
+.cfi_personality 0, handler
+    push %rbx
+    .cfi_def_cfa_offset 16
+    .cfi_offset 3, -16
+    sub $8, %rsp
+    .cfi_def_cfa_offset 24
+    nop
+    add $8, %rsp
+    .cfi_def_cfa_offset 16
+    pop %rbx
+    ret
+.cfi_endproc
+handler:
+    ret
@@ -0,0 +1,17 @@
+# [yasm -p gas -f win64 -g dwarf2]
+# With a DWARF debug format, CFI directives generate .eh_frame rather than
+# unwind info (.xdata/.pdata).
+.text
+proc1:
+.cfi_startproc
+    push %rbx
+    .cfi_def_cfa_offset 16
+    .cfi_offset 3, -16
+    sub $8, %rsp
+    .cfi_def_cfa_offset 24
+    nop
+    add $8, %rsp
+    .cfi_def_cfa_offset 16
+    pop %rbx
+    ret
+.cfi_endproc
@@ -0,0 +1,23 @@
+; [yasm -f win64 -g cv8]
+; CodeView line tables for two code sections, label symbols, and the
+; object and assembler name records.
+[section .text]
+global func
+func:
+	push rbp
+	mov rbp, rsp
+	call helper
+	pop rbp
+	ret
+
+helper:
+	xor eax, eax
+	ret
+
+[section .text2 code]
+other:
+	mov eax, [rel value]
+	ret
+
+[section .data]
+value:	dd 42
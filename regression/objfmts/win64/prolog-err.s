@@ -0,0 +1,10 @@
+# [oformat win64] [fail]
+.text
+.proc_frame p1
+p1:
+    .rept 300
+    nop
+    .endr
+.endprolog
+    ret
+.endproc_frame
@@ -0,0 +1,20 @@
+; [oformat win64] [objdump -h -t -r]
+; Read back sections, symbols and relocations of a COFF object.
+extern ext_func
+global entry
+
+[section .text]
+entry:
+	call ext_func
+	lea rax, [rel table]
+	call local_func
+	ret
+local_func:
+	ret
+
+[section .data]
+table:	dq entry, ext_func
+	dd table
+
+[section .bss]
+buf:	resb 64
@@ -0,0 +1,49 @@
+# [oformat win64]
+.text
+.proc_frame proc1
+proc1:
+    push %rbp
+    .pushreg %rbp
+    push %rbx
+    .pushreg %rbx
+    sub $40, %rsp
+    .allocstack 40
+    sub $200, %rsp
+    .allocstack 200
+    sub $600000, %rsp
+    .allocstack 600000
+    lea 32(%rsp), %rbp
+    .setframe %rbp, 32
+    mov %rsi, 8(%rsp)
+    .savereg %rsi, 8
+    mov %rdi, 800000(%rsp)
+    .savereg %rdi, 800000
+    movdqa %xmm6, 16(%rsp)
+    .savexmm128 %xmm6, 16
+    movdqa %xmm7, 2000000(%rsp)
+    .savexmm128 %xmm7, 2000000
+    .allocstack BIG
+    .allocstack LATER
+    .pushframe
+    .pushframe code
+.endprolog
+    ret
+.endproc_frame
+
+.proc_frame proc2, handler
+proc2:
+    push %rbx
+    .pushreg %rbx
+    .rept 20
+    nop
+    .endr
+    jmp proc2
+    sub $8, %rsp
+    .allocstack 8
+.endprolog
+    ret
+.endproc_frame
+handler:
+    ret
+BIG = 4096
+LATER = 64
@@ -0,0 +1,5 @@
+# string data unescaped in place, with and without escapes
+.ascii "plain", ""
+.asciz "", "tab\there", "oct\101\0\377", "hex\x41\x4142q", "quote\"back\\"
+.string "a long string with no escapes at all, well over sixty-four characters long"
+.asciz "a long string with an escape at the very end, over sixty-four chars\n"
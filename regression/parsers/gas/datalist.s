@@ -0,0 +1,7 @@
+# runs of plain literals mixed with expressions
+.byte 1, 0x2, 03, 0b100, -1, 256+5, 0x1ff, -0x80, 2*3, 7
+.short 0x1234, -2, 1+1, 65537
+.long 0xdeadbeef, 1f, -0x7fffffff
+1:
+.quad 18446744073709551615, -1, 0x0123456789abcdef
+.octa 1, -1
@@ -0,0 +1,7 @@
+# single and double precision literals, including values needing the
+# slow path (long significands, subnormals, overflow)
+.float 0.0, 1.5, .25, 0.1, 3.4028235e38, 1e-38, 16777217.0
+.float 1.00000000000000000000001, 1e-45
+.double 0.1, 2.2250738585072014e-308, 9007199254740993, 1e22, 1e23
+.double 78375562056498e202, 123456789012345678901.5, 4.9e-324
+.tfloat 0.1
@@ -0,0 +1,8 @@
+# integer literals around the 64-bit fast path limits
+.quad 12345678, 123456789, 1234567812345678, 9223372036854775807
+.quad 9223372036854775808, 18446744073709551615, 0000000000000000000000042
+.quad 0x0, 0xffffffffffffffff, 0xFEDCBA9876543210, 0x00000000000000000001
+.quad 0777777777777777777777, 01777777777777777777777
+.quad 0b1111111111111111111111111111111111111111111111111111111111111111
+.quad 99999999999999999999 - 99999999999999999998
+.quad 0x10000000000000000 >> 4
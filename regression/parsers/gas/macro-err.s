@@ -0,0 +1,22 @@
+# [fail]
+.endm
+.macro a x:req
+.byte \x
+.endm
+.macro a
+.byte 1
+.endm
+a
+a 1 2
+a y=3
+.macro b x:foo
+.endm
+.macro c x, x
+.endm
+.purgem zz
+.macro inf
+inf
+.endm
+inf
+.macro unterminated
+.byte 1
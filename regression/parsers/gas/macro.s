@@ -0,0 +1,66 @@
+# recursion and default values
+.macro sum from=0, to=3
+.long \from
+.if \to-\from
+sum (\from+1),\to
+.endif
+.endm
+sum
+# pasting with \()
+.macro lbl name, n
+\name\()_\n: .byte \n
+.endm
+lbl foo 7
+lbl bar, 8
+.long foo_7, bar_8
+# required, vararg and keyword arguments
+.macro op insn, reg:req, rest:vararg
+\insn %\reg, %\reg
+.byte \rest
+.endm
+op xorl eax, 1, 2, 3
+op insn=movl reg=ebx 4
+# blank arguments, redefinition after .purgem
+.macro opt
+.endm
+opt
+.purgem opt
+.macro OPT a
+.ifb \a
+.byte 0xee
+.else
+.byte \a
+.endif
+.endm
+opt
+Opt 5
+# \@ in labels and strings
+.macro loop_to reg, count=3
+    movl $\count, %\reg
+.Lloop\@:
+    dec %\reg
+    jnz .Lloop\@
+.endm
+loop_to ecx
+loop_to reg=edx, count=5
+.macro str name
+.ascii "\name-\@\\"
+.endm
+str hello
+# nested definitions and .rept
+.macro outer n
+.macro inner_\n
+.byte \n
+.endm
+.endm
+outer 9
+inner_9
+.rept 2
+OPT 4
+.endr
+.macro r
+.rept 2
+.byte 6
+.endr
+.endm
+r
@@ -0,0 +1,14 @@
+.rept 3
+.byte 1
+.rept 2
+.byte 2
+.endr
+.endr
+.rept 0
+.byte 9
+.endr
+.rept 5
+.endr
+.rept 1
+.byte 3
+.endr
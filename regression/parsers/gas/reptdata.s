@@ -0,0 +1,28 @@
+.rept 4
+.byte 1, 2
+.word 0x1f ; .long 3
+.ascii "ab"
+.quad -1
+.fill 2, 2, 0x55
+.zero 3
+.float 1.5
+.endr
+y:
+.rept 3
+.long y
+.endr
+.rept 2
+.long .
+.endr
+z: .rept 2
+.byte 9
+1: .byte 8
+.endr
+.rept 3
+.endr
+.rept 2
+.long 1b
+.endr
+.rept 3
+.byte 2
+.endr
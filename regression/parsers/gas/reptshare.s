@@ -0,0 +1,25 @@
+# shared bodies: fixed macros, nested .rept entered repeatedly
+.macro pad
+nop
+.byte 1
+.endm
+.macro inner n
+.rept \n
+pad
+.endr
+.endm
+.rept 3
+.rept 2
+pad
+.rept 2
+.byte 7
+.endr
+.endr
+inner 2
+inner 1
+.endr
+.purgem pad
+.macro pad
+.byte 9
+.endm
+pad
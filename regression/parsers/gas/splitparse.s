@@ -0,0 +1,1217 @@
+# [yasm -p gas -f elf64 -j4 --split-parse]
+# Sections are switched often enough that the source is split into
+# pieces parsed on separate threads; symbols are referenced across
+# pieces, both before and after their definitions.  piecetest.py checks
+# from a trace that the source really is split.
+	.file	"splitparse.c"
+	.text
+	.comm	shared,64,32
+	.section	.rodata.str1.1,"aMS",@progbits,1
+.LC0:
+	.string	"start"
+	.section	.text.unlikely,"ax",@progbits
+cold0:
+	ud2
+	.text
+	.section	.rodata.str1.1
+.LC1:
+	.string	"func0"
+	.text
+	.p2align 4
+	.globl	func0
+	.type	func0, @function
+func0:
+	pushq	%rbx
+	movl	$0, %ebx
+	leaq	.LC1(%rip), %rdi
+	movq	counter13(%rip), %rax
+	addq	%rax, shared(%rip)
+	call	func5
+	testl	%ebx, %ebx
+	je	.L0
+	call	puts
+	jmp	cold0
+.L0:
+	popq	%rbx
+	ret
+	.size	func0, .-func0
+	.data
+	.align 8
+	.type	counter0, @object
+	.size	counter0, 8
+counter0:
+	.quad	func3
+	.section	.text.unlikely
+	jmp	func0
+	.section	.rodata.str1.1
+.LC2:
+	.string	"func1"
+	.text
+	.p2align 4
+	.globl	func1
+	.type	func1, @function
+func1:
+	pushq	%rbx
+	movl	$7, %ebx
+	leaq	.LC2(%rip), %rdi
+	movq	counter14(%rip), %rax
+	addq	%rax, shared(%rip)
+	call	func16
+	testl	%ebx, %ebx
+	je	.L1
+	call	puts
+	jmp	cold0
+.L1:
+	popq	%rbx
+	ret
+	.size	func1, .-func1
+	.data
+	.align 8
+	.type	counter1, @object
+	.size	counter1, 8
+counter1:
+	.quad	func4
+	.section	.text.unlikely
+	jmp	func1
+	.section	.rodata.str1.1
+.LC3:
+	.string	"func2"
+	.text
+	.p2align 4
+	.globl	func2
+	.type	func2, @function
+func2:
+	pushq	%rbx
+	movl	$14, %ebx
+	leaq	.LC3(%rip), %rdi
+	movq	counter15(%rip), %rax
+	addq	%rax, shared(%rip)
+	call	func27
+	testl	%ebx, %ebx
+	je	.L2
+	call	puts
+	jmp	cold0
+.L2:
+	popq	%rbx
+	ret
+	.size	func2, .-func2
+	.data
+	.align 8
+	.type	counter2, @object
+	.size	counter2, 8
+counter2:
+	.quad	func5
+	.section	.text.unlikely
+	jmp	func2
+	.section	.rodata.str1.1
+.LC4:
+	.string	"func3"
+	.text
+	.p2align 4
+	.globl	func3
+	.type	func3, @function
+func3:
+	pushq	%rbx
+	movl	$21, %ebx
+	leaq	.LC4(%rip), %rdi
+	movq	counter16(%rip), %rax
+	addq	%rax, shared(%rip)
+	call	func38
+	testl	%ebx, %ebx
+	je	.L3
+	call	puts
+	jmp	cold0
+.L3:
+	popq	%rbx
+	ret
+	.size	func3, .-func3
+	.data
+	.align 8
+	.type	counter3, @object
+	.size	counter3, 8
+counter3:
+	.quad	func6
+	.section	.text.unlikely
+	jmp	func3
+	.section	.rodata.str1.1
+.LC5:
+	.string	"func4"
+	.text
+	.p2align 4
+	.globl	func4
+	.type	func4, @function
+func4:
+	pushq	%rbx
+	movl	$28, %ebx
+	leaq	.LC5(%rip), %rdi
+	movq	counter17(%rip), %rax
+	addq	%rax, shared(%rip)
+	call	func9
+	testl	%ebx, %ebx
+	je	.L4
+	call	puts
+	jmp	cold0
+.L4:
+	popq	%rbx
+	ret
+	.size	func4, .-func4
+	.data
+	.align 8
+	.type	counter4, @object
+	.size	counter4, 8
+counter4:
+	.quad	func7
+	.section	.text.unlikely
+	jmp	func4
+	.section	.rodata.str1.1
+.LC6:
+	.string	"func5"
+	.text
+	.p2align 4
+	.globl	func5
+	.type	func5, @function
+func5:
+	pushq	%rbx
+	movl	$35, %ebx
+	leaq	.LC6(%rip), %rdi
+	movq	counter18(%rip), %rax
+	addq	%rax, shared(%rip)
+	call	func20
+	testl	%ebx, %ebx
+	je	.L5
+	call	puts
+	jmp	cold0
+.L5:
+	popq	%rbx
+	ret
+	.size	func5, .-func5
+	.data
+	.align 8
+	.type	counter5, @object
+	.size	counter5, 8
+counter5:
+	.quad	func8
+	.section	.text.unlikely
+	jmp	func5
+	.section	.rodata.str1.1
+.LC7:
+	.string	"func6"
+	.text
+	.p2align 4
+	.globl	func6
+	.type	func6, @function
+func6:
+	pushq	%rbx
+	movl	$42, %ebx
+	leaq	.LC7(%rip), %rdi
+	movq	counter19(%rip), %rax
+	addq	%rax, shared(%rip)
+	call	func31
+	testl	%ebx, %ebx
+	je	.L6
+	call	puts
+	jmp	cold0
+.L6:
+	popq	%rbx
+	ret
+	.size	func6, .-func6
+	.data
+	.align 8
+	.type	counter6, @object
+	.size	counter6, 8
+counter6:
+	.quad	func9
+	.section	.text.unlikely
+	jmp	func6
+	.section	.rodata.str1.1
+.LC8:
+	.string	"func7"
+	.text
+	.p2align 4
+	.globl	func7
+	.type	func7, @function
+func7:
+	pushq	%rbx
+	movl	$49, %ebx
+	leaq	.LC8(%rip), %rdi
+	movq	counter20(%rip), %rax
+	addq	%rax, shared(%rip)
+	call	func2
+	testl	%ebx, %ebx
+	je	.L7
+	call	puts
+	jmp	cold0
+.L7:
+	popq	%rbx
+	ret
+	.size	func7, .-func7
+	.data
+	.align 8
+	.type	counter7, @object
+	.size	counter7, 8
+counter7:
+	.quad	func10
+	.section	.text.unlikely
+	jmp	func7
+	.section	.rodata.str1.1
+.LC9:
+	.string	"func8"
+	.text
+	.p2align 4
+	.globl	func8
+	.type	func8, @function
+func8:
+	pushq	%rbx
+	movl	$56, %ebx
+	leaq	.LC9(%rip), %rdi
+	movq	counter21(%rip), %rax
+	addq	%rax, shared(%rip)
+	call	func13
+	testl	%ebx, %ebx
+	je	.L8
+	call	puts
+	jmp	cold0
+.L8:
+	popq	%rbx
+	ret
+	.size	func8, .-func8
+	.data
+	.align 8
+	.type	counter8, @object
+	.size	counter8, 8
+counter8:
+	.quad	func11
+	.section	.text.unlikely
+	jmp	func8
+	.section	.rodata.str1.1
+.LC10:
+	.string	"func9"
+	.text
+	.p2align 4
+	.globl	func9
+	.type	func9, @function
+func9:
+	pushq	%rbx
+	movl	$63, %ebx
+	leaq	.LC10(%rip), %rdi
+	movq	counter22(%rip), %rax
+	addq	%rax, shared(%rip)
+	call	func24
+	testl	%ebx, %ebx
+	je	.L9
+	call	puts
+	jmp	cold0
+.L9:
+	popq	%rbx
+	ret
+	.size	func9, .-func9
+	.data
+	.align 8
+	.type	counter9, @object
+	.size	counter9, 8
+counter9:
+	.quad	func12
+	.section	.text.unlikely
+	jmp	func9
+	.section	.rodata.str1.1
+.LC11:
+	.string	"func10"
+	.text
+	.p2align 4
+	.globl	func10
+	.type	func10, @function
+func10:
+	pushq	%rbx
+	movl	$70, %ebx
+	leaq	.LC11(%rip), %rdi
+	movq	counter23(%rip), %rax
+	addq	%rax, shared(%rip)
+	call	func35
+	testl	%ebx, %ebx
+	je	.L10
+	call	puts
+	jmp	cold0
+.L10:
+	popq	%rbx
+	ret
+	.size	func10, .-func10
+	.data
+	.align 8
+	.type	counter10, @object
+	.size	counter10, 8
+counter10:
+	.quad	func13
+	.section	.text.unlikely
+	jmp	func10
+	.section	.rodata.str1.1
+.LC12:
+	.string	"func11"
+	.text
+	.p2align 4
+	.globl	func11
+	.type	func11, @function
+func11:
+	pushq	%rbx
+	movl	$77, %ebx
+	leaq	.LC12(%rip), %rdi
+	movq	counter24(%rip), %rax
+	addq	%rax, shared(%rip)
+	call	func6
+	testl	%ebx, %ebx
+	je	.L11
+	call	puts
+	jmp	cold0
+.L11:
+	popq	%rbx
+	ret
+	.size	func11, .-func11
+	.data
+	.align 8
+	.type	counter11, @object
+	.size	counter11, 8
+counter11:
+	.quad	func14
+	.section	.text.unlikely
+	jmp	func11
+	.section	.rodata.str1.1
+.LC13:
+	.string	"func12"
+	.text
+	.p2align 4
+	.globl	func12
+	.type	func12, @function
+func12:
+	pushq	%rbx
+	movl	$84, %ebx
+	leaq	.LC13(%rip), %rdi
+	movq	counter25(%rip), %rax
+	addq	%rax, shared(%rip)
+	call	func17
+	testl	%ebx, %ebx
+	je	.L12
+	call	puts
+	jmp	cold0
+.L12:
+	popq	%rbx
+	ret
+	.size	func12, .-func12
+	.data
+	.align 8
+	.type	counter12, @object
+	.size	counter12, 8
+counter12:
+	.quad	func15
+	.section	.text.unlikely
+	jmp	func12
+	.section	.rodata.str1.1
+.LC14:
+	.string	"func13"
+	.text
+	.p2align 4
+	.globl	func13
+	.type	func13, @function
+func13:
+	pushq	%rbx
+	movl	$91, %ebx
+	leaq	.LC14(%rip), %rdi
+	movq	counter26(%rip), %rax
+	addq	%rax, shared(%rip)
+	call	func28
+	testl	%ebx, %ebx
+	je	.L13
+	call	puts
+	jmp	cold0
+.L13:
+	popq	%rbx
+	ret
+	.size	func13, .-func13
+	.data
+	.align 8
+	.type	counter13, @object
+	.size	counter13, 8
+counter13:
+	.quad	func16
+	.section	.text.unlikely
+	jmp	func13
+	.section	.rodata.str1.1
+.LC15:
+	.string	"func14"
+	.text
+	.p2align 4
+	.globl	func14
+	.type	func14, @function
+func14:
+	pushq	%rbx
+	movl	$98, %ebx
+	leaq	.LC15(%rip), %rdi
+	movq	counter27(%rip), %rax
+	addq	%rax, shared(%rip)
+	call	func39
+	testl	%ebx, %ebx
+	je	.L14
+	call	puts
+	jmp	cold0
+.L14:
+	popq	%rbx
+	ret
+	.size	func14, .-func14
+	.data
+	.align 8
+	.type	counter14, @object
+	.size	counter14, 8
+counter14:
+	.quad	func17
+	.section	.text.unlikely
+	jmp	func14
+	.section	.rodata.str1.1
+.LC16:
+	.string	"func15"
+	.text
+	.p2align 4
+	.globl	func15
+	.type	func15, @function
+func15:
+	pushq	%rbx
+	movl	$105, %ebx
+	leaq	.LC16(%rip), %rdi
+	movq	counter28(%rip), %rax
+	addq	%rax, shared(%rip)
+	call	func10
+	testl	%ebx, %ebx
+	je	.L15
+	call	puts
+	jmp	cold0
+.L15:
+	popq	%rbx
+	ret
+	.size	func15, .-func15
+	.data
+	.align 8
+	.type	counter15, @object
+	.size	counter15, 8
+counter15:
+	.quad	func18
+	.section	.text.unlikely
+	jmp	func15
+	.section	.rodata.str1.1
+.LC17:
+	.string	"func16"
+	.text
+	.p2align 4
+	.globl	func16
+	.type	func16, @function
+func16:
+	pushq	%rbx
+	movl	$112, %ebx
+	leaq	.LC17(%rip), %rdi
+	movq	counter29(%rip), %rax
+	addq	%rax, shared(%rip)
+	call	func21
+	testl	%ebx, %ebx
+	je	.L16
+	call	puts
+	jmp	cold0
+.L16:
+	popq	%rbx
+	ret
+	.size	func16, .-func16
+	.data
+	.align 8
+	.type	counter16, @object
+	.size	counter16, 8
+counter16:
+	.quad	func19
+	.section	.text.unlikely
+	jmp	func16
+	.section	.rodata.str1.1
+.LC18:
+	.string	"func17"
+	.text
+	.p2align 4
+	.globl	func17
+	.type	func17, @function
+func17:
+	pushq	%rbx
+	movl	$119, %ebx
+	leaq	.LC18(%rip), %rdi
+	movq	counter30(%rip), %rax
+	addq	%rax, shared(%rip)
+	call	func32
+	testl	%ebx, %ebx
+	je	.L17
+	call	puts
+	jmp	cold0
+.L17:
+	popq	%rbx
+	ret
+	.size	func17, .-func17
+	.data
+	.align 8
+	.type	counter17, @object
+	.size	counter17, 8
+counter17:
+	.quad	func20
+	.section	.text.unlikely
+	jmp	func17
+	.section	.rodata.str1.1
+.LC19:
+	.string	"func18"
+	.text
+	.p2align 4
+	.globl	func18
+	.type	func18, @function
+func18:
+	pushq	%rbx
+	movl	$126, %ebx
+	leaq	.LC19(%rip), %rdi
+	movq	counter31(%rip), %rax
+	addq	%rax, shared(%rip)
+	call	func3
+	testl	%ebx, %ebx
+	je	.L18
+	call	puts
+	jmp	cold0
+.L18:
+	popq	%rbx
+	ret
+	.size	func18, .-func18
+	.data
+	.align 8
+	.type	counter18, @object
+	.size	counter18, 8
+counter18:
+	.quad	func21
+	.section	.text.unlikely
+	jmp	func18
+	.section	.rodata.str1.1
+.LC20:
+	.string	"func19"
+	.text
+	.p2align 4
+	.globl	func19
+	.type	func19, @function
+func19:
+	pushq	%rbx
+	movl	$133, %ebx
+	leaq	.LC20(%rip), %rdi
+	movq	counter32(%rip), %rax
+	addq	%rax, shared(%rip)
+	call	func14
+	testl	%ebx, %ebx
+	je	.L19
+	call	puts
+	jmp	cold0
+.L19:
+	popq	%rbx
+	ret
+	.size	func19, .-func19
+	.data
+	.align 8
+	.type	counter19, @object
+	.size	counter19, 8
+counter19:
+	.quad	func22
+	.section	.text.unlikely
+	jmp	func19
+	.section	.rodata.str1.1
+.LC21:
+	.string	"func20"
+	.text
+	.p2align 4
+	.globl	func20
+	.type	func20, @function
+func20:
+	pushq	%rbx
+	movl	$140, %ebx
+	leaq	.LC21(%rip), %rdi
+	movq	counter33(%rip), %rax
+	addq	%rax, shared(%rip)
+	call	func25
+	testl	%ebx, %ebx
+	je	.L20
+	call	puts
+	jmp	cold0
+.L20:
+	popq	%rbx
+	ret
+	.size	func20, .-func20
+	.data
+	.align 8
+	.type	counter20, @object
+	.size	counter20, 8
+counter20:
+	.quad	func23
+	.section	.text.unlikely
+	jmp	func20
+	.section	.rodata.str1.1
+.LC22:
+	.string	"func21"
+	.text
+	.p2align 4
+	.globl	func21
+	.type	func21, @function
+func21:
+	pushq	%rbx
+	movl	$147, %ebx
+	leaq	.LC22(%rip), %rdi
+	movq	counter34(%rip), %rax
+	addq	%rax, shared(%rip)
+	call	func36
+	testl	%ebx, %ebx
+	je	.L21
+	call	puts
+	jmp	cold0
+.L21:
+	popq	%rbx
+	ret
+	.size	func21, .-func21
+	.data
+	.align 8
+	.type	counter21, @object
+	.size	counter21, 8
+counter21:
+	.quad	func24
+	.section	.text.unlikely
+	jmp	func21
+	.section	.rodata.str1.1
+.LC23:
+	.string	"func22"
+	.text
+	.p2align 4
+	.globl	func22
+	.type	func22, @function
+func22:
+	pushq	%rbx
+	movl	$154, %ebx
+	leaq	.LC23(%rip), %rdi
+	movq	counter35(%rip), %rax
+	addq	%rax, shared(%rip)
+	call	func7
+	testl	%ebx, %ebx
+	je	.L22
+	call	puts
+	jmp	cold0
+.L22:
+	popq	%rbx
+	ret
+	.size	func22, .-func22
+	.data
+	.align 8
+	.type	counter22, @object
+	.size	counter22, 8
+counter22:
+	.quad	func25
+	.section	.text.unlikely
+	jmp	func22
+	.section	.rodata.str1.1
+.LC24:
+	.string	"func23"
+	.text
+	.p2align 4
+	.globl	func23
+	.type	func23, @function
+func23:
+	pushq	%rbx
+	movl	$161, %ebx
+	leaq	.LC24(%rip), %rdi
+	movq	counter36(%rip), %rax
+	addq	%rax, shared(%rip)
+	call	func18
+	testl	%ebx, %ebx
+	je	.L23
+	call	puts
+	jmp	cold0
+.L23:
+	popq	%rbx
+	ret
+	.size	func23, .-func23
+	.data
+	.align 8
+	.type	counter23, @object
+	.size	counter23, 8
+counter23:
+	.quad	func26
+	.section	.text.unlikely
+	jmp	func23
+	.section	.rodata.str1.1
+.LC25:
+	.string	"func24"
+	.text
+	.p2align 4
+	.globl	func24
+	.type	func24, @function
+func24:
+	pushq	%rbx
+	movl	$168, %ebx
+	leaq	.LC25(%rip), %rdi
+	movq	counter37(%rip), %rax
+	addq	%rax, shared(%rip)
+	call	func29
+	testl	%ebx, %ebx
+	je	.L24
+	call	puts
+	jmp	cold0
+.L24:
+	popq	%rbx
+	ret
+	.size	func24, .-func24
+	.data
+	.align 8
+	.type	counter24, @object
+	.size	counter24, 8
+counter24:
+	.quad	func27
+	.section	.text.unlikely
+	jmp	func24
+	.section	.rodata.str1.1
+.LC26:
+	.string	"func25"
+	.text
+	.p2align 4
+	.globl	func25
+	.type	func25, @function
+func25:
+	pushq	%rbx
+	movl	$175, %ebx
+	leaq	.LC26(%rip), %rdi
+	movq	counter38(%rip), %rax
+	addq	%rax, shared(%rip)
+	call	func0
+	testl	%ebx, %ebx
+	je	.L25
+	call	puts
+	jmp	cold0
+.L25:
+	popq	%rbx
+	ret
+	.size	func25, .-func25
+	.data
+	.align 8
+	.type	counter25, @object
+	.size	counter25, 8
+counter25:
+	.quad	func28
+	.section	.text.unlikely
+	jmp	func25
+	.section	.rodata.str1.1
+.LC27:
+	.string	"func26"
+	.text
+	.p2align 4
+	.globl	func26
+	.type	func26, @function
+func26:
+	pushq	%rbx
+	movl	$182, %ebx
+	leaq	.LC27(%rip), %rdi
+	movq	counter39(%rip), %rax
+	addq	%rax, shared(%rip)
+	call	func11
+	testl	%ebx, %ebx
+	je	.L26
+	call	puts
+	jmp	cold0
+.L26:
+	popq	%rbx
+	ret
+	.size	func26, .-func26
+	.data
+	.align 8
+	.type	counter26, @object
+	.size	counter26, 8
+counter26:
+	.quad	func29
+	.section	.text.unlikely
+	jmp	func26
+	.section	.rodata.str1.1
+.LC28:
+	.string	"func27"
+	.text
+	.p2align 4
+	.globl	func27
+	.type	func27, @function
+func27:
+	pushq	%rbx
+	movl	$189, %ebx
+	leaq	.LC28(%rip), %rdi
+	movq	counter0(%rip), %rax
+	addq	%rax, shared(%rip)
+	call	func22
+	testl	%ebx, %ebx
+	je	.L27
+	call	puts
+	jmp	cold0
+.L27:
+	popq	%rbx
+	ret
+	.size	func27, .-func27
+	.data
+	.align 8
+	.type	counter27, @object
+	.size	counter27, 8
+counter27:
+	.quad	func30
+	.section	.text.unlikely
+	jmp	func27
+	.section	.rodata.str1.1
+.LC29:
+	.string	"func28"
+	.text
+	.p2align 4
+	.globl	func28
+	.type	func28, @function
+func28:
+	pushq	%rbx
+	movl	$196, %ebx
+	leaq	.LC29(%rip), %rdi
+	movq	counter1(%rip), %rax
+	addq	%rax, shared(%rip)
+	call	func33
+	testl	%ebx, %ebx
+	je	.L28
+	call	puts
+	jmp	cold0
+.L28:
+	popq	%rbx
+	ret
+	.size	func28, .-func28
+	.data
+	.align 8
+	.type	counter28, @object
+	.size	counter28, 8
+counter28:
+	.quad	func31
+	.section	.text.unlikely
+	jmp	func28
+	.section	.rodata.str1.1
+.LC30:
+	.string	"func29"
+	.text
+	.p2align 4
+	.globl	func29
+	.type	func29, @function
+func29:
+	pushq	%rbx
+	movl	$203, %ebx
+	leaq	.LC30(%rip), %rdi
+	movq	counter2(%rip), %rax
+	addq	%rax, shared(%rip)
+	call	func4
+	testl	%ebx, %ebx
+	je	.L29
+	call	puts
+	jmp	cold0
+.L29:
+	popq	%rbx
+	ret
+	.size	func29, .-func29
+	.data
+	.align 8
+	.type	counter29, @object
+	.size	counter29, 8
+counter29:
+	.quad	func32
+	.section	.text.unlikely
+	jmp	func29
+	.section	.rodata.str1.1
+.LC31:
+	.string	"func30"
+	.text
+	.p2align 4
+	.globl	func30
+	.type	func30, @function
+func30:
+	pushq	%rbx
+	movl	$210, %ebx
+	leaq	.LC31(%rip), %rdi
+	movq	counter3(%rip), %rax
+	addq	%rax, shared(%rip)
+	call	func15
+	testl	%ebx, %ebx
+	je	.L30
+	call	puts
+	jmp	cold0
+.L30:
+	popq	%rbx
+	ret
+	.size	func30, .-func30
+	.data
+	.align 8
+	.type	counter30, @object
+	.size	counter30, 8
+counter30:
+	.quad	func33
+	.section	.text.unlikely
+	jmp	func30
+	.section	.rodata.str1.1
+.LC32:
+	.string	"func31"
+	.text
+	.p2align 4
+	.globl	func31
+	.type	func31, @function
+func31:
+	pushq	%rbx
+	movl	$217, %ebx
+	leaq	.LC32(%rip), %rdi
+	movq	counter4(%rip), %rax
+	addq	%rax, shared(%rip)
+	call	func26
+	testl	%ebx, %ebx
+	je	.L31
+	call	puts
+	jmp	cold0
+.L31:
+	popq	%rbx
+	ret
+	.size	func31, .-func31
+	.data
+	.align 8
+	.type	counter31, @object
+	.size	counter31, 8
+counter31:
+	.quad	func34
+	.section	.text.unlikely
+	jmp	func31
+	.section	.rodata.str1.1
+.LC33:
+	.string	"func32"
+	.text
+	.p2align 4
+	.globl	func32
+	.type	func32, @function
+func32:
+	pushq	%rbx
+	movl	$224, %ebx
+	leaq	.LC33(%rip), %rdi
+	movq	counter5(%rip), %rax
+	addq	%rax, shared(%rip)
+	call	func37
+	testl	%ebx, %ebx
+	je	.L32
+	call	puts
+	jmp	cold0
+.L32:
+	popq	%rbx
+	ret
+	.size	func32, .-func32
+	.data
+	.align 8
+	.type	counter32, @object
+	.size	counter32, 8
+counter32:
+	.quad	func35
+	.section	.text.unlikely
+	jmp	func32
+	.section	.rodata.str1.1
+.LC34:
+	.string	"func33"
+	.text
+	.p2align 4
+	.globl	func33
+	.type	func33, @function
+func33:
+	pushq	%rbx
+	movl	$231, %ebx
+	leaq	.LC34(%rip), %rdi
+	movq	counter6(%rip), %rax
+	addq	%rax, shared(%rip)
+	call	func8
+	testl	%ebx, %ebx
+	je	.L33
+	call	puts
+	jmp	cold0
+.L33:
+	popq	%rbx
+	ret
+	.size	func33, .-func33
+	.data
+	.align 8
+	.type	counter33, @object
+	.size	counter33, 8
+counter33:
+	.quad	func36
+	.section	.text.unlikely
+	jmp	func33
+	.section	.rodata.str1.1
+.LC35:
+	.string	"func34"
+	.text
+	.p2align 4
+	.globl	func34
+	.type	func34, @function
+func34:
+	pushq	%rbx
+	movl	$238, %ebx
+	leaq	.LC35(%rip), %rdi
+	movq	counter7(%rip), %rax
+	addq	%rax, shared(%rip)
+	call	func19
+	testl	%ebx, %ebx
+	je	.L34
+	call	puts
+	jmp	cold0
+.L34:
+	popq	%rbx
+	ret
+	.size	func34, .-func34
+	.data
+	.align 8
+	.type	counter34, @object
+	.size	counter34, 8
+counter34:
+	.quad	func37
+	.section	.text.unlikely
+	jmp	func34
+	.section	.rodata.str1.1
+.LC36:
+	.string	"func35"
+	.text
+	.p2align 4
+	.globl	func35
+	.type	func35, @function
+func35:
+	pushq	%rbx
+	movl	$245, %ebx
+	leaq	.LC36(%rip), %rdi
+	movq	counter8(%rip), %rax
+	addq	%rax, shared(%rip)
+	call	func30
+	testl	%ebx, %ebx
+	je	.L35
+	call	puts
+	jmp	cold0
+.L35:
+	popq	%rbx
+	ret
+	.size	func35, .-func35
+	.data
+	.align 8
+	.type	counter35, @object
+	.size	counter35, 8
+counter35:
+	.quad	func38
+	.section	.text.unlikely
+	jmp	func35
+	.section	.rodata.str1.1
+.LC37:
+	.string	"func36"
+	.text
+	.p2align 4
+	.globl	func36
+	.type	func36, @function
+func36:
+	pushq	%rbx
+	movl	$252, %ebx
+	leaq	.LC37(%rip), %rdi
+	movq	counter9(%rip), %rax
+	addq	%rax, shared(%rip)
+	call	func1
+	testl	%ebx, %ebx
+	je	.L36
+	call	puts
+	jmp	cold0
+.L36:
+	popq	%rbx
+	ret
+	.size	func36, .-func36
+	.data
+	.align 8
+	.type	counter36, @object
+	.size	counter36, 8
+counter36:
+	.quad	func39
+	.section	.text.unlikely
+	jmp	func36
+	.section	.rodata.str1.1
+.LC38:
+	.string	"func37"
+	.text
+	.p2align 4
+	.globl	func37
+	.type	func37, @function
+func37:
+	pushq	%rbx
+	movl	$259, %ebx
+	leaq	.LC38(%rip), %rdi
+	movq	counter10(%rip), %rax
+	addq	%rax, shared(%rip)
+	call	func12
+	testl	%ebx, %ebx
+	je	.L37
+	call	puts
+	jmp	cold0
+.L37:
+	popq	%rbx
+	ret
+	.size	func37, .-func37
+	.data
+	.align 8
+	.type	counter37, @object
+	.size	counter37, 8
+counter37:
+	.quad	func0
+	.section	.text.unlikely
+	jmp	func37
+	.section	.rodata.str1.1
+.LC39:
+	.string	"func38"
+	.text
+	.p2align 4
+	.globl	func38
+	.type	func38, @function
+func38:
+	pushq	%rbx
+	movl	$266, %ebx
+	leaq	.LC39(%rip), %rdi
+	movq	counter11(%rip), %rax
+	addq	%rax, shared(%rip)
+	call	func23
+	testl	%ebx, %ebx
+	je	.L38
+	call	puts
+	jmp	cold0
+.L38:
+	popq	%rbx
+	ret
+	.size	func38, .-func38
+	.data
+	.align 8
+	.type	counter38, @object
+	.size	counter38, 8
+counter38:
+	.quad	func1
+	.section	.text.unlikely
+	jmp	func38
+	.section	.rodata.str1.1
+.LC40:
+	.string	"func39"
+	.text
+	.p2align 4
+	.globl	func39
+	.type	func39, @function
+func39:
+	pushq	%rbx
+	movl	$273, %ebx
+	leaq	.LC40(%rip), %rdi
+	movq	counter12(%rip), %rax
+	addq	%rax, shared(%rip)
+	call	func34
+	testl	%ebx, %ebx
+	je	.L39
+	call	puts
+	jmp	cold0
+.L39:
+	popq	%rbx
+	ret
+	.size	func39, .-func39
+	.data
+	.align 8
+	.type	counter39, @object
+	.size	counter39, 8
+counter39:
+	.quad	func2
+	.section	.text.unlikely
+	jmp	func39
+	.ident	"GCC"
+	.section	.note.GNU-stack,"",@progbits
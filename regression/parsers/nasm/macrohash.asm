@@ -0,0 +1,280 @@
+; Exercise macro table growth: more macros than initial buckets.
+%define SYM0 0
+%define SYM1 1
+%define SYM2 2
+%define SYM3 3
+%define SYM4 4
+%define SYM5 5
+%define SYM6 6
+%define SYM7 7
+%define SYM8 8
+%define SYM9 9
+%define SYM10 10
+%define SYM11 11
+%define SYM12 12
+%define SYM13 13
+%define SYM14 14
+%define SYM15 15
+%define SYM16 16
+%define SYM17 17
+%define SYM18 18
+%define SYM19 19
+%define SYM20 20
+%define SYM21 21
+%define SYM22 22
+%define SYM23 23
+%define SYM24 24
+%define SYM25 25
+%define SYM26 26
+%define SYM27 27
+%define SYM28 28
+%define SYM29 29
+%define SYM30 30
+%define SYM31 31
+%define SYM32 32
+%define SYM33 33
+%define SYM34 34
+%define SYM35 35
+%define SYM36 36
+%define SYM37 37
+%define SYM38 38
+%define SYM39 39
+%define SYM40 40
+%define SYM41 41
+%define SYM42 42
+%define SYM43 43
+%define SYM44 44
+%define SYM45 45
+%define SYM46 46
+%define SYM47 47
+%define SYM48 48
+%define SYM49 49
+%define SYM50 50
+%define SYM51 51
+%define SYM52 52
+%define SYM53 53
+%define SYM54 54
+%define SYM55 55
+%define SYM56 56
+%define SYM57 57
+%define SYM58 58
+%define SYM59 59
+%define SYM60 60
+%define SYM61 61
+%define SYM62 62
+%define SYM63 63
+%define SYM64 64
+%define SYM65 65
+%define SYM66 66
+%define SYM67 67
+%define SYM68 68
+%define SYM69 69
+%define SYM70 70
+%define SYM71 71
+%define SYM72 72
+%define SYM73 73
+%define SYM74 74
+%define SYM75 75
+%define SYM76 76
+%define SYM77 77
+%define SYM78 78
+%define SYM79 79
+%define SYM80 80
+%define SYM81 81
+%define SYM82 82
+%define SYM83 83
+%define SYM84 84
+%define SYM85 85
+%define SYM86 86
+%define SYM87 87
+%define SYM88 88
+%define SYM89 89
+%define SYM90 90
+%define SYM91 91
+%define SYM92 92
+%define SYM93 93
+%define SYM94 94
+%define SYM95 95
+%define SYM96 96
+%define SYM97 97
+%define SYM98 98
+%define SYM99 99
+%idefine isym0 100
+%idefine isym1 101
+%idefine isym2 102
+%idefine isym3 103
+%idefine isym4 104
+%idefine isym5 105
+%idefine isym6 106
+%idefine isym7 107
+%idefine isym8 108
+%idefine isym9 109
+%idefine isym10 110
+%idefine isym11 111
+%idefine isym12 112
+%idefine isym13 113
+%idefine isym14 114
+%idefine isym15 115
+%idefine isym16 116
+%idefine isym17 117
+%idefine isym18 118
+%idefine isym19 119
+%idefine isym20 120
+%idefine isym21 121
+%idefine isym22 122
+%idefine isym23 123
+%idefine isym24 124
+%idefine isym25 125
+%idefine isym26 126
+%idefine isym27 127
+%idefine isym28 128
+%idefine isym29 129
+%idefine isym30 130
+%idefine isym31 131
+%idefine isym32 132
+%idefine isym33 133
+%idefine isym34 134
+%idefine isym35 135
+%idefine isym36 136
+%idefine isym37 137
+%idefine isym38 138
+%idefine isym39 139
+%macro MAC0 1
+db %1+0
+%endmacro
+%macro MAC1 1
+db %1+1
+%endmacro
+%macro MAC2 1
+db %1+2
+%endmacro
+%macro MAC3 1
+db %1+3
+%endmacro
+%macro MAC4 1
+db %1+4
+%endmacro
+%macro MAC5 1
+db %1+5
+%endmacro
+%macro MAC6 1
+db %1+6
+%endmacro
+%macro MAC7 1
+db %1+7
+%endmacro
+%macro MAC8 1
+db %1+8
+%endmacro
+%macro MAC9 1
+db %1+9
+%endmacro
+%macro MAC10 1
+db %1+10
+%endmacro
+%macro MAC11 1
+db %1+11
+%endmacro
+%macro MAC12 1
+db %1+12
+%endmacro
+%macro MAC13 1
+db %1+13
+%endmacro
+%macro MAC14 1
+db %1+14
+%endmacro
+%macro MAC15 1
+db %1+15
+%endmacro
+%macro MAC16 1
+db %1+16
+%endmacro
+%macro MAC17 1
+db %1+17
+%endmacro
+%macro MAC18 1
+db %1+18
+%endmacro
+%macro MAC19 1
+db %1+19
+%endmacro
+%macro MAC20 1
+db %1+20
+%endmacro
+%macro MAC21 1
+db %1+21
+%endmacro
+%macro MAC22 1
+db %1+22
+%endmacro
+%macro MAC23 1
+db %1+23
+%endmacro
+%macro MAC24 1
+db %1+24
+%endmacro
+%macro MAC25 1
+db %1+25
+%endmacro
+%macro MAC26 1
+db %1+26
+%endmacro
+%macro MAC27 1
+db %1+27
+%endmacro
+%macro MAC28 1
+db %1+28
+%endmacro
+%macro MAC29 1
+db %1+29
+%endmacro
+%macro MAC30 1
+db %1+30
+%endmacro
+%macro MAC31 1
+db %1+31
+%endmacro
+%macro MAC32 1
+db %1+32
+%endmacro
+%macro MAC33 1
+db %1+33
+%endmacro
+%macro MAC34 1
+db %1+34
+%endmacro
+%macro MAC35 1
+db %1+35
+%endmacro
+%macro MAC36 1
+db %1+36
+%endmacro
+%macro MAC37 1
+db %1+37
+%endmacro
+%macro MAC38 1
+db %1+38
+%endmacro
+%macro MAC39 1
+db %1+39
+%endmacro
+db SYM0, SYM99, ISYM0, IsYm39
+MAC0 1
+MAC39 1
+%undef SYM50
+%ifdef SYM50
+db 0xff
+%endif
+%ifdef SYM51
+db SYM51
+%endif
+%ifmacro MAC20 1
+db 0xee
+%endif
+%clear
+%ifdef SYM0
+db 0xff
+%endif
+%define A 1
+db A
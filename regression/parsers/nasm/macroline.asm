@@ -0,0 +1,7 @@
+%macro m 0
+ db 1
+ db 2
+ resb 1
+%endmacro
+ m		; out: 01 02 00
+ m		; out: 01 02 00
@@ -0,0 +1,13 @@
+; integer-only preprocessor expressions
+%assign i 0
+%rep 5
+%assign i i+1
+%if i % 2 == 0 && i > 1
+db i
+%endif
+%endrep
+%assign j ((1 << 40) + -3) // 7
+dq j, -5 %% 3, ~0 >> 60
+%if 10 / (1 >= (2 && 3))
+db 0x11
+%endif
@@ -0,0 +1,36 @@
+; %rep lines with unchanging expansions are expanded once and reused
+%define K 3
+%define F(x) ((x)*K+1)
+%assign i 0
+%rep 4
+db F(2), K, i
+%if i == 1
+%define K 7
+%endif
+%assign i i+1
+%endrep
+%assign n 0
+%rep 10
+%assign n n+1
+%if n > 3
+%exitrep
+%endif
+%rep 2
+dw K, n
+%undef K
+%define K 11
+%endrep
+%endrep
+%rep 2
+%scope
+%define Q 1
+db Q
+%endscope
+%define Q 2
+db Q
+%endrep
+G equ 9
+%rep 2
+db G
+%define G 5
+%endrep
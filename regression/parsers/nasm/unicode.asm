@@ -0,0 +1,20 @@
+db __utf16__('aé')		; out: 61 00 e9 00
+dw __utf16__("ab€"), 1		; out: 61 00 62 00 ac 20 01 00
+dw __utf16le__('a')		; out: 61 00
+dw __utf16be__(`A€`)	; out: 00 41 20 ac
+dd __utf16__('abc')		; out: 61 00 62 00 63 00 00 00
+dw __utf16__('😀')		; out: 3d d8 00 de
+dd __utf32__('x😀')		; out: 78 00 00 00 00 f6 01 00
+dd __utf32le__('y')		; out: 79 00 00 00
+dd __utf32be__('z')		; out: 00 00 00 7a
+dw __utf16__('0123456789abcdef0123456789abcdef')
+; out: 30 00 31 00 32 00 33 00 34 00 35 00 36 00 37 00
+; out: 38 00 39 00 61 00 62 00 63 00 64 00 65 00 66 00
+; out: 30 00 31 00 32 00 33 00 34 00 35 00 36 00 37 00
+; out: 38 00 39 00 61 00 62 00 63 00 64 00 65 00 66 00
+dd __utf32be__('0123456789abcdefé')
+; out: 00 00 00 30 00 00 00 31 00 00 00 32 00 00 00 33
+; out: 00 00 00 34 00 00 00 35 00 00 00 36 00 00 00 37
+; out: 00 00 00 38 00 00 00 39 00 00 00 61 00 00 00 62
+; out: 00 00 00 63 00 00 00 64 00 00 00 65 00 00 00 66
+; out: 00 00 00 e9
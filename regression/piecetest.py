@@ -0,0 +1,151 @@
+#! /usr/bin/env python
+# Split parse and piece cache tests
+#
+#  Copyright (C) 2026  Peter Johnson
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+#
+# Assembles parsers/gas/splitparse.s with --split-parse, checking from
+# the trace that it really was split into pieces; the regression test of
+# the same source only compares the output, which would be the same if it
+# weren't.  Then assembles it with a cache directory, edits one piece of
+# it, and assembles it again.  The pieces left unchanged must be replayed
+# from the cache.  Each result must match an assembly without splitting
+# or caching.
+#
+import os
+import shutil
+import subprocess
+import sys
+
+SOURCE = os.path.join("parsers", "gas", "splitparse.s")
+SPLIT_ARGS = ["-p", "gas", "-f", "elf64", "-j4", "--split-parse"]
+
+def assemble(yasmexe, args, outfile):
+    if os.path.exists(outfile):
+        os.remove(outfile)
+    proc = subprocess.Popen([yasmexe] + args + ["-o", outfile],
+                            stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    stdout, stderr = proc.communicate()
+    if proc.returncode != 0:
+        raise RuntimeError("yasm failed (%d): %s" %
+                           (proc.returncode, stderr.decode("latin-1")))
+    f = open(outfile, "rb")
+    try:
+        return f.read()
+    finally:
+        f.close()
+
+def count_pieces(tracefile):
+    """Count the pieces parsed, and how many of those were replayed."""
+    f = open(tracefile)
+    try:
+        trace = f.read()
+    finally:
+        f.close()
+    pieces = trace.count('"Parse Piece"')
+    replayed = trace.count('"detail":"replay"')
+    return pieces, replayed
+
+def check(cond, msg):
+    if not cond:
+        raise RuntimeError(msg)
+
+def test_split(srcdir, workdir, yasmexe):
+    srcfile = os.path.join(srcdir, SOURCE)
+    tracefile = os.path.join(workdir, "split.json")
+    ref = assemble(yasmexe, ["-p", "gas", "-f", "elf64", srcfile],
+                   os.path.join(workdir, "split-ref.o"))
+    obj = assemble(yasmexe, SPLIT_ARGS + ["--trace=" + tracefile, srcfile],
+                   os.path.join(workdir, "split.o"))
+    pieces, replayed = count_pieces(tracefile)
+    check(pieces > 1, "split: source not split (%d pieces)" % pieces)
+    check(obj == ref, "split: output differs from unsplit assembly")
+    print("[ OK ] split: %d pieces" % pieces)
+
+def test_cache(srcdir, workdir, yasmexe):
+    srcfile = os.path.join(workdir, "piece.s")
+    cachedir = os.path.join(workdir, "cache")
+    tracefile = os.path.join(workdir, "piece.json")
+    objfile = os.path.join(workdir, "piece.o")
+    reffile = os.path.join(workdir, "piece-ref.o")
+
+    f = open(os.path.join(srcdir, SOURCE), "rb")
+    try:
+        text = f.read()
+    finally:
+        f.close()
+
+    # The cache key includes the command line, so every cached assembly
+    # uses the same one.
+    cached_args = SPLIT_ARGS + ["--cache-dir=" + cachedir,
+                                "--trace=" + tracefile, srcfile]
+
+    for step in ("cold", "edit"):
+        if step == "edit":
+            # Insert an instruction at a line start in the middle; this
+            # moves everything after it, so references across pieces
+            # change too.
+            mid = text.index(b"\n", len(text) // 2) + 1
+            text = text[:mid] + b"\tnop\n" + text[mid:]
+        f = open(srcfile, "wb")
+        try:
+            f.write(text)
+        finally:
+            f.close()
+
+        ref = assemble(yasmexe, ["-p", "gas", "-f", "elf64", srcfile],
+                       reffile)
+        obj = assemble(yasmexe, cached_args, objfile)
+        pieces, replayed = count_pieces(tracefile)
+        check(pieces > 2, "%s: source not split (%d pieces)" % (step, pieces))
+        if step == "cold":
+            check(replayed == 0, "cold: %d pieces replayed" % replayed)
+        else:
+            # Only the edited piece (and, if the edit moved a bound, a
+            # neighbour) is parsed again.
+            check(replayed >= pieces - 2 and replayed > 0,
+                  "edit: only %d of %d pieces replayed" % (replayed, pieces))
+        check(obj == ref, "%s: output differs from unsplit assembly" % step)
+        print("[ OK ] %s: %d pieces, %d replayed" % (step, pieces, replayed))
+
+def run_test(srcdir, outdir, yasmexe):
+    workdir = os.path.join(outdir, "piecetest")
+    if os.path.exists(workdir):
+        shutil.rmtree(workdir)
+    os.makedirs(workdir)
+    test_split(srcdir, workdir, yasmexe)
+    test_cache(srcdir, workdir, yasmexe)
+
+def main():
+    if len(sys.argv) != 4:
+        print("Usage: piecetest.py <srcdir> <outdir> <yasm>")
+        return 2
+    try:
+        run_test(sys.argv[1], sys.argv[2], sys.argv[3])
+    except RuntimeError:
+        print("[FAILED] %s" % sys.exc_info()[1])
+        return 1
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -37,6 +37,7 @@ def lprint(*args, **kwargs):
     file.write(end)
 
 yasmexe = None
+yobjdumpexe = None
 outdir = None
 
 def path_splitall(path):
@@ -111,29 +112,61 @@ class Test(object):
 
         return match
 
-    def compare_out(self):
-        """Check output file."""
+    def compare_md5(self, outfn, golden):
+        """Check output file against an MD5 digest."""
+        import hashlib
+        f = open(os.path.join(outdir, outfn), "rb")
+        try:
+            digest = hashlib.md5(f.read()).hexdigest()
+        finally:
+            f.close()
+        if digest != golden:
+            lprint("%s: MD5 digest %s (expected %s)"
+                   % (outfn, digest, golden))
+            return False
+        return True
+
+    def compare_out(self, ext=""):
+        """Check output file, or with ext, the extra output file with that
+        extension."""
+        goldenbase = os.path.splitext(self.fullpath)[0] + ext
+        outfn = ext and self.basefn + ext or self.outfn
+
+        # Output too large for a .hex file is checked against the MD5
+        # digest in a .md5 file instead.
+        golden_md5 = None
+        try:
+            f = open(goldenbase + ".md5")
+            try:
+                golden_md5 = f.read().strip()
+            finally:
+                f.close()
+        except IOError:
+            pass
+        if golden_md5 is not None:
+            return self.compare_md5(outfn, golden_md5)
+
         # If there's a .hex file, use it; otherwise scan the input file
         # for comments starting with "out:" followed by hex digits.
         golden = []
         try:
-            f = open(os.path.splitext(self.fullpath)[0] + ".hex")
+            f = open(goldenbase + ".hex")
             try:
                 golden = [l.strip() for l in f.readlines()]
             finally:
                 f.close()
         except IOError:
-            for l in self.inputlines:
+            for l in ext and [] or self.inputlines:
                 comment = l.partition(self.commentsep)[2].strip()
                 if not comment.startswith('out:'):
                     continue
                 golden.extend(comment[4:].split())
         golden = [int(x, 16) for x in golden if x]
 
-        goldenfn = self.basefn + ".gold"
+        goldenfn = self.basefn + ext + ".gold"
 
         # check result file
-        f = open(os.path.join(outdir, self.outfn), "rb")
+        f = open(os.path.join(outdir, outfn), "rb")
         try:
             result = f.read()
         finally:
@@ -141,12 +174,12 @@ class Test(object):
         match = True
         if len(golden) != len(result):
             lprint("%s: output length %d (expected %d)"
-                    % (self.outfn, len(result), len(golden)))
+                    % (outfn, len(result), len(golden)))
             match = False
         for i, (o, g) in enumerate(zip([ord(x) for x in result], golden)):
             if o != g:
                 lprint("%s:%d: mismatch: %s (expected %s)"
-                        % (self.outfn, i, hex(o), hex(g)))
+                        % (outfn, i, hex(o), hex(g)))
                 lprint("  (only the first mismatch is reported)")
                 match = False
                 break
@@ -161,14 +194,16 @@ class Test(object):
                 f.close()
 
             # save golden hex
-            f = open(os.path.join(outdir, self.basefn + ".goldhex"), "w")
+            f = open(os.path.join(outdir, self.basefn + ext + ".goldhex"),
+                     "w")
             try:
                 f.writelines(["%02x\n" % x for x in golden])
             finally:
                 f.close()
 
             # save result hex
-            f = open(os.path.join(outdir, self.basefn + ".outhex"), "w")
+            f = open(os.path.join(outdir, self.basefn + ext + ".outhex"),
+                     "w")
             try:
                 f.writelines(["%02x\n" % ord(x) for x in result])
             finally:
@@ -176,6 +211,60 @@ class Test(object):
 
         return match
 
+    def compare_dump(self, objdumpargs):
+        """Check yobjdump output for the output file."""
+        if yobjdumpexe is None:
+            lprint("%s: no yobjdump executable given" % self.name)
+            return False
+
+        # Run in the output directory so the file name in the dump is
+        # the same wherever the tests are run.
+        import shlex
+        proc = subprocess.Popen(["yobjdump"] + shlex.split(objdumpargs) +
+                                [self.outfn],
+                                executable=yobjdumpexe, cwd=outdir,
+                                stdout=subprocess.PIPE,
+                                stderr=subprocess.PIPE)
+        (stdoutdata, stderrdata) = proc.communicate()
+        if proc.returncode != 0:
+            lprint("yobjdump failed (%d): %s"
+                   % (proc.returncode, stderrdata.strip()))
+            return False
+
+        golden = []
+        try:
+            f = open(os.path.splitext(self.fullpath)[0] + ".dump")
+            try:
+                golden = [l.rstrip() for l in f.readlines()]
+            finally:
+                f.close()
+        except IOError:
+            pass
+        result = [l.rstrip() for l in stdoutdata.splitlines()]
+
+        dumpfn = self.basefn + ".dump"
+        match = True
+        if len(golden) != len(result):
+            lprint("%s: dump length %d (expected %d)"
+                   % (dumpfn, len(result), len(golden)))
+            match = False
+        for i, (o, g) in enumerate(zip(result, golden)):
+            if o != g:
+                lprint("%s:%d: mismatch on dump" % (dumpfn, i+1))
+                lprint(" Expected: %s" % g)
+                lprint(" Actual: %s" % o)
+                match = False
+                break
+
+        if not match:
+            f = open(os.path.join(outdir, dumpfn), "w")
+            try:
+                f.writelines([l + "\n" for l in result])
+            finally:
+                f.close()
+
+        return match
+
     def get_option(self, option, default=None):
         """Get test-specific option from the first line of the input file.
         Returns None if option not present, otherwise option string."""
@@ -223,8 +312,34 @@ class Test(object):
                (self.name, yasmargs[0] == "ygas" and "ygas " or "",
                 " ".join(yasmargs[1:]), expectfail and "{fail}" or ""))
 
+        # Output file extension override: "[outext X]"
+        outext = self.get_option("outext")
+        if outext is not None:
+            self.outfn = self.basefn + "." + outext
+
         # Specify the output filename as we pipe the input.
-        yasmargs.extend(["-o", os.path.join(outdir, self.outfn)])
+        yasmargs.extend(["-o", os.path.abspath(os.path.join(outdir,
+                                                            self.outfn))])
+
+        # Split DWARF output: "[dwo]".  The .dwo file is written next to
+        # the output, from the output directory so the name recorded for
+        # it doesn't depend on where the tests are, and checked against
+        # a .dwo.hex file.
+        dwo = self.get_option("dwo") is not None
+        if dwo:
+            yasmargs.append("--split-dwarf-file=" + self.basefn + ".dwo")
+
+        # Other input files, assembled before the piped one: "[input X]".
+        # These are found relative to the test, and yasm is run from its
+        # directory so their names don't depend on where the tests are.
+        inputs = self.get_option("input")
+        cwd = dwo and outdir or None
+        if inputs is not None:
+            if dwo:
+                lprint("%s: [input] can't be used with [dwo]" % self.name)
+                return False
+            yasmargs.extend(inputs.split())
+            cwd = os.path.dirname(self.fullpath)
 
         # We pipe the input, so append "-" to the command line for stdin input.
         yasmargs.append("-")
@@ -236,7 +351,7 @@ class Test(object):
         proc = subprocess.Popen(yasmargs, bufsize=4096,
                                 executable=(ygasoverride and ygasexe or yasmexe),
                                 stdin=subprocess.PIPE, stdout=subprocess.PIPE,
-                                stderr=subprocess.PIPE, env=env)
+                                stderr=subprocess.PIPE, env=env, cwd=cwd)
         (stdoutdata, stderrdata) = proc.communicate(self.inputfile)
         end = time.time()
 
@@ -266,6 +381,18 @@ class Test(object):
                 if not match:
                     ok = False
 
+            if not expectfail and dwo:
+                match = self.compare_out(".dwo")
+                if not match:
+                    ok = False
+
+            # Dump of the output file: "[objdump <args>]"
+            objdumpargs = self.get_option("objdump")
+            if not expectfail and objdumpargs is not None:
+                match = self.compare_dump(objdumpargs)
+                if not match:
+                    ok = False
+
         # Summarize test result
         if ok:
             result = "      OK"
@@ -313,15 +440,18 @@ def run_all(bpath):
     return True
 
 if __name__ == "__main__":
-    if len(sys.argv) != 5:
+    if len(sys.argv) not in (5, 6):
         lprint("Usage: rtest.py <path to regression tree>", file=sys.stderr)
         lprint("    <path to output directory>", file=sys.stderr)
         lprint("    <path to yasm executable>", file=sys.stderr)
         lprint("    <path to ygas executable>", file=sys.stderr)
+        lprint("    [<path to yobjdump executable>]", file=sys.stderr)
         sys.exit(2)
     outdir = sys.argv[2]
-    yasmexe = sys.argv[3]
-    ygasexe = sys.argv[4]
+    yasmexe = os.path.abspath(sys.argv[3])
+    ygasexe = os.path.abspath(sys.argv[4])
+    if len(sys.argv) > 5:
+        yobjdumpexe = os.path.abspath(sys.argv[5])
     all_ok = run_all(sys.argv[1])
     if all_ok:
         sys.exit(0)
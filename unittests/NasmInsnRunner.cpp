@@ -116,8 +116,8 @@ void
 AddSpanTest(Bytecode& bc,
             int id,
             const Value& value,
-            long neg_thres,
-            long pos_thres)
+            int64_t neg_thres,
+            int64_t pos_thres)
 {
 }
 
@@ -188,7 +188,10 @@ NasmInsnRunner::ParseAndTestLine(const char* filename,
                                  const llvm::StringRef& line,
                                  int linenum)
 {
-    SCOPED_TRACE(llvm::format("%s:%d", filename, linenum));
+    std::string trace;
+    llvm::raw_string_ostream trace_os(trace);
+    trace_os << filename << ':' << linenum;
+    SCOPED_TRACE(trace_os.str());
 
     llvm::StringRef insn_in, golden_in;
     llvm::tie(insn_in, golden_in) = line.split(';');
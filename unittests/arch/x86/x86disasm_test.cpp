@@ -0,0 +1,137 @@
+//
+//  Copyright (C) 2026  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include <gtest/gtest.h>
+#include <string>
+
+#include "llvm/Support/raw_ostream.h"
+#include "yasmx/Support/registry.h"
+#include "yasmx/System/plugin.h"
+#include "yasmx/Arch.h"
+
+
+using namespace yasm;
+
+class X86DisasmTest : public ::testing::Test
+{
+protected:
+    static void SetUpTestCase()
+    {
+        ASSERT_TRUE(LoadStandardPlugins());
+    }
+
+    virtual void SetUp()
+    {
+        m_arch_module = LoadModule<ArchModule>("x86");
+        ASSERT_TRUE(m_arch_module.get() != 0) << "could not load x86 arch";
+        m_arch = m_arch_module->Create();
+        m_arch->setMachine("amd64");
+    }
+
+    // Disassemble, returning the text (or "(bad)") and length.
+    std::string Disasm(unsigned int bits,
+                       const char* bytes,
+                       std::size_t len,
+                       unsigned int* insn_len = 0)
+    {
+        m_arch->setVar("mode_bits", bits);
+        std::string text;
+        llvm::raw_string_ostream os(text);
+        Arch::DisasmInsn insn;
+        if (!m_arch->Disassemble(reinterpret_cast<const unsigned char*>(bytes),
+                                 len, 0x1000, &insn, &os))
+            return "(bad)";
+        if (insn_len)
+            *insn_len = insn.length;
+        return os.str();
+    }
+
+    std::auto_ptr<ArchModule> m_arch_module;
+    std::auto_ptr<Arch> m_arch;
+};
+
+#define DISASM(bits, str)   Disasm(bits, str, sizeof(str)-1)
+
+TEST_F(X86DisasmTest, General)
+{
+    EXPECT_EQ("push rbx", DISASM(64, "\x53"));
+    EXPECT_EQ("push ebx", DISASM(32, "\x53"));
+    EXPECT_EQ("mov eax, ebx", DISASM(64, "\x89\xd8"));
+    EXPECT_EQ("mov r8, qword [rax+rdx*8-0x10]",
+              DISASM(64, "\x4c\x8b\x44\xd0\xf0"));
+    EXPECT_EQ("add ebx, r8d", DISASM(64, "\x44\x01\xc3"));
+    EXPECT_EQ("imul ebx, eax, 0x5", DISASM(64, "\x6b\xd8\x05"));
+    EXPECT_EQ("shl esi, 0x2", DISASM(64, "\xc1\xe6\x02"));
+    EXPECT_EQ("sete al", DISASM(64, "\x0f\x94\xc0"));
+    EXPECT_EQ("mov al, byte [bx+si+0x4]", DISASM(16, "\x8a\x40\x04"));
+}
+
+TEST_F(X86DisasmTest, MemorySize)
+{
+    EXPECT_EQ("movzx eax, byte [rax+0x10]", DISASM(64, "\x0f\xb6\x40\x10"));
+    EXPECT_EQ("cmp qword [rax], 0x0", DISASM(64, "\x48\x83\x38\x00"));
+}
+
+TEST_F(X86DisasmTest, Branches)
+{
+    // Targets are relative to the end of the instruction at 0x1000.
+    EXPECT_EQ("jne 0xfd5", DISASM(64, "\x75\xd3"));
+    EXPECT_EQ("call 0x1005", DISASM(64, "\xe8\x00\x00\x00\x00"));
+    EXPECT_EQ("lea rdi, [rel 0x1010]",
+              DISASM(64, "\x48\x8d\x3d\x09\x00\x00\x00"));
+}
+
+TEST_F(X86DisasmTest, Prefixes)
+{
+    EXPECT_EQ("rep movsb", DISASM(64, "\xf3\xa4"));
+    EXPECT_EQ("lock add dword [rax], eax", DISASM(64, "\xf0\x01\x00"));
+    EXPECT_EQ("movsd xmm0, qword [rdx+rax*8]",
+              DISASM(64, "\xf2\x0f\x10\x04\xc2"));
+    EXPECT_EQ("pxor xmm1, xmm1", DISASM(64, "\x66\x0f\xef\xc9"));
+}
+
+TEST_F(X86DisasmTest, Vex)
+{
+    EXPECT_EQ("vaddpd ymm1, ymm2, ymm3", DISASM(64, "\xc5\xed\x58\xcb"));
+    EXPECT_EQ("andn rax, rbx, rcx", DISASM(64, "\xc4\xe2\xe0\xf2\xc1"));
+    // C5 is LDS outside 64-bit mode unless followed by a register ModRM.
+    EXPECT_EQ("lds eax, [eax]", DISASM(32, "\xc5\x00"));
+}
+
+TEST_F(X86DisasmTest, Fill)
+{
+    unsigned int len = 0;
+    EXPECT_EQ("nop word [cs:rax+rax]",
+              Disasm(64, "\x66\x2e\x0f\x1f\x84\x00\x00\x00\x00\x00", 10,
+                     &len));
+    EXPECT_EQ(10U, len);
+    EXPECT_EQ("endbr64", DISASM(64, "\xf3\x0f\x1e\xfa"));
+}
+
+TEST_F(X86DisasmTest, Bad)
+{
+    EXPECT_EQ("(bad)", DISASM(64, "\x0f"));             // truncated
+    EXPECT_EQ("(bad)", DISASM(64, "\x8b"));             // missing ModRM
+    EXPECT_EQ("(bad)", DISASM(64, "\x06"));             // push es
+}
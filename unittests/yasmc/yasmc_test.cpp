@@ -0,0 +1,144 @@
+// C interface unit tests
+//
+//  Copyright (C) 2026  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "yasmx/yasmc.h"
+
+static void
+SaveOutput(void* data, const void* obj, size_t len)
+{
+    static_cast<std::string*>(data)->assign(static_cast<const char*>(obj),
+                                            len);
+}
+
+static int
+Assemble(yasm_ctx* ctx, const char* src, std::string* obj)
+{
+    obj->clear();
+    return yasm_assemble_buffer(ctx, src, std::strlen(src), SaveOutput, obj);
+}
+
+static void
+WriteFile(const char* filename, const char* contents)
+{
+    std::FILE* f = std::fopen(filename, "wb");
+    ASSERT_TRUE(f != 0);
+    std::fputs(contents, f);
+    std::fclose(f);
+}
+
+TEST(YasmcTest, CreateUnknown)
+{
+    EXPECT_TRUE(yasm_ctx_create("x86", "nasm", "nonexistent") == 0);
+    EXPECT_TRUE(yasm_ctx_create("nonexistent", "nasm", "bin") == 0);
+    yasm_ctx_destroy(0);
+}
+
+TEST(YasmcTest, AssembleTwice)
+{
+    yasm_ctx* ctx = yasm_ctx_create("x86", 0, "bin");
+    ASSERT_TRUE(ctx != 0);
+    std::string obj;
+    EXPECT_EQ(0, Assemble(ctx, "mov ax, 1\n", &obj));
+    EXPECT_EQ(std::string("\xb8\x01\x00", 3), obj);
+    EXPECT_STREQ("", yasm_ctx_diagnostics(ctx));
+    EXPECT_EQ(0, Assemble(ctx, "bits 32\nnop\n", &obj));
+    EXPECT_EQ("\x90", obj);
+    yasm_ctx_destroy(ctx);
+}
+
+TEST(YasmcTest, Error)
+{
+    yasm_ctx* ctx = yasm_ctx_create("x86", "nasm", "bin");
+    ASSERT_TRUE(ctx != 0);
+    std::string obj;
+    EXPECT_NE(0, Assemble(ctx, "mov ax, bx, cx\n", &obj));
+    EXPECT_TRUE(obj.empty());
+    EXPECT_STRNE("", yasm_ctx_diagnostics(ctx));
+    // the error doesn't stick
+    EXPECT_EQ(0, Assemble(ctx, "nop\n", &obj));
+    EXPECT_EQ("\x90", obj);
+    EXPECT_STREQ("", yasm_ctx_diagnostics(ctx));
+    yasm_ctx_destroy(ctx);
+}
+
+TEST(YasmcTest, IncludePath)
+{
+    yasm_ctx* ctx = yasm_ctx_create("x86", "nasm", "bin");
+    ASSERT_TRUE(ctx != 0);
+    EXPECT_NE(0, yasm_ctx_add_include_path(ctx, "yasmc_test_nonexistent"));
+
+    // A missing include is fatal to the preprocessor, but not to the
+    // program using it.
+    std::string obj;
+    EXPECT_NE(0, Assemble(ctx, "%include \"yasmc_test.inc\"\n", &obj));
+    EXPECT_TRUE(std::strstr(yasm_ctx_diagnostics(ctx), "yasmc_test.inc")
+                != 0);
+
+    // Add the path after an assembly has been done.
+    WriteFile("yasmc_test.inc", "db 1\n");
+    EXPECT_EQ(0, yasm_ctx_add_include_path(ctx, "."));
+    EXPECT_EQ(0, Assemble(ctx, "%include \"yasmc_test.inc\"\ndb 2\n", &obj));
+    EXPECT_EQ("\x01\x02", obj);
+    std::remove("yasmc_test.inc");
+    yasm_ctx_destroy(ctx);
+}
+
+TEST(YasmcTest, Reset)
+{
+    yasm_ctx* ctx = yasm_ctx_create("x86", "nasm", "bin");
+    ASSERT_TRUE(ctx != 0);
+    EXPECT_EQ(0, yasm_ctx_add_include_path(ctx, "."));
+    std::string obj;
+
+    WriteFile("yasmc_test_reset.inc", "db 1\n");
+    EXPECT_EQ(0, Assemble(ctx, "%include \"yasmc_test_reset.inc\"\n", &obj));
+    EXPECT_EQ("\x01", obj);
+
+    // Without a reset, the file may be cached; after one, it's read again.
+    WriteFile("yasmc_test_reset.inc", "db 3\n");
+    yasm_ctx_reset(ctx);
+    EXPECT_STREQ("", yasm_ctx_diagnostics(ctx));
+    EXPECT_EQ(0, Assemble(ctx, "%include \"yasmc_test_reset.inc\"\n", &obj));
+    EXPECT_EQ("\x03", obj);
+    std::remove("yasmc_test_reset.inc");
+    yasm_ctx_destroy(ctx);
+}
+
+TEST(YasmcTest, SetMachine)
+{
+    yasm_ctx* ctx = yasm_ctx_create("x86", "gas", "elf64");
+    ASSERT_TRUE(ctx != 0);
+    EXPECT_EQ(0, yasm_ctx_set_machine(ctx, "amd64"));
+    EXPECT_NE(0, yasm_ctx_set_machine(ctx, "nonexistent"));
+    std::string obj;
+    EXPECT_EQ(0, Assemble(ctx, "movq %rax, %rbx\n", &obj));
+    EXPECT_EQ(0, obj.compare(0, 4, "\x7f" "ELF"));
+    yasm_ctx_destroy(ctx);
+}
@@ -214,6 +214,24 @@ TEST_F(ExprTest, Simplify)
     EXPECT_EQ("10+(-5)", String::Format(x));
     x.Simplify(diags);
     EXPECT_EQ("5", String::Format(x));
+
+    // Long chains are leveled in one go, folding all the constants.
+    x = a;
+    for (int i=0; i<1000; ++i)
+    {
+        x.Calc(Op::ADD, IntNum(i));
+        x.Calc(Op::ADD, (i % 2) ? b : c);
+    }
+    x.Simplify(diags);
+    EXPECT_EQ(1003U, x.getTerms().size());
+    EXPECT_EQ(1002, x.getTerms().back().getNumChild());
+    EXPECT_EQ(499500, x.getTerms()[1000].getIntNum()->getInt());
+
+    // Same operators separated by another operator are not leveled.
+    x = ADD(ADD(a, MUL(b, ADD(c, d))), e);
+    EXPECT_EQ("(a+(b*(c+d)))+e", String::Format(x));
+    x.Simplify(diags);
+    EXPECT_EQ("a+(b*(c+d))+e", String::Format(x));
 }
 
 //
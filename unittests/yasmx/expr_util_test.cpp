@@ -93,3 +93,55 @@ TEST(ExpandEquTest, Circular)
     Expr v = Expr(SymbolRef(&a));
     EXPECT_FALSE(ExpandEqu(v));
 }
+
+TEST(ExpandEquTest, Memoized)
+{
+    Symbol a("a"), b("b");
+    a.DefineEqu(MUL(5, 4));
+    b.DefineEqu(ADD(SymbolRef(&a), 1));
+    Expr v = Expr(SymbolRef(&b));
+    EXPECT_TRUE(ExpandEqu(v));
+    EXPECT_EQ("(5*4)+1", String::Format(v));
+    ASSERT_TRUE(b.getExpandedEqu() != 0);
+    EXPECT_EQ("(5*4)+1", String::Format(*b.getExpandedEqu()));
+
+    // Second expansion comes from the memoized value.
+    Expr v2 = SUB(SymbolRef(&b), SymbolRef(&a));
+    EXPECT_TRUE(ExpandEqu(v2));
+    EXPECT_EQ("((5*4)+1)-(5*4)", String::Format(v2));
+}
+
+TEST(ExpandEquTest, FoldConstants)
+{
+    Symbol a("a"), b("b");
+    a.DefineEqu(MUL(5, 4));
+    b.DefineEqu(ADD(SymbolRef(&a), 1));
+    Expr v = ADD(SymbolRef(&b), 2);
+    EXPECT_TRUE(ExpandEqu(v, true));
+    EXPECT_EQ("21+2", String::Format(v));
+}
+
+TEST(ExpandEquTest, FoldConstantsDivideByZero)
+{
+    Symbol a("a");
+    a.DefineEqu(DIV(5, 0));
+    Expr v = Expr(SymbolRef(&a));
+    EXPECT_TRUE(ExpandEqu(v, true));
+    EXPECT_EQ("5/0", String::Format(v));
+}
+
+TEST(ExpandEquTest, NoMemoUndefined)
+{
+    Symbol a("a"), b("b");
+    a.DefineEqu(ADD(SymbolRef(&b), 1));
+    Expr v = Expr(SymbolRef(&a));
+    EXPECT_TRUE(ExpandEqu(v));
+    EXPECT_EQ("b+1", String::Format(v));
+    EXPECT_TRUE(a.getExpandedEqu() == 0);
+
+    // b may still become an equ
+    b.DefineEqu(Expr(3));
+    Expr v2 = Expr(SymbolRef(&a));
+    EXPECT_TRUE(ExpandEqu(v2));
+    EXPECT_EQ("3+1", String::Format(v2));
+}
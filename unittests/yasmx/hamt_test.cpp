@@ -149,6 +149,68 @@ TEST_F(HamtTest, DupReplace)
     }
 }
 
+TEST_F(HamtTest, Nocase)
+{
+    GenSym g(NUM_SYMS);
+    myhamt h(true);
+
+    g.InsertCheckNew(h);
+
+    // find with the case of every letter flipped; long names cover the
+    // word-at-a-time hashing and comparison
+    for (GenSym::Symbols::iterator i=g.syms.begin(), end=g.syms.end();
+         i != end; ++i)
+    {
+        std::string name = i->getName();
+        for (std::string::iterator j=name.begin(), jend=name.end();
+             j != jend; ++j)
+        {
+            if (*j >= 'a' && *j <= 'z')
+                *j = *j - 'a' + 'A';
+            else if (*j >= 'A' && *j <= 'Z')
+                *j = *j - 'A' + 'a';
+        }
+        Symbol* sym = h.Find(name);
+        EXPECT_EQ(sym, &(*i));
+    }
+
+    // characters next to the letters must not fold
+    Symbol at("sym@"), bracket("sym["), grave("sym`"), brace("sym{");
+    EXPECT_TRUE(h.Insert(&at) == 0);
+    EXPECT_TRUE(h.Insert(&bracket) == 0);
+    EXPECT_TRUE(h.Insert(&grave) == 0);
+    EXPECT_TRUE(h.Insert(&brace) == 0);
+    EXPECT_EQ(&at, h.Find("SYM@"));
+    EXPECT_EQ(&bracket, h.Find("SYM["));
+    EXPECT_EQ(&grave, h.Find("SYM`"));
+    EXPECT_EQ(&brace, h.Find("SYM{"));
+}
+
+TEST_F(HamtTest, Remove)
+{
+    GenSym g(NUM_SYMS);
+    myhamt h(false);
+
+    g.InsertCheckNew(h);
+
+    // remove every other symbol
+    int n = 0;
+    for (GenSym::Symbols::iterator i=g.syms.begin(), end=g.syms.end();
+         i != end; ++i, ++n)
+    {
+        if (n % 2 == 0)
+            EXPECT_EQ(&(*i), h.Remove(i->getName()));
+    }
+
+    n = 0;
+    for (GenSym::Symbols::iterator i=g.syms.begin(), end=g.syms.end();
+         i != end; ++i, ++n)
+    {
+        Symbol* sym = h.Find(i->getName());
+        EXPECT_EQ((n % 2 == 0) ? 0 : &(*i), sym);
+    }
+}
+
 HamtTest::GenSym::GenSym(int nsym)
     : m_syms_owner(syms)
 {
@@ -157,6 +219,8 @@ HamtTest::GenSym::GenSym(int nsym)
         llvm::SmallString<128> ss;
         llvm::raw_svector_ostream os(ss);
         os << "sym" << i;
+        if (i % 3 == 0)
+            os << "_ZN4yasm6Object9getSymbolERKN4llvm9StringRefE";
         syms.push_back(new Symbol(os.str()));
     }
 }
@@ -0,0 +1,115 @@
+//
+//  Copyright (C) 2026  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "yasmx/Support/IntervalIndex.h"
+
+using namespace yasm;
+
+namespace {
+struct Interval
+{
+    long low, high;
+    int data;
+};
+
+class Collect
+{
+public:
+    std::vector<int> hits;
+    void operator() (int data) { hits.push_back(data); }
+};
+
+bool
+LowLess(const Interval& a, const Interval& b)
+{
+    return a.low < b.low;
+}
+
+// Intervals overlapping [low,high] in the order the index visits them:
+// by low bound, then insertion order.  The data of each is its position
+// in insertion order.
+std::vector<int>
+Expected(const std::vector<Interval>& sorted, long low, long high)
+{
+    std::vector<int> hits;
+    for (size_t i=0; i<sorted.size(); ++i)
+    {
+        if (sorted[i].low <= high && sorted[i].high >= low)
+            hits.push_back(sorted[i].data);
+    }
+    return hits;
+}
+} // anonymous namespace
+
+TEST(IntervalIndexTest, Empty)
+{
+    IntervalIndex<int> index;
+    index.Build();
+    Collect c;
+    index.Enumerate(0, 100, c);
+    EXPECT_TRUE(c.hits.empty());
+}
+
+TEST(IntervalIndexTest, MatchesLinearScan)
+{
+    // Cover sizes around powers of two, where parts of the implicit tree
+    // fall past the end of the array.
+    unsigned long seed = 1;
+    for (int n=1; n<=300; ++n)
+    {
+        std::vector<Interval> intervals;
+        IntervalIndex<int> index;
+        for (int i=0; i<n; ++i)
+        {
+            seed = seed * 1103515245UL + 12345UL;
+            Interval in;
+            in.low = static_cast<long>((seed >> 8) % 200);
+            in.high = in.low + static_cast<long>((seed >> 20) % 40);
+            in.data = i;
+            intervals.push_back(in);
+            index.Insert(in.low, in.high, i);
+        }
+        index.Build();
+        std::stable_sort(intervals.begin(), intervals.end(), LowLess);
+        ASSERT_EQ(static_cast<size_t>(n), index.size());
+
+        for (long point=-1; point<=240; point+=7)
+        {
+            Collect c;
+            index.Enumerate(point, point, c);
+            EXPECT_EQ(Expected(intervals, point, point), c.hits)
+                << "n=" << n << " point=" << point;
+
+            Collect r;
+            index.Enumerate(point, point+15, r);
+            EXPECT_EQ(Expected(intervals, point, point+15), r.hits)
+                << "n=" << n << " range=" << point;
+        }
+    }
+}
@@ -24,6 +24,7 @@
 //
 #include <gtest/gtest.h>
 
+#include <climits>
 #include <cstdio>
 
 #include "llvm/Support/raw_ostream.h"
@@ -159,6 +160,59 @@ TEST(IntNumOperatorOverloadTest, IncDec)
     ASSERT_EQ(5, x.getInt());
 }
 
+TEST(IntNumOperatorOverloadTest, DoubleWidth)
+{
+    // Values crossing the 64-bit and 128-bit storage boundaries.
+    IntNum x = IntNum(1)<<63;
+    EXPECT_EQ("8000000000000000", x.getStr(16));
+    EXPECT_EQ(1, x.getSign());
+    EXPECT_EQ("-8000000000000000", (-x).getStr(16));
+    EXPECT_EQ("10000000000000000", (x+x).getStr(16));
+    EXPECT_EQ("fffffffffffffffe0000000000000001",
+              (((x<<1)-1)*((x<<1)-1)).getStr(16));
+    EXPECT_EQ("100000000000000000000000000000000", ((x*x)<<2).getStr(16));
+    EXPECT_EQ("-80000000000000000000000000000000", (-((x*x)<<1)).getStr(16));
+    EXPECT_EQ(x, (x*x)/x);
+    EXPECT_EQ(x-1, ((x*x)-1)%x);
+    EXPECT_EQ(IntNum(1), ((x*x)<<1)>>127);
+    EXPECT_EQ(IntNum(-1), (-(x*x))>>200);
+    EXPECT_TRUE(x < x*x);
+    EXPECT_TRUE(-(x*x) < -x);
+    EXPECT_TRUE(x+1 > x);
+    EXPECT_EQ(ULONG_MAX, (x*x).getUInt());
+    EXPECT_EQ(0UL, (-x).getUInt());
+    EXPECT_EQ(LONG_MAX, (x*x).getInt());
+    EXPECT_EQ(LONG_MIN, (-(x*x)).getInt());
+
+    IntNum y = x*x;
+    ++y;
+    --y;
+    --y;
+    EXPECT_EQ("3fffffffffffffffffffffffffffffff", y.getStr(16));
+    y.SignExtend(126);
+    EXPECT_EQ(IntNum(-1), y);
+}
+
+TEST(IntNumOperatorOverloadTest, Get64)
+{
+    // 64-bit accessors don't depend on the width of long.
+    IntNum x = IntNum(1)<<32;
+    EXPECT_EQ(static_cast<int64_t>(1)<<32, x.getInt64());
+    EXPECT_EQ(static_cast<uint64_t>(1)<<32, x.getUInt64());
+    EXPECT_EQ(-(static_cast<int64_t>(1)<<32), (-x).getInt64());
+    EXPECT_EQ(0U, (-x).getUInt64());
+
+    IntNum big = IntNum(1)<<63;
+    EXPECT_EQ(static_cast<uint64_t>(1)<<63, big.getUInt64());
+    EXPECT_EQ(INT64_MAX, big.getInt64());
+    EXPECT_EQ(INT64_MIN, (-big).getInt64());
+    EXPECT_EQ(INT64_MIN, (-big-1).getInt64());
+    EXPECT_EQ(UINT64_MAX, (big<<1).getUInt64());
+    EXPECT_EQ(UINT64_MAX, (big*big).getUInt64());
+    EXPECT_EQ(INT64_MAX, (big*big).getInt64());
+    EXPECT_EQ(INT64_MIN, (-(big*big)).getInt64());
+}
+
 class IntNumStreamOutputTest : public ::testing::TestWithParam<long> {};
 
 
@@ -0,0 +1,98 @@
+// MD5 unit test
+//
+//  Copyright (C) 2026  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "yasmx/Support/MD5.h"
+
+using namespace yasm;
+
+static std::string
+Digest(MD5& md5)
+{
+    unsigned char digest[16];
+    md5.Final(digest);
+    std::string str;
+    for (int i=0; i<16; ++i)
+    {
+        char hex[3];
+        std::sprintf(hex, "%02x", digest[i]);
+        str += hex;
+    }
+    return str;
+}
+
+struct MD5Test
+{
+    const char* input;
+    const char* digest;
+};
+
+// RFC 1321 test suite
+static const MD5Test md5_tests[] =
+{
+    {"", "d41d8cd98f00b204e9800998ecf8427e"},
+    {"a", "0cc175b9c0f1b6a831c399e269772661"},
+    {"abc", "900150983cd24fb0d6963f7d28e17f72"},
+    {"message digest", "f96b697d7cb7938d525a2f31aaf161d0"},
+    {"abcdefghijklmnopqrstuvwxyz", "c3fcd3d76192e4007dfb496cca67e13b"},
+    {"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789",
+     "d174ab98d277d9f5a5611c2c9f419d9f"},
+    {"1234567890123456789012345678901234567890"
+     "1234567890123456789012345678901234567890",
+     "57edf4a22be3c955ac49da2e2107b67a"},
+};
+
+TEST(MD5Test, RFC1321)
+{
+    for (size_t i=0; i<sizeof(md5_tests)/sizeof(md5_tests[0]); ++i)
+    {
+        const unsigned char* input =
+            reinterpret_cast<const unsigned char*>(md5_tests[i].input);
+        MD5 md5;
+        md5.Update(input, std::strlen(md5_tests[i].input));
+        EXPECT_EQ(md5_tests[i].digest, Digest(md5)) << md5_tests[i].input;
+    }
+}
+
+TEST(MD5Test, SplitUpdate)
+{
+    // Same result regardless of how the input is split across updates.
+    const MD5Test& test = md5_tests[6];
+    const unsigned char* input =
+        reinterpret_cast<const unsigned char*>(test.input);
+    unsigned long len = std::strlen(test.input);
+    for (unsigned long split=0; split<=len; ++split)
+    {
+        MD5 md5;
+        md5.Update(input, split);
+        md5.Update(input+split, len-split);
+        EXPECT_EQ(test.digest, Digest(md5)) << split;
+    }
+}
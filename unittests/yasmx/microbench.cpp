@@ -0,0 +1,459 @@
+//
+//  Copyright (C) 2026  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include <gtest/gtest.h>
+//
+// Throughput benchmarks for core libyasmx data structures.  Not a test:
+// run libyasmx_bench by hand (optionally with a substring to select
+// benchmarks) and compare the rates before and after a change.
+//
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/IntrusiveRefCntPtr.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/TimeValue.h"
+#include "llvm/Support/raw_ostream.h"
+#include "yasmx/Basic/Diagnostic.h"
+#include "yasmx/Config/functional.h"
+#include "yasmx/Support/IntervalIndex.h"
+#include "yasmx/Support/IntervalTree.h"
+#include "yasmx/Expr.h"
+#include "yasmx/IntNum.h"
+#include "yasmx/Symbol.h"
+#include "hamt.h"
+
+using namespace yasm;
+
+namespace {
+typedef void (*BenchFunc) (unsigned long iterations);
+
+struct Benchmark
+{
+    const char* name;
+    BenchFunc func;
+    const char* unit;           // what one iteration is
+};
+
+class SymGetName
+{
+public:
+    const std::string& operator() (const std::string* str) const
+    { return *str; }
+};
+
+typedef hamt<std::string, std::string, SymGetName> StringHamt;
+
+class NullDiagConsumer : public DiagnosticConsumer
+{
+public:
+    void HandleDiagnostic(DiagnosticsEngine::Level level,
+                          const Diagnostic& info) {}
+    DiagnosticConsumer* clone(DiagnosticsEngine& diags) const
+    { return new NullDiagConsumer; }
+};
+} // anonymous namespace
+
+// Consumes results so the compiler cannot discard the work.
+static volatile unsigned long sink;
+
+static NullDiagConsumer null_diags;
+static DiagnosticsEngine*
+getDiags()
+{
+    static DiagnosticsEngine* diags = 0;
+    if (!diags)
+    {
+        llvm::IntrusiveRefCntPtr<DiagnosticIDs> diagids(new DiagnosticIDs);
+        diags = new DiagnosticsEngine(diagids, &null_diags, false);
+    }
+    return diags;
+}
+
+static double
+getTime()
+{
+    llvm::sys::TimeValue now = llvm::sys::TimeValue::now();
+    return now.seconds() + now.nanoseconds() / 1e9;
+}
+
+// Symbol-like names, as the symbol table sees them.
+static std::vector<std::string>
+MakeNames(unsigned long n, const char* prefix)
+{
+    std::vector<std::string> names;
+    names.reserve(n);
+    char buf[32];
+    for (unsigned long i=0; i<n; ++i)
+    {
+        std::sprintf(buf, "%s%lu_%lx", prefix, i, (i*2654435761UL)&0xffff);
+        names.push_back(buf);
+    }
+    return names;
+}
+
+static void
+IntNumSmallCalc(unsigned long iterations)
+{
+    DiagnosticsEngine& diags = *getDiags();
+    IntNum acc;
+    for (unsigned long i=0; i<iterations; ++i)
+    {
+        IntNum val(static_cast<unsigned long>(i));
+        acc.Calc(Op::ADD, val, SourceLocation(), diags);
+        acc.Calc(Op::MUL, IntNum(3), SourceLocation(), diags);
+        acc.Calc(Op::AND, IntNum(0xffffffUL), SourceLocation(), diags);
+        acc.Calc(Op::SHL, IntNum(2), SourceLocation(), diags);
+        acc.Calc(Op::SHR, IntNum(1), SourceLocation(), diags);
+    }
+    sink = acc.getUInt();
+}
+
+static void
+IntNumBigCalc(unsigned long iterations)
+{
+    DiagnosticsEngine& diags = *getDiags();
+    IntNum big;
+    big.setStr("123456789abcdef0123456789abcdef0123456789", 16);
+    for (unsigned long i=0; i<iterations; ++i)
+    {
+        IntNum acc(big);
+        acc.Calc(Op::ADD, IntNum(static_cast<unsigned long>(i)),
+                 SourceLocation(), diags);
+        acc.Calc(Op::MUL, IntNum(7), SourceLocation(), diags);
+        acc.Calc(Op::XOR, big, SourceLocation(), diags);
+        acc.Calc(Op::DIV, IntNum(3), SourceLocation(), diags);
+        acc.Calc(Op::SHR, IntNum(100), SourceLocation(), diags);
+        sink = acc.getUInt();
+    }
+}
+
+static void
+IntNumParse(unsigned long iterations)
+{
+    IntNum val;
+    char buf[32];
+    for (unsigned long i=0; i<iterations; ++i)
+    {
+        std::sprintf(buf, "%lx", i*2654435761UL);
+        val.setStr(buf, 16);
+        sink = val.getUInt();
+    }
+}
+
+// Typical effective address / data expression: sym+4*(i+2)-8.
+static void
+ExprSimplifySmall(unsigned long iterations)
+{
+    DiagnosticsEngine& diags = *getDiags();
+    Symbol sym("sym");
+    for (unsigned long i=0; i<iterations; ++i)
+    {
+        Expr e = SUB(ADD(SymbolRef(&sym),
+                         MUL(IntNum(4), ADD(IntNum(i & 0xff), IntNum(2)))),
+                     IntNum(8));
+        e.Simplify(diags);
+        sink = e.getTerms().size();
+    }
+}
+
+// Deeply nested sums as produced by label differences and macros;
+// exercises leveling of many terms.
+static void
+ExprSimplifyNested(unsigned long iterations)
+{
+    DiagnosticsEngine& diags = *getDiags();
+    Symbol sym1("a"), sym2("b");
+    for (unsigned long i=0; i<iterations; ++i)
+    {
+        Expr e((SymbolRef(&sym1)));
+        for (int j=0; j<32; ++j)
+        {
+            if (j % 4 == 0)
+                e = SUB(e, SymbolRef(&sym2));
+            else if (j % 4 == 1)
+                e = ADD(e, SymbolRef(&sym2));
+            else
+                e = ADD(e, MUL(IntNum(j), IntNum(2)));
+        }
+        e.Simplify(diags);
+        sink = e.getTerms().size();
+    }
+}
+
+// Long generated sums (checksums, table sizes): a+1+b+2+... parsed
+// left-associatively into a 4096-deep chain.
+static void
+ExprSimplifyChain(unsigned long iterations)
+{
+    DiagnosticsEngine& diags = *getDiags();
+    Symbol sym1("a"), sym2("b");
+    Expr chain((SymbolRef(&sym1)));
+    for (int j=0; j<4096; ++j)
+    {
+        if (j % 2 == 0)
+            chain.Calc(Op::ADD, IntNum(j));
+        else
+            chain.Calc(Op::ADD, SymbolRef(j % 4 == 1 ? &sym1 : &sym2));
+    }
+    for (unsigned long i=0; i<iterations; ++i)
+    {
+        Expr e(chain);
+        e.Simplify(diags);
+        sink = e.getTerms().size();
+    }
+}
+
+// Spans as the optimizer sees them: mostly short, local intervals.
+enum { NUM_INTERVALS = 10000 };
+
+static void
+AddCount(unsigned long* count, IntervalTreeNode<unsigned long>* node)
+{
+    *count += node->getData();
+}
+
+static void
+IntervalTreeInsert(unsigned long iterations)
+{
+    for (unsigned long i=0; i<iterations; ++i)
+    {
+        IntervalTree<unsigned long> tree;
+        for (unsigned long j=0; j<NUM_INTERVALS; ++j)
+        {
+            long low = static_cast<long>(j);
+            long high = low + static_cast<long>((j*2654435761UL) % 64);
+            tree.Insert(low, high, 1);
+        }
+    }
+}
+
+static void
+IntervalTreeQuery(unsigned long iterations)
+{
+    static IntervalTree<unsigned long>* tree = 0;
+    if (!tree)
+    {
+        tree = new IntervalTree<unsigned long>;
+        for (unsigned long j=0; j<NUM_INTERVALS; ++j)
+        {
+            long low = static_cast<long>(j);
+            long high = low + static_cast<long>((j*2654435761UL) % 64);
+            tree->Insert(low, high, 1);
+        }
+    }
+    unsigned long count = 0;
+    for (unsigned long i=0; i<iterations; ++i)
+    {
+        long pos = static_cast<long>((i*40503UL) % NUM_INTERVALS);
+        tree->Enumerate(pos, pos, TR1::bind(&AddCount, &count, _1));
+    }
+    sink = count;
+}
+
+class AddCountVisitor
+{
+public:
+    AddCountVisitor(unsigned long* count) : m_count(count) {}
+    void operator() (unsigned long data) { *m_count += data; }
+
+private:
+    unsigned long* m_count;
+};
+
+static void
+IntervalIndexBuild(unsigned long iterations)
+{
+    for (unsigned long i=0; i<iterations; ++i)
+    {
+        IntervalIndex<unsigned long> index;
+        for (unsigned long j=0; j<NUM_INTERVALS; ++j)
+        {
+            long low = static_cast<long>(j);
+            long high = low + static_cast<long>((j*2654435761UL) % 64);
+            index.Insert(low, high, 1);
+        }
+        index.Build();
+    }
+}
+
+static void
+IntervalIndexQuery(unsigned long iterations)
+{
+    static IntervalIndex<unsigned long>* index = 0;
+    if (!index)
+    {
+        index = new IntervalIndex<unsigned long>;
+        for (unsigned long j=0; j<NUM_INTERVALS; ++j)
+        {
+            long low = static_cast<long>(j);
+            long high = low + static_cast<long>((j*2654435761UL) % 64);
+            index->Insert(low, high, 1);
+        }
+        index->Build();
+    }
+    unsigned long count = 0;
+    AddCountVisitor visit(&count);
+    for (unsigned long i=0; i<iterations; ++i)
+    {
+        long pos = static_cast<long>((i*40503UL) % NUM_INTERVALS);
+        index->Enumerate(pos, pos, visit);
+    }
+    sink = count;
+}
+
+enum { NUM_NAMES = 10000 };
+
+static void
+HamtInsert(unsigned long iterations)
+{
+    static std::vector<std::string> names = MakeNames(NUM_NAMES, "sym");
+    for (unsigned long i=0; i<iterations; ++i)
+    {
+        StringHamt h(false);
+        for (std::vector<std::string>::iterator j=names.begin(),
+             end=names.end(); j != end; ++j)
+            h.Insert(&(*j));
+    }
+}
+
+static void
+HamtFind(unsigned long iterations)
+{
+    static std::vector<std::string> names = MakeNames(NUM_NAMES, "sym");
+    static std::vector<std::string> misses = MakeNames(NUM_NAMES, "none");
+    static StringHamt* h = 0;
+    if (!h)
+    {
+        h = new StringHamt(false);
+        for (std::vector<std::string>::iterator j=names.begin(),
+             end=names.end(); j != end; ++j)
+            h->Insert(&(*j));
+    }
+    unsigned long found = 0;
+    for (unsigned long i=0; i<iterations; ++i)
+    {
+        // Alternate hits and misses.
+        const std::vector<std::string>& keys = (i & 1) ? misses : names;
+        if (h->Find(keys[(i*40503UL) % NUM_NAMES]))
+            ++found;
+    }
+    sink = found;
+}
+
+// C++-mangled style names, long enough that hashing dominates the lookup.
+static std::vector<std::string>
+MakeLongNames(unsigned long n, const char* prefix)
+{
+    std::vector<std::string> names = MakeNames(n, prefix);
+    for (std::vector<std::string>::iterator i=names.begin(), end=names.end();
+         i != end; ++i)
+        *i = "_ZN4yasm6detail" + *i +
+             "_ImplINS_11SourceRangeEE10HandleNameERKN4llvm9StringRefEb";
+    return names;
+}
+
+static void
+HamtFindLongNocase(unsigned long iterations)
+{
+    static std::vector<std::string> names = MakeLongNames(NUM_NAMES, "Sym");
+    static std::vector<std::string> misses = MakeLongNames(NUM_NAMES, "None");
+    static StringHamt* h = 0;
+    if (!h)
+    {
+        h = new StringHamt(true);
+        for (std::vector<std::string>::iterator j=names.begin(),
+             end=names.end(); j != end; ++j)
+            h->Insert(&(*j));
+    }
+    unsigned long found = 0;
+    for (unsigned long i=0; i<iterations; ++i)
+    {
+        const std::vector<std::string>& keys = (i & 1) ? misses : names;
+        if (h->Find(keys[(i*40503UL) % NUM_NAMES]))
+            ++found;
+    }
+    sink = found;
+}
+
+static const Benchmark benchmarks[] =
+{
+    {"IntNumSmallCalc",     IntNumSmallCalc,    "5 ops"},
+    {"IntNumBigCalc",       IntNumBigCalc,      "5 ops"},
+    {"IntNumParse",         IntNumParse,        "parse"},
+    {"ExprSimplifySmall",   ExprSimplifySmall,  "expr"},
+    {"ExprSimplifyNested",  ExprSimplifyNested, "expr"},
+    {"ExprSimplifyChain",   ExprSimplifyChain,  "expr"},
+    {"IntervalTreeInsert",  IntervalTreeInsert, "10k inserts"},
+    {"IntervalTreeQuery",   IntervalTreeQuery,  "query"},
+    {"IntervalIndexBuild",  IntervalIndexBuild, "10k inserts"},
+    {"IntervalIndexQuery",  IntervalIndexQuery, "query"},
+    {"HamtInsert",          HamtInsert,         "10k inserts"},
+    {"HamtFind",            HamtFind,           "lookup"},
+    {"HamtFindLongNocase",  HamtFindLongNocase, "lookup"},
+};
+
+// Run a benchmark with increasing iteration counts until it runs long
+// enough to time reliably.
+static void
+RunBenchmark(const Benchmark& bench)
+{
+    const double min_time = 0.5;
+    unsigned long iterations = 1;
+    double elapsed;
+    for (;;)
+    {
+        double start = getTime();
+        bench.func(iterations);
+        elapsed = getTime() - start;
+        if (elapsed >= min_time)
+            break;
+        if (elapsed < min_time / 100)
+            iterations *= 10;
+        else
+            iterations = static_cast<unsigned long>(
+                iterations * min_time * 1.2 / elapsed) + 1;
+    }
+    llvm::outs() << llvm::format("%-24s %12.1f ns %14.0f /s %12lu  (%s)\n",
+                                 bench.name, elapsed * 1e9 / iterations,
+                                 iterations / elapsed, iterations,
+                                 bench.unit);
+    llvm::outs().flush();
+}
+
+int
+main(int argc, char* argv[])
+{
+    llvm::outs() << "Benchmark                           Time             Rate"
+                    "   Iterations\n";
+    for (unsigned int i=0; i<sizeof(benchmarks)/sizeof(benchmarks[0]); ++i)
+    {
+        if (argc > 1 && !std::strstr(benchmarks[i].name, argv[1]))
+            continue;
+        RunBenchmark(benchmarks[i]);
+    }
+    return 0;
+}
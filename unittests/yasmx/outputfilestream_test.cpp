@@ -0,0 +1,240 @@
+// OutputFileStream unit test
+//
+//  Copyright (C) 2026  Peter Johnson
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "llvm/Support/raw_ostream.h"
+#include "yasmx/Support/OutputFileStream.h"
+
+TEST(OutputFileStreamTest, PatchHeader)
+{
+    std::string str;
+    llvm::raw_string_ostream dest(str);
+    {
+        yasm::OutputFileStream os(dest);
+        EXPECT_EQ(4U, os.seek(4));
+        os << "body";
+        EXPECT_EQ(8U, os.tell());
+        os.seek(0);
+        os << "head";
+        EXPECT_EQ(4U, os.tell());
+        // nothing is written until close
+        EXPECT_TRUE(dest.str().empty());
+        os.close();
+    }
+    EXPECT_EQ("headbody", dest.str());
+}
+
+TEST(OutputFileStreamTest, SeekPastEnd)
+{
+    std::string str;
+    llvm::raw_string_ostream dest(str);
+    {
+        yasm::OutputFileStream os(dest);
+        os << "ab";
+        os.seek(5);
+        os << "c";
+        os.seek(1);
+        os << "xyz";
+        os.close();
+    }
+    EXPECT_EQ(std::string("axyz\0c", 6), dest.str());
+}
+
+TEST(OutputFileStreamTest, DiscardUnclosed)
+{
+    std::string str;
+    llvm::raw_string_ostream dest(str);
+    {
+        yasm::OutputFileStream os(dest);
+        os << "data";
+    }
+    EXPECT_TRUE(dest.str().empty());
+}
+
+TEST(OutputFileStreamTest, WriteZeros)
+{
+    std::string str;
+    llvm::raw_string_ostream dest(str);
+    {
+        yasm::OutputFileStream os(dest);
+        os << "abcdef";
+        os.seek(2);
+        os.write_zeros(2);
+        EXPECT_EQ(4U, os.tell());
+        os.seek(5);
+        os.write_zeros(3);
+        EXPECT_EQ(8U, os.tell());
+        os << "g";
+        os.close();
+    }
+    EXPECT_EQ(std::string("ab\0\0e\0\0\0g", 9), dest.str());
+}
+
+TEST(OutputFileStreamTest, MemoryImage)
+{
+    std::vector<char> image(3, 'x');    // replaced on close
+    {
+        yasm::OutputFileStream os(image);
+        os << "body";
+        os.seek(0);
+        os << "B";
+        os.seek(6);
+        os << "!";
+        EXPECT_EQ(3U, image.size());
+        os.close();
+    }
+    EXPECT_EQ(std::string("Body\0\0!", 7),
+              std::string(image.begin(), image.end()));
+}
+
+TEST(OutputFileStreamTest, WriteFill)
+{
+    std::string str;
+    llvm::raw_string_ostream dest(str);
+    {
+        yasm::OutputFileStream os(dest);
+        os << "<";
+        os.write_fill("abc", 3, 5000);
+        EXPECT_EQ(15001U, os.tell());
+        os.write_fill("abc", 3, 2);         // continues the run
+        os.write_fill("-", 1, 3);           // short fills are plain data
+        os << ">";
+        os.close();
+    }
+    std::string expected("<");
+    for (int i=0; i<5002; ++i)
+        expected += "abc";
+    expected += "--->";
+    EXPECT_EQ(expected.size(), str.size());
+    EXPECT_TRUE(expected == str);
+}
+
+TEST(OutputFileStreamTest, PatchFill)
+{
+    // Overwrite pieces of a run, including ones straddling copies of the
+    // pattern and the end of the run.
+    std::vector<char> image;
+    std::string expected;
+    {
+        yasm::OutputFileStream os(image);
+        os.write_fill("0123456789", 10, 1000);
+        os.write_zeros(20000);
+        for (int i=0; i<1000; ++i)
+            expected += "0123456789";
+        expected.append(20000, '\0');
+
+        os.seek(15);
+        os << "abcdefgh";
+        expected.replace(15, 8, "abcdefgh");
+        os.seek(9995);
+        os << "XYZWVU";
+        expected.replace(9995, 6, "XYZWVU");
+        os.seek(4);
+        os.write_fill("#", 1, 5000);
+        expected.replace(4, 5000, 5000, '#');
+        os.seek(29990);
+        os << "end of the image";
+        expected.replace(29990, 10, "end of the image");
+        os.seek(3);
+        os << "!";
+        expected.replace(3, 1, "!");
+        os.close();
+    }
+    std::string actual(image.begin(), image.end());
+    EXPECT_EQ(expected.size(), actual.size());
+    EXPECT_TRUE(expected == actual);
+}
+
+static void
+CheckSparseFile(size_t head, size_t hole, size_t tail)
+{
+    const char* filename = "outputfilestream_test.tmp";
+    std::string expected(head, 'h');
+    expected.append(hole, '\0');
+    expected.append(tail, 't');
+    {
+        std::string err;
+        llvm::raw_fd_ostream dest(filename, err, llvm::raw_fd_ostream::F_Binary);
+        ASSERT_TRUE(err.empty());
+        yasm::OutputFileStream os(dest);
+        os << std::string(head, 'h');
+        os.write_zeros(hole);
+        os << std::string(tail, 't');
+        os.close();
+        EXPECT_FALSE(dest.has_error());
+    }
+    std::ifstream in(filename, std::ios::in | std::ios::binary);
+    std::string actual((std::istreambuf_iterator<char>(in)),
+                       std::istreambuf_iterator<char>());
+    in.close();
+    std::remove(filename);
+    EXPECT_EQ(expected.size(), actual.size());
+    EXPECT_TRUE(expected == actual);
+}
+
+TEST(OutputFileStreamTest, SparseFile)
+{
+    const size_t big = yasm::OutputFileStream::SPARSE_THRESHOLD * 3;
+    CheckSparseFile(100, big, 100);     // unaligned hole in the middle
+    CheckSparseFile(0, big, 1);         // leading hole
+    CheckSparseFile(5, big, 0);         // trailing hole
+    CheckSparseFile(0, big, 0);         // nothing but a hole
+    CheckSparseFile(10, 1000, 10);      // too short to leave a hole
+}
+
+TEST(OutputFileStreamTest, SparseFill)
+{
+    const char* filename = "outputfilestream_test.tmp";
+    const uint64_t big = yasm::OutputFileStream::SPARSE_THRESHOLD * 3;
+    std::string expected(std::string(big, '\xff') + "x");
+    expected.append(big, '\0');
+    expected += "y";
+    {
+        std::string err;
+        llvm::raw_fd_ostream dest(filename, err, llvm::raw_fd_ostream::F_Binary);
+        ASSERT_TRUE(err.empty());
+        yasm::OutputFileStream os(dest);
+        os.write_fill("\xff", 1, big);
+        os << "x";
+        os.write_zeros(big);
+        os << "y";
+        os.close();
+        EXPECT_FALSE(dest.has_error());
+    }
+    std::ifstream in(filename, std::ios::in | std::ios::binary);
+    std::string actual((std::istreambuf_iterator<char>(in)),
+                       std::istreambuf_iterator<char>());
+    in.close();
+    std::remove(filename);
+    EXPECT_EQ(expected.size(), actual.size());
+    EXPECT_TRUE(expected == actual);
+}
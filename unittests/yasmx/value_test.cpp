@@ -22,6 +22,8 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 //
+#include <climits>
+
 #include <gtest/gtest.h>
 
 #include "yasmx/Basic/FileManager.h"
@@ -591,3 +593,58 @@ TEST_F(ValueTest, getIntNum)
 
     // TODO: calc_bc_dist-using tests
 }
+
+TEST_F(ValueTest, CompactAbs)
+{
+    MockDiagnosticId mock_consumer;
+    llvm::IntrusiveRefCntPtr<DiagnosticIDs> diagids(new DiagnosticIDs);
+    DiagnosticsEngine diags(diagids, &mock_consumer, false);
+    FileSystemOptions opts;
+    FileManager fmgr(opts);
+    SourceManager smgr(diags, fmgr);
+    diags.setSourceManager(&smgr);
+
+    IntNum intn;
+
+    // symbol+addend keeps just the addend integer
+    Value v(32, Expr::Ptr(new Expr(ADD(sym1, 5))));
+    EXPECT_TRUE(v.Finalize(diags));
+    EXPECT_EQ(sym1, v.getRelative());
+    ASSERT_TRUE(v.hasAbs());
+
+    // copies are independent
+    Value v2(v);
+    v2.AddAbs(3);
+    v.AddAbs(Expr(1));
+    v.getAbs()->Simplify(diags);
+    EXPECT_EQ("6", String::Format(*v.getAbs()));
+    EXPECT_EQ("8", String::Format(*v2.getAbs()));
+
+    // addends too big for a long stay an expression
+    IntNum big = 1;
+    big <<= 100;
+    Value v3(128, Expr::Ptr(new Expr(ADD(sym1, big))));
+    EXPECT_TRUE(v3.Finalize(diags));
+    ASSERT_TRUE(v3.hasAbs());
+    ASSERT_TRUE(v3.getAbs()->isIntNum());
+    EXPECT_EQ(big, v3.getAbs()->getIntNum());
+
+    // adding to an integer can overflow into an expression
+    Value v4(64, Expr::Ptr(new Expr(LONG_MAX)));
+    EXPECT_TRUE(v4.Finalize(diags));
+    v4.AddAbs(1);
+    v4.getAbs()->Simplify(diags);
+    IntNum expect = LONG_MAX;
+    expect += 1;
+    EXPECT_EQ(expect, v4.getAbs()->getIntNum());
+
+    // swap and assignment carry the integer along
+    Value v5(8);
+    v5.swap(v2);
+    EXPECT_TRUE(v5.getIntNum(&intn, false, diags) == false);
+    EXPECT_EQ(sym1, v5.getRelative());
+    v2 = v5;
+    v2.ClearRelative();
+    EXPECT_TRUE(v2.getIntNum(&intn, false, diags));
+    EXPECT_EQ(8, intn.getInt());
+}